@@ -38,6 +38,9 @@
 #include <crypto/internal/skcipher.h>
 #include <linux/workqueue.h>
 #include <linux/spinlock.h>
+#include <linux/debugfs.h>
+#include <linux/percpu.h>
+#include <linux/seq_file.h>
 #ifdef CONFIG_X86_64
 #include <asm/crypto/glue_helper.h>
 #endif
@@ -376,24 +379,145 @@ static int aesni_skcipher_setkey(struct crypto_skcipher *tfm, const u8 *key,
 				  crypto_skcipher_ctx(tfm), key, len);
 }
 
+/*
+ * The walks below keep one FPU section over several walk steps, so that
+ * a request split in many small segments doesn't save and restore the
+ * FPU state for each of them.  Preemption is disabled for the whole
+ * section though, so a section is ended after fpu_max_bytes to bound the
+ * scheduling latency of large requests.
+ */
+static unsigned int fpu_max_bytes = 16384;
+module_param(fpu_max_bytes, uint, 0644);
+MODULE_PARM_DESC(fpu_max_bytes, "Bytes processed with preemption disabled, per FPU section (0 = the whole request)");
+
+struct aesni_fpu_stats {
+	u64 sections;
+	u64 steps;
+	u64 bytes;
+	u64 max_bytes;
+};
+
+static DEFINE_PER_CPU(struct aesni_fpu_stats, aesni_fpu_stats);
+
+struct aesni_fpu_section {
+	unsigned int bytes;
+	unsigned int steps;
+};
+
+static void aesni_fpu_begin(struct aesni_fpu_section *fpu)
+{
+	kernel_fpu_begin();
+	fpu->bytes = 0;
+	fpu->steps = 0;
+}
+
+static void aesni_fpu_end(struct aesni_fpu_section *fpu)
+{
+	struct aesni_fpu_stats *stats = this_cpu_ptr(&aesni_fpu_stats);
+
+	/*
+	 * Nothing else on this CPU can be in a section while this one is
+	 * open, so the counters need no atomics.
+	 */
+	if (fpu->steps) {
+		stats->sections++;
+		stats->steps += fpu->steps;
+		stats->bytes += fpu->bytes;
+		if (fpu->bytes > stats->max_bytes)
+			stats->max_bytes = fpu->bytes;
+	}
+	kernel_fpu_end();
+}
+
+/* Called after each walk step, with the bytes the step processed */
+static void aesni_fpu_step(struct aesni_fpu_section *fpu, unsigned int bytes)
+{
+	unsigned int max_bytes = READ_ONCE(fpu_max_bytes);
+
+	fpu->bytes += bytes;
+	fpu->steps++;
+	if (max_bytes && fpu->bytes >= max_bytes) {
+		aesni_fpu_end(fpu);
+		aesni_fpu_begin(fpu);
+	}
+}
+
+#ifdef CONFIG_DEBUG_FS
+static struct dentry *aesni_fpu_dentry;
+
+static int aesni_fpu_stats_show(struct seq_file *m, void *v)
+{
+	struct aesni_fpu_stats sum = {};
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct aesni_fpu_stats *stats = per_cpu_ptr(&aesni_fpu_stats,
+							    cpu);
+
+		sum.sections += stats->sections;
+		sum.steps += stats->steps;
+		sum.bytes += stats->bytes;
+		sum.max_bytes = max(sum.max_bytes, stats->max_bytes);
+	}
+
+	seq_printf(m, "sections: %llu\n", sum.sections);
+	seq_printf(m, "steps: %llu\n", sum.steps);
+	seq_printf(m, "bytes: %llu\n", sum.bytes);
+	seq_printf(m, "avg_bytes: %llu\n",
+		   sum.sections ? div64_u64(sum.bytes, sum.sections) : 0);
+	seq_printf(m, "max_bytes: %llu\n", sum.max_bytes);
+	return 0;
+}
+
+static int aesni_fpu_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, aesni_fpu_stats_show, NULL);
+}
+
+static const struct file_operations aesni_fpu_stats_fops = {
+	.owner		= THIS_MODULE,
+	.open		= aesni_fpu_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void aesni_fpu_debugfs_init(void)
+{
+	aesni_fpu_dentry = debugfs_create_file("aesni_fpu_sections", 0444,
+					       NULL, NULL,
+					       &aesni_fpu_stats_fops);
+}
+
+static void aesni_fpu_debugfs_exit(void)
+{
+	debugfs_remove(aesni_fpu_dentry);
+}
+#else
+static void aesni_fpu_debugfs_init(void) { }
+static void aesni_fpu_debugfs_exit(void) { }
+#endif
+
 static int ecb_encrypt(struct skcipher_request *req)
 {
 	struct crypto_skcipher *tfm = crypto_skcipher_reqtfm(req);
 	struct crypto_aes_ctx *ctx = aes_ctx(crypto_skcipher_ctx(tfm));
+	struct aesni_fpu_section fpu;
 	struct skcipher_walk walk;
 	unsigned int nbytes;
 	int err;
 
 	err = skcipher_walk_virt(&walk, req, true);
 
-	kernel_fpu_begin();
+	aesni_fpu_begin(&fpu);
 	while ((nbytes = walk.nbytes)) {
 		aesni_ecb_enc(ctx, walk.dst.virt.addr, walk.src.virt.addr,
 			      nbytes & AES_BLOCK_MASK);
+		aesni_fpu_step(&fpu, nbytes & AES_BLOCK_MASK);
 		nbytes &= AES_BLOCK_SIZE - 1;
 		err = skcipher_walk_done(&walk, nbytes);
 	}
-	kernel_fpu_end();
+	aesni_fpu_end(&fpu);
 
 	return err;
 }
@@ -402,20 +526,22 @@ static int ecb_decrypt(struct skcipher_request *req)
 {
 	struct crypto_skcipher *tfm = crypto_skcipher_reqtfm(req);
 	struct crypto_aes_ctx *ctx = aes_ctx(crypto_skcipher_ctx(tfm));
+	struct aesni_fpu_section fpu;
 	struct skcipher_walk walk;
 	unsigned int nbytes;
 	int err;
 
 	err = skcipher_walk_virt(&walk, req, true);
 
-	kernel_fpu_begin();
+	aesni_fpu_begin(&fpu);
 	while ((nbytes = walk.nbytes)) {
 		aesni_ecb_dec(ctx, walk.dst.virt.addr, walk.src.virt.addr,
 			      nbytes & AES_BLOCK_MASK);
+		aesni_fpu_step(&fpu, nbytes & AES_BLOCK_MASK);
 		nbytes &= AES_BLOCK_SIZE - 1;
 		err = skcipher_walk_done(&walk, nbytes);
 	}
-	kernel_fpu_end();
+	aesni_fpu_end(&fpu);
 
 	return err;
 }
@@ -424,20 +550,22 @@ static int cbc_encrypt(struct skcipher_request *req)
 {
 	struct crypto_skcipher *tfm = crypto_skcipher_reqtfm(req);
 	struct crypto_aes_ctx *ctx = aes_ctx(crypto_skcipher_ctx(tfm));
+	struct aesni_fpu_section fpu;
 	struct skcipher_walk walk;
 	unsigned int nbytes;
 	int err;
 
 	err = skcipher_walk_virt(&walk, req, true);
 
-	kernel_fpu_begin();
+	aesni_fpu_begin(&fpu);
 	while ((nbytes = walk.nbytes)) {
 		aesni_cbc_enc(ctx, walk.dst.virt.addr, walk.src.virt.addr,
 			      nbytes & AES_BLOCK_MASK, walk.iv);
+		aesni_fpu_step(&fpu, nbytes & AES_BLOCK_MASK);
 		nbytes &= AES_BLOCK_SIZE - 1;
 		err = skcipher_walk_done(&walk, nbytes);
 	}
-	kernel_fpu_end();
+	aesni_fpu_end(&fpu);
 
 	return err;
 }
@@ -446,20 +574,22 @@ static int cbc_decrypt(struct skcipher_request *req)
 {
 	struct crypto_skcipher *tfm = crypto_skcipher_reqtfm(req);
 	struct crypto_aes_ctx *ctx = aes_ctx(crypto_skcipher_ctx(tfm));
+	struct aesni_fpu_section fpu;
 	struct skcipher_walk walk;
 	unsigned int nbytes;
 	int err;
 
 	err = skcipher_walk_virt(&walk, req, true);
 
-	kernel_fpu_begin();
+	aesni_fpu_begin(&fpu);
 	while ((nbytes = walk.nbytes)) {
 		aesni_cbc_dec(ctx, walk.dst.virt.addr, walk.src.virt.addr,
 			      nbytes & AES_BLOCK_MASK, walk.iv);
+		aesni_fpu_step(&fpu, nbytes & AES_BLOCK_MASK);
 		nbytes &= AES_BLOCK_SIZE - 1;
 		err = skcipher_walk_done(&walk, nbytes);
 	}
-	kernel_fpu_end();
+	aesni_fpu_end(&fpu);
 
 	return err;
 }
@@ -503,16 +633,18 @@ static int ctr_crypt(struct skcipher_request *req)
 {
 	struct crypto_skcipher *tfm = crypto_skcipher_reqtfm(req);
 	struct crypto_aes_ctx *ctx = aes_ctx(crypto_skcipher_ctx(tfm));
+	struct aesni_fpu_section fpu;
 	struct skcipher_walk walk;
 	unsigned int nbytes;
 	int err;
 
 	err = skcipher_walk_virt(&walk, req, true);
 
-	kernel_fpu_begin();
+	aesni_fpu_begin(&fpu);
 	while ((nbytes = walk.nbytes) >= AES_BLOCK_SIZE) {
 		aesni_ctr_enc_tfm(ctx, walk.dst.virt.addr, walk.src.virt.addr,
 			              nbytes & AES_BLOCK_MASK, walk.iv);
+		aesni_fpu_step(&fpu, nbytes & AES_BLOCK_MASK);
 		nbytes &= AES_BLOCK_SIZE - 1;
 		err = skcipher_walk_done(&walk, nbytes);
 	}
@@ -520,7 +652,7 @@ static int ctr_crypt(struct skcipher_request *req)
 		ctr_crypt_final(ctx, &walk);
 		err = skcipher_walk_done(&walk, 0);
 	}
-	kernel_fpu_end();
+	aesni_fpu_end(&fpu);
 
 	return err;
 }
@@ -1285,6 +1417,7 @@ static int __init aesni_init(void)
 		aesni_simd_skciphers2[i].simd = simd;
 	}
 
+	aesni_fpu_debugfs_init();
 	return 0;
 
 unregister_simds:
@@ -1302,6 +1435,7 @@ static int __init aesni_init(void)
 
 static void __exit aesni_exit(void)
 {
+	aesni_fpu_debugfs_exit();
 	aesni_free_simds();
 	crypto_unregister_aeads(aesni_aead_algs, ARRAY_SIZE(aesni_aead_algs));
 	crypto_unregister_skciphers(aesni_skciphers,
@@ -62,6 +62,7 @@
 #include <linux/list.h>
 #include <crypto/scatterwalk.h>
 #include <crypto/sha.h>
+#include <crypto/sha256_base.h>
 #include <crypto/mcryptd.h>
 #include <crypto/crypto_wq.h>
 #include <asm/byteorder.h>
@@ -907,6 +908,98 @@ static struct ahash_alg sha256_mb_async_alg = {
 	},
 };
 
+/*
+ * Synchronous multi-buffer hashing: crypto_shash_digest_many() on the
+ * "sha256_mb_sync" shash runs up to a lane's worth of buffers through a
+ * per-cpu job manager in one FPU section, and returns when their digests
+ * are done.  The single buffer operations use the generic code.
+ */
+struct sha256_mb_sync_state {
+	struct sha256_ctx_mgr mgr;
+	struct sha256_hash_ctx ctx[SHA256_MB_MGR_NUM_LANES_AVX2];
+};
+
+static struct sha256_mb_sync_state __percpu *sha256_mb_sync_state;
+
+static int sha256_mb_sync_init(struct shash_desc *desc)
+{
+	return sha256_base_init(desc);
+}
+
+static int sha256_mb_sync_final(struct shash_desc *desc, u8 *out)
+{
+	return crypto_sha256_finup(desc, NULL, 0, out);
+}
+
+static int sha256_mb_sync_digest_many(struct shash_desc *desc,
+				      const u8 * const *data, unsigned int len,
+				      u8 * const *out, unsigned int n)
+{
+	struct sha256_mb_sync_state *state;
+	unsigned int i, lanes;
+	int err = 0;
+
+	if (!irq_fpu_usable()) {
+		for (i = 0; i < n && !err; i++)
+			err = sha256_base_init(desc) ?:
+			      crypto_sha256_finup(desc, data[i], len, out[i]);
+		return err;
+	}
+
+	for (; n; n -= lanes, data += lanes, out += lanes) {
+		lanes = min_t(unsigned int, n, SHA256_MB_MGR_NUM_LANES_AVX2);
+
+		kernel_fpu_begin();
+		state = this_cpu_ptr(sha256_mb_sync_state);
+		sha256_ctx_mgr_init(&state->mgr);
+		for (i = 0; i < lanes; i++) {
+			hash_ctx_init(&state->ctx[i]);
+			sha256_ctx_mgr_submit(&state->mgr, &state->ctx[i],
+					      data[i], len, HASH_ENTIRE);
+		}
+		while (sha256_ctx_mgr_flush(&state->mgr))
+			;
+
+		for (i = 0; i < lanes; i++) {
+			struct sha256_hash_ctx *ctx = &state->ctx[i];
+			__be32 *dst = (__be32 *)out[i];
+			int j;
+
+			if (hash_ctx_error(ctx) || !hash_ctx_complete(ctx)) {
+				err = -EINVAL;
+				continue;
+			}
+			for (j = 0; j < NUM_SHA256_DIGEST_WORDS; j++)
+				dst[j] = cpu_to_be32(hash_ctx_digest(ctx)[j]);
+		}
+		kernel_fpu_end();
+
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+static struct shash_alg sha256_mb_sync_alg = {
+	.init		= sha256_mb_sync_init,
+	.update		= crypto_sha256_update,
+	.final		= sha256_mb_sync_final,
+	.finup		= crypto_sha256_finup,
+	.digest_many	= sha256_mb_sync_digest_many,
+	.descsize	= sizeof(struct sha256_state),
+	.digestsize	= SHA256_DIGEST_SIZE,
+	.base		= {
+		.cra_name		= "sha256",
+		.cra_driver_name	= "sha256_mb_sync",
+		/* Below the single buffer SIMD versions */
+		.cra_priority		= 110,
+		.cra_flags		= CRYPTO_ALG_TYPE_SHASH,
+		.cra_blocksize		= SHA256_BLOCK_SIZE,
+		.cra_module		= THIS_MODULE,
+	},
+};
+
 static unsigned long sha256_mb_flusher(struct mcryptd_alg_cstate *cstate)
 {
 	struct mcryptd_hash_request_ctx *rctx;
@@ -994,8 +1087,18 @@ static int __init sha256_mb_mod_init(void)
 	if (err)
 		goto err1;
 
+	sha256_mb_sync_state = alloc_percpu(struct sha256_mb_sync_state);
+	if (!sha256_mb_sync_state)
+		goto err0;
+	err = crypto_register_shash(&sha256_mb_sync_alg);
+	if (err) {
+		free_percpu(sha256_mb_sync_state);
+		goto err0;
+	}
 
 	return 0;
+err0:
+	crypto_unregister_ahash(&sha256_mb_async_alg);
 err1:
 	crypto_unregister_ahash(&sha256_mb_areq_alg);
 err2:
@@ -1012,6 +1115,8 @@ static void __exit sha256_mb_mod_fini(void)
 	int cpu;
 	struct mcryptd_alg_cstate *cpu_state;
 
+	crypto_unregister_shash(&sha256_mb_sync_alg);
+	free_percpu(sha256_mb_sync_state);
 	crypto_unregister_ahash(&sha256_mb_async_alg);
 	crypto_unregister_ahash(&sha256_mb_areq_alg);
 	for_each_possible_cpu(cpu) {
@@ -0,0 +1,218 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Key slot management for inline encryption hardware.
+ *
+ * A storage controller with an inline encryption engine holds a small
+ * number of keys in hardware slots, and encrypts or decrypts each request
+ * with the key of the slot it is tagged with.  The manager hands out
+ * slots by key, so that every user of the same key shares one slot, and
+ * only reprograms a slot once nobody holds it any more.
+ */
+
+#include <crypto/algapi.h>
+#include <linux/keyslot-manager.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+struct keyslot {
+	unsigned int refs;
+	bool programmed;
+	enum blk_crypto_mode mode;
+	unsigned int key_size;
+	u8 key[BLK_CRYPTO_MAX_KEY_SIZE];
+};
+
+struct keyslot_manager {
+	unsigned int num_slots;
+	const struct keyslot_mgmt_ll_ops *ksm_ll_ops;
+	unsigned int crypto_modes;
+	unsigned int data_unit_size;
+	void *ll_priv_data;
+	/* Serializes slot lookup with the (sleeping) driver hooks */
+	struct mutex lock;
+	struct keyslot slots[];
+};
+
+/**
+ * keyslot_manager_create() - Create a key slot manager for a device
+ * @num_slots:      Number of key slots the hardware has
+ * @ksm_ll_ops:     Driver hooks to program and evict a slot
+ * @crypto_modes:   Bitmask of the supported enum blk_crypto_mode values
+ * @data_unit_size: Size of the units the hardware encrypts, in bytes
+ * @ll_priv_data:   Driver data, see keyslot_manager_private()
+ *
+ * The manager is attached to the request queue of the device by the
+ * driver, and must outlive it.
+ *
+ * Return: The new manager, or NULL on failure.
+ */
+struct keyslot_manager *keyslot_manager_create(unsigned int num_slots,
+			const struct keyslot_mgmt_ll_ops *ksm_ll_ops,
+			unsigned int crypto_modes, unsigned int data_unit_size,
+			void *ll_priv_data)
+{
+	struct keyslot_manager *ksm;
+
+	if (!num_slots || !ksm_ll_ops->keyslot_program ||
+	    !ksm_ll_ops->keyslot_evict)
+		return NULL;
+
+	ksm = kzalloc(sizeof(*ksm) + num_slots * sizeof(ksm->slots[0]),
+		      GFP_KERNEL);
+	if (!ksm)
+		return NULL;
+
+	ksm->num_slots = num_slots;
+	ksm->ksm_ll_ops = ksm_ll_ops;
+	ksm->crypto_modes = crypto_modes;
+	ksm->data_unit_size = data_unit_size;
+	ksm->ll_priv_data = ll_priv_data;
+	mutex_init(&ksm->lock);
+
+	return ksm;
+}
+EXPORT_SYMBOL(keyslot_manager_create);
+
+/**
+ * keyslot_manager_destroy() - Evict all the keys and free the manager
+ * @ksm: The manager, may be NULL
+ */
+void keyslot_manager_destroy(struct keyslot_manager *ksm)
+{
+	unsigned int i;
+
+	if (!ksm)
+		return;
+
+	for (i = 0; i < ksm->num_slots; i++) {
+		WARN_ON(ksm->slots[i].refs);
+		if (ksm->slots[i].programmed)
+			ksm->ksm_ll_ops->keyslot_evict(ksm, i);
+	}
+	kzfree(ksm);
+}
+EXPORT_SYMBOL(keyslot_manager_destroy);
+
+void *keyslot_manager_private(struct keyslot_manager *ksm)
+{
+	return ksm->ll_priv_data;
+}
+EXPORT_SYMBOL(keyslot_manager_private);
+
+bool keyslot_manager_crypto_mode_supported(struct keyslot_manager *ksm,
+			enum blk_crypto_mode mode, unsigned int data_unit_size)
+{
+	return ksm && (ksm->crypto_modes & (1U << mode)) &&
+	       ksm->data_unit_size == data_unit_size;
+}
+EXPORT_SYMBOL(keyslot_manager_crypto_mode_supported);
+
+static int find_keyslot(struct keyslot_manager *ksm, const u8 *key,
+			unsigned int key_size, enum blk_crypto_mode mode)
+{
+	unsigned int i;
+
+	for (i = 0; i < ksm->num_slots; i++) {
+		struct keyslot *slot = &ksm->slots[i];
+
+		if (slot->programmed && slot->mode == mode &&
+		    slot->key_size == key_size &&
+		    !crypto_memneq(slot->key, key, key_size))
+			return i;
+	}
+	return -ENOKEY;
+}
+
+/*
+ * Prefer a slot that was never programmed, so that the keys that are no
+ * longer held stay around for as long as possible.
+ */
+static int find_free_keyslot(struct keyslot_manager *ksm)
+{
+	int i, idle = -EBUSY;
+
+	for (i = 0; i < ksm->num_slots; i++) {
+		if (!ksm->slots[i].programmed)
+			return i;
+		if (!ksm->slots[i].refs && idle < 0)
+			idle = i;
+	}
+	return idle;
+}
+
+/**
+ * keyslot_manager_get_slot_for_key() - Get a slot holding a key
+ * @ksm:      The manager
+ * @key:      The raw key
+ * @key_size: Size of @key
+ * @mode:     The encryption mode the key is for
+ *
+ * Takes a reference on the slot already holding @key, or programs @key
+ * into a slot nobody holds.  May sleep.
+ *
+ * Return: The slot number, or -EBUSY if all the slots are in use.
+ */
+int keyslot_manager_get_slot_for_key(struct keyslot_manager *ksm,
+			const u8 *key, unsigned int key_size,
+			enum blk_crypto_mode mode)
+{
+	struct keyslot *slot;
+	int i, err;
+
+	if (key_size > BLK_CRYPTO_MAX_KEY_SIZE ||
+	    !(ksm->crypto_modes & (1U << mode)))
+		return -EOPNOTSUPP;
+
+	mutex_lock(&ksm->lock);
+	i = find_keyslot(ksm, key, key_size, mode);
+	if (i >= 0)
+		goto out_get;
+
+	i = find_free_keyslot(ksm);
+	if (i < 0)
+		goto out_unlock;
+
+	slot = &ksm->slots[i];
+	if (slot->programmed) {
+		slot->programmed = false;
+		memzero_explicit(slot->key, sizeof(slot->key));
+		ksm->ksm_ll_ops->keyslot_evict(ksm, i);
+	}
+
+	err = ksm->ksm_ll_ops->keyslot_program(ksm, key, key_size, mode, i);
+	if (err) {
+		i = err;
+		goto out_unlock;
+	}
+	slot->programmed = true;
+	slot->mode = mode;
+	slot->key_size = key_size;
+	memcpy(slot->key, key, key_size);
+out_get:
+	ksm->slots[i].refs++;
+out_unlock:
+	mutex_unlock(&ksm->lock);
+	return i;
+}
+EXPORT_SYMBOL(keyslot_manager_get_slot_for_key);
+
+/**
+ * keyslot_manager_put_slot() - Release a slot got for a key
+ * @ksm:  The manager
+ * @slot: The slot number
+ *
+ * The key stays programmed until the slot is needed for another key.
+ */
+void keyslot_manager_put_slot(struct keyslot_manager *ksm, unsigned int slot)
+{
+	if (WARN_ON(slot >= ksm->num_slots))
+		return;
+
+	mutex_lock(&ksm->lock);
+	WARN_ON(!ksm->slots[slot].refs);
+	ksm->slots[slot].refs--;
+	mutex_unlock(&ksm->lock);
+}
+EXPORT_SYMBOL(keyslot_manager_put_slot);
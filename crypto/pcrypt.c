@@ -28,8 +28,24 @@
 #include <linux/notifier.h>
 #include <linux/kobject.h>
 #include <linux/cpu.h>
+#include <linux/moduleparam.h>
 #include <crypto/pcrypt.h>
 
+/*
+ * Requests shorter than this are not worth the trip through padata, and
+ * are handed to the child right away when none of the tfm is in flight.
+ */
+static unsigned int parallel_threshold = 512;
+module_param(parallel_threshold, uint, 0644);
+MODULE_PARM_DESC(parallel_threshold,
+		 "Smallest request (assoc + crypt bytes) run in parallel (default: 512)");
+
+/* AEADs to wrap at load time, so that users pick pcrypt up without setup */
+static char *aeads;
+module_param(aeads, charp, 0444);
+MODULE_PARM_DESC(aeads,
+		 "Comma separated AEADs to instantiate pcrypt for, e.g. rfc4106(gcm(aes))");
+
 struct padata_pcrypt {
 	struct padata_instance *pinst;
 	struct workqueue_struct *wq;
@@ -68,6 +84,8 @@ struct pcrypt_instance_ctx {
 struct pcrypt_aead_ctx {
 	struct crypto_aead *child;
 	unsigned int cb_cpu;
+	/* requests of the tfm not completed yet, keeps them in order */
+	atomic_t inflight;
 };
 
 static int pcrypt_do_parallel(struct padata_priv *padata, unsigned int *cb_cpu,
@@ -119,8 +137,55 @@ static void pcrypt_aead_serial(struct padata_priv *padata)
 {
 	struct pcrypt_request *preq = pcrypt_padata_request(padata);
 	struct aead_request *req = pcrypt_request_ctx(preq);
+	struct aead_request *parent = req->base.data;
+	struct pcrypt_aead_ctx *ctx =
+		crypto_aead_ctx(crypto_aead_reqtfm(parent));
 
-	aead_request_complete(req->base.data, padata->info);
+	atomic_dec(&ctx->inflight);
+	aead_request_complete(parent, padata->info);
+}
+
+static void pcrypt_aead_direct_done(struct crypto_async_request *areq,
+				    int err)
+{
+	struct aead_request *req = areq->data;
+	struct pcrypt_aead_ctx *ctx = crypto_aead_ctx(crypto_aead_reqtfm(req));
+
+	/* A backlogged request was started, it completes later */
+	if (err != -EINPROGRESS)
+		atomic_dec(&ctx->inflight);
+	aead_request_complete(req, err);
+}
+
+/*
+ * Run a short request on the calling CPU.  Only done while nothing else
+ * of the tfm is in flight, so that it can't overtake a parallel request.
+ */
+static bool pcrypt_aead_run_direct(struct aead_request *req, bool enc, int *err)
+{
+	struct pcrypt_request *preq = aead_request_ctx(req);
+	struct aead_request *creq = pcrypt_request_ctx(preq);
+	struct pcrypt_aead_ctx *ctx = crypto_aead_ctx(crypto_aead_reqtfm(req));
+	u32 flags = aead_request_flags(req);
+
+	if (req->assoclen + req->cryptlen >= READ_ONCE(parallel_threshold) ||
+	    atomic_read(&ctx->inflight))
+		return false;
+
+	atomic_inc(&ctx->inflight);
+
+	aead_request_set_tfm(creq, ctx->child);
+	aead_request_set_callback(creq, flags, pcrypt_aead_direct_done, req);
+	aead_request_set_crypt(creq, req->src, req->dst,
+			       req->cryptlen, req->iv);
+	aead_request_set_ad(creq, req->assoclen);
+
+	*err = enc ? crypto_aead_encrypt(creq) : crypto_aead_decrypt(creq);
+	if (*err != -EINPROGRESS &&
+	    !(*err == -EBUSY && (flags & CRYPTO_TFM_REQ_MAY_BACKLOG)))
+		atomic_dec(&ctx->inflight);
+
+	return true;
 }
 
 static void pcrypt_aead_done(struct crypto_async_request *areq, int err)
@@ -158,6 +223,9 @@ static int pcrypt_aead_encrypt(struct aead_request *req)
 	struct pcrypt_aead_ctx *ctx = crypto_aead_ctx(aead);
 	u32 flags = aead_request_flags(req);
 
+	if (pcrypt_aead_run_direct(req, true, &err))
+		return err;
+
 	memset(padata, 0, sizeof(struct padata_priv));
 
 	padata->parallel = pcrypt_aead_enc;
@@ -170,10 +238,12 @@ static int pcrypt_aead_encrypt(struct aead_request *req)
 			       req->cryptlen, req->iv);
 	aead_request_set_ad(creq, req->assoclen);
 
+	atomic_inc(&ctx->inflight);
 	err = pcrypt_do_parallel(padata, &ctx->cb_cpu, &pencrypt);
 	if (!err)
 		return -EINPROGRESS;
 
+	atomic_dec(&ctx->inflight);
 	return err;
 }
 
@@ -200,6 +270,9 @@ static int pcrypt_aead_decrypt(struct aead_request *req)
 	struct pcrypt_aead_ctx *ctx = crypto_aead_ctx(aead);
 	u32 flags = aead_request_flags(req);
 
+	if (pcrypt_aead_run_direct(req, false, &err))
+		return err;
+
 	memset(padata, 0, sizeof(struct padata_priv));
 
 	padata->parallel = pcrypt_aead_dec;
@@ -212,10 +285,12 @@ static int pcrypt_aead_decrypt(struct aead_request *req)
 			       req->cryptlen, req->iv);
 	aead_request_set_ad(creq, req->assoclen);
 
+	atomic_inc(&ctx->inflight);
 	err = pcrypt_do_parallel(padata, &ctx->cb_cpu, &pdecrypt);
 	if (!err)
 		return -EINPROGRESS;
 
+	atomic_dec(&ctx->inflight);
 	return err;
 }
 
@@ -240,6 +315,7 @@ static int pcrypt_aead_init_tfm(struct crypto_aead *tfm)
 		return PTR_ERR(cipher);
 
 	ctx->child = cipher;
+	atomic_set(&ctx->inflight, 0);
 	crypto_aead_set_reqsize(tfm, sizeof(struct pcrypt_request) +
 				     sizeof(struct aead_request) +
 				     crypto_aead_reqsize(cipher));
@@ -473,6 +549,41 @@ static struct crypto_template pcrypt_tmpl = {
 	.module = THIS_MODULE,
 };
 
+static void __init pcrypt_instantiate_aeads(void)
+{
+	char name[CRYPTO_MAX_ALG_NAME];
+	char *list, *p, *alg;
+
+	if (!aeads)
+		return;
+
+	list = kstrdup(aeads, GFP_KERNEL);
+	if (!list)
+		return;
+
+	/* The instance stays registered once the tfm is gone */
+	for (p = list; (alg = strsep(&p, ",")); ) {
+		struct crypto_aead *tfm;
+
+		if (!*alg)
+			continue;
+		if (snprintf(name, sizeof(name), "pcrypt(%s)", alg) >=
+		    sizeof(name)) {
+			pr_warn("pcrypt: %s: name too long\n", alg);
+			continue;
+		}
+		tfm = crypto_alloc_aead(name, 0, 0);
+		if (IS_ERR(tfm)) {
+			pr_warn("pcrypt: can't instantiate %s: %ld\n",
+				name, PTR_ERR(tfm));
+			continue;
+		}
+		crypto_free_aead(tfm);
+	}
+
+	kfree(list);
+}
+
 static int __init pcrypt_init(void)
 {
 	int err = -ENOMEM;
@@ -492,7 +603,12 @@ static int __init pcrypt_init(void)
 	padata_start(pencrypt.pinst);
 	padata_start(pdecrypt.pinst);
 
-	return crypto_register_template(&pcrypt_tmpl);
+	err = crypto_register_template(&pcrypt_tmpl);
+	if (err)
+		return err;
+
+	pcrypt_instantiate_aeads();
+	return 0;
 
 err_deinit_pencrypt:
 	pcrypt_fini_padata(&pencrypt);
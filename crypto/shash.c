@@ -187,6 +187,32 @@ int crypto_shash_digest(struct shash_desc *desc, const u8 *data,
 }
 EXPORT_SYMBOL_GPL(crypto_shash_digest);
 
+int crypto_shash_digest_many(struct shash_desc *desc, const u8 * const *data,
+			     unsigned int len, u8 * const *out, unsigned int n)
+{
+	struct crypto_shash *tfm = desc->tfm;
+	struct shash_alg *shash = crypto_shash_alg(tfm);
+	unsigned long alignmask = crypto_shash_alignmask(tfm);
+	unsigned long ptrs = 0;
+	unsigned int i;
+	int err;
+
+	for (i = 0; i < n; i++)
+		ptrs |= (unsigned long)data[i] | (unsigned long)out[i];
+
+	if (shash->digest_many && !(ptrs & alignmask))
+		return shash->digest_many(desc, data, len, out, n);
+
+	for (i = 0; i < n; i++) {
+		err = crypto_shash_digest(desc, data[i], len, out[i]);
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(crypto_shash_digest_many);
+
 static int shash_default_export(struct shash_desc *desc, void *out)
 {
 	memcpy(out, shash_desc_ctx(desc), crypto_shash_descsize(desc->tfm));
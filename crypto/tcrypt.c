@@ -24,16 +24,22 @@
 
 #define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
 
+#include <crypto/acompress.h>
 #include <crypto/aead.h>
 #include <crypto/hash.h>
 #include <crypto/skcipher.h>
 #include <linux/err.h>
 #include <linux/fips.h>
+#include <linux/delay.h>
 #include <linux/init.h>
 #include <linux/gfp.h>
+#include <linux/kthread.h>
 #include <linux/module.h>
 #include <linux/scatterlist.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
 #include <linux/string.h>
+#include <linux/vmalloc.h>
 #include <linux/moduleparam.h>
 #include <linux/jiffies.h>
 #include <linux/timex.h>
@@ -67,6 +73,8 @@ static char *alg = NULL;
 static u32 type;
 static u32 mask;
 static int mode;
+static unsigned int threads;
+static unsigned int mt_blen = 4096;
 static char *tvmem[TVMEMSIZE];
 
 static char *check[] = {
@@ -992,6 +1000,340 @@ static void test_cipher_speed(const char *algo, int enc, unsigned int secs,
 				   false);
 }
 
+/*
+ * Multi-thread speed tests: each thread runs the operation back to back
+ * on its own tfm, bound to its own CPU, for the test duration.  The runs
+ * use 1, 2, 4, ... up to the threads parameter, and print the aggregate
+ * throughput, its scaling over one thread and the latency percentiles.
+ */
+enum tcrypt_mt_kind {
+	TCRYPT_MT_SKCIPHER,
+	TCRYPT_MT_AHASH,
+	TCRYPT_MT_ACOMP,
+};
+
+/* Latency samples kept per thread, the latest ones (a power of 2) */
+#define TCRYPT_MT_SAMPLES	4096
+
+struct tcrypt_mt_thread {
+	struct task_struct *task;
+	struct completion *go;
+	struct completion done;
+	enum tcrypt_mt_kind kind;
+	const char *algo;
+	unsigned long end;
+	u64 ops;
+	u64 *lat;
+	unsigned int nlat;
+	int err;
+};
+
+static inline int do_one_mt_op(struct tcrypt_result *tr, int ret)
+{
+	if (ret == -EINPROGRESS || ret == -EBUSY) {
+		wait_for_completion(&tr->completion);
+		reinit_completion(&tr->completion);
+		ret = tr->err;
+	}
+
+	return ret;
+}
+
+static int tcrypt_mt_skcipher(struct tcrypt_mt_thread *t, char *src, char *dst)
+{
+	struct crypto_skcipher *tfm;
+	struct skcipher_request *req;
+	struct tcrypt_result tr;
+	struct scatterlist sg_src, sg_dst;
+	u8 key[64] = { 0xff }, iv[64] = { 0xff };
+	u64 start;
+	int ret;
+
+	tfm = crypto_alloc_skcipher(t->algo, 0, 0);
+	if (IS_ERR(tfm))
+		return PTR_ERR(tfm);
+
+	ret = -ENOMEM;
+	req = skcipher_request_alloc(tfm, GFP_KERNEL);
+	if (!req)
+		goto out;
+
+	ret = crypto_skcipher_setkey(tfm, key,
+			min_t(unsigned int, crypto_skcipher_default_keysize(tfm),
+			      sizeof(key)));
+	if (ret)
+		goto out_free_req;
+
+	init_completion(&tr.completion);
+	skcipher_request_set_callback(req, CRYPTO_TFM_REQ_MAY_BACKLOG,
+				      tcrypt_complete, &tr);
+	sg_init_one(&sg_src, src, mt_blen);
+	sg_init_one(&sg_dst, dst, mt_blen);
+	skcipher_request_set_crypt(req, &sg_src, &sg_dst, mt_blen, iv);
+
+	wait_for_completion(t->go);
+	while (time_before(jiffies, t->end)) {
+		start = ktime_get_ns();
+		ret = do_one_mt_op(&tr, crypto_skcipher_encrypt(req));
+		if (ret)
+			break;
+		t->lat[t->ops++ & (TCRYPT_MT_SAMPLES - 1)] = ktime_get_ns() - start;
+		cond_resched();
+	}
+
+out_free_req:
+	skcipher_request_free(req);
+out:
+	crypto_free_skcipher(tfm);
+	return ret;
+}
+
+static int tcrypt_mt_ahash(struct tcrypt_mt_thread *t, char *src, char *dst)
+{
+	struct crypto_ahash *tfm;
+	struct ahash_request *req;
+	struct tcrypt_result tr;
+	struct scatterlist sg;
+	u64 start;
+	int ret;
+
+	tfm = crypto_alloc_ahash(t->algo, 0, 0);
+	if (IS_ERR(tfm))
+		return PTR_ERR(tfm);
+
+	ret = -EINVAL;
+	if (crypto_ahash_digestsize(tfm) > MAX_DIGEST_SIZE)
+		goto out;
+
+	ret = -ENOMEM;
+	req = ahash_request_alloc(tfm, GFP_KERNEL);
+	if (!req)
+		goto out;
+
+	init_completion(&tr.completion);
+	ahash_request_set_callback(req, CRYPTO_TFM_REQ_MAY_BACKLOG,
+				   tcrypt_complete, &tr);
+	sg_init_one(&sg, src, mt_blen);
+	ahash_request_set_crypt(req, &sg, dst, mt_blen);
+
+	ret = 0;
+	wait_for_completion(t->go);
+	while (time_before(jiffies, t->end)) {
+		start = ktime_get_ns();
+		ret = do_one_mt_op(&tr, crypto_ahash_digest(req));
+		if (ret)
+			break;
+		t->lat[t->ops++ & (TCRYPT_MT_SAMPLES - 1)] = ktime_get_ns() - start;
+		cond_resched();
+	}
+
+	ahash_request_free(req);
+out:
+	crypto_free_ahash(tfm);
+	return ret;
+}
+
+static int tcrypt_mt_acomp(struct tcrypt_mt_thread *t, char *src, char *dst)
+{
+	struct crypto_acomp *tfm;
+	struct acomp_req *req;
+	struct tcrypt_result tr;
+	struct scatterlist sg_src, sg_dst;
+	unsigned int i;
+	u64 start;
+	int ret;
+
+	tfm = crypto_alloc_acomp(t->algo, 0, 0);
+	if (IS_ERR(tfm))
+		return PTR_ERR(tfm);
+
+	ret = -ENOMEM;
+	req = acomp_request_alloc(tfm);
+	if (!req)
+		goto out;
+
+	/* Somewhat compressible data */
+	for (i = 0; i < mt_blen; i++)
+		src[i] = (i / 8) & 0x1f;
+
+	init_completion(&tr.completion);
+	acomp_request_set_callback(req, CRYPTO_TFM_REQ_MAY_BACKLOG,
+				   tcrypt_complete, &tr);
+	sg_init_one(&sg_src, src, mt_blen);
+	sg_init_one(&sg_dst, dst, 2 * mt_blen);
+
+	ret = 0;
+	wait_for_completion(t->go);
+	while (time_before(jiffies, t->end)) {
+		acomp_request_set_params(req, &sg_src, &sg_dst, mt_blen,
+					 2 * mt_blen);
+		start = ktime_get_ns();
+		ret = do_one_mt_op(&tr, crypto_acomp_compress(req));
+		if (ret)
+			break;
+		t->lat[t->ops++ & (TCRYPT_MT_SAMPLES - 1)] = ktime_get_ns() - start;
+		cond_resched();
+	}
+
+	acomp_request_free(req);
+out:
+	crypto_free_acomp(tfm);
+	return ret;
+}
+
+static int tcrypt_mt_thread_fn(void *data)
+{
+	struct tcrypt_mt_thread *t = data;
+	char *src, *dst;
+
+	src = kzalloc(mt_blen, GFP_KERNEL);
+	/* Room for the digest, or for data that doesn't compress */
+	dst = kzalloc(max_t(unsigned int, 2 * mt_blen, MAX_DIGEST_SIZE),
+		      GFP_KERNEL);
+	if (!src || !dst) {
+		t->err = -ENOMEM;
+		wait_for_completion(t->go);
+		goto out;
+	}
+
+	switch (t->kind) {
+	case TCRYPT_MT_SKCIPHER:
+		t->err = tcrypt_mt_skcipher(t, src, dst);
+		break;
+	case TCRYPT_MT_AHASH:
+		t->err = tcrypt_mt_ahash(t, src, dst);
+		break;
+	case TCRYPT_MT_ACOMP:
+		t->err = tcrypt_mt_acomp(t, src, dst);
+		break;
+	}
+	t->nlat = min_t(u64, t->ops, TCRYPT_MT_SAMPLES);
+
+out:
+	kfree(dst);
+	kfree(src);
+	complete(&t->done);
+	/* Wait to be reaped, the results are read after the completion */
+	while (!kthread_should_stop())
+		schedule_timeout_interruptible(HZ);
+	return 0;
+}
+
+static int tcrypt_cmp_u64(const void *a, const void *b)
+{
+	u64 x = *(const u64 *)a, y = *(const u64 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Runs @n threads, returns the aggregate operations per second */
+static u64 tcrypt_mt_run(const char *algo, enum tcrypt_mt_kind kind,
+			 unsigned int n, unsigned int secs, u64 base)
+{
+	struct tcrypt_mt_thread *t;
+	DECLARE_COMPLETION_ONSTACK(go);
+	unsigned int i, cpu, nlat = 0;
+	u64 ops = 0, rate = 0, *lat;
+	u32 scale;
+	int err = 0;
+
+	t = kcalloc(n, sizeof(*t), GFP_KERNEL);
+	lat = vmalloc(n * TCRYPT_MT_SAMPLES * sizeof(*lat));
+	if (!t || !lat) {
+		pr_err("mt: out of memory for %u threads\n", n);
+		goto out;
+	}
+
+	cpu = cpumask_first(cpu_online_mask);
+	for (i = 0; i < n; i++) {
+		t[i].go = &go;
+		init_completion(&t[i].done);
+		t[i].kind = kind;
+		t[i].algo = algo;
+		t[i].lat = lat + i * TCRYPT_MT_SAMPLES;
+		t[i].task = kthread_create(tcrypt_mt_thread_fn, &t[i],
+					   "tcrypt/%u", i);
+		if (IS_ERR(t[i].task)) {
+			err = PTR_ERR(t[i].task);
+			t[i].task = NULL;
+			break;
+		}
+		kthread_bind(t[i].task, cpu);
+		cpu = cpumask_next(cpu, cpu_online_mask);
+		if (cpu >= nr_cpu_ids)
+			cpu = cpumask_first(cpu_online_mask);
+		wake_up_process(t[i].task);
+	}
+
+	/* Leave the threads time to set up before the clock starts */
+	for (i = 0; i < n; i++)
+		t[i].end = jiffies + HZ / 10 + secs * HZ;
+	if (!err)
+		msleep(100);
+	complete_all(&go);
+
+	for (i = 0; i < n && t[i].task; i++) {
+		wait_for_completion(&t[i].done);
+		kthread_stop(t[i].task);
+		if (t[i].err && !err)
+			err = t[i].err;
+		ops += t[i].ops;
+		/* Gather the samples at the start of the array */
+		memmove(lat + nlat, t[i].lat, t[i].nlat * sizeof(*lat));
+		nlat += t[i].nlat;
+	}
+
+	if (err) {
+		pr_err("mt: %s with %u threads failed: %d\n", algo, n, err);
+		goto out;
+	}
+	if (!nlat) {
+		pr_err("mt: %s: no operation completed\n", algo);
+		goto out;
+	}
+
+	sort(lat, nlat, sizeof(*lat), tcrypt_cmp_u64, NULL);
+	rate = div_u64(ops, secs);
+	/* Throughput over the one of a single thread, in hundredths */
+	scale = base ? div64_u64(rate * 100, base) : 100;
+	pr_info("%u threads: %llu ops/s, %llu KB/s, p50 %llu ns, p99 %llu ns, scaling x%u.%02u\n",
+		n, rate, div_u64(rate * mt_blen, 1024), lat[nlat / 2],
+		lat[div_u64((u64)nlat * 99, 100)], scale / 100, scale % 100);
+
+out:
+	vfree(lat);
+	kfree(t);
+	return rate;
+}
+
+static void test_mt_speed(const char *algo, enum tcrypt_mt_kind kind,
+			  unsigned int secs)
+{
+	static const char * const kinds[] = {
+		[TCRYPT_MT_SKCIPHER] = "skcipher encryption",
+		[TCRYPT_MT_AHASH] = "ahash digest",
+		[TCRYPT_MT_ACOMP] = "acomp compression",
+	};
+	unsigned int n, max = threads ?: num_online_cpus();
+	u64 base = 0, rate;
+
+	if (!algo) {
+		pr_err("mt: the alg parameter is needed\n");
+		return;
+	}
+
+	pr_info("\ntesting multi-thread speed of %s %s, %u byte blocks, %u s per run\n",
+		algo, kinds[kind], mt_blen, secs ?: 1);
+
+	for (n = 1; ; n = min(2 * n, max)) {
+		rate = tcrypt_mt_run(algo, kind, n, secs ?: 1, base);
+		if (!rate || n == max)
+			break;
+		if (n == 1)
+			base = rate;
+	}
+}
+
 static void test_available(void)
 {
 	char **name = check;
@@ -2035,6 +2377,18 @@ static int do_test(const char *alg, u32 type, u32 mask, int m)
 				   speed_template_8_32);
 		break;
 
+	case 600:
+		test_mt_speed(alg, TCRYPT_MT_SKCIPHER, sec);
+		break;
+
+	case 601:
+		test_mt_speed(alg, TCRYPT_MT_AHASH, sec);
+		break;
+
+	case 602:
+		test_mt_speed(alg, TCRYPT_MT_ACOMP, sec);
+		break;
+
 	case 1000:
 		test_available();
 		break;
@@ -2096,6 +2450,12 @@ module_param(mode, int, 0);
 module_param(sec, uint, 0);
 MODULE_PARM_DESC(sec, "Length in seconds of speed tests "
 		      "(defaults to zero which uses CPU cycles instead)");
+module_param(threads, uint, 0);
+MODULE_PARM_DESC(threads, "Most threads in the multi-thread speed tests "
+			  "(defaults to the number of online CPUs)");
+module_param_named(blen, mt_blen, uint, 0);
+MODULE_PARM_DESC(blen, "Block size of the multi-thread speed tests "
+		       "(defaults to 4096)");
 
 MODULE_LICENSE("GPL");
 MODULE_DESCRIPTION("Quick & dirty crypto testing module");
@@ -54,9 +54,11 @@
 #include <asm/cacheflush.h>
 #include <linux/fdtable.h>
 #include <linux/file.h>
+#include <linux/frame_trace.h>
 #include <linux/freezer.h>
 #include <linux/fs.h>
 #include <linux/list.h>
+#include <linux/llist.h>
 #include <linux/miscdevice.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
@@ -72,6 +74,7 @@
 #include <linux/pid_namespace.h>
 #include <linux/security.h>
 #include <linux/spinlock.h>
+#include <linux/ktime.h>
 
 #ifdef CONFIG_ANDROID_BINDER_IPC_32BIT
 #define BINDER_IPC_32BIT 1
@@ -80,6 +83,7 @@
 #include <uapi/linux/android/binder.h>
 #include "binder_alloc.h"
 #include "binder_trace.h"
+#include <trace/events/frame.h>
 
 static HLIST_HEAD(binder_deferred_list);
 static DEFINE_MUTEX(binder_deferred_lock);
@@ -163,6 +167,32 @@ static int binder_set_stop_on_user_error(const char *val,
 module_param_call(stop_on_user_error, binder_set_stop_on_user_error,
 	param_get_int, &binder_stop_on_user_error, S_IWUSR | S_IRUGO);
 
+/*
+ * When set, one-way transactions to a node that already has an async
+ * transaction in progress are pushed onto a lock-free per-node queue
+ * instead of taking the target's inner_lock. The queue is merged into
+ * node->async_todo when the target thread frees the current async buffer.
+ */
+static bool binder_oneway_fastpath;
+module_param_named(oneway_fastpath, binder_oneway_fastpath, bool,
+		   S_IWUSR | S_IRUGO);
+
+/*
+ * Thread pool scaling: while a BR_SPAWN_LOOPER request is outstanding,
+ * ask for another looper for every spawn_queue_depth transactions queued
+ * on proc->todo, or as soon as the oldest one has waited spawn_wait_us
+ * or was sent by a caller with an RT policy. 0 disables the check.
+ */
+#define BINDER_MAX_REQUESTED_THREADS	4
+
+static unsigned int binder_spawn_queue_depth;
+module_param_named(spawn_queue_depth, binder_spawn_queue_depth, uint,
+		   S_IWUSR | S_IRUGO);
+
+static unsigned int binder_spawn_wait_us;
+module_param_named(spawn_wait_us, binder_spawn_wait_us, uint,
+		   S_IWUSR | S_IRUGO);
+
 #define binder_debug(mask, x...) \
 	do { \
 		if (binder_debug_mask & mask) \
@@ -201,9 +231,11 @@ enum binder_stat_types {
 
 struct binder_stats {
 	atomic_t br[_IOC_NR(BR_FAILED_REPLY) + 1];
-	atomic_t bc[_IOC_NR(BC_REPLY_SG) + 1];
+	atomic_t bc[_IOC_NR(BC_TRANSACTION_BATCH) + 1];
 	atomic_t obj_created[BINDER_STAT_COUNT];
 	atomic_t obj_deleted[BINDER_STAT_COUNT];
+	atomic_t oneway_fastpath;
+	atomic_t oneway_fallback;
 };
 
 static struct binder_stats binder_stats;
@@ -218,6 +250,26 @@ static inline void binder_stats_created(enum binder_stat_types type)
 	atomic_inc(&binder_stats.obj_created[type]);
 }
 
+/*
+ * Transaction latency histogram. Bucket 0 counts samples below 1us,
+ * bucket i counts samples in [2^(i-1), 2^i) us and the last bucket
+ * is open-ended.
+ */
+#define BINDER_LATENCY_BUCKETS	21
+
+struct binder_latency_hist {
+	atomic_t bucket[BINDER_LATENCY_BUCKETS];
+};
+
+static void binder_latency_record(struct binder_latency_hist *hist,
+				  ktime_t delta)
+{
+	u64 us = ktime_to_us(delta);
+	int i = min_t(int, fls64(us), BINDER_LATENCY_BUCKETS - 1);
+
+	atomic_inc(&hist->bucket[i]);
+}
+
 struct binder_transaction_log_entry {
 	int debug_id;
 	int debug_id_done;
@@ -362,6 +414,14 @@ struct binder_error {
  *                        (invariant after initialized)
  * @async_todo:           list of async work items
  *                        (protected by @proc->inner_lock)
+ * @async_llist:          lock-free list of async transactions queued by
+ *                        the one-way fast path; only added to while
+ *                        @has_async_transaction is set
+ *                        (adds under @lock, removed under @lock and
+ *                        @proc->inner_lock)
+ * @deliver_latency:      histogram of time from BC_TRANSACTION to
+ *                        BR_TRANSACTION for transactions to this node
+ *                        (atomics, no lock needed)
  *
  * Bookkeeping structure for binder nodes.
  */
@@ -402,6 +462,8 @@ struct binder_node {
 	};
 	bool has_async_transaction;
 	struct list_head async_todo;
+	struct llist_head async_llist;
+	struct binder_latency_hist deliver_latency;
 };
 
 struct binder_ref_death {
@@ -524,11 +586,14 @@ struct binder_priority {
  * @max_threads:          cap on number of binder threads
  *                        (protected by @inner_lock)
  * @requested_threads:    number of binder threads requested but not
- *                        yet started. In current implementation, can
- *                        only be 0 or 1.
+ *                        yet started. At most 1 unless the spawn_*
+ *                        pool scaling parameters are set.
  *                        (protected by @inner_lock)
  * @requested_threads_started: number binder threads started
  *                        (protected by @inner_lock)
+ * @idle_timeout:         time in ns after which an idle spawned looper
+ *                        is told to exit, 0 to never retire loopers
+ *                        (set by BINDER_SET_IDLE_TIMEOUT, read locklessly)
  * @tmp_ref:              temporary reference to indicate proc is in use
  *                        (protected by @inner_lock)
  * @default_priority:     default scheduler priority
@@ -537,6 +602,12 @@ struct binder_priority {
  * @alloc:                binder allocator bookkeeping
  * @context:              binder_context for this proc
  *                        (invariant after initialized)
+ * @deliver_latency:      histogram of time from BC_TRANSACTION to
+ *                        BR_TRANSACTION for transactions to this proc
+ *                        (atomics, no lock needed)
+ * @reply_latency:        histogram of time from BR_TRANSACTION to
+ *                        BC_REPLY for transactions handled by this proc
+ *                        (atomics, no lock needed)
  * @inner_lock:           can nest under outer_lock and/or node lock
  * @outer_lock:           no nesting under innor or node lock
  *                        Lock order: 1) outer, 2) node, 3) inner
@@ -564,6 +635,7 @@ struct binder_proc {
 	int max_threads;
 	int requested_threads;
 	int requested_threads_started;
+	s64 idle_timeout;
 	int tmp_ref;
 	struct binder_priority default_priority;
 	struct dentry *debugfs_entry;
@@ -571,6 +643,8 @@ struct binder_proc {
 	struct binder_context *context;
 	spinlock_t inner_lock;
 	spinlock_t outer_lock;
+	struct binder_latency_hist deliver_latency;
+	struct binder_latency_hist reply_latency;
 };
 
 enum {
@@ -580,6 +654,7 @@ enum {
 	BINDER_LOOPER_STATE_INVALID     = 0x08,
 	BINDER_LOOPER_STATE_WAITING     = 0x10,
 	BINDER_LOOPER_STATE_POLL        = 0x20,
+	BINDER_LOOPER_STATE_POOL        = 0x40,
 };
 
 /**
@@ -643,6 +718,7 @@ struct binder_transaction {
 	struct binder_proc *to_proc;
 	struct binder_thread *to_thread;
 	struct binder_transaction *to_parent;
+	struct llist_node async_llnode;
 	unsigned need_reply:1;
 	/* unsigned is_dead:1; */	/* not used at the moment */
 
@@ -653,6 +729,9 @@ struct binder_transaction {
 	struct binder_priority	saved_priority;
 	bool    set_priority_called;
 	kuid_t	sender_euid;
+	ktime_t	start_time;
+	ktime_t	deliver_time;
+	u64	frame_id;
 	/**
 	 * @lock:  protects @from, @to_proc, and @to_thread
 	 *
@@ -895,6 +974,32 @@ static struct binder_work *binder_dequeue_work_head(
 	return w;
 }
 
+/**
+ * binder_node_merge_async_nilocked() - Move fast path work to async_todo
+ * @node:         struct binder_node whose async queues to merge
+ *
+ * Moves the transactions queued locklessly on @node->async_llist to the
+ * tail of @node->async_todo, preserving submission order. Must be called
+ * before @node->async_todo is inspected or appended to.
+ */
+static void binder_node_merge_async_nilocked(struct binder_node *node)
+{
+	struct llist_node *list;
+	struct binder_transaction *t, *tmp;
+
+	assert_spin_locked(&node->lock);
+	if (node->proc)
+		assert_spin_locked(&node->proc->inner_lock);
+
+	list = llist_del_all(&node->async_llist);
+	if (!list)
+		return;
+
+	list = llist_reverse_order(list);
+	llist_for_each_entry_safe(t, tmp, list, async_llnode)
+		binder_enqueue_work_ilocked(&t->work, &node->async_todo);
+}
+
 static void
 binder_defer_work(struct binder_proc *proc, enum binder_deferred_state defer);
 static void binder_free_thread(struct binder_thread *thread);
@@ -1309,6 +1414,7 @@ static struct binder_node *binder_init_node_ilocked(
 	spin_lock_init(&node->lock);
 	INIT_LIST_HEAD(&node->work.entry);
 	INIT_LIST_HEAD(&node->async_todo);
+	init_llist_head(&node->async_llist);
 	binder_debug(BINDER_DEBUG_INTERNAL_REFS,
 		     "%d:%d node %d u%016llx c%016llx created\n",
 		     proc->pid, current->pid, node->debug_id,
@@ -2132,6 +2238,7 @@ static size_t binder_validate_object(struct binder_buffer *buffer, u64 offset)
 		object_size = sizeof(struct binder_fd_object);
 		break;
 	case BINDER_TYPE_PTR:
+	case BINDER_TYPE_PAGES:
 		object_size = sizeof(struct binder_buffer_object);
 		break;
 	case BINDER_TYPE_FDA:
@@ -2327,6 +2434,7 @@ static void binder_transaction_buffer_release(struct binder_proc *proc,
 				task_close_fd(proc, fp->fd);
 		} break;
 		case BINDER_TYPE_PTR:
+		case BINDER_TYPE_PAGES:
 			/*
 			 * Nothing to do here, this will get cleaned up when the
 			 * transaction buffer gets freed
@@ -2668,6 +2776,71 @@ static int binder_fixup_parent(struct binder_transaction *t,
 	return 0;
 }
 
+/**
+ * binder_translate_pages() - share sender pages of a BINDER_TYPE_PAGES object
+ * @bp:		object describing the sender memory
+ * @t:		transaction being built
+ * @thread:	sending thread
+ * @sg_bufp:	next free byte of the extra buffers area, advanced on success
+ * @sg_buf_end:	end of the extra buffers area
+ *
+ * Pins the page-aligned sender range and maps it into the target buffer
+ * at the next page boundary of the extra buffers area, without copying.
+ * The pins are dropped when the target frees the buffer.
+ *
+ * Return:	0 on success, negative errno otherwise
+ */
+static int binder_translate_pages(struct binder_buffer_object *bp,
+				  struct binder_transaction *t,
+				  struct binder_thread *thread,
+				  u8 **sg_bufp, u8 *sg_buf_end)
+{
+	struct binder_proc *proc = thread->proc;
+	struct binder_proc *target_proc = t->to_proc;
+	u8 *kaddr = PTR_ALIGN(*sg_bufp, PAGE_SIZE);
+	struct page **pages;
+	int nr_pages, pinned, ret;
+
+	if (!bp->length || !PAGE_ALIGNED(bp->buffer) ||
+	    !PAGE_ALIGNED(bp->length)) {
+		binder_user_error("%d:%d got unaligned page buffer %016llx size %lld\n",
+				  proc->pid, thread->pid, (u64)bp->buffer,
+				  (u64)bp->length);
+		return -EINVAL;
+	}
+	if (kaddr > sg_buf_end || bp->length > sg_buf_end - kaddr) {
+		binder_user_error("%d:%d got transaction with too large page buffer\n",
+				  proc->pid, thread->pid);
+		return -EINVAL;
+	}
+
+	nr_pages = bp->length >> PAGE_SHIFT;
+	pages = kcalloc(nr_pages, sizeof(*pages), GFP_KERNEL);
+	if (!pages)
+		return -ENOMEM;
+
+	pinned = get_user_pages_fast(bp->buffer, nr_pages, 0, pages);
+	if (pinned != nr_pages) {
+		binder_user_error("%d:%d got transaction with invalid page buffer %016llx\n",
+				  proc->pid, thread->pid, (u64)bp->buffer);
+		while (pinned > 0)
+			put_page(pages[--pinned]);
+		kfree(pages);
+		return -EFAULT;
+	}
+
+	ret = binder_alloc_share_pages(&target_proc->alloc, t->buffer, kaddr,
+				       pages, nr_pages);
+	kfree(pages);
+	if (ret)
+		return ret;
+
+	bp->buffer = (uintptr_t)kaddr +
+		binder_alloc_get_user_buffer_offset(&target_proc->alloc);
+	*sg_bufp = kaddr + bp->length;
+	return 0;
+}
+
 /**
  * binder_proc_transaction() - sends a transaction to a process and wakes it up
  * @t:		transaction to send
@@ -2710,6 +2883,25 @@ static bool binder_proc_transaction(struct binder_transaction *t,
 		}
 	}
 
+	if (oneway && binder_oneway_fastpath) {
+		/*
+		 * The target thread is still busy with an earlier async
+		 * transaction on this node and will pick this one up when
+		 * it frees that buffer, so no wakeup and no inner_lock is
+		 * needed. is_dead is re-checked by binder_node_release()
+		 * under node->lock before the queue is drained.
+		 */
+		if (target_list && !READ_ONCE(proc->is_dead)) {
+			llist_add(&t->async_llnode, &node->async_llist);
+			binder_node_unlock(node);
+			atomic_inc(&binder_stats.oneway_fastpath);
+			atomic_inc(&proc->stats.oneway_fastpath);
+			return true;
+		}
+		atomic_inc(&binder_stats.oneway_fallback);
+		atomic_inc(&proc->stats.oneway_fallback);
+	}
+
 	binder_inner_proc_lock(proc);
 
 	if (proc->is_dead || (thread && thread->is_dead)) {
@@ -2718,6 +2910,10 @@ static bool binder_proc_transaction(struct binder_transaction *t,
 		return false;
 	}
 
+	/* keep ordering with work queued while the fast path was enabled */
+	if (oneway)
+		binder_node_merge_async_nilocked(node);
+
 	if (!thread && !target_list)
 		thread = binder_select_thread_ilocked(proc);
 
@@ -2983,6 +3179,7 @@ static void binder_transaction(struct binder_proc *proc,
 	binder_stats_created(BINDER_STAT_TRANSACTION_COMPLETE);
 
 	t->debug_id = t_debug_id;
+	t->start_time = ktime_get();
 
 	if (reply)
 		binder_debug(BINDER_DEBUG_TRANSACTION,
@@ -3023,6 +3220,8 @@ static void binder_transaction(struct binder_proc *proc,
 	}
 
 	trace_binder_transaction(reply, t, target_node);
+	t->frame_id = frame_trace_id();
+	trace_frame_stage(t->frame_id, FRAME_STAGE_BINDER_SEND);
 
 	t->buffer = binder_alloc_new_buf(&target_proc->alloc, tr->data_size,
 		tr->offsets_size, extra_buffers_size,
@@ -3225,6 +3424,32 @@ static void binder_transaction(struct binder_proc *proc,
 			last_fixup_obj = bp;
 			last_fixup_min_off = 0;
 		} break;
+		case BINDER_TYPE_PAGES: {
+			struct binder_buffer_object *bp =
+				to_binder_buffer_object(hdr);
+
+			ret = binder_translate_pages(bp, t, thread, &sg_bufp,
+						     sg_buf_end);
+			if (ret < 0) {
+				return_error = BR_FAILED_REPLY;
+				return_error_param = ret;
+				return_error_line = __LINE__;
+				goto err_translate_failed;
+			}
+
+			ret = binder_fixup_parent(t, thread, bp, off_start,
+						  offp - off_start,
+						  last_fixup_obj,
+						  last_fixup_min_off);
+			if (ret < 0) {
+				return_error = BR_FAILED_REPLY;
+				return_error_param = ret;
+				return_error_line = __LINE__;
+				goto err_translate_failed;
+			}
+			last_fixup_obj = bp;
+			last_fixup_min_off = 0;
+		} break;
 		default:
 			binder_user_error("%d:%d got transaction with invalid object type, %x\n",
 				proc->pid, thread->pid, hdr->type);
@@ -3250,6 +3475,14 @@ static void binder_transaction(struct binder_proc *proc,
 		binder_inner_proc_unlock(target_proc);
 		wake_up_interruptible_sync(&target_thread->wait);
 		binder_restore_priority(current, in_reply_to->saved_priority);
+		if (in_reply_to->deliver_time) {
+			ktime_t now = ktime_get();
+
+			binder_latency_record(&proc->reply_latency,
+				ktime_sub(now, in_reply_to->deliver_time));
+			trace_binder_transaction_latency(in_reply_to, 0, true,
+				in_reply_to->deliver_time, now);
+		}
 		binder_free_transaction(in_reply_to);
 	} else if (!(t->flags & TF_ONE_WAY)) {
 		BUG_ON(t->buffer->async_transaction != 0);
@@ -3358,6 +3591,66 @@ static void binder_transaction(struct binder_proc *proc,
 	}
 }
 
+/**
+ * binder_transaction_batch() - handle BC_TRANSACTION_BATCH
+ * @proc:	sending process
+ * @thread:	sending thread
+ * @batch:	batch header copied from userspace
+ *
+ * Copies the whole transaction array in one go and submits each entry
+ * through binder_transaction(). Because every entry is a one-way call to
+ * the same node, only the first one can wake the target; the rest are
+ * queued on the node's async list behind it.
+ *
+ * Return:	0 on success or if an entry failed (the failure is reported
+ *		through thread->return_error like a single transaction),
+ *		-EFAULT or -ENOMEM if the array could not be read.
+ */
+static int binder_transaction_batch(struct binder_proc *proc,
+				    struct binder_thread *thread,
+				    struct binder_transaction_batch *batch)
+{
+	struct binder_transaction_data *trs;
+	binder_size_t i;
+
+	if (!batch->count)
+		return 0;
+	if (batch->count > BINDER_TRANSACTION_BATCH_MAX) {
+		binder_user_error("%d:%d BC_TRANSACTION_BATCH too large, %lld\n",
+				  proc->pid, thread->pid, (u64)batch->count);
+		return 0;
+	}
+
+	trs = kmalloc_array(batch->count, sizeof(*trs), GFP_KERNEL);
+	if (!trs)
+		return -ENOMEM;
+	if (copy_from_user(trs, (const void __user *)(uintptr_t)
+			   batch->transactions, batch->count * sizeof(*trs))) {
+		kfree(trs);
+		return -EFAULT;
+	}
+
+	for (i = 0; i < batch->count; i++) {
+		if (!(trs[i].flags & TF_ONE_WAY) ||
+		    trs[i].target.handle != trs[0].target.handle) {
+			binder_user_error("%d:%d BC_TRANSACTION_BATCH entry %lld is not one-way to handle %d\n",
+					  proc->pid, thread->pid, (u64)i,
+					  trs[0].target.handle);
+			kfree(trs);
+			return 0;
+		}
+	}
+
+	for (i = 0; i < batch->count; i++) {
+		binder_transaction(proc, thread, &trs[i], 0, 0);
+		if (thread->return_error.cmd != BR_OK)
+			break;
+	}
+
+	kfree(trs);
+	return 0;
+}
+
 static int binder_thread_write(struct binder_proc *proc,
 			struct binder_thread *thread,
 			binder_uintptr_t binder_buffer, size_t size,
@@ -3557,6 +3850,7 @@ static int binder_thread_write(struct binder_proc *proc,
 				binder_node_inner_lock(buf_node);
 				BUG_ON(!buf_node->has_async_transaction);
 				BUG_ON(buf_node->proc != proc);
+				binder_node_merge_async_nilocked(buf_node);
 				w = binder_dequeue_work_head_ilocked(
 						&buf_node->async_todo);
 				if (!w) {
@@ -3596,6 +3890,17 @@ static int binder_thread_write(struct binder_proc *proc,
 					   cmd == BC_REPLY, 0);
 			break;
 		}
+		case BC_TRANSACTION_BATCH: {
+			struct binder_transaction_batch batch;
+
+			if (copy_from_user(&batch, ptr, sizeof(batch)))
+				return -EFAULT;
+			ptr += sizeof(batch);
+			ret = binder_transaction_batch(proc, thread, &batch);
+			if (ret)
+				return ret;
+			break;
+		}
 
 		case BC_REGISTER_LOOPER:
 			binder_debug(BINDER_DEBUG_THREADS,
@@ -3613,6 +3918,7 @@ static int binder_thread_write(struct binder_proc *proc,
 			} else {
 				proc->requested_threads--;
 				proc->requested_threads_started++;
+				thread->looper |= BINDER_LOOPER_STATE_POOL;
 			}
 			thread->looper |= BINDER_LOOPER_STATE_REGISTERED;
 			binder_inner_proc_unlock(proc);
@@ -3867,19 +4173,36 @@ static int binder_wait_for_work(struct binder_thread *thread,
 {
 	DEFINE_WAIT(wait);
 	struct binder_proc *proc = thread->proc;
+	s64 idle_timeout = READ_ONCE(proc->idle_timeout);
+	long timeout = MAX_SCHEDULE_TIMEOUT;
 	int ret = 0;
 
+	/*
+	 * Only loopers spawned on request may be retired; userspace exits
+	 * the thread when BINDER_WRITE_READ fails with -ETIMEDOUT.
+	 */
+	if (do_proc_work && idle_timeout > 0 &&
+	    (thread->looper & BINDER_LOOPER_STATE_POOL))
+		timeout = nsecs_to_jiffies(idle_timeout) ?: 1;
+
 	freezer_do_not_count();
 	binder_inner_proc_lock(proc);
 	for (;;) {
 		prepare_to_wait(&thread->wait, &wait, TASK_INTERRUPTIBLE);
 		if (binder_has_work_ilocked(thread, do_proc_work))
 			break;
+		if (!timeout) {
+			binder_debug(BINDER_DEBUG_THREADS,
+				     "%d:%d idle looper retired\n",
+				     proc->pid, thread->pid);
+			ret = -ETIMEDOUT;
+			break;
+		}
 		if (do_proc_work)
 			list_add(&thread->waiting_thread_node,
 				 &proc->waiting_threads);
 		binder_inner_proc_unlock(proc);
-		schedule();
+		timeout = schedule_timeout(timeout);
 		binder_inner_proc_lock(proc);
 		list_del_init(&thread->waiting_thread_node);
 		if (signal_pending(current)) {
@@ -3894,6 +4217,54 @@ static int binder_wait_for_work(struct binder_thread *thread,
 	return ret;
 }
 
+/**
+ * binder_pool_needs_thread_ilocked() - check if another looper is needed
+ * @proc:	process whose thread pool to check
+ *
+ * Without pool scaling, a looper is requested only when none is waiting
+ * and no request is outstanding. With spawn_queue_depth or spawn_wait_us
+ * set, further requests are made while the proc->todo backlog keeps
+ * growing, its head has waited too long, or an RT caller is queued there.
+ *
+ * Return:	true if userspace should be sent BR_SPAWN_LOOPER
+ */
+static bool binder_pool_needs_thread_ilocked(struct binder_proc *proc)
+{
+	struct binder_work *w;
+	unsigned int queued = 0, limit;
+
+	assert_spin_locked(&proc->inner_lock);
+	if (!list_empty(&proc->waiting_threads) ||
+	    proc->requested_threads + proc->requested_threads_started >=
+	    proc->max_threads)
+		return false;
+	if (proc->requested_threads == 0)
+		return true;
+	if (proc->requested_threads >= BINDER_MAX_REQUESTED_THREADS ||
+	    (!binder_spawn_queue_depth && !binder_spawn_wait_us))
+		return false;
+
+	limit = binder_spawn_queue_depth * (proc->requested_threads + 1);
+	list_for_each_entry(w, &proc->todo, entry) {
+		struct binder_transaction *t;
+
+		if (w->type != BINDER_WORK_TRANSACTION)
+			continue;
+		t = container_of(w, struct binder_transaction, work);
+		if (is_rt_policy(t->priority.sched_policy))
+			return true;
+		if (!queued++ && binder_spawn_wait_us &&
+		    ktime_us_delta(ktime_get(), t->start_time) >=
+		    binder_spawn_wait_us)
+			return true;
+		if (binder_spawn_queue_depth && queued >= limit)
+			return true;
+		if (!binder_spawn_queue_depth)
+			break;
+	}
+	return false;
+}
+
 static int binder_thread_read(struct binder_proc *proc,
 			      struct binder_thread *thread,
 			      binder_uintptr_t binder_buffer, size_t size,
@@ -4193,6 +4564,22 @@ static int binder_thread_read(struct binder_proc *proc,
 		ptr += sizeof(tr);
 
 		trace_binder_transaction_received(t);
+		trace_frame_stage(t->frame_id, FRAME_STAGE_BINDER_RECV);
+		if (cmd == BR_TRANSACTION) {
+			struct binder_node *target_node = t->buffer->target_node;
+			ktime_t delta;
+
+			t->deliver_time = ktime_get();
+			delta = ktime_sub(t->deliver_time, t->start_time);
+			binder_latency_record(&proc->deliver_latency, delta);
+			binder_latency_record(&target_node->deliver_latency,
+					      delta);
+			trace_binder_transaction_latency(t,
+				target_node->debug_id, false, t->start_time,
+				t->deliver_time);
+			/* The thread now works on the frame of the caller */
+			frame_trace_set_id(t->frame_id);
+		}
 		binder_stat_br(proc, thread, cmd);
 		binder_debug(BINDER_DEBUG_TRANSACTION,
 			     "%d:%d %s %d %d:%d, cmd %d size %zd-%zd ptr %016llx-%016llx\n",
@@ -4223,9 +4610,7 @@ static int binder_thread_read(struct binder_proc *proc,
 
 	*consumed = ptr - buffer;
 	binder_inner_proc_lock(proc);
-	if (proc->requested_threads == 0 &&
-	    list_empty(&thread->proc->waiting_threads) &&
-	    proc->requested_threads_started < proc->max_threads &&
+	if (binder_pool_needs_thread_ilocked(proc) &&
 	    (thread->looper & (BINDER_LOOPER_STATE_REGISTERED |
 	     BINDER_LOOPER_STATE_ENTERED)) /* the user-space code fails to */
 	     /*spawn a new thread if we leave this out */) {
@@ -4403,6 +4788,8 @@ static int binder_thread_release(struct binder_proc *proc,
 	 */
 	atomic_inc(&thread->tmp_ref);
 	rb_erase(&thread->rb_node, &proc->threads);
+	if (thread->looper & BINDER_LOOPER_STATE_POOL)
+		proc->requested_threads_started--;
 	t = thread->transaction_stack;
 	if (t) {
 		spin_lock(&t->lock);
@@ -4651,6 +5038,27 @@ static long binder_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 		binder_inner_proc_unlock(proc);
 		break;
 	}
+	case BINDER_SET_IDLE_TIMEOUT: {
+		s64 idle_timeout;
+
+		if (copy_from_user(&idle_timeout, ubuf,
+				   sizeof(idle_timeout))) {
+			ret = -EINVAL;
+			goto err;
+		}
+		WRITE_ONCE(proc->idle_timeout, max_t(s64, idle_timeout, 0));
+		break;
+	}
+	case BINDER_SET_FRAME_ID: {
+		u64 frame_id;
+
+		if (copy_from_user(&frame_id, ubuf, sizeof(frame_id))) {
+			ret = -EINVAL;
+			goto err;
+		}
+		frame_trace_set_id(frame_id);
+		break;
+	}
 	case BINDER_SET_CONTEXT_MGR:
 		ret = binder_ioctl_set_ctx_mgr(filp);
 		if (ret)
@@ -4890,6 +5298,15 @@ static int binder_node_release(struct binder_node *node, int refs)
 	int death = 0;
 	struct binder_proc *proc = node->proc;
 
+	/*
+	 * proc->is_dead is already set, so once node->lock has been
+	 * taken here the one-way fast path can no longer add to
+	 * node->async_llist.
+	 */
+	binder_node_inner_lock(node);
+	binder_node_merge_async_nilocked(node);
+	binder_node_inner_unlock(node);
+
 	binder_release_work(proc, &node->async_todo);
 
 	binder_node_lock(node);
@@ -5237,6 +5654,7 @@ static void print_binder_node_nilocked(struct seq_file *m,
 	}
 	seq_puts(m, "\n");
 	if (node->proc) {
+		binder_node_merge_async_nilocked(node);
 		list_for_each_entry(w, &node->async_todo, entry)
 			print_binder_work_ilocked(m, node->proc, "    ",
 					  "    pending async transaction", w);
@@ -5361,6 +5779,7 @@ static const char * const binder_command_strings[] = {
 	"BC_DEAD_BINDER_DONE",
 	"BC_TRANSACTION_SG",
 	"BC_REPLY_SG",
+	"BC_TRANSACTION_BATCH",
 };
 
 static const char * const binder_objstat_strings[] = {
@@ -5413,6 +5832,12 @@ static void print_binder_stats(struct seq_file *m, const char *prefix,
 				created - deleted,
 				created);
 	}
+
+	if (atomic_read(&stats->oneway_fastpath) ||
+	    atomic_read(&stats->oneway_fallback))
+		seq_printf(m, "%soneway fastpath: taken %d fallback %d\n",
+			   prefix, atomic_read(&stats->oneway_fastpath),
+			   atomic_read(&stats->oneway_fallback));
 }
 
 static void print_binder_proc_stats(struct seq_file *m,
@@ -5548,6 +5973,59 @@ static int binder_transactions_show(struct seq_file *m, void *unused)
 	return 0;
 }
 
+static void print_binder_latency_hist(struct seq_file *m, const char *prefix,
+				      struct binder_latency_hist *hist)
+{
+	int i;
+
+	for (i = 0; i < BINDER_LATENCY_BUCKETS; i++)
+		if (atomic_read(&hist->bucket[i]))
+			break;
+	if (i == BINDER_LATENCY_BUCKETS)
+		return;
+
+	seq_puts(m, prefix);
+	for (i = 0; i < BINDER_LATENCY_BUCKETS - 1; i++)
+		seq_printf(m, " <%luus:%d", 1UL << i,
+			   atomic_read(&hist->bucket[i]));
+	seq_printf(m, " >=%luus:%d\n", 1UL << (BINDER_LATENCY_BUCKETS - 2),
+		   atomic_read(&hist->bucket[BINDER_LATENCY_BUCKETS - 1]));
+}
+
+static void print_binder_proc_latency(struct seq_file *m,
+				      struct binder_proc *proc)
+{
+	struct rb_node *n;
+
+	seq_printf(m, "proc %d\n", proc->pid);
+	print_binder_latency_hist(m, "  deliver:", &proc->deliver_latency);
+	print_binder_latency_hist(m, "  reply:", &proc->reply_latency);
+
+	binder_inner_proc_lock(proc);
+	for (n = rb_first(&proc->nodes); n != NULL; n = rb_next(n)) {
+		struct binder_node *node = rb_entry(n, struct binder_node,
+						    rb_node);
+		char prefix[32];
+
+		snprintf(prefix, sizeof(prefix), "  node %d:", node->debug_id);
+		print_binder_latency_hist(m, prefix, &node->deliver_latency);
+	}
+	binder_inner_proc_unlock(proc);
+}
+
+static int binder_latency_show(struct seq_file *m, void *unused)
+{
+	struct binder_proc *proc;
+
+	seq_puts(m, "binder latency:\n");
+	mutex_lock(&binder_procs_lock);
+	hlist_for_each_entry(proc, &binder_procs, proc_node)
+		print_binder_proc_latency(m, proc);
+	mutex_unlock(&binder_procs_lock);
+
+	return 0;
+}
+
 static int binder_proc_show(struct seq_file *m, void *unused)
 {
 	struct binder_proc *itr;
@@ -5627,6 +6105,7 @@ BINDER_DEBUG_ENTRY(state);
 BINDER_DEBUG_ENTRY(stats);
 BINDER_DEBUG_ENTRY(transactions);
 BINDER_DEBUG_ENTRY(transaction_log);
+BINDER_DEBUG_ENTRY(latency);
 
 static int __init init_binder_device(const char *name)
 {
@@ -5699,6 +6178,11 @@ static int __init binder_init(void)
 				    binder_debugfs_dir_entry_root,
 				    &binder_transaction_log_failed,
 				    &binder_transaction_log_fops);
+		debugfs_create_file("latency",
+				    S_IRUGO,
+				    binder_debugfs_dir_entry_root,
+				    NULL,
+				    &binder_latency_fops);
 	}
 
 	/*
@@ -24,10 +24,12 @@
 #include <linux/rtmutex.h>
 #include <linux/rbtree.h>
 #include <linux/seq_file.h>
+#include <linux/sizes.h>
 #include <linux/vmalloc.h>
 #include <linux/slab.h>
 #include <linux/sched.h>
 #include <linux/list_lru.h>
+#include <linux/pfn_t.h>
 #include "binder_alloc.h"
 #include "binder_trace.h"
 
@@ -70,6 +72,21 @@ static size_t binder_alloc_buffer_size(struct binder_alloc *alloc,
 	return (u8 *)binder_buffer_next(buffer)->data - (u8 *)buffer->data;
 }
 
+/* exclusive upper bound of each free size class */
+static const size_t binder_free_class_limit[BINDER_ALLOC_FREE_CLASSES] = {
+	256, SZ_1K, SZ_4K,
+};
+
+static unsigned int binder_free_class(size_t size)
+{
+	unsigned int i;
+
+	for (i = 0; i < BINDER_ALLOC_FREE_CLASSES; i++)
+		if (size < binder_free_class_limit[i])
+			return i;
+	return BINDER_ALLOC_FREE_TREE;
+}
+
 static void binder_insert_free_buffer(struct binder_alloc *alloc,
 				      struct binder_buffer *new_buffer)
 {
@@ -87,6 +104,13 @@ static void binder_insert_free_buffer(struct binder_alloc *alloc,
 		     "%d: add free buffer, size %zd, at %pK\n",
 		      alloc->pid, new_buffer_size, new_buffer);
 
+	new_buffer->free_class = binder_free_class(new_buffer_size);
+	if (new_buffer->free_class != BINDER_ALLOC_FREE_TREE) {
+		list_add(&new_buffer->free_entry,
+			 &alloc->free_lists[new_buffer->free_class]);
+		return;
+	}
+
 	while (*p) {
 		parent = *p;
 		buffer = rb_entry(parent, struct binder_buffer, rb_node);
@@ -103,6 +127,76 @@ static void binder_insert_free_buffer(struct binder_alloc *alloc,
 	rb_insert_color(&new_buffer->rb_node, &alloc->free_buffers);
 }
 
+/*
+ * The size of a free buffer can change while it is still filed (when the
+ * following buffer is merged away), so removal goes by the class recorded
+ * at insert time rather than by the current size.
+ */
+static void binder_erase_free_buffer(struct binder_alloc *alloc,
+				     struct binder_buffer *buffer)
+{
+	BUG_ON(!buffer->free);
+
+	if (buffer->free_class != BINDER_ALLOC_FREE_TREE)
+		list_del(&buffer->free_entry);
+	else
+		rb_erase(&buffer->rb_node, &alloc->free_buffers);
+}
+
+/**
+ * binder_find_free_buffer() - pick a free buffer for an allocation
+ * @alloc:	binder_alloc for this proc
+ * @size:	required buffer size
+ *
+ * Small requests are served in constant time from the head of the first
+ * non-empty class whose buffers are all at least @size bytes. Otherwise
+ * the best fit is taken from the free_buffers rbtree, and if that fails
+ * the class that @size itself falls into is scanned first-fit.
+ *
+ * Return:	a free buffer of at least @size bytes, or NULL
+ */
+static struct binder_buffer *binder_find_free_buffer(struct binder_alloc *alloc,
+						     size_t size)
+{
+	struct rb_node *n = alloc->free_buffers.rb_node;
+	struct binder_buffer *buffer, *best_fit = NULL;
+	unsigned int class = binder_free_class(size);
+	unsigned int i;
+
+	for (i = class + 1; i < BINDER_ALLOC_FREE_CLASSES; i++) {
+		buffer = list_first_entry_or_null(&alloc->free_lists[i],
+						  struct binder_buffer,
+						  free_entry);
+		if (buffer)
+			return buffer;
+	}
+
+	while (n) {
+		size_t buffer_size;
+
+		buffer = rb_entry(n, struct binder_buffer, rb_node);
+		BUG_ON(!buffer->free);
+		buffer_size = binder_alloc_buffer_size(alloc, buffer);
+
+		if (size < buffer_size) {
+			best_fit = buffer;
+			n = n->rb_left;
+		} else if (size > buffer_size)
+			n = n->rb_right;
+		else
+			return buffer;
+	}
+	if (best_fit || class == BINDER_ALLOC_FREE_TREE)
+		return best_fit;
+
+	list_for_each_entry(buffer, &alloc->free_lists[class], free_entry) {
+		BUG_ON(!buffer->free);
+		if (binder_alloc_buffer_size(alloc, buffer) >= size)
+			return buffer;
+	}
+	return NULL;
+}
+
 static void binder_insert_allocated_buffer_locked(
 		struct binder_alloc *alloc, struct binder_buffer *new_buffer)
 {
@@ -299,6 +393,10 @@ static int binder_update_page_range(struct binder_alloc *alloc, int allocate,
 		index = (page_addr - alloc->buffer) / PAGE_SIZE;
 		page = &alloc->pages[index];
 
+		/* returned to the sender by binder_unshare_pages_locked() */
+		if (!page->page_ptr)
+			continue;
+
 		trace_binder_free_lru_start(alloc, index);
 
 		ret = list_lru_add(&binder_alloc_lru, &page->lru);
@@ -330,10 +428,9 @@ struct binder_buffer *binder_alloc_new_buf_locked(struct binder_alloc *alloc,
 						  size_t extra_buffers_size,
 						  int is_async)
 {
-	struct rb_node *n = alloc->free_buffers.rb_node;
+	struct rb_node *n;
 	struct binder_buffer *buffer;
 	size_t buffer_size;
-	struct rb_node *best_fit = NULL;
 	void *has_page_addr;
 	void *end_page_addr;
 	size_t size, data_offsets_size;
@@ -372,28 +469,15 @@ struct binder_buffer *binder_alloc_new_buf_locked(struct binder_alloc *alloc,
 	/* Pad 0-size buffers so they get assigned unique addresses */
 	size = max(size, sizeof(void *));
 
-	while (n) {
-		buffer = rb_entry(n, struct binder_buffer, rb_node);
-		BUG_ON(!buffer->free);
-		buffer_size = binder_alloc_buffer_size(alloc, buffer);
-
-		if (size < buffer_size) {
-			best_fit = n;
-			n = n->rb_left;
-		} else if (size > buffer_size)
-			n = n->rb_right;
-		else {
-			best_fit = n;
-			break;
-		}
-	}
-	if (best_fit == NULL) {
+	buffer = binder_find_free_buffer(alloc, size);
+	if (buffer == NULL) {
 		size_t allocated_buffers = 0;
 		size_t largest_alloc_size = 0;
 		size_t total_alloc_size = 0;
 		size_t free_buffers = 0;
 		size_t largest_free_size = 0;
 		size_t total_free_size = 0;
+		int i;
 
 		for (n = rb_first(&alloc->allocated_buffers); n != NULL;
 		     n = rb_next(n)) {
@@ -413,6 +497,17 @@ struct binder_buffer *binder_alloc_new_buf_locked(struct binder_alloc *alloc,
 			if (buffer_size > largest_free_size)
 				largest_free_size = buffer_size;
 		}
+		for (i = 0; i < BINDER_ALLOC_FREE_CLASSES; i++) {
+			list_for_each_entry(buffer, &alloc->free_lists[i],
+					    free_entry) {
+				buffer_size = binder_alloc_buffer_size(alloc,
+								       buffer);
+				free_buffers++;
+				total_free_size += buffer_size;
+				if (buffer_size > largest_free_size)
+					largest_free_size = buffer_size;
+			}
+		}
 		pr_err("%d: binder_alloc_buf size %zd failed, no address space\n",
 			alloc->pid, size);
 		pr_err("allocated: %zd (num: %zd largest: %zd), free: %zd (num: %zd largest: %zd)\n",
@@ -420,10 +515,7 @@ struct binder_buffer *binder_alloc_new_buf_locked(struct binder_alloc *alloc,
 		       total_free_size, free_buffers, largest_free_size);
 		return ERR_PTR(-ENOSPC);
 	}
-	if (n == NULL) {
-		buffer = rb_entry(best_fit, struct binder_buffer, rb_node);
-		buffer_size = binder_alloc_buffer_size(alloc, buffer);
-	}
+	buffer_size = binder_alloc_buffer_size(alloc, buffer);
 
 	binder_alloc_debug(BINDER_DEBUG_BUFFER_ALLOC,
 		     "%d: binder_alloc_buf size %zd got buffer %pK size %zd\n",
@@ -431,7 +523,6 @@ struct binder_buffer *binder_alloc_new_buf_locked(struct binder_alloc *alloc,
 
 	has_page_addr =
 		(void *)(((uintptr_t)buffer->data + buffer_size) & PAGE_MASK);
-	WARN_ON(n && buffer_size != size);
 	end_page_addr =
 		(void *)PAGE_ALIGN((uintptr_t)buffer->data + size);
 	if (end_page_addr > has_page_addr)
@@ -456,7 +547,7 @@ struct binder_buffer *binder_alloc_new_buf_locked(struct binder_alloc *alloc,
 		binder_insert_free_buffer(alloc, new_buffer);
 	}
 
-	rb_erase(best_fit, &alloc->free_buffers);
+	binder_erase_free_buffer(alloc, buffer);
 	buffer->free = 0;
 	buffer->free_in_progress = 0;
 	binder_insert_allocated_buffer_locked(alloc, buffer);
@@ -569,6 +660,147 @@ static void binder_delete_free_buffer(struct binder_alloc *alloc,
 	kfree(buffer);
 }
 
+/**
+ * binder_alloc_share_pages() - map sender pages into a buffer
+ * @alloc:	binder_alloc for the receiving proc
+ * @buffer:	allocated buffer that fully contains the range
+ * @kaddr:	page-aligned kernel address inside @buffer
+ * @pages:	pinned sender pages
+ * @nr_pages:	number of entries in @pages
+ *
+ * Replaces the pages backing @nr_pages pages of @buffer at @kaddr with
+ * @pages, both in the kernel mapping and in the receiver's vma. The
+ * private pages allocated for the range are freed. The sender pages are
+ * unpinned again when @buffer is freed.
+ *
+ * Ownership of the page references in @pages always passes to @alloc,
+ * including on failure.
+ *
+ * Return:	0 on success, -ESRCH if the vma is gone, or another negative
+ *		error if a page could not be mapped
+ */
+int binder_alloc_share_pages(struct binder_alloc *alloc,
+			     struct binder_buffer *buffer,
+			     void *kaddr, struct page **pages, int nr_pages)
+{
+	struct mm_struct *mm = NULL;
+	struct vm_area_struct *vma;
+	size_t index;
+	int i, ret = 0;
+
+	mutex_lock(&alloc->mutex);
+	BUG_ON(buffer->free);
+	BUG_ON(!PAGE_ALIGNED(kaddr));
+	BUG_ON((u8 *)kaddr < (u8 *)buffer->data);
+	BUG_ON((u8 *)kaddr + (size_t)nr_pages * PAGE_SIZE >
+	       (u8 *)buffer->data + binder_alloc_buffer_size(alloc, buffer));
+
+	if (alloc->vma && mmget_not_zero(alloc->vma_vm_mm)) {
+		mm = alloc->vma_vm_mm;
+		down_write(&mm->mmap_sem);
+	}
+	vma = alloc->vma;
+	if (!vma) {
+		ret = -ESRCH;
+		goto out;
+	}
+	/* vm_insert_mixed() needs this; vm_insert_page() sets it lazily */
+	vma->vm_flags |= VM_MIXEDMAP;
+
+	buffer->shared_pages = 1;
+	index = (kaddr - alloc->buffer) / PAGE_SIZE;
+	for (i = 0; i < nr_pages; i++, index++) {
+		struct binder_lru_page *page = &alloc->pages[index];
+		unsigned long page_addr = (uintptr_t)alloc->buffer +
+					  index * PAGE_SIZE;
+		unsigned long user_page_addr =
+			page_addr + alloc->user_buffer_offset;
+
+		if (WARN_ON(!page->page_ptr || page->shared ||
+			    !list_empty(&page->lru))) {
+			ret = -EINVAL;
+			goto out;
+		}
+
+		zap_page_range(vma, user_page_addr, PAGE_SIZE);
+		unmap_kernel_range(page_addr, PAGE_SIZE);
+		__free_page(page->page_ptr);
+
+		page->page_ptr = pages[i];
+		page->shared = true;
+		pages[i] = NULL;
+
+		if (map_kernel_range_noflush(page_addr, PAGE_SIZE, PAGE_KERNEL,
+					     &page->page_ptr) != 1) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		flush_cache_vmap(page_addr, page_addr + PAGE_SIZE);
+
+		ret = vm_insert_mixed(vma, user_page_addr,
+				      page_to_pfn_t(page->page_ptr));
+		if (ret) {
+			pr_err("%d: failed to share page at %lx in userspace\n",
+			       alloc->pid, user_page_addr);
+			goto out;
+		}
+	}
+
+out:
+	for (i = 0; i < nr_pages; i++)
+		if (pages[i])
+			put_page(pages[i]);
+	if (mm) {
+		up_write(&mm->mmap_sem);
+		mmput(mm);
+	}
+	mutex_unlock(&alloc->mutex);
+	return ret;
+}
+
+/*
+ * Drop the sender pages borrowed by @buffer. The slots are left empty,
+ * so they are populated with fresh pages when next allocated.
+ */
+static void binder_unshare_pages_locked(struct binder_alloc *alloc,
+					struct binder_buffer *buffer,
+					size_t buffer_size)
+{
+	struct mm_struct *mm = NULL;
+	struct vm_area_struct *vma;
+	void *page_addr, *end;
+
+	if (alloc->vma && mmget_not_zero(alloc->vma_vm_mm)) {
+		mm = alloc->vma_vm_mm;
+		down_write(&mm->mmap_sem);
+	}
+	vma = alloc->vma;
+
+	page_addr = (void *)PAGE_ALIGN((uintptr_t)buffer->data);
+	end = (void *)(((uintptr_t)buffer->data + buffer_size) & PAGE_MASK);
+	for (; page_addr < end; page_addr += PAGE_SIZE) {
+		size_t index = (page_addr - alloc->buffer) / PAGE_SIZE;
+		struct binder_lru_page *page = &alloc->pages[index];
+
+		if (!page->shared)
+			continue;
+
+		if (vma)
+			zap_page_range(vma, (uintptr_t)page_addr +
+				       alloc->user_buffer_offset, PAGE_SIZE);
+		unmap_kernel_range((unsigned long)page_addr, PAGE_SIZE);
+		put_page(page->page_ptr);
+		page->page_ptr = NULL;
+		page->shared = false;
+	}
+	buffer->shared_pages = 0;
+
+	if (mm) {
+		up_write(&mm->mmap_sem);
+		mmput(mm);
+	}
+}
+
 static void binder_free_buf_locked(struct binder_alloc *alloc,
 				   struct binder_buffer *buffer)
 {
@@ -598,6 +830,9 @@ static void binder_free_buf_locked(struct binder_alloc *alloc,
 			      alloc->pid, size, alloc->free_async_space);
 	}
 
+	if (buffer->shared_pages)
+		binder_unshare_pages_locked(alloc, buffer, buffer_size);
+
 	binder_update_page_range(alloc, 0,
 		(void *)PAGE_ALIGN((uintptr_t)buffer->data),
 		(void *)(((uintptr_t)buffer->data + buffer_size) & PAGE_MASK),
@@ -609,7 +844,7 @@ static void binder_free_buf_locked(struct binder_alloc *alloc,
 		struct binder_buffer *next = binder_buffer_next(buffer);
 
 		if (next->free) {
-			rb_erase(&next->rb_node, &alloc->free_buffers);
+			binder_erase_free_buffer(alloc, next);
 			binder_delete_free_buffer(alloc, next);
 		}
 	}
@@ -618,7 +853,7 @@ static void binder_free_buf_locked(struct binder_alloc *alloc,
 
 		if (prev->free) {
 			binder_delete_free_buffer(alloc, buffer);
-			rb_erase(&prev->rb_node, &alloc->free_buffers);
+			binder_erase_free_buffer(alloc, prev);
 			buffer = prev;
 		}
 	}
@@ -1001,9 +1236,13 @@ struct shrinker binder_shrinker = {
  */
 void binder_alloc_init(struct binder_alloc *alloc)
 {
+	int i;
+
 	alloc->pid = current->group_leader->pid;
 	mutex_init(&alloc->mutex);
 	INIT_LIST_HEAD(&alloc->buffers);
+	for (i = 0; i < BINDER_ALLOC_FREE_CLASSES; i++)
+		INIT_LIST_HEAD(&alloc->free_lists[i]);
 }
 
 void binder_alloc_shrinker_init(void)
@@ -26,14 +26,28 @@
 extern struct list_lru binder_alloc_lru;
 struct binder_transaction;
 
+/*
+ * Free buffers smaller than SZ_4K are kept on unsorted per-size-class
+ * lists instead of the free_buffers rbtree. Class 0 holds buffers below
+ * 256 bytes, class 1 below 1K and class 2 below 4K.
+ */
+#define BINDER_ALLOC_FREE_CLASSES	3
+#define BINDER_ALLOC_FREE_TREE		BINDER_ALLOC_FREE_CLASSES
+
 /**
  * struct binder_buffer - buffer used for binder transactions
  * @entry:              entry alloc->buffers
  * @rb_node:            node for allocated_buffers/free_buffers rb trees
+ * @free_entry:         node for alloc->free_lists when buffer is free
+ *                      and smaller than SZ_4K
  * @free:               true if buffer is free
  * @allow_user_free:    describe the second member of struct blah,
  * @async_transaction:  describe the second member of struct blah,
  * @debug_id:           describe the second member of struct blah,
+ * @free_class:         size class the free buffer is filed under, or
+ *                      BINDER_ALLOC_FREE_TREE if it is on free_buffers
+ * @shared_pages:       some pages of the buffer are borrowed from the
+ *                      sender (see binder_alloc_share_pages())
  * @transaction:        describe the second member of struct blah,
  * @target_node:        describe the second member of struct blah,
  * @data_size:          describe the second member of struct blah,
@@ -45,13 +59,18 @@ struct binder_transaction;
  */
 struct binder_buffer {
 	struct list_head entry; /* free and allocated entries by address */
-	struct rb_node rb_node; /* free entry by size or allocated entry */
-				/* by address */
+	union {
+		struct rb_node rb_node; /* free entry by size or allocated */
+					/* entry by address */
+		struct list_head free_entry; /* small free entry by class */
+	};
 	unsigned free:1;
 	unsigned allow_user_free:1;
 	unsigned async_transaction:1;
 	unsigned free_in_progress:1;
 	unsigned debug_id:28;
+	unsigned free_class:2;
+	unsigned shared_pages:1;
 
 	struct binder_transaction *transaction;
 
@@ -67,11 +86,13 @@ struct binder_buffer {
  * @page_ptr: pointer to physical page in mmap'd space
  * @lru:      entry in binder_alloc_lru
  * @alloc:    binder_alloc for a proc
+ * @shared:   @page_ptr is a pinned sender page, never put on the lru
  */
 struct binder_lru_page {
 	struct list_head lru;
 	struct page *page_ptr;
 	struct binder_alloc *alloc;
+	bool shared;
 };
 
 /**
@@ -85,7 +106,9 @@ struct binder_lru_page {
  * @user_buffer_offset: offset between user and kernel VAs for buffer
  * @buffers:            list of all buffers for this proc
  * @free_buffers:       rb tree of buffers available for allocation
- *                      sorted by size
+ *                      sorted by size (SZ_4K and larger)
+ * @free_lists:         lists of free buffers smaller than SZ_4K,
+ *                      one per size class
  * @allocated_buffers:  rb tree of allocated buffers sorted by address
  * @free_async_space:   VA space available for async buffers. This is
  *                      initialized at mmap time to 1/2 the full VA space
@@ -106,6 +129,7 @@ struct binder_alloc {
 	ptrdiff_t user_buffer_offset;
 	struct list_head buffers;
 	struct rb_root free_buffers;
+	struct list_head free_lists[BINDER_ALLOC_FREE_CLASSES];
 	struct rb_root allocated_buffers;
 	size_t free_async_space;
 	struct binder_lru_page *pages;
@@ -135,6 +159,10 @@ binder_alloc_prepare_to_free(struct binder_alloc *alloc,
 			     uintptr_t user_ptr);
 extern void binder_alloc_free_buf(struct binder_alloc *alloc,
 				  struct binder_buffer *buffer);
+extern int binder_alloc_share_pages(struct binder_alloc *alloc,
+				    struct binder_buffer *buffer,
+				    void *kaddr, struct page **pages,
+				    int nr_pages);
 extern int binder_alloc_mmap_handler(struct binder_alloc *alloc,
 				     struct vm_area_struct *vma);
 extern void binder_alloc_deferred_release(struct binder_alloc *alloc);
@@ -145,6 +145,33 @@ TRACE_EVENT(binder_transaction_received,
 	TP_printk("transaction=%d", __entry->debug_id)
 );
 
+TRACE_EVENT(binder_transaction_latency,
+	TP_PROTO(struct binder_transaction *t, int node_debug_id, bool reply,
+		 ktime_t start, ktime_t end),
+	TP_ARGS(t, node_debug_id, reply, start, end),
+
+	TP_STRUCT__entry(
+		__field(int, debug_id)
+		__field(int, target_node)
+		__field(int, to_proc)
+		__field(int, reply)
+		__field(s64, start)
+		__field(s64, end)
+	),
+	TP_fast_assign(
+		__entry->debug_id = t->debug_id;
+		__entry->target_node = node_debug_id;
+		__entry->to_proc = t->to_proc ? t->to_proc->pid : 0;
+		__entry->reply = reply;
+		__entry->start = ktime_to_ns(start);
+		__entry->end = ktime_to_ns(end);
+	),
+	TP_printk("transaction=%d dest_node=%d dest_proc=%d reply=%d start=%lld end=%lld latency_us=%lld",
+		  __entry->debug_id, __entry->target_node, __entry->to_proc,
+		  __entry->reply, __entry->start, __entry->end,
+		  div_s64(__entry->end - __entry->start, NSEC_PER_USEC))
+);
+
 TRACE_EVENT(binder_transaction_node_to_ref,
 	TP_PROTO(struct binder_transaction *t, struct binder_node *node,
 		 struct binder_ref_data *rdata),
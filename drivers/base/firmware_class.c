@@ -26,6 +26,7 @@
 #include <linux/file.h>
 #include <linux/list.h>
 #include <linux/fs.h>
+#include <linux/ktime.h>
 #include <linux/async.h>
 #include <linux/pm.h>
 #include <linux/suspend.h>
@@ -37,6 +38,9 @@
 
 #include "base.h"
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/firmware.h>
+
 MODULE_AUTHOR("Manuel Estrada Sainz");
 MODULE_DESCRIPTION("Multi purpose firmware loading support");
 MODULE_LICENSE("GPL");
@@ -382,6 +386,10 @@ static const char * const fw_path[] = {
 module_param_string(path, fw_path_para, sizeof(fw_path_para), 0644);
 MODULE_PARM_DESC(path, "customized firmware image search path with a higher priority than default path");
 
+static bool keep_cache;
+module_param(keep_cache, bool, 0644);
+MODULE_PARM_DESC(keep_cache, "keep the firmware of devices in memory from their first load on, so that system sleep does not read it again");
+
 static int
 fw_get_filesystem_firmware(struct device *device, struct firmware_buf *buf)
 {
@@ -523,17 +531,10 @@ static int fw_add_devm_name(struct device *dev, const char *name)
 }
 #endif
 
-static int assign_firmware_buf(struct firmware *fw, struct device *device,
-			       unsigned int opt_flags)
+/* called with fw_lock held */
+static void fw_cache_on_request(struct firmware_buf *buf, struct device *device,
+				unsigned int opt_flags)
 {
-	struct firmware_buf *buf = fw->priv;
-
-	mutex_lock(&fw_lock);
-	if (!buf->size || fw_state_is_aborted(&buf->fw_st)) {
-		mutex_unlock(&fw_lock);
-		return -ENOENT;
-	}
-
 	/*
 	 * add firmware name into devres list so that we can auto cache
 	 * and uncache firmware for device.
@@ -548,13 +549,29 @@ static int assign_firmware_buf(struct firmware *fw, struct device *device,
 
 	/*
 	 * After caching firmware image is started, let it piggyback
-	 * on request firmware.
+	 * on request firmware.  With keep_cache, the firmware of a
+	 * device is cached right away.
 	 */
 	if (!(opt_flags & FW_OPT_NOCACHE) &&
-	    buf->fwc->state == FW_LOADER_START_CACHE) {
+	    (buf->fwc->state == FW_LOADER_START_CACHE ||
+	     (keep_cache && device))) {
 		if (fw_cache_piggyback_on_request(buf->fw_id))
 			kref_get(&buf->ref);
 	}
+}
+
+static int assign_firmware_buf(struct firmware *fw, struct device *device,
+			       unsigned int opt_flags)
+{
+	struct firmware_buf *buf = fw->priv;
+
+	mutex_lock(&fw_lock);
+	if (!buf->size || fw_state_is_aborted(&buf->fw_st)) {
+		mutex_unlock(&fw_lock);
+		return -ENOENT;
+	}
+
+	fw_cache_on_request(buf, device, opt_flags);
 
 	/* pass the pages buffer to driver at the last minute */
 	fw_set_page_data(buf, fw);
@@ -1200,6 +1217,8 @@ _request_firmware(const struct firmware **firmware_p, const char *name,
 		  unsigned int opt_flags)
 {
 	struct firmware *fw = NULL;
+	ktime_t start = ktime_get();
+	bool cached = false;
 	int ret;
 
 	if (!firmware_p)
@@ -1211,8 +1230,19 @@ _request_firmware(const struct firmware **firmware_p, const char *name,
 	}
 
 	ret = _request_firmware_prepare(&fw, name, device, buf, size);
-	if (ret <= 0) /* error or already assigned */
+	if (ret <= 0) { /* error or already assigned */
+		/*
+		 * A cached or batched image, e.g. one that was prefetched,
+		 * is still cached for the device across system sleep.
+		 */
+		if (!ret && fw->priv) {
+			mutex_lock(&fw_lock);
+			fw_cache_on_request(fw->priv, device, opt_flags);
+			mutex_unlock(&fw_lock);
+		}
+		cached = !ret;
 		goto out;
+	}
 
 	ret = fw_get_filesystem_firmware(device, fw->priv);
 	if (ret) {
@@ -1235,6 +1265,9 @@ _request_firmware(const struct firmware **firmware_p, const char *name,
 		fw = NULL;
 	}
 
+	trace_firmware_request(device, name ?: "", fw ? fw->size : 0, ret,
+			       cached, ktime_us_delta(ktime_get(), start));
+
 	*firmware_p = fw;
 	return ret;
 }
@@ -1430,39 +1463,6 @@ request_firmware_nowait(
 }
 EXPORT_SYMBOL(request_firmware_nowait);
 
-#ifdef CONFIG_PM_SLEEP
-static ASYNC_DOMAIN_EXCLUSIVE(fw_cache_domain);
-
-/**
- * cache_firmware - cache one firmware image in kernel memory space
- * @fw_name: the firmware image name
- *
- * Cache firmware in kernel memory so that drivers can use it when
- * system isn't ready for them to request firmware image from userspace.
- * Once it returns successfully, driver can use request_firmware or its
- * nowait version to get the cached firmware without any interacting
- * with userspace
- *
- * Return 0 if the firmware image has been cached successfully
- * Return !0 otherwise
- *
- */
-static int cache_firmware(const char *fw_name)
-{
-	int ret;
-	const struct firmware *fw;
-
-	pr_debug("%s: %s\n", __func__, fw_name);
-
-	ret = request_firmware(&fw, fw_name, NULL);
-	if (!ret)
-		kfree(fw);
-
-	pr_debug("%s: %s ret=%d\n", __func__, fw_name, ret);
-
-	return ret;
-}
-
 static struct firmware_buf *fw_lookup_buf(const char *fw_name)
 {
 	struct firmware_buf *tmp;
@@ -1523,6 +1523,146 @@ static struct fw_cache_entry *alloc_fw_cache_entry(const char *name)
 	return fce;
 }
 
+static void free_fw_cache_entry(struct fw_cache_entry *fce)
+{
+	kfree_const(fce->name);
+	kfree(fce);
+}
+
+/*
+ * Firmware prefetch: userspace writes the names of the images the devices
+ * of the system are going to request, typically from a manifest once the
+ * firmware partitions are mounted, and they are read from storage in
+ * parallel.  The drivers then find them in memory.  The images are held
+ * for FW_PREFETCH_HOLD after the last prefetch only, so the ones no driver
+ * asked for are freed again.
+ */
+#define FW_PREFETCH_HOLD	(60 * MSEC_PER_SEC)
+
+static ASYNC_DOMAIN_EXCLUSIVE(fw_prefetch_domain);
+static DEFINE_SPINLOCK(fw_prefetch_lock);
+static LIST_HEAD(fw_prefetch_names);
+static bool fw_prefetch_ready;
+
+static void fw_prefetch_release(struct work_struct *work)
+{
+	struct fw_cache_entry *fce;
+
+	async_synchronize_full_domain(&fw_prefetch_domain);
+
+	spin_lock(&fw_prefetch_lock);
+	while (!list_empty(&fw_prefetch_names)) {
+		fce = list_first_entry(&fw_prefetch_names,
+				       struct fw_cache_entry, list);
+		list_del(&fce->list);
+		spin_unlock(&fw_prefetch_lock);
+
+		uncache_firmware(fce->name);
+		free_fw_cache_entry(fce);
+
+		spin_lock(&fw_prefetch_lock);
+	}
+	spin_unlock(&fw_prefetch_lock);
+}
+
+static DECLARE_DELAYED_WORK(fw_prefetch_work, fw_prefetch_release);
+
+static void __async_fw_prefetch(void *data, async_cookie_t cookie)
+{
+	struct fw_cache_entry *fce = data;
+	const struct firmware *fw;
+
+	/* No usermode helper, a missing image must not stall the others */
+	if (!request_firmware_direct(&fw, fce->name, NULL)) {
+		/* keep the reference on the buf, see cache_firmware() */
+		kfree(fw);
+		return;
+	}
+
+	spin_lock(&fw_prefetch_lock);
+	list_del(&fce->list);
+	spin_unlock(&fw_prefetch_lock);
+
+	free_fw_cache_entry(fce);
+}
+
+static int fw_prefetch_set(const char *val, const struct kernel_param *kp)
+{
+	struct fw_cache_entry *fce;
+	char *names, *p, *name;
+	int ret = 0;
+
+	/* Nothing to read the images from before the filesystems are up */
+	if (!fw_prefetch_ready || system_state != SYSTEM_RUNNING)
+		return -EBUSY;
+
+	p = names = kstrdup(val, GFP_KERNEL);
+	if (!names)
+		return -ENOMEM;
+
+	while ((name = strsep(&p, " ,\t\n"))) {
+		if (!*name)
+			continue;
+
+		fce = alloc_fw_cache_entry(name);
+		if (!fce) {
+			ret = -ENOMEM;
+			break;
+		}
+
+		spin_lock(&fw_prefetch_lock);
+		list_add(&fce->list, &fw_prefetch_names);
+		spin_unlock(&fw_prefetch_lock);
+
+		async_schedule_domain(__async_fw_prefetch, fce,
+				      &fw_prefetch_domain);
+	}
+	kfree(names);
+
+	mod_delayed_work(system_power_efficient_wq, &fw_prefetch_work,
+			 msecs_to_jiffies(FW_PREFETCH_HOLD));
+	return ret;
+}
+
+static const struct kernel_param_ops fw_prefetch_ops = {
+	.set = fw_prefetch_set,
+};
+module_param_cb(prefetch, &fw_prefetch_ops, NULL, 0200);
+MODULE_PARM_DESC(prefetch, "names of firmware images to load in parallel ahead of the requests of their drivers");
+
+#ifdef CONFIG_PM_SLEEP
+static ASYNC_DOMAIN_EXCLUSIVE(fw_cache_domain);
+
+/**
+ * cache_firmware - cache one firmware image in kernel memory space
+ * @fw_name: the firmware image name
+ *
+ * Cache firmware in kernel memory so that drivers can use it when
+ * system isn't ready for them to request firmware image from userspace.
+ * Once it returns successfully, driver can use request_firmware or its
+ * nowait version to get the cached firmware without any interacting
+ * with userspace
+ *
+ * Return 0 if the firmware image has been cached successfully
+ * Return !0 otherwise
+ *
+ */
+static int cache_firmware(const char *fw_name)
+{
+	int ret;
+	const struct firmware *fw;
+
+	pr_debug("%s: %s\n", __func__, fw_name);
+
+	ret = request_firmware(&fw, fw_name, NULL);
+	if (!ret)
+		kfree(fw);
+
+	pr_debug("%s: %s ret=%d\n", __func__, fw_name, ret);
+
+	return ret;
+}
+
 static int __fw_entry_found(const char *name)
 {
 	struct firmware_cache *fwc = &fw_cache;
@@ -1556,12 +1696,6 @@ static int fw_cache_piggyback_on_request(const char *name)
 	return ret;
 }
 
-static void free_fw_cache_entry(struct fw_cache_entry *fce)
-{
-	kfree_const(fce->name);
-	kfree(fce);
-}
-
 static void __async_dev_cache_fw_image(void *fw_entry,
 				       async_cookie_t cookie)
 {
@@ -1750,7 +1884,9 @@ static int fw_pm_notify(struct notifier_block *notify_block,
 		fw_cache.state = FW_LOADER_NO_CACHE;
 		mutex_unlock(&fw_lock);
 
-		device_uncache_fw_images_delay(10 * MSEC_PER_SEC);
+		/* the images are kept for the next system sleep */
+		if (!keep_cache)
+			device_uncache_fw_images_delay(10 * MSEC_PER_SEC);
 		break;
 	}
 
@@ -1813,6 +1949,7 @@ static struct notifier_block fw_shutdown_nb = {
 static int __init firmware_class_init(void)
 {
 	fw_cache_init();
+	fw_prefetch_ready = true;
 	register_reboot_notifier(&fw_shutdown_nb);
 #ifdef CONFIG_FW_LOADER_USER_HELPER
 	return class_register(&firmware_class);
@@ -1823,6 +1960,8 @@ static int __init firmware_class_init(void)
 
 static void __exit firmware_class_exit(void)
 {
+	cancel_delayed_work_sync(&fw_prefetch_work);
+	fw_prefetch_release(NULL);
 #ifdef CONFIG_PM_SLEEP
 	unregister_syscore_ops(&fw_syscore_ops);
 	unregister_pm_notifier(&fw_cache.pm_notify);
@@ -35,6 +35,8 @@
 #include <linux/cpuidle.h>
 #include <linux/timer.h>
 #include <linux/wakeup_reason.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include "../base.h"
 #include "power.h"
@@ -224,17 +226,28 @@ static void initcall_debug_report(struct device *dev, ktime_t calltime,
 	}
 }
 
+static u32 dpm_time_us(ktime_t starttime)
+{
+	return ktime_to_us(ktime_sub(ktime_get(), starttime));
+}
+
+static bool is_async(struct device *dev)
+{
+	return (dev->power.async_suspend || pm_async_all_enabled) &&
+		pm_async_enabled && !pm_trace_is_enabled();
+}
+
 /**
  * dpm_wait - Wait for a PM operation to complete.
  * @dev: Device to wait for.
- * @async: If unset, wait only if the device's power.async_suspend flag is set.
+ * @async: If unset, wait only if @dev is handled asynchronously.
  */
 static void dpm_wait(struct device *dev, bool async)
 {
 	if (!dev)
 		return;
 
-	if (async || (pm_async_enabled && dev->power.async_suspend))
+	if (async || is_async(dev))
 		wait_for_completion(&dev->power.completion);
 }
 
@@ -541,6 +554,7 @@ static int device_resume_noirq(struct device *dev, pm_message_t state, bool asyn
 {
 	pm_callback_t callback = NULL;
 	const char *info = NULL;
+	ktime_t starttime;
 	int error = 0;
 
 	TRACE_DEVICE(dev);
@@ -553,6 +567,7 @@ static int device_resume_noirq(struct device *dev, pm_message_t state, bool asyn
 		goto Out;
 
 	dpm_wait_for_superior(dev, async);
+	starttime = ktime_get();
 
 	if (dev->pm_domain) {
 		info = "noirq power domain ";
@@ -575,6 +590,7 @@ static int device_resume_noirq(struct device *dev, pm_message_t state, bool asyn
 
 	error = dpm_run_callback(callback, dev, state, info);
 	dev->power.is_noirq_suspended = false;
+	dev->power.resume_noirq_us = dpm_time_us(starttime);
 
  Out:
 	complete_all(&dev->power.completion);
@@ -582,12 +598,6 @@ static int device_resume_noirq(struct device *dev, pm_message_t state, bool asyn
 	return error;
 }
 
-static bool is_async(struct device *dev)
-{
-	return dev->power.async_suspend && pm_async_enabled
-		&& !pm_trace_is_enabled();
-}
-
 static void async_resume_noirq(void *data, async_cookie_t cookie)
 {
 	struct device *dev = (struct device *)data;
@@ -681,6 +691,7 @@ static int device_resume_early(struct device *dev, pm_message_t state, bool asyn
 {
 	pm_callback_t callback = NULL;
 	const char *info = NULL;
+	ktime_t starttime;
 	int error = 0;
 
 	TRACE_DEVICE(dev);
@@ -693,6 +704,7 @@ static int device_resume_early(struct device *dev, pm_message_t state, bool asyn
 		goto Out;
 
 	dpm_wait_for_superior(dev, async);
+	starttime = ktime_get();
 
 	if (dev->pm_domain) {
 		info = "early power domain ";
@@ -715,6 +727,7 @@ static int device_resume_early(struct device *dev, pm_message_t state, bool asyn
 
 	error = dpm_run_callback(callback, dev, state, info);
 	dev->power.is_late_suspended = false;
+	dev->power.resume_early_us = dpm_time_us(starttime);
 
  Out:
 	TRACE_RESUME(error);
@@ -809,6 +822,7 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
 {
 	pm_callback_t callback = NULL;
 	const char *info = NULL;
+	ktime_t starttime;
 	int error = 0;
 	DECLARE_DPM_WATCHDOG_ON_STACK(wd);
 
@@ -826,6 +840,7 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
 
 	dpm_wait_for_superior(dev, async);
 	dpm_watchdog_set(&wd, dev);
+	starttime = ktime_get();
 	device_lock(dev);
 
 	/*
@@ -875,6 +890,8 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
  End:
 	error = dpm_run_callback(callback, dev, state, info);
 	dev->power.is_suspended = false;
+	dev->power.resume_us = dpm_time_us(starttime);
+	dev->power.resumed_async = async;
 
  Unlock:
 	device_unlock(dev);
@@ -1668,6 +1685,9 @@ static int device_prepare(struct device *dev, pm_message_t state)
 	device_lock(dev);
 
 	dev->power.wakeup_path = device_may_wakeup(dev);
+	dev->power.resume_noirq_us = 0;
+	dev->power.resume_early_us = 0;
+	dev->power.resume_us = 0;
 
 	if (dev->power.no_pm_callbacks) {
 		ret = 1;	/* Let device go direct_complete */
@@ -1861,3 +1881,57 @@ void device_pm_check_callbacks(struct device *dev)
 		 !dev->driver->suspend && !dev->driver->resume));
 	spin_unlock_irq(&dev->power.lock);
 }
+
+#ifdef CONFIG_DEBUG_FS
+/*
+ * Time each device spent in the resume phases of the last system resume,
+ * in microseconds.  The time of a phase starts once the parent and the
+ * suppliers of the device are done with it.
+ */
+static int dpm_resume_times_show(struct seq_file *m, void *unused)
+{
+	struct device *dev;
+
+	seq_printf(m, "%-32s %-16s %10s %10s %10s %10s %s\n", "device",
+		   "driver", "noirq_us", "early_us", "resume_us", "total_us",
+		   "async");
+
+	mutex_lock(&dpm_list_mtx);
+	list_for_each_entry(dev, &dpm_list, power.entry) {
+		u32 total = dev->power.resume_noirq_us +
+			    dev->power.resume_early_us + dev->power.resume_us;
+
+		if (!total)
+			continue;
+		seq_printf(m, "%-32s %-16s %10u %10u %10u %10u %d\n",
+			   dev_name(dev), dev_driver_string(dev),
+			   dev->power.resume_noirq_us,
+			   dev->power.resume_early_us,
+			   dev->power.resume_us, total,
+			   dev->power.resumed_async);
+	}
+	mutex_unlock(&dpm_list_mtx);
+
+	return 0;
+}
+
+static int dpm_resume_times_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, dpm_resume_times_show, NULL);
+}
+
+static const struct file_operations dpm_resume_times_fops = {
+	.open		= dpm_resume_times_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init dpm_debugfs_init(void)
+{
+	debugfs_create_file("dpm_resume_times", 0444, NULL, NULL,
+			    &dpm_resume_times_fops);
+	return 0;
+}
+late_initcall(dpm_debugfs_init);
+#endif /* CONFIG_DEBUG_FS */
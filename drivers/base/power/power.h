@@ -128,6 +128,7 @@ static inline void dev_pm_disable_wake_irq_check(struct device *dev)
 
 /* kernel/power/main.c */
 extern int pm_async_enabled;
+extern int pm_async_all_enabled;
 
 /* drivers/base/power/main.c */
 extern struct list_head dpm_list;	/* The active device list */
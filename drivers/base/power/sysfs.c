@@ -382,7 +382,7 @@ static ssize_t wakeup_count_show(struct device *dev,
 
 	spin_lock_irq(&dev->power.lock);
 	if (dev->power.wakeup) {
-		count = dev->power.wakeup->event_count;
+		count = wakeup_source_event_count(dev->power.wakeup);
 		enabled = true;
 	}
 	spin_unlock_irq(&dev->power.lock);
@@ -15,6 +15,7 @@
 #include <linux/seq_file.h>
 #include <linux/debugfs.h>
 #include <linux/pm_wakeirq.h>
+#include <linux/kernel_stat.h>
 #include <linux/types.h>
 #include <trace/events/power.h>
 
@@ -128,7 +129,7 @@ static void wakeup_source_record(struct wakeup_source *ws)
 
 	spin_lock_irqsave(&deleted_ws.lock, flags);
 
-	if (ws->event_count) {
+	if (wakeup_source_event_count(ws)) {
 		deleted_ws.total_time =
 			ktime_add(deleted_ws.total_time, ws->total_time);
 		deleted_ws.prevent_sleep_time =
@@ -137,11 +138,12 @@ static void wakeup_source_record(struct wakeup_source *ws)
 		deleted_ws.max_time =
 			ktime_compare(deleted_ws.max_time, ws->max_time) > 0 ?
 				deleted_ws.max_time : ws->max_time;
-		deleted_ws.event_count += ws->event_count;
+		deleted_ws.event_count += wakeup_source_event_count(ws);
 		deleted_ws.active_count += ws->active_count;
 		deleted_ws.relax_count += ws->relax_count;
 		deleted_ws.expire_count += ws->expire_count;
 		deleted_ws.wakeup_count += ws->wakeup_count;
+		deleted_ws.cpu_time += ws->cpu_time;
 	}
 
 	spin_unlock_irqrestore(&deleted_ws.lock, flags);
@@ -514,6 +516,25 @@ static bool wakeup_source_not_registered(struct wakeup_source *ws)
  * function executed when the timer expires, whichever comes first.
  */
 
+/*
+ * Busy time of all the CPUs, in ns.  What the CPUs spend while a wakeup
+ * source is active is the cost of keeping the system awake for it.
+ */
+static u64 wakeup_cpu_busy_time(void)
+{
+	u64 busy = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		u64 *cpustat = kcpustat_cpu(cpu).cpustat;
+
+		busy += cpustat[CPUTIME_USER] + cpustat[CPUTIME_NICE] +
+			cpustat[CPUTIME_SYSTEM] + cpustat[CPUTIME_IRQ] +
+			cpustat[CPUTIME_SOFTIRQ];
+	}
+	return busy;
+}
+
 /**
  * wakup_source_activate - Mark given wakeup source as active.
  * @ws: Wakeup source to handle.
@@ -533,6 +554,7 @@ static void wakeup_source_activate(struct wakeup_source *ws)
 	ws->active = true;
 	ws->active_count++;
 	ws->last_time = ktime_get();
+	ws->cpu_time_start = wakeup_cpu_busy_time();
 	if (ws->autosleep_enabled)
 		ws->start_prevent_time = ws->last_time;
 
@@ -574,6 +596,18 @@ void __pm_stay_awake(struct wakeup_source *ws)
 	if (!ws)
 		return;
 
+	/*
+	 * An event on a source that is already active, with no timeout to
+	 * cancel, only has to be counted.  This keeps sources signaling
+	 * events at a high rate off the lock.  Racing with __pm_relax() is
+	 * fine, the two calls are not ordered against each other anyway.
+	 */
+	if (READ_ONCE(ws->active) && !READ_ONCE(ws->timer_expires) &&
+	    !READ_ONCE(events_check_enabled)) {
+		atomic_long_inc(&ws->nolock_event_count);
+		return;
+	}
+
 	spin_lock_irqsave(&ws->lock, flags);
 
 	wakeup_source_report_event(ws, false);
@@ -657,6 +691,7 @@ static void wakeup_source_deactivate(struct wakeup_source *ws)
 		ws->max_time = duration;
 
 	ws->last_time = now;
+	ws->cpu_time += wakeup_cpu_busy_time() - ws->cpu_time_start;
 	del_timer(&ws->timer);
 	ws->timer_expires = 0;
 
@@ -1051,7 +1086,7 @@ static int print_wakeup_source_stats(struct seq_file *m,
 	}
 
 	seq_printf(m, "%-32s\t%lu\t\t%lu\t\t%lu\t\t%lu\t\t%lld\t\t%lld\t\t%lld\t\t%lld\t\t%lld\n",
-		   ws->name, active_count, ws->event_count,
+		   ws->name, active_count, wakeup_source_event_count(ws),
 		   ws->wakeup_count, ws->expire_count,
 		   ktime_to_ms(active_time), ktime_to_ms(total_time),
 		   ktime_to_ms(max_time), ktime_to_ms(ws->last_time),
@@ -1098,10 +1133,70 @@ static const struct file_operations wakeup_sources_stats_fops = {
 	.release = single_release,
 };
 
+/*
+ * The CPU time used while each wakeup source was active.  Sources that are
+ * active at the same time are all charged for it.
+ */
+static void print_wakeup_source_cost(struct seq_file *m,
+				     struct wakeup_source *ws)
+{
+	unsigned long flags;
+	ktime_t total_time;
+	u64 cpu_time;
+
+	spin_lock_irqsave(&ws->lock, flags);
+
+	total_time = ws->total_time;
+	cpu_time = ws->cpu_time;
+	if (ws->active) {
+		total_time = ktime_add(total_time,
+				       ktime_sub(ktime_get(), ws->last_time));
+		cpu_time += wakeup_cpu_busy_time() - ws->cpu_time_start;
+	}
+
+	seq_printf(m, "%-32s\t%lu\t\t%lld\t\t%llu\n", ws->name,
+		   wakeup_source_event_count(ws), ktime_to_ms(total_time),
+		   div_u64(cpu_time, NSEC_PER_MSEC));
+
+	spin_unlock_irqrestore(&ws->lock, flags);
+}
+
+static int wakeup_sources_cost_show(struct seq_file *m, void *unused)
+{
+	struct wakeup_source *ws;
+	int srcuidx;
+
+	seq_puts(m, "name\t\t\t\t\tevent_count\ttotal_time\tcpu_time\n");
+
+	srcuidx = srcu_read_lock(&wakeup_srcu);
+	list_for_each_entry_rcu(ws, &wakeup_sources, entry)
+		print_wakeup_source_cost(m, ws);
+	srcu_read_unlock(&wakeup_srcu, srcuidx);
+
+	print_wakeup_source_cost(m, &deleted_ws);
+
+	return 0;
+}
+
+static int wakeup_sources_cost_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, wakeup_sources_cost_show, NULL);
+}
+
+static const struct file_operations wakeup_sources_cost_fops = {
+	.owner = THIS_MODULE,
+	.open = wakeup_sources_cost_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static int __init wakeup_sources_debugfs_init(void)
 {
 	wakeup_sources_stats_dentry = debugfs_create_file("wakeup_sources",
 			S_IRUGO, NULL, NULL, &wakeup_sources_stats_fops);
+	debugfs_create_file("wakeup_sources_cost", S_IRUGO, NULL, NULL,
+			    &wakeup_sources_cost_fops);
 	return 0;
 }
 
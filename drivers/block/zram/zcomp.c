@@ -15,6 +15,10 @@
 #include <linux/sched.h>
 #include <linux/cpu.h>
 #include <linux/crypto.h>
+#include <linux/completion.h>
+#include <linux/scatterlist.h>
+#include <linux/sched/mm.h>
+#include <crypto/acompress.h>
 
 #include "zcomp.h"
 
@@ -158,6 +162,140 @@ int zcomp_decompress(struct zcomp_strm *zstrm,
 			dst, &dst_len);
 }
 
+#ifdef CONFIG_ZRAM_ACOMP
+struct zcomp_batch {
+	struct completion done;
+	atomic_t pending;
+};
+
+struct zcomp_batch_ctx {
+	struct acomp_req *req;
+	struct scatterlist src, dst;
+	struct zcomp_batch_req *breq;
+	struct zcomp_batch *batch;
+};
+
+/*
+ * Only worth it over the per-cpu streams for a truly asynchronous
+ * implementation: the acomp wrapper of a synchronous one would just add
+ * copies through its scratch buffers.
+ */
+static void zcomp_acomp_init(struct zcomp *comp)
+{
+	struct crypto_acomp *acomp;
+
+	acomp = crypto_alloc_acomp(comp->name, 0, 0);
+	if (IS_ERR(acomp))
+		return;
+
+	if (crypto_tfm_alg_type(crypto_acomp_tfm(acomp)) !=
+	    CRYPTO_ALG_TYPE_ACOMPRESS) {
+		crypto_free_acomp(acomp);
+		return;
+	}
+	comp->acomp = acomp;
+}
+
+static void zcomp_acomp_destroy(struct zcomp *comp)
+{
+	if (comp->acomp)
+		crypto_free_acomp(comp->acomp);
+}
+
+bool zcomp_can_batch(struct zcomp *comp)
+{
+	return comp->acomp;
+}
+
+static void zcomp_batch_req_done(struct zcomp_batch_ctx *ctx, int err)
+{
+	ctx->breq->err = err;
+	ctx->breq->dst_len = ctx->req->dlen;
+	if (atomic_dec_and_test(&ctx->batch->pending))
+		complete(&ctx->batch->done);
+}
+
+static void zcomp_batch_done(struct crypto_async_request *areq, int err)
+{
+	/* A backlogged request has just been started */
+	if (err == -EINPROGRESS)
+		return;
+
+	zcomp_batch_req_done(areq->data, err);
+}
+
+/*
+ * Compress @nr pages at once, all the requests in flight together, and
+ * wait for them.  The result of each page is in its @reqs entry, as
+ * zcomp_compress() would have returned it.  Sleeps.
+ *
+ * Return: 0, or an error if the batch could not be submitted at all.
+ */
+int zcomp_compress_batch(struct zcomp *comp, struct zcomp_batch_req *reqs,
+		unsigned int nr)
+{
+	struct zcomp_batch_ctx *ctx;
+	struct zcomp_batch batch;
+	unsigned int noio_flags;
+	unsigned int i;
+	int ret = 0;
+
+	noio_flags = memalloc_noio_save();
+	ctx = kcalloc(nr, sizeof(*ctx), GFP_KERNEL);
+	if (!ctx) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < nr; i++) {
+		ctx[i].req = acomp_request_alloc(comp->acomp);
+		if (!ctx[i].req) {
+			ret = -ENOMEM;
+			goto out_free;
+		}
+	}
+
+	init_completion(&batch.done);
+	/* One extra for the submission, so nothing completes early */
+	atomic_set(&batch.pending, nr + 1);
+
+	for (i = 0; i < nr; i++) {
+		struct zcomp_batch_ctx *c = &ctx[i];
+		int err;
+
+		c->breq = &reqs[i];
+		c->batch = &batch;
+		sg_init_table(&c->src, 1);
+		sg_set_page(&c->src, reqs[i].page, PAGE_SIZE, 0);
+		/* See zcomp_compress() about the size of the buffer */
+		sg_init_one(&c->dst, reqs[i].dst, PAGE_SIZE * 2);
+		acomp_request_set_params(c->req, &c->src, &c->dst,
+				PAGE_SIZE, PAGE_SIZE * 2);
+		acomp_request_set_callback(c->req, CRYPTO_TFM_REQ_MAY_BACKLOG,
+				zcomp_batch_done, c);
+
+		err = crypto_acomp_compress(c->req);
+		if (err != -EINPROGRESS && err != -EBUSY)
+			zcomp_batch_req_done(c, err);
+	}
+
+	if (!atomic_dec_and_test(&batch.pending))
+		wait_for_completion(&batch.done);
+
+	i = nr;
+out_free:
+	while (i--)
+		acomp_request_free(ctx[i].req);
+	kfree(ctx);
+out:
+	memalloc_noio_restore(noio_flags);
+	return ret;
+}
+#else
+static inline void zcomp_acomp_init(struct zcomp *comp) {}
+static inline void zcomp_acomp_destroy(struct zcomp *comp) {}
+#endif
+
 int zcomp_cpu_up_prepare(unsigned int cpu, struct hlist_node *node)
 {
 	struct zcomp *comp = hlist_entry(node, struct zcomp, node);
@@ -209,6 +347,7 @@ void zcomp_destroy(struct zcomp *comp)
 {
 	cpuhp_state_remove_instance(CPUHP_ZCOMP_PREPARE, &comp->node);
 	free_percpu(comp->stream);
+	zcomp_acomp_destroy(comp);
 	kfree(comp);
 }
 
@@ -238,5 +377,6 @@ struct zcomp *zcomp_create(const char *compress)
 		kfree(comp);
 		return ERR_PTR(error);
 	}
+	zcomp_acomp_init(comp);
 	return comp;
 }
@@ -21,6 +21,18 @@ struct zcomp {
 	struct zcomp_strm * __percpu *stream;
 	const char *name;
 	struct hlist_node node;
+#ifdef CONFIG_ZRAM_ACOMP
+	/* Asynchronous implementation, for zcomp_compress_batch() */
+	struct crypto_acomp *acomp;
+#endif
+};
+
+/* One page of a zcomp_compress_batch() call */
+struct zcomp_batch_req {
+	struct page *page;
+	void *dst;		/* 2 * PAGE_SIZE bytes */
+	unsigned int dst_len;
+	int err;
 };
 
 int zcomp_cpu_up_prepare(unsigned int cpu, struct hlist_node *node);
@@ -37,6 +49,19 @@ void zcomp_stream_put(struct zcomp *comp);
 int zcomp_compress(struct zcomp_strm *zstrm,
 		const void *src, unsigned int *dst_len);
 
+#ifdef CONFIG_ZRAM_ACOMP
+bool zcomp_can_batch(struct zcomp *comp);
+int zcomp_compress_batch(struct zcomp *comp, struct zcomp_batch_req *reqs,
+		unsigned int nr);
+#else
+static inline bool zcomp_can_batch(struct zcomp *comp) { return false; }
+static inline int zcomp_compress_batch(struct zcomp *comp,
+		struct zcomp_batch_req *reqs, unsigned int nr)
+{
+	return -EOPNOTSUPP;
+}
+#endif
+
 int zcomp_decompress(struct zcomp_strm *zstrm,
 		const void *src, unsigned int src_len, void *dst);
 
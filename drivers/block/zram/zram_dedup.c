@@ -0,0 +1,260 @@
+/*
+ * Copyright (C) 2008, 2009, 2010  Nitin Gupta
+ *               2012, 2013 Minchan Kim
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ *
+ */
+
+/*
+ * Deduplication of identical pages.  Each compressed object is
+ * registered under the checksum of its uncompressed content, and a write
+ * of the same content takes a reference on it instead of compressing and
+ * storing the page again.  The zsmalloc handle is freed with its last
+ * reference.
+ */
+
+#include <linux/jhash.h>
+#include <linux/log2.h>
+#include <linux/rbtree.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+
+#include "zram_drv.h"
+
+/* Pages per hash bucket, roughly */
+#define ZRAM_DEDUP_BUCKET_PAGES	64
+
+struct zram_entry {
+	struct rb_node rb_node;
+	unsigned long handle;
+	unsigned int len;
+	unsigned int refcount;	/* protected by zram_hash->lock */
+	u32 checksum;
+};
+
+struct zram_hash {
+	spinlock_t lock;
+	struct rb_root rb_root;
+};
+
+static struct zram_hash *zram_dedup_hash(struct zram *zram, u32 checksum)
+{
+	return &zram->hash[checksum & (zram->hash_size - 1)];
+}
+
+u32 zram_dedup_checksum(const void *mem)
+{
+	return jhash(mem, PAGE_SIZE, 0);
+}
+
+/* Whether the object of @entry holds the same data as the page @mem */
+static bool zram_dedup_match(struct zram *zram, struct zram_entry *entry,
+			const void *mem)
+{
+	struct zcomp_strm *zstrm;
+	bool match = false;
+	void *cmem;
+
+	cmem = zs_map_object(zram->mem_pool, entry->handle, ZS_MM_RO);
+	if (entry->len == PAGE_SIZE) {
+		match = !memcmp(mem, cmem, PAGE_SIZE);
+	} else {
+		zstrm = zcomp_stream_get(zram->comp);
+		if (!zcomp_decompress(zstrm, cmem, entry->len, zstrm->buffer))
+			match = !memcmp(mem, zstrm->buffer, PAGE_SIZE);
+		zcomp_stream_put(zram->comp);
+	}
+	zs_unmap_object(zram->mem_pool, entry->handle);
+
+	return match;
+}
+
+static struct zram_entry *zram_dedup_lookup(struct zram_hash *hash,
+			u32 checksum)
+{
+	struct rb_node *rb_node = hash->rb_root.rb_node;
+	struct zram_entry *entry;
+
+	while (rb_node) {
+		entry = rb_entry(rb_node, struct zram_entry, rb_node);
+		if (checksum == entry->checksum)
+			return entry;
+		if (checksum < entry->checksum)
+			rb_node = rb_node->rb_left;
+		else
+			rb_node = rb_node->rb_right;
+	}
+
+	return NULL;
+}
+
+/*
+ * Look for a stored object with the content of @mem, and take a
+ * reference on it.  Only the first object with the same checksum is
+ * compared: a collision just misses the deduplication.
+ *
+ * Return: The zsmalloc handle, with its size in @len, or 0.
+ */
+unsigned long zram_dedup_find(struct zram *zram, const void *mem,
+			u32 checksum, unsigned int *len)
+{
+	struct zram_hash *hash = zram_dedup_hash(zram, checksum);
+	struct zram_entry *entry;
+
+	spin_lock(&hash->lock);
+	entry = zram_dedup_lookup(hash, checksum);
+	if (!entry) {
+		spin_unlock(&hash->lock);
+		return 0;
+	}
+	entry->refcount++;
+	spin_unlock(&hash->lock);
+	/* Every reference but the first saves a copy */
+	atomic64_add(entry->len, &zram->stats.dup_data_size);
+
+	if (!zram_dedup_match(zram, entry, mem)) {
+		zram_dedup_put(zram, entry->handle, checksum);
+		return 0;
+	}
+
+	*len = entry->len;
+	return entry->handle;
+}
+
+/*
+ * Register a newly stored object, with the reference of the slot
+ * storing it.  May fail, the slot then owns the handle alone.
+ */
+int zram_dedup_insert(struct zram *zram, unsigned long handle,
+			unsigned int len, u32 checksum)
+{
+	struct zram_hash *hash = zram_dedup_hash(zram, checksum);
+	struct zram_entry *entry, *cur;
+	struct rb_node **rb_node, *parent = NULL;
+
+	entry = kmalloc(sizeof(*entry), GFP_NOIO | __GFP_NOWARN);
+	if (!entry)
+		return -ENOMEM;
+
+	entry->handle = handle;
+	entry->len = len;
+	entry->refcount = 1;
+	entry->checksum = checksum;
+
+	spin_lock(&hash->lock);
+	rb_node = &hash->rb_root.rb_node;
+	while (*rb_node) {
+		parent = *rb_node;
+		cur = rb_entry(parent, struct zram_entry, rb_node);
+		if (checksum < cur->checksum)
+			rb_node = &parent->rb_left;
+		else
+			rb_node = &parent->rb_right;
+	}
+	rb_link_node(&entry->rb_node, parent, rb_node);
+	rb_insert_color(&entry->rb_node, &hash->rb_root);
+	spin_unlock(&hash->lock);
+
+	atomic64_add(sizeof(*entry), &zram->stats.meta_data_size);
+	return 0;
+}
+
+/*
+ * Drop a reference on a registered object, freeing it with the last one.
+ *
+ * Return: true if the handle was freed.
+ */
+bool zram_dedup_put(struct zram *zram, unsigned long handle, u32 checksum)
+{
+	struct zram_hash *hash = zram_dedup_hash(zram, checksum);
+	struct zram_entry *entry = NULL, *cur;
+	struct rb_node *rb_node;
+
+	spin_lock(&hash->lock);
+	cur = zram_dedup_lookup(hash, checksum);
+	rb_node = cur ? &cur->rb_node : NULL;
+	/* Objects with the same checksum are adjacent in the tree */
+	if (rb_node) {
+		struct rb_node *prev;
+
+		while ((prev = rb_prev(rb_node)) &&
+		       rb_entry(prev, struct zram_entry, rb_node)->checksum ==
+		       checksum)
+			rb_node = prev;
+
+		for (; rb_node; rb_node = rb_next(rb_node)) {
+			cur = rb_entry(rb_node, struct zram_entry, rb_node);
+			if (cur->checksum != checksum)
+				break;
+			if (cur->handle == handle) {
+				entry = cur;
+				break;
+			}
+		}
+	}
+
+	if (WARN_ON_ONCE(!entry)) {
+		spin_unlock(&hash->lock);
+		return false;
+	}
+
+	if (--entry->refcount) {
+		spin_unlock(&hash->lock);
+		atomic64_sub(entry->len, &zram->stats.dup_data_size);
+		return false;
+	}
+
+	rb_erase(&entry->rb_node, &hash->rb_root);
+	spin_unlock(&hash->lock);
+
+	zs_free(zram->mem_pool, handle);
+	kfree(entry);
+	atomic64_sub(sizeof(*entry), &zram->stats.meta_data_size);
+	return true;
+}
+
+int zram_dedup_init(struct zram *zram, size_t num_pages)
+{
+	size_t i;
+
+	if (!zram->use_dedup)
+		return 0;
+
+	zram->hash_size = roundup_pow_of_two(
+			max_t(size_t, num_pages / ZRAM_DEDUP_BUCKET_PAGES, 1));
+	zram->hash = vzalloc(zram->hash_size * sizeof(struct zram_hash));
+	if (!zram->hash)
+		return -ENOMEM;
+
+	for (i = 0; i < zram->hash_size; i++) {
+		spin_lock_init(&zram->hash[i].lock);
+		zram->hash[i].rb_root = RB_ROOT;
+	}
+
+	atomic64_add(zram->hash_size * sizeof(struct zram_hash),
+			&zram->stats.meta_data_size);
+	return 0;
+}
+
+/* Called once all the pages are freed */
+void zram_dedup_fini(struct zram *zram)
+{
+	size_t i;
+
+	if (!zram->hash)
+		return;
+
+	for (i = 0; i < zram->hash_size; i++)
+		WARN_ON_ONCE(!RB_EMPTY_ROOT(&zram->hash[i].rb_root));
+
+	vfree(zram->hash);
+	zram->hash = NULL;
+	zram->hash_size = 0;
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2008, 2009, 2010  Nitin Gupta
+ *               2012, 2013 Minchan Kim
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ *
+ */
+
+#ifndef _ZRAM_DEDUP_H_
+#define _ZRAM_DEDUP_H_
+
+#include <linux/errno.h>
+#include <linux/types.h>
+
+struct zram;
+
+#ifdef CONFIG_ZRAM_DEDUP
+u32 zram_dedup_checksum(const void *mem);
+unsigned long zram_dedup_find(struct zram *zram, const void *mem,
+			u32 checksum, unsigned int *len);
+int zram_dedup_insert(struct zram *zram, unsigned long handle,
+			unsigned int len, u32 checksum);
+bool zram_dedup_put(struct zram *zram, unsigned long handle, u32 checksum);
+
+int zram_dedup_init(struct zram *zram, size_t num_pages);
+void zram_dedup_fini(struct zram *zram);
+#else
+static inline u32 zram_dedup_checksum(const void *mem) { return 0; }
+static inline unsigned long zram_dedup_find(struct zram *zram,
+			const void *mem, u32 checksum, unsigned int *len)
+{
+	return 0;
+}
+static inline int zram_dedup_insert(struct zram *zram, unsigned long handle,
+			unsigned int len, u32 checksum)
+{
+	return -EINVAL;
+}
+static inline bool zram_dedup_put(struct zram *zram, unsigned long handle,
+			u32 checksum)
+{
+	return true;
+}
+
+static inline int zram_dedup_init(struct zram *zram, size_t num_pages)
+{
+	return 0;
+}
+static inline void zram_dedup_fini(struct zram *zram) {}
+#endif
+
+#endif /* _ZRAM_DEDUP_H_ */
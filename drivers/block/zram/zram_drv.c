@@ -32,6 +32,7 @@
 #include <linux/idr.h>
 #include <linux/sysfs.h>
 #include <linux/cpuhotplug.h>
+#include <linux/workqueue.h>
 
 #include "zram_drv.h"
 
@@ -40,6 +41,8 @@ static DEFINE_IDR(zram_index_idr);
 static DEFINE_MUTEX(zram_index_mutex);
 
 static int zram_major;
+/* Compression workers for async writes, see zram_write_async() */
+static struct workqueue_struct *zram_write_wq;
 static const char *default_compressor = "lzo";
 
 /* Module params (documentation at end) */
@@ -110,6 +113,27 @@ static void zram_set_obj_size(struct zram *zram,
 	zram->table[index].value = (flags << ZRAM_FLAG_SHIFT) | size;
 }
 
+#ifdef CONFIG_ZRAM_DEDUP
+static inline bool zram_dedup_enabled(struct zram *zram)
+{
+	return zram->use_dedup;
+}
+
+static u32 zram_get_checksum(struct zram *zram, u32 index)
+{
+	return zram->table[index].checksum;
+}
+
+static void zram_set_checksum(struct zram *zram, u32 index, u32 checksum)
+{
+	zram->table[index].checksum = checksum;
+}
+#else
+static inline bool zram_dedup_enabled(struct zram *zram) { return false; }
+static u32 zram_get_checksum(struct zram *zram, u32 index) { return 0; }
+static void zram_set_checksum(struct zram *zram, u32 index, u32 checksum) {}
+#endif
+
 #if PAGE_SIZE != 4096
 static inline bool is_partial_io(struct bio_vec *bvec)
 {
@@ -570,6 +594,8 @@ static int write_to_bdev(struct zram *zram, struct bio_vec *bvec,
 
 	submit_bio(bio);
 	*pentry = entry;
+	atomic64_inc(&zram->stats.bd_count);
+	atomic64_inc(&zram->stats.bd_writes);
 
 	return 0;
 }
@@ -582,6 +608,7 @@ static void zram_wb_clear(struct zram *zram, u32 index)
 	entry = zram_get_element(zram, index);
 	zram_set_element(zram, index, 0);
 	put_entry_bdev(zram, entry);
+	atomic64_dec(&zram->stats.bd_count);
 }
 
 #else
@@ -625,6 +652,67 @@ static ssize_t max_comp_streams_store(struct device *dev,
 	return len;
 }
 
+static ssize_t async_write_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", READ_ONCE(zram->async_write));
+}
+
+static ssize_t async_write_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	bool val;
+	int ret;
+
+	ret = kstrtobool(buf, &val);
+	if (ret)
+		return ret;
+
+	WRITE_ONCE(zram->async_write, val);
+	return len;
+}
+
+#ifdef CONFIG_ZRAM_DEDUP
+static ssize_t use_dedup_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	bool val;
+
+	down_read(&zram->init_lock);
+	val = zram->use_dedup;
+	up_read(&zram->init_lock);
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", (int)val);
+}
+
+static ssize_t use_dedup_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	bool val;
+	int ret;
+
+	ret = kstrtobool(buf, &val);
+	if (ret)
+		return ret;
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		up_write(&zram->init_lock);
+		pr_info("Can't change dedup usage for initialized device\n");
+		return -EBUSY;
+	}
+	zram->use_dedup = val;
+	up_write(&zram->init_lock);
+
+	return len;
+}
+#endif
+
 static ssize_t comp_algorithm_show(struct device *dev,
 		struct device_attribute *attr, char *buf)
 {
@@ -722,14 +810,22 @@ static ssize_t mm_stat_show(struct device *dev,
 	max_used = atomic_long_read(&zram->stats.max_used_pages);
 
 	ret = scnprintf(buf, PAGE_SIZE,
-			"%8llu %8llu %8llu %8lu %8ld %8llu %8lu\n",
+			"%8llu %8llu %8llu %8lu %8ld %8llu %8lu %8llu"
+			" %8llu %8llu %8llu %8llu %8llu %8llu\n",
 			orig_size << PAGE_SHIFT,
 			(u64)atomic64_read(&zram->stats.compr_data_size),
 			mem_used << PAGE_SHIFT,
 			zram->limit_pages << PAGE_SHIFT,
 			max_used << PAGE_SHIFT,
 			(u64)atomic64_read(&zram->stats.same_pages),
-			pool_stats.pages_compacted);
+			pool_stats.pages_compacted,
+			(u64)atomic64_read(&zram->stats.recomp_pages),
+			(u64)atomic64_read(&zram->stats.huge_pages),
+			(u64)atomic64_read(&zram->stats.bd_count),
+			(u64)atomic64_read(&zram->stats.bd_reads),
+			(u64)atomic64_read(&zram->stats.bd_writes),
+			(u64)atomic64_read(&zram->stats.dup_data_size),
+			(u64)atomic64_read(&zram->stats.meta_data_size));
 	up_read(&zram->init_lock);
 
 	return ret;
@@ -805,6 +901,14 @@ static bool zram_meta_alloc(struct zram *zram, u64 disksize)
 static void zram_free_page(struct zram *zram, size_t index)
 {
 	unsigned long handle;
+	bool freed = true;
+
+	zram_clear_flag(zram, index, ZRAM_IDLE);
+	zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+	if (zram_test_flag(zram, index, ZRAM_HUGE)) {
+		zram_clear_flag(zram, index, ZRAM_HUGE);
+		atomic64_dec(&zram->stats.huge_pages);
+	}
 
 	if (zram_wb_enabled(zram) && zram_test_flag(zram, index, ZRAM_WB)) {
 		zram_wb_clear(zram, index);
@@ -828,16 +932,299 @@ static void zram_free_page(struct zram *zram, size_t index)
 	if (!handle)
 		return;
 
-	zs_free(zram->mem_pool, handle);
+	/* A shared object is only freed with its last slot */
+	if (zram_test_flag(zram, index, ZRAM_DEDUP)) {
+		zram_clear_flag(zram, index, ZRAM_DEDUP);
+		freed = zram_dedup_put(zram, handle,
+				zram_get_checksum(zram, index));
+	} else {
+		zs_free(zram->mem_pool, handle);
+	}
 
-	atomic64_sub(zram_get_obj_size(zram, index),
-			&zram->stats.compr_data_size);
+	if (freed)
+		atomic64_sub(zram_get_obj_size(zram, index),
+				&zram->stats.compr_data_size);
 	atomic64_dec(&zram->stats.pages_stored);
 
+	zram_clear_flag(zram, index, ZRAM_RECOMP);
 	zram_set_handle(zram, index, 0);
 	zram_set_obj_size(zram, index, 0);
 }
 
+#ifdef CONFIG_ZRAM_RECOMPRESS
+static void zram_touch_slot(struct zram *zram, u32 index)
+{
+	zram->table[index].ac_time = (u32)ktime_get_seconds();
+}
+
+/* Slot table entry bit_spin_lock() must be held */
+static struct zcomp *zram_slot_comp(struct zram *zram, u32 index)
+{
+	if (zram_test_flag(zram, index, ZRAM_RECOMP))
+		return zram->recomp;
+	return zram->comp;
+}
+
+static bool zram_recomp_candidate(struct zram *zram, u32 index, u32 now)
+{
+	if (!zram_get_handle(zram, index) ||
+	    zram_test_flag(zram, index, ZRAM_SAME) ||
+	    zram_test_flag(zram, index, ZRAM_WB) ||
+	    zram_test_flag(zram, index, ZRAM_UNDER_WB) ||
+	    zram_test_flag(zram, index, ZRAM_DEDUP) ||
+	    zram_test_flag(zram, index, ZRAM_RECOMP))
+		return false;
+
+	return now - zram->table[index].ac_time >= zram->recomp_idle_secs;
+}
+
+/*
+ * Recompress one idle slot with the secondary algorithm, keeping the
+ * result only if it is smaller.  Runs under the slot lock, so nothing
+ * here may sleep.
+ */
+static void zram_recompress_slot(struct zram *zram, u32 index,
+				 struct page *page)
+{
+	unsigned long handle, new_handle;
+	unsigned int size, comp_len;
+	struct zcomp_strm *zstrm;
+	void *src, *dst;
+	int ret = 0;
+
+	handle = zram_get_handle(zram, index);
+	size = zram_get_obj_size(zram, index);
+
+	src = zs_map_object(zram->mem_pool, handle, ZS_MM_RO);
+	dst = kmap_atomic(page);
+	if (size == PAGE_SIZE) {
+		memcpy(dst, src, PAGE_SIZE);
+	} else {
+		zstrm = zcomp_stream_get(zram->comp);
+		ret = zcomp_decompress(zstrm, src, size, dst);
+		zcomp_stream_put(zram->comp);
+	}
+	kunmap_atomic(dst);
+	zs_unmap_object(zram->mem_pool, handle);
+	if (ret)
+		return;
+
+	zstrm = zcomp_stream_get(zram->recomp);
+	src = kmap_atomic(page);
+	ret = zcomp_compress(zstrm, src, &comp_len);
+	kunmap_atomic(src);
+
+	/* Not worth it: look at the page again after another idle period */
+	if (ret || comp_len >= size || comp_len > max_zpage_size)
+		goto out_retry;
+
+	new_handle = zs_malloc(zram->mem_pool, comp_len,
+			__GFP_KSWAPD_RECLAIM |
+			__GFP_NOWARN |
+			__GFP_HIGHMEM |
+			__GFP_MOVABLE);
+	if (!new_handle)
+		goto out_retry;
+
+	if (zram->limit_pages &&
+	    zs_get_total_pages(zram->mem_pool) > zram->limit_pages) {
+		zs_free(zram->mem_pool, new_handle);
+		goto out_retry;
+	}
+
+	dst = zs_map_object(zram->mem_pool, new_handle, ZS_MM_WO);
+	memcpy(dst, zstrm->buffer, comp_len);
+	zs_unmap_object(zram->mem_pool, new_handle);
+	zcomp_stream_put(zram->recomp);
+
+	zs_free(zram->mem_pool, handle);
+	zram_set_handle(zram, index, new_handle);
+	zram_set_obj_size(zram, index, comp_len);
+	zram_set_flag(zram, index, ZRAM_RECOMP);
+	if (zram_test_flag(zram, index, ZRAM_HUGE)) {
+		zram_clear_flag(zram, index, ZRAM_HUGE);
+		atomic64_dec(&zram->stats.huge_pages);
+	}
+	atomic64_sub(size - comp_len, &zram->stats.compr_data_size);
+	atomic64_inc(&zram->stats.recomp_pages);
+	return;
+
+out_retry:
+	zcomp_stream_put(zram->recomp);
+	zram_touch_slot(zram, index);
+}
+
+static void zram_recomp_schedule(struct zram *zram)
+{
+	unsigned int secs = READ_ONCE(zram->recomp_idle_secs);
+
+	if (zram->recomp && secs)
+		queue_delayed_work(system_long_wq, &zram->recomp_work,
+				   secs * HZ);
+}
+
+static void zram_recomp_work(struct work_struct *work)
+{
+	struct zram *zram = container_of(to_delayed_work(work),
+					 struct zram, recomp_work);
+	struct page *page;
+	unsigned long nr_pages, index;
+	u32 now;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram) || !zram->recomp)
+		goto out;
+
+	page = alloc_page(GFP_KERNEL | __GFP_HIGHMEM);
+	if (!page)
+		goto out_resched;
+
+	now = (u32)ktime_get_seconds();
+	nr_pages = zram->disksize >> PAGE_SHIFT;
+	for (index = 0; index < nr_pages; index++) {
+		zram_slot_lock(zram, index);
+		if (zram_recomp_candidate(zram, index, now))
+			zram_recompress_slot(zram, index, page);
+		zram_slot_unlock(zram, index);
+		cond_resched();
+	}
+	__free_page(page);
+
+out_resched:
+	zram_recomp_schedule(zram);
+out:
+	up_read(&zram->init_lock);
+}
+
+static int zram_recomp_init(struct zram *zram)
+{
+	struct zcomp *recomp;
+
+	if (!zram->recomp_algorithm[0])
+		return 0;
+
+	recomp = zcomp_create(zram->recomp_algorithm);
+	if (IS_ERR(recomp)) {
+		pr_err("Cannot initialise %s recompressing backend\n",
+				zram->recomp_algorithm);
+		return PTR_ERR(recomp);
+	}
+
+	zram->recomp = recomp;
+	zram_recomp_schedule(zram);
+	return 0;
+}
+
+/* Called with the device already marked uninitialized */
+static void zram_recomp_reset(struct zram *zram)
+{
+	cancel_delayed_work_sync(&zram->recomp_work);
+	if (zram->recomp) {
+		zcomp_destroy(zram->recomp);
+		zram->recomp = NULL;
+	}
+}
+
+static ssize_t recomp_algorithm_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	size_t sz;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	if (!zram->recomp_algorithm[0])
+		sz = scnprintf(buf, PAGE_SIZE, "none\n");
+	else
+		sz = zcomp_available_show(zram->recomp_algorithm, buf);
+	up_read(&zram->init_lock);
+
+	return sz;
+}
+
+static ssize_t recomp_algorithm_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	char compressor[ARRAY_SIZE(zram->recomp_algorithm)];
+	size_t sz;
+
+	strlcpy(compressor, buf, sizeof(compressor));
+	/* ignore trailing newline */
+	sz = strlen(compressor);
+	if (sz > 0 && compressor[sz - 1] == '\n')
+		compressor[sz - 1] = 0x00;
+
+	/* "none" or an empty string turns recompression off */
+	if (!strcmp(compressor, "none"))
+		compressor[0] = 0x00;
+
+	if (compressor[0] && !zcomp_available_algorithm(compressor))
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		up_write(&zram->init_lock);
+		pr_info("Can't change algorithm for initialized device\n");
+		return -EBUSY;
+	}
+
+	strcpy(zram->recomp_algorithm, compressor);
+	up_write(&zram->init_lock);
+	return len;
+}
+
+static ssize_t recomp_idle_secs_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%u\n",
+			READ_ONCE(zram->recomp_idle_secs));
+}
+
+static ssize_t recomp_idle_secs_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	unsigned int val;
+	int ret;
+
+	ret = kstrtouint(buf, 10, &val);
+	if (ret)
+		return ret;
+
+	/* A zero period stops the scan */
+	down_read(&zram->init_lock);
+	WRITE_ONCE(zram->recomp_idle_secs, val);
+	if (!val)
+		cancel_delayed_work(&zram->recomp_work);
+	else if (init_done(zram) && zram->recomp)
+		mod_delayed_work(system_long_wq, &zram->recomp_work,
+				 val * HZ);
+	up_read(&zram->init_lock);
+
+	return len;
+}
+#else
+static inline void zram_touch_slot(struct zram *zram, u32 index) {}
+static struct zcomp *zram_slot_comp(struct zram *zram, u32 index)
+{
+	return zram->comp;
+}
+static inline int zram_recomp_init(struct zram *zram) { return 0; }
+static inline void zram_recomp_reset(struct zram *zram) {}
+#endif
+
+/*
+ * Called for each page read or written by the block layer, with the slot
+ * table entry bit_spin_lock() held.
+ */
+static void zram_accessed(struct zram *zram, u32 index)
+{
+	zram_clear_flag(zram, index, ZRAM_IDLE);
+	zram_touch_slot(zram, index);
+}
+
 static int __zram_bvec_read(struct zram *zram, struct page *page, u32 index,
 				struct bio *bio, bool partial_io)
 {
@@ -853,6 +1240,7 @@ static int __zram_bvec_read(struct zram *zram, struct page *page, u32 index,
 
 			zram_slot_unlock(zram, index);
 
+			atomic64_inc(&zram->stats.bd_reads);
 			bvec.bv_page = page;
 			bvec.bv_len = PAGE_SIZE;
 			bvec.bv_offset = 0;
@@ -886,12 +1274,13 @@ static int __zram_bvec_read(struct zram *zram, struct page *page, u32 index,
 		kunmap_atomic(dst);
 		ret = 0;
 	} else {
-		struct zcomp_strm *zstrm = zcomp_stream_get(zram->comp);
+		struct zcomp *comp = zram_slot_comp(zram, index);
+		struct zcomp_strm *zstrm = zcomp_stream_get(comp);
 
 		dst = kmap_atomic(page);
 		ret = zcomp_decompress(zstrm, src, size, dst);
 		kunmap_atomic(dst);
-		zcomp_stream_put(zram->comp);
+		zcomp_stream_put(comp);
 	}
 	zs_unmap_object(zram->mem_pool, handle);
 	zram_slot_unlock(zram, index);
@@ -917,6 +1306,10 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 			return -ENOMEM;
 	}
 
+	zram_slot_lock(zram, index);
+	zram_accessed(zram, index);
+	zram_slot_unlock(zram, index);
+
 	ret = __zram_bvec_read(zram, page, index, bio, is_partial_io(bvec));
 	if (unlikely(ret))
 		goto out;
@@ -936,8 +1329,13 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 	return ret;
 }
 
+/*
+ * @breq holds the page already compressed by zcomp_compress_batch(), or
+ * is NULL.
+ */
 static int __zram_bvec_write(struct zram *zram, struct bio_vec *bvec,
-				u32 index, struct bio *bio)
+				u32 index, struct bio *bio,
+				const struct zcomp_batch_req *breq)
 {
 	int ret = 0;
 	unsigned long alloced_pages;
@@ -945,10 +1343,13 @@ static int __zram_bvec_write(struct zram *zram, struct bio_vec *bvec,
 	unsigned int comp_len = 0;
 	void *src, *dst, *mem;
 	struct zcomp_strm *zstrm;
+	void *cbuf;
 	struct page *page = bvec->bv_page;
 	unsigned long element = 0;
 	enum zram_pageflags flags = 0;
 	bool allow_wb = true;
+	bool dedup = false;
+	u32 checksum = 0;
 
 	mem = kmap_atomic(page);
 	if (page_same_filled(mem, &element)) {
@@ -958,13 +1359,30 @@ static int __zram_bvec_write(struct zram *zram, struct bio_vec *bvec,
 		atomic64_inc(&zram->stats.same_pages);
 		goto out;
 	}
+
+	if (zram_dedup_enabled(zram)) {
+		checksum = zram_dedup_checksum(mem);
+		handle = zram_dedup_find(zram, mem, checksum, &comp_len);
+		if (handle) {
+			kunmap_atomic(mem);
+			dedup = true;
+			goto out;
+		}
+	}
 	kunmap_atomic(mem);
 
 compress_again:
 	zstrm = zcomp_stream_get(zram->comp);
-	src = kmap_atomic(page);
-	ret = zcomp_compress(zstrm, src, &comp_len);
-	kunmap_atomic(src);
+	if (breq) {
+		cbuf = breq->dst;
+		comp_len = breq->dst_len;
+		ret = breq->err;
+	} else {
+		cbuf = zstrm->buffer;
+		src = kmap_atomic(page);
+		ret = zcomp_compress(zstrm, src, &comp_len);
+		kunmap_atomic(src);
+	}
 
 	if (unlikely(ret)) {
 		zcomp_stream_put(zram->comp);
@@ -1029,7 +1447,7 @@ static int __zram_bvec_write(struct zram *zram, struct bio_vec *bvec,
 
 	dst = zs_map_object(zram->mem_pool, handle, ZS_MM_WO);
 
-	src = zstrm->buffer;
+	src = cbuf;
 	if (comp_len == PAGE_SIZE)
 		src = kmap_atomic(page);
 	memcpy(dst, src, comp_len);
@@ -1039,6 +1457,9 @@ static int __zram_bvec_write(struct zram *zram, struct bio_vec *bvec,
 	zcomp_stream_put(zram->comp);
 	zs_unmap_object(zram->mem_pool, handle);
 	atomic64_add(comp_len, &zram->stats.compr_data_size);
+
+	if (zram_dedup_enabled(zram))
+		dedup = !zram_dedup_insert(zram, handle, comp_len, checksum);
 out:
 	/*
 	 * Free memory associated with this sector
@@ -1053,7 +1474,16 @@ static int __zram_bvec_write(struct zram *zram, struct bio_vec *bvec,
 	}  else {
 		zram_set_handle(zram, index, handle);
 		zram_set_obj_size(zram, index, comp_len);
+		if (comp_len == PAGE_SIZE) {
+			zram_set_flag(zram, index, ZRAM_HUGE);
+			atomic64_inc(&zram->stats.huge_pages);
+		}
+		if (dedup) {
+			zram_set_flag(zram, index, ZRAM_DEDUP);
+			zram_set_checksum(zram, index, checksum);
+		}
 	}
+	zram_accessed(zram, index);
 	zram_slot_unlock(zram, index);
 
 	/* Update stats */
@@ -1062,7 +1492,8 @@ static int __zram_bvec_write(struct zram *zram, struct bio_vec *bvec,
 }
 
 static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec,
-				u32 index, int offset, struct bio *bio)
+				u32 index, int offset, struct bio *bio,
+				const struct zcomp_batch_req *breq)
 {
 	int ret;
 	struct page *page = NULL;
@@ -1095,13 +1526,332 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec,
 		vec.bv_offset = 0;
 	}
 
-	ret = __zram_bvec_write(zram, &vec, index, bio);
+	ret = __zram_bvec_write(zram, &vec, index, bio,
+				is_partial_io(bvec) ? NULL : breq);
 out:
 	if (is_partial_io(bvec))
 		__free_page(page);
 	return ret;
 }
 
+#ifdef CONFIG_ZRAM_WRITEBACK
+/* Pages per bio of writeback_store() */
+#define ZRAM_WB_BATCH_PAGES	32
+
+struct zram_wb_batch {
+	struct page *pages[ZRAM_WB_BATCH_PAGES];
+	u32 index[ZRAM_WB_BATCH_PAGES];
+	unsigned long entry;	/* backing device block of pages[0] */
+	unsigned int nr;
+};
+
+static bool zram_wb_limit_get(struct zram *zram)
+{
+	bool ret = true;
+
+	spin_lock(&zram->wb_limit_lock);
+	if (zram->wb_limit_enable) {
+		if (zram->bd_wb_limit)
+			zram->bd_wb_limit--;
+		else
+			ret = false;
+	}
+	spin_unlock(&zram->wb_limit_lock);
+
+	return ret;
+}
+
+static void zram_wb_limit_put(struct zram *zram)
+{
+	spin_lock(&zram->wb_limit_lock);
+	if (zram->wb_limit_enable)
+		zram->bd_wb_limit++;
+	spin_unlock(&zram->wb_limit_lock);
+}
+
+/* Give up the writeback of a slot, the page stays in memory */
+static void zram_wb_abort(struct zram *zram, u32 index)
+{
+	zram_slot_lock(zram, index);
+	zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+	zram_clear_flag(zram, index, ZRAM_IDLE);
+	zram_slot_unlock(zram, index);
+	zram_wb_limit_put(zram);
+}
+
+/*
+ * Write the pages of a batch to consecutive blocks of the backing
+ * device, then free the in-memory copy of the slots nobody accessed in
+ * the meantime.
+ */
+static int zram_wb_flush(struct zram *zram, struct zram_wb_batch *batch)
+{
+	struct bio *bio;
+	unsigned int i;
+	int err;
+
+	if (!batch->nr)
+		return 0;
+
+	bio = bio_alloc(GFP_KERNEL, batch->nr);
+	bio->bi_iter.bi_sector = batch->entry * (PAGE_SIZE >> 9);
+	bio_set_dev(bio, zram->bdev);
+	bio->bi_opf = REQ_OP_WRITE | REQ_SYNC;
+	for (i = 0; i < batch->nr; i++)
+		bio_add_page(bio, batch->pages[i], PAGE_SIZE, 0);
+
+	err = submit_bio_wait(bio);
+	bio_put(bio);
+
+	for (i = 0; i < batch->nr; i++) {
+		u32 index = batch->index[i];
+		unsigned long entry = batch->entry + i;
+
+		if (err) {
+			put_entry_bdev(zram, entry);
+			zram_wb_abort(zram, index);
+			continue;
+		}
+
+		/*
+		 * A write or discard freed the slot, or a read cleared its
+		 * idle mark: the block just written is not needed.
+		 */
+		zram_slot_lock(zram, index);
+		if (!zram_test_flag(zram, index, ZRAM_UNDER_WB) ||
+		    !zram_test_flag(zram, index, ZRAM_IDLE)) {
+			zram_slot_unlock(zram, index);
+			put_entry_bdev(zram, entry);
+			zram_wb_abort(zram, index);
+			continue;
+		}
+
+		zram_free_page(zram, index);
+		zram_set_flag(zram, index, ZRAM_WB);
+		zram_set_element(zram, index, entry);
+		zram_slot_unlock(zram, index);
+
+		atomic64_inc(&zram->stats.pages_stored);
+		atomic64_inc(&zram->stats.bd_count);
+		atomic64_inc(&zram->stats.bd_writes);
+	}
+
+	batch->nr = 0;
+	return err;
+}
+
+/* Mark every stored page idle; reading or writing it clears the mark */
+static ssize_t idle_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	unsigned long nr_pages, index;
+
+	if (!sysfs_streq(buf, "all"))
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		up_read(&zram->init_lock);
+		return -EINVAL;
+	}
+
+	nr_pages = zram->disksize >> PAGE_SHIFT;
+
+	for (index = 0; index < nr_pages; index++) {
+		zram_slot_lock(zram, index);
+		if (zram_get_handle(zram, index) &&
+		    !zram_test_flag(zram, index, ZRAM_WB) &&
+		    !zram_test_flag(zram, index, ZRAM_UNDER_WB))
+			zram_set_flag(zram, index, ZRAM_IDLE);
+		zram_slot_unlock(zram, index);
+		cond_resched();
+	}
+	up_read(&zram->init_lock);
+
+	return len;
+}
+
+/*
+ * Write the idle or the huge pages to the backing device, in bios of
+ * up to ZRAM_WB_BATCH_PAGES pages, and within writeback_limit.
+ */
+static ssize_t writeback_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct zram_wb_batch *batch;
+	enum zram_pageflags mode;
+	unsigned long nr_pages, index, entry;
+	unsigned int i;
+	ssize_t ret = len;
+	int err;
+
+	if (sysfs_streq(buf, "idle"))
+		mode = ZRAM_IDLE;
+	else if (sysfs_streq(buf, "huge"))
+		mode = ZRAM_HUGE;
+	else
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		ret = -EINVAL;
+		goto out_unlock;
+	}
+
+	if (!zram_wb_enabled(zram)) {
+		ret = -ENODEV;
+		goto out_unlock;
+	}
+
+	nr_pages = zram->disksize >> PAGE_SHIFT;
+	batch = kzalloc(sizeof(*batch), GFP_KERNEL);
+	if (!batch) {
+		ret = -ENOMEM;
+		goto out_unlock;
+	}
+
+	for (i = 0; i < ZRAM_WB_BATCH_PAGES; i++) {
+		batch->pages[i] = alloc_page(GFP_KERNEL);
+		if (!batch->pages[i]) {
+			ret = -ENOMEM;
+			goto out_free;
+		}
+	}
+
+	for (index = 0; index < nr_pages; index++) {
+		cond_resched();
+
+		zram_slot_lock(zram, index);
+		if (!zram_get_handle(zram, index) ||
+		    zram_test_flag(zram, index, ZRAM_SAME) ||
+		    zram_test_flag(zram, index, ZRAM_WB) ||
+		    zram_test_flag(zram, index, ZRAM_UNDER_WB) ||
+		    !zram_test_flag(zram, index, mode)) {
+			zram_slot_unlock(zram, index);
+			continue;
+		}
+
+		if (!zram_wb_limit_get(zram)) {
+			zram_slot_unlock(zram, index);
+			ret = -EIO;
+			break;
+		}
+
+		/* The idle mark tells zram_wb_flush() the page was accessed */
+		zram_set_flag(zram, index, ZRAM_UNDER_WB);
+		zram_set_flag(zram, index, ZRAM_IDLE);
+		zram_slot_unlock(zram, index);
+
+		entry = get_entry_bdev(zram);
+		if (!entry) {
+			zram_wb_abort(zram, index);
+			ret = -ENOSPC;
+			break;
+		}
+
+		/* A bio only covers consecutive blocks */
+		if (batch->nr && entry != batch->entry + batch->nr) {
+			err = zram_wb_flush(zram, batch);
+			if (err)
+				ret = err;
+		}
+
+		if (__zram_bvec_read(zram, batch->pages[batch->nr], index,
+				     NULL, false)) {
+			put_entry_bdev(zram, entry);
+			zram_wb_abort(zram, index);
+			continue;
+		}
+
+		if (!batch->nr)
+			batch->entry = entry;
+		batch->index[batch->nr++] = index;
+		if (batch->nr == ZRAM_WB_BATCH_PAGES) {
+			err = zram_wb_flush(zram, batch);
+			if (err)
+				ret = err;
+		}
+	}
+
+	err = zram_wb_flush(zram, batch);
+	if (err)
+		ret = err;
+out_free:
+	for (i = 0; i < ZRAM_WB_BATCH_PAGES; i++)
+		if (batch->pages[i])
+			__free_page(batch->pages[i]);
+	kfree(batch);
+out_unlock:
+	up_read(&zram->init_lock);
+
+	return ret;
+}
+
+static ssize_t writeback_limit_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	u64 val;
+
+	spin_lock(&zram->wb_limit_lock);
+	val = zram->bd_wb_limit;
+	spin_unlock(&zram->wb_limit_lock);
+
+	return scnprintf(buf, PAGE_SIZE, "%llu\n", val);
+}
+
+static ssize_t writeback_limit_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	u64 val;
+	int ret;
+
+	ret = kstrtoull(buf, 10, &val);
+	if (ret)
+		return ret;
+
+	spin_lock(&zram->wb_limit_lock);
+	zram->bd_wb_limit = val;
+	spin_unlock(&zram->wb_limit_lock);
+
+	return len;
+}
+
+static ssize_t writeback_limit_enable_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	bool val;
+
+	spin_lock(&zram->wb_limit_lock);
+	val = zram->wb_limit_enable;
+	spin_unlock(&zram->wb_limit_lock);
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", val);
+}
+
+static ssize_t writeback_limit_enable_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	bool val;
+	int ret;
+
+	ret = kstrtobool(buf, &val);
+	if (ret)
+		return ret;
+
+	spin_lock(&zram->wb_limit_lock);
+	zram->wb_limit_enable = val;
+	spin_unlock(&zram->wb_limit_lock);
+
+	return len;
+}
+#endif
+
 /*
  * zram_bio_discard - handler on discard request
  * @index: physical block index in PAGE_SIZE units
@@ -1146,7 +1896,8 @@ static void zram_bio_discard(struct zram *zram, u32 index,
  * Returns 1 if IO request was successfully submitted.
  */
 static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
-			int offset, bool is_write, struct bio *bio)
+			int offset, bool is_write, struct bio *bio,
+			const struct zcomp_batch_req *breq)
 {
 	unsigned long start_time = jiffies;
 	int rw_acct = is_write ? REQ_OP_WRITE : REQ_OP_READ;
@@ -1162,7 +1913,7 @@ static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
 		flush_dcache_page(bvec->bv_page);
 	} else {
 		atomic64_inc(&zram->stats.num_writes);
-		ret = zram_bvec_write(zram, bvec, index, offset, bio);
+		ret = zram_bvec_write(zram, bvec, index, offset, bio, breq);
 	}
 
 	generic_end_io_acct(q, rw_acct, &zram->disk->part0, start_time);
@@ -1177,6 +1928,156 @@ static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
 	return ret;
 }
 
+/*
+ * Async write: the pages of a bio are split in one contiguous chunk per
+ * online CPU, each compressed by a worker, and the bio is completed by
+ * whichever chunk finishes last.
+ */
+struct zram_write_chunk {
+	struct work_struct work;
+	struct zram_write_job *job;
+	unsigned int start;
+	unsigned int nr;
+};
+
+struct zram_write_job {
+	struct zram *zram;
+	struct bio *bio;
+	u32 index;
+	atomic_t pending;
+	struct bio_vec *bvecs;
+	struct zram_write_chunk chunks[];
+};
+
+/* Pages per zcomp_compress_batch() call of an async write chunk */
+#define ZRAM_COMP_BATCH_PAGES	16
+
+/*
+ * Compress the pages of a chunk in batches, on a compressor that can
+ * have many requests in flight.  Returns false if the buffers could not
+ * be allocated, the pages are then to be written one by one.
+ */
+static bool zram_write_chunk_batch(struct zram_write_chunk *chunk)
+{
+	struct zram_write_job *job = chunk->job;
+	struct zram *zram = job->zram;
+	unsigned int end = chunk->start + chunk->nr;
+	unsigned int nr = min_t(unsigned int, chunk->nr,
+				ZRAM_COMP_BATCH_PAGES);
+	struct zcomp_batch_req *reqs;
+	unsigned int i, j, n;
+	bool batched, ret = false;
+
+	reqs = kcalloc(nr, sizeof(*reqs), GFP_NOIO | __GFP_NOWARN);
+	if (!reqs)
+		return false;
+
+	for (j = 0; j < nr; j++) {
+		reqs[j].dst = (void *)__get_free_pages(GFP_NOIO | __GFP_NOWARN,
+						       1);
+		if (!reqs[j].dst)
+			goto out;
+	}
+
+	for (i = chunk->start; i < end; i += n) {
+		n = min(nr, end - i);
+		for (j = 0; j < n; j++)
+			reqs[j].page = job->bvecs[i + j].bv_page;
+
+		batched = !zcomp_compress_batch(zram->comp, reqs, n);
+		for (j = 0; j < n; j++) {
+			if (zram_bvec_rw(zram, &job->bvecs[i + j],
+					 job->index + i + j, 0, true, job->bio,
+					 batched ? &reqs[j] : NULL) < 0)
+				job->bio->bi_status = BLK_STS_IOERR;
+		}
+	}
+	ret = true;
+out:
+	for (j = 0; j < nr; j++)
+		free_pages((unsigned long)reqs[j].dst, 1);
+	kfree(reqs);
+	return ret;
+}
+
+static void zram_write_chunk_fn(struct work_struct *work)
+{
+	struct zram_write_chunk *chunk =
+		container_of(work, struct zram_write_chunk, work);
+	struct zram_write_job *job = chunk->job;
+	unsigned int i;
+
+	if (zcomp_can_batch(job->zram->comp) && zram_write_chunk_batch(chunk))
+		goto out;
+
+	for (i = chunk->start; i < chunk->start + chunk->nr; i++) {
+		if (zram_bvec_rw(job->zram, &job->bvecs[i], job->index + i, 0,
+				 true, job->bio, NULL) < 0)
+			job->bio->bi_status = BLK_STS_IOERR;
+	}
+out:
+	if (atomic_dec_and_test(&job->pending)) {
+		bio_endio(job->bio);
+		kfree(job);
+	}
+}
+
+/*
+ * Returns false if the bio is to be written synchronously: it has a
+ * single page or partial pages, or memory is short.
+ */
+static bool zram_write_async(struct zram *zram, struct bio *bio, u32 index,
+			     int offset)
+{
+	unsigned int nr_pages = 0, nr_chunks, i, start = 0;
+	struct zram_write_job *job;
+	struct bio_vec bvec;
+	struct bvec_iter iter;
+
+	if (!READ_ONCE(zram->async_write) || offset)
+		return false;
+
+	bio_for_each_segment(bvec, bio, iter) {
+		if (bvec.bv_offset || bvec.bv_len != PAGE_SIZE)
+			return false;
+		nr_pages++;
+	}
+
+	/* A batching compressor is worth it even with a single chunk */
+	nr_chunks = min(nr_pages, num_online_cpus());
+	if (nr_pages <= 1 || (nr_chunks <= 1 && !zcomp_can_batch(zram->comp)))
+		return false;
+
+	job = kmalloc(sizeof(*job) + nr_chunks * sizeof(job->chunks[0]) +
+		      nr_pages * sizeof(*job->bvecs), GFP_NOIO | __GFP_NOWARN);
+	if (!job)
+		return false;
+
+	job->zram = zram;
+	job->bio = bio;
+	job->index = index;
+	atomic_set(&job->pending, nr_chunks);
+	job->bvecs = (struct bio_vec *)&job->chunks[nr_chunks];
+
+	i = 0;
+	bio_for_each_segment(bvec, bio, iter)
+		job->bvecs[i++] = bvec;
+
+	for (i = 0; i < nr_chunks; i++) {
+		struct zram_write_chunk *chunk = &job->chunks[i];
+		unsigned int end = nr_pages * (i + 1) / nr_chunks;
+
+		INIT_WORK(&chunk->work, zram_write_chunk_fn);
+		chunk->job = job;
+		chunk->start = start;
+		chunk->nr = end - start;
+		start = end;
+		queue_work(zram_write_wq, &chunk->work);
+	}
+
+	return true;
+}
+
 static void __zram_make_request(struct zram *zram, struct bio *bio)
 {
 	int offset;
@@ -1194,6 +2095,10 @@ static void __zram_make_request(struct zram *zram, struct bio *bio)
 		zram_bio_discard(zram, index, offset, bio);
 		bio_endio(bio);
 		return;
+	case REQ_OP_WRITE:
+		if (zram_write_async(zram, bio, index, offset))
+			return;
+		break;
 	default:
 		break;
 	}
@@ -1206,7 +2111,7 @@ static void __zram_make_request(struct zram *zram, struct bio *bio)
 			bv.bv_len = min_t(unsigned int, PAGE_SIZE - offset,
 							unwritten);
 			if (zram_bvec_rw(zram, &bv, index, offset,
-					op_is_write(bio_op(bio)), bio) < 0)
+					op_is_write(bio_op(bio)), bio, NULL) < 0)
 				goto out;
 
 			bv.bv_offset += bv.bv_len;
@@ -1282,7 +2187,7 @@ static int zram_rw_page(struct block_device *bdev, sector_t sector,
 	bv.bv_len = PAGE_SIZE;
 	bv.bv_offset = 0;
 
-	ret = zram_bvec_rw(zram, &bv, index, offset, is_write, NULL);
+	ret = zram_bvec_rw(zram, &bv, index, offset, is_write, NULL, NULL);
 out:
 	/*
 	 * If I/O fails, just return error(ie, non-zero) without
@@ -1330,8 +2235,12 @@ static void zram_reset_device(struct zram *zram)
 	part_stat_set_all(&zram->disk->part0, 0);
 
 	up_write(&zram->init_lock);
+	/* Wait for the async writes still compressing */
+	flush_workqueue(zram_write_wq);
+	zram_recomp_reset(zram);
 	/* I/O operation under all of CPU are done so let's free */
 	zram_meta_free(zram, disksize);
+	zram_dedup_fini(zram);
 	memset(&zram->stats, 0, sizeof(zram->stats));
 	zcomp_destroy(comp);
 	reset_bdev(zram);
@@ -1362,6 +2271,10 @@ static ssize_t disksize_store(struct device *dev,
 		goto out_unlock;
 	}
 
+	err = zram_dedup_init(zram, disksize >> PAGE_SHIFT);
+	if (err)
+		goto out_free_meta;
+
 	comp = zcomp_create(zram->compressor);
 	if (IS_ERR(comp)) {
 		pr_err("Cannot initialise %s compressing backend\n",
@@ -1372,14 +2285,23 @@ static ssize_t disksize_store(struct device *dev,
 
 	zram->comp = comp;
 	zram->disksize = disksize;
+	err = zram_recomp_init(zram);
+	if (err) {
+		zram->disksize = 0;
+		zram->comp = NULL;
+		goto out_free_comp;
+	}
 	set_capacity(zram->disk, zram->disksize >> SECTOR_SHIFT);
 	zram_revalidate_disk(zram);
 	up_write(&zram->init_lock);
 
 	return len;
 
+out_free_comp:
+	zcomp_destroy(comp);
 out_free_meta:
 	zram_meta_free(zram, disksize);
+	zram_dedup_fini(zram);
 out_unlock:
 	up_write(&zram->init_lock);
 	return err;
@@ -1460,8 +2382,20 @@ static DEVICE_ATTR_WO(mem_limit);
 static DEVICE_ATTR_WO(mem_used_max);
 static DEVICE_ATTR_RW(max_comp_streams);
 static DEVICE_ATTR_RW(comp_algorithm);
+static DEVICE_ATTR_RW(async_write);
+#ifdef CONFIG_ZRAM_DEDUP
+static DEVICE_ATTR_RW(use_dedup);
+#endif
 #ifdef CONFIG_ZRAM_WRITEBACK
 static DEVICE_ATTR_RW(backing_dev);
+static DEVICE_ATTR_WO(idle);
+static DEVICE_ATTR_WO(writeback);
+static DEVICE_ATTR_RW(writeback_limit);
+static DEVICE_ATTR_RW(writeback_limit_enable);
+#endif
+#ifdef CONFIG_ZRAM_RECOMPRESS
+static DEVICE_ATTR_RW(recomp_algorithm);
+static DEVICE_ATTR_RW(recomp_idle_secs);
 #endif
 
 static struct attribute *zram_disk_attrs[] = {
@@ -1473,8 +2407,20 @@ static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_mem_used_max.attr,
 	&dev_attr_max_comp_streams.attr,
 	&dev_attr_comp_algorithm.attr,
+	&dev_attr_async_write.attr,
+#ifdef CONFIG_ZRAM_DEDUP
+	&dev_attr_use_dedup.attr,
+#endif
 #ifdef CONFIG_ZRAM_WRITEBACK
 	&dev_attr_backing_dev.attr,
+	&dev_attr_idle.attr,
+	&dev_attr_writeback.attr,
+	&dev_attr_writeback_limit.attr,
+	&dev_attr_writeback_limit_enable.attr,
+#endif
+#ifdef CONFIG_ZRAM_RECOMPRESS
+	&dev_attr_recomp_algorithm.attr,
+	&dev_attr_recomp_idle_secs.attr,
 #endif
 	&dev_attr_io_stat.attr,
 	&dev_attr_mm_stat.attr,
@@ -1506,6 +2452,13 @@ static int zram_add(void)
 	device_id = ret;
 
 	init_rwsem(&zram->init_lock);
+#ifdef CONFIG_ZRAM_WRITEBACK
+	spin_lock_init(&zram->wb_limit_lock);
+#endif
+#ifdef CONFIG_ZRAM_RECOMPRESS
+	INIT_DELAYED_WORK(&zram->recomp_work, zram_recomp_work);
+	zram->recomp_idle_secs = 3600;
+#endif
 
 	queue = blk_alloc_queue(GFP_KERNEL);
 	if (!queue) {
@@ -1711,6 +2664,7 @@ static void destroy_devices(void)
 	idr_for_each(&zram_index_idr, &zram_remove_cb, NULL);
 	idr_destroy(&zram_index_idr);
 	unregister_blkdev(zram_major, "zram");
+	destroy_workqueue(zram_write_wq);
 	cpuhp_remove_multi_state(CPUHP_ZCOMP_PREPARE);
 }
 
@@ -1723,9 +2677,19 @@ static int __init zram_init(void)
 	if (ret < 0)
 		return ret;
 
+	/* Writes may be for swap-out, under memory pressure */
+	zram_write_wq = alloc_workqueue("zram_write",
+					WQ_UNBOUND | WQ_HIGHPRI |
+					WQ_MEM_RECLAIM, 0);
+	if (!zram_write_wq) {
+		cpuhp_remove_multi_state(CPUHP_ZCOMP_PREPARE);
+		return -ENOMEM;
+	}
+
 	ret = class_register(&zram_control_class);
 	if (ret) {
 		pr_err("Unable to register zram-control class\n");
+		destroy_workqueue(zram_write_wq);
 		cpuhp_remove_multi_state(CPUHP_ZCOMP_PREPARE);
 		return ret;
 	}
@@ -1734,6 +2698,7 @@ static int __init zram_init(void)
 	if (zram_major <= 0) {
 		pr_err("Unable to get major number\n");
 		class_unregister(&zram_control_class);
+		destroy_workqueue(zram_write_wq);
 		cpuhp_remove_multi_state(CPUHP_ZCOMP_PREPARE);
 		return -EBUSY;
 	}
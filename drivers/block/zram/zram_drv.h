@@ -20,6 +20,7 @@
 #include <linux/crypto.h>
 
 #include "zcomp.h"
+#include "zram_dedup.h"
 
 /*-- Configurable parameters */
 
@@ -64,6 +65,11 @@ enum zram_pageflags {
 	ZRAM_SAME = ZRAM_FLAG_SHIFT,
 	ZRAM_ACCESS,	/* page is now accessed */
 	ZRAM_WB,	/* page is stored on backing_device */
+	ZRAM_RECOMP,	/* page is compressed with the secondary algorithm */
+	ZRAM_IDLE,	/* page not accessed since marked idle */
+	ZRAM_HUGE,	/* incompressible page, stored as is */
+	ZRAM_UNDER_WB,	/* page is being written to backing_device */
+	ZRAM_DEDUP,	/* handle is shared, see zram_dedup.c */
 
 	__NR_ZRAM_PAGEFLAGS,
 };
@@ -77,6 +83,12 @@ struct zram_table_entry {
 		unsigned long element;
 	};
 	unsigned long value;
+#ifdef CONFIG_ZRAM_RECOMPRESS
+	u32 ac_time;	/* last access, in seconds */
+#endif
+#ifdef CONFIG_ZRAM_DEDUP
+	u32 checksum;	/* of the uncompressed page, if ZRAM_DEDUP */
+#endif
 };
 
 struct zram_stats {
@@ -91,6 +103,13 @@ struct zram_stats {
 	atomic64_t pages_stored;	/* no. of pages currently stored */
 	atomic_long_t max_used_pages;	/* no. of maximum pages stored */
 	atomic64_t writestall;		/* no. of write slow paths */
+	atomic64_t recomp_pages;	/* no. of pages recompressed */
+	atomic64_t huge_pages;		/* no. of huge pages */
+	atomic64_t bd_count;		/* no. of pages in backing device */
+	atomic64_t bd_reads;		/* no. of reads from backing device */
+	atomic64_t bd_writes;		/* no. of writes to backing device */
+	atomic64_t dup_data_size;	/* compressed size of pages duplicated */
+	atomic64_t meta_data_size;	/* size of the dedup metadata */
 };
 
 struct zram {
@@ -116,6 +135,8 @@ struct zram {
 	 * zram is claimed so open request will be failed
 	 */
 	bool claim; /* Protected by bdev->bd_mutex */
+	/* Compress the pages of a write bio in parallel */
+	bool async_write;
 #ifdef CONFIG_ZRAM_WRITEBACK
 	struct file *backing_dev;
 	struct block_device *bdev;
@@ -123,6 +144,22 @@ struct zram {
 	unsigned long *bitmap;
 	unsigned long nr_pages;
 	spinlock_t bitmap_lock;
+	/* Pages writeback_store() may still write, if wb_limit_enable */
+	spinlock_t wb_limit_lock;
+	bool wb_limit_enable;
+	u64 bd_wb_limit;
+#endif
+#ifdef CONFIG_ZRAM_RECOMPRESS
+	/* Secondary algorithm for the pages idle for recomp_idle_secs */
+	struct zcomp *recomp;
+	char recomp_algorithm[CRYPTO_MAX_ALG_NAME];
+	unsigned int recomp_idle_secs;
+	struct delayed_work recomp_work;
+#endif
+#ifdef CONFIG_ZRAM_DEDUP
+	bool use_dedup;
+	struct zram_hash *hash;
+	size_t hash_size;
 #endif
 };
 #endif
@@ -30,7 +30,6 @@
 #include <linux/sched/rt.h>
 #include <linux/tick.h>
 #include <linux/time.h>
-#include <linux/timer.h>
 #include <linux/kthread.h>
 #include <linux/slab.h>
 
@@ -94,9 +93,10 @@ struct interactive_tunables {
 	/*
 	 * Max additional time to wait in idle, beyond sampling_rate, at speeds
 	 * above minimum before wakeup to reduce speed, or -1 if unnecessary.
+	 * Unused: the load comes from the scheduler, idle cpus are not woken
+	 * up to sample it.  Kept for the existing userspace configurations.
 	 */
 #define DEFAULT_TIMER_SLACK (4 * DEFAULT_SAMPLING_RATE)
-	unsigned long timer_slack_delay;
 	unsigned long timer_slack;
 	bool io_is_busy;
 };
@@ -106,6 +106,19 @@ struct interactive_policy {
 	struct cpufreq_policy *policy;
 	struct interactive_tunables *tunables;
 	struct list_head tunables_hook;
+
+	raw_spinlock_t update_lock; /* protects the next 2 fields */
+	u64 last_sample_time;
+	bool work_in_progress;
+	struct irq_work irq_work;
+
+	spinlock_t target_freq_lock; /*protects target freq */
+	unsigned int target_freq;
+
+	unsigned int floor_freq;
+	u64 floor_validate_time;
+	u64 hispeed_validate_time; /* when the current speed was set */
+	u64 target_validate_time; /* when target_freq passed the hispeed delay */
 };
 
 /* Separate instance required for each CPU */
@@ -113,28 +126,13 @@ struct interactive_cpu {
 	struct update_util_data update_util;
 	struct interactive_policy *ipolicy;
 
-	struct irq_work irq_work;
-	u64 last_sample_time;
-	unsigned long next_sample_jiffies;
-	bool work_in_progress;
-
 	struct rw_semaphore enable_sem;
-	struct timer_list slack_timer;
-
-	spinlock_t load_lock; /* protects the next 4 fields */
-	u64 time_in_idle;
-	u64 time_in_idle_timestamp;
-	u64 cputime_speedadj;
-	u64 cputime_speedadj_timestamp;
-
-	spinlock_t target_freq_lock; /*protects target freq */
-	unsigned int target_freq;
 
-	unsigned int floor_freq;
-	u64 pol_floor_val_time; /* policy floor_validate_time */
-	u64 loc_floor_val_time; /* per-cpu floor_validate_time */
-	u64 pol_hispeed_val_time; /* policy hispeed_validate_time */
-	u64 loc_hispeed_val_time; /* per-cpu hispeed_validate_time */
+	/* Last scheduler update, protected by ipolicy->update_lock */
+	unsigned long util;
+	unsigned long max;
+	unsigned int flags;
+	u64 last_update;
 };
 
 static DEFINE_PER_CPU(struct interactive_cpu, interactive_cpu);
@@ -161,65 +159,6 @@ static unsigned int default_above_hispeed_delay[] = {
 static struct interactive_tunables *global_tunables;
 static DEFINE_MUTEX(global_tunables_lock);
 
-static inline void update_slack_delay(struct interactive_tunables *tunables)
-{
-	tunables->timer_slack_delay = usecs_to_jiffies(tunables->timer_slack +
-						       tunables->sampling_rate);
-}
-
-static bool timer_slack_required(struct interactive_cpu *icpu)
-{
-	struct interactive_policy *ipolicy = icpu->ipolicy;
-	struct interactive_tunables *tunables = ipolicy->tunables;
-
-	if (tunables->timer_slack < 0)
-		return false;
-
-	if (icpu->target_freq > ipolicy->policy->min)
-		return true;
-
-	return false;
-}
-
-static void gov_slack_timer_start(struct interactive_cpu *icpu, int cpu)
-{
-	struct interactive_tunables *tunables = icpu->ipolicy->tunables;
-
-	icpu->slack_timer.expires = jiffies + tunables->timer_slack_delay;
-	add_timer_on(&icpu->slack_timer, cpu);
-}
-
-static void gov_slack_timer_modify(struct interactive_cpu *icpu)
-{
-	struct interactive_tunables *tunables = icpu->ipolicy->tunables;
-
-	mod_timer(&icpu->slack_timer, jiffies + tunables->timer_slack_delay);
-}
-
-static void slack_timer_resched(struct interactive_cpu *icpu, int cpu,
-				bool modify)
-{
-	struct interactive_tunables *tunables = icpu->ipolicy->tunables;
-	unsigned long flags;
-
-	spin_lock_irqsave(&icpu->load_lock, flags);
-
-	icpu->time_in_idle = get_cpu_idle_time(cpu,
-					       &icpu->time_in_idle_timestamp,
-					       tunables->io_is_busy);
-	icpu->cputime_speedadj = 0;
-	icpu->cputime_speedadj_timestamp = icpu->time_in_idle_timestamp;
-
-	if (timer_slack_required(icpu)) {
-		if (modify)
-			gov_slack_timer_modify(icpu);
-		else
-			gov_slack_timer_start(icpu, cpu);
-	}
-
-	spin_unlock_irqrestore(&icpu->load_lock, flags);
-}
-
 static unsigned int
 freq_to_above_hispeed_delay(struct interactive_tunables *tunables,
 			    unsigned int freq)
@@ -263,10 +202,10 @@ static unsigned int freq_to_targetload(struct interactive_tunables *tunables,
  * choose_freq() will find the minimum frequency that does not exceed its
  * target load given the current load.
  */
-static unsigned int choose_freq(struct interactive_cpu *icpu,
+static unsigned int choose_freq(struct interactive_policy *ipolicy,
 				unsigned int loadadjfreq)
 {
-	struct cpufreq_policy *policy = icpu->ipolicy->policy;
+	struct cpufreq_policy *policy = ipolicy->policy;
 	struct cpufreq_frequency_table *freq_table = policy->freq_table;
 	unsigned int prevfreq, freqmin = 0, freqmax = UINT_MAX, tl;
 	unsigned int freq = policy->cur;
@@ -274,7 +213,7 @@ static unsigned int choose_freq(struct interactive_cpu *icpu,
 
 	do {
 		prevfreq = freq;
-		tl = freq_to_targetload(icpu->ipolicy->tunables, freq);
+		tl = freq_to_targetload(ipolicy->tunables, freq);
 
 		/*
 		 * Find the lowest frequency where the computed load is less
@@ -336,52 +275,60 @@ static unsigned int choose_freq(struct interactive_cpu *icpu,
 	return freq;
 }
 
-static u64 update_load(struct interactive_cpu *icpu, int cpu)
+/*
+ * The load of the busiest cpu of the policy, as the percentage of busy time
+ * times the current speed, from the last scheduler utilization of its cpus.
+ * A cpu not updated for a tick is idle.
+ */
+static unsigned int get_policy_loadadjfreq(struct interactive_policy *ipolicy)
 {
-	struct interactive_tunables *tunables = icpu->ipolicy->tunables;
-	u64 now_idle, now, active_time, delta_idle, delta_time;
+	struct interactive_tunables *tunables = ipolicy->tunables;
+	struct cpufreq_policy *policy = ipolicy->policy;
+	unsigned int freq = cpufreq_sched_util_invariant() ?
+				policy->cpuinfo.max_freq : policy->cur;
+	u64 load, loadadjfreq = 0;
+	unsigned long flags;
+	unsigned int cpu;
+
+	raw_spin_lock_irqsave(&ipolicy->update_lock, flags);
 
-	now_idle = get_cpu_idle_time(cpu, &now, tunables->io_is_busy);
-	delta_idle = (now_idle - icpu->time_in_idle);
-	delta_time = (now - icpu->time_in_idle_timestamp);
+	for_each_cpu(cpu, policy->cpus) {
+		struct interactive_cpu *icpu = &per_cpu(interactive_cpu, cpu);
 
-	if (delta_time <= delta_idle)
-		active_time = 0;
-	else
-		active_time = delta_time - delta_idle;
+		if ((s64)(ipolicy->last_sample_time - icpu->last_update) >
+		    TICK_NSEC)
+			continue;
+
+		if (tunables->io_is_busy && icpu->flags & SCHED_CPUFREQ_IOWAIT)
+			load = (u64)policy->cur * 100;
+		else
+			load = div64_u64((u64)icpu->util * freq * 100,
+					 icpu->max);
 
-	icpu->cputime_speedadj += active_time * icpu->ipolicy->policy->cur;
+		loadadjfreq = max(loadadjfreq, load);
+	}
 
-	icpu->time_in_idle = now_idle;
-	icpu->time_in_idle_timestamp = now;
+	raw_spin_unlock_irqrestore(&ipolicy->update_lock, flags);
 
-	return now;
+	return loadadjfreq;
 }
 
 /* Re-evaluate load to see if a frequency change is required or not */
-static void eval_target_freq(struct interactive_cpu *icpu)
+static void eval_target_freq(struct interactive_policy *ipolicy)
 {
-	struct interactive_tunables *tunables = icpu->ipolicy->tunables;
-	struct cpufreq_policy *policy = icpu->ipolicy->policy;
+	struct interactive_tunables *tunables = ipolicy->tunables;
+	struct cpufreq_policy *policy = ipolicy->policy;
 	struct cpufreq_frequency_table *freq_table = policy->freq_table;
-	u64 cputime_speedadj, now, max_fvtime;
-	unsigned int new_freq, loadadjfreq, index, delta_time;
+	unsigned int new_freq, loadadjfreq, index;
 	unsigned long flags;
 	int cpu_load;
 	int cpu = smp_processor_id();
+	u64 now;
 
-	spin_lock_irqsave(&icpu->load_lock, flags);
-	now = update_load(icpu, smp_processor_id());
-	delta_time = (unsigned int)(now - icpu->cputime_speedadj_timestamp);
-	cputime_speedadj = icpu->cputime_speedadj;
-	spin_unlock_irqrestore(&icpu->load_lock, flags);
+	loadadjfreq = get_policy_loadadjfreq(ipolicy);
+	now = ktime_to_us(ktime_get());
 
-	if (WARN_ON_ONCE(!delta_time))
-		return;
-
-	spin_lock_irqsave(&icpu->target_freq_lock, flags);
-	do_div(cputime_speedadj, delta_time);
-	loadadjfreq = (unsigned int)cputime_speedadj * 100;
+	spin_lock_irqsave(&ipolicy->target_freq_lock, flags);
 	cpu_load = loadadjfreq / policy->cur;
 	tunables->boosted = tunables->boost ||
 			    now < tunables->boostpulse_endtime;
@@ -390,13 +337,13 @@ static void eval_target_freq(struct interactive_cpu *icpu)
 		if (policy->cur < tunables->hispeed_freq) {
 			new_freq = tunables->hispeed_freq;
 		} else {
-			new_freq = choose_freq(icpu, loadadjfreq);
+			new_freq = choose_freq(ipolicy, loadadjfreq);
 
 			if (new_freq < tunables->hispeed_freq)
 				new_freq = tunables->hispeed_freq;
 		}
 	} else {
-		new_freq = choose_freq(icpu, loadadjfreq);
+		new_freq = choose_freq(ipolicy, loadadjfreq);
 		if (new_freq > tunables->hispeed_freq &&
 		    policy->cur < tunables->hispeed_freq)
 			new_freq = tunables->hispeed_freq;
@@ -404,13 +351,13 @@ static void eval_target_freq(struct interactive_cpu *icpu)
 
 	if (policy->cur >= tunables->hispeed_freq &&
 	    new_freq > policy->cur &&
-	    now - icpu->pol_hispeed_val_time < freq_to_above_hispeed_delay(tunables, policy->cur)) {
+	    now - ipolicy->hispeed_validate_time < freq_to_above_hispeed_delay(tunables, policy->cur)) {
 		trace_cpufreq_interactive_notyet(cpu, cpu_load,
-				icpu->target_freq, policy->cur, new_freq);
+				ipolicy->target_freq, policy->cur, new_freq);
 		goto exit;
 	}
 
-	icpu->loc_hispeed_val_time = now;
+	ipolicy->target_validate_time = now;
 
 	index = cpufreq_frequency_table_target(policy, new_freq,
 					       CPUFREQ_RELATION_L);
@@ -420,11 +367,12 @@ static void eval_target_freq(struct interactive_cpu *icpu)
 	 * Do not scale below floor_freq unless we have been at or above the
 	 * floor frequency for the minimum sample time since last validated.
 	 */
-	max_fvtime = max(icpu->pol_floor_val_time, icpu->loc_floor_val_time);
-	if (new_freq < icpu->floor_freq && icpu->target_freq >= policy->cur) {
-		if (now - max_fvtime < tunables->min_sample_time) {
+	if (new_freq < ipolicy->floor_freq &&
+	    ipolicy->target_freq >= policy->cur) {
+		if (now - ipolicy->floor_validate_time <
+		    tunables->min_sample_time) {
 			trace_cpufreq_interactive_notyet(cpu, cpu_load,
-				icpu->target_freq, policy->cur, new_freq);
+				ipolicy->target_freq, policy->cur, new_freq);
 			goto exit;
 		}
 	}
@@ -438,23 +386,24 @@ static void eval_target_freq(struct interactive_cpu *icpu)
 	 */
 
 	if (!tunables->boosted || new_freq > tunables->hispeed_freq) {
-		icpu->floor_freq = new_freq;
-		if (icpu->target_freq >= policy->cur || new_freq >= policy->cur)
-			icpu->loc_floor_val_time = now;
+		ipolicy->floor_freq = new_freq;
+		if (ipolicy->target_freq >= policy->cur ||
+		    new_freq >= policy->cur)
+			ipolicy->floor_validate_time = now;
 	}
 
-	if (icpu->target_freq == new_freq &&
-	    icpu->target_freq <= policy->cur) {
+	if (ipolicy->target_freq == new_freq &&
+	    ipolicy->target_freq <= policy->cur) {
 		trace_cpufreq_interactive_already(cpu, cpu_load,
-			icpu->target_freq, policy->cur, new_freq);
+			ipolicy->target_freq, policy->cur, new_freq);
 		goto exit;
 	}
 
-	trace_cpufreq_interactive_target(cpu, cpu_load, icpu->target_freq,
+	trace_cpufreq_interactive_target(cpu, cpu_load, ipolicy->target_freq,
 					 policy->cur, new_freq);
 
-	icpu->target_freq = new_freq;
-	spin_unlock_irqrestore(&icpu->target_freq_lock, flags);
+	ipolicy->target_freq = new_freq;
+	spin_unlock_irqrestore(&ipolicy->target_freq_lock, flags);
 
 	spin_lock_irqsave(&speedchange_cpumask_lock, flags);
 	cpumask_set_cpu(cpu, &speedchange_cpumask);
@@ -464,84 +413,31 @@ static void eval_target_freq(struct interactive_cpu *icpu)
 	return;
 
 exit:
-	spin_unlock_irqrestore(&icpu->target_freq_lock, flags);
-}
-
-static void cpufreq_interactive_update(struct interactive_cpu *icpu)
-{
-	eval_target_freq(icpu);
-	slack_timer_resched(icpu, smp_processor_id(), true);
-}
-
-static void cpufreq_interactive_idle_end(void)
-{
-	struct interactive_cpu *icpu = &per_cpu(interactive_cpu,
-						smp_processor_id());
-
-	if (!down_read_trylock(&icpu->enable_sem))
-		return;
-
-	if (icpu->ipolicy) {
-		/*
-		 * We haven't sampled load for more than sampling_rate time, do
-		 * it right now.
-		 */
-		if (time_after_eq(jiffies, icpu->next_sample_jiffies))
-			cpufreq_interactive_update(icpu);
-	}
-
-	up_read(&icpu->enable_sem);
+	spin_unlock_irqrestore(&ipolicy->target_freq_lock, flags);
 }
 
-static void cpufreq_interactive_get_policy_info(struct cpufreq_policy *policy,
-						unsigned int *pmax_freq,
-						u64 *phvt, u64 *pfvt)
+static void cpufreq_interactive_adjust_policy(unsigned int cpu,
+					      struct interactive_policy *ipolicy)
 {
-	struct interactive_cpu *icpu;
-	u64 hvt = ~0ULL, fvt = 0;
-	unsigned int max_freq = 0, i;
-
-	for_each_cpu(i, policy->cpus) {
-		icpu = &per_cpu(interactive_cpu, i);
-
-		fvt = max(fvt, icpu->loc_floor_val_time);
-		if (icpu->target_freq > max_freq) {
-			max_freq = icpu->target_freq;
-			hvt = icpu->loc_hispeed_val_time;
-		} else if (icpu->target_freq == max_freq) {
-			hvt = min(hvt, icpu->loc_hispeed_val_time);
-		}
-	}
-
-	*pmax_freq = max_freq;
-	*phvt = hvt;
-	*pfvt = fvt;
-}
-
-static void cpufreq_interactive_adjust_cpu(unsigned int cpu,
-					   struct cpufreq_policy *policy)
-{
-	struct interactive_cpu *icpu;
-	u64 hvt, fvt;
-	unsigned int max_freq;
-	int i;
+	struct cpufreq_policy *policy = ipolicy->policy;
+	unsigned int target_freq;
+	unsigned long flags;
+	u64 tvt;
 
-	cpufreq_interactive_get_policy_info(policy, &max_freq, &hvt, &fvt);
+	spin_lock_irqsave(&ipolicy->target_freq_lock, flags);
+	target_freq = ipolicy->target_freq;
+	tvt = ipolicy->target_validate_time;
+	spin_unlock_irqrestore(&ipolicy->target_freq_lock, flags);
 
-	for_each_cpu(i, policy->cpus) {
-		icpu = &per_cpu(interactive_cpu, i);
-		icpu->pol_floor_val_time = fvt;
-	}
+	if (target_freq != policy->cur) {
+		__cpufreq_driver_target(policy, target_freq, CPUFREQ_RELATION_H);
 
-	if (max_freq != policy->cur) {
-		__cpufreq_driver_target(policy, max_freq, CPUFREQ_RELATION_H);
-		for_each_cpu(i, policy->cpus) {
-			icpu = &per_cpu(interactive_cpu, i);
-			icpu->pol_hispeed_val_time = hvt;
-		}
+		spin_lock_irqsave(&ipolicy->target_freq_lock, flags);
+		ipolicy->hispeed_validate_time = tvt;
+		spin_unlock_irqrestore(&ipolicy->target_freq_lock, flags);
 	}
 
-	trace_cpufreq_interactive_setspeed(cpu, max_freq, policy->cur);
+	trace_cpufreq_interactive_setspeed(cpu, target_freq, policy->cur);
 }
 
 static int cpufreq_interactive_speedchange_task(void *data)
@@ -571,15 +467,12 @@ static int cpufreq_interactive_speedchange_task(void *data)
 
 	for_each_cpu(cpu, &tmp_mask) {
 		struct interactive_cpu *icpu = &per_cpu(interactive_cpu, cpu);
-		struct cpufreq_policy *policy;
 
 		if (unlikely(!down_read_trylock(&icpu->enable_sem)))
 			continue;
 
-		if (likely(icpu->ipolicy)) {
-			policy = icpu->ipolicy->policy;
-			cpufreq_interactive_adjust_cpu(cpu, policy);
-		}
+		if (likely(icpu->ipolicy))
+			cpufreq_interactive_adjust_policy(cpu, icpu->ipolicy);
 
 		up_read(&icpu->enable_sem);
 	}
@@ -594,7 +487,6 @@ static void cpufreq_interactive_boost(struct interactive_tunables *tunables)
 	struct interactive_cpu *icpu;
 	unsigned long flags[2];
 	bool wakeup = false;
-	int i;
 
 	tunables->boosted = true;
 
@@ -602,68 +494,34 @@ static void cpufreq_interactive_boost(struct interactive_tunables *tunables)
 
 	for_each_ipolicy(ipolicy) {
 		policy = ipolicy->policy;
+		icpu = &per_cpu(interactive_cpu, policy->cpu);
 
-		for_each_cpu(i, policy->cpus) {
-			icpu = &per_cpu(interactive_cpu, i);
-
-			if (!down_read_trylock(&icpu->enable_sem))
-				continue;
-
-			if (!icpu->ipolicy) {
-				up_read(&icpu->enable_sem);
-				continue;
-			}
-
-			spin_lock_irqsave(&icpu->target_freq_lock, flags[1]);
-			if (icpu->target_freq < tunables->hispeed_freq) {
-				icpu->target_freq = tunables->hispeed_freq;
-				cpumask_set_cpu(i, &speedchange_cpumask);
-				icpu->pol_hispeed_val_time = ktime_to_us(ktime_get());
-				wakeup = true;
-			}
-			spin_unlock_irqrestore(&icpu->target_freq_lock, flags[1]);
+		if (!down_read_trylock(&icpu->enable_sem))
+			continue;
 
+		if (!icpu->ipolicy) {
 			up_read(&icpu->enable_sem);
+			continue;
 		}
-	}
-
-	spin_unlock_irqrestore(&speedchange_cpumask_lock, flags[0]);
-
-	if (wakeup)
-		wake_up_process(speedchange_task);
-}
-
-static int cpufreq_interactive_notifier(struct notifier_block *nb,
-					unsigned long val, void *data)
-{
-	struct cpufreq_freqs *freq = data;
-	struct interactive_cpu *icpu = &per_cpu(interactive_cpu, freq->cpu);
-	unsigned long flags;
-
-	if (val != CPUFREQ_POSTCHANGE)
-		return 0;
 
-	if (!down_read_trylock(&icpu->enable_sem))
-		return 0;
+		spin_lock_irqsave(&ipolicy->target_freq_lock, flags[1]);
+		if (ipolicy->target_freq < tunables->hispeed_freq) {
+			ipolicy->target_freq = tunables->hispeed_freq;
+			cpumask_set_cpu(policy->cpu, &speedchange_cpumask);
+			ipolicy->hispeed_validate_time = ktime_to_us(ktime_get());
+			wakeup = true;
+		}
+		spin_unlock_irqrestore(&ipolicy->target_freq_lock, flags[1]);
 
-	if (!icpu->ipolicy) {
 		up_read(&icpu->enable_sem);
-		return 0;
 	}
 
-	spin_lock_irqsave(&icpu->load_lock, flags);
-	update_load(icpu, freq->cpu);
-	spin_unlock_irqrestore(&icpu->load_lock, flags);
-
-	up_read(&icpu->enable_sem);
+	spin_unlock_irqrestore(&speedchange_cpumask_lock, flags[0]);
 
-	return 0;
+	if (wakeup)
+		wake_up_process(speedchange_task);
 }
 
-static struct notifier_block cpufreq_notifier_block = {
-	.notifier_call = cpufreq_interactive_notifier,
-};
-
 static unsigned int *get_tokenized_data(const char *buf, int *num_tokens)
 {
 	const char *cp = buf;
@@ -891,7 +749,6 @@ static ssize_t store_timer_slack(struct gov_attr_set *attr_set, const char *buf,
 		return ret;
 
 	tunables->timer_slack = val;
-	update_slack_delay(tunables);
 
 	return count;
 }
@@ -1013,23 +870,9 @@ static struct kobj_type interactive_tunables_ktype = {
 	.sysfs_ops = &governor_sysfs_ops,
 };
 
-static int cpufreq_interactive_idle_notifier(struct notifier_block *nb,
-					     unsigned long val, void *data)
-{
-	if (val == IDLE_END)
-		cpufreq_interactive_idle_end();
-
-	return 0;
-}
-
-static struct notifier_block cpufreq_interactive_idle_nb = {
-	.notifier_call = cpufreq_interactive_idle_notifier,
-};
-
 /* Interactive Governor callbacks */
 struct interactive_governor {
 	struct cpufreq_governor gov;
-	unsigned int usage_count;
 };
 
 static struct interactive_governor interactive_gov;
@@ -1038,11 +881,11 @@ static struct interactive_governor interactive_gov;
 
 static void irq_work(struct irq_work *irq_work)
 {
-	struct interactive_cpu *icpu = container_of(irq_work, struct
-						    interactive_cpu, irq_work);
+	struct interactive_policy *ipolicy = container_of(irq_work, struct
+						interactive_policy, irq_work);
 
-	cpufreq_interactive_update(icpu);
-	icpu->work_in_progress = false;
+	eval_target_freq(ipolicy);
+	ipolicy->work_in_progress = false;
 }
 
 static void update_util_handler(struct update_util_data *data, u64 time,
@@ -1052,27 +895,35 @@ static void update_util_handler(struct update_util_data *data, u64 time,
 					struct interactive_cpu, update_util);
 	struct interactive_policy *ipolicy = icpu->ipolicy;
 	struct interactive_tunables *tunables = ipolicy->tunables;
+	unsigned long util, max;
 	u64 delta_ns;
 
+	util = cpufreq_get_sched_util(smp_processor_id(), &max);
+
+	raw_spin_lock(&ipolicy->update_lock);
+
+	icpu->util = util;
+	icpu->max = max;
+	icpu->flags = flags;
+	icpu->last_update = time;
+
 	/*
-	 * The irq-work may not be allowed to be queued up right now.
+	 * The cpus of the policy are evaluated together, once per sampling
+	 * period, from whichever of them updates first.  The irq-work may
+	 * not be allowed to be queued up right now.
 	 * Possible reasons:
 	 * - Work has already been queued up or is in progress.
 	 * - It is too early (too little time from the previous sample).
 	 */
-	if (icpu->work_in_progress)
-		return;
-
-	delta_ns = time - icpu->last_sample_time;
-	if ((s64)delta_ns < tunables->sampling_rate * NSEC_PER_USEC)
-		return;
-
-	icpu->last_sample_time = time;
-	icpu->next_sample_jiffies = usecs_to_jiffies(tunables->sampling_rate) +
-				    jiffies;
+	delta_ns = time - ipolicy->last_sample_time;
+	if (!ipolicy->work_in_progress &&
+	    (s64)delta_ns >= tunables->sampling_rate * NSEC_PER_USEC) {
+		ipolicy->last_sample_time = time;
+		ipolicy->work_in_progress = true;
+		irq_work_queue(&ipolicy->irq_work);
+	}
 
-	icpu->work_in_progress = true;
-	irq_work_queue(&icpu->irq_work);
+	raw_spin_unlock(&ipolicy->update_lock);
 }
 
 static void gov_set_update_util(struct interactive_policy *ipolicy)
@@ -1081,11 +932,12 @@ static void gov_set_update_util(struct interactive_policy *ipolicy)
 	struct interactive_cpu *icpu;
 	int cpu;
 
+	ipolicy->last_sample_time = 0;
+
 	for_each_cpu(cpu, policy->cpus) {
 		icpu = &per_cpu(interactive_cpu, cpu);
 
-		icpu->last_sample_time = 0;
-		icpu->next_sample_jiffies = 0;
+		icpu->last_update = 0;
 		cpufreq_add_update_util_hook(cpu, &icpu->update_util,
 					     update_util_handler);
 	}
@@ -1101,13 +953,6 @@ static inline void gov_clear_update_util(struct cpufreq_policy *policy)
 	synchronize_sched();
 }
 
-static void icpu_cancel_work(struct interactive_cpu *icpu)
-{
-	irq_work_sync(&icpu->irq_work);
-	icpu->work_in_progress = false;
-	del_timer_sync(&icpu->slack_timer);
-}
-
 static struct interactive_policy *
 interactive_policy_alloc(struct cpufreq_policy *policy)
 {
@@ -1118,6 +963,9 @@ interactive_policy_alloc(struct cpufreq_policy *policy)
 		return NULL;
 
 	ipolicy->policy = policy;
+	raw_spin_lock_init(&ipolicy->update_lock);
+	init_irq_work(&ipolicy->irq_work, irq_work);
+	spin_lock_init(&ipolicy->target_freq_lock);
 
 	return ipolicy;
 }
@@ -1200,7 +1048,6 @@ int cpufreq_interactive_init(struct cpufreq_policy *policy)
 	tunables->boostpulse_duration = DEFAULT_MIN_SAMPLE_TIME;
 	tunables->sampling_rate = DEFAULT_SAMPLING_RATE;
 	tunables->timer_slack = DEFAULT_TIMER_SLACK;
-	update_slack_delay(tunables);
 
 	spin_lock_init(&tunables->target_loads_lock);
 	spin_lock_init(&tunables->above_hispeed_delay_lock);
@@ -1214,13 +1061,6 @@ int cpufreq_interactive_init(struct cpufreq_policy *policy)
 	if (ret)
 		goto fail;
 
-	/* One time initialization for governor */
-	if (!interactive_gov.usage_count++) {
-		idle_notifier_register(&cpufreq_interactive_idle_nb);
-		cpufreq_register_notifier(&cpufreq_notifier_block,
-					  CPUFREQ_TRANSITION_NOTIFIER);
-	}
-
  out:
 	mutex_unlock(&global_tunables_lock);
 	return 0;
@@ -1246,13 +1086,6 @@ void cpufreq_interactive_exit(struct cpufreq_policy *policy)
 
 	mutex_lock(&global_tunables_lock);
 
-	/* Last policy using the governor ? */
-	if (!--interactive_gov.usage_count) {
-		cpufreq_unregister_notifier(&cpufreq_notifier_block,
-					    CPUFREQ_TRANSITION_NOTIFIER);
-		idle_notifier_unregister(&cpufreq_interactive_idle_nb);
-	}
-
 	count = gov_attr_set_put(&tunables->attr_set, &ipolicy->tunables_hook);
 	policy->governor_data = NULL;
 	if (!count)
@@ -1269,21 +1102,19 @@ int cpufreq_interactive_start(struct cpufreq_policy *policy)
 	struct interactive_cpu *icpu;
 	unsigned int cpu;
 
+	ipolicy->target_freq = policy->cur;
+	ipolicy->floor_freq = ipolicy->target_freq;
+	ipolicy->floor_validate_time = ktime_to_us(ktime_get());
+	ipolicy->hispeed_validate_time = ipolicy->floor_validate_time;
+	ipolicy->target_validate_time = ipolicy->floor_validate_time;
+	ipolicy->work_in_progress = false;
+
 	for_each_cpu(cpu, policy->cpus) {
 		icpu = &per_cpu(interactive_cpu, cpu);
 
-		icpu->target_freq = policy->cur;
-		icpu->floor_freq = icpu->target_freq;
-		icpu->pol_floor_val_time = ktime_to_us(ktime_get());
-		icpu->loc_floor_val_time = icpu->pol_floor_val_time;
-		icpu->pol_hispeed_val_time = icpu->pol_floor_val_time;
-		icpu->loc_hispeed_val_time = icpu->pol_floor_val_time;
-
 		down_write(&icpu->enable_sem);
 		icpu->ipolicy = ipolicy;
 		up_write(&icpu->enable_sem);
-
-		slack_timer_resched(icpu, cpu, false);
 	}
 
 	gov_set_update_util(ipolicy);
@@ -1298,11 +1129,12 @@ void cpufreq_interactive_stop(struct cpufreq_policy *policy)
 
 	gov_clear_update_util(ipolicy->policy);
 
+	irq_work_sync(&ipolicy->irq_work);
+	ipolicy->work_in_progress = false;
+
 	for_each_cpu(cpu, policy->cpus) {
 		icpu = &per_cpu(interactive_cpu, cpu);
 
-		icpu_cancel_work(icpu);
-
 		down_write(&icpu->enable_sem);
 		icpu->ipolicy = NULL;
 		up_write(&icpu->enable_sem);
@@ -1311,24 +1143,19 @@ void cpufreq_interactive_stop(struct cpufreq_policy *policy)
 
 void cpufreq_interactive_limits(struct cpufreq_policy *policy)
 {
-	struct interactive_cpu *icpu;
-	unsigned int cpu;
+	struct interactive_policy *ipolicy = policy->governor_data;
 	unsigned long flags;
 
 	cpufreq_policy_apply_limits(policy);
 
-	for_each_cpu(cpu, policy->cpus) {
-		icpu = &per_cpu(interactive_cpu, cpu);
-
-		spin_lock_irqsave(&icpu->target_freq_lock, flags);
+	spin_lock_irqsave(&ipolicy->target_freq_lock, flags);
 
-		if (policy->max < icpu->target_freq)
-			icpu->target_freq = policy->max;
-		else if (policy->min > icpu->target_freq)
-			icpu->target_freq = policy->min;
+	if (policy->max < ipolicy->target_freq)
+		ipolicy->target_freq = policy->max;
+	else if (policy->min > ipolicy->target_freq)
+		ipolicy->target_freq = policy->min;
 
-		spin_unlock_irqrestore(&icpu->target_freq_lock, flags);
-	}
+	spin_unlock_irqrestore(&ipolicy->target_freq_lock, flags);
 }
 
 static struct interactive_governor interactive_gov = {
@@ -1344,17 +1171,6 @@ static struct interactive_governor interactive_gov = {
 	}
 };
 
-static void cpufreq_interactive_nop_timer(unsigned long data)
-{
-	/*
-	 * The purpose of slack-timer is to wake up the CPU from IDLE, in order
-	 * to decrease its frequency if it is not set to minimum already.
-	 *
-	 * This is important for platforms where CPU with higher frequencies
-	 * consume higher power even at IDLE.
-	 */
-}
-
 static int __init cpufreq_interactive_gov_init(void)
 {
 	struct sched_param param = { .sched_priority = MAX_RT_PRIO - 1 };
@@ -1364,14 +1180,7 @@ static int __init cpufreq_interactive_gov_init(void)
 	for_each_possible_cpu(cpu) {
 		icpu = &per_cpu(interactive_cpu, cpu);
 
-		init_irq_work(&icpu->irq_work, irq_work);
-		spin_lock_init(&icpu->load_lock);
-		spin_lock_init(&icpu->target_freq_lock);
 		init_rwsem(&icpu->enable_sem);
-
-		/* Initialize per-cpu slack-timer */
-		init_timer_pinned(&icpu->slack_timer);
-		icpu->slack_timer.function = cpufreq_interactive_nop_timer;
 	}
 
 	spin_lock_init(&speedchange_cpumask_lock);
@@ -222,6 +222,9 @@ struct global_params {
  *			preference/bias
  * @epp_saved:		Saved EPP/EPB during system suspend or CPU offline
  *			operation
+ * @hwp_req_cached:	MSR_HWP_REQUEST value set by the policy, before boost
+ * @hwp_req_boosted:	MSR_HWP_REQUEST value last written to the CPU
+ * @hwp_boost:		Scheduler boost @hwp_req_boosted was computed for
  *
  * This structure stores per CPU instance data for all CPUs.
  */
@@ -254,6 +257,9 @@ struct cpudata {
 	s16 epp_policy;
 	s16 epp_default;
 	s16 epp_saved;
+	u64 hwp_req_cached;
+	u64 hwp_req_boosted;
+	int hwp_boost;
 };
 
 static struct cpudata **all_cpu_data;
@@ -285,6 +291,7 @@ struct pstate_funcs {
 static struct pstate_funcs pstate_funcs __read_mostly;
 
 static int hwp_active __read_mostly;
+static bool hwp_boost __read_mostly = IS_ENABLED(CONFIG_CGROUP_SCHEDTUNE);
 static bool per_cpu_limits __read_mostly;
 
 static struct cpufreq_driver *intel_pstate_driver __read_mostly;
@@ -486,6 +493,19 @@ static s16 intel_pstate_get_epb(struct cpudata *cpu_data)
 	return (s16)(epb & 0x0f);
 }
 
+/*
+ * The MSR may hold a boosted request, see intel_pstate_update_util_hwp(),
+ * so the policy side works on the value it wrote last.
+ */
+static int intel_pstate_hwp_read(struct cpudata *cpu_data, u64 *value)
+{
+	*value = READ_ONCE(cpu_data->hwp_req_cached);
+	if (*value)
+		return 0;
+
+	return rdmsrl_on_cpu(cpu_data->cpu, MSR_HWP_REQUEST, value);
+}
+
 static s16 intel_pstate_get_epp(struct cpudata *cpu_data, u64 hwp_req_data)
 {
 	s16 epp;
@@ -496,8 +516,7 @@ static s16 intel_pstate_get_epp(struct cpudata *cpu_data, u64 hwp_req_data)
 		 * MSR_HWP_REQUEST, so need to read and get EPP.
 		 */
 		if (!hwp_req_data) {
-			epp = rdmsrl_on_cpu(cpu_data->cpu, MSR_HWP_REQUEST,
-					    &hwp_req_data);
+			epp = intel_pstate_hwp_read(cpu_data, &hwp_req_data);
 			if (epp)
 				return epp;
 		}
@@ -547,6 +566,61 @@ static const char * const energy_perf_strings[] = {
 	"power",
 	NULL
 };
+/*
+ * Scale the request of the policy by the boost of the tasks on the CPU:
+ * a positive boost raises min-perf towards max-perf and EPP towards
+ * performance, a negative one moves EPP towards power saving.
+ */
+static u64 intel_pstate_hwp_boost_req(u64 value, int boost)
+{
+	int min = value & 0xff;
+	int max = (value >> 8) & 0xff;
+	int epp = (value >> 24) & 0xff;
+
+	if (!boost)
+		return value;
+
+	if (boost > 0) {
+		if (max > min)
+			min += (max - min) * boost / 100;
+		epp -= epp * boost / 100;
+	} else {
+		epp += (HWP_EPP_POWERSAVE - epp) * -boost / 100;
+	}
+
+	value &= ~HWP_MIN_PERF(~0L);
+	value |= HWP_MIN_PERF(min);
+	if (static_cpu_has(X86_FEATURE_HWP_EPP)) {
+		value &= ~GENMASK_ULL(31, 24);
+		value |= HWP_ENERGY_PERF_PREFERENCE(epp);
+	}
+
+	return value;
+}
+
+static void intel_pstate_hwp_request_local(void *data)
+{
+	struct cpudata *cpu = all_cpu_data[smp_processor_id()];
+	u64 value = *(u64 *)data;
+
+	cpu->hwp_req_cached = value;
+	cpu->hwp_boost = hwp_boost ? schedtune_cpufreq_boost(cpu->cpu) : 0;
+	cpu->hwp_req_boosted = intel_pstate_hwp_boost_req(value,
+							   cpu->hwp_boost);
+	wrmsrl(MSR_HWP_REQUEST, cpu->hwp_req_boosted);
+}
+
+/*
+ * Runs on the target CPU with interrupts disabled, like the scheduler
+ * callback, so the boosted request is always derived from the last one.
+ */
+static int intel_pstate_hwp_request(struct cpudata *cpu_data, u64 value)
+{
+	return smp_call_function_single(cpu_data->cpu,
+					intel_pstate_hwp_request_local,
+					&value, 1);
+}
+
 static const unsigned int epp_values[] = {
 	HWP_EPP_PERFORMANCE,
 	HWP_EPP_BALANCE_PERFORMANCE,
@@ -603,7 +677,7 @@ static int intel_pstate_set_energy_pref_index(struct cpudata *cpu_data,
 	if (static_cpu_has(X86_FEATURE_HWP_EPP)) {
 		u64 value;
 
-		ret = rdmsrl_on_cpu(cpu_data->cpu, MSR_HWP_REQUEST, &value);
+		ret = intel_pstate_hwp_read(cpu_data, &value);
 		if (ret)
 			goto return_pref;
 
@@ -613,7 +687,7 @@ static int intel_pstate_set_energy_pref_index(struct cpudata *cpu_data,
 			epp = epp_values[pref_index - 1];
 
 		value |= (u64)epp << 24;
-		ret = wrmsrl_on_cpu(cpu_data->cpu, MSR_HWP_REQUEST, value);
+		ret = intel_pstate_hwp_request(cpu_data, value);
 	} else {
 		if (epp == -EINVAL)
 			epp = (pref_index - 1) << 2;
@@ -711,7 +785,7 @@ static void intel_pstate_hwp_set(unsigned int cpu)
 	if (cpu_data->policy == CPUFREQ_POLICY_PERFORMANCE)
 		min = max;
 
-	rdmsrl_on_cpu(cpu, MSR_HWP_REQUEST, &value);
+	intel_pstate_hwp_read(cpu_data, &value);
 
 	value &= ~HWP_MIN_PERF(~0L);
 	value |= HWP_MIN_PERF(min);
@@ -764,7 +838,7 @@ static void intel_pstate_hwp_set(unsigned int cpu)
 		intel_pstate_set_epb(cpu, epp);
 	}
 skip_epp:
-	wrmsrl_on_cpu(cpu, MSR_HWP_REQUEST, value);
+	intel_pstate_hwp_request(cpu_data, value);
 }
 
 static int intel_pstate_hwp_save_state(struct cpufreq_policy *policy)
@@ -1075,6 +1149,8 @@ static void intel_pstate_hwp_enable(struct cpudata *cpudata)
 		wrmsrl_on_cpu(cpudata->cpu, MSR_HWP_INTERRUPT, 0x00);
 
 	wrmsrl_on_cpu(cpudata->cpu, MSR_PM_ENABLE, 0x1);
+	/* The request may have been reset, e.g. across suspend */
+	cpudata->hwp_req_cached = 0;
 	cpudata->epp_policy = 0;
 	if (cpudata->epp_default == -EINVAL)
 		cpudata->epp_default = intel_pstate_get_epp(cpudata, 0);
@@ -1556,6 +1632,36 @@ static void intel_pstate_update_util(struct update_util_data *data, u64 time,
 		intel_pstate_adjust_pstate(cpu);
 }
 
+/*
+ * With HWP the hardware picks the P-state, but the scheduler knows which
+ * tasks need to ramp up at once: apply their boost to the min-perf and EPP
+ * hints. The MSR is only written when the boost or the result changes, in
+ * a single write for both hints.
+ */
+static void intel_pstate_update_util_hwp(struct update_util_data *data,
+					 u64 time, unsigned int flags)
+{
+	struct cpudata *cpu = container_of(data, struct cpudata, update_util);
+	u64 value;
+	int boost;
+
+	/* Don't allow remote callbacks */
+	if (smp_processor_id() != cpu->cpu)
+		return;
+
+	boost = schedtune_cpufreq_boost(cpu->cpu);
+	if (boost == cpu->hwp_boost || !cpu->hwp_req_cached)
+		return;
+
+	cpu->hwp_boost = boost;
+	value = intel_pstate_hwp_boost_req(cpu->hwp_req_cached, boost);
+	if (value == cpu->hwp_req_boosted)
+		return;
+
+	cpu->hwp_req_boosted = value;
+	wrmsrl(MSR_HWP_REQUEST, value);
+}
+
 static struct pstate_funcs core_funcs = {
 	.get_max = core_get_max_pstate,
 	.get_max_physical = core_get_max_pstate_physical,
@@ -1688,7 +1794,7 @@ static void intel_pstate_set_update_util_hook(unsigned int cpu_num)
 {
 	struct cpudata *cpu = all_cpu_data[cpu_num];
 
-	if (hwp_active)
+	if (hwp_active && !hwp_boost)
 		return;
 
 	if (cpu->update_util_set)
@@ -1697,7 +1803,8 @@ static void intel_pstate_set_update_util_hook(unsigned int cpu_num)
 	/* Prevent intel_pstate_update_util() from using stale data. */
 	cpu->sample.time = 0;
 	cpufreq_add_update_util_hook(cpu_num, &cpu->update_util,
-				     intel_pstate_update_util);
+				     hwp_active ? intel_pstate_update_util_hwp :
+						  intel_pstate_update_util);
 	cpu->update_util_set = true;
 }
 
@@ -2344,6 +2451,8 @@ static int __init intel_pstate_setup(char *str)
 		hwp_only = 1;
 	if (!strcmp(str, "per_cpu_perf_limits"))
 		per_cpu_limits = true;
+	if (!strcmp(str, "no_hwp_boost"))
+		hwp_boost = false;
 
 #ifdef CONFIG_ACPI
 	if (!strcmp(str, "support_acpi_ppc"))
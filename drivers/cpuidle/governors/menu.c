@@ -22,6 +22,7 @@
 #include <linux/sched/stat.h>
 #include <linux/math64.h>
 #include <linux/cpu.h>
+#include <linux/interrupt.h>
 
 /*
  * Please note when changing the tuning values:
@@ -280,6 +281,39 @@ static unsigned int get_typical_interval(struct menu_device *data)
 	goto again;
 }
 
+#ifdef CONFIG_CPU_IDLE_GOV_MENU_IRQ
+/*
+ * Periodic device interrupts end the idle period just as a timer would,
+ * but the tick code does not know about them.  The irq timings keep the
+ * average interval of each interrupt on this cpu, as long as it stays
+ * regular enough to be predicted, and give the earliest one due.
+ */
+static unsigned int menu_next_irq_us(void)
+{
+	u64 now = local_clock();
+	u64 next_evt = irq_timings_next_event(now);
+
+	if (next_evt == U64_MAX)
+		return UINT_MAX;
+
+	return min_t(u64, div_u64(next_evt - now, NSEC_PER_USEC), UINT_MAX);
+}
+
+static void menu_irq_timings_enable(void)
+{
+	irq_timings_enable();
+}
+#else
+static inline unsigned int menu_next_irq_us(void)
+{
+	return UINT_MAX;
+}
+
+static inline void menu_irq_timings_enable(void)
+{
+}
+#endif
+
 /**
  * menu_select - selects the next idle state to enter
  * @drv: cpuidle driver containing state data
@@ -328,6 +362,7 @@ static int menu_select(struct cpuidle_driver *drv, struct cpuidle_device *dev)
 
 	expected_interval = get_typical_interval(data);
 	expected_interval = min(expected_interval, data->next_timer_us);
+	expected_interval = min(expected_interval, menu_next_irq_us());
 
 	first_idx = 0;
 	if (drv->states[0].flags & CPUIDLE_FLAG_POLLING) {
@@ -511,6 +546,8 @@ static struct cpuidle_governor menu_governor = {
  */
 static int __init init_menu(void)
 {
+	menu_irq_timings_enable();
+
 	return cpuidle_register_governor(&menu_governor);
 }
 
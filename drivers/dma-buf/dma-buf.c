@@ -598,6 +598,11 @@ void dma_buf_detach(struct dma_buf *dmabuf, struct dma_buf_attachment *attach)
 		return;
 
 	mutex_lock(&dmabuf->lock);
+	if (attach->sgt) {
+		WARN_ON(attach->map_count);
+		dmabuf->ops->unmap_dma_buf(attach, attach->sgt, attach->dir);
+		attach->sgt = NULL;
+	}
 	list_del(&attach->node);
 	if (dmabuf->ops->detach)
 		dmabuf->ops->detach(dmabuf, attach);
@@ -621,21 +626,54 @@ EXPORT_SYMBOL_GPL(dma_buf_detach);
  * the underlying backing storage is pinned for as long as a mapping exists,
  * therefore users/importers should not hold onto a mapping for undue amounts of
  * time.
+ *
+ * If the exporter sets &dma_buf_ops.cache_sgt_mapping, the mapping is kept
+ * in the attachment after it has been unmapped and returned again by the next
+ * call for the same @direction. A request for a different direction while the
+ * cached mapping is still in use gets an uncached mapping.
  */
 struct sg_table *dma_buf_map_attachment(struct dma_buf_attachment *attach,
 					enum dma_data_direction direction)
 {
 	struct sg_table *sg_table = ERR_PTR(-EINVAL);
+	struct dma_buf *dmabuf;
 
 	might_sleep();
 
 	if (WARN_ON(!attach || !attach->dmabuf))
 		return ERR_PTR(-EINVAL);
 
-	sg_table = attach->dmabuf->ops->map_dma_buf(attach, direction);
+	dmabuf = attach->dmabuf;
+	if (!dmabuf->ops->cache_sgt_mapping) {
+		sg_table = dmabuf->ops->map_dma_buf(attach, direction);
+		if (!sg_table)
+			sg_table = ERR_PTR(-ENOMEM);
+		return sg_table;
+	}
+
+	mutex_lock(&dmabuf->lock);
+	if (attach->sgt && !attach->sgt_stale && attach->dir == direction) {
+		attach->map_count++;
+		sg_table = attach->sgt;
+		goto out;
+	}
+
+	if (attach->sgt && !attach->map_count) {
+		dmabuf->ops->unmap_dma_buf(attach, attach->sgt, attach->dir);
+		attach->sgt = NULL;
+		attach->sgt_stale = false;
+	}
+
+	sg_table = dmabuf->ops->map_dma_buf(attach, direction);
 	if (!sg_table)
 		sg_table = ERR_PTR(-ENOMEM);
-
+	if (!IS_ERR(sg_table) && !attach->sgt) {
+		attach->sgt = sg_table;
+		attach->dir = direction;
+		attach->map_count = 1;
+	}
+out:
+	mutex_unlock(&dmabuf->lock);
 	return sg_table;
 }
 EXPORT_SYMBOL_GPL(dma_buf_map_attachment);
@@ -659,11 +697,65 @@ void dma_buf_unmap_attachment(struct dma_buf_attachment *attach,
 	if (WARN_ON(!attach || !attach->dmabuf || !sg_table))
 		return;
 
+	if (attach->dmabuf->ops->cache_sgt_mapping) {
+		struct dma_buf *dmabuf = attach->dmabuf;
+
+		mutex_lock(&dmabuf->lock);
+		if (sg_table == attach->sgt) {
+			if (!WARN_ON(!attach->map_count) &&
+			    !--attach->map_count && attach->sgt_stale) {
+				dmabuf->ops->unmap_dma_buf(attach, sg_table,
+							   attach->dir);
+				attach->sgt = NULL;
+				attach->sgt_stale = false;
+			}
+			mutex_unlock(&dmabuf->lock);
+			return;
+		}
+		mutex_unlock(&dmabuf->lock);
+	}
+
 	attach->dmabuf->ops->unmap_dma_buf(attach, sg_table,
 						direction);
 }
 EXPORT_SYMBOL_GPL(dma_buf_unmap_attachment);
 
+/**
+ * dma_buf_invalidate_mappings - drop the cached mappings of a buffer
+ * @dmabuf:	[in]	buffer whose backing storage moved
+ *
+ * Called by exporters using &dma_buf_ops.cache_sgt_mapping when the backing
+ * storage of @dmabuf changed. Cached mappings without users are released
+ * immediately, mappings still in use are released on their last unmap and
+ * no longer handed out. The &dma_buf_attachment.invalidate callback of each
+ * attachment is invoked so importers can drop any state derived from the old
+ * mapping.
+ */
+void dma_buf_invalidate_mappings(struct dma_buf *dmabuf)
+{
+	struct dma_buf_attachment *attach;
+
+	if (WARN_ON(!dmabuf))
+		return;
+
+	mutex_lock(&dmabuf->lock);
+	list_for_each_entry(attach, &dmabuf->attachments, node) {
+		if (attach->sgt) {
+			if (attach->map_count) {
+				attach->sgt_stale = true;
+			} else {
+				dmabuf->ops->unmap_dma_buf(attach, attach->sgt,
+							   attach->dir);
+				attach->sgt = NULL;
+			}
+		}
+		if (attach->invalidate)
+			attach->invalidate(attach);
+	}
+	mutex_unlock(&dmabuf->lock);
+}
+EXPORT_SYMBOL_GPL(dma_buf_invalidate_mappings);
+
 /**
  * DOC: cpu access
  *
@@ -22,14 +22,21 @@
 #include <linux/export.h>
 #include <linux/atomic.h>
 #include <linux/dma-fence.h>
+#include <linux/frame_trace.h>
 #include <linux/sched/signal.h>
+#include <linux/moduleparam.h>
+#include <linux/rculist.h>
+#include <linux/seq_file.h>
+#include <linux/stringhash.h>
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/dma_fence.h>
+#include <trace/events/frame.h>
 
 EXPORT_TRACEPOINT_SYMBOL(dma_fence_annotate_wait_on);
 EXPORT_TRACEPOINT_SYMBOL(dma_fence_emit);
 EXPORT_TRACEPOINT_SYMBOL(dma_fence_enable_signal);
+EXPORT_TRACEPOINT_SYMBOL_GPL(frame_stage);
 
 /*
  * fence context counter: each execution context should have its own
@@ -53,6 +60,140 @@ u64 dma_fence_context_alloc(unsigned num)
 }
 EXPORT_SYMBOL(dma_fence_context_alloc);
 
+#ifdef CONFIG_DMA_FENCE_STATS
+/*
+ * Per timeline (driver name plus timeline name) histograms of how long
+ * fences take from dma_fence_init to being signaled, and from being
+ * signaled to their last callback returning. Bucket n counts latencies
+ * below 2^n us. Timelines are added on first use and never removed, so
+ * the list is walked under RCU from the signaling path.
+ */
+#define DMA_FENCE_STATS_BUCKETS		20
+#define DMA_FENCE_STATS_MAX_TIMELINES	128
+#define DMA_FENCE_STATS_NAME_LEN	32
+
+struct dma_fence_stats {
+	struct list_head node;
+	unsigned int hash;
+	char driver[DMA_FENCE_STATS_NAME_LEN];
+	char timeline[DMA_FENCE_STATS_NAME_LEN];
+	atomic_long_t count;
+	atomic_t signal_hist[DMA_FENCE_STATS_BUCKETS];
+	atomic_t callback_hist[DMA_FENCE_STATS_BUCKETS];
+};
+
+static bool dma_fence_stats_enabled;
+module_param_named(stats, dma_fence_stats_enabled, bool, 0644);
+
+static LIST_HEAD(dma_fence_stats_list);
+static DEFINE_SPINLOCK(dma_fence_stats_lock);
+static unsigned int dma_fence_stats_count;
+
+static struct dma_fence_stats *dma_fence_stats_get(struct dma_fence *fence)
+{
+	const char *driver = fence->ops->get_driver_name(fence);
+	const char *timeline = fence->ops->get_timeline_name(fence);
+	struct dma_fence_stats *stats;
+	unsigned long flags;
+	unsigned int hash;
+
+	hash = full_name_hash(NULL, driver, strlen(driver)) ^
+	       full_name_hash(NULL, timeline, strlen(timeline));
+
+	list_for_each_entry_rcu(stats, &dma_fence_stats_list, node)
+		if (stats->hash == hash &&
+		    !strncmp(stats->driver, driver, sizeof(stats->driver)) &&
+		    !strncmp(stats->timeline, timeline, sizeof(stats->timeline)))
+			return stats;
+
+	if (READ_ONCE(dma_fence_stats_count) >= DMA_FENCE_STATS_MAX_TIMELINES)
+		return NULL;
+
+	stats = kzalloc(sizeof(*stats), GFP_ATOMIC);
+	if (!stats)
+		return NULL;
+	stats->hash = hash;
+	strlcpy(stats->driver, driver, sizeof(stats->driver));
+	strlcpy(stats->timeline, timeline, sizeof(stats->timeline));
+
+	/* a concurrent signaler may add the same timeline, that's harmless */
+	spin_lock_irqsave(&dma_fence_stats_lock, flags);
+	dma_fence_stats_count++;
+	list_add_tail_rcu(&stats->node, &dma_fence_stats_list);
+	spin_unlock_irqrestore(&dma_fence_stats_lock, flags);
+
+	return stats;
+}
+
+static void dma_fence_stats_hist(atomic_t *hist, ktime_t delta)
+{
+	s64 us = ktime_to_us(delta);
+	int bucket = us > 0 ? min(fls64(us), DMA_FENCE_STATS_BUCKETS - 1) : 0;
+
+	atomic_inc(&hist[bucket]);
+}
+
+static void dma_fence_stats_record(struct dma_fence *fence, bool callbacks)
+{
+	struct dma_fence_stats *stats;
+
+	if (!fence->init_time)
+		return;
+
+	rcu_read_lock();
+	stats = dma_fence_stats_get(fence);
+	if (stats) {
+		atomic_long_inc(&stats->count);
+		dma_fence_stats_hist(stats->signal_hist,
+				     ktime_sub(fence->timestamp,
+					       fence->init_time));
+		if (callbacks)
+			dma_fence_stats_hist(stats->callback_hist,
+					     ktime_sub(ktime_get(),
+						       fence->timestamp));
+	}
+	rcu_read_unlock();
+}
+
+static void dma_fence_stats_print_hist(struct seq_file *s, const char *what,
+				       atomic_t *hist)
+{
+	int i;
+
+	seq_printf(s, "  %s:", what);
+	for (i = 0; i < DMA_FENCE_STATS_BUCKETS; i++)
+		seq_printf(s, " %d", atomic_read(&hist[i]));
+	seq_putc(s, '\n');
+}
+
+/**
+ * dma_fence_stats_show - print the per timeline fence latency histograms
+ * @s:	[in]	seq_file to print to
+ */
+void dma_fence_stats_show(struct seq_file *s)
+{
+	struct dma_fence_stats *stats;
+
+	seq_printf(s, "recording %s, bucket n counts latencies < 2^n us\n",
+		   dma_fence_stats_enabled ? "on" : "off");
+	rcu_read_lock();
+	list_for_each_entry_rcu(stats, &dma_fence_stats_list, node) {
+		seq_printf(s, "%s %s: %ld fences\n", stats->driver,
+			   stats->timeline, atomic_long_read(&stats->count));
+		dma_fence_stats_print_hist(s, "init to signal",
+					   stats->signal_hist);
+		dma_fence_stats_print_hist(s, "signal to callbacks",
+					   stats->callback_hist);
+	}
+	rcu_read_unlock();
+}
+#else
+static inline void dma_fence_stats_record(struct dma_fence *fence,
+					  bool callbacks)
+{
+}
+#endif
+
 /**
  * dma_fence_signal_locked - signal completion of a fence
  * @fence: the fence to signal
@@ -68,6 +209,7 @@ EXPORT_SYMBOL(dma_fence_context_alloc);
 int dma_fence_signal_locked(struct dma_fence *fence)
 {
 	struct dma_fence_cb *cur, *tmp;
+	bool callbacks;
 	int ret = 0;
 
 	lockdep_assert_held(fence->lock);
@@ -86,12 +228,16 @@ int dma_fence_signal_locked(struct dma_fence *fence)
 		fence->timestamp = ktime_get();
 		set_bit(DMA_FENCE_FLAG_TIMESTAMP_BIT, &fence->flags);
 		trace_dma_fence_signaled(fence);
+		trace_frame_stage(fence->frame_id, FRAME_STAGE_FENCE_SIGNAL);
 	}
 
+	callbacks = !list_empty(&fence->cb_list);
 	list_for_each_entry_safe(cur, tmp, &fence->cb_list, node) {
 		list_del_init(&cur->node);
 		cur->func(fence, cur);
 	}
+	if (!ret)
+		dma_fence_stats_record(fence, callbacks);
 	return ret;
 }
 EXPORT_SYMBOL(dma_fence_signal_locked);
@@ -119,16 +265,22 @@ int dma_fence_signal(struct dma_fence *fence)
 	fence->timestamp = ktime_get();
 	set_bit(DMA_FENCE_FLAG_TIMESTAMP_BIT, &fence->flags);
 	trace_dma_fence_signaled(fence);
+	trace_frame_stage(fence->frame_id, FRAME_STAGE_FENCE_SIGNAL);
 
 	if (test_bit(DMA_FENCE_FLAG_ENABLE_SIGNAL_BIT, &fence->flags)) {
 		struct dma_fence_cb *cur, *tmp;
+		bool callbacks;
 
 		spin_lock_irqsave(fence->lock, flags);
+		callbacks = !list_empty(&fence->cb_list);
 		list_for_each_entry_safe(cur, tmp, &fence->cb_list, node) {
 			list_del_init(&cur->node);
 			cur->func(fence, cur);
 		}
 		spin_unlock_irqrestore(fence->lock, flags);
+		dma_fence_stats_record(fence, callbacks);
+	} else {
+		dma_fence_stats_record(fence, false);
 	}
 	return 0;
 }
@@ -575,6 +727,10 @@ dma_fence_init(struct dma_fence *fence, const struct dma_fence_ops *ops,
 	fence->seqno = seqno;
 	fence->flags = 0UL;
 	fence->error = 0;
+	fence->frame_id = frame_trace_id();
+#ifdef CONFIG_DMA_FENCE_STATS
+	fence->init_time = READ_ONCE(dma_fence_stats_enabled) ? ktime_get() : 0;
+#endif
 
 	trace_dma_fence_init(fence);
 }
@@ -34,6 +34,8 @@
 
 #include <linux/reservation.h>
 #include <linux/export.h>
+#include <linux/sched/signal.h>
+#include <linux/slab.h>
 
 /**
  * DOC: Reservation Object Overview
@@ -496,6 +498,213 @@ long reservation_object_wait_timeout_rcu(struct reservation_object *obj,
 }
 EXPORT_SYMBOL_GPL(reservation_object_wait_timeout_rcu);
 
+static bool reservation_fence_collect(struct dma_fence *fence,
+				      struct dma_fence **fences,
+				      unsigned int *count, unsigned int max,
+				      bool *retry)
+{
+	if (test_bit(DMA_FENCE_FLAG_SIGNALED_BIT, &fence->flags))
+		return true;
+
+	if (*count == max)
+		return false;
+
+	if (!dma_fence_get_rcu(fence)) {
+		*retry = true;
+		return false;
+	}
+
+	if (dma_fence_is_signaled(fence)) {
+		dma_fence_put(fence);
+		return true;
+	}
+
+	fences[(*count)++] = fence;
+	return true;
+}
+
+struct reservation_multi_wait {
+	struct dma_fence_cb base;
+	struct task_struct *task;
+	atomic_t *pending;
+};
+
+static void reservation_multi_wait_cb(struct dma_fence *fence,
+				      struct dma_fence_cb *cb)
+{
+	struct reservation_multi_wait *wait =
+		container_of(cb, struct reservation_multi_wait, base);
+
+	if (atomic_dec_and_test(wait->pending))
+		wake_up_state(wait->task, TASK_NORMAL);
+}
+
+static long reservation_wait_fences(struct dma_fence **fences,
+				    unsigned int count, bool intr, long ret)
+{
+	struct reservation_multi_wait *cb;
+	atomic_t pending = ATOMIC_INIT(1);
+	unsigned int i;
+
+	cb = kcalloc(count, sizeof(*cb), GFP_KERNEL);
+	if (!cb)
+		return -ENOMEM;
+
+	/*
+	 * One callback per fence on a shared counter, so the task sleeps once
+	 * for the whole set. Fences that implement their own wait are waited
+	 * on individually afterwards.
+	 */
+	for (i = 0; i < count; i++) {
+		cb[i].task = current;
+		cb[i].pending = &pending;
+		INIT_LIST_HEAD(&cb[i].base.node);
+		if (fences[i]->ops->wait != dma_fence_default_wait)
+			continue;
+
+		atomic_inc(&pending);
+		if (dma_fence_add_callback(fences[i], &cb[i].base,
+					   reservation_multi_wait_cb))
+			atomic_dec(&pending);
+	}
+
+	if (!atomic_dec_and_test(&pending)) {
+		while (ret > 0) {
+			set_current_state(intr ? TASK_INTERRUPTIBLE :
+						 TASK_UNINTERRUPTIBLE);
+			if (!atomic_read(&pending))
+				break;
+
+			ret = schedule_timeout(ret);
+
+			if (ret > 0 && intr && signal_pending(current))
+				ret = -ERESTARTSYS;
+		}
+		__set_current_state(TASK_RUNNING);
+	}
+
+	for (i = 0; i < count; i++)
+		dma_fence_remove_callback(fences[i], &cb[i].base);
+	kfree(cb);
+
+	for (i = 0; i < count && ret > 0; i++) {
+		if (fences[i]->ops->wait != dma_fence_default_wait)
+			ret = dma_fence_wait_timeout(fences[i], intr, ret);
+	}
+
+	return ret;
+}
+
+/**
+ * reservation_object_wait_timeout_multi_rcu - Wait on the fences of several
+ * reservation objects at once.
+ * @objs: array of reservation objects
+ * @num_objs: number of entries in @objs
+ * @wait_all: if true, wait on all fences of every object, else wait on just
+ * the exclusive fences
+ * @intr: if true, do interruptible wait
+ * @timeout: timeout value in jiffies or zero to return immediately
+ *
+ * Collects the unsignaled fences of all objects in a single RCU pass and then
+ * sleeps once until all of them have signaled, instead of calling
+ * reservation_object_wait_timeout_rcu() and restarting the timeout for each
+ * object.
+ *
+ * RETURNS
+ * Returns -ERESTARTSYS if interrupted, -ENOMEM if the fence array could not be
+ * allocated, 0 if the wait timed out, or greater than zero on success.
+ */
+long reservation_object_wait_timeout_multi_rcu(struct reservation_object **objs,
+					       unsigned int num_objs,
+					       bool wait_all, bool intr,
+					       unsigned long timeout)
+{
+	struct dma_fence **fences = NULL;
+	unsigned int max = 0, count, i, j;
+	long ret = timeout ? timeout : 1;
+	bool retry, grow;
+
+retry:
+	count = 0;
+	retry = false;
+	grow = false;
+	rcu_read_lock();
+	for (i = 0; i < num_objs; i++) {
+		struct reservation_object *obj = objs[i];
+		struct reservation_object_list *fobj = NULL;
+		unsigned int first = count, shared_count = 0;
+		struct dma_fence *fence;
+		unsigned int seq;
+
+		seq = read_seqcount_begin(&obj->seq);
+
+		if (wait_all) {
+			fobj = rcu_dereference(obj->fence);
+			if (fobj)
+				shared_count = fobj->shared_count;
+		}
+
+		fence = rcu_dereference(obj->fence_excl);
+		if (fence && !reservation_fence_collect(fence, fences, &count,
+							max, &retry))
+			goto unlock;
+
+		for (j = 0; j < shared_count; j++) {
+			fence = rcu_dereference(fobj->shared[j]);
+			if (!reservation_fence_collect(fence, fences, &count,
+						       max, &retry))
+				goto unlock;
+		}
+
+		if (read_seqcount_retry(&obj->seq, seq)) {
+			while (count > first)
+				dma_fence_put(fences[--count]);
+			i--;
+		}
+		continue;
+
+unlock:
+		/* Either a fence was being freed or we are out of room */
+		grow = !retry;
+		retry = true;
+		break;
+	}
+	rcu_read_unlock();
+
+	if (retry) {
+		while (count)
+			dma_fence_put(fences[--count]);
+
+		if (grow) {
+			struct dma_fence **nfences;
+
+			max = max * 2 + num_objs;
+			nfences = krealloc(fences, max * sizeof(*fences),
+					   GFP_KERNEL);
+			if (!nfences) {
+				kfree(fences);
+				return -ENOMEM;
+			}
+			fences = nfences;
+		}
+		goto retry;
+	}
+
+	if (count) {
+		if (timeout)
+			ret = reservation_wait_fences(fences, count, intr, ret);
+		else
+			ret = 0;
+
+		while (count)
+			dma_fence_put(fences[--count]);
+	}
+	kfree(fences);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(reservation_object_wait_timeout_multi_rcu);
+
 
 static inline int
 reservation_object_test_signaled_single(struct dma_fence *passed_fence)
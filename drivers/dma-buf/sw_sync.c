@@ -16,6 +16,8 @@
 
 #include <linux/file.h>
 #include <linux/fs.h>
+#include <linux/ktime.h>
+#include <linux/mm.h>
 #include <linux/uaccess.h>
 #include <linux/slab.h>
 #include <linux/sync_file.h>
@@ -50,6 +52,13 @@
  * from the timeline and signal any fence that has a seqno smaller or equal
  * to it.
  *
+ * SW_SYNC_IOC_BATCH creates @count points in one call, spaced @step apart
+ * after the current timeline value, then increments the timeline by @inc
+ * and reports how long that took. With SW_SYNC_BATCH_BENCHMARK the points
+ * are not returned as fds; each gets a callback attached and is dropped
+ * again after signaling, which measures the signal fan-out cost for many
+ * outstanding points.
+ *
  * struct sw_sync_ioctl_create_fence
  * @value:	the seqno to initialise the fence with
  * @name:	the name of the new sync point
@@ -61,6 +70,31 @@ struct sw_sync_create_fence_data {
 	__s32	fence; /* fd of new fence */
 };
 
+/*
+ * struct sw_sync_batch_data
+ * @count:	number of points to create, at most SW_SYNC_BATCH_MAX
+ * @step:	seqno distance between consecutive points
+ * @inc:	timeline increment once all points are created
+ * @flags:	SW_SYNC_BATCH_* flags
+ * @fences:	user pointer to @count __s32, filled with the new fds
+ *		unless SW_SYNC_BATCH_BENCHMARK is set
+ * @signal_ns:	return the time spent incrementing the timeline
+ * @signaled:	return the number of new points that signaled
+ */
+struct sw_sync_batch_data {
+	__u32	count;
+	__u32	step;
+	__u32	inc;
+	__u32	flags;
+	__u64	fences;
+	__u64	signal_ns;
+	__u32	signaled;
+	__u32	pad;
+};
+
+#define SW_SYNC_BATCH_BENCHMARK	(1 << 0)
+#define SW_SYNC_BATCH_MAX	(1 << 16)
+
 #define SW_SYNC_IOC_MAGIC	'W'
 
 #define SW_SYNC_IOC_CREATE_FENCE	_IOWR(SW_SYNC_IOC_MAGIC, 0,\
@@ -68,6 +102,9 @@ struct sw_sync_create_fence_data {
 
 #define SW_SYNC_IOC_INC			_IOW(SW_SYNC_IOC_MAGIC, 1, __u32)
 
+#define SW_SYNC_IOC_BATCH		_IOWR(SW_SYNC_IOC_MAGIC, 2,\
+		struct sw_sync_batch_data)
+
 static const struct dma_fence_ops timeline_fence_ops;
 
 static inline struct sync_pt *dma_fence_to_sync_pt(struct dma_fence *fence)
@@ -399,6 +436,123 @@ static long sw_sync_ioctl_inc(struct sync_timeline *obj, unsigned long arg)
 	return 0;
 }
 
+struct sw_sync_batch_pt {
+	struct sync_pt *pt;
+	union {
+		struct dma_fence_cb cb;
+		struct {
+			struct sync_file *sync_file;
+			int fd;
+		};
+	};
+	atomic_t *signaled;
+};
+
+static void sw_sync_batch_cb(struct dma_fence *fence, struct dma_fence_cb *cb)
+{
+	struct sw_sync_batch_pt *bpt = container_of(cb, typeof(*bpt), cb);
+
+	atomic_inc(bpt->signaled);
+}
+
+static long sw_sync_ioctl_batch(struct sync_timeline *obj, unsigned long arg)
+{
+	struct sw_sync_batch_data data;
+	struct sw_sync_batch_pt *pts;
+	bool bench;
+	s32 __user *ufds;
+	atomic_t signaled = ATOMIC_INIT(0);
+	unsigned int value, i, n = 0;
+	ktime_t start;
+	long err = 0;
+
+	if (copy_from_user(&data, (void __user *)arg, sizeof(data)))
+		return -EFAULT;
+
+	if (!data.count || data.count > SW_SYNC_BATCH_MAX ||
+	    data.flags & ~SW_SYNC_BATCH_BENCHMARK || data.pad)
+		return -EINVAL;
+
+	bench = data.flags & SW_SYNC_BATCH_BENCHMARK;
+	ufds = u64_to_user_ptr(data.fences);
+	pts = kvmalloc_array(data.count, sizeof(*pts), GFP_KERNEL);
+	if (!pts)
+		return -ENOMEM;
+
+	spin_lock_irq(&obj->lock);
+	value = obj->value;
+	spin_unlock_irq(&obj->lock);
+
+	for (n = 0; n < data.count; n++) {
+		struct sw_sync_batch_pt *bpt = &pts[n];
+
+		value += data.step;
+		bpt->pt = sync_pt_create(obj, value);
+		if (!bpt->pt) {
+			err = -ENOMEM;
+			goto out;
+		}
+		bpt->signaled = &signaled;
+		if (bench &&
+		    dma_fence_add_callback(&bpt->pt->base, &bpt->cb,
+					   sw_sync_batch_cb))
+			INIT_LIST_HEAD(&bpt->cb.node);
+	}
+
+	if (!bench) {
+		for (i = 0; i < data.count; i++) {
+			pts[i].fd = get_unused_fd_flags(O_CLOEXEC);
+			if (pts[i].fd < 0) {
+				err = pts[i].fd;
+				break;
+			}
+			pts[i].sync_file = sync_file_create(&pts[i].pt->base);
+			if (!pts[i].sync_file) {
+				put_unused_fd(pts[i].fd);
+				err = -ENOMEM;
+				break;
+			}
+			if (put_user(pts[i].fd, &ufds[i])) {
+				i++;
+				err = -EFAULT;
+				break;
+			}
+		}
+		if (err) {
+			while (i--) {
+				fput(pts[i].sync_file->file);
+				put_unused_fd(pts[i].fd);
+			}
+			goto out;
+		}
+		for (i = 0; i < data.count; i++)
+			fd_install(pts[i].fd, pts[i].sync_file->file);
+	}
+
+	start = ktime_get();
+	sync_timeline_signal(obj, data.inc);
+	data.signal_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	if (bench) {
+		data.signaled = atomic_read(&signaled);
+	} else {
+		for (data.signaled = i = 0; i < data.count; i++)
+			data.signaled += dma_fence_is_signaled(&pts[i].pt->base);
+	}
+
+	if (copy_to_user((void __user *)arg, &data, sizeof(data)))
+		err = -EFAULT;
+
+out:
+	for (i = 0; i < n; i++) {
+		if (bench)
+			dma_fence_remove_callback(&pts[i].pt->base, &pts[i].cb);
+		dma_fence_put(&pts[i].pt->base);
+	}
+	kvfree(pts);
+	return err;
+}
+
 static long sw_sync_ioctl(struct file *file, unsigned int cmd,
 			  unsigned long arg)
 {
@@ -411,6 +565,9 @@ static long sw_sync_ioctl(struct file *file, unsigned int cmd,
 	case SW_SYNC_IOC_INC:
 		return sw_sync_ioctl_inc(obj, arg);
 
+	case SW_SYNC_IOC_BATCH:
+		return sw_sync_ioctl_batch(obj, arg);
+
 	default:
 		return -ENOTTY;
 	}
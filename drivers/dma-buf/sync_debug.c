@@ -190,6 +190,26 @@ static const struct file_operations sync_info_debugfs_fops = {
 	.release        = single_release,
 };
 
+#ifdef CONFIG_DMA_FENCE_STATS
+static int sync_fence_stats_show(struct seq_file *s, void *unused)
+{
+	dma_fence_stats_show(s);
+	return 0;
+}
+
+static int sync_fence_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, sync_fence_stats_show, inode->i_private);
+}
+
+static const struct file_operations sync_fence_stats_fops = {
+	.open           = sync_fence_stats_open,
+	.read           = seq_read,
+	.llseek         = seq_lseek,
+	.release        = single_release,
+};
+#endif
+
 static __init int sync_debugfs_init(void)
 {
 	dbgfs = debugfs_create_dir("sync", NULL);
@@ -203,6 +223,10 @@ static __init int sync_debugfs_init(void)
 				   &sync_info_debugfs_fops);
 	debugfs_create_file_unsafe("sw_sync", 0644, dbgfs, NULL,
 				   &sw_sync_debugfs_fops);
+#ifdef CONFIG_DMA_FENCE_STATS
+	debugfs_create_file_unsafe("fence_stats", 0444, dbgfs, NULL,
+				   &sync_fence_stats_fops);
+#endif
 
 	return 0;
 }
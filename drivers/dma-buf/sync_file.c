@@ -14,17 +14,22 @@
  *
  */
 
+#include <linux/debugfs.h>
 #include <linux/export.h>
 #include <linux/file.h>
+#include <linux/frame_trace.h>
 #include <linux/fs.h>
 #include <linux/kernel.h>
 #include <linux/poll.h>
 #include <linux/sched.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
+#include <linux/sort.h>
 #include <linux/uaccess.h>
 #include <linux/anon_inodes.h>
 #include <linux/sync_file.h>
 #include <uapi/linux/sync_file.h>
+#include <trace/events/frame.h>
 
 static const struct file_operations sync_file_fops;
 
@@ -79,6 +84,7 @@ struct sync_file *sync_file_create(struct dma_fence *fence)
 		return NULL;
 
 	sync_file->fence = dma_fence_get(fence);
+	trace_frame_stage(fence->frame_id, FRAME_STAGE_FENCE_EXPORT);
 
 	return sync_file;
 }
@@ -195,15 +201,50 @@ static struct dma_fence **get_fences(struct sync_file *sync_file,
 	return &sync_file->fence;
 }
 
-static void add_fence(struct dma_fence **fences,
-		      int *i, struct dma_fence *fence)
+/*
+ * Merge statistics, shown in debugfs: how many merges reused one of their
+ * inputs instead of building a new fence array, and how many fences were
+ * left out because they had signaled or were superseded by a later fence
+ * on the same context.
+ */
+static struct {
+	atomic_long_t merges;
+	atomic_long_t reused;
+	atomic_long_t signaled;
+	atomic_long_t collapsed;
+} merge_stats;
+
+static int fence_cmp(const void *_a, const void *_b)
+{
+	const struct dma_fence *a = *(const struct dma_fence **)_a;
+	const struct dma_fence *b = *(const struct dma_fence **)_b;
+
+	if (a->context != b->context)
+		return a->context < b->context ? -1 : 1;
+	/* latest first, so that duplicates can be dropped after the first */
+	if (a->seqno == b->seqno)
+		return 0;
+	return __dma_fence_is_later(a->seqno, b->seqno) ? -1 : 1;
+}
+
+static int add_fences(struct dma_fence **fences, int i,
+		      struct dma_fence **src, int num)
 {
-	fences[*i] = fence;
+	int j;
 
-	if (!dma_fence_is_signaled(fence)) {
-		dma_fence_get(fence);
-		(*i)++;
+	for (j = 0; j < num; j++) {
+		if (dma_fence_is_signaled(src[j]))
+			atomic_long_inc(&merge_stats.signaled);
+		else
+			fences[i++] = src[j];
 	}
+
+	return i;
+}
+
+static bool same_fences(struct dma_fence **a, struct dma_fence **b, int num)
+{
+	return !memcmp(a, b, num * sizeof(*a));
 }
 
 /**
@@ -215,13 +256,17 @@ static void add_fence(struct dma_fence **fences,
  * Creates a new sync_file which contains copies of all the fences in both
  * @a and @b.  @a and @b remain valid, independent sync_file. Returns the
  * new merged sync_file or NULL in case of error.
+ *
+ * Signaled fences are dropped and only the latest fence of each context is
+ * kept. If that leaves exactly the fences of @a or @b, the new sync_file
+ * shares their fence instead of allocating a new fence array.
  */
 static struct sync_file *sync_file_merge(const char *name, struct sync_file *a,
 					 struct sync_file *b)
 {
 	struct sync_file *sync_file;
-	struct dma_fence **fences, **nfences, **a_fences, **b_fences;
-	int i, i_a, i_b, num_fences, a_num_fences, b_num_fences;
+	struct dma_fence **fences, **a_fences, **b_fences;
+	int i, j, num_fences, a_num_fences, b_num_fences;
 
 	sync_file = sync_file_alloc();
 	if (!sync_file)
@@ -230,7 +275,7 @@ static struct sync_file *sync_file_merge(const char *name, struct sync_file *a,
 	a_fences = get_fences(a, &a_num_fences);
 	b_fences = get_fences(b, &b_num_fences);
 	if (a_num_fences > INT_MAX - b_num_fences)
-		return NULL;
+		goto err;
 
 	num_fences = a_num_fences + b_num_fences;
 
@@ -239,58 +284,55 @@ static struct sync_file *sync_file_merge(const char *name, struct sync_file *a,
 		goto err;
 
 	/*
-	 * Assume sync_file a and b are both ordered and have no
-	 * duplicates with the same context.
-	 *
-	 * If a sync_file can only be created with sync_file_merge
-	 * and sync_file_create, this is a reasonable assumption.
+	 * Don't rely on either input being ordered or free of duplicates,
+	 * fence arrays may also come from drivers through sync_file_create.
 	 */
-	for (i = i_a = i_b = 0; i_a < a_num_fences && i_b < b_num_fences; ) {
-		struct dma_fence *pt_a = a_fences[i_a];
-		struct dma_fence *pt_b = b_fences[i_b];
-
-		if (pt_a->context < pt_b->context) {
-			add_fence(fences, &i, pt_a);
-
-			i_a++;
-		} else if (pt_a->context > pt_b->context) {
-			add_fence(fences, &i, pt_b);
-
-			i_b++;
-		} else {
-			if (pt_a->seqno - pt_b->seqno <= INT_MAX)
-				add_fence(fences, &i, pt_a);
-			else
-				add_fence(fences, &i, pt_b);
-
-			i_a++;
-			i_b++;
+	i = add_fences(fences, 0, a_fences, a_num_fences);
+	i = add_fences(fences, i, b_fences, b_num_fences);
+	sort(fences, i, sizeof(*fences), fence_cmp, NULL);
+	for (num_fences = j = 0; j < i; j++) {
+		if (num_fences &&
+		    fences[num_fences - 1]->context == fences[j]->context) {
+			atomic_long_inc(&merge_stats.collapsed);
+			continue;
 		}
+		fences[num_fences++] = fences[j];
 	}
-
-	for (; i_a < a_num_fences; i_a++)
-		add_fence(fences, &i, a_fences[i_a]);
-
-	for (; i_b < b_num_fences; i_b++)
-		add_fence(fences, &i, b_fences[i_b]);
-
-	if (i == 0)
-		fences[i++] = dma_fence_get(a_fences[0]);
-
-	if (num_fences > i) {
-		nfences = krealloc(fences, i * sizeof(*fences),
-				  GFP_KERNEL);
-		if (!nfences)
-			goto err;
-
-		fences = nfences;
+	atomic_long_inc(&merge_stats.merges);
+
+	if (num_fences == 0) {
+		fences[num_fences++] = a_fences[0];
+	} else if (num_fences > 1 && (num_fences == a_num_fences ||
+				      num_fences == b_num_fences)) {
+		struct sync_file *same = NULL;
+
+		/* get_fences() of a merged sync_file is already sorted */
+		if (num_fences == a_num_fences &&
+		    same_fences(fences, a_fences, num_fences))
+			same = a;
+		else if (num_fences == b_num_fences &&
+			 same_fences(fences, b_fences, num_fences))
+			same = b;
+
+		if (same) {
+			atomic_long_inc(&merge_stats.reused);
+			kfree(fences);
+			sync_file->fence = dma_fence_get(same->fence);
+			goto out;
+		}
 	}
 
-	if (sync_file_set_fence(sync_file, fences, i) < 0) {
+	for (j = 0; j < num_fences; j++)
+		dma_fence_get(fences[j]);
+
+	if (sync_file_set_fence(sync_file, fences, num_fences) < 0) {
+		for (j = 0; j < num_fences; j++)
+			dma_fence_put(fences[j]);
 		kfree(fences);
 		goto err;
 	}
 
+out:
 	strlcpy(sync_file->user_name, name, sizeof(sync_file->user_name));
 	return sync_file;
 
@@ -490,3 +532,36 @@ static const struct file_operations sync_file_fops = {
 	.unlocked_ioctl = sync_file_ioctl,
 	.compat_ioctl = sync_file_ioctl,
 };
+
+#ifdef CONFIG_DEBUG_FS
+static int sync_file_merge_stats_show(struct seq_file *s, void *unused)
+{
+	seq_printf(s, "merges: %ld\n", atomic_long_read(&merge_stats.merges));
+	seq_printf(s, "reused: %ld\n", atomic_long_read(&merge_stats.reused));
+	seq_printf(s, "signaled dropped: %ld\n",
+		   atomic_long_read(&merge_stats.signaled));
+	seq_printf(s, "same context collapsed: %ld\n",
+		   atomic_long_read(&merge_stats.collapsed));
+	return 0;
+}
+
+static int sync_file_merge_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, sync_file_merge_stats_show, NULL);
+}
+
+static const struct file_operations sync_file_merge_stats_fops = {
+	.open           = sync_file_merge_stats_open,
+	.read           = seq_read,
+	.llseek         = seq_lseek,
+	.release        = single_release,
+};
+
+static __init int sync_file_debugfs_init(void)
+{
+	debugfs_create_file("sync_file_merge", 0444, NULL, NULL,
+			    &sync_file_merge_stats_fops);
+	return 0;
+}
+late_initcall(sync_file_debugfs_init);
+#endif
@@ -35,6 +35,7 @@
  */
 
 #include <linux/slab.h>
+#include <linux/jhash.h>
 #include "i915_drv.h"
 #include "gvt.h"
 #include "i915_pvinfo.h"
@@ -475,6 +476,14 @@ struct parser_exec_state {
 	struct cmd_info *info;
 
 	struct intel_vgpu_workload *workload;
+
+	/* ring level batch buffer to be added to the cache at its end */
+	struct intel_shadow_bb_entry *bb_cache_entry;
+	void *bb_cache_guest;
+	unsigned long bb_cache_gma;
+	u32 bb_cache_hash;
+	bool bb_cacheable;
+	DECLARE_BITMAP(bb_saved_events, INTEL_GVT_EVENT_MAX);
 };
 
 #define gmadr_dw_number(s)	\
@@ -1058,6 +1067,166 @@ static int cmd_advance_default(struct parser_exec_state *s)
 	return ip_gma_advance(s, cmd_length(s));
 }
 
+/*
+ * Guest drivers tend to resubmit the very same batch buffers, so the audited
+ * shadow of a ring level batch is kept around and handed out again when the
+ * guest submits identical contents at the same address, skipping the copy
+ * into a fresh object and the command scan. The hash only narrows down the
+ * lookup; a hit always compares the full contents against the copy of the
+ * guest batch taken when it was audited.
+ */
+#define GVT_BB_CACHE_MAX_ENTRIES 64
+#define GVT_BB_CACHE_MAX_LEN SZ_1M
+
+struct intel_vgpu_cached_bb {
+	struct hlist_node hnode;
+	struct list_head link;
+
+	int ring_id;
+	unsigned long gma;
+	u32 len;
+	u32 hash;
+
+	/* guest contents at the time of the audit */
+	void *guest;
+	/* audited, and possibly patched, shadow */
+	struct drm_i915_gem_object *obj;
+	/* virtual events raised by the commands in the batch */
+	DECLARE_BITMAP(events, INTEL_GVT_EVENT_MAX);
+};
+
+static void bb_cache_free(struct intel_vgpu_bb_cache *cache,
+			  struct intel_vgpu_cached_bb *cached)
+{
+	hash_del(&cached->hnode);
+	list_del(&cached->link);
+	cache->count--;
+
+	i915_gem_object_unpin_map(cached->obj);
+	i915_gem_object_put(cached->obj);
+	kvfree(cached->guest);
+	kfree(cached);
+}
+
+static struct intel_vgpu_cached_bb *
+bb_cache_lookup(struct intel_vgpu *vgpu, int ring_id, unsigned long gma,
+		u32 len, u32 hash, const void *guest)
+{
+	struct intel_vgpu_cached_bb *cached;
+
+	hash_for_each_possible(vgpu->bb_cache.ht, cached, hnode, hash) {
+		if (cached->hash == hash && cached->ring_id == ring_id &&
+		    cached->gma == gma && cached->len == len &&
+		    !memcmp(cached->guest, guest, len))
+			return cached;
+	}
+
+	return NULL;
+}
+
+static int bb_cache_reuse(struct parser_exec_state *s,
+			  struct intel_vgpu_cached_bb *cached)
+{
+	struct intel_vgpu_bb_cache *cache = &s->vgpu->bb_cache;
+	struct intel_shadow_bb_entry *entry_obj;
+	void *va;
+
+	entry_obj = kmalloc(sizeof(*entry_obj), GFP_KERNEL);
+	if (!entry_obj)
+		return -ENOMEM;
+
+	va = i915_gem_object_pin_map(cached->obj, I915_MAP_WB);
+	if (IS_ERR(va)) {
+		kfree(entry_obj);
+		return PTR_ERR(va);
+	}
+
+	entry_obj->obj = i915_gem_object_get(cached->obj);
+	entry_obj->vma = NULL;
+	entry_obj->va = va;
+	entry_obj->len = cached->len;
+	entry_obj->bb_start_cmd_va = s->ip_va;
+	list_add(&entry_obj->list, &s->workload->shadow_bb);
+
+	bitmap_or(s->workload->pending_events, s->workload->pending_events,
+		  cached->events, INTEL_GVT_EVENT_MAX);
+
+	list_move(&cached->link, &cache->lru);
+	cache->hits++;
+
+	return 0;
+}
+
+static void bb_cache_commit(struct parser_exec_state *s)
+{
+	struct intel_vgpu_bb_cache *cache = &s->vgpu->bb_cache;
+	struct intel_shadow_bb_entry *entry_obj = s->bb_cache_entry;
+	unsigned long *events = s->workload->pending_events;
+	struct intel_vgpu_cached_bb *cached;
+	void *va;
+
+	s->bb_cache_entry = NULL;
+
+	if (!s->bb_cacheable)
+		goto out;
+
+	cached = kmalloc(sizeof(*cached), GFP_KERNEL);
+	if (!cached)
+		goto out;
+
+	va = i915_gem_object_pin_map(entry_obj->obj, I915_MAP_WB);
+	if (IS_ERR(va)) {
+		kfree(cached);
+		goto out;
+	}
+
+	cached->ring_id = s->ring_id;
+	cached->gma = s->bb_cache_gma;
+	cached->len = entry_obj->len;
+	cached->hash = s->bb_cache_hash;
+	cached->guest = fetch_and_zero(&s->bb_cache_guest);
+	cached->obj = i915_gem_object_get(entry_obj->obj);
+	bitmap_copy(cached->events, events, INTEL_GVT_EVENT_MAX);
+
+	hash_add(cache->ht, &cached->hnode, cached->hash);
+	list_add(&cached->link, &cache->lru);
+	if (++cache->count > GVT_BB_CACHE_MAX_ENTRIES)
+		bb_cache_free(cache, list_last_entry(&cache->lru,
+						     struct intel_vgpu_cached_bb,
+						     link));
+
+out:
+	kvfree(fetch_and_zero(&s->bb_cache_guest));
+	/* merge back the events raised by the ring before the batch */
+	bitmap_or(events, events, s->bb_saved_events, INTEL_GVT_EVENT_MAX);
+}
+
+/**
+ * intel_vgpu_init_bb_cache - initialize the shadow batch buffer cache
+ * @vgpu: a vGPU
+ */
+void intel_vgpu_init_bb_cache(struct intel_vgpu *vgpu)
+{
+	struct intel_vgpu_bb_cache *cache = &vgpu->bb_cache;
+
+	memset(cache, 0, sizeof(*cache));
+	hash_init(cache->ht);
+	INIT_LIST_HEAD(&cache->lru);
+}
+
+/**
+ * intel_vgpu_clean_bb_cache - release the shadow batch buffer cache
+ * @vgpu: a vGPU
+ */
+void intel_vgpu_clean_bb_cache(struct intel_vgpu *vgpu)
+{
+	struct intel_vgpu_bb_cache *cache = &vgpu->bb_cache;
+	struct intel_vgpu_cached_bb *cached, *next;
+
+	list_for_each_entry_safe(cached, next, &cache->lru, link)
+		bb_cache_free(cache, cached);
+}
+
 static int cmd_handler_mi_batch_buffer_end(struct parser_exec_state *s)
 {
 	int ret;
@@ -1067,6 +1236,9 @@ static int cmd_handler_mi_batch_buffer_end(struct parser_exec_state *s)
 		ret = ip_gma_set(s, s->ret_ip_gma_bb);
 		s->buf_addr_type = s->saved_buf_addr_type;
 	} else {
+		if (s->bb_cache_entry)
+			bb_cache_commit(s);
+
 		s->buf_type = RING_BUFFER_INSTRUCTION;
 		s->buf_addr_type = GTT_BUFFER;
 		if (s->ret_ip_gma_ring >= s->ring_start + s->ring_size)
@@ -1320,6 +1492,9 @@ static int cmd_handler_mi_display_flip(struct parser_exec_state *s)
 
 	for (i = 0; i < len; i++)
 		patch_value(s, cmd_ptr(s, i), MI_NOOP);
+
+	/* updating the plane registers can't be replayed from the cache */
+	s->bb_cacheable = false;
 	return 0;
 }
 
@@ -1623,13 +1798,20 @@ static uint32_t find_bb_size(struct parser_exec_state *s)
 	return bb_size;
 }
 
-static int perform_bb_shadow(struct parser_exec_state *s)
+/*
+ * Returns 1 if an already audited shadow of the batch buffer was found in
+ * the cache, in which case the batch must not be scanned again.
+ */
+static int perform_bb_shadow(struct parser_exec_state *s, bool from_ring)
 {
 	struct intel_shadow_bb_entry *entry_obj;
+	struct intel_vgpu_cached_bb *cached;
 	struct intel_vgpu *vgpu = s->vgpu;
 	unsigned long gma = 0;
 	uint32_t bb_size;
+	void *guest = NULL;
 	void *dst = NULL;
+	u32 hash = 0;
 	int ret = 0;
 
 	/* get the start gm address of the batch buffer */
@@ -1638,10 +1820,39 @@ static int perform_bb_shadow(struct parser_exec_state *s)
 	/* get the size of the batch buffer */
 	bb_size = find_bb_size(s);
 
+	/* whatever a batch jumps to is not covered by its cache entry */
+	if (s->bb_cache_entry)
+		s->bb_cacheable = false;
+
+	if (from_ring && bb_size <= GVT_BB_CACHE_MAX_LEN)
+		guest = kvmalloc(bb_size, GFP_KERNEL);
+
+	if (guest) {
+		ret = copy_gma_to_hva(vgpu, vgpu->gtt.ggtt_mm,
+				      gma, gma + bb_size, guest);
+		if (ret < 0) {
+			gvt_vgpu_err("fail to copy guest batch buffer\n");
+			kvfree(guest);
+			return ret;
+		}
+
+		hash = jhash(guest, bb_size, 0);
+		cached = bb_cache_lookup(vgpu, s->ring_id, gma, bb_size,
+					 hash, guest);
+		if (cached) {
+			kvfree(guest);
+			ret = bb_cache_reuse(s, cached);
+			return ret ?: 1;
+		}
+		vgpu->bb_cache.misses++;
+	}
+
 	/* allocate shadow batch buffer */
 	entry_obj = kmalloc(sizeof(*entry_obj), GFP_KERNEL);
-	if (entry_obj == NULL)
-		return -ENOMEM;
+	if (entry_obj == NULL) {
+		ret = -ENOMEM;
+		goto free_guest;
+	}
 
 	entry_obj->obj =
 		i915_gem_object_create(s->vgpu->gvt->dev_priv,
@@ -1651,6 +1862,7 @@ static int perform_bb_shadow(struct parser_exec_state *s)
 		goto free_entry;
 	}
 	entry_obj->len = bb_size;
+	entry_obj->vma = NULL;
 	INIT_LIST_HEAD(&entry_obj->list);
 
 	dst = i915_gem_object_pin_map(entry_obj->obj, I915_MAP_WB);
@@ -1669,15 +1881,34 @@ static int perform_bb_shadow(struct parser_exec_state *s)
 	entry_obj->bb_start_cmd_va = s->ip_va;
 
 	/* copy batch buffer to shadow batch buffer*/
-	ret = copy_gma_to_hva(s->vgpu, s->vgpu->gtt.ggtt_mm,
-			      gma, gma + bb_size,
-			      dst);
-	if (ret < 0) {
-		gvt_vgpu_err("fail to copy guest ring buffer\n");
-		goto unmap_src;
+	if (guest) {
+		memcpy(dst, guest, bb_size);
+	} else {
+		ret = copy_gma_to_hva(s->vgpu, s->vgpu->gtt.ggtt_mm,
+				      gma, gma + bb_size,
+				      dst);
+		if (ret < 0) {
+			gvt_vgpu_err("fail to copy guest ring buffer\n");
+			goto unmap_src;
+		}
 	}
 
 	list_add(&entry_obj->list, &s->workload->shadow_bb);
+
+	/*
+	 * Track the events raised by this batch separately from those of
+	 * the ring, they are replayed whenever the cached copy is reused.
+	 */
+	if (guest) {
+		s->bb_cache_entry = entry_obj;
+		s->bb_cache_guest = guest;
+		s->bb_cache_gma = gma;
+		s->bb_cache_hash = hash;
+		s->bb_cacheable = true;
+		bitmap_copy(s->bb_saved_events, s->workload->pending_events,
+			    INTEL_GVT_EVENT_MAX);
+		bitmap_zero(s->workload->pending_events, INTEL_GVT_EVENT_MAX);
+	}
 	/*
 	 * ip_va saves the virtual address of the shadow batch buffer, while
 	 * ip_gma saves the graphics address of the original batch buffer.
@@ -1697,12 +1928,15 @@ static int perform_bb_shadow(struct parser_exec_state *s)
 	i915_gem_object_put(entry_obj->obj);
 free_entry:
 	kfree(entry_obj);
+free_guest:
+	kvfree(guest);
 	return ret;
 }
 
 static int cmd_handler_mi_batch_buffer_start(struct parser_exec_state *s)
 {
 	bool second_level;
+	bool from_ring = s->buf_type == RING_BUFFER_INSTRUCTION;
 	int ret = 0;
 	struct intel_vgpu *vgpu = s->vgpu;
 
@@ -1729,9 +1963,12 @@ static int cmd_handler_mi_batch_buffer_start(struct parser_exec_state *s)
 	}
 
 	if (batch_buffer_needs_scan(s)) {
-		ret = perform_bb_shadow(s);
+		ret = perform_bb_shadow(s, from_ring);
 		if (ret < 0)
 			gvt_vgpu_err("invalid shadow batch buffer\n");
+		else if (ret > 0)
+			/* already audited, go straight back to the ring */
+			ret = cmd_handler_mi_batch_buffer_end(s);
 	} else {
 		/* emulate a batch buffer end to do return right */
 		ret = cmd_handler_mi_batch_buffer_end(s);
@@ -2509,8 +2746,10 @@ static int command_scan(struct parser_exec_state *s,
 
 static int scan_workload(struct intel_vgpu_workload *workload)
 {
+	struct intel_vgpu_bb_cache *cache = &workload->vgpu->bb_cache;
 	unsigned long gma_head, gma_tail, gma_bottom;
 	struct parser_exec_state s;
+	ktime_t start;
 	int ret = 0;
 
 	/* ring base is page aligned */
@@ -2531,6 +2770,8 @@ static int scan_workload(struct intel_vgpu_workload *workload)
 	s.ring_tail = gma_tail;
 	s.rb_va = workload->shadow_ring_buffer_va;
 	s.workload = workload;
+	s.bb_cache_entry = NULL;
+	s.bb_cache_guest = NULL;
 
 	if ((bypass_scan_mask & (1 << workload->ring_id)) ||
 		gma_head == gma_tail)
@@ -2545,9 +2786,14 @@ static int scan_workload(struct intel_vgpu_workload *workload)
 	if (ret)
 		goto out;
 
+	start = ktime_get();
 	ret = command_scan(&s, workload->rb_head, workload->rb_tail,
 		workload->rb_start, _RING_CTL_BUF_SIZE(workload->rb_ctl));
+	cache->scan_time_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+	cache->scans++;
 
+	/* left over by a scan that failed within a batch */
+	kvfree(s.bb_cache_guest);
 out:
 	return ret;
 }
@@ -2557,10 +2803,12 @@ static int scan_wa_ctx(struct intel_shadow_wa_ctx *wa_ctx)
 
 	unsigned long gma_head, gma_tail, gma_bottom, ring_size, ring_tail;
 	struct parser_exec_state s;
+	ktime_t start;
 	int ret = 0;
 	struct intel_vgpu_workload *workload = container_of(wa_ctx,
 				struct intel_vgpu_workload,
 				wa_ctx);
+	struct intel_vgpu_bb_cache *cache = &workload->vgpu->bb_cache;
 
 	/* ring base is page aligned */
 	if (WARN_ON(!IS_ALIGNED(wa_ctx->indirect_ctx.guest_gma, GTT_PAGE_SIZE)))
@@ -2583,6 +2831,8 @@ static int scan_wa_ctx(struct intel_shadow_wa_ctx *wa_ctx)
 	s.ring_tail = gma_tail;
 	s.rb_va = wa_ctx->indirect_ctx.shadow_va;
 	s.workload = workload;
+	s.bb_cache_entry = NULL;
+	s.bb_cache_guest = NULL;
 
 	if (!intel_gvt_ggtt_validate_range(s.vgpu, s.ring_start, s.ring_size)) {
 		ret = -EINVAL;
@@ -2593,8 +2843,13 @@ static int scan_wa_ctx(struct intel_shadow_wa_ctx *wa_ctx)
 	if (ret)
 		goto out;
 
+	start = ktime_get();
 	ret = command_scan(&s, 0, ring_tail,
 		wa_ctx->indirect_ctx.guest_gma, ring_size);
+	cache->scan_time_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+	cache->scans++;
+
+	kvfree(s.bb_cache_guest);
 out:
 	return ret;
 }
@@ -36,8 +36,34 @@
 #ifndef _GVT_CMD_PARSER_H_
 #define _GVT_CMD_PARSER_H_
 
+#include <linux/hashtable.h>
+
 #define GVT_CMD_HASH_BITS 7
 
+#define GVT_BB_CACHE_HASH_BITS 6
+
+/*
+ * Audited shadow copies of the batch buffers a vGPU submitted, keyed by
+ * guest address and contents, along with the command scan statistics
+ * reported through debugfs. Protected by gvt->lock.
+ */
+struct intel_vgpu_bb_cache {
+	DECLARE_HASHTABLE(ht, GVT_BB_CACHE_HASH_BITS);
+	struct list_head lru;
+	unsigned int count;
+
+	u64 hits;
+	u64 misses;
+	u64 scans;
+	u64 scan_time_ns;
+};
+
+struct intel_vgpu;
+
+void intel_vgpu_init_bb_cache(struct intel_vgpu *vgpu);
+
+void intel_vgpu_clean_bb_cache(struct intel_vgpu *vgpu);
+
 void intel_gvt_clean_cmd_parser(struct intel_gvt *gvt);
 
 int intel_gvt_init_cmd_parser(struct intel_gvt *gvt);
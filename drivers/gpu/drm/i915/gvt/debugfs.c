@@ -0,0 +1,184 @@
+/*
+ * Copyright(c) 2017 Intel Corporation. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <linux/debugfs.h>
+#include "i915_drv.h"
+#include "gvt.h"
+
+static const char * const mmio_class_names[] = {
+	[INTEL_VGPU_MMIO_CLASS_GGTT] = "ggtt",
+	[INTEL_VGPU_MMIO_CLASS_PVINFO] = "pvinfo",
+	[INTEL_VGPU_MMIO_CLASS_ENGINE] = "engine",
+	[INTEL_VGPU_MMIO_CLASS_DISPLAY] = "display",
+	[INTEL_VGPU_MMIO_CLASS_OTHER] = "other",
+};
+
+static int vgpu_stats_show(struct seq_file *m, void *unused)
+{
+	struct intel_vgpu *vgpu = m->private;
+	struct intel_vgpu_bb_cache *cache = &vgpu->bb_cache;
+	struct intel_vgpu_stats *stats = &vgpu->stats;
+	u64 lookups;
+	int i;
+
+	mutex_lock(&vgpu->gvt->lock);
+
+	lookups = cache->hits + cache->misses;
+
+	seq_printf(m, "workloads submitted: %llu, completed: %llu\n",
+		   stats->workloads_submitted, stats->workloads_completed);
+	seq_printf(m, "gpu time: %llu us\n",
+		   div_u64(stats->gpu_time_ns, NSEC_PER_USEC));
+	seq_printf(m, "shadow time: %llu us\n",
+		   div_u64(READ_ONCE(stats->shadow_time_ns), NSEC_PER_USEC));
+	seq_printf(m, "scans: %llu\n", cache->scans);
+	seq_printf(m, "scan time: %llu us\n",
+		   div_u64(cache->scan_time_ns, NSEC_PER_USEC));
+	seq_printf(m, "bb cache entries: %u\n", cache->count);
+	seq_printf(m, "bb cache hits: %llu, misses: %llu, hit rate: %llu%%\n",
+		   cache->hits, cache->misses,
+		   lookups ? div64_u64(cache->hits * 100, lookups) : 0);
+	seq_printf(m, "page track faults: %llu\n", stats->page_track_faults);
+	for (i = 0; i < INTEL_VGPU_MMIO_CLASS_MAX; i++)
+		seq_printf(m, "mmio traps %s: %llu\n",
+			   mmio_class_names[i], stats->mmio_traps[i]);
+
+	mutex_unlock(&vgpu->gvt->lock);
+
+	return 0;
+}
+
+static int vgpu_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, vgpu_stats_show, inode->i_private);
+}
+
+static const struct file_operations vgpu_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = vgpu_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int mmio_switch_stats_show(struct seq_file *m, void *unused)
+{
+	struct intel_gvt *gvt = m->private;
+	struct intel_gvt_workload_scheduler *scheduler = &gvt->scheduler;
+	struct intel_gvt_mmio_switch_stats stats;
+	struct intel_engine_cs *engine;
+	enum intel_engine_id id;
+
+	for_each_engine(engine, gvt->dev_priv, id) {
+		spin_lock_bh(&scheduler->mmio_context_lock);
+		stats = scheduler->mmio_switch_stats[id];
+		spin_unlock_bh(&scheduler->mmio_context_lock);
+
+		seq_printf(m, "%s: switches: %llu, writes: %llu, avg: %llu ns, max: %llu ns\n",
+			   engine->name, stats.count, stats.writes,
+			   stats.count ? div64_u64(stats.total_ns, stats.count) : 0,
+			   stats.max_ns);
+	}
+
+	return 0;
+}
+
+static int mmio_switch_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mmio_switch_stats_show, inode->i_private);
+}
+
+static const struct file_operations mmio_switch_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = mmio_switch_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/**
+ * intel_gvt_debugfs_add_vgpu - register debugfs entries for a vGPU
+ * @vgpu: a vGPU
+ *
+ * Returns:
+ * Zero on success, negative error code if failed.
+ */
+int intel_gvt_debugfs_add_vgpu(struct intel_vgpu *vgpu)
+{
+	struct dentry *ent;
+	char name[16];
+
+	snprintf(name, sizeof(name), "vgpu%d", vgpu->id);
+	vgpu->debugfs = debugfs_create_dir(name, vgpu->gvt->debugfs_root);
+	if (!vgpu->debugfs)
+		return -ENOMEM;
+
+	ent = debugfs_create_file("stats", 0444, vgpu->debugfs,
+				  vgpu, &vgpu_stats_fops);
+	if (!ent)
+		return -ENOMEM;
+
+	return 0;
+}
+
+/**
+ * intel_gvt_debugfs_remove_vgpu - remove debugfs entries of a vGPU
+ * @vgpu: a vGPU
+ */
+void intel_gvt_debugfs_remove_vgpu(struct intel_vgpu *vgpu)
+{
+	debugfs_remove_recursive(vgpu->debugfs);
+	vgpu->debugfs = NULL;
+}
+
+/**
+ * intel_gvt_debugfs_init - register gvt debugfs root entry
+ * @gvt: GVT device
+ *
+ * Returns:
+ * Zero on success, negative error code if failed.
+ */
+int intel_gvt_debugfs_init(struct intel_gvt *gvt)
+{
+	struct dentry *ent;
+
+	gvt->debugfs_root = debugfs_create_dir("gvt", NULL);
+	if (!gvt->debugfs_root)
+		return -ENOMEM;
+
+	ent = debugfs_create_file("mmio_switch_stats", 0444, gvt->debugfs_root,
+				  gvt, &mmio_switch_stats_fops);
+	if (!ent)
+		return -ENOMEM;
+
+	return 0;
+}
+
+/**
+ * intel_gvt_debugfs_clean - remove debugfs entries
+ * @gvt: GVT device
+ */
+void intel_gvt_debugfs_clean(struct intel_gvt *gvt)
+{
+	debugfs_remove_recursive(gvt->debugfs_root);
+	gvt->debugfs_root = NULL;
+}
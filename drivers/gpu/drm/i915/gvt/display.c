@@ -368,6 +368,13 @@ static void emulate_vblank_on_pipe(struct intel_vgpu *vgpu, int pipe)
 
 		vgpu_vreg(vgpu, PIPE_FLIPCOUNT_G4X(pipe))++;
 		intel_vgpu_trigger_virtual_event(vgpu, event);
+
+		if (event == PRIMARY_A_FLIP_DONE + pipe)
+			intel_vgpu_signal_flip_fences(vgpu,
+						      INTEL_VGPU_PLANE_PRIMARY);
+		else if (event == SPRITE_A_FLIP_DONE + pipe)
+			intel_vgpu_signal_flip_fences(vgpu,
+						      INTEL_VGPU_PLANE_SPRITE);
 	}
 
 	if (pipe_is_enabled(vgpu, pipe)) {
@@ -0,0 +1,535 @@
+/*
+ * Copyright(c) 2017 Intel Corporation. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <linux/dma-buf.h>
+#include <linux/sync_file.h>
+#include <linux/vfio.h>
+#include <drm/drm_fourcc.h>
+#include <drm/drm_plane.h>
+
+#include "i915_drv.h"
+#include "gvt.h"
+
+/*
+ * Export of guest framebuffers: the surface a guest plane scans out is
+ * decoded from the virtual display registers and wrapped into a GEM
+ * object whose backing pages are the host GGTT entries of the guest's
+ * graphics memory, so the host can display or sample from it without
+ * copying. Together with a query, the host can ask for a fence which is
+ * signaled when the guest next flips the plane.
+ */
+
+struct intel_vgpu_flip_fence {
+	struct dma_fence base;
+	struct list_head link;
+};
+
+static const char *flip_fence_get_driver_name(struct dma_fence *fence)
+{
+	return "i915-gvt";
+}
+
+static const char *flip_fence_get_timeline_name(struct dma_fence *fence)
+{
+	return "vgpu-flip";
+}
+
+static bool flip_fence_enable_signaling(struct dma_fence *fence)
+{
+	return true;
+}
+
+static const struct dma_fence_ops flip_fence_ops = {
+	.get_driver_name = flip_fence_get_driver_name,
+	.get_timeline_name = flip_fence_get_timeline_name,
+	.enable_signaling = flip_fence_enable_signaling,
+	.wait = dma_fence_default_wait,
+};
+
+/**
+ * intel_vgpu_init_flip_fences - initialize the flip fences of a vGPU
+ * @vgpu: a vGPU
+ */
+void intel_vgpu_init_flip_fences(struct intel_vgpu *vgpu)
+{
+	struct intel_vgpu_flip_fences *fences = &vgpu->flip_fences;
+	int i;
+
+	spin_lock_init(&fences->fence_lock);
+	fences->context = dma_fence_context_alloc(INTEL_VGPU_PLANE_MAX);
+	for (i = 0; i < INTEL_VGPU_PLANE_MAX; i++) {
+		fences->seqno[i] = 0;
+		INIT_LIST_HEAD(&fences->pending[i]);
+	}
+}
+
+/**
+ * intel_vgpu_signal_flip_fences - signal the fences waiting for a flip
+ * @vgpu: a vGPU
+ * @plane: the plane the guest has flipped
+ *
+ * Called with gvt->lock held when the flip done event of @plane is
+ * delivered to the guest.
+ */
+void intel_vgpu_signal_flip_fences(struct intel_vgpu *vgpu,
+				   enum intel_vgpu_plane_id plane)
+{
+	struct intel_vgpu_flip_fence *fence, *next;
+
+	list_for_each_entry_safe(fence, next,
+				 &vgpu->flip_fences.pending[plane], link) {
+		list_del(&fence->link);
+		dma_fence_signal(&fence->base);
+		dma_fence_put(&fence->base);
+	}
+}
+
+/**
+ * intel_vgpu_clean_flip_fences - release the flip fences of a vGPU
+ * @vgpu: a vGPU
+ *
+ * Signal all the pending fences, no more flips will happen.
+ */
+void intel_vgpu_clean_flip_fences(struct intel_vgpu *vgpu)
+{
+	int i;
+
+	for (i = 0; i < INTEL_VGPU_PLANE_MAX; i++)
+		intel_vgpu_signal_flip_fences(vgpu, i);
+}
+
+static int create_flip_fence(struct intel_vgpu *vgpu,
+			     enum intel_vgpu_plane_id plane)
+{
+	struct intel_vgpu_flip_fences *fences = &vgpu->flip_fences;
+	struct intel_vgpu_flip_fence *fence;
+	struct sync_file *sync_file;
+	int fd;
+
+	fd = get_unused_fd_flags(O_CLOEXEC);
+	if (fd < 0)
+		return fd;
+
+	fence = kzalloc(sizeof(*fence), GFP_KERNEL);
+	if (!fence) {
+		put_unused_fd(fd);
+		return -ENOMEM;
+	}
+
+	dma_fence_init(&fence->base, &flip_fence_ops, &fences->fence_lock,
+		       fences->context + plane, ++fences->seqno[plane]);
+
+	sync_file = sync_file_create(&fence->base);
+	if (!sync_file) {
+		dma_fence_put(&fence->base);
+		put_unused_fd(fd);
+		return -ENOMEM;
+	}
+
+	/* the pending list keeps the initial reference */
+	list_add_tail(&fence->link, &fences->pending[plane]);
+	fd_install(fd, sync_file->file);
+	return fd;
+}
+
+static int plane_type_to_id(unsigned int plane_type)
+{
+	switch (plane_type) {
+	case DRM_PLANE_TYPE_PRIMARY:
+		return INTEL_VGPU_PLANE_PRIMARY;
+	case DRM_PLANE_TYPE_OVERLAY:
+		return INTEL_VGPU_PLANE_SPRITE;
+	default:
+		return -EINVAL;
+	}
+}
+
+static int skl_format_to_drm(u32 ctl)
+{
+	bool rgbx = ctl & PLANE_CTL_ORDER_RGBX;
+	bool alpha = ctl & PLANE_CTL_ALPHA_MASK;
+
+	switch (ctl & PLANE_CTL_FORMAT_MASK) {
+	case PLANE_CTL_FORMAT_XRGB_8888:
+		if (rgbx)
+			return alpha ? DRM_FORMAT_ABGR8888 : DRM_FORMAT_XBGR8888;
+		return alpha ? DRM_FORMAT_ARGB8888 : DRM_FORMAT_XRGB8888;
+	case PLANE_CTL_FORMAT_XRGB_2101010:
+		return rgbx ? DRM_FORMAT_XBGR2101010 : DRM_FORMAT_XRGB2101010;
+	case PLANE_CTL_FORMAT_RGB_565:
+		return DRM_FORMAT_RGB565;
+	default:
+		return -EINVAL;
+	}
+}
+
+static int skl_decode_plane(struct intel_vgpu *vgpu, enum pipe pipe,
+			    enum intel_vgpu_plane_id id,
+			    struct intel_vgpu_fb_info *fb)
+{
+	u32 ctl, val;
+	int format, plane = id == INTEL_VGPU_PLANE_PRIMARY ? 0 : 1;
+
+	ctl = vgpu_vreg(vgpu, PLANE_CTL(pipe, plane));
+	if (!(ctl & PLANE_CTL_ENABLE))
+		return -ENODEV;
+
+	format = skl_format_to_drm(ctl);
+	if (format < 0)
+		return format;
+	fb->drm_format = format;
+
+	val = vgpu_vreg(vgpu, PLANE_STRIDE(pipe, plane)) & 0x3ff;
+	switch (ctl & PLANE_CTL_TILED_MASK) {
+	case PLANE_CTL_TILED_LINEAR:
+		fb->drm_format_mod = DRM_FORMAT_MOD_LINEAR;
+		fb->stride = val * 64;
+		break;
+	case PLANE_CTL_TILED_X:
+		fb->drm_format_mod = I915_FORMAT_MOD_X_TILED;
+		fb->stride = val * 512;
+		break;
+	case PLANE_CTL_TILED_Y:
+		fb->drm_format_mod = I915_FORMAT_MOD_Y_TILED;
+		fb->stride = val * 128;
+		break;
+	case PLANE_CTL_TILED_YF:
+		fb->drm_format_mod = I915_FORMAT_MOD_Yf_TILED;
+		fb->stride = val * 128;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	val = vgpu_vreg(vgpu, PLANE_SIZE(pipe, plane));
+	fb->width = (val & 0x1fff) + 1;
+	fb->height = ((val >> 16) & 0xfff) + 1;
+
+	val = vgpu_vreg(vgpu, PLANE_POS(pipe, plane));
+	fb->x_pos = val & 0x1fff;
+	fb->y_pos = (val >> 16) & 0xfff;
+
+	fb->start = vgpu_vreg(vgpu, PLANE_SURF(pipe, plane)) & GTT_PAGE_MASK;
+	return 0;
+}
+
+static int bdw_decode_primary(struct intel_vgpu *vgpu, enum pipe pipe,
+			      struct intel_vgpu_fb_info *fb)
+{
+	struct drm_i915_private *dev_priv = vgpu->gvt->dev_priv;
+	u32 ctl, val;
+
+	ctl = vgpu_vreg(vgpu, DSPCNTR(pipe));
+	if (!(ctl & DISPLAY_PLANE_ENABLE))
+		return -ENODEV;
+
+	switch (ctl & DISPPLANE_PIXFORMAT_MASK) {
+	case DISPPLANE_BGRX888:
+		fb->drm_format = DRM_FORMAT_XRGB8888;
+		break;
+	case DISPPLANE_RGBX888:
+		fb->drm_format = DRM_FORMAT_XBGR8888;
+		break;
+	case DISPPLANE_BGRX101010:
+		fb->drm_format = DRM_FORMAT_XRGB2101010;
+		break;
+	case DISPPLANE_RGBX101010:
+		fb->drm_format = DRM_FORMAT_XBGR2101010;
+		break;
+	case DISPPLANE_BGRX565:
+		fb->drm_format = DRM_FORMAT_RGB565;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	fb->drm_format_mod = ctl & DISPPLANE_TILED ?
+		I915_FORMAT_MOD_X_TILED : DRM_FORMAT_MOD_LINEAR;
+	fb->stride = vgpu_vreg(vgpu, DSPSTRIDE(pipe));
+
+	val = vgpu_vreg(vgpu, PIPESRC(pipe));
+	fb->width = ((val >> 16) & 0xfff) + 1;
+	fb->height = (val & 0xfff) + 1;
+	fb->x_pos = 0;
+	fb->y_pos = 0;
+
+	fb->start = vgpu_vreg(vgpu, DSPSURF(pipe)) & GTT_PAGE_MASK;
+	return 0;
+}
+
+static int bdw_decode_sprite(struct intel_vgpu *vgpu, enum pipe pipe,
+			     struct intel_vgpu_fb_info *fb)
+{
+	u32 ctl, val;
+
+	ctl = vgpu_vreg(vgpu, SPRCTL(pipe));
+	if (!(ctl & SPRITE_ENABLE))
+		return -ENODEV;
+
+	switch (ctl & SPRITE_PIXFORMAT_MASK) {
+	case SPRITE_FORMAT_RGBX888:
+		fb->drm_format = ctl & SPRITE_RGB_ORDER_RGBX ?
+			DRM_FORMAT_XBGR8888 : DRM_FORMAT_XRGB8888;
+		break;
+	case SPRITE_FORMAT_RGBX101010:
+		fb->drm_format = DRM_FORMAT_XBGR2101010;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	fb->drm_format_mod = ctl & SPRITE_TILED ?
+		I915_FORMAT_MOD_X_TILED : DRM_FORMAT_MOD_LINEAR;
+	fb->stride = vgpu_vreg(vgpu, SPRSTRIDE(pipe));
+
+	val = vgpu_vreg(vgpu, SPRSIZE(pipe));
+	fb->width = (val & 0xfff) + 1;
+	fb->height = ((val >> 16) & 0xfff) + 1;
+
+	val = vgpu_vreg(vgpu, SPRPOS(pipe));
+	fb->x_pos = val & 0xfff;
+	fb->y_pos = (val >> 16) & 0xfff;
+
+	fb->start = vgpu_vreg(vgpu, SPRSURF(pipe)) & GTT_PAGE_MASK;
+	return 0;
+}
+
+/* Decode the surface of a plane on the first enabled virtual pipe. */
+static int vgpu_decode_plane(struct intel_vgpu *vgpu,
+			     enum intel_vgpu_plane_id id,
+			     struct intel_vgpu_fb_info *fb)
+{
+	struct drm_i915_private *dev_priv = vgpu->gvt->dev_priv;
+	unsigned int tile_height;
+	enum pipe pipe;
+	int ret;
+
+	for_each_pipe(dev_priv, pipe) {
+		if (vgpu_vreg(vgpu, PIPECONF(pipe)) & PIPECONF_ENABLE)
+			break;
+	}
+	if (pipe == INTEL_INFO(dev_priv)->num_pipes)
+		return -ENODEV;
+
+	if (INTEL_GEN(dev_priv) >= 9)
+		ret = skl_decode_plane(vgpu, pipe, id, fb);
+	else if (id == INTEL_VGPU_PLANE_PRIMARY)
+		ret = bdw_decode_primary(vgpu, pipe, fb);
+	else
+		ret = bdw_decode_sprite(vgpu, pipe, fb);
+	if (ret)
+		return ret;
+
+	switch (fb->drm_format_mod) {
+	case I915_FORMAT_MOD_X_TILED:
+		tile_height = 8;
+		break;
+	case I915_FORMAT_MOD_Y_TILED:
+	case I915_FORMAT_MOD_Yf_TILED:
+		tile_height = 32;
+		break;
+	default:
+		tile_height = 1;
+		break;
+	}
+
+	fb->size = PAGE_ALIGN(fb->stride * roundup(fb->height, tile_height));
+	if (!fb->stride || !intel_gvt_ggtt_validate_range(vgpu, fb->start,
+							  fb->size)) {
+		gvt_vgpu_err("invalid plane surface %llx size %x\n",
+			     fb->start, fb->size);
+		return -EINVAL;
+	}
+
+	fb->vgpu = vgpu;
+	return 0;
+}
+
+/**
+ * intel_vgpu_query_plane - describe the current surface of a guest plane
+ * @vgpu: a vGPU
+ * @args: a struct vfio_device_gfx_plane_info
+ *
+ * Returns:
+ * Zero on success, negative error code if failed.
+ */
+int intel_vgpu_query_plane(struct intel_vgpu *vgpu, void *args)
+{
+	struct vfio_device_gfx_plane_info *info = args;
+	struct intel_vgpu_fb_info fb;
+	int id, ret;
+
+	id = plane_type_to_id(info->drm_plane_type);
+	if (id < 0)
+		return id;
+
+	if (info->flags & VFIO_GFX_PLANE_TYPE_PROBE)
+		return info->flags & ~(VFIO_GFX_PLANE_TYPE_PROBE |
+				       VFIO_GFX_PLANE_TYPE_DMABUF |
+				       VFIO_GFX_PLANE_FLIP_FENCE) ?
+			-EINVAL : 0;
+
+	mutex_lock(&vgpu->gvt->lock);
+
+	ret = vgpu_decode_plane(vgpu, id, &fb);
+	if (ret)
+		goto out;
+
+	info->drm_format = fb.drm_format;
+	info->drm_format_mod = fb.drm_format_mod;
+	info->width = fb.width;
+	info->height = fb.height;
+	info->stride = fb.stride;
+	info->size = fb.size;
+	info->x_pos = fb.x_pos;
+	info->y_pos = fb.y_pos;
+	info->flip_fence_fd = -1;
+
+	if (info->flags & VFIO_GFX_PLANE_FLIP_FENCE) {
+		ret = create_flip_fence(vgpu, id);
+		if (ret < 0)
+			goto out;
+		info->flip_fence_fd = ret;
+		ret = 0;
+	}
+
+out:
+	mutex_unlock(&vgpu->gvt->lock);
+	return ret;
+}
+
+static struct sg_table *vgpu_gem_get_pages(struct drm_i915_gem_object *obj)
+{
+	struct drm_i915_private *dev_priv = to_i915(obj->base.dev);
+	struct intel_vgpu_fb_info *fb = obj->gvt_info;
+	gen8_pte_t __iomem *gtt_entries;
+	unsigned int page_num = fb->size >> PAGE_SHIFT;
+	struct scatterlist *sg;
+	struct sg_table *st;
+	int i, ret;
+
+	st = kmalloc(sizeof(*st), GFP_KERNEL);
+	if (!st)
+		return ERR_PTR(-ENOMEM);
+
+	ret = sg_alloc_table(st, page_num, GFP_KERNEL);
+	if (ret) {
+		kfree(st);
+		return ERR_PTR(ret);
+	}
+
+	/* the host GGTT already maps the guest pages, reuse its entries */
+	gtt_entries = (gen8_pte_t __iomem *)dev_priv->ggtt.gsm +
+		(fb->start >> PAGE_SHIFT);
+	for_each_sg(st->sgl, sg, page_num, i) {
+		sg->offset = 0;
+		sg->length = PAGE_SIZE;
+		sg_dma_address(sg) = readq(&gtt_entries[i]) & GTT_PAGE_MASK;
+		sg_dma_len(sg) = PAGE_SIZE;
+	}
+
+	return st;
+}
+
+static void vgpu_gem_put_pages(struct drm_i915_gem_object *obj,
+			       struct sg_table *pages)
+{
+	sg_free_table(pages);
+	kfree(pages);
+}
+
+static void vgpu_gem_release(struct drm_i915_gem_object *obj)
+{
+	kfree(obj->gvt_info);
+}
+
+static const struct drm_i915_gem_object_ops intel_vgpu_gem_ops = {
+	.get_pages = vgpu_gem_get_pages,
+	.put_pages = vgpu_gem_put_pages,
+	.release = vgpu_gem_release,
+};
+
+/**
+ * intel_vgpu_get_dmabuf - export the current surface of a guest plane
+ * @vgpu: a vGPU
+ * @plane_type: DRM_PLANE_TYPE_* of the plane
+ *
+ * Returns:
+ * A dma-buf fd on success, negative error code if failed.
+ */
+int intel_vgpu_get_dmabuf(struct intel_vgpu *vgpu, unsigned int plane_type)
+{
+	struct drm_i915_private *dev_priv = vgpu->gvt->dev_priv;
+	struct intel_vgpu_fb_info *fb;
+	struct drm_i915_gem_object *obj;
+	struct dma_buf *dmabuf;
+	int id, ret;
+
+	id = plane_type_to_id(plane_type);
+	if (id < 0)
+		return id;
+
+	fb = kzalloc(sizeof(*fb), GFP_KERNEL);
+	if (!fb)
+		return -ENOMEM;
+
+	mutex_lock(&vgpu->gvt->lock);
+	ret = vgpu_decode_plane(vgpu, id, fb);
+	mutex_unlock(&vgpu->gvt->lock);
+	if (ret)
+		goto err_free_fb;
+
+	obj = i915_gem_object_alloc(dev_priv);
+	if (!obj) {
+		ret = -ENOMEM;
+		goto err_free_fb;
+	}
+
+	drm_gem_private_object_init(&dev_priv->drm, &obj->base, fb->size);
+	i915_gem_object_init(obj, &intel_vgpu_gem_ops);
+	obj->base.read_domains = I915_GEM_DOMAIN_GTT;
+	obj->base.write_domain = 0;
+	obj->gvt_info = fb;
+
+	/* the dma-buf takes over our reference on the object */
+	dmabuf = i915_gem_prime_export(&dev_priv->drm, &obj->base,
+				       DRM_CLOEXEC | DRM_RDWR);
+	if (IS_ERR(dmabuf)) {
+		i915_gem_object_put(obj);
+		return PTR_ERR(dmabuf);
+	}
+
+	ret = dma_buf_fd(dmabuf, DRM_CLOEXEC | DRM_RDWR);
+	if (ret < 0) {
+		dma_buf_put(dmabuf);
+		return ret;
+	}
+
+	gvt_dbg_dpy("vgpu%d: exported plane %d, %ux%u stride %u as fd %d\n",
+		    vgpu->id, id, fb->width, fb->height, fb->stride, ret);
+	return ret;
+
+err_free_fb:
+	kfree(fb);
+	return ret;
+}
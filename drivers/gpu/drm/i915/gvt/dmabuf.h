@@ -0,0 +1,69 @@
+/*
+ * Copyright(c) 2017 Intel Corporation. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _GVT_DMABUF_H_
+#define _GVT_DMABUF_H_
+
+#include <linux/dma-fence.h>
+
+enum intel_vgpu_plane_id {
+	INTEL_VGPU_PLANE_PRIMARY = 0,
+	INTEL_VGPU_PLANE_SPRITE,
+	INTEL_VGPU_PLANE_MAX,
+};
+
+/* guest surface backing an exported dma-buf */
+struct intel_vgpu_fb_info {
+	struct intel_vgpu *vgpu;
+	u32 drm_format;
+	u64 drm_format_mod;
+	u32 width;
+	u32 height;
+	u32 stride;
+	u32 size;
+	u32 x_pos;
+	u32 y_pos;
+	u64 start;	/* guest graphics memory address */
+};
+
+/*
+ * Fences handed out together with a plane query, signaled on the next
+ * flip of that plane. Protected by gvt->lock, fence_lock only serves as
+ * the dma_fence lock.
+ */
+struct intel_vgpu_flip_fences {
+	spinlock_t fence_lock;
+	u64 context;
+	unsigned int seqno[INTEL_VGPU_PLANE_MAX];
+	struct list_head pending[INTEL_VGPU_PLANE_MAX];
+};
+
+void intel_vgpu_init_flip_fences(struct intel_vgpu *vgpu);
+void intel_vgpu_clean_flip_fences(struct intel_vgpu *vgpu);
+void intel_vgpu_signal_flip_fences(struct intel_vgpu *vgpu,
+				   enum intel_vgpu_plane_id plane);
+
+int intel_vgpu_query_plane(struct intel_vgpu *vgpu, void *args);
+int intel_vgpu_get_dmabuf(struct intel_vgpu *vgpu, unsigned int plane_type);
+
+#endif
@@ -34,6 +34,7 @@
 
 #include "i915_drv.h"
 #include "gvt.h"
+#include "i915_pvinfo.h"
 
 #define _EL_OFFSET_STATUS       0x234
 #define _EL_OFFSET_STATUS_BUF   0x370
@@ -126,6 +127,50 @@ static void emulate_execlist_status(struct intel_vgpu_execlist *execlist)
 		vgpu->id, status_reg, status.ldw, status.udw);
 }
 
+/**
+ * intel_vgpu_publish_csb - mirror the virtual CSB into the guest shared page
+ * @vgpu: a vGPU
+ * @ring_id: ring index
+ *
+ * Copy the virtual context status buffer and its pointer of @ring_id into
+ * the page the guest registered through pvinfo, if any, so the guest can
+ * process context switches without trapping on the CSB registers. The
+ * buffer is written before the pointer, as the guest trusts every entry
+ * up to the write pointer it reads.
+ */
+void intel_vgpu_publish_csb(struct intel_vgpu *vgpu, int ring_id)
+{
+	struct vgt_shared_engine shared;
+	unsigned long gpa;
+	u32 ptr_reg, buf_reg;
+	int i;
+
+	if (!vgpu->shared_page_gpa || ring_id >= VGT_SHARED_PAGE_ENGINES)
+		return;
+
+	ptr_reg = execlist_ring_mmio(vgpu->gvt, ring_id,
+			_EL_OFFSET_STATUS_PTR);
+	buf_reg = execlist_ring_mmio(vgpu->gvt, ring_id,
+			_EL_OFFSET_STATUS_BUF);
+
+	for (i = 0; i < ARRAY_SIZE(shared.csb); i++)
+		shared.csb[i] = vgpu_vreg(vgpu, buf_reg + i * 4);
+	shared.csb_ptr = vgpu_vreg(vgpu, ptr_reg);
+
+	gpa = vgpu->shared_page_gpa +
+		offsetof(struct vgt_shared_page, engine[ring_id]);
+
+	if (intel_gvt_hypervisor_write_gpa(vgpu,
+			gpa + offsetof(struct vgt_shared_engine, csb),
+			shared.csb, sizeof(shared.csb)) ||
+	    intel_gvt_hypervisor_write_gpa(vgpu,
+			gpa + offsetof(struct vgt_shared_engine, csb_ptr),
+			&shared.csb_ptr, sizeof(shared.csb_ptr))) {
+		gvt_vgpu_err("fail to update shared page, disabling it\n");
+		vgpu->shared_page_gpa = 0;
+	}
+}
+
 static void emulate_csb_update(struct intel_vgpu_execlist *execlist,
 		struct execlist_context_status_format *status,
 		bool trigger_interrupt_later)
@@ -163,6 +208,8 @@ static void emulate_csb_update(struct intel_vgpu_execlist *execlist,
 	gvt_dbg_el("vgpu%d: w pointer %u reg %x csb l %x csb h %x\n",
 		vgpu->id, write_pointer, offset, status->ldw, status->udw);
 
+	intel_vgpu_publish_csb(vgpu, ring_id);
+
 	if (trigger_interrupt_later)
 		return;
 
@@ -382,10 +429,11 @@ static void prepare_shadow_batch_buffer(struct intel_vgpu_workload *workload)
 			return;
 		}
 
-		/* FIXME: we are not tracking our pinned VMA leaving it
-		 * up to the core to fix up the stray pin_count upon
-		 * free.
+		/*
+		 * Shadow batches may be reused from the vGPU's cache, so the
+		 * pin has to be dropped again once the workload completes.
 		 */
+		entry_obj->vma = vma;
 
 		/* update the relocate gma with shadow batch buffer*/
 		entry_obj->bb_start_cmd_va[1] = i915_ggtt_offset(vma);
@@ -454,8 +502,14 @@ static int prepare_execlist_workload(struct intel_vgpu_workload *workload)
 	struct intel_vgpu *vgpu = workload->vgpu;
 	struct execlist_ctx_descriptor_format ctx[2];
 	int ring_id = workload->ring_id;
+	int ret;
+
+	ret = intel_vgpu_pin_mm(workload->shadow_mm);
+	if (ret) {
+		gvt_vgpu_err("fail to shadow ppgtt\n");
+		return ret;
+	}
 
-	intel_vgpu_pin_mm(workload->shadow_mm);
 	intel_vgpu_sync_oos_pages(workload->vgpu);
 	intel_vgpu_flush_post_shadow(workload->vgpu);
 	prepare_shadow_batch_buffer(workload);
@@ -471,6 +525,8 @@ static int prepare_execlist_workload(struct intel_vgpu_workload *workload)
 
 static void release_shadow_batch_buffer(struct intel_vgpu_workload *workload)
 {
+	struct drm_i915_private *dev_priv = workload->vgpu->gvt->dev_priv;
+
 	/* release all the shadow batch buffer */
 	if (!list_empty(&workload->shadow_bb)) {
 		struct intel_shadow_bb_entry *entry_obj =
@@ -481,6 +537,11 @@ static void release_shadow_batch_buffer(struct intel_vgpu_workload *workload)
 
 		list_for_each_entry_safe(entry_obj, temp, &workload->shadow_bb,
 					 list) {
+			if (entry_obj->vma) {
+				mutex_lock(&dev_priv->drm.struct_mutex);
+				i915_vma_unpin(entry_obj->vma);
+				mutex_unlock(&dev_priv->drm.struct_mutex);
+			}
 			i915_gem_object_unpin_map(entry_obj->obj);
 			i915_gem_object_put(entry_obj->obj);
 			list_del(&entry_obj->list);
@@ -686,6 +747,7 @@ static int submit_context(struct intel_vgpu *vgpu, int ring_id,
 	workload->complete = complete_execlist_workload;
 	workload->status = -EINPROGRESS;
 	workload->emulate_schedule_in = emulate_schedule_in;
+	workload->prefetched = false;
 	workload->shadowed = false;
 
 	if (ring_id == RCS) {
@@ -731,6 +793,13 @@ static int submit_context(struct intel_vgpu *vgpu, int ring_id,
 	}
 
 	queue_workload(workload);
+	vgpu->stats.workloads_submitted++;
+
+	/* let an interactive vGPU take over without waiting for the tick */
+	if (vgpu->sched_ctl.latency_class == INTEL_VGPU_LATENCY_INTERACTIVE &&
+	    vgpu->gvt->scheduler.current_vgpu[ring_id] != vgpu)
+		intel_gvt_request_service(vgpu->gvt,
+					  INTEL_GVT_REQUEST_EVENT_SCHED);
 	return 0;
 }
 
@@ -853,6 +922,8 @@ void intel_vgpu_reset_execlist(struct intel_vgpu *vgpu,
 	unsigned int tmp;
 
 	clean_workloads(vgpu, engine_mask);
-	for_each_engine_masked(engine, dev_priv, engine_mask, tmp)
+	for_each_engine_masked(engine, dev_priv, engine_mask, tmp) {
 		init_vgpu_execlist(vgpu, engine->id);
+		intel_vgpu_publish_csb(vgpu, engine->id);
+	}
 }
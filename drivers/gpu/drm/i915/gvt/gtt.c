@@ -1484,7 +1484,7 @@ void intel_vgpu_destroy_mm(struct kref *mm_ref)
 	list_del(&mm->list);
 	list_del(&mm->lru_list);
 
-	if (mm->has_shadow_page_table)
+	if (mm->has_shadow_page_table && mm->shadowed)
 		invalidate_mm(mm);
 
 	gtt->mm_free_page_table(mm);
@@ -1601,7 +1601,12 @@ struct intel_vgpu_mm *intel_vgpu_create_mm(struct intel_vgpu *vgpu,
 		memcpy(mm->virtual_page_table, virtual_page_table,
 				mm->page_table_entry_size);
 
-	if (mm->has_shadow_page_table) {
+	/*
+	 * With lazy PPGTT shadowing the shadow page table is only built when
+	 * the mm is pinned for its first workload, so an mm the guest never
+	 * submits against costs nothing beyond the root entries.
+	 */
+	if (mm->has_shadow_page_table && !i915.gvt_lazy_ppgtt) {
 		ret = shadow_mm(mm);
 		if (ret)
 			goto fail;
@@ -2289,6 +2294,13 @@ int intel_gvt_init_gtt(struct intel_gvt *gvt)
 	gvt->gtt.scratch_ggtt_page = virt_to_page(page);
 	gvt->gtt.scratch_ggtt_mfn = (unsigned long)(daddr >> GTT_PAGE_SHIFT);
 
+	/*
+	 * Lazily shadowed page tables are mostly written by the guest before
+	 * their first use, so let such writes go out of sync and resync them
+	 * in one pass at submission instead of trapping every PTE update.
+	 */
+	enable_out_of_sync = i915.gvt_lazy_ppgtt;
+
 	if (enable_out_of_sync) {
 		ret = setup_spt_oos(gvt);
 		if (ret) {
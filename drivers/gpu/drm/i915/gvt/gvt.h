@@ -46,6 +46,7 @@
 #include "sched_policy.h"
 #include "render.h"
 #include "cmd_parser.h"
+#include "dmabuf.h"
 
 #define GVT_MAX_VGPU 8
 
@@ -138,8 +139,42 @@ struct intel_vgpu_display {
 	struct intel_vgpu_sbi sbi;
 };
 
+#define VGPU_MAX_WEIGHT 16
+
+enum intel_vgpu_latency_class {
+	INTEL_VGPU_LATENCY_BATCH = 0,
+	INTEL_VGPU_LATENCY_INTERACTIVE,
+};
+
 struct vgpu_sched_ctl {
+	/* proportional share, 1 to VGPU_MAX_WEIGHT */
 	int weight;
+	/* upper bound in percent of engine time, 0 for uncapped */
+	int cap;
+	/* interactive vGPUs preempt batch ones when they have work */
+	enum intel_vgpu_latency_class latency_class;
+};
+
+enum intel_vgpu_mmio_class {
+	INTEL_VGPU_MMIO_CLASS_GGTT = 0,
+	INTEL_VGPU_MMIO_CLASS_PVINFO,
+	INTEL_VGPU_MMIO_CLASS_ENGINE,
+	INTEL_VGPU_MMIO_CLASS_DISPLAY,
+	INTEL_VGPU_MMIO_CLASS_OTHER,
+	INTEL_VGPU_MMIO_CLASS_MAX,
+};
+
+/*
+ * Always-on counters, exported through debugfs. The workload and trap
+ * counters are protected by gvt->lock, shadow_time_ns by struct_mutex.
+ */
+struct intel_vgpu_stats {
+	u64 mmio_traps[INTEL_VGPU_MMIO_CLASS_MAX];
+	u64 page_track_faults;
+	u64 workloads_submitted;
+	u64 workloads_completed;
+	u64 gpu_time_ns;
+	u64 shadow_time_ns;
 };
 
 struct intel_vgpu {
@@ -148,6 +183,8 @@ struct intel_vgpu {
 	unsigned long handle; /* vGPU handle used by hypervisor MPT modules */
 	bool active;
 	bool pv_notified;
+	/* guest page registered through pvinfo shared_page_gpa, or 0 */
+	u64 shared_page_gpa;
 	bool failsafe;
 	unsigned int resetting_eng;
 	void *sched_data;
@@ -169,6 +206,11 @@ struct intel_vgpu {
 	struct i915_gem_context *shadow_ctx;
 	DECLARE_BITMAP(shadow_ctx_desc_updated, I915_NUM_ENGINES);
 
+	struct intel_vgpu_bb_cache bb_cache;
+	struct intel_vgpu_flip_fences flip_fences;
+	struct intel_vgpu_stats stats;
+	struct dentry *debugfs;
+
 #if IS_ENABLED(CONFIG_DRM_I915_GVT_KVMGT)
 	struct {
 		struct mdev_device *mdev;
@@ -176,7 +218,9 @@ struct intel_vgpu {
 		int num_regions;
 		struct eventfd_ctx *intx_trigger;
 		struct eventfd_ctx *msi_trigger;
-		struct rb_root cache;
+#define INTEL_GVT_CACHE_HASH_BITS	12
+		DECLARE_HASHTABLE(cache, INTEL_GVT_CACHE_HASH_BITS);
+		unsigned long nr_cache_entries;
 		struct mutex cache_lock;
 		struct notifier_block iommu_notifier;
 		struct notifier_block group_notifier;
@@ -276,6 +320,8 @@ struct intel_gvt {
 	struct task_struct *service_thread;
 	wait_queue_head_t service_thread_wq;
 	unsigned long service_request;
+
+	struct dentry *debugfs_root;
 };
 
 static inline struct intel_gvt *to_gvt(struct drm_i915_private *i915)
@@ -485,6 +531,11 @@ void populate_pvinfo_page(struct intel_vgpu *vgpu);
 
 int intel_gvt_scan_and_shadow_workload(struct intel_vgpu_workload *workload);
 
+int intel_gvt_debugfs_add_vgpu(struct intel_vgpu *vgpu);
+void intel_gvt_debugfs_remove_vgpu(struct intel_vgpu *vgpu);
+int intel_gvt_debugfs_init(struct intel_gvt *gvt);
+void intel_gvt_debugfs_clean(struct intel_gvt *gvt);
+
 struct intel_gvt_ops {
 	int (*emulate_cfg_read)(struct intel_vgpu *, unsigned int, void *,
 				unsigned int);
@@ -500,6 +551,11 @@ struct intel_gvt_ops {
 	void (*vgpu_reset)(struct intel_vgpu *);
 	void (*vgpu_activate)(struct intel_vgpu *);
 	void (*vgpu_deactivate)(struct intel_vgpu *);
+	int (*vgpu_set_sched_ctl)(struct intel_vgpu *,
+				  const struct vgpu_sched_ctl *);
+	void (*vgpu_query_sched_usage)(struct intel_vgpu *, u64 *);
+	int (*vgpu_query_plane)(struct intel_vgpu *, void *);
+	int (*vgpu_get_dmabuf)(struct intel_vgpu *, unsigned int);
 };
 
 
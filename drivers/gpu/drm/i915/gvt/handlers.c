@@ -1168,6 +1168,27 @@ static int send_display_ready_uevent(struct intel_vgpu *vgpu, int ready)
 	return kobject_uevent_env(kobj, KOBJ_ADD, env);
 }
 
+static void handle_shared_page_registration(struct intel_vgpu *vgpu)
+{
+	u64 gpa = vgpu_vreg64(vgpu, vgtif_reg(shared_page_gpa));
+	struct intel_engine_cs *engine;
+	enum intel_engine_id id;
+
+	if (!IS_ALIGNED(gpa, PAGE_SIZE)) {
+		gvt_vgpu_err("invalid shared page gpa %llx\n", gpa);
+		gpa = 0;
+	}
+
+	vgpu->shared_page_gpa = gpa;
+	if (!gpa)
+		return;
+
+	gvt_dbg_core("vgpu%d: shared page registered at %llx\n",
+		     vgpu->id, gpa);
+	for_each_engine(engine, vgpu->gvt->dev_priv, id)
+		intel_vgpu_publish_csb(vgpu, id);
+}
+
 static int pvinfo_mmio_write(struct intel_vgpu *vgpu, unsigned int offset,
 		void *p_data, unsigned int bytes)
 {
@@ -1197,6 +1218,10 @@ static int pvinfo_mmio_write(struct intel_vgpu *vgpu, unsigned int offset,
 	case _vgtif_reg(pdp[3].hi):
 	case _vgtif_reg(execlist_context_descriptor_lo):
 	case _vgtif_reg(execlist_context_descriptor_hi):
+	case _vgtif_reg(shared_page_gpa.lo):
+		break;
+	case _vgtif_reg(shared_page_gpa.hi):
+		handle_shared_page_registration(vgpu);
 		break;
 	case _vgtif_reg(rsv5[0])..._vgtif_reg(rsv5[3]):
 		enter_failsafe_mode(vgpu, GVT_FAILSAFE_INSUFFICIENT_RESOURCE);
@@ -75,11 +75,19 @@ struct kvmgt_guest_info {
 };
 
 struct gvt_dma {
-	struct rb_node node;
+	struct hlist_node node;
 	gfn_t gfn;
 	unsigned long iova;
 };
 
+/*
+ * On a cache miss the aligned window of gfns around the faulting one is
+ * pinned with a single vfio_pin_pages() call, as shadowing a guest page
+ * table almost always walks physically contiguous guest pages next.
+ */
+#define GVT_CACHE_PREFETCH_PAGES	16
+#define GVT_CACHE_UNPIN_BATCH		64
+
 static inline bool handle_valid(unsigned long handle)
 {
 	return !!(handle & ~0xff);
@@ -120,24 +128,13 @@ static void gvt_dma_unmap_iova(struct intel_vgpu *vgpu, unsigned long iova)
 
 static struct gvt_dma *__gvt_cache_find(struct intel_vgpu *vgpu, gfn_t gfn)
 {
-	struct rb_node *node = vgpu->vdev.cache.rb_node;
-	struct gvt_dma *ret = NULL;
+	struct gvt_dma *itr;
 
-	while (node) {
-		struct gvt_dma *itr = rb_entry(node, struct gvt_dma, node);
-
-		if (gfn < itr->gfn)
-			node = node->rb_left;
-		else if (gfn > itr->gfn)
-			node = node->rb_right;
-		else {
-			ret = itr;
-			goto out;
-		}
+	hash_for_each_possible(vgpu->vdev.cache, itr, node, gfn) {
+		if (itr->gfn == gfn)
+			return itr;
 	}
-
-out:
-	return ret;
+	return NULL;
 }
 
 static unsigned long gvt_cache_find(struct intel_vgpu *vgpu, gfn_t gfn)
@@ -154,98 +151,168 @@ static unsigned long gvt_cache_find(struct intel_vgpu *vgpu, gfn_t gfn)
 	return iova;
 }
 
-static void gvt_cache_add(struct intel_vgpu *vgpu, gfn_t gfn,
+static int __gvt_cache_add(struct intel_vgpu *vgpu, gfn_t gfn,
 		unsigned long iova)
 {
-	struct gvt_dma *new, *itr;
-	struct rb_node **link = &vgpu->vdev.cache.rb_node, *parent = NULL;
+	struct gvt_dma *new;
 
 	new = kzalloc(sizeof(struct gvt_dma), GFP_KERNEL);
 	if (!new)
-		return;
+		return -ENOMEM;
 
 	new->gfn = gfn;
 	new->iova = iova;
 
+	hash_add(vgpu->vdev.cache, &new->node, gfn);
+	vgpu->vdev.nr_cache_entries++;
+	return 0;
+}
+
+static void __gvt_cache_remove_entry(struct intel_vgpu *vgpu,
+				struct gvt_dma *entry)
+{
+	hash_del(&entry->node);
+	vgpu->vdev.nr_cache_entries--;
+	kfree(entry);
+}
+
+/*
+ * Pin and map every gfn of [gfn, gfn + nr) that is not cached yet, using a
+ * single vfio_pin_pages() call. Returns the number of gfns added to the
+ * cache or a negative error code, in which case nothing was added.
+ */
+static int gvt_cache_pin_range(struct intel_vgpu *vgpu, gfn_t gfn,
+		unsigned int nr)
+{
+	struct device *dev = mdev_dev(vgpu->vdev.mdev);
+	unsigned long gfns[GVT_CACHE_PREFETCH_PAGES];
+	unsigned long pfns[GVT_CACHE_PREFETCH_PAGES];
+	unsigned long iova;
+	int i, n = 0, rc;
+
+	if (WARN_ON(nr > GVT_CACHE_PREFETCH_PAGES))
+		return -EINVAL;
+
 	mutex_lock(&vgpu->vdev.cache_lock);
-	while (*link) {
-		parent = *link;
-		itr = rb_entry(parent, struct gvt_dma, node);
 
-		if (gfn == itr->gfn)
-			goto out;
-		else if (gfn < itr->gfn)
-			link = &parent->rb_left;
-		else
-			link = &parent->rb_right;
+	for (i = 0; i < nr; i++) {
+		if (!__gvt_cache_find(vgpu, gfn + i))
+			gfns[n++] = gfn + i;
+	}
+	if (!n) {
+		rc = 0;
+		goto out;
+	}
+
+	rc = vfio_pin_pages(dev, gfns, n, IOMMU_READ | IOMMU_WRITE, pfns);
+	if (rc != n) {
+		if (rc > 0)
+			vfio_unpin_pages(dev, gfns, rc);
+		rc = rc < 0 ? rc : -EFAULT;
+		goto out;
+	}
+
+	for (i = 0; i < n; i++) {
+		/* transfer to host iova for GFX to use DMA */
+		rc = gvt_dma_map_iova(vgpu, pfns[i], &iova);
+		if (rc)
+			goto err;
+
+		rc = __gvt_cache_add(vgpu, gfns[i], iova);
+		if (rc) {
+			gvt_dma_unmap_iova(vgpu, iova);
+			goto err;
+		}
 	}
 
-	rb_link_node(&new->node, parent, link);
-	rb_insert_color(&new->node, &vgpu->vdev.cache);
 	mutex_unlock(&vgpu->vdev.cache_lock);
-	return;
+	return n;
+
+err:
+	while (i--) {
+		struct gvt_dma *entry = __gvt_cache_find(vgpu, gfns[i]);
 
+		gvt_dma_unmap_iova(vgpu, entry->iova);
+		__gvt_cache_remove_entry(vgpu, entry);
+	}
+	vfio_unpin_pages(dev, gfns, n);
 out:
 	mutex_unlock(&vgpu->vdev.cache_lock);
-	kfree(new);
+	return rc;
 }
 
-static void __gvt_cache_remove_entry(struct intel_vgpu *vgpu,
-				struct gvt_dma *entry)
+struct gvt_unpin_batch {
+	unsigned long gfns[GVT_CACHE_UNPIN_BATCH];
+	int n;
+};
+
+static void gvt_unpin_batch_flush(struct intel_vgpu *vgpu,
+		struct gvt_unpin_batch *batch)
 {
-	rb_erase(&entry->node, &vgpu->vdev.cache);
-	kfree(entry);
+	int rc;
+
+	if (!batch->n)
+		return;
+
+	rc = vfio_unpin_pages(mdev_dev(vgpu->vdev.mdev), batch->gfns,
+			      batch->n);
+	WARN_ON(rc != batch->n);
+	batch->n = 0;
 }
 
-static void gvt_cache_remove(struct intel_vgpu *vgpu, gfn_t gfn)
+static void __gvt_cache_unpin_entry(struct intel_vgpu *vgpu,
+		struct gvt_dma *entry, struct gvt_unpin_batch *batch)
 {
-	struct device *dev = mdev_dev(vgpu->vdev.mdev);
+	gvt_dma_unmap_iova(vgpu, entry->iova);
+	batch->gfns[batch->n++] = entry->gfn;
+	__gvt_cache_remove_entry(vgpu, entry);
+
+	if (batch->n == GVT_CACHE_UNPIN_BATCH)
+		gvt_unpin_batch_flush(vgpu, batch);
+}
+
+/*
+ * Drop the cached translations of [gfn, end_gfn), unpinning the pages in
+ * batches. Ranges larger than the cache, e.g. the guest tearing down all
+ * of its memory, walk the cache rather than every gfn of the range.
+ */
+static void gvt_cache_remove_range(struct intel_vgpu *vgpu, gfn_t gfn,
+		gfn_t end_gfn)
+{
+	struct gvt_unpin_batch batch = { .n = 0 };
 	struct gvt_dma *this;
-	unsigned long g1;
-	int rc;
+	struct hlist_node *tmp;
+	int bkt;
 
 	mutex_lock(&vgpu->vdev.cache_lock);
-	this  = __gvt_cache_find(vgpu, gfn);
-	if (!this) {
-		mutex_unlock(&vgpu->vdev.cache_lock);
-		return;
+
+	if (end_gfn - gfn > vgpu->vdev.nr_cache_entries) {
+		hash_for_each_safe(vgpu->vdev.cache, bkt, tmp, this, node) {
+			if (this->gfn >= gfn && this->gfn < end_gfn)
+				__gvt_cache_unpin_entry(vgpu, this, &batch);
+		}
+	} else {
+		for (; gfn < end_gfn; gfn++) {
+			this = __gvt_cache_find(vgpu, gfn);
+			if (this)
+				__gvt_cache_unpin_entry(vgpu, this, &batch);
+		}
 	}
+	gvt_unpin_batch_flush(vgpu, &batch);
 
-	g1 = gfn;
-	gvt_dma_unmap_iova(vgpu, this->iova);
-	rc = vfio_unpin_pages(dev, &g1, 1);
-	WARN_ON(rc != 1);
-	__gvt_cache_remove_entry(vgpu, this);
 	mutex_unlock(&vgpu->vdev.cache_lock);
 }
 
 static void gvt_cache_init(struct intel_vgpu *vgpu)
 {
-	vgpu->vdev.cache = RB_ROOT;
+	hash_init(vgpu->vdev.cache);
+	vgpu->vdev.nr_cache_entries = 0;
 	mutex_init(&vgpu->vdev.cache_lock);
 }
 
 static void gvt_cache_destroy(struct intel_vgpu *vgpu)
 {
-	struct gvt_dma *dma;
-	struct rb_node *node = NULL;
-	struct device *dev = mdev_dev(vgpu->vdev.mdev);
-	unsigned long gfn;
-
-	for (;;) {
-		mutex_lock(&vgpu->vdev.cache_lock);
-		node = rb_first(&vgpu->vdev.cache);
-		if (!node) {
-			mutex_unlock(&vgpu->vdev.cache_lock);
-			break;
-		}
-		dma = rb_entry(node, struct gvt_dma, node);
-		gvt_dma_unmap_iova(vgpu, dma->iova);
-		gfn = dma->gfn;
-		__gvt_cache_remove_entry(vgpu, dma);
-		mutex_unlock(&vgpu->vdev.cache_lock);
-		vfio_unpin_pages(dev, &gfn, 1);
-	}
+	gvt_cache_remove_range(vgpu, 0, ~(gfn_t)0);
 }
 
 static struct intel_vgpu_type *intel_gvt_find_vgpu_type(struct intel_gvt *gvt,
@@ -494,8 +561,7 @@ static int intel_vgpu_iommu_notifier(struct notifier_block *nb,
 		gfn = unmap->iova >> PAGE_SHIFT;
 		end_gfn = gfn + unmap->size / PAGE_SIZE;
 
-		while (gfn < end_gfn)
-			gvt_cache_remove(vgpu, gfn++);
+		gvt_cache_remove_range(vgpu, gfn, end_gfn);
 	}
 
 	return NOTIFY_OK;
@@ -1151,6 +1217,31 @@ static long intel_vgpu_ioctl(struct mdev_device *mdev, unsigned int cmd,
 	} else if (cmd == VFIO_DEVICE_RESET) {
 		intel_gvt_ops->vgpu_reset(vgpu);
 		return 0;
+	} else if (cmd == VFIO_DEVICE_QUERY_GFX_PLANE) {
+		struct vfio_device_gfx_plane_info info;
+		int ret;
+
+		minsz = offsetofend(struct vfio_device_gfx_plane_info, pad);
+
+		if (copy_from_user(&info, (void __user *)arg, minsz))
+			return -EFAULT;
+
+		if (info.argsz < minsz)
+			return -EINVAL;
+
+		ret = intel_gvt_ops->vgpu_query_plane(vgpu, &info);
+		if (ret)
+			return ret;
+
+		return copy_to_user((void __user *)arg, &info, minsz) ?
+			-EFAULT : 0;
+	} else if (cmd == VFIO_DEVICE_GET_GFX_DMABUF) {
+		__u32 plane_type;
+
+		if (get_user(plane_type, (__u32 __user *)arg))
+			return -EFAULT;
+
+		return intel_gvt_ops->vgpu_get_dmabuf(vgpu, plane_type);
 	}
 
 	return 0;
@@ -1185,12 +1276,165 @@ hw_id_show(struct device *dev, struct device_attribute *attr,
 	return sprintf(buf, "\n");
 }
 
+static const char * const vgpu_latency_class_names[] = {
+	[INTEL_VGPU_LATENCY_BATCH] = "batch",
+	[INTEL_VGPU_LATENCY_INTERACTIVE] = "interactive",
+};
+
+static ssize_t
+sched_weight_show(struct device *dev, struct device_attribute *attr,
+		  char *buf)
+{
+	struct mdev_device *mdev = mdev_from_dev(dev);
+
+	if (mdev) {
+		struct intel_vgpu *vgpu = (struct intel_vgpu *)
+			mdev_get_drvdata(mdev);
+		return sprintf(buf, "%d\n", vgpu->sched_ctl.weight);
+	}
+	return sprintf(buf, "\n");
+}
+
+static ssize_t
+sched_weight_store(struct device *dev, struct device_attribute *attr,
+		   const char *buf, size_t count)
+{
+	struct mdev_device *mdev = mdev_from_dev(dev);
+	struct intel_vgpu *vgpu;
+	struct vgpu_sched_ctl ctl;
+	int ret;
+
+	if (!mdev)
+		return -ENODEV;
+
+	vgpu = mdev_get_drvdata(mdev);
+	ctl = vgpu->sched_ctl;
+	ret = kstrtoint(buf, 0, &ctl.weight);
+	if (ret)
+		return ret;
+
+	ret = intel_gvt_ops->vgpu_set_sched_ctl(vgpu, &ctl);
+	return ret ?: count;
+}
+
+static ssize_t
+sched_cap_show(struct device *dev, struct device_attribute *attr,
+	       char *buf)
+{
+	struct mdev_device *mdev = mdev_from_dev(dev);
+
+	if (mdev) {
+		struct intel_vgpu *vgpu = (struct intel_vgpu *)
+			mdev_get_drvdata(mdev);
+		return sprintf(buf, "%d\n", vgpu->sched_ctl.cap);
+	}
+	return sprintf(buf, "\n");
+}
+
+static ssize_t
+sched_cap_store(struct device *dev, struct device_attribute *attr,
+		const char *buf, size_t count)
+{
+	struct mdev_device *mdev = mdev_from_dev(dev);
+	struct intel_vgpu *vgpu;
+	struct vgpu_sched_ctl ctl;
+	int ret;
+
+	if (!mdev)
+		return -ENODEV;
+
+	vgpu = mdev_get_drvdata(mdev);
+	ctl = vgpu->sched_ctl;
+	ret = kstrtoint(buf, 0, &ctl.cap);
+	if (ret)
+		return ret;
+
+	ret = intel_gvt_ops->vgpu_set_sched_ctl(vgpu, &ctl);
+	return ret ?: count;
+}
+
+static ssize_t
+sched_latency_class_show(struct device *dev, struct device_attribute *attr,
+			 char *buf)
+{
+	struct mdev_device *mdev = mdev_from_dev(dev);
+
+	if (mdev) {
+		struct intel_vgpu *vgpu = (struct intel_vgpu *)
+			mdev_get_drvdata(mdev);
+		return sprintf(buf, "%s\n",
+			vgpu_latency_class_names[vgpu->sched_ctl.latency_class]);
+	}
+	return sprintf(buf, "\n");
+}
+
+static ssize_t
+sched_latency_class_store(struct device *dev, struct device_attribute *attr,
+			  const char *buf, size_t count)
+{
+	struct mdev_device *mdev = mdev_from_dev(dev);
+	struct intel_vgpu *vgpu;
+	struct vgpu_sched_ctl ctl;
+	unsigned int i;
+	int ret;
+
+	if (!mdev)
+		return -ENODEV;
+
+	vgpu = mdev_get_drvdata(mdev);
+	ctl = vgpu->sched_ctl;
+
+	for (i = 0; i < ARRAY_SIZE(vgpu_latency_class_names); i++)
+		if (sysfs_streq(buf, vgpu_latency_class_names[i]))
+			break;
+	if (i == ARRAY_SIZE(vgpu_latency_class_names))
+		return -EINVAL;
+	ctl.latency_class = i;
+
+	ret = intel_gvt_ops->vgpu_set_sched_ctl(vgpu, &ctl);
+	return ret ?: count;
+}
+
+static ssize_t
+sched_usage_show(struct device *dev, struct device_attribute *attr,
+		 char *buf)
+{
+	struct mdev_device *mdev = mdev_from_dev(dev);
+	struct drm_i915_private *dev_priv;
+	struct intel_engine_cs *engine;
+	enum intel_engine_id id;
+	struct intel_vgpu *vgpu;
+	u64 usage[I915_NUM_ENGINES];
+	ssize_t len = 0;
+
+	if (!mdev)
+		return sprintf(buf, "\n");
+
+	vgpu = mdev_get_drvdata(mdev);
+	dev_priv = vgpu->gvt->dev_priv;
+	intel_gvt_ops->vgpu_query_sched_usage(vgpu, usage);
+
+	for_each_engine(engine, dev_priv, id)
+		len += sprintf(buf + len, "%s: %llu ns\n",
+			       engine->name, usage[id]);
+
+	return len;
+}
+
 static DEVICE_ATTR_RO(vgpu_id);
 static DEVICE_ATTR_RO(hw_id);
+static DEVICE_ATTR_RW(sched_weight);
+static DEVICE_ATTR_RW(sched_cap);
+static DEVICE_ATTR_RW(sched_latency_class);
+static DEVICE_ATTR_RO(sched_usage);
 
 static struct attribute *intel_vgpu_attrs[] = {
 	&dev_attr_vgpu_id.attr,
 	&dev_attr_hw_id.attr,
+	&dev_attr_sched_weight.attr,
+	&dev_attr_sched_cap.attr,
+	&dev_attr_sched_latency_class.attr,
+	&dev_attr_sched_usage.attr,
 	NULL
 };
 
@@ -1438,9 +1682,8 @@ static int kvmgt_inject_msi(unsigned long handle, u32 addr, u16 data)
 
 static unsigned long kvmgt_gfn_to_pfn(unsigned long handle, unsigned long gfn)
 {
-	unsigned long iova, pfn;
+	unsigned long iova, start;
 	struct kvmgt_guest_info *info;
-	struct device *dev;
 	struct intel_vgpu *vgpu;
 	int rc;
 
@@ -1449,28 +1692,24 @@ static unsigned long kvmgt_gfn_to_pfn(unsigned long handle, unsigned long gfn)
 
 	info = (struct kvmgt_guest_info *)handle;
 	vgpu = info->vgpu;
-	iova = gvt_cache_find(info->vgpu, gfn);
+	iova = gvt_cache_find(vgpu, gfn);
 	if (iova != INTEL_GVT_INVALID_ADDR)
 		return iova;
 
-	pfn = INTEL_GVT_INVALID_ADDR;
-	dev = mdev_dev(info->vgpu->vdev.mdev);
-	rc = vfio_pin_pages(dev, &gfn, 1, IOMMU_READ | IOMMU_WRITE, &pfn);
-	if (rc != 1) {
-		gvt_vgpu_err("vfio_pin_pages failed for gfn 0x%lx: %d\n",
-			gfn, rc);
-		return INTEL_GVT_INVALID_ADDR;
-	}
-	/* transfer to host iova for GFX to use DMA */
-	rc = gvt_dma_map_iova(info->vgpu, pfn, &iova);
-	if (rc) {
-		gvt_vgpu_err("gvt_dma_map_iova failed for gfn: 0x%lx\n", gfn);
-		vfio_unpin_pages(dev, &gfn, 1);
+	/*
+	 * Neighbouring gfns may fall outside of guest memory, so fall back
+	 * to pinning only the requested one if the window can't be pinned.
+	 */
+	start = round_down(gfn, GVT_CACHE_PREFETCH_PAGES);
+	rc = gvt_cache_pin_range(vgpu, start, GVT_CACHE_PREFETCH_PAGES);
+	if (rc < 0)
+		rc = gvt_cache_pin_range(vgpu, gfn, 1);
+	if (rc < 0) {
+		gvt_vgpu_err("fail to pin gfn 0x%lx: %d\n", gfn, rc);
 		return INTEL_GVT_INVALID_ADDR;
 	}
 
-	gvt_cache_add(info->vgpu, gfn, iova);
-	return iova;
+	return gvt_cache_find(vgpu, gfn);
 }
 
 static int kvmgt_rw_gpa(unsigned long handle, unsigned long gpa,
@@ -35,6 +35,7 @@
 
 #include "i915_drv.h"
 #include "gvt.h"
+#include "i915_pvinfo.h"
 
 /**
  * intel_vgpu_gpa_to_mmio_offset - translate a GPA to MMIO offset
@@ -109,6 +110,36 @@ static void failsafe_emulate_mmio_rw(struct intel_vgpu *vgpu, uint64_t pa,
 	mutex_unlock(&gvt->lock);
 }
 
+#define GVT_DISPLAY_MMIO_START	0x40000
+#define GVT_DISPLAY_MMIO_END	0x80000
+
+static void count_mmio_trap(struct intel_vgpu *vgpu, unsigned int offset)
+{
+	struct intel_gvt *gvt = vgpu->gvt;
+	struct intel_engine_cs *engine;
+	enum intel_engine_id id;
+	int class = INTEL_VGPU_MMIO_CLASS_OTHER;
+
+	if (reg_is_gtt(gvt, offset))
+		class = INTEL_VGPU_MMIO_CLASS_GGTT;
+	else if (offset >= VGT_PVINFO_PAGE &&
+		 offset < VGT_PVINFO_PAGE + VGT_PVINFO_SIZE)
+		class = INTEL_VGPU_MMIO_CLASS_PVINFO;
+	else if (offset >= GVT_DISPLAY_MMIO_START &&
+		 offset < GVT_DISPLAY_MMIO_END)
+		class = INTEL_VGPU_MMIO_CLASS_DISPLAY;
+	else {
+		for_each_engine(engine, gvt->dev_priv, id) {
+			if ((offset & ~GENMASK(11, 0)) == engine->mmio_base) {
+				class = INTEL_VGPU_MMIO_CLASS_ENGINE;
+				break;
+			}
+		}
+	}
+
+	vgpu->stats.mmio_traps[class]++;
+}
+
 /**
  * intel_vgpu_emulate_mmio_read - emulate MMIO read
  * @vgpu: a vGPU
@@ -152,6 +183,7 @@ int intel_vgpu_emulate_mmio_read(struct intel_vgpu *vgpu, uint64_t pa,
 	}
 
 	offset = intel_vgpu_gpa_to_mmio_offset(vgpu, pa);
+	count_mmio_trap(vgpu, offset);
 
 	if (WARN_ON(bytes > 8))
 		goto err;
@@ -229,6 +261,7 @@ int intel_vgpu_emulate_mmio_write(struct intel_vgpu *vgpu, uint64_t pa,
 
 		gp = intel_vgpu_find_guest_page(vgpu, pa >> PAGE_SHIFT);
 		if (gp) {
+			vgpu->stats.page_track_faults++;
 			ret = gp->handler(gp, pa, p_data, bytes);
 			if (ret) {
 				gvt_err("guest page write error %d, "
@@ -243,6 +276,7 @@ int intel_vgpu_emulate_mmio_write(struct intel_vgpu *vgpu, uint64_t pa,
 	}
 
 	offset = intel_vgpu_gpa_to_mmio_offset(vgpu, pa);
+	count_mmio_trap(vgpu, offset);
 
 	if (WARN_ON(bytes > 8))
 		goto err;
@@ -189,10 +189,18 @@ static void handle_tlb_pending_event(struct intel_vgpu *vgpu, int ring_id)
 	gvt_dbg_core("invalidate TLB for ring %d\n", ring_id);
 }
 
-static void load_mocs(struct intel_vgpu *vgpu, int ring_id)
+/*
+ * Save the MOCS of the previous owner of the engine (the host if @pre is
+ * NULL) and load the ones of the next owner, writing only the entries that
+ * actually differ. Returns the number of registers written.
+ */
+static unsigned int switch_mocs(struct intel_vgpu *pre,
+				struct intel_vgpu *next, int ring_id)
 {
-	struct drm_i915_private *dev_priv = vgpu->gvt->dev_priv;
+	struct drm_i915_private *dev_priv = pre ? pre->gvt->dev_priv :
+						  next->gvt->dev_priv;
 	i915_reg_t offset, l3_offset;
+	u32 old_v, new_v;
 	u32 regs[] = {
 		[RCS] = 0xc800,
 		[VCS] = 0xc900,
@@ -200,135 +208,87 @@ static void load_mocs(struct intel_vgpu *vgpu, int ring_id)
 		[BCS] = 0xcc00,
 		[VECS] = 0xcb00,
 	};
+	unsigned int writes = 0;
 	int i;
 
 	if (WARN_ON(ring_id >= ARRAY_SIZE(regs)))
-		return;
+		return 0;
 
 	offset.reg = regs[ring_id];
 	for (i = 0; i < 64; i++) {
-		gen9_render_mocs[ring_id][i] = I915_READ_FW(offset);
-		I915_WRITE(offset, vgpu_vreg(vgpu, offset));
-		offset.reg += 4;
-	}
+		old_v = I915_READ_FW(offset);
+		if (pre)
+			vgpu_vreg(pre, offset) = old_v;
+		else
+			gen9_render_mocs[ring_id][i] = old_v;
 
-	if (ring_id == RCS) {
-		l3_offset.reg = 0xb020;
-		for (i = 0; i < 32; i++) {
-			gen9_render_mocs_L3[i] = I915_READ_FW(l3_offset);
-			I915_WRITE_FW(l3_offset, vgpu_vreg(vgpu, l3_offset));
-			l3_offset.reg += 4;
+		new_v = next ? vgpu_vreg(next, offset) :
+			       gen9_render_mocs[ring_id][i];
+		if (new_v != old_v) {
+			I915_WRITE_FW(offset, new_v);
+			writes++;
 		}
-	}
-}
-
-static void restore_mocs(struct intel_vgpu *vgpu, int ring_id)
-{
-	struct drm_i915_private *dev_priv = vgpu->gvt->dev_priv;
-	i915_reg_t offset, l3_offset;
-	u32 regs[] = {
-		[RCS] = 0xc800,
-		[VCS] = 0xc900,
-		[VCS2] = 0xca00,
-		[BCS] = 0xcc00,
-		[VECS] = 0xcb00,
-	};
-	int i;
-
-	if (WARN_ON(ring_id >= ARRAY_SIZE(regs)))
-		return;
-
-	offset.reg = regs[ring_id];
-	for (i = 0; i < 64; i++) {
-		vgpu_vreg(vgpu, offset) = I915_READ_FW(offset);
-		I915_WRITE_FW(offset, gen9_render_mocs[ring_id][i]);
 		offset.reg += 4;
 	}
 
 	if (ring_id == RCS) {
 		l3_offset.reg = 0xb020;
 		for (i = 0; i < 32; i++) {
-			vgpu_vreg(vgpu, l3_offset) = I915_READ_FW(l3_offset);
-			I915_WRITE_FW(l3_offset, gen9_render_mocs_L3[i]);
+			old_v = I915_READ_FW(l3_offset);
+			if (pre)
+				vgpu_vreg(pre, l3_offset) = old_v;
+			else
+				gen9_render_mocs_L3[i] = old_v;
+
+			new_v = next ? vgpu_vreg(next, l3_offset) :
+				       gen9_render_mocs_L3[i];
+			if (new_v != old_v) {
+				I915_WRITE_FW(l3_offset, new_v);
+				writes++;
+			}
 			l3_offset.reg += 4;
 		}
 	}
+
+	return writes;
 }
 
 #define CTX_CONTEXT_CONTROL_VAL	0x03
 
-/* Switch ring mmio values (context) from host to a vgpu. */
-static void switch_mmio_to_vgpu(struct intel_vgpu *vgpu, int ring_id)
+static bool is_inhibit_context(struct intel_vgpu *vgpu, int ring_id)
 {
-	struct drm_i915_private *dev_priv = vgpu->gvt->dev_priv;
-	struct render_mmio *mmio;
-	u32 v;
-	int i, array_size;
 	u32 *reg_state = vgpu->shadow_ctx->engine[ring_id].lrc_reg_state;
-	u32 ctx_ctrl = reg_state[CTX_CONTEXT_CONTROL_VAL];
 	u32 inhibit_mask =
 		_MASKED_BIT_ENABLE(CTX_CTRL_ENGINE_CTX_RESTORE_INHIBIT);
-	i915_reg_t last_reg = _MMIO(0);
 
-	if (IS_SKYLAKE(vgpu->gvt->dev_priv)
-		|| IS_KABYLAKE(vgpu->gvt->dev_priv)) {
-		mmio = gen9_render_mmio_list;
-		array_size = ARRAY_SIZE(gen9_render_mmio_list);
-		load_mocs(vgpu, ring_id);
-	} else {
-		mmio = gen8_render_mmio_list;
-		array_size = ARRAY_SIZE(gen8_render_mmio_list);
-	}
-
-	for (i = 0; i < array_size; i++, mmio++) {
-		if (mmio->ring_id != ring_id)
-			continue;
-
-		mmio->value = I915_READ_FW(mmio->reg);
-
-		/*
-		 * if it is an inhibit context, load in_context mmio
-		 * into HW by mmio write. If it is not, skip this mmio
-		 * write.
-		 */
-		if (mmio->in_context &&
-				((ctx_ctrl & inhibit_mask) != inhibit_mask) &&
-				i915.enable_execlists)
-			continue;
-
-		if (mmio->mask)
-			v = vgpu_vreg(vgpu, mmio->reg) | (mmio->mask << 16);
-		else
-			v = vgpu_vreg(vgpu, mmio->reg);
-
-		I915_WRITE_FW(mmio->reg, v);
-		last_reg = mmio->reg;
-
-		trace_render_mmio(vgpu->id, "load",
-				  i915_mmio_reg_offset(mmio->reg),
-				  mmio->value, v);
-	}
-
-	/* Make sure the swiched MMIOs has taken effect. */
-	if (likely(INTEL_GVT_MMIO_OFFSET(last_reg)))
-		I915_READ_FW(last_reg);
-
-	handle_tlb_pending_event(vgpu, ring_id);
+	return (reg_state[CTX_CONTEXT_CONTROL_VAL] & inhibit_mask) ==
+		inhibit_mask;
 }
 
-/* Switch ring mmio values (context) from vgpu to host. */
-static void switch_mmio_to_host(struct intel_vgpu *vgpu, int ring_id)
+/*
+ * Switch the ring mmio values (context) of @ring_id from @pre to @next in
+ * a single pass, either of them being NULL for the host. The values of the
+ * previous owner are saved, and a register is only written when the next
+ * owner's value differs from what the hardware holds: on a vGPU to vGPU
+ * switch this avoids restoring the host value just to overwrite it again.
+ * Returns the number of registers written.
+ */
+static unsigned int switch_mmio(struct intel_vgpu *pre,
+				struct intel_vgpu *next, int ring_id)
 {
-	struct drm_i915_private *dev_priv = vgpu->gvt->dev_priv;
+	struct drm_i915_private *dev_priv = pre ? pre->gvt->dev_priv :
+						  next->gvt->dev_priv;
 	struct render_mmio *mmio;
 	i915_reg_t last_reg = _MMIO(0);
-	u32 v;
+	bool next_inhibit = next && is_inhibit_context(next, ring_id);
+	unsigned int writes = 0;
+	u32 old_v, new_v, mask;
 	int i, array_size;
 
 	if (IS_SKYLAKE(dev_priv) || IS_KABYLAKE(dev_priv)) {
 		mmio = gen9_render_mmio_list;
 		array_size = ARRAY_SIZE(gen9_render_mmio_list);
-		restore_mocs(vgpu, ring_id);
+		writes += switch_mocs(pre, next, ring_id);
 	} else {
 		mmio = gen8_render_mmio_list;
 		array_size = ARRAY_SIZE(gen8_render_mmio_list);
@@ -338,28 +298,56 @@ static void switch_mmio_to_host(struct intel_vgpu *vgpu, int ring_id)
 		if (mmio->ring_id != ring_id)
 			continue;
 
-		vgpu_vreg(vgpu, mmio->reg) = I915_READ_FW(mmio->reg);
-
-		if (mmio->mask) {
-			vgpu_vreg(vgpu, mmio->reg) &= ~(mmio->mask << 16);
-			v = mmio->value | (mmio->mask << 16);
+		old_v = I915_READ_FW(mmio->reg);
+		if (pre) {
+			vgpu_vreg(pre, mmio->reg) = old_v;
+			if (mmio->mask)
+				vgpu_vreg(pre, mmio->reg) &= ~(mmio->mask << 16);
 		} else
-			v = mmio->value;
+			mmio->value = old_v;
+
+		if (next) {
+			/*
+			 * if it is an inhibit context, load in_context mmio
+			 * into HW by mmio write. If it is not, skip this mmio
+			 * write.
+			 */
+			if (mmio->in_context && !next_inhibit &&
+			    i915.enable_execlists)
+				continue;
+			new_v = vgpu_vreg(next, mmio->reg);
+		} else {
+			if (mmio->in_context)
+				continue;
+			new_v = mmio->value;
+		}
 
-		if (mmio->in_context)
+		/* only the unmasked bits of a masked register are compared */
+		mask = mmio->mask ? mmio->mask : ~0u;
+		if ((new_v & mask) == (old_v & mask))
 			continue;
 
-		I915_WRITE_FW(mmio->reg, v);
+		if (mmio->mask)
+			new_v |= mmio->mask << 16;
+
+		I915_WRITE_FW(mmio->reg, new_v);
 		last_reg = mmio->reg;
+		writes++;
 
-		trace_render_mmio(vgpu->id, "restore",
+		trace_render_mmio(next ? next->id : pre->id,
+				  next ? "load" : "restore",
 				  i915_mmio_reg_offset(mmio->reg),
-				  mmio->value, v);
+				  old_v, new_v);
 	}
 
 	/* Make sure the swiched MMIOs has taken effect. */
 	if (likely(INTEL_GVT_MMIO_OFFSET(last_reg)))
 		I915_READ_FW(last_reg);
+
+	if (next)
+		handle_tlb_pending_event(next, ring_id);
+
+	return writes;
 }
 
 /**
@@ -369,12 +357,20 @@ static void switch_mmio_to_host(struct intel_vgpu *vgpu, int ring_id)
  * @ring_id: specify the engine
  *
  * If pre is null indicates that host own the engine. If next is null
- * indicates that we are switching to host workload.
+ * indicates that we are switching to host workload. The time spent and
+ * the number of registers written are accounted in the scheduler's
+ * mmio_switch_stats of the engine, protected by the mmio_context_lock the
+ * callers hold.
  */
 void intel_gvt_switch_mmio(struct intel_vgpu *pre,
 			   struct intel_vgpu *next, int ring_id)
 {
+	struct intel_gvt *gvt;
 	struct drm_i915_private *dev_priv;
+	struct intel_gvt_mmio_switch_stats *stats;
+	ktime_t start;
+	u64 delta;
+	unsigned int writes;
 
 	if (WARN_ON(!pre && !next))
 		return;
@@ -382,7 +378,9 @@ void intel_gvt_switch_mmio(struct intel_vgpu *pre,
 	gvt_dbg_render("switch ring %d from %s to %s\n", ring_id,
 		       pre ? "vGPU" : "host", next ? "vGPU" : "HOST");
 
-	dev_priv = pre ? pre->gvt->dev_priv : next->gvt->dev_priv;
+	gvt = pre ? pre->gvt : next->gvt;
+	dev_priv = gvt->dev_priv;
+	start = ktime_get();
 
 	/**
 	 * We are using raw mmio access wrapper to improve the
@@ -390,16 +388,13 @@ void intel_gvt_switch_mmio(struct intel_vgpu *pre,
 	 * handle forcewake mannually.
 	 */
 	intel_uncore_forcewake_get(dev_priv, FORCEWAKE_ALL);
-
-	/**
-	 * TODO: Optimize for vGPU to vGPU switch by merging
-	 * switch_mmio_to_host() and switch_mmio_to_vgpu().
-	 */
-	if (pre)
-		switch_mmio_to_host(pre, ring_id);
-
-	if (next)
-		switch_mmio_to_vgpu(next, ring_id);
-
+	writes = switch_mmio(pre, next, ring_id);
 	intel_uncore_forcewake_put(dev_priv, FORCEWAKE_ALL);
+
+	delta = ktime_to_ns(ktime_sub(ktime_get(), start));
+	stats = &gvt->scheduler.mmio_switch_stats[ring_id];
+	stats->count++;
+	stats->writes += writes;
+	stats->total_ns += delta;
+	stats->max_ns = max(stats->max_ns, delta);
 }
@@ -34,106 +34,83 @@
 #include "i915_drv.h"
 #include "gvt.h"
 
-static bool vgpu_has_pending_workload(struct intel_vgpu *vgpu)
+static bool vgpu_has_pending_workload(struct intel_vgpu *vgpu, int ring_id)
 {
-	enum intel_engine_id i;
-	struct intel_engine_cs *engine;
-
-	for_each_engine(engine, vgpu->gvt->dev_priv, i) {
-		if (!list_empty(workload_q_head(vgpu, i)))
-			return true;
-	}
-
-	return false;
+	return !list_empty(workload_q_head(vgpu, ring_id));
 }
 
 struct vgpu_sched_data {
 	struct list_head lru_list;
 	struct intel_vgpu *vgpu;
 
-	ktime_t sched_in_time;
-	ktime_t sched_out_time;
-	ktime_t sched_time;
-	ktime_t left_ts;
-	ktime_t allocated_ts;
-
-	struct vgpu_sched_ctl sched_ctl;
+	/* engine time consumed, scaled down by the weight, per engine */
+	u64 vruntime[I915_NUM_ENGINES];
+	/* engine time consumed in the current cap window */
+	u64 window_usage;
+	/* engine time consumed since creation, per engine */
+	u64 engine_usage[I915_NUM_ENGINES];
 };
 
 struct gvt_sched_data {
 	struct intel_gvt *gvt;
 	struct hrtimer timer;
 	unsigned long period;
+	ktime_t window_start;
+	u64 min_vruntime[I915_NUM_ENGINES];
 	struct list_head lru_runq_head;
 };
 
-static void vgpu_update_timeslice(struct intel_vgpu *pre_vgpu)
+/* Caps are enforced over windows of this length */
+#define GVT_SCHED_WINDOW_MS 100
+
+/*
+ * An interactive vGPU is picked ahead of batch vGPUs until it has run this
+ * much (weighted) engine time more than them.
+ */
+#define GVT_SCHED_LATENCY_CREDIT (2 * NSEC_PER_MSEC)
+
+static void gvt_reset_sched_window(struct gvt_sched_data *sched_data,
+				   ktime_t cur_time)
 {
-	ktime_t delta_ts;
-	struct vgpu_sched_data *vgpu_data = pre_vgpu->sched_data;
+	struct vgpu_sched_data *vgpu_data;
 
-	delta_ts = vgpu_data->sched_out_time - vgpu_data->sched_in_time;
+	list_for_each_entry(vgpu_data, &sched_data->lru_runq_head, lru_list)
+		vgpu_data->window_usage = 0;
 
-	vgpu_data->sched_time += delta_ts;
-	vgpu_data->left_ts -= delta_ts;
+	sched_data->window_start = cur_time;
 }
 
-#define GVT_TS_BALANCE_PERIOD_MS 100
-#define GVT_TS_BALANCE_STAGE_NUM 10
-
-static void gvt_balance_timeslice(struct gvt_sched_data *sched_data)
+static bool vgpu_is_capped(struct vgpu_sched_data *vgpu_data)
 {
-	struct vgpu_sched_data *vgpu_data;
-	struct list_head *pos;
-	static uint64_t stage_check;
-	int stage = stage_check++ % GVT_TS_BALANCE_STAGE_NUM;
+	int cap = vgpu_data->vgpu->sched_ctl.cap;
 
-	/* The timeslice accumulation reset at stage 0, which is
-	 * allocated again without adding previous debt.
-	 */
-	if (stage == 0) {
-		int total_weight = 0;
-		ktime_t fair_timeslice;
+	if (!cap)
+		return false;
 
-		list_for_each(pos, &sched_data->lru_runq_head) {
-			vgpu_data = container_of(pos, struct vgpu_sched_data, lru_list);
-			total_weight += vgpu_data->sched_ctl.weight;
-		}
+	return vgpu_data->window_usage * 100 >=
+		(u64)cap * GVT_SCHED_WINDOW_MS * NSEC_PER_MSEC;
+}
 
-		list_for_each(pos, &sched_data->lru_runq_head) {
-			vgpu_data = container_of(pos, struct vgpu_sched_data, lru_list);
-			fair_timeslice = ms_to_ktime(GVT_TS_BALANCE_PERIOD_MS) *
-						vgpu_data->sched_ctl.weight /
-						total_weight;
+static s64 vgpu_sched_key(struct vgpu_sched_data *vgpu_data, int ring_id)
+{
+	s64 key = vgpu_data->vruntime[ring_id];
 
-			vgpu_data->allocated_ts = fair_timeslice;
-			vgpu_data->left_ts = vgpu_data->allocated_ts;
-		}
-	} else {
-		list_for_each(pos, &sched_data->lru_runq_head) {
-			vgpu_data = container_of(pos, struct vgpu_sched_data, lru_list);
+	if (vgpu_data->vgpu->sched_ctl.latency_class ==
+	    INTEL_VGPU_LATENCY_INTERACTIVE)
+		key -= GVT_SCHED_LATENCY_CREDIT;
 
-			/* timeslice for next 100ms should add the left/debt
-			 * slice of previous stages.
-			 */
-			vgpu_data->left_ts += vgpu_data->allocated_ts;
-		}
-	}
+	return key;
 }
 
-static void try_to_schedule_next_vgpu(struct intel_gvt *gvt)
+static void try_to_schedule_next_vgpu(struct intel_gvt *gvt, int ring_id)
 {
 	struct intel_gvt_workload_scheduler *scheduler = &gvt->scheduler;
-	enum intel_engine_id i;
-	struct intel_engine_cs *engine;
-	struct vgpu_sched_data *vgpu_data;
-	ktime_t cur_time;
 
 	/* no need to schedule if next_vgpu is the same with current_vgpu,
 	 * let scheduler chose next_vgpu again by setting it to NULL.
 	 */
-	if (scheduler->next_vgpu == scheduler->current_vgpu) {
-		scheduler->next_vgpu = NULL;
+	if (scheduler->next_vgpu[ring_id] == scheduler->current_vgpu[ring_id]) {
+		scheduler->next_vgpu[ring_id] = NULL;
 		return;
 	}
 
@@ -141,99 +118,127 @@ static void try_to_schedule_next_vgpu(struct intel_gvt *gvt)
 	 * after the flag is set, workload dispatch thread will
 	 * stop dispatching workload for current vgpu
 	 */
-	scheduler->need_reschedule = true;
+	scheduler->need_reschedule[ring_id] = true;
 
 	/* still have uncompleted workload? */
-	for_each_engine(engine, gvt->dev_priv, i) {
-		if (scheduler->current_workload[i])
-			return;
-	}
-
-	cur_time = ktime_get();
-	if (scheduler->current_vgpu) {
-		vgpu_data = scheduler->current_vgpu->sched_data;
-		vgpu_data->sched_out_time = cur_time;
-		vgpu_update_timeslice(scheduler->current_vgpu);
-	}
-	vgpu_data = scheduler->next_vgpu->sched_data;
-	vgpu_data->sched_in_time = cur_time;
+	if (scheduler->current_workload[ring_id])
+		return;
 
 	/* switch current vgpu */
-	scheduler->current_vgpu = scheduler->next_vgpu;
-	scheduler->next_vgpu = NULL;
+	scheduler->current_vgpu[ring_id] = scheduler->next_vgpu[ring_id];
+	scheduler->next_vgpu[ring_id] = NULL;
 
-	scheduler->need_reschedule = false;
+	scheduler->need_reschedule[ring_id] = false;
 
 	/* wake up workload dispatch thread */
-	for_each_engine(engine, gvt->dev_priv, i)
-		wake_up(&scheduler->waitq[i]);
+	wake_up(&scheduler->waitq[ring_id]);
 }
 
-static struct intel_vgpu *find_busy_vgpu(struct gvt_sched_data *sched_data)
+static struct intel_vgpu *find_busy_vgpu(struct gvt_sched_data *sched_data,
+					 int ring_id)
 {
-	struct vgpu_sched_data *vgpu_data;
-	struct intel_vgpu *vgpu = NULL;
+	struct vgpu_sched_data *vgpu_data, *best = NULL;
 	struct list_head *head = &sched_data->lru_runq_head;
-	struct list_head *pos;
+	u64 min_vruntime = U64_MAX;
+	s64 best_key = 0;
+
+	list_for_each_entry(vgpu_data, head, lru_list) {
+		if (vgpu_has_pending_workload(vgpu_data->vgpu, ring_id))
+			min_vruntime = min(min_vruntime,
+					   vgpu_data->vruntime[ring_id]);
+	}
+
+	if (min_vruntime == U64_MAX)
+		return NULL;
+
+	/*
+	 * The floor only moves forward, so that a vGPU coming back from
+	 * idle does not get to monopolise the engine with the credit it
+	 * "saved" while it had nothing to run.
+	 */
+	sched_data->min_vruntime[ring_id] =
+		max(sched_data->min_vruntime[ring_id], min_vruntime);
 
-	/* search a vgpu with pending workload */
-	list_for_each(pos, head) {
+	/* pick the vGPU with the least weighted time on this engine */
+	list_for_each_entry(vgpu_data, head, lru_list) {
+		s64 key;
 
-		vgpu_data = container_of(pos, struct vgpu_sched_data, lru_list);
-		if (!vgpu_has_pending_workload(vgpu_data->vgpu))
+		if (!vgpu_has_pending_workload(vgpu_data->vgpu, ring_id))
 			continue;
 
-		/* Return the vGPU only if it has time slice left */
-		if (vgpu_data->left_ts > 0) {
-			vgpu = vgpu_data->vgpu;
-			break;
+		if (vgpu_data->vruntime[ring_id] <
+		    sched_data->min_vruntime[ring_id])
+			vgpu_data->vruntime[ring_id] =
+				sched_data->min_vruntime[ring_id];
+
+		if (vgpu_is_capped(vgpu_data))
+			continue;
+
+		key = vgpu_sched_key(vgpu_data, ring_id);
+		if (!best || key < best_key) {
+			best = vgpu_data;
+			best_key = key;
 		}
 	}
 
-	return vgpu;
+	return best ? best->vgpu : NULL;
 }
 
-/* in nanosecond */
-#define GVT_DEFAULT_TIME_SLICE 1000000
-
+/*
+ * Each engine is owned by one vGPU at a time, but different engines may be
+ * owned by different vGPUs: a render workload of one guest can overlap with
+ * a media workload of another.
+ */
 static void tbs_sched_func(struct gvt_sched_data *sched_data)
 {
 	struct intel_gvt *gvt = sched_data->gvt;
 	struct intel_gvt_workload_scheduler *scheduler = &gvt->scheduler;
 	struct vgpu_sched_data *vgpu_data;
-	struct intel_vgpu *vgpu = NULL;
-	/* no active vgpu or has already had a target */
-	if (list_empty(&sched_data->lru_runq_head) || scheduler->next_vgpu)
-		goto out;
-
-	vgpu = find_busy_vgpu(sched_data);
-	if (vgpu) {
-		scheduler->next_vgpu = vgpu;
-
-		/* Move the last used vGPU to the tail of lru_list */
-		vgpu_data = vgpu->sched_data;
-		list_del_init(&vgpu_data->lru_list);
-		list_add_tail(&vgpu_data->lru_list,
-				&sched_data->lru_runq_head);
-	} else {
-		scheduler->next_vgpu = gvt->idle_vgpu;
-	}
+	struct intel_engine_cs *engine;
+	struct intel_vgpu *vgpu;
+	enum intel_engine_id i;
+
+	for_each_engine(engine, gvt->dev_priv, i) {
+		/* no active vgpu or has already had a target */
+		if (list_empty(&sched_data->lru_runq_head) ||
+		    scheduler->next_vgpu[i])
+			goto out;
+
+		vgpu = find_busy_vgpu(sched_data, i);
+		if (vgpu) {
+			scheduler->next_vgpu[i] = vgpu;
+
+			/*
+			 * Move the last used vGPU to the tail of lru_list,
+			 * so that vGPUs with the same key are served
+			 * round-robin.
+			 */
+			vgpu_data = vgpu->sched_data;
+			list_del_init(&vgpu_data->lru_list);
+			list_add_tail(&vgpu_data->lru_list,
+				      &sched_data->lru_runq_head);
+		} else {
+			scheduler->next_vgpu[i] = gvt->idle_vgpu;
+		}
 out:
-	if (scheduler->next_vgpu)
-		try_to_schedule_next_vgpu(gvt);
+		if (scheduler->next_vgpu[i])
+			try_to_schedule_next_vgpu(gvt, i);
+	}
 }
 
 void intel_gvt_schedule(struct intel_gvt *gvt)
 {
 	struct gvt_sched_data *sched_data = gvt->scheduler.sched_data;
-	static uint64_t timer_check;
 
 	mutex_lock(&gvt->lock);
 
 	if (test_and_clear_bit(INTEL_GVT_REQUEST_SCHED,
 				(void *)&gvt->service_request)) {
-		if (!(timer_check++ % GVT_TS_BALANCE_PERIOD_MS))
-			gvt_balance_timeslice(sched_data);
+		ktime_t cur_time = ktime_get();
+
+		if (ktime_ms_delta(cur_time, sched_data->window_start) >=
+		    GVT_SCHED_WINDOW_MS)
+			gvt_reset_sched_window(sched_data, cur_time);
 	}
 	clear_bit(INTEL_GVT_REQUEST_EVENT_SCHED, (void *)&gvt->service_request);
 
@@ -250,6 +255,7 @@ static enum hrtimer_restart tbs_timer_fn(struct hrtimer *timer_data)
 
 	intel_gvt_request_service(data->gvt, INTEL_GVT_REQUEST_SCHED);
 
+	data->period = gvt_sched_period();
 	hrtimer_add_expires_ns(&data->timer, data->period);
 
 	return HRTIMER_RESTART;
@@ -269,7 +275,8 @@ static int tbs_sched_init(struct intel_gvt *gvt)
 	INIT_LIST_HEAD(&data->lru_runq_head);
 	hrtimer_init(&data->timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
 	data->timer.function = tbs_timer_fn;
-	data->period = GVT_DEFAULT_TIME_SLICE;
+	data->period = gvt_sched_period();
+	data->window_start = ktime_get();
 	data->gvt = gvt;
 
 	scheduler->sched_data = data;
@@ -297,7 +304,6 @@ static int tbs_sched_init_vgpu(struct intel_vgpu *vgpu)
 	if (!data)
 		return -ENOMEM;
 
-	data->sched_ctl.weight = vgpu->sched_ctl.weight;
 	data->vgpu = vgpu;
 	INIT_LIST_HEAD(&data->lru_list);
 
@@ -334,6 +340,24 @@ static void tbs_sched_stop_schedule(struct intel_vgpu *vgpu)
 	list_del_init(&vgpu_data->lru_list);
 }
 
+static void tbs_sched_account_usage(struct intel_vgpu *vgpu, int ring_id,
+				    u64 ns)
+{
+	struct vgpu_sched_data *vgpu_data = vgpu->sched_data;
+
+	vgpu_data->engine_usage[ring_id] += ns;
+	vgpu_data->window_usage += ns;
+	vgpu_data->vruntime[ring_id] += div_u64(ns, vgpu->sched_ctl.weight);
+}
+
+static void tbs_sched_query_usage(struct intel_vgpu *vgpu, u64 *usage)
+{
+	struct vgpu_sched_data *vgpu_data = vgpu->sched_data;
+
+	memcpy(usage, vgpu_data->engine_usage,
+	       sizeof(vgpu_data->engine_usage));
+}
+
 static struct intel_gvt_sched_policy_ops tbs_schedule_ops = {
 	.init = tbs_sched_init,
 	.clean = tbs_sched_clean,
@@ -341,6 +365,8 @@ static struct intel_gvt_sched_policy_ops tbs_schedule_ops = {
 	.clean_vgpu = tbs_sched_clean_vgpu,
 	.start_schedule = tbs_sched_start_schedule,
 	.stop_schedule = tbs_sched_stop_schedule,
+	.account_usage = tbs_sched_account_usage,
+	.query_usage = tbs_sched_query_usage,
 };
 
 int intel_gvt_init_sched_policy(struct intel_gvt *gvt)
@@ -382,13 +408,15 @@ void intel_vgpu_stop_schedule(struct intel_vgpu *vgpu)
 
 	scheduler->sched_ops->stop_schedule(vgpu);
 
-	if (scheduler->next_vgpu == vgpu)
-		scheduler->next_vgpu = NULL;
+	for (ring_id = 0; ring_id < I915_NUM_ENGINES; ring_id++) {
+		if (scheduler->next_vgpu[ring_id] == vgpu)
+			scheduler->next_vgpu[ring_id] = NULL;
 
-	if (scheduler->current_vgpu == vgpu) {
-		/* stop workload dispatching */
-		scheduler->need_reschedule = true;
-		scheduler->current_vgpu = NULL;
+		if (scheduler->current_vgpu[ring_id] == vgpu) {
+			/* stop workload dispatching */
+			scheduler->need_reschedule[ring_id] = true;
+			scheduler->current_vgpu[ring_id] = NULL;
+		}
 	}
 
 	spin_lock_bh(&scheduler->mmio_context_lock);
@@ -400,3 +428,53 @@ void intel_vgpu_stop_schedule(struct intel_vgpu *vgpu)
 	}
 	spin_unlock_bh(&scheduler->mmio_context_lock);
 }
+
+/**
+ * intel_vgpu_set_sched_ctl - update the scheduling attributes of a vGPU
+ * @vgpu: a vGPU
+ * @ctl: new weight, cap and latency class
+ *
+ * Returns:
+ * Zero on success, -EINVAL if any of the attributes is out of range.
+ */
+int intel_vgpu_set_sched_ctl(struct intel_vgpu *vgpu,
+			     const struct vgpu_sched_ctl *ctl)
+{
+	if (ctl->weight < 1 || ctl->weight > VGPU_MAX_WEIGHT)
+		return -EINVAL;
+
+	if (ctl->cap < 0 || ctl->cap > 100)
+		return -EINVAL;
+
+	if (ctl->latency_class != INTEL_VGPU_LATENCY_BATCH &&
+	    ctl->latency_class != INTEL_VGPU_LATENCY_INTERACTIVE)
+		return -EINVAL;
+
+	mutex_lock(&vgpu->gvt->lock);
+	vgpu->sched_ctl = *ctl;
+	mutex_unlock(&vgpu->gvt->lock);
+
+	gvt_dbg_sched("vgpu%d: weight %d cap %d%% class %d\n", vgpu->id,
+		      ctl->weight, ctl->cap, ctl->latency_class);
+
+	return 0;
+}
+
+/* Called with gvt->lock held when a workload leaves the engine for good. */
+void intel_vgpu_account_sched_usage(struct intel_vgpu *vgpu, int ring_id,
+				    u64 ns)
+{
+	vgpu->gvt->scheduler.sched_ops->account_usage(vgpu, ring_id, ns);
+}
+
+/**
+ * intel_vgpu_query_sched_usage - report the engine time used by a vGPU
+ * @vgpu: a vGPU
+ * @usage: array of I915_NUM_ENGINES entries, filled in nanoseconds
+ */
+void intel_vgpu_query_sched_usage(struct intel_vgpu *vgpu, u64 *usage)
+{
+	mutex_lock(&vgpu->gvt->lock);
+	vgpu->gvt->scheduler.sched_ops->query_usage(vgpu, usage);
+	mutex_unlock(&vgpu->gvt->lock);
+}
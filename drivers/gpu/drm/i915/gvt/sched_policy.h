@@ -34,6 +34,8 @@
 #ifndef __GVT_SCHED_POLICY__
 #define __GVT_SCHED_POLICY__
 
+struct vgpu_sched_ctl;
+
 struct intel_gvt_sched_policy_ops {
 	int (*init)(struct intel_gvt *gvt);
 	void (*clean)(struct intel_gvt *gvt);
@@ -41,6 +43,8 @@ struct intel_gvt_sched_policy_ops {
 	void (*clean_vgpu)(struct intel_vgpu *vgpu);
 	void (*start_schedule)(struct intel_vgpu *vgpu);
 	void (*stop_schedule)(struct intel_vgpu *vgpu);
+	void (*account_usage)(struct intel_vgpu *vgpu, int ring_id, u64 ns);
+	void (*query_usage)(struct intel_vgpu *vgpu, u64 *usage);
 };
 
 void intel_gvt_schedule(struct intel_gvt *gvt);
@@ -57,4 +61,12 @@ void intel_vgpu_start_schedule(struct intel_vgpu *vgpu);
 
 void intel_vgpu_stop_schedule(struct intel_vgpu *vgpu);
 
+int intel_vgpu_set_sched_ctl(struct intel_vgpu *vgpu,
+			     const struct vgpu_sched_ctl *ctl);
+
+void intel_vgpu_account_sched_usage(struct intel_vgpu *vgpu, int ring_id,
+				    u64 ns);
+
+void intel_vgpu_query_sched_usage(struct intel_vgpu *vgpu, u64 *usage);
+
 #endif
@@ -52,6 +52,26 @@ static void set_context_pdp_root_pointer(
 		pdp_pair[i].val = pdp[7 - i];
 }
 
+/*
+ * The shadow PPGTT is only guaranteed to exist once the workload's mm has
+ * been pinned in prepare, as it is built lazily and may be reclaimed while
+ * the mm sits unpinned, so load the root pointers as late as possible.
+ */
+static void update_shadow_pdp_root_pointer(struct intel_vgpu_workload *workload)
+{
+	struct i915_gem_context *shadow_ctx = workload->vgpu->shadow_ctx;
+	struct drm_i915_gem_object *ctx_obj =
+		shadow_ctx->engine[workload->ring_id].state->obj;
+	struct execlist_ring_context *shadow_ring_context;
+	struct page *page;
+
+	page = i915_gem_object_get_page(ctx_obj, LRC_STATE_PN);
+	shadow_ring_context = kmap(page);
+	set_context_pdp_root_pointer(shadow_ring_context,
+				     workload->shadow_mm->shadow_page_table);
+	kunmap(page);
+}
+
 static int populate_shadow_context(struct intel_vgpu_workload *workload)
 {
 	struct intel_vgpu *vgpu = workload->vgpu;
@@ -112,9 +132,6 @@ static int populate_shadow_context(struct intel_vgpu_workload *workload)
 	}
 #undef COPY_REG
 
-	set_context_pdp_root_pointer(shadow_ring_context,
-				     workload->shadow_mm->shadow_page_table);
-
 	intel_gvt_hypervisor_read_gpa(vgpu,
 			workload->ring_context_gpa +
 			sizeof(*shadow_ring_context),
@@ -171,9 +188,13 @@ static int shadow_context_status_change(struct notifier_block *nb,
 			gvt_dbg_sched("skip ring %d mmio switch for vgpu%d\n",
 				      ring_id, workload->vgpu->id);
 		spin_unlock_bh(&scheduler->mmio_context_lock);
+		workload->engine_in_time = ktime_get();
 		atomic_set(&workload->shadow_ctx_active, 1);
 		break;
 	case INTEL_CONTEXT_SCHEDULE_OUT:
+		workload->engine_time_ns +=
+			ktime_to_ns(ktime_sub(ktime_get(),
+					      workload->engine_in_time));
 		atomic_set(&workload->shadow_ctx_active, 0);
 		break;
 	default:
@@ -201,15 +222,7 @@ static void shadow_context_descriptor_update(struct i915_gem_context *ctx,
 	ce->lrc_desc = desc;
 }
 
-/**
- * intel_gvt_scan_and_shadow_workload - audit the workload by scanning and
- * shadow it as well, include ringbuffer,wa_ctx and ctx.
- * @workload: an abstract entity for each execlist submission.
- *
- * This function is called before the workload submitting to i915, to make
- * sure the content of the workload is valid.
- */
-int intel_gvt_scan_and_shadow_workload(struct intel_vgpu_workload *workload)
+static int prefetch_workload(struct intel_vgpu_workload *workload)
 {
 	int ring_id = workload->ring_id;
 	struct i915_gem_context *shadow_ctx = workload->vgpu->shadow_ctx;
@@ -220,9 +233,13 @@ int intel_gvt_scan_and_shadow_workload(struct intel_vgpu_workload *workload)
 
 	lockdep_assert_held(&dev_priv->drm.struct_mutex);
 
-	if (workload->shadowed)
+	if (workload->prefetched)
 		return 0;
 
+	/* an earlier attempt failed half way, don't emit a second request */
+	if (workload->req)
+		return -EINVAL;
+
 	shadow_ctx->desc_template &= ~(0x3 << GEN8_CTX_ADDRESSING_MODE_SHIFT);
 	shadow_ctx->desc_template |= workload->ctx_desc.addressing_mode <<
 				    GEN8_CTX_ADDRESSING_MODE_SHIFT;
@@ -234,8 +251,7 @@ int intel_gvt_scan_and_shadow_workload(struct intel_vgpu_workload *workload)
 	rq = i915_gem_request_alloc(dev_priv->engine[ring_id], shadow_ctx);
 	if (IS_ERR(rq)) {
 		gvt_vgpu_err("fail to allocate gem request\n");
-		ret = PTR_ERR(rq);
-		goto out;
+		return PTR_ERR(rq);
 	}
 
 	gvt_dbg_sched("ring id %d get i915 gem request %p\n", ring_id, rq);
@@ -244,23 +260,47 @@ int intel_gvt_scan_and_shadow_workload(struct intel_vgpu_workload *workload)
 
 	ret = intel_gvt_scan_and_shadow_ringbuffer(workload);
 	if (ret)
-		goto out;
+		return ret;
 
 	if ((workload->ring_id == RCS) &&
 	    (workload->wa_ctx.indirect_ctx.size != 0)) {
 		ret = intel_gvt_scan_and_shadow_wa_ctx(&workload->wa_ctx);
 		if (ret)
-			goto out;
+			return ret;
 	}
 
+	workload->prefetched = true;
+	return 0;
+}
+
+/**
+ * intel_gvt_scan_and_shadow_workload - audit the workload by scanning and
+ * shadow it as well, include ringbuffer,wa_ctx and ctx.
+ * @workload: an abstract entity for each execlist submission.
+ *
+ * This function is called before the workload submitting to i915, to make
+ * sure the content of the workload is valid.
+ */
+int intel_gvt_scan_and_shadow_workload(struct intel_vgpu_workload *workload)
+{
+	struct drm_i915_private *dev_priv = workload->vgpu->gvt->dev_priv;
+	int ret;
+
+	lockdep_assert_held(&dev_priv->drm.struct_mutex);
+
+	if (workload->shadowed)
+		return 0;
+
+	ret = prefetch_workload(workload);
+	if (ret)
+		return ret;
+
 	ret = populate_shadow_context(workload);
 	if (ret)
-		goto out;
+		return ret;
 
 	workload->shadowed = true;
-
-out:
-	return ret;
+	return 0;
 }
 
 static int dispatch_workload(struct intel_vgpu_workload *workload)
@@ -271,6 +311,7 @@ static int dispatch_workload(struct intel_vgpu_workload *workload)
 	struct intel_engine_cs *engine = dev_priv->engine[ring_id];
 	struct intel_vgpu *vgpu = workload->vgpu;
 	struct intel_ring *ring;
+	ktime_t start;
 	int ret = 0;
 
 	gvt_dbg_sched("ring id %d prepare to dispatch workload %p\n",
@@ -278,6 +319,8 @@ static int dispatch_workload(struct intel_vgpu_workload *workload)
 
 	mutex_lock(&dev_priv->drm.struct_mutex);
 
+	start = ktime_get();
+
 	ret = intel_gvt_scan_and_shadow_workload(workload);
 	if (ret)
 		goto out;
@@ -288,6 +331,10 @@ static int dispatch_workload(struct intel_vgpu_workload *workload)
 			goto out;
 	}
 
+	vgpu->stats.shadow_time_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	update_shadow_pdp_root_pointer(workload);
+
 	/* pin shadow context by gvt even the shadow context will be pinned
 	 * when i915 alloc request. That is because gvt will update the guest
 	 * context from shadow context when workload is completed, and at that
@@ -329,17 +376,18 @@ static struct intel_vgpu_workload *pick_next_workload(
 	 * no current vgpu / will be scheduled out / no workload
 	 * bail out
 	 */
-	if (!scheduler->current_vgpu) {
+	if (!scheduler->current_vgpu[ring_id]) {
 		gvt_dbg_sched("ring id %d stop - no current vgpu\n", ring_id);
 		goto out;
 	}
 
-	if (scheduler->need_reschedule) {
+	if (scheduler->need_reschedule[ring_id]) {
 		gvt_dbg_sched("ring id %d stop - will reschedule\n", ring_id);
 		goto out;
 	}
 
-	if (list_empty(workload_q_head(scheduler->current_vgpu, ring_id)))
+	if (list_empty(workload_q_head(scheduler->current_vgpu[ring_id],
+				       ring_id)))
 		goto out;
 
 	/*
@@ -360,7 +408,8 @@ static struct intel_vgpu_workload *pick_next_workload(
 	 * schedule out a vgpu.
 	 */
 	scheduler->current_workload[ring_id] = container_of(
-			workload_q_head(scheduler->current_vgpu, ring_id)->next,
+			workload_q_head(scheduler->current_vgpu[ring_id],
+					ring_id)->next,
 			struct intel_vgpu_workload, list);
 
 	workload = scheduler->current_workload[ring_id];
@@ -479,6 +528,11 @@ static void complete_current_workload(struct intel_gvt *gvt, int ring_id)
 
 		i915_gem_request_put(fetch_and_zero(&workload->req));
 
+		intel_vgpu_account_sched_usage(vgpu, ring_id,
+					       workload->engine_time_ns);
+		vgpu->stats.gpu_time_ns += workload->engine_time_ns;
+		vgpu->stats.workloads_completed++;
+
 		if (!workload->status && !(vgpu->resetting_eng &
 					   ENGINE_MASK(ring_id))) {
 			update_guest_context(workload);
@@ -504,12 +558,51 @@ static void complete_current_workload(struct intel_gvt *gvt, int ring_id)
 	atomic_dec(&vgpu->running_workload_num);
 	wake_up(&scheduler->workload_complete_wq);
 
-	if (gvt->scheduler.need_reschedule)
+	if (gvt->scheduler.need_reschedule[ring_id])
 		intel_gvt_request_service(gvt, INTEL_GVT_REQUEST_EVENT_SCHED);
 
 	mutex_unlock(&gvt->lock);
 }
 
+/*
+ * Scan and shadow the workload queued behind the one just dispatched, so
+ * that the CPU work overlaps with GPU execution instead of leaving the
+ * engine idle in between. Only one workload is prefetched: its request
+ * stays open until dispatch and i915 emits the breadcrumb at the ring
+ * tail, so a second open request on the same ring would end up inside it.
+ * The shadow context image is still in use by the running workload, so
+ * populating it is left for dispatch time.
+ */
+static void prefetch_next_workload(struct intel_gvt *gvt,
+				   struct intel_vgpu_workload *workload)
+{
+	struct intel_gvt_workload_scheduler *scheduler = &gvt->scheduler;
+	struct drm_i915_private *dev_priv = gvt->dev_priv;
+	struct intel_vgpu *vgpu = workload->vgpu;
+	int ring_id = workload->ring_id;
+	struct intel_vgpu_workload *next;
+
+	if (!i915.gvt_prefetch)
+		return;
+
+	mutex_lock(&gvt->lock);
+
+	if (scheduler->current_vgpu[ring_id] != vgpu ||
+	    scheduler->need_reschedule[ring_id] ||
+	    list_is_last(&workload->list, workload_q_head(vgpu, ring_id)))
+		goto out;
+
+	next = list_next_entry(workload, list);
+
+	mutex_lock(&dev_priv->drm.struct_mutex);
+	if (prefetch_workload(next))
+		gvt_vgpu_err("fail to prefetch workload %p\n", next);
+	mutex_unlock(&dev_priv->drm.struct_mutex);
+
+out:
+	mutex_unlock(&gvt->lock);
+}
+
 struct workload_thread_param {
 	struct intel_gvt *gvt;
 	int ring_id;
@@ -569,6 +662,8 @@ static int workload_thread(void *priv)
 			goto complete;
 		}
 
+		prefetch_next_workload(gvt, workload);
+
 		gvt_dbg_sched("ring id %d wait workload %p\n",
 				workload->ring_id, workload);
 		i915_wait_request(workload->req, 0, MAX_SCHEDULE_TIMEOUT);
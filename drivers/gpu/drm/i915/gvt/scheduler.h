@@ -36,15 +36,24 @@
 #ifndef _GVT_SCHEDULER_H_
 #define _GVT_SCHEDULER_H_
 
+struct intel_gvt_mmio_switch_stats {
+	u64 count;
+	u64 writes;
+	u64 total_ns;
+	u64 max_ns;
+};
+
 struct intel_gvt_workload_scheduler {
-	struct intel_vgpu *current_vgpu;
-	struct intel_vgpu *next_vgpu;
+	/* engines are owned, and switched, independently of each other */
+	struct intel_vgpu *current_vgpu[I915_NUM_ENGINES];
+	struct intel_vgpu *next_vgpu[I915_NUM_ENGINES];
 	struct intel_vgpu_workload *current_workload[I915_NUM_ENGINES];
-	bool need_reschedule;
+	bool need_reschedule[I915_NUM_ENGINES];
 
 	spinlock_t mmio_context_lock;
 	/* can be null when owner is host */
 	struct intel_vgpu *engine_owner[I915_NUM_ENGINES];
+	struct intel_gvt_mmio_switch_stats mmio_switch_stats[I915_NUM_ENGINES];
 
 	wait_queue_head_t workload_complete_wq;
 	struct task_struct *thread[I915_NUM_ENGINES];
@@ -83,9 +92,15 @@ struct intel_vgpu_workload {
 	struct drm_i915_gem_request *req;
 	/* if this workload has been dispatched to i915? */
 	bool dispatched;
+	/* ring buffer and wa_ctx scanned, request allocated */
+	bool prefetched;
 	bool shadowed;
 	int status;
 
+	/* time spent on the engine, charged to the vGPU on completion */
+	ktime_t engine_in_time;
+	u64 engine_time_ns;
+
 	struct intel_vgpu_mm *shadow_mm;
 
 	/* different submission model may need different handler */
@@ -116,6 +131,7 @@ struct intel_vgpu_workload {
 struct intel_shadow_bb_entry {
 	struct list_head list;
 	struct drm_i915_gem_object *obj;
+	struct i915_vma *vma;
 	void *va;
 	unsigned long len;
 	u32 *bb_start_cmd_va;
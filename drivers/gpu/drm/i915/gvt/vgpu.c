@@ -43,7 +43,8 @@ void populate_pvinfo_page(struct intel_vgpu *vgpu)
 	vgpu_vreg(vgpu, vgtif_reg(version_minor)) = 0;
 	vgpu_vreg(vgpu, vgtif_reg(display_ready)) = 0;
 	vgpu_vreg(vgpu, vgtif_reg(vgt_id)) = vgpu->id;
-	vgpu_vreg(vgpu, vgtif_reg(vgt_caps)) = VGT_CAPS_FULL_48BIT_PPGTT;
+	vgpu_vreg(vgpu, vgtif_reg(vgt_caps)) = VGT_CAPS_FULL_48BIT_PPGTT |
+						VGT_CAPS_SHARED_PAGE;
 	vgpu_vreg(vgpu, vgtif_reg(avail_rs.mappable_gmadr.base)) =
 		vgpu_aperture_gmadr_base(vgpu);
 	vgpu_vreg(vgpu, vgtif_reg(avail_rs.mappable_gmadr.size)) =
@@ -65,7 +66,6 @@ void populate_pvinfo_page(struct intel_vgpu *vgpu)
 	WARN_ON(sizeof(struct vgt_if) != VGT_PVINFO_SIZE);
 }
 
-#define VGPU_MAX_WEIGHT 16
 #define VGPU_WEIGHT(vgpu_num)	\
 	(VGPU_MAX_WEIGHT / (vgpu_num))
 
@@ -252,7 +252,10 @@ void intel_gvt_destroy_vgpu(struct intel_vgpu *vgpu)
 
 	WARN(vgpu->active, "vGPU is still active!\n");
 
+	intel_gvt_debugfs_remove_vgpu(vgpu);
 	idr_remove(&gvt->vgpu_idr, vgpu->id);
+	intel_vgpu_clean_bb_cache(vgpu);
+	intel_vgpu_clean_flip_fences(vgpu);
 	intel_vgpu_clean_sched_policy(vgpu);
 	intel_vgpu_clean_gvt_context(vgpu);
 	intel_vgpu_clean_execlist(vgpu);
@@ -346,6 +349,8 @@ static struct intel_vgpu *__intel_gvt_create_vgpu(struct intel_gvt *gvt,
 	vgpu->handle = param->handle;
 	vgpu->gvt = gvt;
 	vgpu->sched_ctl.weight = param->weight;
+	vgpu->sched_ctl.cap = 0;
+	vgpu->sched_ctl.latency_class = INTEL_VGPU_LATENCY_BATCH;
 	bitmap_zero(vgpu->tlb_handle_pending, I915_NUM_ENGINES);
 
 	intel_vgpu_init_cfg_space(vgpu, param->primary);
@@ -384,6 +389,13 @@ static struct intel_vgpu *__intel_gvt_create_vgpu(struct intel_gvt *gvt,
 	if (ret)
 		goto out_clean_shadow_ctx;
 
+	intel_vgpu_init_bb_cache(vgpu);
+	intel_vgpu_init_flip_fences(vgpu);
+
+	ret = intel_gvt_debugfs_add_vgpu(vgpu);
+	if (ret)
+		gvt_vgpu_err("failed to create debugfs entries\n");
+
 	mutex_unlock(&gvt->lock);
 
 	return vgpu;
@@ -480,7 +492,6 @@ void intel_gvt_reset_vgpu_locked(struct intel_vgpu *vgpu, bool dmlr,
 				 unsigned int engine_mask)
 {
 	struct intel_gvt *gvt = vgpu->gvt;
-	struct intel_gvt_workload_scheduler *scheduler = &gvt->scheduler;
 	unsigned int resetting_eng = dmlr ? ALL_ENGINES : engine_mask;
 
 	gvt_dbg_core("------------------------------------------\n");
@@ -491,14 +502,17 @@ void intel_gvt_reset_vgpu_locked(struct intel_vgpu *vgpu, bool dmlr,
 
 	intel_vgpu_stop_schedule(vgpu);
 	/*
-	 * The current_vgpu will set to NULL after stopping the
-	 * scheduler when the reset is triggered by current vgpu.
+	 * The vGPU may still own some engines while others are owned by
+	 * other vGPUs, so wait for whatever it has in flight. This returns
+	 * immediately if it was not running anywhere.
 	 */
-	if (scheduler->current_vgpu == NULL) {
-		mutex_unlock(&gvt->lock);
-		intel_gvt_wait_vgpu_idle(vgpu);
-		mutex_lock(&gvt->lock);
-	}
+	mutex_unlock(&gvt->lock);
+	intel_gvt_wait_vgpu_idle(vgpu);
+	mutex_lock(&gvt->lock);
+
+	/* the guest page is no longer the guest's after a device reset */
+	if (dmlr)
+		vgpu->shared_page_gpa = 0;
 
 	intel_vgpu_reset_execlist(vgpu, resetting_eng);
 
@@ -25,6 +25,8 @@
  *
  */
 
+#include <linux/jhash.h>
+
 #include "i915_drv.h"
 
 /**
@@ -857,6 +859,84 @@ static void fini_hash_table(struct intel_engine_cs *engine)
 	}
 }
 
+/*
+ * Clients tend to submit the same batch (or a small set of them) over and
+ * over again, e.g. for a media pipeline or a compositor. Instead of scanning
+ * each copy command by command, we remember the last few batches that were
+ * accepted and compare the new shadow copy against them. The hash only
+ * narrows the search; an entry is only used if the batch is bytewise
+ * identical, so userspace cannot forge a hit. The outcome of the scan is a
+ * pure function of the batch contents, the engine's (static) tables and
+ * is_master, so that is all we need to key on.
+ */
+#define CMD_CACHE_ENTRIES 16
+#define CMD_CACHE_MAX_LEN SZ_16K
+
+struct cmd_cache_entry {
+	struct list_head link;
+	u32 hash;
+	u32 len; /* bytes of batch compared */
+	u32 end; /* bytes up to and including MI_BATCH_BUFFER_END */
+	bool is_master;
+	u32 cmds[];
+};
+
+static u32 cmd_cache_hash(const u32 *cmds, u32 len)
+{
+	return jhash2(cmds, len / sizeof(u32), 0);
+}
+
+static struct cmd_cache_entry *
+cmd_cache_lookup(struct intel_engine_cs *engine,
+		 const u32 *cmds, u32 len, u32 hash, bool is_master)
+{
+	struct cmd_cache_entry *entry;
+
+	list_for_each_entry(entry, &engine->cmd_cache, link) {
+		if (entry->hash != hash ||
+		    entry->len != len ||
+		    entry->is_master != is_master)
+			continue;
+
+		if (memcmp(entry->cmds, cmds, len))
+			continue;
+
+		list_move(&entry->link, &engine->cmd_cache);
+		engine->cmd_cache_hits++;
+		return entry;
+	}
+
+	return NULL;
+}
+
+static void cmd_cache_add(struct intel_engine_cs *engine,
+			  const u32 *cmds, u32 len, u32 end, u32 hash,
+			  bool is_master)
+{
+	struct cmd_cache_entry *entry;
+
+	if (engine->cmd_cache_count < CMD_CACHE_ENTRIES) {
+		entry = kmalloc(sizeof(*entry) + CMD_CACHE_MAX_LEN,
+				GFP_KERNEL | __GFP_NOWARN);
+		if (!entry)
+			return;
+
+		engine->cmd_cache_count++;
+	} else {
+		entry = list_last_entry(&engine->cmd_cache,
+					typeof(*entry), link);
+		list_del(&entry->link);
+	}
+
+	entry->hash = hash;
+	entry->len = len;
+	entry->end = end;
+	entry->is_master = is_master;
+	memcpy(entry->cmds, cmds, len);
+
+	list_add(&entry->link, &engine->cmd_cache);
+}
+
 /**
  * intel_engine_init_cmd_parser() - set cmd parser related fields for an engine
  * @engine: the engine to initialize
@@ -947,6 +1027,9 @@ void intel_engine_init_cmd_parser(struct intel_engine_cs *engine)
 		return;
 	}
 
+	INIT_LIST_HEAD(&engine->cmd_cache);
+	engine->cmd_cache_count = 0;
+
 	engine->needs_cmd_parser = true;
 }
 
@@ -959,9 +1042,15 @@ void intel_engine_init_cmd_parser(struct intel_engine_cs *engine)
  */
 void intel_engine_cleanup_cmd_parser(struct intel_engine_cs *engine)
 {
+	struct cmd_cache_entry *entry, *n;
+
 	if (!engine->needs_cmd_parser)
 		return;
 
+	list_for_each_entry_safe(entry, n, &engine->cmd_cache, link)
+		kfree(entry);
+	INIT_LIST_HEAD(&engine->cmd_cache);
+
 	fini_hash_table(engine);
 }
 
@@ -1259,10 +1348,13 @@ int intel_engine_cmd_parser(struct intel_engine_cs *engine,
 			    u32 batch_len,
 			    bool is_master)
 {
-	u32 *cmd, *batch_end;
+	u32 *cmd, *batch, *batch_end;
 	struct drm_i915_cmd_descriptor default_desc = noop_desc;
 	const struct drm_i915_cmd_descriptor *desc = &default_desc;
+	struct cmd_cache_entry *cached;
 	bool needs_clflush_after = false;
+	bool cacheable;
+	u32 hash = 0;
 	int ret = 0;
 
 	cmd = copy_batch(shadow_batch_obj, batch_obj,
@@ -1278,7 +1370,23 @@ int intel_engine_cmd_parser(struct intel_engine_cs *engine,
 	 * large or larger and copy_batch() will write MI_NOPs to the extra
 	 * space. Parsing should be faster in some cases this way.
 	 */
+	batch = cmd;
 	batch_end = cmd + (batch_len / sizeof(*batch_end));
+
+	cacheable = batch_len <= CMD_CACHE_MAX_LEN;
+	if (cacheable) {
+		hash = cmd_cache_hash(batch, batch_len);
+		cached = cmd_cache_lookup(engine, batch, batch_len, hash,
+					  is_master);
+		if (cached) {
+			GEM_BUG_ON(batch[cached->end / sizeof(*cmd) - 1] !=
+				   MI_BATCH_BUFFER_END);
+			if (needs_clflush_after)
+				drm_clflush_virt_range(batch, cached->end);
+			goto out;
+		}
+	}
+
 	do {
 		u32 length;
 
@@ -1288,6 +1396,10 @@ int intel_engine_cmd_parser(struct intel_engine_cs *engine,
 				drm_clflush_virt_range(ptr,
 						       (void *)(cmd + 1) - ptr);
 			}
+			if (cacheable)
+				cmd_cache_add(engine, batch, batch_len,
+					      (void *)(cmd + 1) - (void *)batch,
+					      hash, is_master);
 			break;
 		}
 
@@ -1336,6 +1448,7 @@ int intel_engine_cmd_parser(struct intel_engine_cs *engine,
 		}
 	} while (1);
 
+out:
 	i915_gem_object_unpin_map(shadow_batch_obj);
 	return ret;
 }
@@ -466,6 +466,8 @@ static int i915_gem_object_info(struct seq_file *m, void *data)
 
 	seq_printf(m, "%llu [%llu] gtt total\n",
 		   ggtt->base.total, ggtt->mappable_end);
+	seq_printf(m, "%lu gtt invalidates, %lu deferred by batching\n",
+		   ggtt->invalidations, ggtt->deferred_invalidations);
 
 	seq_putc(m, '\n');
 	print_batch_pool_stats(m, dev_priv);
@@ -1308,6 +1310,9 @@ static int i915_hangcheck_info(struct seq_file *m, void *unused)
 			   yesno(test_bit(engine->id,
 					  &dev_priv->gpu_error.missed_irq_rings)),
 			   yesno(engine->hangcheck.stalled));
+		seq_printf(m, "\theartbeats = %lu, resets on missed heartbeat = %lu, beat pending? %s\n",
+			   engine->heartbeat.beats, engine->heartbeat.resets,
+			   yesno(engine->heartbeat.systole));
 
 		spin_lock_irq(&b->rb_lock);
 		for (rb = rb_first(&b->waiters); rb; rb = rb_next(rb)) {
@@ -1422,10 +1427,25 @@ static int i915_forcewake_domains(struct seq_file *m, void *data)
 	struct intel_uncore_forcewake_domain *fw_domain;
 	unsigned int tmp;
 
-	for_each_fw_domain(fw_domain, i915, tmp)
+	for_each_fw_domain(fw_domain, i915, tmp) {
+		const char *name =
+			intel_uncore_forcewake_domain_to_str(fw_domain->id);
+		u64 wakes = READ_ONCE(fw_domain->wakes);
+
 		seq_printf(m, "%s.wake_count = %u\n",
-			   intel_uncore_forcewake_domain_to_str(fw_domain->id),
-			   READ_ONCE(fw_domain->wake_count));
+			   name, READ_ONCE(fw_domain->wake_count));
+		seq_printf(m, "%s.hold_us = %u\n",
+			   name, READ_ONCE(fw_domain->hold_us));
+		seq_printf(m, "%s.wakes = %llu (%llu soon after release)\n",
+			   name, wakes, READ_ONCE(fw_domain->rewakes));
+		seq_printf(m, "%s.wake_latency = %llu ns avg, %llu ns max\n",
+			   name,
+			   wakes ? div64_u64(READ_ONCE(fw_domain->wake_ns), wakes) : 0,
+			   READ_ONCE(fw_domain->wake_ns_max));
+		seq_printf(m, "%s.held = %llu us\n",
+			   name, div_u64(READ_ONCE(fw_domain->held_ns),
+					 NSEC_PER_USEC));
+	}
 
 	return 0;
 }
@@ -1611,6 +1631,7 @@ static int i915_frontbuffer_tracking(struct seq_file *m, void *unused)
 static int i915_fbc_status(struct seq_file *m, void *unused)
 {
 	struct drm_i915_private *dev_priv = node_to_i915(m->private);
+	enum pipe pipe;
 
 	if (!HAS_FBC(dev_priv)) {
 		seq_puts(m, "FBC unsupported on this chipset\n");
@@ -1644,6 +1665,20 @@ static int i915_fbc_status(struct seq_file *m, void *unused)
 		seq_printf(m, "Compressing: %s\n", yesno(mask));
 	}
 
+	for_each_pipe(dev_priv, pipe) {
+		struct intel_fbc_pipe_stats *stats = &dev_priv->fbc.stats[pipe];
+		u64 active_ns = stats->active_ns;
+
+		if (intel_fbc_is_active(dev_priv) &&
+		    dev_priv->fbc.params.crtc.pipe == pipe)
+			active_ns += ktime_to_ns(ktime_sub(ktime_get(),
+						 dev_priv->fbc.activated));
+
+		seq_printf(m, "Pipe %c: active %llu ms, %u activations, %u nukes\n",
+			   pipe_name(pipe), div_u64(active_ns, NSEC_PER_MSEC),
+			   stats->activations, stats->nukes);
+	}
+
 	mutex_unlock(&dev_priv->fbc.lock);
 	intel_runtime_pm_put(dev_priv);
 
@@ -2822,6 +2857,18 @@ static int i915_runtime_pm_status(struct seq_file *m, void *unused)
 	seq_printf(m, "PCI device power state: %s [%d]\n",
 		   pci_power_name(pdev->current_state),
 		   pdev->current_state);
+	seq_printf(m, "Autosuspend delay: %d ms\n",
+		   READ_ONCE(dev_priv->pm.autosuspend_ms));
+	seq_printf(m, "Runtime suspends: %llu (%llu resumed within the delay)\n",
+		   dev_priv->pm.suspend_count, dev_priv->pm.short_suspends);
+	seq_printf(m, "Time suspended: %llu ms\n",
+		   div_u64(dev_priv->pm.suspended_ns, NSEC_PER_MSEC));
+	seq_printf(m, "Resume latency: %llu us avg, %llu us max\n",
+		   dev_priv->pm.suspend_count ?
+		   div_u64(div64_u64(dev_priv->pm.resume_ns,
+				     dev_priv->pm.suspend_count),
+			   NSEC_PER_USEC) : 0,
+		   div_u64(dev_priv->pm.resume_ns_max, NSEC_PER_USEC));
 
 	return 0;
 }
@@ -3215,6 +3262,10 @@ static int i915_display_info(struct seq_file *m, void *unused)
 			intel_plane_info(m, crtc);
 		}
 
+		seq_printf(m, "\tflips: coalesced=%u, missed vblanks=%u\n",
+			   atomic_read(&crtc->flip_stats.coalesced),
+			   atomic_read(&crtc->flip_stats.missed_vblanks));
+
 		seq_printf(m, "\tunderrun reporting: cpu=%s pch=%s \n",
 			   yesno(!crtc->cpu_fifo_underrun_disabled),
 			   yesno(!crtc->pch_fifo_underrun_disabled));
@@ -3265,6 +3316,10 @@ static int i915_engine_info(struct seq_file *m, void *unused)
 			   engine->timeline->inflight_seqnos);
 		seq_printf(m, "\tReset count: %d\n",
 			   i915_reset_engine_count(error, engine));
+		if (engine->needs_cmd_parser)
+			seq_printf(m, "\tCmd parser cache: %u entries, %lu hits\n",
+				   READ_ONCE(engine->cmd_cache_count),
+				   READ_ONCE(engine->cmd_cache_hits));
 
 		rcu_read_lock();
 
@@ -3358,6 +3413,25 @@ static int i915_engine_info(struct seq_file *m, void *unused)
 			}
 			rcu_read_unlock();
 
+			seq_printf(m, "\tExeclist direct submissions: %lu\n",
+				   READ_ONCE(engine->execlist_direct_submits));
+			seq_printf(m, "\tCSB from %s, context switches handled in irq: %lu\n",
+				   engine->execlist_csb_hwsp ? "HWSP" :
+				   engine->execlist_csb_shared ? "GVT" : "mmio",
+				   READ_ONCE(engine->execlist_csb_irq));
+			if (dev_priv->preempt_context) {
+				unsigned long count =
+					READ_ONCE(engine->execlist_preempt_stats.count);
+
+				seq_printf(m, "\tPreemptions: %lu (timeslices %lu), pending? %s\n",
+					   count,
+					   READ_ONCE(engine->execlist_preempt_stats.timeslices),
+					   yesno(READ_ONCE(engine->execlist_preempt)));
+				seq_printf(m, "\tPreemption latency: avg %lluns, max %lluns\n",
+					   count ? div64_u64(READ_ONCE(engine->execlist_preempt_stats.total_ns), count) : 0,
+					   READ_ONCE(engine->execlist_preempt_stats.max_ns));
+			}
+
 			spin_lock_irq(&engine->timeline->lock);
 			for (rb = engine->execlist_first; rb; rb = rb_next(rb)){
 				struct i915_priolist *p =
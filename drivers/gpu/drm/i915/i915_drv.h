@@ -607,6 +607,9 @@ struct drm_i915_file_private {
  */
 #define I915_MAX_CLIENT_CONTEXT_BANS 3
 	atomic_t context_bans;
+
+	/* GPU time, in ns per engine class, of contexts already closed */
+	u64 runtime[MAX_ENGINE_CLASS + 1];
 };
 
 /* Used by dp and fdi links */
@@ -878,6 +881,8 @@ struct i915_gpu_state {
 	struct drm_i915_private *i915;
 
 	char error_msg[128];
+	/* Buffers whose contents are copied after the stop_machine() capture */
+	struct list_head deferred;
 	bool simulated;
 	bool awake;
 	bool wakelock;
@@ -1119,6 +1124,14 @@ struct intel_fbc {
 		struct work_struct work;
 	} work;
 
+	/* Compression residency, accounted to the pipe FBC was active on */
+	ktime_t activated;
+	struct intel_fbc_pipe_stats {
+		u64 active_ns;
+		unsigned int activations;
+		unsigned int nukes;
+	} stats[I915_MAX_PIPES];
+
 	const char *no_fbc_reason;
 };
 
@@ -1479,6 +1492,19 @@ struct i915_gem_mm {
 	struct notifier_block vmap_notifier;
 	struct shrinker shrinker;
 
+	/**
+	 * Generation counter advanced by every shrinker scan, used to tell
+	 * recently used objects from cold ones.
+	 */
+	unsigned int shrink_gen;
+
+	/**
+	 * Objects whose pages were released by the shrinker and whose
+	 * shmem backing storage is waiting to be written back to swap.
+	 */
+	struct llist_head writeback_list;
+	struct work_struct writeback_work;
+
 	/** LRU list of objects with fence regs on them. */
 	struct list_head fence_list;
 
@@ -1534,6 +1560,11 @@ struct i915_gpu_error {
 	spinlock_t lock;
 	/* Protected by the above dev->gpu_error.lock. */
 	struct i915_gpu_state *first_error;
+	/* Captured, buffer contents still being copied by capture_work */
+	struct i915_gpu_state *pending_error;
+	struct work_struct capture_work;
+	/* Serializes the deferred copies, which share the GGTT slot */
+	struct mutex capture_lock;
 
 	atomic_t pending_fb_pin;
 
@@ -1845,6 +1876,16 @@ struct i915_runtime_pm {
 	atomic_t wakeref_count;
 	bool suspended;
 	bool irqs_enabled;
+
+	/* Autosuspend delay, adapted to how long the device stays suspended */
+	int autosuspend_ms;
+	ktime_t suspended_at;
+
+	u64 suspend_count;
+	u64 short_suspends;
+	u64 suspended_ns;
+	u64 resume_ns;
+	u64 resume_ns_max;
 };
 
 enum intel_pipe_crc_source {
@@ -1913,6 +1954,8 @@ struct i915_workarounds {
 struct i915_virtual_gpu {
 	bool active;
 	u32 caps;
+	/* registers mirrored by GVT-g, read without trapping */
+	struct vgt_shared_page *shared_page;
 };
 
 /* used in computing the new watermarks state */
@@ -2008,6 +2051,13 @@ struct i915_perf_stream_ops {
 		    size_t count,
 		    size_t *offset);
 
+	/**
+	 * @mmap: Map the stream's buffered data directly into userspace, for
+	 * streams that export their buffer instead of supporting @read.
+	 */
+	int (*mmap)(struct i915_perf_stream *stream,
+		    struct vm_area_struct *vma);
+
 	/**
 	 * @destroy: Cleanup any stream specific resources.
 	 *
@@ -2151,6 +2201,12 @@ struct i915_oa_ops {
 	 * generations.
 	 */
 	u32 (*oa_hw_tail_read)(struct drm_i915_private *dev_priv);
+
+	/**
+	 * @oa_hw_head_write: write the OA head pointer register, telling the
+	 * OA unit that the space up to @head may be reused
+	 */
+	void (*oa_hw_head_write)(struct drm_i915_private *dev_priv, u32 head);
 };
 
 struct intel_cdclk_state {
@@ -2204,6 +2260,7 @@ struct drm_i915_private {
 
 	struct pci_dev *bridge_dev;
 	struct i915_gem_context *kernel_context;
+	struct i915_gem_context *preempt_context;
 	struct intel_engine_cs *engine[I915_NUM_ENGINES];
 	struct i915_vma *semaphore;
 
@@ -2294,6 +2351,13 @@ struct drm_i915_private {
 	 */
 	struct workqueue_struct *wq;
 
+	/**
+	 * flip_wq - High priority queue for nonblocking plane-only commits,
+	 * so that page flips are not stuck behind modesets or other work on
+	 * the system queues.
+	 */
+	struct workqueue_struct *flip_wq;
+
 	/* Display functions */
 	struct drm_i915_display_funcs display;
 
@@ -2595,6 +2659,13 @@ struct drm_i915_private {
 				 * data to userspace.
 				 */
 				u32 head;
+
+				/**
+				 * Page shared read-only with userspace when
+				 * the OA buffer is exported via mmap(), %NULL
+				 * for streams read() by userspace.
+				 */
+				struct drm_i915_perf_oa_buffer_status *status;
 			} oa_buffer;
 
 			u32 gen7_latched_oastatus1;
@@ -3020,6 +3091,8 @@ intel_info(const struct drm_i915_private *dev_priv)
 
 #define HAS_LOGICAL_RING_CONTEXTS(dev_priv) \
 		((dev_priv)->info.has_logical_ring_contexts)
+#define HAS_LOGICAL_RING_PREEMPTION(dev_priv) \
+		(HAS_LOGICAL_RING_CONTEXTS(dev_priv) && INTEL_GEN(dev_priv) >= 9)
 #define USES_PPGTT(dev_priv)		(i915.enable_ppgtt)
 #define USES_FULL_PPGTT(dev_priv)	(i915.enable_ppgtt >= 2)
 #define USES_FULL_48BIT_PPGTT(dev_priv)	(i915.enable_ppgtt == 3)
@@ -3192,6 +3265,9 @@ extern int i915_reset_engine(struct intel_engine_cs *engine,
 extern bool intel_has_reset_engine(struct drm_i915_private *dev_priv);
 extern int intel_guc_reset(struct drm_i915_private *dev_priv);
 extern void intel_engine_init_hangcheck(struct intel_engine_cs *engine);
+extern void intel_engine_init_heartbeat(struct intel_engine_cs *engine);
+extern void intel_engine_unpark_heartbeat(struct intel_engine_cs *engine);
+extern void intel_engine_fini_heartbeat(struct intel_engine_cs *engine);
 extern void intel_hangcheck_init(struct drm_i915_private *dev_priv);
 extern unsigned long i915_chipset_val(struct drm_i915_private *dev_priv);
 extern unsigned long i915_mch_val(struct drm_i915_private *dev_priv);
@@ -3765,6 +3841,8 @@ unsigned long i915_gem_shrink(struct drm_i915_private *dev_priv,
 #define I915_SHRINK_BOUND 0x4
 #define I915_SHRINK_ACTIVE 0x8
 #define I915_SHRINK_VMAPS 0x10
+#define I915_SHRINK_COLD 0x20
+#define I915_SHRINK_WRITEBACK 0x40
 unsigned long i915_gem_shrink_all(struct drm_i915_private *dev_priv);
 void i915_gem_shrinker_init(struct drm_i915_private *dev_priv);
 void i915_gem_shrinker_cleanup(struct drm_i915_private *dev_priv);
@@ -3829,6 +3907,7 @@ static inline void i915_error_state_buf_release(
 	kfree(eb->buf);
 }
 
+void i915_gpu_error_init(struct drm_i915_private *i915);
 struct i915_gpu_state *i915_capture_gpu_state(struct drm_i915_private *i915);
 void i915_capture_error_state(struct drm_i915_private *dev_priv,
 			      u32 engine_mask,
@@ -3853,6 +3932,10 @@ void i915_reset_error_state(struct drm_i915_private *i915);
 
 #else
 
+static inline void i915_gpu_error_init(struct drm_i915_private *i915)
+{
+}
+
 static inline void i915_capture_error_state(struct drm_i915_private *dev_priv,
 					    u32 engine_mask,
 					    const char *error_msg)
@@ -4050,6 +4050,8 @@ static void engine_set_wedged(struct intel_engine_cs *engine)
 
 		spin_unlock_irqrestore(&engine->timeline->lock, flags);
 
+		intel_engine_runtime_update(engine);
+
 		/* The port is checked prior to scheduling a tasklet, but
 		 * just in case we have suspended the tasklet to do the
 		 * wedging make sure that when it wakes, it decides there
@@ -4251,6 +4253,7 @@ void i915_gem_close_object(struct drm_gem_object *gem, struct drm_file *file)
 			continue;
 
 		vma = radix_tree_delete(&ctx->handles_vma, lut->handle);
+		ctx->handles_gen++; /* invalidate any cached BO list lookups */
 
 		GEM_BUG_ON(vma->obj != obj);
 
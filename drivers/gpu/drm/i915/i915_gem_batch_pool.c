@@ -37,8 +37,17 @@
  * The batch pool framework provides a mechanism for the driver to manage a
  * set of scratch buffers to use for this purpose. The framework can be
  * extended to support other uses cases should they arise.
+ *
+ * Objects are kept in power-of-two size classes (with everything larger than
+ * the biggest class sharing the final bucket), each in LRU order. As every
+ * object in a class is large enough for any request that maps to it, the
+ * least recently used object is the only one that needs to be checked for
+ * idleness. The pool is capped at BATCH_POOL_MAX_SIZE, beyond which idle
+ * objects are released, and may be trimmed further by the shrinker.
  */
 
+#define BATCH_POOL_MAX_SIZE SZ_8M
+
 /**
  * i915_gem_batch_pool_init() - initialize a batch buffer pool
  * @engine: the associated request submission engine
@@ -50,6 +59,7 @@ void i915_gem_batch_pool_init(struct intel_engine_cs *engine,
 	int n;
 
 	pool->engine = engine;
+	pool->size = 0;
 
 	for (n = 0; n < ARRAY_SIZE(pool->cache_list); n++)
 		INIT_LIST_HEAD(&pool->cache_list[n]);
@@ -77,6 +87,56 @@ void i915_gem_batch_pool_fini(struct i915_gem_batch_pool *pool)
 
 		INIT_LIST_HEAD(&pool->cache_list[n]);
 	}
+
+	pool->size = 0;
+}
+
+/**
+ * i915_gem_batch_pool_trim() - release idle buffers from the pool
+ * @pool: the batch buffer pool
+ * @target: the size to shrink the pool down to
+ *
+ * Releases the least recently used buffers that are neither active on the
+ * GPU nor pinned until the pool holds no more than @target bytes.
+ *
+ * Note: Callers must hold the struct_mutex.
+ *
+ * Return: the number of bytes released
+ */
+u64 i915_gem_batch_pool_trim(struct i915_gem_batch_pool *pool, u64 target)
+{
+	u64 freed = 0;
+	int n;
+
+	lockdep_assert_held(&pool->engine->i915->drm.struct_mutex);
+
+	/* Start with the largest objects */
+	for (n = ARRAY_SIZE(pool->cache_list); n-- && pool->size > target; ) {
+		struct drm_i915_gem_object *obj, *next;
+
+		list_for_each_entry_safe(obj, next,
+					 &pool->cache_list[n],
+					 batch_pool_link) {
+			if (pool->size <= target)
+				break;
+
+			/* The batches are strictly LRU ordered */
+			if (i915_gem_object_is_active(obj))
+				break;
+
+			/* Handed out but not yet submitted? */
+			if (i915_gem_object_has_pinned_pages(obj))
+				continue;
+
+			list_del_init(&obj->batch_pool_link);
+			pool->size -= obj->base.size;
+			freed += obj->base.size;
+
+			__i915_gem_object_release_unless_active(obj);
+		}
+	}
+
+	return freed;
 }
 
 /**
@@ -102,13 +162,15 @@ i915_gem_batch_pool_get(struct i915_gem_batch_pool *pool,
 
 	lockdep_assert_held(&pool->engine->i915->drm.struct_mutex);
 
-	/* Compute a power-of-two bucket, but throw everything greater than
-	 * 16KiB into the same bucket: i.e. the the buckets hold objects of
-	 * (1 page, 2 pages, 4 pages, 8+ pages).
+	/* Round up to a power-of-two bucket, but throw everything greater
+	 * than 256KiB into the same bucket: i.e. the the buckets hold objects
+	 * of exactly (1, 2, 4, ..., 64 pages) and then 65+ pages.
 	 */
-	n = fls(size >> PAGE_SHIFT) - 1;
-	if (n >= ARRAY_SIZE(pool->cache_list))
+	n = order_base_2(DIV_ROUND_UP(size, PAGE_SIZE));
+	if (n >= ARRAY_SIZE(pool->cache_list) - 1)
 		n = ARRAY_SIZE(pool->cache_list) - 1;
+	else
+		size = PAGE_SIZE << n;
 	list = &pool->cache_list[n];
 
 	list_for_each_entry(obj, list, batch_pool_link) {
@@ -144,10 +206,17 @@ i915_gem_batch_pool_get(struct i915_gem_batch_pool *pool,
 			goto found;
 	}
 
+	if (pool->size + size > BATCH_POOL_MAX_SIZE)
+		i915_gem_batch_pool_trim(pool,
+					 size < BATCH_POOL_MAX_SIZE ?
+					 BATCH_POOL_MAX_SIZE - size : 0);
+
 	obj = i915_gem_object_create_internal(pool->engine->i915, size);
 	if (IS_ERR(obj))
 		return obj;
 
+	pool->size += obj->base.size;
+
 found:
 	ret = i915_gem_object_pin_pages(obj);
 	if (ret)
@@ -31,7 +31,8 @@ struct intel_engine_cs;
 
 struct i915_gem_batch_pool {
 	struct intel_engine_cs *engine;
-	struct list_head cache_list[4];
+	struct list_head cache_list[8];
+	u64 size; /* total size of the objects held in the pool */
 };
 
 /* i915_gem_batch_pool.c */
@@ -40,5 +41,6 @@ void i915_gem_batch_pool_init(struct intel_engine_cs *engine,
 void i915_gem_batch_pool_fini(struct i915_gem_batch_pool *pool);
 struct drm_i915_gem_object*
 i915_gem_batch_pool_get(struct i915_gem_batch_pool *pool, size_t size);
+u64 i915_gem_batch_pool_trim(struct i915_gem_batch_pool *pool, u64 target);
 
 #endif /* I915_GEM_BATCH_POOL_H */
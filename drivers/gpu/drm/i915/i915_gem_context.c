@@ -119,6 +119,19 @@ static void lut_close(struct i915_gem_context *ctx)
 	rcu_read_unlock();
 }
 
+static void bo_list_free(struct i915_gem_bo_list *list)
+{
+	kvfree(list->vma);
+	kvfree(list->exec);
+	kfree(list);
+}
+
+static int bo_list_free_cb(int id, void *p, void *data)
+{
+	bo_list_free(p);
+	return 0;
+}
+
 static void i915_gem_context_free(struct i915_gem_context *ctx)
 {
 	int i;
@@ -128,6 +141,9 @@ static void i915_gem_context_free(struct i915_gem_context *ctx)
 
 	i915_ppgtt_put(ctx->ppgtt);
 
+	idr_for_each(&ctx->bo_lists, bo_list_free_cb, NULL);
+	idr_destroy(&ctx->bo_lists);
+
 	for (i = 0; i < I915_NUM_ENGINES; i++) {
 		struct intel_context *ce = &ctx->engine[i];
 
@@ -198,6 +214,20 @@ void i915_gem_context_release(struct kref *ref)
 
 static void context_close(struct i915_gem_context *ctx)
 {
+	struct intel_engine_cs *engine;
+	enum intel_engine_id id;
+
+	/*
+	 * Keep charging the client for the GPU time of its closed contexts,
+	 * but only for what has been accounted so far; requests still in
+	 * flight are retired after our link to the client is gone.
+	 */
+	if (!IS_ERR_OR_NULL(ctx->file_priv)) {
+		for_each_engine(engine, ctx->i915, id)
+			ctx->file_priv->runtime[engine->class] +=
+				intel_engine_context_runtime(engine, ctx);
+	}
+
 	i915_gem_context_set_closed(ctx);
 
 	lut_close(ctx);
@@ -278,6 +308,7 @@ __create_hw_context(struct drm_i915_private *dev_priv,
 
 	INIT_RADIX_TREE(&ctx->handles_vma, GFP_KERNEL);
 	INIT_LIST_HEAD(&ctx->handles_list);
+	idr_init(&ctx->bo_lists);
 
 	/* Default context will never have a file_priv */
 	ret = DEFAULT_CONTEXT_HANDLE;
@@ -418,6 +449,32 @@ i915_gem_context_create_gvt(struct drm_device *dev)
 	return ctx;
 }
 
+static struct i915_gem_context *
+create_kernel_context(struct drm_i915_private *i915, int prio)
+{
+	struct i915_gem_context *ctx;
+
+	ctx = i915_gem_create_context(i915, NULL);
+	if (IS_ERR(ctx))
+		return ctx;
+
+	i915_gem_context_clear_bannable(ctx);
+	ctx->priority = prio;
+
+	GEM_BUG_ON(!i915_gem_context_is_kernel(ctx));
+
+	return ctx;
+}
+
+static bool needs_preempt_context(struct drm_i915_private *i915)
+{
+	return HAS_LOGICAL_RING_PREEMPTION(i915) &&
+	       i915.enable_execlists &&
+	       i915.enable_preemption &&
+	       !i915.enable_guc_submission &&
+	       !intel_vgpu_active(i915);
+}
+
 int i915_gem_contexts_init(struct drm_i915_private *dev_priv)
 {
 	struct i915_gem_context *ctx;
@@ -443,7 +500,8 @@ int i915_gem_contexts_init(struct drm_i915_private *dev_priv)
 	BUILD_BUG_ON(MAX_CONTEXT_HW_ID > INT_MAX);
 	ida_init(&dev_priv->contexts.hw_ida);
 
-	ctx = i915_gem_create_context(dev_priv, NULL);
+	/* lowest priority; idle task */
+	ctx = create_kernel_context(dev_priv, I915_PRIORITY_MIN);
 	if (IS_ERR(ctx)) {
 		DRM_ERROR("Failed to create default global context (error %ld)\n",
 			  PTR_ERR(ctx));
@@ -454,12 +512,22 @@ int i915_gem_contexts_init(struct drm_i915_private *dev_priv)
 	 * all user contexts will have non-zero hw_id.
 	 */
 	GEM_BUG_ON(ctx->hw_id);
-
-	i915_gem_context_clear_bannable(ctx);
-	ctx->priority = I915_PRIORITY_MIN; /* lowest priority; idle task */
 	dev_priv->kernel_context = ctx;
 
-	GEM_BUG_ON(!i915_gem_context_is_kernel(ctx));
+	/* highest priority; preempting task, identified by hw_id 1 in the CSB */
+	if (needs_preempt_context(dev_priv)) {
+		ctx = create_kernel_context(dev_priv, INT_MAX);
+		if (!IS_ERR(ctx) && ctx->hw_id == 1) {
+			/* it only ever executes a couple of NOOPs */
+			ctx->ring_size = PAGE_SIZE;
+			dev_priv->preempt_context = ctx;
+		}
+		else if (!IS_ERR(ctx))
+			context_close(ctx);
+
+		if (!dev_priv->preempt_context)
+			DRM_ERROR("Failed to create preempt context; disabling preemption\n");
+	}
 
 	DRM_DEBUG_DRIVER("%s context support initialized\n",
 			 dev_priv->engine[RCS]->context_size ? "logical" :
@@ -513,6 +581,13 @@ void i915_gem_contexts_fini(struct drm_i915_private *i915)
 
 	lockdep_assert_held(&i915->drm.struct_mutex);
 
+	if (i915->preempt_context) {
+		ctx = i915_gem_context_get(fetch_and_zero(&i915->preempt_context));
+		GEM_BUG_ON(!i915_gem_context_is_kernel(ctx));
+		context_close(ctx);
+		i915_gem_context_free(ctx);
+	}
+
 	/* Keep the context so that we can free it immediately ourselves */
 	ctx = i915_gem_context_get(fetch_and_zero(&i915->kernel_context));
 	GEM_BUG_ON(!i915_gem_context_is_kernel(ctx));
@@ -1142,6 +1217,99 @@ int i915_gem_context_reset_stats_ioctl(struct drm_device *dev,
 	return ret;
 }
 
+int i915_gem_bo_list_create_ioctl(struct drm_device *dev, void *data,
+				  struct drm_file *file)
+{
+	struct drm_i915_gem_bo_list_create *args = data;
+	struct i915_gem_bo_list *list;
+	struct i915_gem_context *ctx;
+	int ret;
+
+	if (args->pad)
+		return -EINVAL;
+
+	if (args->buffer_count < 1 ||
+	    args->buffer_count > SIZE_MAX / sizeof(*list->exec) - 1)
+		return -EINVAL;
+
+	list = kmalloc(sizeof(*list), GFP_KERNEL);
+	if (!list)
+		return -ENOMEM;
+
+	list->count = args->buffer_count;
+	list->exec = kvmalloc_array(list->count, sizeof(*list->exec),
+				    __GFP_NOWARN | GFP_KERNEL);
+	list->vma = kvmalloc_array(list->count, sizeof(*list->vma),
+				   __GFP_NOWARN | GFP_KERNEL | __GFP_ZERO);
+	if (!list->exec || !list->vma) {
+		ret = -ENOMEM;
+		goto err_free;
+	}
+
+	if (copy_from_user(list->exec, u64_to_user_ptr(args->buffers_ptr),
+			   sizeof(*list->exec) * list->count)) {
+		ret = -EFAULT;
+		goto err_free;
+	}
+
+	ctx = i915_gem_context_lookup(file->driver_priv, args->ctx_id);
+	if (!ctx) {
+		ret = -ENOENT;
+		goto err_free;
+	}
+
+	ret = i915_mutex_lock_interruptible(dev);
+	if (ret)
+		goto err_ctx;
+
+	/* Nothing resolved yet, force a full lookup on first use */
+	list->handles_gen = ctx->handles_gen - 1;
+
+	ret = idr_alloc(&ctx->bo_lists, list, 1, 0, GFP_KERNEL);
+	mutex_unlock(&dev->struct_mutex);
+	if (ret < 0)
+		goto err_ctx;
+
+	i915_gem_context_put(ctx);
+	args->list_id = ret;
+	return 0;
+
+err_ctx:
+	i915_gem_context_put(ctx);
+err_free:
+	bo_list_free(list);
+	return ret;
+}
+
+int i915_gem_bo_list_destroy_ioctl(struct drm_device *dev, void *data,
+				   struct drm_file *file)
+{
+	struct drm_i915_gem_bo_list_destroy *args = data;
+	struct i915_gem_bo_list *list;
+	struct i915_gem_context *ctx;
+	int ret;
+
+	ctx = i915_gem_context_lookup(file->driver_priv, args->ctx_id);
+	if (!ctx)
+		return -ENOENT;
+
+	ret = i915_mutex_lock_interruptible(dev);
+	if (ret)
+		goto out;
+
+	list = idr_remove(&ctx->bo_lists, args->list_id);
+	mutex_unlock(&dev->struct_mutex);
+
+	if (list)
+		bo_list_free(list);
+	else
+		ret = -ENOENT;
+
+out:
+	i915_gem_context_put(ctx);
+	return ret;
+}
+
 #if IS_ENABLED(CONFIG_DRM_I915_SELFTEST)
 #include "selftests/mock_context.c"
 #include "selftests/i915_gem_context.c"
@@ -26,6 +26,7 @@
 #define __I915_GEM_CONTEXT_H__
 
 #include <linux/bitops.h>
+#include <linux/idr.h>
 #include <linux/list.h>
 #include <linux/radix-tree.h>
 
@@ -39,9 +40,29 @@ struct drm_i915_file_private;
 struct i915_hw_ppgtt;
 struct i915_vma;
 struct intel_ring;
+struct drm_i915_gem_exec_object2;
 
 #define DEFAULT_CONTEXT_HANDLE 0
 
+/**
+ * struct i915_gem_bo_list - a registered execobject[] array
+ *
+ * A BO list holds a copy of the execobject[] supplied by userspace at
+ * creation, along with the vma each handle resolved to on the last execbuf.
+ * The cached vma are only valid for as long as @handles_gen matches that of
+ * the context, i.e. no handle has been removed from the context's lut since.
+ */
+struct i915_gem_bo_list {
+	/** count: number of entries in @exec and @vma */
+	unsigned int count;
+	/** handles_gen: value of ctx->handles_gen when @vma was filled */
+	unsigned int handles_gen;
+	/** exec: the execobject[], with offsets updated after each execbuf */
+	struct drm_i915_gem_exec_object2 *exec;
+	/** vma: the cached handle lookup, or NULL if not yet resolved */
+	struct i915_vma **vma;
+};
+
 /**
  * struct i915_gem_context - client state
  *
@@ -158,6 +179,8 @@ struct i915_gem_context {
 		u64 lrc_desc;
 		int pin_count;
 		bool initialised;
+		/** runtime: ns spent executing by retired requests */
+		u64 runtime;
 	} engine[I915_NUM_ENGINES];
 
 	/** ring_size: size for allocating the per-engine ring buffer */
@@ -192,6 +215,14 @@ struct i915_gem_context {
 	 * context close.
 	 */
 	struct list_head handles_list;
+
+	/** handles_gen: incremented whenever an entry in handles_vma is
+	 * removed, invalidating any vma cached by a BO list.
+	 */
+	unsigned int handles_gen;
+
+	/** bo_lists: idr of struct i915_gem_bo_list registered by userspace */
+	struct idr bo_lists;
 };
 
 static inline bool i915_gem_context_is_closed(const struct i915_gem_context *ctx)
@@ -291,6 +322,10 @@ int i915_gem_context_setparam_ioctl(struct drm_device *dev, void *data,
 				    struct drm_file *file_priv);
 int i915_gem_context_reset_stats_ioctl(struct drm_device *dev, void *data,
 				       struct drm_file *file);
+int i915_gem_bo_list_create_ioctl(struct drm_device *dev, void *data,
+				  struct drm_file *file);
+int i915_gem_bo_list_destroy_ioctl(struct drm_device *dev, void *data,
+				   struct drm_file *file);
 
 static inline struct i915_gem_context *
 i915_gem_context_get(struct i915_gem_context *ctx)
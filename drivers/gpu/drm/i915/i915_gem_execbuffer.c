@@ -195,6 +195,8 @@ struct i915_execbuffer {
 	struct i915_vma **vma;
 	unsigned int *flags;
 
+	struct i915_gem_bo_list *bo_list; /** registered execobj[], if any */
+
 	struct intel_engine_cs *engine; /** engine to queue the request to */
 	struct i915_gem_context *ctx; /** context for building the request */
 	struct i915_address_space *vm; /** GTT and vma for the request */
@@ -577,7 +579,7 @@ static int eb_reserve_vma(const struct i915_execbuffer *eb,
 	return 0;
 }
 
-static int eb_reserve(struct i915_execbuffer *eb)
+static int __eb_reserve(struct i915_execbuffer *eb)
 {
 	const unsigned int count = eb->buffer_count;
 	struct list_head last;
@@ -649,6 +651,22 @@ static int eb_reserve(struct i915_execbuffer *eb)
 	} while (1);
 }
 
+static int eb_reserve(struct i915_execbuffer *eb)
+{
+	struct i915_ggtt *ggtt = &eb->i915->ggtt;
+	int err;
+
+	/*
+	 * Nothing looks at the new bindings until we have reserved all
+	 * the objects, so flush the GGTT TLB just once for all of them.
+	 */
+	i915_ggtt_batch_begin(ggtt);
+	err = __eb_reserve(eb);
+	i915_ggtt_batch_end(ggtt);
+
+	return err;
+}
+
 static unsigned int eb_batch_index(const struct i915_execbuffer *eb)
 {
 	if (eb->args->flags & I915_EXEC_BATCH_FIRST)
@@ -679,6 +697,7 @@ static int eb_lookup_vmas(struct i915_execbuffer *eb)
 {
 	struct radix_tree_root *handles_vma = &eb->ctx->handles_vma;
 	struct drm_i915_gem_object *uninitialized_var(obj);
+	bool cached;
 	unsigned int i;
 	int err;
 
@@ -691,11 +710,25 @@ static int eb_lookup_vmas(struct i915_execbuffer *eb)
 	INIT_LIST_HEAD(&eb->relocs);
 	INIT_LIST_HEAD(&eb->unbound);
 
+	/*
+	 * A BO list remembers the vma each of its handles resolved to on
+	 * the previous execbuf. So long as no handle has since been closed
+	 * on this context, those vma are still held open by the lut and we
+	 * can skip the lookup entirely.
+	 */
+	cached = eb->bo_list &&
+		 eb->bo_list->handles_gen == eb->ctx->handles_gen;
+
 	for (i = 0; i < eb->buffer_count; i++) {
 		u32 handle = eb->exec[i].handle;
 		struct i915_lut_handle *lut;
 		struct i915_vma *vma;
 
+		if (cached) {
+			vma = eb->bo_list->vma[i];
+			goto add_vma;
+		}
+
 		vma = radix_tree_lookup(handles_vma, handle);
 		if (likely(vma))
 			goto add_vma;
@@ -742,6 +775,12 @@ static int eb_lookup_vmas(struct i915_execbuffer *eb)
 		GEM_BUG_ON(vma->exec_flags != &eb->flags[i]);
 	}
 
+	if (eb->bo_list && !cached) {
+		memcpy(eb->bo_list->vma, eb->vma,
+		       eb->bo_list->count * sizeof(*eb->vma));
+		eb->bo_list->handles_gen = eb->ctx->handles_gen;
+	}
+
 	/* take note of the batch buffer before we might reorder the lists */
 	i = eb_batch_index(eb);
 	eb->batch = eb->vma[i];
@@ -772,6 +811,42 @@ static int eb_lookup_vmas(struct i915_execbuffer *eb)
 	return err;
 }
 
+static int eb_lookup_bo_list(struct i915_execbuffer *eb)
+{
+	struct i915_gem_bo_list *list;
+
+	list = idr_find(&eb->ctx->bo_lists, eb->args->DR1);
+	if (unlikely(!list))
+		return -ENOENT;
+
+	if (unlikely(list->count != eb->buffer_count)) {
+		DRM_DEBUG("BO list has %d buffers, execbuf %d\n",
+			  list->count, eb->buffer_count);
+		return -EINVAL;
+	}
+
+	memcpy(eb->exec, list->exec, list->count * sizeof(*eb->exec));
+	eb->bo_list = list;
+	return 0;
+}
+
+static void eb_update_bo_list(const struct i915_execbuffer *eb)
+{
+	struct i915_gem_bo_list *list = eb->bo_list;
+	unsigned int i;
+
+	/* Keep the presumed offsets current for the next execbuf */
+	for (i = 0; i < list->count; i++) {
+		u64 offset = eb->exec[i].offset;
+
+		if (!(offset & UPDATE))
+			continue;
+
+		list->exec[i].offset =
+			gen8_canonical_addr(offset & PIN_OFFSET_MASK);
+	}
+}
+
 static struct i915_vma *
 eb_get_vma(const struct i915_execbuffer *eb, unsigned long handle)
 {
@@ -1827,7 +1902,11 @@ static bool i915_gem_check_execbuffer(struct drm_i915_gem_execbuffer2 *exec)
 		DRM_DEBUG("UXA submitting garbage DR4, fixing up\n");
 		exec->DR4 = 0;
 	}
-	if (exec->DR1 || exec->DR4)
+	if (exec->DR4)
+		return false;
+
+	/* DR1 is reused for the BO list id */
+	if (exec->DR1 && !(exec->flags & I915_EXEC_BO_LIST))
 		return false;
 
 	if ((exec->batch_start_offset | exec->batch_len) & 0x7)
@@ -1856,6 +1935,7 @@ void i915_vma_move_to_active(struct i915_vma *vma,
 	 */
 	if (!i915_vma_is_active(vma))
 		obj->active_count++;
+	obj->mm.shrink_gen = READ_ONCE(req->i915->mm.shrink_gen);
 	i915_vma_set_active(vma, idx);
 	i915_gem_active_set(&vma->last_read[idx], req);
 	list_move_tail(&vma->vm_link, &vma->vm->active_list);
@@ -2200,6 +2280,7 @@ i915_gem_do_execbuffer(struct drm_device *dev,
 		args->flags |= __EXEC_HAS_RELOC;
 
 	eb.exec = exec;
+	eb.bo_list = NULL;
 	eb.vma = (struct i915_vma **)(exec + args->buffer_count + 1);
 	eb.vma[0] = NULL;
 	eb.flags = (unsigned int *)(eb.vma + args->buffer_count + 1);
@@ -2278,6 +2359,14 @@ i915_gem_do_execbuffer(struct drm_device *dev,
 	if (err)
 		goto err_rpm;
 
+	if (args->flags & I915_EXEC_BO_LIST) {
+		err = eb_lookup_bo_list(&eb);
+		if (err) {
+			args->flags &= ~__EXEC_HAS_RELOC;
+			goto err_vma;
+		}
+	}
+
 	err = eb_relocate(&eb);
 	if (err) {
 		/*
@@ -2422,6 +2511,8 @@ i915_gem_do_execbuffer(struct drm_device *dev,
 err_vma:
 	if (eb.exec)
 		eb_release_vmas(&eb);
+	if (eb.bo_list && args->flags & __EXEC_HAS_RELOC)
+		eb_update_bo_list(&eb);
 	mutex_unlock(&dev->struct_mutex);
 err_rpm:
 	intel_runtime_pm_put(eb.i915);
@@ -2553,6 +2644,11 @@ i915_gem_execbuffer2(struct drm_device *dev, void *data,
 	if (!i915_gem_check_execbuffer(args))
 		return -EINVAL;
 
+	if (args->flags & I915_EXEC_BO_LIST && args->buffers_ptr) {
+		DRM_DEBUG("execbuf2 with both a BO list and buffers_ptr\n");
+		return -EINVAL;
+	}
+
 	/* Allocate an extra slot for use by the command parser */
 	exec2_list = kvmalloc_array(args->buffer_count + 1, sz,
 				    __GFP_NOWARN | GFP_KERNEL);
@@ -2561,7 +2657,9 @@ i915_gem_execbuffer2(struct drm_device *dev, void *data,
 			  args->buffer_count);
 		return -ENOMEM;
 	}
-	if (copy_from_user(exec2_list,
+	/* A BO list is copied in from the context once we hold its lock */
+	if (!(args->flags & I915_EXEC_BO_LIST) &&
+	    copy_from_user(exec2_list,
 			   u64_to_user_ptr(args->buffers_ptr),
 			   sizeof(*exec2_list) * args->buffer_count)) {
 		DRM_DEBUG("copy %d exec entries failed\n", args->buffer_count);
@@ -2583,9 +2681,11 @@ i915_gem_execbuffer2(struct drm_device *dev, void *data,
 	 * Now that we have begun execution of the batchbuffer, we ignore
 	 * any new error after this point. Also given that we have already
 	 * updated the associated relocations, we try to write out the current
-	 * object locations irrespective of any error.
+	 * object locations irrespective of any error. For a BO list, they
+	 * have already been recorded in the list itself.
 	 */
-	if (args->flags & __EXEC_HAS_RELOC) {
+	if (args->flags & __EXEC_HAS_RELOC &&
+	    !(args->flags & I915_EXEC_BO_LIST)) {
 		struct drm_i915_gem_exec_object2 __user *user_exec_list =
 			u64_to_user_ptr(args->buffers_ptr);
 		unsigned int i;
@@ -2611,3 +2711,7 @@ i915_gem_execbuffer2(struct drm_device *dev, void *data,
 	kvfree(exec2_list);
 	return err;
 }
+
+#if IS_ENABLED(CONFIG_DRM_I915_SELFTEST)
+#include "selftests/i915_gem_bench.c"
+#endif
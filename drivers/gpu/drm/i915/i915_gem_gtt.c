@@ -132,6 +132,64 @@ static inline void i915_ggtt_invalidate(struct drm_i915_private *i915)
 	i915->ggtt.invalidate(i915);
 }
 
+/*
+ * Invalidate the TLB after writing the PTEs for a vma, unless we are inside
+ * an i915_ggtt_batch_begin() section in which case the invalidate is
+ * postponed until the end of the batch.
+ */
+static void ggtt_invalidate_entries(struct i915_ggtt *ggtt)
+{
+	if (ggtt->batch_depth) {
+		ggtt->batch_pending = true;
+		ggtt->deferred_invalidations++;
+		return;
+	}
+
+	ggtt->invalidations++;
+	ggtt->invalidate(ggtt->base.i915);
+}
+
+/**
+ * i915_ggtt_batch_begin - start batching GGTT PTE updates
+ * @ggtt: the global GTT
+ *
+ * Binding many vma into the GGTT otherwise costs a TLB invalidate (an
+ * uncached mmio write, plus a GuC invalidate if active) per vma. Between
+ * i915_ggtt_batch_begin() and i915_ggtt_batch_end() the PTEs are written as
+ * usual but only a single invalidate is issued at the end. The caller must
+ * not access any of the new bindings, from either the GPU or through the
+ * aperture, before ending the batch. Single page updates (insert_page) are
+ * never deferred.
+ *
+ * Batches may nest and must be called under struct_mutex.
+ */
+void i915_ggtt_batch_begin(struct i915_ggtt *ggtt)
+{
+	lockdep_assert_held(&ggtt->base.i915->drm.struct_mutex);
+
+	ggtt->batch_depth++;
+}
+
+/**
+ * i915_ggtt_batch_end - finish batching GGTT PTE updates
+ * @ggtt: the global GTT
+ *
+ * Ends a section started with i915_ggtt_batch_begin(), flushing the pending
+ * TLB invalidate once the outermost section is closed.
+ */
+void i915_ggtt_batch_end(struct i915_ggtt *ggtt)
+{
+	lockdep_assert_held(&ggtt->base.i915->drm.struct_mutex);
+	GEM_BUG_ON(!ggtt->batch_depth);
+
+	if (--ggtt->batch_depth || !ggtt->batch_pending)
+		return;
+
+	ggtt->batch_pending = false;
+	ggtt->invalidations++;
+	ggtt->invalidate(ggtt->base.i915);
+}
+
 int intel_sanitize_enable_ppgtt(struct drm_i915_private *dev_priv,
 			       	int enable_ppgtt)
 {
@@ -2105,7 +2163,7 @@ static void gen8_ggtt_insert_entries(struct i915_address_space *vm,
 	 * want to flush the TLBs only after we're certain all the PTE updates
 	 * have finished.
 	 */
-	ggtt->invalidate(vm->i915);
+	ggtt_invalidate_entries(ggtt);
 }
 
 static void gen6_ggtt_insert_page(struct i915_address_space *vm,
@@ -2147,7 +2205,7 @@ static void gen6_ggtt_insert_entries(struct i915_address_space *vm,
 	 * want to flush the TLBs only after we're certain all the PTE updates
 	 * have finished.
 	 */
-	ggtt->invalidate(vm->i915);
+	ggtt_invalidate_entries(ggtt);
 }
 
 static void nop_clear_range(struct i915_address_space *vm,
@@ -3126,6 +3184,9 @@ void i915_gem_restore_gtt_mappings(struct drm_i915_private *dev_priv)
 
 	ggtt->base.closed = true; /* skip rewriting PTE on VMA unbind */
 
+	/* The invalidate at the end covers all of the rebinding */
+	i915_ggtt_batch_begin(ggtt);
+
 	/* clflush objects bound into the GGTT and rebind them. */
 	list_for_each_entry_safe(obj, on,
 				 &dev_priv->mm.bound_list, global_link) {
@@ -3149,6 +3210,7 @@ void i915_gem_restore_gtt_mappings(struct drm_i915_private *dev_priv)
 	}
 
 	ggtt->base.closed = false;
+	i915_ggtt_batch_end(ggtt);
 
 	if (INTEL_GEN(dev_priv) >= 8) {
 		if (INTEL_GEN(dev_priv) >= 10)
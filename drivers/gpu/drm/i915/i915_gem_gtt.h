@@ -367,6 +367,16 @@ struct i915_ggtt {
 	void __iomem *gsm;
 	void (*invalidate)(struct drm_i915_private *dev_priv);
 
+	/**
+	 * Batching of PTE updates: while @batch_depth is non-zero, binding
+	 * a vma only writes its PTEs and the TLB invalidate is deferred to
+	 * the final i915_ggtt_batch_end(). Protected by struct_mutex.
+	 */
+	unsigned int batch_depth;
+	bool batch_pending;
+	unsigned long invalidations; /* TLB invalidates issued for binds */
+	unsigned long deferred_invalidations; /* ... and those elided */
+
 	bool do_idle_maps;
 
 	int mtrr;
@@ -543,6 +553,8 @@ int i915_ggtt_probe_hw(struct drm_i915_private *dev_priv);
 int i915_ggtt_init_hw(struct drm_i915_private *dev_priv);
 int i915_ggtt_enable_hw(struct drm_i915_private *dev_priv);
 void i915_ggtt_enable_guc(struct drm_i915_private *i915);
+void i915_ggtt_batch_begin(struct i915_ggtt *ggtt);
+void i915_ggtt_batch_end(struct i915_ggtt *ggtt);
 void i915_ggtt_disable_guc(struct drm_i915_private *i915);
 int i915_gem_init_ggtt(struct drm_i915_private *dev_priv);
 void i915_ggtt_cleanup_hw(struct drm_i915_private *dev_priv);
@@ -37,6 +37,7 @@
 #include "i915_selftest.h"
 
 struct drm_i915_gem_object;
+struct intel_vgpu_fb_info;
 
 /*
  * struct i915_lut_handle tracks the fast lookups from handle to vma used
@@ -128,6 +129,9 @@ struct drm_i915_gem_object {
 	struct list_head batch_pool_link;
 	I915_SELFTEST_DECLARE(struct list_head st_link);
 
+	/** Link in i915->mm.writeback_list, see i915_gem_shrink() */
+	struct llist_node writeback_link;
+
 	unsigned long flags;
 
 	/**
@@ -195,6 +199,19 @@ struct drm_i915_gem_object {
 		 * swizzling.
 		 */
 		bool quirked:1;
+
+		/**
+		 * Value of i915->mm.shrink_gen when the object was last used
+		 * by the GPU. Objects from older generations are cold and
+		 * reclaimed first by the shrinker.
+		 */
+		unsigned int shrink_gen;
+
+		/**
+		 * Set while the object is queued for writeback of its released
+		 * shmem pages. Protected by @lock.
+		 */
+		bool writeback;
 	} mm;
 
 	/** Breadcrumb of last rendering to the buffer.
@@ -226,6 +243,9 @@ struct drm_i915_gem_object {
 		} userptr;
 
 		unsigned long scratch;
+
+		/** guest framebuffer exported by GVT-g, see gvt/dmabuf.c */
+		struct intel_vgpu_fb_info *gvt_info;
 	};
 
 	struct list_head pid_info;
@@ -28,6 +28,8 @@
 #include <linux/sched/clock.h>
 #include <linux/sched/signal.h>
 
+#include <trace/events/frame.h>
+
 #include "i915_drv.h"
 
 static const char *i915_fence_get_driver_name(struct dma_fence *fence)
@@ -187,6 +189,7 @@ i915_priotree_init(struct i915_priotree *pt)
 	INIT_LIST_HEAD(&pt->waiters_list);
 	INIT_LIST_HEAD(&pt->link);
 	pt->priority = INT_MIN;
+	pt->ordered = false;
 }
 
 static int reset_all_global_seqno(struct drm_i915_private *i915, u32 seqno)
@@ -246,6 +249,9 @@ int i915_gem_set_global_seqno(struct drm_device *dev, u32 seqno)
 
 static void mark_busy(struct drm_i915_private *i915)
 {
+	struct intel_engine_cs *engine;
+	enum intel_engine_id id;
+
 	if (i915->gt.awake)
 		return;
 
@@ -262,6 +268,9 @@ static void mark_busy(struct drm_i915_private *i915)
 	queue_delayed_work(i915->wq,
 			   &i915->gt.retire_work,
 			   round_jiffies_up_relative(HZ));
+
+	for_each_engine(engine, i915, id)
+		intel_engine_unpark_heartbeat(engine);
 }
 
 static int reserve_engine(struct intel_engine_cs *engine)
@@ -403,6 +412,8 @@ static void i915_gem_request_retire(struct drm_i915_gem_request *request)
 	/* Retirement decays the ban score as it is a sign of ctx progress */
 	atomic_dec_if_positive(&request->ctx->ban_score);
 
+	intel_engine_runtime_retire(engine, request);
+
 	/* The backing object for the context is done after switching to the
 	 * *next* context. Therefore we cannot retire the previous context until
 	 * the next context has already started running. However, since we
@@ -458,6 +469,7 @@ void __i915_gem_request_submit(struct drm_i915_gem_request *request)
 	lockdep_assert_held(&engine->timeline->lock);
 
 	trace_i915_gem_request_execute(request);
+	trace_frame_stage(request->fence.frame_id, FRAME_STAGE_GPU_SUBMIT);
 
 	/* Transfer from per-context onto the global per-engine timeline */
 	timeline = engine->timeline;
@@ -674,6 +686,7 @@ i915_gem_request_alloc(struct intel_engine_cs *engine,
 	req->batch = NULL;
 	req->capture_list = NULL;
 	req->waitboost = false;
+	req->runtime = 0;
 
 	/*
 	 * Reserve space in the ring buffer for all the commands required to
@@ -735,6 +748,12 @@ i915_gem_request_await_request(struct drm_i915_gem_request *to,
 	}
 
 	if (to->engine == from->engine) {
+		/*
+		 * We only wait for @from to be submitted, and rely on the
+		 * engine executing in order. The scheduler must not let
+		 * @to overtake @from when timeslicing.
+		 */
+		to->priotree.ordered = true;
 		ret = i915_sw_fence_await_sw_fence_gfp(&to->submit,
 						       &from->submit,
 						       GFP_KERNEL);
@@ -69,6 +69,7 @@ struct i915_priotree {
 	struct list_head waiters_list; /* those after us, they depend upon us */
 	struct list_head link;
 	int priority;
+	bool ordered; /* waits on another timeline's submission, same engine */
 #define I915_PRIORITY_MAX 1024
 #define I915_PRIORITY_NORMAL 0
 #define I915_PRIORITY_MIN (-I915_PRIORITY_MAX)
@@ -184,6 +185,12 @@ struct drm_i915_gem_request {
 	/** Time at which this request was emitted, in jiffies. */
 	unsigned long emitted_jiffies;
 
+	/**
+	 * Time spent executing on the engine, in ns, until it is folded into
+	 * the context on retirement.
+	 */
+	u64 runtime;
+
 	bool waitboost;
 
 	/** engine->request_list entry for this request */
@@ -23,12 +23,14 @@
  */
 
 #include <linux/oom.h>
+#include <linux/pagemap.h>
 #include <linux/shmem_fs.h>
 #include <linux/slab.h>
 #include <linux/swap.h>
 #include <linux/pci.h>
 #include <linux/dma-buf.h>
 #include <linux/vmalloc.h>
+#include <linux/writeback.h>
 #include <drm/drmP.h>
 #include <drm/i915_drm.h>
 
@@ -132,6 +134,98 @@ static bool unsafe_drop_pages(struct drm_i915_gem_object *obj)
 	return !READ_ONCE(obj->mm.pages);
 }
 
+static void __shmem_writeback(size_t size, struct address_space *mapping)
+{
+	struct writeback_control wbc = {
+		.sync_mode = WB_SYNC_NONE,
+		.nr_to_write = SWAP_CLUSTER_MAX,
+		.range_start = 0,
+		.range_end = LLONG_MAX,
+		.for_reclaim = 1,
+	};
+	unsigned long i;
+
+	/*
+	 * Leave mmapings intact (GTT will have been revoked on unbinding,
+	 * leaving only CPU mmapings around) and add those pages to the LRU
+	 * instead of invoking writeback so they are aged and paged out
+	 * as normal.
+	 */
+
+	/* Begin writeback on each dirty page */
+	for (i = 0; i < size >> PAGE_SHIFT; i++) {
+		struct page *page;
+
+		page = find_lock_page(mapping, i);
+		if (!page)
+			continue;
+
+		if (!page_mapped(page) && clear_page_dirty_for_io(page)) {
+			int ret;
+
+			SetPageReclaim(page);
+			ret = mapping->a_ops->writepage(page, &wbc);
+			if (!PageWriteback(page))
+				ClearPageReclaim(page);
+			if (!ret)
+				goto put;
+		}
+		unlock_page(page);
+put:
+		put_page(page);
+	}
+}
+
+static void i915_gem_shrinker_writeback(struct work_struct *work)
+{
+	struct drm_i915_private *i915 =
+		container_of(work, typeof(*i915), mm.writeback_work);
+	struct drm_i915_gem_object *obj, *on;
+	struct llist_node *list;
+
+	list = llist_del_all(&i915->mm.writeback_list);
+	llist_for_each_entry_safe(obj, on, list, writeback_link) {
+		bool writeback;
+
+		mutex_lock(&obj->mm.lock);
+		obj->mm.writeback = false;
+		/* Skip objects whose pages were reacquired in the meantime */
+		writeback = !obj->mm.pages &&
+			    obj->mm.madv == I915_MADV_WILLNEED;
+		mutex_unlock(&obj->mm.lock);
+
+		if (writeback)
+			__shmem_writeback(obj->base.size,
+					  obj->base.filp->f_mapping);
+
+		i915_gem_object_put(obj);
+		cond_resched();
+	}
+}
+
+/*
+ * Releasing our pages only drops them into the shmemfs page cache; they
+ * still have to be written to swap before the memory can be reused. Rather
+ * than do that inline from direct reclaim or kswapd, hand the object to a
+ * worker which starts the writeback for us. Called with obj->mm.lock held.
+ */
+static void queue_writeback(struct drm_i915_private *i915,
+			    struct drm_i915_gem_object *obj)
+{
+	lockdep_assert_held(&obj->mm.lock);
+
+	if (!obj->base.filp || obj->mm.madv != I915_MADV_WILLNEED)
+		return;
+
+	if (obj->mm.writeback)
+		return;
+
+	obj->mm.writeback = true;
+	i915_gem_object_get(obj);
+	if (llist_add(&obj->writeback_link, &i915->mm.writeback_list))
+		queue_work(i915->wq, &i915->mm.writeback_work);
+}
+
 /**
  * i915_gem_shrink - Shrink buffer object caches
  * @dev_priv: i915 device
@@ -154,6 +248,10 @@ static bool unsafe_drop_pages(struct drm_i915_gem_object *obj)
  * backing storage pins at the buffer object level) result in the shrinker code
  * having to skip the object.
  *
+ * With I915_SHRINK_COLD only objects that have not been used by the GPU since
+ * the last shrinker scan are considered, and with I915_SHRINK_WRITEBACK the
+ * released shmem pages are queued for writeback to swap.
+ *
  * Returns:
  * The number of pages of backing storage actually released.
  */
@@ -240,6 +338,10 @@ i915_gem_shrink(struct drm_i915_private *dev_priv,
 			     i915_gem_object_is_framebuffer(obj)))
 				continue;
 
+			if (flags & I915_SHRINK_COLD &&
+			    obj->mm.shrink_gen == dev_priv->mm.shrink_gen)
+				continue;
+
 			if (!can_release_pages(obj))
 				continue;
 
@@ -251,6 +353,9 @@ i915_gem_shrink(struct drm_i915_private *dev_priv,
 					__i915_gem_object_invalidate(obj);
 					list_del_init(&obj->global_link);
 					count += obj->base.size >> PAGE_SHIFT;
+
+					if (flags & I915_SHRINK_WRITEBACK)
+						queue_writeback(dev_priv, obj);
 				}
 				mutex_unlock(&obj->mm.lock);
 				scanned += obj->base.size >> PAGE_SHIFT;
@@ -333,6 +438,8 @@ i915_gem_shrinker_scan(struct shrinker *shrinker, struct shrink_control *sc)
 {
 	struct drm_i915_private *dev_priv =
 		container_of(shrinker, struct drm_i915_private, mm.shrinker);
+	struct intel_engine_cs *engine;
+	enum intel_engine_id id;
 	unsigned long freed;
 	bool unlock;
 
@@ -341,6 +448,10 @@ i915_gem_shrinker_scan(struct shrinker *shrinker, struct shrink_control *sc)
 	if (!shrinker_lock(dev_priv, &unlock))
 		return SHRINK_STOP;
 
+	/* Idle shadow batches are just a cache, release them first */
+	for_each_engine(engine, dev_priv, id)
+		i915_gem_batch_pool_trim(&engine->batch_pool, 0);
+
 	freed = i915_gem_shrink(dev_priv,
 				sc->nr_to_scan,
 				&sc->nr_scanned,
@@ -352,7 +463,16 @@ i915_gem_shrinker_scan(struct shrinker *shrinker, struct shrink_control *sc)
 					 sc->nr_to_scan - sc->nr_scanned,
 					 &sc->nr_scanned,
 					 I915_SHRINK_BOUND |
-					 I915_SHRINK_UNBOUND);
+					 I915_SHRINK_UNBOUND |
+					 I915_SHRINK_COLD |
+					 I915_SHRINK_WRITEBACK);
+	if (freed < sc->nr_to_scan)
+		freed += i915_gem_shrink(dev_priv,
+					 sc->nr_to_scan - sc->nr_scanned,
+					 &sc->nr_scanned,
+					 I915_SHRINK_BOUND |
+					 I915_SHRINK_UNBOUND |
+					 I915_SHRINK_WRITEBACK);
 	if (freed < sc->nr_to_scan && current_is_kswapd()) {
 		intel_runtime_pm_get(dev_priv);
 		freed += i915_gem_shrink(dev_priv,
@@ -360,10 +480,17 @@ i915_gem_shrinker_scan(struct shrinker *shrinker, struct shrink_control *sc)
 					 &sc->nr_scanned,
 					 I915_SHRINK_ACTIVE |
 					 I915_SHRINK_BOUND |
-					 I915_SHRINK_UNBOUND);
+					 I915_SHRINK_UNBOUND |
+					 I915_SHRINK_WRITEBACK);
 		intel_runtime_pm_put(dev_priv);
 	}
 
+	/*
+	 * Everything used by the GPU from now on belongs to the new
+	 * generation and is spared by the next I915_SHRINK_COLD pass.
+	 */
+	dev_priv->mm.shrink_gen++;
+
 	shrinker_unlock(dev_priv, unlock);
 
 	return sc->nr_scanned ? freed : SHRINK_STOP;
@@ -495,6 +622,9 @@ i915_gem_shrinker_vmap(struct notifier_block *nb, unsigned long event, void *ptr
  */
 void i915_gem_shrinker_init(struct drm_i915_private *dev_priv)
 {
+	init_llist_head(&dev_priv->mm.writeback_list);
+	INIT_WORK(&dev_priv->mm.writeback_work, i915_gem_shrinker_writeback);
+
 	dev_priv->mm.shrinker.scan_objects = i915_gem_shrinker_scan;
 	dev_priv->mm.shrinker.count_objects = i915_gem_shrinker_count;
 	dev_priv->mm.shrinker.seeks = DEFAULT_SEEKS;
@@ -518,4 +648,5 @@ void i915_gem_shrinker_cleanup(struct drm_i915_private *dev_priv)
 	WARN_ON(unregister_vmap_purge_notifier(&dev_priv->mm.vmap_notifier));
 	WARN_ON(unregister_oom_notifier(&dev_priv->mm.oom_notifier));
 	unregister_shrinker(&dev_priv->mm.shrinker);
+	flush_work(&dev_priv->mm.writeback_work);
 }
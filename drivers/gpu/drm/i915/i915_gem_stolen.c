@@ -45,9 +45,18 @@
  * for is a boon.
  */
 
-int i915_gem_stolen_insert_node_in_range(struct drm_i915_private *dev_priv,
+/*
+ * Kernel objects below this size (rings, scratch and overlay pages) are
+ * packed at the top of stolen, so that they don't break up the large
+ * contiguous ranges the CFB and framebuffers need, which are best-fit
+ * from the bottom.
+ */
+#define I915_STOLEN_SMALL_SIZE	KB(256)
+
+static int __i915_gem_stolen_insert_node(struct drm_i915_private *dev_priv,
 					 struct drm_mm_node *node, u64 size,
-					 unsigned alignment, u64 start, u64 end)
+					 unsigned alignment, u64 start, u64 end,
+					 enum drm_mm_insert_mode mode)
 {
 	int ret;
 
@@ -57,12 +66,20 @@ int i915_gem_stolen_insert_node_in_range(struct drm_i915_private *dev_priv,
 	mutex_lock(&dev_priv->mm.stolen_lock);
 	ret = drm_mm_insert_node_in_range(&dev_priv->mm.stolen, node,
 					  size, alignment, 0,
-					  start, end, DRM_MM_INSERT_BEST);
+					  start, end, mode);
 	mutex_unlock(&dev_priv->mm.stolen_lock);
 
 	return ret;
 }
 
+int i915_gem_stolen_insert_node_in_range(struct drm_i915_private *dev_priv,
+					 struct drm_mm_node *node, u64 size,
+					 unsigned alignment, u64 start, u64 end)
+{
+	return __i915_gem_stolen_insert_node(dev_priv, node, size, alignment,
+					     start, end, DRM_MM_INSERT_BEST);
+}
+
 int i915_gem_stolen_insert_node(struct drm_i915_private *dev_priv,
 				struct drm_mm_node *node, u64 size,
 				unsigned alignment)
@@ -621,7 +638,11 @@ i915_gem_object_create_stolen(struct drm_i915_private *dev_priv, u32 size)
 	if (!stolen)
 		return NULL;
 
-	ret = i915_gem_stolen_insert_node(dev_priv, stolen, size, 4096);
+	ret = __i915_gem_stolen_insert_node(dev_priv, stolen, size, 4096,
+					    0, U64_MAX,
+					    size < I915_STOLEN_SMALL_SIZE ?
+					    DRM_MM_INSERT_HIGH :
+					    DRM_MM_INSERT_BEST);
 	if (ret) {
 		kfree(stolen);
 		return NULL;
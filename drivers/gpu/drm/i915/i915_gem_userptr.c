@@ -51,6 +51,30 @@ struct i915_mmu_notifier {
 	struct mmu_notifier mn;
 	struct rb_root_cached objects;
 	struct workqueue_struct *wq;
+
+	/* Cache of pinned user pages, shared by all userptr on this mm */
+	struct rb_root_cached ranges;
+	struct list_head ranges_lru;
+	unsigned long ranges_pages;
+	unsigned int invalidate_seq;
+	unsigned int invalidate_active;
+};
+
+/*
+ * Clients often create and destroy userptr objects over the same host
+ * buffers again and again. Rather than pin the pages afresh each time with
+ * get_user_pages(), we keep a reference to the last pinned ranges of each mm
+ * so that a new object lying within one of them can borrow its pages
+ * directly. The ranges are dropped as soon as the mmu_notifier reports any
+ * change to the mapping, in the same way as we cancel the objects.
+ */
+#define I915_USERPTR_CACHE_PAGES (SZ_64M >> PAGE_SHIFT)
+
+struct i915_mmu_range {
+	struct interval_tree_node it;
+	struct list_head link;
+	unsigned long num_pages;
+	struct page *pages[];
 };
 
 struct i915_mmu_object {
@@ -112,6 +136,30 @@ static void del_object(struct i915_mmu_object *mo)
 	mo->attached = false;
 }
 
+static void free_range(struct i915_mmu_range *r)
+{
+	release_pages(r->pages, r->num_pages, 0);
+	kvfree(r);
+}
+
+static void del_range(struct i915_mmu_notifier *mn, struct i915_mmu_range *r,
+		      struct list_head *freed)
+{
+	lockdep_assert_held(&mn->lock);
+
+	interval_tree_remove(&r->it, &mn->ranges);
+	mn->ranges_pages -= r->num_pages;
+	list_move(&r->link, freed);
+}
+
+static void free_ranges(struct list_head *freed)
+{
+	struct i915_mmu_range *r, *rn;
+
+	list_for_each_entry_safe(r, rn, freed, link)
+		free_range(r);
+}
+
 static void i915_gem_userptr_mn_invalidate_range_start(struct mmu_notifier *_mn,
 						       struct mm_struct *mm,
 						       unsigned long start,
@@ -122,14 +170,35 @@ static void i915_gem_userptr_mn_invalidate_range_start(struct mmu_notifier *_mn,
 	struct i915_mmu_object *mo;
 	struct interval_tree_node *it;
 	LIST_HEAD(cancelled);
-
-	if (RB_EMPTY_ROOT(&mn->objects.rb_root))
-		return;
+	LIST_HEAD(freed);
 
 	/* interval ranges are inclusive, but invalidate range is exclusive */
 	end--;
 
 	spin_lock(&mn->lock);
+
+	/*
+	 * Prevent any pages pinned concurrently with this invalidation from
+	 * being added to the cache, see userptr_cache_insert().
+	 */
+	mn->invalidate_seq++;
+	mn->invalidate_active++;
+
+	it = interval_tree_iter_first(&mn->ranges, start, end);
+	while (it) {
+		struct i915_mmu_range *r =
+			container_of(it, struct i915_mmu_range, it);
+
+		it = interval_tree_iter_next(it, start, end);
+		del_range(mn, r, &freed);
+	}
+
+	if (RB_EMPTY_ROOT(&mn->objects.rb_root)) {
+		spin_unlock(&mn->lock);
+		free_ranges(&freed);
+		return;
+	}
+
 	it = interval_tree_iter_first(&mn->objects, start, end);
 	while (it) {
 		/* The mmu_object is released late when destroying the
@@ -152,14 +221,164 @@ static void i915_gem_userptr_mn_invalidate_range_start(struct mmu_notifier *_mn,
 		del_object(mo);
 	spin_unlock(&mn->lock);
 
+	free_ranges(&freed);
+
 	if (!list_empty(&cancelled))
 		flush_workqueue(mn->wq);
 }
 
+static void i915_gem_userptr_mn_invalidate_range_end(struct mmu_notifier *_mn,
+						     struct mm_struct *mm,
+						     unsigned long start,
+						     unsigned long end)
+{
+	struct i915_mmu_notifier *mn =
+		container_of(_mn, struct i915_mmu_notifier, mn);
+
+	spin_lock(&mn->lock);
+	GEM_BUG_ON(!mn->invalidate_active);
+	mn->invalidate_active--;
+	spin_unlock(&mn->lock);
+}
+
 static const struct mmu_notifier_ops i915_gem_userptr_notifier = {
 	.invalidate_range_start = i915_gem_userptr_mn_invalidate_range_start,
+	.invalidate_range_end = i915_gem_userptr_mn_invalidate_range_end,
 };
 
+static bool userptr_cacheable(struct drm_i915_gem_object *obj)
+{
+	return obj->userptr.mmu_object &&
+	       !obj->userptr.read_only &&
+	       obj->base.size >> PAGE_SHIFT <= I915_USERPTR_CACHE_PAGES;
+}
+
+/* Sample the invalidation sequence prior to pinning the user pages */
+static unsigned int userptr_cache_seq(struct drm_i915_gem_object *obj)
+{
+	if (!userptr_cacheable(obj))
+		return 0;
+
+	return READ_ONCE(obj->userptr.mmu_object->mn->invalidate_seq);
+}
+
+/*
+ * Look for a cached range covering the whole of the object. If found, we
+ * take our own references to its pages and mark the object as active under
+ * the same lock, so that any subsequent invalidation will cancel it.
+ */
+static bool userptr_cache_lookup(struct drm_i915_gem_object *obj,
+				 struct page **pvec)
+{
+	struct i915_mmu_object *mo = obj->userptr.mmu_object;
+	struct i915_mmu_notifier *mn;
+	struct interval_tree_node *it;
+	bool found = false;
+
+	if (!userptr_cacheable(obj))
+		return false;
+
+	mn = mo->mn;
+	spin_lock(&mn->lock);
+	if (work_pending(&mo->work))
+		goto out;
+
+	it = interval_tree_iter_first(&mn->ranges, mo->it.start, mo->it.last);
+	while (it) {
+		struct i915_mmu_range *r =
+			container_of(it, struct i915_mmu_range, it);
+
+		if (r->it.start <= mo->it.start && r->it.last >= mo->it.last) {
+			const unsigned long npages =
+				obj->base.size >> PAGE_SHIFT;
+			struct page **pages =
+				r->pages +
+				((mo->it.start - r->it.start) >> PAGE_SHIFT);
+			unsigned long n;
+
+			for (n = 0; n < npages; n++) {
+				pvec[n] = pages[n];
+				get_page(pvec[n]);
+			}
+
+			list_move(&r->link, &mn->ranges_lru);
+			add_object(mo);
+			found = true;
+			break;
+		}
+
+		it = interval_tree_iter_next(it, mo->it.start, mo->it.last);
+	}
+out:
+	spin_unlock(&mn->lock);
+
+	return found;
+}
+
+/*
+ * Remember the freshly pinned pages of the object for reuse, unless the
+ * mapping may have changed since we sampled @seq before pinning them.
+ */
+static void userptr_cache_insert(struct drm_i915_gem_object *obj,
+				 struct page **pvec, unsigned int seq)
+{
+	struct i915_mmu_object *mo = obj->userptr.mmu_object;
+	const unsigned long npages = obj->base.size >> PAGE_SHIFT;
+	struct i915_mmu_notifier *mn;
+	struct interval_tree_node *it;
+	struct i915_mmu_range *r;
+	unsigned long n;
+	LIST_HEAD(freed);
+
+	if (!userptr_cacheable(obj))
+		return;
+
+	r = kvmalloc(sizeof(*r) + npages * sizeof(*r->pages),
+		     GFP_KERNEL | __GFP_NORETRY | __GFP_NOWARN);
+	if (!r)
+		return;
+
+	r->it.start = mo->it.start;
+	r->it.last = mo->it.last;
+	r->num_pages = npages;
+	for (n = 0; n < npages; n++) {
+		r->pages[n] = pvec[n];
+		get_page(r->pages[n]);
+	}
+
+	mn = mo->mn;
+	spin_lock(&mn->lock);
+	if (mn->invalidate_seq != seq || mn->invalidate_active) {
+		list_add(&r->link, &freed);
+		goto out;
+	}
+
+	/* The new range supersedes any that it overlaps */
+	it = interval_tree_iter_first(&mn->ranges, r->it.start, r->it.last);
+	while (it) {
+		struct i915_mmu_range *old =
+			container_of(it, struct i915_mmu_range, it);
+
+		it = interval_tree_iter_next(it, r->it.start, r->it.last);
+		del_range(mn, old, &freed);
+	}
+
+	interval_tree_insert(&r->it, &mn->ranges);
+	list_add(&r->link, &mn->ranges_lru);
+	mn->ranges_pages += npages;
+
+	while (mn->ranges_pages > I915_USERPTR_CACHE_PAGES) {
+		struct i915_mmu_range *old =
+			list_last_entry(&mn->ranges_lru, typeof(*old), link);
+
+		del_range(mn, old, &freed);
+	}
+out:
+	spin_unlock(&mn->lock);
+
+	free_ranges(&freed);
+}
+
 static struct i915_mmu_notifier *
 i915_mmu_notifier_create(struct mm_struct *mm)
 {
@@ -173,6 +392,11 @@ i915_mmu_notifier_create(struct mm_struct *mm)
 	spin_lock_init(&mn->lock);
 	mn->mn.ops = &i915_gem_userptr_notifier;
 	mn->objects = RB_ROOT_CACHED;
+	mn->ranges = RB_ROOT_CACHED;
+	INIT_LIST_HEAD(&mn->ranges_lru);
+	mn->ranges_pages = 0;
+	mn->invalidate_seq = 0;
+	mn->invalidate_active = 0;
 	mn->wq = alloc_workqueue("i915-userptr-release", WQ_UNBOUND, 0);
 	if (mn->wq == NULL) {
 		kfree(mn);
@@ -269,6 +493,7 @@ i915_mmu_notifier_free(struct i915_mmu_notifier *mn,
 
 	mmu_notifier_unregister(&mn->mn, mm);
 	destroy_workqueue(mn->wq);
+	free_ranges(&mn->ranges_lru);
 	kfree(mn);
 }
 
@@ -298,6 +523,27 @@ i915_mmu_notifier_free(struct i915_mmu_notifier *mn,
 {
 }
 
+static bool userptr_cacheable(struct drm_i915_gem_object *obj)
+{
+	return false;
+}
+
+static unsigned int userptr_cache_seq(struct drm_i915_gem_object *obj)
+{
+	return 0;
+}
+
+static bool userptr_cache_lookup(struct drm_i915_gem_object *obj,
+				 struct page **pvec)
+{
+	return false;
+}
+
+static void userptr_cache_insert(struct drm_i915_gem_object *obj,
+				 struct page **pvec, unsigned int seq)
+{
+}
+
 #endif
 
 static struct i915_mm_struct *
@@ -501,6 +747,7 @@ __i915_gem_userptr_get_pages_worker(struct work_struct *_work)
 	struct get_pages_work *work = container_of(_work, typeof(*work), work);
 	struct drm_i915_gem_object *obj = work->obj;
 	const int npages = obj->base.size >> PAGE_SHIFT;
+	unsigned int seq = userptr_cache_seq(obj);
 	struct page **pvec;
 	int pinned, ret;
 
@@ -542,6 +789,7 @@ __i915_gem_userptr_get_pages_worker(struct work_struct *_work)
 		if (pinned == npages) {
 			pages = __i915_gem_userptr_set_pages(obj, pvec, npages);
 			if (!IS_ERR(pages)) {
+				userptr_cache_insert(obj, pvec, seq);
 				__i915_gem_object_set_pages(obj, pages);
 				pinned = 0;
 				pages = NULL;
@@ -610,6 +858,7 @@ i915_gem_userptr_get_pages(struct drm_i915_gem_object *obj)
 	struct mm_struct *mm = obj->userptr.mm->mm;
 	struct page **pvec;
 	struct sg_table *pages;
+	unsigned int seq;
 	bool active;
 	int pinned;
 
@@ -641,18 +890,30 @@ i915_gem_userptr_get_pages(struct drm_i915_gem_object *obj)
 	pvec = NULL;
 	pinned = 0;
 
-	if (mm == current->mm) {
+	if (mm == current->mm || userptr_cacheable(obj))
 		pvec = kvmalloc_array(num_pages, sizeof(struct page *),
 				      GFP_KERNEL |
 				      __GFP_NORETRY |
 				      __GFP_NOWARN);
-		if (pvec) /* defer to worker if malloc fails */
-			pinned = __get_user_pages_fast(obj->userptr.ptr,
-						       num_pages,
-						       !obj->userptr.read_only,
-						       pvec);
+
+	/* Borrow the pages of an earlier userptr over the same range? */
+	if (pvec && userptr_cache_lookup(obj, pvec)) {
+		pages = __i915_gem_userptr_set_pages(obj, pvec, num_pages);
+		if (IS_ERR(pages)) {
+			__i915_gem_userptr_set_active(obj, false);
+			release_pages(pvec, num_pages, 0);
+		}
+		kvfree(pvec);
+		return pages;
 	}
 
+	seq = userptr_cache_seq(obj);
+	if (pvec && mm == current->mm) /* defer to worker if malloc fails */
+		pinned = __get_user_pages_fast(obj->userptr.ptr,
+					       num_pages,
+					       !obj->userptr.read_only,
+					       pvec);
+
 	active = false;
 	if (pinned < 0) {
 		pages = ERR_PTR(pinned);
@@ -663,6 +924,8 @@ i915_gem_userptr_get_pages(struct drm_i915_gem_object *obj)
 	} else {
 		pages = __i915_gem_userptr_set_pages(obj, pvec, num_pages);
 		active = !IS_ERR(pages);
+		if (active)
+			userptr_cache_insert(obj, pvec, seq);
 	}
 	if (active)
 		__i915_gem_userptr_set_active(obj, true);
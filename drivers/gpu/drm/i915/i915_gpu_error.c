@@ -31,6 +31,7 @@
 #include <linux/stop_machine.h>
 #include <linux/zlib.h>
 #include "i915_drv.h"
+#include "intel_drv.h"
 
 static const char *engine_str(int engine)
 {
@@ -839,6 +840,28 @@ static void i915_error_object_free(struct drm_i915_error_object *obj)
 	kfree(obj);
 }
 
+/*
+ * Buffers that userspace can make arbitrarily large are not copied under
+ * stop_machine().  Their pages are kept pinned instead, and are read once
+ * the machine runs again, see i915_error_capture_work().
+ */
+struct i915_error_deferred {
+	struct list_head link;
+	struct drm_i915_error_object **dst;
+	struct drm_i915_gem_object *obj;
+	u64 gtt_offset;
+	u64 gtt_size;
+	u64 size;
+};
+
+static void i915_error_deferred_release(struct i915_error_deferred *d)
+{
+	list_del(&d->link);
+	i915_gem_object_unpin_pages(d->obj);
+	i915_gem_object_put(d->obj);
+	kfree(d);
+}
+
 static __always_inline void free_param(const char *type, void *x)
 {
 	if (!__builtin_strcmp(type, "char *"))
@@ -849,8 +872,12 @@ void __i915_gpu_state_free(struct kref *error_ref)
 {
 	struct i915_gpu_state *error =
 		container_of(error_ref, typeof(*error), ref);
+	struct i915_error_deferred *d, *dn;
 	long i, j;
 
+	list_for_each_entry_safe(d, dn, &error->deferred, link)
+		i915_error_deferred_release(d);
+
 	for (i = 0; i < ARRAY_SIZE(error->engine); i++) {
 		struct drm_i915_error_engine *ee = &error->engine[i];
 
@@ -888,29 +915,32 @@ void __i915_gpu_state_free(struct kref *error_ref)
 }
 
 static struct drm_i915_error_object *
-i915_error_object_create(struct drm_i915_private *i915,
-			 struct i915_vma *vma)
+__i915_error_object_create(struct drm_i915_private *dev_priv,
+			   struct sg_table *pages,
+			   u64 gtt_offset, u64 gtt_size, u64 size,
+			   bool can_sleep)
 {
-	struct i915_ggtt *ggtt = &i915->ggtt;
+	struct i915_ggtt *ggtt = &dev_priv->ggtt;
 	const u64 slot = ggtt->error_capture.start;
 	struct drm_i915_error_object *dst;
 	struct compress compress;
-	unsigned long num_pages;
+	unsigned long num_pages, max_pages, count;
 	struct sgt_iter iter;
 	dma_addr_t dma;
 
-	if (!vma)
-		return NULL;
+	num_pages = size >> PAGE_SHIFT;
+	max_pages = i915.error_capture_max_kb >> (PAGE_SHIFT - 10);
+	if (max_pages && num_pages > max_pages)
+		num_pages = max_pages;
 
-	num_pages = min_t(u64, vma->size, vma->obj->base.size) >> PAGE_SHIFT;
-	num_pages = DIV_ROUND_UP(10 * num_pages, 8); /* worstcase zlib growth */
-	dst = kmalloc(sizeof(*dst) + num_pages * sizeof(u32 *),
+	count = DIV_ROUND_UP(10 * num_pages, 8); /* worstcase zlib growth */
+	dst = kmalloc(sizeof(*dst) + count * sizeof(u32 *),
 		      GFP_ATOMIC | __GFP_NOWARN);
 	if (!dst)
 		return NULL;
 
-	dst->gtt_offset = vma->node.start;
-	dst->gtt_size = vma->node.size;
+	dst->gtt_offset = gtt_offset;
+	dst->gtt_size = gtt_size;
 	dst->page_count = 0;
 	dst->unused = 0;
 
@@ -919,19 +949,32 @@ i915_error_object_create(struct drm_i915_private *i915,
 		return NULL;
 	}
 
-	for_each_sgt_dma(dma, iter, vma->pages) {
+	count = 0;
+	for_each_sgt_dma(dma, iter, pages) {
 		void __iomem *s;
 		int ret;
 
+		if (count++ == num_pages)
+			break;
+
+		/*
+		 * Keep a capture running under stop_machine() from using
+		 * the slot in between.
+		 */
+		preempt_disable();
 		ggtt->base.insert_page(&ggtt->base, dma, slot,
 				       I915_CACHE_NONE, 0);
 
 		s = io_mapping_map_atomic_wc(&ggtt->mappable, slot);
 		ret = compress_page(&compress, (void  __force *)s, dst);
 		io_mapping_unmap_atomic(s);
+		preempt_enable();
 
 		if (ret)
 			goto unwind;
+
+		if (can_sleep)
+			cond_resched();
 	}
 	goto out;
 
@@ -947,6 +990,81 @@ i915_error_object_create(struct drm_i915_private *i915,
 	return dst;
 }
 
+static struct drm_i915_error_object *
+i915_error_object_create(struct drm_i915_private *i915,
+			 struct i915_vma *vma)
+{
+	if (!vma)
+		return NULL;
+
+	return __i915_error_object_create(i915, vma->pages,
+					  vma->node.start, vma->node.size,
+					  min_t(u64, vma->size,
+						vma->obj->base.size),
+					  false);
+}
+
+/*
+ * Record @vma to be copied into *@dst by i915_error_capture_deferred().
+ * Falls back to copying it right away if its pages can't be kept.
+ */
+static void i915_error_object_defer(struct i915_gpu_state *error,
+				    struct i915_vma *vma,
+				    struct drm_i915_error_object **dst)
+{
+	struct drm_i915_gem_object *obj;
+	struct i915_error_deferred *d;
+
+	*dst = NULL;
+	if (!vma)
+		return;
+
+	/* Only a normal view maps the pages of the object as they are */
+	obj = vma->obj;
+	if (vma->pages != obj->mm.pages)
+		goto copy;
+
+	d = kmalloc(sizeof(*d), GFP_ATOMIC | __GFP_NOWARN);
+	if (!d)
+		goto copy;
+
+	if (!atomic_inc_not_zero(&obj->mm.pages_pin_count)) {
+		kfree(d);
+		goto copy;
+	}
+
+	d->dst = dst;
+	d->obj = i915_gem_object_get(obj);
+	d->gtt_offset = vma->node.start;
+	d->gtt_size = vma->node.size;
+	d->size = min_t(u64, vma->size, obj->base.size);
+	list_add_tail(&d->link, &error->deferred);
+	return;
+
+copy:
+	*dst = i915_error_object_create(error->i915, vma);
+}
+
+static void i915_error_capture_deferred(struct i915_gpu_state *error)
+{
+	struct i915_gpu_error *gpu_error = &error->i915->gpu_error;
+	struct i915_error_deferred *d, *dn;
+
+	if (list_empty(&error->deferred))
+		return;
+
+	mutex_lock(&gpu_error->capture_lock);
+	list_for_each_entry_safe(d, dn, &error->deferred, link) {
+		*d->dst = __i915_error_object_create(error->i915,
+						     d->obj->mm.pages,
+						     d->gtt_offset,
+						     d->gtt_size,
+						     d->size, true);
+		i915_error_deferred_release(d);
+	}
+	mutex_unlock(&gpu_error->capture_lock);
+}
+
 /* The error capture is special as tries to run underneath the normal
  * locking rules - so we use the raw version of the i915_gem_active lookup.
  */
@@ -1381,7 +1499,8 @@ static void record_context(struct drm_i915_error_context *e,
 	e->active = atomic_read(&ctx->active_count);
 }
 
-static void request_record_user_bo(struct drm_i915_gem_request *request,
+static void request_record_user_bo(struct i915_gpu_state *error,
+				   struct drm_i915_gem_request *request,
 				   struct drm_i915_error_engine *ee)
 {
 	struct i915_gem_capture_list *c;
@@ -1399,12 +1518,8 @@ static void request_record_user_bo(struct drm_i915_gem_request *request,
 		return;
 
 	count = 0;
-	for (c = request->capture_list; c; c = c->next) {
-		bo[count] = i915_error_object_create(request->i915, c->vma);
-		if (!bo[count])
-			break;
-		count++;
-	}
+	for (c = request->capture_list; c; c = c->next)
+		i915_error_object_defer(error, c->vma, &bo[count++]);
 
 	ee->user_bo = bo;
 	ee->user_bo_count = count;
@@ -1448,15 +1563,14 @@ static void i915_gem_record_rings(struct drm_i915_private *dev_priv,
 			 * as the simplest method to avoid being overwritten
 			 * by userspace.
 			 */
-			ee->batchbuffer =
-				i915_error_object_create(dev_priv,
-							 request->batch);
+			i915_error_object_defer(error, request->batch,
+						&ee->batchbuffer);
 
 			if (HAS_BROKEN_CS_TLB(dev_priv))
 				ee->wa_batchbuffer =
 					i915_error_object_create(dev_priv,
 								 engine->scratch);
-			request_record_user_bo(request, ee);
+			request_record_user_bo(error, request, ee);
 
 			ee->ctx =
 				i915_error_object_create(dev_priv,
@@ -1736,8 +1850,8 @@ static int capture(void *data)
 
 #define DAY_AS_SECONDS(x) (24 * 60 * 60 * (x))
 
-struct i915_gpu_state *
-i915_capture_gpu_state(struct drm_i915_private *i915)
+static struct i915_gpu_state *
+__i915_capture_gpu_state(struct drm_i915_private *i915)
 {
 	struct i915_gpu_state *error;
 
@@ -1747,12 +1861,62 @@ i915_capture_gpu_state(struct drm_i915_private *i915)
 
 	kref_init(&error->ref);
 	error->i915 = i915;
+	INIT_LIST_HEAD(&error->deferred);
 
 	stop_machine(capture, error, NULL);
 
 	return error;
 }
 
+struct i915_gpu_state *
+i915_capture_gpu_state(struct drm_i915_private *i915)
+{
+	struct i915_gpu_state *error;
+
+	error = __i915_capture_gpu_state(i915);
+	if (error)
+		i915_error_capture_deferred(error);
+
+	return error;
+}
+
+static void i915_error_capture_work(struct work_struct *work)
+{
+	struct drm_i915_private *dev_priv =
+		container_of(work, typeof(*dev_priv), gpu_error.capture_work);
+	struct i915_gpu_state *error = READ_ONCE(dev_priv->gpu_error.pending_error);
+	static bool warned;
+
+	if (!error)
+		return;
+
+	intel_runtime_pm_get(dev_priv);
+	i915_error_capture_deferred(error);
+	intel_runtime_pm_put(dev_priv);
+
+	spin_lock_irq(&dev_priv->gpu_error.lock);
+	dev_priv->gpu_error.pending_error = NULL;
+	dev_priv->gpu_error.first_error = error;
+	spin_unlock_irq(&dev_priv->gpu_error.lock);
+
+	if (!warned &&
+	    ktime_get_real_seconds() - DRIVER_TIMESTAMP < DAY_AS_SECONDS(180)) {
+		DRM_INFO("GPU hangs can indicate a bug anywhere in the entire gfx stack, including userspace.\n");
+		DRM_INFO("Please file a _new_ bug report on bugs.freedesktop.org against DRI -> DRM/Intel\n");
+		DRM_INFO("drm/i915 developers can then reassign to the right component if it's not a kernel issue.\n");
+		DRM_INFO("The gpu crash dump is required to analyze gpu hangs, so please always attach it.\n");
+		DRM_INFO("GPU crash dump saved to /sys/class/drm/card%d/error\n",
+			 dev_priv->drm.primary->index);
+		warned = true;
+	}
+}
+
+void i915_gpu_error_init(struct drm_i915_private *i915)
+{
+	INIT_WORK(&i915->gpu_error.capture_work, i915_error_capture_work);
+	mutex_init(&i915->gpu_error.capture_lock);
+}
+
 /**
  * i915_capture_error_state - capture an error record for later analysis
  * @dev: drm device
@@ -1766,17 +1930,17 @@ void i915_capture_error_state(struct drm_i915_private *dev_priv,
 			      u32 engine_mask,
 			      const char *error_msg)
 {
-	static bool warned;
 	struct i915_gpu_state *error;
 	unsigned long flags;
 
 	if (!i915.error_capture)
 		return;
 
-	if (READ_ONCE(dev_priv->gpu_error.first_error))
+	if (READ_ONCE(dev_priv->gpu_error.first_error) ||
+	    READ_ONCE(dev_priv->gpu_error.pending_error))
 		return;
 
-	error = i915_capture_gpu_state(dev_priv);
+	error = __i915_capture_gpu_state(dev_priv);
 	if (!error) {
 		DRM_DEBUG_DRIVER("out of memory, not capturing error state\n");
 		return;
@@ -1787,8 +1951,9 @@ void i915_capture_error_state(struct drm_i915_private *dev_priv,
 
 	if (!error->simulated) {
 		spin_lock_irqsave(&dev_priv->gpu_error.lock, flags);
-		if (!dev_priv->gpu_error.first_error) {
-			dev_priv->gpu_error.first_error = error;
+		if (!dev_priv->gpu_error.first_error &&
+		    !dev_priv->gpu_error.pending_error) {
+			dev_priv->gpu_error.pending_error = error;
 			error = NULL;
 		}
 		spin_unlock_irqrestore(&dev_priv->gpu_error.lock, flags);
@@ -1799,16 +1964,8 @@ void i915_capture_error_state(struct drm_i915_private *dev_priv,
 		return;
 	}
 
-	if (!warned &&
-	    ktime_get_real_seconds() - DRIVER_TIMESTAMP < DAY_AS_SECONDS(180)) {
-		DRM_INFO("GPU hangs can indicate a bug anywhere in the entire gfx stack, including userspace.\n");
-		DRM_INFO("Please file a _new_ bug report on bugs.freedesktop.org against DRI -> DRM/Intel\n");
-		DRM_INFO("drm/i915 developers can then reassign to the right component if it's not a kernel issue.\n");
-		DRM_INFO("The gpu crash dump is required to analyze gpu hangs, so please always attach it.\n");
-		DRM_INFO("GPU crash dump saved to /sys/class/drm/card%d/error\n",
-			 dev_priv->drm.primary->index);
-		warned = true;
-	}
+	/* The reset can go ahead while the buffers are copied */
+	schedule_work(&dev_priv->gpu_error.capture_work);
 }
 
 struct i915_gpu_state *
@@ -1829,6 +1986,8 @@ void i915_reset_error_state(struct drm_i915_private *i915)
 {
 	struct i915_gpu_state *error;
 
+	flush_work(&i915->gpu_error.capture_work);
+
 	spin_lock_irq(&i915->gpu_error.lock);
 	error = i915->gpu_error.first_error;
 	i915->gpu_error.first_error = NULL;
@@ -733,6 +733,8 @@ static void i915_guc_irq_handler(unsigned long data)
 		if (!port_count(&port[1]))
 			submit = i915_guc_dequeue(engine);
 	} while (submit);
+
+	intel_engine_runtime_update(engine);
 }
 
 /*
@@ -1305,12 +1305,12 @@ static void snb_gt_irq_handler(struct drm_i915_private *dev_priv,
 static void
 gen8_cs_irq_handler(struct intel_engine_cs *engine, u32 iir, int test_shift)
 {
-	bool tasklet = false;
+	bool csb = false, tasklet = false;
 
 	if (iir & (GT_CONTEXT_SWITCH_INTERRUPT << test_shift)) {
 		if (port_count(&engine->execlist_port[0])) {
 			__set_bit(ENGINE_IRQ_EXECLIST, &engine->irq_posted);
-			tasklet = true;
+			csb = true;
 		}
 	}
 
@@ -1319,7 +1319,9 @@ gen8_cs_irq_handler(struct intel_engine_cs *engine, u32 iir, int test_shift)
 		tasklet |= i915.enable_guc_submission;
 	}
 
-	if (tasklet)
+	if (csb && !i915.enable_guc_submission)
+		intel_lrc_csb_irq(engine);
+	else if (csb || tasklet)
 		tasklet_hi_schedule(&engine->irq_tasklet);
 }
 
@@ -1703,6 +1705,10 @@ static void gen9_guc_irq_handler(struct drm_i915_private *dev_priv, u32 gt_iir)
 			 * re-triggering of the interrupt.
 			 */
 		}
+
+		/* Responses to CT commands are posted to the RECV buffer */
+		if (HAS_GUC_CT(dev_priv))
+			intel_guc_ct_event_handler(&dev_priv->guc.ct);
 	}
 }
 
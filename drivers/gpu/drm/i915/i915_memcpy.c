@@ -24,10 +24,12 @@
 
 #include <linux/kernel.h>
 #include <asm/fpu/api.h>
+#include <asm/fpu/xstate.h>
 
 #include "i915_drv.h"
 
 static DEFINE_STATIC_KEY_FALSE(has_movntdqa);
+static DEFINE_STATIC_KEY_FALSE(has_movntdqa_avx2);
 
 #ifdef CONFIG_AS_MOVNTDQA
 static void __memcpy_ntdqa(void *dst, const void *src, unsigned long len)
@@ -59,6 +61,59 @@ static void __memcpy_ntdqa(void *dst, const void *src, unsigned long len)
 
 	kernel_fpu_end();
 }
+
+#ifdef CONFIG_AS_AVX2
+/*
+ * As __memcpy_ntdqa(), but reading 32 bytes per load and 128 bytes per
+ * iteration. vmovntdqa of a ymm register requires a 32 byte aligned
+ * source, so an odd leading 16 bytes are read through xmm first; the
+ * destination may then only be 16 byte aligned, hence vmovdqu.
+ */
+static void __memcpy_ntdqa_avx2(void *dst, const void *src, unsigned long len)
+{
+	kernel_fpu_begin();
+
+	len >>= 4;
+	if ((unsigned long)src & 16) {
+		asm("vmovntdqa (%0), %%xmm0\n"
+		    "vmovdqa %%xmm0, (%1)\n"
+		    :: "r" (src), "r" (dst) : "memory");
+		src += 16;
+		dst += 16;
+		len--;
+	}
+	while (len >= 8) {
+		asm("vmovntdqa   (%0), %%ymm0\n"
+		    "vmovntdqa 32(%0), %%ymm1\n"
+		    "vmovntdqa 64(%0), %%ymm2\n"
+		    "vmovntdqa 96(%0), %%ymm3\n"
+		    "vmovdqu %%ymm0,   (%1)\n"
+		    "vmovdqu %%ymm1, 32(%1)\n"
+		    "vmovdqu %%ymm2, 64(%1)\n"
+		    "vmovdqu %%ymm3, 96(%1)\n"
+		    :: "r" (src), "r" (dst) : "memory");
+		src += 128;
+		dst += 128;
+		len -= 8;
+	}
+	while (len >= 2) {
+		asm("vmovntdqa (%0), %%ymm0\n"
+		    "vmovdqu %%ymm0, (%1)\n"
+		    :: "r" (src), "r" (dst) : "memory");
+		src += 32;
+		dst += 32;
+		len -= 2;
+	}
+	if (len) {
+		asm("vmovntdqa (%0), %%xmm0\n"
+		    "vmovdqa %%xmm0, (%1)\n"
+		    :: "r" (src), "r" (dst) : "memory");
+	}
+	asm volatile("vzeroupper");
+
+	kernel_fpu_end();
+}
+#endif
 #endif
 
 /**
@@ -85,8 +140,16 @@ bool i915_memcpy_from_wc(void *dst, const void *src, unsigned long len)
 
 #ifdef CONFIG_AS_MOVNTDQA
 	if (static_branch_likely(&has_movntdqa)) {
-		if (likely(len))
-			__memcpy_ntdqa(dst, src, len);
+		if (unlikely(!len))
+			return true;
+#ifdef CONFIG_AS_AVX2
+		/* Not worth the ymm state for less than one iteration */
+		if (static_branch_likely(&has_movntdqa_avx2) && len >= 128) {
+			__memcpy_ntdqa_avx2(dst, src, len);
+			return true;
+		}
+#endif
+		__memcpy_ntdqa(dst, src, len);
 		return true;
 	}
 #endif
@@ -98,4 +161,13 @@ void i915_memcpy_init_early(struct drm_i915_private *dev_priv)
 {
 	if (static_cpu_has(X86_FEATURE_XMM4_1))
 		static_branch_enable(&has_movntdqa);
+
+	if (static_cpu_has(X86_FEATURE_XMM4_1) &&
+	    static_cpu_has(X86_FEATURE_AVX2) &&
+	    cpu_has_xfeatures(XFEATURE_MASK_SSE | XFEATURE_MASK_YMM, NULL))
+		static_branch_enable(&has_movntdqa_avx2);
 }
+
+#if IS_ENABLED(CONFIG_DRM_I915_SELFTEST)
+#include "selftests/i915_memcpy.c"
+#endif
@@ -48,6 +48,9 @@ struct i915_params i915 __read_mostly = {
 	.force_reset_modeset_test = 0,
 	.reset = 2,
 	.error_capture = true,
+	.error_capture_max_kb = 16384,
+	.heartbeat_interval_ms = 250,
+	.heartbeat_priority = I915_PRIORITY_MAX,
 	.invert_brightness = 0,
 	.disable_display = 0,
 	.enable_cmd_parser = true,
@@ -58,6 +61,7 @@ struct i915_params i915 __read_mostly = {
 	.edp_vswing = 0,
 	.enable_guc_loading = 0,
 	.enable_guc_submission = 0,
+	.enable_guc_ct = -1,
 	.guc_log_level = -1,
 	.guc_firmware_path = NULL,
 	.huc_firmware_path = NULL,
@@ -65,6 +69,12 @@ struct i915_params i915 __read_mostly = {
 	.inject_load_failure = 0,
 	.enable_dpcd_backlight = false,
 	.enable_gvt = false,
+	.execlists_direct_submit = true,
+	.enable_preemption = true,
+	.execlists_timeslice_ms = 5,
+	.gvt_timeslice_us = 1000,
+	.gvt_lazy_ppgtt = true,
+	.gvt_prefetch = true,
 	.memtrack_debug = 1,
 };
 
@@ -129,6 +139,11 @@ MODULE_PARM_DESC(error_capture,
 	"Record the GPU state following a hang. "
 	"This information in /sys/class/drm/card<N>/error is vital for "
 	"triaging and debugging hangs.");
+
+module_param_named(error_capture_max_kb, i915.error_capture_max_kb, uint, 0600);
+MODULE_PARM_DESC(error_capture_max_kb,
+	"Maximum size of each buffer recorded following a hang, in KiB "
+	"(0=unlimited, default:16384)");
 #endif
 
 module_param_named_unsafe(enable_hangcheck, i915.enable_hangcheck, bool, 0644);
@@ -233,6 +248,11 @@ MODULE_PARM_DESC(enable_guc_submission,
 		"Enable GuC submission "
 		"(-1=auto, 0=never [default], 1=if available, 2=required)");
 
+module_param_named_unsafe(enable_guc_ct, i915.enable_guc_ct, int, 0400);
+MODULE_PARM_DESC(enable_guc_ct,
+		"Use command transport buffers to talk to the GuC "
+		"(-1=auto [default], 0=never, 1=if GuC is loaded)");
+
 module_param_named(guc_log_level, i915.guc_log_level, int, 0400);
 MODULE_PARM_DESC(guc_log_level,
 	"GuC firmware logging level (-1:disabled (default), 0-3:enabled)");
@@ -259,6 +279,42 @@ module_param_named(enable_gvt, i915.enable_gvt, bool, 0400);
 MODULE_PARM_DESC(enable_gvt,
 	"Enable support for Intel GVT-g graphics virtualization host support(default:false)");
 
+module_param_named(execlists_direct_submit, i915.execlists_direct_submit, bool, 0600);
+MODULE_PARM_DESC(execlists_direct_submit,
+	"Write the ELSP directly from the submitting context when the execlist ports are idle, instead of deferring to the tasklet (default:true)");
+
+module_param_named_unsafe(heartbeat_interval_ms, i915.heartbeat_interval_ms, uint, 0600);
+MODULE_PARM_DESC(heartbeat_interval_ms,
+	"Interval between the heartbeats sent down each busy engine, an "
+	"engine is reset after missing two of them; needs preemption "
+	"(0=use hangcheck only, default:250)");
+
+module_param_named_unsafe(heartbeat_priority, i915.heartbeat_priority, int, 0600);
+MODULE_PARM_DESC(heartbeat_priority,
+	"Priority a late heartbeat is raised to before the engine is "
+	"declared hung, work at or above it is not preempted by the beat "
+	"(default:1024, max)");
+
+module_param_named_unsafe(enable_preemption, i915.enable_preemption, bool, 0400);
+MODULE_PARM_DESC(enable_preemption,
+	"Allow higher priority requests to preempt running ones on gen9+ execlists (default:true)");
+
+module_param_named(execlists_timeslice_ms, i915.execlists_timeslice_ms, uint, 0600);
+MODULE_PARM_DESC(execlists_timeslice_ms,
+	"Timeslice between contexts of equal priority when preemption is enabled, in ms (0=disabled, default:5)");
+
+module_param_named(gvt_timeslice_us, i915.gvt_timeslice_us, uint, 0600);
+MODULE_PARM_DESC(gvt_timeslice_us,
+	"GVT-g scheduling tick, bounding how long a vGPU waits to be preempted, in us (min:100, default:1000)");
+
+module_param_named(gvt_lazy_ppgtt, i915.gvt_lazy_ppgtt, bool, 0400);
+MODULE_PARM_DESC(gvt_lazy_ppgtt,
+	"Shadow guest PPGTTs on first use and let guest page table writes go out of sync until submission (default: true)");
+
+module_param_named(gvt_prefetch, i915.gvt_prefetch, bool, 0600);
+MODULE_PARM_DESC(gvt_prefetch,
+	"Scan and shadow the next GVT-g workload of a ring while the current one runs on the GPU (default: true)");
+
 module_param_named(memtrack_debug, i915.memtrack_debug, int, 0600);
 MODULE_PARM_DESC(memtrack_debug,
 		"use Memtrack debug capability (0=never, 1=always)");
@@ -40,12 +40,15 @@
 	func(int, enable_fbc); \
 	func(int, enable_ppgtt); \
 	func(int, enable_execlists); \
+	func(unsigned int, execlists_timeslice_ms); \
+	func(unsigned int, gvt_timeslice_us); \
 	func(int, enable_psr); \
 	func(int, disable_power_well); \
 	func(int, enable_ips); \
 	func(int, invert_brightness); \
 	func(int, enable_guc_loading); \
 	func(int, enable_guc_submission); \
+	func(int, enable_guc_ct); \
 	func(int, guc_log_level); \
 	func(char *, guc_firmware_path); \
 	func(char *, huc_firmware_path); \
@@ -54,6 +57,9 @@
 	func(int, edp_vswing); \
 	func(int, reset); \
 	func(unsigned int, inject_load_failure); \
+	func(unsigned int, error_capture_max_kb); \
+	func(unsigned int, heartbeat_interval_ms); \
+	func(int, heartbeat_priority); \
 	/* leave bools at the end to not create holes */ \
 	func(bool, alpha_support); \
 	func(bool, enable_cmd_parser); \
@@ -69,6 +75,10 @@
 	func(bool, enable_dp_mst); \
 	func(bool, enable_dpcd_backlight); \
 	func(bool, enable_gvt); \
+	func(bool, gvt_lazy_ppgtt); \
+	func(bool, gvt_prefetch); \
+	func(bool, execlists_direct_submit); \
+	func(bool, enable_preemption); \
 	func(int, memtrack_debug)
 
 #define MEMBER(T, member) T member
@@ -340,6 +340,7 @@ static struct i915_oa_format gen8_plus_oa_formats[I915_OA_FORMAT_MAX] = {
  * @oa_format: An OA unit HW report format
  * @oa_periodic: Whether to enable periodic OA unit sampling
  * @oa_period_exponent: The OA unit sampling period is derived from this
+ * @oa_buffer_mmap: Export the OA buffer via mmap() instead of read()
  *
  * As read_properties_unlocked() enumerates and validates the properties given
  * to open a stream of metrics the configuration is built up in the structure
@@ -356,6 +357,7 @@ struct perf_open_properties {
 	int oa_format;
 	bool oa_periodic;
 	int oa_period_exponent;
+	bool oa_buffer_mmap;
 };
 
 static void free_oa_config(struct drm_i915_private *dev_priv,
@@ -418,6 +420,17 @@ static u32 gen7_oa_hw_tail_read(struct drm_i915_private *dev_priv)
 	return oastatus1 & GEN7_OASTATUS1_TAIL_MASK;
 }
 
+static void gen8_oa_hw_head_write(struct drm_i915_private *dev_priv, u32 head)
+{
+	I915_WRITE(GEN8_OAHEADPTR, head & GEN8_OAHEADPTR_MASK);
+}
+
+static void gen7_oa_hw_head_write(struct drm_i915_private *dev_priv, u32 head)
+{
+	I915_WRITE(GEN7_OASTATUS2,
+		   (head & GEN7_OASTATUS2_HEAD_MASK) | OA_MEM_SELECT_GGTT);
+}
+
 /**
  * oa_buffer_check_unlocked - check for data and update tail ptr state
  * @dev_priv: i915 device instance
@@ -824,7 +837,7 @@ static int gen8_append_oa_reports(struct i915_perf_stream *stream,
 		 */
 		head += gtt_offset;
 
-		I915_WRITE(GEN8_OAHEADPTR, head & GEN8_OAHEADPTR_MASK);
+		dev_priv->perf.oa.ops.oa_hw_head_write(dev_priv, head);
 		dev_priv->perf.oa.oa_buffer.head = head;
 
 		spin_unlock_irqrestore(&dev_priv->perf.oa.oa_buffer.ptr_lock, flags);
@@ -1037,9 +1050,7 @@ static int gen7_append_oa_reports(struct i915_perf_stream *stream,
 		 */
 		head += gtt_offset;
 
-		I915_WRITE(GEN7_OASTATUS2,
-			   ((head & GEN7_OASTATUS2_HEAD_MASK) |
-			    OA_MEM_SELECT_GGTT));
+		dev_priv->perf.oa.ops.oa_hw_head_write(dev_priv, head);
 		dev_priv->perf.oa.oa_buffer.head = head;
 
 		spin_unlock_irqrestore(&dev_priv->perf.oa.oa_buffer.ptr_lock, flags);
@@ -1199,6 +1210,52 @@ static int i915_oa_read(struct i915_perf_stream *stream,
 	return dev_priv->perf.oa.ops.read(stream, buf, count, offset);
 }
 
+/**
+ * i915_oa_mmap - export the OA buffer to userspace
+ * @stream: An i915-perf stream opened with `DRM_I915_PERF_PROP_OA_BUFFER_MMAP`
+ * @vma: the userspace mapping being set up
+ *
+ * Maps the status page followed by every page of the OA buffer read-only
+ * into @vma. The pages stay pinned until the stream is destroyed, which
+ * can't happen before the mapping is gone since it holds a file reference.
+ *
+ * Returns: zero on success or a negative error code
+ */
+static int i915_oa_mmap(struct i915_perf_stream *stream,
+			struct vm_area_struct *vma)
+{
+	struct drm_i915_private *dev_priv = stream->dev_priv;
+	struct drm_i915_gem_object *obj = dev_priv->perf.oa.oa_buffer.vma->obj;
+	unsigned long addr = vma->vm_start;
+	unsigned int n;
+	int ret;
+
+	if (vma->vm_pgoff ||
+	    vma->vm_end - vma->vm_start != PAGE_SIZE + OA_BUFFER_SIZE)
+		return -EINVAL;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EACCES;
+
+	vma->vm_flags &= ~VM_MAYWRITE;
+	vma->vm_flags |= VM_DONTEXPAND | VM_DONTDUMP;
+
+	ret = vm_insert_page(vma, addr,
+			     virt_to_page(dev_priv->perf.oa.oa_buffer.status));
+	if (ret)
+		return ret;
+
+	for (n = 0; n < OA_BUFFER_SIZE >> PAGE_SHIFT; n++) {
+		addr += PAGE_SIZE;
+		ret = vm_insert_page(vma, addr,
+				     i915_gem_object_get_page(obj, n));
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
 /**
  * oa_get_render_ctx_id - determine and hold ctx hw id
  * @stream: An i915-perf stream opened for OA metrics
@@ -1318,6 +1375,29 @@ static void i915_oa_stream_destroy(struct i915_perf_stream *stream)
 		DRM_NOTE("%d spurious OA report notices suppressed due to ratelimiting\n",
 			 dev_priv->perf.oa.spurious_report_rs.missed);
 	}
+
+	free_page((unsigned long)dev_priv->perf.oa.oa_buffer.status);
+	dev_priv->perf.oa.oa_buffer.status = NULL;
+}
+
+/*
+ * Restart the tail published to an mmap()ed OA buffer, called with the
+ * ptr_lock held whenever the OA buffer is (re)initialized.
+ */
+static void oa_buffer_status_reset(struct drm_i915_private *dev_priv)
+{
+	struct drm_i915_perf_oa_buffer_status *status =
+		dev_priv->perf.oa.oa_buffer.status;
+
+	if (!status)
+		return;
+
+	WRITE_ONCE(status->seqno, status->seqno + 1);
+	smp_wmb();
+	status->tail = 0;
+	status->resets++;
+	smp_wmb();
+	WRITE_ONCE(status->seqno, status->seqno + 1);
 }
 
 static void gen7_init_oa_buffer(struct drm_i915_private *dev_priv)
@@ -1341,6 +1421,8 @@ static void gen7_init_oa_buffer(struct drm_i915_private *dev_priv)
 	dev_priv->perf.oa.oa_buffer.tails[0].offset = INVALID_TAIL_PTR;
 	dev_priv->perf.oa.oa_buffer.tails[1].offset = INVALID_TAIL_PTR;
 
+	oa_buffer_status_reset(dev_priv);
+
 	spin_unlock_irqrestore(&dev_priv->perf.oa.oa_buffer.ptr_lock, flags);
 
 	/* On Haswell we have to track which OASTATUS1 flags we've
@@ -1404,6 +1486,8 @@ static void gen8_init_oa_buffer(struct drm_i915_private *dev_priv)
 	 */
 	dev_priv->perf.oa.oa_buffer.last_ctx_id = INVALID_CTX_ID;
 
+	oa_buffer_status_reset(dev_priv);
+
 	spin_unlock_irqrestore(&dev_priv->perf.oa.oa_buffer.ptr_lock, flags);
 
 	/*
@@ -2001,6 +2085,14 @@ static const struct i915_perf_stream_ops i915_oa_stream_ops = {
 	.read = i915_oa_read,
 };
 
+static const struct i915_perf_stream_ops i915_oa_mmap_stream_ops = {
+	.destroy = i915_oa_stream_destroy,
+	.enable = i915_oa_stream_enable,
+	.disable = i915_oa_stream_disable,
+	.poll_wait = i915_oa_poll_wait,
+	.mmap = i915_oa_mmap,
+};
+
 /**
  * i915_oa_stream_init - validate combined props for OA stream and init
  * @stream: An i915 perf stream
@@ -2098,10 +2190,35 @@ static int i915_oa_stream_init(struct i915_perf_stream *stream,
 	if (dev_priv->perf.oa.periodic)
 		dev_priv->perf.oa.period_exponent = props->oa_period_exponent;
 
+	if (props->oa_buffer_mmap) {
+		/*
+		 * The raw OA buffer carries the reports of every context, so
+		 * we can only hand it out when we wouldn't filter anything.
+		 */
+		if (stream->ctx) {
+			DRM_DEBUG("OA buffer mmap requires a system-wide stream\n");
+			return -EINVAL;
+		}
+
+		/* Only the periodic hrtimer publishes new reports */
+		if (!props->oa_periodic) {
+			DRM_DEBUG("OA buffer mmap requires periodic sampling\n");
+			return -EINVAL;
+		}
+
+		dev_priv->perf.oa.oa_buffer.status =
+			(void *)get_zeroed_page(GFP_KERNEL);
+		if (!dev_priv->perf.oa.oa_buffer.status)
+			return -ENOMEM;
+
+		dev_priv->perf.oa.oa_buffer.status->size = OA_BUFFER_SIZE;
+		dev_priv->perf.oa.oa_buffer.status->report_size = format_size;
+	}
+
 	if (stream->ctx) {
 		ret = oa_get_render_ctx_id(stream);
 		if (ret)
-			return ret;
+			goto err_status;
 	}
 
 	ret = get_oa_config(dev_priv, props->metrics_set, &stream->oa_config);
@@ -2132,7 +2249,10 @@ static int i915_oa_stream_init(struct i915_perf_stream *stream,
 	if (ret)
 		goto err_enable;
 
-	stream->ops = &i915_oa_stream_ops;
+	if (dev_priv->perf.oa.oa_buffer.status)
+		stream->ops = &i915_oa_mmap_stream_ops;
+	else
+		stream->ops = &i915_oa_stream_ops;
 
 	/* Lock device for exclusive_stream access late because
 	 * enable_metric_set() might lock as well on gen8+.
@@ -2163,6 +2283,10 @@ static int i915_oa_stream_init(struct i915_perf_stream *stream,
 	if (stream->ctx)
 		oa_put_render_ctx_id(stream);
 
+err_status:
+	free_page((unsigned long)dev_priv->perf.oa.oa_buffer.status);
+	dev_priv->perf.oa.oa_buffer.status = NULL;
+
 	return ret;
 }
 
@@ -2257,6 +2381,10 @@ static ssize_t i915_perf_read(struct file *file,
 	if (!stream->enabled)
 		return -EIO;
 
+	/* Streams exported via mmap() are consumed directly by userspace */
+	if (!stream->ops->read)
+		return -EINVAL;
+
 	if (!(file->f_flags & O_NONBLOCK)) {
 		/* There's the small chance of false positives from
 		 * stream->ops->wait_unlocked.
@@ -2299,6 +2427,46 @@ static ssize_t i915_perf_read(struct file *file,
 	return ret;
 }
 
+/**
+ * oa_buffer_publish - expose newly aged reports to an mmap()ed OA buffer
+ * @dev_priv: i915 device instance
+ *
+ * Publishes the aged tail through the status page shared with userspace and
+ * immediately hands the space back to the OA unit by advancing the head.
+ * Readers of the mapping don't give us any feedback, so much like a flight
+ * recorder they are expected to keep up with the ring and use the published
+ * byte count to notice when they have been lapped.
+ */
+static void oa_buffer_publish(struct drm_i915_private *dev_priv)
+{
+	struct drm_i915_perf_oa_buffer_status *status =
+		dev_priv->perf.oa.oa_buffer.status;
+	u32 gtt_offset = i915_ggtt_offset(dev_priv->perf.oa.oa_buffer.vma);
+	unsigned long flags;
+	unsigned int aged_idx;
+	u32 head, tail;
+
+	spin_lock_irqsave(&dev_priv->perf.oa.oa_buffer.ptr_lock, flags);
+
+	head = dev_priv->perf.oa.oa_buffer.head;
+	aged_idx = dev_priv->perf.oa.oa_buffer.aged_tail_idx;
+	tail = dev_priv->perf.oa.oa_buffer.tails[aged_idx].offset;
+
+	if (tail != INVALID_TAIL_PTR && tail != head) {
+		WRITE_ONCE(status->seqno, status->seqno + 1);
+		smp_wmb();
+		status->tail = tail - gtt_offset;
+		status->total += OA_TAKEN(tail, head);
+		smp_wmb();
+		WRITE_ONCE(status->seqno, status->seqno + 1);
+
+		dev_priv->perf.oa.ops.oa_hw_head_write(dev_priv, tail);
+		dev_priv->perf.oa.oa_buffer.head = tail;
+	}
+
+	spin_unlock_irqrestore(&dev_priv->perf.oa.oa_buffer.ptr_lock, flags);
+}
+
 static enum hrtimer_restart oa_poll_check_timer_cb(struct hrtimer *hrtimer)
 {
 	struct drm_i915_private *dev_priv =
@@ -2306,6 +2474,9 @@ static enum hrtimer_restart oa_poll_check_timer_cb(struct hrtimer *hrtimer)
 			     perf.oa.poll_check_timer);
 
 	if (oa_buffer_check_unlocked(dev_priv)) {
+		if (dev_priv->perf.oa.oa_buffer.status)
+			oa_buffer_publish(dev_priv);
+
 		dev_priv->perf.oa.pollin = true;
 		wake_up(&dev_priv->perf.oa.poll_wq);
 	}
@@ -2349,6 +2520,13 @@ static unsigned int i915_perf_poll_locked(struct drm_i915_private *dev_priv,
 	if (dev_priv->perf.oa.pollin)
 		events |= POLLIN;
 
+	/*
+	 * Without a read() to clear it, report each batch of newly published
+	 * data to an mmap() stream only once.
+	 */
+	if (!stream->ops->read)
+		dev_priv->perf.oa.pollin = false;
+
 	return events;
 }
 
@@ -2529,6 +2707,31 @@ static int i915_perf_release(struct inode *inode, struct file *file)
 	return 0;
 }
 
+/**
+ * i915_perf_mmap - handles mmap() FOP for i915 perf stream FDs
+ * @file: An i915 perf stream file
+ * @vma: the userspace mapping being set up
+ *
+ * Only streams that export their buffer (see &i915_perf_stream_ops->mmap)
+ * can be mapped.
+ *
+ * Note: unlike the other fops we don't take the &drm_i915_private->perf.lock
+ * mutex since we are called with mmap_sem held, which read() acquires while
+ * holding perf.lock. The exported buffer lives as long as the stream and
+ * our file reference keeps the stream alive.
+ *
+ * Returns: zero on success or a negative error code.
+ */
+static int i915_perf_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct i915_perf_stream *stream = file->private_data;
+
+	if (!stream->ops->mmap)
+		return -ENODEV;
+
+	return stream->ops->mmap(stream, vma);
+}
+
 
 static const struct file_operations fops = {
 	.owner		= THIS_MODULE,
@@ -2536,6 +2739,7 @@ static const struct file_operations fops = {
 	.release	= i915_perf_release,
 	.poll		= i915_perf_poll,
 	.read		= i915_perf_read,
+	.mmap		= i915_perf_mmap,
 	.unlocked_ioctl	= i915_perf_ioctl,
 	/* Our ioctl have no arguments, so it's safe to use the same function
 	 * to handle 32bits compatibility.
@@ -2809,6 +3013,9 @@ static int read_properties_unlocked(struct drm_i915_private *dev_priv,
 			props->oa_periodic = true;
 			props->oa_period_exponent = value;
 			break;
+		case DRM_I915_PERF_PROP_OA_BUFFER_MMAP:
+			props->oa_buffer_mmap = value;
+			break;
 		case DRM_I915_PERF_PROP_MAX:
 			MISSING_CASE(id);
 			return -EINVAL;
@@ -3405,6 +3612,8 @@ void i915_perf_init(struct drm_i915_private *dev_priv)
 		dev_priv->perf.oa.ops.read = gen7_oa_read;
 		dev_priv->perf.oa.ops.oa_hw_tail_read =
 			gen7_oa_hw_tail_read;
+		dev_priv->perf.oa.ops.oa_hw_head_write =
+			gen7_oa_hw_head_write;
 
 		dev_priv->perf.oa.timestamp_frequency = 12500000;
 
@@ -3430,6 +3639,7 @@ void i915_perf_init(struct drm_i915_private *dev_priv)
 		dev_priv->perf.oa.ops.oa_disable = gen8_oa_disable;
 		dev_priv->perf.oa.ops.read = gen8_oa_read;
 		dev_priv->perf.oa.ops.oa_hw_tail_read = gen8_oa_hw_tail_read;
+		dev_priv->perf.oa.ops.oa_hw_head_write = gen8_oa_hw_head_write;
 
 		dev_priv->perf.oa.oa_formats = gen8_plus_oa_formats;
 
@@ -53,6 +53,26 @@ enum vgt_g2v_type {
  * VGT capabilities type
  */
 #define VGT_CAPS_FULL_48BIT_PPGTT	BIT(2)
+#define VGT_CAPS_SHARED_PAGE		BIT(3)
+
+/*
+ * Guest memory page registered through vgt_if.shared_page_gpa, in which
+ * the host emulator mirrors registers the guest polls, so that reading
+ * them doesn't trap. For each engine, indexed by the i915 engine id, the
+ * host updates the context status buffer before the status pointer,
+ * exactly like the hardware does.
+ */
+#define VGT_SHARED_PAGE_ENGINES		8
+
+struct vgt_shared_engine {
+	u32 csb_ptr;		/* RING_CONTEXT_STATUS_PTR */
+	u32 rsv;
+	u32 csb[12];		/* RING_CONTEXT_STATUS_BUF, 6 qwords */
+} __packed;
+
+struct vgt_shared_page {
+	struct vgt_shared_engine engine[VGT_SHARED_PAGE_ENGINES];
+} __packed;
 
 struct vgt_if {
 	u64 magic;		/* VGT_MAGIC */
@@ -102,7 +122,13 @@ struct vgt_if {
 	u32 execlist_context_descriptor_lo;
 	u32 execlist_context_descriptor_hi;
 
-	u32  rsv7[0x200 - 24];    /* pad to one page */
+	/* writing hi (re)registers the page, 0 unregisters it */
+	struct {
+		u32 lo;
+		u32 hi;
+	} shared_page_gpa;
+
+	u32  rsv7[0x200 - 26];    /* pad to one page */
 } __packed;
 
 #define vgtif_reg(x) \
@@ -185,6 +185,7 @@ static inline bool i915_mmio_reg_valid(i915_reg_t reg)
 #define VIDEO_DECODE_CLASS	1
 #define VIDEO_ENHANCEMENT_CLASS	2
 #define COPY_ENGINE_CLASS	3
+#define MAX_ENGINE_CLASS	3
 #define OTHER_CLASS		4
 
 /* PCI config space */
@@ -838,6 +838,96 @@ static void i915_setup_error_capture(struct device *kdev) {}
 static void i915_teardown_error_capture(struct device *kdev) {}
 #endif
 
+static const char * const engine_class_names[] = {
+	[RENDER_CLASS] = "rcs",
+	[VIDEO_DECODE_CLASS] = "vcs",
+	[VIDEO_ENHANCEMENT_CLASS] = "vecs",
+	[COPY_ENGINE_CLASS] = "bcs",
+};
+
+/* pid, comm and one " vecs=<u64>" per class comfortably fit */
+#define CLIENT_RUNTIME_LINE 160
+
+static ssize_t clients_runtime_read(struct file *filp, struct kobject *kobj,
+				    struct bin_attribute *attr, char *buf,
+				    loff_t off, size_t count)
+{
+	struct device *kdev = kobj_to_dev(kobj);
+	struct drm_i915_private *dev_priv = kdev_minor_to_i915(kdev);
+	struct drm_device *dev = &dev_priv->drm;
+	struct drm_file *file;
+	size_t size, len = 0;
+	char *data;
+	ssize_t ret;
+
+	mutex_lock(&dev->filelist_mutex);
+
+	size = CLIENT_RUNTIME_LINE;
+	list_for_each_entry(file, &dev->filelist, lhead)
+		size += CLIENT_RUNTIME_LINE;
+
+	data = kvmalloc(size, GFP_KERNEL);
+	if (!data) {
+		ret = -ENOMEM;
+		goto out_filelist;
+	}
+
+	ret = i915_mutex_lock_interruptible(dev);
+	if (ret)
+		goto out_data;
+
+	list_for_each_entry(file, &dev->filelist, lhead) {
+		struct drm_i915_file_private *file_priv = file->driver_priv;
+		u64 runtime[MAX_ENGINE_CLASS + 1];
+		struct i915_gem_context *ctx;
+		struct intel_engine_cs *engine;
+		struct task_struct *task;
+		enum intel_engine_id id;
+		unsigned int class;
+
+		memcpy(runtime, file_priv->runtime, sizeof(runtime));
+		list_for_each_entry(ctx, &dev_priv->contexts.list, link) {
+			if (ctx->file_priv != file_priv)
+				continue;
+
+			for_each_engine(engine, dev_priv, id)
+				runtime[engine->class] +=
+					intel_engine_context_runtime(engine,
+								     ctx);
+		}
+
+		rcu_read_lock();
+		task = pid_task(file->pid, PIDTYPE_PID);
+		len += scnprintf(data + len, size - len, "%d %s",
+				 pid_nr(file->pid),
+				 task ? task->comm : "<unknown>");
+		rcu_read_unlock();
+
+		for (class = 0; class < ARRAY_SIZE(runtime); class++)
+			len += scnprintf(data + len, size - len, " %s=%llu",
+					 engine_class_names[class],
+					 runtime[class]);
+		len += scnprintf(data + len, size - len, "\n");
+	}
+
+	mutex_unlock(&dev->struct_mutex);
+
+	ret = memory_read_from_buffer(buf, count, &off, data, len);
+
+out_data:
+	kvfree(data);
+out_filelist:
+	mutex_unlock(&dev->filelist_mutex);
+	return ret;
+}
+
+static const struct bin_attribute clients_runtime_attr = {
+	.attr.name = "clients_runtime",
+	.attr.mode = S_IRUGO,
+	.size = 0,
+	.read = clients_runtime_read,
+};
+
 void i915_setup_sysfs(struct drm_i915_private *dev_priv)
 {
 	struct device *kdev = dev_priv->drm.primary->kdev;
@@ -886,6 +976,13 @@ void i915_setup_sysfs(struct drm_i915_private *dev_priv)
 
 	i915_setup_error_capture(kdev);
 
+	/* Busy time is sampled from the execlist ports */
+	if (i915.enable_execlists) {
+		ret = sysfs_create_bin_file(&kdev->kobj, &clients_runtime_attr);
+		if (ret)
+			DRM_ERROR("clients runtime sysfs setup failed\n");
+	}
+
 	if (i915.memtrack_debug) {
 		/*
 		 * Create the gfx_memtrack directory for memtrack sysfs files
@@ -915,6 +1012,8 @@ void i915_teardown_sysfs(struct drm_i915_private *dev_priv)
 
 	i915_teardown_error_capture(kdev);
 
+	sysfs_remove_bin_file(&kdev->kobj, &clients_runtime_attr);
+
 	if (IS_VALLEYVIEW(dev_priv) || IS_CHERRYVIEW(dev_priv))
 		sysfs_remove_files(&kdev->kobj, vlv_attrs);
 	else
@@ -79,6 +79,54 @@ void i915_check_vgpu(struct drm_i915_private *dev_priv)
 
 	dev_priv->vgpu.active = true;
 	DRM_INFO("Virtual GPU for Intel GVT-g detected.\n");
+
+	if (dev_priv->vgpu.caps & VGT_CAPS_SHARED_PAGE) {
+		BUILD_BUG_ON(sizeof(struct vgt_shared_page) > PAGE_SIZE);
+		dev_priv->vgpu.shared_page =
+			(void *)get_zeroed_page(GFP_KERNEL);
+		i915_vgpu_register_shared_page(dev_priv);
+	}
+}
+
+/**
+ * i915_vgpu_register_shared_page - hand the shared page over to GVT-g
+ * @dev_priv: i915 device private
+ *
+ * Tell the host where the page mirroring hot registers lives. It has to be
+ * repeated whenever the host may have forgotten about it, i.e. on resume,
+ * as a device model level reset of the vGPU unregisters it.
+ */
+void i915_vgpu_register_shared_page(struct drm_i915_private *dev_priv)
+{
+	u64 gpa;
+
+	if (!dev_priv->vgpu.shared_page)
+		return;
+
+	gpa = virt_to_phys(dev_priv->vgpu.shared_page);
+	__raw_i915_write32(dev_priv, vgtif_reg(shared_page_gpa.lo),
+			   lower_32_bits(gpa));
+	__raw_i915_write32(dev_priv, vgtif_reg(shared_page_gpa.hi),
+			   upper_32_bits(gpa));
+}
+
+/**
+ * i915_vgpu_fini - release the vGPU state
+ * @dev_priv: i915 device private
+ *
+ * Unregister and free the shared page, so the host stops writing to it
+ * before the memory is reused.
+ */
+void i915_vgpu_fini(struct drm_i915_private *dev_priv)
+{
+	if (!dev_priv->vgpu.shared_page)
+		return;
+
+	__raw_i915_write32(dev_priv, vgtif_reg(shared_page_gpa.lo), 0);
+	__raw_i915_write32(dev_priv, vgtif_reg(shared_page_gpa.hi), 0);
+
+	free_page((unsigned long)dev_priv->vgpu.shared_page);
+	dev_priv->vgpu.shared_page = NULL;
 }
 
 bool intel_vgpu_has_full_48bit_ppgtt(struct drm_i915_private *dev_priv)
@@ -27,6 +27,8 @@
 #include "i915_pvinfo.h"
 
 void i915_check_vgpu(struct drm_i915_private *dev_priv);
+void i915_vgpu_register_shared_page(struct drm_i915_private *dev_priv);
+void i915_vgpu_fini(struct drm_i915_private *dev_priv);
 
 bool intel_vgpu_has_full_48bit_ppgtt(struct drm_i915_private *dev_priv);
 
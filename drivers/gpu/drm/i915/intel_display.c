@@ -48,6 +48,7 @@
 #include <drm/drm_rect.h>
 #include <linux/dma_remapping.h>
 #include <linux/reservation.h>
+#include <trace/events/frame.h>
 
 /* Primary plane formats for gen <= 3 */
 static const uint32_t i8xx_primary_formats[] = {
@@ -12355,6 +12356,51 @@ static void intel_atomic_commit_fence_wait(struct intel_atomic_state *intel_stat
 	finish_wait(&dev_priv->gpu_error.wait_queue, &wait_reset);
 }
 
+static bool intel_atomic_is_plane_update(struct drm_atomic_state *state)
+{
+	struct drm_crtc_state *new_crtc_state;
+	struct drm_crtc *crtc;
+	int i;
+
+	if (to_intel_atomic_state(state)->modeset)
+		return false;
+
+	for_each_new_crtc_in_state(state, crtc, new_crtc_state, i) {
+		if (needs_modeset(new_crtc_state) ||
+		    to_intel_crtc_state(new_crtc_state)->update_pipe)
+			return false;
+	}
+
+	return true;
+}
+
+static void intel_atomic_update_flip_stats(struct drm_atomic_state *state,
+					   const u32 *ready_vbl_count)
+{
+	struct drm_crtc_state *new_crtc_state;
+	struct drm_crtc *crtc;
+	int i;
+
+	for_each_new_crtc_in_state(state, crtc, new_crtc_state, i) {
+		struct intel_crtc *intel_crtc = to_intel_crtc(crtc);
+		u32 delta;
+
+		if (needs_modeset(new_crtc_state) || !new_crtc_state->active)
+			continue;
+
+		/*
+		 * Evading the vblank may legitimately push the update into
+		 * the next frame, anything beyond that is a frame we failed
+		 * to deliver even though the commit was ready for it.
+		 */
+		delta = drm_crtc_vblank_count(crtc) -
+			ready_vbl_count[intel_crtc->pipe];
+		if (delta > 1)
+			atomic_add(delta - 1,
+				   &intel_crtc->flip_stats.missed_vblanks);
+	}
+}
+
 static void intel_atomic_commit_tail(struct drm_atomic_state *state)
 {
 	struct drm_device *dev = state->dev;
@@ -12364,6 +12410,7 @@ static void intel_atomic_commit_tail(struct drm_atomic_state *state)
 	struct drm_crtc *crtc;
 	struct intel_crtc_state *intel_cstate;
 	u64 put_domains[I915_MAX_PIPES] = {};
+	u32 ready_vbl_count[I915_MAX_PIPES] = {};
 	unsigned crtc_vblank_mask = 0;
 	int i;
 
@@ -12371,6 +12418,10 @@ static void intel_atomic_commit_tail(struct drm_atomic_state *state)
 
 	drm_atomic_helper_wait_for_dependencies(state);
 
+	for_each_new_crtc_in_state(state, crtc, new_crtc_state, i)
+		ready_vbl_count[to_intel_crtc(crtc)->pipe] =
+			drm_crtc_vblank_count(crtc);
+
 	if (intel_state->modeset)
 		intel_display_power_get(dev_priv, POWER_DOMAIN_MODESET);
 
@@ -12455,6 +12506,9 @@ static void intel_atomic_commit_tail(struct drm_atomic_state *state)
 	/* Now enable the clocks, plane, pipe, and connectors that we set up. */
 	dev_priv->display.update_crtcs(state, &crtc_vblank_mask);
 
+	intel_atomic_update_flip_stats(state, ready_vbl_count);
+	trace_frame_stage(intel_state->frame_id, FRAME_STAGE_FLIP);
+
 	/* FIXME: We should call drm_atomic_helper_commit_hw_done() here
 	 * already, but still need the state for the delayed optimization. To
 	 * fix this:
@@ -12464,8 +12518,10 @@ static void intel_atomic_commit_tail(struct drm_atomic_state *state)
 	 * - switch over to the vblank wait helper in the core after that since
 	 *   we don't need out special handling any more.
 	 */
-	if (!state->legacy_cursor_update)
+	if (!state->legacy_cursor_update) {
 		intel_atomic_wait_for_vblanks(dev, dev_priv, crtc_vblank_mask);
+		trace_frame_stage(intel_state->frame_id, FRAME_STAGE_VBLANK);
+	}
 
 	/*
 	 * Now that the vblank has passed, we can go ahead and program the
@@ -12638,13 +12694,17 @@ static int intel_atomic_commit(struct drm_device *dev,
 	drm_atomic_state_get(state);
 	INIT_WORK(&state->commit_work, intel_atomic_commit_work);
 
+	intel_state->frame_id = frame_trace_id();
+	trace_frame_stage(intel_state->frame_id, FRAME_STAGE_COMMIT);
+
 	i915_sw_fence_commit(&intel_state->commit_ready);
-	if (nonblock)
+	if (nonblock && intel_atomic_is_plane_update(state))
+		queue_work(dev_priv->flip_wq, &state->commit_work);
+	else if (nonblock)
 		queue_work(system_unbound_wq, &state->commit_work);
 	else
 		intel_atomic_commit_tail(state);
 
-
 	return 0;
 }
 
@@ -397,6 +397,9 @@ struct intel_atomic_state {
 	/* Gen9+ only */
 	struct skl_wm_values wm_results;
 
+	/* Frame of the committing task, see <linux/frame_trace.h> */
+	u64 frame_id;
+
 	struct i915_sw_fence commit_ready;
 
 	struct llist_node freed;
@@ -835,6 +838,19 @@ struct intel_crtc {
 		int scanline_start;
 	} debug;
 
+	/*
+	 * Nonblocking plane update statistics, reported through
+	 * i915_display_info. @coalesced counts plane updates that were
+	 * overwritten by a later one before the hardware latched them,
+	 * @missed_vblanks the frames lost between a commit becoming ready
+	 * and it reaching the hardware.
+	 */
+	struct {
+		atomic_t coalesced;
+		atomic_t missed_vblanks;
+		u32 last_vbl_count;
+	} flip_stats;
+
 	/* scalers available on this crtc */
 	int num_scalers;
 };
@@ -1738,6 +1754,8 @@ void intel_power_domains_verify_state(struct drm_i915_private *dev_priv);
 void bxt_display_core_init(struct drm_i915_private *dev_priv, bool resume);
 void bxt_display_core_uninit(struct drm_i915_private *dev_priv);
 void intel_runtime_pm_enable(struct drm_i915_private *dev_priv);
+void intel_runtime_pm_suspended(struct drm_i915_private *dev_priv);
+void intel_runtime_pm_resumed(struct drm_i915_private *dev_priv, ktime_t start);
 const char *
 intel_display_power_domain_str(enum intel_display_power_domain domain);
 
@@ -393,9 +393,11 @@ void intel_engine_setup_common(struct intel_engine_cs *engine)
 {
 	engine->execlist_queue = RB_ROOT;
 	engine->execlist_first = NULL;
+	spin_lock_init(&engine->runtime.lock);
 
 	intel_engine_init_timeline(engine);
 	intel_engine_init_hangcheck(engine);
+	intel_engine_init_heartbeat(engine);
 	i915_gem_batch_pool_init(engine, &engine->batch_pool);
 
 	intel_engine_init_cmd_parser(engine);
@@ -471,17 +473,33 @@ int intel_engine_init_common(struct intel_engine_cs *engine)
 	if (IS_ERR(ring))
 		return PTR_ERR(ring);
 
+	/*
+	 * Similarly the preempt context must always be available so that
+	 * we can interrupt the engine at any time.
+	 */
+	if (engine->i915->preempt_context) {
+		ring = engine->context_pin(engine,
+					   engine->i915->preempt_context);
+		if (IS_ERR(ring)) {
+			ret = PTR_ERR(ring);
+			goto err_unpin_kernel;
+		}
+	}
+
 	ret = intel_engine_init_breadcrumbs(engine);
 	if (ret)
-		goto err_unpin;
+		goto err_unpin_preempt;
 
 	ret = i915_gem_render_state_init(engine);
 	if (ret)
-		goto err_unpin;
+		goto err_unpin_preempt;
 
 	return 0;
 
-err_unpin:
+err_unpin_preempt:
+	if (engine->i915->preempt_context)
+		engine->context_unpin(engine, engine->i915->preempt_context);
+err_unpin_kernel:
 	engine->context_unpin(engine, engine->i915->kernel_context);
 	return ret;
 }
@@ -495,6 +513,7 @@ int intel_engine_init_common(struct intel_engine_cs *engine)
  */
 void intel_engine_cleanup_common(struct intel_engine_cs *engine)
 {
+	intel_engine_fini_heartbeat(engine);
 	intel_engine_cleanup_scratch(engine);
 
 	i915_gem_render_state_fini(engine);
@@ -502,7 +521,105 @@ void intel_engine_cleanup_common(struct intel_engine_cs *engine)
 	intel_engine_cleanup_cmd_parser(engine);
 	i915_gem_batch_pool_fini(&engine->batch_pool);
 
+	if (engine->i915->preempt_context)
+		engine->context_unpin(engine, engine->i915->preempt_context);
 	engine->context_unpin(engine, engine->i915->kernel_context);
+
+	if (engine->runtime.active)
+		i915_gem_request_put(engine->runtime.active);
+}
+
+/**
+ * intel_engine_runtime_update - charge the outgoing request for its GPU time
+ * @engine: the engine whose execlist ports may have changed
+ *
+ * Called by the submission backends after they have updated port[0]. The
+ * request that owned port[0] is charged for the time since it was switched
+ * in. A reference to the new occupant is kept so that we can charge it even
+ * if it is retired before we see it switched out.
+ */
+void intel_engine_runtime_update(struct intel_engine_cs *engine)
+{
+	struct drm_i915_gem_request *rq =
+		port_request(&engine->execlist_port[0]);
+	struct drm_i915_gem_request *old;
+	unsigned long flags;
+	ktime_t now;
+
+	if (likely(rq == READ_ONCE(engine->runtime.active)))
+		return;
+
+	now = ktime_get();
+
+	spin_lock_irqsave(&engine->runtime.lock, flags);
+	old = engine->runtime.active;
+	if (old)
+		old->runtime += ktime_to_ns(ktime_sub(now,
+						      engine->runtime.start));
+	engine->runtime.active = rq ? i915_gem_request_get(rq) : NULL;
+	engine->runtime.start = now;
+	spin_unlock_irqrestore(&engine->runtime.lock, flags);
+
+	if (old)
+		i915_gem_request_put(old);
+}
+
+/**
+ * intel_engine_runtime_retire - fold a request's GPU time into its context
+ * @engine: the engine the request executed on
+ * @rq: the request being retired
+ *
+ * Anything charged to @rq after this point (it may still occupy port[0]
+ * until the context switch is processed) is time spent idling after its
+ * breadcrumb and is deliberately dropped.
+ */
+void intel_engine_runtime_retire(struct intel_engine_cs *engine,
+				 struct drm_i915_gem_request *rq)
+{
+	struct intel_context *ce = &rq->ctx->engine[engine->id];
+
+	spin_lock_irq(&engine->runtime.lock);
+	if (engine->runtime.active == rq) {
+		ktime_t now = ktime_get();
+
+		rq->runtime += ktime_to_ns(ktime_sub(now,
+						     engine->runtime.start));
+		engine->runtime.start = now;
+	}
+	ce->runtime += rq->runtime;
+	rq->runtime = 0;
+	spin_unlock_irq(&engine->runtime.lock);
+}
+
+/**
+ * intel_engine_context_runtime - GPU time consumed by a context on an engine
+ * @engine: the engine
+ * @ctx: the context
+ *
+ * Returns the ns spent executing requests of @ctx on @engine, including the
+ * request currently executing. Requests completed but not yet retired are
+ * only accounted once retired. Must be called with struct_mutex held.
+ */
+u64 intel_engine_context_runtime(struct intel_engine_cs *engine,
+				 struct i915_gem_context *ctx)
+{
+	struct drm_i915_gem_request *rq;
+	u64 runtime;
+
+	lockdep_assert_held(&engine->i915->drm.struct_mutex);
+
+	spin_lock_irq(&engine->runtime.lock);
+	runtime = ctx->engine[engine->id].runtime;
+	rq = engine->runtime.active;
+	if (rq && rq->ctx == ctx) {
+		runtime += rq->runtime;
+		if (!i915_gem_request_completed(rq))
+			runtime += ktime_to_ns(ktime_sub(ktime_get(),
+							 engine->runtime.start));
+	}
+	spin_unlock_irq(&engine->runtime.lock);
+
+	return runtime;
 }
 
 u64 intel_engine_get_active_head(struct intel_engine_cs *engine)
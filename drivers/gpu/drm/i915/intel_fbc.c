@@ -357,6 +357,8 @@ static void intel_fbc_hw_activate(struct drm_i915_private *dev_priv)
 	struct intel_fbc *fbc = &dev_priv->fbc;
 
 	fbc->active = true;
+	fbc->activated = ktime_get();
+	fbc->stats[fbc->params.crtc.pipe].activations++;
 
 	if (INTEL_GEN(dev_priv) >= 7)
 		gen7_fbc_activate(dev_priv);
@@ -373,6 +375,8 @@ static void intel_fbc_hw_deactivate(struct drm_i915_private *dev_priv)
 	struct intel_fbc *fbc = &dev_priv->fbc;
 
 	fbc->active = false;
+	fbc->stats[fbc->params.crtc.pipe].active_ns +=
+		ktime_to_ns(ktime_sub(ktime_get(), fbc->activated));
 
 	if (INTEL_GEN(dev_priv) >= 5)
 		ilk_fbc_deactivate(dev_priv);
@@ -1011,9 +1015,10 @@ void intel_fbc_flush(struct drm_i915_private *dev_priv,
 
 	if (!fbc->busy_bits && fbc->enabled &&
 	    (frontbuffer_bits & intel_fbc_get_frontbuffer_bit(fbc))) {
-		if (fbc->active)
+		if (fbc->active) {
 			intel_fbc_recompress(dev_priv);
-		else
+			fbc->stats[fbc->params.crtc.pipe].nukes++;
+		} else
 			__intel_fbc_post_update(fbc->crtc);
 	}
 
@@ -1039,7 +1044,8 @@ void intel_fbc_choose_crtc(struct drm_i915_private *dev_priv,
 	struct intel_fbc *fbc = &dev_priv->fbc;
 	struct drm_plane *plane;
 	struct drm_plane_state *plane_state;
-	bool crtc_chosen = false;
+	struct intel_crtc_state *chosen = NULL;
+	unsigned int chosen_area = 0;
 	int i;
 
 	mutex_lock(&fbc->lock);
@@ -1052,15 +1058,15 @@ void intel_fbc_choose_crtc(struct drm_i915_private *dev_priv,
 	if (!intel_fbc_can_enable(dev_priv))
 		goto out;
 
-	/* Simply choose the first CRTC that is compatible and has a visible
-	 * plane. We could go for fancier schemes such as checking the plane
-	 * size, but this would just affect the few platforms that don't tie FBC
-	 * to pipe or plane A. */
+	/* There is only one compressor, so on the platforms that don't tie it
+	 * to pipe or plane A give it to the largest compatible visible plane,
+	 * which is where it saves the most memory bandwidth. */
 	for_each_new_plane_in_state(state, plane, plane_state, i) {
 		struct intel_plane_state *intel_plane_state =
 			to_intel_plane_state(plane_state);
 		struct intel_crtc_state *intel_crtc_state;
 		struct intel_crtc *crtc = to_intel_crtc(plane_state->crtc);
+		unsigned int area;
 
 		if (!intel_plane_state->base.visible)
 			continue;
@@ -1074,12 +1080,18 @@ void intel_fbc_choose_crtc(struct drm_i915_private *dev_priv,
 		intel_crtc_state = to_intel_crtc_state(
 			drm_atomic_get_existing_crtc_state(state, &crtc->base));
 
-		intel_crtc_state->enable_fbc = true;
-		crtc_chosen = true;
-		break;
+		area = (drm_rect_width(&intel_plane_state->base.src) >> 16) *
+		       (drm_rect_height(&intel_plane_state->base.src) >> 16);
+		if (chosen && area <= chosen_area)
+			continue;
+
+		chosen = intel_crtc_state;
+		chosen_area = area;
 	}
 
-	if (!crtc_chosen)
+	if (chosen)
+		chosen->enable_fbc = true;
+	else
 		fbc->no_fbc_reason = "no suitable CRTC for FBC";
 
 out:
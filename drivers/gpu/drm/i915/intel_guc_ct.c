@@ -28,10 +28,21 @@ enum { CTB_SEND = 0, CTB_RECV = 1 };
 
 enum { CTB_OWNER_HOST = 0 };
 
+/* Tracks a single command sent over CT until the GuC responds to it */
+struct ct_request {
+	struct list_head link;
+	u32 fence;
+	u32 status;
+};
+
 void intel_guc_ct_init_early(struct intel_guc_ct *ct)
 {
 	/* we're using static channel owners */
 	ct->host_channel.owner = CTB_OWNER_HOST;
+
+	spin_lock_init(&ct->lock);
+	INIT_LIST_HEAD(&ct->pending_requests);
+	init_waitqueue_head(&ct->wq);
 }
 
 static inline const char *guc_ct_buffer_type_to_str(u32 type)
@@ -298,9 +309,14 @@ static int ctb_write(struct intel_guc_ct_buffer *ctb,
 	 * DW0: header (including action code)
 	 * DW1: fence
 	 * DW2+: action data
+	 *
+	 * We ask the GuC to post the status back to us over the RECV buffer,
+	 * which raises an interrupt, so that the sender can sleep instead
+	 * of spinning on the descriptor.
 	 */
 	header = (len << GUC_CT_MSG_LEN_SHIFT) |
 		 (GUC_CT_MSG_WRITE_FENCE_TO_DESC) |
+		 (GUC_CT_MSG_SEND_STATUS) |
 		 (action[0] << GUC_CT_MSG_ACTION_SHIFT);
 
 	cmds[tail] = header;
@@ -321,33 +337,187 @@ static int ctb_write(struct intel_guc_ct_buffer *ctb,
 	return 0;
 }
 
+/* Read a single message from the RECV buffer.
+ * @data:	placeholder for the message, at least GUC_CT_MSG_LEN_MASK + 1
+ *		dwords long
+ * return:	0 message read
+ *		-ENODATA buffer is empty
+ *		-EPROTO buffer is corrupted
+ */
+static int ctb_read(struct intel_guc_ct_buffer *ctb, u32 *data)
+{
+	struct guc_ct_buffer_desc *desc = ctb->desc;
+	u32 head = desc->head / 4;	/* in dwords */
+	u32 tail = READ_ONCE(desc->tail) / 4;	/* in dwords */
+	u32 size = desc->size / 4;	/* in dwords */
+	u32 *cmds = ctb->cmds;
+	u32 available;			/* in dwords */
+	unsigned int len;
+	unsigned int i;
+
+	GEM_BUG_ON(desc->size % 4);
+	GEM_BUG_ON(desc->head % 4);
+	GEM_BUG_ON(head >= size);
+
+	if (unlikely(desc->is_in_error || tail >= size))
+		return -EPROTO;
+
+	if (tail == head)
+		return -ENODATA;
+
+	if (tail < head)
+		available = (size - head) + tail;
+	else
+		available = tail - head;
+
+	/* Make sure the payload is visible before we read it */
+	rmb();
+
+	data[0] = cmds[head];
+	head = (head + 1) % size;
+
+	/* message len from the header excludes the header itself */
+	len = ((data[0] >> GUC_CT_MSG_LEN_SHIFT) & GUC_CT_MSG_LEN_MASK) + 1;
+	if (unlikely(len > available)) {
+		DRM_ERROR("CT: incomplete message %#x; len=%u available=%u\n",
+			  data[0], len, available);
+		return -EPROTO;
+	}
+
+	for (i = 1; i < len; i++) {
+		data[i] = cmds[head];
+		head = (head + 1) % size;
+	}
+
+	/* now update desc head (back in bytes) */
+	desc->head = head * 4;
+	return 0;
+}
+
+static bool ct_process_response(struct intel_guc_ct *ct, const u32 *msg)
+{
+	u32 len = (msg[0] >> GUC_CT_MSG_LEN_SHIFT) & GUC_CT_MSG_LEN_MASK;
+	struct ct_request *req;
+
+	lockdep_assert_held(&ct->lock);
+
+	/* Response payload shall at least include fence and status */
+	if (unlikely(len < 2)) {
+		DRM_ERROR("CT: corrupted response %#x\n", msg[0]);
+		return false;
+	}
+
+	list_for_each_entry(req, &ct->pending_requests, link) {
+		if (req->fence != msg[1])
+			continue;
+
+		WRITE_ONCE(req->status, msg[2]);
+		return true;
+	}
+
+	DRM_DEBUG_DRIVER("CT: unsolicited response fence=%u status=%#x\n",
+			 msg[1], msg[2]);
+	return false;
+}
+
+/* Drain the RECV buffer, returns true if any pending request completed */
+static bool ct_process_incoming(struct intel_guc_ct *ct)
+{
+	struct intel_guc_ct_buffer *ctb = &ct->host_channel.ctbs[CTB_RECV];
+	u32 msg[GUC_CT_MSG_LEN_MASK + 1];
+	bool completed = false;
+	int err;
+
+	lockdep_assert_held(&ct->lock);
+
+	if (!ct->enabled)
+		return false;
+
+	while ((err = ctb_read(ctb, msg)) == 0) {
+		if (msg[0] & GUC_CT_MSG_IS_RESPONSE)
+			completed |= ct_process_response(ct, msg);
+		else
+			DRM_DEBUG_DRIVER("CT: ignoring request %#x\n",
+					 (msg[0] >> GUC_CT_MSG_ACTION_SHIFT) &
+					 GUC_CT_MSG_ACTION_MASK);
+	}
+
+	if (unlikely(err == -EPROTO)) {
+		/* Drop whatever is left and hope the senders time out cleanly */
+		guc_ct_buffer_desc_reset(ctb->desc);
+	}
+
+	return completed;
+}
+
+/**
+ * intel_guc_ct_event_handler - process messages posted by the GuC
+ * @ct: the command transport
+ *
+ * Called from the GuC to host interrupt handler to drain the RECV buffer
+ * and wake up any sender whose command has now completed.
+ */
+void intel_guc_ct_event_handler(struct intel_guc_ct *ct)
+{
+	bool completed;
+
+	spin_lock(&ct->lock);
+	completed = ct_process_incoming(ct);
+	spin_unlock(&ct->lock);
+
+	if (completed)
+		wake_up_all(&ct->wq);
+}
+
+static bool ct_request_done(struct intel_guc_ct *ct, struct ct_request *req)
+{
+	unsigned long flags;
+
+	if (INTEL_GUC_RECV_IS_RESPONSE(READ_ONCE(req->status)))
+		return true;
+
+	/*
+	 * The GuC interrupt may be masked (e.g. across suspend or while the
+	 * log relay owns it), so also look for the response ourselves.
+	 */
+	spin_lock_irqsave(&ct->lock, flags);
+	ct_process_incoming(ct);
+	spin_unlock_irqrestore(&ct->lock, flags);
+
+	return INTEL_GUC_RECV_IS_RESPONSE(READ_ONCE(req->status));
+}
+
 /* Wait for the response from the GuC.
- * @fence:	response fence
- * @status:	placeholder for status
+ * @req:	the pending request, @req->status is valid on success
  * return:	0 response received (status is valid)
  *		-ETIMEDOUT no response within hardcoded timeout
  *		-EPROTO no response, ct buffer was in error
  */
-static int wait_for_response(struct guc_ct_buffer_desc *desc,
-			     u32 fence,
-			     u32 *status)
+static int wait_for_response(struct intel_guc *guc, struct ct_request *req)
 {
+	struct intel_guc_ct *ct = &guc->ct;
+	struct guc_ct_buffer_desc *desc = ct->host_channel.ctbs[CTB_SEND].desc;
 	int err;
 
 	/*
 	 * Fast commands should complete in less than 10us, so sample quickly
-	 * up to that length of time, then switch to a slower sleep-wait loop.
-	 * No GuC command should ever take longer than 10ms.
+	 * up to that length of time, then sleep until the GuC interrupts us
+	 * with the response. No GuC command should ever take longer than 10ms.
 	 */
-#define done (READ_ONCE(desc->fence) == fence)
+#define done ct_request_done(ct, req)
 	err = wait_for_us(done, 10);
-	if (err)
+	if (err && READ_ONCE(guc->interrupts_enabled)) {
+		if (wait_event_timeout(ct->wq, done,
+				       msecs_to_jiffies(10) + 1))
+			err = 0;
+	} else if (err) {
 		err = wait_for(done, 10);
+	}
 #undef done
 
 	if (unlikely(err)) {
 		DRM_ERROR("CT: fence %u failed; reported fence=%u\n",
-			  fence, desc->fence);
+			  req->fence, desc->fence);
 
 		if (WARN_ON(desc->is_in_error)) {
 			/* Something went wrong with the messaging, try to reset
@@ -358,7 +528,6 @@ static int wait_for_response(struct guc_ct_buffer_desc *desc,
 		}
 	}
 
-	*status = desc->status;
 	return err;
 }
 
@@ -368,23 +537,36 @@ static int ctch_send(struct intel_guc *guc,
 		     u32 len,
 		     u32 *status)
 {
+	struct intel_guc_ct *ct = &guc->ct;
 	struct intel_guc_ct_buffer *ctb = &ctch->ctbs[CTB_SEND];
-	struct guc_ct_buffer_desc *desc = ctb->desc;
-	u32 fence;
+	struct ct_request req;
 	int err;
 
 	GEM_BUG_ON(!ctch_is_open(ctch));
 	GEM_BUG_ON(!len);
 	GEM_BUG_ON(len & ~GUC_CT_MSG_LEN_MASK);
 
-	fence = ctch_get_next_fence(ctch);
-	err = ctb_write(ctb, action, len, fence);
+	req.fence = ctch_get_next_fence(ctch);
+	req.status = 0; /* not a valid response */
+
+	spin_lock_irq(&ct->lock);
+	list_add_tail(&req.link, &ct->pending_requests);
+	spin_unlock_irq(&ct->lock);
+
+	err = ctb_write(ctb, action, len, req.fence);
 	if (unlikely(err))
-		return err;
+		goto unlink;
 
 	intel_guc_notify(guc);
 
-	err = wait_for_response(desc, fence, status);
+	err = wait_for_response(guc, &req);
+
+unlink:
+	spin_lock_irq(&ct->lock);
+	list_del(&req.link);
+	spin_unlock_irq(&ct->lock);
+
+	*status = req.status;
 	if (unlikely(err))
 		return err;
 	if (*status != INTEL_GUC_STATUS_SUCCESS)
@@ -432,6 +614,10 @@ int intel_guc_enable_ct(struct intel_guc *guc)
 	if (unlikely(err))
 		return err;
 
+	spin_lock_irq(&guc->ct.lock);
+	guc->ct.enabled = true;
+	spin_unlock_irq(&guc->ct.lock);
+
 	/* Switch into cmd transport buffer based send() */
 	guc->send = intel_guc_send_ct;
 	DRM_INFO("CT: %s\n", enableddisabled(true));
@@ -453,6 +639,11 @@ void intel_guc_disable_ct(struct intel_guc *guc)
 	if (!ctch_is_open(ctch))
 		return;
 
+	/* Stop the interrupt handler from touching the buffers */
+	spin_lock_irq(&guc->ct.lock);
+	guc->ct.enabled = false;
+	spin_unlock_irq(&guc->ct.lock);
+
 	ctch_close(guc, ctch);
 
 	/* Disable send */
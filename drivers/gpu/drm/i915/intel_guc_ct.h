@@ -71,13 +71,23 @@ struct intel_guc_ct_channel {
 /** Holds all command transport channels.
  *
  * @host_channel: main channel used by the host
+ * @lock: protects @pending_requests and reading from the RECV buffer
+ * @pending_requests: sent commands still waiting for their G2H response
+ * @wq: waitqueue for the senders, woken from the GuC interrupt handler
+ * @enabled: whether GuC to host messages should be processed
  */
 struct intel_guc_ct {
 	struct intel_guc_ct_channel host_channel;
 	/* other channels are tbd */
+
+	spinlock_t lock;
+	struct list_head pending_requests;
+	wait_queue_head_t wq;
+	bool enabled;
 };
 
 void intel_guc_ct_init_early(struct intel_guc_ct *ct);
+void intel_guc_ct_event_handler(struct intel_guc_ct *ct);
 
 /* XXX: move to intel_uc.h ? don't fit there either */
 int intel_guc_enable_ct(struct intel_guc *guc);
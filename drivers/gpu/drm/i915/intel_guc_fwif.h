@@ -372,6 +372,21 @@ struct guc_ct_buffer_desc {
 #define GUC_CT_MSG_ACTION_SHIFT			16
 #define GUC_CT_MSG_ACTION_MASK			0xFFFF
 
+/*
+ * Definition of the message header (DW0) received from the GuC (G2H)
+ *
+ * bit[4..0]	message len (in dwords, excluding the header)
+ * bit[7..5]	reserved
+ * bit[8]	response
+ * bit[15..9]	reserved
+ * bit[31..16]	action code
+ *
+ * A response to a command sent with GUC_CT_MSG_SEND_STATUS carries the
+ * fence of that command in DW1, followed by the status in DW2 and any
+ * optional response data.
+ */
+#define GUC_CT_MSG_IS_RESPONSE			(1 << 8)
+
 #define GUC_FORCEWAKE_RENDER	(1 << 0)
 #define GUC_FORCEWAKE_MEDIA	(1 << 1)
 
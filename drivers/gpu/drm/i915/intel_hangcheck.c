@@ -475,6 +475,124 @@ void intel_engine_init_hangcheck(struct intel_engine_cs *engine)
 	memset(&engine->hangcheck, 0, sizeof(engine->hangcheck));
 }
 
+static bool heartbeat_enabled(struct intel_engine_cs *engine)
+{
+	/* Without preemption a long batch could not let the beat through */
+	return READ_ONCE(i915.heartbeat_interval_ms) &&
+	       engine->schedule && engine->i915->preempt_context;
+}
+
+static void heartbeat_queue(struct intel_engine_cs *engine)
+{
+	mod_delayed_work(system_highpri_wq, &engine->heartbeat.work,
+			 msecs_to_jiffies(READ_ONCE(i915.heartbeat_interval_ms)));
+}
+
+static void heartbeat_send(struct intel_engine_cs *engine)
+{
+	struct drm_i915_private *i915 = engine->i915;
+	struct drm_i915_gem_request *rq;
+
+	/* Nothing to check on an engine that has completed all its work */
+	if (i915_seqno_passed(intel_engine_get_seqno(engine),
+			      intel_engine_last_submit(engine)))
+		return;
+
+	/* Never wait for struct_mutex: its holder may be stuck behind the
+	 * very hang we are looking for, and hangcheck still covers us.
+	 */
+	if (!mutex_trylock(&i915->drm.struct_mutex))
+		return;
+
+	rq = i915_gem_request_alloc(engine, i915->kernel_context);
+	if (!IS_ERR(rq)) {
+		engine->heartbeat.systole = i915_gem_request_get(rq);
+		engine->heartbeat.beats++;
+		i915_add_request(rq);
+	}
+
+	mutex_unlock(&i915->drm.struct_mutex);
+}
+
+static void heartbeat_raise(struct intel_engine_cs *engine,
+			    struct drm_i915_gem_request *rq, int prio)
+{
+	struct drm_i915_private *i915 = engine->i915;
+
+	if (!mutex_trylock(&i915->drm.struct_mutex))
+		return;
+
+	engine->schedule(rq, prio);
+	mutex_unlock(&i915->drm.struct_mutex);
+}
+
+/*
+ * The beat is sent from the kernel context, at the lowest priority, so
+ * that it only runs once the engine has got through the work queued
+ * ahead of it. A beat still waiting after an interval is raised to
+ * heartbeat_priority, and preempts whatever is running below that;
+ * if it still has not run an interval later, the engine is hung and
+ * we reset it. A hang is thus handled within three intervals of the
+ * engine stopping, rather than the several hangcheck periods it takes
+ * for hangcheck to give up on an engine.
+ */
+static void heartbeat_pulse(struct work_struct *work)
+{
+	struct intel_engine_cs *engine =
+		container_of(work, typeof(*engine), heartbeat.work.work);
+	struct drm_i915_private *i915 = engine->i915;
+	struct drm_i915_gem_request *rq = engine->heartbeat.systole;
+	int prio = READ_ONCE(i915.heartbeat_priority);
+
+	if (rq && i915_gem_request_completed(rq)) {
+		i915_gem_request_put(rq);
+		engine->heartbeat.systole = rq = NULL;
+	}
+
+	/* Rearmed by intel_engine_unpark_heartbeat() */
+	if (!READ_ONCE(i915->gt.awake) || !heartbeat_enabled(engine)) {
+		if (rq)
+			i915_gem_request_put(fetch_and_zero(&engine->heartbeat.systole));
+		return;
+	}
+
+	if (i915_terminally_wedged(&i915->gpu_error) ||
+	    test_bit(I915_RESET_BACKOFF, &i915->gpu_error.flags))
+		goto out;
+
+	if (!rq) {
+		heartbeat_send(engine);
+	} else if (READ_ONCE(rq->priotree.priority) < prio) {
+		heartbeat_raise(engine, rq, prio);
+	} else {
+		engine->heartbeat.resets++;
+		i915_handle_error(i915, intel_engine_flag(engine),
+				  "No heartbeat on %s", engine->name);
+	}
+
+out:
+	heartbeat_queue(engine);
+}
+
+void intel_engine_init_heartbeat(struct intel_engine_cs *engine)
+{
+	INIT_DELAYED_WORK(&engine->heartbeat.work, heartbeat_pulse);
+}
+
+void intel_engine_unpark_heartbeat(struct intel_engine_cs *engine)
+{
+	if (heartbeat_enabled(engine) &&
+	    !delayed_work_pending(&engine->heartbeat.work))
+		heartbeat_queue(engine);
+}
+
+void intel_engine_fini_heartbeat(struct intel_engine_cs *engine)
+{
+	cancel_delayed_work_sync(&engine->heartbeat.work);
+	if (engine->heartbeat.systole)
+		i915_gem_request_put(fetch_and_zero(&engine->heartbeat.systole));
+}
+
 void intel_hangcheck_init(struct drm_i915_private *i915)
 {
 	INIT_DELAYED_WORK(&i915->gpu_error.hangcheck_work,
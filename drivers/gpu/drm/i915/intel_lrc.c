@@ -130,12 +130,22 @@
  * with the same context and optimizes the context switch flow by not doing
  * preemption, but just sampling the new tail pointer).
  *
+ * On gen9+ a request of higher priority than the one executing in port[0]
+ * preempts it: we submit the dedicated preempt context (hw_id PREEMPT_ID),
+ * which the GPU switches to at the next arbitration point. Its completion
+ * event tells us the engine is idle, at which point every incomplete request
+ * is unwound back onto the priority queue and resubmitted in priority order.
+ * The same mechanism provides a timeslice between contexts of equal priority:
+ * when the timeslice expires, the running requests are unwound behind the
+ * waiting ones instead of in front of them.
+ *
  */
 #include <linux/interrupt.h>
 
 #include <drm/drmP.h>
 #include <drm/i915_drm.h>
 #include "i915_drv.h"
+#include "i915_vgpu.h"
 #include "intel_mocs.h"
 
 #define RING_EXECLIST_QFULL		(1 << 0x2)
@@ -210,6 +220,9 @@
 #define EXECLISTS_REQUEST_SIZE 64 /* bytes */
 
 #define WA_TAIL_DWORDS 2
+#define WA_TAIL_BYTES (sizeof(u32) * WA_TAIL_DWORDS)
+
+#define PREEMPT_ID 0x1
 
 static int execlists_context_deferred_alloc(struct i915_gem_context *ctx,
 					    struct intel_engine_cs *engine);
@@ -395,24 +408,203 @@ static void port_assign(struct execlist_port *port,
 	port_set(port, port_pack(i915_gem_request_get(rq), port_count(port)));
 }
 
+static struct i915_priolist *
+lookup_priolist(struct intel_engine_cs *engine, int prio, bool *first)
+{
+	struct i915_priolist *p;
+	struct rb_node **parent, *rb;
+
+	if (unlikely(engine->no_priolist))
+		prio = I915_PRIORITY_NORMAL;
+
+find_priolist:
+	/* most positive priority is scheduled first, equal priorities fifo */
+	*first = true;
+	rb = NULL;
+	parent = &engine->execlist_queue.rb_node;
+	while (*parent) {
+		rb = *parent;
+		p = rb_entry(rb, typeof(*p), node);
+		if (prio > p->priority) {
+			parent = &rb->rb_left;
+		} else if (prio < p->priority) {
+			parent = &rb->rb_right;
+			*first = false;
+		} else {
+			*first = false;
+			return p;
+		}
+	}
+
+	if (prio == I915_PRIORITY_NORMAL) {
+		p = &engine->default_priolist;
+	} else {
+		p = kmem_cache_alloc(engine->i915->priorities, GFP_ATOMIC);
+		/* Convert an allocation failure to a priority bump */
+		if (unlikely(!p)) {
+			prio = I915_PRIORITY_NORMAL; /* recurses just once */
+
+			/* To maintain ordering with all rendering, after an
+			 * allocation failure we have to disable all scheduling.
+			 * Requests will then be executed in fifo, and schedule
+			 * will ensure that dependencies are emitted in fifo.
+			 * There will be still some reordering with existing
+			 * requests, so if userspace lied about their
+			 * dependencies that reordering may be visible.
+			 */
+			engine->no_priolist = true;
+			goto find_priolist;
+		}
+	}
+
+	p->priority = prio;
+	rb_link_node(&p->node, rb, parent);
+	rb_insert_color(&p->node, &engine->execlist_queue);
+
+	INIT_LIST_HEAD(&p->requests);
+
+	if (*first)
+		engine->execlist_first = &p->node;
+
+	return p;
+}
+
+static bool
+insert_request(struct intel_engine_cs *engine,
+	       struct i915_priotree *pt,
+	       int prio)
+{
+	struct i915_priolist *p;
+	bool first;
+
+	p = lookup_priolist(engine, prio, &first);
+	list_add_tail(&pt->link, &p->requests);
+
+	return first;
+}
+
+static bool can_preempt(struct intel_engine_cs *engine)
+{
+	return engine->i915->preempt_context;
+}
+
+static void inject_preempt_context(struct intel_engine_cs *engine, bool rotate)
+{
+	struct intel_context *ce =
+		&engine->i915->preempt_context->engine[engine->id];
+	u32 __iomem *elsp =
+		engine->i915->regs + i915_mmio_reg_offset(RING_ELSP(engine));
+	unsigned int n;
+
+	GEM_BUG_ON(engine->i915->preempt_context->hw_id != PREEMPT_ID);
+	GEM_BUG_ON(!IS_ALIGNED(ce->ring->size, WA_TAIL_BYTES));
+
+	/* Give the preempt context a couple of NOOPs to execute */
+	memset(ce->ring->vaddr + ce->ring->tail, 0, WA_TAIL_BYTES);
+	ce->ring->tail += WA_TAIL_BYTES;
+	ce->ring->tail &= (ce->ring->size - 1);
+	ce->lrc_reg_state[CTX_RING_TAIL+1] = ce->ring->tail;
+
+	for (n = ARRAY_SIZE(engine->execlist_port); --n; ) {
+		writel(0, elsp);
+		writel(0, elsp);
+	}
+
+	writel(upper_32_bits(ce->lrc_desc), elsp);
+	writel(lower_32_bits(ce->lrc_desc), elsp);
+
+	engine->execlist_preempt = true;
+	engine->execlist_preempt_rotate = rotate;
+	engine->execlist_preempt_start = ktime_get();
+}
+
+/*
+ * A timeslice may only move the running requests behind the waiting ones if
+ * none of the waiters relies on in-order execution behind work already
+ * submitted to this engine, and at least one of them belongs to a context
+ * other than those in the ports.
+ */
+static bool timeslice_allowed(struct intel_engine_cs *engine,
+			      struct i915_priolist *p)
+{
+	const struct execlist_port *port = engine->execlist_port;
+	struct drm_i915_gem_request *rq;
+	unsigned int budget = 64;
+	bool other = false;
+
+	list_for_each_entry(rq, &p->requests, priotree.link) {
+		if (rq->priotree.ordered || !--budget)
+			return false;
+
+		if (rq->ctx != port_request(&port[0])->ctx &&
+		    (!port_isset(&port[1]) ||
+		     rq->ctx != port_request(&port[1])->ctx))
+			other = true;
+	}
+
+	return other;
+}
+
+static bool need_preempt(struct intel_engine_cs *engine,
+			 const struct drm_i915_gem_request *last,
+			 struct i915_priolist *p, bool *rotate)
+{
+	bool expired = fetch_and_zero(&engine->execlist_timeslice_expired);
+
+	if (!can_preempt(engine) || ctx_single_port_submission(last->ctx))
+		return false;
+
+	if (p->priority > max(last->priotree.priority, 0)) {
+		*rotate = false;
+		return true;
+	}
+
+	if (expired && p->priority == last->priotree.priority &&
+	    timeslice_allowed(engine, p)) {
+		*rotate = true;
+		return true;
+	}
+
+	return false;
+}
+
+static void arm_timeslice(struct intel_engine_cs *engine,
+			  const struct drm_i915_gem_request *last,
+			  struct rb_node *rb)
+{
+	unsigned int ms = READ_ONCE(i915.execlists_timeslice_ms);
+
+	if (!ms || !rb || !can_preempt(engine))
+		return;
+
+	if (rb_entry(rb, struct i915_priolist, node)->priority !=
+	    last->priotree.priority)
+		return;
+
+	if (!timer_pending(&engine->execlist_timeslice))
+		mod_timer(&engine->execlist_timeslice,
+			  jiffies + msecs_to_jiffies(ms));
+}
+
+static void execlists_timeslice_expired(unsigned long data)
+{
+	struct intel_engine_cs *engine = (struct intel_engine_cs *)data;
+
+	/* Queued requests keep the device awake for the tasklet */
+	if (!READ_ONCE(engine->execlist_first))
+		return;
+
+	WRITE_ONCE(engine->execlist_timeslice_expired, true);
+	tasklet_hi_schedule(&engine->irq_tasklet);
+}
+
 static void execlists_dequeue(struct intel_engine_cs *engine)
 {
 	struct drm_i915_gem_request *last;
 	struct execlist_port *port = engine->execlist_port;
 	struct rb_node *rb;
 	bool submit = false;
-
-	last = port_request(port);
-	if (last)
-		/* WaIdleLiteRestore:bdw,skl
-		 * Apply the wa NOOPs to prevent ring:HEAD == req:TAIL
-		 * as we resubmit the request. See gen8_emit_breadcrumb()
-		 * for where we prepare the padding after the end of the
-		 * request.
-		 */
-		last->tail = last->wa_tail;
-
-	GEM_BUG_ON(port_isset(&port[1]));
+	bool rotate;
 
 	/* Hardware submission is through 2 ports. Conceptually each port
 	 * has a (RING_START, RING_HEAD, RING_TAIL) tuple. RING_START is
@@ -438,6 +630,42 @@ static void execlists_dequeue(struct intel_engine_cs *engine)
 	spin_lock_irq(&engine->timeline->lock);
 	rb = engine->execlist_first;
 	GEM_BUG_ON(rb_first(&engine->execlist_queue) != rb);
+	if (!rb)
+		goto unlock;
+
+	last = port_request(port);
+	if (last) {
+		/*
+		 * Don't resubmit or switch until all outstanding
+		 * submissions (lite-restore) have been acked by the hw.
+		 */
+		if (port_count(&port[0]) > 1)
+			goto unlock;
+
+		if (need_preempt(engine, last,
+				 rb_entry(rb, struct i915_priolist, node),
+				 &rotate)) {
+			inject_preempt_context(engine, rotate);
+			goto unlock;
+		}
+
+		/* Both ports busy, wait for a context switch */
+		if (port_isset(&port[1])) {
+			arm_timeslice(engine, last, rb);
+			goto unlock;
+		}
+
+		/* WaIdleLiteRestore:bdw,skl
+		 * Apply the wa NOOPs to prevent ring:HEAD == req:TAIL
+		 * as we resubmit the request. See gen8_emit_breadcrumb()
+		 * for where we prepare the padding after the end of the
+		 * request.
+		 */
+		last->tail = last->wa_tail;
+	}
+
+	GEM_BUG_ON(port_isset(&port[1]));
+
 	while (rb) {
 		struct i915_priolist *p = rb_entry(rb, typeof(*p), node);
 		struct drm_i915_gem_request *rq, *rn;
@@ -488,7 +716,6 @@ static void execlists_dequeue(struct intel_engine_cs *engine)
 			}
 
 			INIT_LIST_HEAD(&rq->priotree.link);
-			rq->priotree.priority = INT_MAX;
 
 			__i915_gem_request_submit(rq);
 			trace_i915_gem_request_in(rq, port_index(port, engine));
@@ -504,14 +731,123 @@ static void execlists_dequeue(struct intel_engine_cs *engine)
 	}
 done:
 	engine->execlist_first = rb;
-	if (submit)
+	if (submit) {
 		port_assign(port, last);
+		arm_timeslice(engine, port_request(&engine->execlist_port[0]),
+			      rb);
+	}
+unlock:
 	spin_unlock_irq(&engine->timeline->lock);
 
 	if (submit)
 		execlists_submit_ports(engine);
 }
 
+static void execlists_cancel_port_requests(struct intel_engine_cs *engine)
+{
+	struct execlist_port *port = engine->execlist_port;
+	unsigned int n;
+
+	for (n = 0; n < ARRAY_SIZE(engine->execlist_port); n++) {
+		struct drm_i915_gem_request *rq = port_request(&port[n]);
+
+		if (!rq)
+			continue;
+
+		execlists_context_status_change(rq, INTEL_CONTEXT_SCHEDULE_OUT);
+		i915_gem_request_put(rq);
+	}
+
+	memset(engine->execlist_port, 0, sizeof(engine->execlist_port));
+}
+
+static void
+execlists_unwind_incomplete_requests(struct intel_engine_cs *engine,
+				     bool rotate)
+{
+	struct drm_i915_gem_request *rq, *rn, *q, *qn;
+	struct i915_gem_context *ctx[2] = {};
+	struct i915_priolist *p, *fp;
+	LIST_HEAD(unwound);
+	LIST_HEAD(followers);
+	bool first;
+
+	lockdep_assert_held(&engine->timeline->lock);
+
+	/* Unsubmit in reverse order, leaving @unwound in execution order */
+	list_for_each_entry_safe_reverse(rq, rn,
+					 &engine->timeline->requests, link) {
+		if (i915_gem_request_completed(rq))
+			break;
+
+		__i915_gem_request_unsubmit(rq);
+		list_add(&rq->priotree.link, &unwound);
+
+		if (rq->ctx != ctx[0] && rq->ctx != ctx[1])
+			ctx[ctx[0] ? 1 : 0] = rq->ctx;
+	}
+
+	if (!rotate) {
+		/* Put the preempted requests back in front of their peers */
+		list_for_each_entry_safe_reverse(rq, rn, &unwound,
+						 priotree.link) {
+			p = lookup_priolist(engine, rq->priotree.priority,
+					    &first);
+			list_move(&rq->priotree.link, &p->requests);
+		}
+		return;
+	}
+
+	/*
+	 * For a timeslice the preempted requests go behind the waiters of the
+	 * same priority, together with any later requests from their own
+	 * contexts that were already queued, so that each context stays in
+	 * ring order.
+	 */
+	fp = NULL;
+	list_for_each_entry_safe(rq, rn, &unwound, priotree.link) {
+		p = lookup_priolist(engine, rq->priotree.priority, &first);
+		if (p != fp) {
+			if (fp)
+				list_splice_tail_init(&followers, &fp->requests);
+
+			list_for_each_entry_safe(q, qn, &p->requests,
+						 priotree.link) {
+				if (q->ctx == ctx[0] || q->ctx == ctx[1])
+					list_move_tail(&q->priotree.link,
+						       &followers);
+			}
+			fp = p;
+		}
+		list_move_tail(&rq->priotree.link, &p->requests);
+	}
+	if (fp)
+		list_splice_tail(&followers, &fp->requests);
+}
+
+static void execlists_preempt_complete(struct intel_engine_cs *engine)
+{
+	u64 delta;
+
+	spin_lock_irq(&engine->timeline->lock);
+	execlists_cancel_port_requests(engine);
+	execlists_unwind_incomplete_requests(engine,
+					     engine->execlist_preempt_rotate);
+	spin_unlock_irq(&engine->timeline->lock);
+
+	delta = ktime_to_ns(ktime_sub(ktime_get(),
+				      engine->execlist_preempt_start));
+	engine->execlist_preempt_stats.count++;
+	if (engine->execlist_preempt_rotate)
+		engine->execlist_preempt_stats.timeslices++;
+	engine->execlist_preempt_stats.total_ns += delta;
+	if (delta > engine->execlist_preempt_stats.max_ns)
+		engine->execlist_preempt_stats.max_ns = delta;
+
+	engine->execlist_preempt = false;
+	engine->execlist_preempt_rotate = false;
+}
+
 static bool execlists_elsp_ready(const struct intel_engine_cs *engine)
 {
 	const struct execlist_port *port = engine->execlist_port;
@@ -520,25 +856,60 @@ static bool execlists_elsp_ready(const struct intel_engine_cs *engine)
 }
 
 /*
- * Check the unread Context Status Buffers and manage the submission of new
- * contexts to the ELSP accordingly.
+ * Under GVT-g the CSB registers are mirrored into guest memory, see
+ * struct vgt_shared_page, which spares a trap for each of them. The host
+ * writes the buffer before the pointer, so pair the pointer read with a
+ * read barrier before looking at the entries. The read pointer is ours,
+ * the mirror only catches up with it on the next context switch event,
+ * so track it locally instead.
+ *
+ * On real hardware, the CS also writes the CSB entries and then the
+ * write pointer into the HWSP, which is snooped, so that neither an
+ * uncached read nor forcewake is needed to process a context switch.
  */
-static void intel_lrc_irq_handler(unsigned long data)
+static inline bool csb_in_memory(const struct intel_engine_cs *engine)
 {
-	struct intel_engine_cs *engine = (struct intel_engine_cs *)data;
-	struct execlist_port *port = engine->execlist_port;
-	struct drm_i915_private *dev_priv = engine->i915;
+	return engine->execlist_csb_shared || engine->execlist_csb_hwsp;
+}
 
-	/* We can skip acquiring intel_runtime_pm_get() here as it was taken
-	 * on our behalf by the request (see i915_gem_mark_busy()) and it will
-	 * not be relinquished until the device is idle (see
-	 * i915_gem_idle_work_handler()). As a precaution, we make sure
-	 * that all ELSP are drained i.e. we have processed the CSB,
-	 * before allowing ourselves to idle and calling intel_runtime_pm_put().
-	 */
-	GEM_BUG_ON(!dev_priv->gt.awake);
+static inline u32 csb_read_ptr(struct intel_engine_cs *engine,
+			       u32 __iomem *csb_mmio)
+{
+	u32 ptr;
+
+	if (engine->execlist_csb_hwsp)
+		ptr = READ_ONCE(engine->status_page.page_addr[I915_HWS_CSB_WRITE_INDEX]);
+	else if (engine->execlist_csb_shared)
+		ptr = READ_ONCE(engine->execlist_csb_shared->csb_ptr);
+	else
+		return readl(csb_mmio);
+
+	smp_rmb();
+	return (ptr & GEN8_CSB_WRITE_PTR_MASK) |
+	       (engine->execlist_csb_head << 8);
+}
 
-	intel_uncore_forcewake_get(dev_priv, engine->fw_domains);
+static inline u32 csb_read(struct intel_engine_cs *engine,
+			   u32 __iomem *buf, unsigned int idx)
+{
+	if (engine->execlist_csb_hwsp)
+		return READ_ONCE(engine->status_page.page_addr[I915_HWS_CSB_BUF0_INDEX + idx]);
+
+	if (engine->execlist_csb_shared)
+		return READ_ONCE(engine->execlist_csb_shared->csb[idx]);
+
+	return readl(buf + idx);
+}
+
+/*
+ * Consume the unread Context Status Buffer events, retiring the ports
+ * of the contexts that completed. Called with the tasklet owned, either
+ * from the tasklet itself or from the interrupt handler.
+ */
+static void execlists_process_csb(struct intel_engine_cs *engine)
+{
+	struct execlist_port *port = engine->execlist_port;
+	struct drm_i915_private *dev_priv = engine->i915;
 
 	/* Prefer doing test_and_clear_bit() as a two stage operation to avoid
 	 * imposing the cost of a locked atomic transaction when submitting a
@@ -553,7 +924,8 @@ static void intel_lrc_irq_handler(unsigned long data)
 
 		/* The write will be ordered by the uncached read (itself
 		 * a memory barrier), so we do not need another in the form
-		 * of a locked instruction. The race between the interrupt
+		 * of a locked instruction; a CSB in memory needs a plain
+		 * smp_mb() instead. The race between the interrupt
 		 * handler and the split test/clear is harmless as we order
 		 * our clear before the CSB read. If the interrupt arrived
 		 * first between the test and the clear, we read the updated
@@ -562,7 +934,9 @@ static void intel_lrc_irq_handler(unsigned long data)
 		 * is set and we do a new loop.
 		 */
 		__clear_bit(ENGINE_IRQ_EXECLIST, &engine->irq_posted);
-		head = readl(csb_mmio);
+		if (csb_in_memory(engine))
+			smp_mb(); /* order the clear before the pointer read */
+		head = csb_read_ptr(engine, csb_mmio);
 		tail = GEN8_CSB_WRITE_PTR(head);
 		head = GEN8_CSB_READ_PTR(head);
 		while (head != tail) {
@@ -587,15 +961,33 @@ static void intel_lrc_irq_handler(unsigned long data)
 			 * store all of the bookkeeping within port[] as
 			 * required, and avoid using unguarded pointers beneath
 			 * request itself. The same applies to the atomic
-			 * status notifier.
+			 * status notifier. We may even be in hardirq context,
+			 * see intel_lrc_csb_irq().
 			 */
 
-			status = readl(buf + 2 * head);
+			status = csb_read(engine, buf, 2 * head);
+
+			/*
+			 * The preempt context has run to completion on an
+			 * otherwise idle engine, everything still in the
+			 * ports can now be unwound and resubmitted.
+			 */
+			if (status & GEN8_CTX_STATUS_COMPLETE &&
+			    csb_read(engine, buf, 2 * head + 1) == PREEMPT_ID) {
+				GEM_BUG_ON(!engine->execlist_preempt);
+				execlists_preempt_complete(engine);
+				continue;
+			}
+
+			if (status & GEN8_CTX_STATUS_PREEMPTED &&
+			    engine->execlist_preempt)
+				continue;
+
 			if (!(status & GEN8_CTX_STATUS_COMPLETED_MASK))
 				continue;
 
 			/* Check the context/desc id for this event matches */
-			GEM_DEBUG_BUG_ON(readl(buf + 2 * head + 1) !=
+			GEM_DEBUG_BUG_ON(csb_read(engine, buf, 2 * head + 1) !=
 					 port->context_id);
 
 			rq = port_unpack(port, &count);
@@ -614,89 +1006,140 @@ static void intel_lrc_irq_handler(unsigned long data)
 				port_set(port, port_pack(rq, count));
 			}
 
-			/* After the final element, the hw should be idle */
+			/*
+			 * After the final element, the hw should be idle,
+			 * unless it switched to the preempt context.
+			 */
 			GEM_BUG_ON(port_count(port) == 0 &&
+				   !engine->execlist_preempt &&
 				   !(status & GEN8_CTX_STATUS_ACTIVE_IDLE));
 		}
 
+		/* A posted write, which the CS does not need forcewake for */
 		writel(_MASKED_FIELD(GEN8_CSB_READ_PTR_MASK, head << 8),
 		       csb_mmio);
+		engine->execlist_csb_head = head;
+	}
+}
+
+/*
+ * Check the unread Context Status Buffers and manage the submission of new
+ * contexts to the ELSP accordingly.
+ */
+static void intel_lrc_irq_handler(unsigned long data)
+{
+	struct intel_engine_cs *engine = (struct intel_engine_cs *)data;
+	struct drm_i915_private *dev_priv = engine->i915;
+	bool fw = false;
+
+	/* We can skip acquiring intel_runtime_pm_get() here as it was taken
+	 * on our behalf by the request (see i915_gem_mark_busy()) and it will
+	 * not be relinquished until the device is idle (see
+	 * i915_gem_idle_work_handler()). As a precaution, we make sure
+	 * that all ELSP are drained i.e. we have processed the CSB,
+	 * before allowing ourselves to idle and calling intel_runtime_pm_put().
+	 */
+	GEM_BUG_ON(!dev_priv->gt.awake);
+
+	/* Only the mmio CSB and the ELSP writes need forcewake */
+	if (!csb_in_memory(engine)) {
+		intel_uncore_forcewake_get(dev_priv, engine->fw_domains);
+		fw = true;
 	}
 
-	if (execlists_elsp_ready(engine))
+	execlists_process_csb(engine);
+
+	if (!engine->execlist_preempt && READ_ONCE(engine->execlist_first)) {
+		if (!fw) {
+			intel_uncore_forcewake_get(dev_priv, engine->fw_domains);
+			fw = true;
+		}
 		execlists_dequeue(engine);
+	}
+
+	intel_engine_runtime_update(engine);
 
-	intel_uncore_forcewake_put(dev_priv, engine->fw_domains);
+	if (fw)
+		intel_uncore_forcewake_put(dev_priv, engine->fw_domains);
 }
 
-static bool
-insert_request(struct intel_engine_cs *engine,
-	       struct i915_priotree *pt,
-	       int prio)
+/**
+ * intel_lrc_csb_irq - handle a context switch interrupt
+ * @engine: the engine that raised the interrupt
+ *
+ * Called from the interrupt handler, with ENGINE_IRQ_EXECLIST set. When
+ * the CSB can be read from memory, and nothing else holds the tasklet,
+ * the events are processed on the spot. The tasklet is then only needed
+ * to submit more work to the ELSP, which takes the timeline lock with
+ * spin_lock_irq() and forcewake, so that a context completing on an
+ * engine with nothing queued behind it costs no softirq.
+ */
+void intel_lrc_csb_irq(struct intel_engine_cs *engine)
 {
-	struct i915_priolist *p;
-	struct rb_node **parent, *rb;
-	bool first = true;
+	struct tasklet_struct *t = &engine->irq_tasklet;
 
-	if (unlikely(engine->no_priolist))
-		prio = I915_PRIORITY_NORMAL;
+	if (!engine->execlist_csb_hwsp || t->func != intel_lrc_irq_handler ||
+	    !tasklet_trylock(t))
+		goto schedule;
 
-find_priolist:
-	/* most positive priority is scheduled first, equal priorities fifo */
-	rb = NULL;
-	parent = &engine->execlist_queue.rb_node;
-	while (*parent) {
-		rb = *parent;
-		p = rb_entry(rb, typeof(*p), node);
-		if (prio > p->priority) {
-			parent = &rb->rb_left;
-		} else if (prio < p->priority) {
-			parent = &rb->rb_right;
-			first = false;
-		} else {
-			list_add_tail(&pt->link, &p->requests);
-			return false;
-		}
+	/* Disabled for a reset, or a preemption to unwind in the tasklet */
+	if (atomic_read(&t->count) || engine->execlist_preempt) {
+		tasklet_unlock(t);
+		goto schedule;
 	}
 
-	if (prio == I915_PRIORITY_NORMAL) {
-		p = &engine->default_priolist;
-	} else {
-		p = kmem_cache_alloc(engine->i915->priorities, GFP_ATOMIC);
-		/* Convert an allocation failure to a priority bump */
-		if (unlikely(!p)) {
-			prio = I915_PRIORITY_NORMAL; /* recurses just once */
+	execlists_process_csb(engine);
+	intel_engine_runtime_update(engine);
+	engine->execlist_csb_irq++;
 
-			/* To maintain ordering with all rendering, after an
-			 * allocation failure we have to disable all scheduling.
-			 * Requests will then be executed in fifo, and schedule
-			 * will ensure that dependencies are emitted in fifo.
-			 * There will be still some reordering with existing
-			 * requests, so if userspace lied about their
-			 * dependencies that reordering may be visible.
-			 */
-			engine->no_priolist = true;
-			goto find_priolist;
-		}
-	}
+	tasklet_unlock(t);
 
-	p->priority = prio;
-	rb_link_node(&p->node, rb, parent);
-	rb_insert_color(&p->node, &engine->execlist_queue);
+	/*
+	 * A submission racing with us failed to own the tasklet, and so
+	 * scheduled it; otherwise we only need it for the queue.
+	 */
+	if (!READ_ONCE(engine->execlist_first))
+		return;
 
-	INIT_LIST_HEAD(&p->requests);
-	list_add_tail(&pt->link, &p->requests);
+schedule:
+	tasklet_hi_schedule(t);
+}
 
-	if (first)
-		engine->execlist_first = &p->node;
+static bool execlists_direct_submit(struct intel_engine_cs *engine)
+{
+	struct tasklet_struct *t = &engine->irq_tasklet;
+	bool submitted = false;
 
-	return first;
+	/*
+	 * Owning the tasklet's RUN bit excludes intel_lrc_irq_handler(), so
+	 * with both ports empty and no CSB event outstanding we can do the
+	 * dequeue ourselves and save the softirq round trip. A disabled
+	 * tasklet means a reset is in progress; leave the ELSP alone.
+	 */
+	if (!tasklet_trylock(t))
+		return false;
+
+	if (!atomic_read(&t->count) &&
+	    !engine->execlist_preempt &&
+	    !port_isset(&engine->execlist_port[0]) &&
+	    !test_bit(ENGINE_IRQ_EXECLIST, &engine->irq_posted)) {
+		intel_uncore_forcewake_get(engine->i915, engine->fw_domains);
+		execlists_dequeue(engine);
+		intel_uncore_forcewake_put(engine->i915, engine->fw_domains);
+		intel_engine_runtime_update(engine);
+		engine->execlist_direct_submits++;
+		submitted = true;
+	}
+
+	tasklet_unlock(t);
+	return submitted;
 }
 
 static void execlists_submit_request(struct drm_i915_gem_request *request)
 {
 	struct intel_engine_cs *engine = request->engine;
 	unsigned long flags;
+	bool kick = false;
 
 	/* Will be called from irq-context when using foreign fences. */
 	spin_lock_irqsave(&engine->timeline->lock, flags);
@@ -704,14 +1147,28 @@ static void execlists_submit_request(struct drm_i915_gem_request *request)
 	if (insert_request(engine,
 			   &request->priotree,
 			   request->priotree.priority)) {
-		if (execlists_elsp_ready(engine))
-			tasklet_hi_schedule(&engine->irq_tasklet);
+		if (execlists_elsp_ready(engine) || can_preempt(engine))
+			kick = true;
 	}
 
 	GEM_BUG_ON(!engine->execlist_first);
 	GEM_BUG_ON(list_empty(&request->priotree.link));
 
 	spin_unlock_irqrestore(&engine->timeline->lock, flags);
+
+	if (!kick)
+		return;
+
+	/*
+	 * execlists_dequeue() uses spin_lock_irq(), so only submit directly
+	 * if we were called with interrupts enabled.
+	 */
+	if (i915.execlists_direct_submit && !in_irq() &&
+	    !irqs_disabled_flags(flags) &&
+	    execlists_direct_submit(engine))
+		return;
+
+	tasklet_hi_schedule(&engine->irq_tasklet);
 }
 
 static struct intel_engine_cs *
@@ -810,13 +1267,14 @@ static void execlists_schedule(struct drm_i915_gem_request *request, int prio)
 		pt->priority = prio;
 		if (!list_empty(&pt->link)) {
 			__list_del_entry(&pt->link);
-			insert_request(engine, pt, prio);
+			/* Kick the tasklet to see if we should preempt */
+			if (insert_request(engine, pt, prio) &&
+			    can_preempt(engine))
+				tasklet_hi_schedule(&engine->irq_tasklet);
 		}
 	}
 
 	spin_unlock_irq(&engine->timeline->lock);
-
-	/* XXX Do we need to preempt to make room for us and our deps? */
 }
 
 static struct intel_ring *
@@ -1268,6 +1726,20 @@ static int gen8_init_common_ring(struct intel_engine_cs *engine)
 		   GT_CONTEXT_SWITCH_INTERRUPT << engine->irq_shift);
 	clear_bit(ENGINE_IRQ_EXECLIST, &engine->irq_posted);
 
+	/* The host has republished the CSB after resetting it. */
+	if (engine->execlist_csb_shared)
+		engine->execlist_csb_head = GEN8_CSB_READ_PTR(
+			READ_ONCE(engine->execlist_csb_shared->csb_ptr));
+
+	/* The HWSP mirror is only rewritten on the next event, resync it */
+	if (engine->execlist_csb_hwsp) {
+		u32 ptr = I915_READ(RING_CONTEXT_STATUS_PTR(engine));
+
+		engine->execlist_csb_head = GEN8_CSB_READ_PTR(ptr);
+		WRITE_ONCE(engine->status_page.page_addr[I915_HWS_CSB_WRITE_INDEX],
+			   GEN8_CSB_WRITE_PTR(ptr));
+	}
+
 	/* After a GPU reset, we may have requests to replay */
 	submit = false;
 	for (n = 0; n < ARRAY_SIZE(engine->execlist_port); n++) {
@@ -1286,6 +1758,9 @@ static int gen8_init_common_ring(struct intel_engine_cs *engine)
 	if (submit && !i915.enable_guc_submission)
 		execlists_submit_ports(engine);
 
+	/* A reset may have dropped whatever was executing */
+	intel_engine_runtime_update(engine);
+
 	return 0;
 }
 
@@ -1337,7 +1812,14 @@ static void reset_common_ring(struct intel_engine_cs *engine,
 	 * often trashed across a GPU reset! Instead we have to rely on
 	 * guessing the missed context-switch events by looking at what
 	 * requests were completed.
+	 *
+	 * A preemption that was in flight is simply forgotten, the ports
+	 * still describe what was running before it.
 	 */
+	engine->execlist_preempt = false;
+	engine->execlist_preempt_rotate = false;
+	engine->execlist_timeslice_expired = false;
+
 	if (!request) {
 		for (n = 0; n < ARRAY_SIZE(engine->execlist_port); n++)
 			i915_gem_request_put(port_request(&port[n]));
@@ -1444,16 +1926,25 @@ static int gen8_emit_bb_start(struct drm_i915_gem_request *req,
 		req->ctx->ppgtt->pd_dirty_rings &= ~intel_engine_flag(req->engine);
 	}
 
-	cs = intel_ring_begin(req, 4);
+	cs = intel_ring_begin(req, 6);
 	if (IS_ERR(cs))
 		return PTR_ERR(cs);
 
+	/*
+	 * Allow the batch to be preempted at its arbitration points, but keep
+	 * arbitration off for the rest of the request so that we only switch
+	 * away mid-batch or at the MI_ARB_CHECK in the wa tail.
+	 */
+	*cs++ = MI_ARB_ON_OFF | MI_ARB_ENABLE;
+
 	/* FIXME(BDW): Address space and security selectors. */
 	*cs++ = MI_BATCH_BUFFER_START_GEN8 |
 		(flags & I915_DISPATCH_SECURE ? 0 : BIT(8)) |
 		(flags & I915_DISPATCH_RS ? MI_BATCH_RESOURCE_STREAMER : 0);
 	*cs++ = lower_32_bits(offset);
 	*cs++ = upper_32_bits(offset);
+
+	*cs++ = MI_ARB_ON_OFF | MI_ARB_DISABLE;
 	*cs++ = MI_NOOP;
 	intel_ring_advance(req, cs);
 
@@ -1583,7 +2074,8 @@ static int gen8_emit_flush_render(struct drm_i915_gem_request *request,
  */
 static void gen8_emit_wa_tail(struct drm_i915_gem_request *request, u32 *cs)
 {
-	*cs++ = MI_NOOP;
+	/* Ensure there's always at least one preemption point per-request. */
+	*cs++ = MI_ARB_CHECK;
 	*cs++ = MI_NOOP;
 	request->wa_tail = intel_ring_offset(request, cs);
 }
@@ -1598,7 +2090,7 @@ static void gen8_emit_breadcrumb(struct drm_i915_gem_request *request, u32 *cs)
 	*cs++ = 0;
 	*cs++ = request->global_seqno;
 	*cs++ = MI_USER_INTERRUPT;
-	*cs++ = MI_NOOP;
+	*cs++ = MI_ARB_ON_OFF | MI_ARB_ENABLE;
 	request->tail = intel_ring_offset(request, cs);
 	assert_ring_tail_valid(request->ring, request->tail);
 
@@ -1626,7 +2118,7 @@ static void gen8_emit_breadcrumb_render(struct drm_i915_gem_request *request,
 	/* We're thrashing one dword of HWS. */
 	*cs++ = 0;
 	*cs++ = MI_USER_INTERRUPT;
-	*cs++ = MI_NOOP;
+	*cs++ = MI_ARB_ON_OFF | MI_ARB_ENABLE;
 	request->tail = intel_ring_offset(request, cs);
 	assert_ring_tail_valid(request->ring, request->tail);
 
@@ -1668,6 +2160,7 @@ void intel_logical_ring_cleanup(struct intel_engine_cs *engine)
 	 */
 	if (WARN_ON(test_bit(TASKLET_STATE_SCHED, &engine->irq_tasklet.state)))
 		tasklet_kill(&engine->irq_tasklet);
+	del_timer_sync(&engine->execlist_timeslice);
 
 	dev_priv = engine->i915;
 
@@ -1772,8 +2265,18 @@ logical_ring_setup(struct intel_engine_cs *engine)
 
 	engine->fw_domains = fw_domains;
 
+	if (dev_priv->vgpu.shared_page && engine->id < VGT_SHARED_PAGE_ENGINES)
+		engine->execlist_csb_shared =
+			&dev_priv->vgpu.shared_page->engine[engine->id];
+	else if (INTEL_GEN(dev_priv) >= 9 && !intel_vgpu_active(dev_priv) &&
+		 !intel_vtd_active())
+		/* With VT-d the HWSP update may land after the interrupt */
+		engine->execlist_csb_hwsp = true;
+
 	tasklet_init(&engine->irq_tasklet,
 		     intel_lrc_irq_handler, (unsigned long)engine);
+	setup_timer(&engine->execlist_timeslice,
+		    execlists_timeslice_expired, (unsigned long)engine);
 
 	logical_ring_default_vfuncs(engine);
 	logical_ring_default_irqs(engine);
@@ -2132,3 +2635,7 @@ void intel_lr_context_resume(struct drm_i915_private *dev_priv)
 		}
 	}
 }
+
+#if IS_ENABLED(CONFIG_DRM_I915_SELFTEST)
+#include "selftests/intel_lrc.c"
+#endif
@@ -336,9 +336,8 @@ static void intel_enable_source_psr2(struct intel_dp *intel_dp)
 
 	val = idle_frames << EDP_PSR_IDLE_FRAME_SHIFT;
 
-	/* FIXME: selective update is probably totally broken because it doesn't
-	 * mesh at all with our frontbuffer tracking. And the hw alone isn't
-	 * good enough. */
+	/* Selective update tracking only covers plane updates, so
+	 * intel_psr_flush() still exits PSR for frontbuffer rendering. */
 	val |= EDP_PSR2_ENABLE |
 		EDP_SU_TRACK_ENABLE |
 		EDP_FRAMES_BEFORE_SU_ENTRY;
@@ -919,8 +918,14 @@ void intel_psr_flush(struct drm_i915_private *dev_priv,
 	frontbuffer_bits &= INTEL_FRONTBUFFER_ALL_MASK(pipe);
 	dev_priv->psr.busy_frontbuffer_bits &= ~frontbuffer_bits;
 
-	/* By definition flush = invalidate + flush */
-	if (frontbuffer_bits)
+	/*
+	 * By definition flush = invalidate + flush.  A flip is a plane
+	 * update the PSR2 selective update tracking sees, so the hardware
+	 * sends the changed lines itself and the panel can stay in PSR.
+	 * Frontbuffer rendering isn't tracked and needs a full exit.
+	 */
+	if (frontbuffer_bits &&
+	    !(dev_priv->psr.psr2_support && origin == ORIGIN_FLIP))
 		intel_psr_exit(dev_priv);
 
 	if (!dev_priv->psr.active && !dev_priv->psr.busy_frontbuffer_bits)
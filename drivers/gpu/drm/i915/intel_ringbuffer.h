@@ -126,6 +126,19 @@ struct intel_engine_hangcheck {
 	bool stalled;
 };
 
+/*
+ * A kernel request sent down a busy engine every heartbeat_interval_ms.
+ * A beat that has not run after one interval is raised to
+ * heartbeat_priority, and one that still has not run an interval later
+ * gets the engine reset.
+ */
+struct intel_engine_heartbeat {
+	struct delayed_work work;
+	struct drm_i915_gem_request *systole;
+	unsigned long beats;
+	unsigned long resets;
+};
+
 struct intel_ring {
 	struct i915_vma *vma;
 	void *vaddr;
@@ -165,6 +178,7 @@ struct i915_ctx_workarounds {
 
 struct drm_i915_gem_request;
 struct intel_render_state;
+struct vgt_shared_engine;
 
 /*
  * Engine IDs definitions.
@@ -391,6 +405,37 @@ struct intel_engine_cs {
 	} execlist_port[2];
 	struct rb_root execlist_queue;
 	struct rb_node *execlist_first;
+	unsigned long execlist_direct_submits;
+	/* CSB mirrored by GVT-g into guest memory, NULL on real hardware */
+	struct vgt_shared_engine *execlist_csb_shared;
+	/* CSB read from its mirror in the HWSP instead of through mmio */
+	bool execlist_csb_hwsp;
+	unsigned int execlist_csb_head;
+	/* Context switches fully handled from the interrupt handler */
+	unsigned long execlist_csb_irq;
+
+	/* Preemption through the preempt context, see intel_lrc.c */
+	bool execlist_preempt;
+	bool execlist_preempt_rotate;
+	bool execlist_timeslice_expired;
+	struct timer_list execlist_timeslice;
+	ktime_t execlist_preempt_start;
+	struct {
+		unsigned long count;
+		unsigned long timeslices;
+		u64 total_ns;
+		u64 max_ns;
+	} execlist_preempt_stats;
+
+	/*
+	 * Busy-time accounting: the request in port[0] is charged for the
+	 * time it spends there, see intel_engine_runtime_update().
+	 */
+	struct {
+		spinlock_t lock;
+		struct drm_i915_gem_request *active;
+		ktime_t start;
+	} runtime;
 	unsigned int fw_domains;
 
 	/* Contexts are pinned whilst they are active on the GPU. The last
@@ -416,6 +461,7 @@ struct intel_engine_cs {
 	struct atomic_notifier_head context_status_notifier;
 
 	struct intel_engine_hangcheck hangcheck;
+	struct intel_engine_heartbeat heartbeat;
 
 	bool needs_cmd_parser;
 
@@ -442,6 +488,15 @@ struct intel_engine_cs {
 	 * certain bits to encode the command length in the header).
 	 */
 	u32 (*get_cmd_length_mask)(u32 cmd_header);
+
+	/*
+	 * Small MRU cache of batch contents that have already passed the
+	 * command parser, so that repeated batches skip the scan.
+	 * Protected by struct_mutex.
+	 */
+	struct list_head cmd_cache;
+	unsigned int cmd_cache_count;
+	unsigned long cmd_cache_hits;
 };
 
 static inline unsigned int
@@ -486,12 +541,14 @@ intel_write_status_page(struct intel_engine_cs *engine, int reg, u32 value)
  * 0x04: ring 0 head pointer
  * 0x05: ring 1 head pointer (915-class)
  * 0x06: ring 2 head pointer (915-class)
- * 0x10-0x1b: Context status DWords (GM45)
- * 0x1f: Last written status offset. (GM45)
+ * 0x10-0x1b: Context status DWords (GM45, and the CSB on Gen8+)
+ * 0x1f: Last written status offset. (GM45, CSB write pointer on Gen8+)
  * 0x20-0x2f: Reserved (Gen6+)
  *
  * The area from dword 0x30 to 0x3ff is available for driver usage.
  */
+#define I915_HWS_CSB_BUF0_INDEX		0x10
+#define I915_HWS_CSB_WRITE_INDEX	0x1f
 #define I915_GEM_HWS_INDEX		0x30
 #define I915_GEM_HWS_INDEX_ADDR (I915_GEM_HWS_INDEX << MI_STORE_DWORD_INDEX_SHIFT)
 #define I915_GEM_HWS_SCRATCH_INDEX	0x40
@@ -597,6 +654,12 @@ int intel_engine_init_common(struct intel_engine_cs *engine);
 int intel_engine_create_scratch(struct intel_engine_cs *engine, int size);
 void intel_engine_cleanup_common(struct intel_engine_cs *engine);
 
+void intel_engine_runtime_update(struct intel_engine_cs *engine);
+void intel_engine_runtime_retire(struct intel_engine_cs *engine,
+				 struct drm_i915_gem_request *rq);
+u64 intel_engine_context_runtime(struct intel_engine_cs *engine,
+				 struct i915_gem_context *ctx);
+
 int intel_init_render_ring_buffer(struct intel_engine_cs *engine);
 int intel_init_bsd_ring_buffer(struct intel_engine_cs *engine);
 int intel_init_blt_ring_buffer(struct intel_engine_cs *engine);
@@ -3192,6 +3192,68 @@ void intel_runtime_pm_put(struct drm_i915_private *dev_priv)
 	pm_runtime_put_autosuspend(kdev);
 }
 
+/*
+ * Bounds of the autosuspend delay.  A device that is resumed within the
+ * delay of being suspended would have stayed awake through that idle
+ * period with twice the delay, so the delay is doubled.  It is halved
+ * when the device then stays suspended for much longer than the delay,
+ * to suspend sooner when the GPU is used sparsely.
+ */
+#define RPM_AUTOSUSPEND_MIN_MS	250
+#define RPM_AUTOSUSPEND_MAX_MS	10000
+#define RPM_AUTOSUSPEND_SHRINK	8
+
+/**
+ * intel_runtime_pm_suspended - account a runtime suspend
+ * @dev_priv: i915 device instance
+ *
+ * Called at the end of a successful runtime suspend.
+ */
+void intel_runtime_pm_suspended(struct drm_i915_private *dev_priv)
+{
+	dev_priv->pm.suspended_at = ktime_get();
+	dev_priv->pm.suspend_count++;
+}
+
+/**
+ * intel_runtime_pm_resumed - account a runtime resume, adapt the delay
+ * @dev_priv: i915 device instance
+ * @start: time the resume started
+ *
+ * Called at the end of a successful runtime resume.
+ */
+void intel_runtime_pm_resumed(struct drm_i915_private *dev_priv, ktime_t start)
+{
+	struct i915_runtime_pm *pm = &dev_priv->pm;
+	struct device *kdev = &dev_priv->drm.pdev->dev;
+	s64 residency_ms = ktime_ms_delta(start, pm->suspended_at);
+	u64 latency = ktime_to_ns(ktime_sub(ktime_get(), start));
+	int delay = pm->autosuspend_ms;
+
+	pm->suspended_ns += ktime_to_ns(ktime_sub(start, pm->suspended_at));
+	pm->resume_ns += latency;
+	if (latency > pm->resume_ns_max)
+		pm->resume_ns_max = latency;
+
+	if (residency_ms < delay) {
+		pm->short_suspends++;
+		delay = min(delay * 2, RPM_AUTOSUSPEND_MAX_MS);
+	} else if (residency_ms > RPM_AUTOSUSPEND_SHRINK * delay) {
+		delay = max(delay / 2, RPM_AUTOSUSPEND_MIN_MS);
+	}
+
+#ifdef CONFIG_PM
+	/* Leave a delay set through power/autosuspend_delay_ms alone */
+	if (kdev->power.autosuspend_delay != pm->autosuspend_ms)
+		return;
+#endif
+
+	if (delay != pm->autosuspend_ms) {
+		pm->autosuspend_ms = delay;
+		pm_runtime_set_autosuspend_delay(kdev, delay);
+	}
+}
+
 /**
  * intel_runtime_pm_enable - enable runtime pm
  * @dev_priv: i915 device instance
@@ -3207,7 +3269,8 @@ void intel_runtime_pm_enable(struct drm_i915_private *dev_priv)
 	struct pci_dev *pdev = dev_priv->drm.pdev;
 	struct device *kdev = &pdev->dev;
 
-	pm_runtime_set_autosuspend_delay(kdev, 10000); /* 10s */
+	dev_priv->pm.autosuspend_ms = RPM_AUTOSUSPEND_MAX_MS;
+	pm_runtime_set_autosuspend_delay(kdev, dev_priv->pm.autosuspend_ms);
 	pm_runtime_mark_last_busy(kdev);
 
 	/*
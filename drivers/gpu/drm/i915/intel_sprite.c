@@ -201,6 +201,16 @@ void intel_pipe_update_end(struct intel_crtc *crtc)
 		crtc->base.state->event = NULL;
 	}
 
+	/*
+	 * The plane registers are double buffered, so an update landing in
+	 * the same frame as the previous one simply replaces it before the
+	 * hardware ever latches it.
+	 */
+	if (crtc->flip_stats.last_vbl_count &&
+	    crtc->flip_stats.last_vbl_count == end_vbl_count)
+		atomic_inc(&crtc->flip_stats.coalesced);
+	crtc->flip_stats.last_vbl_count = end_vbl_count;
+
 	local_irq_enable();
 
 	if (intel_vgpu_active(dev_priv))
@@ -214,6 +224,7 @@ void intel_pipe_update_end(struct intel_crtc *crtc)
 			  ktime_us_delta(end_vbl_time, crtc->debug.start_vbl_time),
 			  crtc->debug.min_vbl, crtc->debug.max_vbl,
 			  crtc->debug.scanline_start, scanline_end);
+		atomic_inc(&crtc->flip_stats.missed_vblanks);
 	}
 #ifdef CONFIG_DRM_I915_DEBUG_VBLANK_EVADE
 	else if (ktime_us_delta(end_vbl_time, crtc->debug.start_vbl_time) >
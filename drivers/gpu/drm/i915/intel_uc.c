@@ -69,6 +69,7 @@ void intel_uc_sanitize_options(struct drm_i915_private *dev_priv)
 
 		i915.enable_guc_loading = 0;
 		i915.enable_guc_submission = 0;
+		i915.enable_guc_ct = 0;
 		return;
 	}
 
@@ -92,6 +93,16 @@ void intel_uc_sanitize_options(struct drm_i915_private *dev_priv)
 	/* A negative value means "use platform default" */
 	if (i915.enable_guc_submission < 0)
 		i915.enable_guc_submission = HAS_GUC_SCHED(dev_priv);
+
+	/*
+	 * Allow CT based communication to be opted into on platforms that
+	 * don't default to it (gen9); everything else keys off HAS_GUC_CT.
+	 */
+	if (i915.enable_guc_ct < 0)
+		i915.enable_guc_ct = HAS_GUC_CT(dev_priv);
+	if (!i915.enable_guc_loading)
+		i915.enable_guc_ct = 0;
+	mkwrite_device_info(dev_priv)->has_guc_ct = !!i915.enable_guc_ct;
 }
 
 static void gen8_guc_raise_irq(struct intel_guc *guc)
@@ -390,6 +401,10 @@ int intel_uc_init_hw(struct drm_i915_private *dev_priv)
 	if (ret)
 		goto err_log_capture;
 
+	/* CT senders sleep until the GuC interrupts them with the response */
+	if (HAS_GUC_CT(dev_priv))
+		gen9_enable_guc_interrupts(dev_priv);
+
 	intel_guc_auth_huc(dev_priv);
 	if (i915.enable_guc_submission) {
 		if (i915.guc_log_level >= 0)
@@ -451,10 +466,11 @@ void intel_uc_fini_hw(struct drm_i915_private *dev_priv)
 
 	guc_disable_communication(&dev_priv->guc);
 
-	if (i915.enable_guc_submission) {
+	if (i915.enable_guc_submission || HAS_GUC_CT(dev_priv))
 		gen9_disable_guc_interrupts(dev_priv);
+
+	if (i915.enable_guc_submission)
 		i915_guc_submission_fini(dev_priv);
-	}
 
 	i915_ggtt_disable_guc(dev_priv);
 }
@@ -59,13 +59,26 @@ fw_domain_reset(struct drm_i915_private *i915,
 	__raw_i915_write32(i915, d->reg_set, i915->uncore.fw_reset);
 }
 
+/*
+ * Bounds of the delay between the last use of a domain and its release.
+ * The delay is doubled whenever a domain is woken again within it of its
+ * release, and halved when the domain then stays asleep for much longer,
+ * to keep the GT in RC6 when the register accesses are sparse.
+ */
+#define FW_HOLD_MIN_US		250
+#define FW_HOLD_DEFAULT_US	1000
+#define FW_HOLD_MAX_US		8000
+#define FW_HOLD_SHRINK		8
+
 static inline void
 fw_domain_arm_timer(struct intel_uncore_forcewake_domain *d)
 {
+	u64 hold_ns = (u64)d->hold_us * NSEC_PER_USEC;
+
 	d->wake_count++;
 	hrtimer_start_range_ns(&d->timer,
-			       NSEC_PER_MSEC,
-			       NSEC_PER_MSEC,
+			       hold_ns,
+			       hold_ns,
 			       HRTIMER_MODE_REL);
 }
 
@@ -138,6 +151,60 @@ fw_domains_put(struct drm_i915_private *i915, enum forcewake_domains fw_domains)
 	i915->uncore.fw_domains_active &= ~fw_domains;
 }
 
+static void
+fw_domains_wake(struct drm_i915_private *i915,
+		enum forcewake_domains fw_domains)
+{
+	struct intel_uncore_forcewake_domain *d;
+	ktime_t start, now;
+	unsigned int tmp;
+	u64 latency;
+
+	start = ktime_get();
+	i915->uncore.funcs.force_wake_get(i915, fw_domains);
+	now = ktime_get();
+	latency = ktime_to_ns(ktime_sub(now, start));
+
+	for_each_fw_domain_masked(d, fw_domains, i915, tmp) {
+		s64 idle_us = ktime_us_delta(start, d->released);
+
+		d->wakes++;
+		d->wake_ns += latency;
+		if (latency > d->wake_ns_max)
+			d->wake_ns_max = latency;
+		d->woken = now;
+
+		if (!d->released)
+			continue;
+
+		if (idle_us < d->hold_us) {
+			d->rewakes++;
+			d->hold_us = min_t(unsigned int, d->hold_us * 2,
+					  FW_HOLD_MAX_US);
+		} else if (idle_us > FW_HOLD_SHRINK * d->hold_us) {
+			d->hold_us = max_t(unsigned int, d->hold_us / 2,
+					  FW_HOLD_MIN_US);
+		}
+	}
+}
+
+static void
+fw_domains_release(struct drm_i915_private *i915,
+		   enum forcewake_domains fw_domains)
+{
+	struct intel_uncore_forcewake_domain *d;
+	unsigned int tmp;
+	ktime_t now;
+
+	i915->uncore.funcs.force_wake_put(i915, fw_domains);
+
+	now = ktime_get();
+	for_each_fw_domain_masked(d, fw_domains, i915, tmp) {
+		d->held_ns += ktime_to_ns(ktime_sub(now, d->woken));
+		d->released = now;
+	}
+}
+
 static void
 fw_domains_reset(struct drm_i915_private *i915,
 		 enum forcewake_domains fw_domains)
@@ -214,15 +281,20 @@ intel_uncore_fw_release_timer(struct hrtimer *timer)
 
 	assert_rpm_device_not_suspended(dev_priv);
 
-	if (xchg(&domain->active, false))
+	/* Used since the timer was armed, hold it for another period */
+	if (xchg(&domain->active, false)) {
+		hrtimer_forward_now(timer,
+				    ns_to_ktime((u64)domain->hold_us *
+						NSEC_PER_USEC));
 		return HRTIMER_RESTART;
+	}
 
 	spin_lock_irqsave(&dev_priv->uncore.lock, irqflags);
 	if (WARN_ON(domain->wake_count == 0))
 		domain->wake_count++;
 
 	if (--domain->wake_count == 0)
-		dev_priv->uncore.funcs.force_wake_put(dev_priv, domain->mask);
+		fw_domains_release(dev_priv, domain->mask);
 
 	spin_unlock_irqrestore(&dev_priv->uncore.lock, irqflags);
 
@@ -277,13 +349,13 @@ static void intel_uncore_forcewake_reset(struct drm_i915_private *dev_priv,
 
 	fw = dev_priv->uncore.fw_domains_active;
 	if (fw)
-		dev_priv->uncore.funcs.force_wake_put(dev_priv, fw);
+		fw_domains_release(dev_priv, fw);
 
 	fw_domains_reset(dev_priv, dev_priv->uncore.fw_domains);
 
 	if (restore) { /* If reset with a user forcewake, try to restore */
 		if (fw)
-			dev_priv->uncore.funcs.force_wake_get(dev_priv, fw);
+			fw_domains_wake(dev_priv, fw);
 
 		if (IS_GEN6(dev_priv) || IS_GEN7(dev_priv))
 			dev_priv->uncore.fifo_count =
@@ -432,6 +504,7 @@ void intel_uncore_resume_early(struct drm_i915_private *dev_priv)
 	iosf_mbi_register_pmic_bus_access_notifier(
 		&dev_priv->uncore.pmic_bus_access_nb);
 	i915_check_and_clear_faults(dev_priv);
+	i915_vgpu_register_shared_page(dev_priv);
 }
 
 void intel_uncore_sanitize(struct drm_i915_private *dev_priv)
@@ -458,7 +531,7 @@ static void __intel_uncore_forcewake_get(struct drm_i915_private *dev_priv,
 	}
 
 	if (fw_domains)
-		dev_priv->uncore.funcs.force_wake_get(dev_priv, fw_domains);
+		fw_domains_wake(dev_priv, fw_domains);
 }
 
 /**
@@ -870,7 +943,7 @@ static noinline void ___force_wake_auto(struct drm_i915_private *dev_priv,
 	for_each_fw_domain_masked(domain, fw_domains, dev_priv, tmp)
 		fw_domain_arm_timer(domain);
 
-	dev_priv->uncore.funcs.force_wake_get(dev_priv, fw_domains);
+	fw_domains_wake(dev_priv, fw_domains);
 }
 
 static inline void __force_wake_auto(struct drm_i915_private *dev_priv,
@@ -1037,6 +1110,7 @@ static void fw_domain_init(struct drm_i915_private *dev_priv,
 	WARN_ON(!i915_mmio_reg_valid(reg_ack));
 
 	d->wake_count = 0;
+	d->hold_us = FW_HOLD_DEFAULT_US;
 	d->reg_set = reg_set;
 	d->reg_ack = reg_ack;
 
@@ -1239,6 +1313,8 @@ void intel_uncore_fini(struct drm_i915_private *dev_priv)
 	/* Paranoia: make sure we have disabled everything before we exit. */
 	intel_uncore_sanitize(dev_priv);
 	intel_uncore_forcewake_reset(dev_priv, false);
+
+	i915_vgpu_fini(dev_priv);
 }
 
 #define GEN_RANGE(l, h) GENMASK((h) - 1, (l) - 1)
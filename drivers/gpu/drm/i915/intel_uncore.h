@@ -100,6 +100,18 @@ struct intel_uncore {
 		struct hrtimer timer;
 		i915_reg_t reg_set;
 		i915_reg_t reg_ack;
+
+		/* Release hold-off, adapted to how soon the domain is retaken */
+		unsigned int hold_us;
+		ktime_t woken;
+		ktime_t released;
+
+		/* Hardware wakes, and those soon after a release */
+		u64 wakes;
+		u64 rewakes;
+		u64 wake_ns;
+		u64 wake_ns_max;
+		u64 held_ns;
 	} fw_domain[FW_DOMAIN_ID_COUNT];
 
 	int unclaimed_mmio_check;
@@ -0,0 +1,497 @@
+/*
+ * Copyright © 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <linux/sizes.h>
+
+#include "../i915_selftest.h"
+
+#include "mock_context.h"
+#include "mock_drm.h"
+
+/* Each figure is reported on a line of its own, as
+ *
+ *	bench,<test>,<engine>,<metric>,<value>,<unit>
+ *
+ * so that a run can be collected with a grep of the kernel log and
+ * compared against the previous one. <engine> is "-" for the figures
+ * that are not tied to an engine.
+ */
+static void bench_report(const char *test, const char *engine,
+			 const char *metric, u64 value, const char *unit)
+{
+	pr_info("bench,%s,%s,%s,%llu,%s\n",
+		test, engine ?: "-", metric, value, unit);
+}
+
+static u64 bench_rate(u64 count, ktime_t dt)
+{
+	return div64_u64(count * NSEC_PER_SEC, max_t(u64, ktime_to_ns(dt), 1));
+}
+
+static int bench_begin(struct drm_i915_private *i915, unsigned int *resets)
+{
+	*resets = i915_reset_count(&i915->gpu_error);
+	return i915_gem_wait_for_idle(i915, I915_WAIT_LOCKED);
+}
+
+static int bench_end(struct drm_i915_private *i915, unsigned int resets,
+		     const char *test)
+{
+	int err;
+
+	err = i915_gem_wait_for_idle(i915, I915_WAIT_LOCKED);
+	if (err)
+		return err;
+
+	/* A figure taken across a reset measures the reset, not us */
+	if (resets != i915_reset_count(&i915->gpu_error)) {
+		pr_err("%s: GPU was reset during the benchmark\n", test);
+		return -EIO;
+	}
+
+	return 0;
+}
+
+static struct drm_i915_gem_request *
+bench_request(struct intel_engine_cs *engine, struct i915_gem_context *ctx)
+{
+	struct drm_i915_gem_request *rq;
+	int err;
+
+	rq = i915_gem_request_alloc(engine, ctx);
+	if (IS_ERR(rq))
+		return rq;
+
+	err = i915_switch_context(rq);
+	__i915_add_request(rq, err == 0);
+
+	return err ? ERR_PTR(err) : rq;
+}
+
+static int bench_request_throughput(void *arg)
+{
+	struct drm_i915_private *i915 = arg;
+	struct intel_engine_cs *engine;
+	unsigned int id, resets;
+	int err;
+
+	/* How many empty requests each engine retires per second, with
+	 * submission never waiting for the GPU other than for ring space.
+	 */
+
+	mutex_lock(&i915->drm.struct_mutex);
+
+	for_each_engine(engine, i915, id) {
+		struct drm_i915_gem_request *rq = NULL;
+		IGT_TIMEOUT(end_time);
+		unsigned long count = 0;
+		ktime_t dt;
+
+		err = bench_begin(i915, &resets);
+		if (err)
+			goto out_unlock;
+
+		dt = ktime_get_raw();
+		do {
+			if (rq)
+				i915_gem_request_put(rq);
+
+			rq = bench_request(engine, i915->kernel_context);
+			if (IS_ERR(rq)) {
+				err = PTR_ERR(rq);
+				goto out_unlock;
+			}
+			i915_gem_request_get(rq);
+			count++;
+		} while (!__igt_timeout(end_time, NULL));
+		i915_wait_request(rq, I915_WAIT_LOCKED, MAX_SCHEDULE_TIMEOUT);
+		dt = ktime_sub(ktime_get_raw(), dt);
+		i915_gem_request_put(rq);
+
+		err = bench_end(i915, resets, __func__);
+		if (err)
+			goto out_unlock;
+
+		bench_report("requests", engine->name, "throughput",
+			     bench_rate(count, dt), "req/s");
+	}
+
+out_unlock:
+	mutex_unlock(&i915->drm.struct_mutex);
+	return err;
+}
+
+static int bench_switch_pair(struct intel_engine_cs *engine,
+			     struct intel_engine_cs *other,
+			     struct i915_gem_context **ctx,
+			     const char *test, const char *name)
+{
+	struct drm_i915_private *i915 = engine->i915;
+	IGT_TIMEOUT(end_time);
+	unsigned long count = 0;
+	unsigned int resets;
+	ktime_t dt;
+	int err;
+
+	err = bench_begin(i915, &resets);
+	if (err)
+		return err;
+
+	/* Each request waits for the previous one, alternating between
+	 * the two contexts and, if @other is set, the two engines; so
+	 * the average time per request is the latency of the switch.
+	 */
+	dt = ktime_get_raw();
+	do {
+		struct intel_engine_cs *e = other && count & 1 ? other : engine;
+		struct drm_i915_gem_request *rq;
+
+		rq = bench_request(e, ctx[count & 1]);
+		if (IS_ERR(rq))
+			return PTR_ERR(rq);
+
+		i915_wait_request(rq, I915_WAIT_LOCKED, MAX_SCHEDULE_TIMEOUT);
+		count++;
+	} while (!__igt_timeout(end_time, NULL));
+	dt = ktime_sub(ktime_get_raw(), dt);
+
+	err = bench_end(i915, resets, test);
+	if (err)
+		return err;
+
+	bench_report(test, name, "latency",
+		     div64_u64(ktime_to_ns(dt), count), "ns");
+	return 0;
+}
+
+static int bench_context_switch(void *arg)
+{
+	struct drm_i915_private *i915 = arg;
+	struct intel_engine_cs *engine, *other;
+	struct i915_gem_context *ctx[2];
+	struct drm_file *file;
+	unsigned int id, oid;
+	char name[32];
+	int err = 0;
+
+	file = mock_file(i915);
+	if (IS_ERR(file))
+		return PTR_ERR(file);
+
+	mutex_lock(&i915->drm.struct_mutex);
+
+	ctx[0] = live_context(i915, file);
+	ctx[1] = live_context(i915, file);
+	if (IS_ERR(ctx[0]) || IS_ERR(ctx[1])) {
+		err = PTR_ERR(IS_ERR(ctx[0]) ? ctx[0] : ctx[1]);
+		goto out_unlock;
+	}
+
+	for_each_engine(engine, i915, id) {
+		err = bench_switch_pair(engine, NULL, ctx,
+					"context_switch", engine->name);
+		if (err)
+			goto out_unlock;
+	}
+
+	for_each_engine(engine, i915, id) {
+		for_each_engine(other, i915, oid) {
+			if (other == engine)
+				continue;
+
+			snprintf(name, sizeof(name), "%s:%s",
+				 engine->name, other->name);
+			err = bench_switch_pair(engine, other, ctx,
+						"engine_switch", name);
+			if (err)
+				goto out_unlock;
+		}
+	}
+
+out_unlock:
+	mutex_unlock(&i915->drm.struct_mutex);
+	mock_file_free(i915, file);
+	return err;
+}
+
+static struct i915_vma *bench_batch(struct drm_i915_private *i915)
+{
+	struct drm_i915_gem_object *obj;
+	struct i915_vma *vma;
+	u32 *cmd;
+	int err;
+
+	obj = i915_gem_object_create_internal(i915, PAGE_SIZE);
+	if (IS_ERR(obj))
+		return ERR_CAST(obj);
+
+	cmd = i915_gem_object_pin_map(obj, I915_MAP_WB);
+	if (IS_ERR(cmd)) {
+		err = PTR_ERR(cmd);
+		goto err;
+	}
+	*cmd = MI_BATCH_BUFFER_END;
+	i915_gem_object_unpin_map(obj);
+
+	err = i915_gem_object_set_to_gtt_domain(obj, false);
+	if (err)
+		goto err;
+
+	vma = i915_vma_instance(obj, &i915->ggtt.base, NULL);
+	if (IS_ERR(vma)) {
+		err = PTR_ERR(vma);
+		goto err;
+	}
+
+	err = i915_vma_pin(vma, 0, 0, PIN_USER | PIN_GLOBAL);
+	if (err)
+		goto err;
+
+	return vma;
+
+err:
+	i915_gem_object_put(obj);
+	return ERR_PTR(err);
+}
+
+/* Like the inner loop of i915_gem_do_execbuffer(): pin every object of
+ * the request, track it as active, and run the batch.
+ */
+static struct drm_i915_gem_request *
+bench_execbuf(struct intel_engine_cs *engine, struct i915_vma *batch,
+	      struct i915_vma **vma, unsigned int count)
+{
+	struct drm_i915_gem_request *rq;
+	unsigned int n;
+	int err = 0;
+
+	rq = i915_gem_request_alloc(engine, engine->i915->kernel_context);
+	if (IS_ERR(rq))
+		return rq;
+
+	for (n = 0; n < count; n++) {
+		err = i915_vma_pin(vma[n], 0, 0, PIN_USER);
+		if (err)
+			goto out_request;
+
+		i915_vma_move_to_active(vma[n], rq, 0);
+		i915_vma_unpin(vma[n]);
+	}
+
+	err = engine->emit_flush(rq, EMIT_INVALIDATE);
+	if (err)
+		goto out_request;
+
+	err = i915_switch_context(rq);
+	if (err)
+		goto out_request;
+
+	err = engine->emit_bb_start(rq, batch->node.start, batch->node.size,
+				    I915_DISPATCH_SECURE);
+
+out_request:
+	__i915_add_request(rq, err == 0);
+	return err ? ERR_PTR(err) : rq;
+}
+
+static int bench_execbuf_objects(void *arg)
+{
+	static const unsigned int counts[] = { 1, 16, 128, 1024 };
+	struct drm_i915_private *i915 = arg;
+	struct i915_gem_context *ctx = i915->kernel_context;
+	struct i915_address_space *vm =
+		ctx->ppgtt ? &ctx->ppgtt->base : &i915->ggtt.base;
+	struct intel_engine_cs *engine = i915->engine[RCS];
+	struct drm_i915_gem_object *obj, *on;
+	struct i915_vma *batch, **vma;
+	unsigned int i, n, resets;
+	LIST_HEAD(objects);
+	char metric[32];
+	int err = 0;
+
+	/* Execbuf rate by the number of objects in the request. The ioctl
+	 * itself is not driven: the user copies and relocations are not
+	 * what grows with the object count, the reservation is.
+	 */
+
+	vma = kmalloc_array(counts[ARRAY_SIZE(counts) - 1], sizeof(*vma),
+			    GFP_KERNEL);
+	if (!vma)
+		return -ENOMEM;
+
+	mutex_lock(&i915->drm.struct_mutex);
+
+	batch = bench_batch(i915);
+	if (IS_ERR(batch)) {
+		err = PTR_ERR(batch);
+		goto out_unlock;
+	}
+
+	for (n = 0; n < counts[ARRAY_SIZE(counts) - 1]; n++) {
+		obj = i915_gem_object_create_internal(i915, PAGE_SIZE);
+		if (IS_ERR(obj)) {
+			err = PTR_ERR(obj);
+			goto out_objects;
+		}
+		list_add_tail(&obj->st_link, &objects);
+
+		vma[n] = i915_vma_instance(obj, vm, NULL);
+		if (IS_ERR(vma[n])) {
+			err = PTR_ERR(vma[n]);
+			goto out_objects;
+		}
+	}
+
+	for (i = 0; i < ARRAY_SIZE(counts); i++) {
+		struct drm_i915_gem_request *rq = NULL;
+		IGT_TIMEOUT(end_time);
+		unsigned long count = 0;
+		ktime_t dt;
+
+		err = bench_begin(i915, &resets);
+		if (err)
+			goto out_objects;
+
+		dt = ktime_get_raw();
+		do {
+			if (rq)
+				i915_gem_request_put(rq);
+
+			rq = bench_execbuf(engine, batch, vma, counts[i]);
+			if (IS_ERR(rq)) {
+				err = PTR_ERR(rq);
+				goto out_objects;
+			}
+			i915_gem_request_get(rq);
+			count++;
+		} while (!__igt_timeout(end_time, NULL));
+		i915_wait_request(rq, I915_WAIT_LOCKED, MAX_SCHEDULE_TIMEOUT);
+		dt = ktime_sub(ktime_get_raw(), dt);
+		i915_gem_request_put(rq);
+
+		err = bench_end(i915, resets, __func__);
+		if (err)
+			goto out_objects;
+
+		snprintf(metric, sizeof(metric), "throughput_%u_objects",
+			 counts[i]);
+		bench_report("execbuf", engine->name, metric,
+			     bench_rate(count, dt), "execbuf/s");
+	}
+
+out_objects:
+	i915_gem_wait_for_idle(i915, I915_WAIT_LOCKED);
+	list_for_each_entry_safe(obj, on, &objects, st_link) {
+		list_del(&obj->st_link);
+		i915_gem_object_put(obj);
+	}
+	i915_vma_unpin(batch);
+	i915_vma_put(batch);
+out_unlock:
+	mutex_unlock(&i915->drm.struct_mutex);
+	kfree(vma);
+	return err;
+}
+
+static int bench_ggtt_bind(void *arg)
+{
+	static const unsigned int sizes[] = { SZ_4K, SZ_64K, SZ_2M };
+	struct drm_i915_private *i915 = arg;
+	unsigned int i;
+	int err = 0;
+
+	/* GGTT PTE writes per second, bind and unbind of one object at a
+	 * time for a few object sizes. The pages stay pinned, so only the
+	 * drm_mm insertion and the PTE updates are measured.
+	 */
+
+	mutex_lock(&i915->drm.struct_mutex);
+	intel_runtime_pm_get(i915);
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		struct drm_i915_gem_object *obj;
+		IGT_TIMEOUT(end_time);
+		unsigned long count = 0;
+		struct i915_vma *vma;
+		char metric[32];
+		ktime_t dt;
+
+		obj = i915_gem_object_create_internal(i915, sizes[i]);
+		if (IS_ERR(obj)) {
+			err = PTR_ERR(obj);
+			break;
+		}
+
+		err = i915_gem_object_pin_pages(obj);
+		if (err)
+			goto out_put;
+
+		vma = i915_vma_instance(obj, &i915->ggtt.base, NULL);
+		if (IS_ERR(vma)) {
+			err = PTR_ERR(vma);
+			goto out_unpin;
+		}
+
+		dt = ktime_get_raw();
+		do {
+			err = i915_vma_pin(vma, 0, 0, PIN_GLOBAL);
+			if (err)
+				goto out_unpin;
+			i915_vma_unpin(vma);
+
+			err = i915_vma_unbind(vma);
+			if (err)
+				goto out_unpin;
+			count++;
+		} while (!__igt_timeout(end_time, NULL));
+		dt = ktime_sub(ktime_get_raw(), dt);
+
+		snprintf(metric, sizeof(metric), "bind_%uKiB", sizes[i] >> 10);
+		bench_report("ggtt", NULL, metric,
+			     bench_rate((u64)count * (sizes[i] >> PAGE_SHIFT), dt),
+			     "pages/s");
+
+out_unpin:
+		i915_gem_object_unpin_pages(obj);
+out_put:
+		i915_gem_object_put(obj);
+		if (err)
+			break;
+	}
+
+	intel_runtime_pm_put(i915);
+	mutex_unlock(&i915->drm.struct_mutex);
+	return err;
+}
+
+int i915_gem_bench_live_selftests(struct drm_i915_private *i915)
+{
+	static const struct i915_subtest tests[] = {
+		SUBTEST(bench_request_throughput),
+		SUBTEST(bench_context_switch),
+		SUBTEST(bench_execbuf_objects),
+		SUBTEST(bench_ggtt_bind),
+	};
+
+	return i915_subtests(tests, i915);
+}
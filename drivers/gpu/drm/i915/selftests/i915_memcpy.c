@@ -0,0 +1,184 @@
+/*
+ * Copyright © 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <linux/random.h>
+#include <asm/set_memory.h>
+
+#include "../i915_selftest.h"
+#include "i915_random.h"
+
+#define MEMCPY_ORDER 8 /* 1MiB, well past the caches of smaller parts */
+
+struct memcpy_variant {
+	const char *name;
+	void (*copy)(void *dst, const void *src, unsigned long len);
+	bool (*available)(void);
+};
+
+static void igt_memcpy_plain(void *dst, const void *src, unsigned long len)
+{
+	memcpy(dst, src, len);
+}
+
+static bool igt_always(void)
+{
+	return true;
+}
+
+#ifdef CONFIG_AS_MOVNTDQA
+static bool igt_has_movntdqa(void)
+{
+	return static_branch_likely(&has_movntdqa);
+}
+
+#ifdef CONFIG_AS_AVX2
+static bool igt_has_movntdqa_avx2(void)
+{
+	return static_branch_likely(&has_movntdqa_avx2);
+}
+#endif
+#endif
+
+static const struct memcpy_variant variants[] = {
+	{ "memcpy", igt_memcpy_plain, igt_always },
+#ifdef CONFIG_AS_MOVNTDQA
+	{ "sse4.1", __memcpy_ntdqa, igt_has_movntdqa },
+#ifdef CONFIG_AS_AVX2
+	{ "avx2", __memcpy_ntdqa_avx2, igt_has_movntdqa_avx2 },
+#endif
+#endif
+};
+
+static int igt_memcpy_check(const struct memcpy_variant *v,
+			    void *dst, const void *src, unsigned long size,
+			    struct rnd_state *prng)
+{
+	unsigned int n;
+
+	/* Cover the 16 byte leading slot and every tail of the avx2 loop */
+	for (n = 0; n < 64; n++) {
+		unsigned long offset = 16 * (prandom_u32_state(prng) % 4);
+		unsigned long len;
+
+		len = 16 * (prandom_u32_state(prng) % ((size - offset) / 16));
+		if (n < 16)
+			len = 16 * n;
+
+		memset(dst, 0xc5, size);
+		v->copy(dst + offset, src + offset, len);
+
+		if (memcmp(dst + offset, src + offset, len)) {
+			pr_err("%s: mismatch copying %lu bytes at offset %lu\n",
+			       v->name, len, offset);
+			return -EINVAL;
+		}
+		if (len + offset < size &&
+		    memchr_inv(dst + offset + len, 0xc5,
+			       size - offset - len)) {
+			pr_err("%s: overrun copying %lu bytes at offset %lu\n",
+			       v->name, len, offset);
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+static void igt_memcpy_bench(const struct memcpy_variant *v,
+			     void *dst, const void *src, unsigned long size)
+{
+	IGT_TIMEOUT(end_time);
+	unsigned long count = 0;
+	ktime_t t0, t1;
+	u64 ns;
+
+	t0 = ktime_get();
+	do {
+		v->copy(dst, src, size);
+		count++;
+	} while (!time_after(jiffies, end_time));
+	t1 = ktime_get();
+
+	ns = max_t(u64, ktime_to_ns(ktime_sub(t1, t0)), 1);
+	pr_info("%s: %lu copies of %luKiB from WC, %llu MiB/s\n",
+		v->name, count, size >> 10,
+		div64_u64((u64)count * size * NSEC_PER_SEC, ns) >> 20);
+}
+
+static int igt_memcpy_from_wc(void *ignored)
+{
+	const unsigned long size = PAGE_SIZE << MEMCPY_ORDER;
+	I915_RND_STATE(prng);
+	struct page *page;
+	void *src, *dst;
+	unsigned int i;
+	int err = 0;
+
+	page = alloc_pages(GFP_KERNEL, MEMCPY_ORDER);
+	if (!page)
+		return -ENOMEM;
+	src = page_address(page);
+
+	dst = (void *)__get_free_pages(GFP_KERNEL, MEMCPY_ORDER);
+	if (!dst) {
+		err = -ENOMEM;
+		goto err_src;
+	}
+
+	prandom_bytes_state(&prng, src, size);
+	if (set_memory_wc((unsigned long)src, 1 << MEMCPY_ORDER)) {
+		err = -ENODEV;
+		goto err_dst;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(variants); i++) {
+		const struct memcpy_variant *v = &variants[i];
+
+		if (!v->available()) {
+			pr_info("%s: not supported by this CPU\n", v->name);
+			continue;
+		}
+
+		err = igt_memcpy_check(v, dst, src, size, &prng);
+		if (err)
+			break;
+
+		igt_memcpy_bench(v, dst, src, size);
+	}
+
+	set_memory_wb((unsigned long)src, 1 << MEMCPY_ORDER);
+err_dst:
+	free_pages((unsigned long)dst, MEMCPY_ORDER);
+err_src:
+	__free_pages(page, MEMCPY_ORDER);
+	return err;
+}
+
+int i915_memcpy_mock_selftests(void)
+{
+	static const struct i915_subtest tests[] = {
+		SUBTEST(igt_memcpy_from_wc),
+	};
+
+	return i915_subtests(tests, NULL);
+}
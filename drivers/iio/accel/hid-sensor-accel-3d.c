@@ -228,16 +228,10 @@ static const struct iio_info accel_3d_info = {
 	.driver_module = THIS_MODULE,
 	.read_raw = &accel_3d_read_raw,
 	.write_raw = &accel_3d_write_raw,
+	.hwfifo_set_watermark = hid_sensor_set_watermark,
+	.hwfifo_flush_to_buffer = hid_sensor_flush_to_buffer,
 };
 
-/* Function to push data to buffer */
-static void hid_sensor_push_data(struct iio_dev *indio_dev, void *data,
-				 int len, int64_t timestamp)
-{
-	dev_dbg(&indio_dev->dev, "hid_sensor_push_data\n");
-	iio_push_to_buffers_with_timestamp(indio_dev, data, timestamp);
-}
-
 /* Callback handler to send event after all samples are received and captured */
 static int accel_3d_proc_event(struct hid_sensor_hub_device *hsdev,
 				unsigned usage_id,
@@ -251,10 +245,9 @@ static int accel_3d_proc_event(struct hid_sensor_hub_device *hsdev,
 		if (!accel_state->timestamp)
 			accel_state->timestamp = iio_get_time_ns(indio_dev);
 
-		hid_sensor_push_data(indio_dev,
-				     accel_state->accel_val,
-				     sizeof(accel_state->accel_val),
-				     accel_state->timestamp);
+		hid_sensor_push(&accel_state->common_attributes, indio_dev,
+				accel_state->accel_val,
+				accel_state->timestamp);
 
 		accel_state->timestamp = 0;
 	}
@@ -230,6 +230,106 @@ static int hid_sensor_data_rdy_trigger_set_state(struct iio_trigger *trig,
 	return hid_sensor_power_state(iio_trigger_get_drvdata(trig), state);
 }
 
+/* Upper bound of the scans batched in a report burst */
+#define HID_SENSOR_BATCH_MAX	64
+
+/* Called with batch_lock held */
+static unsigned int __hid_sensor_flush(struct iio_dev *indio_dev,
+				       struct hid_sensor_common *st)
+{
+	unsigned int count = st->batch_count;
+
+	if (count)
+		iio_push_to_buffers_n(indio_dev, st->batch, count);
+	st->batch_count = 0;
+	return count;
+}
+
+/**
+ * hid_sensor_push() - push a scan to the buffers of a sensor
+ * @st:		common attributes of the sensor
+ * @indio_dev:	iio device of the sensor
+ * @data:	full scan, with room for the timestamp
+ * @timestamp:	timestamp of the scan
+ *
+ * With a buffer watermark above 1, scans are collected and pushed all at
+ * once when the watermark is reached, so a burst of reports out of the
+ * hub FIFO wakes the reader up once.  Readers that can't wait get the
+ * pending scans through the hwfifo_flush_to_buffer callback.
+ */
+int hid_sensor_push(struct hid_sensor_common *st, struct iio_dev *indio_dev,
+		    void *data, int64_t timestamp)
+{
+	unsigned long flags;
+	void *scan;
+	int ret = 0;
+
+	spin_lock_irqsave(&st->batch_lock, flags);
+	if (st->batch_watermark <= 1 || !st->batch) {
+		ret = iio_push_to_buffers_with_timestamp(indio_dev, data,
+							 timestamp);
+		goto out;
+	}
+
+	scan = st->batch + st->batch_count++ * indio_dev->scan_bytes;
+	memcpy(scan, data, indio_dev->scan_bytes);
+	if (indio_dev->scan_timestamp)
+		((int64_t *)scan)[indio_dev->scan_bytes / sizeof(int64_t) - 1] =
+			timestamp;
+
+	if (st->batch_count >= st->batch_watermark)
+		__hid_sensor_flush(indio_dev, st);
+out:
+	spin_unlock_irqrestore(&st->batch_lock, flags);
+	return ret;
+}
+EXPORT_SYMBOL(hid_sensor_push);
+
+/* The hwfifo_set_watermark callback of sensors using hid_sensor_push() */
+int hid_sensor_set_watermark(struct iio_dev *indio_dev, unsigned int val)
+{
+	struct hid_sensor_common *st = iio_device_get_drvdata(indio_dev);
+	u8 *batch = NULL, *old;
+	unsigned long flags;
+
+	val = min_t(unsigned int, val, HID_SENSOR_BATCH_MAX);
+	if (val > 1) {
+		batch = kmalloc_array(val, indio_dev->scan_bytes, GFP_KERNEL);
+		if (!batch)
+			return -ENOMEM;
+	}
+
+	/*
+	 * Called as the buffers are enabled, when the scan layout may just
+	 * have changed: scans still held back from before are dropped.
+	 */
+	spin_lock_irqsave(&st->batch_lock, flags);
+	st->batch_count = 0;
+	old = st->batch;
+	st->batch = batch;
+	st->batch_watermark = val;
+	spin_unlock_irqrestore(&st->batch_lock, flags);
+
+	kfree(old);
+	return 0;
+}
+EXPORT_SYMBOL(hid_sensor_set_watermark);
+
+/* The hwfifo_flush_to_buffer callback of sensors using hid_sensor_push() */
+int hid_sensor_flush_to_buffer(struct iio_dev *indio_dev, unsigned int count)
+{
+	struct hid_sensor_common *st = iio_device_get_drvdata(indio_dev);
+	unsigned long flags;
+	unsigned int flushed;
+
+	spin_lock_irqsave(&st->batch_lock, flags);
+	flushed = __hid_sensor_flush(indio_dev, st);
+	spin_unlock_irqrestore(&st->batch_lock, flags);
+
+	return flushed;
+}
+EXPORT_SYMBOL(hid_sensor_flush_to_buffer);
+
 void hid_sensor_remove_trigger(struct hid_sensor_common *attrb)
 {
 	pm_runtime_disable(&attrb->pdev->dev);
@@ -239,6 +339,7 @@ void hid_sensor_remove_trigger(struct hid_sensor_common *attrb)
 	cancel_work_sync(&attrb->work);
 	iio_trigger_unregister(attrb->trigger);
 	iio_trigger_free(attrb->trigger);
+	kfree(attrb->batch);
 }
 EXPORT_SYMBOL(hid_sensor_remove_trigger);
 
@@ -281,6 +382,7 @@ int hid_sensor_setup_trigger(struct iio_dev *indio_dev, const char *name,
 	iio_device_set_drvdata(indio_dev, attrb);
 
 	INIT_WORK(&attrb->work, hid_sensor_set_power_work);
+	spin_lock_init(&attrb->batch_lock);
 
 	pm_suspend_ignore_children(&attrb->pdev->dev, true);
 	pm_runtime_enable(&attrb->pdev->dev);
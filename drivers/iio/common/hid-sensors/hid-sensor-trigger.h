@@ -28,5 +28,9 @@ int hid_sensor_setup_trigger(struct iio_dev *indio_dev, const char *name,
 				struct hid_sensor_common *attrb);
 void hid_sensor_remove_trigger(struct hid_sensor_common *attrb);
 int hid_sensor_power_state(struct hid_sensor_common *st, bool state);
+int hid_sensor_push(struct hid_sensor_common *st, struct iio_dev *indio_dev,
+		    void *data, int64_t timestamp);
+int hid_sensor_set_watermark(struct iio_dev *indio_dev, unsigned int val);
+int hid_sensor_flush_to_buffer(struct iio_dev *indio_dev, unsigned int count);
 
 #endif
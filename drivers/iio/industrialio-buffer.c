@@ -1368,12 +1368,18 @@ static const void *iio_demux(struct iio_buffer *buffer,
 	return buffer->demux_bounce;
 }
 
-static int iio_push_to_buffer(struct iio_buffer *buffer, const void *data)
+static int iio_store_to_buffer(struct iio_buffer *buffer, const void *data)
 {
 	const void *dataout = iio_demux(buffer, data);
+
+	return buffer->access->store_to(buffer, dataout);
+}
+
+static int iio_push_to_buffer(struct iio_buffer *buffer, const void *data)
+{
 	int ret;
 
-	ret = buffer->access->store_to(buffer, dataout);
+	ret = iio_store_to_buffer(buffer, data);
 	if (ret)
 		return ret;
 
@@ -1405,6 +1411,39 @@ int iio_push_to_buffers(struct iio_dev *indio_dev, const void *data)
 }
 EXPORT_SYMBOL_GPL(iio_push_to_buffers);
 
+/**
+ * iio_push_to_buffers_n() - push several scans to the registered buffers
+ * @indio_dev:		iio_dev structure for device.
+ * @data:		@n full scans, each indio_dev->scan_bytes long.
+ * @n:			Number of scans.
+ *
+ * Readers are woken up once, after all the scans were stored.
+ */
+int iio_push_to_buffers_n(struct iio_dev *indio_dev, const void *data,
+			  unsigned int n)
+{
+	struct iio_buffer *buf;
+	unsigned int i;
+	int ret = 0;
+
+	list_for_each_entry(buf, &indio_dev->buffer_list, buffer_list) {
+		for (i = 0; i < n; i++) {
+			ret = iio_store_to_buffer(buf,
+					data + i * indio_dev->scan_bytes);
+			if (ret < 0)
+				break;
+		}
+		if (i)
+			wake_up_interruptible_poll(&buf->pollq,
+						   POLLIN | POLLRDNORM);
+		if (ret < 0)
+			return ret;
+	}
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(iio_push_to_buffers_n);
+
 /**
  * iio_buffer_release() - Free a buffer's resources
  * @ref: Pointer to the kref embedded in the iio_buffer struct
@@ -59,6 +59,11 @@ struct evdev_client {
 	unsigned int clk_type;
 	bool revoked;
 	unsigned long *evmasks[EV_CNT];
+	struct input_event_ring *ring; /* shared with the reader once mapped */
+	unsigned int ring_size;
+	unsigned int ring_head; /* next event to write to the ring */
+	unsigned int ring_packet_head; /* head published to the reader */
+	bool ring_dropped; /* SYN_DROPPED has to be queued to the ring */
 	unsigned int bufsize;
 	struct input_event buffer[];
 };
@@ -117,6 +122,10 @@ static void __evdev_flush_queue(struct evdev_client *client, unsigned int type)
 
 	BUG_ON(type == EV_SYN);
 
+	/* the reader may look at the ring at any time, leave it alone */
+	if (client->ring)
+		return;
+
 	head = client->tail;
 	client->packet_head = client->tail;
 
@@ -158,6 +167,11 @@ static void __evdev_queue_syn_dropped(struct evdev_client *client)
 	struct input_event ev;
 	ktime_t time;
 
+	if (client->ring) {
+		client->ring_dropped = true;
+		return;
+	}
+
 	time = client->clk_type == EV_CLK_REAL ?
 			ktime_get_real() :
 			client->clk_type == EV_CLK_MONO ?
@@ -255,6 +269,53 @@ static void __pass_event(struct evdev_client *client,
 	}
 }
 
+/*
+ * Queue an event to the mapped ring of @client.  The reader owns the
+ * tail of the ring, so an event that does not fit drops the packet being
+ * queued instead of the oldest events.
+ */
+static void __evdev_ring_pass_event(struct evdev_client *client,
+				    const struct input_event *event)
+{
+	struct input_event_ring *ring = client->ring;
+	unsigned int mask = client->ring_size - 1;
+	unsigned int tail = smp_load_acquire(&ring->tail);
+
+	if (client->ring_dropped &&
+	    client->ring_head == client->ring_packet_head &&
+	    client->ring_head - tail < client->ring_size) {
+		ring->events[client->ring_head & mask].time = event->time;
+		ring->events[client->ring_head & mask].type = EV_SYN;
+		ring->events[client->ring_head & mask].code = SYN_DROPPED;
+		ring->events[client->ring_head & mask].value = 0;
+		client->ring_head++;
+		client->ring_dropped = false;
+	}
+
+	if (client->ring_dropped ||
+	    client->ring_head - tail >= client->ring_size) {
+		client->ring_head = client->ring_packet_head;
+		client->ring_dropped = true;
+		return;
+	}
+
+	ring->events[client->ring_head++ & mask] = *event;
+
+	if (event->type == EV_SYN && event->code == SYN_REPORT) {
+		/* publish the events of the packet along with the head */
+		client->ring_packet_head = client->ring_head;
+		smp_store_release(&ring->head, client->ring_head);
+		kill_fasync(&client->fasync, SIGIO, POLL_IN);
+	}
+}
+
+static bool evdev_ring_has_packet(struct evdev_client *client)
+{
+	struct input_event_ring *ring = client->ring;
+
+	return READ_ONCE(ring->head) != READ_ONCE(ring->tail);
+}
+
 static void evdev_pass_values(struct evdev_client *client,
 			const struct input_value *vals, unsigned int count,
 			ktime_t *ev_time)
@@ -278,7 +339,9 @@ static void evdev_pass_values(struct evdev_client *client,
 
 		if (v->type == EV_SYN && v->code == SYN_REPORT) {
 			/* drop empty SYN_REPORT */
-			if (client->packet_head == client->head)
+			if (client->ring ?
+			    client->ring_head == client->ring_packet_head :
+			    client->packet_head == client->head)
 				continue;
 
 			wakeup = true;
@@ -287,7 +350,10 @@ static void evdev_pass_values(struct evdev_client *client,
 		event.type = v->type;
 		event.code = v->code;
 		event.value = v->value;
-		__pass_event(client, &event);
+		if (client->ring)
+			__evdev_ring_pass_event(client, &event);
+		else
+			__pass_event(client, &event);
 	}
 
 	spin_unlock(&client->buffer_lock);
@@ -306,7 +372,7 @@ static void evdev_events(struct input_handle *handle,
 	struct evdev_client *client;
 	ktime_t ev_time[EV_CLK_MAX];
 
-	ev_time[EV_CLK_MONO] = ktime_get();
+	ev_time[EV_CLK_MONO] = input_get_timestamp(handle->dev);
 	ev_time[EV_CLK_REAL] = ktime_mono_to_real(ev_time[EV_CLK_MONO]);
 	ev_time[EV_CLK_BOOT] = ktime_mono_to_any(ev_time[EV_CLK_MONO],
 						 TK_OFFS_BOOT);
@@ -477,6 +543,7 @@ static int evdev_release(struct inode *inode, struct file *file)
 	for (i = 0; i < EV_CNT; ++i)
 		kfree(client->evmasks[i]);
 
+	vfree(client->ring);
 	kvfree(client);
 
 	evdev_close_device(evdev);
@@ -599,6 +666,10 @@ static ssize_t evdev_read(struct file *file, char __user *buffer,
 		if (!evdev->exist || client->revoked)
 			return -ENODEV;
 
+		/* events go to the mapped ring only */
+		if (READ_ONCE(client->ring))
+			return -EBUSY;
+
 		if (client->packet_head == client->tail &&
 		    (file->f_flags & O_NONBLOCK))
 			return -EAGAIN;
@@ -625,7 +696,8 @@ static ssize_t evdev_read(struct file *file, char __user *buffer,
 		if (!(file->f_flags & O_NONBLOCK)) {
 			error = wait_event_interruptible(evdev->wait,
 					client->packet_head != client->tail ||
-					!evdev->exist || client->revoked);
+					!evdev->exist || client->revoked ||
+					READ_ONCE(client->ring));
 			if (error)
 				return error;
 		}
@@ -648,12 +720,77 @@ static unsigned int evdev_poll(struct file *file, poll_table *wait)
 	else
 		mask = POLLHUP | POLLERR;
 
-	if (client->packet_head != client->tail)
+	if (READ_ONCE(client->ring) ? evdev_ring_has_packet(client) :
+	    client->packet_head != client->tail)
 		mask |= POLLIN | POLLRDNORM;
 
 	return mask;
 }
 
+/*
+ * Map the event ring of the client, see struct input_event_ring.  The
+ * ring is sized from the length of the mapping.
+ */
+static int evdev_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct evdev_client *client = file->private_data;
+	struct evdev *evdev = client->evdev;
+	unsigned long len = vma->vm_end - vma->vm_start;
+	struct input_event_ring *ring;
+	unsigned int size;
+	int error;
+
+	/* the ring holds native events only */
+	if (input_event_size() != sizeof(struct input_event))
+		return -EINVAL;
+
+	if (vma->vm_pgoff || !(vma->vm_flags & VM_SHARED) ||
+	    len < sizeof(*ring) || len > INT_MAX)
+		return -EINVAL;
+
+	size = (len - sizeof(*ring)) / sizeof(struct input_event);
+	if (size < client->bufsize)
+		return -EINVAL;
+	size = rounddown_pow_of_two(size);
+
+	ring = vmalloc_user(len);
+	if (!ring)
+		return -ENOMEM;
+	ring->size = size;
+
+	error = mutex_lock_interruptible(&evdev->mutex);
+	if (error)
+		goto err_free_ring;
+
+	if (client->ring) {
+		error = -EBUSY;
+		goto err_unlock;
+	}
+
+	error = remap_vmalloc_range(vma, ring, 0);
+	if (error)
+		goto err_unlock;
+
+	/* events queued until now are dropped along with the read() buffer */
+	spin_lock_irq(&client->buffer_lock);
+	client->ring_size = size;
+	client->ring_head = client->ring_packet_head = 0;
+	client->ring_dropped = client->head != client->tail;
+	client->packet_head = client->head = client->tail;
+	WRITE_ONCE(client->ring, ring);
+	spin_unlock_irq(&client->buffer_lock);
+	wake_up_interruptible(&evdev->wait);
+
+	mutex_unlock(&evdev->mutex);
+	return 0;
+
+ err_unlock:
+	mutex_unlock(&evdev->mutex);
+ err_free_ring:
+	vfree(ring);
+	return error;
+}
+
 #ifdef CONFIG_COMPAT
 
 #define BITS_PER_LONG_COMPAT (sizeof(compat_long_t) * 8)
@@ -1324,6 +1461,7 @@ static const struct file_operations evdev_fops = {
 	.read		= evdev_read,
 	.write		= evdev_write,
 	.poll		= evdev_poll,
+	.mmap		= evdev_mmap,
 	.open		= evdev_open,
 	.release	= evdev_release,
 	.unlocked_ioctl	= evdev_ioctl,
@@ -137,9 +137,14 @@ static void input_pass_values(struct input_dev *dev,
 	if (!count)
 		return;
 
+	dev->num_events += count;
+	dev->num_frames++;
+
 	rcu_read_lock();
 
 	handle = rcu_dereference(dev->grab);
+	if (!handle)
+		handle = rcu_dereference(dev->only_handle);
 	if (handle) {
 		count = input_to_handler(handle, vals, count);
 	} else {
@@ -400,6 +405,7 @@ static void input_handle_event(struct input_dev *dev,
 		if (dev->num_vals >= 2)
 			input_pass_values(dev, dev->vals, dev->num_vals);
 		dev->num_vals = 0;
+		dev->timestamp = 0;
 	} else if (dev->num_vals >= dev->max_vals - 2) {
 		dev->vals[dev->num_vals++] = input_value_sync;
 		input_pass_values(dev, dev->vals, dev->num_vals);
@@ -583,6 +589,28 @@ EXPORT_SYMBOL(input_release_device);
  * This function should be called by input handlers when they
  * want to start receive events from given input device.
  */
+/*
+ * Track the handle of devices with a single open handle, the common case
+ * of a device read by one evdev client.  Called with dev->mutex held,
+ * before synchronize_rcu() when a handle is closed.
+ */
+static void input_update_only_handle(struct input_dev *dev)
+{
+	struct input_handle *handle, *only = NULL;
+
+	list_for_each_entry(handle, &dev->h_list, d_node) {
+		if (!handle->open)
+			continue;
+		if (only) {
+			only = NULL;
+			break;
+		}
+		only = handle;
+	}
+
+	rcu_assign_pointer(dev->only_handle, only);
+}
+
 int input_open_device(struct input_handle *handle)
 {
 	struct input_dev *dev = handle->dev;
@@ -605,12 +633,15 @@ int input_open_device(struct input_handle *handle)
 	if (retval) {
 		dev->users--;
 		if (!--handle->open) {
+			input_update_only_handle(dev);
 			/*
 			 * Make sure we are not delivering any more events
 			 * through this handle
 			 */
 			synchronize_rcu();
 		}
+	} else {
+		input_update_only_handle(dev);
 	}
 
  out:
@@ -655,6 +686,7 @@ void input_close_device(struct input_handle *handle)
 		dev->close(dev);
 
 	if (!--handle->open) {
+		input_update_only_handle(dev);
 		/*
 		 * synchronize_rcu() makes sure that input_pass_event()
 		 * completed and that no more input events are delivered
@@ -717,6 +749,7 @@ static void input_disconnect_device(struct input_dev *dev)
 
 	list_for_each_entry(handle, &dev->h_list, d_node)
 		handle->open = 0;
+	rcu_assign_pointer(dev->only_handle, NULL);
 
 	spin_unlock_irq(&dev->event_lock);
 }
@@ -1494,10 +1527,41 @@ static const struct attribute_group input_dev_caps_attr_group = {
 	.attrs	= input_dev_caps_attrs,
 };
 
+#define INPUT_DEV_STATS_ATTR(name)					\
+static ssize_t input_dev_show_stats_##name(struct device *dev,		\
+					   struct device_attribute *attr, \
+					   char *buf)			\
+{									\
+	struct input_dev *input_dev = to_input_dev(dev);		\
+	u64 val;							\
+									\
+	spin_lock_irq(&input_dev->event_lock);				\
+	val = input_dev->num_##name;					\
+	spin_unlock_irq(&input_dev->event_lock);			\
+									\
+	return scnprintf(buf, PAGE_SIZE, "%llu\n", val);		\
+}									\
+static DEVICE_ATTR(name, S_IRUGO, input_dev_show_stats_##name, NULL)
+
+INPUT_DEV_STATS_ATTR(events);
+INPUT_DEV_STATS_ATTR(frames);
+
+static struct attribute *input_dev_stats_attrs[] = {
+	&dev_attr_events.attr,
+	&dev_attr_frames.attr,
+	NULL
+};
+
+static const struct attribute_group input_dev_stats_attr_group = {
+	.name	= "stats",
+	.attrs	= input_dev_stats_attrs,
+};
+
 static const struct attribute_group *input_dev_attr_groups[] = {
 	&input_dev_attr_group,
 	&input_dev_id_attr_group,
 	&input_dev_caps_attr_group,
+	&input_dev_stats_attr_group,
 	NULL
 };
 
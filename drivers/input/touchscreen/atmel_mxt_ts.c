@@ -272,6 +272,7 @@ static const struct v4l2_file_operations mxt_video_fops = {
 struct mxt_data {
 	struct i2c_client *client;
 	struct input_dev *input_dev;
+	ktime_t irq_time;
 	char phys[64];		/* device physical location */
 	const struct mxt_platform_data *pdata;
 	struct mxt_object *object_table;
@@ -1116,10 +1117,22 @@ static irqreturn_t mxt_process_messages(struct mxt_data *data)
 	return IRQ_HANDLED;
 }
 
+/* Record when the touch was reported, the thread may run much later */
+static irqreturn_t mxt_hard_interrupt(int irq, void *dev_id)
+{
+	struct mxt_data *data = dev_id;
+
+	data->irq_time = ktime_get();
+	return IRQ_WAKE_THREAD;
+}
+
 static irqreturn_t mxt_interrupt(int irq, void *dev_id)
 {
 	struct mxt_data *data = dev_id;
 
+	if (data->input_dev)
+		input_set_timestamp(data->input_dev, data->irq_time);
+
 	if (data->in_bootloader) {
 		/* bootloader state transition completion */
 		complete(&data->bl_completion);
@@ -3144,7 +3157,7 @@ static int mxt_probe(struct i2c_client *client, const struct i2c_device_id *id)
 	}
 
 	error = devm_request_threaded_irq(&client->dev, client->irq,
-					  NULL, mxt_interrupt,
+					  mxt_hard_interrupt, mxt_interrupt,
 					  pdata->irqflags | IRQF_ONESHOT,
 					  client->name, data);
 	if (error) {
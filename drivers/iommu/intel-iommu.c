@@ -46,6 +46,7 @@
 #include <linux/memblock.h>
 #include <linux/dma-contiguous.h>
 #include <linux/crash_dump.h>
+#include <linux/seq_file.h>
 #include <asm/irq_remapping.h>
 #include <asm/cacheflush.h>
 #include <asm/iommu.h>
@@ -488,6 +489,18 @@ static int intel_iommu_ecs = 1;
 static int intel_iommu_pasid28;
 static int iommu_identity_mapping;
 
+/* Deferred unmaps per CPU that force an IOTLB flush, and their timeout */
+static unsigned int intel_iommu_fq_batch = IOVA_FQ_BATCH;
+static unsigned int intel_iommu_fq_timeout = IOVA_FQ_TIMEOUT;
+
+static struct {
+	atomic64_t	queued;		/* unmaps deferred to a flush queue */
+	atomic64_t	flushes;	/* domain flushes of the queues */
+	atomic64_t	flush_ns;
+	atomic64_t	strict;		/* unmaps flushed synchronously */
+	atomic64_t	strict_ns;
+} intel_iommu_flush_stats;
+
 #define IDENTMAP_ALL		1
 #define IDENTMAP_GFX		2
 #define IDENTMAP_AZALIA		4
@@ -571,6 +584,17 @@ static int __init intel_iommu_setup(char *str)
 		} else if (!strncmp(str, "strict", 6)) {
 			pr_info("Disable batched IOTLB flush\n");
 			intel_iommu_strict = 1;
+		} else if (!strncmp(str, "fq_batch=", 9)) {
+			intel_iommu_fq_batch = clamp_t(unsigned int,
+					simple_strtoul(str + 9, NULL, 0),
+					1, IOVA_FQ_BATCH);
+			pr_info("Flush IOTLB every %u deferred unmaps\n",
+				intel_iommu_fq_batch);
+		} else if (!strncmp(str, "fq_timeout=", 11)) {
+			intel_iommu_fq_timeout = max_t(unsigned int,
+					simple_strtoul(str + 11, NULL, 0), 1);
+			pr_info("Flush deferred unmaps after %u ms\n",
+				intel_iommu_fq_timeout);
 		} else if (!strncmp(str, "sp_off", 6)) {
 			pr_info("Disable supported super page\n");
 			intel_iommu_superpage = 0;
@@ -1610,6 +1634,7 @@ static void iommu_flush_iotlb_psi(struct intel_iommu *iommu,
 static void iommu_flush_iova(struct iova_domain *iovad)
 {
 	struct dmar_domain *domain;
+	u64 start = ktime_get_ns();
 	int idx;
 
 	domain = container_of(iovad, struct dmar_domain, iovad);
@@ -1624,6 +1649,9 @@ static void iommu_flush_iova(struct iova_domain *iovad)
 			iommu_flush_dev_iotlb(get_iommu_domain(iommu, did),
 					      0, MAX_AGAW_PFN_WIDTH);
 	}
+
+	atomic64_inc(&intel_iommu_flush_stats.flushes);
+	atomic64_add(ktime_get_ns() - start, &intel_iommu_flush_stats.flush_ns);
 }
 
 static void iommu_disable_protect_mem_regions(struct intel_iommu *iommu)
@@ -1945,6 +1973,8 @@ static int domain_init(struct dmar_domain *domain, struct intel_iommu *iommu,
 				    iommu_flush_iova, iova_entry_free);
 	if (err)
 		return err;
+	domain->iovad.fq_batch = intel_iommu_fq_batch;
+	domain->iovad.fq_timeout = intel_iommu_fq_timeout;
 
 	domain_reserve_special_ranges(domain);
 
@@ -3683,12 +3713,18 @@ static void intel_unmap(struct device *dev, dma_addr_t dev_addr, size_t size)
 	freelist = domain_unmap(domain, start_pfn, last_pfn);
 
 	if (intel_iommu_strict) {
+		u64 start = ktime_get_ns();
+
 		iommu_flush_iotlb_psi(iommu, domain, start_pfn,
 				      nrpages, !freelist, 0);
+		atomic64_inc(&intel_iommu_flush_stats.strict);
+		atomic64_add(ktime_get_ns() - start,
+			     &intel_iommu_flush_stats.strict_ns);
 		/* free iova */
 		free_iova_fast(&domain->iovad, iova_pfn, dma_to_mm_pfn(nrpages));
 		dma_free_pagelist(freelist);
 	} else {
+		atomic64_inc(&intel_iommu_flush_stats.queued);
 		queue_iova(&domain->iovad, iova_pfn, nrpages,
 			   (unsigned long)freelist);
 		/*
@@ -4724,6 +4760,58 @@ const struct attribute_group *intel_iommu_groups[] = {
 	NULL,
 };
 
+static u64 intel_iommu_avg(atomic64_t *ns, atomic64_t *count)
+{
+	u64 n = atomic64_read(count);
+
+	return n ? div64_u64(atomic64_read(ns), n) : 0;
+}
+
+static int intel_iommu_flush_show(struct seq_file *m, void *unused)
+{
+	u64 queued = atomic64_read(&intel_iommu_flush_stats.queued);
+	u64 flushes = atomic64_read(&intel_iommu_flush_stats.flushes);
+
+	seq_printf(m, "strict          : %d\n", intel_iommu_strict);
+	seq_printf(m, "fq_batch        : %u\n", intel_iommu_fq_batch);
+	seq_printf(m, "fq_timeout_ms   : %u\n", intel_iommu_fq_timeout);
+	seq_printf(m, "queued_unmaps   : %llu\n", queued);
+	seq_printf(m, "queue_flushes   : %llu\n", flushes);
+	seq_printf(m, "unmaps_per_flush: %llu\n",
+		   flushes ? div64_u64(queued, flushes) : 0);
+	seq_printf(m, "queue_flush_ns  : %llu avg\n",
+		   intel_iommu_avg(&intel_iommu_flush_stats.flush_ns,
+				   &intel_iommu_flush_stats.flushes));
+	seq_printf(m, "strict_flushes  : %llu\n",
+		   (u64)atomic64_read(&intel_iommu_flush_stats.strict));
+	seq_printf(m, "strict_flush_ns : %llu avg\n",
+		   intel_iommu_avg(&intel_iommu_flush_stats.strict_ns,
+				   &intel_iommu_flush_stats.strict));
+	return 0;
+}
+
+static int intel_iommu_flush_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, intel_iommu_flush_show, NULL);
+}
+
+static const struct file_operations intel_iommu_flush_fops = {
+	.open		= intel_iommu_flush_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void __init intel_iommu_debugfs_init(void)
+{
+	struct dentry *dir = debugfs_create_dir("intel_iommu", NULL);
+
+	if (IS_ERR_OR_NULL(dir))
+		return;
+	debugfs_create_file("iotlb_flush", 0444, dir, NULL,
+			    &intel_iommu_flush_fops);
+}
+
 int __init intel_iommu_init(void)
 {
 	int ret = -ENODEV;
@@ -4820,6 +4908,7 @@ int __init intel_iommu_init(void)
 		register_memory_notifier(&intel_iommu_memory_nb);
 	cpuhp_setup_state(CPUHP_IOMMU_INTEL_DEAD, "iommu/intel:dead", NULL,
 			  intel_iommu_cpu_dead);
+	intel_iommu_debugfs_init();
 	intel_iommu_enabled = 1;
 
 	return 0;
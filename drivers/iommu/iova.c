@@ -48,10 +48,12 @@ init_iova_domain(struct iova_domain *iovad, unsigned long granule,
 
 	spin_lock_init(&iovad->iova_rbtree_lock);
 	iovad->rbroot = RB_ROOT;
+	iovad->cached_node = NULL;
 	iovad->cached32_node = NULL;
 	iovad->granule = granule;
 	iovad->start_pfn = start_pfn;
 	iovad->dma_32bit_pfn = pfn_32bit + 1;
+	iovad->max32_alloc_size = iovad->dma_32bit_pfn;
 	iovad->flush_cb = NULL;
 	iovad->fq = NULL;
 	init_iova_rcaches(iovad);
@@ -89,6 +91,8 @@ int init_iova_flush_queue(struct iova_domain *iovad,
 
 	iovad->flush_cb   = flush_cb;
 	iovad->entry_dtor = entry_dtor;
+	iovad->fq_batch   = IOVA_FQ_BATCH;
+	iovad->fq_timeout = IOVA_FQ_TIMEOUT;
 
 	for_each_possible_cpu(cpu) {
 		struct iova_fq *fq;
@@ -107,40 +111,59 @@ int init_iova_flush_queue(struct iova_domain *iovad,
 }
 EXPORT_SYMBOL_GPL(init_iova_flush_queue);
 
+/*
+ * The space above the node cached for a limit has already been handed
+ * out, so the backwards walk starts below it.  Allocations above 32 bits
+ * get their own cached node, or each of them would walk down from the
+ * top of the tree past every live 64-bit range.
+ */
 static struct rb_node *
 __get_cached_rbnode(struct iova_domain *iovad, unsigned long *limit_pfn)
 {
-	if ((*limit_pfn > iovad->dma_32bit_pfn) ||
-		(iovad->cached32_node == NULL))
+	struct rb_node *cached;
+	struct iova *curr_iova;
+
+	if (*limit_pfn > iovad->dma_32bit_pfn)
+		cached = iovad->cached_node;
+	else
+		cached = iovad->cached32_node;
+
+	if (!cached)
 		return rb_last(&iovad->rbroot);
-	else {
-		struct rb_node *prev_node = rb_prev(iovad->cached32_node);
-		struct iova *curr_iova =
-			rb_entry(iovad->cached32_node, struct iova, node);
-		*limit_pfn = curr_iova->pfn_lo;
-		return prev_node;
-	}
+
+	curr_iova = rb_entry(cached, struct iova, node);
+	*limit_pfn = min(*limit_pfn, curr_iova->pfn_lo);
+	return rb_prev(cached);
 }
 
 static void
 __cached_rbnode_insert_update(struct iova_domain *iovad,
 	unsigned long limit_pfn, struct iova *new)
 {
-	if (limit_pfn != iovad->dma_32bit_pfn)
-		return;
-	iovad->cached32_node = &new->node;
+	if (limit_pfn == iovad->dma_32bit_pfn)
+		iovad->cached32_node = &new->node;
+	else if (limit_pfn > iovad->dma_32bit_pfn)
+		iovad->cached_node = &new->node;
 }
 
 static void
 __cached_rbnode_delete_update(struct iova_domain *iovad, struct iova *free)
 {
 	struct iova *cached_iova;
-	struct rb_node *curr;
 
-	if (!iovad->cached32_node)
+	/* A 32-bit range was freed, so the next failed size may fit again */
+	if (free->pfn_lo < iovad->dma_32bit_pfn)
+		iovad->max32_alloc_size = iovad->dma_32bit_pfn;
+
+	if (iovad->cached_node) {
+		cached_iova = rb_entry(iovad->cached_node, struct iova, node);
+		if (free->pfn_lo >= cached_iova->pfn_lo)
+			iovad->cached_node = rb_next(&free->node);
+	}
+
+	if (!iovad->cached32_node || free->pfn_lo >= iovad->dma_32bit_pfn)
 		return;
-	curr = iovad->cached32_node;
-	cached_iova = rb_entry(curr, struct iova, node);
+	cached_iova = rb_entry(iovad->cached32_node, struct iova, node);
 
 	if (free->pfn_lo >= cached_iova->pfn_lo) {
 		struct rb_node *node = rb_next(&free->node);
@@ -204,6 +227,15 @@ static int __alloc_and_insert_iova_range(struct iova_domain *iovad,
 	/* Walk the tree backwards */
 	spin_lock_irqsave(&iovad->iova_rbtree_lock, flags);
 	saved_pfn = limit_pfn;
+
+	/*
+	 * Don't walk the whole 32-bit space again for a size it could not
+	 * fit last time, until a 32-bit range is freed.
+	 */
+	if (limit_pfn <= iovad->dma_32bit_pfn &&
+	    size >= iovad->max32_alloc_size)
+		goto iova32_full;
+
 	curr = __get_cached_rbnode(iovad, &limit_pfn);
 	prev = curr;
 	while (curr) {
@@ -227,8 +259,9 @@ static int __alloc_and_insert_iova_range(struct iova_domain *iovad,
 		if (size_aligned)
 			pad_size = iova_get_pad_size(size, limit_pfn);
 		if ((iovad->start_pfn + size + pad_size) > limit_pfn) {
-			spin_unlock_irqrestore(&iovad->iova_rbtree_lock, flags);
-			return -ENOMEM;
+			if (saved_pfn == iovad->dma_32bit_pfn)
+				iovad->max32_alloc_size = size;
+			goto iova32_full;
 		}
 	}
 
@@ -244,6 +277,10 @@ static int __alloc_and_insert_iova_range(struct iova_domain *iovad,
 
 
 	return 0;
+
+iova32_full:
+	spin_unlock_irqrestore(&iovad->iova_rbtree_lock, flags);
+	return -ENOMEM;
 }
 
 static struct kmem_cache *iova_cache;
@@ -479,10 +516,12 @@ EXPORT_SYMBOL_GPL(free_iova_fast);
 #define fq_ring_for_each(i, fq) \
 	for ((i) = (fq)->head; (i) != (fq)->tail; (i) = ((i) + 1) % IOVA_FQ_SIZE)
 
-static inline bool fq_full(struct iova_fq *fq)
+static inline bool fq_full(struct iova_domain *iovad, struct iova_fq *fq)
 {
+	unsigned used = (fq->tail + IOVA_FQ_SIZE - fq->head) % IOVA_FQ_SIZE;
+
 	assert_spin_locked(&fq->lock);
-	return (((fq->tail + 1) % IOVA_FQ_SIZE) == fq->head);
+	return used >= min_t(unsigned, iovad->fq_batch, IOVA_FQ_BATCH);
 }
 
 static inline unsigned fq_ring_add(struct iova_fq *fq)
@@ -583,7 +622,7 @@ void queue_iova(struct iova_domain *iovad,
 	 */
 	fq_ring_free(iovad, fq);
 
-	if (fq_full(fq)) {
+	if (fq_full(iovad, fq)) {
 		iova_domain_flush(iovad);
 		fq_ring_free(iovad, fq);
 	}
@@ -599,7 +638,7 @@ void queue_iova(struct iova_domain *iovad,
 
 	if (atomic_cmpxchg(&iovad->fq_timer_on, 0, 1) == 0)
 		mod_timer(&iovad->fq_timer,
-			  jiffies + msecs_to_jiffies(IOVA_FQ_TIMEOUT));
+			  jiffies + msecs_to_jiffies(iovad->fq_timeout));
 
 	put_cpu_ptr(iovad->fq);
 }
@@ -794,13 +833,20 @@ split_and_remove_iova(struct iova_domain *iovad, struct iova *iova,
  * Allocator to Many CPUs and Arbitrary Resources" by Bonwick and Adams.
  * For simplicity, we use a static magazine size and don't implement the
  * dynamic size tuning described in the paper.
+ *
+ * The bins from IOVA_RANGE_CACHE_LARGE_SIZE up hold ranges of 256KB and
+ * more, as mapped for camera and display buffers.  Each of those pins
+ * much more address space, so they get small magazines and a small
+ * depot instead.
  */
 
 #define IOVA_MAG_SIZE 128
+#define IOVA_LARGE_MAG_SIZE 16
+#define MAX_GLOBAL_LARGE_MAGS 4
 
 struct iova_magazine {
 	unsigned long size;
-	unsigned long pfns[IOVA_MAG_SIZE];
+	unsigned long pfns[];
 };
 
 struct iova_cpu_rcache {
@@ -809,9 +855,11 @@ struct iova_cpu_rcache {
 	struct iova_magazine *prev;
 };
 
-static struct iova_magazine *iova_magazine_alloc(gfp_t flags)
+static struct iova_magazine *iova_magazine_alloc(struct iova_rcache *rcache,
+						 gfp_t flags)
 {
-	return kzalloc(sizeof(struct iova_magazine), flags);
+	return kzalloc(sizeof(struct iova_magazine) +
+		       rcache->mag_size * sizeof(unsigned long), flags);
 }
 
 static void iova_magazine_free(struct iova_magazine *mag)
@@ -842,9 +890,10 @@ iova_magazine_free_pfns(struct iova_magazine *mag, struct iova_domain *iovad)
 	mag->size = 0;
 }
 
-static bool iova_magazine_full(struct iova_magazine *mag)
+static bool iova_magazine_full(struct iova_rcache *rcache,
+			       struct iova_magazine *mag)
 {
-	return (mag && mag->size == IOVA_MAG_SIZE);
+	return (mag && mag->size == rcache->mag_size);
 }
 
 static bool iova_magazine_empty(struct iova_magazine *mag)
@@ -863,9 +912,10 @@ static unsigned long iova_magazine_pop(struct iova_magazine *mag,
 	return mag->pfns[--mag->size];
 }
 
-static void iova_magazine_push(struct iova_magazine *mag, unsigned long pfn)
+static void iova_magazine_push(struct iova_rcache *rcache,
+			       struct iova_magazine *mag, unsigned long pfn)
 {
-	BUG_ON(iova_magazine_full(mag));
+	BUG_ON(iova_magazine_full(rcache, mag));
 
 	mag->pfns[mag->size++] = pfn;
 }
@@ -881,14 +931,21 @@ static void init_iova_rcaches(struct iova_domain *iovad)
 		rcache = &iovad->rcaches[i];
 		spin_lock_init(&rcache->lock);
 		rcache->depot_size = 0;
+		if (i < IOVA_RANGE_CACHE_LARGE_SIZE) {
+			rcache->depot_max = MAX_GLOBAL_MAGS;
+			rcache->mag_size = IOVA_MAG_SIZE;
+		} else {
+			rcache->depot_max = MAX_GLOBAL_LARGE_MAGS;
+			rcache->mag_size = IOVA_LARGE_MAG_SIZE;
+		}
 		rcache->cpu_rcaches = __alloc_percpu(sizeof(*cpu_rcache), cache_line_size());
 		if (WARN_ON(!rcache->cpu_rcaches))
 			continue;
 		for_each_possible_cpu(cpu) {
 			cpu_rcache = per_cpu_ptr(rcache->cpu_rcaches, cpu);
 			spin_lock_init(&cpu_rcache->lock);
-			cpu_rcache->loaded = iova_magazine_alloc(GFP_KERNEL);
-			cpu_rcache->prev = iova_magazine_alloc(GFP_KERNEL);
+			cpu_rcache->loaded = iova_magazine_alloc(rcache, GFP_KERNEL);
+			cpu_rcache->prev = iova_magazine_alloc(rcache, GFP_KERNEL);
 		}
 	}
 }
@@ -911,17 +968,18 @@ static bool __iova_rcache_insert(struct iova_domain *iovad,
 	cpu_rcache = raw_cpu_ptr(rcache->cpu_rcaches);
 	spin_lock_irqsave(&cpu_rcache->lock, flags);
 
-	if (!iova_magazine_full(cpu_rcache->loaded)) {
+	if (!iova_magazine_full(rcache, cpu_rcache->loaded)) {
 		can_insert = true;
-	} else if (!iova_magazine_full(cpu_rcache->prev)) {
+	} else if (!iova_magazine_full(rcache, cpu_rcache->prev)) {
 		swap(cpu_rcache->prev, cpu_rcache->loaded);
 		can_insert = true;
 	} else {
-		struct iova_magazine *new_mag = iova_magazine_alloc(GFP_ATOMIC);
+		struct iova_magazine *new_mag = iova_magazine_alloc(rcache,
+								    GFP_ATOMIC);
 
 		if (new_mag) {
 			spin_lock(&rcache->lock);
-			if (rcache->depot_size < MAX_GLOBAL_MAGS) {
+			if (rcache->depot_size < rcache->depot_max) {
 				rcache->depot[rcache->depot_size++] =
 						cpu_rcache->loaded;
 			} else {
@@ -935,7 +993,7 @@ static bool __iova_rcache_insert(struct iova_domain *iovad,
 	}
 
 	if (can_insert)
-		iova_magazine_push(cpu_rcache->loaded, iova_pfn);
+		iova_magazine_push(rcache, cpu_rcache->loaded, iova_pfn);
 
 	spin_unlock_irqrestore(&cpu_rcache->lock, flags);
 
@@ -13,6 +13,7 @@
  * Free Software Foundation; either version 2 of the License, or (at your
  * option) any later version.
  */
+#include <linux/ktime.h>
 #include <linux/module.h>
 #include <linux/sched.h>
 #include <linux/slab.h>
@@ -39,7 +40,7 @@ module_param(debug, bool, 0644);
 
 /* Instance is already queued on the job_queue */
 #define TRANS_QUEUED		(1 << 0)
-/* Instance is currently running in hardware */
+/* Instance is currently running in hardware, and off the job_queue */
 #define TRANS_RUNNING		(1 << 1)
 /* Instance is currently aborting */
 #define TRANS_ABORT		(1 << 2)
@@ -51,20 +52,34 @@ module_param(debug, bool, 0644);
 #define DST_QUEUE_OFF_BASE	(1 << 30)
 
 
+/**
+ * struct v4l2_m2m_slot - a hardware instance of the device
+ * @ctx:		instance running on it
+ * @run_start:		when @ctx started running
+ * @stats:		jobs run on it so far
+ */
+struct v4l2_m2m_slot {
+	struct v4l2_m2m_ctx	*ctx;
+	ktime_t			run_start;
+	struct v4l2_m2m_slot_stats stats;
+};
+
 /**
  * struct v4l2_m2m_dev - per-device context
- * @curr_ctx:		currently running instance
- * @job_queue:		instances queued to run
- * @job_spinlock:	protects job_queue
+ * @job_queue:		instances queued to run, in the order they got ready
+ * @job_spinlock:	protects job_queue and slots
  * @m2m_ops:		driver callbacks
+ * @num_slots:		number of jobs the device can run at once
+ * @slots:		the hardware instances
  */
 struct v4l2_m2m_dev {
-	struct v4l2_m2m_ctx	*curr_ctx;
-
 	struct list_head	job_queue;
 	spinlock_t		job_spinlock;
 
 	const struct v4l2_m2m_ops *m2m_ops;
+
+	unsigned int		num_slots;
+	struct v4l2_m2m_slot	slots[];
 };
 
 static struct v4l2_m2m_queue_ctx *get_queue_ctx(struct v4l2_m2m_ctx *m2m_ctx,
@@ -173,42 +188,97 @@ void *v4l2_m2m_get_curr_priv(struct v4l2_m2m_dev *m2m_dev)
 	void *ret = NULL;
 
 	spin_lock_irqsave(&m2m_dev->job_spinlock, flags);
-	if (m2m_dev->curr_ctx)
-		ret = m2m_dev->curr_ctx->priv;
+	if (m2m_dev->slots[0].ctx)
+		ret = m2m_dev->slots[0].ctx->priv;
 	spin_unlock_irqrestore(&m2m_dev->job_spinlock, flags);
 
 	return ret;
 }
 EXPORT_SYMBOL(v4l2_m2m_get_curr_priv);
 
+int v4l2_m2m_get_slot_stats(struct v4l2_m2m_dev *m2m_dev, unsigned int slot,
+			    struct v4l2_m2m_slot_stats *stats)
+{
+	struct v4l2_m2m_slot *s;
+	unsigned long flags;
+
+	if (slot >= m2m_dev->num_slots)
+		return -EINVAL;
+
+	s = &m2m_dev->slots[slot];
+	spin_lock_irqsave(&m2m_dev->job_spinlock, flags);
+	*stats = s->stats;
+	/* Include the job running now */
+	if (s->ctx)
+		stats->busy_ns += ktime_to_ns(ktime_sub(ktime_get(),
+							s->run_start));
+	spin_unlock_irqrestore(&m2m_dev->job_spinlock, flags);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(v4l2_m2m_get_slot_stats);
+
+static void v4l2_m2m_slot_done(struct v4l2_m2m_slot *s)
+{
+	s->stats.jobs++;
+	s->stats.busy_ns += ktime_to_ns(ktime_sub(ktime_get(), s->run_start));
+	s->ctx = NULL;
+}
+
+/*
+ * The slot @m2m_ctx is running on, or NULL if it is not running.
+ * Called with job_spinlock held.
+ */
+static struct v4l2_m2m_slot *v4l2_m2m_ctx_slot(struct v4l2_m2m_ctx *m2m_ctx)
+{
+	struct v4l2_m2m_slot *s = &m2m_ctx->m2m_dev->slots[m2m_ctx->slot];
+
+	return s->ctx == m2m_ctx ? s : NULL;
+}
+
 /**
- * v4l2_m2m_try_run() - select next job to perform and run it if possible
+ * v4l2_m2m_try_run() - select next jobs to perform and run them if possible
  *
- * Get next transaction (if present) from the waiting jobs list and run it.
+ * Run the transactions waiting longest on the free slots of the device.
+ * An instance runs one job at a time and is queued again at the tail
+ * once it finishes, so instances take turns on the slots.
  */
 static void v4l2_m2m_try_run(struct v4l2_m2m_dev *m2m_dev)
 {
+	struct v4l2_m2m_ctx *m2m_ctx;
 	unsigned long flags;
+	unsigned int slot;
 
 	spin_lock_irqsave(&m2m_dev->job_spinlock, flags);
-	if (NULL != m2m_dev->curr_ctx) {
-		spin_unlock_irqrestore(&m2m_dev->job_spinlock, flags);
-		dprintk("Another instance is running, won't run now\n");
-		return;
-	}
+	for (;;) {
+		if (list_empty(&m2m_dev->job_queue)) {
+			dprintk("No job pending\n");
+			break;
+		}
+
+		for (slot = 0; slot < m2m_dev->num_slots; slot++)
+			if (!m2m_dev->slots[slot].ctx)
+				break;
+		if (slot == m2m_dev->num_slots) {
+			dprintk("Other instances are running, won't run now\n");
+			break;
+		}
 
-	if (list_empty(&m2m_dev->job_queue)) {
+		m2m_ctx = list_first_entry(&m2m_dev->job_queue,
+					   struct v4l2_m2m_ctx, queue);
+		list_del(&m2m_ctx->queue);
+		m2m_ctx->job_flags &= ~TRANS_QUEUED;
+		m2m_ctx->job_flags |= TRANS_RUNNING;
+		m2m_ctx->slot = slot;
+		m2m_dev->slots[slot].ctx = m2m_ctx;
+		m2m_dev->slots[slot].run_start = ktime_get();
 		spin_unlock_irqrestore(&m2m_dev->job_spinlock, flags);
-		dprintk("No job pending\n");
-		return;
-	}
 
-	m2m_dev->curr_ctx = list_first_entry(&m2m_dev->job_queue,
-				   struct v4l2_m2m_ctx, queue);
-	m2m_dev->curr_ctx->job_flags |= TRANS_RUNNING;
-	spin_unlock_irqrestore(&m2m_dev->job_spinlock, flags);
+		m2m_dev->m2m_ops->device_run(m2m_ctx->priv);
 
-	m2m_dev->m2m_ops->device_run(m2m_dev->curr_ctx->priv);
+		spin_lock_irqsave(&m2m_dev->job_spinlock, flags);
+	}
+	spin_unlock_irqrestore(&m2m_dev->job_spinlock, flags);
 }
 
 void v4l2_m2m_try_schedule(struct v4l2_m2m_ctx *m2m_ctx)
@@ -234,9 +304,9 @@ void v4l2_m2m_try_schedule(struct v4l2_m2m_ctx *m2m_ctx)
 		return;
 	}
 
-	if (m2m_ctx->job_flags & TRANS_QUEUED) {
+	if (m2m_ctx->job_flags & (TRANS_QUEUED | TRANS_RUNNING)) {
 		spin_unlock_irqrestore(&m2m_dev->job_spinlock, flags_job);
-		dprintk("On job queue already\n");
+		dprintk("On job queue or running already\n");
 		return;
 	}
 
@@ -317,19 +387,20 @@ static void v4l2_m2m_cancel_job(struct v4l2_m2m_ctx *m2m_ctx)
 void v4l2_m2m_job_finish(struct v4l2_m2m_dev *m2m_dev,
 			 struct v4l2_m2m_ctx *m2m_ctx)
 {
+	struct v4l2_m2m_slot *s;
 	unsigned long flags;
 
 	spin_lock_irqsave(&m2m_dev->job_spinlock, flags);
-	if (!m2m_dev->curr_ctx || m2m_dev->curr_ctx != m2m_ctx) {
+	s = v4l2_m2m_ctx_slot(m2m_ctx);
+	if (!s) {
 		spin_unlock_irqrestore(&m2m_dev->job_spinlock, flags);
 		dprintk("Called by an instance not currently running\n");
 		return;
 	}
 
-	list_del(&m2m_dev->curr_ctx->queue);
-	m2m_dev->curr_ctx->job_flags &= ~(TRANS_QUEUED | TRANS_RUNNING);
-	wake_up(&m2m_dev->curr_ctx->finished);
-	m2m_dev->curr_ctx = NULL;
+	v4l2_m2m_slot_done(s);
+	m2m_ctx->job_flags &= ~TRANS_RUNNING;
+	wake_up(&m2m_ctx->finished);
 
 	spin_unlock_irqrestore(&m2m_dev->job_spinlock, flags);
 
@@ -463,6 +534,7 @@ int v4l2_m2m_streamoff(struct file *file, struct v4l2_m2m_ctx *m2m_ctx,
 {
 	struct v4l2_m2m_dev *m2m_dev;
 	struct v4l2_m2m_queue_ctx *q_ctx;
+	struct v4l2_m2m_slot *s;
 	unsigned long flags_job, flags;
 	int ret;
 
@@ -488,8 +560,9 @@ int v4l2_m2m_streamoff(struct file *file, struct v4l2_m2m_ctx *m2m_ctx,
 	q_ctx->num_rdy = 0;
 	spin_unlock_irqrestore(&q_ctx->rdy_spinlock, flags);
 
-	if (m2m_dev->curr_ctx == m2m_ctx) {
-		m2m_dev->curr_ctx = NULL;
+	s = v4l2_m2m_ctx_slot(m2m_ctx);
+	if (s) {
+		v4l2_m2m_slot_done(s);
 		wake_up(&m2m_ctx->finished);
 	}
 	spin_unlock_irqrestore(&m2m_dev->job_spinlock, flags_job);
@@ -593,25 +666,33 @@ int v4l2_m2m_mmap(struct file *file, struct v4l2_m2m_ctx *m2m_ctx,
 }
 EXPORT_SYMBOL(v4l2_m2m_mmap);
 
-struct v4l2_m2m_dev *v4l2_m2m_init(const struct v4l2_m2m_ops *m2m_ops)
+struct v4l2_m2m_dev *v4l2_m2m_init_slots(const struct v4l2_m2m_ops *m2m_ops,
+					 unsigned int num_slots)
 {
 	struct v4l2_m2m_dev *m2m_dev;
 
 	if (!m2m_ops || WARN_ON(!m2m_ops->device_run) ||
-			WARN_ON(!m2m_ops->job_abort))
+			WARN_ON(!m2m_ops->job_abort) || WARN_ON(!num_slots))
 		return ERR_PTR(-EINVAL);
 
-	m2m_dev = kzalloc(sizeof *m2m_dev, GFP_KERNEL);
+	m2m_dev = kzalloc(sizeof(*m2m_dev) + num_slots * sizeof(m2m_dev->slots[0]),
+			  GFP_KERNEL);
 	if (!m2m_dev)
 		return ERR_PTR(-ENOMEM);
 
-	m2m_dev->curr_ctx = NULL;
 	m2m_dev->m2m_ops = m2m_ops;
+	m2m_dev->num_slots = num_slots;
 	INIT_LIST_HEAD(&m2m_dev->job_queue);
 	spin_lock_init(&m2m_dev->job_spinlock);
 
 	return m2m_dev;
 }
+EXPORT_SYMBOL_GPL(v4l2_m2m_init_slots);
+
+struct v4l2_m2m_dev *v4l2_m2m_init(const struct v4l2_m2m_ops *m2m_ops)
+{
+	return v4l2_m2m_init_slots(m2m_ops, 1);
+}
 EXPORT_SYMBOL_GPL(v4l2_m2m_init);
 
 void v4l2_m2m_release(struct v4l2_m2m_dev *m2m_dev)
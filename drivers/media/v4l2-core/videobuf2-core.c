@@ -277,6 +277,116 @@ static void __vb2_plane_dmabuf_put(struct vb2_buffer *vb, struct vb2_plane *p)
 	p->dbuf_mapped = 0;
 }
 
+/*
+ * An attachment parked in the DMABUF cache of a queue.  It holds a
+ * reference to @dbuf.
+ */
+struct vb2_dmabuf_cache_entry {
+	struct list_head	list;
+	struct dma_buf		*dbuf;
+	void			*mem_priv;
+	struct device		*dev;
+	unsigned int		length;
+};
+
+/*
+ * The cached attachment moves between buffers, so count its park and its
+ * reuse as a detach and an attach of the buffers involved to keep their
+ * counters balanced.
+ */
+#ifdef CONFIG_VIDEO_ADV_DEBUG
+#define vb2_dmabuf_cache_count(vb, op)	((vb)->cnt_mem_ ## op++)
+#else
+#define vb2_dmabuf_cache_count(vb, op)
+#endif
+
+static void __vb2_dmabuf_cache_evict(struct vb2_queue *q,
+				     struct vb2_dmabuf_cache_entry *e)
+{
+	list_del(&e->list);
+	q->dmabuf_cache_count--;
+	if (q->mem_ops->detach_dmabuf)
+		q->mem_ops->detach_dmabuf(e->mem_priv);
+	dma_buf_put(e->dbuf);
+	kfree(e);
+}
+
+/**
+ * __vb2_plane_dmabuf_park() - release a DMABUF shared plane, keeping its
+ * attachment in the queue cache
+ *
+ * Applications often rotate a pool of dma_bufs over the buffers of a
+ * queue, so the dma_buf of a plane is likely to be queued again on some
+ * other buffer.  The attachment is released for real only when the cache
+ * is full or the buffers of the queue are freed.
+ */
+static void __vb2_plane_dmabuf_park(struct vb2_buffer *vb, unsigned int plane)
+{
+	struct vb2_queue *q = vb->vb2_queue;
+	struct vb2_plane *p = &vb->planes[plane];
+	struct vb2_dmabuf_cache_entry *e;
+
+	if (!p->mem_priv)
+		return;
+
+	e = kmalloc(sizeof(*e), GFP_KERNEL);
+	if (!e) {
+		__vb2_plane_dmabuf_put(vb, p);
+		return;
+	}
+
+	if (p->dbuf_mapped)
+		call_void_memop(vb, unmap_dmabuf, p->mem_priv);
+	vb2_dmabuf_cache_count(vb, detach_dmabuf);
+
+	e->dbuf = p->dbuf;
+	e->mem_priv = p->mem_priv;
+	e->dev = q->alloc_devs[plane] ? : q->dev;
+	e->length = p->length;
+	list_add(&e->list, &q->dmabuf_cache);
+	if (++q->dmabuf_cache_count > VB2_MAX_FRAME)
+		__vb2_dmabuf_cache_evict(q, list_last_entry(&q->dmabuf_cache,
+				struct vb2_dmabuf_cache_entry, list));
+
+	p->mem_priv = NULL;
+	p->dbuf = NULL;
+	p->dbuf_mapped = 0;
+}
+
+/*
+ * Take the attachment of @dbuf for @dev out of the cache.  The reference
+ * to @dbuf held by the cache entry is handed over to the caller.
+ */
+static void *__vb2_dmabuf_cache_get(struct vb2_buffer *vb,
+				    struct dma_buf *dbuf, struct device *dev,
+				    unsigned int length)
+{
+	struct vb2_queue *q = vb->vb2_queue;
+	struct vb2_dmabuf_cache_entry *e;
+	void *mem_priv;
+
+	list_for_each_entry(e, &q->dmabuf_cache, list) {
+		if (e->dbuf != dbuf || e->dev != dev || e->length != length)
+			continue;
+
+		mem_priv = e->mem_priv;
+		list_del(&e->list);
+		q->dmabuf_cache_count--;
+		kfree(e);
+		vb2_dmabuf_cache_count(vb, attach_dmabuf);
+		return mem_priv;
+	}
+	return NULL;
+}
+
+static void __vb2_dmabuf_cache_flush(struct vb2_queue *q)
+{
+	struct vb2_dmabuf_cache_entry *e, *tmp;
+
+	list_for_each_entry_safe(e, tmp, &q->dmabuf_cache, list)
+		__vb2_dmabuf_cache_evict(q, e);
+}
+
 /**
  * __vb2_buf_dmabuf_put() - release memory associated with
  * a DMABUF shared buffer
@@ -522,6 +632,7 @@ static int __vb2_queue_free(struct vb2_queue *q, unsigned int buffers)
 	if (!q->num_buffers) {
 		q->memory = 0;
 		INIT_LIST_HEAD(&q->queued_list);
+		__vb2_dmabuf_cache_flush(q);
 	}
 	return 0;
 }
@@ -1105,6 +1216,7 @@ static int __prepare_dmabuf(struct vb2_buffer *vb, const void *pb)
 
 	for (plane = 0; plane < vb->num_planes; ++plane) {
 		struct dma_buf *dbuf = dma_buf_get(planes[plane].m.fd);
+		struct device *dev = q->alloc_devs[plane] ? : q->dev;
 
 		if (IS_ERR_OR_NULL(dbuf)) {
 			dprintk(1, "invalid dmabuf fd for plane %d\n",
@@ -1141,21 +1253,30 @@ static int __prepare_dmabuf(struct vb2_buffer *vb, const void *pb)
 		}
 
 		/* Release previously acquired memory if present */
-		__vb2_plane_dmabuf_put(vb, &vb->planes[plane]);
+		__vb2_plane_dmabuf_park(vb, plane);
 		vb->planes[plane].bytesused = 0;
 		vb->planes[plane].length = 0;
 		vb->planes[plane].m.fd = 0;
 		vb->planes[plane].data_offset = 0;
 
-		/* Acquire each plane's memory */
-		mem_priv = call_ptr_memop(vb, attach_dmabuf,
-				q->alloc_devs[plane] ? : q->dev,
-				dbuf, planes[plane].length, q->dma_dir);
-		if (IS_ERR(mem_priv)) {
-			dprintk(1, "failed to attach dmabuf\n");
-			ret = PTR_ERR(mem_priv);
+		/*
+		 * Reuse the attachment of a recently released plane, the
+		 * cache already holds a reference to dbuf.
+		 */
+		mem_priv = __vb2_dmabuf_cache_get(vb, dbuf, dev,
+						  planes[plane].length);
+		if (mem_priv) {
 			dma_buf_put(dbuf);
-			goto err;
+		} else {
+			/* Acquire each plane's memory */
+			mem_priv = call_ptr_memop(vb, attach_dmabuf, dev,
+					dbuf, planes[plane].length, q->dma_dir);
+			if (IS_ERR(mem_priv)) {
+				dprintk(1, "failed to attach dmabuf\n");
+				ret = PTR_ERR(mem_priv);
+				dma_buf_put(dbuf);
+				goto err;
+			}
 		}
 
 		vb->planes[plane].dbuf = dbuf;
@@ -1990,6 +2111,7 @@ int vb2_core_queue_init(struct vb2_queue *q)
 
 	INIT_LIST_HEAD(&q->queued_list);
 	INIT_LIST_HEAD(&q->done_list);
+	INIT_LIST_HEAD(&q->dmabuf_cache);
 	spin_lock_init(&q->done_lock);
 	mutex_init(&q->mmap_lock);
 	init_waitqueue_head(&q->done_wq);
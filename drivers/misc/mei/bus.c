@@ -30,6 +30,22 @@
 #define to_mei_cl_driver(d) container_of(d, struct mei_cl_driver, driver)
 #define to_mei_cl_device(d) container_of(d, struct mei_cl_device, dev)
 
+/* maximal number of requests submitted and not yet answered per client */
+#define MEI_CL_REQ_MAX_INFLIGHT 8
+
+/**
+ * struct mei_cl_req - request submitted with mei_cldev_submit()
+ *
+ * @list: link in the client pending requests list
+ * @complete: completion callback
+ * @context: completion callback argument
+ */
+struct mei_cl_req {
+	struct list_head list;
+	mei_cldev_req_cb_t complete;
+	void *context;
+};
+
 /**
  * __mei_cl_send - internal client send (write)
  *
@@ -235,6 +251,149 @@ ssize_t mei_cldev_recv(struct mei_cl_device *cldev, u8 *buf, size_t length)
 }
 EXPORT_SYMBOL_GPL(mei_cldev_recv);
 
+/**
+ * mei_cldev_submit - submit a request without waiting for the reply
+ *
+ * @cldev: me client device
+ * @buf: request to send
+ * @length: request length
+ * @complete: called with the reply, or with a negative error as @length
+ *	if the request failed after submission, from process context
+ * @context: argument of @complete
+ *
+ * The me client replies to the requests in order, so each received
+ * message completes the oldest request.  Up to MEI_CL_REQ_MAX_INFLIGHT
+ * requests may be pending; the client cannot use an rx callback meanwhile.
+ *
+ * Return: 0 on success
+ *         -EBUSY if too many requests are pending or an rx callback is
+ *	registered
+ *         <0 on other errors
+ */
+int mei_cldev_submit(struct mei_cl_device *cldev, const u8 *buf, size_t length,
+		     mei_cldev_req_cb_t complete, void *context)
+{
+	struct mei_device *bus = cldev->bus;
+	struct mei_cl *cl = cldev->cl;
+	struct mei_cl_req *req;
+	struct mei_cl_cb *cb;
+	ssize_t rets;
+
+	if (!complete)
+		return -EINVAL;
+
+	req = kmalloc(sizeof(*req), GFP_KERNEL);
+	if (!req)
+		return -ENOMEM;
+
+	req->complete = complete;
+	req->context = context;
+
+	mutex_lock(&bus->device_lock);
+	if (bus->dev_state != MEI_DEV_ENABLED || !mei_cl_is_connected(cl)) {
+		rets = -ENODEV;
+		goto err;
+	}
+
+	if (!mei_me_cl_is_active(cl->me_cl)) {
+		rets = -ENOTTY;
+		goto err;
+	}
+
+	if (length > mei_cl_mtu(cl)) {
+		rets = -EFBIG;
+		goto err;
+	}
+
+	if (cldev->rx_cb || cldev->req_inflight >= MEI_CL_REQ_MAX_INFLIGHT) {
+		rets = -EBUSY;
+		goto err;
+	}
+
+	cb = mei_cl_alloc_cb(cl, length, MEI_FOP_WRITE, NULL);
+	if (!cb) {
+		rets = -ENOMEM;
+		goto err;
+	}
+	memcpy(cb->buf.data, buf, length);
+
+	/* the reply can't be handled before device_lock is released */
+	list_add_tail(&req->list, &cldev->req_pending);
+	cldev->req_inflight++;
+
+	rets = mei_cl_write(cl, cb);
+	if (rets < 0) {
+		list_del(&req->list);
+		cldev->req_inflight--;
+		goto err;
+	}
+
+	rets = mei_cl_read_start(cl, mei_cl_mtu(cl), NULL);
+	if (rets == -EBUSY)
+		rets = 0;
+	/* the request is on its way, a read failure completes it */
+	if (rets)
+		schedule_work(&cldev->req_work);
+	mutex_unlock(&bus->device_lock);
+
+	return 0;
+
+err:
+	mutex_unlock(&bus->device_lock);
+	kfree(req);
+	return rets;
+}
+EXPORT_SYMBOL_GPL(mei_cldev_submit);
+
+/**
+ * mei_cl_bus_req_work - complete the requests that got a reply
+ *
+ * @work: work
+ */
+static void mei_cl_bus_req_work(struct work_struct *work)
+{
+	struct mei_cl_device *cldev;
+	struct mei_device *bus;
+	struct mei_cl *cl;
+	struct mei_cl_req *req;
+	struct mei_cl_cb *cb;
+	int rets;
+
+	cldev = container_of(work, struct mei_cl_device, req_work);
+	bus = cldev->bus;
+	cl = cldev->cl;
+
+	mutex_lock(&bus->device_lock);
+	while ((req = list_first_entry_or_null(&cldev->req_pending,
+					       struct mei_cl_req, list))) {
+		cb = mei_cl_read_cb(cl, NULL);
+		if (!cb && mei_cl_is_connected(cl)) {
+			/* wait for the reply, unless it can't be read */
+			rets = mei_cl_read_start(cl, mei_cl_mtu(cl), NULL);
+			if (!rets || rets == -EBUSY)
+				break;
+		}
+
+		list_del(&req->list);
+		cldev->req_inflight--;
+		/* the callback may submit the next request */
+		mutex_unlock(&bus->device_lock);
+
+		if (!cb)
+			req->complete(cldev, req->context, NULL, -ENODEV);
+		else if (cb->status)
+			req->complete(cldev, req->context, NULL, cb->status);
+		else
+			req->complete(cldev, req->context, cb->buf.data,
+				      cb->buf_idx);
+		kfree(req);
+
+		mutex_lock(&bus->device_lock);
+		mei_io_cb_free(cb);
+	}
+	mutex_unlock(&bus->device_lock);
+}
+
 /**
  * mei_cl_bus_rx_work - dispatch rx event for a bus device
  *
@@ -309,10 +468,15 @@ bool mei_cl_bus_rx_event(struct mei_cl *cl)
 {
 	struct mei_cl_device *cldev = cl->cldev;
 
-	if (!cldev || !cldev->rx_cb)
+	if (!cldev)
 		return false;
 
-	schedule_work(&cldev->rx_work);
+	if (cldev->rx_cb)
+		schedule_work(&cldev->rx_work);
+	else if (!list_empty(&cldev->req_pending))
+		schedule_work(&cldev->req_work);
+	else
+		return false;
 
 	return true;
 }
@@ -336,6 +500,8 @@ int mei_cldev_register_rx_cb(struct mei_cl_device *cldev, mei_cldev_cb_t rx_cb)
 		return -EINVAL;
 	if (cldev->rx_cb)
 		return -EALREADY;
+	if (cldev->req_inflight)
+		return -EBUSY;
 
 	cldev->rx_cb = rx_cb;
 	INIT_WORK(&cldev->rx_work, mei_cl_bus_rx_work);
@@ -515,6 +681,8 @@ static void mei_cldev_unregister_callbacks(struct mei_cl_device *cldev)
 		cancel_work_sync(&cldev->notif_work);
 		cldev->notif_cb = NULL;
 	}
+
+	cancel_work_sync(&cldev->req_work);
 }
 
 /**
@@ -558,6 +726,10 @@ int mei_cldev_disable(struct mei_cl_device *cldev)
 	mei_cl_unlink(cl);
 
 	mutex_unlock(&bus->device_lock);
+
+	/* fail the requests that won't get a reply */
+	mei_cl_bus_req_work(&cldev->req_work);
+
 	return err;
 }
 EXPORT_SYMBOL_GPL(mei_cldev_disable);
@@ -896,6 +1068,8 @@ static struct mei_cl_device *mei_cl_bus_dev_alloc(struct mei_device *bus,
 	mei_cl_bus_set_name(cldev);
 	cldev->is_added   = 0;
 	INIT_LIST_HEAD(&cldev->bus_list);
+	INIT_LIST_HEAD(&cldev->req_pending);
+	INIT_WORK(&cldev->req_work, mei_cl_bus_req_work);
 
 	return cldev;
 }
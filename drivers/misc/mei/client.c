@@ -1529,6 +1529,15 @@ struct mei_msg_hdr_ext {
 	u32 dma_len;
 };
 
+static inline void mei_cl_account_tx(struct mei_device *dev,
+				     struct mei_msg_hdr *mei_hdr, size_t len)
+{
+	if (mei_hdr->dma_ring)
+		dev->xfer_stats.tx_dma += len;
+	else
+		dev->xfer_stats.tx_hbuf += len;
+}
+
 /**
  * mei_cl_irq_write - write a message to device
  *	from the interrupt thread context
@@ -1583,7 +1592,8 @@ int mei_cl_irq_write(struct mei_cl *cl, struct mei_cl_cb *cb,
 	if (hbuf_slots >= msg_slots) {
 		mei_hdr->length = len;
 		mei_hdr->msg_complete = 1;
-	} else if (dev->hbm_f_dr_supported && hbuf_slots > sizeof(ext_hdr) &&
+	} else if (dev->hbm_f_dr_supported &&
+		   hbuf_slots >= mei_data2slots(sizeof(ext_hdr.dma_len)) &&
 		   dr_slots) {
 		if (msg_slots < dr_slots)
 			mei_hdr->msg_complete = 1;
@@ -1610,6 +1620,8 @@ int mei_cl_irq_write(struct mei_cl *cl, struct mei_cl_cb *cb,
 	if (rets)
 		goto err;
 
+	mei_cl_account_tx(dev, mei_hdr, len);
+
 	cl->status = 0;
 	cl->writing_state = MEI_WRITING;
 	cb->buf_idx += len;
@@ -1702,7 +1714,8 @@ int mei_cl_write(struct mei_cl *cl, struct mei_cl_cb *cb)
 	if (hbuf_slots >= msg_slots) {
 		mei_hdr->length = len;
 		mei_hdr->msg_complete = 1;
-	} else if (dev->hbm_f_dr_supported && hbuf_slots > sizeof(ext_hdr) &&
+	} else if (dev->hbm_f_dr_supported &&
+		   hbuf_slots >= mei_data2slots(sizeof(ext_hdr.dma_len)) &&
 		   dr_slots) {
 		if (msg_slots < dr_slots)
 			mei_hdr->msg_complete = 1;
@@ -1725,6 +1738,8 @@ int mei_cl_write(struct mei_cl *cl, struct mei_cl_cb *cb)
 	if (rets)
 		goto err;
 
+	mei_cl_account_tx(dev, mei_hdr, len);
+
 	rets = mei_cl_tx_flow_ctrl_creds_reduce(cl);
 	if (rets)
 		goto err;
@@ -17,6 +17,7 @@
 #include <linux/kernel.h>
 #include <linux/device.h>
 #include <linux/debugfs.h>
+#include <linux/math64.h>
 
 #include <linux/mei.h>
 
@@ -199,6 +200,40 @@ static const struct file_operations mei_dbgfs_fops_devstate = {
 	.llseek = generic_file_llseek,
 };
 
+static ssize_t mei_dbgfs_read_xfer_stats(struct file *fp, char __user *ubuf,
+					 size_t cnt, loff_t *ppos)
+{
+	struct mei_device *dev = fp->private_data;
+	struct mei_xfer_stats st;
+	u64 total;
+	char buf[256];
+	int pos = 0;
+
+	mutex_lock(&dev->device_lock);
+	st = dev->xfer_stats;
+	mutex_unlock(&dev->device_lock);
+
+	total = st.tx_hbuf + st.tx_dma + st.rx_hbuf + st.rx_dma;
+
+	pos += scnprintf(buf + pos, sizeof(buf) - pos, "irqs: %llu\n",
+			 st.irqs);
+	pos += scnprintf(buf + pos, sizeof(buf) - pos,
+			 "tx: hbuf %llu dma %llu\n", st.tx_hbuf, st.tx_dma);
+	pos += scnprintf(buf + pos, sizeof(buf) - pos,
+			 "rx: hbuf %llu dma %llu\n", st.rx_hbuf, st.rx_dma);
+	pos += scnprintf(buf + pos, sizeof(buf) - pos,
+			 "bytes per irq: %llu\n",
+			 st.irqs ? div64_u64(total, st.irqs) : 0);
+
+	return simple_read_from_buffer(ubuf, cnt, ppos, buf, pos);
+}
+
+static const struct file_operations mei_dbgfs_fops_xfer_stats = {
+	.open = simple_open,
+	.read = mei_dbgfs_read_xfer_stats,
+	.llseek = generic_file_llseek,
+};
+
 static ssize_t mei_dbgfs_write_allow_fa(struct file *file,
 					const char __user *user_buf,
 					size_t count, loff_t *ppos)
@@ -272,6 +307,12 @@ int mei_dbgfs_register(struct mei_device *dev, const char *name)
 		dev_err(dev->dev, "devstate: registration failed\n");
 		goto err;
 	}
+	f = debugfs_create_file("xfer_stats", S_IRUSR, dir,
+				dev, &mei_dbgfs_fops_xfer_stats);
+	if (!f) {
+		dev_err(dev->dev, "xfer_stats: registration failed\n");
+		goto err;
+	}
 	f = debugfs_create_file("allow_fixed_address", S_IRUSR | S_IWUSR, dir,
 				&dev->allow_fixed_address,
 				&mei_dbgfs_fops_allow_fa);
@@ -1220,6 +1220,7 @@ irqreturn_t mei_me_irq_thread_handler(int irq, void *dev_id)
 	dev_dbg(dev->dev, "function called after ISR to handle the interrupt processing.\n");
 	/* initialize our complete list */
 	mutex_lock(&dev->device_lock);
+	dev->xfer_stats.irqs++;
 
 	hcsr = mei_hcsr_read(dev);
 	me_intr_clear(dev, hcsr);
@@ -134,6 +134,23 @@ struct mei_dma_dscr {
 	size_t size;
 };
 
+/**
+ * struct mei_xfer_stats - client data transfer statistics
+ *
+ * @irqs        : interrupts handled
+ * @tx_hbuf     : bytes written through the host buffer
+ * @tx_dma      : bytes written through the dma ring
+ * @rx_hbuf     : bytes read from the device buffer
+ * @rx_dma      : bytes read from the dma ring
+ */
+struct mei_xfer_stats {
+	u64 irqs;
+	u64 tx_hbuf;
+	u64 tx_dma;
+	u64 rx_hbuf;
+	u64 rx_dma;
+};
+
 /* Maximum number of processed FW status registers */
 #define MEI_FW_STATUS_MAX 6
 /* Minimal  buffer for FW status string (8 bytes in dw + space or '\0') */
@@ -401,6 +418,7 @@ const char *mei_pg_state_str(enum mei_pg_state state);
  * @hbuf_depth  : depth of hardware host/write buffer is slots
  * @hbuf_is_ready : query if the host host/write buffer is ready
  * @dr_dscr: DMA ring descriptors: TX, RX, and CTRL
+ * @xfer_stats: client data transfer statistics
  *
  * @version     : HBM protocol version in use
  * @hbm_f_pg_supported  : hbm feature pgi protocol
@@ -479,6 +497,7 @@ struct mei_device {
 	bool hbuf_is_ready;
 
 	struct mei_dma_dscr dr_dscr[DMA_DSCR_NUM];
+	struct mei_xfer_stats xfer_stats;
 
 	struct hbm_version version;
 	unsigned int hbm_f_pg_supported:1;
@@ -13,22 +13,31 @@
  *
  */
 
+/*
+ * The time spent at each memory frequency and total bandwidth bucket is
+ * accumulated by the update hooks themselves, in per-cpu counters, and
+ * summed up on read.  show_stat prints the times as text, show_stat_bin
+ * holds them as an array of u64 nanoseconds, one row of num_buckets per
+ * frequency in the order of the device tree tables, including the time
+ * spent in the current state so far.
+ */
+
 #include <linux/device.h>
 #include <linux/err.h>
 #include <linux/errno.h>
-#include <linux/hashtable.h>
 #include <linux/kconfig.h>
 #include <linux/kernel.h>
 #include <linux/kobject.h>
 #include <linux/memory-state-time.h>
 #include <linux/module.h>
-#include <linux/mutex.h>
 #include <linux/of_platform.h>
+#include <linux/percpu.h>
 #include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
 #include <linux/sysfs.h>
 #include <linux/time.h>
 #include <linux/timekeeping.h>
-#include <linux/workqueue.h>
 
 #define KERNEL_ATTR_RO(_name) \
 static struct kobj_attribute _name##_attr = __ATTR_RO(_name)
@@ -37,10 +46,8 @@ static struct kobj_attribute _name##_attr = __ATTR_RO(_name)
 static struct kobj_attribute _name##_attr = \
 	__ATTR(_name, 0644, _name##_show, _name##_store)
 
-#define FREQ_HASH_BITS 4
-DECLARE_HASHTABLE(freq_hash_table, FREQ_HASH_BITS);
-
-static DEFINE_MUTEX(mem_lock);
+/* Protects the current state and last_update */
+static DEFINE_SPINLOCK(mem_lock);
 
 #define TAG "memory_state_time"
 #define BW_NODE "/soc/memory-state-time"
@@ -51,7 +58,7 @@ static DEFINE_MUTEX(mem_lock);
 #define LOWEST_FREQ 2
 
 static int curr_bw;
-static int curr_freq;
+static int curr_freq_idx;
 static u32 *bw_buckets;
 static u32 *freq_buckets;
 static int num_freqs;
@@ -59,23 +66,11 @@ static int num_buckets;
 static int registered_bw_sources;
 static u64 last_update;
 static bool init_success;
-static struct workqueue_struct *memory_wq;
 static u32 num_sources = 10;
 static int *bandwidths;
 
-struct freq_entry {
-	int freq;
-	u64 *buckets; /* Bandwidth buckets. */
-	struct hlist_node hash;
-};
-
-struct queue_container {
-	struct work_struct update_state;
-	int value;
-	u64 time_now;
-	int id;
-	struct mutex *lock;
-};
+/* Time in ns per frequency and bandwidth bucket, num_freqs * num_buckets */
+static u64 __percpu *state_time;
 
 static int find_bucket(int bw)
 {
@@ -94,13 +89,40 @@ static int find_bucket(int bw)
 	return 0;
 }
 
-static u64 get_time_diff(u64 time_now)
+static size_t state_time_size(void)
 {
-	u64 ms;
+	return num_freqs * num_buckets * sizeof(u64);
+}
 
-	ms = time_now - last_update;
+/* Called with mem_lock held, closes the interval spent in the current state */
+static void update_table(u64 time_now)
+{
+	u64 *times = this_cpu_ptr(state_time);
+
+	pr_debug("Last known bw %d freq %d\n", curr_bw,
+			freq_buckets[curr_freq_idx]);
+	times[curr_freq_idx * num_buckets + find_bucket(curr_bw)] +=
+			time_now - last_update;
 	last_update = time_now;
-	return ms;
+}
+
+/* Fills @times, of state_time_size(), with the time spent in each state */
+static void get_state_times(u64 *times)
+{
+	unsigned long flags;
+	int cpu, i, n = num_freqs * num_buckets;
+
+	memset(times, 0, state_time_size());
+	spin_lock_irqsave(&mem_lock, flags);
+	for_each_possible_cpu(cpu) {
+		u64 *cpu_times = per_cpu_ptr(state_time, cpu);
+
+		for (i = 0; i < n; i++)
+			times[i] += cpu_times[i];
+	}
+	times[curr_freq_idx * num_buckets + find_bucket(curr_bw)] +=
+			ktime_get_boot_ns() - last_update;
+	spin_unlock_irqrestore(&mem_lock, flags);
 }
 
 static ssize_t show_stat_show(struct kobject *kobj,
@@ -108,55 +130,62 @@ static ssize_t show_stat_show(struct kobject *kobj,
 {
 	int i, j;
 	int len = 0;
-	struct freq_entry *freq_entry;
+	u64 *times;
+
+	if (!smp_load_acquire(&init_success))
+		return 0;
+
+	times = kmalloc(state_time_size(), GFP_KERNEL);
+	if (!times)
+		return -ENOMEM;
+	get_state_times(times);
 
 	for (i = 0; i < num_freqs; i++) {
-		hash_for_each_possible(freq_hash_table, freq_entry, hash,
-				freq_buckets[i]) {
-			if (freq_entry->freq == freq_buckets[i]) {
-				len += scnprintf(buf + len, PAGE_SIZE - len,
-						"%d ", freq_buckets[i]);
-				if (len >= PAGE_SIZE)
-					break;
-				for (j = 0; j < num_buckets; j++) {
-					len += scnprintf(buf + len,
-							PAGE_SIZE - len,
-							"%llu ",
-							freq_entry->buckets[j]);
-				}
-				len += scnprintf(buf + len, PAGE_SIZE - len,
-						"\n");
-			}
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+				"%d ", freq_buckets[i]);
+		if (len >= PAGE_SIZE)
+			break;
+		for (j = 0; j < num_buckets; j++) {
+			len += scnprintf(buf + len, PAGE_SIZE - len, "%llu ",
+					times[i * num_buckets + j]);
 		}
+		len += scnprintf(buf + len, PAGE_SIZE - len, "\n");
 	}
+	kfree(times);
 	pr_debug("Current Time: %llu\n", ktime_get_boot_ns());
 	return len;
 }
 KERNEL_ATTR_RO(show_stat);
 
-static void update_table(u64 time_now)
+static ssize_t show_stat_bin_read(struct file *filp, struct kobject *kobj,
+		struct bin_attribute *attr, char *buf, loff_t off, size_t count)
 {
-	struct freq_entry *freq_entry;
+	ssize_t len;
+	u64 *times;
 
-	pr_debug("Last known bw %d freq %d\n", curr_bw, curr_freq);
-	hash_for_each_possible(freq_hash_table, freq_entry, hash, curr_freq) {
-		if (curr_freq == freq_entry->freq) {
-			freq_entry->buckets[find_bucket(curr_bw)]
-					+= get_time_diff(time_now);
-			break;
-		}
-	}
+	if (!smp_load_acquire(&init_success))
+		return 0;
+
+	times = kmalloc(state_time_size(), GFP_KERNEL);
+	if (!times)
+		return -ENOMEM;
+	get_state_times(times);
+	len = memory_read_from_buffer(buf, count, &off, times,
+			state_time_size());
+	kfree(times);
+	return len;
 }
+static BIN_ATTR_RO(show_stat_bin, 0);
 
-static bool freq_exists(int freq)
+static int find_freq(int freq)
 {
 	int i;
 
 	for (i = 0; i < num_freqs; i++) {
 		if (freq == freq_buckets[i])
-			return true;
+			return i;
 	}
-	return false;
+	return -1;
 }
 
 static int calculate_total_bw(int bw, int index)
@@ -171,75 +200,39 @@ static int calculate_total_bw(int bw, int index)
 	return total_bw;
 }
 
-static void freq_update_do_work(struct work_struct *work)
-{
-	struct queue_container *freq_state_update
-			= container_of(work, struct queue_container,
-			update_state);
-	if (freq_state_update) {
-		mutex_lock(&mem_lock);
-		update_table(freq_state_update->time_now);
-		curr_freq = freq_state_update->value;
-		mutex_unlock(&mem_lock);
-		kfree(freq_state_update);
-	}
-}
-
-static void bw_update_do_work(struct work_struct *work)
-{
-	struct queue_container *bw_state_update
-			= container_of(work, struct queue_container,
-			update_state);
-	if (bw_state_update) {
-		mutex_lock(&mem_lock);
-		update_table(bw_state_update->time_now);
-		curr_bw = calculate_total_bw(bw_state_update->value,
-				bw_state_update->id);
-		mutex_unlock(&mem_lock);
-		kfree(bw_state_update);
-	}
-}
-
 static void memory_state_freq_update(struct memory_state_update_block *ub,
 		int value)
 {
+	unsigned long flags;
+	int idx;
+
 	if (IS_ENABLED(CONFIG_MEMORY_STATE_TIME)) {
-		if (freq_exists(value) && init_success) {
-			struct queue_container *freq_container
-				= kmalloc(sizeof(struct queue_container),
-				GFP_KERNEL);
-			if (!freq_container)
-				return;
-			INIT_WORK(&freq_container->update_state,
-					freq_update_do_work);
-			freq_container->time_now = ktime_get_boot_ns();
-			freq_container->value = value;
-			pr_debug("Scheduling freq update in work queue\n");
-			queue_work(memory_wq, &freq_container->update_state);
-		} else {
+		if (!smp_load_acquire(&init_success))
+			return;
+		idx = find_freq(value);
+		if (idx < 0) {
 			pr_debug("Freq does not exist.\n");
+			return;
 		}
+		spin_lock_irqsave(&mem_lock, flags);
+		update_table(ktime_get_boot_ns());
+		curr_freq_idx = idx;
+		spin_unlock_irqrestore(&mem_lock, flags);
 	}
 }
 
 static void memory_state_bw_update(struct memory_state_update_block *ub,
 		int value)
 {
+	unsigned long flags;
+
 	if (IS_ENABLED(CONFIG_MEMORY_STATE_TIME)) {
-		if (init_success) {
-			struct queue_container *bw_container
-				= kmalloc(sizeof(struct queue_container),
-				GFP_KERNEL);
-			if (!bw_container)
-				return;
-			INIT_WORK(&bw_container->update_state,
-					bw_update_do_work);
-			bw_container->time_now = ktime_get_boot_ns();
-			bw_container->value = value;
-			bw_container->id = ub->id;
-			pr_debug("Scheduling bandwidth update in work queue\n");
-			queue_work(memory_wq, &bw_container->update_state);
-		}
+		if (!smp_load_acquire(&init_success))
+			return;
+		spin_lock_irqsave(&mem_lock, flags);
+		update_table(ktime_get_boot_ns());
+		curr_bw = calculate_total_bw(value, ub->id);
+		spin_unlock_irqrestore(&mem_lock, flags);
 	}
 }
 
@@ -326,13 +319,11 @@ static int get_bw_buckets(struct device *dev)
 	return 0;
 }
 
-/* Adds struct freq_entry nodes to the hashtable for each compatible frequency.
- * Returns the supported number of frequencies.
+/* Reads the supported frequencies and allocates the time counters of each
+ * frequency and bandwidth bucket.
  */
 static int freq_buckets_init(struct device *dev)
 {
-	struct freq_entry *freq_entry;
-	int i;
 	int ret, lenf;
 	struct device_node *node = dev->of_node;
 
@@ -357,24 +348,12 @@ static int freq_buckets_init(struct device *dev)
 	pr_debug("ret freq %d\n", ret);
 
 	num_freqs = lenf;
-	curr_freq = freq_buckets[LOWEST_FREQ];
+	curr_freq_idx = LOWEST_FREQ;
 
-	for (i = 0; i < num_freqs; i++) {
-		freq_entry = devm_kzalloc(dev, sizeof(struct freq_entry),
-				GFP_KERNEL);
-		if (!freq_entry)
-			return -ENOMEM;
-		freq_entry->buckets = devm_kzalloc(dev, sizeof(u64)*num_buckets,
-				GFP_KERNEL);
-		if (!freq_entry->buckets) {
-			devm_kfree(dev, freq_entry);
-			return -ENOMEM;
-		}
-		pr_debug("memory_state_time Adding freq to ht %d\n",
-				freq_buckets[i]);
-		freq_entry->freq = freq_buckets[i];
-		hash_add(freq_hash_table, &freq_entry->hash, freq_buckets[i]);
-	}
+	state_time = __devm_alloc_percpu(dev, state_time_size(),
+			__alignof__(u64));
+	if (!state_time)
+		return -ENOMEM;
 	return 0;
 }
 
@@ -386,8 +365,14 @@ static struct attribute *memory_attrs[] = {
 	NULL
 };
 
+static struct bin_attribute *memory_bin_attrs[] = {
+	&bin_attr_show_stat_bin,
+	NULL
+};
+
 static struct attribute_group memory_attr_group = {
 	.attrs = memory_attrs,
+	.bin_attrs = memory_bin_attrs,
 };
 
 static int memory_state_time_probe(struct platform_device *pdev)
@@ -401,7 +386,8 @@ static int memory_state_time_probe(struct platform_device *pdev)
 	if (error)
 		return error;
 	last_update = ktime_get_boot_ns();
-	init_success = true;
+	/* The update hooks can run from now on */
+	smp_store_release(&init_success, true);
 
 	pr_debug("memory_state_time initialized with num_freqs %d\n",
 			num_freqs);
@@ -426,20 +412,13 @@ static int __init memory_state_time_init(void)
 {
 	int error;
 
-	hash_init(freq_hash_table);
-	memory_wq = create_singlethread_workqueue("memory_wq");
-	if (!memory_wq) {
-		pr_err("Unable to create workqueue.\n");
-		return -EINVAL;
-	}
 	/*
 	 * Create sys/kernel directory for memory_state_time.
 	 */
 	memory_kobj = kobject_create_and_add(TAG, kernel_kobj);
 	if (!memory_kobj) {
 		pr_err("Unable to allocate memory_kobj for sysfs directory.\n");
-		error = -ENOMEM;
-		goto wq;
+		return -ENOMEM;
 	}
 	error = sysfs_create_group(memory_kobj, &memory_attr_group);
 	if (error) {
@@ -456,7 +435,6 @@ static int __init memory_state_time_init(void)
 
 group:	sysfs_remove_group(memory_kobj, &memory_attr_group);
 kobj:	kobject_put(memory_kobj);
-wq:	destroy_workqueue(memory_wq);
 	return error;
 }
 module_init(memory_state_time_init);
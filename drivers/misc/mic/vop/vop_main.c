@@ -141,6 +141,9 @@ static int vop_finalize_features(struct virtio_device *vdev)
 	/* Give virtio_ring a chance to accept features. */
 	vring_transport_features(vdev);
 
+	/* Our rings are laid out by vring_new_virtqueue(), split only */
+	__virtio_clear_bit(vdev, VIRTIO_F_RING_PACKED);
+
 	memset_io(out_features, 0, feature_len);
 	bits = min_t(unsigned, feature_len,
 		     sizeof(vdev->features)) * 8;
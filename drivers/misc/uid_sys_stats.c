@@ -13,6 +13,15 @@
  *
  */
 
+/*
+ * The cpu time and I/O of each task are added to the entry of its UID as
+ * they happen: the scheduler reports the cpu time it accounts to a task
+ * through uid_sys_stats_account(), which also folds in the I/O the task
+ * did since its last tick, and the rest of the I/O of a task is folded in
+ * when it exits.  The entries are read under RCU without walking the
+ * tasks, so a read costs O(UIDs).
+ */
+
 #include <linux/atomic.h>
 #include <linux/err.h>
 #include <linux/hashtable.h>
@@ -22,13 +31,16 @@
 #include <linux/mm.h>
 #include <linux/proc_fs.h>
 #include <linux/profile.h>
+#include <linux/rculist.h>
 #include <linux/rtmutex.h>
 #include <linux/sched.h>
 #include <linux/sched/signal.h>
 #include <linux/sched/cputime.h>
 #include <linux/seq_file.h>
 #include <linux/slab.h>
+#include <linux/spinlock.h>
 #include <linux/uaccess.h>
+#include <linux/uid_sys_stats.h>
 #include <linux/mm.h>
 
 
@@ -38,7 +50,16 @@ DECLARE_HASHTABLE(hash_table, UID_HASH_BITS);
 #define cputime_to_jiffies(__ct)       (__force unsigned long)(__ct)
 typedef u64 __nocast cputime_t;
 
+/*
+ * Entries can be added from the scheduler tick, so they are allocated
+ * without waking kswapd, which could need the runqueue lock.
+ */
+#define UID_ENTRY_GFP	(__GFP_HIGH | __GFP_NOWARN)
+
+/* Serializes the writers of /proc and, in debug, the per-task stats */
 static DEFINE_RT_MUTEX(uid_lock);
+/* Serializes the updates of hash_table, readers use RCU */
+static DEFINE_SPINLOCK(uid_hash_lock);
 static struct proc_dir_entry *cpu_parent;
 static struct proc_dir_entry *io_parent;
 static struct proc_dir_entry *proc_parent;
@@ -69,28 +90,36 @@ struct task_entry {
 	struct hlist_node hash;
 };
 
+struct uid_io_stats {
+	atomic64_t read_bytes;
+	atomic64_t write_bytes;
+	atomic64_t rchar;
+	atomic64_t wchar;
+	atomic64_t fsync;
+};
+
 struct uid_entry {
 	uid_t uid;
-	cputime_t utime;
-	cputime_t stime;
-	cputime_t active_utime;
-	cputime_t active_stime;
+	atomic64_t utime;
+	atomic64_t stime;
 	int state;
-	struct io_stats io[UID_STATE_SIZE];
+	struct uid_io_stats io[UID_STATE_BUCKET_SIZE];
 	struct hlist_node hash;
+	struct rcu_head rcu;
 #ifdef CONFIG_UID_SYS_STATS_DEBUG
 	DECLARE_HASHTABLE(task_entries, UID_HASH_BITS);
 #endif
 };
 
-static u64 compute_write_bytes(struct task_struct *task)
+static u64 compute_write_bytes(struct task_io_accounting *ioac)
 {
-	if (task->ioac.write_bytes <= task->ioac.cancelled_write_bytes)
+	if (ioac->write_bytes <= ioac->cancelled_write_bytes)
 		return 0;
 
-	return task->ioac.write_bytes - task->ioac.cancelled_write_bytes;
+	return ioac->write_bytes - ioac->cancelled_write_bytes;
 }
 
+#ifdef CONFIG_UID_SYS_STATS_DEBUG
 static void compute_io_bucket_stats(struct io_stats *io_bucket,
 					struct io_stats *io_curr,
 					struct io_stats *io_last,
@@ -124,7 +153,6 @@ static void compute_io_bucket_stats(struct io_stats *io_bucket,
 	memset(io_dead, 0, sizeof(struct io_stats));
 }
 
-#ifdef CONFIG_UID_SYS_STATS_DEBUG
 static void get_full_task_comm(struct task_entry *task_entry,
 		struct task_struct *task)
 {
@@ -249,10 +277,14 @@ static void add_uid_tasks_io_stats(struct uid_entry *uid_entry,
 		struct task_struct *task, int slot)
 {
 	struct task_entry *task_entry = find_or_register_task(uid_entry, task);
-	struct io_stats *task_io_slot = &task_entry->io[slot];
+	struct io_stats *task_io_slot;
 
+	if (!task_entry)
+		return;
+
+	task_io_slot = &task_entry->io[slot];
 	task_io_slot->read_bytes += task->ioac.read_bytes;
-	task_io_slot->write_bytes += compute_write_bytes(task);
+	task_io_slot->write_bytes += compute_write_bytes(&task->ioac);
 	task_io_slot->rchar += task->ioac.rchar;
 	task_io_slot->wchar += task->ioac.wchar;
 	task_io_slot->fsync += task->ioac.syscfs;
@@ -295,93 +327,194 @@ static void show_io_uid_tasks(struct seq_file *m, struct uid_entry *uid_entry)
 }
 #else
 static void remove_uid_tasks(struct uid_entry *uid_entry) {};
-static void set_io_uid_tasks_zero(struct uid_entry *uid_entry) {};
-static void add_uid_tasks_io_stats(struct uid_entry *uid_entry,
-		struct task_struct *task, int slot) {};
-static void compute_io_uid_tasks(struct uid_entry *uid_entry) {};
 static void show_io_uid_tasks(struct seq_file *m,
 		struct uid_entry *uid_entry) {}
 #endif
 
+static uid_t uid_of(struct task_struct *task)
+{
+	return from_kuid_munged(&init_user_ns, task_uid(task));
+}
+
 static struct uid_entry *find_uid_entry(uid_t uid)
 {
 	struct uid_entry *uid_entry;
-	hash_for_each_possible(hash_table, uid_entry, hash, uid) {
+
+	hash_for_each_possible_rcu(hash_table, uid_entry, hash, uid) {
 		if (uid_entry->uid == uid)
 			return uid_entry;
 	}
 	return NULL;
 }
 
+/* Called under rcu_read_lock(), possibly from the scheduler tick */
 static struct uid_entry *find_or_register_uid(uid_t uid)
 {
-	struct uid_entry *uid_entry;
+	struct uid_entry *uid_entry, *new_entry;
+	unsigned long flags;
 
 	uid_entry = find_uid_entry(uid);
 	if (uid_entry)
 		return uid_entry;
 
-	uid_entry = kzalloc(sizeof(struct uid_entry), GFP_ATOMIC);
-	if (!uid_entry)
+	new_entry = kzalloc(sizeof(struct uid_entry), UID_ENTRY_GFP);
+	if (!new_entry)
 		return NULL;
 
-	uid_entry->uid = uid;
+	new_entry->uid = uid;
 #ifdef CONFIG_UID_SYS_STATS_DEBUG
-	hash_init(uid_entry->task_entries);
+	hash_init(new_entry->task_entries);
 #endif
-	hash_add(hash_table, &uid_entry->hash, uid);
 
+	spin_lock_irqsave(&uid_hash_lock, flags);
+	/* Another cpu may have added the uid meanwhile */
+	uid_entry = find_uid_entry(uid);
+	if (!uid_entry) {
+		hash_add_rcu(hash_table, &new_entry->hash, uid);
+		uid_entry = new_entry;
+		new_entry = NULL;
+	}
+	spin_unlock_irqrestore(&uid_hash_lock, flags);
+
+	kfree(new_entry);
 	return uid_entry;
 }
 
-static int uid_cputime_show(struct seq_file *m, void *v)
+#ifdef CONFIG_UID_SYS_STATS_DEBUG
+/*
+ * The per-task stats are still computed by walking the tasks, on each
+ * read of /proc/uid_io/stats; they are only meant for debugging.  The
+ * uid_entry of a task_entry can't be removed while uid_lock is held.
+ */
+static void uid_tasks_lock(void)
 {
-	struct uid_entry *uid_entry = NULL;
+	rt_mutex_lock(&uid_lock);
+}
+
+static void uid_tasks_unlock(void)
+{
+	rt_mutex_unlock(&uid_lock);
+}
+
+/* Updates the per-task stats of @only, or of all the uids if NULL */
+static void update_io_uid_tasks_locked(struct uid_entry *only)
+{
+	struct uid_entry *uid_entry;
 	struct task_struct *task, *temp;
-	struct user_namespace *user_ns = current_user_ns();
-	cputime_t utime;
-	cputime_t stime;
 	unsigned long bkt;
 	uid_t uid;
 
-	rt_mutex_lock(&uid_lock);
-
-	hash_for_each(hash_table, bkt, uid_entry, hash) {
-		uid_entry->active_stime = 0;
-		uid_entry->active_utime = 0;
+	rcu_read_lock();
+	hash_for_each_rcu(hash_table, bkt, uid_entry, hash) {
+		if (!only || uid_entry == only)
+			set_io_uid_tasks_zero(uid_entry);
 	}
 
-	read_lock(&tasklist_lock);
+	uid_entry = NULL;
 	do_each_thread(temp, task) {
-		uid = from_kuid_munged(user_ns, task_uid(task));
+		uid = uid_of(task);
+		if (only && uid != only->uid)
+			continue;
 		if (!uid_entry || uid_entry->uid != uid)
 			uid_entry = find_or_register_uid(uid);
-		if (!uid_entry) {
-			read_unlock(&tasklist_lock);
-			rt_mutex_unlock(&uid_lock);
-			pr_err("%s: failed to find the uid_entry for uid %d\n",
-				__func__, uid);
-			return -ENOMEM;
-		}
-		task_cputime_adjusted(task, &utime, &stime);
-		uid_entry->active_utime += utime;
-		uid_entry->active_stime += stime;
+		if (!uid_entry)
+			continue;
+		add_uid_tasks_io_stats(uid_entry, task, UID_STATE_TOTAL_CURR);
 	} while_each_thread(temp, task);
-	read_unlock(&tasklist_lock);
 
-	hash_for_each(hash_table, bkt, uid_entry, hash) {
-		cputime_t total_utime = uid_entry->utime +
-							uid_entry->active_utime;
-		cputime_t total_stime = uid_entry->stime +
-							uid_entry->active_stime;
+	hash_for_each_rcu(hash_table, bkt, uid_entry, hash) {
+		if (!only || uid_entry == only)
+			compute_io_uid_tasks(uid_entry);
+	}
+	rcu_read_unlock();
+}
+
+static void add_dead_task_io_stats(struct task_struct *task, uid_t uid)
+{
+	struct uid_entry *uid_entry;
+
+	rt_mutex_lock(&uid_lock);
+	rcu_read_lock();
+	uid_entry = find_uid_entry(uid);
+	rcu_read_unlock();
+	if (uid_entry)
+		add_uid_tasks_io_stats(uid_entry, task, UID_STATE_DEAD_TASKS);
+	rt_mutex_unlock(&uid_lock);
+}
+#else
+static void uid_tasks_lock(void) {}
+static void uid_tasks_unlock(void) {}
+static void update_io_uid_tasks_locked(struct uid_entry *only) {}
+static void add_dead_task_io_stats(struct task_struct *task, uid_t uid) {}
+#endif
+
+static void add_io_delta(atomic64_t *stat, u64 now, u64 folded)
+{
+	/* The net written bytes go down when writes are cancelled */
+	if (now > folded)
+		atomic64_add(now - folded, stat);
+}
+
+/*
+ * Adds the I/O @task did since the last call to the current state bucket
+ * of its uid.  Called with interrupts disabled, from @task itself.
+ */
+static void fold_task_io(struct uid_entry *uid_entry, struct task_struct *task)
+{
+	struct task_io_accounting *ioac = &task->ioac;
+	struct task_io_accounting *folded = &task->uid_ioac;
+	struct uid_io_stats *io = &uid_entry->io[READ_ONCE(uid_entry->state)];
+
+	if (task->uid_ioac_task != task) {
+		/* Inherited from the parent, nothing folded yet */
+		memset(folded, 0, sizeof(*folded));
+		task->uid_ioac_task = task;
+	}
+
+	add_io_delta(&io->read_bytes, ioac->read_bytes, folded->read_bytes);
+	add_io_delta(&io->write_bytes, compute_write_bytes(ioac),
+		     compute_write_bytes(folded));
+	add_io_delta(&io->rchar, ioac->rchar, folded->rchar);
+	add_io_delta(&io->wchar, ioac->wchar, folded->wchar);
+	add_io_delta(&io->fsync, ioac->syscfs, folded->syscfs);
+
+	*folded = *ioac;
+}
+
+void uid_sys_stats_account(struct task_struct *p, u64 cputime, bool user)
+{
+	struct uid_entry *uid_entry;
+
+	rcu_read_lock();
+	uid_entry = find_or_register_uid(uid_of(p));
+	if (uid_entry) {
+		atomic64_add(cputime, user ? &uid_entry->utime :
+					     &uid_entry->stime);
+		/* Only the task itself updates its I/O counters */
+		if (p == current)
+			fold_task_io(uid_entry, p);
+	}
+	rcu_read_unlock();
+}
+
+static int uid_cputime_show(struct seq_file *m, void *v)
+{
+	struct uid_entry *uid_entry;
+	unsigned long bkt;
+
+	rcu_read_lock();
+	hash_for_each_rcu(hash_table, bkt, uid_entry, hash) {
+		cputime_t total_utime = atomic64_read(&uid_entry->utime);
+		cputime_t total_stime = atomic64_read(&uid_entry->stime);
+
 		seq_printf(m, "%d: %llu %llu\n", uid_entry->uid,
 			(unsigned long long)jiffies_to_msecs(
 				cputime_to_jiffies(total_utime)) * USEC_PER_MSEC,
 			(unsigned long long)jiffies_to_msecs(
 				cputime_to_jiffies(total_stime)) * USEC_PER_MSEC);
 	}
+	rcu_read_unlock();
 
-	rt_mutex_unlock(&uid_lock);
 	return 0;
 }
 
@@ -407,6 +540,7 @@ static ssize_t uid_remove_write(struct file *file,
 {
 	struct uid_entry *uid_entry;
 	struct hlist_node *tmp;
+	unsigned long bkt;
 	char uids[128];
 	char *start_uid, *end_uid = NULL;
 	long int uid_start = 0, uid_end = 0;
@@ -429,18 +563,17 @@ static ssize_t uid_remove_write(struct file *file,
 		return -EINVAL;
 	}
 	rt_mutex_lock(&uid_lock);
+	spin_lock_irq(&uid_hash_lock);
 
-	for (; uid_start <= uid_end; uid_start++) {
-		hash_for_each_possible_safe(hash_table, uid_entry, tmp,
-							hash, (uid_t)uid_start) {
-			if (uid_start == uid_entry->uid) {
-				remove_uid_tasks(uid_entry);
-				hash_del(&uid_entry->hash);
-				kfree(uid_entry);
-			}
+	hash_for_each_safe(hash_table, bkt, tmp, uid_entry, hash) {
+		if (uid_entry->uid >= uid_start && uid_entry->uid <= uid_end) {
+			remove_uid_tasks(uid_entry);
+			hash_del_rcu(&uid_entry->hash);
+			kfree_rcu(uid_entry, rcu);
 		}
 	}
 
+	spin_unlock_irq(&uid_hash_lock);
 	rt_mutex_unlock(&uid_lock);
 	return count;
 }
@@ -452,106 +585,41 @@ static const struct file_operations uid_remove_fops = {
 };
 
 
-static void add_uid_io_stats(struct uid_entry *uid_entry,
-			struct task_struct *task, int slot)
-{
-	struct io_stats *io_slot = &uid_entry->io[slot];
-
-	io_slot->read_bytes += task->ioac.read_bytes;
-	io_slot->write_bytes += compute_write_bytes(task);
-	io_slot->rchar += task->ioac.rchar;
-	io_slot->wchar += task->ioac.wchar;
-	io_slot->fsync += task->ioac.syscfs;
-
-	add_uid_tasks_io_stats(uid_entry, task, slot);
-}
-
-static void update_io_stats_all_locked(void)
-{
-	struct uid_entry *uid_entry = NULL;
-	struct task_struct *task, *temp;
-	struct user_namespace *user_ns = current_user_ns();
-	unsigned long bkt;
-	uid_t uid;
-
-	hash_for_each(hash_table, bkt, uid_entry, hash) {
-		memset(&uid_entry->io[UID_STATE_TOTAL_CURR], 0,
-			sizeof(struct io_stats));
-		set_io_uid_tasks_zero(uid_entry);
-	}
-
-	rcu_read_lock();
-	do_each_thread(temp, task) {
-		uid = from_kuid_munged(user_ns, task_uid(task));
-		if (!uid_entry || uid_entry->uid != uid)
-			uid_entry = find_or_register_uid(uid);
-		if (!uid_entry)
-			continue;
-		add_uid_io_stats(uid_entry, task, UID_STATE_TOTAL_CURR);
-	} while_each_thread(temp, task);
-	rcu_read_unlock();
-
-	hash_for_each(hash_table, bkt, uid_entry, hash) {
-		compute_io_bucket_stats(&uid_entry->io[uid_entry->state],
-					&uid_entry->io[UID_STATE_TOTAL_CURR],
-					&uid_entry->io[UID_STATE_TOTAL_LAST],
-					&uid_entry->io[UID_STATE_DEAD_TASKS]);
-		compute_io_uid_tasks(uid_entry);
-	}
-}
-
-static void update_io_stats_uid_locked(struct uid_entry *uid_entry)
-{
-	struct task_struct *task, *temp;
-	struct user_namespace *user_ns = current_user_ns();
-
-	memset(&uid_entry->io[UID_STATE_TOTAL_CURR], 0,
-		sizeof(struct io_stats));
-	set_io_uid_tasks_zero(uid_entry);
-
-	rcu_read_lock();
-	do_each_thread(temp, task) {
-		if (from_kuid_munged(user_ns, task_uid(task)) != uid_entry->uid)
-			continue;
-		add_uid_io_stats(uid_entry, task, UID_STATE_TOTAL_CURR);
-	} while_each_thread(temp, task);
-	rcu_read_unlock();
-
-	compute_io_bucket_stats(&uid_entry->io[uid_entry->state],
-				&uid_entry->io[UID_STATE_TOTAL_CURR],
-				&uid_entry->io[UID_STATE_TOTAL_LAST],
-				&uid_entry->io[UID_STATE_DEAD_TASKS]);
-	compute_io_uid_tasks(uid_entry);
-}
-
+#define uid_io_stat(uid_entry, state, field) \
+	((u64)atomic64_read(&(uid_entry)->io[state].field))
 
 static int uid_io_show(struct seq_file *m, void *v)
 {
 	struct uid_entry *uid_entry;
 	unsigned long bkt;
 
-	rt_mutex_lock(&uid_lock);
-
-	update_io_stats_all_locked();
+	uid_tasks_lock();
+	update_io_uid_tasks_locked(NULL);
 
-	hash_for_each(hash_table, bkt, uid_entry, hash) {
+	rcu_read_lock();
+	hash_for_each_rcu(hash_table, bkt, uid_entry, hash) {
 		seq_printf(m, "%d %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu\n",
 				uid_entry->uid,
-				uid_entry->io[UID_STATE_FOREGROUND].rchar,
-				uid_entry->io[UID_STATE_FOREGROUND].wchar,
-				uid_entry->io[UID_STATE_FOREGROUND].read_bytes,
-				uid_entry->io[UID_STATE_FOREGROUND].write_bytes,
-				uid_entry->io[UID_STATE_BACKGROUND].rchar,
-				uid_entry->io[UID_STATE_BACKGROUND].wchar,
-				uid_entry->io[UID_STATE_BACKGROUND].read_bytes,
-				uid_entry->io[UID_STATE_BACKGROUND].write_bytes,
-				uid_entry->io[UID_STATE_FOREGROUND].fsync,
-				uid_entry->io[UID_STATE_BACKGROUND].fsync);
+				uid_io_stat(uid_entry, UID_STATE_FOREGROUND, rchar),
+				uid_io_stat(uid_entry, UID_STATE_FOREGROUND, wchar),
+				uid_io_stat(uid_entry, UID_STATE_FOREGROUND,
+					    read_bytes),
+				uid_io_stat(uid_entry, UID_STATE_FOREGROUND,
+					    write_bytes),
+				uid_io_stat(uid_entry, UID_STATE_BACKGROUND, rchar),
+				uid_io_stat(uid_entry, UID_STATE_BACKGROUND, wchar),
+				uid_io_stat(uid_entry, UID_STATE_BACKGROUND,
+					    read_bytes),
+				uid_io_stat(uid_entry, UID_STATE_BACKGROUND,
+					    write_bytes),
+				uid_io_stat(uid_entry, UID_STATE_FOREGROUND, fsync),
+				uid_io_stat(uid_entry, UID_STATE_BACKGROUND, fsync));
 
 		show_io_uid_tasks(m, uid_entry);
 	}
+	rcu_read_unlock();
 
-	rt_mutex_unlock(&uid_lock);
+	uid_tasks_unlock();
 	return 0;
 }
 
@@ -595,9 +663,12 @@ static ssize_t uid_procstat_write(struct file *file,
 	if (state != UID_STATE_BACKGROUND && state != UID_STATE_FOREGROUND)
 		return -EINVAL;
 
+	/* uid_lock keeps the entry from being removed */
 	rt_mutex_lock(&uid_lock);
 
+	rcu_read_lock();
 	uid_entry = find_or_register_uid(uid);
+	rcu_read_unlock();
 	if (!uid_entry) {
 		rt_mutex_unlock(&uid_lock);
 		return -EINVAL;
@@ -608,9 +679,10 @@ static ssize_t uid_procstat_write(struct file *file,
 		return count;
 	}
 
-	update_io_stats_uid_locked(uid_entry);
+	update_io_uid_tasks_locked(uid_entry);
 
-	uid_entry->state = state;
+	/* The I/O the tasks of the uid fold from now on goes to @state */
+	WRITE_ONCE(uid_entry->state, state);
 
 	rt_mutex_unlock(&uid_lock);
 
@@ -628,28 +700,29 @@ static int process_notifier(struct notifier_block *self,
 {
 	struct task_struct *task = v;
 	struct uid_entry *uid_entry;
-	cputime_t utime, stime;
+	unsigned long flags;
 	uid_t uid;
 
 	if (!task)
 		return NOTIFY_OK;
 
-	rt_mutex_lock(&uid_lock);
-	uid = from_kuid_munged(current_user_ns(), task_uid(task));
+	/* The cpu time of @task was added at each tick already */
+	uid = uid_of(task);
+	rcu_read_lock();
 	uid_entry = find_or_register_uid(uid);
+	if (uid_entry) {
+		local_irq_save(flags);
+		fold_task_io(uid_entry, task);
+		local_irq_restore(flags);
+	}
+	rcu_read_unlock();
+
 	if (!uid_entry) {
 		pr_err("%s: failed to find uid %d\n", __func__, uid);
-		goto exit;
+		return NOTIFY_OK;
 	}
 
-	task_cputime_adjusted(task, &utime, &stime);
-	uid_entry->utime += utime;
-	uid_entry->stime += stime;
-
-	add_uid_io_stats(uid_entry, task, UID_STATE_DEAD_TASKS);
-
-exit:
-	rt_mutex_unlock(&uid_lock);
+	add_dead_task_io_stats(task, uid);
 	return NOTIFY_OK;
 }
 
@@ -659,8 +732,7 @@ static struct notifier_block process_notifier_block = {
 
 static int __init proc_uid_sys_stats_init(void)
 {
-	hash_init(hash_table);
-
+	/* hash_table is not reset, the scheduler tick may have filled it */
 	cpu_parent = proc_mkdir("uid_cputime", NULL);
 	if (!cpu_parent) {
 		pr_err("%s: failed to create uid_cputime proc entry\n",
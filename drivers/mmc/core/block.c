@@ -65,6 +65,8 @@ MODULE_ALIAS("mmc:block");
 
 #define MMC_BLK_TIMEOUT_MS  (10 * 60 * 1000)        /* 10 minute timeout */
 #define MMC_SANITIZE_REQ_TIMEOUT 240000
+#define MMC_CQE_RETRIES 2
+#define MMC_PACKED_THRESHOLD 64	/* largest packed write, in sectors */
 #define MMC_EXTRACT_INDEX_FROM_ARG(x) ((x & 0x00FF0000) >> 16)
 
 #define mmc_req_rel_wr(req)	((req->cmd_flags & REQ_FUA) && \
@@ -101,6 +103,7 @@ struct mmc_blk_data {
 	unsigned int	flags;
 #define MMC_BLK_CMD23	(1 << 0)	/* Can do SET_BLOCK_COUNT for multiblock */
 #define MMC_BLK_REL_WR	(1 << 1)	/* MMC Reliable write support */
+#define MMC_BLK_PACKED_CMD	(1 << 2)	/* MMC packed write support */
 
 	unsigned int	usage;
 	unsigned int	read_only;
@@ -111,6 +114,7 @@ struct mmc_blk_data {
 #define MMC_BLK_DISCARD		BIT(2)
 #define MMC_BLK_SECDISCARD	BIT(3)
 #define MMC_BLK_RPMB		BIT(4)
+#define MMC_BLK_CQE_RECOVERY	BIT(5)
 
 	/*
 	 * Only set in main mmc_blk_data associated
@@ -121,10 +125,139 @@ struct mmc_blk_data {
 	struct device_attribute force_ro;
 	struct device_attribute power_ro_lock;
 	int	area_type;
+
+	/* Writes of up to this many sectors are packed, 0 disables packing */
+	unsigned int	packed_threshold;
+
+#ifdef CONFIG_MMC_BLOCK_LATENCY_HIST
+	struct mmc_blk_lat __percpu *lat;
+#endif
 };
 
 static DEFINE_MUTEX(open_lock);
 
+#ifdef CONFIG_MMC_BLOCK_LATENCY_HIST
+
+/*
+ * Latency histograms, per partition and kind of request, measured from the
+ * dispatch of a request to the driver to its completion.  Bucket 0 counts
+ * the requests that took less than 64us, and each next bucket doubles that
+ * bound, up to the last bucket that counts all the requests that took more
+ * than about 1s.
+ */
+#define MMC_LAT_BUCKETS		16
+#define MMC_LAT_MIN_SHIFT	6	/* 64us */
+
+enum mmc_blk_lat_type {
+	MMC_LAT_READ,
+	MMC_LAT_WRITE,
+	MMC_LAT_DISCARD,
+	MMC_LAT_FLUSH,
+	MMC_LAT_DRV_OP,
+	MMC_LAT_TYPES,
+};
+
+static const char * const mmc_blk_lat_names[MMC_LAT_TYPES] = {
+	[MMC_LAT_READ]		= "read",
+	[MMC_LAT_WRITE]		= "write",
+	[MMC_LAT_DISCARD]	= "discard",
+	[MMC_LAT_FLUSH]		= "flush",
+	[MMC_LAT_DRV_OP]	= "ioctl",
+};
+
+struct mmc_blk_lat_hist {
+	u64	buckets[MMC_LAT_BUCKETS];
+	u64	total_us;
+	u64	max_us;
+};
+
+struct mmc_blk_lat {
+	struct mmc_blk_lat_hist hist[MMC_LAT_TYPES];
+};
+
+static int mmc_blk_alloc_lat(struct mmc_blk_data *md)
+{
+	md->lat = alloc_percpu(struct mmc_blk_lat);
+	return md->lat ? 0 : -ENOMEM;
+}
+
+static void mmc_blk_free_lat(struct mmc_blk_data *md)
+{
+	free_percpu(md->lat);
+}
+
+static enum mmc_blk_lat_type mmc_blk_lat_type(struct request *req)
+{
+	switch (req_op(req)) {
+	case REQ_OP_READ:
+		return MMC_LAT_READ;
+	case REQ_OP_WRITE:
+		return MMC_LAT_WRITE;
+	case REQ_OP_DISCARD:
+	case REQ_OP_SECURE_ERASE:
+		return MMC_LAT_DISCARD;
+	case REQ_OP_FLUSH:
+		return MMC_LAT_FLUSH;
+	default:
+		return MMC_LAT_DRV_OP;
+	}
+}
+
+static void mmc_blk_account_lat(struct request *req)
+{
+	struct mmc_queue *mq = req->q->queuedata;
+	struct mmc_queue_req *mqrq = req_to_mmc_queue_req(req);
+	struct mmc_blk_lat_hist *hist;
+	unsigned long flags;
+	unsigned int idx;
+	u64 us;
+
+	us = ktime_us_delta(ktime_get(), mqrq->issue_time);
+	if (us < (1 << MMC_LAT_MIN_SHIFT))
+		idx = 0;
+	else
+		idx = min_t(unsigned int, ilog2(us) - MMC_LAT_MIN_SHIFT + 1,
+			    MMC_LAT_BUCKETS - 1);
+
+	/* CQE requests complete in interrupt context */
+	local_irq_save(flags);
+	hist = &this_cpu_ptr(mq->blkdata->lat)->hist[mmc_blk_lat_type(req)];
+	hist->buckets[idx]++;
+	hist->total_us += us;
+	if (us > hist->max_us)
+		hist->max_us = us;
+	local_irq_restore(flags);
+}
+
+#else
+
+static inline int mmc_blk_alloc_lat(struct mmc_blk_data *md)
+{
+	return 0;
+}
+
+static inline void mmc_blk_free_lat(struct mmc_blk_data *md)
+{
+}
+
+static inline void mmc_blk_account_lat(struct request *req)
+{
+}
+
+#endif /* CONFIG_MMC_BLOCK_LATENCY_HIST */
+
+static void mmc_blk_mq_end_request(struct request *req, blk_status_t error)
+{
+	mmc_blk_account_lat(req);
+	blk_mq_end_request(req, error);
+}
+
+static void __mmc_blk_mq_end_request(struct request *req, blk_status_t error)
+{
+	mmc_blk_account_lat(req);
+	__blk_mq_end_request(req, error);
+}
+
 module_param(perdev_minors, int, 0444);
 MODULE_PARM_DESC(perdev_minors, "Minors numbers to allocate per device");
 
@@ -158,9 +291,10 @@ static void mmc_blk_put(struct mmc_blk_data *md)
 	md->usage--;
 	if (md->usage == 0) {
 		int devidx = mmc_get_devidx(md->disk);
-		blk_cleanup_queue(md->queue.queue);
+		blk_put_queue(md->queue.queue);
 		ida_simple_remove(&mmc_blk_ida, devidx);
 		put_disk(md->disk);
+		mmc_blk_free_lat(md);
 		kfree(md);
 	}
 	mutex_unlock(&open_lock);
@@ -206,9 +340,14 @@ static ssize_t power_ro_lock_store(struct device *dev,
 
 	/* Dispatch locking to the block layer */
 	req = blk_get_request(mq->queue, REQ_OP_DRV_OUT, __GFP_RECLAIM);
+	if (IS_ERR(req)) {
+		count = PTR_ERR(req);
+		goto out_put;
+	}
 	req_to_mmc_queue_req(req)->drv_op = MMC_DRV_OP_BOOT_WP;
 	blk_execute_rq(mq->queue, NULL, req, 0);
 	ret = req_to_mmc_queue_req(req)->drv_op_result;
+	blk_put_request(req);
 
 	if (!ret) {
 		pr_info("%s: Locking boot partition ro until next power on\n",
@@ -221,7 +360,7 @@ static ssize_t power_ro_lock_store(struct device *dev,
 				set_disk_ro(part_md->disk, 1);
 			}
 	}
-
+out_put:
 	mmc_blk_put(md);
 	return count;
 }
@@ -258,6 +397,119 @@ static ssize_t force_ro_store(struct device *dev, struct device_attribute *attr,
 	return ret;
 }
 
+static ssize_t packed_threshold_show(struct device *dev,
+				     struct device_attribute *attr, char *buf)
+{
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+	int ret;
+
+	ret = snprintf(buf, PAGE_SIZE, "%u\n", READ_ONCE(md->packed_threshold));
+	mmc_blk_put(md);
+	return ret;
+}
+
+static ssize_t packed_threshold_store(struct device *dev,
+				      struct device_attribute *attr,
+				      const char *buf, size_t count)
+{
+	struct mmc_blk_data *md;
+	unsigned int set;
+
+	if (kstrtouint(buf, 0, &set))
+		return -EINVAL;
+
+	md = mmc_blk_get(dev_to_disk(dev));
+	WRITE_ONCE(md->packed_threshold, set);
+	mmc_blk_put(md);
+	return count;
+}
+
+static const DEVICE_ATTR(packed_threshold, S_IRUGO | S_IWUSR,
+	packed_threshold_show, packed_threshold_store);
+
+/*
+ * Packed commands issued, writes and sectors sent in them, packable writes
+ * sent on their own, and packed commands that failed.
+ */
+static ssize_t packed_stats_show(struct device *dev,
+				 struct device_attribute *attr, char *buf)
+{
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+	struct mmc_packed_stats *stats = &md->queue.packed_stats;
+	int ret;
+
+	ret = snprintf(buf, PAGE_SIZE, "%lu %lu %lu %lu %lu\n",
+		       stats->groups, stats->packed_reqs, stats->packed_blocks,
+		       stats->single_reqs, stats->failed_groups);
+	mmc_blk_put(md);
+	return ret;
+}
+
+static const DEVICE_ATTR(packed_stats, S_IRUGO, packed_stats_show, NULL);
+
+#ifdef CONFIG_MMC_BLOCK_LATENCY_HIST
+
+/*
+ * One line per kind of request: its name, the number of requests, their
+ * total and maximum latency in us, then the MMC_LAT_BUCKETS buckets.
+ * Writing anything clears the histograms.
+ */
+static ssize_t io_latency_show(struct device *dev,
+			       struct device_attribute *attr, char *buf)
+{
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+	struct mmc_blk_lat_hist sum;
+	ssize_t ret = 0;
+	int type, cpu, i;
+
+	for (type = 0; type < MMC_LAT_TYPES; type++) {
+		u64 count = 0;
+
+		memset(&sum, 0, sizeof(sum));
+		for_each_possible_cpu(cpu) {
+			struct mmc_blk_lat_hist *hist =
+				&per_cpu_ptr(md->lat, cpu)->hist[type];
+
+			for (i = 0; i < MMC_LAT_BUCKETS; i++)
+				sum.buckets[i] += hist->buckets[i];
+			sum.total_us += hist->total_us;
+			sum.max_us = max(sum.max_us, hist->max_us);
+		}
+		for (i = 0; i < MMC_LAT_BUCKETS; i++)
+			count += sum.buckets[i];
+
+		ret += scnprintf(buf + ret, PAGE_SIZE - ret, "%s %llu %llu %llu",
+				 mmc_blk_lat_names[type], count, sum.total_us,
+				 sum.max_us);
+		for (i = 0; i < MMC_LAT_BUCKETS; i++)
+			ret += scnprintf(buf + ret, PAGE_SIZE - ret, " %llu",
+					 sum.buckets[i]);
+		ret += scnprintf(buf + ret, PAGE_SIZE - ret, "\n");
+	}
+
+	mmc_blk_put(md);
+	return ret;
+}
+
+static ssize_t io_latency_store(struct device *dev,
+				struct device_attribute *attr,
+				const char *buf, size_t count)
+{
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(md->lat, cpu), 0, sizeof(struct mmc_blk_lat));
+
+	mmc_blk_put(md);
+	return count;
+}
+
+static const DEVICE_ATTR(io_latency, S_IRUGO | S_IWUSR,
+	io_latency_show, io_latency_store);
+
+#endif
+
 #ifdef CONFIG_MMC_SIMULATE_MAX_SPEED
 
 static int max_read_speed, max_write_speed, cache_size = 4;
@@ -826,6 +1078,10 @@ static int mmc_blk_ioctl_cmd(struct mmc_blk_data *md,
 	req = blk_get_request(mq->queue,
 		idata->ic.write_flag ? REQ_OP_DRV_OUT : REQ_OP_DRV_IN,
 		__GFP_RECLAIM);
+	if (IS_ERR(req)) {
+		err = PTR_ERR(req);
+		goto cmd_done;
+	}
 	idatas[0] = idata;
 	req_to_mmc_queue_req(req)->drv_op = MMC_DRV_OP_IOCTL;
 	req_to_mmc_queue_req(req)->drv_op_data = idatas;
@@ -889,6 +1145,10 @@ static int mmc_blk_ioctl_multi_cmd(struct mmc_blk_data *md,
 	req = blk_get_request(mq->queue,
 		idata[0]->ic.write_flag ? REQ_OP_DRV_OUT : REQ_OP_DRV_IN,
 		__GFP_RECLAIM);
+	if (IS_ERR(req)) {
+		err = PTR_ERR(req);
+		goto cmd_err;
+	}
 	req_to_mmc_queue_req(req)->drv_op = MMC_DRV_OP_IOCTL;
 	req_to_mmc_queue_req(req)->drv_op_data = idata;
 	req_to_mmc_queue_req(req)->ioc_count = num_of_cmds;
@@ -1410,6 +1670,20 @@ int mmc_access_rpmb(struct mmc_queue *mq)
 	return false;
 }
 
+/*
+ * Complete @nr_bytes of @req, returning true if some of it is still pending,
+ * as blk_end_request() does on a legacy request queue.
+ */
+static bool mmc_blk_end_request(struct request *req, blk_status_t error,
+				unsigned int nr_bytes)
+{
+	if (blk_update_request(req, error, nr_bytes))
+		return true;
+
+	__mmc_blk_mq_end_request(req, error);
+	return false;
+}
+
 /*
  * The non-block commands come back from the block layer after it queued it and
  * processed it with all other requests and then they get issued in this
@@ -1469,7 +1743,7 @@ static void mmc_blk_issue_drv_op(struct mmc_queue *mq, struct request *req)
 		break;
 	}
 	mq_rq->drv_op_result = ret;
-	blk_end_request_all(req, ret ? BLK_STS_IOERR : BLK_STS_OK);
+	mmc_blk_mq_end_request(req, ret ? BLK_STS_IOERR : BLK_STS_OK);
 }
 
 static int mmc_rpmb_send_cmd(struct mmc_card *card,
@@ -1577,7 +1851,7 @@ static int mmc_blk_rpmb_process(struct mmc_blk_data *md,
 	if (!card || !mmc_card_mmc(card))
 		return -ENODEV;
 
-	mmc_get_card(card);
+	mmc_get_card(card, NULL);
 
 	/* switch to RPMB partition */
 	ret = mmc_blk_part_switch(card, md->part_type);
@@ -1608,7 +1882,7 @@ static int mmc_blk_rpmb_process(struct mmc_blk_data *md,
 	main_md = dev_get_drvdata(&card->dev);
 	mmc_blk_part_switch(card, main_md->part_type);
 out:
-	mmc_put_card(card);
+	mmc_put_card(card, NULL);
 	return ret;
 }
 
@@ -1761,7 +2035,7 @@ static void mmc_blk_issue_discard_rq(struct mmc_queue *mq, struct request *req)
 	else
 		mmc_blk_reset_success(md, type);
 fail:
-	blk_end_request(req, status, blk_rq_bytes(req));
+	mmc_blk_mq_end_request(req, status);
 }
 
 static void mmc_blk_issue_secdiscard_rq(struct mmc_queue *mq,
@@ -1831,7 +2105,7 @@ static void mmc_blk_issue_secdiscard_rq(struct mmc_queue *mq,
 	if (!err)
 		mmc_blk_reset_success(md, type);
 out:
-	blk_end_request(req, status, blk_rq_bytes(req));
+	mmc_blk_mq_end_request(req, status);
 }
 
 static void mmc_blk_issue_flush(struct mmc_queue *mq, struct request *req)
@@ -1859,7 +2133,7 @@ static void mmc_blk_issue_flush(struct mmc_queue *mq, struct request *req)
 		}
 	}
 #endif
-	blk_end_request_all(req, ret ? BLK_STS_IOERR : BLK_STS_OK);
+	mmc_blk_mq_end_request(req, ret ? BLK_STS_IOERR : BLK_STS_OK);
 }
 
 /*
@@ -2040,6 +2314,12 @@ static enum mmc_blk_status mmc_blk_err_check(struct mmc_card *card,
 	if (!brq->data.bytes_xfered)
 		return MMC_BLK_RETRY;
 
+	if (mq_mrq->packed) {
+		if (brq->data.blocks << 9 != brq->data.bytes_xfered)
+			return MMC_BLK_PARTIAL;
+		return MMC_BLK_SUCCESS;
+	}
+
 	if (blk_rq_bytes(req) != brq->data.bytes_xfered)
 		return MMC_BLK_PARTIAL;
 
@@ -2047,25 +2327,27 @@ static enum mmc_blk_status mmc_blk_err_check(struct mmc_card *card,
 }
 
 static void mmc_blk_data_prep(struct mmc_queue *mq, struct mmc_queue_req *mqrq,
-			      int disable_multi, bool *do_rel_wr,
-			      bool *do_data_tag)
+			      int disable_multi, bool *do_rel_wr_p,
+			      bool *do_data_tag_p)
 {
 	struct mmc_blk_data *md = mq->blkdata;
 	struct mmc_card *card = md->queue.card;
 	struct mmc_blk_request *brq = &mqrq->brq;
 	struct request *req = mmc_queue_req_to_req(mqrq);
+	bool do_rel_wr, do_data_tag;
 
 	/*
 	 * Reliable writes are used to implement Forced Unit Access and
 	 * are supported only on MMCs.
 	 */
-	*do_rel_wr = (req->cmd_flags & REQ_FUA) &&
-		     rq_data_dir(req) == WRITE &&
-		     (md->flags & MMC_BLK_REL_WR);
+	do_rel_wr = (req->cmd_flags & REQ_FUA) &&
+		    rq_data_dir(req) == WRITE &&
+		    (md->flags & MMC_BLK_REL_WR);
 
 	memset(brq, 0, sizeof(struct mmc_blk_request));
 
 	brq->mrq.data = &brq->data;
+	brq->mrq.tag = req->tag;
 
 	brq->stop.opcode = MMC_STOP_TRANSMISSION;
 	brq->stop.arg = 0;
@@ -2080,6 +2362,14 @@ static void mmc_blk_data_prep(struct mmc_queue *mq, struct mmc_queue_req *mqrq,
 
 	brq->data.blksz = 512;
 	brq->data.blocks = blk_rq_sectors(req);
+	brq->data.blk_addr = blk_rq_pos(req);
+
+	/*
+	 * The command queue supports 2 priorities: "high" (1) and "simple" (0).
+	 * The eMMC will give "high" priority tasks priority over "simple"
+	 * priority tasks. Here we always set "simple" priority by not setting
+	 * MMC_DATA_PRIO.
+	 */
 
 	/*
 	 * The block layer doesn't support all sector count
@@ -2109,21 +2399,33 @@ static void mmc_blk_data_prep(struct mmc_queue *mq, struct mmc_queue_req *mqrq,
 						brq->data.blocks);
 	}
 
-	if (*do_rel_wr)
+	if (do_rel_wr) {
 		mmc_apply_rel_rw(brq, card, req);
+		brq->data.flags |= MMC_DATA_REL_WR;
+	}
 
 	/*
 	 * Data tag is used only during writing meta data to speed
 	 * up write and any subsequent read of this meta data
 	 */
-	*do_data_tag = card->ext_csd.data_tag_unit_size &&
-		       (req->cmd_flags & REQ_META) &&
-		       (rq_data_dir(req) == WRITE) &&
-		       ((brq->data.blocks * brq->data.blksz) >=
-			card->ext_csd.data_tag_unit_size);
+	do_data_tag = card->ext_csd.data_tag_unit_size &&
+		      (req->cmd_flags & REQ_META) &&
+		      (rq_data_dir(req) == WRITE) &&
+		      ((brq->data.blocks * brq->data.blksz) >=
+		       card->ext_csd.data_tag_unit_size);
+
+	if (do_data_tag)
+		brq->data.flags |= MMC_DATA_DAT_TAG;
 
 	mmc_set_data_timeout(&brq->data, card);
 
+	/* All the bios of a request share the key of the first one */
+	if (req->bio && bio_is_inline_encrypted(req->bio)) {
+		brq->mrq.crypto_enabled = true;
+		brq->mrq.crypto_key_slot = req->bio->bi_crypt_slot;
+		brq->mrq.crypto_dun = req->bio->bi_crypt_dun;
+	}
+
 	brq->data.sg = mqrq->sg;
 	brq->data.sg_len = mmc_queue_map_sg(mq, mqrq);
 
@@ -2147,6 +2449,144 @@ static void mmc_blk_data_prep(struct mmc_queue *mq, struct mmc_queue_req *mqrq,
 	}
 
 	mqrq->areq.mrq = &brq->mrq;
+
+	if (do_rel_wr_p)
+		*do_rel_wr_p = do_rel_wr;
+
+	if (do_data_tag_p)
+		*do_data_tag_p = do_data_tag;
+}
+
+void mmc_blk_cqe_complete_rq(struct request *req)
+{
+	struct mmc_queue_req *mqrq = req_to_mmc_queue_req(req);
+	struct mmc_request *mrq = &mqrq->brq.mrq;
+	struct request_queue *q = req->q;
+	struct mmc_queue *mq = q->queuedata;
+	struct mmc_host *host = mq->card->host;
+	enum mmc_issue_type issue_type = mmc_issue_type(mq, req);
+	unsigned long flags;
+	bool put_card;
+	int err;
+
+	mmc_cqe_post_req(host, mrq);
+
+	if (mrq->cmd && mrq->cmd->error)
+		err = mrq->cmd->error;
+	else if (mrq->data && mrq->data->error)
+		err = mrq->data->error;
+	else
+		err = 0;
+
+	if (err) {
+		if (mqrq->retries++ < MMC_CQE_RETRIES)
+			blk_mq_requeue_request(req, true);
+		else
+			mmc_blk_mq_end_request(req, BLK_STS_IOERR);
+	} else if (mrq->data) {
+		if (blk_update_request(req, BLK_STS_OK, mrq->data->bytes_xfered))
+			blk_mq_requeue_request(req, true);
+		else
+			__mmc_blk_mq_end_request(req, BLK_STS_OK);
+	} else {
+		mmc_blk_mq_end_request(req, BLK_STS_OK);
+	}
+
+	spin_lock_irqsave(q->queue_lock, flags);
+
+	mq->in_flight[issue_type] -= 1;
+
+	put_card = (mmc_tot_in_flight(mq) == 0);
+
+	mmc_cqe_check_busy(mq);
+
+	spin_unlock_irqrestore(q->queue_lock, flags);
+
+	if (!mq->cqe_busy)
+		blk_mq_run_hw_queues(q, true);
+
+	if (put_card)
+		mmc_put_card(mq->card, &mq->ctx);
+}
+
+void mmc_blk_cqe_recovery(struct mmc_queue *mq)
+{
+	struct mmc_card *card = mq->card;
+	struct mmc_host *host = card->host;
+	int err;
+
+	pr_debug("%s: CQE recovery start\n", mmc_hostname(host));
+
+	err = mmc_cqe_recovery(host);
+	if (err)
+		mmc_blk_reset(mq->blkdata, host, MMC_BLK_CQE_RECOVERY);
+	else
+		mmc_blk_reset_success(mq->blkdata, MMC_BLK_CQE_RECOVERY);
+
+	pr_debug("%s: CQE recovery done\n", mmc_hostname(host));
+}
+
+static void mmc_blk_cqe_req_done(struct mmc_request *mrq)
+{
+	struct mmc_queue_req *mqrq = container_of(mrq, struct mmc_queue_req,
+						  brq.mrq);
+	struct request *req = mmc_queue_req_to_req(mqrq);
+	struct request_queue *q = req->q;
+	struct mmc_queue *mq = q->queuedata;
+
+	/*
+	 * Block layer timeouts race with completions which means the normal
+	 * completion path cannot be used during recovery.
+	 */
+	if (mq->in_recovery)
+		mmc_blk_cqe_complete_rq(req);
+	else
+		blk_mq_complete_request(req);
+}
+
+static int mmc_blk_cqe_start_req(struct mmc_host *host, struct mmc_request *mrq)
+{
+	mrq->done		= mmc_blk_cqe_req_done;
+	mrq->recovery_notifier	= mmc_cqe_recovery_notifier;
+
+	return mmc_cqe_start_req(host, mrq);
+}
+
+static struct mmc_request *mmc_blk_cqe_prep_dcmd(struct mmc_queue_req *mqrq,
+						 struct request *req)
+{
+	struct mmc_blk_request *brq = &mqrq->brq;
+
+	memset(brq, 0, sizeof(*brq));
+
+	brq->mrq.cmd = &brq->cmd;
+	brq->mrq.tag = req->tag;
+
+	return &brq->mrq;
+}
+
+static int mmc_blk_cqe_issue_flush(struct mmc_queue *mq, struct request *req)
+{
+	struct mmc_queue_req *mqrq = req_to_mmc_queue_req(req);
+	struct mmc_request *mrq = mmc_blk_cqe_prep_dcmd(mqrq, req);
+
+	mrq->cmd->opcode = MMC_SWITCH;
+	mrq->cmd->arg = (MMC_SWITCH_MODE_WRITE_BYTE << 24) |
+			(EXT_CSD_FLUSH_CACHE << 16) |
+			(1 << 8) |
+			EXT_CSD_CMD_SET_NORMAL;
+	mrq->cmd->flags = MMC_CMD_AC | MMC_RSP_R1B;
+
+	return mmc_blk_cqe_start_req(mq->card->host, mrq);
+}
+
+static int mmc_blk_cqe_issue_rw_rq(struct mmc_queue *mq, struct request *req)
+{
+	struct mmc_queue_req *mqrq = req_to_mmc_queue_req(req);
+
+	mmc_blk_data_prep(mq, mqrq, 0, NULL, NULL);
+
+	return mmc_blk_cqe_start_req(mq->card->host, &mqrq->brq.mrq);
 }
 
 static void mmc_blk_rw_rq_prep(struct mmc_queue_req *mqrq,
@@ -2217,6 +2657,197 @@ static void mmc_blk_rw_rq_prep(struct mmc_queue_req *mqrq,
 	mqrq->areq.err_check = mmc_blk_err_check;
 }
 
+#define PACKED_CMD_VER	0x01
+#define PACKED_CMD_WR	0x02
+
+static inline unsigned int mmc_blk_packed_max_entries(struct mmc_card *card,
+						      unsigned int hdr_blocks)
+{
+	/* The first entry of the header is taken by the header itself */
+	return min_t(unsigned int, card->ext_csd.max_packed_writes,
+		     (hdr_blocks << 9) / 8 - 1);
+}
+
+static enum mmc_blk_status mmc_blk_packed_err_check(struct mmc_card *card,
+						    struct mmc_async_req *areq)
+{
+	struct mmc_queue_req *mq_rq = container_of(areq, struct mmc_queue_req,
+						   areq);
+	struct request *req = mmc_queue_req_to_req(mq_rq);
+	struct mmc_packed *packed = mq_rq->packed;
+	enum mmc_blk_status check;
+	u32 status;
+	u8 *ext_csd;
+	int err;
+
+	packed->idx_failure = MMC_PACKED_NR_IDX;
+
+	check = mmc_blk_err_check(card, areq);
+	err = __mmc_send_status(card, &status, 0);
+	if (err) {
+		pr_err("%s: error %d sending status command\n",
+		       req->rq_disk->disk_name, err);
+		return MMC_BLK_ABORT;
+	}
+
+	if (status & R1_EXCEPTION_EVENT) {
+		err = mmc_get_ext_csd(card, &ext_csd);
+		if (err) {
+			pr_err("%s: error %d sending ext_csd\n",
+			       req->rq_disk->disk_name, err);
+			return MMC_BLK_ABORT;
+		}
+
+		if ((ext_csd[EXT_CSD_EXP_EVENTS_STATUS] &
+		     EXT_CSD_PACKED_FAILURE) &&
+		    (ext_csd[EXT_CSD_PACKED_CMD_STATUS] &
+		     EXT_CSD_PACKED_GENERIC_ERROR)) {
+			if (ext_csd[EXT_CSD_PACKED_CMD_STATUS] &
+			    EXT_CSD_PACKED_INDEXED_ERROR) {
+				packed->idx_failure =
+				  ext_csd[EXT_CSD_PACKED_FAILURE_INDEX] - 1;
+				check = MMC_BLK_PARTIAL;
+			}
+			pr_err("%s: packed cmd failed, nr %u, sectors %u, failure index: %d\n",
+			       req->rq_disk->disk_name, packed->nr_entries,
+			       packed->blocks, packed->idx_failure);
+		}
+		kfree(ext_csd);
+	}
+
+	return check;
+}
+
+static void mmc_blk_packed_hdr_wrq_prep(struct mmc_queue_req *mqrq,
+					struct mmc_card *card,
+					struct mmc_queue *mq)
+{
+	struct mmc_blk_request *brq = &mqrq->brq;
+	struct request *req = mmc_queue_req_to_req(mqrq);
+	struct mmc_blk_data *md = mq->blkdata;
+	struct mmc_packed *packed = mqrq->packed;
+	__le32 *packed_cmd_hdr = packed->cmd_hdr;
+	struct request *prq;
+	bool do_rel_wr, do_data_tag;
+	int i = 1;
+
+	memset(packed_cmd_hdr, 0, packed->hdr_blocks << 9);
+	packed_cmd_hdr[0] = cpu_to_le32((packed->nr_entries << 16) |
+		(PACKED_CMD_WR << 8) | PACKED_CMD_VER);
+
+	/*
+	 * Argument for each entry of packed group
+	 */
+	list_for_each_entry(prq, &packed->list, queuelist) {
+		do_rel_wr = mmc_req_rel_wr(prq) && (md->flags & MMC_BLK_REL_WR);
+		do_data_tag = card->ext_csd.data_tag_unit_size &&
+			      (prq->cmd_flags & REQ_META) &&
+			      blk_rq_bytes(prq) >=
+			      card->ext_csd.data_tag_unit_size;
+		/* Argument of CMD23 */
+		packed_cmd_hdr[i * 2] = cpu_to_le32(
+			(do_rel_wr ? MMC_CMD23_ARG_REL_WR : 0) |
+			(do_data_tag ? MMC_CMD23_ARG_TAG_REQ : 0) |
+			blk_rq_sectors(prq));
+		/* Argument of CMD25 */
+		packed_cmd_hdr[i * 2 + 1] = cpu_to_le32(
+			mmc_card_blockaddr(card) ?
+			blk_rq_pos(prq) : blk_rq_pos(prq) << 9);
+		i++;
+	}
+
+	memset(brq, 0, sizeof(struct mmc_blk_request));
+	brq->mrq.cmd = &brq->cmd;
+	brq->mrq.data = &brq->data;
+	brq->mrq.sbc = &brq->sbc;
+	brq->mrq.stop = &brq->stop;
+
+	brq->sbc.opcode = MMC_SET_BLOCK_COUNT;
+	brq->sbc.arg = MMC_CMD23_ARG_PACKED |
+		       (packed->blocks + packed->hdr_blocks);
+	brq->sbc.flags = MMC_RSP_R1 | MMC_CMD_AC;
+
+	brq->cmd.opcode = MMC_WRITE_MULTIPLE_BLOCK;
+	brq->cmd.arg = blk_rq_pos(req);
+	if (!mmc_card_blockaddr(card))
+		brq->cmd.arg <<= 9;
+	brq->cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_ADTC;
+
+	brq->data.blksz = 512;
+	brq->data.blocks = packed->blocks + packed->hdr_blocks;
+	brq->data.flags = MMC_DATA_WRITE;
+
+	brq->stop.opcode = MMC_STOP_TRANSMISSION;
+	brq->stop.arg = 0;
+	brq->stop.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
+
+	mmc_set_data_timeout(&brq->data, card);
+
+	brq->data.sg = mqrq->sg;
+	brq->data.sg_len = mmc_queue_map_sg(mq, mqrq);
+
+	mqrq->areq.mrq = &brq->mrq;
+	mqrq->areq.err_check = mmc_blk_packed_err_check;
+}
+
+static void mmc_blk_rw_prep(struct mmc_queue_req *mqrq, struct mmc_card *card,
+			    struct mmc_queue *mq)
+{
+	if (mqrq->packed)
+		mmc_blk_packed_hdr_wrq_prep(mqrq, card, mq);
+	else
+		mmc_blk_rw_rq_prep(mqrq, card, 0, mq);
+}
+
+/*
+ * Complete the writes of a packed command up to the one that failed, if
+ * any.  The others are retried on their own, unless the card is gone.
+ */
+static void mmc_blk_end_packed_req(struct mmc_queue *mq,
+				   struct mmc_queue_req *mqrq,
+				   enum mmc_blk_status status)
+{
+	struct mmc_packed *packed = mqrq->packed;
+	struct request *prq, *tmp;
+	int idx = 0, nr_done;
+	bool abort;
+
+	switch (status) {
+	case MMC_BLK_SUCCESS:
+		nr_done = packed->nr_entries;
+		break;
+	case MMC_BLK_PARTIAL:
+		nr_done = packed->idx_failure;
+		if (nr_done < 0 || nr_done >= packed->nr_entries)
+			nr_done = 0;
+		break;
+	default:
+		nr_done = 0;
+		break;
+	}
+	abort = status == MMC_BLK_NOMEDIUM || mmc_card_removed(mq->card);
+
+	if (nr_done == packed->nr_entries)
+		mmc_blk_reset_success(mq->blkdata, MMC_BLK_WRITE);
+	else
+		mq->packed_stats.failed_groups++;
+
+	mqrq->packed = NULL;
+	list_for_each_entry_safe(prq, tmp, &packed->list, queuelist) {
+		list_del_init(&prq->queuelist);
+		if (idx++ < nr_done) {
+			mmc_blk_mq_end_request(prq, BLK_STS_OK);
+		} else if (abort) {
+			prq->rq_flags |= RQF_QUIET;
+			mmc_blk_mq_end_request(prq, BLK_STS_IOERR);
+		} else {
+			req_to_mmc_queue_req(prq)->retries++;
+			blk_mq_requeue_request(prq, true);
+		}
+	}
+	kfree(packed);
+}
+
 static bool mmc_blk_rw_cmd_err(struct mmc_blk_data *md, struct mmc_card *card,
 			       struct mmc_blk_request *brq, struct request *req,
 			       bool old_req_pending)
@@ -2239,9 +2870,9 @@ static bool mmc_blk_rw_cmd_err(struct mmc_blk_data *md, struct mmc_card *card,
 		if (err)
 			req_pending = old_req_pending;
 		else
-			req_pending = blk_end_request(req, BLK_STS_OK, blocks << 9);
+			req_pending = mmc_blk_end_request(req, BLK_STS_OK, blocks << 9);
 	} else {
-		req_pending = blk_end_request(req, BLK_STS_OK, brq->data.bytes_xfered);
+		req_pending = mmc_blk_end_request(req, BLK_STS_OK, brq->data.bytes_xfered);
 	}
 	return req_pending;
 }
@@ -2252,7 +2883,7 @@ static void mmc_blk_rw_cmd_abort(struct mmc_queue *mq, struct mmc_card *card,
 {
 	if (mmc_card_removed(card))
 		req->rq_flags |= RQF_QUIET;
-	while (blk_end_request(req, BLK_STS_IOERR, blk_rq_cur_bytes(req)));
+	while (mmc_blk_end_request(req, BLK_STS_IOERR, blk_rq_cur_bytes(req)));
 	mq->qcnt--;
 }
 
@@ -2271,13 +2902,17 @@ static void mmc_blk_rw_try_restart(struct mmc_queue *mq, struct request *req,
 	 * If the card was removed, just cancel everything and return.
 	 */
 	if (mmc_card_removed(mq->card)) {
-		req->rq_flags |= RQF_QUIET;
-		blk_end_request_all(req, BLK_STS_IOERR);
+		if (mqrq->packed) {
+			mmc_blk_end_packed_req(mq, mqrq, MMC_BLK_NOMEDIUM);
+		} else {
+			req->rq_flags |= RQF_QUIET;
+			mmc_blk_mq_end_request(req, BLK_STS_IOERR);
+		}
 		mq->qcnt--; /* FIXME: just set to 0? */
 		return;
 	}
 	/* Else proceed and try to restart the current async request */
-	mmc_blk_rw_rq_prep(mqrq, mq->card, 0, mq);
+	mmc_blk_rw_prep(mqrq, mq->card, mq);
 	mmc_start_areq(mq->card->host, &mqrq->areq, NULL);
 }
 
@@ -2320,7 +2955,7 @@ static void mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *new_req)
 				return;
 			}
 
-			mmc_blk_rw_rq_prep(mqrq_cur, card, 0, mq);
+			mmc_blk_rw_prep(mqrq_cur, card, mq);
 			new_areq = &mqrq_cur->areq;
 		} else
 			new_areq = NULL;
@@ -2344,6 +2979,18 @@ static void mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *new_req)
 		old_req = mmc_queue_req_to_req(mq_rq);
 		type = rq_data_dir(old_req) == READ ? MMC_BLK_READ : MMC_BLK_WRITE;
 
+		/*
+		 * A packed command is not retried as such: what did not make
+		 * it goes back to the queue to be retried write by write.
+		 */
+		if (mq_rq->packed) {
+			mmc_blk_end_packed_req(mq, mq_rq, status);
+			mq->qcnt--;
+			if (status != MMC_BLK_SUCCESS)
+				mmc_blk_rw_try_restart(mq, new_req, mqrq_cur);
+			return;
+		}
+
 		switch (status) {
 		case MMC_BLK_SUCCESS:
 		case MMC_BLK_PARTIAL:
@@ -2354,7 +3001,7 @@ static void mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *new_req)
 
 			mmc_blk_simulate_delay(mq, new_req, waitfor);
 
-			req_pending = blk_end_request(old_req, BLK_STS_OK,
+			req_pending = mmc_blk_end_request(old_req, BLK_STS_OK,
 						      brq->data.bytes_xfered);
 
 			/*
@@ -2423,7 +3070,7 @@ static void mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *new_req)
 			 * time, so we only reach here after trying to
 			 * read a single sector.
 			 */
-			req_pending = blk_end_request(old_req, BLK_STS_IOERR,
+			req_pending = mmc_blk_end_request(old_req, BLK_STS_IOERR,
 						      brq->data.blksz);
 			if (!req_pending) {
 				mq->qcnt--;
@@ -2459,6 +3106,155 @@ static void mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *new_req)
 	mq->qcnt--;
 }
 
+static bool mmc_blk_packable(struct mmc_queue *mq, struct request *req)
+{
+	struct mmc_blk_data *md = mq->blkdata;
+	struct mmc_card *card = mq->card;
+
+	if (!(md->flags & MMC_BLK_PACKED_CMD) || req_op(req) != REQ_OP_WRITE)
+		return false;
+
+	if (blk_rq_sectors(req) > READ_ONCE(md->packed_threshold))
+		return false;
+
+	/* Writes that failed in a packed command are retried on their own */
+	if (req_to_mmc_queue_req(req)->retries)
+		return false;
+
+	/* Legacy reliable writes have alignment constraints of their own */
+	if (mmc_req_rel_wr(req) && (md->flags & MMC_BLK_REL_WR) &&
+	    !(card->ext_csd.rel_param & EXT_CSD_WR_REL_PARAM_EN))
+		return false;
+
+	if (mmc_large_sector(card) && !IS_ALIGNED(blk_rq_sectors(req), 8))
+		return false;
+
+	/* A packed command is encrypted with a single key and data unit */
+	if (req->bio && bio_is_inline_encrypted(req->bio))
+		return false;
+
+	return true;
+}
+
+static bool mmc_blk_packed_fits(struct mmc_queue *mq,
+				struct mmc_packed *packed, struct request *req)
+{
+	struct mmc_host *host = mq->card->host;
+	unsigned int max_blocks;
+
+	/* The block count of CMD23 is 16 bits wide */
+	max_blocks = min3(host->max_blk_count, host->max_req_size >> 9, 0xffffU);
+
+	return packed->nr_entries <
+	       mmc_blk_packed_max_entries(mq->card, packed->hdr_blocks) &&
+	       packed->hdr_blocks + packed->blocks + blk_rq_sectors(req) <=
+	       max_blocks &&
+	       packed->nr_segs + req->nr_phys_segments <= host->max_segs;
+}
+
+static struct mmc_packed *mmc_blk_alloc_packed(struct mmc_queue *mq)
+{
+	unsigned int hdr_blocks = mmc_large_sector(mq->card) ? 8 : 1;
+	struct mmc_packed *packed;
+
+	packed = kzalloc(sizeof(*packed) + (hdr_blocks << 9), GFP_NOIO);
+	if (!packed)
+		return NULL;
+
+	INIT_LIST_HEAD(&packed->list);
+	packed->hdr_blocks = hdr_blocks;
+	packed->nr_segs = DIV_ROUND_UP(hdr_blocks << 9,
+				       queue_max_segment_size(mq->queue));
+
+	return packed;
+}
+
+static void __mmc_blk_issue_packed(struct mmc_queue *mq)
+{
+	struct mmc_packed *packed = mq->packing;
+	struct mmc_packed_stats *stats = &mq->packed_stats;
+	struct request *req;
+
+	if (!packed)
+		return;
+
+	mq->packing = NULL;
+	req = list_first_entry(&packed->list, struct request, queuelist);
+
+	if (packed->nr_entries == 1) {
+		list_del_init(&req->queuelist);
+		kfree(packed);
+		stats->single_reqs++;
+	} else {
+		req_to_mmc_queue_req(req)->packed = packed;
+		stats->groups++;
+		stats->packed_reqs += packed->nr_entries;
+		stats->packed_blocks += packed->blocks;
+	}
+
+	mmc_blk_issue_rw_rq(mq, req);
+}
+
+/**
+ * mmc_blk_issue_packed() - send the writes held back for packing, if any
+ * @mq: the queue
+ */
+void mmc_blk_issue_packed(struct mmc_queue *mq)
+{
+	if (!mq->packing)
+		return;
+
+	__mmc_blk_issue_packed(mq);
+
+	if (!mq->qcnt)
+		mmc_put_card(mq->card, &mq->ctx);
+}
+
+/*
+ * Add a read or write to the group of writes being packed, closing the
+ * group first if the request cannot join it.  A group only starts while
+ * the card is busy with another request, so that packing never delays a
+ * write the card could take straight away.
+ *
+ * Returns true if the request was held back.
+ */
+static bool mmc_blk_pack_rw_rq(struct mmc_queue *mq, struct request *req)
+{
+	struct mmc_packed *packed = mq->packing;
+
+	if (!mmc_blk_packable(mq, req)) {
+		__mmc_blk_issue_packed(mq);
+		return false;
+	}
+
+	if (packed && !mmc_blk_packed_fits(mq, packed, req)) {
+		__mmc_blk_issue_packed(mq);
+		packed = NULL;
+	}
+
+	if (!packed) {
+		if (mq->qcnt)
+			packed = mmc_blk_alloc_packed(mq);
+		if (!packed || !mmc_blk_packed_fits(mq, packed, req)) {
+			kfree(packed);
+			mq->packed_stats.single_reqs++;
+			return false;
+		}
+		mq->packing = packed;
+	}
+
+	list_add_tail(&req->queuelist, &packed->list);
+	packed->nr_entries++;
+	packed->blocks += blk_rq_sectors(req);
+	packed->nr_segs += req->nr_phys_segments;
+
+	if (packed->nr_entries ==
+	    mmc_blk_packed_max_entries(mq->card, packed->hdr_blocks))
+		__mmc_blk_issue_packed(mq);
+
+	return true;
+}
+
 void mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 {
 	int ret;
@@ -2467,17 +3263,21 @@ void mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 
 	if (req && !mq->qcnt)
 		/* claim host only for the first request */
-		mmc_get_card(card);
+		mmc_get_card(card, &mq->ctx);
 
 	ret = mmc_blk_part_switch(card, md->part_type);
 	if (ret) {
 		if (req) {
-			blk_end_request_all(req, BLK_STS_IOERR);
+			mmc_blk_mq_end_request(req, BLK_STS_IOERR);
 		}
 		goto out;
 	}
 
 	if (req) {
+		/* Nothing but a read or write can go around held back writes */
+		if (req_op(req) != REQ_OP_READ && req_op(req) != REQ_OP_WRITE)
+			__mmc_blk_issue_packed(mq);
+
 		switch (req_op(req)) {
 		case REQ_OP_DRV_IN:
 		case REQ_OP_DRV_OUT:
@@ -2517,8 +3317,9 @@ void mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 			mmc_blk_issue_flush(mq, req);
 			break;
 		default:
-			/* Normal request, just issue it */
-			mmc_blk_issue_rw_rq(mq, req);
+			/* Normal request, just issue it, or pack it */
+			if (!mmc_blk_pack_rw_rq(mq, req))
+				mmc_blk_issue_rw_rq(mq, req);
 			card->host->context_info.is_waiting_last_req = false;
 			break;
 		}
@@ -2530,7 +3331,70 @@ void mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 
 out:
 	if (!mq->qcnt)
-		mmc_put_card(card);
+		mmc_put_card(card, &mq->ctx);
+}
+
+/*
+ * Issue a request to the Command Queue Engine.  The requests that the CQE
+ * cannot take, i.e. driver operations, discards and, without DCMD support,
+ * flushes, are issued synchronously once the CQE is idle.
+ */
+enum mmc_issued mmc_blk_cqe_issue_rq(struct mmc_queue *mq, struct request *req)
+{
+	struct mmc_blk_data *md = mq->blkdata;
+	struct mmc_card *card = md->queue.card;
+	struct mmc_host *host = card->host;
+	int ret;
+
+	ret = mmc_blk_part_switch(card, md->part_type);
+	if (ret)
+		return MMC_REQ_FAILED_TO_START;
+
+	switch (mmc_issue_type(mq, req)) {
+	case MMC_ISSUE_SYNC:
+		ret = host->cqe_ops->cqe_wait_for_idle(host);
+		if (ret)
+			return MMC_REQ_BUSY;
+		switch (req_op(req)) {
+		case REQ_OP_DRV_IN:
+		case REQ_OP_DRV_OUT:
+			mmc_blk_issue_drv_op(mq, req);
+			break;
+		case REQ_OP_DISCARD:
+			mmc_blk_issue_discard_rq(mq, req);
+			break;
+		case REQ_OP_SECURE_ERASE:
+			mmc_blk_issue_secdiscard_rq(mq, req);
+			break;
+		case REQ_OP_FLUSH:
+			mmc_blk_issue_flush(mq, req);
+			break;
+		default:
+			WARN_ON_ONCE(1);
+			return MMC_REQ_FAILED_TO_START;
+		}
+		return MMC_REQ_FINISHED;
+	case MMC_ISSUE_DCMD:
+	case MMC_ISSUE_ASYNC:
+		switch (req_op(req)) {
+		case REQ_OP_FLUSH:
+			ret = mmc_blk_cqe_issue_flush(mq, req);
+			break;
+		case REQ_OP_READ:
+		case REQ_OP_WRITE:
+			ret = mmc_blk_cqe_issue_rw_rq(mq, req);
+			break;
+		default:
+			WARN_ON_ONCE(1);
+			ret = -EINVAL;
+		}
+		if (!ret)
+			return MMC_REQ_STARTED;
+		return ret == -EBUSY ? MMC_REQ_BUSY : MMC_REQ_FAILED_TO_START;
+	default:
+		WARN_ON_ONCE(1);
+		return MMC_REQ_FAILED_TO_START;
+	}
 }
 
 static inline int mmc_blk_readonly(struct mmc_card *card)
@@ -2573,6 +3437,10 @@ static struct mmc_blk_data *mmc_blk_alloc_req(struct mmc_card *card,
 
 	md->area_type = area_type;
 
+	ret = mmc_blk_alloc_lat(md);
+	if (ret)
+		goto err_kfree;
+
 	/*
 	 * Set the read-only status based on the supported commands
 	 * and the write protect switch.
@@ -2645,11 +3513,20 @@ static struct mmc_blk_data *mmc_blk_alloc_req(struct mmc_card *card,
 		blk_queue_write_cache(md->queue.queue, true, true);
 	}
 
+	if (mmc_card_mmc(card) &&
+	    area_type == MMC_BLK_DATA_AREA_MAIN &&
+	    md->flags & MMC_BLK_CMD23 &&
+	    card->ext_csd.packed_event_en) {
+		md->flags |= MMC_BLK_PACKED_CMD;
+		md->packed_threshold = MMC_PACKED_THRESHOLD;
+	}
+
 	return md;
 
  err_putdisk:
 	put_disk(md->disk);
  err_kfree:
+	mmc_blk_free_lat(md);
 	kfree(md);
  out:
 	ida_simple_remove(&mmc_blk_ida, devidx);
@@ -2752,6 +3629,12 @@ static void mmc_blk_remove_req(struct mmc_blk_data *md)
 		mmc_cleanup_queue(&md->queue);
 		if (md->disk->flags & GENHD_FL_UP) {
 			device_remove_file(disk_to_dev(md->disk), &md->force_ro);
+			if (md->flags & MMC_BLK_PACKED_CMD) {
+				device_remove_file(disk_to_dev(md->disk),
+						   &dev_attr_packed_threshold);
+				device_remove_file(disk_to_dev(md->disk),
+						   &dev_attr_packed_stats);
+			}
 			if ((md->area_type & MMC_BLK_DATA_AREA_BOOT) &&
 					card->ext_csd.boot_ro_lockable)
 				device_remove_file(disk_to_dev(md->disk),
@@ -2764,6 +3647,10 @@ static void mmc_blk_remove_req(struct mmc_blk_data *md)
 			device_remove_file(disk_to_dev(md->disk),
 						&dev_attr_cache_size);
 #endif
+#ifdef CONFIG_MMC_BLOCK_LATENCY_HIST
+			device_remove_file(disk_to_dev(md->disk),
+						&dev_attr_io_latency);
+#endif
 
 			del_gendisk(md->disk);
 		}
@@ -2816,6 +3703,22 @@ static int mmc_add_disk(struct mmc_blk_data *md)
 	if (ret)
 		goto cache_size_fail;
 #endif
+#ifdef CONFIG_MMC_BLOCK_LATENCY_HIST
+	ret = device_create_file(disk_to_dev(md->disk), &dev_attr_io_latency);
+	if (ret)
+		goto io_latency_fail;
+#endif
+
+	if (md->flags & MMC_BLK_PACKED_CMD) {
+		ret = device_create_file(disk_to_dev(md->disk),
+				&dev_attr_packed_threshold);
+		if (ret)
+			goto packed_threshold_fail;
+		ret = device_create_file(disk_to_dev(md->disk),
+				&dev_attr_packed_stats);
+		if (ret)
+			goto packed_stats_fail;
+	}
 
 	if ((md->area_type & MMC_BLK_DATA_AREA_BOOT) &&
 	     card->ext_csd.boot_ro_lockable) {
@@ -2840,6 +3743,18 @@ static int mmc_add_disk(struct mmc_blk_data *md)
 	return ret;
 
 power_ro_lock_fail:
+	if (md->flags & MMC_BLK_PACKED_CMD)
+		device_remove_file(disk_to_dev(md->disk),
+				   &dev_attr_packed_stats);
+packed_stats_fail:
+	if (md->flags & MMC_BLK_PACKED_CMD)
+		device_remove_file(disk_to_dev(md->disk),
+				   &dev_attr_packed_threshold);
+packed_threshold_fail:
+#ifdef CONFIG_MMC_BLOCK_LATENCY_HIST
+	device_remove_file(disk_to_dev(md->disk), &dev_attr_io_latency);
+io_latency_fail:
+#endif
 #ifdef CONFIG_MMC_SIMULATE_MAX_SPEED
 	device_remove_file(disk_to_dev(md->disk), &dev_attr_cache_size);
 cache_size_fail:
@@ -2867,6 +3782,8 @@ static int mmc_dbg_card_status_get(void *data, u64 *val)
 
 	/* Ask the block layer about the card status */
 	req = blk_get_request(mq->queue, REQ_OP_DRV_IN, __GFP_RECLAIM);
+	if (IS_ERR(req))
+		return PTR_ERR(req);
 	req_to_mmc_queue_req(req)->drv_op = MMC_DRV_OP_GET_CARD_STATUS;
 	blk_execute_rq(mq->queue, NULL, req, 0);
 	ret = req_to_mmc_queue_req(req)->drv_op_result;
@@ -2874,6 +3791,7 @@ static int mmc_dbg_card_status_get(void *data, u64 *val)
 		*val = ret;
 		ret = 0;
 	}
+	blk_put_request(req);
 
 	return ret;
 }
@@ -2900,10 +3818,15 @@ static int mmc_ext_csd_open(struct inode *inode, struct file *filp)
 
 	/* Ask the block layer for the EXT CSD */
 	req = blk_get_request(mq->queue, REQ_OP_DRV_IN, __GFP_RECLAIM);
+	if (IS_ERR(req)) {
+		err = PTR_ERR(req);
+		goto out_free;
+	}
 	req_to_mmc_queue_req(req)->drv_op = MMC_DRV_OP_GET_EXT_CSD;
 	req_to_mmc_queue_req(req)->drv_op_data = &ext_csd;
 	blk_execute_rq(mq->queue, NULL, req, 0);
 	err = req_to_mmc_queue_req(req)->drv_op_result;
+	blk_put_request(req);
 	if (err) {
 		pr_err("FAILED %d\n", err);
 		goto out_free;
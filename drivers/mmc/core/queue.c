@@ -10,119 +10,353 @@
 #include <linux/slab.h>
 #include <linux/module.h>
 #include <linux/blkdev.h>
-#include <linux/freezer.h>
-#include <linux/kthread.h>
 #include <linux/scatterlist.h>
 #include <linux/dma-mapping.h>
 
 #include <linux/mmc/card.h>
 #include <linux/mmc/host.h>
-#include <linux/sched/rt.h>
-#include <uapi/linux/sched/types.h>
 
 #include "queue.h"
 #include "block.h"
 #include "core.h"
 #include "card.h"
 
-/*
- * Prepare a MMC request. This just filters out odd stuff.
- */
-static int mmc_prep_request(struct request_queue *q, struct request *req)
+#define MMC_QUEUE_DEPTH 64
+
+static inline bool mmc_cqe_dcmd_busy(struct mmc_queue *mq)
+{
+	/* Allow only 1 DCMD at a time */
+	return mq->in_flight[MMC_ISSUE_DCMD];
+}
+
+void mmc_cqe_check_busy(struct mmc_queue *mq)
+{
+	if ((mq->cqe_busy & MMC_CQE_DCMD_BUSY) && !mmc_cqe_dcmd_busy(mq))
+		mq->cqe_busy &= ~MMC_CQE_DCMD_BUSY;
+
+	mq->cqe_busy &= ~MMC_CQE_QUEUE_FULL;
+}
+
+static inline bool mmc_cqe_can_dcmd(struct mmc_host *host)
+{
+	return host->caps2 & MMC_CAP2_CQE_DCMD;
+}
+
+static enum mmc_issue_type mmc_cqe_issue_type(struct mmc_host *host,
+					      struct request *req)
+{
+	switch (req_op(req)) {
+	case REQ_OP_DRV_IN:
+	case REQ_OP_DRV_OUT:
+	case REQ_OP_DISCARD:
+	case REQ_OP_SECURE_ERASE:
+		return MMC_ISSUE_SYNC;
+	case REQ_OP_FLUSH:
+		return mmc_cqe_can_dcmd(host) ? MMC_ISSUE_DCMD : MMC_ISSUE_SYNC;
+	default:
+		return MMC_ISSUE_ASYNC;
+	}
+}
+
+enum mmc_issue_type mmc_issue_type(struct mmc_queue *mq, struct request *req)
+{
+	struct mmc_host *host = mq->card->host;
+
+	if (mq->use_cqe)
+		return mmc_cqe_issue_type(host, req);
+
+	if (req_op(req) == REQ_OP_READ || req_op(req) == REQ_OP_WRITE)
+		return MMC_ISSUE_ASYNC;
+
+	return MMC_ISSUE_SYNC;
+}
+
+static void __mmc_cqe_recovery_notifier(struct mmc_queue *mq)
 {
+	if (!mq->recovery_needed) {
+		mq->recovery_needed = true;
+		schedule_work(&mq->recovery_work);
+	}
+}
+
+void mmc_cqe_recovery_notifier(struct mmc_request *mrq)
+{
+	struct mmc_queue_req *mqrq = container_of(mrq, struct mmc_queue_req,
+						  brq.mrq);
+	struct request *req = mmc_queue_req_to_req(mqrq);
+	struct request_queue *q = req->q;
 	struct mmc_queue *mq = q->queuedata;
+	unsigned long flags;
 
-	if (mq && (mmc_card_removed(mq->card) || mmc_access_rpmb(mq)))
-		return BLKPREP_KILL;
+	spin_lock_irqsave(q->queue_lock, flags);
+	__mmc_cqe_recovery_notifier(mq);
+	spin_unlock_irqrestore(q->queue_lock, flags);
+}
 
-	req->rq_flags |= RQF_DONTPREP;
+static enum blk_eh_timer_return mmc_cqe_timed_out(struct request *req)
+{
+	struct mmc_queue_req *mqrq = req_to_mmc_queue_req(req);
+	struct mmc_request *mrq = &mqrq->brq.mrq;
+	struct mmc_queue *mq = req->q->queuedata;
+	struct mmc_host *host = mq->card->host;
+	enum mmc_issue_type issue_type = mmc_issue_type(mq, req);
+	bool recovery_needed = false;
+
+	switch (issue_type) {
+	case MMC_ISSUE_ASYNC:
+	case MMC_ISSUE_DCMD:
+		if (host->cqe_ops->cqe_timeout(host, mrq, &recovery_needed)) {
+			if (recovery_needed)
+				__mmc_cqe_recovery_notifier(mq);
+			return BLK_EH_RESET_TIMER;
+		}
+		/* The request completed before the CQE noticed a timeout */
+		return BLK_EH_HANDLED;
+	default:
+		/* Timeout is handled by mmc core */
+		return BLK_EH_RESET_TIMER;
+	}
+}
 
-	return BLKPREP_OK;
+static enum blk_eh_timer_return mmc_mq_timed_out(struct request *req,
+						 bool reserved)
+{
+	struct request_queue *q = req->q;
+	struct mmc_queue *mq = q->queuedata;
+	unsigned long flags;
+	enum blk_eh_timer_return ret;
+
+	spin_lock_irqsave(q->queue_lock, flags);
+
+	/* Without a CQE, timeouts are handled by mmc core */
+	if (mq->recovery_needed || !mq->use_cqe)
+		ret = BLK_EH_RESET_TIMER;
+	else
+		ret = mmc_cqe_timed_out(req);
+
+	spin_unlock_irqrestore(q->queue_lock, flags);
+
+	return ret;
 }
 
-static int mmc_queue_thread(void *d)
+static void mmc_mq_recovery_handler(struct work_struct *work)
 {
-	struct mmc_queue *mq = d;
+	struct mmc_queue *mq = container_of(work, struct mmc_queue,
+					    recovery_work);
 	struct request_queue *q = mq->queue;
-	struct mmc_context_info *cntx = &mq->card->host->context_info;
-	struct sched_param scheduler_params = {0};
 
-	scheduler_params.sched_priority = 1;
+	mmc_get_card(mq->card, &mq->ctx);
 
-	sched_setscheduler(current, SCHED_FIFO, &scheduler_params);
+	mq->in_recovery = true;
 
-	current->flags |= PF_MEMALLOC;
+	mmc_blk_cqe_recovery(mq);
 
-	down(&mq->thread_sem);
-	do {
-		struct request *req;
+	mq->in_recovery = false;
 
-		spin_lock_irq(q->queue_lock);
-		set_current_state(TASK_INTERRUPTIBLE);
-		req = blk_fetch_request(q);
-		mq->asleep = false;
-		cntx->is_waiting_last_req = false;
-		cntx->is_new_req = false;
-		if (!req) {
-			/*
-			 * Dispatch queue is empty so set flags for
-			 * mmc_request_fn() to wake us up.
-			 */
-			if (mq->qcnt)
-				cntx->is_waiting_last_req = true;
-			else
-				mq->asleep = true;
-		}
-		spin_unlock_irq(q->queue_lock);
+	spin_lock_irq(q->queue_lock);
+	mq->recovery_needed = false;
+	spin_unlock_irq(q->queue_lock);
 
-		if (req || mq->qcnt) {
-			set_current_state(TASK_RUNNING);
-			mmc_blk_issue_rq(mq, req);
-			cond_resched();
-		} else {
-			if (kthread_should_stop()) {
-				set_current_state(TASK_RUNNING);
-				break;
-			}
-			up(&mq->thread_sem);
-			schedule();
-			down(&mq->thread_sem);
-		}
-	} while (1);
-	up(&mq->thread_sem);
+	mmc_put_card(mq->card, &mq->ctx);
 
-	return 0;
+	blk_mq_run_hw_queues(q, true);
 }
 
 /*
- * Generic MMC request handler.  This is called for any queue on a
- * particular host.  When the host is not busy, we look for a request
- * on any queue on this host, and attempt to issue it.  This may
- * not be the queue we were asked to process.
+ * Finish the request left in the asynchronous pipeline after the last
+ * dispatch, unless a new request comes along to take its place, as
+ * mmcqd did when its queue ran empty.
  */
-static void mmc_request_fn(struct request_queue *q)
+static void mmc_mq_complete_work(struct work_struct *work)
 {
-	struct mmc_queue *mq = q->queuedata;
-	struct request *req;
-	struct mmc_context_info *cntx;
+	struct mmc_queue *mq = container_of(work, struct mmc_queue,
+					    complete_work);
+	struct request_queue *q = mq->queue;
+	struct mmc_context_info *cntx = &mq->card->host->context_info;
+
+	mutex_lock(&mq->issue_lock);
+
+	/*
+	 * Send the writes held back for packing first: a new request must
+	 * not cut their issue short, as it does a pipeline flush.
+	 */
+	mmc_blk_issue_packed(mq);
 
-	if (!mq) {
-		while ((req = blk_fetch_request(q)) != NULL) {
-			req->rq_flags |= RQF_QUIET;
-			__blk_end_request_all(req, BLK_STS_IOERR);
+	while (mq->qcnt) {
+		spin_lock_irq(q->queue_lock);
+		if (mq->issue_waiting) {
+			spin_unlock_irq(q->queue_lock);
+			break;
 		}
-		return;
+		cntx->is_waiting_last_req = true;
+		cntx->is_new_req = false;
+		spin_unlock_irq(q->queue_lock);
+
+		mmc_blk_issue_rq(mq, NULL);
 	}
+	spin_lock_irq(q->queue_lock);
+	cntx->is_waiting_last_req = false;
+	cntx->is_new_req = false;
+	spin_unlock_irq(q->queue_lock);
+	mutex_unlock(&mq->issue_lock);
+}
 
-	cntx = &mq->card->host->context_info;
+static blk_status_t mmc_mq_issue_async(struct mmc_queue *mq,
+				       const struct blk_mq_queue_data *bd)
+{
+	struct request *req = bd->rq;
+	struct request_queue *q = mq->queue;
+	struct mmc_context_info *cntx = &mq->card->host->context_info;
+	bool pending;
 
+	/* Wake up a pipeline flush, the new request will finish it instead */
+	spin_lock_irq(q->queue_lock);
+	mq->issue_waiting += 1;
 	if (cntx->is_waiting_last_req) {
 		cntx->is_new_req = true;
 		wake_up_interruptible(&cntx->wait);
 	}
+	spin_unlock_irq(q->queue_lock);
+
+	mutex_lock(&mq->issue_lock);
+
+	spin_lock_irq(q->queue_lock);
+	mq->issue_waiting -= 1;
+	cntx->is_waiting_last_req = false;
+	cntx->is_new_req = false;
+	spin_unlock_irq(q->queue_lock);
+
+	if (!(req->rq_flags & RQF_DONTPREP)) {
+		req_to_mmc_queue_req(req)->retries = 0;
+		req->rq_flags |= RQF_DONTPREP;
+	}
+
+	blk_mq_start_request(req);
+	mmc_blk_issue_rq(mq, req);
+
+	pending = bd->last && mq->qcnt;
+
+	mutex_unlock(&mq->issue_lock);
+
+	if (pending)
+		kblockd_schedule_work(&mq->complete_work);
 
-	if (mq->asleep)
-		wake_up_process(mq->thread);
+	return BLK_STS_OK;
+}
+
+static blk_status_t mmc_mq_issue_cqe(struct mmc_queue *mq,
+				     struct request *req)
+{
+	struct request_queue *q = mq->queue;
+	struct mmc_card *card = mq->card;
+	struct mmc_host *host = card->host;
+	enum mmc_issue_type issue_type;
+	enum mmc_issued issued;
+	bool get_card, cqe_retune_ok;
+	blk_status_t ret;
+
+	issue_type = mmc_issue_type(mq, req);
+
+	spin_lock_irq(q->queue_lock);
+
+	/*
+	 * Nothing is issued during recovery, nor next to a synchronous
+	 * request, which is sent while the CQE is off.
+	 */
+	if (mq->recovery_needed || mq->in_flight[MMC_ISSUE_SYNC]) {
+		spin_unlock_irq(q->queue_lock);
+		return BLK_STS_RESOURCE;
+	}
+
+	switch (issue_type) {
+	case MMC_ISSUE_DCMD:
+		if (mmc_cqe_dcmd_busy(mq)) {
+			mq->cqe_busy |= MMC_CQE_DCMD_BUSY;
+			spin_unlock_irq(q->queue_lock);
+			return BLK_STS_RESOURCE;
+		}
+		break;
+	case MMC_ISSUE_ASYNC:
+		break;
+	default:
+		/*
+		 * Timeouts are handled by mmc core, and we don't have a host
+		 * API to abort requests, so we can't handle the timeout anyway.
+		 * However, when the timeout happens, blk_mq_complete_request()
+		 * no longer works (to stop the request disappearing under us).
+		 * To avoid racing with that, set a large timeout.
+		 */
+		req->timeout = 600 * HZ;
+		break;
+	}
+
+	mq->in_flight[issue_type] += 1;
+	get_card = (mmc_tot_in_flight(mq) == 1);
+	cqe_retune_ok = (mmc_cqe_qcnt(mq) == 1);
+
+	spin_unlock_irq(q->queue_lock);
+
+	if (!(req->rq_flags & RQF_DONTPREP)) {
+		req_to_mmc_queue_req(req)->retries = 0;
+		req->rq_flags |= RQF_DONTPREP;
+	}
+
+	if (get_card)
+		mmc_get_card(card, &mq->ctx);
+
+	host->retune_now = host->need_retune && cqe_retune_ok &&
+			   !host->hold_retune;
+
+	blk_mq_start_request(req);
+
+	issued = mmc_blk_cqe_issue_rq(mq, req);
+
+	switch (issued) {
+	case MMC_REQ_BUSY:
+		ret = BLK_STS_RESOURCE;
+		break;
+	case MMC_REQ_FAILED_TO_START:
+		ret = BLK_STS_IOERR;
+		break;
+	default:
+		ret = BLK_STS_OK;
+		break;
+	}
+
+	if (issued != MMC_REQ_STARTED) {
+		bool put_card = false;
+
+		spin_lock_irq(q->queue_lock);
+		mq->in_flight[issue_type] -= 1;
+		if (mmc_tot_in_flight(mq) == 0)
+			put_card = true;
+		spin_unlock_irq(q->queue_lock);
+		if (put_card)
+			mmc_put_card(card, &mq->ctx);
+	}
+
+	return ret;
+}
+
+static blk_status_t mmc_mq_queue_rq(struct blk_mq_hw_ctx *hctx,
+				    const struct blk_mq_queue_data *bd)
+{
+	struct request *req = bd->rq;
+	struct mmc_queue *mq = req->q->queuedata;
+
+	if (mmc_card_removed(mq->card) || mmc_access_rpmb(mq)) {
+		req->rq_flags |= RQF_QUIET;
+		return BLK_STS_IOERR;
+	}
+
+#ifdef CONFIG_MMC_BLOCK_LATENCY_HIST
+	req_to_mmc_queue_req(req)->issue_time = ktime_get();
+#endif
+
+	if (mq->use_cqe)
+		return mmc_mq_issue_cqe(mq, req);
+
+	return mmc_mq_issue_async(mq, bd);
 }
 
 static struct scatterlist *mmc_alloc_sg(int sg_len, gfp_t gfp)
@@ -157,15 +391,14 @@ static void mmc_queue_setup_discard(struct request_queue *q,
 
 /**
  * mmc_init_request() - initialize the MMC-specific per-request data
- * @q: the request queue
+ * @mq: the mmc queue
  * @req: the request
  * @gfp: memory allocation policy
  */
-static int mmc_init_request(struct request_queue *q, struct request *req,
+static int mmc_init_request(struct mmc_queue *mq, struct request *req,
 			    gfp_t gfp)
 {
 	struct mmc_queue_req *mq_rq = req_to_mmc_queue_req(req);
-	struct mmc_queue *mq = q->queuedata;
 	struct mmc_card *card = mq->card;
 	struct mmc_host *host = card->host;
 
@@ -176,7 +409,7 @@ static int mmc_init_request(struct request_queue *q, struct request *req,
 	return 0;
 }
 
-static void mmc_exit_request(struct request_queue *q, struct request *req)
+static void mmc_exit_request(struct request *req)
 {
 	struct mmc_queue_req *mq_rq = req_to_mmc_queue_req(req);
 
@@ -184,43 +417,34 @@ static void mmc_exit_request(struct request_queue *q, struct request *req)
 	mq_rq->sg = NULL;
 }
 
-/**
- * mmc_init_queue - initialise a queue structure.
- * @mq: mmc queue
- * @card: mmc card to attach this queue
- * @lock: queue lock
- * @subname: partition subname
- *
- * Initialise a MMC card request queue.
- */
-int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card,
-		   spinlock_t *lock, const char *subname)
+static int mmc_mq_init_request(struct blk_mq_tag_set *set, struct request *req,
+			       unsigned int hctx_idx, unsigned int numa_node)
+{
+	return mmc_init_request(set->driver_data, req, GFP_KERNEL);
+}
+
+static void mmc_mq_exit_request(struct blk_mq_tag_set *set, struct request *req,
+				unsigned int hctx_idx)
+{
+	mmc_exit_request(req);
+}
+
+static const struct blk_mq_ops mmc_mq_ops = {
+	.queue_rq	= mmc_mq_queue_rq,
+	.init_request	= mmc_mq_init_request,
+	.exit_request	= mmc_mq_exit_request,
+	.complete	= mmc_blk_cqe_complete_rq,
+	.timeout	= mmc_mq_timed_out,
+};
+
+static void mmc_setup_queue(struct mmc_queue *mq, struct mmc_card *card)
 {
 	struct mmc_host *host = card->host;
 	u64 limit = BLK_BOUNCE_HIGH;
-	int ret = -ENOMEM;
 
 	if (mmc_dev(host)->dma_mask && *mmc_dev(host)->dma_mask)
 		limit = (u64)dma_max_pfn(mmc_dev(host)) << PAGE_SHIFT;
 
-	mq->card = card;
-	mq->queue = blk_alloc_queue(GFP_KERNEL);
-	if (!mq->queue)
-		return -ENOMEM;
-	mq->queue->queue_lock = lock;
-	mq->queue->request_fn = mmc_request_fn;
-	mq->queue->init_rq_fn = mmc_init_request;
-	mq->queue->exit_rq_fn = mmc_exit_request;
-	mq->queue->cmd_size = sizeof(struct mmc_queue_req);
-	mq->queue->queuedata = mq;
-	mq->qcnt = 0;
-	ret = blk_init_allocated_queue(mq->queue);
-	if (ret) {
-		blk_cleanup_queue(mq->queue);
-		return ret;
-	}
-
-	blk_queue_prep_rq(mq->queue, mmc_prep_request);
 	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, mq->queue);
 	queue_flag_clear_unlocked(QUEUE_FLAG_ADD_RANDOM, mq->queue);
 	if (mmc_can_erase(card))
@@ -231,40 +455,97 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card,
 		min(host->max_blk_count, host->max_req_size / 512));
 	blk_queue_max_segments(mq->queue, host->max_segs);
 	blk_queue_max_segment_size(mq->queue, host->max_seg_size);
+#ifdef CONFIG_FS_ENCRYPTION_INLINE_CRYPT
+	mq->queue->ksm = host->ksm;
+#endif
 
-	sema_init(&mq->thread_sem, 1);
+	mutex_init(&mq->issue_lock);
+	INIT_WORK(&mq->complete_work, mmc_mq_complete_work);
+	INIT_WORK(&mq->recovery_work, mmc_mq_recovery_handler);
+}
 
-	mq->thread = kthread_run(mmc_queue_thread, mq, "mmcqd/%d%s",
-		host->index, subname ? subname : "");
+/**
+ * mmc_init_queue - initialise a queue structure.
+ * @mq: mmc queue
+ * @card: mmc card to attach this queue
+ * @lock: queue lock
+ * @subname: partition subname
+ *
+ * Initialise a MMC card request queue.  With a Command Queue Engine, one
+ * tag is allocated per hardware task slot, so that the block layer can
+ * keep that many requests in flight.
+ */
+int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card,
+		   spinlock_t *lock, const char *subname)
+{
+	struct mmc_host *host = card->host;
+	int ret;
+
+	mq->card = card;
+	mq->use_cqe = host->cqe_enabled;
+
+	memset(&mq->tag_set, 0, sizeof(mq->tag_set));
+	mq->tag_set.ops = &mmc_mq_ops;
+	/*
+	 * The queue depth for CQE must match the hardware because the request
+	 * tag is used to index the hardware queue.
+	 */
+	if (mq->use_cqe)
+		mq->tag_set.queue_depth =
+			min_t(int, card->ext_csd.cmdq_depth, host->cqe_qdepth);
+	else
+		mq->tag_set.queue_depth = MMC_QUEUE_DEPTH;
+	mq->tag_set.numa_node = NUMA_NO_NODE;
+	mq->tag_set.flags = BLK_MQ_F_SHOULD_MERGE | BLK_MQ_F_BLOCKING;
+	mq->tag_set.nr_hw_queues = 1;
+	mq->tag_set.cmd_size = sizeof(struct mmc_queue_req);
+	mq->tag_set.driver_data = mq;
+
+	ret = blk_mq_alloc_tag_set(&mq->tag_set);
+	if (ret)
+		return ret;
 
-	if (IS_ERR(mq->thread)) {
-		ret = PTR_ERR(mq->thread);
-		goto cleanup_queue;
+	mq->queue = blk_mq_init_queue(&mq->tag_set);
+	if (IS_ERR(mq->queue)) {
+		ret = PTR_ERR(mq->queue);
+		goto free_tag_set;
 	}
 
+	mq->queue->queue_lock = lock;
+	mq->queue->queuedata = mq;
+	mq->qcnt = 0;
+
+	mmc_setup_queue(mq, card);
+
 	return 0;
 
-cleanup_queue:
-	blk_cleanup_queue(mq->queue);
+free_tag_set:
+	blk_mq_free_tag_set(&mq->tag_set);
 	return ret;
 }
 
 void mmc_cleanup_queue(struct mmc_queue *mq)
 {
 	struct request_queue *q = mq->queue;
-	unsigned long flags;
 
-	/* Make sure the queue isn't suspended, as that will deadlock */
-	mmc_queue_resume(mq);
+	/*
+	 * The legacy code handled the possibility of being suspended,
+	 * so do that here too.
+	 */
+	if (blk_queue_quiesced(q))
+		blk_mq_unquiesce_queue(q);
+	mq->suspended = false;
 
-	/* Then terminate our worker thread */
-	kthread_stop(mq->thread);
+	blk_cleanup_queue(q);
 
-	/* Empty the queue */
-	spin_lock_irqsave(q->queue_lock, flags);
-	q->queuedata = NULL;
-	blk_start_queue(q);
-	spin_unlock_irqrestore(q->queue_lock, flags);
+	/*
+	 * The last request in the pipeline may have been finished by a new
+	 * one, leaving a complete_work with nothing to do. Such a work item
+	 * might still be queued at this point. Flush it.
+	 */
+	flush_work(&mq->complete_work);
+
+	blk_mq_free_tag_set(&mq->tag_set);
 
 	mq->card = NULL;
 }
@@ -274,23 +555,30 @@ EXPORT_SYMBOL(mmc_cleanup_queue);
  * mmc_queue_suspend - suspend a MMC request queue
  * @mq: MMC queue to suspend
  *
- * Stop the block request queue, and wait for our thread to
- * complete any outstanding requests.  This ensures that we
- * won't suspend while a request is being processed.
+ * Stop the block request queue, and wait for any outstanding requests
+ * to complete.  This ensures that we won't suspend while a request is
+ * being processed.
  */
 void mmc_queue_suspend(struct mmc_queue *mq)
 {
-	struct request_queue *q = mq->queue;
-	unsigned long flags;
-
 	if (!mq->suspended) {
-		mq->suspended |= true;
+		mq->suspended = true;
+
+		blk_mq_quiesce_queue(mq->queue);
 
-		spin_lock_irqsave(q->queue_lock, flags);
-		blk_stop_queue(q);
-		spin_unlock_irqrestore(q->queue_lock, flags);
+		/* Finish the request left in the pipeline, if any */
+		if (!mq->use_cqe) {
+			kblockd_schedule_work(&mq->complete_work);
+			flush_work(&mq->complete_work);
+		}
 
-		down(&mq->thread_sem);
+		/*
+		 * The host remains claimed while there are outstanding
+		 * requests, so simply claiming and releasing here ensures
+		 * there are none.
+		 */
+		mmc_claim_host(mq->card->host);
+		mmc_release_host(mq->card->host);
 	}
 }
 
@@ -300,18 +588,38 @@ void mmc_queue_suspend(struct mmc_queue *mq)
  */
 void mmc_queue_resume(struct mmc_queue *mq)
 {
-	struct request_queue *q = mq->queue;
-	unsigned long flags;
-
 	if (mq->suspended) {
 		mq->suspended = false;
 
-		up(&mq->thread_sem);
+		blk_mq_unquiesce_queue(mq->queue);
+	}
+}
 
-		spin_lock_irqsave(q->queue_lock, flags);
-		blk_start_queue(q);
-		spin_unlock_irqrestore(q->queue_lock, flags);
+/*
+ * Map the header of a packed command, then the data of each of its writes,
+ * into one sg list.
+ */
+static unsigned int mmc_queue_packed_map_sg(struct mmc_queue *mq,
+					    struct mmc_packed *packed,
+					    struct scatterlist *sg)
+{
+	unsigned int max_seg_sz = queue_max_segment_size(mq->queue);
+	unsigned int hdr_sz = packed->hdr_blocks << 9;
+	unsigned int sg_len = 0, offset, len;
+	struct request *req;
+
+	for (offset = 0; offset < hdr_sz; offset += len) {
+		len = min(hdr_sz - offset, max_seg_sz);
+		sg_unmark_end(&sg[sg_len]);
+		sg_set_buf(&sg[sg_len++], (u8 *)packed->cmd_hdr + offset, len);
+	}
+
+	list_for_each_entry(req, &packed->list, queuelist) {
+		sg_unmark_end(&sg[sg_len - 1]);
+		sg_len += blk_rq_map_sg(mq->queue, req, &sg[sg_len]);
 	}
+
+	return sg_len;
 }
 
 /*
@@ -321,5 +629,8 @@ unsigned int mmc_queue_map_sg(struct mmc_queue *mq, struct mmc_queue_req *mqrq)
 {
 	struct request *req = mmc_queue_req_to_req(mqrq);
 
+	if (mqrq->packed)
+		return mmc_queue_packed_map_sg(mq, mqrq->packed, mqrq->sg);
+
 	return blk_rq_map_sg(mq->queue, req, mqrq->sg);
 }
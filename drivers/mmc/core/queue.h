@@ -20,7 +20,6 @@ static inline struct request *mmc_queue_req_to_req(struct mmc_queue_req *mqr)
 	return blk_mq_rq_from_pdu(mqr);
 }
 
-struct task_struct;
 struct mmc_blk_data;
 struct mmc_blk_ioc_data;
 
@@ -47,6 +46,51 @@ enum mmc_drv_op {
 	MMC_DRV_OP_GET_EXT_CSD,
 };
 
+/**
+ * enum mmc_issued - result of handing a request to mmc_blk_mq_issue_rq()
+ * @MMC_REQ_STARTED: the request is in flight and completes asynchronously
+ * @MMC_REQ_BUSY: the request could not be issued yet, retry it later
+ * @MMC_REQ_FAILED_TO_START: the request could not be issued at all
+ * @MMC_REQ_FINISHED: the request was issued and completed synchronously
+ */
+enum mmc_issued {
+	MMC_REQ_STARTED,
+	MMC_REQ_BUSY,
+	MMC_REQ_FAILED_TO_START,
+	MMC_REQ_FINISHED,
+};
+
+enum mmc_issue_type {
+	MMC_ISSUE_SYNC,
+	MMC_ISSUE_DCMD,
+	MMC_ISSUE_ASYNC,
+	MMC_ISSUE_MAX,
+};
+
+/*
+ * A packed write starts with a header of one sector, holding the CMD23 and
+ * CMD25 arguments of each of the writes that follow.
+ */
+#define MMC_PACKED_NR_IDX	-1
+
+struct mmc_packed {
+	struct list_head	list;
+	unsigned int		blocks;
+	unsigned int		nr_segs;
+	unsigned int		hdr_blocks;
+	u8			nr_entries;
+	s16			idx_failure;
+	__le32			cmd_hdr[];
+};
+
+struct mmc_packed_stats {
+	unsigned long		groups;		/* packed commands issued */
+	unsigned long		packed_reqs;	/* writes sent packed */
+	unsigned long		packed_blocks;	/* sectors sent packed */
+	unsigned long		single_reqs;	/* packable writes sent alone */
+	unsigned long		failed_groups;	/* packed commands that failed */
+};
+
 struct mmc_queue_req {
 	struct mmc_blk_request	brq;
 	struct scatterlist	*sg;
@@ -55,16 +99,44 @@ struct mmc_queue_req {
 	int			drv_op_result;
 	void			*drv_op_data;
 	unsigned int		ioc_count;
+	int			retries;
+	struct mmc_packed	*packed;	/* set in the first write only */
+#ifdef CONFIG_MMC_BLOCK_LATENCY_HIST
+	ktime_t			issue_time;
+#endif
 };
 
 struct mmc_queue {
 	struct mmc_card		*card;
-	struct task_struct	*thread;
-	struct semaphore	thread_sem;
+	struct mmc_ctx		ctx;
+	struct blk_mq_tag_set	tag_set;
 	bool			suspended;
-	bool			asleep;
+	bool			use_cqe;
+	bool			recovery_needed;
+	bool			in_recovery;
+	int			cqe_busy;
+#define MMC_CQE_DCMD_BUSY	BIT(0)
+#define MMC_CQE_QUEUE_FULL	BIT(1)
+	int			in_flight[MMC_ISSUE_MAX];
 	struct mmc_blk_data	*blkdata;
 	struct request_queue	*queue;
+	/*
+	 * Without a CQE the requests go through the asynchronous request
+	 * pipeline of the core, one at a time: issue_lock serializes the
+	 * callers of mmc_blk_issue_rq() and complete_work finishes the last
+	 * request in the pipeline once no new request comes along.
+	 */
+	struct mutex		issue_lock;
+	int			issue_waiting;
+	struct work_struct	complete_work;
+	struct work_struct	recovery_work;
+	/*
+	 * While the card is busy, small writes are held back in a group
+	 * that is sent as one packed command once it is full, or once a
+	 * request that cannot join it, or the end of the dispatch, comes.
+	 */
+	struct mmc_packed	*packing;
+	struct mmc_packed_stats	packed_stats;
 	/*
 	 * FIXME: this counter is not a very reliable way of keeping
 	 * track of how many requests that are ongoing. Switch to just
@@ -92,4 +164,22 @@ extern unsigned int mmc_queue_map_sg(struct mmc_queue *,
 
 extern int mmc_access_rpmb(struct mmc_queue *);
 
+void mmc_cqe_check_busy(struct mmc_queue *mq);
+void mmc_cqe_recovery_notifier(struct mmc_request *mrq);
+
+enum mmc_issue_type mmc_issue_type(struct mmc_queue *mq, struct request *req);
+
+static inline int mmc_tot_in_flight(struct mmc_queue *mq)
+{
+	return mq->in_flight[MMC_ISSUE_SYNC] +
+	       mq->in_flight[MMC_ISSUE_DCMD] +
+	       mq->in_flight[MMC_ISSUE_ASYNC];
+}
+
+static inline int mmc_cqe_qcnt(struct mmc_queue *mq)
+{
+	return mq->in_flight[MMC_ISSUE_DCMD] +
+	       mq->in_flight[MMC_ISSUE_ASYNC];
+}
+
 #endif
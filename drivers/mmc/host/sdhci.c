@@ -539,6 +539,36 @@ static void sdhci_adma_write_desc(struct sdhci_host *host, void *desc,
 		dma_desc->addr_hi = cpu_to_le32((u64)addr >> 32);
 }
 
+/* Size of one bounce buffer and descriptor table pair */
+static size_t sdhci_adma_set_sz(struct sdhci_host *host)
+{
+	return host->align_buffer_sz +
+	       ALIGN(host->adma_table_sz, SDHCI_ADMA2_DESC_ALIGN);
+}
+
+static void sdhci_free_adma(struct sdhci_host *host)
+{
+	void *buf = host->align_buffer;
+	dma_addr_t dma = host->align_addr;
+
+	if (!buf)
+		return;
+
+	/* The two sets may have been swapped, free from the first one */
+	if (host->align_buffer_next < buf) {
+		buf = host->align_buffer_next;
+		dma = host->align_addr_next;
+	}
+	dma_free_coherent(mmc_dev(host->mmc), 2 * sdhci_adma_set_sz(host),
+			  buf, dma);
+
+	host->adma_table = NULL;
+	host->align_buffer = NULL;
+	host->adma_table_next = NULL;
+	host->align_buffer_next = NULL;
+	host->adma_next_data = NULL;
+}
+
 static void sdhci_adma_mark_end(void *desc)
 {
 	struct sdhci_adma2_64_desc *dma_desc = desc;
@@ -547,13 +577,18 @@ static void sdhci_adma_mark_end(void *desc)
 	dma_desc->cmd |= cpu_to_le16(ADMA2_END);
 }
 
+/*
+ * Build the descriptor table for @data in @table, with @align as the bounce
+ * buffer for unaligned data.
+ */
 static void sdhci_adma_table_pre(struct sdhci_host *host,
-	struct mmc_data *data, int sg_count)
+	struct mmc_data *data, int sg_count, void *table, void *align,
+	dma_addr_t align_addr)
 {
 	struct scatterlist *sg;
 	unsigned long flags;
-	dma_addr_t addr, align_addr;
-	void *desc, *align;
+	dma_addr_t addr;
+	void *desc;
 	char *buffer;
 	int len, offset, i;
 
@@ -562,14 +597,9 @@ static void sdhci_adma_table_pre(struct sdhci_host *host,
 	 * We currently guess that it is LE.
 	 */
 
-	host->sg_count = sg_count;
-
-	desc = host->adma_table;
-	align = host->align_buffer;
+	desc = table;
 
-	align_addr = host->align_addr;
-
-	for_each_sg(data->sg, sg, host->sg_count, i) {
+	for_each_sg(data->sg, sg, sg_count, i) {
 		addr = sg_dma_address(sg);
 		len = sg_dma_len(sg);
 
@@ -616,12 +646,12 @@ static void sdhci_adma_table_pre(struct sdhci_host *host,
 		 * If this triggers then we have a calculation bug
 		 * somewhere. :/
 		 */
-		WARN_ON((desc - host->adma_table) >= host->adma_table_sz);
+		WARN_ON((desc - table) >= host->adma_table_sz);
 	}
 
 	if (host->quirks & SDHCI_QUIRK_NO_ENDATTR_IN_NOPDESC) {
 		/* Mark the last descriptor as the terminating descriptor */
-		if (desc != host->adma_table) {
+		if (desc != table) {
 			desc -= host->desc_sz;
 			sdhci_adma_mark_end(desc);
 		}
@@ -848,7 +878,21 @@ static void sdhci_prepare_data(struct sdhci_host *host, struct mmc_command *cmd)
 			WARN_ON(1);
 			host->flags &= ~SDHCI_REQ_USE_DMA;
 		} else if (host->flags & SDHCI_USE_ADMA) {
-			sdhci_adma_table_pre(host, data, sg_cnt);
+			host->sg_count = sg_cnt;
+
+			if (host->adma_next_data == data) {
+				/* Built by sdhci_pre_req(), switch to it */
+				swap(host->adma_table, host->adma_table_next);
+				swap(host->adma_addr, host->adma_addr_next);
+				swap(host->align_buffer, host->align_buffer_next);
+				swap(host->align_addr, host->align_addr_next);
+				host->adma_next_data = NULL;
+			} else {
+				sdhci_adma_table_pre(host, data, sg_cnt,
+						     host->adma_table,
+						     host->align_buffer,
+						     host->align_addr);
+			}
 
 			sdhci_writel(host, host->adma_addr, SDHCI_ADMA_ADDRESS);
 			if (host->flags & SDHCI_USE_64_BIT_DMA)
@@ -2234,6 +2278,9 @@ static void sdhci_post_req(struct mmc_host *mmc, struct mmc_request *mrq,
 	struct sdhci_host *host = mmc_priv(mmc);
 	struct mmc_data *data = mrq->data;
 
+	if (host->adma_next_data == data)
+		host->adma_next_data = NULL;
+
 	if (data->host_cookie != COOKIE_UNMAPPED)
 		dma_unmap_sg(mmc_dev(host->mmc), data->sg, data->sg_len,
 			     mmc_get_dma_dir(data));
@@ -2244,11 +2291,29 @@ static void sdhci_post_req(struct mmc_host *mmc, struct mmc_request *mrq,
 static void sdhci_pre_req(struct mmc_host *mmc, struct mmc_request *mrq)
 {
 	struct sdhci_host *host = mmc_priv(mmc);
+	struct mmc_data *data = mrq->data;
+	int sg_count;
 
-	mrq->data->host_cookie = COOKIE_UNMAPPED;
+	data->host_cookie = COOKIE_UNMAPPED;
 
-	if (host->flags & SDHCI_REQ_USE_DMA)
-		sdhci_pre_dma_transfer(host, mrq->data, COOKIE_PRE_MAPPED);
+	if (!(host->flags & SDHCI_REQ_USE_DMA))
+		return;
+
+	sg_count = sdhci_pre_dma_transfer(host, data, COOKIE_PRE_MAPPED);
+
+	/*
+	 * The current request, if any, uses the other descriptor table, so
+	 * the descriptors of this one can be built while it transfers,
+	 * rather than between the two.
+	 */
+	if (sg_count > 0 && (host->flags & SDHCI_USE_ADMA)) {
+		host->adma_next_data = NULL;
+		sdhci_adma_table_pre(host, data, sg_count,
+				     host->adma_table_next,
+				     host->align_buffer_next,
+				     host->align_addr_next);
+		host->adma_next_data = data;
+	}
 }
 
 static inline bool sdhci_has_requests(struct sdhci_host *host)
@@ -3311,6 +3376,7 @@ int sdhci_setup_host(struct sdhci_host *host)
 
 	if (host->flags & SDHCI_USE_ADMA) {
 		dma_addr_t dma;
+		size_t set_sz;
 		void *buf;
 
 		/*
@@ -3330,8 +3396,15 @@ int sdhci_setup_host(struct sdhci_host *host)
 		}
 
 		host->align_buffer_sz = SDHCI_MAX_SEGS * SDHCI_ADMA2_ALIGN;
-		buf = dma_alloc_coherent(mmc_dev(mmc), host->align_buffer_sz +
-					 host->adma_table_sz, &dma, GFP_KERNEL);
+
+		/*
+		 * Two sets of bounce buffer and descriptor table, so that the
+		 * descriptors of the next request can be built in one while
+		 * the controller runs the current request from the other.
+		 */
+		set_sz = sdhci_adma_set_sz(host);
+		buf = dma_alloc_coherent(mmc_dev(mmc), 2 * set_sz, &dma,
+					 GFP_KERNEL);
 		if (!buf) {
 			pr_warn("%s: Unable to allocate ADMA buffers - falling back to standard DMA\n",
 				mmc_hostname(mmc));
@@ -3341,14 +3414,21 @@ int sdhci_setup_host(struct sdhci_host *host)
 			pr_warn("%s: unable to allocate aligned ADMA descriptor\n",
 				mmc_hostname(mmc));
 			host->flags &= ~SDHCI_USE_ADMA;
-			dma_free_coherent(mmc_dev(mmc), host->align_buffer_sz +
-					  host->adma_table_sz, buf, dma);
+			dma_free_coherent(mmc_dev(mmc), 2 * set_sz, buf, dma);
 		} else {
 			host->align_buffer = buf;
 			host->align_addr = dma;
 
 			host->adma_table = buf + host->align_buffer_sz;
 			host->adma_addr = dma + host->align_buffer_sz;
+
+			host->align_buffer_next = buf + set_sz;
+			host->align_addr_next = dma + set_sz;
+
+			host->adma_table_next = host->align_buffer_next +
+						host->align_buffer_sz;
+			host->adma_addr_next = host->align_addr_next +
+					       host->align_buffer_sz;
 		}
 	}
 
@@ -3711,12 +3791,7 @@ int sdhci_setup_host(struct sdhci_host *host)
 	if (!IS_ERR(mmc->supply.vqmmc))
 		regulator_disable(mmc->supply.vqmmc);
 undma:
-	if (host->align_buffer)
-		dma_free_coherent(mmc_dev(mmc), host->align_buffer_sz +
-				  host->adma_table_sz, host->align_buffer,
-				  host->align_addr);
-	host->adma_table = NULL;
-	host->align_buffer = NULL;
+	sdhci_free_adma(host);
 
 	return ret;
 }
@@ -3729,12 +3804,7 @@ void sdhci_cleanup_host(struct sdhci_host *host)
 	if (!IS_ERR(mmc->supply.vqmmc))
 		regulator_disable(mmc->supply.vqmmc);
 
-	if (host->align_buffer)
-		dma_free_coherent(mmc_dev(mmc), host->align_buffer_sz +
-				  host->adma_table_sz, host->align_buffer,
-				  host->align_addr);
-	host->adma_table = NULL;
-	host->align_buffer = NULL;
+	sdhci_free_adma(host);
 }
 EXPORT_SYMBOL_GPL(sdhci_cleanup_host);
 
@@ -3863,13 +3933,7 @@ void sdhci_remove_host(struct sdhci_host *host, int dead)
 	if (!IS_ERR(mmc->supply.vqmmc))
 		regulator_disable(mmc->supply.vqmmc);
 
-	if (host->align_buffer)
-		dma_free_coherent(mmc_dev(mmc), host->align_buffer_sz +
-				  host->adma_table_sz, host->align_buffer,
-				  host->align_addr);
-
-	host->adma_table = NULL;
-	host->align_buffer = NULL;
+	sdhci_free_adma(host);
 }
 
 EXPORT_SYMBOL_GPL(sdhci_remove_host);
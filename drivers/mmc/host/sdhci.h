@@ -505,6 +505,13 @@ struct sdhci_host {
 	dma_addr_t adma_addr;	/* Mapped ADMA descr. table */
 	dma_addr_t align_addr;	/* Mapped bounce buffer */
 
+	/* Second set, for the descriptors built ahead by sdhci_pre_req() */
+	void *adma_table_next;	/* ADMA descriptor table */
+	void *align_buffer_next;	/* Bounce buffer */
+	dma_addr_t adma_addr_next;	/* Mapped ADMA descr. table */
+	dma_addr_t align_addr_next;	/* Mapped bounce buffer */
+	struct mmc_data *adma_next_data;	/* Data described in that set */
+
 	unsigned int desc_sz;	/* ADMA descriptor size */
 
 	struct tasklet_struct finish_tasklet;	/* Tasklet structures */
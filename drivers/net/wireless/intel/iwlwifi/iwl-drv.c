@@ -1782,3 +1782,7 @@ MODULE_PARM_DESC(d0i3_timeout, "Timeout to D0i3 entry when idle (ms)");
 module_param_named(disable_11ac, iwlwifi_mod_params.disable_11ac, bool,
 		   S_IRUGO);
 MODULE_PARM_DESC(disable_11ac, "Disable VHT capabilities (default: false)");
+
+module_param_named(rss_cpus, iwlwifi_mod_params.rss_cpus, charp, S_IRUGO);
+MODULE_PARM_DESC(rss_cpus,
+		 "CPU list to spread the RSS queue interrupts over (default: the CPUs local to the device)");
@@ -122,6 +122,8 @@ enum iwl_uapsd_disable {
  * @lar_disable: disable LAR (regulatory), default = 0
  * @fw_monitor: allow to use firmware monitor
  * @disable_11ac: disable VHT capabilities, default = false.
+ * @rss_cpus: list of the CPUs the RSS queue interrupts are spread over,
+ *	default = NULL (the CPUs closest to the device)
  */
 struct iwl_mod_params {
 	int swcrypto;
@@ -143,6 +145,7 @@ struct iwl_mod_params {
 	bool lar_disable;
 	bool fw_monitor;
 	bool disable_11ac;
+	char *rss_cpus;
 };
 
 #endif /* #__iwl_modparams_h__ */
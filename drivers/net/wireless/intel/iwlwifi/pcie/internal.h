@@ -59,6 +59,7 @@
 #define RX_POST_REQ_ALLOC 2
 #define RX_CLAIM_REQ_ALLOC 8
 #define RX_PENDING_WATERMARK 16
+#define RX_PAGE_CACHE_SIZE 64
 
 struct iwl_host_cmd;
 
@@ -165,6 +166,29 @@ struct iwl_rb_allocator {
 	struct work_struct rx_alloc;
 };
 
+/**
+ * struct iwl_rx_page_cache - RB pages given to the stack, kept for reuse
+ * @pages: FIFO of the pages, the oldest at @head
+ * @head: index of the oldest page
+ * @count: number of pages in the FIFO
+ * @lock: protects the FIFO and the counters
+ * @hits: page allocations served from the cache
+ * @misses: page allocations that went to the page allocator
+ * @drops: pages released because the cache was full
+ *
+ * A page stays in the cache until the stack dropped all its references to
+ * it, then it is handed out again instead of allocating a new one.
+ */
+struct iwl_rx_page_cache {
+	struct page *pages[RX_PAGE_CACHE_SIZE];
+	unsigned int head;
+	unsigned int count;
+	spinlock_t lock;
+	u64 hits;
+	u64 misses;
+	u64 drops;
+};
+
 struct iwl_dma_ptr {
 	dma_addr_t dma;
 	void *addr;
@@ -383,12 +407,21 @@ struct iwl_self_init_dram {
  * @hw_init_mask: initial unmasked hw causes
  * @fh_mask: current unmasked fh causes
  * @hw_mask: current unmasked hw causes
+ * @low_latency: a latency sensitive flow is active, see
+ *	iwl_pcie_low_latency_tx()
+ * @low_latency_lock: protects entering and leaving the latency mode
+ * @low_latency_timer: leaves the latency mode once the flows went quiet
+ * @low_latency_start: when the latency mode was entered, in jiffies
+ * @low_latency_last: last latency sensitive frame, in jiffies
+ * @low_latency_stats: entries into the latency mode, frames that kept it
+ *	up and time spent in it
  */
 struct iwl_trans_pcie {
 	struct iwl_rxq *rxq;
 	struct iwl_rx_mem_buffer rx_pool[RX_POOL_SIZE];
 	struct iwl_rx_mem_buffer *global_table[RX_POOL_SIZE];
 	struct iwl_rb_allocator rba;
+	struct iwl_rx_page_cache rx_page_cache;
 	struct iwl_context_info *ctxt_info;
 	dma_addr_t ctxt_info_dma_addr;
 	struct iwl_self_init_dram init_dram;
@@ -418,6 +451,8 @@ struct iwl_trans_pcie {
 	struct iwl_txq *txq[IWL_MAX_TVQM_QUEUES];
 	unsigned long queue_used[BITS_TO_LONGS(IWL_MAX_TVQM_QUEUES)];
 	unsigned long queue_stopped[BITS_TO_LONGS(IWL_MAX_TVQM_QUEUES)];
+	/* queues whose write pointer update waits for the end of a burst */
+	unsigned long queue_wrptr_deferred[BITS_TO_LONGS(IWL_MAX_TVQM_QUEUES)];
 
 	/* PCI bus related data */
 	struct pci_dev *pci_dev;
@@ -463,6 +498,17 @@ struct iwl_trans_pcie {
 	u32 fh_mask;
 	u32 hw_mask;
 	cpumask_t affinity_mask[IWL_MAX_RX_HW_QUEUES];
+
+	bool low_latency;
+	spinlock_t low_latency_lock;
+	struct timer_list low_latency_timer;
+	unsigned long low_latency_start;
+	unsigned long low_latency_last;
+	struct {
+		u32 entries;
+		u64 frames;
+		unsigned long jiffies;
+	} low_latency_stats;
 };
 
 static inline struct iwl_trans_pcie *
@@ -725,6 +771,48 @@ static inline void iwl_stop_queue(struct iwl_trans *trans,
 				    txq->id);
 }
 
+/*
+ * The write pointer of a frame the stack has more frames queued behind
+ * (skb->xmit_more) is sent to the device along with the last frame of
+ * the burst, unless the queue is stopped and no more frames will come.
+ */
+static inline bool iwl_pcie_txq_defer_wr_ptr(struct iwl_trans *trans,
+					     struct iwl_txq *txq,
+					     struct sk_buff *skb)
+{
+	struct iwl_trans_pcie *trans_pcie = IWL_TRANS_GET_PCIE_TRANS(trans);
+
+	return skb->xmit_more &&
+	       !test_bit(txq->id, trans_pcie->queue_stopped);
+}
+
+/* Lowest 802.1d priority (video) of the latency sensitive frames */
+#define IWL_PCIE_LOW_LATENCY_PRIO	4
+
+/*
+ * iwl_pcie_low_latency_tx - account a frame for the latency mode
+ *
+ * A QoS data frame of priority video or voice, which the stack also
+ * derives from the socket priority, puts the transport into the latency
+ * mode: the device is kept out of d0i3 and the interrupts are coalesced
+ * over a much shorter time, for as long as such frames keep coming.
+ */
+static inline void iwl_pcie_low_latency_tx(struct iwl_trans *trans,
+					   struct sk_buff *skb)
+{
+	struct iwl_trans_pcie *trans_pcie = IWL_TRANS_GET_PCIE_TRANS(trans);
+	struct ieee80211_hdr *hdr = (void *)skb->data;
+
+	if (skb->priority < IWL_PCIE_LOW_LATENCY_PRIO || skb->priority > 7 ||
+	    !ieee80211_is_data_qos(hdr->frame_control))
+		return;
+
+	trans_pcie->low_latency_stats.frames++;
+	WRITE_ONCE(trans_pcie->low_latency_last, jiffies);
+	if (!READ_ONCE(trans_pcie->low_latency))
+		__iwl_pcie_low_latency_enter(trans);
+}
+
 static inline bool iwl_queue_used(const struct iwl_txq *q, int i)
 {
 	return q->write_ptr >= q->read_ptr ?
@@ -787,6 +875,9 @@ int iwl_pci_fw_exit_d0i3(struct iwl_trans *trans);
 int iwl_pci_fw_enter_d0i3(struct iwl_trans *trans);
 
 void iwl_pcie_enable_rx_wake(struct iwl_trans *trans, bool enable);
+void __iwl_pcie_low_latency_enter(struct iwl_trans *trans);
+void iwl_pcie_low_latency_timer(unsigned long data);
+void iwl_pcie_low_latency_stop(struct iwl_trans *trans);
 
 void iwl_pcie_rx_allocator_work(struct work_struct *data);
 
@@ -349,6 +349,74 @@ void iwl_pcie_rxq_restock(struct iwl_trans *trans, struct iwl_rxq *rxq)
 		iwl_pcie_rxsq_restock(trans, rxq);
 }
 
+/*
+ * iwl_pcie_rx_cache_get - take the oldest cached page, if the stack
+ * released it already.
+ */
+static struct page *iwl_pcie_rx_cache_get(struct iwl_trans_pcie *trans_pcie)
+{
+	struct iwl_rx_page_cache *cache = &trans_pcie->rx_page_cache;
+	struct page *page = NULL;
+
+	spin_lock_bh(&cache->lock);
+	if (cache->count && page_ref_count(cache->pages[cache->head]) == 1) {
+		page = cache->pages[cache->head];
+		cache->head = (cache->head + 1) % RX_PAGE_CACHE_SIZE;
+		cache->count--;
+		cache->hits++;
+	} else {
+		cache->misses++;
+	}
+	spin_unlock_bh(&cache->lock);
+
+	return page;
+}
+
+/*
+ * iwl_pcie_rx_cache_put - keep a page that was stolen by the stack, along
+ * with our reference to it.
+ */
+static void iwl_pcie_rx_cache_put(struct iwl_trans_pcie *trans_pcie,
+				  struct page *page)
+{
+	struct iwl_rx_page_cache *cache = &trans_pcie->rx_page_cache;
+	struct page *old = NULL;
+
+	/* Give emergency reserves back */
+	if (page_is_pfmemalloc(page)) {
+		__free_pages(page, trans_pcie->rx_page_order);
+		return;
+	}
+
+	spin_lock_bh(&cache->lock);
+	if (cache->count == RX_PAGE_CACHE_SIZE) {
+		old = cache->pages[cache->head];
+		cache->head = (cache->head + 1) % RX_PAGE_CACHE_SIZE;
+		cache->count--;
+		cache->drops++;
+	}
+	cache->pages[(cache->head + cache->count) % RX_PAGE_CACHE_SIZE] = page;
+	cache->count++;
+	spin_unlock_bh(&cache->lock);
+
+	if (old)
+		__free_pages(old, trans_pcie->rx_page_order);
+}
+
+static void iwl_pcie_rx_cache_free(struct iwl_trans_pcie *trans_pcie)
+{
+	struct iwl_rx_page_cache *cache = &trans_pcie->rx_page_cache;
+
+	spin_lock_bh(&cache->lock);
+	while (cache->count) {
+		__free_pages(cache->pages[cache->head],
+			     trans_pcie->rx_page_order);
+		cache->head = (cache->head + 1) % RX_PAGE_CACHE_SIZE;
+		cache->count--;
+	}
+	spin_unlock_bh(&cache->lock);
+}
+
 /*
  * iwl_pcie_rx_alloc_page - allocates and returns a page.
  *
@@ -360,6 +428,10 @@ static struct page *iwl_pcie_rx_alloc_page(struct iwl_trans *trans,
 	struct page *page;
 	gfp_t gfp_mask = priority;
 
+	page = iwl_pcie_rx_cache_get(trans_pcie);
+	if (page)
+		return page;
+
 	if (trans_pcie->rx_page_order > 0)
 		gfp_mask |= __GFP_COMP;
 
@@ -625,6 +697,7 @@ static int iwl_pcie_rx_alloc(struct iwl_trans *trans)
 		return -EINVAL;
 
 	spin_lock_init(&rba->lock);
+	spin_lock_init(&trans_pcie->rx_page_cache.lock);
 
 	for (i = 0; i < trans->num_rx_queues; i++) {
 		struct iwl_rxq *rxq = &trans_pcie->rxq[i];
@@ -690,6 +763,92 @@ static int iwl_pcie_rx_alloc(struct iwl_trans *trans)
 	return -ENOMEM;
 }
 
+/* Interrupt coalescing timer in the latency mode (128 usecs) */
+#define IWL_HOST_INT_TIMEOUT_LOW_LATENCY	(0x4)
+
+/* Time the latency mode is kept after the last latency sensitive frame */
+#define IWL_PCIE_LOW_LATENCY_HOLD		(HZ / 5)
+
+static void iwl_pcie_set_int_coalescing(struct iwl_trans *trans)
+{
+	struct iwl_trans_pcie *trans_pcie = IWL_TRANS_GET_PCIE_TRANS(trans);
+
+	/* Default (2048 usecs) unless in the latency mode */
+	iwl_write8(trans, CSR_INT_COALESCING,
+		   trans_pcie->low_latency ? IWL_HOST_INT_TIMEOUT_LOW_LATENCY :
+					     IWL_HOST_INT_TIMEOUT_DEF);
+
+	/* W/A for interrupt coalescing bug in 7260 and 3160 */
+	if (trans->cfg->host_interrupt_operation_mode)
+		iwl_set_bit(trans, CSR_INT_COALESCING, IWL_HOST_INT_OPER_MODE);
+}
+
+void __iwl_pcie_low_latency_enter(struct iwl_trans *trans)
+{
+	struct iwl_trans_pcie *trans_pcie = IWL_TRANS_GET_PCIE_TRANS(trans);
+
+	spin_lock_bh(&trans_pcie->low_latency_lock);
+	if (trans_pcie->low_latency || trans_pcie->is_down)
+		goto out;
+
+	IWL_DEBUG_POWER(trans, "entering latency mode\n");
+	trans_pcie->low_latency = true;
+	trans_pcie->low_latency_start = jiffies;
+	trans_pcie->low_latency_stats.entries++;
+	iwl_trans_ref(trans);
+	iwl_pcie_set_int_coalescing(trans);
+	mod_timer(&trans_pcie->low_latency_timer,
+		  jiffies + IWL_PCIE_LOW_LATENCY_HOLD);
+out:
+	spin_unlock_bh(&trans_pcie->low_latency_lock);
+}
+
+/* Called with low_latency_lock held */
+static void iwl_pcie_low_latency_exit(struct iwl_trans *trans)
+{
+	struct iwl_trans_pcie *trans_pcie = IWL_TRANS_GET_PCIE_TRANS(trans);
+
+	if (!trans_pcie->low_latency)
+		return;
+
+	IWL_DEBUG_POWER(trans, "leaving latency mode\n");
+	trans_pcie->low_latency = false;
+	trans_pcie->low_latency_stats.jiffies +=
+		jiffies - trans_pcie->low_latency_start;
+	if (!trans_pcie->is_down)
+		iwl_pcie_set_int_coalescing(trans);
+	iwl_trans_unref(trans);
+}
+
+void iwl_pcie_low_latency_timer(unsigned long data)
+{
+	struct iwl_trans_pcie *trans_pcie = (void *)data;
+	unsigned long expires;
+
+	expires = READ_ONCE(trans_pcie->low_latency_last) +
+		  IWL_PCIE_LOW_LATENCY_HOLD;
+	if (time_before(jiffies, expires)) {
+		mod_timer(&trans_pcie->low_latency_timer, expires);
+		return;
+	}
+
+	spin_lock_bh(&trans_pcie->low_latency_lock);
+	iwl_pcie_low_latency_exit(trans_pcie->trans);
+	spin_unlock_bh(&trans_pcie->low_latency_lock);
+}
+
+/* Called when the device is going down, after is_down was set */
+void iwl_pcie_low_latency_stop(struct iwl_trans *trans)
+{
+	struct iwl_trans_pcie *trans_pcie = IWL_TRANS_GET_PCIE_TRANS(trans);
+
+	del_timer_sync(&trans_pcie->low_latency_timer);
+
+	spin_lock_bh(&trans_pcie->low_latency_lock);
+	iwl_pcie_low_latency_exit(trans);
+	spin_unlock_bh(&trans_pcie->low_latency_lock);
+}
+
 static void iwl_pcie_rx_hw_init(struct iwl_trans *trans, struct iwl_rxq *rxq)
 {
 	struct iwl_trans_pcie *trans_pcie = IWL_TRANS_GET_PCIE_TRANS(trans);
@@ -751,12 +910,7 @@ static void iwl_pcie_rx_hw_init(struct iwl_trans *trans, struct iwl_rxq *rxq)
 
 	iwl_trans_release_nic_access(trans, &flags);
 
-	/* Set interrupt coalescing timer to default (2048 usecs) */
-	iwl_write8(trans, CSR_INT_COALESCING, IWL_HOST_INT_TIMEOUT_DEF);
-
-	/* W/A for interrupt coalescing bug in 7260 and 3160 */
-	if (trans->cfg->host_interrupt_operation_mode)
-		iwl_set_bit(trans, CSR_INT_COALESCING, IWL_HOST_INT_OPER_MODE);
+	iwl_pcie_set_int_coalescing(trans);
 }
 
 void iwl_pcie_enable_rx_wake(struct iwl_trans *trans, bool enable)
@@ -865,8 +1019,7 @@ static void iwl_pcie_rx_mq_hw_init(struct iwl_trans *trans)
 
 	iwl_trans_release_nic_access(trans, &flags);
 
-	/* Set interrupt coalescing timer to default (2048 usecs) */
-	iwl_write8(trans, CSR_INT_COALESCING, IWL_HOST_INT_TIMEOUT_DEF);
+	iwl_pcie_set_int_coalescing(trans);
 
 	iwl_pcie_enable_rx_wake(trans, true);
 }
@@ -881,10 +1034,33 @@ static void iwl_pcie_rx_init_rxb_lists(struct iwl_rxq *rxq)
 	rxq->used_count = 0;
 }
 
-static int iwl_pcie_dummy_napi_poll(struct napi_struct *napi, int budget)
+static int iwl_pcie_rx_handle(struct iwl_trans *trans, int queue);
+
+/*
+ * The RX queues are processed from the interrupt handlers, and the NAPI
+ * context is only used for GRO and, through its ID, by sockets that busy
+ * poll (SO_BUSY_POLL).  A busy polling socket gets here to pick up the
+ * completed RBs without waiting for the interrupt.  The queue is always
+ * drained whatever the budget, so the poll always completes.
+ */
+static int iwl_pcie_napi_poll(struct napi_struct *napi, int budget)
 {
-	WARN_ON(1);
-	return 0;
+	struct iwl_rxq *rxq = container_of(napi, struct iwl_rxq, napi);
+	struct iwl_trans_pcie *trans_pcie =
+		container_of(napi->dev, struct iwl_trans_pcie, napi_dev);
+	struct iwl_trans *trans = trans_pcie->trans;
+	int done = 0;
+
+	if (test_bit(STATUS_DEVICE_ENABLED, &trans->status)) {
+		lock_map_acquire(&trans->sync_cmd_lockdep_map);
+		done = iwl_pcie_rx_handle(trans, rxq->id);
+		lock_map_release(&trans->sync_cmd_lockdep_map);
+	}
+
+	done = min(done, budget - 1);
+	napi_complete_done(napi, done);
+
+	return done;
 }
 
 static int _iwl_pcie_rx_init(struct iwl_trans *trans)
@@ -932,9 +1108,11 @@ static int _iwl_pcie_rx_init(struct iwl_trans *trans)
 
 		iwl_pcie_rx_init_rxb_lists(rxq);
 
-		if (!rxq->napi.poll)
+		if (!rxq->napi.poll) {
 			netif_napi_add(&trans_pcie->napi_dev, &rxq->napi,
-				       iwl_pcie_dummy_napi_poll, 64);
+				       iwl_pcie_napi_poll, 64);
+			napi_enable(&rxq->napi);
+		}
 
 		spin_unlock(&rxq->lock);
 	}
@@ -1015,6 +1193,7 @@ void iwl_pcie_rx_free(struct iwl_trans *trans)
 	cancel_work_sync(&rba->rx_alloc);
 
 	iwl_pcie_free_rbs_pool(trans);
+	iwl_pcie_rx_cache_free(trans_pcie);
 
 	for (i = 0; i < trans->num_rx_queues; i++) {
 		struct iwl_rxq *rxq = &trans_pcie->rxq[i];
@@ -1041,8 +1220,10 @@ void iwl_pcie_rx_free(struct iwl_trans *trans)
 		rxq->used_bd_dma = 0;
 		rxq->used_bd = NULL;
 
-		if (rxq->napi.poll)
+		if (rxq->napi.poll) {
+			napi_disable(&rxq->napi);
 			netif_napi_del(&rxq->napi);
+		}
 	}
 	kfree(trans_pcie->rxq);
 }
@@ -1202,9 +1383,9 @@ static void iwl_pcie_rx_handle_rb(struct iwl_trans *trans,
 		offset += ALIGN(len, FH_RSCSR_FRAME_ALIGN);
 	}
 
-	/* page was stolen from us -- free our reference */
+	/* page was stolen from us -- keep our reference for reuse */
 	if (page_stolen) {
-		__free_pages(rxb->page, trans_pcie->rx_page_order);
+		iwl_pcie_rx_cache_put(trans_pcie, rxb->page);
 		rxb->page = NULL;
 	}
 
@@ -1236,12 +1417,13 @@ static void iwl_pcie_rx_handle_rb(struct iwl_trans *trans,
 /*
  * iwl_pcie_rx_handle - Main entry function for receiving responses from fw
  */
-static void iwl_pcie_rx_handle(struct iwl_trans *trans, int queue)
+static int iwl_pcie_rx_handle(struct iwl_trans *trans, int queue)
 {
 	struct iwl_trans_pcie *trans_pcie = IWL_TRANS_GET_PCIE_TRANS(trans);
 	struct iwl_rxq *rxq = &trans_pcie->rxq[queue];
 	u32 r, i, count = 0;
 	bool emergency = false;
+	int handled = 0;
 
 restart:
 	spin_lock(&rxq->lock);
@@ -1290,6 +1472,7 @@ static void iwl_pcie_rx_handle(struct iwl_trans *trans, int queue)
 
 		IWL_DEBUG_RX(trans, "Q %d: HW = %d, SW = %d\n", rxq->id, r, i);
 		iwl_pcie_rx_handle_rb(trans, rxq, rxb, emergency);
+		handled++;
 
 		i = (i + 1) & (rxq->queue_size - 1);
 
@@ -1328,6 +1511,10 @@ static void iwl_pcie_rx_handle(struct iwl_trans *trans, int queue)
 out:
 	/* Backtrack one entry */
 	rxq->read = i;
+
+	/* under the lock, as a busy polling socket may handle the queue too */
+	if (rxq->napi.poll)
+		napi_gro_flush(&rxq->napi, false);
 	spin_unlock(&rxq->lock);
 
 	/*
@@ -1345,10 +1532,9 @@ static void iwl_pcie_rx_handle(struct iwl_trans *trans, int queue)
 	if (unlikely(emergency && count))
 		iwl_pcie_rxq_alloc_rbs(trans, GFP_ATOMIC, rxq);
 
-	if (rxq->napi.poll)
-		napi_gro_flush(&rxq->napi, false);
-
 	iwl_pcie_rxq_restock(trans, rxq);
+
+	return handled;
 }
 
 static struct iwl_trans_pcie *iwl_pcie_get_trans_pcie(struct msix_entry *entry)
@@ -1137,6 +1137,7 @@ static void _iwl_trans_pcie_stop_device(struct iwl_trans *trans, bool low_power)
 		return;
 
 	trans_pcie->is_down = true;
+	iwl_pcie_low_latency_stop(trans);
 
 	/* tell the device to stop sending interrupts */
 	iwl_disable_interrupts(trans);
@@ -1551,20 +1552,44 @@ static void iwl_pcie_set_interrupt_capa(struct pci_dev *pdev,
 	}
 }
 
+/*
+ * Spread the RSS queues, one per CPU, over the CPUs given by the rss_cpus
+ * module parameter, or else over the CPUs closest to the device first.
+ */
 static void iwl_pcie_irq_set_affinity(struct iwl_trans *trans)
 {
 	int iter_rx_q, i, ret, cpu, offset;
 	struct iwl_trans_pcie *trans_pcie = IWL_TRANS_GET_PCIE_TRANS(trans);
+	cpumask_var_t rss_cpus;
+	bool user_cpus = false;
+
+	if (iwlwifi_mod_params.rss_cpus &&
+	    zalloc_cpumask_var(&rss_cpus, GFP_KERNEL)) {
+		if (!cpulist_parse(iwlwifi_mod_params.rss_cpus, rss_cpus))
+			cpumask_and(rss_cpus, rss_cpus, cpu_online_mask);
+		user_cpus = !cpumask_empty(rss_cpus);
+		if (!user_cpus) {
+			IWL_ERR(trans, "Invalid rss_cpus \"%s\", ignored\n",
+				iwlwifi_mod_params.rss_cpus);
+			free_cpumask_var(rss_cpus);
+		}
+	}
 
 	i = trans_pcie->shared_vec_mask & IWL_SHARED_IRQ_FIRST_RSS ? 0 : 1;
 	iter_rx_q = trans_pcie->trans->num_rx_queues - 1 + i;
 	offset = 1 + i;
+	cpu = -1;
 	for (; i < iter_rx_q ; i++) {
-		/*
-		 * Get the cpu prior to the place to search
-		 * (i.e. return will be > i - 1).
-		 */
-		cpu = cpumask_next(i - offset, cpu_online_mask);
+		if (user_cpus) {
+			/* Wrap around when there are more queues than CPUs */
+			cpu = cpumask_next(cpu, rss_cpus);
+			if (cpu >= nr_cpu_ids)
+				cpu = cpumask_first(rss_cpus);
+		} else {
+			cpu = cpumask_local_spread(i - offset + 1,
+						   dev_to_node(trans->dev));
+		}
+		cpumask_clear(&trans_pcie->affinity_mask[i]);
 		cpumask_set_cpu(cpu, &trans_pcie->affinity_mask[i]);
 		ret = irq_set_affinity_hint(trans_pcie->msix_entries[i].vector,
 					    &trans_pcie->affinity_mask[i]);
@@ -1573,6 +1598,9 @@ static void iwl_pcie_irq_set_affinity(struct iwl_trans *trans)
 				"Failed to set affinity mask for IRQ %d\n",
 				i);
 	}
+
+	if (user_cpus)
+		free_cpumask_var(rss_cpus);
 }
 
 static const char *queue_name(struct device *dev,
@@ -2417,6 +2445,61 @@ static ssize_t iwl_dbgfs_interrupt_read(struct file *file,
 	return ret;
 }
 
+static ssize_t iwl_dbgfs_rx_page_cache_read(struct file *file,
+					    char __user *user_buf,
+					    size_t count, loff_t *ppos)
+{
+	struct iwl_trans *trans = file->private_data;
+	struct iwl_trans_pcie *trans_pcie = IWL_TRANS_GET_PCIE_TRANS(trans);
+	struct iwl_rx_page_cache *cache = &trans_pcie->rx_page_cache;
+	u64 hits, misses, drops;
+	unsigned int cached;
+	char buf[160];
+	int pos;
+
+	spin_lock_bh(&cache->lock);
+	hits = cache->hits;
+	misses = cache->misses;
+	drops = cache->drops;
+	cached = cache->count;
+	spin_unlock_bh(&cache->lock);
+
+	pos = scnprintf(buf, sizeof(buf),
+			"cached:\t\t%u\nhits:\t\t%llu\nmisses:\t\t%llu\n"
+			"drops:\t\t%llu\nhit rate:\t%llu%%\n",
+			cached, hits, misses, drops,
+			hits + misses ? div64_u64(hits * 100, hits + misses) : 0);
+
+	return simple_read_from_buffer(user_buf, count, ppos, buf, pos);
+}
+
+static ssize_t iwl_dbgfs_low_latency_read(struct file *file,
+					  char __user *user_buf,
+					  size_t count, loff_t *ppos)
+{
+	struct iwl_trans *trans = file->private_data;
+	struct iwl_trans_pcie *trans_pcie = IWL_TRANS_GET_PCIE_TRANS(trans);
+	unsigned long time;
+	char buf[160];
+	bool active;
+	int pos;
+
+	spin_lock_bh(&trans_pcie->low_latency_lock);
+	active = trans_pcie->low_latency;
+	time = trans_pcie->low_latency_stats.jiffies;
+	if (active)
+		time += jiffies - trans_pcie->low_latency_start;
+	pos = scnprintf(buf, sizeof(buf),
+			"active:\t\t%d\nentries:\t%u\nframes:\t\t%llu\n"
+			"time (ms):\t%u\n",
+			active, trans_pcie->low_latency_stats.entries,
+			trans_pcie->low_latency_stats.frames,
+			jiffies_to_msecs(time));
+	spin_unlock_bh(&trans_pcie->low_latency_lock);
+
+	return simple_read_from_buffer(user_buf, count, ppos, buf, pos);
+}
+
 static ssize_t iwl_dbgfs_interrupt_write(struct file *file,
 					 const char __user *user_buf,
 					 size_t count, loff_t *ppos)
@@ -2506,6 +2589,8 @@ static ssize_t iwl_dbgfs_rfkill_write(struct file *file,
 DEBUGFS_READ_WRITE_FILE_OPS(interrupt);
 DEBUGFS_READ_FILE_OPS(fh_reg);
 DEBUGFS_READ_FILE_OPS(rx_queue);
+DEBUGFS_READ_FILE_OPS(rx_page_cache);
+DEBUGFS_READ_FILE_OPS(low_latency);
 DEBUGFS_READ_FILE_OPS(tx_queue);
 DEBUGFS_WRITE_FILE_OPS(csr);
 DEBUGFS_READ_WRITE_FILE_OPS(rfkill);
@@ -2516,6 +2601,8 @@ int iwl_trans_pcie_dbgfs_register(struct iwl_trans *trans)
 	struct dentry *dir = trans->dbgfs_dir;
 
 	DEBUGFS_ADD_FILE(rx_queue, dir, S_IRUSR);
+	DEBUGFS_ADD_FILE(rx_page_cache, dir, S_IRUSR);
+	DEBUGFS_ADD_FILE(low_latency, dir, S_IRUSR);
 	DEBUGFS_ADD_FILE(tx_queue, dir, S_IRUSR);
 	DEBUGFS_ADD_FILE(interrupt, dir, S_IWUSR | S_IRUSR);
 	DEBUGFS_ADD_FILE(csr, dir, S_IWUSR);
@@ -3012,6 +3099,9 @@ struct iwl_trans *iwl_trans_pcie_alloc(struct pci_dev *pdev,
 	trans_pcie->opmode_down = true;
 	spin_lock_init(&trans_pcie->irq_lock);
 	spin_lock_init(&trans_pcie->reg_lock);
+	spin_lock_init(&trans_pcie->low_latency_lock);
+	setup_timer(&trans_pcie->low_latency_timer, iwl_pcie_low_latency_timer,
+		    (unsigned long)trans_pcie);
 	mutex_init(&trans_pcie->mutex);
 	init_waitqueue_head(&trans_pcie->ucode_write_waitq);
 	trans_pcie->tso_hdr_page = alloc_percpu(struct iwl_tso_hdr_page);
@@ -72,6 +72,8 @@ void iwl_pcie_gen2_tx_stop(struct iwl_trans *trans)
 	 */
 	memset(trans_pcie->queue_stopped, 0, sizeof(trans_pcie->queue_stopped));
 	memset(trans_pcie->queue_used, 0, sizeof(trans_pcie->queue_used));
+	memset(trans_pcie->queue_wrptr_deferred, 0,
+	       sizeof(trans_pcie->queue_wrptr_deferred));
 
 	/* Unmap DMA from host system and free skb's */
 	for (txq_id = 0; txq_id < ARRAY_SIZE(trans_pcie->txq); txq_id++) {
@@ -131,6 +133,28 @@ static void iwl_pcie_gen2_txq_inc_wr_ptr(struct iwl_trans *trans,
 	iwl_write32(trans, HBUS_TARG_WRPTR, txq->write_ptr | (txq->id << 16));
 }
 
+/*
+ * iwl_pcie_gen2_txq_kick_deferred - Send the write index of the queues
+ * that were left behind in a burst of frames
+ */
+static void iwl_pcie_gen2_txq_kick_deferred(struct iwl_trans *trans)
+{
+	struct iwl_trans_pcie *trans_pcie = IWL_TRANS_GET_PCIE_TRANS(trans);
+	int i;
+
+	for_each_set_bit(i, trans_pcie->queue_wrptr_deferred,
+			 IWL_MAX_TVQM_QUEUES) {
+		struct iwl_txq *txq = trans_pcie->txq[i];
+
+		if (!test_and_clear_bit(i, trans_pcie->queue_wrptr_deferred))
+			continue;
+
+		spin_lock(&txq->lock);
+		iwl_pcie_gen2_txq_inc_wr_ptr(trans, txq);
+		spin_unlock(&txq->lock);
+	}
+}
+
 static u8 iwl_pcie_gen2_get_num_tbs(struct iwl_trans *trans,
 				    struct iwl_tfh_tfd *tfd)
 {
@@ -481,6 +505,7 @@ int iwl_trans_pcie_gen2_tx(struct iwl_trans *trans, struct sk_buff *skb,
 	struct iwl_tx_cmd_gen2 *tx_cmd = (void *)dev_cmd->payload;
 	struct iwl_cmd_meta *out_meta;
 	struct iwl_txq *txq = trans_pcie->txq[txq_id];
+	bool xmit_more = skb->xmit_more;
 	int idx;
 	void *tfd;
 
@@ -493,6 +518,8 @@ int iwl_trans_pcie_gen2_tx(struct iwl_trans *trans, struct sk_buff *skb,
 	    __skb_linearize(skb))
 		return -ENOMEM;
 
+	iwl_pcie_low_latency_tx(trans, skb);
+
 	spin_lock(&txq->lock);
 
 	idx = iwl_pcie_get_cmd_index(txq, txq->write_ptr);
@@ -512,6 +539,7 @@ int iwl_trans_pcie_gen2_tx(struct iwl_trans *trans, struct sk_buff *skb,
 	tfd = iwl_pcie_gen2_build_tfd(trans, txq, dev_cmd, skb, out_meta);
 	if (!tfd) {
 		spin_unlock(&txq->lock);
+		iwl_pcie_gen2_txq_kick_deferred(trans);
 		return -1;
 	}
 
@@ -529,15 +557,24 @@ int iwl_trans_pcie_gen2_tx(struct iwl_trans *trans, struct sk_buff *skb,
 
 	/* Tell device the write index *just past* this latest filled TFD */
 	txq->write_ptr = iwl_queue_inc_wrap(txq->write_ptr);
-	iwl_pcie_gen2_txq_inc_wr_ptr(trans, txq);
 	if (iwl_queue_space(txq) < txq->high_mark)
 		iwl_stop_queue(trans, txq);
+	if (iwl_pcie_txq_defer_wr_ptr(trans, txq, skb)) {
+		set_bit(txq_id, trans_pcie->queue_wrptr_deferred);
+	} else {
+		clear_bit(txq_id, trans_pcie->queue_wrptr_deferred);
+		iwl_pcie_gen2_txq_inc_wr_ptr(trans, txq);
+	}
 
 	/*
 	 * At this point the frame is "transmitted" successfully
 	 * and we will get a TX status notification eventually.
 	 */
 	spin_unlock(&txq->lock);
+
+	/* End of the burst, for the other queues too */
+	if (!xmit_more)
+		iwl_pcie_gen2_txq_kick_deferred(trans);
 	return 0;
 }
 
@@ -1024,6 +1061,7 @@ static void iwl_pcie_gen2_txq_free(struct iwl_trans *trans, int txq_id)
 	trans_pcie->txq[txq_id] = NULL;
 
 	clear_bit(txq_id, trans_pcie->queue_used);
+	clear_bit(txq_id, trans_pcie->queue_wrptr_deferred);
 }
 
 int iwl_trans_pcie_dyn_txq_alloc(struct iwl_trans *trans,
@@ -1127,6 +1165,7 @@ void iwl_trans_pcie_dyn_txq_free(struct iwl_trans *trans, int queue)
 	 * allow the op_mode to call txq_disable after it already called
 	 * stop_device.
 	 */
+	clear_bit(queue, trans_pcie->queue_wrptr_deferred);
 	if (!test_and_clear_bit(queue, trans_pcie->queue_used)) {
 		WARN_ONCE(test_bit(STATUS_DEVICE_ENABLED, &trans->status),
 			  "queue %d not used", queue);
@@ -1144,6 +1183,8 @@ void iwl_pcie_gen2_tx_free(struct iwl_trans *trans)
 	int i;
 
 	memset(trans_pcie->queue_used, 0, sizeof(trans_pcie->queue_used));
+	memset(trans_pcie->queue_wrptr_deferred, 0,
+	       sizeof(trans_pcie->queue_wrptr_deferred));
 
 	/* Free all TX queues */
 	for (i = 0; i < ARRAY_SIZE(trans_pcie->txq); i++) {
@@ -289,6 +289,28 @@ static void iwl_pcie_txq_inc_wr_ptr(struct iwl_trans *trans,
 			    txq->write_ptr | (txq_id << 8));
 }
 
+/*
+ * iwl_pcie_txq_kick_deferred - Send the write index of the queues that
+ * were left behind in a burst of frames
+ */
+static void iwl_pcie_txq_kick_deferred(struct iwl_trans *trans)
+{
+	struct iwl_trans_pcie *trans_pcie = IWL_TRANS_GET_PCIE_TRANS(trans);
+	int i;
+
+	for_each_set_bit(i, trans_pcie->queue_wrptr_deferred,
+			 trans->cfg->base_params->num_of_queues) {
+		struct iwl_txq *txq = trans_pcie->txq[i];
+
+		if (!test_and_clear_bit(i, trans_pcie->queue_wrptr_deferred))
+			continue;
+
+		spin_lock(&txq->lock);
+		iwl_pcie_txq_inc_wr_ptr(trans, txq);
+		spin_unlock(&txq->lock);
+	}
+}
+
 void iwl_pcie_txq_check_wrptrs(struct iwl_trans *trans)
 {
 	struct iwl_trans_pcie *trans_pcie = IWL_TRANS_GET_PCIE_TRANS(trans);
@@ -724,6 +746,8 @@ void iwl_pcie_tx_start(struct iwl_trans *trans, u32 scd_base_addr)
 	/* make sure all queue are not stopped/used */
 	memset(trans_pcie->queue_stopped, 0, sizeof(trans_pcie->queue_stopped));
 	memset(trans_pcie->queue_used, 0, sizeof(trans_pcie->queue_used));
+	memset(trans_pcie->queue_wrptr_deferred, 0,
+	       sizeof(trans_pcie->queue_wrptr_deferred));
 
 	trans_pcie->scd_base_addr =
 		iwl_read_prph(trans, SCD_SRAM_BASE_ADDR);
@@ -861,6 +885,8 @@ int iwl_pcie_tx_stop(struct iwl_trans *trans)
 	 */
 	memset(trans_pcie->queue_stopped, 0, sizeof(trans_pcie->queue_stopped));
 	memset(trans_pcie->queue_used, 0, sizeof(trans_pcie->queue_used));
+	memset(trans_pcie->queue_wrptr_deferred, 0,
+	       sizeof(trans_pcie->queue_wrptr_deferred));
 
 	/* This can happen: start_hw, stop_device */
 	if (!trans_pcie->txq_memory)
@@ -885,6 +911,8 @@ void iwl_pcie_tx_free(struct iwl_trans *trans)
 	struct iwl_trans_pcie *trans_pcie = IWL_TRANS_GET_PCIE_TRANS(trans);
 
 	memset(trans_pcie->queue_used, 0, sizeof(trans_pcie->queue_used));
+	memset(trans_pcie->queue_wrptr_deferred, 0,
+	       sizeof(trans_pcie->queue_wrptr_deferred));
 
 	/* Tx queues */
 	if (trans_pcie->txq_memory) {
@@ -1418,6 +1446,7 @@ void iwl_trans_pcie_txq_disable(struct iwl_trans *trans, int txq_id,
 	 * allow the op_mode to call txq_disable after it already called
 	 * stop_device.
 	 */
+	clear_bit(txq_id, trans_pcie->queue_wrptr_deferred);
 	if (!test_and_clear_bit(txq_id, trans_pcie->queue_used)) {
 		WARN_ONCE(test_bit(STATUS_DEVICE_ENABLED, &trans->status),
 			  "queue %d not used", txq_id);
@@ -2266,6 +2295,7 @@ int iwl_trans_pcie_tx(struct iwl_trans *trans, struct sk_buff *skb,
 	void *tfd;
 	u16 len, tb1_len;
 	bool wait_write_ptr;
+	bool xmit_more = skb->xmit_more;
 	__le16 fc;
 	u8 hdr_len;
 	u16 wifi_seq;
@@ -2304,6 +2334,8 @@ int iwl_trans_pcie_tx(struct iwl_trans *trans, struct sk_buff *skb,
 	fc = hdr->frame_control;
 	hdr_len = ieee80211_hdrlen(fc);
 
+	iwl_pcie_low_latency_tx(trans, skb);
+
 	spin_lock(&txq->lock);
 
 	if (iwl_queue_space(txq) < txq->high_mark) {
@@ -2320,6 +2352,7 @@ int iwl_trans_pcie_tx(struct iwl_trans *trans, struct sk_buff *skb,
 			__skb_queue_tail(&txq->overflow_q, skb);
 
 			spin_unlock(&txq->lock);
+			iwl_pcie_txq_kick_deferred(trans);
 			return 0;
 		}
 	}
@@ -2434,16 +2467,25 @@ int iwl_trans_pcie_tx(struct iwl_trans *trans, struct sk_buff *skb,
 
 	/* Tell device the write index *just past* this latest filled TFD */
 	txq->write_ptr = iwl_queue_inc_wrap(txq->write_ptr);
-	if (!wait_write_ptr)
+	if (iwl_pcie_txq_defer_wr_ptr(trans, txq, skb)) {
+		set_bit(txq_id, trans_pcie->queue_wrptr_deferred);
+	} else if (!wait_write_ptr) {
+		clear_bit(txq_id, trans_pcie->queue_wrptr_deferred);
 		iwl_pcie_txq_inc_wr_ptr(trans, txq);
+	}
 
 	/*
 	 * At this point the frame is "transmitted" successfully
 	 * and we will get a TX status notification eventually.
 	 */
 	spin_unlock(&txq->lock);
+
+	/* End of the burst, for the other queues too */
+	if (!xmit_more)
+		iwl_pcie_txq_kick_deferred(trans);
 	return 0;
 out_err:
 	spin_unlock(&txq->lock);
+	iwl_pcie_txq_kick_deferred(trans);
 	return -1;
 }
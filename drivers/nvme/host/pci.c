@@ -67,6 +67,11 @@ static int io_queue_depth = 1024;
 module_param_cb(io_queue_depth, &io_queue_depth_ops, &io_queue_depth, 0644);
 MODULE_PARM_DESC(io_queue_depth, "set io queue depth, should >= 2");
 
+static bool poll_queues;
+module_param(poll_queues, bool, 0444);
+MODULE_PARM_DESC(poll_queues,
+	"add an interrupt-less queue pair per hardware queue for polled I/O");
+
 struct nvme_dev;
 struct nvme_queue;
 
@@ -86,6 +91,10 @@ struct nvme_dev {
 	struct dma_pool *prp_small_pool;
 	unsigned online_queues;
 	unsigned max_qid;
+	/* polled queue pairs, indexed by hardware context, qid > max_qid */
+	struct nvme_queue **poll_queues;
+	unsigned max_poll_queues;
+	unsigned nr_poll_queues;
 	int q_depth;
 	u32 db_stride;
 	void __iomem *bar;
@@ -159,10 +168,15 @@ struct nvme_queue {
 	u16 q_depth;
 	s16 cq_vector;
 	u16 sq_tail;
+	u16 last_sq_tail;
 	u16 cq_head;
 	u16 qid;
 	u8 cq_phase;
 	u8 cqe_seen;
+	u8 polled;
+	/* completions reaped, and the sum of their latencies */
+	u64 nr_completed;
+	u64 lat_ns;
 	u32 *dbbuf_sq_db;
 	u32 *dbbuf_cq_db;
 	u32 *dbbuf_sq_ei;
@@ -179,6 +193,7 @@ struct nvme_iod {
 	struct nvme_request req;
 	struct nvme_queue *nvmeq;
 	int aborted;
+	u64 submit_ns;
 	int npages;		/* In the PRP list. 0 means small pool in use */
 	int nents;		/* Used in scatterlist */
 	int length;		/* Of data, in bytes */
@@ -366,14 +381,26 @@ static void nvme_admin_exit_hctx(struct blk_mq_hw_ctx *hctx, unsigned int hctx_i
 	nvmeq->tags = NULL;
 }
 
+static inline struct nvme_queue *nvme_hctx_poll_queue(struct nvme_dev *dev,
+		unsigned int hctx_idx)
+{
+	if (hctx_idx >= dev->nr_poll_queues)
+		return NULL;
+	return dev->poll_queues[hctx_idx];
+}
+
 static int nvme_init_hctx(struct blk_mq_hw_ctx *hctx, void *data,
 			  unsigned int hctx_idx)
 {
 	struct nvme_dev *dev = data;
 	struct nvme_queue *nvmeq = dev->queues[hctx_idx + 1];
+	struct nvme_queue *pollq = nvme_hctx_poll_queue(dev, hctx_idx);
 
 	if (!nvmeq->tags)
 		nvmeq->tags = &dev->tagset.tags[hctx_idx];
+	/* The polled queue shares the tag space of the hardware context */
+	if (pollq && !pollq->tags)
+		pollq->tags = &dev->tagset.tags[hctx_idx];
 
 	WARN_ON(dev->tagset.tags[hctx_idx] != hctx->tags);
 	hctx->driver_data = nvmeq;
@@ -400,15 +427,36 @@ static int nvme_pci_map_queues(struct blk_mq_tag_set *set)
 	return blk_mq_pci_map_queues(set, to_pci_dev(dev->dev));
 }
 
+/*
+ * Ring the SQ doorbell for all the commands copied in since it was last
+ * rung.  Must be called with the q_lock held.
+ */
+static inline void nvme_write_sq_db(struct nvme_queue *nvmeq)
+{
+	u16 tail = nvmeq->sq_tail;
+
+	if (tail == nvmeq->last_sq_tail)
+		return;
+
+	/* Drain the write-combining buffers of a CMB resident SQ first */
+	if (nvmeq->sq_cmds_io)
+		wmb();
+	if (nvme_dbbuf_update_and_check_event(tail, nvmeq->dbbuf_sq_db,
+					      nvmeq->dbbuf_sq_ei))
+		writel(tail, nvmeq->q_db);
+	nvmeq->last_sq_tail = tail;
+}
+
 /**
  * __nvme_submit_cmd() - Copy a command into a queue and ring the doorbell
  * @nvmeq: The queue to use
  * @cmd: The command to send
+ * @write_sq: Ring the doorbell now, rather than with a later command
  *
  * Safe to use from interrupt context
  */
 static void __nvme_submit_cmd(struct nvme_queue *nvmeq,
-						struct nvme_command *cmd)
+				struct nvme_command *cmd, bool write_sq)
 {
 	u16 tail = nvmeq->sq_tail;
 
@@ -419,10 +467,9 @@ static void __nvme_submit_cmd(struct nvme_queue *nvmeq,
 
 	if (++tail == nvmeq->q_depth)
 		tail = 0;
-	if (nvme_dbbuf_update_and_check_event(tail, nvmeq->dbbuf_sq_db,
-					      nvmeq->dbbuf_sq_ei))
-		writel(tail, nvmeq->q_db);
 	nvmeq->sq_tail = tail;
+	if (write_sq)
+		nvme_write_sq_db(nvmeq);
 }
 
 static __le64 **iod_list(struct request *req)
@@ -713,6 +760,32 @@ static void nvme_unmap_data(struct nvme_dev *dev, struct request *req)
 	nvme_free_iod(dev, req);
 }
 
+static void nvme_commit_sq(struct nvme_queue *nvmeq)
+{
+	spin_lock_irq(&nvmeq->q_lock);
+	nvme_write_sq_db(nvmeq);
+	spin_unlock_irq(&nvmeq->q_lock);
+}
+
+/*
+ * Ring the doorbells left pending by the requests queued so far, on both
+ * queues of the hardware context, except for @skip which is up to date.
+ */
+static void nvme_commit_rqs(struct blk_mq_hw_ctx *hctx,
+			    struct nvme_queue *skip)
+{
+	struct nvme_queue *nvmeq = hctx->driver_data;
+	struct nvme_queue *pollq = NULL;
+
+	if (nvmeq->qid)
+		pollq = nvme_hctx_poll_queue(nvmeq->dev, hctx->queue_num);
+
+	if (nvmeq != skip)
+		nvme_commit_sq(nvmeq);
+	if (pollq && pollq != skip)
+		nvme_commit_sq(pollq);
+}
+
 /*
  * NOTE: ns is NULL when called on the admin queue.
  */
@@ -723,16 +796,30 @@ static blk_status_t nvme_queue_rq(struct blk_mq_hw_ctx *hctx,
 	struct nvme_queue *nvmeq = hctx->driver_data;
 	struct nvme_dev *dev = nvmeq->dev;
 	struct request *req = bd->rq;
+	struct nvme_iod *iod = blk_mq_rq_to_pdu(req);
 	struct nvme_command cmnd;
 	blk_status_t ret;
 
+	/*
+	 * High priority I/O is reaped by its submitter through nvme_poll(),
+	 * so send it to the polled queue and keep it off the interrupt path.
+	 */
+	if ((req->cmd_flags & REQ_HIPRI) && nvmeq->qid) {
+		struct nvme_queue *pollq =
+			nvme_hctx_poll_queue(dev, hctx->queue_num);
+
+		if (pollq)
+			nvmeq = pollq;
+	}
+
 	ret = nvme_setup_cmd(ns, req, &cmnd);
 	if (ret)
-		return ret;
+		goto out_commit;
 
 	ret = nvme_init_iod(req, dev);
 	if (ret)
 		goto out_free_cmd;
+	iod->nvmeq = nvmeq;
 
 	if (blk_rq_nr_phys_segments(req)) {
 		ret = nvme_map_data(dev, req, &cmnd);
@@ -748,14 +835,25 @@ static blk_status_t nvme_queue_rq(struct blk_mq_hw_ctx *hctx,
 		spin_unlock_irq(&nvmeq->q_lock);
 		goto out_cleanup_iod;
 	}
-	__nvme_submit_cmd(nvmeq, &cmnd);
+	if (poll_queues)
+		iod->submit_ns = ktime_get_ns();
+	/*
+	 * blk-mq tells us whether more requests follow in this dispatch, so
+	 * ring the doorbell once for the whole batch.
+	 */
+	__nvme_submit_cmd(nvmeq, &cmnd, bd->last);
 	nvme_process_cq(nvmeq);
 	spin_unlock_irq(&nvmeq->q_lock);
+	if (bd->last)
+		nvme_commit_rqs(hctx, nvmeq);
 	return BLK_STS_OK;
 out_cleanup_iod:
 	nvme_free_iod(dev, req);
 out_free_cmd:
 	nvme_cleanup_cmd(req);
+out_commit:
+	/* Nothing follows a failed request, so ring for the batch here */
+	nvme_commit_rqs(hctx, NULL);
 	return ret;
 }
 
@@ -812,6 +910,12 @@ static inline void nvme_handle_cqe(struct nvme_queue *nvmeq,
 
 	nvmeq->cqe_seen = 1;
 	req = blk_mq_tag_to_rq(*nvmeq->tags, cqe->command_id);
+	if (poll_queues && nvmeq->qid) {
+		struct nvme_iod *iod = blk_mq_rq_to_pdu(req);
+
+		nvmeq->nr_completed++;
+		nvmeq->lat_ns += ktime_get_ns() - iod->submit_ns;
+	}
 	nvme_end_request(req, cqe->status, cqe->result);
 }
 
@@ -893,7 +997,11 @@ static int __nvme_poll(struct nvme_queue *nvmeq, unsigned int tag)
 static int nvme_poll(struct blk_mq_hw_ctx *hctx, unsigned int tag)
 {
 	struct nvme_queue *nvmeq = hctx->driver_data;
+	struct nvme_queue *pollq = nvme_hctx_poll_queue(nvmeq->dev,
+							hctx->queue_num);
 
+	if (pollq && __nvme_poll(pollq, tag))
+		return 1;
 	return __nvme_poll(nvmeq, tag);
 }
 
@@ -908,7 +1016,7 @@ static void nvme_pci_submit_async_event(struct nvme_ctrl *ctrl, int aer_idx)
 	c.common.command_id = NVME_AQ_BLKMQ_DEPTH + aer_idx;
 
 	spin_lock_irq(&nvmeq->q_lock);
-	__nvme_submit_cmd(nvmeq, &c);
+	__nvme_submit_cmd(nvmeq, &c, true);
 	spin_unlock_irq(&nvmeq->q_lock);
 }
 
@@ -927,7 +1035,10 @@ static int adapter_alloc_cq(struct nvme_dev *dev, u16 qid,
 						struct nvme_queue *nvmeq)
 {
 	struct nvme_command c;
-	int flags = NVME_QUEUE_PHYS_CONTIG | NVME_CQ_IRQ_ENABLED;
+	int flags = NVME_QUEUE_PHYS_CONTIG;
+
+	if (!nvmeq->polled)
+		flags |= NVME_CQ_IRQ_ENABLED;
 
 	/*
 	 * Note: we (ab)use the fact the the prp fields survive if no data
@@ -1151,6 +1262,21 @@ static void nvme_free_queues(struct nvme_dev *dev, int lowest)
 	}
 }
 
+static void nvme_free_poll_queues(struct nvme_dev *dev)
+{
+	int i;
+
+	if (!dev->poll_queues)
+		return;
+
+	for (i = num_possible_cpus() - 1; i >= 0; i--) {
+		if (dev->poll_queues[i]) {
+			nvme_free_queue(dev->poll_queues[i]);
+			dev->poll_queues[i] = NULL;
+		}
+	}
+}
+
 /**
  * nvme_suspend_queue - put queue into suspended state
  * @nvmeq - queue to suspend
@@ -1165,10 +1291,14 @@ static int nvme_suspend_queue(struct nvme_queue *nvmeq)
 		return 1;
 	}
 	vector = nvmeq->cq_vector;
-	nvmeq->dev->online_queues--;
+	if (!nvmeq->polled)
+		nvmeq->dev->online_queues--;
 	nvmeq->cq_vector = -1;
 	spin_unlock_irq(&nvmeq->q_lock);
 
+	if (nvmeq->polled)
+		return 0;
+
 	if (!nvmeq->qid && nvmeq->dev->ctrl.admin_q)
 		blk_mq_quiesce_queue(nvmeq->dev->ctrl.admin_q);
 
@@ -1196,36 +1326,28 @@ static void nvme_disable_admin_queue(struct nvme_dev *dev, bool shutdown)
 	spin_unlock_irq(&nvmeq->q_lock);
 }
 
-static int nvme_cmb_qdepth(struct nvme_dev *dev, int nr_io_queues,
-				int entry_size)
+/*
+ * Each I/O SQ gets a fixed slot of the CMB, and the queues whose slot lies
+ * past its end are placed in host memory instead.
+ */
+static bool nvme_cmb_fits_sq(struct nvme_dev *dev, int qid, int depth,
+			     u64 *offset)
 {
-	int q_depth = dev->q_depth;
-	unsigned q_size_aligned = roundup(q_depth * entry_size,
-					  dev->ctrl.page_size);
+	u64 slot = roundup(SQ_SIZE(depth), dev->ctrl.page_size);
 
-	if (q_size_aligned * nr_io_queues > dev->cmb_size) {
-		u64 mem_per_q = div_u64(dev->cmb_size, nr_io_queues);
-		mem_per_q = round_down(mem_per_q, dev->ctrl.page_size);
-		q_depth = div_u64(mem_per_q, entry_size);
-
-		/*
-		 * Ensure the reduced q_depth is above some threshold where it
-		 * would be better to map queues in system memory with the
-		 * original depth
-		 */
-		if (q_depth < 64)
-			return -ENOMEM;
-	}
+	if (!qid || !dev->cmb || !use_cmb_sqes || !NVME_CMB_SQS(dev->cmbsz))
+		return false;
 
-	return q_depth;
+	*offset = (qid - 1) * slot;
+	return *offset + slot <= dev->cmb_size;
 }
 
 static int nvme_alloc_sq_cmds(struct nvme_dev *dev, struct nvme_queue *nvmeq,
 				int qid, int depth)
 {
-	if (qid && dev->cmb && use_cmb_sqes && NVME_CMB_SQS(dev->cmbsz)) {
-		unsigned offset = (qid - 1) * roundup(SQ_SIZE(depth),
-						      dev->ctrl.page_size);
+	u64 offset;
+
+	if (nvme_cmb_fits_sq(dev, qid, depth, &offset)) {
 		nvmeq->sq_dma_addr = dev->cmb_bus_addr + offset;
 		nvmeq->sq_cmds_io = dev->cmb + offset;
 	} else {
@@ -1238,7 +1360,7 @@ static int nvme_alloc_sq_cmds(struct nvme_dev *dev, struct nvme_queue *nvmeq,
 	return 0;
 }
 
-static struct nvme_queue *nvme_alloc_queue(struct nvme_dev *dev, int qid,
+static struct nvme_queue *__nvme_alloc_queue(struct nvme_dev *dev, int qid,
 							int depth, int node)
 {
 	struct nvme_queue *nvmeq = kzalloc_node(sizeof(*nvmeq), GFP_KERNEL,
@@ -1263,8 +1385,6 @@ static struct nvme_queue *nvme_alloc_queue(struct nvme_dev *dev, int qid,
 	nvmeq->q_depth = depth;
 	nvmeq->qid = qid;
 	nvmeq->cq_vector = -1;
-	dev->queues[qid] = nvmeq;
-	dev->ctrl.queue_count++;
 
 	return nvmeq;
 
@@ -1276,6 +1396,20 @@ static struct nvme_queue *nvme_alloc_queue(struct nvme_dev *dev, int qid,
 	return NULL;
 }
 
+static struct nvme_queue *nvme_alloc_queue(struct nvme_dev *dev, int qid,
+							int depth, int node)
+{
+	struct nvme_queue *nvmeq = __nvme_alloc_queue(dev, qid, depth, node);
+
+	if (!nvmeq)
+		return NULL;
+
+	dev->queues[qid] = nvmeq;
+	dev->ctrl.queue_count++;
+
+	return nvmeq;
+}
+
 static int queue_request_irq(struct nvme_queue *nvmeq)
 {
 	struct pci_dev *pdev = to_pci_dev(nvmeq->dev->dev);
@@ -1296,12 +1430,14 @@ static void nvme_init_queue(struct nvme_queue *nvmeq, u16 qid)
 
 	spin_lock_irq(&nvmeq->q_lock);
 	nvmeq->sq_tail = 0;
+	nvmeq->last_sq_tail = 0;
 	nvmeq->cq_head = 0;
 	nvmeq->cq_phase = 1;
 	nvmeq->q_db = &dev->dbs[qid * 2 * dev->db_stride];
 	memset((void *)nvmeq->cqes, 0, CQ_SIZE(nvmeq->q_depth));
 	nvme_dbbuf_init(dev, nvmeq, qid);
-	dev->online_queues++;
+	if (!nvmeq->polled)
+		dev->online_queues++;
 	spin_unlock_irq(&nvmeq->q_lock);
 }
 
@@ -1310,16 +1446,30 @@ static int nvme_create_queue(struct nvme_queue *nvmeq, int qid)
 	struct nvme_dev *dev = nvmeq->dev;
 	int result;
 
-	nvmeq->cq_vector = qid - 1;
+	/* The CMB is mapped again on every reset, follow it */
+	if (nvmeq->sq_cmds_io) {
+		u64 offset;
+
+		if (!nvme_cmb_fits_sq(dev, qid, nvmeq->q_depth, &offset))
+			return -ENOMEM;
+		nvmeq->sq_dma_addr = dev->cmb_bus_addr + offset;
+		nvmeq->sq_cmds_io = dev->cmb + offset;
+	}
+
+	/* A polled queue has no vector, but must still look live */
+	nvmeq->cq_vector = nvmeq->polled ? 0 : qid - 1;
 	result = adapter_alloc_cq(dev, qid, nvmeq);
 	if (result < 0)
-		return result;
+		goto out;
 
 	result = adapter_alloc_sq(dev, qid, nvmeq);
 	if (result < 0)
 		goto release_cq;
 
 	nvme_init_queue(nvmeq, qid);
+	if (nvmeq->polled)
+		return 0;
+
 	result = queue_request_irq(nvmeq);
 	if (result < 0)
 		goto release_sq;
@@ -1330,6 +1480,9 @@ static int nvme_create_queue(struct nvme_queue *nvmeq, int qid)
 	adapter_delete_sq(dev, qid);
  release_cq:
 	adapter_delete_cq(dev, qid);
+ out:
+	if (nvmeq->polled)
+		nvmeq->cq_vector = -1;
 	return result;
 }
 
@@ -1480,6 +1633,44 @@ static int nvme_pci_configure_admin_queue(struct nvme_dev *dev)
 	return result;
 }
 
+/*
+ * Polled queues take the qids above the interrupt driven ones, so a queue
+ * left over from before a reset is reallocated if that range moved.
+ */
+static void nvme_create_poll_queues(struct nvme_dev *dev)
+{
+	unsigned i, nr = min(dev->max_poll_queues, dev->online_queues - 1);
+
+	dev->nr_poll_queues = 0;
+	for (i = 0; i < nr; i++) {
+		struct nvme_queue *nvmeq = dev->poll_queues[i];
+		int qid = dev->max_qid + 1 + i;
+
+		if (nvmeq && (nvmeq->qid != qid ||
+			      nvmeq->q_depth != dev->q_depth)) {
+			nvme_free_queue(nvmeq);
+			dev->poll_queues[i] = nvmeq = NULL;
+		}
+		if (!nvmeq) {
+			nvmeq = __nvme_alloc_queue(dev, qid, dev->q_depth,
+				pci_irq_get_node(to_pci_dev(dev->dev), i));
+			if (!nvmeq)
+				break;
+			nvmeq->polled = 1;
+			if (dev->ctrl.tagset)
+				nvmeq->tags = &dev->tagset.tags[i];
+			dev->poll_queues[i] = nvmeq;
+		}
+		if (nvme_create_queue(nvmeq, qid))
+			break;
+		dev->nr_poll_queues++;
+	}
+
+	if (dev->max_poll_queues)
+		dev_info(dev->ctrl.device, "%u/%u polled queues\n",
+			 dev->nr_poll_queues, dev->online_queues - 1);
+}
+
 static int nvme_create_io_queues(struct nvme_dev *dev)
 {
 	unsigned i, max;
@@ -1501,6 +1692,9 @@ static int nvme_create_io_queues(struct nvme_dev *dev)
 			break;
 	}
 
+	if (dev->online_queues > 1)
+		nvme_create_poll_queues(dev);
+
 	/*
 	 * Ignore failing Create SQ/CQ commands, we can continue with less
 	 * than the desired aount of queues, and even a controller without
@@ -1521,6 +1715,42 @@ static ssize_t nvme_cmb_show(struct device *dev,
 }
 static DEVICE_ATTR(cmb, S_IRUGO, nvme_cmb_show, NULL);
 
+static void nvme_queue_lat_add(struct nvme_queue *nvmeq, u64 *nr, u64 *lat)
+{
+	if (!nvmeq)
+		return;
+
+	spin_lock_irq(&nvmeq->q_lock);
+	*nr += nvmeq->nr_completed;
+	*lat += nvmeq->lat_ns;
+	spin_unlock_irq(&nvmeq->q_lock);
+}
+
+/*
+ * Completion latency, from the doorbell write to the reaping of the CQE,
+ * of the interrupt driven and of the polled I/O queues.
+ */
+static ssize_t nvme_queue_lat_show(struct device *dev,
+				   struct device_attribute *attr,
+				   char *buf)
+{
+	struct nvme_dev *ndev = to_nvme_dev(dev_get_drvdata(dev));
+	u64 irq_nr = 0, irq_lat = 0, poll_nr = 0, poll_lat = 0;
+	unsigned i;
+
+	for (i = 1; i < ndev->online_queues; i++)
+		nvme_queue_lat_add(ndev->queues[i], &irq_nr, &irq_lat);
+	for (i = 0; i < ndev->nr_poll_queues; i++)
+		nvme_queue_lat_add(ndev->poll_queues[i], &poll_nr, &poll_lat);
+
+	return scnprintf(buf, PAGE_SIZE,
+			 "irq  : %llu cqes, %llu ns avg\n"
+			 "poll : %llu cqes, %llu ns avg\n",
+			 irq_nr, irq_nr ? div64_u64(irq_lat, irq_nr) : 0,
+			 poll_nr, poll_nr ? div64_u64(poll_lat, poll_nr) : 0);
+}
+static DEVICE_ATTR(queue_latency, S_IRUGO, nvme_queue_lat_show, NULL);
+
 static void __iomem *nvme_map_cmb(struct nvme_dev *dev)
 {
 	u64 szu, size, offset;
@@ -1753,25 +1983,27 @@ static int nvme_setup_io_queues(struct nvme_dev *dev)
 {
 	struct nvme_queue *adminq = dev->queues[0];
 	struct pci_dev *pdev = to_pci_dev(dev->dev);
-	int result, nr_io_queues;
+	int result, nr_io_queues, nr_irq_queues;
 	unsigned long size;
+	/*
+	 * Shadow doorbells only cover one queue pair per CPU, and the
+	 * controllers that want them are emulated ones, where polling
+	 * buys nothing anyway.
+	 */
+	bool want_poll = dev->poll_queues && !dev->dbbuf_dbs;
 
 	nr_io_queues = num_present_cpus();
+	if (want_poll)
+		nr_io_queues *= 2;
 	result = nvme_set_queue_count(&dev->ctrl, &nr_io_queues);
 	if (result < 0)
 		return result;
 
+	dev->max_poll_queues = 0;
 	if (nr_io_queues == 0)
 		return 0;
-
-	if (dev->cmb && NVME_CMB_SQS(dev->cmbsz)) {
-		result = nvme_cmb_qdepth(dev, nr_io_queues,
-				sizeof(struct nvme_command));
-		if (result > 0)
-			dev->q_depth = result;
-		else
-			nvme_release_cmb(dev);
-	}
+	if (nr_io_queues < 2)
+		want_poll = false;
 
 	do {
 		size = db_bar_size(dev, nr_io_queues);
@@ -1791,11 +2023,15 @@ static int nvme_setup_io_queues(struct nvme_dev *dev)
 	 * setting up the full range we need.
 	 */
 	pci_free_irq_vectors(pdev);
-	nr_io_queues = pci_alloc_irq_vectors(pdev, 1, nr_io_queues,
+	nr_irq_queues = want_poll ? nr_io_queues / 2 : nr_io_queues;
+	nr_irq_queues = pci_alloc_irq_vectors(pdev, 1, nr_irq_queues,
 			PCI_IRQ_ALL_TYPES | PCI_IRQ_AFFINITY);
-	if (nr_io_queues <= 0)
+	if (nr_irq_queues <= 0)
 		return -EIO;
-	dev->max_qid = nr_io_queues;
+	dev->max_qid = nr_irq_queues;
+	if (want_poll)
+		dev->max_poll_queues = min(nr_irq_queues,
+					   nr_io_queues - nr_irq_queues);
 
 	/*
 	 * Should investigate if there's a performance win from allocating
@@ -1864,7 +2100,8 @@ static int nvme_delete_queue(struct nvme_queue *nvmeq, u8 opcode)
 	return 0;
 }
 
-static void nvme_disable_io_queues(struct nvme_dev *dev, int queues)
+static void nvme_disable_io_queues(struct nvme_dev *dev,
+				   struct nvme_queue **nvmeqs, int queues)
 {
 	int pass;
 	unsigned long timeout;
@@ -1877,7 +2114,7 @@ static void nvme_disable_io_queues(struct nvme_dev *dev, int queues)
  retry:
 		timeout = ADMIN_TIMEOUT;
 		for (; i > 0; i--, sent++)
-			if (nvme_delete_queue(dev->queues[i], opcode))
+			if (nvme_delete_queue(nvmeqs[i - 1], opcode))
 				break;
 
 		while (sent--) {
@@ -2025,7 +2262,7 @@ static void nvme_pci_disable(struct nvme_dev *dev)
 
 static void nvme_dev_disable(struct nvme_dev *dev, bool shutdown)
 {
-	int i, queues;
+	int i, queues, poll;
 	bool dead = true;
 	struct pci_dev *pdev = to_pci_dev(dev->dev);
 
@@ -2061,6 +2298,10 @@ static void nvme_dev_disable(struct nvme_dev *dev, bool shutdown)
 	nvme_stop_queues(&dev->ctrl);
 
 	queues = dev->online_queues - 1;
+	poll = dev->nr_poll_queues;
+	for (i = poll - 1; i >= 0; i--)
+		nvme_suspend_queue(dev->poll_queues[i]);
+	dev->nr_poll_queues = 0;
 	for (i = dev->ctrl.queue_count - 1; i > 0; i--)
 		nvme_suspend_queue(dev->queues[i]);
 
@@ -2072,7 +2313,8 @@ static void nvme_dev_disable(struct nvme_dev *dev, bool shutdown)
 		if (dev->ctrl.queue_count)
 			nvme_suspend_queue(dev->queues[0]);
 	} else {
-		nvme_disable_io_queues(dev, queues);
+		nvme_disable_io_queues(dev, dev->poll_queues, poll);
+		nvme_disable_io_queues(dev, dev->queues + 1, queues);
 		nvme_disable_admin_queue(dev, shutdown);
 	}
 	nvme_pci_disable(dev);
@@ -2123,6 +2365,7 @@ static void nvme_pci_free_ctrl(struct nvme_ctrl *ctrl)
 		blk_mq_free_tag_set(&dev->tagset);
 	if (dev->ctrl.admin_q)
 		blk_put_queue(dev->ctrl.admin_q);
+	kfree(dev->poll_queues);
 	kfree(dev->queues);
 	free_opal_dev(dev->ctrl.opal_dev);
 	kfree(dev);
@@ -2319,6 +2562,12 @@ static int nvme_probe(struct pci_dev *pdev, const struct pci_device_id *id)
 							GFP_KERNEL, node);
 	if (!dev->queues)
 		goto free;
+	if (poll_queues) {
+		dev->poll_queues = kzalloc_node(num_possible_cpus() *
+						sizeof(void *), GFP_KERNEL, node);
+		if (!dev->poll_queues)
+			goto free;
+	}
 
 	dev->dev = get_device(&pdev->dev);
 	pci_set_drvdata(pdev, dev);
@@ -2346,6 +2595,12 @@ static int nvme_probe(struct pci_dev *pdev, const struct pci_device_id *id)
 	nvme_change_ctrl_state(&dev->ctrl, NVME_CTRL_RESETTING);
 	dev_info(dev->ctrl.device, "pci function %s\n", dev_name(&pdev->dev));
 
+	if (poll_queues &&
+	    sysfs_add_file_to_group(&dev->ctrl.device->kobj,
+				    &dev_attr_queue_latency.attr, NULL))
+		dev_warn(dev->ctrl.device,
+			 "failed to add sysfs attribute for queue latency\n");
+
 	queue_work(nvme_wq, &dev->ctrl.reset_work);
 	return 0;
 
@@ -2356,6 +2611,7 @@ static int nvme_probe(struct pci_dev *pdev, const struct pci_device_id *id)
  put_pci:
 	put_device(dev->dev);
  free:
+	kfree(dev->poll_queues);
 	kfree(dev->queues);
 	kfree(dev);
 	return result;
@@ -2404,6 +2660,7 @@ static void nvme_remove(struct pci_dev *pdev)
 	nvme_dev_disable(dev, true);
 	nvme_free_host_mem(dev);
 	nvme_dev_remove_admin(dev);
+	nvme_free_poll_queues(dev);
 	nvme_free_queues(dev, 0);
 	nvme_uninit_ctrl(&dev->ctrl);
 	nvme_release_prp_pools(dev);
@@ -42,6 +42,15 @@ static ulong pram_ftrace_size = 2*SZ_4K;
 module_param_named(ftrace_size, pram_ftrace_size, ulong, 0400);
 MODULE_PARM_DESC(ftrace_size, "size of ftrace log");
 
+static ulong pram_pmsg_size;
+module_param_named(pmsg_size, pram_pmsg_size, ulong, 0400);
+MODULE_PARM_DESC(pmsg_size, "size of user space message log");
+
+static bool pram_per_cpu = true;
+module_param_named(per_cpu, pram_per_cpu, bool, 0400);
+MODULE_PARM_DESC(per_cpu,
+		 "use lockless per-CPU ftrace and pmsg zones (default true)");
+
 static int pram_dump_oops = 1;
 module_param_named(dump_oops, pram_dump_oops, int, 0600);
 MODULE_PARM_DESC(dump_oops,
@@ -77,7 +86,11 @@ static int register_pram_dev(unsigned long mem_address,
 	pram_data->record_size = pram_record_size;
 	pram_data->console_size = pram_console_size;
 	pram_data->ftrace_size = pram_ftrace_size;
+	pram_data->pmsg_size = pram_pmsg_size;
 	pram_data->dump_oops = pram_dump_oops;
+	if (pram_per_cpu)
+		pram_data->flags = RAMOOPS_FLAG_FTRACE_PER_CPU |
+				   RAMOOPS_FLAG_PMSG_PER_CPU;
 	/*
 	 * For backwards compatibility with previous
 	 * fs/pstore/ram_core.c implementation,
@@ -380,6 +380,7 @@ static int ion_dma_buf_end_cpu_access(struct dma_buf *dmabuf,
 static const struct dma_buf_ops dma_buf_ops = {
 	.map_dma_buf = ion_map_dma_buf,
 	.unmap_dma_buf = ion_unmap_dma_buf,
+	.cache_sgt_mapping = true,
 	.mmap = ion_mmap,
 	.release = ion_dma_buf_release,
 	.attach = ion_dma_buf_attach,
@@ -537,6 +538,25 @@ static int debug_shrink_get(void *data, u64 *val)
 DEFINE_SIMPLE_ATTRIBUTE(debug_shrink_fops, debug_shrink_get,
 			debug_shrink_set, "%llu\n");
 
+static int ion_heap_debug_show(struct seq_file *s, void *unused)
+{
+	struct ion_heap *heap = s->private;
+
+	return heap->debug_show(heap, s, unused);
+}
+
+static int ion_heap_debug_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ion_heap_debug_show, inode->i_private);
+}
+
+static const struct file_operations ion_heap_debug_fops = {
+	.open = ion_heap_debug_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 void ion_device_add_heap(struct ion_heap *heap)
 {
 	struct dentry *debug_file;
@@ -581,6 +601,19 @@ void ion_device_add_heap(struct ion_heap *heap)
 		}
 	}
 
+	if (heap->debug_show) {
+		debug_file = debugfs_create_file(heap->name, 0444,
+						 dev->debug_root, heap,
+						 &ion_heap_debug_fops);
+		if (!debug_file) {
+			char buf[256], *path;
+
+			path = dentry_path(dev->debug_root, buf, 256);
+			pr_err("Failed to create heap debugfs at %s/%s\n",
+			       path, heap->name);
+		}
+	}
+
 	dev->heap_cnt++;
 	up_write(&dev->lock);
 }
@@ -25,6 +25,7 @@
 #include <linux/rbtree.h>
 #include <linux/sched.h>
 #include <linux/shrinker.h>
+#include <linux/spinlock.h>
 #include <linux/types.h>
 #include <linux/miscdevice.h>
 
@@ -53,6 +54,21 @@ struct ion_platform_heap {
 	void *priv;
 };
 
+/**
+ * struct ion_carveout_class - a region of a carveout heap kept for a size class
+ * @max_size:	largest buffer allocated from the region
+ * @size:	size of the region in bytes
+ *
+ * Passed in ion_platform_heap.priv of a carveout heap, as an array
+ * terminated by a zero @size.  Buffers up to @max_size are allocated from
+ * the smallest class region they fit, and from the rest of the heap only
+ * once it is full, so that they don't fragment it for large buffers.
+ */
+struct ion_carveout_class {
+	size_t max_size;
+	size_t size;
+};
+
 /**
  * struct ion_buffer - metadata for a particular buffer
  * @ref:		reference count
@@ -308,18 +324,44 @@ size_t ion_heap_freelist_size(struct ion_heap *heap);
  * many systems
  */
 
+#define ION_PAGE_POOL_PCP_PAGES	16
+
+/**
+ * struct ion_page_pool_pcp - per-cpu front cache of a page pool
+ * @lock:		protects the cache, only contended by the shrinker
+ * @count:		number of pages in @pages
+ * @pages:		cached pages, used as a stack
+ */
+struct ion_page_pool_pcp {
+	spinlock_t lock;
+	unsigned int count;
+	struct page *pages[ION_PAGE_POOL_PCP_PAGES];
+};
+
 /**
  * struct ion_page_pool - pagepool struct
  * @high_count:		number of highmem items in the pool
  * @low_count:		number of lowmem items in the pool
  * @high_items:		list of highmem items
  * @low_items:		list of lowmem items
+ * @dirty_count:	number of items still waiting to be zeroed
+ * @dirty_items:	list of items waiting to be zeroed
  * @mutex:		lock protecting this struct and especially the count
  *			item list
  * @gfp_mask:		gfp_mask to use from alloc
  * @order:		order of pages in the pool
  * @list:		plist node for list of pools
  * @cached:		it's cached pool or not
+ * @pcp:		per-cpu caches in front of the item lists
+ * @pcp_high:		max pages held in each per-cpu cache
+ * @pcp_batch:		pages moved between a per-cpu cache and the lists
+ *			at once
+ * @pools_entry:	entry in the list of pools served by the zeroing thread
+ * @zeroed_hits:	allocations served with pages zeroed ahead of time
+ * @zeroed_misses:	allocations that had to zero or allocate a page
+ *
+ * Only @dirty_items hold pages that have not been zeroed yet; they are
+ * cleared in the background and then moved to @high_items or @low_items.
  *
  * Allows you to keep a pool of pre allocated pages to use from your heap.
  * Keeping a pool of pages that is ready for dma, ie any cached mapping have
@@ -332,10 +374,18 @@ struct ion_page_pool {
 	bool cached;
 	struct list_head high_items;
 	struct list_head low_items;
+	int dirty_count;
+	struct list_head dirty_items;
 	struct mutex mutex;
 	gfp_t gfp_mask;
 	unsigned int order;
 	struct plist_node list;
+	struct ion_page_pool_pcp __percpu *pcp;
+	unsigned int pcp_high;
+	unsigned int pcp_batch;
+	struct list_head pools_entry;
+	atomic_long_t zeroed_hits;
+	atomic_long_t zeroed_misses;
 };
 
 struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order,
@@ -343,6 +393,7 @@ struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order,
 void ion_page_pool_destroy(struct ion_page_pool *pool);
 struct page *ion_page_pool_alloc(struct ion_page_pool *pool);
 void ion_page_pool_free(struct ion_page_pool *pool, struct page *page);
+void ion_page_pool_free_dirty(struct ion_page_pool *pool, struct page *page);
 
 /** ion_page_pool_shrink - shrinks the size of the memory cached in the pool
  * @pool:		the pool
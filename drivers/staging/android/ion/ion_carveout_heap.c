@@ -16,44 +16,255 @@
 #include <linux/spinlock.h>
 #include <linux/dma-mapping.h>
 #include <linux/err.h>
-#include <linux/genalloc.h>
 #include <linux/io.h>
+#include <linux/log2.h>
 #include <linux/mm.h>
 #include <linux/scatterlist.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
 #include "ion.h"
 
 #define ION_CARVEOUT_ALLOCATE_FAIL	-1
 
+/* Largest block of the buddy allocator, 4GB with 4K pages */
+#define ION_CARVEOUT_MAX_ORDER		20
+
+/**
+ * struct ion_carveout_pool - a buddy allocator over a range of the carveout
+ * @base_pfn:	first page of the range
+ * @nr_pages:	size of the range
+ * @max_size:	largest buffer allocated from the range, 0 for no limit
+ * @free_area:	free blocks of each order
+ * @nr_free:	number of blocks in each free_area list
+ * @free_pages:	pages in the free blocks
+ * @allocs:	successful allocations
+ * @failed:	failed allocations
+ * @frag_failed: failed allocations that would have fit in @free_pages
+ *
+ * The carveout has struct pages that the page allocator never uses, so
+ * like the page allocator we link free blocks through page->lru and keep
+ * order + 1 in page_private() of the head page of a free block, 0 for
+ * any other page.  Allocation and free are then O(log n), and need no
+ * memory besides this structure.
+ */
+struct ion_carveout_pool {
+	unsigned long base_pfn;
+	unsigned long nr_pages;
+	size_t max_size;
+	struct list_head free_area[ION_CARVEOUT_MAX_ORDER + 1];
+	unsigned long nr_free[ION_CARVEOUT_MAX_ORDER + 1];
+	unsigned long free_pages;
+	unsigned long allocs;
+	unsigned long failed;
+	unsigned long frag_failed;
+};
+
+/*
+ * pools[0] spans the carveout except for the size class regions of
+ * struct ion_carveout_class, which follow it.
+ */
 struct ion_carveout_heap {
 	struct ion_heap heap;
-	struct gen_pool *pool;
 	phys_addr_t base;
+	spinlock_t lock;
+	int nr_pools;
+	struct ion_carveout_pool pools[];
 };
 
+#define to_carveout_heap(x) container_of(x, struct ion_carveout_heap, heap)
+
+static struct page *pool_page(struct ion_carveout_pool *pool,
+			      unsigned long idx)
+{
+	return pfn_to_page(pool->base_pfn + idx);
+}
+
+static void pool_add_free(struct ion_carveout_pool *pool, unsigned long idx,
+			  unsigned int order)
+{
+	struct page *page = pool_page(pool, idx);
+
+	set_page_private(page, order + 1);
+	list_add(&page->lru, &pool->free_area[order]);
+	pool->nr_free[order]++;
+}
+
+/* Free the block at @idx, merging it with its free buddies */
+static void pool_free_block(struct ion_carveout_pool *pool, unsigned long idx,
+			    unsigned int order)
+{
+	while (order < ION_CARVEOUT_MAX_ORDER) {
+		unsigned long buddy = idx ^ (1UL << order);
+		struct page *page;
+
+		if (buddy + (1UL << order) > pool->nr_pages)
+			break;
+
+		page = pool_page(pool, buddy);
+		if (page_private(page) != order + 1)
+			break;
+
+		list_del(&page->lru);
+		set_page_private(page, 0);
+		pool->nr_free[order]--;
+
+		idx &= ~(1UL << order);
+		order++;
+	}
+
+	pool_add_free(pool, idx, order);
+}
+
+/* Free [@idx, @idx + @count) as the largest aligned blocks it holds */
+static void pool_free_range(struct ion_carveout_pool *pool, unsigned long idx,
+			    unsigned long count)
+{
+	unsigned int order;
+
+	pool->free_pages += count;
+	while (count) {
+		order = min_t(unsigned int, ION_CARVEOUT_MAX_ORDER,
+			      fls_long(count) - 1);
+		if (idx)
+			order = min_t(unsigned int, order, __ffs(idx));
+
+		pool_free_block(pool, idx, order);
+		idx += 1UL << order;
+		count -= 1UL << order;
+	}
+}
+
+/*
+ * Take the smallest free block that fits, split it down and give the
+ * pages past @count back, so a buffer uses no more than its size.
+ */
+static long pool_alloc(struct ion_carveout_pool *pool, unsigned long count)
+{
+	unsigned int order = order_base_2(count);
+	unsigned int o;
+	struct page *page;
+	unsigned long idx;
+
+	if (order > ION_CARVEOUT_MAX_ORDER)
+		return -ENOMEM;
+
+	for (o = order; o <= ION_CARVEOUT_MAX_ORDER; o++)
+		if (!list_empty(&pool->free_area[o]))
+			break;
+	if (o > ION_CARVEOUT_MAX_ORDER)
+		return -ENOMEM;
+
+	page = list_first_entry(&pool->free_area[o], struct page, lru);
+	list_del(&page->lru);
+	set_page_private(page, 0);
+	pool->nr_free[o]--;
+	idx = page_to_pfn(page) - pool->base_pfn;
+
+	while (o > order) {
+		o--;
+		pool_add_free(pool, idx + (1UL << o), o);
+	}
+
+	pool->free_pages -= 1UL << order;
+	pool_free_range(pool, idx + count, (1UL << order) - count);
+	return idx;
+}
+
+static void pool_init(struct ion_carveout_pool *pool, unsigned long base_pfn,
+		      unsigned long nr_pages, size_t max_size)
+{
+	unsigned long i;
+
+	pool->base_pfn = base_pfn;
+	pool->nr_pages = nr_pages;
+	pool->max_size = max_size;
+	for (i = 0; i <= ION_CARVEOUT_MAX_ORDER; i++)
+		INIT_LIST_HEAD(&pool->free_area[i]);
+	for (i = 0; i < nr_pages; i++)
+		set_page_private(pool_page(pool, i), 0);
+
+	pool_free_range(pool, 0, nr_pages);
+}
+
+static struct ion_carveout_pool *
+ion_carveout_find_pool(struct ion_carveout_heap *carveout_heap,
+		       unsigned long pfn)
+{
+	int i;
+
+	for (i = 0; i < carveout_heap->nr_pools; i++) {
+		struct ion_carveout_pool *pool = &carveout_heap->pools[i];
+
+		if (pfn >= pool->base_pfn &&
+		    pfn < pool->base_pfn + pool->nr_pages)
+			return pool;
+	}
+	return NULL;
+}
+
 static phys_addr_t ion_carveout_allocate(struct ion_heap *heap,
 					 unsigned long size)
 {
-	struct ion_carveout_heap *carveout_heap =
-		container_of(heap, struct ion_carveout_heap, heap);
-	unsigned long offset = gen_pool_alloc(carveout_heap->pool, size);
+	struct ion_carveout_heap *carveout_heap = to_carveout_heap(heap);
+	struct ion_carveout_pool *pool = &carveout_heap->pools[0];
+	struct ion_carveout_pool *class = NULL;
+	unsigned long count = PAGE_ALIGN(size) >> PAGE_SHIFT;
+	long idx = -ENOMEM;
+	int i;
 
-	if (!offset)
+	spin_lock(&carveout_heap->lock);
+
+	/* The smallest size class the buffer fits, then the main pool */
+	for (i = 1; i < carveout_heap->nr_pools; i++) {
+		struct ion_carveout_pool *p = &carveout_heap->pools[i];
+
+		if (size <= p->max_size &&
+		    (!class || p->max_size < class->max_size))
+			class = p;
+	}
+	if (class) {
+		idx = pool_alloc(class, count);
+		if (idx >= 0)
+			pool = class;
+	}
+	if (idx < 0)
+		idx = pool_alloc(pool, count);
+
+	if (idx >= 0) {
+		pool->allocs++;
+	} else {
+		pool->failed++;
+		if (pool->free_pages >= count)
+			pool->frag_failed++;
+	}
+
+	spin_unlock(&carveout_heap->lock);
+
+	if (idx < 0)
 		return ION_CARVEOUT_ALLOCATE_FAIL;
 
-	return offset;
+	return PFN_PHYS(pool->base_pfn + idx);
 }
 
 static void ion_carveout_free(struct ion_heap *heap, phys_addr_t addr,
 			      unsigned long size)
 {
-	struct ion_carveout_heap *carveout_heap =
-		container_of(heap, struct ion_carveout_heap, heap);
+	struct ion_carveout_heap *carveout_heap = to_carveout_heap(heap);
+	struct ion_carveout_pool *pool;
+	unsigned long pfn = PFN_DOWN(addr);
 
 	if (addr == ION_CARVEOUT_ALLOCATE_FAIL)
 		return;
-	gen_pool_free(carveout_heap->pool, addr, size);
+
+	pool = ion_carveout_find_pool(carveout_heap, pfn);
+	if (WARN_ON(!pool))
+		return;
+
+	spin_lock(&carveout_heap->lock);
+	pool_free_range(pool, pfn - pool->base_pfn,
+			PAGE_ALIGN(size) >> PAGE_SHIFT);
+	spin_unlock(&carveout_heap->lock);
 }
 
 static int ion_carveout_heap_allocate(struct ion_heap *heap,
@@ -104,6 +315,49 @@ static void ion_carveout_heap_free(struct ion_buffer *buffer)
 	kfree(table);
 }
 
+static void ion_carveout_pool_show(struct seq_file *s,
+				   struct ion_carveout_pool *pool)
+{
+	unsigned long largest = 0;
+	int order;
+
+	if (pool->max_size)
+		seq_printf(s, "class up to %zu bytes:", pool->max_size);
+	else
+		seq_puts(s, "main:");
+	seq_printf(s, " %lu pages, %lu free\n", pool->nr_pages,
+		   pool->free_pages);
+
+	seq_puts(s, "  free blocks per order:");
+	for (order = 0; order <= ION_CARVEOUT_MAX_ORDER; order++) {
+		seq_printf(s, " %lu", pool->nr_free[order]);
+		if (pool->nr_free[order])
+			largest = 1UL << order;
+	}
+	seq_putc(s, '\n');
+
+	/* Share of the free pages outside the largest free block */
+	seq_printf(s, "  largest free block %lu pages, fragmentation %lu%%\n",
+		   largest, pool->free_pages ?
+		   100 - largest * 100 / pool->free_pages : 0);
+	seq_printf(s, "  allocs %lu failed %lu failed on fragmentation %lu\n",
+		   pool->allocs, pool->failed, pool->frag_failed);
+}
+
+static int ion_carveout_heap_debug_show(struct ion_heap *heap,
+					struct seq_file *s, void *unused)
+{
+	struct ion_carveout_heap *carveout_heap = to_carveout_heap(heap);
+	int i;
+
+	spin_lock(&carveout_heap->lock);
+	for (i = 0; i < carveout_heap->nr_pools; i++)
+		ion_carveout_pool_show(s, &carveout_heap->pools[i]);
+	spin_unlock(&carveout_heap->lock);
+
+	return 0;
+}
+
 static struct ion_heap_ops carveout_heap_ops = {
 	.allocate = ion_carveout_heap_allocate,
 	.free = ion_carveout_heap_free,
@@ -112,34 +366,59 @@ static struct ion_heap_ops carveout_heap_ops = {
 	.unmap_kernel = ion_heap_unmap_kernel,
 };
 
+/**
+ * ion_carveout_heap_create - create a carveout heap
+ * @heap_data:	the heap, ->priv may point to an array of
+ *		struct ion_carveout_class terminated by a zero size
+ */
 struct ion_heap *ion_carveout_heap_create(struct ion_platform_heap *heap_data)
 {
+	const struct ion_carveout_class *classes = heap_data->priv;
 	struct ion_carveout_heap *carveout_heap;
-	int ret;
+	unsigned long pfn, nr_pages, class_pages;
+	int ret, i, nr_classes = 0;
 
 	struct page *page;
 	size_t size;
 
 	page = pfn_to_page(PFN_DOWN(heap_data->base));
 	size = heap_data->size;
+	pfn = PFN_DOWN(heap_data->base);
+	nr_pages = size >> PAGE_SHIFT;
+
+	class_pages = 0;
+	for (i = 0; classes && classes[i].size; i++) {
+		class_pages += PAGE_ALIGN(classes[i].size) >> PAGE_SHIFT;
+		nr_classes++;
+	}
+	if (class_pages >= nr_pages)
+		return ERR_PTR(-EINVAL);
 
 	ret = ion_heap_pages_zero(page, size, pgprot_writecombine(PAGE_KERNEL));
 	if (ret)
 		return ERR_PTR(ret);
 
-	carveout_heap = kzalloc(sizeof(*carveout_heap), GFP_KERNEL);
+	carveout_heap = kzalloc(sizeof(*carveout_heap) +
+				(nr_classes + 1) * sizeof(carveout_heap->pools[0]),
+				GFP_KERNEL);
 	if (!carveout_heap)
 		return ERR_PTR(-ENOMEM);
 
-	carveout_heap->pool = gen_pool_create(PAGE_SHIFT, -1);
-	if (!carveout_heap->pool) {
-		kfree(carveout_heap);
-		return ERR_PTR(-ENOMEM);
-	}
+	spin_lock_init(&carveout_heap->lock);
 	carveout_heap->base = heap_data->base;
-	gen_pool_add(carveout_heap->pool, carveout_heap->base, heap_data->size,
-		     -1);
+	carveout_heap->nr_pools = nr_classes + 1;
+	pool_init(&carveout_heap->pools[0], pfn, nr_pages - class_pages, 0);
+	pfn += nr_pages - class_pages;
+	for (i = 0; i < nr_classes; i++) {
+		unsigned long count = PAGE_ALIGN(classes[i].size) >> PAGE_SHIFT;
+
+		pool_init(&carveout_heap->pools[i + 1], pfn, count,
+			  classes[i].max_size);
+		pfn += count;
+	}
+
 	carveout_heap->heap.ops = &carveout_heap_ops;
+	carveout_heap->heap.debug_show = ion_carveout_heap_debug_show;
 	carveout_heap->heap.type = ION_HEAP_TYPE_CARVEOUT;
 	carveout_heap->heap.flags = ION_HEAP_FLAG_DEFER_FREE;
 
@@ -20,30 +20,195 @@
 #include <linux/errno.h>
 #include <linux/err.h>
 #include <linux/cma.h>
+#include <linux/debugfs.h>
+#include <linux/ktime.h>
 #include <linux/scatterlist.h>
+#include <linux/seq_file.h>
+#include <linux/workqueue.h>
 
 #include "ion.h"
 
+/* Allocation latency buckets, bucket n counts latencies below 2^n us */
+#define ION_CMA_LAT_BUCKETS	22
+
+/*
+ * A range of the CMA area that was already allocated, i.e. evacuated of
+ * movable pages, by the refill worker, for allocations to be carved from.
+ */
+struct ion_cma_chunk {
+	struct list_head list;
+	unsigned long pfn;
+	unsigned long count;
+};
+
+/**
+ * struct ion_cma_heap - a heap backed by a CMA area
+ * @heap:	the ion heap
+ * @cma:	the CMA area
+ * @lock:	protects @chunks and @reserved
+ * @chunks:	the evacuated ranges, see struct ion_cma_chunk
+ * @reserved:	pages in @chunks
+ * @watermark:	pages the refill worker keeps in @chunks
+ * @refill:	the refill worker
+ * @hits:	allocations carved from @chunks
+ * @misses:	allocations that had to migrate pages
+ * @latency:	allocation latency histogram
+ *
+ * cma_alloc() has to migrate the pages that are in the way out of the
+ * area, which can take hundreds of milliseconds when a video or camera
+ * session starts.  With a watermark set, the heap keeps that much of the
+ * area evacuated ahead of time, and refills it in the background after
+ * an allocation.  The reserve is given back to the page allocator through
+ * the heap shrinker under memory pressure.
+ */
 struct ion_cma_heap {
 	struct ion_heap heap;
 	struct cma *cma;
+
+	spinlock_t lock;
+	struct list_head chunks;
+	unsigned long reserved;
+	unsigned long watermark;
+	struct work_struct refill;
+
+	atomic_long_t hits;
+	atomic_long_t misses;
+	atomic_long_t latency[ION_CMA_LAT_BUCKETS];
 };
 
 #define to_cma_heap(x) container_of(x, struct ion_cma_heap, heap)
 
+/* Carve @count pages from the head of the first chunk large enough */
+static struct page *ion_cma_reserve_take(struct ion_cma_heap *cma_heap,
+					 unsigned long count)
+{
+	struct ion_cma_chunk *chunk;
+	struct page *pages = NULL;
+
+	spin_lock(&cma_heap->lock);
+	list_for_each_entry(chunk, &cma_heap->chunks, list) {
+		if (chunk->count < count)
+			continue;
+
+		pages = pfn_to_page(chunk->pfn);
+		chunk->pfn += count;
+		chunk->count -= count;
+		cma_heap->reserved -= count;
+		if (!chunk->count) {
+			list_del(&chunk->list);
+			kfree(chunk);
+		}
+		break;
+	}
+	spin_unlock(&cma_heap->lock);
+
+	return pages;
+}
+
+/* Give chunks back to the CMA area, at least @count pages' worth */
+static unsigned long ion_cma_reserve_release(struct ion_cma_heap *cma_heap,
+					     unsigned long count)
+{
+	struct ion_cma_chunk *chunk, *tmp;
+	unsigned long freed = 0;
+	LIST_HEAD(release);
+
+	spin_lock(&cma_heap->lock);
+	list_for_each_entry_safe(chunk, tmp, &cma_heap->chunks, list) {
+		if (freed >= count)
+			break;
+		list_move(&chunk->list, &release);
+		cma_heap->reserved -= chunk->count;
+		freed += chunk->count;
+	}
+	spin_unlock(&cma_heap->lock);
+
+	list_for_each_entry_safe(chunk, tmp, &release, list) {
+		cma_release(cma_heap->cma, pfn_to_page(chunk->pfn),
+			    chunk->count);
+		kfree(chunk);
+	}
+
+	return freed;
+}
+
+static void ion_cma_refill(struct work_struct *work)
+{
+	struct ion_cma_heap *cma_heap = container_of(work, struct ion_cma_heap,
+						     refill);
+	struct ion_cma_chunk *chunk;
+	unsigned long want, count;
+	struct page *pages;
+
+	spin_lock(&cma_heap->lock);
+	want = cma_heap->watermark > cma_heap->reserved ?
+	       cma_heap->watermark - cma_heap->reserved : 0;
+	spin_unlock(&cma_heap->lock);
+
+	/* Settle for smaller ranges when the area is fragmented */
+	for (count = want; want && count; count = min(count, want)) {
+		chunk = kmalloc(sizeof(*chunk), GFP_KERNEL);
+		if (!chunk)
+			return;
+
+		pages = cma_alloc(cma_heap->cma, count, 0,
+				  GFP_KERNEL | __GFP_NOWARN);
+		if (!pages) {
+			kfree(chunk);
+			count >>= 1;
+			continue;
+		}
+
+		chunk->pfn = page_to_pfn(pages);
+		chunk->count = count;
+		spin_lock(&cma_heap->lock);
+		list_add_tail(&chunk->list, &cma_heap->chunks);
+		cma_heap->reserved += count;
+		spin_unlock(&cma_heap->lock);
+
+		want -= count;
+	}
+}
+
+static void ion_cma_account_latency(struct ion_cma_heap *cma_heap,
+				    ktime_t start)
+{
+	s64 us = ktime_us_delta(ktime_get(), start);
+	int bucket = min_t(int, fls64(us), ION_CMA_LAT_BUCKETS - 1);
+
+	atomic_long_inc(&cma_heap->latency[bucket]);
+}
+
 /* ION CMA heap operations functions */
 static int ion_cma_allocate(struct ion_heap *heap, struct ion_buffer *buffer,
 			    unsigned long len,
 			    unsigned long flags)
 {
 	struct ion_cma_heap *cma_heap = to_cma_heap(heap);
+	unsigned long nr_pages = PAGE_ALIGN(len) >> PAGE_SHIFT;
+	ktime_t start = ktime_get();
 	struct sg_table *table;
 	struct page *pages;
 	int ret;
 
-	pages = cma_alloc(cma_heap->cma, len, 0, GFP_KERNEL);
+	pages = ion_cma_reserve_take(cma_heap, nr_pages);
+	if (pages) {
+		atomic_long_inc(&cma_heap->hits);
+	} else {
+		atomic_long_inc(&cma_heap->misses);
+		pages = cma_alloc(cma_heap->cma, nr_pages, 0, GFP_KERNEL);
+		/* The reserve may be what is in the way */
+		if (!pages && ion_cma_reserve_release(cma_heap, ULONG_MAX))
+			pages = cma_alloc(cma_heap->cma, nr_pages, 0,
+					  GFP_KERNEL);
+	}
+
+	if (READ_ONCE(cma_heap->watermark))
+		queue_work(system_unbound_wq, &cma_heap->refill);
+
 	if (!pages)
 		return -ENOMEM;
+	ion_cma_account_latency(cma_heap, start);
 
 	table = kmalloc(sizeof(*table), GFP_KERNEL);
 	if (!table)
@@ -62,30 +227,103 @@ static int ion_cma_allocate(struct ion_heap *heap, struct ion_buffer *buffer,
 free_mem:
 	kfree(table);
 err:
-	cma_release(cma_heap->cma, pages, buffer->size);
+	cma_release(cma_heap->cma, pages, nr_pages);
 	return -ENOMEM;
 }
 
 static void ion_cma_free(struct ion_buffer *buffer)
 {
 	struct ion_cma_heap *cma_heap = to_cma_heap(buffer->heap);
+	unsigned long nr_pages = PAGE_ALIGN(buffer->size) >> PAGE_SHIFT;
 	struct page *pages = buffer->priv_virt;
 
 	/* release memory */
-	cma_release(cma_heap->cma, pages, buffer->size);
+	cma_release(cma_heap->cma, pages, nr_pages);
 	/* release sg table */
 	sg_free_table(buffer->sg_table);
 	kfree(buffer->sg_table);
 }
 
+static int ion_cma_shrink(struct ion_heap *heap, gfp_t gfp_mask,
+			  int nr_to_scan)
+{
+	struct ion_cma_heap *cma_heap = to_cma_heap(heap);
+
+	if (!nr_to_scan)
+		return READ_ONCE(cma_heap->reserved);
+
+	return ion_cma_reserve_release(cma_heap, nr_to_scan);
+}
+
+static int ion_cma_debug_show(struct ion_heap *heap, struct seq_file *s,
+			      void *unused)
+{
+	struct ion_cma_heap *cma_heap = to_cma_heap(heap);
+	long count;
+	int i;
+
+	seq_printf(s, "reserved %lu watermark %lu pages\n",
+		   READ_ONCE(cma_heap->reserved),
+		   READ_ONCE(cma_heap->watermark));
+	seq_printf(s, "reserve hits %ld misses %ld\n",
+		   atomic_long_read(&cma_heap->hits),
+		   atomic_long_read(&cma_heap->misses));
+
+	seq_puts(s, "allocation latency:\n");
+	for (i = 0; i < ION_CMA_LAT_BUCKETS; i++) {
+		count = atomic_long_read(&cma_heap->latency[i]);
+		if (!count)
+			continue;
+		if (i == ION_CMA_LAT_BUCKETS - 1)
+			seq_printf(s, "  >=%luus %ld\n", 1UL << (i - 1), count);
+		else
+			seq_printf(s, "  <%luus %ld\n", 1UL << i, count);
+	}
+
+	return 0;
+}
+
 static struct ion_heap_ops ion_cma_ops = {
 	.allocate = ion_cma_allocate,
 	.free = ion_cma_free,
 	.map_user = ion_heap_map_user,
 	.map_kernel = ion_heap_map_kernel,
 	.unmap_kernel = ion_heap_unmap_kernel,
+	.shrink = ion_cma_shrink,
 };
 
+static int ion_cma_watermark_get(void *data, u64 *val)
+{
+	struct ion_cma_heap *cma_heap = data;
+
+	*val = (u64)READ_ONCE(cma_heap->watermark) << PAGE_SHIFT;
+	return 0;
+}
+
+static int ion_cma_watermark_set(void *data, u64 val)
+{
+	struct ion_cma_heap *cma_heap = data;
+	unsigned long watermark = PAGE_ALIGN(val) >> PAGE_SHIFT;
+	unsigned long reserved;
+
+	if (watermark > cma_get_size(cma_heap->cma) >> PAGE_SHIFT)
+		return -EINVAL;
+
+	spin_lock(&cma_heap->lock);
+	cma_heap->watermark = watermark;
+	reserved = cma_heap->reserved;
+	spin_unlock(&cma_heap->lock);
+
+	if (reserved > watermark)
+		ion_cma_reserve_release(cma_heap, reserved - watermark);
+	else
+		queue_work(system_unbound_wq, &cma_heap->refill);
+	return 0;
+}
+
+DEFINE_SIMPLE_ATTRIBUTE(ion_cma_watermark_fops, ion_cma_watermark_get,
+			ion_cma_watermark_set, "%llu\n");
+
 static struct ion_heap *__ion_cma_heap_create(struct cma *cma)
 {
 	struct ion_cma_heap *cma_heap;
@@ -96,18 +334,23 @@ static struct ion_heap *__ion_cma_heap_create(struct cma *cma)
 		return ERR_PTR(-ENOMEM);
 
 	cma_heap->heap.ops = &ion_cma_ops;
+	cma_heap->heap.debug_show = ion_cma_debug_show;
 	/*
 	 * get device from private heaps data, later it will be
 	 * used to make the link with reserved CMA memory
 	 */
 	cma_heap->cma = cma;
 	cma_heap->heap.type = ION_HEAP_TYPE_DMA;
+	spin_lock_init(&cma_heap->lock);
+	INIT_LIST_HEAD(&cma_heap->chunks);
+	INIT_WORK(&cma_heap->refill, ion_cma_refill);
 	return &cma_heap->heap;
 }
 
 static int __ion_add_cma_heaps(struct cma *cma, void *data)
 {
 	struct ion_heap *heap;
+	char debug_name[64];
 
 	heap = __ion_cma_heap_create(cma);
 	if (IS_ERR(heap))
@@ -116,6 +359,11 @@ static int __ion_add_cma_heaps(struct cma *cma, void *data)
 	heap->name = cma_get_name(cma);
 
 	ion_device_add_heap(heap);
+
+	/* Bytes of the area to keep evacuated, 0 (the default) disables */
+	snprintf(debug_name, 64, "%s_watermark", heap->name);
+	debugfs_create_file(debug_name, 0644, heap->dev->debug_root,
+			    to_cma_heap(heap), &ion_cma_watermark_fops);
 	return 0;
 }
 
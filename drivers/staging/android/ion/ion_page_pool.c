@@ -17,14 +17,31 @@
 #include <linux/debugfs.h>
 #include <linux/dma-mapping.h>
 #include <linux/err.h>
+#include <linux/freezer.h>
 #include <linux/fs.h>
+#include <linux/kthread.h>
 #include <linux/list.h>
 #include <linux/init.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <uapi/linux/sched/types.h>
+#include <linux/sizes.h>
 #include <linux/slab.h>
 #include <linux/swap.h>
 
 #include "ion.h"
 
+/*
+ * Pages freed to a pool with ion_page_pool_free_dirty() are cleared by a
+ * SCHED_IDLE thread, so allocations normally find zeroed pages without
+ * having to clear them on the allocation or free path.
+ */
+static LIST_HEAD(ion_page_pools);
+static DEFINE_MUTEX(ion_page_pools_lock);
+static DECLARE_WAIT_QUEUE_HEAD(ion_page_pool_zero_wait);
+static atomic_long_t ion_page_pool_dirty = ATOMIC_LONG_INIT(0);
+static struct task_struct *ion_page_pool_zero_task;
+
 static void *ion_page_pool_alloc_pages(struct ion_page_pool *pool)
 {
 	struct page *page = alloc_pages(pool->gfp_mask, pool->order);
@@ -40,9 +57,33 @@ static void ion_page_pool_free_pages(struct ion_page_pool *pool,
 	__free_pages(page, pool->order);
 }
 
-static int ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
+static int ion_page_pool_zero_page(struct ion_page_pool *pool,
+				   struct page *page)
+{
+	pgprot_t pgprot;
+
+	if (pool->cached)
+		pgprot = PAGE_KERNEL;
+	else
+		pgprot = pgprot_writecombine(PAGE_KERNEL);
+
+	return ion_heap_pages_zero(page, PAGE_SIZE << pool->order, pgprot);
+}
+
+static struct page *ion_page_pool_remove_dirty(struct ion_page_pool *pool)
+{
+	struct page *page;
+
+	BUG_ON(!pool->dirty_count);
+	page = list_first_entry(&pool->dirty_items, struct page, lru);
+	list_del(&page->lru);
+	pool->dirty_count--;
+	atomic_long_dec(&ion_page_pool_dirty);
+	return page;
+}
+
+static void __ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
 {
-	mutex_lock(&pool->mutex);
 	if (PageHighMem(page)) {
 		list_add_tail(&page->lru, &pool->high_items);
 		pool->high_count++;
@@ -50,8 +91,17 @@ static int ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
 		list_add_tail(&page->lru, &pool->low_items);
 		pool->low_count++;
 	}
+}
+
+static void ion_page_pool_add(struct ion_page_pool *pool,
+			      struct page **pages, unsigned int nr)
+{
+	unsigned int i;
+
+	mutex_lock(&pool->mutex);
+	for (i = 0; i < nr; i++)
+		__ion_page_pool_add(pool, pages[i]);
 	mutex_unlock(&pool->mutex);
-	return 0;
 }
 
 static struct page *ion_page_pool_remove(struct ion_page_pool *pool, bool high)
@@ -72,39 +122,166 @@ static struct page *ion_page_pool_remove(struct ion_page_pool *pool, bool high)
 	return page;
 }
 
-struct page *ion_page_pool_alloc(struct ion_page_pool *pool)
+/*
+ * Pages move between a per-cpu cache and the pool lists in batches, so
+ * pool->mutex is only taken once every pcp_batch allocations or frees.
+ * The per-cpu lock is only ever contended by the shrinker draining the
+ * caches of other cpus.
+ */
+static unsigned int ion_page_pool_pcp_take(struct ion_page_pool_pcp *pcp,
+					   struct page **pages,
+					   unsigned int nr)
 {
+	unsigned int i;
+
+	nr = min(nr, pcp->count);
+	for (i = 0; i < nr; i++)
+		pages[i] = pcp->pages[--pcp->count];
+	return nr;
+}
+
+static struct page *ion_page_pool_pcp_alloc(struct ion_page_pool *pool)
+{
+	struct page *pages[ION_PAGE_POOL_PCP_PAGES];
+	struct ion_page_pool_pcp *pcp;
 	struct page *page = NULL;
+	unsigned int nr = 0;
 
-	BUG_ON(!pool);
+	pcp = get_cpu_ptr(pool->pcp);
+	spin_lock(&pcp->lock);
+	if (pcp->count)
+		page = pcp->pages[--pcp->count];
+	spin_unlock(&pcp->lock);
+	put_cpu_ptr(pool->pcp);
+	if (page) {
+		atomic_long_inc(&pool->zeroed_hits);
+		return page;
+	}
 
 	mutex_lock(&pool->mutex);
-	if (pool->high_count)
-		page = ion_page_pool_remove(pool, true);
-	else if (pool->low_count)
-		page = ion_page_pool_remove(pool, false);
+	while (nr < pool->pcp_batch) {
+		if (pool->high_count)
+			pages[nr++] = ion_page_pool_remove(pool, true);
+		else if (pool->low_count)
+			pages[nr++] = ion_page_pool_remove(pool, false);
+		else
+			break;
+	}
+	if (!nr && pool->dirty_count)
+		page = ion_page_pool_remove_dirty(pool);
 	mutex_unlock(&pool->mutex);
+	if (!nr) {
+		if (!page)
+			return NULL;
+		/* the zeroing thread is behind, clear this one inline */
+		atomic_long_inc(&pool->zeroed_misses);
+		if (ion_page_pool_zero_page(pool, page)) {
+			ion_page_pool_free_pages(pool, page);
+			return NULL;
+		}
+		return page;
+	}
 
-	if (!page)
+	atomic_long_inc(&pool->zeroed_hits);
+	page = pages[--nr];
+	if (nr) {
+		pcp = get_cpu_ptr(pool->pcp);
+		spin_lock(&pcp->lock);
+		while (nr && pcp->count < pool->pcp_high)
+			pcp->pages[pcp->count++] = pages[--nr];
+		spin_unlock(&pcp->lock);
+		put_cpu_ptr(pool->pcp);
+		if (nr)
+			ion_page_pool_add(pool, pages, nr);
+	}
+	return page;
+}
+
+static void ion_page_pool_pcp_free(struct ion_page_pool *pool,
+				   struct page *page)
+{
+	struct page *pages[ION_PAGE_POOL_PCP_PAGES];
+	struct ion_page_pool_pcp *pcp;
+	unsigned int nr = 0;
+
+	pcp = get_cpu_ptr(pool->pcp);
+	spin_lock(&pcp->lock);
+	if (pcp->count >= pool->pcp_high)
+		nr = ion_page_pool_pcp_take(pcp, pages, pool->pcp_batch);
+	pcp->pages[pcp->count++] = page;
+	spin_unlock(&pcp->lock);
+	put_cpu_ptr(pool->pcp);
+
+	if (nr)
+		ion_page_pool_add(pool, pages, nr);
+}
+
+static void ion_page_pool_pcp_drain(struct ion_page_pool *pool)
+{
+	struct page *pages[ION_PAGE_POOL_PCP_PAGES];
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct ion_page_pool_pcp *pcp = per_cpu_ptr(pool->pcp, cpu);
+		unsigned int nr;
+
+		spin_lock(&pcp->lock);
+		nr = ion_page_pool_pcp_take(pcp, pages,
+					    ION_PAGE_POOL_PCP_PAGES);
+		spin_unlock(&pcp->lock);
+		if (nr)
+			ion_page_pool_add(pool, pages, nr);
+	}
+}
+
+static int ion_page_pool_pcp_count(struct ion_page_pool *pool)
+{
+	int cpu, count = 0;
+
+	for_each_possible_cpu(cpu)
+		count += READ_ONCE(per_cpu_ptr(pool->pcp, cpu)->count);
+	return count;
+}
+
+struct page *ion_page_pool_alloc(struct ion_page_pool *pool)
+{
+	struct page *page;
+
+	BUG_ON(!pool);
+
+	page = ion_page_pool_pcp_alloc(pool);
+	if (!page) {
+		atomic_long_inc(&pool->zeroed_misses);
 		page = ion_page_pool_alloc_pages(pool);
+	}
 
 	return page;
 }
 
+/* @page must already be zeroed */
 void ion_page_pool_free(struct ion_page_pool *pool, struct page *page)
 {
-	int ret;
+	BUG_ON(pool->order != compound_order(page));
+
+	ion_page_pool_pcp_free(pool, page);
+}
 
+void ion_page_pool_free_dirty(struct ion_page_pool *pool, struct page *page)
+{
 	BUG_ON(pool->order != compound_order(page));
 
-	ret = ion_page_pool_add(pool, page);
-	if (ret)
-		ion_page_pool_free_pages(pool, page);
+	mutex_lock(&pool->mutex);
+	list_add_tail(&page->lru, &pool->dirty_items);
+	pool->dirty_count++;
+	mutex_unlock(&pool->mutex);
+	if (atomic_long_inc_return(&ion_page_pool_dirty) == 1)
+		wake_up(&ion_page_pool_zero_wait);
 }
 
 static int ion_page_pool_total(struct ion_page_pool *pool, bool high)
 {
-	int count = pool->low_count;
+	int count = pool->low_count + pool->dirty_count +
+		    ion_page_pool_pcp_count(pool);
 
 	if (high)
 		count += pool->high_count;
@@ -126,11 +303,15 @@ int ion_page_pool_shrink(struct ion_page_pool *pool, gfp_t gfp_mask,
 	if (nr_to_scan == 0)
 		return ion_page_pool_total(pool, high);
 
+	ion_page_pool_pcp_drain(pool);
+
 	while (freed < nr_to_scan) {
 		struct page *page;
 
 		mutex_lock(&pool->mutex);
-		if (pool->low_count) {
+		if (pool->dirty_count) {
+			page = ion_page_pool_remove_dirty(pool);
+		} else if (pool->low_count) {
 			page = ion_page_pool_remove(pool, false);
 		} else if (high && pool->high_count) {
 			page = ion_page_pool_remove(pool, true);
@@ -150,13 +331,33 @@ struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order,
 					   bool cached)
 {
 	struct ion_page_pool *pool = kmalloc(sizeof(*pool), GFP_KERNEL);
+	int cpu;
 
 	if (!pool)
 		return NULL;
+	pool->pcp = alloc_percpu(struct ion_page_pool_pcp);
+	if (!pool->pcp) {
+		kfree(pool);
+		return NULL;
+	}
+	for_each_possible_cpu(cpu) {
+		struct ion_page_pool_pcp *pcp = per_cpu_ptr(pool->pcp, cpu);
+
+		spin_lock_init(&pcp->lock);
+		pcp->count = 0;
+	}
+	/* keep at most 1MB per cpu so large orders don't pin much memory */
+	pool->pcp_high = clamp_t(unsigned int, SZ_1M >> (PAGE_SHIFT + order),
+				 1, ION_PAGE_POOL_PCP_PAGES);
+	pool->pcp_batch = DIV_ROUND_UP(pool->pcp_high, 2);
 	pool->high_count = 0;
 	pool->low_count = 0;
 	INIT_LIST_HEAD(&pool->low_items);
 	INIT_LIST_HEAD(&pool->high_items);
+	pool->dirty_count = 0;
+	INIT_LIST_HEAD(&pool->dirty_items);
+	atomic_long_set(&pool->zeroed_hits, 0);
+	atomic_long_set(&pool->zeroed_misses, 0);
 	pool->gfp_mask = gfp_mask | __GFP_COMP;
 	pool->order = order;
 	mutex_init(&pool->mutex);
@@ -164,16 +365,87 @@ struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order,
 	if (cached)
 		pool->cached = true;
 
+	mutex_lock(&ion_page_pools_lock);
+	list_add_tail(&pool->pools_entry, &ion_page_pools);
+	mutex_unlock(&ion_page_pools_lock);
+
 	return pool;
 }
 
 void ion_page_pool_destroy(struct ion_page_pool *pool)
 {
+	int cpu;
+
+	mutex_lock(&ion_page_pools_lock);
+	list_del(&pool->pools_entry);
+	mutex_unlock(&ion_page_pools_lock);
+
+	while (pool->dirty_count)
+		ion_page_pool_free_pages(pool,
+					 ion_page_pool_remove_dirty(pool));
+
+	for_each_possible_cpu(cpu) {
+		struct ion_page_pool_pcp *pcp = per_cpu_ptr(pool->pcp, cpu);
+
+		while (pcp->count)
+			ion_page_pool_free_pages(pool,
+						 pcp->pages[--pcp->count]);
+	}
+	free_percpu(pool->pcp);
 	kfree(pool);
 }
 
+static void ion_page_pool_zero_dirty(struct ion_page_pool *pool)
+{
+	struct page *page;
+
+	for (;;) {
+		mutex_lock(&pool->mutex);
+		if (!pool->dirty_count) {
+			mutex_unlock(&pool->mutex);
+			break;
+		}
+		page = ion_page_pool_remove_dirty(pool);
+		mutex_unlock(&pool->mutex);
+
+		if (ion_page_pool_zero_page(pool, page))
+			ion_page_pool_free_pages(pool, page);
+		else
+			ion_page_pool_add(pool, &page, 1);
+		cond_resched();
+	}
+}
+
+static int ion_page_pool_zero_thread(void *data)
+{
+	struct ion_page_pool *pool;
+
+	set_freezable();
+	while (true) {
+		wait_event_freezable(ion_page_pool_zero_wait,
+				     atomic_long_read(&ion_page_pool_dirty) > 0);
+
+		mutex_lock(&ion_page_pools_lock);
+		list_for_each_entry(pool, &ion_page_pools, pools_entry)
+			ion_page_pool_zero_dirty(pool);
+		mutex_unlock(&ion_page_pools_lock);
+	}
+
+	return 0;
+}
+
 static int __init ion_page_pool_init(void)
 {
+	struct sched_param param = { .sched_priority = 0 };
+
+	ion_page_pool_zero_task = kthread_run(ion_page_pool_zero_thread, NULL,
+					      "ion_page_zero");
+	if (IS_ERR(ion_page_pool_zero_task)) {
+		pr_err("%s: creating thread for page zeroing failed\n",
+		       __func__);
+		return PTR_ERR(ion_page_pool_zero_task);
+	}
+	sched_setscheduler(ion_page_pool_zero_task, SCHED_IDLE, &param);
 	return 0;
 }
 device_initcall(ion_page_pool_init);
@@ -18,6 +18,7 @@
 #include <linux/dma-mapping.h>
 #include <linux/err.h>
 #include <linux/highmem.h>
+#include <linux/huge_mm.h>
 #include <linux/mm.h>
 #include <linux/scatterlist.h>
 #include <linux/seq_file.h>
@@ -30,7 +31,12 @@
 static gfp_t high_order_gfp_flags = (GFP_HIGHUSER | __GFP_ZERO | __GFP_NOWARN |
 				     __GFP_NORETRY) & ~__GFP_RECLAIM;
 static gfp_t low_order_gfp_flags  = GFP_HIGHUSER | __GFP_ZERO;
-static const unsigned int orders[] = {8, 4, 0};
+static const unsigned int orders[] = {
+#ifdef CONFIG_ION_SYSTEM_HEAP_HUGE
+	HPAGE_PMD_ORDER,
+#endif
+	8, 4, 0
+};
 
 static int order_to_index(unsigned int order)
 {
@@ -52,6 +58,8 @@ struct ion_system_heap {
 	struct ion_heap heap;
 	struct ion_page_pool *uncached_pools[NUM_ORDERS];
 	struct ion_page_pool *cached_pools[NUM_ORDERS];
+	atomic_long_t huge_allocs;
+	atomic_long_t huge_fallbacks;
 };
 
 /**
@@ -78,7 +86,8 @@ static struct page *alloc_buffer_page(struct ion_system_heap *heap,
 }
 
 static void free_buffer_page(struct ion_system_heap *heap,
-			     struct ion_buffer *buffer, struct page *page)
+			     struct ion_buffer *buffer, struct page *page,
+			     bool zeroed)
 {
 	struct ion_page_pool *pool;
 	unsigned int order = compound_order(page);
@@ -95,7 +104,10 @@ static void free_buffer_page(struct ion_system_heap *heap,
 	else
 		pool = heap->cached_pools[order_to_index(order)];
 
-	ion_page_pool_free(pool, page);
+	if (zeroed)
+		ion_page_pool_free(pool, page);
+	else
+		ion_page_pool_free_dirty(pool, page);
 }
 
 static struct page *alloc_largest_available(struct ion_system_heap *heap,
@@ -113,6 +125,9 @@ static struct page *alloc_largest_available(struct ion_system_heap *heap,
 			continue;
 
 		page = alloc_buffer_page(heap, buffer, orders[i]);
+		if (IS_ENABLED(CONFIG_ION_SYSTEM_HEAP_HUGE) && i == 0)
+			atomic_long_inc(page ? &heap->huge_allocs :
+					&heap->huge_fallbacks);
 		if (!page)
 			continue;
 
@@ -141,6 +156,11 @@ static int ion_system_heap_allocate(struct ion_heap *heap,
 	if (size / PAGE_SIZE > totalram_pages / 2)
 		return -ENOMEM;
 
+	/* huge pages are only used when asked for */
+	if (IS_ENABLED(CONFIG_ION_SYSTEM_HEAP_HUGE) &&
+	    !(flags & ION_FLAG_HUGEPAGE))
+		max_order = orders[1];
+
 	INIT_LIST_HEAD(&pages);
 	while (size_remaining > 0) {
 		page = alloc_largest_available(sys_heap, buffer, size_remaining,
@@ -173,7 +193,7 @@ static int ion_system_heap_allocate(struct ion_heap *heap,
 	kfree(table);
 free_pages:
 	list_for_each_entry_safe(page, tmp_page, &pages, lru)
-		free_buffer_page(sys_heap, buffer, page);
+		free_buffer_page(sys_heap, buffer, page, true);
 	return -ENOMEM;
 }
 
@@ -186,12 +206,9 @@ static void ion_system_heap_free(struct ion_buffer *buffer)
 	struct scatterlist *sg;
 	int i;
 
-	/* zero the buffer before goto page pool */
-	if (!(buffer->private_flags & ION_PRIV_FLAG_SHRINKER_FREE))
-		ion_heap_buffer_zero(buffer);
-
+	/* the pools zero pages in the background before reusing them */
 	for_each_sg(table->sgl, sg, table->nents, i)
-		free_buffer_page(sys_heap, buffer, sg_page(sg));
+		free_buffer_page(sys_heap, buffer, sg_page(sg), false);
 	sg_free_table(table);
 	kfree(table);
 }
@@ -252,6 +269,24 @@ static struct ion_heap_ops system_heap_ops = {
 	.shrink = ion_system_heap_shrink,
 };
 
+static void ion_system_heap_pool_show(struct seq_file *s,
+				      struct ion_page_pool *pool,
+				      const char *type)
+{
+	seq_printf(s, "%d order %u highmem pages %s %lu total\n",
+		   pool->high_count, pool->order, type,
+		   (PAGE_SIZE << pool->order) * pool->high_count);
+	seq_printf(s, "%d order %u lowmem pages %s %lu total\n",
+		   pool->low_count, pool->order, type,
+		   (PAGE_SIZE << pool->order) * pool->low_count);
+	seq_printf(s, "%d order %u pages %s waiting for zeroing %lu total\n",
+		   pool->dirty_count, pool->order, type,
+		   (PAGE_SIZE << pool->order) * pool->dirty_count);
+	seq_printf(s, "order %u %s pre-zeroed hits %ld misses %ld\n",
+		   pool->order, type, atomic_long_read(&pool->zeroed_hits),
+		   atomic_long_read(&pool->zeroed_misses));
+}
+
 static int ion_system_heap_debug_show(struct ion_heap *heap, struct seq_file *s,
 				      void *unused)
 {
@@ -259,29 +294,19 @@ static int ion_system_heap_debug_show(struct ion_heap *heap, struct seq_file *s,
 							struct ion_system_heap,
 							heap);
 	int i;
-	struct ion_page_pool *pool;
 
-	for (i = 0; i < NUM_ORDERS; i++) {
-		pool = sys_heap->uncached_pools[i];
-
-		seq_printf(s, "%d order %u highmem pages uncached %lu total\n",
-			   pool->high_count, pool->order,
-			   (PAGE_SIZE << pool->order) * pool->high_count);
-		seq_printf(s, "%d order %u lowmem pages uncached %lu total\n",
-			   pool->low_count, pool->order,
-			   (PAGE_SIZE << pool->order) * pool->low_count);
-	}
+	for (i = 0; i < NUM_ORDERS; i++)
+		ion_system_heap_pool_show(s, sys_heap->uncached_pools[i],
+					  "uncached");
 
-	for (i = 0; i < NUM_ORDERS; i++) {
-		pool = sys_heap->cached_pools[i];
-
-		seq_printf(s, "%d order %u highmem pages cached %lu total\n",
-			   pool->high_count, pool->order,
-			   (PAGE_SIZE << pool->order) * pool->high_count);
-		seq_printf(s, "%d order %u lowmem pages cached %lu total\n",
-			   pool->low_count, pool->order,
-			   (PAGE_SIZE << pool->order) * pool->low_count);
-	}
+	for (i = 0; i < NUM_ORDERS; i++)
+		ion_system_heap_pool_show(s, sys_heap->cached_pools[i],
+					  "cached");
+
+	if (IS_ENABLED(CONFIG_ION_SYSTEM_HEAP_HUGE))
+		seq_printf(s, "huge pages allocated %ld fallbacks %ld\n",
+			   atomic_long_read(&sys_heap->huge_allocs),
+			   atomic_long_read(&sys_heap->huge_fallbacks));
 	return 0;
 }
 
@@ -42,6 +42,19 @@
 #include <linux/rcupdate.h>
 #include <linux/profile.h>
 #include <linux/notifier.h>
+#include <linux/debugfs.h>
+#include <linux/delayacct.h>
+#include <linux/freezer.h>
+#include <linux/hashtable.h>
+#include <linux/kthread.h>
+#include <linux/sched/coredump.h>
+#include <linux/sched/mm.h>
+#include <linux/sched/task.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/ktime.h>
+#include <linux/percpu.h>
+#include <linux/spinlock.h>
 
 #define CREATE_TRACE_POINTS
 #include "trace/lowmemorykiller.h"
@@ -72,6 +85,637 @@ static unsigned long lowmem_deathpending_timeout;
 			pr_info(x);			\
 	} while (0)
 
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER_MEMSTALL
+/*
+ * In memstall mode, kills are driven by how much CPU time tasks spend
+ * stalled in direct reclaim rather than by minfree. The stall is sampled
+ * from the delay accounting start stamp each time a direct reclaimer
+ * calls into lowmem_scan, and accumulated per cpu. Once the stall share
+ * (or the number of workingset refaults) stays above its threshold for a
+ * whole window, the adj levels are walked down from the last one, one
+ * level per multiple of the threshold.
+ */
+static bool lowmem_memstall;
+static unsigned int lowmem_memstall_threshold = 10;	/* percent */
+static unsigned int lowmem_memstall_window_ms = 1000;
+static unsigned long lowmem_memstall_refaults;		/* 0: disabled */
+
+/* statistics, read only */
+static unsigned long lowmem_memstall_kills;
+static unsigned int lowmem_memstall_pressure;
+static unsigned long lowmem_memstall_kill_latency_ms;
+
+struct lowmem_stall_cpu {
+	u64 stall_ns;
+	struct task_struct *task;
+	u64 seen_ns;
+};
+
+static DEFINE_PER_CPU(struct lowmem_stall_cpu, lowmem_stall_cpu);
+
+/* protects the window state below */
+static DEFINE_SPINLOCK(lowmem_memstall_lock);
+static u64 lowmem_window_start;
+static u64 lowmem_window_stall;
+static unsigned long lowmem_window_refault;
+static unsigned long lowmem_window_refaults;
+static u64 lowmem_pressure_since;
+
+static void lowmem_memstall_account(void)
+{
+	struct lowmem_stall_cpu *sc;
+	u64 now, start;
+
+	if (current_is_kswapd() || !(current->flags & PF_MEMALLOC) ||
+	    !current->delays)
+		return;
+
+	now = ktime_get_ns();
+	start = READ_ONCE(current->delays->freepages_start);
+	if (!start || start > now)
+		return;
+
+	/*
+	 * Only the time since this task was last seen on this cpu is added,
+	 * so a reclaimer that calls in repeatedly is not counted twice. A
+	 * reclaimer migrating in the middle of a stall may be.
+	 */
+	sc = get_cpu_ptr(&lowmem_stall_cpu);
+	if (sc->task != current || sc->seen_ns < start)
+		sc->seen_ns = start;
+	sc->stall_ns += now - sc->seen_ns;
+	sc->task = current;
+	sc->seen_ns = now;
+	put_cpu_ptr(&lowmem_stall_cpu);
+}
+
+static u64 lowmem_memstall_total(void)
+{
+	u64 total = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		total += READ_ONCE(per_cpu(lowmem_stall_cpu, cpu).stall_ns);
+	return total;
+}
+
+/*
+ * Returns the minimum oom_score_adj to kill at, or OOM_SCORE_ADJ_MAX + 1
+ * if there has not been a full window of pressure yet.
+ */
+static short lowmem_memstall_min_adj(int array_size)
+{
+	u64 now = ktime_get_ns();
+	u64 window = (u64)lowmem_memstall_window_ms * NSEC_PER_MSEC;
+	unsigned int levels;
+	int idx;
+
+	spin_lock(&lowmem_memstall_lock);
+	if (now - lowmem_window_start >= window) {
+		u64 total = lowmem_memstall_total();
+		unsigned long refault =
+			global_node_page_state(WORKINGSET_REFAULT);
+		u64 elapsed = (now - lowmem_window_start) * num_online_cpus();
+		bool over;
+
+		lowmem_memstall_pressure =
+			div64_u64((total - lowmem_window_stall) * 100, elapsed);
+		lowmem_window_refaults = refault - lowmem_window_refault;
+		over = lowmem_memstall_pressure >= lowmem_memstall_threshold ||
+		       (lowmem_memstall_refaults &&
+			lowmem_window_refaults >= lowmem_memstall_refaults);
+		if (!over)
+			lowmem_pressure_since = 0;
+		else if (!lowmem_pressure_since)
+			lowmem_pressure_since = lowmem_window_start;
+
+		lowmem_window_start = now;
+		lowmem_window_stall = total;
+		lowmem_window_refault = refault;
+	}
+	levels = lowmem_memstall_pressure /
+		 max(lowmem_memstall_threshold, 1U);
+	spin_unlock(&lowmem_memstall_lock);
+
+	if (!lowmem_pressure_since || array_size <= 0)
+		return OOM_SCORE_ADJ_MAX + 1;
+
+	idx = array_size - max(levels, 1U);
+	return lowmem_adj[max(idx, 0)];
+}
+
+static void lowmem_memstall_killed(struct task_struct *selected)
+{
+	u64 latency;
+
+	spin_lock(&lowmem_memstall_lock);
+	latency = ktime_get_ns() - lowmem_pressure_since;
+	/* the next kill needs another full window of pressure */
+	lowmem_pressure_since = 0;
+	lowmem_window_start = ktime_get_ns();
+	lowmem_window_stall = lowmem_memstall_total();
+	lowmem_window_refault = global_node_page_state(WORKINGSET_REFAULT);
+	lowmem_memstall_kills++;
+	lowmem_memstall_kill_latency_ms = div_u64(latency, NSEC_PER_MSEC);
+	spin_unlock(&lowmem_memstall_lock);
+
+	trace_lowmemory_memstall_kill(selected, lowmem_memstall_pressure,
+				      lowmem_window_refaults, latency);
+}
+#else
+static const bool lowmem_memstall;
+
+static inline void lowmem_memstall_account(void)
+{
+}
+
+static inline short lowmem_memstall_min_adj(int array_size)
+{
+	return OOM_SCORE_ADJ_MAX + 1;
+}
+
+static inline void lowmem_memstall_killed(struct task_struct *selected)
+{
+}
+#endif
+
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER_TASK_INDEX
+/*
+ * Processes are indexed by the oom_score_adj last written through /proc,
+ * in buckets of 16 adj values. A bitmap of non-empty buckets lets the
+ * killer go straight to the highest one. Entries hold a reference on the
+ * process' tgid pid and are dropped when the process exits or is found
+ * dead. Negative adj values are never killed and not indexed.
+ */
+#define LOWMEM_INDEX_SHIFT	4
+#define LOWMEM_INDEX_BUCKETS	((OOM_SCORE_ADJ_MAX >> LOWMEM_INDEX_SHIFT) + 1)
+
+struct lowmem_task_entry {
+	struct list_head node;
+	struct hlist_node hnode;
+	struct pid *pid;
+	short adj;
+	unsigned long rss;
+};
+
+static DEFINE_SPINLOCK(lowmem_index_lock);
+static DEFINE_HASHTABLE(lowmem_index_hash, 8);
+static struct list_head lowmem_index[LOWMEM_INDEX_BUCKETS];
+static DECLARE_BITMAP(lowmem_index_map, LOWMEM_INDEX_BUCKETS);
+static struct pid *lowmem_last_victim;
+
+static struct lowmem_task_entry *lowmem_index_find(struct pid *pid)
+{
+	struct lowmem_task_entry *e;
+
+	hash_for_each_possible(lowmem_index_hash, e, hnode, (unsigned long)pid)
+		if (e->pid == pid)
+			return e;
+	return NULL;
+}
+
+static void lowmem_index_unlink(struct lowmem_task_entry *e)
+{
+	int b = e->adj >> LOWMEM_INDEX_SHIFT;
+
+	list_del(&e->node);
+	if (list_empty(&lowmem_index[b]))
+		clear_bit(b, lowmem_index_map);
+}
+
+static void lowmem_index_link(struct lowmem_task_entry *e, short adj)
+{
+	int b = adj >> LOWMEM_INDEX_SHIFT;
+
+	e->adj = adj;
+	list_add_tail(&e->node, &lowmem_index[b]);
+	set_bit(b, lowmem_index_map);
+}
+
+/* called with lowmem_index_lock held, the entry is freed by the caller */
+static void lowmem_index_remove(struct lowmem_task_entry *e)
+{
+	lowmem_index_unlink(e);
+	hash_del(&e->hnode);
+}
+
+static void lowmem_index_free(struct lowmem_task_entry *e)
+{
+	put_pid(e->pid);
+	kfree(e);
+}
+
+/*
+ * lowmem_oom_score_adj_update() - Reindex a process after an adj write
+ * @task:	A task of the process whose oom_score_adj was just set
+ *
+ * Called from __set_oom_adj() with oom_adj_mutex held, may sleep.
+ */
+void lowmem_oom_score_adj_update(struct task_struct *task)
+{
+	struct lowmem_task_entry *e, *new, *old = NULL;
+	short adj = task->signal->oom_score_adj;
+	struct task_struct *p;
+	unsigned long rss = 0;
+	struct pid *pid;
+
+	new = adj >= 0 ? kzalloc(sizeof(*new), GFP_KERNEL) : NULL;
+	p = find_lock_task_mm(task);
+	if (p) {
+		rss = get_mm_rss(p->mm);
+		task_unlock(p);
+	}
+
+	rcu_read_lock();
+	pid = task_tgid(task);
+	spin_lock(&lowmem_index_lock);
+	e = lowmem_index_find(pid);
+	if (adj < 0 || (!e && !new)) {
+		if (e)
+			lowmem_index_remove(e);
+		old = e;
+	} else {
+		if (e) {
+			lowmem_index_unlink(e);
+		} else {
+			e = new;
+			new = NULL;
+			e->pid = get_pid(pid);
+			hash_add(lowmem_index_hash, &e->hnode, (unsigned long)pid);
+		}
+		e->rss = rss;
+		lowmem_index_link(e, adj);
+	}
+	spin_unlock(&lowmem_index_lock);
+	rcu_read_unlock();
+
+	kfree(new);
+	if (old)
+		lowmem_index_free(old);
+}
+
+static int lowmem_task_exit(struct notifier_block *nb, unsigned long val,
+			    void *data)
+{
+	struct task_struct *task = data;
+	struct lowmem_task_entry *e;
+
+	/* only the last thread of the process takes it off the index */
+	if (get_nr_threads(task) > 1)
+		return NOTIFY_DONE;
+
+	spin_lock(&lowmem_index_lock);
+	e = lowmem_index_find(task_tgid(task));
+	if (e)
+		lowmem_index_remove(e);
+	spin_unlock(&lowmem_index_lock);
+	if (e)
+		lowmem_index_free(e);
+	return NOTIFY_OK;
+}
+
+static struct notifier_block lowmem_task_nb = {
+	.notifier_call = lowmem_task_exit,
+};
+
+/*
+ * lowmem_index_select() - Pick a victim from the highest indexed bucket
+ *
+ * Called under rcu_read_lock(). Returns -EBUSY if the previous victim is
+ * still dying, otherwise 0 with *@selected set to the victim or NULL if
+ * the index has no process at or above @min_score_adj.
+ */
+static int lowmem_index_select(short min_score_adj,
+			       struct task_struct **selected,
+			       int *selected_tasksize,
+			       short *selected_oom_score_adj)
+{
+	struct lowmem_task_entry *e, *tmp, *best;
+	struct task_struct *tsk, *p;
+	LIST_HEAD(dead);
+	int b, end, min_b;
+
+	*selected = NULL;
+	if (min_score_adj < 0)
+		return 0;
+
+	spin_lock(&lowmem_index_lock);
+	if (lowmem_last_victim) {
+		tsk = pid_task(lowmem_last_victim, PIDTYPE_PID);
+		if (tsk && task_lmk_waiting(tsk) &&
+		    time_before_eq(jiffies, lowmem_deathpending_timeout)) {
+			spin_unlock(&lowmem_index_lock);
+			return -EBUSY;
+		}
+	}
+
+	min_b = min_score_adj >> LOWMEM_INDEX_SHIFT;
+retry:
+	for (end = LOWMEM_INDEX_BUCKETS;
+	     (b = find_last_bit(lowmem_index_map, end)) < end && b >= min_b;
+	     end = b) {
+		best = NULL;
+		list_for_each_entry_safe(e, tmp, &lowmem_index[b], node) {
+			tsk = pid_task(e->pid, PIDTYPE_PID);
+			if (!tsk) {
+				lowmem_index_remove(e);
+				list_add(&e->node, &dead);
+				continue;
+			}
+			/* adj may have been changed through a shared mm */
+			if (tsk->signal->oom_score_adj != e->adj) {
+				lowmem_index_unlink(e);
+				if (tsk->signal->oom_score_adj < 0) {
+					hash_del(&e->hnode);
+					list_add(&e->node, &dead);
+				} else {
+					lowmem_index_link(e,
+						tsk->signal->oom_score_adj);
+				}
+				goto retry;
+			}
+			if (e->adj < min_score_adj)
+				continue;
+			if (best && (e->adj < best->adj ||
+				     (e->adj == best->adj &&
+				      e->rss <= best->rss)))
+				continue;
+			best = e;
+		}
+		if (!best)
+			continue;
+
+		/* refresh the cached rss of the one we are about to kill */
+		tsk = pid_task(best->pid, PIDTYPE_PID);
+		p = find_lock_task_mm(tsk);
+		if (!p) {
+			lowmem_index_remove(best);
+			list_add(&best->node, &dead);
+			goto retry;
+		}
+		best->rss = get_mm_rss(p->mm);
+		task_unlock(p);
+		if (!best->rss)
+			continue;
+
+		*selected = p;
+		*selected_tasksize = best->rss;
+		*selected_oom_score_adj = best->adj;
+		put_pid(lowmem_last_victim);
+		lowmem_last_victim = get_pid(best->pid);
+		break;
+	}
+	spin_unlock(&lowmem_index_lock);
+
+	list_for_each_entry_safe(e, tmp, &dead, node)
+		lowmem_index_free(e);
+	return 0;
+}
+
+static void __init lowmem_index_init(void)
+{
+	int i;
+
+	for (i = 0; i < LOWMEM_INDEX_BUCKETS; i++)
+		INIT_LIST_HEAD(&lowmem_index[i]);
+	profile_event_register(PROFILE_TASK_EXIT, &lowmem_task_nb);
+}
+#else
+static inline int lowmem_index_select(short min_score_adj,
+				      struct task_struct **selected,
+				      int *selected_tasksize,
+				      short *selected_oom_score_adj)
+{
+	*selected = NULL;
+	return 0;
+}
+
+static inline void lowmem_index_init(void)
+{
+}
+#endif
+
+/*
+ * A killed process only frees its memory once it gets through its exit
+ * path, which can take long if it is stuck in D state. Like the OOM
+ * reaper, the lmk reaper unmaps the private memory of each victim right
+ * away. Reap latency (kill to memory released) is kept for the last
+ * LOWMEM_REAP_HISTORY kills and shown in debugfs.
+ */
+#define LOWMEM_REAP_QUEUE	8
+#define LOWMEM_REAP_HISTORY	16
+#define LOWMEM_REAP_RETRIES	10
+
+static bool lowmem_reap = true;
+
+struct lowmem_reap_req {
+	struct task_struct *tsk;
+	unsigned long rss;
+	u64 killed_ns;
+};
+
+struct lowmem_reap_stat {
+	pid_t pid;
+	char comm[TASK_COMM_LEN];
+	unsigned long rss;
+	unsigned long reaped;
+	u64 latency_ns;
+};
+
+static DEFINE_SPINLOCK(lowmem_reap_lock);
+static DECLARE_WAIT_QUEUE_HEAD(lowmem_reap_wait);
+static struct task_struct *lowmem_reaper;
+static struct lowmem_reap_req lowmem_reap_queue[LOWMEM_REAP_QUEUE];
+static unsigned int lowmem_reap_head, lowmem_reap_tail;
+static struct lowmem_reap_stat lowmem_reap_history[LOWMEM_REAP_HISTORY];
+static unsigned int lowmem_reap_next;
+static unsigned long lowmem_reap_done, lowmem_reap_failed;
+static unsigned long lowmem_reap_skipped;
+static u64 lowmem_reap_max_ns, lowmem_reap_total_ns;
+
+/* called with rcu_read_lock() held right after @tsk was sent SIGKILL */
+static void lowmem_queue_reap(struct task_struct *tsk, unsigned long rss)
+{
+	struct lowmem_reap_req *req;
+
+	if (!lowmem_reap || !lowmem_reaper)
+		return;
+
+	spin_lock(&lowmem_reap_lock);
+	if (lowmem_reap_head - lowmem_reap_tail >= LOWMEM_REAP_QUEUE) {
+		lowmem_reap_skipped++;
+		spin_unlock(&lowmem_reap_lock);
+		return;
+	}
+	req = &lowmem_reap_queue[lowmem_reap_head++ % LOWMEM_REAP_QUEUE];
+	get_task_struct(tsk);
+	req->tsk = tsk;
+	req->rss = rss;
+	req->killed_ns = ktime_get_ns();
+	spin_unlock(&lowmem_reap_lock);
+	wake_up(&lowmem_reap_wait);
+}
+
+/* returns the number of pages released, or -EAGAIN to retry later */
+static long lowmem_reap_mm(struct mm_struct *mm, int nr_threads)
+{
+	struct vm_area_struct *vma;
+	unsigned long before;
+
+	if (!down_read_trylock(&mm->mmap_sem))
+		return -EAGAIN;
+
+	/*
+	 * Don't touch an mm that someone other than the dying threads holds,
+	 * it may be shared with a process that was not killed.
+	 */
+	if (atomic_read(&mm->mm_users) > nr_threads + 1) {
+		up_read(&mm->mmap_sem);
+		return 0;
+	}
+
+	set_bit(MMF_UNSTABLE, &mm->flags);
+	before = get_mm_rss(mm);
+	for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		if (vma->vm_flags & (VM_LOCKED | VM_HUGETLB | VM_PFNMAP))
+			continue;
+		/* only private memory is freed by unmapping it */
+		if (vma_is_anonymous(vma) || !(vma->vm_flags & VM_SHARED))
+			zap_page_range(vma, vma->vm_start,
+				       vma->vm_end - vma->vm_start);
+	}
+	up_read(&mm->mmap_sem);
+
+	return before - min(before, get_mm_rss(mm));
+}
+
+static void lowmem_reap_task(struct lowmem_reap_req *req)
+{
+	struct task_struct *tsk = req->tsk;
+	struct lowmem_reap_stat *stat;
+	struct mm_struct *mm = NULL;
+	struct task_struct *p;
+	long reaped = 0;
+	int attempts;
+
+	p = find_lock_task_mm(tsk);
+	if (p) {
+		mm = p->mm;
+		if (!mmget_not_zero(mm))
+			mm = NULL;
+		task_unlock(p);
+	}
+
+	if (mm) {
+		for (attempts = 0; attempts < LOWMEM_REAP_RETRIES; attempts++) {
+			reaped = lowmem_reap_mm(mm, get_nr_threads(tsk));
+			if (reaped != -EAGAIN)
+				break;
+			schedule_timeout_idle(HZ / 10);
+		}
+		/* the victim may be the last user, don't do its exit work */
+		mmput_async(mm);
+	}
+
+	spin_lock(&lowmem_reap_lock);
+	if (reaped < 0) {
+		lowmem_reap_failed++;
+		reaped = 0;
+	} else {
+		u64 latency = ktime_get_ns() - req->killed_ns;
+
+		stat = &lowmem_reap_history[lowmem_reap_next++ %
+					    LOWMEM_REAP_HISTORY];
+		stat->pid = tsk->pid;
+		memcpy(stat->comm, tsk->comm, TASK_COMM_LEN);
+		stat->rss = req->rss;
+		stat->reaped = reaped;
+		stat->latency_ns = latency;
+		lowmem_reap_done++;
+		lowmem_reap_total_ns += latency;
+		lowmem_reap_max_ns = max(lowmem_reap_max_ns, latency);
+	}
+	spin_unlock(&lowmem_reap_lock);
+
+	lowmem_print(2, "reaped '%s' (%d), %ldkB released\n", tsk->comm,
+		     tsk->pid, reaped * (long)(PAGE_SIZE / 1024));
+	put_task_struct(tsk);
+}
+
+static int lowmem_reaper_fn(void *unused)
+{
+	struct lowmem_reap_req req;
+
+	set_freezable();
+	while (true) {
+		wait_event_freezable(lowmem_reap_wait,
+				     READ_ONCE(lowmem_reap_head) !=
+				     READ_ONCE(lowmem_reap_tail));
+
+		spin_lock(&lowmem_reap_lock);
+		req = lowmem_reap_queue[lowmem_reap_tail++ % LOWMEM_REAP_QUEUE];
+		spin_unlock(&lowmem_reap_lock);
+		lowmem_reap_task(&req);
+	}
+
+	return 0;
+}
+
+static int lowmem_reap_stats_show(struct seq_file *m, void *unused)
+{
+	unsigned int i, n;
+
+	spin_lock(&lowmem_reap_lock);
+	seq_printf(m, "reaped %lu failed %lu skipped %lu\n",
+		   lowmem_reap_done, lowmem_reap_failed, lowmem_reap_skipped);
+	seq_printf(m, "latency max %llu us avg %llu us\n",
+		   div_u64(lowmem_reap_max_ns, NSEC_PER_USEC),
+		   lowmem_reap_done ?
+		   div64_u64(lowmem_reap_total_ns,
+			     lowmem_reap_done * NSEC_PER_USEC) : 0);
+	n = min_t(unsigned int, lowmem_reap_next, LOWMEM_REAP_HISTORY);
+	for (i = 0; i < n; i++) {
+		struct lowmem_reap_stat *stat = &lowmem_reap_history[
+			(lowmem_reap_next - n + i) % LOWMEM_REAP_HISTORY];
+
+		seq_printf(m, "%d %s rss %lukB reaped %lukB in %llu us\n",
+			   stat->pid, stat->comm,
+			   stat->rss * (PAGE_SIZE / 1024),
+			   stat->reaped * (PAGE_SIZE / 1024),
+			   div_u64(stat->latency_ns, NSEC_PER_USEC));
+	}
+	spin_unlock(&lowmem_reap_lock);
+	return 0;
+}
+
+static int lowmem_reap_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lowmem_reap_stats_show, NULL);
+}
+
+static const struct file_operations lowmem_reap_stats_fops = {
+	.open = lowmem_reap_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void __init lowmem_reaper_init(void)
+{
+	struct dentry *dir;
+
+	lowmem_reaper = kthread_run(lowmem_reaper_fn, NULL, "lmk_reaper");
+	if (IS_ERR(lowmem_reaper)) {
+		pr_err("failed to start reaper thread\n");
+		lowmem_reaper = NULL;
+		return;
+	}
+
+	dir = debugfs_create_dir("lowmemorykiller", NULL);
+	debugfs_create_file("reap_stats", 0444, dir, NULL,
+			    &lowmem_reap_stats_fops);
+}
+
 static unsigned long lowmem_count(struct shrinker *s,
 				  struct shrink_control *sc)
 {
@@ -103,11 +747,16 @@ static unsigned long lowmem_scan(struct shrinker *s, struct shrink_control *sc)
 		array_size = lowmem_adj_size;
 	if (lowmem_minfree_size < array_size)
 		array_size = lowmem_minfree_size;
-	for (i = 0; i < array_size; i++) {
-		minfree = lowmem_minfree[i];
-		if (other_free < minfree && other_file < minfree) {
-			min_score_adj = lowmem_adj[i];
-			break;
+	lowmem_memstall_account();
+	if (lowmem_memstall) {
+		min_score_adj = lowmem_memstall_min_adj(array_size);
+	} else {
+		for (i = 0; i < array_size; i++) {
+			minfree = lowmem_minfree[i];
+			if (other_free < minfree && other_file < minfree) {
+				min_score_adj = lowmem_adj[i];
+				break;
+			}
 		}
 	}
 
@@ -124,6 +773,15 @@ static unsigned long lowmem_scan(struct shrinker *s, struct shrink_control *sc)
 	selected_oom_score_adj = min_score_adj;
 
 	rcu_read_lock();
+	if (lowmem_index_select(min_score_adj, &selected, &selected_tasksize,
+				&selected_oom_score_adj)) {
+		rcu_read_unlock();
+		return 0;
+	}
+	/* fall back to walking every process if the index has no victim */
+	if (selected)
+		goto kill;
+
 	for_each_process(tsk) {
 		struct task_struct *p;
 		short oom_score_adj;
@@ -163,6 +821,7 @@ static unsigned long lowmem_scan(struct shrinker *s, struct shrink_control *sc)
 		lowmem_print(2, "select '%s' (%d), adj %hd, size %d, to kill\n",
 			     p->comm, p->pid, oom_score_adj, tasksize);
 	}
+kill:
 	if (selected) {
 		long cache_size = other_file * (long)(PAGE_SIZE / 1024);
 		long cache_limit = minfree * (long)(PAGE_SIZE / 1024);
@@ -173,7 +832,10 @@ static unsigned long lowmem_scan(struct shrinker *s, struct shrink_control *sc)
 		if (selected->mm)
 			task_set_lmk_waiting(selected);
 		task_unlock(selected);
+		lowmem_queue_reap(selected, selected_tasksize);
 		trace_lowmemory_kill(selected, cache_size, cache_limit, free);
+		if (lowmem_memstall)
+			lowmem_memstall_killed(selected);
 		lowmem_print(1, "Killing '%s' (%d) (tgid %d), adj %hd,\n"
 				 "   to free %ldkB on behalf of '%s' (%d) because\n"
 				 "   cache %ldkB is below limit %ldkB for oom_score_adj %hd\n"
@@ -203,6 +865,8 @@ static struct shrinker lowmem_shrinker = {
 
 static int __init lowmem_init(void)
 {
+	lowmem_index_init();
+	lowmem_reaper_init();
 	register_shrinker(&lowmem_shrinker);
 	return 0;
 }
@@ -301,4 +965,15 @@ module_param_array_named(adj, lowmem_adj, short, &lowmem_adj_size, 0644);
 module_param_array_named(minfree, lowmem_minfree, uint, &lowmem_minfree_size,
 			 0644);
 module_param_named(debug_level, lowmem_debug_level, uint, 0644);
+module_param_named(reap, lowmem_reap, bool, 0644);
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER_MEMSTALL
+module_param_named(memstall, lowmem_memstall, bool, 0644);
+module_param_named(memstall_threshold, lowmem_memstall_threshold, uint, 0644);
+module_param_named(memstall_window_ms, lowmem_memstall_window_ms, uint, 0644);
+module_param_named(memstall_refaults, lowmem_memstall_refaults, ulong, 0644);
+module_param_named(memstall_kills, lowmem_memstall_kills, ulong, 0444);
+module_param_named(memstall_pressure, lowmem_memstall_pressure, uint, 0444);
+module_param_named(memstall_kill_latency_ms, lowmem_memstall_kill_latency_ms,
+		   ulong, 0444);
+#endif
 
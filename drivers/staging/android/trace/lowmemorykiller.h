@@ -34,6 +34,32 @@ TRACE_EVENT(lowmemory_kill,
 		__entry->pagecache_limit, __entry->free)
 );
 
+TRACE_EVENT(lowmemory_memstall_kill,
+	TP_PROTO(struct task_struct *killed_task, unsigned int pressure,
+		 unsigned long refaults, u64 latency_ns),
+
+	TP_ARGS(killed_task, pressure, refaults, latency_ns),
+
+	TP_STRUCT__entry(
+			__array(char, comm, TASK_COMM_LEN)
+			__field(pid_t, pid)
+			__field(unsigned int, pressure)
+			__field(unsigned long, refaults)
+			__field(u64, latency_ns)
+	),
+
+	TP_fast_assign(
+			memcpy(__entry->comm, killed_task->comm, TASK_COMM_LEN);
+			__entry->pid = killed_task->pid;
+			__entry->pressure = pressure;
+			__entry->refaults = refaults;
+			__entry->latency_ns = latency_ns;
+	),
+
+	TP_printk("%s (%d), stall %u%%, refaults %lu, %llu us after pressure onset",
+		__entry->comm, __entry->pid, __entry->pressure,
+		__entry->refaults, __entry->latency_ns / NSEC_PER_USEC)
+);
 
 #endif /* if !defined(_TRACE_LOWMEMORYKILLER_H) || defined(TRACE_HEADER_MULTI_READ) */
 
@@ -57,6 +57,12 @@ enum ion_heap_type {
  */
 #define ION_FLAG_CACHED 1
 
+/*
+ * system heap: back buffers of 2MB and larger with huge pages where
+ * possible, only honoured with CONFIG_ION_SYSTEM_HEAP_HUGE
+ */
+#define ION_FLAG_HUGEPAGE (1 << 16)
+
 /**
  * DOC: Ion Userspace API
  *
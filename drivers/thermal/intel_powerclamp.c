@@ -662,6 +662,91 @@ static int powerclamp_set_cur_state(struct thermal_cooling_device *cdev,
 	return ret;
 }
 
+/*
+ * Power model for the power allocator governor, from the RAPL package
+ * energy counter.  Injected idle is spent in a package C-state, which
+ * draws next to nothing compared to the busy time, so the package would
+ * draw the measured power scaled by 100 / (100 - target ratio) if it
+ * was not clamped, and each percent of idle injected takes away one
+ * percent of that.
+ */
+static DEFINE_MUTEX(pkg_power_lock);
+static unsigned int rapl_energy_shift;
+static u32 pkg_energy_last;
+static u64 pkg_energy_time_last;
+static u32 pkg_power_full; /* estimated unclamped package power, in mW */
+
+static int powerclamp_get_requested_power(struct thermal_cooling_device *cdev,
+					  struct thermal_zone_device *tz,
+					  u32 *power)
+{
+	u64 val, now, energy_uj, delta_ns;
+	u32 energy;
+	unsigned int ratio;
+	int ret = 0;
+
+	if (rdmsrl_safe(MSR_PKG_ENERGY_STATUS, &val))
+		return -EIO;
+
+	mutex_lock(&pkg_power_lock);
+
+	energy = val;
+	now = ktime_get_ns();
+	delta_ns = now - pkg_energy_time_last;
+
+	/* Keep the last estimate if called again within the same period */
+	if (pkg_energy_time_last && delta_ns < NSEC_PER_MSEC)
+		goto out;
+
+	if (pkg_energy_time_last) {
+		/* The counter is 32 bit wide and wraps around */
+		energy_uj = ((u64)(energy - pkg_energy_last) * USEC_PER_SEC) >>
+				rapl_energy_shift;
+		val = div64_u64(energy_uj * NSEC_PER_USEC, delta_ns);
+
+		ratio = clamping ? set_target_ratio : 0;
+		pkg_power_full = div_u64(val * 100, 100 - ratio);
+	}
+
+	pkg_energy_last = energy;
+	pkg_energy_time_last = now;
+
+out:
+	if (!pkg_power_full)
+		ret = -EAGAIN;
+	*power = pkg_power_full;
+
+	mutex_unlock(&pkg_power_lock);
+
+	return ret;
+}
+
+static int powerclamp_state2power(struct thermal_cooling_device *cdev,
+				  struct thermal_zone_device *tz,
+				  unsigned long state, u32 *power)
+{
+	state = min_t(unsigned long, state, MAX_TARGET_RATIO - 1);
+
+	*power = READ_ONCE(pkg_power_full) * (100 - state) / 100;
+
+	return 0;
+}
+
+static int powerclamp_power2state(struct thermal_cooling_device *cdev,
+				  struct thermal_zone_device *tz,
+				  u32 power, unsigned long *state)
+{
+	u32 full = READ_ONCE(pkg_power_full);
+
+	if (!full || power >= full)
+		*state = 0;
+	else
+		*state = min_t(unsigned long, 100 - (u64)power * 100 / full,
+			       MAX_TARGET_RATIO - 1);
+
+	return 0;
+}
+
 /* bind to generic thermal layer as cooling device*/
 static struct thermal_cooling_device_ops powerclamp_cooling_ops = {
 	.get_max_state = powerclamp_get_max_state,
@@ -669,6 +754,24 @@ static struct thermal_cooling_device_ops powerclamp_cooling_ops = {
 	.set_cur_state = powerclamp_set_cur_state,
 };
 
+/* Only a power actor when the package energy can be measured */
+static void __init powerclamp_probe_power_model(void)
+{
+	u64 val;
+
+	if (rdmsrl_safe(MSR_RAPL_POWER_UNIT, &val) ||
+	    rdmsrl_safe(MSR_PKG_ENERGY_STATUS, &val))
+		return;
+
+	rdmsrl(MSR_RAPL_POWER_UNIT, val);
+	rapl_energy_shift = (val >> 8) & 0x1f;
+
+	powerclamp_cooling_ops.get_requested_power =
+					powerclamp_get_requested_power;
+	powerclamp_cooling_ops.state2power = powerclamp_state2power;
+	powerclamp_cooling_ops.power2state = powerclamp_power2state;
+}
+
 static const struct x86_cpu_id __initconst intel_powerclamp_ids[] = {
 	{ X86_VENDOR_INTEL, X86_FAMILY_ANY, X86_MODEL_ANY, X86_FEATURE_MWAIT },
 	{}
@@ -692,6 +795,8 @@ static int __init powerclamp_probe(void)
 	/* find the deepest mwait value */
 	find_target_mwait();
 
+	powerclamp_probe_power_model();
+
 	return 0;
 }
 
@@ -53,6 +53,9 @@
 /* DTS0 and DTS 1 */
 #define SOC_MAX_DTS_SENSORS		2
 
+/* Re-run the governor while cooling, the trip interrupts only fire on crossing */
+#define SOC_DTS_PASSIVE_DELAY		1000
+
 static int get_tj_max(u32 *tj_max)
 {
 	u32 eax, edx;
@@ -254,6 +257,10 @@ static struct thermal_zone_device_ops tzone_ops = {
 	.set_trip_temp = sys_set_trip_temp,
 };
 
+static struct thermal_zone_params soc_dts_tz_params = {
+	.adaptive_polling = true,
+};
+
 static int soc_dts_enable(int id)
 {
 	u32 out;
@@ -328,7 +335,8 @@ static int add_dts_thermal_zone(int id, struct intel_soc_dts_sensor_entry *dts,
 						  trip_count,
 						  trip_mask,
 						  dts, &tzone_ops,
-						  NULL, 0, 0);
+						  &soc_dts_tz_params,
+						  SOC_DTS_PASSIVE_DELAY, 0);
 	if (IS_ERR(dts->tzone)) {
 		ret = PTR_ERR(dts->tzone);
 		goto err_ret;
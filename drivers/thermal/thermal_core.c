@@ -302,16 +302,56 @@ static void thermal_zone_device_set_polling(struct thermal_zone_device *tz,
 		cancel_delayed_work(&tz->poll_queue);
 }
 
+/* How far the adaptive delay may get from the one of the zone */
+#define THERMAL_POLL_SCALE	4
+
+/*
+ * With adaptive polling, the next poll is due when the temperature is
+ * expected to be half way to the next trip point at the last rate it
+ * rose, so a zone heating up fast is sampled more often and a cool or
+ * cooling one less often.  Interrupt driven zones, with no delay, are
+ * not polled at all.
+ */
+static int thermal_zone_poll_delay(struct thermal_zone_device *tz, int delay)
+{
+	int trip, trip_temp, headroom = INT_MAX;
+	int rise, next;
+
+	if (!delay || !tz->tzp || !tz->tzp->adaptive_polling ||
+	    tz->last_temperature == THERMAL_TEMP_INVALID || !tz->poll_delay)
+		return delay;
+
+	for (trip = 0; trip < tz->trips; trip++) {
+		if (tz->ops->get_trip_temp(tz, trip, &trip_temp))
+			continue;
+		if (trip_temp > tz->temperature)
+			headroom = min(headroom, trip_temp - tz->temperature);
+	}
+
+	rise = tz->temperature - tz->last_temperature;
+	if (rise <= 0 || headroom == INT_MAX)
+		return delay * THERMAL_POLL_SCALE;
+
+	next = div_u64((u64)headroom * tz->poll_delay, 2 * rise);
+
+	return clamp(next, delay / THERMAL_POLL_SCALE,
+		     delay * THERMAL_POLL_SCALE);
+}
+
 static void monitor_thermal_zone(struct thermal_zone_device *tz)
 {
+	int delay;
+
 	mutex_lock(&tz->lock);
 
 	if (tz->passive)
-		thermal_zone_device_set_polling(tz, tz->passive_delay);
-	else if (tz->polling_delay)
-		thermal_zone_device_set_polling(tz, tz->polling_delay);
+		delay = tz->passive_delay;
 	else
-		thermal_zone_device_set_polling(tz, 0);
+		delay = tz->polling_delay;
+
+	delay = thermal_zone_poll_delay(tz, delay);
+	tz->poll_delay = delay;
+	thermal_zone_device_set_polling(tz, delay);
 
 	mutex_unlock(&tz->lock);
 }
@@ -68,8 +68,16 @@ struct pkg_device {
 
 static struct thermal_zone_params pkg_temp_tz_params = {
 	.no_hwmon	= true,
+	.adaptive_polling = true,
 };
 
+/*
+ * The threshold interrupts tell when a trip is crossed, but once cooling
+ * has started the governor has to be run again to step the cooling
+ * devices up or down as long as the package stays above the trip.
+ */
+#define PKG_TEMP_THERMAL_PASSIVE_DELAY	1000
+
 /* Keep track of how many package pointers we allocated in init() */
 static int max_packages __read_mostly;
 /* Array of package pointers */
@@ -382,7 +390,8 @@ static int pkg_temp_thermal_device_add(unsigned int cpu)
 	pkgdev->tzone = thermal_zone_device_register("x86_pkg_temp",
 			thres_count,
 			(thres_count == MAX_NUMBER_OF_TRIPS) ? 0x03 : 0x01,
-			pkgdev, &tzone_ops, &pkg_temp_tz_params, 0, 0);
+			pkgdev, &tzone_ops, &pkg_temp_tz_params,
+			PKG_TEMP_THERMAL_PASSIVE_DELAY, 0);
 	if (IS_ERR(pkgdev->tzone)) {
 		err = PTR_ERR(pkgdev->tzone);
 		kfree(pkgdev);
@@ -25,6 +25,7 @@
 #include <linux/sched.h>
 #include <linux/compat.h>
 #include <linux/uio.h>
+#include <linux/mm.h>
 
 #include <linux/virtio.h>
 #include <linux/virtio_ids.h>
@@ -61,6 +62,18 @@
 #define TIPC_IOC_CONNECT_COMPAT		_IOW(TIPC_IOC_MAGIC, 0x80, \
 					     compat_uptr_t)
 #endif
+#define TIPC_IOC_SHARE_MEM		_IOW(TIPC_IOC_MAGIC, 0x81, \
+					     struct tipc_shm_req)
+
+/* struct tipc_shm_req has the same layout for 32-bit callers */
+struct tipc_shm_req {
+	__u64 addr;
+	__u64 len;
+	__u32 flags;
+	__u32 reserved;
+};
+
+#define TIPC_SHM_FLAG_WRITABLE		0x1
 
 struct tipc_virtio_dev;
 
@@ -85,6 +98,7 @@ enum tipc_ctrl_msg_types {
 	TIPC_CTRL_MSGTYPE_CONN_REQ,
 	TIPC_CTRL_MSGTYPE_CONN_RSP,
 	TIPC_CTRL_MSGTYPE_DISC_REQ,
+	TIPC_CTRL_MSGTYPE_SHM_REGISTER,
 };
 
 struct tipc_ctrl_msg {
@@ -109,6 +123,16 @@ struct tipc_disc_req_body {
 	u32 target;
 } __packed;
 
+struct tipc_shm_register_body {
+	u32 target;
+	u32 flags;
+	u32 offset;
+	u32 size;
+	u32 page_cnt;
+	u32 reserved;
+	struct ns_mem_page_info pages[0];
+} __packed;
+
 struct tipc_cdev_node {
 	struct cdev cdev;
 	struct device *dev;
@@ -137,6 +161,12 @@ struct tipc_virtio_dev {
 	enum tipc_device_state state;
 	struct tipc_cdev_node cdev_node;
 	char   cdev_name[MAX_DEV_NAME_LEN];
+	uint tx_inflight; /* tx buffers handed to the remote */
+	bool tx_kick_pending; /* a tx kick has not been answered yet */
+	u64 tx_msg_cnt;
+	u64 tx_kick_cnt;
+	u64 rx_msg_cnt;
+	u64 rx_kick_cnt;
 };
 
 enum tipc_chan_state {
@@ -379,7 +409,21 @@ static int vds_queue_txbuf(struct tipc_virtio_dev *vds,
 	if (vds->state == VDS_ONLINE) {
 		sg_init_one(&sg, mb->buf_va, mb->wpos);
 		err = virtqueue_add_outbuf(vds->txvq, &sg, 1, mb, GFP_KERNEL);
-		need_notify = virtqueue_kick_prepare(vds->txvq);
+		if (!err) {
+			vds->tx_inflight++;
+			vds->tx_msg_cnt++;
+		}
+		/*
+		 * While a kick is outstanding the buffer is picked up with
+		 * the ones before it, or the kick is repeated by _txvq_cb.
+		 */
+		if (!vds->tx_kick_pending) {
+			need_notify = virtqueue_kick_prepare(vds->txvq);
+			if (need_notify) {
+				vds->tx_kick_pending = true;
+				vds->tx_kick_cnt++;
+			}
+		}
 	} else {
 		err = -ENODEV;
 	}
@@ -695,6 +739,75 @@ int tipc_chan_shutdown(struct tipc_chan *chan)
 }
 EXPORT_SYMBOL(tipc_chan_shutdown);
 
+/*
+ * Tell the remote end of a connected channel about a set of pinned pages
+ * it may map for the lifetime of the channel.  The region is dropped by
+ * the remote when the channel is disconnected.
+ */
+static int tipc_chan_share_pages(struct tipc_chan *chan, struct page **pages,
+				 unsigned int page_cnt, u32 offset, u32 size,
+				 bool writable)
+{
+	int err = 0;
+	unsigned int i;
+	size_t body_len;
+	struct tipc_ctrl_msg *msg;
+	struct tipc_shm_register_body *body;
+	struct tipc_msg_buf *txbuf;
+	pgprot_t pgprot = writable ? PAGE_KERNEL : PAGE_KERNEL_RO;
+
+	txbuf = vds_get_txbuf(chan->vds, TXBUF_TIMEOUT);
+	if (IS_ERR(txbuf))
+		return PTR_ERR(txbuf);
+
+	body_len = sizeof(*body) + page_cnt * sizeof(body->pages[0]);
+	if (sizeof(*msg) + body_len > mb_avail_space(txbuf)) {
+		err = -E2BIG;
+		goto err_put_txbuf;
+	}
+
+	/* reserve space for shared memory control message */
+	msg = mb_put_data(txbuf, sizeof(*msg) + body_len);
+	body = (struct tipc_shm_register_body *)msg->body;
+
+	msg->type = TIPC_CTRL_MSGTYPE_SHM_REGISTER;
+	msg->body_len = body_len;
+	body->flags = writable ? TIPC_SHM_FLAG_WRITABLE : 0;
+	body->offset = offset;
+	body->size = size;
+	body->page_cnt = page_cnt;
+	body->reserved = 0;
+
+	for (i = 0; i < page_cnt; i++) {
+		err = trusty_encode_page_info(&body->pages[i], pages[i],
+					      pgprot);
+		if (err)
+			goto err_put_txbuf;
+	}
+
+	mutex_lock(&chan->lock);
+	if (chan->state == TIPC_CONNECTED) {
+		body->target = chan->remote;
+		fill_msg_hdr(txbuf, chan->local, TIPC_CTRL_ADDR);
+		err = vds_queue_txbuf(chan->vds, txbuf);
+		if (err) {
+			/* this should never happen */
+			pr_err("%s: failed to queue tx buffer (%d)\n",
+			       __func__, err);
+		}
+	} else {
+		err = -ENOTCONN;
+	}
+	mutex_unlock(&chan->lock);
+
+	if (!err)
+		return 0;
+
+err_put_txbuf:
+	tipc_chan_put_txbuf(chan, txbuf);
+	return err;
+}
+
 void tipc_chan_destroy(struct tipc_chan *chan)
 {
 	mutex_lock(&chan->lock);
@@ -710,6 +823,12 @@ EXPORT_SYMBOL(tipc_chan_destroy);
 
 /***************************************************************************/
 
+struct tipc_shm {
+	struct page **pages;
+	unsigned int page_cnt;
+	bool writable;
+};
+
 struct tipc_dn_chan {
 	int pulse;
 	int state;
@@ -718,8 +837,25 @@ struct tipc_dn_chan {
 	wait_queue_head_t readq;
 	struct completion reply_comp;
 	struct list_head rx_msg_queue;
+	struct tipc_shm *shm; /* user pages shared with the remote */
 };
 
+static void tipc_shm_free(struct tipc_shm *shm)
+{
+	unsigned int i;
+
+	if (!shm)
+		return;
+
+	for (i = 0; i < shm->page_cnt; i++) {
+		if (shm->writable)
+			set_page_dirty_lock(shm->pages[i]);
+		put_page(shm->pages[i]);
+	}
+	kvfree(shm->pages);
+	kfree(shm);
+}
+
 static int dn_wait_for_reply(struct tipc_dn_chan *dn, int timeout)
 {
 	int ret;
@@ -936,6 +1072,95 @@ static int dn_connect_ioctl(struct tipc_dn_chan *dn, char __user *usr_name)
 	return dn_wait_for_reply(dn, REPLY_TIMEOUT);
 }
 
+/*
+ * Pin a user buffer and share it with the remote end of the channel, so
+ * that bulk data can be exchanged in place instead of being copied
+ * through the message buffers.  One region per channel; it stays pinned
+ * until the channel is released.
+ */
+static int dn_share_mem_ioctl(struct tipc_dn_chan *dn,
+			      struct tipc_shm_req __user *usr_req)
+{
+	int ret;
+	int pinned;
+	unsigned int page_cnt, max_page_cnt;
+	struct tipc_shm_req req;
+	struct tipc_shm *shm;
+	bool writable;
+
+	if (copy_from_user(&req, usr_req, sizeof(req)))
+		return -EFAULT;
+
+	if (!req.len || req.len > U32_MAX || req.addr + req.len < req.addr ||
+	    (req.flags & ~TIPC_SHM_FLAG_WRITABLE) || req.reserved)
+		return -EINVAL;
+
+	/* all the pages have to be described in a single message */
+	max_page_cnt = (dn->chan->vds->msg_buf_max_sz -
+			sizeof(struct tipc_msg_hdr) -
+			sizeof(struct tipc_ctrl_msg) -
+			sizeof(struct tipc_shm_register_body)) /
+		       sizeof(struct ns_mem_page_info);
+	page_cnt = ((req.addr + req.len - 1) >> PAGE_SHIFT) -
+		   (req.addr >> PAGE_SHIFT) + 1;
+	if (page_cnt > max_page_cnt)
+		return -E2BIG;
+
+	writable = req.flags & TIPC_SHM_FLAG_WRITABLE;
+
+	shm = kzalloc(sizeof(*shm), GFP_KERNEL);
+	if (!shm)
+		return -ENOMEM;
+
+	shm->writable = writable;
+	shm->pages = kvmalloc_array(page_cnt, sizeof(*shm->pages), GFP_KERNEL);
+	if (!shm->pages) {
+		ret = -ENOMEM;
+		goto err_free;
+	}
+
+	pinned = get_user_pages_fast(req.addr & PAGE_MASK, page_cnt,
+				     writable, shm->pages);
+	if (pinned < 0) {
+		ret = pinned;
+		goto err_free;
+	}
+	shm->page_cnt = pinned;
+	if (pinned != page_cnt) {
+		ret = -EFAULT;
+		goto err_free;
+	}
+
+	mutex_lock(&dn->lock);
+	if (dn->state != TIPC_CONNECTED)
+		ret = -ENOTCONN;
+	else if (dn->shm)
+		ret = -EBUSY;
+	else
+		ret = 0;
+	if (!ret)
+		dn->shm = shm;
+	mutex_unlock(&dn->lock);
+	if (ret)
+		goto err_free;
+
+	ret = tipc_chan_share_pages(dn->chan, shm->pages, page_cnt,
+				    offset_in_page(req.addr), req.len,
+				    writable);
+	if (ret) {
+		mutex_lock(&dn->lock);
+		dn->shm = NULL;
+		mutex_unlock(&dn->lock);
+		goto err_free;
+	}
+
+	return 0;
+
+err_free:
+	tipc_shm_free(shm);
+	return ret;
+}
+
 static long tipc_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 {
 	int ret;
@@ -948,6 +1173,9 @@ static long tipc_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 	case TIPC_IOC_CONNECT:
 		ret = dn_connect_ioctl(dn, (char __user *)arg);
 		break;
+	case TIPC_IOC_SHARE_MEM:
+		ret = dn_share_mem_ioctl(dn, (void __user *)arg);
+		break;
 	default:
 		pr_warn("%s: Unhandled ioctl cmd: 0x%x\n",
 			__func__, cmd);
@@ -971,6 +1199,9 @@ static long tipc_compat_ioctl(struct file *filp,
 	case TIPC_IOC_CONNECT_COMPAT:
 		ret = dn_connect_ioctl(dn, user_req);
 		break;
+	case TIPC_IOC_SHARE_MEM:
+		ret = dn_share_mem_ioctl(dn, user_req);
+		break;
 	default:
 		pr_warn("%s: Unhandled ioctl cmd: 0x%x\n",
 			__func__, cmd);
@@ -1128,6 +1359,9 @@ static int tipc_release(struct inode *inode, struct file *filp)
 	/* and destroy it */
 	tipc_chan_destroy(dn->chan);
 
+	/* the remote drops the shared region with the channel */
+	tipc_shm_free(dn->shm);
+
 	kfree(dn);
 
 	return 0;
@@ -1265,8 +1499,10 @@ static void destroy_cdev_node(struct tipc_virtio_dev *vds,
 static void _go_online(struct tipc_virtio_dev *vds)
 {
 	mutex_lock(&vds->lock);
-	if (vds->state == VDS_OFFLINE)
+	if (vds->state == VDS_OFFLINE) {
 		vds->state = VDS_ONLINE;
+		vds->tx_kick_pending = false;
+	}
 	mutex_unlock(&vds->lock);
 
 	create_cdev_node(vds, &vds->cdev_node);
@@ -1484,15 +1720,30 @@ static void _rxvq_cb(struct virtqueue *rxvq)
 	unsigned int msg_cnt = 0;
 	struct tipc_virtio_dev *vds = rxvq->vdev->priv;
 
-	while ((mb = virtqueue_get_buf(rxvq, &len)) != NULL) {
-		if (_handle_rxbuf(vds, mb, len))
-			break;
-		msg_cnt++;
-	}
+	/*
+	 * Drain everything the remote has queued, including what arrives
+	 * meanwhile, and return the buffers with a single kick.
+	 */
+	do {
+		virtqueue_disable_cb(rxvq);
+		while ((mb = virtqueue_get_buf(rxvq, &len)) != NULL) {
+			if (_handle_rxbuf(vds, mb, len)) {
+				virtqueue_enable_cb(rxvq);
+				goto out;
+			}
+			msg_cnt++;
+		}
+	} while (!virtqueue_enable_cb(rxvq));
 
+out:
 	/* tell the other size that we added rx buffers */
-	if (msg_cnt)
-		virtqueue_kick(rxvq);
+	if (msg_cnt) {
+		vds->rx_msg_cnt += msg_cnt;
+		if (virtqueue_kick_prepare(rxvq)) {
+			vds->rx_kick_cnt++;
+			virtqueue_notify(rxvq);
+		}
+	}
 }
 
 static void _txvq_cb(struct virtqueue *txvq)
@@ -1500,22 +1751,59 @@ static void _txvq_cb(struct virtqueue *txvq)
 	unsigned int len;
 	struct tipc_msg_buf *mb;
 	bool need_wakeup = false;
+	bool need_notify = false;
 	struct tipc_virtio_dev *vds = txvq->vdev->priv;
 
 	dev_dbg(&txvq->vdev->dev, "%s\n", __func__);
 
 	/* detach all buffers */
 	mutex_lock(&vds->lock);
-	while ((mb = virtqueue_get_buf(txvq, &len)) != NULL)
+	while ((mb = virtqueue_get_buf(txvq, &len)) != NULL) {
+		vds->tx_inflight--;
 		need_wakeup |= _put_txbuf_locked(vds, mb);
+	}
+
+	/* kick again for the buffers queued while the last kick was pending */
+	if (vds->tx_kick_pending) {
+		vds->tx_kick_pending = false;
+		if (vds->tx_inflight && vds->state == VDS_ONLINE) {
+			need_notify = virtqueue_kick_prepare(txvq);
+			if (need_notify) {
+				vds->tx_kick_pending = true;
+				vds->tx_kick_cnt++;
+			}
+		}
+	}
 	mutex_unlock(&vds->lock);
 
+	if (need_notify)
+		virtqueue_notify(txvq);
+
 	if (need_wakeup) {
 		/* wake up potential senders waiting for a tx buffer */
 		wake_up_interruptible_all(&vds->sendq);
 	}
 }
 
+static ssize_t kick_stats_show(struct device *dev,
+			       struct device_attribute *attr, char *buf)
+{
+	struct tipc_virtio_dev *vds = dev_to_virtio(dev)->priv;
+	u64 tx_msg_cnt, tx_kick_cnt;
+
+	mutex_lock(&vds->lock);
+	tx_msg_cnt = vds->tx_msg_cnt;
+	tx_kick_cnt = vds->tx_kick_cnt;
+	mutex_unlock(&vds->lock);
+
+	return scnprintf(buf, PAGE_SIZE,
+			 "tx msgs %llu kicks %llu\nrx msgs %llu kicks %llu\n",
+			 tx_msg_cnt, tx_kick_cnt,
+			 vds->rx_msg_cnt, vds->rx_kick_cnt);
+}
+
+static DEVICE_ATTR_RO(kick_stats);
+
 static int tipc_virtio_probe(struct virtio_device *vdev)
 {
 	int err, i;
@@ -1589,6 +1877,9 @@ static int tipc_virtio_probe(struct virtio_device *vdev)
 	vdev->priv = vds;
 	vds->state = VDS_OFFLINE;
 
+	if (device_create_file(&vdev->dev, &dev_attr_kick_stats))
+		dev_warn(&vdev->dev, "failed to create kick_stats\n");
+
 	dev_dbg(&vdev->dev, "%s: done\n", __func__);
 	return 0;
 
@@ -1603,6 +1894,8 @@ static void tipc_virtio_remove(struct virtio_device *vdev)
 {
 	struct tipc_virtio_dev *vds = vdev->priv;
 
+	device_remove_file(&vdev->dev, &dev_attr_kick_stats);
+
 	_go_offline(vds);
 
 	mutex_lock(&vds->lock);
@@ -20,6 +20,9 @@
 #include <linux/mm.h>
 #include <linux/module.h>
 #include <linux/log2.h>
+#include <linux/miscdevice.h>
+#include <linux/fs.h>
+#include <linux/workqueue.h>
 #include <asm/page.h>
 #include "trusty-log.h"
 
@@ -37,10 +40,10 @@ struct trusty_log_state {
 	struct device *trusty_dev;
 
 	/*
-	 * This lock is here to ensure only one consumer will read
-	 * from the log ring buffer at a time.
+	 * The ring is only consumed from dump_work, outside of the call
+	 * return path, so no lock is needed on the consumer side.
 	 */
-	spinlock_t lock;
+	struct work_struct dump_work;
 	struct log_rb *log;
 	uint32_t get;
 
@@ -48,6 +51,7 @@ struct trusty_log_state {
 
 	struct notifier_block call_notifier;
 	struct notifier_block panic_notifier;
+	struct miscdevice misc;
 	char line_buffer[TRUSTY_LINE_BUFFER_SIZE];
 };
 
@@ -112,26 +116,70 @@ static void trusty_dump_logs(struct trusty_log_state *s, bool dump_panic_log)
 	s->get = get;
 }
 
+static void trusty_log_dump_work(struct work_struct *work)
+{
+	struct trusty_log_state *s = container_of(work,
+						  struct trusty_log_state,
+						  dump_work);
+
+#ifdef CONFIG_DEBUG_INFO
+	trusty_dump_logs(s, true);
+#else
+	trusty_dump_logs(s, false);
+#endif
+}
+
 static int trusty_log_call_notify(struct notifier_block *nb,
 				  unsigned long action, void *data)
 {
 	struct trusty_log_state *s;
-	unsigned long flags;
 
 	if (action != TRUSTY_CALL_RETURNED)
 		return NOTIFY_DONE;
 
+	/* only check for new data here, the copy is done by dump_work */
 	s = container_of(nb, struct trusty_log_state, call_notifier);
-	spin_lock_irqsave(&s->lock, flags);
-#ifdef CONFIG_DEBUG_INFO
-	trusty_dump_logs(s, true);
-#else
-	trusty_dump_logs(s, false);
-#endif
-	spin_unlock_irqrestore(&s->lock, flags);
+	if (s->log->put != s->get)
+		schedule_work(&s->dump_work);
 	return NOTIFY_OK;
 }
 
+/*
+ * The log ring is exported read-only to userspace, which keeps its own
+ * read position against the put and alloc counters of struct log_rb.
+ */
+static int trusty_log_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct trusty_log_state *s = container_of(filp->private_data,
+						  struct trusty_log_state,
+						  misc);
+	unsigned long size = vma->vm_end - vma->vm_start;
+	unsigned long i;
+	int ret;
+
+	if (vma->vm_pgoff || size > TRUSTY_LOG_SIZE)
+		return -EINVAL;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	/* the mapping holds page references, so it may outlive the device */
+	for (i = 0; i < size >> PAGE_SHIFT; i++) {
+		ret = vm_insert_page(vma, vma->vm_start + (i << PAGE_SHIFT),
+				     s->log_pages + i);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+static const struct file_operations trusty_log_fops = {
+	.owner		= THIS_MODULE,
+	.mmap		= trusty_log_mmap,
+};
+
 static int trusty_log_panic_notify(struct notifier_block *nb,
 				   unsigned long action, void *data)
 {
@@ -280,11 +328,11 @@ static int trusty_log_probe(struct platform_device *pdev)
 		goto error_alloc_state;
 	}
 
-	spin_lock_init(&s->lock);
+	INIT_WORK(&s->dump_work, trusty_log_dump_work);
 	s->dev = &pdev->dev;
 	s->trusty_dev = s->dev->parent;
 	s->get = 0;
-	s->log_pages = alloc_pages(GFP_KERNEL | __GFP_ZERO,
+	s->log_pages = alloc_pages(GFP_KERNEL | __GFP_ZERO | __GFP_COMP,
 				   get_order(TRUSTY_LOG_SIZE));
 	if (!s->log_pages) {
 		result = -ENOMEM;
@@ -321,6 +369,16 @@ static int trusty_log_probe(struct platform_device *pdev)
 		goto error_panic_notifier;
 	}
 
+	s->misc.minor = MISC_DYNAMIC_MINOR;
+	s->misc.name = "trusty-log";
+	s->misc.fops = &trusty_log_fops;
+	s->misc.parent = &pdev->dev;
+	result = misc_register(&s->misc);
+	if (result < 0) {
+		dev_err(&pdev->dev, "failed to register log device\n");
+		goto error_misc_register;
+	}
+
 	if(vmm_signature == EVMM_SIGNATURE_VMM) {
 		/* allocate debug buffer for vmm panic dump */
 		g_vmm_debug_buf = __get_free_pages(GFP_KERNEL | __GFP_ZERO, 2);
@@ -359,10 +417,13 @@ static int trusty_log_probe(struct platform_device *pdev)
 error_vmm_panic_notifier:
 	free_page(g_vmm_debug_buf);
 error_alloc_vmm:
+	misc_deregister(&s->misc);
+error_misc_register:
 	atomic_notifier_chain_unregister(&panic_notifier_list,
 			&s->panic_notifier);
 error_panic_notifier:
 	trusty_call_notifier_unregister(s->trusty_dev, &s->call_notifier);
+	cancel_work_sync(&s->dump_work);
 error_call_notifier:
 	trusty_std_call32(s->trusty_dev, SMC_SC_SHARED_LOG_RM,
 			  (u32)pa, (u32)HIULINT(pa), 0);
@@ -384,9 +445,11 @@ static int trusty_log_remove(struct platform_device *pdev)
 
 	atomic_notifier_chain_unregister(&panic_notifier_list,
 					&trusty_vmm_panic_nb);
+	misc_deregister(&s->misc);
 	atomic_notifier_chain_unregister(&panic_notifier_list,
 					 &s->panic_notifier);
 	trusty_call_notifier_unregister(s->trusty_dev, &s->call_notifier);
+	cancel_work_sync(&s->dump_work);
 
 	result = trusty_std_call32(s->trusty_dev, SMC_SC_SHARED_LOG_RM,
 				   (u32)pa, (u32)HIULINT(pa), 0);
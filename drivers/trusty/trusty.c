@@ -13,6 +13,8 @@
  */
 
 #include <linux/delay.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
 #include <linux/module.h>
 #include <linux/of.h>
 #include <linux/of_platform.h>
@@ -28,8 +30,26 @@
 
 #define TRUSTY_VMCALL_SMC 0x74727500
 
+/* Number of distinct standard calls with their own statistics */
+#define TRUSTY_STD_CALL_STATS	16
+
 struct trusty_state;
 
+/*
+ * Time spent by standard calls waiting for smc_lock, and running in the
+ * secure side.  Keyed by call number, as the trusted apps themselves are
+ * only reached through the trusty-ipc virtio queues.
+ */
+struct trusty_std_call_stats {
+	u32 smcnr;
+	u64 count;
+	u64 restarts;
+	u64 wait_ns;
+	u64 wait_max_ns;
+	u64 run_ns;
+	u64 run_max_ns;
+};
+
 struct trusty_work {
 	struct trusty_state *ts;
 	struct work_struct work;
@@ -46,6 +66,10 @@ struct trusty_state {
 	struct trusty_work __percpu *nop_works;
 	struct list_head nop_queue;
 	spinlock_t nop_lock; /* protects nop_queue */
+	atomic_t std_call_waiters;
+	int std_call_waiters_max;
+	spinlock_t stats_lock; /* protects std_call_stats */
+	struct trusty_std_call_stats std_call_stats[TRUSTY_STD_CALL_STATS];
 };
 
 struct trusty_smc_interface {
@@ -199,6 +223,32 @@ struct trusty_std_call32_args {
         u32 a2;
 };
 
+static void trusty_std_call_account(struct trusty_state *s, u32 smcnr,
+				    u64 wait_ns, u64 run_ns, u64 restarts)
+{
+	struct trusty_std_call_stats *st;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&s->stats_lock, flags);
+	/* The last slot collects the calls that did not get their own */
+	for (i = 0; i < TRUSTY_STD_CALL_STATS - 1; i++) {
+		st = &s->std_call_stats[i];
+		if (!st->count)
+			st->smcnr = smcnr;
+		if (st->smcnr == smcnr)
+			break;
+	}
+	st = &s->std_call_stats[i];
+	st->count++;
+	st->restarts += restarts;
+	st->wait_ns += wait_ns;
+	st->wait_max_ns = max(st->wait_max_ns, wait_ns);
+	st->run_ns += run_ns;
+	st->run_max_ns = max(st->run_max_ns, run_ns);
+	spin_unlock_irqrestore(&s->stats_lock, flags);
+}
+
 static long trusty_std_call32_work(void *args)
 {
 	int ret;
@@ -206,6 +256,8 @@ static long trusty_std_call32_work(void *args)
 	u32 smcnr, a0, a1, a2;
 	struct trusty_state *s;
 	struct trusty_std_call32_args *work_args;
+	u64 start, locked, restarts = 0;
+	int waiters;
 
 	BUG_ON(!args);
 
@@ -221,10 +273,16 @@ static long trusty_std_call32_work(void *args)
 	BUG_ON(SMC_IS_FASTCALL(smcnr));
 	BUG_ON(SMC_IS_SMC64(smcnr));
 
+	start = ktime_get_ns();
 	if (smcnr != SMC_SC_NOP) {
+		waiters = atomic_inc_return(&s->std_call_waiters);
+		if (waiters > READ_ONCE(s->std_call_waiters_max))
+			WRITE_ONCE(s->std_call_waiters_max, waiters);
 		mutex_lock(&s->smc_lock);
+		atomic_dec(&s->std_call_waiters);
 		reinit_completion(&s->cpu_idle_completion);
 	}
+	locked = ktime_get_ns();
 
 	dev_dbg(dev, "%s(0x%x 0x%x 0x%x 0x%x) started\n",
 		__func__, smcnr, a0, a1, a2);
@@ -236,12 +294,16 @@ static long trusty_std_call32_work(void *args)
 		if (ret == SM_ERR_CPU_IDLE)
 			trusty_std_call_cpu_idle(s);
 		ret = trusty_std_call_helper(dev, SMC_SC_RESTART_LAST, 0, 0, 0);
+		restarts++;
 	}
 	dev_dbg(dev, "%s(0x%x 0x%x 0x%x 0x%x) returned 0x%x\n",
 		__func__, smcnr, a0, a1, a2, ret);
 
 	WARN_ONCE(ret == SM_ERR_PANIC, "trusty crashed");
 
+	trusty_std_call_account(s, smcnr, locked - start,
+				ktime_get_ns() - locked, restarts);
+
 	if (smcnr == SMC_SC_NOP)
 		complete(&s->cpu_idle_completion);
 	else
@@ -301,6 +363,42 @@ ssize_t trusty_version_show(struct device *dev, struct device_attribute *attr,
 
 DEVICE_ATTR(trusty_version, S_IRUSR, trusty_version_show, NULL);
 
+static ssize_t std_call_stats_show(struct device *dev,
+				   struct device_attribute *attr, char *buf)
+{
+	struct trusty_state *s = platform_get_drvdata(to_platform_device(dev));
+	struct trusty_std_call_stats st;
+	unsigned long flags;
+	ssize_t len;
+	int i;
+
+	len = scnprintf(buf, PAGE_SIZE, "waiting: %d max: %d\n",
+			atomic_read(&s->std_call_waiters),
+			READ_ONCE(s->std_call_waiters_max));
+	len += scnprintf(buf + len, PAGE_SIZE - len,
+			 "smcnr      count      restarts   wait_avg_us wait_max_us run_avg_us  run_max_us\n");
+
+	for (i = 0; i < TRUSTY_STD_CALL_STATS; i++) {
+		spin_lock_irqsave(&s->stats_lock, flags);
+		st = s->std_call_stats[i];
+		spin_unlock_irqrestore(&s->stats_lock, flags);
+
+		if (!st.count)
+			continue;
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+				 "0x%08x %-10llu %-10llu %-11llu %-11llu %-11llu %llu\n",
+				 st.smcnr, st.count, st.restarts,
+				 div64_u64(st.wait_ns, st.count * NSEC_PER_USEC),
+				 div64_u64(st.wait_max_ns, NSEC_PER_USEC),
+				 div64_u64(st.run_ns, st.count * NSEC_PER_USEC),
+				 div64_u64(st.run_max_ns, NSEC_PER_USEC));
+	}
+
+	return len;
+}
+
+static DEVICE_ATTR(std_call_stats, S_IRUSR, std_call_stats_show, NULL);
+
 const char *trusty_version_str_get(struct device *dev)
 {
 	struct trusty_state *s = platform_get_drvdata(to_platform_device(dev));
@@ -509,6 +607,7 @@ static int trusty_probe(struct platform_device *pdev)
 	s->dev = &pdev->dev;
 	spin_lock_init(&s->nop_lock);
 	INIT_LIST_HEAD(&s->nop_queue);
+	spin_lock_init(&s->stats_lock);
 
 	mutex_init(&s->smc_lock);
 	ATOMIC_INIT_NOTIFIER_HEAD(&s->notifier);
@@ -547,6 +646,9 @@ static int trusty_probe(struct platform_device *pdev)
 		INIT_WORK(&tw->work, work_func);
 	}
 
+	if (device_create_file(&pdev->dev, &dev_attr_std_call_stats))
+		dev_warn(&pdev->dev, "failed to create std_call_stats\n");
+
 	return 0;
 
 err_alloc_works:
@@ -577,6 +679,7 @@ static int trusty_remove(struct platform_device *pdev)
 
 	dev_dbg(&(pdev->dev), "%s() is called\n", __func__);
 
+	device_remove_file(&pdev->dev, &dev_attr_std_call_stats);
 	device_for_each_child(&pdev->dev, NULL, trusty_remove_child);
 
 	for_each_possible_cpu(cpu) {
@@ -46,10 +46,15 @@ struct uart_8250_dma {
 
 	size_t			rx_size;
 	size_t			tx_size;
+	/* Next byte of @rx_buf to hand to the TTY layer, in cyclic mode */
+	size_t			rx_tail;
 
 	unsigned char		tx_running;
 	unsigned char		tx_err;
 	unsigned char		rx_running;
+	/* Set by the glue driver to receive into @rx_buf as a ring */
+	unsigned char		rx_cyclic;
+	unsigned char		rx_paused;
 };
 
 struct old_serial_port {
@@ -15,6 +15,9 @@
 
 #include "8250.h"
 
+/* Number of period interrupts per lap of the cyclic RX ring */
+#define SERIAL8250_RX_DMA_PERIODS	4
+
 static void __dma_tx_complete(void *param)
 {
 	struct uart_8250_port	*p = param;
@@ -65,6 +68,86 @@ static void __dma_rx_complete(void *param)
 	tty_flip_buffer_push(tty_port);
 }
 
+/*
+ * Hand everything the DMA wrote since the last call to the TTY layer, with
+ * a single push. The write position comes from the residue, so this works
+ * at any point of a period, not just on its completion.
+ */
+static void dma_rx_push_cyclic(struct uart_8250_port *p)
+{
+	struct uart_8250_dma	*dma = p->dma;
+	struct tty_port		*tty_port = &p->port.state->port;
+	struct dma_tx_state	state;
+	size_t			head;
+	int			count = 0;
+
+	dmaengine_tx_status(dma->rxchan, dma->rx_cookie, &state);
+	head = (dma->rx_size - state.residue) % dma->rx_size;
+
+	if (head < dma->rx_tail) {
+		count += tty_insert_flip_string(tty_port,
+						dma->rx_buf + dma->rx_tail,
+						dma->rx_size - dma->rx_tail);
+		dma->rx_tail = 0;
+	}
+	count += tty_insert_flip_string(tty_port, dma->rx_buf + dma->rx_tail,
+					head - dma->rx_tail);
+	dma->rx_tail = head;
+
+	if (!count)
+		return;
+
+	p->port.icount.rx += count;
+	tty_flip_buffer_push(tty_port);
+}
+
+static void __dma_rx_period(void *param)
+{
+	struct uart_8250_port	*p = param;
+	unsigned long		flags;
+
+	spin_lock_irqsave(&p->port.lock, flags);
+	if (p->dma->rx_running)
+		dma_rx_push_cyclic(p);
+	spin_unlock_irqrestore(&p->port.lock, flags);
+}
+
+/*
+ * The ring is armed once and keeps running across transfers, so there is
+ * no window without a descriptor in which the FIFO can overrun.
+ */
+static int serial8250_rx_dma_cyclic(struct uart_8250_port *p)
+{
+	struct uart_8250_dma		*dma = p->dma;
+	struct dma_async_tx_descriptor	*desc;
+
+	if (dma->rx_running) {
+		if (dma->rx_paused) {
+			dmaengine_resume(dma->rxchan);
+			dma->rx_paused = 0;
+		}
+		return 0;
+	}
+
+	desc = dmaengine_prep_dma_cyclic(dma->rxchan, dma->rx_addr,
+					 dma->rx_size,
+					 dma->rx_size / SERIAL8250_RX_DMA_PERIODS,
+					 DMA_DEV_TO_MEM, DMA_PREP_INTERRUPT);
+	if (!desc)
+		return -EBUSY;
+
+	dma->rx_running = 1;
+	dma->rx_tail = 0;
+	desc->callback = __dma_rx_period;
+	desc->callback_param = p;
+
+	dma->rx_cookie = dmaengine_submit(desc);
+
+	dma_async_issue_pending(dma->rxchan);
+
+	return 0;
+}
+
 int serial8250_tx_dma(struct uart_8250_port *p)
 {
 	struct uart_8250_dma		*dma = p->dma;
@@ -120,6 +203,9 @@ int serial8250_rx_dma(struct uart_8250_port *p)
 	struct uart_8250_dma		*dma = p->dma;
 	struct dma_async_tx_descriptor	*desc;
 
+	if (dma->rx_cyclic)
+		return serial8250_rx_dma_cyclic(p);
+
 	if (dma->rx_running)
 		return 0;
 
@@ -144,11 +230,25 @@ void serial8250_rx_dma_flush(struct uart_8250_port *p)
 {
 	struct uart_8250_dma *dma = p->dma;
 
-	if (dma->rx_running) {
-		dmaengine_pause(dma->rxchan);
-		__dma_rx_complete(p);
-		dmaengine_terminate_async(dma->rxchan);
+	if (!dma->rx_running)
+		return;
+
+	/*
+	 * The ring stays paused while the caller drains the FIFO by PIO, the
+	 * next RX interrupt resumes it.
+	 */
+	if (dma->rx_cyclic) {
+		if (!dma->rx_paused) {
+			dmaengine_pause(dma->rxchan);
+			dma->rx_paused = 1;
+		}
+		dma_rx_push_cyclic(p);
+		return;
 	}
+
+	dmaengine_pause(dma->rxchan);
+	__dma_rx_complete(p);
+	dmaengine_terminate_async(dma->rxchan);
 }
 EXPORT_SYMBOL_GPL(serial8250_rx_dma_flush);
 
@@ -192,6 +292,12 @@ int serial8250_request_dma(struct uart_8250_port *p)
 		goto release_rx;
 	}
 
+	/* The ring needs a residue finer than the period to be flushed */
+	if (dma->rx_cyclic &&
+	    (!dma_has_cap(DMA_CYCLIC, dma->rxchan->device->cap_mask) ||
+	     caps.residue_granularity != DMA_RESIDUE_GRANULARITY_BURST))
+		dma->rx_cyclic = 0;
+
 	dmaengine_slave_config(dma->rxchan, &dma->rxconf);
 
 	/* Get a channel for TX */
@@ -216,7 +322,8 @@ int serial8250_request_dma(struct uart_8250_port *p)
 
 	/* RX buffer */
 	if (!dma->rx_size)
-		dma->rx_size = PAGE_SIZE;
+		dma->rx_size = dma->rx_cyclic ? SERIAL8250_RX_DMA_PERIODS *
+						PAGE_SIZE : PAGE_SIZE;
 
 	dma->rx_buf = dma_alloc_coherent(dma->rxchan->device->dev, dma->rx_size,
 					&dma->rx_addr, GFP_KERNEL);
@@ -261,6 +368,8 @@ void serial8250_release_dma(struct uart_8250_port *p)
 			  dma->rx_addr);
 	dma_release_channel(dma->rxchan);
 	dma->rxchan = NULL;
+	dma->rx_running = 0;
+	dma->rx_paused = 0;
 
 	/* Release TX resources */
 	dmaengine_terminate_sync(dma->txchan);
@@ -497,6 +497,10 @@ static int dw8250_probe(struct platform_device *pdev)
 	/* Always ask for fixed clock rate from a property. */
 	device_property_read_u32(dev, "clock-frequency", &p->uartclk);
 
+	/* High baud rate links, like Bluetooth, want a gapless RX ring */
+	data->dma.rx_cyclic = device_property_read_bool(dev,
+							"snps,rx-dma-cyclic");
+
 	/* If there is separate baudclk, get the rate from it. */
 	data->clk = devm_clk_get(dev, "baudclk");
 	if (IS_ERR(data->clk) && PTR_ERR(data->clk) != -EPROBE_DEFER)
@@ -510,6 +510,8 @@ struct dwc3_event_buffer {
 #define DWC3_EP_DIRECTION_RX	false
 
 #define DWC3_TRB_NUM		256
+#define DWC3_TRB_NUM_MIN	32
+#define DWC3_TRB_NUM_MAX	4096
 
 /**
  * struct dwc3_ep - device side endpoint representation
@@ -521,8 +523,11 @@ struct dwc3_event_buffer {
  * @regs: pointer to first endpoint register
  * @trb_pool: array of transaction buffers
  * @trb_pool_dma: dma address of @trb_pool
+ * @num_trbs: number of TRBs in @trb_pool, a power of 2, link TRB included
  * @trb_enqueue: enqueue 'pointer' into TRB array
  * @trb_dequeue: dequeue 'pointer' into TRB array
+ * @trb_max_used: highest number of TRBs owned by the hardware at once
+ * @trb_ring_full: times requests were left pending for lack of TRBs
  * @dwc: pointer to DWC controller
  * @saved_state: ep state saved during hibernation
  * @flags: endpoint flags (wedged, stalled, ...)
@@ -565,16 +570,15 @@ struct dwc3_ep {
 #define DWC3_EP0_DIR_IN		BIT(31)
 
 	/*
-	 * IMPORTANT: we *know* we have 256 TRBs in our @trb_pool, so we will
-	 * use a u8 type here. If anybody decides to increase number of TRBs to
-	 * anything larger than 256 - I can't see why people would want to do
-	 * this though - then this type needs to be changed.
-	 *
-	 * By using u8 types we ensure that our % operator when incrementing
-	 * enqueue and dequeue get optimized away by the compiler.
+	 * The ring size is configurable, see "snps,num-trbs", and always a
+	 * power of 2 so that the distance between enqueue and dequeue is
+	 * a simple mask.
 	 */
-	u8			trb_enqueue;
-	u8			trb_dequeue;
+	u16			num_trbs;
+	u16			trb_enqueue;
+	u16			trb_dequeue;
+	u16			trb_max_used;
+	unsigned long		trb_ring_full;
 
 	u8			number;
 	u8			type;
@@ -722,7 +726,9 @@ struct dwc3_hwparams {
  * @list: a list_head used for request queueing
  * @dep: struct dwc3_ep owning this request
  * @sg: pointer to first incomplete sg
+ * @start_sg: pointer to the next sg to prepare a TRB for
  * @num_pending_sgs: counter to pending sgs
+ * @num_queued_sgs: counter to pending sgs that have a TRB
  * @remaining: amount of data remaining
  * @epnum: endpoint number to which this request refers
  * @trb: pointer to struct dwc3_trb
@@ -738,8 +744,10 @@ struct dwc3_request {
 	struct list_head	list;
 	struct dwc3_ep		*dep;
 	struct scatterlist	*sg;
+	struct scatterlist	*start_sg;
 
 	unsigned		num_pending_sgs;
+	unsigned		num_queued_sgs;
 	unsigned		remaining;
 	u8			epnum;
 	struct dwc3_trb		*trb;
@@ -655,7 +655,7 @@ static int dwc3_ep_trb_ring_show(struct seq_file *s, void *unused)
 
 	seq_printf(s, "buffer_addr,size,type,ioc,isp_imi,csp,chn,lst,hwo\n");
 
-	for (i = 0; i < DWC3_TRB_NUM; i++) {
+	for (i = 0; i < dep->num_trbs; i++) {
 		struct dwc3_trb *trb = &dep->trb_pool[i];
 		unsigned int type = DWC3_TRBCTL_TYPE(trb->ctrl);
 
@@ -678,6 +678,30 @@ static int dwc3_ep_trb_ring_show(struct seq_file *s, void *unused)
 	return 0;
 }
 
+static int dwc3_ep_trb_ring_stats_show(struct seq_file *s, void *unused)
+{
+	struct dwc3_ep		*dep = s->private;
+	struct dwc3		*dwc = dep->dwc;
+	unsigned long		flags;
+
+	spin_lock_irqsave(&dwc->lock, flags);
+	if (dep->number <= 1) {
+		seq_printf(s, "--\n");
+		goto out;
+	}
+
+	seq_printf(s, "size %u\n", dep->num_trbs - 1);
+	seq_printf(s, "enqueue %u\n", dep->trb_enqueue);
+	seq_printf(s, "dequeue %u\n", dep->trb_dequeue);
+	seq_printf(s, "max in use %u\n", dep->trb_max_used);
+	seq_printf(s, "full %lu\n", dep->trb_ring_full);
+
+out:
+	spin_unlock_irqrestore(&dwc->lock, flags);
+
+	return 0;
+}
+
 static struct dwc3_ep_file_map map[] = {
 	{ "tx_fifo_queue", dwc3_tx_fifo_queue_show, },
 	{ "rx_fifo_queue", dwc3_rx_fifo_queue_show, },
@@ -688,6 +712,7 @@ static struct dwc3_ep_file_map map[] = {
 	{ "event_queue", dwc3_event_queue_show, },
 	{ "transfer_type", dwc3_ep_transfer_type_show, },
 	{ "trb_ring", dwc3_ep_trb_ring_show, },
+	{ "trb_ring_stats", dwc3_ep_trb_ring_stats_show, },
 };
 
 static int dwc3_endpoint_open(struct inode *inode, struct file *file)
@@ -26,6 +26,8 @@
 #include <linux/io.h>
 #include <linux/list.h>
 #include <linux/dma-mapping.h>
+#include <linux/log2.h>
+#include <linux/property.h>
 #include <asm/processor.h>
 
 #include <linux/usb/ch9.h>
@@ -144,16 +146,17 @@ int dwc3_gadget_set_link_state(struct dwc3 *dwc, enum dwc3_link_state state)
 
 /**
  * dwc3_ep_inc_trb - increment a trb index.
+ * @dep: The endpoint owning the TRB ring
  * @index: Pointer to the TRB index to increment.
  *
  * The index should never point to the link TRB. After incrementing,
  * if it is point to the link TRB, wrap around to the beginning. The
  * link TRB is always at the last TRB entry.
  */
-static void dwc3_ep_inc_trb(u8 *index)
+static void dwc3_ep_inc_trb(struct dwc3_ep *dep, u16 *index)
 {
 	(*index)++;
-	if (*index == (DWC3_TRB_NUM - 1))
+	if (*index == (dep->num_trbs - 1))
 		*index = 0;
 }
 
@@ -163,7 +166,7 @@ static void dwc3_ep_inc_trb(u8 *index)
  */
 static void dwc3_ep_inc_enq(struct dwc3_ep *dep)
 {
-	dwc3_ep_inc_trb(&dep->trb_enqueue);
+	dwc3_ep_inc_trb(dep, &dep->trb_enqueue);
 }
 
 /**
@@ -172,7 +175,7 @@ static void dwc3_ep_inc_enq(struct dwc3_ep *dep)
  */
 static void dwc3_ep_inc_deq(struct dwc3_ep *dep)
 {
-	dwc3_ep_inc_trb(&dep->trb_dequeue);
+	dwc3_ep_inc_trb(dep, &dep->trb_dequeue);
 }
 
 /**
@@ -435,7 +438,7 @@ static int dwc3_alloc_trb_pool(struct dwc3_ep *dep)
 		return 0;
 
 	dep->trb_pool = dma_alloc_coherent(dwc->sysdev,
-			sizeof(struct dwc3_trb) * DWC3_TRB_NUM,
+			sizeof(struct dwc3_trb) * dep->num_trbs,
 			&dep->trb_pool_dma, GFP_KERNEL);
 	if (!dep->trb_pool) {
 		dev_err(dep->dwc->dev, "failed to allocate trb pool for %s\n",
@@ -450,7 +453,7 @@ static void dwc3_free_trb_pool(struct dwc3_ep *dep)
 {
 	struct dwc3		*dwc = dep->dwc;
 
-	dma_free_coherent(dwc->sysdev, sizeof(struct dwc3_trb) * DWC3_TRB_NUM,
+	dma_free_coherent(dwc->sysdev, sizeof(struct dwc3_trb) * dep->num_trbs,
 			dep->trb_pool, dep->trb_pool_dma);
 
 	dep->trb_pool = NULL;
@@ -657,12 +660,12 @@ static int __dwc3_gadget_ep_enable(struct dwc3_ep *dep,
 		dep->trb_dequeue = 0;
 		dep->trb_enqueue = 0;
 		memset(dep->trb_pool, 0,
-		       sizeof(struct dwc3_trb) * DWC3_TRB_NUM);
+		       sizeof(struct dwc3_trb) * dep->num_trbs);
 
 		/* Link TRB. The HWO bit is never reset */
 		trb_st_hw = &dep->trb_pool[0];
 
-		trb_link = &dep->trb_pool[DWC3_TRB_NUM - 1];
+		trb_link = &dep->trb_pool[dep->num_trbs - 1];
 		trb_link->bpl = lower_32_bits(dwc3_trb_dma_offset(dep, trb_st_hw));
 		trb_link->bph = upper_32_bits(dwc3_trb_dma_offset(dep, trb_st_hw));
 		trb_link->ctrl |= DWC3_TRBCTL_LINK_TRB;
@@ -984,14 +987,13 @@ static void __dwc3_prepare_one_trb(struct dwc3_ep *dep, struct dwc3_trb *trb,
  * @node: only for isochronous endpoints. First TRB needs different type.
  */
 static void dwc3_prepare_one_trb(struct dwc3_ep *dep,
-		struct dwc3_request *req, unsigned chain, unsigned node)
+		struct dwc3_request *req, dma_addr_t dma, unsigned length,
+		unsigned chain, unsigned node)
 {
 	struct dwc3_trb		*trb;
-	unsigned		length = req->request.length;
 	unsigned		stream_id = req->request.stream_id;
 	unsigned		short_not_ok = req->request.short_not_ok;
 	unsigned		no_interrupt = req->request.no_interrupt;
-	dma_addr_t		dma = req->request.dma;
 
 	trb = &dep->trb_pool[dep->trb_enqueue];
 
@@ -1015,12 +1017,12 @@ static void dwc3_prepare_one_trb(struct dwc3_ep *dep,
  * index is 0, we will wrap backwards, skip the link TRB, and return
  * the one just before that.
  */
-static struct dwc3_trb *dwc3_ep_prev_trb(struct dwc3_ep *dep, u8 index)
+static struct dwc3_trb *dwc3_ep_prev_trb(struct dwc3_ep *dep, u16 index)
 {
-	u8 tmp = index;
+	u16 tmp = index;
 
 	if (!tmp)
-		tmp = DWC3_TRB_NUM - 1;
+		tmp = dep->num_trbs - 1;
 
 	return &dep->trb_pool[tmp - 1];
 }
@@ -1028,7 +1030,7 @@ static struct dwc3_trb *dwc3_ep_prev_trb(struct dwc3_ep *dep, u8 index)
 static u32 dwc3_calc_trbs_left(struct dwc3_ep *dep)
 {
 	struct dwc3_trb		*tmp;
-	u8			trbs_left;
+	u16			trbs_left;
 
 	/*
 	 * If enqueue & dequeue are equal than it is either full or empty.
@@ -1042,11 +1044,11 @@ static u32 dwc3_calc_trbs_left(struct dwc3_ep *dep)
 		if (tmp->ctrl & DWC3_TRB_CTRL_HWO)
 			return 0;
 
-		return DWC3_TRB_NUM - 1;
+		return dep->num_trbs - 1;
 	}
 
 	trbs_left = dep->trb_dequeue - dep->trb_enqueue;
-	trbs_left &= (DWC3_TRB_NUM - 1);
+	trbs_left &= (dep->num_trbs - 1);
 
 	if (dep->trb_dequeue < dep->trb_enqueue)
 		trbs_left--;
@@ -1054,30 +1056,56 @@ static u32 dwc3_calc_trbs_left(struct dwc3_ep *dep)
 	return trbs_left;
 }
 
+static void dwc3_ep_update_trb_stats(struct dwc3_ep *dep)
+{
+	u16 used = dep->num_trbs - 1 - dwc3_calc_trbs_left(dep);
+
+	if (used > dep->trb_max_used)
+		dep->trb_max_used = used;
+
+	/* Requests wait for TRBs: the ring is too small for this function */
+	if (used == dep->num_trbs - 1 && !list_empty(&dep->pending_list))
+		dep->trb_ring_full++;
+}
+
+/*
+ * One TRB per mapped sg entry, chained, so that a request spans any number
+ * of pages without going through a bounce buffer. If the ring fills up,
+ * the request is left in the started list with its remaining entries, and
+ * dwc3_prepare_trbs() resumes from @start_sg once TRBs are freed.
+ */
 static void dwc3_prepare_one_trb_sg(struct dwc3_ep *dep,
 		struct dwc3_request *req)
 {
-	struct scatterlist *sg = req->sg;
+	struct scatterlist *sg = req->start_sg;
 	struct scatterlist *s;
+	unsigned int	remaining = req->num_pending_sgs - req->num_queued_sgs;
+	unsigned int	node = req->request.num_mapped_sgs - remaining;
 	int		i;
 
-	for_each_sg(sg, s, req->num_pending_sgs, i) {
+	for_each_sg(sg, s, remaining, i) {
 		unsigned int length = req->request.length;
 		unsigned int maxp = usb_endpoint_maxp(dep->endpoint.desc);
 		unsigned int rem = length % maxp;
 		unsigned chain = true;
 
-		if (sg_is_last(s))
+		/* The IOMMU may have merged entries: the last is not the end */
+		if (i == remaining - 1)
 			chain = false;
 
 		if (rem && usb_endpoint_dir_out(dep->endpoint.desc) && !chain) {
 			struct dwc3	*dwc = dep->dwc;
 			struct dwc3_trb	*trb;
 
+			/* The extra TRB has to come with the last one */
+			if (dwc3_calc_trbs_left(dep) < 2)
+				break;
+
 			req->unaligned = true;
 
 			/* prepare normal TRB */
-			dwc3_prepare_one_trb(dep, req, true, i);
+			dwc3_prepare_one_trb(dep, req, sg_dma_address(s),
+					sg_dma_len(s), true, node + i);
 
 			/* Now prepare one extra TRB to align transfer size */
 			trb = &dep->trb_pool[dep->trb_enqueue];
@@ -1087,9 +1115,13 @@ static void dwc3_prepare_one_trb_sg(struct dwc3_ep *dep,
 					req->request.short_not_ok,
 					req->request.no_interrupt);
 		} else {
-			dwc3_prepare_one_trb(dep, req, chain, i);
+			dwc3_prepare_one_trb(dep, req, sg_dma_address(s),
+					sg_dma_len(s), chain, node + i);
 		}
 
+		req->start_sg = sg_next(s);
+		req->num_queued_sgs++;
+
 		if (!dwc3_calc_trbs_left(dep))
 			break;
 	}
@@ -1109,7 +1141,8 @@ static void dwc3_prepare_one_trb_linear(struct dwc3_ep *dep,
 		req->unaligned = true;
 
 		/* prepare normal TRB */
-		dwc3_prepare_one_trb(dep, req, true, 0);
+		dwc3_prepare_one_trb(dep, req, req->request.dma, length,
+				true, 0);
 
 		/* Now prepare one extra TRB to align transfer size */
 		trb = &dep->trb_pool[dep->trb_enqueue];
@@ -1125,7 +1158,8 @@ static void dwc3_prepare_one_trb_linear(struct dwc3_ep *dep,
 		req->zero = true;
 
 		/* prepare normal TRB */
-		dwc3_prepare_one_trb(dep, req, true, 0);
+		dwc3_prepare_one_trb(dep, req, req->request.dma, length,
+				true, 0);
 
 		/* Now prepare one extra TRB to handle ZLP */
 		trb = &dep->trb_pool[dep->trb_enqueue];
@@ -1134,7 +1168,8 @@ static void dwc3_prepare_one_trb_linear(struct dwc3_ep *dep,
 				req->request.short_not_ok,
 				req->request.no_interrupt);
 	} else {
-		dwc3_prepare_one_trb(dep, req, false, 0);
+		dwc3_prepare_one_trb(dep, req, req->request.dma, length,
+				false, 0);
 	}
 }
 
@@ -1150,8 +1185,6 @@ static void dwc3_prepare_trbs(struct dwc3_ep *dep)
 {
 	struct dwc3_request	*req, *n;
 
-	BUILD_BUG_ON_NOT_POWER_OF_2(DWC3_TRB_NUM);
-
 	if (!dwc3_calc_trbs_left(dep))
 		return;
 
@@ -1166,7 +1199,7 @@ static void dwc3_prepare_trbs(struct dwc3_ep *dep)
 	 * break things.
 	 */
 	list_for_each_entry(req, &dep->started_list, list) {
-		if (req->num_pending_sgs > 0)
+		if (req->num_pending_sgs > req->num_queued_sgs)
 			dwc3_prepare_one_trb_sg(dep, req);
 
 		if (!dwc3_calc_trbs_left(dep))
@@ -1183,7 +1216,9 @@ static void dwc3_prepare_trbs(struct dwc3_ep *dep)
 			return;
 
 		req->sg			= req->request.sg;
+		req->start_sg		= req->request.sg;
 		req->num_pending_sgs	= req->request.num_mapped_sgs;
+		req->num_queued_sgs	= 0;
 
 		if (req->num_pending_sgs > 0)
 			dwc3_prepare_one_trb_sg(dep, req);
@@ -1206,6 +1241,7 @@ static int __dwc3_gadget_kick_transfer(struct dwc3_ep *dep, u16 cmd_param)
 	starting = !(dep->flags & DWC3_EP_BUSY);
 
 	dwc3_prepare_trbs(dep);
+	dwc3_ep_update_trb_stats(dep);
 	req = next_request(&dep->started_list);
 	if (!req) {
 		dep->flags |= DWC3_EP_PENDING_REQUEST;
@@ -1444,14 +1480,15 @@ static int dwc3_gadget_ep_dequeue(struct usb_ep *ep,
 				struct dwc3_trb *trb;
 				int i = 0;
 
-				for (i = 0; i < r->num_pending_sgs; i++) {
-					trb = r->trb + i;
+				/* Walk the ring, these may wrap past the link TRB */
+				for (i = 0; i < r->num_queued_sgs; i++) {
+					trb = &dep->trb_pool[dep->trb_dequeue];
 					trb->ctrl &= ~DWC3_TRB_CTRL_HWO;
 					dwc3_ep_inc_deq(dep);
 				}
 
 				if (r->unaligned || r->zero) {
-					trb = r->trb + r->num_pending_sgs + 1;
+					trb = &dep->trb_pool[dep->trb_dequeue];
 					trb->ctrl &= ~DWC3_TRB_CTRL_HWO;
 					dwc3_ep_inc_deq(dep);
 				}
@@ -2109,6 +2146,34 @@ static const struct usb_gadget_ops dwc3_gadget_ops = {
 
 /* -------------------------------------------------------------------------- */
 
+/*
+ * "snps,num-trbs" sizes the TRB ring of the non-control endpoints, either
+ * with one value for all of them or with one per physical endpoint. Deep
+ * rings let a function driver keep many requests, or requests with many
+ * sg entries, queued without waiting on completions.
+ */
+static u16 dwc3_gadget_ep_num_trbs(struct dwc3 *dwc, u8 epnum, u8 total)
+{
+	u16	num_trbs[DWC3_ENDPOINTS_NUM];
+	int	count;
+
+	count = device_property_read_u16_array(dwc->dev, "snps,num-trbs",
+			NULL, 0);
+	if (count != 1 && count != total)
+		return DWC3_TRB_NUM;
+
+	if (device_property_read_u16_array(dwc->dev, "snps,num-trbs",
+				num_trbs, count))
+		return DWC3_TRB_NUM;
+
+	if (count == 1)
+		epnum = 0;
+
+	/* The ring index arithmetic needs a power of two */
+	return rounddown_pow_of_two(clamp_t(u16, num_trbs[epnum],
+				DWC3_TRB_NUM_MIN, DWC3_TRB_NUM_MAX));
+}
+
 static int dwc3_gadget_init_endpoints(struct dwc3 *dwc, u8 total)
 {
 	struct dwc3_ep			*dep;
@@ -2128,6 +2193,7 @@ static int dwc3_gadget_init_endpoints(struct dwc3 *dwc, u8 total)
 		dep->number = epnum;
 		dep->direction = direction;
 		dep->regs = dwc->regs + DWC3_DEP_BASE(epnum);
+		dep->num_trbs = dwc3_gadget_ep_num_trbs(dwc, epnum, total);
 		dwc->eps[epnum] = dep;
 
 		snprintf(dep->name, sizeof(dep->name), "ep%u%s", num,
@@ -2352,10 +2418,10 @@ static int dwc3_cleanup_done_reqs(struct dwc3 *dwc, struct dwc3_ep *dep,
 		if (chain) {
 			struct scatterlist *sg = req->sg;
 			struct scatterlist *s;
-			unsigned int pending = req->num_pending_sgs;
+			unsigned int queued = req->num_queued_sgs;
 			unsigned int i;
 
-			for_each_sg(sg, s, pending, i) {
+			for_each_sg(sg, s, queued, i) {
 				trb = &dep->trb_pool[dep->trb_dequeue];
 
 				if (trb->ctrl & DWC3_TRB_CTRL_HWO)
@@ -2363,6 +2429,7 @@ static int dwc3_cleanup_done_reqs(struct dwc3 *dwc, struct dwc3_ep *dep,
 
 				req->sg = sg_next(s);
 				req->num_pending_sgs--;
+				req->num_queued_sgs--;
 
 				ret = __dwc3_cleanup_done_trbs(dwc, dep, req, trb,
 						event, status, chain);
@@ -300,8 +300,8 @@ DECLARE_EVENT_CLASS(dwc3_log_ep,
 		__field(unsigned, maxburst)
 		__field(unsigned, flags)
 		__field(unsigned, direction)
-		__field(u8, trb_enqueue)
-		__field(u8, trb_dequeue)
+		__field(u16, trb_enqueue)
+		__field(u16, trb_dequeue)
 	),
 	TP_fast_assign(
 		__assign_str(name, dep->name);
@@ -24,6 +24,7 @@
 #include <linux/hid.h>
 #include <linux/module.h>
 #include <linux/sched/signal.h>
+#include <linux/sizes.h>
 #include <linux/uio.h>
 #include <asm/unaligned.h>
 
@@ -192,6 +193,8 @@ struct ffs_epfile {
 	struct ffs_buffer		*read_buffer;
 #define READ_BUFFER_DROP ((struct ffs_buffer *)ERR_PTR(-ESHUTDOWN))
 
+	struct ffs_buf_pool		*buf_pool;	/* P: ffs->eps_lock */
+
 	char				name[5];
 
 	unsigned char			in;	/* P: ffs->eps_lock */
@@ -206,6 +209,23 @@ struct ffs_buffer {
 	char storage[];
 };
 
+/*
+ * Buffers userspace maps from an endpoint file, so that AIO can be done
+ * in place.  Each buffer is physically contiguous, as UDCs map the buffer
+ * of a usb_request for DMA as a whole.  References are held by the
+ * endpoint, by each mapping, and by each request using one of the buffers.
+ */
+struct ffs_buf_pool {
+	struct kref ref;
+	unsigned count;
+	size_t size;			/* of each buffer, page aligned */
+	unsigned long *busy;		/* buffers with a request queued */
+	struct page *pages[];		/* first page of each buffer */
+};
+
+#define FFS_BUF_POOL_MAX_SIZE	SZ_1M
+#define FFS_BUF_POOL_MAX_BYTES	SZ_16M
+
 /*  ffs_io_data structure ***************************************************/
 
 struct ffs_io_data {
@@ -224,6 +244,11 @@ struct ffs_io_data {
 	struct usb_request *req;
 
 	struct ffs_data *ffs;
+
+	/* Set if buf lies in a buffer of the pool, see ffs_epfile_buf_claim */
+	struct ffs_buf_pool *buf_pool;
+	unsigned buf_idx;
+	size_t buf_room;
 };
 
 struct ffs_desc_helper {
@@ -697,6 +722,139 @@ static const struct file_operations ffs_ep0_operations = {
 
 /* "Normal" endpoints operations ********************************************/
 
+static void ffs_buf_pool_release(struct kref *ref)
+{
+	struct ffs_buf_pool *pool = container_of(ref, struct ffs_buf_pool, ref);
+	unsigned i, j;
+
+	for (i = 0; i < pool->count; i++)
+		for (j = 0; j < pool->size >> PAGE_SHIFT; j++)
+			__free_page(pool->pages[i] + j);
+	kfree(pool->busy);
+	kfree(pool);
+}
+
+static void ffs_buf_pool_put(struct ffs_buf_pool *pool)
+{
+	kref_put(&pool->ref, ffs_buf_pool_release);
+}
+
+static struct ffs_buf_pool *ffs_buf_pool_alloc(unsigned count, size_t size)
+{
+	struct ffs_buf_pool *pool;
+	unsigned order = get_order(size);
+	unsigned i, j;
+
+	pool = kzalloc(sizeof(*pool) + count * sizeof(pool->pages[0]),
+		       GFP_KERNEL);
+	if (!pool)
+		return NULL;
+	kref_init(&pool->ref);
+	pool->size = PAGE_ALIGN(size);
+
+	pool->busy = kcalloc(BITS_TO_LONGS(count), sizeof(long), GFP_KERNEL);
+	if (!pool->busy)
+		goto error;
+
+	for (i = 0; i < count; i++) {
+		struct page *page = alloc_pages(GFP_KERNEL | __GFP_ZERO |
+						__GFP_NOWARN, order);
+		if (!page)
+			goto error;
+
+		/* Pages are mapped one by one, and the tail is not needed */
+		split_page(page, order);
+		for (j = pool->size >> PAGE_SHIFT; j < 1 << order; j++)
+			__free_page(page + j);
+		pool->pages[pool->count++] = page;
+	}
+
+	return pool;
+
+error:
+	ffs_buf_pool_release(&pool->ref);
+	return NULL;
+}
+
+static struct page *ffs_buf_pool_page(struct ffs_buf_pool *pool,
+				      unsigned long off)
+{
+	return pool->pages[off / pool->size] +
+	       ((off % pool->size) >> PAGE_SHIFT);
+}
+
+static void ffs_buf_pool_vm_open(struct vm_area_struct *vma)
+{
+	struct ffs_buf_pool *pool = vma->vm_private_data;
+
+	kref_get(&pool->ref);
+}
+
+static void ffs_buf_pool_vm_close(struct vm_area_struct *vma)
+{
+	ffs_buf_pool_put(vma->vm_private_data);
+}
+
+static const struct vm_operations_struct ffs_buf_pool_vm_ops = {
+	.open =		ffs_buf_pool_vm_open,
+	.close =	ffs_buf_pool_vm_close,
+};
+
+/*
+ * Claim the pool buffer an AIO's single iovec points into, if it does, so
+ * that the request is done on the buffer itself rather than on a copy.
+ * Called in the context of the submitter.
+ */
+static void ffs_epfile_buf_claim(struct ffs_epfile *epfile,
+				 struct ffs_io_data *io_data)
+{
+	struct iov_iter *iter = &io_data->data;
+	struct mm_struct *mm = current->mm;
+	struct vm_area_struct *vma;
+	struct ffs_buf_pool *pool;
+	unsigned long addr, off;
+	unsigned idx;
+
+	if (!iter_is_iovec(iter) || iter->nr_segs != 1 || !mm)
+		return;
+	addr = (unsigned long)iter->iov->iov_base + iter->iov_offset;
+
+	down_read(&mm->mmap_sem);
+	vma = find_vma(mm, addr);
+	if (!vma || vma->vm_start > addr ||
+	    vma->vm_ops != &ffs_buf_pool_vm_ops ||
+	    vma->vm_file->private_data != epfile)
+		goto out;
+
+	pool = vma->vm_private_data;
+	off = addr - vma->vm_start + (vma->vm_pgoff << PAGE_SHIFT);
+	idx = off / pool->size;
+	off %= pool->size;
+	if (iov_iter_count(iter) > pool->size - off)
+		goto out;
+
+	/* Two requests on one buffer: leave the second to the copying path */
+	if (test_and_set_bit(idx, pool->busy))
+		goto out;
+
+	kref_get(&pool->ref);
+	io_data->buf_pool = pool;
+	io_data->buf_idx = idx;
+	io_data->buf = page_address(pool->pages[idx]) + off;
+	io_data->buf_room = pool->size - off;
+out:
+	up_read(&mm->mmap_sem);
+}
+
+static void ffs_epfile_buf_release(struct ffs_io_data *io_data)
+{
+	struct ffs_buf_pool *pool = io_data->buf_pool;
+
+	clear_bit(io_data->buf_idx, pool->busy);
+	ffs_buf_pool_put(pool);
+	io_data->buf_pool = NULL;
+}
+
 static void ffs_epfile_io_complete(struct usb_ep *_ep, struct usb_request *req)
 {
 	ENTER();
@@ -758,7 +916,10 @@ static void ffs_user_copy_worker(struct work_struct *work)
 					 io_data->req->actual;
 	bool kiocb_has_eventfd = io_data->kiocb->ki_flags & IOCB_EVENTFD;
 
-	if (io_data->read && ret > 0) {
+	if (io_data->read && ret > 0 && io_data->buf_pool) {
+		/* The data is in place, past the end of the iovec if too long */
+		ret = min_t(int, ret, iov_iter_count(&io_data->data));
+	} else if (io_data->read && ret > 0) {
 		use_mm(io_data->mm);
 		ret = ffs_copy_to_iter(io_data->buf, ret, &io_data->data);
 		unuse_mm(io_data->mm);
@@ -773,7 +934,10 @@ static void ffs_user_copy_worker(struct work_struct *work)
 
 	if (io_data->read)
 		kfree(io_data->to_free);
-	kfree(io_data->buf);
+	if (io_data->buf_pool)
+		ffs_epfile_buf_release(io_data);
+	else
+		kfree(io_data->buf);
 	kfree(io_data);
 }
 
@@ -901,6 +1065,9 @@ static ssize_t ffs_epfile_io(struct file *file, struct ffs_io_data *io_data)
 	if (halt && epfile->isoc)
 		return -EINVAL;
 
+	if (io_data->aio && !halt)
+		ffs_epfile_buf_claim(epfile, io_data);
+
 	/* We will be using request and read_buffer */
 	ret = ffs_mutex_lock(&epfile->mutex, file->f_flags & O_NONBLOCK);
 	if (unlikely(ret))
@@ -945,6 +1112,13 @@ static ssize_t ffs_epfile_io(struct file *file, struct ffs_io_data *io_data)
 			data_len = usb_ep_align_maybe(gadget, ep->ep, data_len);
 		spin_unlock_irq(&epfile->ffs->eps_lock);
 
+		if (io_data->buf_pool && data_len > io_data->buf_room)
+			ffs_epfile_buf_release(io_data);
+		if (io_data->buf_pool) {
+			data = io_data->buf;
+			goto queue;
+		}
+
 		data = kmalloc(data_len, GFP_KERNEL);
 		if (unlikely(!data)) {
 			ret = -ENOMEM;
@@ -957,6 +1131,7 @@ static ssize_t ffs_epfile_io(struct file *file, struct ffs_io_data *io_data)
 		}
 	}
 
+queue:
 	spin_lock_irq(&epfile->ffs->eps_lock);
 
 	if (epfile->ep != ep) {
@@ -1049,7 +1224,10 @@ static ssize_t ffs_epfile_io(struct file *file, struct ffs_io_data *io_data)
 error_mutex:
 	mutex_unlock(&epfile->mutex);
 error:
-	kfree(data);
+	if (!io_data->buf_pool)
+		kfree(data);
+	else if (ret != -EIOCBQUEUED)
+		ffs_epfile_buf_release(io_data);
 	return ret;
 }
 
@@ -1109,6 +1287,7 @@ static ssize_t ffs_epfile_write_iter(struct kiocb *kiocb, struct iov_iter *from)
 	p->kiocb = kiocb;
 	p->data = *from;
 	p->mm = current->mm;
+	p->buf_pool = NULL;
 
 	kiocb->private = p;
 
@@ -1154,6 +1333,7 @@ static ssize_t ffs_epfile_read_iter(struct kiocb *kiocb, struct iov_iter *to)
 		p->to_free = NULL;
 	}
 	p->mm = current->mm;
+	p->buf_pool = NULL;
 
 	kiocb->private = p;
 
@@ -1186,6 +1366,82 @@ ffs_epfile_release(struct inode *inode, struct file *file)
 	return 0;
 }
 
+static int ffs_epfile_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct ffs_epfile *epfile = file->private_data;
+	struct ffs_buf_pool *pool;
+	unsigned long addr, off, end;
+	int ret = 0;
+
+	ENTER();
+
+	if (!(vma->vm_flags & VM_SHARED))
+		return -EINVAL;
+
+	spin_lock_irq(&epfile->ffs->eps_lock);
+	pool = epfile->buf_pool;
+	if (pool)
+		kref_get(&pool->ref);
+	spin_unlock_irq(&epfile->ffs->eps_lock);
+	if (!pool)
+		return -ENODEV;
+
+	off = vma->vm_pgoff << PAGE_SHIFT;
+	end = pool->count * pool->size;
+	if (vma->vm_pgoff >= end >> PAGE_SHIFT ||
+	    vma->vm_end - vma->vm_start > end - off) {
+		ret = -EINVAL;
+		goto error;
+	}
+
+	for (addr = vma->vm_start; addr < vma->vm_end; addr += PAGE_SIZE) {
+		ret = vm_insert_page(vma, addr, ffs_buf_pool_page(pool, off));
+		if (ret)
+			goto error;
+		off += PAGE_SIZE;
+	}
+
+	vma->vm_flags |= VM_DONTEXPAND;
+	vma->vm_private_data = pool;
+	vma->vm_ops = &ffs_buf_pool_vm_ops;
+	return 0;
+
+error:
+	ffs_buf_pool_put(pool);
+	return ret;
+}
+
+static long ffs_epfile_buffers_alloc(struct ffs_epfile *epfile,
+				     struct usb_functionfs_buffers __user *arg)
+{
+	struct usb_functionfs_buffers bufs;
+	struct ffs_buf_pool *pool = NULL, *old;
+
+	if (copy_from_user(&bufs, arg, sizeof(bufs)))
+		return -EFAULT;
+
+	if (bufs.count) {
+		if (!bufs.size || bufs.size > FFS_BUF_POOL_MAX_SIZE ||
+		    (u64)bufs.count * PAGE_ALIGN(bufs.size) >
+					FFS_BUF_POOL_MAX_BYTES)
+			return -EINVAL;
+
+		pool = ffs_buf_pool_alloc(bufs.count, bufs.size);
+		if (!pool)
+			return -ENOMEM;
+	}
+
+	/* Mappings and requests of the old pool keep it alive */
+	spin_lock_irq(&epfile->ffs->eps_lock);
+	old = epfile->buf_pool;
+	epfile->buf_pool = pool;
+	spin_unlock_irq(&epfile->ffs->eps_lock);
+
+	if (old)
+		ffs_buf_pool_put(old);
+	return 0;
+}
+
 static long ffs_epfile_ioctl(struct file *file, unsigned code,
 			     unsigned long value)
 {
@@ -1198,6 +1454,9 @@ static long ffs_epfile_ioctl(struct file *file, unsigned code,
 	if (WARN_ON(epfile->ffs->state != FFS_ACTIVE))
 		return -ENODEV;
 
+	if (code == FUNCTIONFS_BUFFERS_ALLOC)
+		return ffs_epfile_buffers_alloc(epfile, (void __user *)value);
+
 	/* Wait for endpoint to be enabled */
 	ep = epfile->ep;
 	if (!ep) {
@@ -1271,6 +1530,7 @@ static const struct file_operations ffs_epfile_operations = {
 	.read_iter =	ffs_epfile_read_iter,
 	.release =	ffs_epfile_release,
 	.unlocked_ioctl =	ffs_epfile_ioctl,
+	.mmap =		ffs_epfile_mmap,
 };
 
 
@@ -1812,6 +2072,8 @@ static void ffs_epfiles_destroy(struct ffs_epfile *epfiles, unsigned count)
 
 	for (; count; --count, ++epfile) {
 		BUG_ON(mutex_is_locked(&epfile->mutex));
+		if (epfile->buf_pool)
+			ffs_buf_pool_put(epfile->buf_pool);
 		if (epfile->dentry) {
 			d_delete(epfile->dentry);
 			dput(epfile->dentry);
@@ -609,6 +609,27 @@ static int sleep_thread(struct fsg_common *common, bool can_freeze,
 
 /*-------------------------------------------------------------------------*/
 
+/*
+ * Start reading @amount bytes of the backing file at @offset into the page
+ * cache without waiting for them, so that the storage is kept busy while
+ * the buffers already read are on the bus.
+ */
+static void fsg_lun_readahead(struct fsg_lun *curlun, loff_t offset,
+			      loff_t amount)
+{
+	struct file *filp = curlun->filp;
+	pgoff_t index, last;
+
+	amount = min(amount, curlun->file_length - offset);
+	if (amount <= 0 || (filp->f_flags & O_DIRECT))
+		return;
+
+	index = offset >> PAGE_SHIFT;
+	last = (offset + amount - 1) >> PAGE_SHIFT;
+	page_cache_sync_readahead(filp->f_mapping, &filp->f_ra, filp,
+				  index, last + 1 - index);
+}
+
 static int do_read(struct fsg_common *common)
 {
 	struct fsg_lun		*curlun = common->curlun;
@@ -650,6 +671,9 @@ static int do_read(struct fsg_common *common)
 	if (unlikely(amount_left == 0))
 		return -EIO;		/* No default reply */
 
+	/* Submit the whole command at once rather than a buffer at a time */
+	fsg_lun_readahead(curlun, file_offset, amount_left);
+
 	for (;;) {
 		/*
 		 * Figure out how much we need to read:
@@ -720,8 +744,16 @@ static int do_read(struct fsg_common *common)
 			break;
 		}
 
-		if (amount_left == 0)
+		if (amount_left == 0) {
+			/*
+			 * Hosts mostly read sequentially: fetch what the
+			 * next command is likely to ask for while this one's
+			 * last buffers are sent.
+			 */
+			fsg_lun_readahead(curlun, file_offset,
+					  common->data_size_from_cmnd);
 			break;		/* No more left to read */
+		}
 
 		/* Send this buffer and go read some more */
 		bh->inreq->zero = 0;
@@ -3278,7 +3310,6 @@ static ssize_t fsg_opts_stall_store(struct config_item *item, const char *page,
 
 CONFIGFS_ATTR(fsg_opts_, stall);
 
-#ifdef CONFIG_USB_GADGET_DEBUG_FILES
 static ssize_t fsg_opts_num_buffers_show(struct config_item *item, char *page)
 {
 	struct fsg_opts *opts = to_fsg_opts(item);
@@ -3307,8 +3338,14 @@ static ssize_t fsg_opts_num_buffers_store(struct config_item *item,
 	if (ret)
 		goto end;
 
-	fsg_common_set_num_buffers(opts->common, num);
-	ret = len;
+	if (num < 2) {
+		ret = -EINVAL;
+		goto end;
+	}
+
+	ret = fsg_common_set_num_buffers(opts->common, num);
+	if (!ret)
+		ret = len;
 
 end:
 	mutex_unlock(&opts->lock);
@@ -3316,13 +3353,10 @@ static ssize_t fsg_opts_num_buffers_store(struct config_item *item,
 }
 
 CONFIGFS_ATTR(fsg_opts_, num_buffers);
-#endif
 
 static struct configfs_attribute *fsg_attrs[] = {
 	&fsg_opts_attr_stall,
-#ifdef CONFIG_USB_GADGET_DEBUG_FILES
 	&fsg_opts_attr_num_buffers,
-#endif
 	NULL,
 };
 
@@ -30,6 +30,8 @@
 #include <linux/file.h>
 #include <linux/device.h>
 #include <linux/miscdevice.h>
+#include <linux/pagemap.h>
+#include <linux/scatterlist.h>
 
 #include <linux/usb.h>
 #include <linux/usb_usual.h>
@@ -41,6 +43,8 @@
 #include "configfs.h"
 
 #define MTP_BULK_BUFFER_SIZE       16384
+#define MTP_TX_BUFFER_INIT_SIZE    (1024 * 1024)
+#define MTP_RX_BUFFER_INIT_SIZE    (1024 * 1024)
 #define INTR_BUFFER_SIZE           28
 #define MAX_INST_NAME_LEN          40
 #define MTP_MAX_FILE_SIZE          0xFFFFFFFFL
@@ -55,11 +59,32 @@
 #define STATE_CANCELED              3   /* transaction canceled by host */
 #define STATE_ERROR                 4   /* error from completion routine */
 
-/* number of tx and rx requests to allocate */
-#define TX_REQ_MAX 4
-#define RX_REQ_MAX 2
+/* upper bounds on the number of tx and rx requests to allocate */
+#define TX_REQ_MAX 16
+#define RX_REQ_MAX 8
 #define INTR_REQ_MAX 5
 
+/*
+ * Size and number of the bulk requests, read when the function is bound.
+ * Requests of the size asked for that cannot be allocated fall back to
+ * MTP_BULK_BUFFER_SIZE.
+ */
+static unsigned int mtp_tx_req_len = MTP_TX_BUFFER_INIT_SIZE;
+module_param(mtp_tx_req_len, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_tx_req_len, "size of the bulk IN requests");
+
+static unsigned int mtp_tx_reqs = 8;
+module_param(mtp_tx_reqs, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_tx_reqs, "number of bulk IN requests, at most 16");
+
+static unsigned int mtp_rx_req_len = MTP_RX_BUFFER_INIT_SIZE;
+module_param(mtp_rx_req_len, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_rx_req_len, "size of the bulk OUT requests");
+
+static unsigned int mtp_rx_reqs = 4;
+module_param(mtp_rx_reqs, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_rx_reqs, "number of bulk OUT requests, at most 8");
+
 /* ID for Microsoft MTP OS String */
 #define MTP_OS_STRING_ID   0xEE
 
@@ -99,7 +124,13 @@ struct mtp_dev {
 	wait_queue_head_t write_wq;
 	wait_queue_head_t intr_wq;
 	struct usb_request *rx_req[RX_REQ_MAX];
+	/* number of rx requests completed, in order, since it was zeroed */
 	int rx_done;
+	unsigned rx_reqs;
+	unsigned rx_req_len;
+	unsigned tx_req_len;
+	/* entries of the scatterlist of a tx request, see mtp_map_file_pages */
+	unsigned tx_sg_ents;
 
 	/* for processing MTP_SEND_FILE, MTP_RECEIVE_FILE and
 	 * MTP_SEND_FILE_WITH_HEADER ioctls on a work queue
@@ -379,11 +410,28 @@ static struct usb_request *mtp_request_new(struct usb_ep *ep, int buffer_size)
 static void mtp_request_free(struct usb_request *req, struct usb_ep *ep)
 {
 	if (req) {
+		kfree(req->sg);
 		kfree(req->buf);
 		usb_ep_free_request(ep, req);
 	}
 }
 
+/*
+ * Allocate a bulk request of *len bytes, or of MTP_BULK_BUFFER_SIZE if
+ * that fails, in which case *len is lowered for the requests that follow.
+ */
+static struct usb_request *mtp_request_new_bulk(struct usb_ep *ep,
+						unsigned *len)
+{
+	struct usb_request *req = mtp_request_new(ep, *len);
+
+	if (!req && *len > MTP_BULK_BUFFER_SIZE) {
+		*len = MTP_BULK_BUFFER_SIZE;
+		req = mtp_request_new(ep, *len);
+	}
+	return req;
+}
+
 static inline int mtp_lock(atomic_t *excl)
 {
 	if (atomic_inc_return(excl) == 1) {
@@ -428,6 +476,105 @@ static struct usb_request
 	return req;
 }
 
+/*
+ * Point the scatterlist of @req at up to @len bytes of @filp from @offset,
+ * behind the @hdr_size bytes of header already in req->buf, and take a
+ * reference on each page until mtp_unmap_file_pages().
+ *
+ * The page cache only holds the file data on block based filesystems:
+ * FUSE and stacked ones, and the gadgets that can't do scatter-gather,
+ * return 0 and the caller copies the file with vfs_read() instead.
+ *
+ * Returns the number of file bytes mapped.
+ */
+static int mtp_map_file_pages(struct mtp_dev *dev, struct usb_request *req,
+			      struct file *filp, loff_t offset, int len,
+			      int hdr_size)
+{
+	struct address_space *mapping = filp->f_mapping;
+	struct inode *inode = mapping->host;
+	struct scatterlist *sg = req->sg;
+	pgoff_t index, last;
+	loff_t isize;
+	int done = 0, nents = 0;
+
+	if (!sg || !mapping->a_ops->readpage || IS_DAX(inode) ||
+	    !(inode->i_sb->s_type->fs_flags & FS_REQUIRES_DEV))
+		return 0;
+
+	isize = i_size_read(inode);
+	if (offset >= isize || len <= 0)
+		return 0;
+	if (len > isize - offset)
+		len = isize - offset;
+
+	sg_init_table(sg, dev->tx_sg_ents);
+	if (hdr_size)
+		sg_set_buf(&sg[nents++], req->buf, hdr_size);
+
+	index = offset >> PAGE_SHIFT;
+	last = (offset + len - 1) >> PAGE_SHIFT;
+	while (done < len && nents < dev->tx_sg_ents) {
+		unsigned int poff = offset & ~PAGE_MASK;
+		unsigned int plen = min_t(unsigned int, PAGE_SIZE - poff,
+					  len - done);
+		struct page *page;
+
+		page = find_get_page(mapping, index);
+		if (!page) {
+			page_cache_sync_readahead(mapping, &filp->f_ra, filp,
+						  index, last + 1 - index);
+		} else {
+			if (PageReadahead(page))
+				page_cache_async_readahead(mapping, &filp->f_ra,
+						filp, page, index,
+						last + 1 - index);
+			if (PageUptodate(page))
+				goto got_page;
+			put_page(page);
+		}
+		/* Either waits for the readahead or reads the page itself */
+		page = read_mapping_page(mapping, index, filp);
+		if (IS_ERR(page))
+			break;
+got_page:
+		sg_set_page(&sg[nents++], page, plen, poff);
+		done += plen;
+		offset += plen;
+		index++;
+	}
+
+	if (!done)
+		return 0;
+
+	sg_mark_end(&sg[nents - 1]);
+	req->num_sgs = nents;
+	return done;
+}
+
+static void mtp_unmap_file_pages(struct usb_request *req)
+{
+	struct scatterlist *sg;
+	int i;
+
+	for_each_sg(req->sg, sg, req->num_sgs, i) {
+		/* the header lives in req->buf */
+		if (sg_virt(sg) != req->buf)
+			put_page(sg_page(sg));
+	}
+	req->num_sgs = 0;
+}
+
+/* Get an idle tx request, with the file pages of its last send released */
+static struct usb_request *mtp_tx_req_get(struct mtp_dev *dev)
+{
+	struct usb_request *req = mtp_req_get(dev, &dev->tx_idle);
+
+	if (req)
+		mtp_unmap_file_pages(req);
+	return req;
+}
+
 static void mtp_complete_in(struct usb_ep *ep, struct usb_request *req)
 {
 	struct mtp_dev *dev = _mtp_dev;
@@ -444,8 +591,10 @@ static void mtp_complete_out(struct usb_ep *ep, struct usb_request *req)
 {
 	struct mtp_dev *dev = _mtp_dev;
 
-	dev->rx_done = 1;
-	if (req->status != 0)
+	/* Requests complete in the order they were queued */
+	dev->rx_done++;
+	/* A request we dequeued ourselves isn't an error */
+	if (req->status != 0 && req->status != -ECONNRESET)
 		dev->state = STATE_ERROR;
 
 	wake_up(&dev->read_wq);
@@ -503,15 +652,27 @@ static int mtp_create_bulk_endpoints(struct mtp_dev *dev,
 	dev->ep_intr = ep;
 
 	/* now allocate requests for our endpoints */
-	for (i = 0; i < TX_REQ_MAX; i++) {
-		req = mtp_request_new(dev->ep_in, MTP_BULK_BUFFER_SIZE);
+	dev->tx_req_len = max_t(unsigned, mtp_tx_req_len, MTP_BULK_BUFFER_SIZE);
+	/* OUT requests must be a multiple of maxpacket */
+	dev->rx_req_len = round_down(max_t(unsigned, mtp_rx_req_len,
+					   MTP_BULK_BUFFER_SIZE), 1024);
+	dev->rx_reqs = clamp_t(unsigned, mtp_rx_reqs, 1, RX_REQ_MAX);
+	/* the header, and the file pages of an unaligned tx_req_len */
+	dev->tx_sg_ents = dev->tx_req_len / PAGE_SIZE + 3;
+
+	for (i = 0; i < clamp_t(unsigned, mtp_tx_reqs, 1, TX_REQ_MAX); i++) {
+		req = mtp_request_new_bulk(dev->ep_in, &dev->tx_req_len);
 		if (!req)
 			goto fail;
 		req->complete = mtp_complete_in;
+		/* Without a scatterlist, sends go through vfs_read() */
+		if (cdev->gadget->sg_supported)
+			req->sg = kmalloc_array(dev->tx_sg_ents,
+						sizeof(*req->sg), GFP_KERNEL);
 		mtp_req_put(dev, &dev->tx_idle, req);
 	}
-	for (i = 0; i < RX_REQ_MAX; i++) {
-		req = mtp_request_new(dev->ep_out, MTP_BULK_BUFFER_SIZE);
+	for (i = 0; i < dev->rx_reqs; i++) {
+		req = mtp_request_new_bulk(dev->ep_out, &dev->rx_req_len);
 		if (!req)
 			goto fail;
 		req->complete = mtp_complete_out;
@@ -556,7 +717,7 @@ static ssize_t mtp_read(struct file *fp, char __user *buf,
 	spin_lock_irq(&dev->lock);
 	if (dev->ep_out->desc) {
 		len = usb_ep_align_maybe(cdev->gadget, dev->ep_out, count);
-		if (len > MTP_BULK_BUFFER_SIZE) {
+		if (len > dev->rx_req_len) {
 			spin_unlock_irq(&dev->lock);
 			return -EINVAL;
 		}
@@ -663,15 +824,15 @@ static ssize_t mtp_write(struct file *fp, const char __user *buf,
 		/* get an idle tx request to use */
 		req = 0;
 		ret = wait_event_interruptible(dev->write_wq,
-			((req = mtp_req_get(dev, &dev->tx_idle))
+			((req = mtp_tx_req_get(dev))
 				|| dev->state != STATE_BUSY));
 		if (!req) {
 			r = ret;
 			break;
 		}
 
-		if (count > MTP_BULK_BUFFER_SIZE)
-			xfer = MTP_BULK_BUFFER_SIZE;
+		if (count > dev->tx_req_len)
+			xfer = dev->tx_req_len;
 		else
 			xfer = count;
 		if (xfer && copy_from_user(req->buf, buf, xfer)) {
@@ -752,7 +913,7 @@ static void send_file_work(struct work_struct *data)
 		/* get an idle tx request to use */
 		req = 0;
 		ret = wait_event_interruptible(dev->write_wq,
-			(req = mtp_req_get(dev, &dev->tx_idle))
+			(req = mtp_tx_req_get(dev))
 			|| dev->state != STATE_BUSY);
 		if (dev->state == STATE_CANCELED) {
 			r = -ECANCELED;
@@ -763,8 +924,8 @@ static void send_file_work(struct work_struct *data)
 			break;
 		}
 
-		if (count > MTP_BULK_BUFFER_SIZE)
-			xfer = MTP_BULK_BUFFER_SIZE;
+		if (count > dev->tx_req_len)
+			xfer = dev->tx_req_len;
 		else
 			xfer = count;
 
@@ -783,8 +944,13 @@ static void send_file_work(struct work_struct *data)
 					__cpu_to_le32(dev->xfer_transaction_id);
 		}
 
-		ret = vfs_read(filp, req->buf + hdr_size, xfer - hdr_size,
-								&offset);
+		ret = mtp_map_file_pages(dev, req, filp, offset,
+					 xfer - hdr_size, hdr_size);
+		if (ret > 0)
+			offset += ret;
+		else
+			ret = vfs_read(filp, req->buf + hdr_size,
+				       xfer - hdr_size, &offset);
 		if (ret < 0) {
 			r = ret;
 			break;
@@ -816,17 +982,23 @@ static void send_file_work(struct work_struct *data)
 	smp_wmb();
 }
 
-/* read from USB and write to a local file */
+/*
+ * read from USB and write to a local file
+ *
+ * Up to rx_reqs requests are kept queued, so that the host keeps sending
+ * while the data of the oldest one is written out.
+ */
 static void receive_file_work(struct work_struct *data)
 {
 	struct mtp_dev *dev = container_of(data, struct mtp_dev,
 						receive_file_work);
 	struct usb_composite_dev *cdev = dev->cdev;
-	struct usb_request *read_req = NULL, *write_req = NULL;
+	struct usb_request *req;
 	struct file *filp;
 	loff_t offset;
-	int64_t count;
-	int ret, len, cur_buf = 0;
+	int64_t count, queued = 0;
+	unsigned head = 0, tail = 0, inflight = 0, done = 0, max_inflight;
+	int ret, len, i;
 	int r = 0;
 
 	/* read our parameters */
@@ -837,72 +1009,90 @@ static void receive_file_work(struct work_struct *data)
 
 	DBG(cdev, "receive_file_work(%lld)\n", count);
 
-	while (count > 0 || write_req) {
-		if (count > 0) {
-			/* queue a request */
-			read_req = dev->rx_req[cur_buf];
-			cur_buf = (cur_buf + 1) % RX_REQ_MAX;
+	/*
+	 * if xfer_file_length is 0xFFFFFFFF, then we read until we get a
+	 * short packet, and a request queued past it would eat the next
+	 * command: only pipeline transfers of a known length.
+	 */
+	max_inflight = (count == 0xFFFFFFFF) ? 1 : dev->rx_reqs;
 
-			len = ALIGN(count, dev->ep_out->maxpacket);
-			if (len > MTP_BULK_BUFFER_SIZE)
-				len = MTP_BULK_BUFFER_SIZE;
-			read_req->length = len;
+	dev->rx_done = 0;
+	while (count > 0) {
+		while (inflight < max_inflight &&
+		       (count == 0xFFFFFFFF || queued < count)) {
+			/* queue a request */
+			req = dev->rx_req[head];
 
-			dev->rx_done = 0;
-			ret = usb_ep_queue(dev->ep_out, read_req, GFP_KERNEL);
+			if (count == 0xFFFFFFFF)
+				len = dev->rx_req_len;
+			else
+				len = ALIGN(min_t(int64_t, count - queued,
+						  dev->rx_req_len),
+					    dev->ep_out->maxpacket);
+			if (len > dev->rx_req_len)
+				len = dev->rx_req_len;
+			req->length = len;
+
+			ret = usb_ep_queue(dev->ep_out, req, GFP_KERNEL);
 			if (ret < 0) {
 				r = -EIO;
 				dev->state = STATE_ERROR;
-				break;
+				goto drain;
 			}
+			head = (head + 1) % dev->rx_reqs;
+			queued += len;
+			inflight++;
 		}
 
-		if (write_req) {
-			DBG(cdev, "rx %p %d\n", write_req, write_req->actual);
-			ret = vfs_write(filp, write_req->buf, write_req->actual,
-				&offset);
-			DBG(cdev, "vfs_write %d\n", ret);
-			if (ret != write_req->actual) {
-				r = -EIO;
-				dev->state = STATE_ERROR;
-				break;
-			}
-			write_req = NULL;
+		/* wait for the oldest read to complete */
+		req = dev->rx_req[tail];
+		ret = wait_event_interruptible(dev->read_wq,
+			dev->rx_done > done || dev->state != STATE_BUSY);
+		if (dev->state == STATE_CANCELED) {
+			r = -ECANCELED;
+			goto drain;
 		}
-
-		if (read_req) {
-			/* wait for our last read to complete */
-			ret = wait_event_interruptible(dev->read_wq,
-				dev->rx_done || dev->state != STATE_BUSY);
-			if (dev->state == STATE_CANCELED) {
-				r = -ECANCELED;
-				if (!dev->rx_done)
-					usb_ep_dequeue(dev->ep_out, read_req);
-				break;
-			}
-			if (read_req->status) {
-				r = read_req->status;
-				break;
-			}
-			/* if xfer_file_length is 0xFFFFFFFF, then we read until
-			 * we get a zero length packet
+		if (dev->rx_done <= done) {
+			r = ret ? ret : -EIO;
+			goto drain;
+		}
+		tail = (tail + 1) % dev->rx_reqs;
+		queued -= req->length;
+		inflight--;
+		done++;
+
+		if (req->status) {
+			r = req->status;
+			goto drain;
+		}
+		if (count != 0xFFFFFFFF)
+			count -= req->actual;
+		if (req->actual < req->length) {
+			/*
+			 * short packet is used to signal EOF for
+			 * sizes > 4 gig
 			 */
-			if (count != 0xFFFFFFFF)
-				count -= read_req->actual;
-			if (read_req->actual < read_req->length) {
-				/*
-				 * short packet is used to signal EOF for
-				 * sizes > 4 gig
-				 */
-				DBG(cdev, "got short packet\n");
-				count = 0;
-			}
+			DBG(cdev, "got short packet\n");
+			count = 0;
+		}
 
-			write_req = read_req;
-			read_req = NULL;
+		DBG(cdev, "rx %p %d\n", req, req->actual);
+		ret = vfs_write(filp, req->buf, req->actual, &offset);
+		DBG(cdev, "vfs_write %d\n", ret);
+		if (ret != req->actual) {
+			r = -EIO;
+			dev->state = STATE_ERROR;
+			goto drain;
 		}
 	}
 
+drain:
+	/* a transfer cut short leaves requests that must not outlive it */
+	for (i = 0; i < inflight; i++)
+		usb_ep_dequeue(dev->ep_out,
+			       dev->rx_req[(tail + i) % dev->rx_reqs]);
+	wait_event(dev->read_wq, dev->rx_done >= done + inflight);
+
 	DBG(cdev, "receive_file_work returning %d\n", r);
 	/* write the result */
 	dev->xfer_result = r;
@@ -1253,10 +1443,12 @@ mtp_function_unbind(struct usb_configuration *c, struct usb_function *f)
 	int i;
 
 	mtp_string_defs[INTERFACE_STRING_INDEX].id = 0;
-	while ((req = mtp_req_get(dev, &dev->tx_idle)))
+	while ((req = mtp_tx_req_get(dev)))
 		mtp_request_free(req, dev->ep_in);
-	for (i = 0; i < RX_REQ_MAX; i++)
+	for (i = 0; i < RX_REQ_MAX; i++) {
 		mtp_request_free(dev->rx_req[i], dev->ep_out);
+		dev->rx_req[i] = NULL;
+	}
 	while ((req = mtp_req_get(dev, &dev->intr_idle)))
 		mtp_request_free(req, dev->ep_intr);
 	dev->state = STATE_OFFLINE;
@@ -461,6 +461,10 @@ static void rndis_command_complete(struct usb_ep *ep, struct usb_request *req)
 		pr_err("RNDIS command error %d, %d/%d\n",
 			status, req->actual, req->length);
 //	spin_unlock(&dev->lock);
+
+	/* the host's INITIALIZE message sets how many packets it takes */
+	rndis->port.dl_max_pkts_per_xfer = rndis->params->dl_max_pkt_per_xfer;
+	rndis->port.dl_max_xfer_size = rndis->params->dl_max_xfer_size;
 }
 
 static int
@@ -593,6 +597,12 @@ static int rndis_set_alt(struct usb_function *f, unsigned intf, unsigned alt)
 		 */
 		rndis->port.cdc_filter = 0;
 
+		/* OUT requests are sized before the host's INITIALIZE */
+		rndis->port.ul_max_pkts_per_xfer =
+				rndis->params->ul_max_pkt_per_xfer;
+		rndis->port.dl_max_pkts_per_xfer = 0;
+		rndis->port.dl_max_xfer_size = 0;
+
 		DBG(cdev, "RNDIS RX/TX early activation ... \n");
 		net = gether_connect(&rndis->port);
 		if (IS_ERR(net))
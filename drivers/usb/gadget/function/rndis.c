@@ -58,6 +58,20 @@ MODULE_PARM_DESC (rndis_debug, "enable debugging");
 #define rndis_debug		0
 #endif
 
+/*
+ * Packets per transfer, each way.  The host's INITIALIZE message bounds
+ * the device to host transfers; 1 turns batching off.
+ */
+static unsigned int rndis_ul_max_pkt_per_xfer = 3;
+module_param(rndis_ul_max_pkt_per_xfer, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(rndis_ul_max_pkt_per_xfer,
+		 "Maximum packets per transfer from the host");
+
+static unsigned int rndis_dl_max_pkt_per_xfer = 10;
+module_param(rndis_dl_max_pkt_per_xfer, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(rndis_dl_max_pkt_per_xfer,
+		 "Maximum packets per transfer to the host");
+
 #ifdef CONFIG_USB_GADGET_DEBUG_FILES
 
 #define	NAME_TEMPLATE "driver/rndis-%03d"
@@ -560,10 +574,20 @@ static int rndis_init_response(struct rndis_params *params,
 {
 	rndis_init_cmplt_type *resp;
 	rndis_resp_t *r;
+	u32 pkt_len, host_max;
 
 	if (!params->dev)
 		return -ENOTSUPP;
 
+	/* Largest packet message, as built by rndis_add_hdr() */
+	pkt_len = params->dev->mtu + sizeof(struct ethhdr) +
+		  sizeof(struct rndis_packet_msg_type);
+	host_max = le32_to_cpu(buf->MaxTransferSize);
+	params->dl_max_pkt_per_xfer = clamp_t(u32, host_max / pkt_len, 1,
+					      max(rndis_dl_max_pkt_per_xfer, 1U));
+	params->dl_max_xfer_size = min(host_max,
+				       params->dl_max_pkt_per_xfer * pkt_len);
+
 	r = rndis_add_response(params, sizeof(rndis_init_cmplt_type));
 	if (!r)
 		return -ENOMEM;
@@ -577,12 +601,12 @@ static int rndis_init_response(struct rndis_params *params,
 	resp->MinorVersion = cpu_to_le32(RNDIS_MINOR_VERSION);
 	resp->DeviceFlags = cpu_to_le32(RNDIS_DF_CONNECTIONLESS);
 	resp->Medium = cpu_to_le32(RNDIS_MEDIUM_802_3);
-	resp->MaxPacketsPerTransfer = cpu_to_le32(1);
-	resp->MaxTransferSize = cpu_to_le32(
+	resp->MaxPacketsPerTransfer = cpu_to_le32(params->ul_max_pkt_per_xfer);
+	resp->MaxTransferSize = cpu_to_le32(params->ul_max_pkt_per_xfer * (
 		  params->dev->mtu
 		+ sizeof(struct ethhdr)
 		+ sizeof(struct rndis_packet_msg_type)
-		+ 22);
+		+ 22));
 	resp->PacketAlignmentFactor = cpu_to_le32(0);
 	resp->AFListOffset = cpu_to_le32(0);
 	resp->AFListSize = cpu_to_le32(0);
@@ -771,6 +795,8 @@ void rndis_uninit(struct rndis_params *params)
 	if (!params)
 		return;
 	params->state = RNDIS_UNINITIALIZED;
+	params->dl_max_pkt_per_xfer = 0;
+	params->dl_max_xfer_size = 0;
 
 	/* drain the response queue */
 	while ((buf = rndis_get_next_response(params, &length)))
@@ -918,6 +944,7 @@ struct rndis_params *rndis_register(void (*resp_avail)(void *v), void *v)
 	params->media_state = RNDIS_MEDIA_STATE_DISCONNECTED;
 	params->resp_avail = resp_avail;
 	params->v = v;
+	params->ul_max_pkt_per_xfer = max(rndis_ul_max_pkt_per_xfer, 1U);
 	INIT_LIST_HEAD(&params->resp_queue);
 	pr_debug("%s: configNr = %d\n", __func__, i);
 
@@ -1055,30 +1082,66 @@ static rndis_resp_t *rndis_add_response(struct rndis_params *params, u32 length)
 	return r;
 }
 
+/*
+ * A transfer holds up to ul_max_pkt_per_xfer packet messages, back to
+ * back: all but the last are split off as clones sharing its data.
+ */
 int rndis_rm_hdr(struct gether *port,
 			struct sk_buff *skb,
 			struct sk_buff_head *list)
 {
-	/* tmp points to a struct rndis_packet_msg_type */
-	__le32 *tmp = (void *)skb->data;
+	struct sk_buff *skb2;
+	u32 msg_len, data_offset, data_len;
+	int status;
+
+	for (;;) {
+		/* tmp points to a struct rndis_packet_msg_type */
+		__le32 *tmp = (void *)skb->data;
+
+		status = -EOVERFLOW;
+		if (skb->len < sizeof(struct rndis_packet_msg_type))
+			goto err;
+
+		/* MessageType, MessageLength */
+		status = -EINVAL;
+		if (cpu_to_le32(RNDIS_MSG_PACKET)
+				!= get_unaligned(tmp++))
+			goto err;
+		msg_len = get_unaligned_le32(tmp++);
+
+		/* DataOffset, DataLength */
+		data_offset = get_unaligned_le32(tmp++) + 8;
+		data_len = get_unaligned_le32(tmp++);
+
+		status = -EOVERFLOW;
+		if (data_offset > skb->len || data_len > skb->len - data_offset)
+			goto err;
+
+		/* The last message may be padded up to the short packet */
+		if (msg_len < data_offset + data_len ||
+		    msg_len > skb->len - sizeof(struct rndis_packet_msg_type))
+			break;
 
-	/* MessageType, MessageLength */
-	if (cpu_to_le32(RNDIS_MSG_PACKET)
-			!= get_unaligned(tmp++)) {
-		dev_kfree_skb_any(skb);
-		return -EINVAL;
-	}
-	tmp++;
+		skb2 = skb_clone(skb, GFP_ATOMIC);
+		status = -ENOMEM;
+		if (!skb2)
+			goto err;
+		skb_pull(skb2, data_offset);
+		skb_trim(skb2, data_len);
+		skb_queue_tail(list, skb2);
 
-	/* DataOffset, DataLength */
-	if (!skb_pull(skb, get_unaligned_le32(tmp++) + 8)) {
-		dev_kfree_skb_any(skb);
-		return -EOVERFLOW;
+		skb_pull(skb, msg_len);
 	}
-	skb_trim(skb, get_unaligned_le32(tmp++));
+
+	skb_pull(skb, data_offset);
+	skb_trim(skb, data_len);
 
 	skb_queue_tail(list, skb);
 	return 0;
+
+err:
+	dev_kfree_skb_any(skb);
+	return status;
 }
 EXPORT_SYMBOL_GPL(rndis_rm_hdr);
 
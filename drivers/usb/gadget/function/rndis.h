@@ -177,6 +177,12 @@ typedef struct rndis_params {
 	void			(*resp_avail)(void *v);
 	void			*v;
 	struct list_head	resp_queue;
+
+	/* packets per transfer from the host, told in INITIALIZE_CMPLT */
+	u32			ul_max_pkt_per_xfer;
+	/* and to the host, within its INITIALIZE MaxTransferSize */
+	u32			dl_max_pkt_per_xfer;
+	u32			dl_max_xfer_size;
 } rndis_params;
 
 /* RNDIS Message parser and other useless functions */
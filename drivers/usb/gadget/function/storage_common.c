@@ -18,9 +18,9 @@
  */
 
 /*
- * When USB_GADGET_DEBUG_FILES is defined the module param num_buffers
- * sets the number of pipeline buffers (length of the fsg_buffhd array).
- * The valid range of num_buffers is: num >= 2 && num <= 4.
+ * The num_buffers configfs attribute, and the module param num_buffers
+ * when USB_GADGET_DEBUG_FILES is defined, set the number of pipeline
+ * buffers (length of the fsg_buffhd array).  At least 2 are needed.
  */
 
 #include <linux/module.h>
@@ -62,10 +62,14 @@ struct eth_dev {
 	struct net_device	*net;
 	struct usb_gadget	*gadget;
 
-	spinlock_t		req_lock;	/* guard {rx,tx}_reqs */
+	spinlock_t		req_lock;	/* guard {rx,tx}_reqs, tx_skb_hold */
 	struct list_head	tx_reqs, rx_reqs;
 	atomic_t		tx_qlen;
 
+	/* packets held back for the next IN transfer, see eth_tx_aggregate */
+	struct sk_buff		*tx_skb_hold;
+	unsigned		tx_skb_hold_pkts;
+
 	struct sk_buff_head	rx_frames;
 
 	unsigned		qmult;
@@ -210,6 +214,8 @@ rx_submit(struct eth_dev *dev, struct usb_request *req, gfp_t gfp_flags)
 	 */
 	size += sizeof(struct ethhdr) + dev->net->mtu + RX_EXTRA;
 	size += dev->port_usb->header_len;
+	if (dev->port_usb->ul_max_pkts_per_xfer > 1)
+		size *= dev->port_usb->ul_max_pkts_per_xfer;
 
 	if (g->quirk_ep_out_aligned_size) {
 		size += out->maxpacket - 1;
@@ -437,6 +443,80 @@ static void eth_work(struct work_struct *work)
 		DBG(dev, "work done, flags = 0x%lx\n", dev->todo);
 }
 
+static void tx_complete(struct usb_ep *ep, struct usb_request *req);
+
+static int eth_tx_submit(struct eth_dev *dev, struct usb_ep *in,
+			 struct usb_request *req, struct sk_buff *skb)
+{
+	int	length = skb->len;
+	int	retval;
+
+	req->buf = skb->data;
+	req->context = skb;
+	req->complete = tx_complete;
+
+	/* NCM requires no zlp if transfer is dwNtbInMaxSize */
+	if (dev->port_usb &&
+	    dev->port_usb->is_fixed &&
+	    length == dev->port_usb->fixed_in_len &&
+	    (length % in->maxpacket) == 0)
+		req->zero = 0;
+	else
+		req->zero = 1;
+
+	/* use zlp framing on tx for strict CDC-Ether conformance,
+	 * though any robust network rx path ignores extra padding.
+	 * and some hardware doesn't like to write zlps.
+	 */
+	if (req->zero && !dev->zlp && (length % in->maxpacket) == 0)
+		length++;
+
+	req->length = length;
+
+	retval = usb_ep_queue(in, req, GFP_ATOMIC);
+	switch (retval) {
+	default:
+		DBG(dev, "tx queue err %d\n", retval);
+		break;
+	case 0:
+		netif_trans_update(dev->net);
+		atomic_inc(&dev->tx_qlen);
+	}
+	return retval;
+}
+
+/* Send the packets held back by eth_tx_aggregate(), if any */
+static void eth_tx_flush(struct eth_dev *dev, struct usb_ep *in)
+{
+	struct usb_request	*req;
+	struct sk_buff		*skb;
+	unsigned long		flags;
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	skb = dev->tx_skb_hold;
+	if (!skb || list_empty(&dev->tx_reqs)) {
+		spin_unlock_irqrestore(&dev->req_lock, flags);
+		return;
+	}
+	dev->tx_skb_hold = NULL;
+
+	req = list_first_entry(&dev->tx_reqs, struct usb_request, list);
+	list_del(&req->list);
+	if (list_empty(&dev->tx_reqs))
+		netif_stop_queue(dev->net);
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
+	if (eth_tx_submit(dev, in, req, skb)) {
+		dev_kfree_skb_any(skb);
+		dev->net->stats.tx_dropped++;
+		spin_lock_irqsave(&dev->req_lock, flags);
+		if (list_empty(&dev->tx_reqs))
+			netif_start_queue(dev->net);
+		list_add(&req->list, &dev->tx_reqs);
+		spin_unlock_irqrestore(&dev->req_lock, flags);
+	}
+}
+
 static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 {
 	struct sk_buff	*skb = req->context;
@@ -462,8 +542,12 @@ static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 	spin_unlock(&dev->req_lock);
 
 	atomic_dec(&dev->tx_qlen);
-	if (netif_carrier_ok(dev->net))
+	if (netif_carrier_ok(dev->net)) {
+		/* packets held back while this transfer was in flight */
+		if (dev->tx_skb_hold)
+			eth_tx_flush(dev, ep);
 		netif_wake_queue(dev->net);
+	}
 }
 
 static inline int is_promisc(u16 cdc_filter)
@@ -471,21 +555,102 @@ static inline int is_promisc(u16 cdc_filter)
 	return cdc_filter & USB_CDC_PACKET_TYPE_PROMISCUOUS;
 }
 
+/*
+ * Start packing packets, already wrapped, into one IN transfer.  Returns
+ * @skb itself when it can't be copied into a transfer of @max_len bytes.
+ */
+static struct sk_buff *eth_tx_agg_start(struct eth_dev *dev,
+					struct sk_buff *skb, unsigned max_len)
+{
+	struct sk_buff	*agg;
+
+	dev->tx_skb_hold_pkts = 0;
+	if (skb->len >= max_len)
+		return skb;
+
+	agg = alloc_skb(max_len, GFP_ATOMIC);
+	if (!agg)
+		return skb;
+
+	skb_put_data(agg, skb->data, skb->len);
+	dev_consume_skb_any(skb);
+	dev->tx_skb_hold_pkts = 1;
+	return agg;
+}
+
+/*
+ * For hosts that take several packets per transfer: while a transfer is
+ * in flight, copy @skb into the one being built rather than queueing a
+ * transfer of its own, and let tx_complete() send it.  An idle link
+ * sends right away, so only a busy one trades latency for fewer, larger
+ * transfers.
+ *
+ * Returns the skb to send now, or NULL if it is held back.
+ */
+static struct sk_buff *eth_tx_aggregate(struct eth_dev *dev,
+					struct sk_buff *skb,
+					unsigned max_pkts, unsigned max_len)
+{
+	struct sk_buff	*agg;
+	unsigned long	flags;
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	agg = dev->tx_skb_hold;
+	dev->tx_skb_hold = NULL;
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
+	if (!agg) {
+		if (!atomic_read(&dev->tx_qlen))
+			return skb;
+		agg = eth_tx_agg_start(dev, skb, max_len);
+	} else if (dev->tx_skb_hold_pkts &&
+		   dev->tx_skb_hold_pkts < max_pkts &&
+		   skb_tailroom(agg) >= skb->len) {
+		skb_put_data(agg, skb->data, skb->len);
+		dev_consume_skb_any(skb);
+		dev->net->stats.tx_packets++;
+		if (++dev->tx_skb_hold_pkts >= max_pkts)
+			return agg;
+	} else {
+		/*
+		 * Send what was held and hold @skb instead: the transfer
+		 * queued now will flush it.
+		 */
+		spin_lock_irqsave(&dev->req_lock, flags);
+		dev->tx_skb_hold = eth_tx_agg_start(dev, skb, max_len);
+		spin_unlock_irqrestore(&dev->req_lock, flags);
+		return agg;
+	}
+
+	/* Hold back only while a completion is still to come */
+	spin_lock_irqsave(&dev->req_lock, flags);
+	if (atomic_read(&dev->tx_qlen)) {
+		dev->tx_skb_hold = agg;
+		agg = NULL;
+	}
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+	return agg;
+}
+
 static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 					struct net_device *net)
 {
 	struct eth_dev		*dev = netdev_priv(net);
-	int			length = 0;
 	int			retval;
 	struct usb_request	*req = NULL;
 	unsigned long		flags;
 	struct usb_ep		*in;
 	u16			cdc_filter;
+	unsigned		max_pkts = 0, max_len = 0;
 
 	spin_lock_irqsave(&dev->lock, flags);
 	if (dev->port_usb) {
 		in = dev->port_usb->in_ep;
 		cdc_filter = dev->port_usb->cdc_filter;
+		if (!dev->port_usb->supports_multi_frame) {
+			max_pkts = dev->port_usb->dl_max_pkts_per_xfer;
+			max_len = dev->port_usb->dl_max_xfer_size;
+		}
 	} else {
 		in = NULL;
 		cdc_filter = 0;
@@ -560,39 +725,13 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 		}
 	}
 
-	length = skb->len;
-	req->buf = skb->data;
-	req->context = skb;
-	req->complete = tx_complete;
-
-	/* NCM requires no zlp if transfer is dwNtbInMaxSize */
-	if (dev->port_usb &&
-	    dev->port_usb->is_fixed &&
-	    length == dev->port_usb->fixed_in_len &&
-	    (length % in->maxpacket) == 0)
-		req->zero = 0;
-	else
-		req->zero = 1;
-
-	/* use zlp framing on tx for strict CDC-Ether conformance,
-	 * though any robust network rx path ignores extra padding.
-	 * and some hardware doesn't like to write zlps.
-	 */
-	if (req->zero && !dev->zlp && (length % in->maxpacket) == 0)
-		length++;
-
-	req->length = length;
-
-	retval = usb_ep_queue(in, req, GFP_ATOMIC);
-	switch (retval) {
-	default:
-		DBG(dev, "tx queue err %d\n", retval);
-		break;
-	case 0:
-		netif_trans_update(net);
-		atomic_inc(&dev->tx_qlen);
+	if (max_pkts > 1) {
+		skb = eth_tx_aggregate(dev, skb, max_pkts, max_len);
+		if (!skb)
+			goto multiframe;
 	}
 
+	retval = eth_tx_submit(dev, in, req, skb);
 	if (retval) {
 		dev_kfree_skb_any(skb);
 drop:
@@ -1164,6 +1303,9 @@ void gether_disconnect(struct gether *link)
 	spin_unlock(&dev->req_lock);
 	link->out_ep->desc = NULL;
 
+	dev_kfree_skb_any(dev->tx_skb_hold);
+	dev->tx_skb_hold = NULL;
+
 	/* finish forgetting about this USB link episode */
 	dev->header_len = 0;
 	dev->unwrap = NULL;
@@ -74,6 +74,15 @@ struct gether {
 	u32				fixed_out_len;
 	u32				fixed_in_len;
 	bool				supports_multi_frame;
+	/*
+	 * Framings that carry several packets per transfer, as negotiated
+	 * with the host: IN transfers pack up to dl_max_pkts_per_xfer
+	 * packets within dl_max_xfer_size bytes, and OUT transfers are
+	 * sized for ul_max_pkts_per_xfer packets.
+	 */
+	u32				dl_max_pkts_per_xfer;
+	u32				dl_max_xfer_size;
+	u32				ul_max_pkts_per_xfer;
 	struct sk_buff			*(*wrap)(struct gether *port,
 						struct sk_buff *skb);
 	int				(*unwrap)(struct gether *port,
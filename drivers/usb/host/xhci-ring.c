@@ -412,6 +412,23 @@ void xhci_ring_ep_doorbell(struct xhci_hcd *xhci,
 	if ((ep_state & EP_STOP_CMD_PENDING) || (ep_state & SET_DEQ_PENDING) ||
 	    (ep_state & EP_HALTED))
 		return;
+
+	/*
+	 * URBs resubmitted from their completion, while xhci_irq() goes
+	 * through the event ring, only get one doorbell per endpoint at
+	 * the end of the pass. Other CPUs are not held back.
+	 */
+	if (xhci->db_defer_cpu == smp_processor_id() && !stream_id) {
+		if (ep_state & EP_DOORBELL_DEFERRED)
+			return;
+		if (xhci->db_deferred_count < XHCI_MAX_DEFERRED_DB) {
+			ep->ep_state |= EP_DOORBELL_DEFERRED;
+			xhci->db_deferred[xhci->db_deferred_count++] =
+				slot_id << 5 | ep_index;
+			return;
+		}
+	}
+
 	writel(DB_VALUE(ep_index, stream_id), db_addr);
 	/* The CPU has better things to do at this point than wait for a
 	 * write-posting flush.  It'll get there soon enough.
@@ -2721,11 +2738,96 @@ static int xhci_handle_event(struct xhci_hcd *xhci)
  * we might get bad data out of the event ring.  Section 4.10.2.7 has a list of
  * indicators of an event TRB error, but we check the status *first* to be safe.
  */
+static void xhci_ring_deferred_doorbells(struct xhci_hcd *xhci)
+{
+	unsigned int i;
+
+	xhci->db_defer_cpu = -1;
+	for (i = 0; i < xhci->db_deferred_count; i++) {
+		unsigned int slot_id = xhci->db_deferred[i] >> 5;
+		unsigned int ep_index = xhci->db_deferred[i] & 0x1f;
+
+		/* The slot may have been disabled by an event of this pass */
+		if (!xhci->devs[slot_id])
+			continue;
+
+		xhci->devs[slot_id]->eps[ep_index].ep_state &=
+			~EP_DOORBELL_DEFERRED;
+		xhci_ring_ep_doorbell(xhci, slot_id, ep_index, 0);
+	}
+	xhci->db_deferred_count = 0;
+}
+
+static bool adaptive_imod = true;
+module_param(adaptive_imod, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(adaptive_imod,
+		 "Adapt the interrupt moderation interval to the event rate");
+
+/* Interrupts per second above which events should be batched */
+#define XHCI_IMOD_HIGH_RATE	8000
+/* Interrupts per second below which a low latency is affordable */
+#define XHCI_IMOD_LOW_RATE	1000
+#define XHCI_IMOD_WINDOW	(HZ / 10)
+
+void xhci_set_imod(struct xhci_hcd *xhci, unsigned int ns)
+{
+	u32 temp;
+
+	temp = readl(&xhci->ir_set->irq_control);
+	temp &= ~ER_IRQ_INTERVAL_MASK;
+	/*
+	 * the increment interval is 8 times as much as that defined
+	 * in xHCI spec on MTK's controller
+	 */
+	temp |= (ns / ((xhci->quirks & XHCI_MTK_HOST) ? 2000 : 250)) &
+		ER_IRQ_INTERVAL_MASK;
+	writel(temp, &xhci->ir_set->irq_control);
+	xhci->imod_interval = ns;
+}
+
+/*
+ * Called for every interrupt with the number of events it handled. Over
+ * each window, the interval is doubled while interrupts come at a high
+ * rate with fewer than two events each (a camera or a disk streaming), and
+ * halved while they come at a low rate (a keyboard, control transfers).
+ */
+static void xhci_update_imod(struct xhci_hcd *xhci, unsigned int events)
+{
+	unsigned long elapsed = jiffies - xhci->imod_window_start;
+	unsigned int ns = xhci->imod_interval;
+	unsigned long rate;
+
+	xhci->imod_irqs++;
+	xhci->imod_events += events;
+	if (elapsed < XHCI_IMOD_WINDOW)
+		return;
+
+	rate = (unsigned long)xhci->imod_irqs * HZ / elapsed;
+	if (!adaptive_imod)
+		ns = XHCI_IMOD_DEFAULT_NS;
+	else if (rate > XHCI_IMOD_HIGH_RATE &&
+		 xhci->imod_events < 2 * xhci->imod_irqs)
+		ns = min_t(unsigned int, ns * 2, XHCI_IMOD_MAX_NS);
+	else if (rate < XHCI_IMOD_LOW_RATE)
+		ns = max_t(unsigned int, ns / 2, XHCI_IMOD_MIN_NS);
+
+	if (ns != xhci->imod_interval) {
+		xhci_dbg(xhci, "%lu irq/s, %u events: IMOD %u -> %u ns\n",
+			 rate, xhci->imod_events, xhci->imod_interval, ns);
+		xhci_set_imod(xhci, ns);
+	}
+
+	xhci->imod_window_start = jiffies;
+	xhci->imod_irqs = 0;
+	xhci->imod_events = 0;
+}
+
 irqreturn_t xhci_irq(struct usb_hcd *hcd)
 {
 	struct xhci_hcd *xhci = hcd_to_xhci(hcd);
 	union xhci_trb *event_ring_deq;
 	irqreturn_t ret = IRQ_NONE;
+	unsigned int events = 0;
 	unsigned long flags;
 	dma_addr_t deq;
 	u64 temp_64;
@@ -2783,7 +2885,11 @@ irqreturn_t xhci_irq(struct usb_hcd *hcd)
 	/* FIXME this should be a delayed service routine
 	 * that clears the EHB.
 	 */
-	while (xhci_handle_event(xhci) > 0) {}
+	xhci->db_defer_cpu = smp_processor_id();
+	while (xhci_handle_event(xhci) > 0)
+		events++;
+	xhci_ring_deferred_doorbells(xhci);
+	xhci_update_imod(xhci, events);
 
 	temp_64 = xhci_read_64(xhci, &xhci->ir_set->erst_dequeue);
 	/* If necessary, update the HW's version of the event ring deq ptr. */
@@ -595,14 +595,9 @@ int xhci_run(struct usb_hcd *hcd)
 
 	xhci_dbg_trace(xhci, trace_xhci_dbg_init,
 			"// Set the interrupt modulation register");
-	temp = readl(&xhci->ir_set->irq_control);
-	temp &= ~ER_IRQ_INTERVAL_MASK;
-	/*
-	 * the increment interval is 8 times as much as that defined
-	 * in xHCI spec on MTK's controller
-	 */
-	temp |= (u32) ((xhci->quirks & XHCI_MTK_HOST) ? 20 : 160);
-	writel(temp, &xhci->ir_set->irq_control);
+	xhci_set_imod(xhci, XHCI_IMOD_DEFAULT_NS);
+	xhci->imod_window_start = jiffies;
+	xhci->db_defer_cpu = -1;
 
 	/* Set the HCD state before we enable the irqs */
 	temp = readl(&xhci->op_regs->command);
@@ -500,6 +500,14 @@ struct xhci_intr_reg {
 #define ER_IRQ_INTERVAL_MASK	(0xffff)
 /* Counter used to count down the time to the next interrupt - HW use only */
 #define ER_IRQ_COUNTER_MASK	(0xffff << 16)
+/*
+ * Range of the interval xhci_update_imod() picks from, in ns. Beyond one
+ * microframe an isochronous completion would be reported a service
+ * interval late.
+ */
+#define XHCI_IMOD_DEFAULT_NS	40000
+#define XHCI_IMOD_MIN_NS	10000
+#define XHCI_IMOD_MAX_NS	125000
 
 /* erst_size bitmasks */
 /* Preserve bits 16:31 of erst_size */
@@ -931,6 +939,8 @@ struct xhci_virt_ep {
 #define EP_HAS_STREAMS		(1 << 4)
 /* Transitioning the endpoint to not using streams, don't enqueue URBs */
 #define EP_GETTING_NO_STREAMS	(1 << 5)
+/* Doorbell held back until the end of the event ring pass, see xhci_irq() */
+#define EP_DOORBELL_DEFERRED	(1 << 6)
 	/* ----  Related to URB cancellation ---- */
 	struct list_head	cancelled_td_list;
 	/* Watchdog timer for stop endpoint command to cancel URBs */
@@ -1748,6 +1758,16 @@ struct xhci_hcd {
 	struct xhci_command	*current_cmd;
 	struct xhci_ring	*event_ring;
 	struct xhci_erst	erst;
+	/* Adaptive interrupt moderation, see xhci_update_imod() */
+	unsigned int		imod_interval;	/* in ns */
+	unsigned long		imod_window_start;
+	unsigned int		imod_irqs;
+	unsigned int		imod_events;
+	/* Endpoint doorbells deferred by the CPU processing the event ring */
+	int			db_defer_cpu;
+	unsigned int		db_deferred_count;
+#define XHCI_MAX_DEFERRED_DB	32
+	u16			db_deferred[XHCI_MAX_DEFERRED_DB];
 	/* Scratchpad */
 	struct xhci_scratchpad  *scratchpad;
 	/* Store LPM test failed devices' information */
@@ -2019,6 +2039,7 @@ int xhci_suspend(struct xhci_hcd *xhci, bool do_wakeup);
 int xhci_resume(struct xhci_hcd *xhci, bool hibernated);
 
 irqreturn_t xhci_irq(struct usb_hcd *hcd);
+void xhci_set_imod(struct xhci_hcd *xhci, unsigned int ns);
 irqreturn_t xhci_msi_irq(int irq, void *hcd);
 int xhci_alloc_dev(struct usb_hcd *hcd, struct usb_device *udev);
 int xhci_alloc_tt_info(struct xhci_hcd *xhci,
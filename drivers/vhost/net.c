@@ -373,13 +373,60 @@ static inline unsigned long busy_clock(void)
 	return local_clock() >> 10;
 }
 
-static bool vhost_can_busy_poll(struct vhost_dev *dev,
+/*
+ * How long to busy poll @vq for, in us, now that it was found empty.
+ * Adaptive polling also starts timing how long it stays empty.
+ */
+static unsigned long vhost_net_busy_budget(struct vhost_virtqueue *vq)
+{
+	if (!vq->busyloop_adaptive)
+		return vq->busyloop_timeout;
+
+	if (!vq->busyloop_idle)
+		vq->busyloop_idle = busy_clock();
+	return vq->busyloop_budget;
+}
+
+static void vhost_net_busy_account(struct vhost_virtqueue *vq, bool hit)
+{
+	if (hit)
+		vq->busyloop_hits++;
+	else
+		vq->busyloop_misses++;
+}
+
+/*
+ * Work showed up on @vq. Adaptive polling moves the budget to twice the
+ * average time the ring stays empty, so that most arrivals are caught
+ * by the busy loop, or to nothing if that exceeds the timeout: the ring
+ * is then mostly idle, and waiting for notifications is cheaper.
+ */
+static void vhost_net_busy_arrival(struct vhost_virtqueue *vq)
+{
+	u64 interval, budget;
+
+	if (!vq->busyloop_idle)
+		return;
+
+	interval = min_t(u64, busy_clock() - vq->busyloop_idle,
+			 2ULL * vq->busyloop_timeout);
+	vq->busyloop_idle = 0;
+
+	/* Moving average, with a weight of 1/8 for the new interval */
+	vq->busyloop_interval = (vq->busyloop_interval * 7 + interval) >> 3;
+
+	budget = 2 * vq->busyloop_interval;
+	vq->busyloop_budget = budget <= vq->busyloop_timeout ? budget : 0;
+}
+
+/* @vq is the virtqueue whose worker is running the busy loop */
+static bool vhost_can_busy_poll(struct vhost_virtqueue *vq,
 				unsigned long endtime)
 {
 	return likely(!need_resched()) &&
 	       likely(!time_after(busy_clock(), endtime)) &&
 	       likely(!signal_pending(current)) &&
-	       !vhost_has_work(dev);
+	       !vhost_vq_has_work(vq);
 }
 
 static void vhost_net_disable_vq(struct vhost_net *n,
@@ -414,20 +461,28 @@ static int vhost_net_tx_get_vq_desc(struct vhost_net *net,
 				    unsigned int *out_num, unsigned int *in_num)
 {
 	unsigned long uninitialized_var(endtime);
+	unsigned long budget = 0;
 	int r = vhost_get_vq_desc(vq, vq->iov, ARRAY_SIZE(vq->iov),
 				  out_num, in_num, NULL, NULL);
 
-	if (r == vq->num && vq->busyloop_timeout) {
+	if (r == vq->num && vq->busyloop_timeout)
+		budget = vhost_net_busy_budget(vq);
+
+	if (budget) {
 		preempt_disable();
-		endtime = busy_clock() + vq->busyloop_timeout;
-		while (vhost_can_busy_poll(vq->dev, endtime) &&
+		endtime = busy_clock() + budget;
+		while (vhost_can_busy_poll(vq, endtime) &&
 		       vhost_vq_avail_empty(vq->dev, vq))
 			cpu_relax();
 		preempt_enable();
 		r = vhost_get_vq_desc(vq, vq->iov, ARRAY_SIZE(vq->iov),
 				      out_num, in_num, NULL, NULL);
+		vhost_net_busy_account(vq, r != vq->num);
 	}
 
+	if (r >= 0 && r != vq->num)
+		vhost_net_busy_arrival(vq);
+
 	return r;
 }
 
@@ -618,17 +673,21 @@ static int vhost_net_rx_peek_head_len(struct vhost_net *net, struct sock *sk)
 	struct vhost_net_virtqueue *nvq = &net->vqs[VHOST_NET_VQ_TX];
 	struct vhost_virtqueue *vq = &nvq->vq;
 	unsigned long uninitialized_var(endtime);
+	unsigned long budget = 0;
 	int len = peek_head_len(rvq, sk);
 
-	if (!len && vq->busyloop_timeout) {
+	if (!len && rvq->vq.busyloop_timeout)
+		budget = vhost_net_busy_budget(&rvq->vq);
+
+	if (budget) {
 		/* Both tx vq and rx socket were polled here */
 		mutex_lock(&vq->mutex);
 		vhost_disable_notify(&net->dev, vq);
 
 		preempt_disable();
-		endtime = busy_clock() + vq->busyloop_timeout;
+		endtime = busy_clock() + budget;
 
-		while (vhost_can_busy_poll(&net->dev, endtime) &&
+		while (vhost_can_busy_poll(&rvq->vq, endtime) &&
 		       !sk_has_rx_data(sk) &&
 		       vhost_vq_avail_empty(&net->dev, vq))
 			cpu_relax();
@@ -645,8 +704,12 @@ static int vhost_net_rx_peek_head_len(struct vhost_net *net, struct sock *sk)
 		mutex_unlock(&vq->mutex);
 
 		len = peek_head_len(rvq, sk);
+		vhost_net_busy_account(&rvq->vq, len);
 	}
 
+	if (len)
+		vhost_net_busy_arrival(&rvq->vq);
+
 	return len;
 }
 
@@ -937,8 +1000,10 @@ static int vhost_net_open(struct inode *inode, struct file *f)
 	}
 	vhost_dev_init(dev, vqs, VHOST_NET_VQ_MAX);
 
-	vhost_poll_init(n->poll + VHOST_NET_VQ_TX, handle_tx_net, POLLOUT, dev);
-	vhost_poll_init(n->poll + VHOST_NET_VQ_RX, handle_rx_net, POLLIN, dev);
+	vhost_poll_init(n->poll + VHOST_NET_VQ_TX, handle_tx_net, POLLOUT, dev,
+			vqs[VHOST_NET_VQ_TX]);
+	vhost_poll_init(n->poll + VHOST_NET_VQ_RX, handle_rx_net, POLLIN, dev,
+			vqs[VHOST_NET_VQ_RX]);
 
 	f->private_data = n;
 
@@ -1317,6 +1382,13 @@ static long vhost_net_ioctl(struct file *f, unsigned int ioctl,
 		return vhost_net_reset_owner(n);
 	case VHOST_SET_OWNER:
 		return vhost_net_set_owner(n);
+	case VHOST_SET_VRING_WORKER:
+		mutex_lock(&n->dev.mutex);
+		r = vhost_dev_check_owner(&n->dev);
+		if (!r)
+			r = vhost_vring_set_worker(&n->dev, argp);
+		mutex_unlock(&n->dev.mutex);
+		return r;
 	default:
 		mutex_lock(&n->dev.mutex);
 		r = vhost_dev_ioctl(&n->dev, ioctl, argp);
@@ -185,14 +185,16 @@ void vhost_work_init(struct vhost_work *work, vhost_work_fn_t fn)
 }
 EXPORT_SYMBOL_GPL(vhost_work_init);
 
-/* Init poll structure */
+/* Init poll structure. With @vq, the work runs on the worker of @vq. */
 void vhost_poll_init(struct vhost_poll *poll, vhost_work_fn_t fn,
-		     unsigned long mask, struct vhost_dev *dev)
+		     unsigned long mask, struct vhost_dev *dev,
+		     struct vhost_virtqueue *vq)
 {
 	init_waitqueue_func_entry(&poll->wait, vhost_poll_wakeup);
 	init_poll_funcptr(&poll->table, vhost_poll_func);
 	poll->mask = mask;
 	poll->dev = dev;
+	poll->vq = vq;
 	poll->wqh = NULL;
 
 	vhost_work_init(&poll->work, fn);
@@ -233,54 +235,92 @@ void vhost_poll_stop(struct vhost_poll *poll)
 }
 EXPORT_SYMBOL_GPL(vhost_poll_stop);
 
-void vhost_work_flush(struct vhost_dev *dev, struct vhost_work *work)
+static void vhost_worker_queue(struct vhost_worker *worker,
+			       struct vhost_work *work)
+{
+	if (!worker->task)
+		return;
+
+	if (!test_and_set_bit(VHOST_WORK_QUEUED, &work->flags)) {
+		/* We can only add the work to the list after we're
+		 * sure it was not in the list.
+		 * test_and_set_bit() implies a memory barrier.
+		 */
+		llist_add(&work->node, &worker->work_list);
+		wake_up_process(worker->task);
+	}
+}
+
+static void vhost_worker_flush(struct vhost_worker *worker)
 {
 	struct vhost_flush_struct flush;
 
-	if (dev->worker) {
+	if (worker->task) {
 		init_completion(&flush.wait_event);
 		vhost_work_init(&flush.work, vhost_flush_work);
 
-		vhost_work_queue(dev, &flush.work);
+		vhost_worker_queue(worker, &flush.work);
 		wait_for_completion(&flush.wait_event);
 	}
 }
+
+static struct vhost_worker *vhost_vq_get_worker(struct vhost_virtqueue *vq)
+{
+	struct vhost_worker *worker = READ_ONCE(vq->worker);
+
+	return worker ? worker : &vq->dev->worker;
+}
+
+void vhost_work_flush(struct vhost_dev *dev, struct vhost_work *work)
+{
+	vhost_worker_flush(&dev->worker);
+}
 EXPORT_SYMBOL_GPL(vhost_work_flush);
 
 /* Flush any work that has been scheduled. When calling this, don't hold any
  * locks that are also used by the callback. */
 void vhost_poll_flush(struct vhost_poll *poll)
 {
-	vhost_work_flush(poll->dev, &poll->work);
+	if (poll->vq)
+		vhost_worker_flush(vhost_vq_get_worker(poll->vq));
+	else
+		vhost_work_flush(poll->dev, &poll->work);
 }
 EXPORT_SYMBOL_GPL(vhost_poll_flush);
 
 void vhost_work_queue(struct vhost_dev *dev, struct vhost_work *work)
 {
-	if (!dev->worker)
-		return;
-
-	if (!test_and_set_bit(VHOST_WORK_QUEUED, &work->flags)) {
-		/* We can only add the work to the list after we're
-		 * sure it was not in the list.
-		 * test_and_set_bit() implies a memory barrier.
-		 */
-		llist_add(&work->node, &dev->work_list);
-		wake_up_process(dev->worker);
-	}
+	vhost_worker_queue(&dev->worker, work);
 }
 EXPORT_SYMBOL_GPL(vhost_work_queue);
 
+/* Queue work on the worker running the handlers of @vq */
+void vhost_vq_work_queue(struct vhost_virtqueue *vq, struct vhost_work *work)
+{
+	vhost_worker_queue(vhost_vq_get_worker(vq), work);
+}
+EXPORT_SYMBOL_GPL(vhost_vq_work_queue);
+
 /* A lockless hint for busy polling code to exit the loop */
 bool vhost_has_work(struct vhost_dev *dev)
 {
-	return !llist_empty(&dev->work_list);
+	return !llist_empty(&dev->worker.work_list);
 }
 EXPORT_SYMBOL_GPL(vhost_has_work);
 
+/* Same, for code running on the worker of @vq */
+bool vhost_vq_has_work(struct vhost_virtqueue *vq)
+{
+	return !llist_empty(&vhost_vq_get_worker(vq)->work_list);
+}
+EXPORT_SYMBOL_GPL(vhost_vq_has_work);
+
 void vhost_poll_queue(struct vhost_poll *poll)
 {
-	vhost_work_queue(poll->dev, &poll->work);
+	if (poll->vq)
+		vhost_vq_work_queue(poll->vq, &poll->work);
+	else
+		vhost_work_queue(poll->dev, &poll->work);
 }
 EXPORT_SYMBOL_GPL(vhost_poll_queue);
 
@@ -300,6 +340,14 @@ static void vhost_vq_meta_reset(struct vhost_dev *d)
 		__vhost_vq_meta_reset(d->vqs[i]);
 }
 
+/* Adaptive busy polling starts from polling for the whole timeout */
+static void vhost_vq_busyloop_restart(struct vhost_virtqueue *vq)
+{
+	vq->busyloop_budget = vq->busyloop_timeout;
+	vq->busyloop_interval = vq->busyloop_timeout / 2;
+	vq->busyloop_idle = 0;
+}
+
 static void vhost_vq_reset(struct vhost_dev *dev,
 			   struct vhost_virtqueue *vq)
 {
@@ -327,6 +375,10 @@ static void vhost_vq_reset(struct vhost_dev *dev,
 	vhost_reset_is_le(vq);
 	vhost_disable_cross_endian(vq);
 	vq->busyloop_timeout = 0;
+	vq->busyloop_adaptive = false;
+	vhost_vq_busyloop_restart(vq);
+	vq->busyloop_hits = 0;
+	vq->busyloop_misses = 0;
 	vq->umem = NULL;
 	vq->iotlb = NULL;
 	__vhost_vq_meta_reset(vq);
@@ -334,7 +386,8 @@ static void vhost_vq_reset(struct vhost_dev *dev,
 
 static int vhost_worker(void *data)
 {
-	struct vhost_dev *dev = data;
+	struct vhost_worker *worker = data;
+	struct vhost_dev *dev = worker->dev;
 	struct vhost_work *work, *work_next;
 	struct llist_node *node;
 	mm_segment_t oldfs = get_fs();
@@ -351,7 +404,7 @@ static int vhost_worker(void *data)
 			break;
 		}
 
-		node = llist_del_all(&dev->work_list);
+		node = llist_del_all(&worker->work_list);
 		if (!node)
 			schedule();
 
@@ -426,8 +479,9 @@ void vhost_dev_init(struct vhost_dev *dev,
 	dev->umem = NULL;
 	dev->iotlb = NULL;
 	dev->mm = NULL;
-	dev->worker = NULL;
-	init_llist_head(&dev->work_list);
+	dev->worker.task = NULL;
+	dev->worker.dev = dev;
+	init_llist_head(&dev->worker.work_list);
 	init_waitqueue_head(&dev->wait);
 	INIT_LIST_HEAD(&dev->read_list);
 	INIT_LIST_HEAD(&dev->pending_list);
@@ -440,11 +494,12 @@ void vhost_dev_init(struct vhost_dev *dev,
 		vq->indirect = NULL;
 		vq->heads = NULL;
 		vq->dev = dev;
+		vq->worker = NULL;
 		mutex_init(&vq->mutex);
 		vhost_vq_reset(dev, vq);
 		if (vq->handle_kick)
 			vhost_poll_init(&vq->poll, vq->handle_kick,
-					POLLIN, dev);
+					POLLIN, dev, vq);
 	}
 }
 EXPORT_SYMBOL_GPL(vhost_dev_init);
@@ -471,14 +526,14 @@ static void vhost_attach_cgroups_work(struct vhost_work *work)
 	s->ret = cgroup_attach_task_all(s->owner, current);
 }
 
-static int vhost_attach_cgroups(struct vhost_dev *dev)
+static int vhost_attach_cgroups(struct vhost_worker *worker)
 {
 	struct vhost_attach_cgroups_struct attach;
 
 	attach.owner = current;
 	vhost_work_init(&attach.work, vhost_attach_cgroups_work);
-	vhost_work_queue(dev, &attach.work);
-	vhost_work_flush(dev, &attach.work);
+	vhost_worker_queue(worker, &attach.work);
+	vhost_worker_flush(worker);
 	return attach.ret;
 }
 
@@ -503,16 +558,17 @@ long vhost_dev_set_owner(struct vhost_dev *dev)
 
 	/* No owner, become one */
 	dev->mm = get_task_mm(current);
-	worker = kthread_create(vhost_worker, dev, "vhost-%d", current->pid);
+	worker = kthread_create(vhost_worker, &dev->worker, "vhost-%d",
+				current->pid);
 	if (IS_ERR(worker)) {
 		err = PTR_ERR(worker);
 		goto err_worker;
 	}
 
-	dev->worker = worker;
+	dev->worker.task = worker;
 	wake_up_process(worker);	/* avoid contributing to loadavg */
 
-	err = vhost_attach_cgroups(dev);
+	err = vhost_attach_cgroups(&dev->worker);
 	if (err)
 		goto err_cgroup;
 
@@ -523,7 +579,7 @@ long vhost_dev_set_owner(struct vhost_dev *dev)
 	return 0;
 err_cgroup:
 	kthread_stop(worker);
-	dev->worker = NULL;
+	dev->worker.task = NULL;
 err_worker:
 	if (dev->mm)
 		mmput(dev->mm);
@@ -533,6 +589,98 @@ long vhost_dev_set_owner(struct vhost_dev *dev)
 }
 EXPORT_SYMBOL_GPL(vhost_dev_set_owner);
 
+static void vhost_worker_destroy(struct vhost_worker *worker)
+{
+	WARN_ON(!llist_empty(&worker->work_list));
+	kthread_stop(worker->task);
+	kfree(worker);
+}
+
+static struct vhost_worker *vhost_worker_create(struct vhost_dev *dev,
+						u32 idx, u32 cpu)
+{
+	struct vhost_worker *worker;
+	struct task_struct *task;
+	int err;
+
+	worker = kzalloc(sizeof(*worker), GFP_KERNEL);
+	if (!worker)
+		return ERR_PTR(-ENOMEM);
+
+	worker->dev = dev;
+	init_llist_head(&worker->work_list);
+
+	task = kthread_create(vhost_worker, worker, "vhost-%d-%u",
+			      current->pid, idx);
+	if (IS_ERR(task)) {
+		kfree(worker);
+		return ERR_CAST(task);
+	}
+
+	/* Not bound: the owner can still move it, as the device worker */
+	if (cpu != VHOST_VRING_WORKER_ANY_CPU)
+		set_cpus_allowed_ptr(task, cpumask_of(cpu));
+
+	worker->task = task;
+	wake_up_process(task);		/* avoid contributing to loadavg */
+
+	err = vhost_attach_cgroups(worker);
+	if (err) {
+		vhost_worker_destroy(worker);
+		return ERR_PTR(err);
+	}
+
+	return worker;
+}
+
+/*
+ * Caller must have device mutex, and must be able to run the handlers of
+ * different virtqueues concurrently.
+ */
+long vhost_vring_set_worker(struct vhost_dev *d, void __user *argp)
+{
+	struct vhost_worker *worker = NULL, *old;
+	struct vhost_virtqueue *vq;
+	struct vhost_vring_state s;
+	long r = 0;
+
+	if (copy_from_user(&s, argp, sizeof(s)))
+		return -EFAULT;
+	if (s.index >= d->nvqs)
+		return -ENOBUFS;
+	if (s.num != VHOST_VRING_WORKER_DEVICE &&
+	    s.num != VHOST_VRING_WORKER_ANY_CPU &&
+	    (s.num >= nr_cpu_ids || !cpu_online(s.num)))
+		return -EINVAL;
+
+	vq = d->vqs[s.index];
+
+	mutex_lock(&vq->mutex);
+
+	/* Nothing may be queued for the ring while it changes worker */
+	if (vq->kick || vq->private_data) {
+		r = -EBUSY;
+		goto out;
+	}
+
+	if (s.num != VHOST_VRING_WORKER_DEVICE) {
+		worker = vhost_worker_create(d, s.index, s.num);
+		if (IS_ERR(worker)) {
+			r = PTR_ERR(worker);
+			goto out;
+		}
+	}
+
+	old = vq->worker;
+	WRITE_ONCE(vq->worker, worker);
+	if (old)
+		vhost_worker_destroy(old);
+out:
+	mutex_unlock(&vq->mutex);
+	return r;
+}
+EXPORT_SYMBOL_GPL(vhost_vring_set_worker);
+
 struct vhost_umem *vhost_dev_reset_owner_prepare(void)
 {
 	return kvzalloc(sizeof(struct vhost_umem), GFP_KERNEL);
@@ -643,10 +791,16 @@ void vhost_dev_cleanup(struct vhost_dev *dev, bool locked)
 	dev->iotlb = NULL;
 	vhost_clear_msg(dev);
 	wake_up_interruptible_poll(&dev->wait, POLLIN | POLLRDNORM);
-	WARN_ON(!llist_empty(&dev->work_list));
-	if (dev->worker) {
-		kthread_stop(dev->worker);
-		dev->worker = NULL;
+	for (i = 0; i < dev->nvqs; ++i) {
+		if (dev->vqs[i]->worker) {
+			vhost_worker_destroy(dev->vqs[i]->worker);
+			dev->vqs[i]->worker = NULL;
+		}
+	}
+	WARN_ON(!llist_empty(&dev->worker.work_list));
+	if (dev->worker.task) {
+		kthread_stop(dev->worker.task);
+		dev->worker.task = NULL;
 	}
 	if (dev->mm)
 		mmput(dev->mm);
@@ -1355,6 +1509,7 @@ long vhost_vring_ioctl(struct vhost_dev *d, int ioctl, void __user *argp)
 	struct vhost_vring_state s;
 	struct vhost_vring_file f;
 	struct vhost_vring_addr a;
+	struct vhost_vring_busyloop_stats bs;
 	u32 idx;
 	long r;
 
@@ -1533,6 +1688,7 @@ long vhost_vring_ioctl(struct vhost_dev *d, int ioctl, void __user *argp)
 			break;
 		}
 		vq->busyloop_timeout = s.num;
+		vhost_vq_busyloop_restart(vq);
 		break;
 	case VHOST_GET_VRING_BUSYLOOP_TIMEOUT:
 		s.index = idx;
@@ -1540,6 +1696,33 @@ long vhost_vring_ioctl(struct vhost_dev *d, int ioctl, void __user *argp)
 		if (copy_to_user(argp, &s, sizeof(s)))
 			r = -EFAULT;
 		break;
+	case VHOST_SET_VRING_BUSYLOOP_ADAPTIVE:
+		if (copy_from_user(&s, argp, sizeof(s))) {
+			r = -EFAULT;
+			break;
+		}
+		if (s.num > 1) {
+			r = -EINVAL;
+			break;
+		}
+		vq->busyloop_adaptive = s.num;
+		vhost_vq_busyloop_restart(vq);
+		break;
+	case VHOST_GET_VRING_BUSYLOOP_ADAPTIVE:
+		s.index = idx;
+		s.num = vq->busyloop_adaptive;
+		if (copy_to_user(argp, &s, sizeof(s)))
+			r = -EFAULT;
+		break;
+	case VHOST_GET_VRING_BUSYLOOP_STATS:
+		bs.index = idx;
+		bs.budget = vq->busyloop_adaptive ? vq->busyloop_budget :
+						    vq->busyloop_timeout;
+		bs.hits = vq->busyloop_hits;
+		bs.misses = vq->busyloop_misses;
+		if (copy_to_user(argp, &bs, sizeof(bs)))
+			r = -EFAULT;
+		break;
 	default:
 		r = -ENOIOCTLCMD;
 	}
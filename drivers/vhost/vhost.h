@@ -27,6 +27,13 @@ struct vhost_work {
 	unsigned long		  flags;
 };
 
+/* A thread running queued works with the mm of the device owner */
+struct vhost_worker {
+	struct task_struct	 *task;
+	struct llist_head	  work_list;
+	struct vhost_dev	 *dev;
+};
+
 /* Poll a file (eventfd or socket) */
 /* Note: there's nothing vhost specific about this structure. */
 struct vhost_poll {
@@ -36,14 +43,19 @@ struct vhost_poll {
 	struct vhost_work	  work;
 	unsigned long		  mask;
 	struct vhost_dev	 *dev;
+	/* Run work on the worker of this virtqueue, if set */
+	struct vhost_virtqueue	 *vq;
 };
 
 void vhost_work_init(struct vhost_work *work, vhost_work_fn_t fn);
 void vhost_work_queue(struct vhost_dev *dev, struct vhost_work *work);
 bool vhost_has_work(struct vhost_dev *dev);
+void vhost_vq_work_queue(struct vhost_virtqueue *vq, struct vhost_work *work);
+bool vhost_vq_has_work(struct vhost_virtqueue *vq);
 
 void vhost_poll_init(struct vhost_poll *poll, vhost_work_fn_t fn,
-		     unsigned long mask, struct vhost_dev *dev);
+		     unsigned long mask, struct vhost_dev *dev,
+		     struct vhost_virtqueue *vq);
 int vhost_poll_start(struct vhost_poll *poll, struct file *file);
 void vhost_poll_stop(struct vhost_poll *poll);
 void vhost_poll_flush(struct vhost_poll *poll);
@@ -104,6 +116,9 @@ struct vhost_virtqueue {
 
 	struct vhost_poll poll;
 
+	/* Own worker thread, or NULL to use the one of the device. */
+	struct vhost_worker *worker;
+
 	/* The routine to call when the Guest pings us, or timeout. */
 	vhost_work_fn_t handle_kick;
 
@@ -150,6 +165,15 @@ struct vhost_virtqueue {
 	bool user_be;
 #endif
 	u32 busyloop_timeout;
+	/* Adaptive busy polling, for at most busyloop_timeout (us) */
+	bool busyloop_adaptive;
+	u32 busyloop_budget;
+	/* Average time the ring stays empty (us), and since when it is */
+	u64 busyloop_interval;
+	u64 busyloop_idle;
+	/* Busy loops that ended with / without work to do */
+	u64 busyloop_hits;
+	u64 busyloop_misses;
 };
 
 struct vhost_msg_node {
@@ -165,8 +189,7 @@ struct vhost_dev {
 	int nvqs;
 	struct file *log_file;
 	struct eventfd_ctx *log_ctx;
-	struct llist_head work_list;
-	struct task_struct *worker;
+	struct vhost_worker worker;
 	struct vhost_umem *umem;
 	struct vhost_umem *iotlb;
 	spinlock_t iotlb_lock;
@@ -185,6 +208,7 @@ void vhost_dev_cleanup(struct vhost_dev *, bool locked);
 void vhost_dev_stop(struct vhost_dev *);
 long vhost_dev_ioctl(struct vhost_dev *, unsigned int ioctl, void __user *argp);
 long vhost_vring_ioctl(struct vhost_dev *d, int ioctl, void __user *argp);
+long vhost_vring_set_worker(struct vhost_dev *d, void __user *argp);
 int vhost_vq_access_ok(struct vhost_virtqueue *vq);
 int vhost_log_access_ok(struct vhost_dev *);
 
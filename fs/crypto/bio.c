@@ -24,45 +24,240 @@
 #include <linux/module.h>
 #include <linux/bio.h>
 #include <linux/namei.h>
+#include <linux/slab.h>
 #include "fscrypt_private.h"
 
 /*
- * Call fscrypt_decrypt_page on every single page, reusing the encryption
- * context.
+ * Decrypt a range of the pages of a bio in place, and unlock them.
  */
-static void completion_pages(struct work_struct *work)
+static void decrypt_bio_range(struct bio *bio, unsigned int start,
+			      unsigned int nr)
 {
-	struct fscrypt_ctx *ctx =
-		container_of(work, struct fscrypt_ctx, r.work);
-	struct bio *bio = ctx->r.bio;
-	struct bio_vec *bv;
-	int i;
+	struct bio_vec *bvecs = bio->bi_io_vec + start;
+	int i, ret;
 
-	bio_for_each_segment_all(bv, bio, i) {
-		struct page *page = bv->bv_page;
-		int ret = fscrypt_decrypt_page(page->mapping->host, page,
-				PAGE_SIZE, 0, page->index);
+	ret = fscrypt_do_bvec_crypto(bvecs[0].bv_page->mapping->host,
+				     FS_DECRYPT, bvecs, nr, NULL, GFP_NOFS);
+	WARN_ON_ONCE(ret);
+
+	for (i = 0; i < nr; i++) {
+		struct page *page = bvecs[i].bv_page;
 
-		if (ret) {
-			WARN_ON_ONCE(1);
+		if (ret)
 			SetPageError(page);
-		} else {
+		else
 			SetPageUptodate(page);
-		}
 		unlock_page(page);
 	}
+}
+
+/*
+ * Decrypt all the pages of the bio in one batch, reusing the encryption
+ * context.
+ */
+static void completion_pages(struct work_struct *work)
+{
+	struct fscrypt_ctx *ctx =
+		container_of(work, struct fscrypt_ctx, r.work);
+	struct bio *bio = ctx->r.bio;
+
+	decrypt_bio_range(bio, 0, bio->bi_vcnt);
 	fscrypt_release_ctx(ctx);
 	bio_put(bio);
 }
 
+/*
+ * Large bios are split into chunks of at least this many pages, each
+ * decrypted by a worker on a different CPU.
+ */
+#define FSCRYPT_MIN_CHUNK_PAGES	8
+
+struct fscrypt_decrypt_chunk {
+	struct work_struct work;
+	struct fscrypt_decrypt_job *job;
+	unsigned int start;
+	unsigned int nr;
+};
+
+struct fscrypt_decrypt_job {
+	struct fscrypt_ctx *ctx;
+	struct bio *bio;
+	atomic_t remaining;
+	struct fscrypt_decrypt_chunk chunks[];
+};
+
+/*
+ * Each page is unlocked as soon as its chunk is decrypted; the bio and
+ * the context are released by whichever chunk finishes last.
+ */
+static void completion_chunk(struct work_struct *work)
+{
+	struct fscrypt_decrypt_chunk *chunk =
+		container_of(work, struct fscrypt_decrypt_chunk, work);
+	struct fscrypt_decrypt_job *job = chunk->job;
+
+	decrypt_bio_range(job->bio, chunk->start, chunk->nr);
+	if (atomic_dec_and_test(&job->remaining)) {
+		fscrypt_release_ctx(job->ctx);
+		bio_put(job->bio);
+		kfree(job);
+	}
+}
+
+static bool fscrypt_decrypt_bio_parallel(struct fscrypt_ctx *ctx,
+					 struct bio *bio)
+{
+	unsigned int nr_chunks = min_t(unsigned int, num_online_cpus(),
+			bio->bi_vcnt / FSCRYPT_MIN_CHUNK_PAGES);
+	struct fscrypt_decrypt_job *job;
+	unsigned int i, start = 0;
+	int cpu;
+
+	if (nr_chunks <= 1)
+		return false;
+
+	/* Called from bio completion */
+	job = kmalloc(sizeof(*job) + nr_chunks * sizeof(job->chunks[0]),
+		      GFP_ATOMIC);
+	if (!job)
+		return false;
+
+	job->ctx = ctx;
+	job->bio = bio;
+	atomic_set(&job->remaining, nr_chunks);
+
+	cpu = raw_smp_processor_id();
+	for (i = 0; i < nr_chunks; i++) {
+		struct fscrypt_decrypt_chunk *chunk = &job->chunks[i];
+		unsigned int end = bio->bi_vcnt * (i + 1) / nr_chunks;
+
+		INIT_WORK(&chunk->work, completion_chunk);
+		chunk->job = job;
+		chunk->start = start;
+		chunk->nr = end - start;
+		start = end;
+
+		queue_work_on(cpu, fscrypt_read_workqueue, &chunk->work);
+		cpu = cpumask_next(cpu, cpu_online_mask);
+		if (cpu >= nr_cpu_ids)
+			cpu = cpumask_first(cpu_online_mask);
+	}
+
+	return true;
+}
+
 void fscrypt_decrypt_bio_pages(struct fscrypt_ctx *ctx, struct bio *bio)
 {
+	/* Already decrypted by the storage hardware */
+	if (bio_is_inline_encrypted(bio)) {
+		struct bio_vec *bv;
+		int i;
+
+		bio_for_each_segment_all(bv, bio, i) {
+			SetPageUptodate(bv->bv_page);
+			unlock_page(bv->bv_page);
+		}
+		fscrypt_release_ctx(ctx);
+		bio_put(bio);
+		return;
+	}
+
+	if (fscrypt_decrypt_bio_parallel(ctx, bio))
+		return;
+
 	INIT_WORK(&ctx->r.work, completion_pages);
 	ctx->r.bio = bio;
 	queue_work(fscrypt_read_workqueue, &ctx->r.work);
 }
 EXPORT_SYMBOL(fscrypt_decrypt_bio_pages);
 
+/**
+ * fscrypt_encrypt_bio_pages() - Encrypts the pages of a write bio
+ * @inode:     The inode the pages belong to
+ * @bio:       The bio, holding locked pagecache pages
+ * @gfp_flags: The gfp flag for memory allocation
+ *
+ * Encrypts all the pages of @bio in one batch.  Unless the filesystem
+ * sets FS_CFLG_OWN_PAGES, each page is replaced in the bio by a locked
+ * bounce page holding its ciphertext, exactly as fscrypt_encrypt_page()
+ * returns them, to be released with fscrypt_pullback_bio_page() or
+ * fscrypt_restore_control_page() on completion.
+ *
+ * If the inode uses inline encryption, @bio is only tagged for the
+ * hardware, and must hold contiguous blocks (see fscrypt_mergeable_bio()).
+ *
+ * Return: Zero on success, with @bio unchanged on failure.
+ */
+int fscrypt_encrypt_bio_pages(const struct inode *inode, struct bio *bio,
+			      gfp_t gfp_flags)
+{
+	struct page **bounce;
+	struct bio_vec *bv;
+	int i, err;
+
+	if (fscrypt_inode_uses_inline_crypto(inode)) {
+		fscrypt_set_bio_crypt_ctx(bio, inode,
+					  bio->bi_io_vec[0].bv_page->index);
+		return 0;
+	}
+
+	if (inode->i_sb->s_cop->flags & FS_CFLG_OWN_PAGES)
+		return fscrypt_do_bvec_crypto(inode, FS_ENCRYPT, bio->bi_io_vec,
+					      bio->bi_vcnt, NULL, gfp_flags);
+
+	bounce = kcalloc(bio->bi_vcnt, sizeof(*bounce), gfp_flags);
+	if (!bounce)
+		return -ENOMEM;
+
+	bio_for_each_segment_all(bv, bio, i) {
+		struct fscrypt_ctx *ctx;
+
+		BUG_ON(bv->bv_len % FS_CRYPTO_BLOCK_SIZE != 0);
+		BUG_ON(!PageLocked(bv->bv_page));
+
+		ctx = fscrypt_get_ctx(inode, gfp_flags);
+		if (IS_ERR(ctx)) {
+			err = PTR_ERR(ctx);
+			goto errout;
+		}
+
+		bounce[i] = fscrypt_alloc_bounce_page(ctx, gfp_flags);
+		if (IS_ERR(bounce[i])) {
+			err = PTR_ERR(bounce[i]);
+			bounce[i] = NULL;
+			fscrypt_release_ctx(ctx);
+			goto errout;
+		}
+		ctx->w.control_page = bv->bv_page;
+		set_page_private(bounce[i], (unsigned long)ctx);
+	}
+
+	err = fscrypt_do_bvec_crypto(inode, FS_ENCRYPT, bio->bi_io_vec,
+				     bio->bi_vcnt, bounce, gfp_flags);
+	if (err)
+		goto errout;
+
+	bio_for_each_segment_all(bv, bio, i) {
+		SetPagePrivate(bounce[i]);
+		lock_page(bounce[i]);
+		bv->bv_page = bounce[i];
+	}
+	kfree(bounce);
+	return 0;
+
+errout:
+	for (i = 0; i < bio->bi_vcnt && bounce[i]; i++) {
+		struct fscrypt_ctx *ctx =
+			(struct fscrypt_ctx *)page_private(bounce[i]);
+
+		set_page_private(bounce[i], (unsigned long)NULL);
+		fscrypt_release_ctx(ctx);
+	}
+	kfree(bounce);
+	return err;
+}
+EXPORT_SYMBOL(fscrypt_encrypt_bio_pages);
+
 void fscrypt_pullback_bio_page(struct page **page, bool restore)
 {
 	struct fscrypt_ctx *ctx;
@@ -89,6 +284,7 @@ int fscrypt_zeroout_range(const struct inode *inode, pgoff_t lblk,
 {
 	struct fscrypt_ctx *ctx;
 	struct page *ciphertext_page = NULL;
+	bool inline_crypt = fscrypt_inode_uses_inline_crypto(inode);
 	struct bio *bio;
 	int ret, err = 0;
 
@@ -98,24 +294,33 @@ int fscrypt_zeroout_range(const struct inode *inode, pgoff_t lblk,
 	if (IS_ERR(ctx))
 		return PTR_ERR(ctx);
 
-	ciphertext_page = fscrypt_alloc_bounce_page(ctx, GFP_NOWAIT);
-	if (IS_ERR(ciphertext_page)) {
-		err = PTR_ERR(ciphertext_page);
-		goto errout;
+	/* The hardware encrypts the zero page itself */
+	if (inline_crypt) {
+		ciphertext_page = ZERO_PAGE(0);
+	} else {
+		ciphertext_page = fscrypt_alloc_bounce_page(ctx, GFP_NOWAIT);
+		if (IS_ERR(ciphertext_page)) {
+			err = PTR_ERR(ciphertext_page);
+			goto errout;
+		}
 	}
 
 	while (len--) {
-		err = fscrypt_do_page_crypto(inode, FS_ENCRYPT, lblk,
-					     ZERO_PAGE(0), ciphertext_page,
-					     PAGE_SIZE, 0, GFP_NOFS);
-		if (err)
-			goto errout;
+		if (!inline_crypt) {
+			err = fscrypt_do_page_crypto(inode, FS_ENCRYPT, lblk,
+						     ZERO_PAGE(0),
+						     ciphertext_page,
+						     PAGE_SIZE, 0, GFP_NOFS);
+			if (err)
+				goto errout;
+		}
 
 		bio = bio_alloc(GFP_NOWAIT, 1);
 		if (!bio) {
 			err = -ENOMEM;
 			goto errout;
 		}
+		fscrypt_set_bio_crypt_ctx(bio, inode, lblk);
 		bio_set_dev(bio, inode->i_sb->s_bdev);
 		bio->bi_iter.bi_sector =
 			pblk << (inode->i_sb->s_blocksize_bits - 9);
@@ -26,6 +26,7 @@
 #include <linux/ratelimit.h>
 #include <linux/dcache.h>
 #include <linux/namei.h>
+#include <linux/bio.h>
 #include <crypto/aes.h>
 #include "fscrypt_private.h"
 
@@ -126,6 +127,18 @@ struct fscrypt_ctx *fscrypt_get_ctx(const struct inode *inode, gfp_t gfp_flags)
 }
 EXPORT_SYMBOL(fscrypt_get_ctx);
 
+static void fscrypt_generate_iv(union fscrypt_iv *iv, u64 lblk_num,
+				const struct fscrypt_info *ci)
+{
+	BUILD_BUG_ON(sizeof(*iv) != FS_IV_SIZE);
+	BUILD_BUG_ON(AES_BLOCK_SIZE != FS_IV_SIZE);
+	iv->index = cpu_to_le64(lblk_num);
+	memset(iv->padding, 0, sizeof(iv->padding));
+
+	if (ci->ci_essiv_tfm != NULL)
+		crypto_cipher_encrypt_one(ci->ci_essiv_tfm, iv->raw, iv->raw);
+}
+
 /**
  * page_crypt_complete() - completion callback for page crypto
  * @req: The asynchronous cipher request context
@@ -146,10 +159,7 @@ int fscrypt_do_page_crypto(const struct inode *inode, fscrypt_direction_t rw,
 			   struct page *dest_page, unsigned int len,
 			   unsigned int offs, gfp_t gfp_flags)
 {
-	struct {
-		__le64 index;
-		u8 padding[FS_IV_SIZE - sizeof(__le64)];
-	} iv;
+	union fscrypt_iv iv;
 	struct skcipher_request *req = NULL;
 	DECLARE_FS_COMPLETION_RESULT(ecr);
 	struct scatterlist dst, src;
@@ -159,15 +169,7 @@ int fscrypt_do_page_crypto(const struct inode *inode, fscrypt_direction_t rw,
 
 	BUG_ON(len == 0);
 
-	BUILD_BUG_ON(sizeof(iv) != FS_IV_SIZE);
-	BUILD_BUG_ON(AES_BLOCK_SIZE != FS_IV_SIZE);
-	iv.index = cpu_to_le64(lblk_num);
-	memset(iv.padding, 0, sizeof(iv.padding));
-
-	if (ci->ci_essiv_tfm != NULL) {
-		crypto_cipher_encrypt_one(ci->ci_essiv_tfm, (u8 *)&iv,
-					  (u8 *)&iv);
-	}
+	fscrypt_generate_iv(&iv, lblk_num, ci);
 
 	req = skcipher_request_alloc(tfm, gfp_flags);
 	if (!req) {
@@ -205,6 +207,147 @@ int fscrypt_do_page_crypto(const struct inode *inode, fscrypt_direction_t rw,
 	return 0;
 }
 
+/*
+ * Requests of a bio are issued in batches of this many pages, all in
+ * flight at once, with a single wait per batch.
+ */
+#define FSCRYPT_BATCH_PAGES	16
+
+struct fscrypt_batch {
+	struct completion done;
+	atomic_t pending;
+	int res;
+};
+
+/* One page of a batch, followed by its skcipher request */
+struct fscrypt_batch_slot {
+	union fscrypt_iv iv;
+	struct scatterlist src;
+	struct scatterlist dst;
+};
+
+static void fscrypt_batch_complete(struct crypto_async_request *req, int res)
+{
+	struct fscrypt_batch *batch = req->data;
+
+	/* A backlogged request was started, its completion comes later */
+	if (res == -EINPROGRESS)
+		return;
+	if (res)
+		WRITE_ONCE(batch->res, res);
+	if (atomic_dec_and_test(&batch->pending))
+		complete(&batch->done);
+}
+
+/**
+ * fscrypt_do_bvec_crypto() - Encrypt or decrypt an array of bio segments
+ * @inode:      The inode the pages belong to
+ * @rw:         FS_ENCRYPT or FS_DECRYPT
+ * @bvecs:      The segments holding the source data
+ * @nr:         Number of segments
+ * @dest_pages: Per-segment destination pages, NULL for in-place
+ * @gfp_flags:  The gfp flag for memory allocation
+ *
+ * Like fscrypt_do_page_crypto() on every segment, with the
+ * logical block number taken from the page index, but the skcipher
+ * requests are allocated once and kept in flight together instead of
+ * being allocated and waited on one page at a time.  Falls back to
+ * fscrypt_do_page_crypto() if the requests can't be allocated.
+ *
+ * Return: Zero on success, non-zero otherwise.
+ */
+int fscrypt_do_bvec_crypto(const struct inode *inode, fscrypt_direction_t rw,
+			   struct bio_vec *bvecs, unsigned int nr_bvecs,
+			   struct page **dest_pages, gfp_t gfp_flags)
+{
+	struct fscrypt_info *ci = inode->i_crypt_info;
+	struct crypto_skcipher *tfm = ci->ci_ctfm;
+	size_t req_offset = ALIGN(sizeof(struct fscrypt_batch_slot),
+				  CRYPTO_MINALIGN);
+	size_t stride = ALIGN(req_offset + sizeof(struct skcipher_request) +
+			      crypto_skcipher_reqsize(tfm), CRYPTO_MINALIGN);
+	unsigned int nr = min_t(unsigned int, nr_bvecs, FSCRYPT_BATCH_PAGES);
+	struct fscrypt_batch batch;
+	struct bio_vec *bv;
+	void *slots;
+	int i, n = 0, res = 0;
+
+	slots = kmalloc_array(nr, stride, gfp_flags);
+	if (!slots) {
+		for (i = 0, bv = bvecs; i < nr_bvecs; i++, bv++) {
+			res = fscrypt_do_page_crypto(inode, rw,
+					bv->bv_page->index, bv->bv_page,
+					dest_pages ? dest_pages[i] :
+						     bv->bv_page,
+					bv->bv_len, bv->bv_offset, gfp_flags);
+			if (res)
+				return res;
+		}
+		return 0;
+	}
+
+	init_completion(&batch.done);
+	batch.res = 0;
+	atomic_set(&batch.pending, 1);
+
+	for (i = 0, bv = bvecs; i < nr_bvecs; i++, bv++) {
+		struct fscrypt_batch_slot *slot = slots + n * stride;
+		struct skcipher_request *req = (void *)slot + req_offset;
+		struct page *dest = dest_pages ? dest_pages[i] : bv->bv_page;
+		int err;
+
+		BUG_ON(bv->bv_len == 0);
+
+		fscrypt_generate_iv(&slot->iv, bv->bv_page->index, ci);
+		sg_init_table(&slot->src, 1);
+		sg_set_page(&slot->src, bv->bv_page, bv->bv_len,
+			    bv->bv_offset);
+		sg_init_table(&slot->dst, 1);
+		sg_set_page(&slot->dst, dest, bv->bv_len, bv->bv_offset);
+
+		skcipher_request_set_tfm(req, tfm);
+		skcipher_request_set_callback(req,
+			CRYPTO_TFM_REQ_MAY_BACKLOG | CRYPTO_TFM_REQ_MAY_SLEEP,
+			fscrypt_batch_complete, &batch);
+		skcipher_request_set_crypt(req, &slot->src, &slot->dst,
+					   bv->bv_len, slot->iv.raw);
+
+		atomic_inc(&batch.pending);
+		if (rw == FS_DECRYPT)
+			err = crypto_skcipher_decrypt(req);
+		else
+			err = crypto_skcipher_encrypt(req);
+		if (err != -EINPROGRESS && err != -EBUSY) {
+			/* Completed synchronously, no callback */
+			if (err)
+				batch.res = err;
+			atomic_dec(&batch.pending);
+		}
+
+		if (++n < nr && i + 1 < nr_bvecs)
+			continue;
+
+		/* Wait for the batch before its slots are reused */
+		if (!atomic_dec_and_test(&batch.pending))
+			wait_for_completion(&batch.done);
+		res = READ_ONCE(batch.res);
+		if (res)
+			break;
+		reinit_completion(&batch.done);
+		atomic_set(&batch.pending, 1);
+		n = 0;
+	}
+
+	kfree(slots);
+	if (res) {
+		printk_ratelimited(KERN_ERR
+			"%s: crypto_skcipher_%s() returned %d\n", __func__,
+			rw == FS_DECRYPT ? "decrypt" : "encrypt", res);
+		return res;
+	}
+	return 0;
+}
+
 struct page *fscrypt_alloc_bounce_page(struct fscrypt_ctx *ctx,
 				       gfp_t gfp_flags)
 {
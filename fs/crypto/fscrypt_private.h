@@ -60,6 +60,11 @@ struct fscrypt_info {
 	struct crypto_skcipher *ci_ctfm;
 	struct crypto_cipher *ci_essiv_tfm;
 	u8 ci_master_key[FS_KEY_DESCRIPTOR_SIZE];
+#ifdef CONFIG_FS_ENCRYPTION_INLINE_CRYPT
+	/* Slot of the contents key in the inline encryption engine */
+	struct keyslot_manager *ci_ksm;
+	unsigned int ci_keyslot;
+#endif
 };
 
 typedef enum {
@@ -79,6 +84,14 @@ struct fscrypt_completion_result {
 	struct fscrypt_completion_result ecr = { \
 		COMPLETION_INITIALIZER_ONSTACK((ecr).completion), 0 }
 
+union fscrypt_iv {
+	struct {
+		__le64 index;
+		u8 padding[FS_IV_SIZE - sizeof(__le64)];
+	};
+	u8 raw[FS_IV_SIZE];
+};
+
 
 /* crypto.c */
 extern int fscrypt_initialize(unsigned int cop_flags);
@@ -91,8 +104,30 @@ extern int fscrypt_do_page_crypto(const struct inode *inode,
 				  gfp_t gfp_flags);
 extern struct page *fscrypt_alloc_bounce_page(struct fscrypt_ctx *ctx,
 					      gfp_t gfp_flags);
+extern int fscrypt_do_bvec_crypto(const struct inode *inode,
+				  fscrypt_direction_t rw, struct bio_vec *bvecs,
+				  unsigned int nr_bvecs, struct page **dest_pages,
+				  gfp_t gfp_flags);
 
 /* keyinfo.c */
 extern void __exit fscrypt_essiv_cleanup(void);
 
+/* inline_crypt.c */
+#ifdef CONFIG_FS_ENCRYPTION_INLINE_CRYPT
+extern void fscrypt_inline_crypt_setup(struct fscrypt_info *ci,
+				       const struct inode *inode,
+				       const u8 *raw_key, int keysize);
+extern void fscrypt_inline_crypt_release(struct fscrypt_info *ci);
+#else
+static inline void fscrypt_inline_crypt_setup(struct fscrypt_info *ci,
+					      const struct inode *inode,
+					      const u8 *raw_key, int keysize)
+{
+}
+
+static inline void fscrypt_inline_crypt_release(struct fscrypt_info *ci)
+{
+}
+#endif
+
 #endif /* _FSCRYPT_PRIVATE_H */
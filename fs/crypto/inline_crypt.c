@@ -0,0 +1,119 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Inline encryption support for fscrypt.
+ *
+ * When the block device of a filesystem has an inline encryption engine,
+ * the contents key of each regular file is programmed into one of its key
+ * slots, and the filesystem tags its bios with that slot instead of
+ * encrypting the pages itself.  The software transform is still set up,
+ * for the paths that can't be offloaded.
+ */
+
+#include <linux/blkdev.h>
+#include <linux/keyslot-manager.h>
+#include "fscrypt_private.h"
+
+void fscrypt_inline_crypt_setup(struct fscrypt_info *ci,
+				const struct inode *inode,
+				const u8 *raw_key, int keysize)
+{
+	struct super_block *sb = inode->i_sb;
+	struct keyslot_manager *ksm;
+	int slot;
+
+	if (!S_ISREG(inode->i_mode) ||
+	    ci->ci_data_mode != FS_ENCRYPTION_MODE_AES_256_XTS)
+		return;
+
+	/* The data unit number is the page index, as for fscrypt_encrypt_page() */
+	if (!(sb->s_cop->flags & FS_CFLG_INLINE_CRYPT) || !sb->s_bdev ||
+	    sb->s_blocksize != PAGE_SIZE)
+		return;
+
+	ksm = bdev_get_queue(sb->s_bdev)->ksm;
+	if (!keyslot_manager_crypto_mode_supported(ksm,
+				BLK_ENCRYPTION_MODE_AES_256_XTS, PAGE_SIZE))
+		return;
+
+	/* Out of slots: use software encryption for this inode */
+	slot = keyslot_manager_get_slot_for_key(ksm, raw_key, keysize,
+					BLK_ENCRYPTION_MODE_AES_256_XTS);
+	if (slot < 0) {
+		pr_debug("%s: error %d (inode %lu) getting inline key slot\n",
+			 __func__, slot, inode->i_ino);
+		return;
+	}
+
+	ci->ci_ksm = ksm;
+	ci->ci_keyslot = slot;
+}
+
+void fscrypt_inline_crypt_release(struct fscrypt_info *ci)
+{
+	if (ci->ci_ksm)
+		keyslot_manager_put_slot(ci->ci_ksm, ci->ci_keyslot);
+}
+
+/**
+ * fscrypt_inode_uses_inline_crypto() - Whether the contents of an inode are
+ *					encrypted by the storage hardware
+ * @inode: The inode, with its encryption key set up
+ *
+ * If so, the filesystem submits the page cache pages themselves, tagged
+ * with fscrypt_set_bio_crypt_ctx(), and does not decrypt them on read.
+ */
+bool fscrypt_inode_uses_inline_crypto(const struct inode *inode)
+{
+	struct fscrypt_info *ci = inode->i_crypt_info;
+
+	return ci && ci->ci_ksm;
+}
+EXPORT_SYMBOL(fscrypt_inode_uses_inline_crypto);
+
+/**
+ * fscrypt_set_bio_crypt_ctx() - Tag a bio for inline encryption
+ * @bio:        The bio, before any page is added
+ * @inode:      The inode the data belongs to
+ * @first_lblk: The logical block of the first page of @bio
+ *
+ * Does nothing unless fscrypt_inode_uses_inline_crypto().
+ */
+void fscrypt_set_bio_crypt_ctx(struct bio *bio, const struct inode *inode,
+			       pgoff_t first_lblk)
+{
+	struct fscrypt_info *ci = inode->i_crypt_info;
+
+	if (!ci || !ci->ci_ksm)
+		return;
+
+	bio->bi_crypt_ksm = ci->ci_ksm;
+	bio->bi_crypt_slot = ci->ci_keyslot;
+	bio->bi_crypt_dun = first_lblk;
+}
+EXPORT_SYMBOL(fscrypt_set_bio_crypt_ctx);
+
+/**
+ * fscrypt_mergeable_bio() - Whether a page can be added to a bio
+ * @bio:       The bio being built
+ * @inode:     The inode the page belongs to
+ * @next_lblk: The logical block of the page
+ *
+ * The hardware derives the IV of each data unit from the first one of
+ * the bio, so a bio must hold contiguous blocks under the same key.
+ */
+bool fscrypt_mergeable_bio(struct bio *bio, const struct inode *inode,
+			   pgoff_t next_lblk)
+{
+	struct fscrypt_info *ci = inode->i_crypt_info;
+	struct keyslot_manager *ksm = ci ? ci->ci_ksm : NULL;
+
+	if (bio->bi_crypt_ksm != ksm)
+		return false;
+	if (!ksm)
+		return true;
+
+	return bio->bi_crypt_slot == ci->ci_keyslot &&
+	       bio->bi_crypt_dun + (bio->bi_iter.bi_size >> PAGE_SHIFT) ==
+	       next_lblk;
+}
+EXPORT_SYMBOL(fscrypt_mergeable_bio);
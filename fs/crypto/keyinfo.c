@@ -183,6 +183,7 @@ static void put_crypt_info(struct fscrypt_info *ci)
 	if (!ci)
 		return;
 
+	fscrypt_inline_crypt_release(ci);
 	crypto_free_skcipher(ci->ci_ctfm);
 	crypto_free_cipher(ci->ci_essiv_tfm);
 	kmem_cache_free(fscrypt_info_cachep, ci);
@@ -301,6 +302,9 @@ int fscrypt_get_encryption_info(struct inode *inode)
 	crypt_info->ci_filename_mode = ctx.filenames_encryption_mode;
 	crypt_info->ci_ctfm = NULL;
 	crypt_info->ci_essiv_tfm = NULL;
+#ifdef CONFIG_FS_ENCRYPTION_INLINE_CRYPT
+	crypt_info->ci_ksm = NULL;
+#endif
 	memcpy(crypt_info->ci_master_key, ctx.master_key_descriptor,
 				sizeof(crypt_info->ci_master_key));
 
@@ -358,6 +362,8 @@ int fscrypt_get_encryption_info(struct inode *inode)
 			goto out;
 		}
 	}
+	/* The software tfm is kept for the paths that can't use hardware */
+	fscrypt_inline_crypt_setup(crypt_info, inode, raw_key, keysize);
 	if (cmpxchg(&inode->i_crypt_info, NULL, crypt_info) == NULL)
 		crypt_info = NULL;
 out:
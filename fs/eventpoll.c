@@ -43,6 +43,8 @@
 #include <linux/seq_file.h>
 #include <linux/compat.h>
 #include <linux/rculist.h>
+#include <linux/llist.h>
+#include <linux/percpu.h>
 #include <net/busy_poll.h>
 
 /*
@@ -58,7 +60,11 @@
  * from inside the poll callback, that might be triggered from
  * a wake_up() that in turn might be called from IRQ context.
  * So we can't sleep inside the poll callback and hence we need
- * a spinlock. During the event transfer loop (from kernel to
+ * a spinlock. The poll callback itself only takes it to wake up
+ * sleepers in sys_epoll_wait(): ready items are first pushed on a
+ * lockless per-CPU list, and moved to the ready list by the consumer,
+ * under ep->lock, see ep_merge_ready(). During the event transfer
+ * loop (from kernel to
  * user space) we could end up sleeping due a copy_to_user(), so
  * we need a lock that will allow us to sleep. This lock is a
  * mutex (ep->mtx). It is acquired during the event transfer loop,
@@ -152,10 +158,10 @@ struct epitem {
 	struct list_head rdllink;
 
 	/*
-	 * Works together "struct eventpoll"->ovflist in keeping the
-	 * single linked chain of items.
+	 * Links the item to one of the per-CPU lists of ready items of
+	 * "struct eventpoll". ->next is EP_UNACTIVE_PTR while it is on none.
 	 */
-	struct epitem *next;
+	struct llist_node rdlnode;
 
 	/* The file descriptor information this item refers to */
 	struct epoll_filefd ffd;
@@ -209,11 +215,13 @@ struct eventpoll {
 	struct rb_root_cached rbr;
 
 	/*
-	 * This is a single linked list that chains all the "struct epitem" that
-	 * happened while transferring ready events to userspace w/out
-	 * holding ->lock.
+	 * Items made ready by the poll callback, on the CPU it ran on. They
+	 * are moved to ->rdllist by the consumer, so that the callbacks of
+	 * different CPUs don't contend on ->lock, and so that events that
+	 * happen while transferring ready events to userspace w/out holding
+	 * ->lock are not lost.
 	 */
-	struct epitem *ovflist;
+	struct llist_head __percpu *pcpu_rdllist;
 
 	/* wakeup_source used when ep_scan_ready_list is running */
 	struct wakeup_source *ws;
@@ -388,7 +396,16 @@ static void ep_nested_calls_init(struct nested_calls *ncalls)
  */
 static inline int ep_events_available(struct eventpoll *ep)
 {
-	return !list_empty(&ep->rdllist) || ep->ovflist != EP_UNACTIVE_PTR;
+	int cpu;
+
+	if (!list_empty(&ep->rdllist))
+		return 1;
+
+	for_each_possible_cpu(cpu)
+		if (!llist_empty(per_cpu_ptr(ep->pcpu_rdllist, cpu)))
+			return 1;
+
+	return 0;
 }
 
 #ifdef CONFIG_NET_RX_BUSY_POLL
@@ -664,6 +681,53 @@ static inline void ep_pm_stay_awake_rcu(struct epitem *epi)
 	rcu_read_unlock();
 }
 
+/*
+ * Moves the items queued by the poll callback to the ready list, oldest
+ * first. Must be called with "ep->lock" held, or the items of a CPU could
+ * be reordered by two concurrent merges.
+ */
+static void ep_merge_ready(struct eventpoll *ep)
+{
+	struct llist_node *node, *next;
+	struct epitem *epi;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		node = llist_del_all(per_cpu_ptr(ep->pcpu_rdllist, cpu));
+		node = llist_reverse_order(node);
+		for (; node; node = next) {
+			next = node->next;
+			epi = llist_entry(node, struct epitem, rdlnode);
+
+			/* Let the poll callback queue the item again */
+			smp_store_release(&node->next, EP_UNACTIVE_PTR);
+
+			/*
+			 * The item may already be on the ready list, or on
+			 * the "txlist" of ep_scan_ready_list(), which is
+			 * spliced back after us.
+			 */
+			if (!ep_is_linked(&epi->rdllink)) {
+				list_add_tail(&epi->rdllink, &ep->rdllist);
+				ep_pm_stay_awake(epi);
+			}
+		}
+	}
+}
+
+/* Unlinks a removed item, which the poll callback can no longer queue */
+static void ep_unlink_ready(struct eventpoll *ep, struct epitem *epi)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&ep->lock, flags);
+	if (READ_ONCE(epi->rdlnode.next) != EP_UNACTIVE_PTR)
+		ep_merge_ready(ep);
+	if (ep_is_linked(&epi->rdllink))
+		list_del_init(&epi->rdllink);
+	spin_unlock_irqrestore(&ep->lock, flags);
+}
+
 /**
  * ep_scan_ready_list - Scans the ready list in a way that makes possible for
  *                      the scan code, to call f_op->poll(). Also allows for
@@ -684,7 +748,6 @@ static int ep_scan_ready_list(struct eventpoll *ep,
 {
 	int error, pwake = 0;
 	unsigned long flags;
-	struct epitem *epi, *nepi;
 	LIST_HEAD(txlist);
 
 	/*
@@ -697,15 +760,14 @@ static int ep_scan_ready_list(struct eventpoll *ep,
 
 	/*
 	 * Steal the ready list, and re-init the original one to the
-	 * empty list. Also, set ep->ovflist to NULL so that events
-	 * happening while looping w/out locks, are not lost. We cannot
-	 * have the poll callback to queue directly on ep->rdllist,
-	 * because we want the "sproc" callback to be able to do it
-	 * in a lockless way.
+	 * empty list. Events happening while looping w/out locks stay
+	 * on the per-CPU lists, the poll callback never queues directly
+	 * on ep->rdllist, because we want the "sproc" callback to be
+	 * able to do it in a lockless way.
 	 */
 	spin_lock_irqsave(&ep->lock, flags);
+	ep_merge_ready(ep);
 	list_splice_init(&ep->rdllist, &txlist);
-	ep->ovflist = NULL;
 	spin_unlock_irqrestore(&ep->lock, flags);
 
 	/*
@@ -719,25 +781,7 @@ static int ep_scan_ready_list(struct eventpoll *ep,
 	 * other events might have been queued by the poll callback.
 	 * We re-insert them inside the main ready-list here.
 	 */
-	for (nepi = ep->ovflist; (epi = nepi) != NULL;
-	     nepi = epi->next, epi->next = EP_UNACTIVE_PTR) {
-		/*
-		 * We need to check if the item is already in the list.
-		 * During the "sproc" callback execution time, items are
-		 * queued into ->ovflist but the "txlist" might already
-		 * contain them, and the list_splice() below takes care of them.
-		 */
-		if (!ep_is_linked(&epi->rdllink)) {
-			list_add_tail(&epi->rdllink, &ep->rdllist);
-			ep_pm_stay_awake(epi);
-		}
-	}
-	/*
-	 * We need to set back ep->ovflist to EP_UNACTIVE_PTR, so that after
-	 * releasing the lock, events will be queued in the normal way inside
-	 * ep->rdllist.
-	 */
-	ep->ovflist = EP_UNACTIVE_PTR;
+	ep_merge_ready(ep);
 
 	/*
 	 * Quickly re-inject items left on "txlist".
@@ -779,7 +823,6 @@ static void epi_rcu_free(struct rcu_head *head)
  */
 static int ep_remove(struct eventpoll *ep, struct epitem *epi)
 {
-	unsigned long flags;
 	struct file *file = epi->ffd.file;
 
 	/*
@@ -799,10 +842,7 @@ static int ep_remove(struct eventpoll *ep, struct epitem *epi)
 
 	rb_erase_cached(&epi->rbn, &ep->rbr);
 
-	spin_lock_irqsave(&ep->lock, flags);
-	if (ep_is_linked(&epi->rdllink))
-		list_del_init(&epi->rdllink);
-	spin_unlock_irqrestore(&ep->lock, flags);
+	ep_unlink_ready(ep, epi);
 
 	wakeup_source_unregister(ep_wakeup_source(epi));
 	/*
@@ -868,6 +908,7 @@ static void ep_free(struct eventpoll *ep)
 	mutex_destroy(&ep->mtx);
 	free_uid(ep->user);
 	wakeup_source_unregister(ep->ws);
+	free_percpu(ep->pcpu_rdllist);
 	kfree(ep);
 }
 
@@ -1036,19 +1077,24 @@ static int ep_alloc(struct eventpoll **pep)
 	if (unlikely(!ep))
 		goto free_uid;
 
+	ep->pcpu_rdllist = alloc_percpu(struct llist_head);
+	if (unlikely(!ep->pcpu_rdllist))
+		goto free_ep;
+
 	spin_lock_init(&ep->lock);
 	mutex_init(&ep->mtx);
 	init_waitqueue_head(&ep->wq);
 	init_waitqueue_head(&ep->poll_wait);
 	INIT_LIST_HEAD(&ep->rdllist);
 	ep->rbr = RB_ROOT_CACHED;
-	ep->ovflist = EP_UNACTIVE_PTR;
 	ep->user = user;
 
 	*pep = ep;
 
 	return 0;
 
+free_ep:
+	kfree(ep);
 free_uid:
 	free_uid(user);
 	return error;
@@ -1140,8 +1186,6 @@ static int ep_poll_callback(wait_queue_entry_t *wait, unsigned mode, int sync, v
 	struct eventpoll *ep = epi->ep;
 	int ewake = 0;
 
-	spin_lock_irqsave(&ep->lock, flags);
-
 	ep_set_busy_poll_napi_id(epi);
 
 	/*
@@ -1163,36 +1207,20 @@ static int ep_poll_callback(wait_queue_entry_t *wait, unsigned mode, int sync, v
 		goto out_unlock;
 
 	/*
-	 * If we are transferring events to userspace, we can hold no locks
-	 * (because we're accessing user memory, and because of linux f_op->poll()
-	 * semantics). All the events that happen during that period of time are
-	 * chained in ep->ovflist and requeued later on.
+	 * Queue the item on the list of this CPU, unless it already is on
+	 * one, without any lock: the consumer moves it to ep->rdllist, and
+	 * may be transferring events to userspace right now.
 	 */
-	if (unlikely(ep->ovflist != EP_UNACTIVE_PTR)) {
-		if (epi->next == EP_UNACTIVE_PTR) {
-			epi->next = ep->ovflist;
-			ep->ovflist = epi;
-			if (epi->ws) {
-				/*
-				 * Activate ep->ws since epi->ws may get
-				 * deactivated at any time.
-				 */
-				__pm_stay_awake(ep->ws);
-			}
-
-		}
-		goto out_unlock;
-	}
-
-	/* If this file is already in the ready list we exit soon */
-	if (!ep_is_linked(&epi->rdllink)) {
-		list_add_tail(&epi->rdllink, &ep->rdllist);
+	if (cmpxchg(&epi->rdlnode.next, EP_UNACTIVE_PTR, NULL) ==
+	    EP_UNACTIVE_PTR) {
+		llist_add(&epi->rdlnode, this_cpu_ptr(ep->pcpu_rdllist));
 		ep_pm_stay_awake_rcu(epi);
 	}
 
 	/*
 	 * Wake up ( if active ) both the eventpoll wait list and the ->poll()
-	 * wait list.
+	 * wait list. The llist_add() above orders the queueing before the
+	 * check, against the waiter adding itself before checking the lists.
 	 */
 	if (waitqueue_active(&ep->wq)) {
 		if ((epi->event.events & EPOLLEXCLUSIVE) &&
@@ -1211,20 +1239,27 @@ static int ep_poll_callback(wait_queue_entry_t *wait, unsigned mode, int sync, v
 				break;
 			}
 		}
+		spin_lock_irqsave(&ep->lock, flags);
 		wake_up_locked(&ep->wq);
+		spin_unlock_irqrestore(&ep->lock, flags);
 	}
 	if (waitqueue_active(&ep->poll_wait))
 		pwake++;
 
 out_unlock:
-	spin_unlock_irqrestore(&ep->lock, flags);
-
 	/* We have to call this outside the lock */
 	if (pwake)
 		ep_poll_safewake(&ep->poll_wait);
 
 	if (!(epi->event.events & EPOLLEXCLUSIVE))
 		ewake = 1;
+	else if (ewake && !((unsigned long)key & POLLFREE))
+		/*
+		 * Round-robin among the epoll instances sharing the file:
+		 * the one that takes this wakeup goes behind the others.
+		 * The caller holds the wait queue head lock.
+		 */
+		list_move_tail(&wait->entry, &ep_pwq_from_wait(wait)->whead->head);
 
 	if ((unsigned long)key & POLLFREE) {
 		/*
@@ -1453,7 +1488,7 @@ static int ep_insert(struct eventpoll *ep, struct epoll_event *event,
 	ep_set_ffd(&epi->ffd, tfile, fd);
 	epi->event = *event;
 	epi->nwait = 0;
-	epi->next = EP_UNACTIVE_PTR;
+	epi->rdlnode.next = EP_UNACTIVE_PTR;
 	if (epi->event.events & EPOLLWAKEUP) {
 		error = ep_create_wakeup_source(epi);
 		if (error)
@@ -1540,14 +1575,9 @@ static int ep_insert(struct eventpoll *ep, struct epoll_event *event,
 
 	/*
 	 * We need to do this because an event could have been arrived on some
-	 * allocated wait queue. Note that we don't care about the ep->ovflist
-	 * list, since that is used/cleaned only inside a section bound by "mtx".
-	 * And ep_insert() is called with "mtx" held.
+	 * allocated wait queue.
 	 */
-	spin_lock_irqsave(&ep->lock, flags);
-	if (ep_is_linked(&epi->rdllink))
-		list_del_init(&epi->rdllink);
-	spin_unlock_irqrestore(&ep->lock, flags);
+	ep_unlink_ready(ep, epi);
 
 	wakeup_source_unregister(ep_wakeup_source(epi));
 
@@ -1704,7 +1734,7 @@ static int ep_send_events_proc(struct eventpoll *ep, struct list_head *head,
 				 * into ep->rdllist besides us. The epoll_ctl()
 				 * callers are locked out by
 				 * ep_scan_ready_list() holding "mtx" and the
-				 * poll callback will queue them in ep->ovflist.
+				 * poll callback queues on the per-CPU lists.
 				 */
 				list_add_tail(&epi->rdllink, &ep->rdllist);
 				ep_pm_stay_awake(epi);
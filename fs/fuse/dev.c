@@ -23,6 +23,9 @@
 #include <linux/splice.h>
 #include <linux/sched.h>
 #include <linux/freezer.h>
+#include <linux/vmalloc.h>
+#include <linux/bvec.h>
+#include <linux/sched/clock.h>
 
 MODULE_ALIAS_MISCDEV(FUSE_MINOR);
 MODULE_ALIAS("devname:fuse");
@@ -307,12 +310,59 @@ static u64 fuse_get_unique(struct fuse_iqueue *fiq)
 	return ++fiq->reqctr;
 }
 
+/*
+ * Find a device with a reader sleeping on the submitting CPU, so that
+ * the request is handled by the daemon thread that shares our caches.
+ *
+ * Called with fiq->waitq.lock held
+ */
+static struct fuse_dev *fuse_steer_dev(struct fuse_iqueue *fiq)
+{
+	int cpu = smp_processor_id();
+	struct fuse_dev *fud;
+
+	list_for_each_entry(fud, &fiq->readers, iq_entry) {
+		if (fud->cpu == cpu && waitqueue_active(&fud->waitq))
+			return fud;
+	}
+	return NULL;
+}
+
+/*
+ * Wake a single idle reader, preferring one on the current CPU, and
+ * anyone polling the connection.
+ *
+ * Called with fiq->waitq.lock held
+ */
+static void fuse_wake_reader(struct fuse_iqueue *fiq)
+{
+	struct fuse_dev *fud = fuse_steer_dev(fiq);
+
+	if (!fud) {
+		list_for_each_entry(fud, &fiq->readers, iq_entry) {
+			if (waitqueue_active(&fud->waitq))
+				break;
+		}
+	}
+	if (&fud->iq_entry != &fiq->readers)
+		wake_up(&fud->waitq);
+	wake_up_locked(&fiq->waitq);
+}
+
 static void queue_request(struct fuse_iqueue *fiq, struct fuse_req *req)
 {
+	struct fuse_dev *fud = fuse_steer_dev(fiq);
+
 	req->in.h.len = sizeof(struct fuse_in_header) +
 		len_args(req->in.numargs, (struct fuse_arg *) req->in.args);
-	list_add_tail(&req->list, &fiq->pending);
-	wake_up_locked(&fiq->waitq);
+	if (fud) {
+		list_add_tail(&req->list, &fud->pending);
+		wake_up(&fud->waitq);
+		wake_up_locked(&fiq->waitq);
+	} else {
+		list_add_tail(&req->list, &fiq->pending);
+		fuse_wake_reader(fiq);
+	}
 	kill_fasync(&fiq->fasync, SIGIO, POLL_IN);
 }
 
@@ -328,7 +378,7 @@ void fuse_queue_forget(struct fuse_conn *fc, struct fuse_forget_link *forget,
 	if (fiq->connected) {
 		fiq->forget_list_tail->next = forget;
 		fiq->forget_list_tail = forget;
-		wake_up_locked(&fiq->waitq);
+		fuse_wake_reader(fiq);
 		kill_fasync(&fiq->fasync, SIGIO, POLL_IN);
 	} else {
 		kfree(forget);
@@ -408,7 +458,7 @@ static void queue_interrupt(struct fuse_iqueue *fiq, struct fuse_req *req)
 	}
 	if (list_empty(&req->intr_entry)) {
 		list_add_tail(&req->intr_entry, &fiq->interrupts);
-		wake_up_locked(&fiq->waitq);
+		fuse_wake_reader(fiq);
 	}
 	spin_unlock(&fiq->waitq.lock);
 	kill_fasync(&fiq->fasync, SIGIO, POLL_IN);
@@ -688,7 +738,10 @@ struct fuse_copy_state {
 	struct page *pg;
 	unsigned len;
 	unsigned offset;
+	unsigned ref_bytes;
+	unsigned copied_bytes;
 	unsigned move_pages:1;
+	unsigned ring:1;
 };
 
 static void fuse_copy_init(struct fuse_copy_state *cs, int write,
@@ -711,7 +764,9 @@ static void fuse_copy_finish(struct fuse_copy_state *cs)
 	} else if (cs->pg) {
 		if (cs->write) {
 			flush_dcache_page(cs->pg);
-			set_page_dirty_lock(cs->pg);
+			/* ring pages are not page cache */
+			if (!cs->ring)
+				set_page_dirty_lock(cs->pg);
 		}
 		put_page(cs->pg);
 	}
@@ -946,6 +1001,18 @@ static int fuse_ref_page(struct fuse_copy_state *cs, struct page *page,
 	return 0;
 }
 
+/*
+ * Fragments smaller than this are copied into the current pipe buffer
+ * rather than each taking a pipe slot of their own
+ */
+#define FUSE_REF_MIN_BYTES (PAGE_SIZE / 2)
+
+static bool fuse_can_ref_page(struct fuse_copy_state *cs, unsigned count)
+{
+	return count >= FUSE_REF_MIN_BYTES &&
+		cs->nr_segs < cs->pipe->buffers;
+}
+
 /*
  * Copy a page in the request to/from the userspace buffer.  Must be
  * done atomically
@@ -960,8 +1027,12 @@ static int fuse_copy_page(struct fuse_copy_state *cs, struct page **pagep,
 		clear_highpage(page);
 
 	while (count) {
-		if (cs->write && cs->pipebufs && page) {
-			return fuse_ref_page(cs, page, offset, count);
+		if (cs->write && cs->pipebufs && page &&
+		    fuse_can_ref_page(cs, count)) {
+			err = fuse_ref_page(cs, page, offset, count);
+			if (!err)
+				cs->ref_bytes += count;
+			return err;
 		} else if (!cs->len) {
 			if (cs->move_pages && page &&
 			    offset == 0 && count == PAGE_SIZE) {
@@ -977,8 +1048,12 @@ static int fuse_copy_page(struct fuse_copy_state *cs, struct page **pagep,
 		if (page) {
 			void *mapaddr = kmap_atomic(page);
 			void *buf = mapaddr + offset;
-			offset += fuse_copy_do(cs, &buf, &count);
+			unsigned ncpy = fuse_copy_do(cs, &buf, &count);
+
 			kunmap_atomic(mapaddr);
+			offset += ncpy;
+			if (cs->write)
+				cs->copied_bytes += ncpy;
 		} else
 			offset += fuse_copy_do(cs, NULL, &count);
 	}
@@ -1052,6 +1127,68 @@ static int request_pending(struct fuse_iqueue *fiq)
 		forget_pending(fiq);
 }
 
+/*
+ * Pick the list the next request for @fud is taken from: requests
+ * steered to it come first, then unsteered ones, and an otherwise idle
+ * reader steals from the other devices.
+ *
+ * Called with fiq->waitq.lock held
+ */
+static struct list_head *fuse_dev_pending(struct fuse_iqueue *fiq,
+					  struct fuse_dev *fud)
+{
+	struct fuse_dev *other;
+
+	if (!list_empty(&fud->pending))
+		return &fud->pending;
+	if (!list_empty(&fiq->pending))
+		return &fiq->pending;
+	list_for_each_entry(other, &fiq->readers, iq_entry) {
+		if (!list_empty(&other->pending))
+			return &other->pending;
+	}
+	return NULL;
+}
+
+static bool fuse_dev_request_pending(struct fuse_iqueue *fiq,
+				     struct fuse_dev *fud)
+{
+	return !list_empty(&fiq->interrupts) || forget_pending(fiq) ||
+		fuse_dev_pending(fiq, fud);
+}
+
+/*
+ * Wait until there is something for @fud to read.  Each device has its
+ * own wait queue, so a request steered to a device only wakes a reader
+ * of that device.
+ *
+ * Called with fiq->waitq.lock held, which is dropped while sleeping
+ */
+static int fuse_dev_wait(struct fuse_iqueue *fiq, struct fuse_dev *fud)
+{
+	DEFINE_WAIT(wait);
+	int err = 0;
+
+	fud->cpu = smp_processor_id();
+	for (;;) {
+		prepare_to_wait_exclusive(&fud->waitq, &wait,
+					  TASK_INTERRUPTIBLE);
+		if (!fiq->connected || fuse_dev_request_pending(fiq, fud))
+			break;
+		if (signal_pending(current)) {
+			err = -ERESTARTSYS;
+			break;
+		}
+		spin_unlock(&fiq->waitq.lock);
+		schedule();
+		spin_lock(&fiq->waitq.lock);
+		fud->cpu = smp_processor_id();
+	}
+	finish_wait(&fud->waitq, &wait);
+
+	return err;
+}
+
 /*
  * Transfer an interrupt request to userspace
  *
@@ -1222,6 +1359,7 @@ static ssize_t fuse_dev_do_read(struct fuse_dev *fud, struct file *file,
 	struct fuse_conn *fc = fud->fc;
 	struct fuse_iqueue *fiq = &fc->iq;
 	struct fuse_pqueue *fpq = &fud->pq;
+	struct list_head *pending;
 	struct fuse_req *req;
 	struct fuse_in *in;
 	unsigned reqsize;
@@ -1229,12 +1367,11 @@ static ssize_t fuse_dev_do_read(struct fuse_dev *fud, struct file *file,
  restart:
 	spin_lock(&fiq->waitq.lock);
 	err = -EAGAIN;
-	if ((file->f_flags & O_NONBLOCK) && fiq->connected &&
-	    !request_pending(fiq))
+	if (((file->f_flags & O_NONBLOCK) || cs->ring) && fiq->connected &&
+	    !fuse_dev_request_pending(fiq, fud))
 		goto err_unlock;
 
-	err = wait_event_interruptible_exclusive_locked(fiq->waitq,
-				!fiq->connected || request_pending(fiq));
+	err = fuse_dev_wait(fiq, fud);
 	if (err)
 		goto err_unlock;
 
@@ -1248,15 +1385,21 @@ static ssize_t fuse_dev_do_read(struct fuse_dev *fud, struct file *file,
 		return fuse_read_interrupt(fiq, cs, nbytes, req);
 	}
 
+	pending = fuse_dev_pending(fiq, fud);
 	if (forget_pending(fiq)) {
-		if (list_empty(&fiq->pending) || fiq->forget_batch-- > 0)
+		if (!pending || fiq->forget_batch-- > 0)
 			return fuse_read_forget(fc, fiq, cs, nbytes);
 
 		if (fiq->forget_batch <= -8)
 			fiq->forget_batch = 16;
 	}
 
-	req = list_entry(fiq->pending.next, struct fuse_req, list);
+	req = list_entry(pending->next, struct fuse_req, list);
+	/* Leave requests that don't fit a ring slot to read() */
+	err = -EMSGSIZE;
+	if (cs->ring && req->in.h.len > nbytes)
+		goto err_unlock;
+
 	clear_bit(FR_PENDING, &req->flags);
 	list_del_init(&req->list);
 	spin_unlock(&fiq->waitq.lock);
@@ -1288,6 +1431,10 @@ static ssize_t fuse_dev_do_read(struct fuse_dev *fud, struct file *file,
 		err = fuse_copy_args(cs, in->numargs, in->argpages,
 				     (struct fuse_arg *) in->args, 0);
 	fuse_copy_finish(cs);
+	if (cs->ref_bytes)
+		atomic64_add(cs->ref_bytes, &fc->ref_bytes);
+	if (cs->copied_bytes)
+		atomic64_add(cs->copied_bytes, &fc->copied_bytes);
 	spin_lock(&fpq->lock);
 	clear_bit(FR_LOCKED, &req->flags);
 	if (!fpq->connected) {
@@ -2027,7 +2174,7 @@ static unsigned fuse_dev_poll(struct file *file, poll_table *wait)
 	spin_lock(&fiq->waitq.lock);
 	if (!fiq->connected)
 		mask = POLLERR;
-	else if (request_pending(fiq))
+	else if (fuse_dev_request_pending(fiq, fud))
 		mask |= POLLIN | POLLRDNORM;
 	spin_unlock(&fiq->waitq.lock);
 
@@ -2122,6 +2269,10 @@ void fuse_abort_conn(struct fuse_conn *fc)
 		spin_lock(&fiq->waitq.lock);
 		fiq->connected = 0;
 		list_splice_init(&fiq->pending, &to_end2);
+		list_for_each_entry(fud, &fiq->readers, iq_entry) {
+			list_splice_init(&fud->pending, &to_end2);
+			wake_up_all(&fud->waitq);
+		}
 		list_for_each_entry(req, &to_end2, list)
 			clear_bit(FR_PENDING, &req->flags);
 		while (forget_pending(fiq))
@@ -2146,6 +2297,286 @@ void fuse_abort_conn(struct fuse_conn *fc)
 }
 EXPORT_SYMBOL_GPL(fuse_abort_conn);
 
+#define FUSE_RING_MAX_ENTRIES		1024
+#define FUSE_RING_MAX_ENTRY_SIZE	(256 * 1024)
+#define FUSE_RING_MAX_SIZE		(64 * 1024 * 1024)
+#define FUSE_RING_SPIN_MIN_NS		1000
+#define FUSE_RING_SPIN_MAX_NS		50000
+
+static void fuse_ring_free(struct fuse_ring *ring)
+{
+	if (!ring)
+		return;
+	vfree(ring->mem);
+	kfree(ring->bvec);
+	kfree(ring->busy);
+	kfree(ring);
+}
+
+static long fuse_ring_setup(struct fuse_dev *fud,
+			    struct fuse_ring_params __user *uparams)
+{
+	struct fuse_ring_params params;
+	struct fuse_ring *ring;
+	size_t hdr_size, size;
+	int err;
+
+	if (copy_from_user(&params, uparams, sizeof(params)))
+		return -EFAULT;
+
+	if (params.flags || !params.entries ||
+	    params.entries > FUSE_RING_MAX_ENTRIES ||
+	    !is_power_of_2(params.entries) ||
+	    params.entry_size < FUSE_MIN_READ_BUFFER ||
+	    params.entry_size > FUSE_RING_MAX_ENTRY_SIZE ||
+	    !PAGE_ALIGNED(params.entry_size))
+		return -EINVAL;
+
+	hdr_size = PAGE_ALIGN(sizeof(struct fuse_ring_header) +
+			      2 * params.entries * sizeof(u32));
+	size = hdr_size + (size_t)params.entries * params.entry_size;
+	if (size > FUSE_RING_MAX_SIZE)
+		return -EINVAL;
+
+	err = -ENOMEM;
+	ring = kzalloc(sizeof(*ring), GFP_KERNEL);
+	if (!ring)
+		return -ENOMEM;
+
+	ring->mem = vmalloc_user(size);
+	ring->busy = kcalloc(BITS_TO_LONGS(params.entries),
+			     sizeof(unsigned long), GFP_KERNEL);
+	ring->bvec = kcalloc(params.entry_size >> PAGE_SHIFT,
+			     sizeof(struct bio_vec), GFP_KERNEL);
+	if (!ring->mem || !ring->busy || !ring->bvec)
+		goto out_free;
+
+	mutex_init(&ring->lock);
+	ring->size = size;
+	ring->hdr = ring->mem;
+	ring->sq = ring->mem + sizeof(struct fuse_ring_header);
+	ring->cq = ring->sq + params.entries;
+	ring->slot_offset = hdr_size;
+	ring->entries = params.entries;
+	ring->entry_size = params.entry_size;
+	ring->spin_ns = FUSE_RING_SPIN_MIN_NS;
+
+	params.slot_offset = hdr_size;
+	params.ring_size = size;
+	err = -EFAULT;
+	if (copy_to_user(uparams, &params, sizeof(params)))
+		goto out_free;
+
+	/* pairs with smp_load_acquire() in fuse_get_ring() */
+	err = -EBUSY;
+	if (cmpxchg_release(&fud->ring, NULL, ring))
+		goto out_free;
+
+	return 0;
+
+out_free:
+	fuse_ring_free(ring);
+	return err;
+}
+
+static struct fuse_ring *fuse_get_ring(struct fuse_dev *fud)
+{
+	return smp_load_acquire(&fud->ring);
+}
+
+/* Point @iter at the first @len bytes of slot @idx */
+static void fuse_ring_slot_iter(struct fuse_ring *ring, unsigned int idx,
+				size_t len, int dir, struct iov_iter *iter)
+{
+	void *slot = ring->mem + ring->slot_offset +
+		     (size_t)idx * ring->entry_size;
+	unsigned int i, nr = DIV_ROUND_UP(len, PAGE_SIZE);
+
+	for (i = 0; i < nr; i++) {
+		ring->bvec[i].bv_page = vmalloc_to_page(slot + i * PAGE_SIZE);
+		ring->bvec[i].bv_offset = 0;
+		ring->bvec[i].bv_len = PAGE_SIZE;
+	}
+	iov_iter_bvec(iter, ITER_BVEC | dir, ring->bvec, nr, len);
+}
+
+/* Pass the replies on the completion queue to their requests */
+static int fuse_ring_complete(struct fuse_dev *fud, struct fuse_ring *ring)
+{
+	struct fuse_ring_header *hdr = ring->hdr;
+	u32 head = ring->cq_head;
+	u32 tail = smp_load_acquire(&hdr->cq_tail);
+	struct fuse_copy_state cs;
+	struct iov_iter iter;
+	unsigned int idx;
+	u32 len;
+
+	if (tail - head > ring->entries)
+		return -EINVAL;
+
+	for (; head != tail; head++) {
+		idx = READ_ONCE(ring->cq[head & (ring->entries - 1)]);
+		if (idx >= ring->entries || !test_and_clear_bit(idx, ring->busy))
+			continue;
+
+		len = READ_ONCE(((struct fuse_out_header *)(ring->mem +
+				ring->slot_offset +
+				(size_t)idx * ring->entry_size))->len);
+		if (!len || len > ring->entry_size)
+			continue;
+
+		fuse_ring_slot_iter(ring, idx, len, WRITE, &iter);
+		fuse_copy_init(&cs, 0, &iter);
+		cs.ring = 1;
+		fuse_dev_do_write(fud, &cs, len);
+	}
+
+	ring->cq_head = head;
+	smp_store_release(&hdr->cq_head, head);
+	return 0;
+}
+
+/* Move pending requests into free slots, returns how many were posted */
+static int fuse_ring_submit(struct fuse_dev *fud, struct file *file,
+			    struct fuse_ring *ring)
+{
+	struct fuse_ring_header *hdr = ring->hdr;
+	struct fuse_copy_state cs;
+	struct iov_iter iter;
+	unsigned int idx;
+	u32 flags = 0;
+	ssize_t err = 0;
+	int posted = 0;
+
+	for (;;) {
+		idx = find_first_zero_bit(ring->busy, ring->entries);
+		if (idx >= ring->entries)
+			break;
+
+		fuse_ring_slot_iter(ring, idx, ring->entry_size, READ, &iter);
+		fuse_copy_init(&cs, 1, &iter);
+		cs.ring = 1;
+		err = fuse_dev_do_read(fud, file, &cs, ring->entry_size);
+		if (err < 0) {
+			if (err == -EMSGSIZE)
+				flags |= FUSE_RING_NEED_READ;
+			break;
+		}
+
+		set_bit(idx, ring->busy);
+		WRITE_ONCE(ring->sq[ring->sq_tail & (ring->entries - 1)], idx);
+		ring->sq_tail++;
+		posted++;
+	}
+
+	WRITE_ONCE(hdr->flags, flags);
+	if (posted)
+		smp_store_release(&hdr->sq_tail, ring->sq_tail);
+
+	if (!posted && err != -EAGAIN && err != -EMSGSIZE && err < 0)
+		return err;
+	return posted;
+}
+
+/*
+ * Adaptive polling: spin for a window that grows while requests keep
+ * arriving within it and shrinks when they don't, then sleep.
+ */
+static int fuse_ring_wait(struct fuse_dev *fud, struct fuse_ring *ring)
+{
+	struct fuse_iqueue *fiq = &fud->fc->iq;
+	unsigned int spin_ns = READ_ONCE(ring->spin_ns);
+	u64 start = local_clock();
+	int err;
+
+	while (local_clock() - start < spin_ns) {
+		if (request_pending(fiq) || !list_empty(&fud->pending) ||
+		    !READ_ONCE(fiq->connected)) {
+			WRITE_ONCE(ring->spin_ns, min_t(unsigned int,
+					spin_ns * 2, FUSE_RING_SPIN_MAX_NS));
+			return 0;
+		}
+		if (need_resched() || signal_pending(current))
+			break;
+		cpu_relax();
+	}
+	WRITE_ONCE(ring->spin_ns, max_t(unsigned int,
+			spin_ns / 2, FUSE_RING_SPIN_MIN_NS));
+
+	spin_lock(&fiq->waitq.lock);
+	err = fuse_dev_wait(fiq, fud);
+	spin_unlock(&fiq->waitq.lock);
+
+	return err;
+}
+
+static long fuse_ring_enter(struct fuse_dev *fud, struct file *file,
+			    u32 __user *uflags)
+{
+	struct fuse_ring *ring = fuse_get_ring(fud);
+	u32 flags;
+	int ret;
+
+	if (!ring)
+		return -EINVAL;
+	if (get_user(flags, uflags))
+		return -EFAULT;
+	if (flags & ~FUSE_RING_ENTER_GETEVENTS)
+		return -EINVAL;
+
+	mutex_lock(&ring->lock);
+	ret = fuse_ring_complete(fud, ring);
+	if (!ret)
+		ret = fuse_ring_submit(fud, file, ring);
+	mutex_unlock(&ring->lock);
+
+	while (!ret && (flags & FUSE_RING_ENTER_GETEVENTS) &&
+	       !(READ_ONCE(ring->hdr->flags) & FUSE_RING_NEED_READ)) {
+		ret = fuse_ring_wait(fud, ring);
+		if (ret)
+			break;
+
+		mutex_lock(&ring->lock);
+		ret = fuse_ring_submit(fud, file, ring);
+		mutex_unlock(&ring->lock);
+	}
+
+	return ret;
+}
+
+static int fuse_dev_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct fuse_dev *fud = fuse_get_dev(file);
+	struct fuse_ring *ring;
+
+	if (!fud)
+		return -EPERM;
+
+	ring = fuse_get_ring(fud);
+	if (!ring || vma->vm_pgoff ||
+	    vma->vm_end - vma->vm_start > ring->size)
+		return -EINVAL;
+
+	return remap_vmalloc_range(vma, ring->mem, 0);
+}
+
+/*
+ * Stop steering requests to a device that is going away and hand the
+ * ones already queued on it back to the other readers.
+ */
+static void fuse_dev_unsteer(struct fuse_dev *fud)
+{
+	struct fuse_iqueue *fiq = &fud->fc->iq;
+
+	spin_lock(&fiq->waitq.lock);
+	list_del_init(&fud->iq_entry);
+	if (!list_empty(&fud->pending)) {
+		list_splice_init(&fud->pending, &fiq->pending);
+		fuse_wake_reader(fiq);
+	}
+	spin_unlock(&fiq->waitq.lock);
+}
+
 int fuse_dev_release(struct inode *inode, struct file *file)
 {
 	struct fuse_dev *fud = fuse_get_dev(file);
@@ -2156,11 +2587,13 @@ int fuse_dev_release(struct inode *inode, struct file *file)
 
 		WARN_ON(!list_empty(&fpq->io));
 		end_requests(fc, &fpq->processing);
+		fuse_dev_unsteer(fud);
 		/* Are we the last open device? */
 		if (atomic_dec_and_test(&fc->dev_count)) {
 			WARN_ON(fc->iq.fasync != NULL);
 			fuse_abort_conn(fc);
 		}
+		fuse_ring_free(fud->ring);
 		fuse_dev_free(fud);
 	}
 	return 0;
@@ -2200,6 +2633,27 @@ static long fuse_dev_ioctl(struct file *file, unsigned int cmd,
 {
 	int err = -ENOTTY;
 
+	if (cmd == FUSE_DEV_IOC_RING_SETUP || cmd == FUSE_DEV_IOC_RING_ENTER) {
+		struct fuse_dev *fud = fuse_get_dev(file);
+
+		if (!fud)
+			return -EPERM;
+		if (cmd == FUSE_DEV_IOC_RING_SETUP)
+			return fuse_ring_setup(fud, (void __user *)arg);
+		return fuse_ring_enter(fud, file, (u32 __user *)arg);
+	}
+
+	if (cmd == FUSE_DEV_IOC_PASSTHROUGH_OPEN) {
+		struct fuse_dev *fud = fuse_get_dev(file);
+		u32 lower_fd;
+
+		if (!fud)
+			return -EPERM;
+		if (get_user(lower_fd, (__u32 __user *) arg))
+			return -EFAULT;
+		return fuse_passthrough_open(fud, lower_fd);
+	}
+
 	if (cmd == FUSE_DEV_IOC_CLONE) {
 		int oldfd;
 
@@ -2240,6 +2694,7 @@ const struct file_operations fuse_dev_operations = {
 	.write_iter	= fuse_dev_write,
 	.splice_write	= fuse_dev_splice_write,
 	.poll		= fuse_dev_poll,
+	.mmap		= fuse_dev_mmap,
 	.release	= fuse_dev_release,
 	.fasync		= fuse_dev_fasync,
 	.unlocked_ioctl = fuse_dev_ioctl,
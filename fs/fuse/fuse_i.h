@@ -26,6 +26,7 @@
 #include <linux/xattr.h>
 #include <linux/pid_namespace.h>
 #include <linux/refcount.h>
+#include <linux/idr.h>
 
 /** Max number of pages that can be used in a single read request */
 #define FUSE_MAX_PAGES_PER_REQ 32
@@ -37,7 +38,7 @@
 #define FUSE_NAME_MAX 1024
 
 /** Number of dentries for each connection in the control filesystem */
-#define FUSE_CTL_NUM_DENTRIES 5
+#define FUSE_CTL_NUM_DENTRIES 6
 
 /** Number of page pointers embedded in fuse_req */
 #define FUSE_REQ_INLINE_PAGES 1
@@ -122,6 +123,15 @@ enum {
 struct fuse_conn;
 
 /** FUSE specific file data */
+/** Backing file of a FOPEN_PASSTHROUGH open */
+struct fuse_passthrough {
+	/** The backing file, NULL if not passthrough */
+	struct file *filp;
+
+	/** Credentials of the daemon that registered the backing file */
+	const struct cred *cred;
+};
+
 struct fuse_file {
 	/** Fuse connection for this file */
 	struct fuse_conn *fc;
@@ -155,6 +165,9 @@ struct fuse_file {
 
 	/** Has flock been performed on this file? */
 	bool flock:1;
+
+	/** Backing file, see FOPEN_PASSTHROUGH */
+	struct fuse_passthrough passthrough;
 };
 
 /** One input argument of a request */
@@ -396,9 +409,12 @@ struct fuse_iqueue {
 	/** The next unique request id */
 	u64 reqctr;
 
-	/** The list of pending requests */
+	/** The list of pending requests not steered to a device */
 	struct list_head pending;
 
+	/** Devices that read requests, see fuse_dev.iq_entry */
+	struct list_head readers;
+
 	/** Pending interrupts */
 	struct list_head interrupts;
 
@@ -427,6 +443,39 @@ struct fuse_pqueue {
 	struct list_head io;
 };
 
+/**
+ * Request ring shared with the daemon, see FUSE_DEV_IOC_RING_SETUP
+ */
+struct fuse_ring {
+	/** Serializes queue updates by FUSE_DEV_IOC_RING_ENTER callers */
+	struct mutex lock;
+
+	/** vmalloc_user() area mapped by the daemon */
+	void *mem;
+	size_t size;
+
+	/** Layout of the area, the header and queues come first */
+	struct fuse_ring_header *hdr;
+	u32 *sq;
+	u32 *cq;
+	unsigned int slot_offset;
+	unsigned int entries;
+	unsigned int entry_size;
+
+	/** Kernel copies of the indices the kernel owns */
+	u32 sq_tail;
+	u32 cq_head;
+
+	/** Slots handed to the daemon and not completed yet */
+	unsigned long *busy;
+
+	/** Scratch vector mapping one slot, used under @lock */
+	struct bio_vec *bvec;
+
+	/** Current adaptive polling window before sleeping, in ns */
+	unsigned int spin_ns;
+};
+
 /**
  * Fuse device instance
  */
@@ -439,6 +488,25 @@ struct fuse_dev {
 
 	/** list entry on fc->devices */
 	struct list_head entry;
+
+	/** Optional shared request ring, set once */
+	struct fuse_ring *ring;
+
+	/*
+	 * The following are protected by fc->iq.waitq.lock
+	 */
+
+	/** list entry on fc->iq.readers */
+	struct list_head iq_entry;
+
+	/** Requests steered to this device by a submitter on its CPU */
+	struct list_head pending;
+
+	/** Readers of this device are waiting on this */
+	wait_queue_head_t waitq;
+
+	/** CPU the last reader of this device went to sleep on */
+	int cpu;
 };
 
 /**
@@ -624,6 +692,9 @@ struct fuse_conn {
 	/** Does the filesystem support posix acls? */
 	unsigned posix_acl:1;
 
+	/** May opens be served from a backing file? */
+	unsigned passthrough:1;
+
 	/** Check permissions based on the file mode or not? */
 	unsigned default_permissions:1;
 
@@ -633,9 +704,21 @@ struct fuse_conn {
 	/** The number of requests waiting for completion */
 	atomic_t num_waiting;
 
+	/** Request page data spliced to the daemon by page reference */
+	atomic64_t ref_bytes;
+
+	/** Request page data copied to the daemon */
+	atomic64_t copied_bytes;
+
 	/** Negotiated minor version */
 	unsigned minor;
 
+	/** Backing files registered by FUSE_DEV_IOC_PASSTHROUGH_OPEN */
+	struct idr passthrough_req;
+
+	/** Protects passthrough_req */
+	spinlock_t passthrough_req_lock;
+
 	/** Entry on the fuse_conn_list */
 	struct list_head entry;
 
@@ -983,4 +1066,14 @@ struct posix_acl;
 struct posix_acl *fuse_get_acl(struct inode *inode, int type);
 int fuse_set_acl(struct inode *inode, struct posix_acl *acl, int type);
 
+/* passthrough.c */
+int fuse_passthrough_open(struct fuse_dev *fud, u32 lower_fd);
+void fuse_passthrough_setup(struct fuse_conn *fc, struct fuse_file *ff,
+			    struct fuse_open_out *openarg);
+void fuse_passthrough_release(struct fuse_passthrough *passthrough);
+void fuse_passthrough_cleanup(struct fuse_conn *fc);
+ssize_t fuse_passthrough_read_iter(struct kiocb *iocb, struct iov_iter *to);
+ssize_t fuse_passthrough_write_iter(struct kiocb *iocb, struct iov_iter *from);
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma);
+
 #endif /* _FS_FUSE_I_H */
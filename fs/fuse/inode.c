@@ -583,6 +583,7 @@ static void fuse_iqueue_init(struct fuse_iqueue *fiq)
 	memset(fiq, 0, sizeof(struct fuse_iqueue));
 	init_waitqueue_head(&fiq->waitq);
 	INIT_LIST_HEAD(&fiq->pending);
+	INIT_LIST_HEAD(&fiq->readers);
 	INIT_LIST_HEAD(&fiq->interrupts);
 	fiq->forget_list_tail = &fiq->forget_list_head;
 	fiq->connected = 1;
@@ -610,6 +611,8 @@ void fuse_conn_init(struct fuse_conn *fc)
 	INIT_LIST_HEAD(&fc->bg_queue);
 	INIT_LIST_HEAD(&fc->entry);
 	INIT_LIST_HEAD(&fc->devices);
+	idr_init(&fc->passthrough_req);
+	spin_lock_init(&fc->passthrough_req_lock);
 	atomic_set(&fc->num_waiting, 0);
 	fc->max_background = FUSE_DEFAULT_MAX_BACKGROUND;
 	fc->congestion_threshold = FUSE_DEFAULT_CONGESTION_THRESHOLD;
@@ -629,6 +632,7 @@ void fuse_conn_put(struct fuse_conn *fc)
 	if (refcount_dec_and_test(&fc->count)) {
 		if (fc->destroy_req)
 			fuse_request_free(fc->destroy_req);
+		fuse_passthrough_cleanup(fc);
 		put_pid_ns(fc->pid_ns);
 		fc->release(fc);
 	}
@@ -918,6 +922,12 @@ static void process_init_reply(struct fuse_conn *fc, struct fuse_req *req)
 				fc->posix_acl = 1;
 				fc->sb->s_xattr = fuse_acl_xattr_handlers;
 			}
+			if (arg->flags & FUSE_PASSTHROUGH) {
+				fc->passthrough = 1;
+				/* Prevent further stacking */
+				fc->sb->s_stack_depth =
+					FILESYSTEM_MAX_STACK_DEPTH;
+			}
 		} else {
 			ra_pages = fc->max_read / PAGE_SIZE;
 			fc->no_lock = 1;
@@ -948,7 +958,8 @@ static void fuse_send_init(struct fuse_conn *fc, struct fuse_req *req)
 		FUSE_FLOCK_LOCKS | FUSE_HAS_IOCTL_DIR | FUSE_AUTO_INVAL_DATA |
 		FUSE_DO_READDIRPLUS | FUSE_READDIRPLUS_AUTO | FUSE_ASYNC_DIO |
 		FUSE_WRITEBACK_CACHE | FUSE_NO_OPEN_SUPPORT |
-		FUSE_PARALLEL_DIROPS | FUSE_HANDLE_KILLPRIV | FUSE_POSIX_ACL;
+		FUSE_PARALLEL_DIROPS | FUSE_HANDLE_KILLPRIV | FUSE_POSIX_ACL |
+		FUSE_PASSTHROUGH;
 	req->in.h.opcode = FUSE_INIT;
 	req->in.numargs = 1;
 	req->in.args[0].size = sizeof(*arg);
@@ -1018,9 +1029,15 @@ struct fuse_dev *fuse_dev_alloc(struct fuse_conn *fc)
 	if (fud) {
 		fud->fc = fuse_conn_get(fc);
 		fuse_pqueue_init(&fud->pq);
+		INIT_LIST_HEAD(&fud->pending);
+		init_waitqueue_head(&fud->waitq);
+		fud->cpu = -1;
 
 		spin_lock(&fc->lock);
 		list_add_tail(&fud->entry, &fc->devices);
+		spin_lock(&fc->iq.waitq.lock);
+		list_add_tail(&fud->iq_entry, &fc->iq.readers);
+		spin_unlock(&fc->iq.waitq.lock);
 		spin_unlock(&fc->lock);
 	}
 
@@ -1035,6 +1052,10 @@ void fuse_dev_free(struct fuse_dev *fud)
 	if (fc) {
 		spin_lock(&fc->lock);
 		list_del(&fud->entry);
+		spin_lock(&fc->iq.waitq.lock);
+		list_del_init(&fud->iq_entry);
+		WARN_ON(!list_empty(&fud->pending));
+		spin_unlock(&fc->iq.waitq.lock);
 		spin_unlock(&fc->lock);
 
 		fuse_conn_put(fc);
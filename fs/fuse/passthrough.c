@@ -0,0 +1,214 @@
+/*
+ * FUSE: Filesystem in Userspace
+ *
+ * Passthrough of read, write and mmap to a backing file registered by
+ * the daemon, so that bulk I/O on a file whose access was checked at
+ * open does not take a round trip through userspace.
+ *
+ * This program can be distributed under the terms of the GNU GPL.
+ * See the file COPYING.
+ */
+
+#include "fuse_i.h"
+
+#include <linux/cred.h>
+#include <linux/file.h>
+#include <linux/slab.h>
+#include <linux/uio.h>
+
+int fuse_passthrough_open(struct fuse_dev *fud, u32 lower_fd)
+{
+	struct fuse_conn *fc = fud->fc;
+	struct fuse_passthrough *passthrough;
+	struct file *filp;
+	int res;
+
+	if (!fc->passthrough)
+		return -EPERM;
+
+	filp = fget(lower_fd);
+	if (!filp)
+		return -EBADF;
+
+	res = -EINVAL;
+	if (!filp->f_op->read_iter || !filp->f_op->write_iter)
+		goto out_fput;
+
+	/* Don't let the backing file be a fuse file, or stack any deeper */
+	if (file_inode(filp)->i_sb->s_stack_depth >= FILESYSTEM_MAX_STACK_DEPTH)
+		goto out_fput;
+
+	res = -ENOMEM;
+	passthrough = kmalloc(sizeof(*passthrough), GFP_KERNEL);
+	if (!passthrough)
+		goto out_fput;
+
+	passthrough->filp = filp;
+	passthrough->cred = get_current_cred();
+
+	idr_preload(GFP_KERNEL);
+	spin_lock(&fc->passthrough_req_lock);
+	res = idr_alloc(&fc->passthrough_req, passthrough, 1, 0, GFP_ATOMIC);
+	spin_unlock(&fc->passthrough_req_lock);
+	idr_preload_end();
+
+	if (res > 0)
+		return res;
+
+	put_cred(passthrough->cred);
+	kfree(passthrough);
+out_fput:
+	fput(filp);
+	return res;
+}
+
+/*
+ * Attach the backing file named by an OPEN or CREATE reply to the new
+ * fuse file.  An unknown identifier falls back to normal I/O.
+ */
+void fuse_passthrough_setup(struct fuse_conn *fc, struct fuse_file *ff,
+			    struct fuse_open_out *openarg)
+{
+	struct fuse_passthrough *passthrough = NULL;
+
+	if (openarg->passthrough_fh && openarg->passthrough_fh <= INT_MAX) {
+		spin_lock(&fc->passthrough_req_lock);
+		passthrough = idr_remove(&fc->passthrough_req,
+					 openarg->passthrough_fh);
+		spin_unlock(&fc->passthrough_req_lock);
+	}
+
+	if (!passthrough) {
+		ff->open_flags &= ~FOPEN_PASSTHROUGH;
+		return;
+	}
+
+	ff->passthrough = *passthrough;
+	kfree(passthrough);
+
+	/* The page cache of the fuse inode is not used */
+	ff->open_flags &= ~FOPEN_DIRECT_IO;
+}
+
+void fuse_passthrough_release(struct fuse_passthrough *passthrough)
+{
+	if (passthrough->filp) {
+		fput(passthrough->filp);
+		put_cred(passthrough->cred);
+		passthrough->filp = NULL;
+		passthrough->cred = NULL;
+	}
+}
+
+static int fuse_passthrough_free_req(int id, void *p, void *data)
+{
+	fuse_passthrough_release(p);
+	kfree(p);
+	return 0;
+}
+
+/*
+ * Drop the backing files that were registered but never claimed by an
+ * open reply
+ */
+void fuse_passthrough_cleanup(struct fuse_conn *fc)
+{
+	idr_for_each(&fc->passthrough_req, fuse_passthrough_free_req, NULL);
+	idr_destroy(&fc->passthrough_req);
+}
+
+static rwf_t fuse_iocb_to_rwf(struct kiocb *iocb)
+{
+	rwf_t flags = 0;
+
+	if (iocb->ki_flags & IOCB_HIPRI)
+		flags |= RWF_HIPRI;
+	if (iocb->ki_flags & IOCB_DSYNC)
+		flags |= RWF_DSYNC;
+	if (iocb->ki_flags & IOCB_SYNC)
+		flags |= RWF_SYNC;
+
+	return flags;
+}
+
+/*
+ * Asynchronous kiocbs are completed synchronously: the backing file is
+ * accessed with vfs_iter_read/write(), which take a file position
+ * rather than a kiocb.
+ */
+ssize_t fuse_passthrough_read_iter(struct kiocb *iocb, struct iov_iter *to)
+{
+	struct file *file = iocb->ki_filp;
+	struct fuse_file *ff = file->private_data;
+	const struct cred *old_cred;
+	ssize_t ret;
+
+	if (!iov_iter_count(to))
+		return 0;
+
+	old_cred = override_creds(ff->passthrough.cred);
+	ret = vfs_iter_read(ff->passthrough.filp, to, &iocb->ki_pos,
+			    fuse_iocb_to_rwf(iocb));
+	revert_creds(old_cred);
+
+	fuse_invalidate_atime(file_inode(file));
+
+	return ret;
+}
+
+ssize_t fuse_passthrough_write_iter(struct kiocb *iocb, struct iov_iter *from)
+{
+	struct file *file = iocb->ki_filp;
+	struct inode *inode = file_inode(file);
+	struct fuse_file *ff = file->private_data;
+	struct file *lower = ff->passthrough.filp;
+	const struct cred *old_cred;
+	ssize_t ret;
+
+	if (!iov_iter_count(from))
+		return 0;
+
+	inode_lock(inode);
+	old_cred = override_creds(ff->passthrough.cred);
+	file_start_write(lower);
+	ret = vfs_iter_write(lower, from, &iocb->ki_pos,
+			     fuse_iocb_to_rwf(iocb));
+	file_end_write(lower);
+	revert_creds(old_cred);
+
+	if (ret > 0)
+		fuse_write_update_size(inode, iocb->ki_pos);
+	fuse_invalidate_attr(inode);
+	inode_unlock(inode);
+
+	return ret;
+}
+
+/*
+ * Map the backing file directly, so page faults never reach the fuse
+ * inode and its page cache stays unused.
+ */
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct fuse_file *ff = file->private_data;
+	struct file *lower = ff->passthrough.filp;
+	const struct cred *old_cred;
+	int ret;
+
+	if (!lower->f_op->mmap)
+		return -ENODEV;
+
+	vma->vm_file = get_file(lower);
+	old_cred = override_creds(ff->passthrough.cred);
+	ret = call_mmap(lower, vma);
+	revert_creds(old_cred);
+
+	if (ret) {
+		vma->vm_file = file;
+		fput(lower);
+	} else {
+		fput(file);
+	}
+
+	return ret;
+}
@@ -38,7 +38,10 @@ int ovl_setattr(struct dentry *dentry, struct iattr *attr)
 	if (err)
 		goto out;
 
-	err = ovl_copy_up(dentry);
+	if (attr->ia_valid & ATTR_SIZE)
+		err = ovl_copy_up_with_data(dentry);
+	else
+		err = ovl_copy_up(dentry);
 	if (!err) {
 		upperdentry = ovl_dentry_upper(dentry);
 
@@ -123,6 +126,18 @@ int ovl_getattr(const struct path *path, struct kstat *stat,
 		stat->ino = dentry->d_inode->i_ino;
 	}
 
+	/* The blocks of a metacopy file are still those of the lower */
+	if (!is_dir && ovl_test_flag(OVL_METACOPY, d_inode(dentry))) {
+		struct kstat lowerstat;
+
+		ovl_path_lower(dentry, &realpath);
+		err = vfs_getattr(&realpath, &lowerstat, STATX_BLOCKS, flags);
+		if (err)
+			goto out;
+
+		stat->blocks = lowerstat.blocks;
+	}
+
 	/*
 	 * It's probably not worth it to count subdirs to get the
 	 * correct link count.  nlink=1 seems to pacify 'find' and
@@ -319,16 +334,17 @@ struct posix_acl *ovl_get_acl(struct inode *inode, int type)
 
 static bool ovl_open_need_copy_up(struct dentry *dentry, int flags)
 {
-	if (ovl_dentry_upper(dentry) &&
-	    ovl_dentry_has_upper_alias(dentry))
-		return false;
-
 	if (special_file(d_inode(dentry)->i_mode))
 		return false;
 
 	if (!(OPEN_FMODE(flags) & FMODE_WRITE) && !(flags & O_TRUNC))
 		return false;
 
+	if (ovl_dentry_upper(dentry) &&
+	    ovl_dentry_has_upper_alias(dentry) &&
+	    !ovl_need_data_copy_up(dentry, flags))
+		return false;
+
 	return true;
 }
 
@@ -587,6 +587,7 @@ struct dentry *ovl_lookup(struct inode *dir, struct dentry *dentry,
 	unsigned int ctr = 0;
 	struct inode *inode = NULL;
 	bool upperopaque = false;
+	bool metacopy = false;
 	char *upperredirect = NULL;
 	struct dentry *this;
 	unsigned int i;
@@ -694,6 +695,18 @@ struct dentry *ovl_lookup(struct inode *dir, struct dentry *dentry,
 		}
 	}
 
+	/* A metacopy upper is useless without the lower data */
+	if ((upperdentry || index) &&
+	    ovl_check_metacopy_xattr(upperdentry ?: index)) {
+		err = -EIO;
+		if (!ctr) {
+			pr_warn_ratelimited("overlayfs: metacopy without lower data (%pd2)\n",
+					    upperdentry ?: index);
+			goto out_put;
+		}
+		metacopy = true;
+	}
+
 	oe = ovl_alloc_entry(ctr);
 	err = -ENOMEM;
 	if (!oe)
@@ -717,6 +730,8 @@ struct dentry *ovl_lookup(struct inode *dir, struct dentry *dentry,
 		OVL_I(inode)->redirect = upperredirect;
 		if (index)
 			ovl_set_flag(OVL_INDEX, inode);
+		if (metacopy)
+			ovl_set_flag(OVL_METACOPY, inode);
 	}
 
 	revert_creds(old_cred);
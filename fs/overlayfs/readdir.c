@@ -16,8 +16,15 @@
 #include <linux/security.h>
 #include <linux/cred.h>
 #include <linux/ratelimit.h>
+#include <linux/module.h>
+#include <linux/shrinker.h>
 #include "overlayfs.h"
 
+static unsigned int ovl_dir_cache_max_kb = 2048;
+module_param_named(dir_cache_max_kb, ovl_dir_cache_max_kb, uint, 0644);
+MODULE_PARM_DESC(ovl_dir_cache_max_kb,
+		 "Maximum size of the cached merged dirs that are not open");
+
 struct ovl_cache_entry {
 	unsigned int len;
 	unsigned int type;
@@ -35,8 +42,23 @@ struct ovl_dir_cache {
 	u64 version;
 	struct list_head entries;
 	struct rb_root root;
+	/* Merged dir caches not open, on ovl_dir_cache_lru */
+	struct inode *inode;
+	struct list_head lru;
+	size_t size;
 };
 
+/*
+ * The cache of a merged dir is kept attached to the inode after the last
+ * close, for as long as the dir version doesn't change.  These unused
+ * caches are capped in size, and reclaimed by a shrinker; the lock
+ * protects the pointer of their inode as well.
+ */
+static LIST_HEAD(ovl_dir_cache_lru);
+static DEFINE_SPINLOCK(ovl_dir_cache_lock);
+static unsigned long ovl_dir_cache_lru_nr;
+static size_t ovl_dir_cache_lru_size;
+
 struct ovl_readdir_data {
 	struct dir_context ctx;
 	struct dentry *dentry;
@@ -222,29 +244,125 @@ void ovl_cache_free(struct list_head *list)
 	INIT_LIST_HEAD(list);
 }
 
+static void ovl_dir_cache_lru_del(struct ovl_dir_cache *cache)
+{
+	list_del_init(&cache->lru);
+	ovl_dir_cache_lru_nr--;
+	ovl_dir_cache_lru_size -= cache->size;
+}
+
+/*
+ * Get the cache of @inode, taking it off the unused list so that the
+ * shrinker leaves it alone.
+ */
+static struct ovl_dir_cache *ovl_dir_cache_claim(struct inode *inode)
+{
+	struct ovl_dir_cache *cache;
+
+	spin_lock(&ovl_dir_cache_lock);
+	cache = ovl_dir_cache(inode);
+	if (cache && !list_empty(&cache->lru))
+		ovl_dir_cache_lru_del(cache);
+	spin_unlock(&ovl_dir_cache_lock);
+
+	return cache;
+}
+
+static void ovl_dir_cache_destroy(struct ovl_dir_cache *cache)
+{
+	ovl_cache_free(&cache->entries);
+	kfree(cache);
+}
+
 void ovl_dir_cache_free(struct inode *inode)
 {
-	struct ovl_dir_cache *cache = ovl_dir_cache(inode);
+	struct ovl_dir_cache *cache = ovl_dir_cache_claim(inode);
 
-	if (cache) {
-		ovl_cache_free(&cache->entries);
-		kfree(cache);
+	if (cache)
+		ovl_dir_cache_destroy(cache);
+}
+
+/* Free unused caches from the cold end, down to @size or @nr freed */
+static unsigned long ovl_dir_cache_prune(size_t size, unsigned long nr)
+{
+	struct ovl_dir_cache *cache, *next;
+	unsigned long freed = 0;
+	LIST_HEAD(dispose);
+
+	spin_lock(&ovl_dir_cache_lock);
+	list_for_each_entry_safe(cache, next, &ovl_dir_cache_lru, lru) {
+		if (ovl_dir_cache_lru_size <= size || freed >= nr)
+			break;
+
+		ovl_dir_cache_lru_del(cache);
+		ovl_set_dir_cache(cache->inode, NULL);
+		list_add(&cache->lru, &dispose);
+		freed++;
 	}
+	spin_unlock(&ovl_dir_cache_lock);
+
+	list_for_each_entry_safe(cache, next, &dispose, lru)
+		ovl_dir_cache_destroy(cache);
+
+	return freed;
 }
 
 static void ovl_cache_put(struct ovl_dir_file *od, struct dentry *dentry)
 {
 	struct ovl_dir_cache *cache = od->cache;
+	struct inode *inode = d_inode(dentry);
+	size_t max_size = (size_t)ovl_dir_cache_max_kb << 10;
 
 	WARN_ON(cache->refcount <= 0);
 	cache->refcount--;
-	if (!cache->refcount) {
-		if (ovl_dir_cache(d_inode(dentry)) == cache)
-			ovl_set_dir_cache(d_inode(dentry), NULL);
+	if (cache->refcount)
+		return;
 
-		ovl_cache_free(&cache->entries);
-		kfree(cache);
+	if (ovl_dir_cache(inode) == cache) {
+		/* Keep it for the next opendir while it's up to date */
+		if (ovl_dentry_version_get(dentry) == cache->version &&
+		    cache->size <= max_size) {
+			spin_lock(&ovl_dir_cache_lock);
+			list_add_tail(&cache->lru, &ovl_dir_cache_lru);
+			ovl_dir_cache_lru_nr++;
+			ovl_dir_cache_lru_size += cache->size;
+			spin_unlock(&ovl_dir_cache_lock);
+
+			ovl_dir_cache_prune(max_size, ULONG_MAX);
+			return;
+		}
+		ovl_set_dir_cache(inode, NULL);
 	}
+
+	ovl_dir_cache_destroy(cache);
+}
+
+static unsigned long ovl_dir_cache_count(struct shrinker *shrink,
+					 struct shrink_control *sc)
+{
+	return READ_ONCE(ovl_dir_cache_lru_nr);
+}
+
+static unsigned long ovl_dir_cache_scan(struct shrinker *shrink,
+					struct shrink_control *sc)
+{
+	return ovl_dir_cache_prune(0, sc->nr_to_scan);
+}
+
+static struct shrinker ovl_dir_cache_shrinker = {
+	.count_objects	= ovl_dir_cache_count,
+	.scan_objects	= ovl_dir_cache_scan,
+	.seeks		= DEFAULT_SEEKS,
+};
+
+int __init ovl_readdir_init(void)
+{
+	return register_shrinker(&ovl_dir_cache_shrinker);
+}
+
+void ovl_readdir_exit(void)
+{
+	unregister_shrinker(&ovl_dir_cache_shrinker);
 }
 
 static int ovl_fill_merge(struct dir_context *ctx, const char *name,
@@ -387,14 +505,17 @@ static struct ovl_dir_cache *ovl_cache_get(struct dentry *dentry)
 {
 	int res;
 	struct ovl_dir_cache *cache;
+	struct ovl_cache_entry *p;
 
-	cache = ovl_dir_cache(d_inode(dentry));
+	cache = ovl_dir_cache_claim(d_inode(dentry));
 	if (cache && ovl_dentry_version_get(dentry) == cache->version) {
-		WARN_ON(!cache->refcount);
 		cache->refcount++;
 		return cache;
 	}
 	ovl_set_dir_cache(d_inode(dentry), NULL);
+	/* Stale and not open any more */
+	if (cache && !cache->refcount)
+		ovl_dir_cache_destroy(cache);
 
 	cache = kzalloc(sizeof(struct ovl_dir_cache), GFP_KERNEL);
 	if (!cache)
@@ -403,6 +524,8 @@ static struct ovl_dir_cache *ovl_cache_get(struct dentry *dentry)
 	cache->refcount = 1;
 	INIT_LIST_HEAD(&cache->entries);
 	cache->root = RB_ROOT;
+	cache->inode = d_inode(dentry);
+	INIT_LIST_HEAD(&cache->lru);
 
 	res = ovl_dir_read_merged(dentry, &cache->entries, &cache->root);
 	if (res) {
@@ -411,6 +534,10 @@ static struct ovl_dir_cache *ovl_cache_get(struct dentry *dentry)
 		return ERR_PTR(res);
 	}
 
+	cache->size = sizeof(*cache);
+	list_for_each_entry(p, &cache->entries, l_node)
+		cache->size += offsetof(struct ovl_cache_entry, name[p->len + 1]);
+
 	cache->version = ovl_dentry_version_get(dentry);
 	ovl_set_dir_cache(d_inode(dentry), cache);
 
@@ -556,7 +683,7 @@ static struct ovl_dir_cache *ovl_cache_get_impure(struct path *path)
 	struct dentry *dentry = path->dentry;
 	struct ovl_dir_cache *cache;
 
-	cache = ovl_dir_cache(d_inode(dentry));
+	cache = ovl_dir_cache_claim(d_inode(dentry));
 	if (cache && ovl_dentry_version_get(dentry) == cache->version)
 		return cache;
 
@@ -568,6 +695,7 @@ static struct ovl_dir_cache *ovl_cache_get_impure(struct path *path)
 	if (!cache)
 		return ERR_PTR(-ENOMEM);
 
+	INIT_LIST_HEAD(&cache->lru);
 	res = ovl_dir_read_impure(path, &cache->entries, &cache->root);
 	if (res) {
 		ovl_cache_free(&cache->entries);
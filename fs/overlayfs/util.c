@@ -310,13 +310,14 @@ struct file *ovl_path_open(struct path *path, int flags)
 	return dentry_open(path, flags | O_NOATIME, current_cred());
 }
 
-int ovl_copy_up_start(struct dentry *dentry)
+int ovl_copy_up_start(struct dentry *dentry, int flags)
 {
 	struct ovl_inode *oi = OVL_I(d_inode(dentry));
 	int err;
 
 	err = mutex_lock_interruptible(&oi->lock);
-	if (!err && ovl_dentry_has_upper_alias(dentry)) {
+	if (!err && ovl_dentry_has_upper_alias(dentry) &&
+	    !ovl_need_data_copy_up(dentry, flags)) {
 		err = 1; /* Already copied up */
 		mutex_unlock(&oi->lock);
 	}
@@ -329,6 +330,18 @@ void ovl_copy_up_end(struct dentry *dentry)
 	mutex_unlock(&OVL_I(d_inode(dentry))->lock);
 }
 
+/*
+ * A metacopy upper file gets its data from the lower origin until it is
+ * opened for write or truncated.
+ */
+bool ovl_need_data_copy_up(struct dentry *dentry, int flags)
+{
+	if (!ovl_test_flag(OVL_METACOPY, d_inode(dentry)))
+		return false;
+
+	return (OPEN_FMODE(flags) & FMODE_WRITE) || (flags & O_TRUNC);
+}
+
 bool ovl_check_dir_xattr(struct dentry *dentry, const char *name)
 {
 	int res;
@@ -344,6 +357,17 @@ bool ovl_check_dir_xattr(struct dentry *dentry, const char *name)
 	return false;
 }
 
+bool ovl_check_metacopy_xattr(struct dentry *dentry)
+{
+	int res;
+
+	if (!d_is_reg(dentry))
+		return false;
+
+	res = vfs_getxattr(dentry, OVL_XATTR_METACOPY, NULL, 0);
+	return res >= 0;
+}
+
 int ovl_check_setxattr(struct dentry *dentry, struct dentry *upperdentry,
 		       const char *name, const void *value, size_t size,
 		       int xerr)
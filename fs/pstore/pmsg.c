@@ -36,6 +36,9 @@ static ssize_t write_pmsg(struct file *file, const char __user *buf,
 	if (!access_ok(VERIFY_READ, buf, count))
 		return -EFAULT;
 
+	if (psinfo->flags & PSTORE_FLAGS_PMSG_NO_LOCK)
+		return psinfo->write_user(&record, buf) ?: count;
+
 	mutex_lock(&pmsg_lock);
 	ret = psinfo->write_user(&record, buf);
 	mutex_unlock(&pmsg_lock);
@@ -87,7 +87,7 @@ struct ramoops_context {
 	struct persistent_ram_zone **dprzs;	/* Oops dump zones */
 	struct persistent_ram_zone *cprz;	/* Console zone */
 	struct persistent_ram_zone **fprzs;	/* Ftrace zones */
-	struct persistent_ram_zone *mprz;	/* PMSG zone */
+	struct persistent_ram_zone **mprzs;	/* PMSG zones */
 	phys_addr_t phys_addr;
 	unsigned long size;
 	unsigned int memtype;
@@ -105,6 +105,7 @@ struct ramoops_context {
 	unsigned int console_read_cnt;
 	unsigned int max_ftrace_cnt;
 	unsigned int ftrace_read_cnt;
+	unsigned int max_pmsg_cnt;
 	unsigned int pmsg_read_cnt;
 	struct pstore_info pstore;
 };
@@ -275,10 +276,11 @@ static ssize_t ramoops_pstore_read(struct pstore_record *record)
 					   1, &record->id, &record->type,
 					   PSTORE_TYPE_CONSOLE, 0);
 
-	if (!prz_ok(prz))
-		prz = ramoops_get_next_prz(&cxt->mprz, &cxt->pmsg_read_cnt,
-					   1, &record->id, &record->type,
-					   PSTORE_TYPE_PMSG, 0);
+	/* Per-CPU pmsg zones have no time stamps to merge them by */
+	while (cxt->pmsg_read_cnt < cxt->max_pmsg_cnt && !prz_ok(prz))
+		prz = ramoops_get_next_prz(cxt->mprzs, &cxt->pmsg_read_cnt,
+					   cxt->max_pmsg_cnt, &record->id,
+					   &record->type, PSTORE_TYPE_PMSG, 0);
 
 	/* ftrace is last since it may want to dynamically allocate memory. */
 	if (!prz_ok(prz)) {
@@ -372,6 +374,17 @@ static size_t ramoops_write_kmsg_hdr(struct persistent_ram_zone *prz,
 	return len;
 }
 
+/* Cover the newest ftrace and pmsg data with the ECC before going down */
+static void notrace ramoops_flush_ecc(struct ramoops_context *cxt)
+{
+	int i;
+
+	for (i = 0; cxt->fprzs && i < cxt->max_ftrace_cnt; i++)
+		persistent_ram_flush_ecc(cxt->fprzs[i]);
+	for (i = 0; cxt->mprzs && i < cxt->max_pmsg_cnt; i++)
+		persistent_ram_flush_ecc(cxt->mprzs[i]);
+}
+
 static int notrace ramoops_pstore_write(struct pstore_record *record)
 {
 	struct ramoops_context *cxt = record->psi->data;
@@ -415,6 +428,8 @@ static int notrace ramoops_pstore_write(struct pstore_record *record)
 	    record->reason != KMSG_DUMP_PANIC)
 		return -EINVAL;
 
+	ramoops_flush_ecc(cxt);
+
 	/* Skip Oopes when configured to do so. */
 	if (record->reason == KMSG_DUMP_OOPS && !cxt->dump_oops)
 		return -EINVAL;
@@ -450,10 +465,19 @@ static int notrace ramoops_pstore_write_user(struct pstore_record *record,
 {
 	if (record->type == PSTORE_TYPE_PMSG) {
 		struct ramoops_context *cxt = record->psi->data;
+		int zonenum = 0;
 
-		if (!cxt->mprz)
+		if (!cxt->mprzs)
 			return -ENOMEM;
-		return persistent_ram_write_user(cxt->mprz, buf, record->size);
+		/*
+		 * The writer may sleep and migrate while copying, which is
+		 * fine: the zone space is reserved atomically.
+		 */
+		if (cxt->flags & RAMOOPS_FLAG_PMSG_PER_CPU)
+			zonenum = raw_smp_processor_id();
+
+		return persistent_ram_write_user(cxt->mprzs[zonenum], buf,
+						 record->size);
 	}
 
 	return -EINVAL;
@@ -479,7 +503,9 @@ static int ramoops_pstore_erase(struct pstore_record *record)
 		prz = cxt->fprzs[record->id];
 		break;
 	case PSTORE_TYPE_PMSG:
-		prz = cxt->mprz;
+		if (record->id >= cxt->max_pmsg_cnt)
+			return -EINVAL;
+		prz = cxt->mprzs[record->id];
 		break;
 	default:
 		return -EINVAL;
@@ -523,6 +549,14 @@ static void ramoops_free_przs(struct ramoops_context *cxt)
 		kfree(cxt->fprzs);
 		cxt->max_ftrace_cnt = 0;
 	}
+
+	/* Free pmsg PRZs */
+	if (cxt->mprzs) {
+		for (i = 0; i < cxt->max_pmsg_cnt; i++)
+			persistent_ram_free(cxt->mprzs[i]);
+		kfree(cxt->mprzs);
+		cxt->max_pmsg_cnt = 0;
+	}
 }
 
 static int ramoops_init_przs(const char *name,
@@ -721,6 +755,7 @@ static int ramoops_probe(struct platform_device *pdev)
 	size_t dump_mem_sz;
 	phys_addr_t paddr;
 	int err = -EINVAL;
+	int i;
 
 	if (dev_of_node(dev) && !pdata) {
 		pdata = devm_kzalloc(&pdev->dev, sizeof(*pdata), GFP_KERNEL);
@@ -792,6 +827,10 @@ static int ramoops_probe(struct platform_device *pdev)
 	if (err)
 		goto fail_init_cprz;
 
+	/*
+	 * Per-CPU zones are meant to stay on in the field: they are written
+	 * without a lock and have their ECC computed a block at a time.
+	 */
 	cxt->max_ftrace_cnt = (cxt->flags & RAMOOPS_FLAG_FTRACE_PER_CPU)
 				? nr_cpu_ids
 				: 1;
@@ -799,14 +838,25 @@ static int ramoops_probe(struct platform_device *pdev)
 				cxt->ftrace_size, -1,
 				&cxt->max_ftrace_cnt, LINUX_VERSION_CODE,
 				(cxt->flags & RAMOOPS_FLAG_FTRACE_PER_CPU)
-					? PRZ_FLAG_NO_LOCK : 0);
+					? PRZ_FLAG_NO_LOCK | PRZ_FLAG_DEFER_ECC
+					: 0);
 	if (err)
 		goto fail_init_fprz;
 
-	err = ramoops_init_prz("pmsg", dev, cxt, &cxt->mprz, &paddr,
-				cxt->pmsg_size, 0);
+	cxt->max_pmsg_cnt = (cxt->flags & RAMOOPS_FLAG_PMSG_PER_CPU)
+				? nr_cpu_ids
+				: 1;
+	err = ramoops_init_przs("pmsg", dev, cxt, &cxt->mprzs, &paddr,
+				cxt->pmsg_size, -1,
+				&cxt->max_pmsg_cnt, 0,
+				(cxt->flags & RAMOOPS_FLAG_PMSG_PER_CPU)
+					? PRZ_FLAG_NO_LOCK | PRZ_FLAG_DEFER_ECC
+					: 0);
 	if (err)
 		goto fail_init_mprz;
+	/* Unlike ftrace, pmsg starts over on every boot */
+	for (i = 0; i < cxt->max_pmsg_cnt; i++)
+		persistent_ram_zap(cxt->mprzs[i]);
 
 	cxt->pstore.data = cxt;
 	/*
@@ -833,6 +883,8 @@ static int ramoops_probe(struct platform_device *pdev)
 		cxt->pstore.flags |= PSTORE_FLAGS_FTRACE;
 	if (cxt->pmsg_size)
 		cxt->pstore.flags |= PSTORE_FLAGS_PMSG;
+	if (cxt->flags & RAMOOPS_FLAG_PMSG_PER_CPU)
+		cxt->pstore.flags |= PSTORE_FLAGS_PMSG_NO_LOCK;
 
 	err = pstore_register(&cxt->pstore);
 	if (err) {
@@ -862,7 +914,6 @@ static int ramoops_probe(struct platform_device *pdev)
 	kfree(cxt->pstore.buf);
 fail_clear:
 	cxt->pstore.bufsize = 0;
-	persistent_ram_free(cxt->mprz);
 fail_init_mprz:
 fail_init_fprz:
 	persistent_ram_free(cxt->cprz);
@@ -881,7 +932,6 @@ static int ramoops_remove(struct platform_device *pdev)
 	kfree(cxt->pstore.buf);
 	cxt->pstore.bufsize = 0;
 
-	persistent_ram_free(cxt->mprz);
 	persistent_ram_free(cxt->cprz);
 	ramoops_free_przs(cxt);
 
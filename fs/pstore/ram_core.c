@@ -48,6 +48,44 @@ static inline size_t buffer_start(struct persistent_ram_zone *prz)
 	return atomic_read(&prz->buffer->start);
 }
 
+/*
+ * Without the lock, the space is reserved with a cmpxchg loop: the zones
+ * are per-CPU, so the only other writers are interrupts nesting on the
+ * same CPU, which get the space after ours.
+ */
+static size_t buffer_start_add_lockless(struct persistent_ram_zone *prz,
+					size_t a)
+{
+	int old;
+	int new;
+
+	do {
+		old = atomic_read(&prz->buffer->start);
+		new = old + a;
+		while (unlikely(new >= prz->buffer_size))
+			new -= prz->buffer_size;
+	} while (atomic_cmpxchg(&prz->buffer->start, old, new) != old);
+
+	return old;
+}
+
+static void buffer_size_add_lockless(struct persistent_ram_zone *prz,
+				     size_t a)
+{
+	size_t old;
+	size_t new;
+
+	do {
+		old = atomic_read(&prz->buffer->size);
+		if (old == prz->buffer_size)
+			return;
+
+		new = old + a;
+		if (new > prz->buffer_size)
+			new = prz->buffer_size;
+	} while (atomic_cmpxchg(&prz->buffer->size, old, new) != old);
+}
+
 /* increase and wrap the start pointer, returning the old value */
 static size_t buffer_start_add(struct persistent_ram_zone *prz, size_t a)
 {
@@ -55,8 +93,10 @@ static size_t buffer_start_add(struct persistent_ram_zone *prz, size_t a)
 	int new;
 	unsigned long flags = 0;
 
-	if (!(prz->flags & PRZ_FLAG_NO_LOCK))
-		raw_spin_lock_irqsave(&prz->buffer_lock, flags);
+	if (prz->flags & PRZ_FLAG_NO_LOCK)
+		return buffer_start_add_lockless(prz, a);
+
+	raw_spin_lock_irqsave(&prz->buffer_lock, flags);
 
 	old = atomic_read(&prz->buffer->start);
 	new = old + a;
@@ -64,8 +104,7 @@ static size_t buffer_start_add(struct persistent_ram_zone *prz, size_t a)
 		new -= prz->buffer_size;
 	atomic_set(&prz->buffer->start, new);
 
-	if (!(prz->flags & PRZ_FLAG_NO_LOCK))
-		raw_spin_unlock_irqrestore(&prz->buffer_lock, flags);
+	raw_spin_unlock_irqrestore(&prz->buffer_lock, flags);
 
 	return old;
 }
@@ -77,8 +116,12 @@ static void buffer_size_add(struct persistent_ram_zone *prz, size_t a)
 	size_t new;
 	unsigned long flags = 0;
 
-	if (!(prz->flags & PRZ_FLAG_NO_LOCK))
-		raw_spin_lock_irqsave(&prz->buffer_lock, flags);
+	if (prz->flags & PRZ_FLAG_NO_LOCK) {
+		buffer_size_add_lockless(prz, a);
+		return;
+	}
+
+	raw_spin_lock_irqsave(&prz->buffer_lock, flags);
 
 	old = atomic_read(&prz->buffer->size);
 	if (old == prz->buffer_size)
@@ -90,8 +133,7 @@ static void buffer_size_add(struct persistent_ram_zone *prz, size_t a)
 	atomic_set(&prz->buffer->size, new);
 
 exit:
-	if (!(prz->flags & PRZ_FLAG_NO_LOCK))
-		raw_spin_unlock_irqrestore(&prz->buffer_lock, flags);
+	raw_spin_unlock_irqrestore(&prz->buffer_lock, flags);
 }
 
 static void notrace persistent_ram_encode_rs8(struct persistent_ram_zone *prz,
@@ -133,6 +175,21 @@ static void notrace persistent_ram_update_ecc(struct persistent_ram_zone *prz,
 	if (!ecc_size)
 		return;
 
+	/*
+	 * Deferred ECC only encodes the blocks this write filled up, the
+	 * block still being written is encoded by persistent_ram_flush_ecc()
+	 * or once a later write completes it.
+	 */
+	if (prz->flags & PRZ_FLAG_DEFER_ECC) {
+		unsigned int end = start + count;
+
+		if (end < prz->buffer_size)
+			end &= ~(ecc_block_size - 1);
+		if (end <= (start & ~(ecc_block_size - 1)))
+			return;
+		count = end - start;
+	}
+
 	block = buffer->data + (start & ~(ecc_block_size - 1));
 	par = prz->par_buffer + (start / ecc_block_size) * ecc_size;
 
@@ -156,6 +213,44 @@ static void persistent_ram_update_header_ecc(struct persistent_ram_zone *prz)
 				  prz->par_header);
 }
 
+/* With deferred ECC, the header is encoded along with each full block */
+static bool persistent_ram_header_ecc_due(struct persistent_ram_zone *prz,
+	size_t start, unsigned int count)
+{
+	int ecc_block_size = prz->ecc_info.block_size;
+
+	if (!prz->ecc_info.ecc_size || !(prz->flags & PRZ_FLAG_DEFER_ECC))
+		return true;
+
+	return start + count >= prz->buffer_size ||
+	       start / ecc_block_size != (start + count) / ecc_block_size;
+}
+
+/**
+ * persistent_ram_flush_ecc() - Encode the block a zone is being written at
+ * @prz: The zone, created with %PRZ_FLAG_DEFER_ECC
+ *
+ * Called before the system goes down, so that the newest data of the zone
+ * is covered by the ECC as well.
+ */
+void notrace persistent_ram_flush_ecc(struct persistent_ram_zone *prz)
+{
+	struct persistent_ram_buffer *buffer = prz->buffer;
+	int ecc_block_size = prz->ecc_info.block_size;
+	size_t start;
+	int size;
+
+	if (!prz->ecc_info.ecc_size || !(prz->flags & PRZ_FLAG_DEFER_ECC))
+		return;
+
+	start = buffer_start(prz) & ~(ecc_block_size - 1);
+	size = min_t(size_t, ecc_block_size, prz->buffer_size - start);
+	persistent_ram_encode_rs8(prz, buffer->data + start, size,
+				  prz->par_buffer +
+				  (start / ecc_block_size) * prz->ecc_info.ecc_size);
+	persistent_ram_update_header_ecc(prz);
+}
+
 static void persistent_ram_ecc_old(struct persistent_ram_zone *prz)
 {
 	struct persistent_ram_buffer *buffer = prz->buffer;
@@ -309,6 +404,7 @@ int notrace persistent_ram_write(struct persistent_ram_zone *prz,
 	int rem;
 	int c = count;
 	size_t start;
+	bool header_ecc;
 
 	if (unlikely(c > prz->buffer_size)) {
 		s += c - prz->buffer_size;
@@ -318,6 +414,7 @@ int notrace persistent_ram_write(struct persistent_ram_zone *prz,
 	buffer_size_add(prz, c);
 
 	start = buffer_start_add(prz, c);
+	header_ecc = persistent_ram_header_ecc_due(prz, start, c);
 
 	rem = prz->buffer_size - start;
 	if (unlikely(rem < c)) {
@@ -328,7 +425,8 @@ int notrace persistent_ram_write(struct persistent_ram_zone *prz,
 	}
 	persistent_ram_update(prz, s, start, c);
 
-	persistent_ram_update_header_ecc(prz);
+	if (header_ecc)
+		persistent_ram_update_header_ecc(prz);
 
 	return count;
 }
@@ -338,6 +436,7 @@ int notrace persistent_ram_write_user(struct persistent_ram_zone *prz,
 {
 	int rem, ret = 0, c = count;
 	size_t start;
+	bool header_ecc;
 
 	if (unlikely(!access_ok(VERIFY_READ, s, count)))
 		return -EFAULT;
@@ -349,6 +448,7 @@ int notrace persistent_ram_write_user(struct persistent_ram_zone *prz,
 	buffer_size_add(prz, c);
 
 	start = buffer_start_add(prz, c);
+	header_ecc = persistent_ram_header_ecc_due(prz, start, c);
 
 	rem = prz->buffer_size - start;
 	if (unlikely(rem < c)) {
@@ -360,7 +460,8 @@ int notrace persistent_ram_write_user(struct persistent_ram_zone *prz,
 	if (likely(!ret))
 		ret = persistent_ram_update_user(prz, s, start, c);
 
-	persistent_ram_update_header_ecc(prz);
+	if (header_ecc)
+		persistent_ram_update_header_ecc(prz);
 
 	return unlikely(ret) ? ret : count;
 }
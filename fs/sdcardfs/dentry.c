@@ -21,6 +21,81 @@
 #include "sdcardfs.h"
 #include "linux/ctype.h"
 
+static DEFINE_PER_CPU(unsigned long, revalidate_rcu_walk);
+static DEFINE_PER_CPU(unsigned long, revalidate_ref_walk);
+
+void sdcardfs_revalidate_stats(unsigned long *rcu_walk, unsigned long *ref_walk)
+{
+	int cpu;
+
+	*rcu_walk = 0;
+	*ref_walk = 0;
+	for_each_possible_cpu(cpu) {
+		*rcu_walk += per_cpu(revalidate_rcu_walk, cpu);
+		*ref_walk += per_cpu(revalidate_ref_walk, cpu);
+	}
+}
+
+/*
+ * The common case of sdcardfs_d_revalidate, done without taking locks or
+ * references. Nothing here can invalidate the dentry: whenever something
+ * looks off, return -ECHILD and let ref-walk give the definite answer.
+ * Dentry private data and inode data are freed after a grace period, and
+ * dentry names stay NUL terminated, so racing with a rename or a release
+ * at worst yields a spurious fallback.
+ */
+static int sdcardfs_d_revalidate_rcu(struct dentry *dentry)
+{
+	struct sdcardfs_dentry_info *di, *parent_di;
+	struct dentry *lower_dentry;
+	struct inode *inode;
+	struct sdcardfs_inode_info *info;
+	struct sdcardfs_inode_data *top;
+	const unsigned char *name;
+
+	if (IS_ROOT(dentry))
+		return 1;
+
+	di = READ_ONCE(dentry->d_fsdata);
+	parent_di = READ_ONCE(READ_ONCE(dentry->d_parent)->d_fsdata);
+	if (!di || !parent_di)
+		return -ECHILD;
+
+	/* obb graft points need d_path() to check the base obbpath */
+	if (READ_ONCE(di->orig_path.dentry))
+		return -ECHILD;
+
+	lower_dentry = READ_ONCE(di->lower_path.dentry);
+	if (!lower_dentry || (lower_dentry->d_flags & DCACHE_OP_REVALIDATE))
+		return -ECHILD;
+
+	if (d_unhashed(lower_dentry) ||
+	    READ_ONCE(lower_dentry->d_parent) !=
+			READ_ONCE(parent_di->lower_path.dentry))
+		return -ECHILD;
+
+	name = READ_ONCE(lower_dentry->d_name.name);
+	if (READ_ONCE(lower_dentry->d_name.len) != dentry->d_name.len ||
+	    !str_n_case_eq(dentry->d_name.name, name, dentry->d_name.len))
+		return -ECHILD;
+
+	inode = d_inode_rcu(dentry);
+	if (!inode)
+		return -ECHILD;
+
+	info = SDCARDFS_I(inode);
+	top = READ_ONCE(info->top_data);
+	if (!top || READ_ONCE(top->abandoned))
+		return -ECHILD;
+
+	/* see fixup_stale_derived_permission() */
+	if (info->data->perm == PERM_ANDROID_PACKAGE &&
+	    info->data->generation != get_package_generation())
+		return -ECHILD;
+
+	return 1;
+}
+
 /*
  * returns: -ERRNO if error (returned to user)
  *          0: tell VFS to invalidate dentry
@@ -37,8 +112,14 @@ static int sdcardfs_d_revalidate(struct dentry *dentry, unsigned int flags)
 	struct inode *inode;
 	struct sdcardfs_inode_data *data;
 
-	if (flags & LOOKUP_RCU)
-		return -ECHILD;
+	if (flags & LOOKUP_RCU) {
+		err = sdcardfs_d_revalidate_rcu(dentry);
+		if (err == -ECHILD)
+			this_cpu_inc(revalidate_ref_walk);
+		else
+			this_cpu_inc(revalidate_rcu_walk);
+		return err;
+	}
 
 	spin_lock(&dentry->d_lock);
 	if (IS_ROOT(dentry)) {
@@ -118,6 +199,8 @@ static int sdcardfs_d_revalidate(struct dentry *dentry, unsigned int flags)
 		}
 		if (data)
 			data_put(data);
+		if (err)
+			fixup_stale_derived_permission(parent_dentry, dentry);
 		iput(inode);
 	}
 
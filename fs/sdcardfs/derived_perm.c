@@ -68,6 +68,7 @@ void get_derived_permission_new(struct dentry *parent, struct dentry *dentry,
 	struct qstr q_obb = QSTR_LITERAL("obb");
 	struct qstr q_media = QSTR_LITERAL("media");
 	struct qstr q_cache = QSTR_LITERAL("cache");
+	unsigned int generation = get_package_generation();
 
 	/* By default, each inode inherits from its parent.
 	 * the properties are maintained on its private fields
@@ -78,6 +79,7 @@ void get_derived_permission_new(struct dentry *parent, struct dentry *dentry,
 	 */
 
 	inherit_derived_state(d_inode(parent), d_inode(dentry));
+	info->data->generation = generation;
 
 	/* Files don't get special labels */
 	if (!S_ISDIR(d_inode(dentry)->i_mode))
@@ -264,17 +266,6 @@ void fixup_lower_ownership(struct dentry *dentry, const char *name)
 	sdcardfs_put_lower_path(dentry, &path);
 }
 
-static int descendant_may_need_fixup(struct sdcardfs_inode_data *data,
-		struct limit_search *limit)
-{
-	if (data->perm == PERM_ROOT)
-		return (limit->flags & BY_USERID) ?
-				data->userid == limit->userid : 1;
-	if (data->perm == PERM_PRE_ROOT || data->perm == PERM_ANDROID)
-		return 1;
-	return 0;
-}
-
 static int needs_fixup(perm_t perm)
 {
 	if (perm == PERM_ANDROID_DATA || perm == PERM_ANDROID_OBB
@@ -283,48 +274,24 @@ static int needs_fixup(perm_t perm)
 	return 0;
 }
 
-static void __fixup_perms_recursive(struct dentry *dentry, struct limit_search *limit, int depth)
+/*
+ * Only the package directories directly under Android/data, obb and media
+ * derive their owner from the package list, so they are the only ones that
+ * go stale when it changes. Re-derive them here instead of walking the
+ * whole dcache from the configfs handlers.
+ */
+void fixup_stale_derived_permission(struct dentry *parent, struct dentry *dentry)
 {
-	struct dentry *child;
-	struct sdcardfs_inode_info *info;
+	struct sdcardfs_inode_info *info = SDCARDFS_I(d_inode(dentry));
 
-	/*
-	 * All paths will terminate their recursion on hitting PERM_ANDROID_OBB,
-	 * PERM_ANDROID_MEDIA, or PERM_ANDROID_DATA. This happens at a depth of
-	 * at most 3.
-	 */
-	WARN(depth > 3, "%s: Max expected depth exceeded!\n", __func__);
-	spin_lock_nested(&dentry->d_lock, depth);
-	if (!d_inode(dentry)) {
-		spin_unlock(&dentry->d_lock);
+	if (info->data->perm != PERM_ANDROID_PACKAGE ||
+			info->data->generation == get_package_generation())
+		return;
+	if (!needs_fixup(SDCARDFS_I(d_inode(parent))->data->perm))
 		return;
-	}
-	info = SDCARDFS_I(d_inode(dentry));
-
-	if (needs_fixup(info->data->perm)) {
-		list_for_each_entry(child, &dentry->d_subdirs, d_child) {
-			spin_lock_nested(&child->d_lock, depth + 1);
-			if (!(limit->flags & BY_NAME) || qstr_case_eq(&child->d_name, &limit->name)) {
-				if (d_inode(child)) {
-					get_derived_permission(dentry, child);
-					fixup_tmp_permissions(d_inode(child));
-					spin_unlock(&child->d_lock);
-					break;
-				}
-			}
-			spin_unlock(&child->d_lock);
-		}
-	} else if (descendant_may_need_fixup(info->data, limit)) {
-		list_for_each_entry(child, &dentry->d_subdirs, d_child) {
-			__fixup_perms_recursive(child, limit, depth + 1);
-		}
-	}
-	spin_unlock(&dentry->d_lock);
-}
 
-void fixup_perms_recursive(struct dentry *dentry, struct limit_search *limit)
-{
-	__fixup_perms_recursive(dentry, limit, 0);
+	get_derived_permission(parent, dentry);
+	fixup_tmp_permissions(d_inode(dentry));
 }
 
 /* main function for updating derived permission */
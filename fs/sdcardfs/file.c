@@ -157,63 +157,34 @@ static long sdcardfs_compat_ioctl(struct file *file, unsigned int cmd,
 }
 #endif
 
+/*
+ * Hand the mapping over to the lower file, so faults and writeback run
+ * against the lower page cache directly instead of bouncing through our
+ * own vm_ops. The vma then holds a reference on the lower file only.
+ */
 static int sdcardfs_mmap(struct file *file, struct vm_area_struct *vma)
 {
-	int err = 0;
-	bool willwrite;
+	int err;
 	struct file *lower_file;
-	const struct vm_operations_struct *saved_vm_ops = NULL;
-
-	/* this might be deferred to mmap's writepage */
-	willwrite = ((vma->vm_flags | VM_SHARED | VM_WRITE) == vma->vm_flags);
-
-	/*
-	 * File systems which do not implement ->writepage may use
-	 * generic_file_readonly_mmap as their ->mmap op.  If you call
-	 * generic_file_readonly_mmap with VM_WRITE, you'd get an -EINVAL.
-	 * But we cannot call the lower ->mmap op, so we can't tell that
-	 * writeable mappings won't work.  Therefore, our only choice is to
-	 * check if the lower file system supports the ->writepage, and if
-	 * not, return EINVAL (the same error that
-	 * generic_file_readonly_mmap returns in that case).
-	 */
+
 	lower_file = sdcardfs_lower_file(file);
-	if (willwrite && !lower_file->f_mapping->a_ops->writepage) {
-		err = -EINVAL;
-		pr_err("sdcardfs: lower file system does not support writeable mmap\n");
-		goto out;
-	}
+	if (!lower_file->f_op->mmap)
+		return -ENODEV;
 
-	/*
-	 * find and save lower vm_ops.
-	 *
-	 * XXX: the VFS should have a cleaner way of finding the lower vm_ops
-	 */
-	if (!SDCARDFS_F(file)->lower_vm_ops) {
-		err = lower_file->f_op->mmap(lower_file, vma);
-		if (err) {
-			pr_err("sdcardfs: lower mmap failed %d\n", err);
-			goto out;
-		}
-		saved_vm_ops = vma->vm_ops; /* save: came from lower ->mmap */
+	if (WARN_ON(file != vma->vm_file))
+		return -EIO;
+
+	vma->vm_file = get_file(lower_file);
+	err = call_mmap(lower_file, vma);
+	if (err) {
+		pr_err("sdcardfs: lower mmap failed %d\n", err);
+		fput(lower_file);
+		return err;
 	}
+	fput(file);
 
-	/*
-	 * Next 3 lines are all I need from generic_file_mmap.  I definitely
-	 * don't want its test for ->readpage which returns -ENOEXEC.
-	 */
 	file_accessed(file);
-	vma->vm_ops = &sdcardfs_vm_ops;
-
-	file->f_mapping->a_ops = &sdcardfs_aops; /* set our aops */
-	if (!SDCARDFS_F(file)->lower_vm_ops) /* save for our ->fault */
-		SDCARDFS_F(file)->lower_vm_ops = saved_vm_ops;
-	vma->vm_private_data = file;
-	get_file(lower_file);
-	vma->vm_file = lower_file;
-
-out:
-	return err;
+	return 0;
 }
 
 static int sdcardfs_open(struct inode *inode, struct file *file)
@@ -260,6 +231,13 @@ static int sdcardfs_open(struct inode *inode, struct file *file)
 		}
 	} else {
 		sdcardfs_set_lower_file(file, lower_file);
+		/*
+		 * Share the lower page cache, so fadvise, readahead and
+		 * sync_file_range on our file act on the pages that
+		 * actually back it.
+		 */
+		if (S_ISREG(inode->i_mode))
+			file->f_mapping = lower_file->f_mapping;
 	}
 
 	if (err)
@@ -280,10 +258,8 @@ static int sdcardfs_flush(struct file *file, fl_owner_t id)
 	struct file *lower_file = NULL;
 
 	lower_file = sdcardfs_lower_file(file);
-	if (lower_file && lower_file->f_op && lower_file->f_op->flush) {
-		filemap_write_and_wait(file->f_mapping);
+	if (lower_file && lower_file->f_op && lower_file->f_op->flush)
 		err = lower_file->f_op->flush(lower_file, id);
-	}
 
 	return err;
 }
@@ -303,6 +279,7 @@ static int sdcardfs_file_release(struct inode *inode, struct file *file)
 	return 0;
 }
 
+/* all data lives in the lower page cache, so the lower fsync does it all */
 static int sdcardfs_fsync(struct file *file, loff_t start, loff_t end,
 			int datasync)
 {
@@ -311,15 +288,10 @@ static int sdcardfs_fsync(struct file *file, loff_t start, loff_t end,
 	struct path lower_path;
 	struct dentry *dentry = file->f_path.dentry;
 
-	err = __generic_file_fsync(file, start, end, datasync);
-	if (err)
-		goto out;
-
 	lower_file = sdcardfs_lower_file(file);
 	sdcardfs_get_lower_path(dentry, &lower_path);
 	err = vfs_fsync_range(lower_file, start, end, datasync);
 	sdcardfs_put_lower_path(dentry, &lower_path);
-out:
 	return err;
 }
 
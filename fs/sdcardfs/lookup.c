@@ -36,14 +36,24 @@ int sdcardfs_init_dentry_cache(void)
 
 void sdcardfs_destroy_dentry_cache(void)
 {
+	rcu_barrier();
 	kmem_cache_destroy(sdcardfs_dentry_cachep);
 }
 
+static void dentry_private_data_free_rcu(struct rcu_head *head)
+{
+	struct sdcardfs_dentry_info *info =
+		container_of(head, struct sdcardfs_dentry_info, rcu);
+
+	kmem_cache_free(sdcardfs_dentry_cachep, info);
+}
+
+/* RCU-walk revalidation may still be reading it, defer the free */
 void free_dentry_private_data(struct dentry *dentry)
 {
 	if (!dentry || !dentry->d_fsdata)
 		return;
-	kmem_cache_free(sdcardfs_dentry_cachep, dentry->d_fsdata);
+	call_rcu(&SDCARDFS_D(dentry)->rcu, dentry_private_data_free_rcu);
 	dentry->d_fsdata = NULL;
 }
 
@@ -36,12 +36,22 @@ struct hashtable_entry {
 	struct hlist_node dlist; /* for deletion cleanup */
 	struct qstr key;
 	atomic_t value;
+	struct rcu_head rcu;
 };
 
+/*
+ * Serializes updates to the tables below. Lookups only take
+ * rcu_read_lock(), and removed entries are freed after a grace period
+ * without the writer waiting for it.
+ */
+static DEFINE_MUTEX(packagelist_lock);
+
 static DEFINE_HASHTABLE(package_to_appid, 8);
 static DEFINE_HASHTABLE(package_to_userid, 8);
 static DEFINE_HASHTABLE(ext_to_groupid, 8);
 
+/* bumped whenever a change may alter the derived owner of a package dir */
+static atomic_t package_generation = ATOMIC_INIT(0);
 
 static struct kmem_cache *hashtable_entry_cachep;
 
@@ -249,55 +259,31 @@ static int insert_userid_exclude_entry_locked(const struct qstr *key, userid_t v
 	return 0;
 }
 
-static void fixup_all_perms_name(const struct qstr *key)
-{
-	struct sdcardfs_sb_info *sbinfo;
-	struct limit_search limit = {
-		.flags = BY_NAME,
-		.name = QSTR_INIT(key->name, key->len),
-	};
-	list_for_each_entry(sbinfo, &sdcardfs_super_list, list) {
-		if (sbinfo_has_sdcard_magic(sbinfo))
-			fixup_perms_recursive(sbinfo->sb->s_root, &limit);
-	}
-}
-
-static void fixup_all_perms_name_userid(const struct qstr *key, userid_t userid)
+/*
+ * Instead of walking every cached dentry, mark all derived permissions
+ * stale; package directories pick up the change on their next revalidate.
+ * The table update must be visible before the new generation is.
+ */
+static void invalidate_derived_perms(void)
 {
-	struct sdcardfs_sb_info *sbinfo;
-	struct limit_search limit = {
-		.flags = BY_NAME | BY_USERID,
-		.name = QSTR_INIT(key->name, key->len),
-		.userid = userid,
-	};
-	list_for_each_entry(sbinfo, &sdcardfs_super_list, list) {
-		if (sbinfo_has_sdcard_magic(sbinfo))
-			fixup_perms_recursive(sbinfo->sb->s_root, &limit);
-	}
+	smp_mb__before_atomic();
+	atomic_inc(&package_generation);
 }
 
-static void fixup_all_perms_userid(userid_t userid)
+unsigned int get_package_generation(void)
 {
-	struct sdcardfs_sb_info *sbinfo;
-	struct limit_search limit = {
-		.flags = BY_USERID,
-		.userid = userid,
-	};
-	list_for_each_entry(sbinfo, &sdcardfs_super_list, list) {
-		if (sbinfo_has_sdcard_magic(sbinfo))
-			fixup_perms_recursive(sbinfo->sb->s_root, &limit);
-	}
+	return atomic_read_acquire(&package_generation);
 }
 
 static int insert_packagelist_entry(const struct qstr *key, appid_t value)
 {
 	int err;
 
-	mutex_lock(&sdcardfs_super_list_lock);
+	mutex_lock(&packagelist_lock);
 	err = insert_packagelist_appid_entry_locked(key, value);
 	if (!err)
-		fixup_all_perms_name(key);
-	mutex_unlock(&sdcardfs_super_list_lock);
+		invalidate_derived_perms();
+	mutex_unlock(&packagelist_lock);
 
 	return err;
 }
@@ -306,9 +292,9 @@ static int insert_ext_gid_entry(const struct qstr *key, appid_t value)
 {
 	int err;
 
-	mutex_lock(&sdcardfs_super_list_lock);
+	mutex_lock(&packagelist_lock);
 	err = insert_ext_gid_entry_locked(key, value);
-	mutex_unlock(&sdcardfs_super_list_lock);
+	mutex_unlock(&packagelist_lock);
 
 	return err;
 }
@@ -317,11 +303,11 @@ static int insert_userid_exclude_entry(const struct qstr *key, userid_t value)
 {
 	int err;
 
-	mutex_lock(&sdcardfs_super_list_lock);
+	mutex_lock(&packagelist_lock);
 	err = insert_userid_exclude_entry_locked(key, value);
 	if (!err)
-		fixup_all_perms_name_userid(key, value);
-	mutex_unlock(&sdcardfs_super_list_lock);
+		invalidate_derived_perms();
+	mutex_unlock(&packagelist_lock);
 
 	return err;
 }
@@ -332,37 +318,44 @@ static void free_hashtable_entry(struct hashtable_entry *entry)
 	kmem_cache_free(hashtable_entry_cachep, entry);
 }
 
+static void free_hashtable_entry_rcu(struct rcu_head *head)
+{
+	free_hashtable_entry(container_of(head, struct hashtable_entry, rcu));
+}
+
+/* drop an entry already unlinked from its table once readers are done */
+static void release_hashtable_entry(struct hashtable_entry *entry)
+{
+	call_rcu(&entry->rcu, free_hashtable_entry_rcu);
+}
+
 static void remove_packagelist_entry_locked(const struct qstr *key)
 {
 	struct hashtable_entry *hash_cur;
 	unsigned int hash = key->hash;
 	struct hlist_node *h_t;
-	HLIST_HEAD(free_list);
 
-	hash_for_each_possible_rcu(package_to_userid, hash_cur, hlist, hash) {
+	hash_for_each_possible_safe(package_to_userid, hash_cur, h_t, hlist, hash) {
 		if (qstr_case_eq(key, &hash_cur->key)) {
 			hash_del_rcu(&hash_cur->hlist);
-			hlist_add_head(&hash_cur->dlist, &free_list);
+			release_hashtable_entry(hash_cur);
 		}
 	}
-	hash_for_each_possible_rcu(package_to_appid, hash_cur, hlist, hash) {
+	hash_for_each_possible(package_to_appid, hash_cur, hlist, hash) {
 		if (qstr_case_eq(key, &hash_cur->key)) {
 			hash_del_rcu(&hash_cur->hlist);
-			hlist_add_head(&hash_cur->dlist, &free_list);
+			release_hashtable_entry(hash_cur);
 			break;
 		}
 	}
-	synchronize_rcu();
-	hlist_for_each_entry_safe(hash_cur, h_t, &free_list, dlist)
-		free_hashtable_entry(hash_cur);
 }
 
 static void remove_packagelist_entry(const struct qstr *key)
 {
-	mutex_lock(&sdcardfs_super_list_lock);
+	mutex_lock(&packagelist_lock);
 	remove_packagelist_entry_locked(key);
-	fixup_all_perms_name(key);
-	mutex_unlock(&sdcardfs_super_list_lock);
+	invalidate_derived_perms();
+	mutex_unlock(&packagelist_lock);
 }
 
 static void remove_ext_gid_entry_locked(const struct qstr *key, gid_t group)
@@ -373,8 +366,7 @@ static void remove_ext_gid_entry_locked(const struct qstr *key, gid_t group)
 	hash_for_each_possible_rcu(ext_to_groupid, hash_cur, hlist, hash) {
 		if (qstr_case_eq(key, &hash_cur->key) && atomic_read(&hash_cur->value) == group) {
 			hash_del_rcu(&hash_cur->hlist);
-			synchronize_rcu();
-			free_hashtable_entry(hash_cur);
+			release_hashtable_entry(hash_cur);
 			break;
 		}
 	}
@@ -382,36 +374,31 @@ static void remove_ext_gid_entry_locked(const struct qstr *key, gid_t group)
 
 static void remove_ext_gid_entry(const struct qstr *key, gid_t group)
 {
-	mutex_lock(&sdcardfs_super_list_lock);
+	mutex_lock(&packagelist_lock);
 	remove_ext_gid_entry_locked(key, group);
-	mutex_unlock(&sdcardfs_super_list_lock);
+	mutex_unlock(&packagelist_lock);
 }
 
 static void remove_userid_all_entry_locked(userid_t userid)
 {
 	struct hashtable_entry *hash_cur;
 	struct hlist_node *h_t;
-	HLIST_HEAD(free_list);
 	int i;
 
-	hash_for_each_rcu(package_to_userid, i, hash_cur, hlist) {
+	hash_for_each_safe(package_to_userid, i, h_t, hash_cur, hlist) {
 		if (atomic_read(&hash_cur->value) == userid) {
 			hash_del_rcu(&hash_cur->hlist);
-			hlist_add_head(&hash_cur->dlist, &free_list);
+			release_hashtable_entry(hash_cur);
 		}
 	}
-	synchronize_rcu();
-	hlist_for_each_entry_safe(hash_cur, h_t, &free_list, dlist) {
-		free_hashtable_entry(hash_cur);
-	}
 }
 
 static void remove_userid_all_entry(userid_t userid)
 {
-	mutex_lock(&sdcardfs_super_list_lock);
+	mutex_lock(&packagelist_lock);
 	remove_userid_all_entry_locked(userid);
-	fixup_all_perms_userid(userid);
-	mutex_unlock(&sdcardfs_super_list_lock);
+	invalidate_derived_perms();
+	mutex_unlock(&packagelist_lock);
 }
 
 static void remove_userid_exclude_entry_locked(const struct qstr *key, userid_t userid)
@@ -423,8 +410,7 @@ static void remove_userid_exclude_entry_locked(const struct qstr *key, userid_t
 		if (qstr_case_eq(key, &hash_cur->key) &&
 				atomic_read(&hash_cur->value) == userid) {
 			hash_del_rcu(&hash_cur->hlist);
-			synchronize_rcu();
-			free_hashtable_entry(hash_cur);
+			release_hashtable_entry(hash_cur);
 			break;
 		}
 	}
@@ -432,10 +418,10 @@ static void remove_userid_exclude_entry_locked(const struct qstr *key, userid_t
 
 static void remove_userid_exclude_entry(const struct qstr *key, userid_t userid)
 {
-	mutex_lock(&sdcardfs_super_list_lock);
+	mutex_lock(&packagelist_lock);
 	remove_userid_exclude_entry_locked(key, userid);
-	fixup_all_perms_name_userid(key, userid);
-	mutex_unlock(&sdcardfs_super_list_lock);
+	invalidate_derived_perms();
+	mutex_unlock(&packagelist_lock);
 }
 
 static void packagelist_destroy(void)
@@ -445,7 +431,7 @@ static void packagelist_destroy(void)
 	HLIST_HEAD(free_list);
 	int i;
 
-	mutex_lock(&sdcardfs_super_list_lock);
+	mutex_lock(&packagelist_lock);
 	hash_for_each_rcu(package_to_appid, i, hash_cur, hlist) {
 		hash_del_rcu(&hash_cur->hlist);
 		hlist_add_head(&hash_cur->dlist, &free_list);
@@ -457,7 +443,7 @@ static void packagelist_destroy(void)
 	synchronize_rcu();
 	hlist_for_each_entry_safe(hash_cur, h_t, &free_list, dlist)
 		free_hashtable_entry(hash_cur);
-	mutex_unlock(&sdcardfs_super_list_lock);
+	mutex_unlock(&packagelist_lock);
 	pr_info("sdcardfs: destroyed packagelist pkgld\n");
 }
 
@@ -798,11 +784,23 @@ static struct configfs_attribute packages_attr_packages_gid_list = {
 	.show		= packages_list_show,
 };
 
+static ssize_t packages_revalidate_stats_show(struct config_item *item,
+					char *page)
+{
+	unsigned long rcu_walk, ref_walk;
+
+	sdcardfs_revalidate_stats(&rcu_walk, &ref_walk);
+	return scnprintf(page, PAGE_SIZE, "rcu_walk %lu\nref_walk_fallback %lu\n",
+			rcu_walk, ref_walk);
+}
+
 SDCARDFS_CONFIGFS_ATTR_WO(packages_, remove_userid);
+SDCARDFS_CONFIGFS_ATTR_RO(packages_, revalidate_stats);
 
 static struct configfs_attribute *packages_attrs[] = {
 	&packages_attr_packages_gid_list,
 	&packages_attr_remove_userid,
+	&packages_attr_revalidate_stats,
 	NULL,
 };
 
@@ -877,5 +875,6 @@ void packagelist_exit(void)
 {
 	configfs_sdcardfs_exit();
 	packagelist_destroy();
+	rcu_barrier();
 	kmem_cache_destroy(hashtable_entry_cachep);
 }
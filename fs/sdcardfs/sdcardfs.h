@@ -161,10 +161,11 @@ extern const struct inode_operations sdcardfs_symlink_iops;
 extern const struct super_operations sdcardfs_sops;
 extern const struct dentry_operations sdcardfs_ci_dops;
 extern const struct address_space_operations sdcardfs_aops, sdcardfs_dummy_aops;
-extern const struct vm_operations_struct sdcardfs_vm_ops;
 
 extern int sdcardfs_init_inode_cache(void);
 extern void sdcardfs_destroy_inode_cache(void);
+extern void sdcardfs_revalidate_stats(unsigned long *rcu_walk,
+		unsigned long *ref_walk);
 extern int sdcardfs_init_dentry_cache(void);
 extern void sdcardfs_destroy_dentry_cache(void);
 extern int new_dentry_private_data(struct dentry *dentry);
@@ -179,12 +180,13 @@ extern int sdcardfs_interpose(struct dentry *dentry, struct super_block *sb,
 /* file private data */
 struct sdcardfs_file_info {
 	struct file *lower_file;
-	const struct vm_operations_struct *lower_vm_ops;
 };
 
 struct sdcardfs_inode_data {
 	struct kref refcount;
 	bool abandoned;
+	/* read locklessly by RCU-walk revalidation */
+	struct rcu_head rcu;
 
 	perm_t perm;
 	userid_t userid;
@@ -192,6 +194,8 @@ struct sdcardfs_inode_data {
 	bool under_android;
 	bool under_cache;
 	bool under_obb;
+	/* package generation the state was derived against */
+	unsigned int generation;
 };
 
 /* sdcardfs inode data in memory */
@@ -212,6 +216,7 @@ struct sdcardfs_dentry_info {
 	spinlock_t lock;	/* protects lower_path */
 	struct path lower_path;
 	struct path orig_path;
+	struct rcu_head rcu;
 };
 
 struct sdcardfs_mount_options {
@@ -499,25 +504,18 @@ extern struct list_head sdcardfs_super_list;
 extern appid_t get_appid(const char *app_name);
 extern appid_t get_ext_gid(const char *app_name);
 extern appid_t is_excluded(const char *app_name, userid_t userid);
+extern unsigned int get_package_generation(void);
 extern int check_caller_access_to_name(struct inode *parent_node, const struct qstr *name);
 extern int packagelist_init(void);
 extern void packagelist_exit(void);
 
 /* for derived_perm.c */
-#define BY_NAME		(1 << 0)
-#define BY_USERID	(1 << 1)
-struct limit_search {
-	unsigned int flags;
-	struct qstr name;
-	userid_t userid;
-};
-
 extern void setup_derived_state(struct inode *inode, perm_t perm,
 		userid_t userid, uid_t uid, bool under_android,
 		struct sdcardfs_inode_data *top);
 extern void get_derived_permission(struct dentry *parent, struct dentry *dentry);
 extern void get_derived_permission_new(struct dentry *parent, struct dentry *dentry, const struct qstr *name);
-extern void fixup_perms_recursive(struct dentry *dentry, struct limit_search *limit);
+extern void fixup_stale_derived_permission(struct dentry *parent, struct dentry *dentry);
 
 extern void update_derived_permission_lock(struct dentry *dentry);
 void fixup_lower_ownership(struct dentry *dentry, const char *name);
@@ -35,12 +35,21 @@ static struct kmem_cache *sdcardfs_inode_cachep;
  */
 static struct kmem_cache *sdcardfs_inode_data_cachep;
 
+static void data_free_rcu(struct rcu_head *head)
+{
+	struct sdcardfs_inode_data *data =
+		container_of(head, struct sdcardfs_inode_data, rcu);
+
+	kmem_cache_free(sdcardfs_inode_data_cachep, data);
+}
+
 void data_release(struct kref *ref)
 {
 	struct sdcardfs_inode_data *data =
 		container_of(ref, struct sdcardfs_inode_data, refcount);
 
-	kmem_cache_free(sdcardfs_inode_data_cachep, data);
+	/* RCU-walk may still be looking at it through some top_data */
+	call_rcu(&data->rcu, data_free_rcu);
 }
 
 /* final actions when unmounting a file system */
@@ -266,6 +275,7 @@ int sdcardfs_init_inode_cache(void)
 /* sdcardfs inode cache destructor */
 void sdcardfs_destroy_inode_cache(void)
 {
+	rcu_barrier();
 	kmem_cache_destroy(sdcardfs_inode_data_cachep);
 	kmem_cache_destroy(sdcardfs_inode_cachep);
 }
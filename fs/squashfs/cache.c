@@ -42,6 +42,12 @@
  * have been packed with it, these because of locality-of-reference may be read
  * in the near future. Temporarily caching them ensures they are available for
  * near future access without requiring an additional read and decompress.
+ *
+ * The fixed entries of the metadata and fragment caches can be extended:
+ * a block evicted from a fixed entry is kept on an LRU of extra entries
+ * while memory is available, and is brought back by swapping buffers
+ * rather than by decompressing it again.  A shrinker frees the extra
+ * entries under memory pressure.
  */
 
 #include <linux/fs.h>
@@ -52,12 +58,163 @@
 #include <linux/spinlock.h>
 #include <linux/wait.h>
 #include <linux/pagemap.h>
+#include <linux/hash.h>
+#include <linux/seq_file.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
 #include "squashfs.h"
 #include "page_actor.h"
 
+#define SQUASHFS_CACHE_EXT_HASH_BITS	6
+
+static struct squashfs_cache_ext *squashfs_cache_ext_alloc(
+	struct squashfs_cache *cache, gfp_t gfp)
+{
+	struct squashfs_cache_ext *ext = kzalloc(sizeof(*ext), gfp);
+	int i;
+
+	if (ext == NULL)
+		return NULL;
+
+	ext->block = SQUASHFS_INVALID_BLK;
+	ext->data = kcalloc(cache->pages, sizeof(void *), gfp);
+	if (ext->data == NULL)
+		goto failed;
+
+	for (i = 0; i < cache->pages; i++) {
+		ext->data[i] = kmalloc(PAGE_SIZE, gfp);
+		if (ext->data[i] == NULL)
+			goto failed;
+	}
+
+	ext->actor = squashfs_page_actor_init(ext->data, cache->pages, 0);
+	if (ext->actor == NULL)
+		goto failed;
+
+	return ext;
+
+failed:
+	if (ext->data) {
+		for (i = 0; i < cache->pages; i++)
+			kfree(ext->data[i]);
+		kfree(ext->data);
+	}
+	kfree(ext);
+	return NULL;
+}
+
+
+static void squashfs_cache_ext_free(struct squashfs_cache *cache,
+	struct squashfs_cache_ext *ext)
+{
+	int i;
+
+	if (ext == NULL)
+		return;
+
+	for (i = 0; i < cache->pages; i++)
+		kfree(ext->data[i]);
+	kfree(ext->data);
+	kfree(ext->actor);
+	kfree(ext);
+}
+
+
+/*
+ * Exchange the buffers and contents of a cache entry and an extra entry.
+ * Called with cache->lock held.
+ */
+static void squashfs_cache_ext_swap(struct squashfs_cache_entry *entry,
+	struct squashfs_cache_ext *ext)
+{
+	swap(entry->block, ext->block);
+	swap(entry->length, ext->length);
+	swap(entry->next_index, ext->next_index);
+	swap(entry->data, ext->data);
+	swap(entry->actor, ext->actor);
+}
+
+
+/*
+ * Move the block held by an unused entry about to be reused onto the
+ * extra entries, if a spare buffer is available.  Called with
+ * cache->lock held.
+ */
+static void squashfs_cache_ext_evict(struct squashfs_cache *cache,
+	struct squashfs_cache_entry *entry)
+{
+	struct squashfs_cache_ext *ext = cache->spare;
+
+	if (!cache->extended || ext == NULL ||
+			entry->block == SQUASHFS_INVALID_BLK || entry->error)
+		return;
+
+	cache->spare = NULL;
+	squashfs_cache_ext_swap(entry, ext);
+	hlist_add_head(&ext->hash, &cache->ext_hash[hash_64(ext->block,
+		SQUASHFS_CACHE_EXT_HASH_BITS)]);
+	list_add(&ext->lru, &cache->ext_lru);
+	cache->ext_entries++;
+}
+
+
+/*
+ * Fill an entry from the extra entries if they hold block, and return
+ * the extra entry (now owning the entry's old buffers) to be reused as
+ * the spare or freed.  Called with cache->lock held.
+ */
+static struct squashfs_cache_ext *squashfs_cache_ext_get(
+	struct squashfs_cache *cache, struct squashfs_cache_entry *entry,
+	u64 block)
+{
+	struct squashfs_cache_ext *ext;
+
+	if (!cache->extended)
+		return NULL;
+
+	hlist_for_each_entry(ext, &cache->ext_hash[hash_64(block,
+			SQUASHFS_CACHE_EXT_HASH_BITS)], hash) {
+		if (ext->block == block) {
+			hlist_del(&ext->hash);
+			list_del(&ext->lru);
+			cache->ext_entries--;
+			squashfs_cache_ext_swap(entry, ext);
+			return ext;
+		}
+	}
+
+	return NULL;
+}
+
+
+/*
+ * Keep a spare buffer ready for the next eviction, allocated only from
+ * memory that is free without reclaim.
+ */
+static void squashfs_cache_ext_refill(struct squashfs_cache *cache)
+{
+	struct squashfs_cache_ext *ext;
+
+	if (!cache->extended || READ_ONCE(cache->spare))
+		return;
+
+	ext = squashfs_cache_ext_alloc(cache, (GFP_KERNEL &
+		~__GFP_DIRECT_RECLAIM) | __GFP_NOWARN);
+	if (ext == NULL)
+		return;
+
+	spin_lock(&cache->lock);
+	if (cache->spare == NULL) {
+		cache->spare = ext;
+		ext = NULL;
+	}
+	spin_unlock(&cache->lock);
+
+	squashfs_cache_ext_free(cache, ext);
+}
+
+
 /*
  * Look-up block in cache, and increment usage count.  If not in cache, read
  * and decompress it from disk.
@@ -67,6 +224,7 @@ struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 {
 	int i, n;
 	struct squashfs_cache_entry *entry;
+	struct squashfs_cache_ext *ext;
 
 	spin_lock(&cache->lock);
 
@@ -108,21 +266,40 @@ struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 			cache->next_blk = (i + 1) % cache->entries;
 			entry = &cache->entry[i];
 
+			squashfs_cache_ext_evict(cache, entry);
+
+			cache->unused--;
+			entry->refcount = 1;
+			entry->num_waiters = 0;
+			entry->error = 0;
+
+			ext = squashfs_cache_ext_get(cache, entry, block);
+			if (ext) {
+				cache->ext_hits++;
+				entry->pending = 0;
+				if (cache->spare == NULL) {
+					cache->spare = ext;
+					ext = NULL;
+				}
+				spin_unlock(&cache->lock);
+				squashfs_cache_ext_free(cache, ext);
+				goto out;
+			}
+
 			/*
 			 * Initialise chosen cache entry, and fill it in from
 			 * disk.
 			 */
-			cache->unused--;
+			cache->misses++;
 			entry->block = block;
-			entry->refcount = 1;
 			entry->pending = 1;
-			entry->num_waiters = 0;
-			entry->error = 0;
 			spin_unlock(&cache->lock);
 
 			entry->length = squashfs_read_data(sb, block, length,
 				&entry->next_index, entry->actor);
 
+			squashfs_cache_ext_refill(cache);
+
 			spin_lock(&cache->lock);
 
 			if (entry->length < 0)
@@ -151,6 +328,7 @@ struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 		 * for reuse.
 		 */
 		entry = &cache->entry[i];
+		cache->hits++;
 		if (entry->refcount == 0)
 			cache->unused--;
 		entry->refcount++;
@@ -204,6 +382,111 @@ void squashfs_cache_put(struct squashfs_cache_entry *entry)
 	spin_unlock(&cache->lock);
 }
 
+
+static unsigned long squashfs_cache_ext_count(struct shrinker *shrinker,
+	struct shrink_control *sc)
+{
+	struct squashfs_cache *cache = container_of(shrinker,
+		struct squashfs_cache, shrinker);
+
+	return READ_ONCE(cache->ext_entries) + !!READ_ONCE(cache->spare);
+}
+
+
+static unsigned long squashfs_cache_ext_scan(struct shrinker *shrinker,
+	struct shrink_control *sc)
+{
+	struct squashfs_cache *cache = container_of(shrinker,
+		struct squashfs_cache, shrinker);
+	struct squashfs_cache_ext *ext, *next, *spare;
+	unsigned long freed = 0;
+	LIST_HEAD(dispose);
+
+	spin_lock(&cache->lock);
+	while (freed < sc->nr_to_scan && !list_empty(&cache->ext_lru)) {
+		ext = list_last_entry(&cache->ext_lru,
+			struct squashfs_cache_ext, lru);
+		hlist_del(&ext->hash);
+		list_move(&ext->lru, &dispose);
+		cache->ext_entries--;
+		freed++;
+	}
+	spare = cache->spare;
+	cache->spare = NULL;
+	spin_unlock(&cache->lock);
+
+	list_for_each_entry_safe(ext, next, &dispose, lru)
+		squashfs_cache_ext_free(cache, ext);
+	if (spare) {
+		squashfs_cache_ext_free(cache, spare);
+		freed++;
+	}
+
+	return freed;
+}
+
+
+/*
+ * Extend the cache with extra entries freed by a shrinker.  The cache
+ * works without them if this fails.
+ */
+static void squashfs_cache_ext_init(struct squashfs_cache *cache)
+{
+	int i;
+
+	cache->ext_hash = kmalloc_array(1 << SQUASHFS_CACHE_EXT_HASH_BITS,
+		sizeof(*cache->ext_hash), GFP_KERNEL);
+	if (cache->ext_hash == NULL)
+		return;
+
+	for (i = 0; i < 1 << SQUASHFS_CACHE_EXT_HASH_BITS; i++)
+		INIT_HLIST_HEAD(&cache->ext_hash[i]);
+	INIT_LIST_HEAD(&cache->ext_lru);
+
+	cache->shrinker.count_objects = squashfs_cache_ext_count;
+	cache->shrinker.scan_objects = squashfs_cache_ext_scan;
+	cache->shrinker.seeks = DEFAULT_SEEKS;
+	if (register_shrinker(&cache->shrinker)) {
+		kfree(cache->ext_hash);
+		cache->ext_hash = NULL;
+		return;
+	}
+
+	cache->extended = true;
+}
+
+
+static void squashfs_cache_ext_delete(struct squashfs_cache *cache)
+{
+	struct squashfs_cache_ext *ext, *next;
+
+	if (!cache->extended)
+		return;
+
+	unregister_shrinker(&cache->shrinker);
+	list_for_each_entry_safe(ext, next, &cache->ext_lru, lru)
+		squashfs_cache_ext_free(cache, ext);
+	squashfs_cache_ext_free(cache, cache->spare);
+	kfree(cache->ext_hash);
+}
+
+
+void squashfs_cache_show_stats(struct seq_file *m,
+	struct squashfs_cache *cache)
+{
+	if (cache == NULL)
+		return;
+
+	spin_lock(&cache->lock);
+	seq_printf(m, "\n\t%s cache: hits %lu misses %lu", cache->name,
+		cache->hits, cache->misses);
+	if (cache->extended)
+		seq_printf(m, " extended hits %lu entries %d",
+			cache->ext_hits, cache->ext_entries);
+	spin_unlock(&cache->lock);
+}
+
+
 /*
  * Delete cache reclaiming all kmalloced buffers.
  */
@@ -214,6 +497,8 @@ void squashfs_cache_delete(struct squashfs_cache *cache)
 	if (cache == NULL)
 		return;
 
+	squashfs_cache_ext_delete(cache);
+
 	for (i = 0; i < cache->entries; i++) {
 		if (cache->entry[i].data) {
 			for (j = 0; j < cache->pages; j++)
@@ -234,7 +519,7 @@ void squashfs_cache_delete(struct squashfs_cache *cache)
  * is allocated as a sequence of kmalloced PAGE_SIZE buffers.
  */
 struct squashfs_cache *squashfs_cache_init(char *name, int entries,
-	int block_size)
+	int block_size, bool extend)
 {
 	int i, j;
 	struct squashfs_cache *cache = kzalloc(sizeof(*cache), GFP_KERNEL);
@@ -290,6 +575,9 @@ struct squashfs_cache *squashfs_cache_init(char *name, int entries,
 		}
 	}
 
+	if (extend)
+		squashfs_cache_ext_init(cache);
+
 	return cache;
 
 cleanup:
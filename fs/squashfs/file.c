@@ -46,7 +46,9 @@
 #include <linux/slab.h>
 #include <linux/string.h>
 #include <linux/pagemap.h>
+#include <linux/mm_inline.h>
 #include <linux/mutex.h>
+#include <linux/workqueue.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -497,7 +499,202 @@ static int squashfs_readpage(struct file *file, struct page *page)
 	return 0;
 }
 
+/*
+ * Readahead decompresses the datablocks it covers in parallel when the
+ * decompressor allows more than one stream, one work item per block.
+ */
+static struct workqueue_struct *squashfs_read_wq;
+
+struct squashfs_readahead {
+	struct work_struct work;
+	struct inode *inode;
+	u64 block;
+	int bsize;
+	int index;
+	int nr_pages;
+	struct page *pages[];
+};
+
+/*
+ * Fill the readahead pages of one datablock, which were added locked to
+ * the page cache.  The locked pages keep the inode, and so the
+ * superblock, alive until they are unlocked.
+ */
+static void squashfs_readahead_fill(struct squashfs_readahead *ra)
+{
+	struct inode *inode = ra->inode;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	struct squashfs_cache_entry *buffer = NULL;
+	int file_end = i_size_read(inode) >> msblk->block_log;
+	int mask = (1 << (msblk->block_log - PAGE_SHIFT)) - 1;
+	int bytes = msblk->block_size, offset = 0, res = 0, i;
+
+	if (ra->index < file_end || squashfs_i(inode)->fragment_block ==
+					SQUASHFS_INVALID_BLK) {
+		if (ra->index == file_end)
+			bytes = i_size_read(inode) & (msblk->block_size - 1);
+		if (ra->bsize)
+			buffer = squashfs_get_datablock(inode->i_sb, ra->block,
+				ra->bsize);
+	} else {
+		buffer = squashfs_get_fragment(inode->i_sb,
+			squashfs_i(inode)->fragment_block,
+			squashfs_i(inode)->fragment_size);
+		bytes = i_size_read(inode) & (msblk->block_size - 1);
+		offset = squashfs_i(inode)->fragment_offset;
+	}
+
+	if (buffer && buffer->error) {
+		res = buffer->error;
+		ERROR("Unable to read page, block %llx, size %x\n",
+			buffer->block, buffer->length);
+	}
+
+	for (i = 0; i < ra->nr_pages; i++) {
+		struct page *page = ra->pages[i];
+		int pos = (page->index & mask) << PAGE_SHIFT;
+		int avail;
+		void *pageaddr;
+
+		if (res) {
+			SetPageError(page);
+			continue;
+		}
+
+		avail = buffer ? clamp_t(int, bytes - pos, 0, PAGE_SIZE) : 0;
+		pageaddr = kmap_atomic(page);
+		squashfs_copy_data(pageaddr, buffer, offset + pos, avail);
+		memset(pageaddr + avail, 0, PAGE_SIZE - avail);
+		kunmap_atomic(pageaddr);
+		flush_dcache_page(page);
+		SetPageUptodate(page);
+	}
+
+	/* Release the cache entry while the locked pages pin the superblock */
+	if (buffer)
+		squashfs_cache_put(buffer);
+
+	for (i = 0; i < ra->nr_pages; i++) {
+		unlock_page(ra->pages[i]);
+		put_page(ra->pages[i]);
+	}
+}
+
+static void squashfs_readahead_work(struct work_struct *work)
+{
+	struct squashfs_readahead *ra = container_of(work,
+		struct squashfs_readahead, work);
+
+	squashfs_readahead_fill(ra);
+	kfree(ra);
+}
+
+static int squashfs_readpages(struct file *file, struct address_space *mapping,
+	struct list_head *pages, unsigned nr_pages)
+{
+	struct inode *inode = mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int shift = msblk->block_log - PAGE_SHIFT;
+	int file_end = i_size_read(inode) >> msblk->block_log;
+	pgoff_t end = (i_size_read(inode) + PAGE_SIZE - 1) >> PAGE_SHIFT;
+	gfp_t gfp = readahead_gfp_mask(mapping);
+	struct squashfs_readahead *first = NULL;
+
+	if (squashfs_max_decompressors() == 1) {
+		/* No parallelism to gain, behave as if there was no readpages */
+		while (!list_empty(pages)) {
+			struct page *page = lru_to_page(pages);
+
+			list_del(&page->lru);
+			if (!add_to_page_cache_lru(page, mapping, page->index,
+					gfp))
+				squashfs_readpage(file, page);
+			put_page(page);
+		}
+		return 0;
+	}
+
+	/* lru_to_page() returns the lowest index first */
+	while (!list_empty(pages)) {
+		struct page *page = lru_to_page(pages);
+		int index = page->index >> shift;
+		struct squashfs_readahead *ra;
+
+		if (page->index >= end)
+			break;
+
+		ra = kmalloc(sizeof(*ra) + (sizeof(struct page *) << shift),
+			GFP_KERNEL);
+		if (ra == NULL)
+			break;
+
+		ra->inode = inode;
+		ra->index = index;
+		ra->block = 0;
+		ra->bsize = 0;
+		ra->nr_pages = 0;
+		if (index < file_end || squashfs_i(inode)->fragment_block ==
+						SQUASHFS_INVALID_BLK) {
+			ra->bsize = read_blocklist(inode, index, &ra->block);
+			if (ra->bsize < 0) {
+				kfree(ra);
+				break;
+			}
+		}
+
+		while (!list_empty(pages)) {
+			page = lru_to_page(pages);
+			if (page->index >> shift != index)
+				break;
+
+			list_del(&page->lru);
+			if (add_to_page_cache_lru(page, mapping, page->index,
+					gfp)) {
+				put_page(page);
+				continue;
+			}
+			ra->pages[ra->nr_pages++] = page;
+		}
+
+		if (!ra->nr_pages) {
+			kfree(ra);
+			continue;
+		}
+
+		/* Fill the block needed first from this context */
+		if (!first) {
+			first = ra;
+			continue;
+		}
+
+		INIT_WORK(&ra->work, squashfs_readahead_work);
+		queue_work(squashfs_read_wq, &ra->work);
+	}
+
+	/* Whatever is left on the list is freed by the caller */
+	if (first) {
+		squashfs_readahead_fill(first);
+		kfree(first);
+	}
+
+	return 0;
+}
+
+int __init squashfs_readahead_init(void)
+{
+	squashfs_read_wq = alloc_workqueue("squashfs_read",
+		WQ_UNBOUND | WQ_MEM_RECLAIM, 0);
+
+	return squashfs_read_wq ? 0 : -ENOMEM;
+}
+
+void squashfs_readahead_exit(void)
+{
+	destroy_workqueue(squashfs_read_wq);
+}
+
 
 const struct address_space_operations squashfs_aops = {
-	.readpage = squashfs_readpage
+	.readpage = squashfs_readpage,
+	.readpages = squashfs_readpages
 };
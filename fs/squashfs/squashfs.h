@@ -32,11 +32,14 @@ extern int squashfs_read_data(struct super_block *, u64, int, u64 *,
 				struct squashfs_page_actor *);
 
 /* cache.c */
-extern struct squashfs_cache *squashfs_cache_init(char *, int, int);
+struct seq_file;
+extern struct squashfs_cache *squashfs_cache_init(char *, int, int, bool);
 extern void squashfs_cache_delete(struct squashfs_cache *);
 extern struct squashfs_cache_entry *squashfs_cache_get(struct super_block *,
 				struct squashfs_cache *, u64, int);
 extern void squashfs_cache_put(struct squashfs_cache_entry *);
+extern void squashfs_cache_show_stats(struct seq_file *,
+				struct squashfs_cache *);
 extern int squashfs_copy_data(void *, struct squashfs_cache_entry *, int, int);
 extern int squashfs_read_metadata(struct super_block *, void *, u64 *,
 				int *, int);
@@ -69,6 +72,8 @@ extern __le64 *squashfs_read_fragment_index_table(struct super_block *,
 /* file.c */
 void squashfs_copy_cache(struct page *, struct squashfs_cache_entry *, int,
 				int);
+extern int squashfs_readahead_init(void);
+extern void squashfs_readahead_exit(void);
 
 /* file_xxx.c */
 extern int squashfs_readpage_block(struct page *, u64, int);
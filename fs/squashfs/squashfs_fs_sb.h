@@ -25,6 +25,8 @@
 
 #include "squashfs_fs.h"
 
+#include <linux/shrinker.h>
+
 struct squashfs_cache {
 	char			*name;
 	int			entries;
@@ -37,6 +39,26 @@ struct squashfs_cache {
 	spinlock_t		lock;
 	wait_queue_head_t	wait_queue;
 	struct squashfs_cache_entry *entry;
+	unsigned long		hits;
+	unsigned long		misses;
+	/* Evicted blocks kept while memory allows, see cache.c */
+	bool			extended;
+	int			ext_entries;
+	unsigned long		ext_hits;
+	struct list_head	ext_lru;
+	struct hlist_head	*ext_hash;
+	struct squashfs_cache_ext *spare;
+	struct shrinker		shrinker;
+};
+
+struct squashfs_cache_ext {
+	u64			block;
+	int			length;
+	u64			next_index;
+	struct list_head	lru;
+	struct hlist_node	hash;
+	void			**data;
+	struct squashfs_page_actor	*actor;
 };
 
 struct squashfs_cache_entry {
@@ -38,6 +38,7 @@
 #include <linux/module.h>
 #include <linux/magic.h>
 #include <linux/xattr.h>
+#include <linux/seq_file.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -201,13 +202,13 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 	err = -ENOMEM;
 
 	msblk->block_cache = squashfs_cache_init("metadata",
-			SQUASHFS_CACHED_BLKS, SQUASHFS_METADATA_SIZE);
+			SQUASHFS_CACHED_BLKS, SQUASHFS_METADATA_SIZE, true);
 	if (msblk->block_cache == NULL)
 		goto failed_mount;
 
 	/* Allocate read_page block */
 	msblk->read_page = squashfs_cache_init("data",
-		squashfs_max_decompressors(), msblk->block_size);
+		squashfs_max_decompressors(), msblk->block_size, false);
 	if (msblk->read_page == NULL) {
 		ERROR("Failed to allocate read_page block\n");
 		goto failed_mount;
@@ -277,7 +278,7 @@ static int squashfs_fill_super(struct super_block *sb, void *data, int silent)
 		goto check_directory_table;
 
 	msblk->fragment_cache = squashfs_cache_init("fragment",
-		SQUASHFS_CACHED_FRAGMENTS, msblk->block_size);
+		SQUASHFS_CACHED_FRAGMENTS, msblk->block_size, true);
 	if (msblk->fragment_cache == NULL) {
 		err = -ENOMEM;
 		goto failed_mount;
@@ -444,8 +445,15 @@ static int __init init_squashfs_fs(void)
 	if (err)
 		return err;
 
+	err = squashfs_readahead_init();
+	if (err) {
+		destroy_inodecache();
+		return err;
+	}
+
 	err = register_filesystem(&squashfs_fs_type);
 	if (err) {
+		squashfs_readahead_exit();
 		destroy_inodecache();
 		return err;
 	}
@@ -459,6 +467,7 @@ static int __init init_squashfs_fs(void)
 static void __exit exit_squashfs_fs(void)
 {
 	unregister_filesystem(&squashfs_fs_type);
+	squashfs_readahead_exit();
 	destroy_inodecache();
 }
 
@@ -493,10 +502,24 @@ static struct file_system_type squashfs_fs_type = {
 };
 MODULE_ALIAS_FS("squashfs");
 
+/* Cache statistics, shown in /proc/<pid>/mountstats */
+static int squashfs_show_stats(struct seq_file *m, struct dentry *root)
+{
+	struct squashfs_sb_info *msblk = root->d_sb->s_fs_info;
+
+	squashfs_cache_show_stats(m, msblk->block_cache);
+	squashfs_cache_show_stats(m, msblk->fragment_cache);
+	squashfs_cache_show_stats(m, msblk->read_page);
+	seq_putc(m, '\n');
+	return 0;
+}
+
+
 static const struct super_operations squashfs_super_ops = {
 	.alloc_inode = squashfs_alloc_inode,
 	.destroy_inode = squashfs_destroy_inode,
 	.statfs = squashfs_statfs,
+	.show_stats = squashfs_show_stats,
 	.put_super = squashfs_put_super,
 	.remount_fs = squashfs_remount
 };
@@ -162,6 +162,10 @@ struct shash_desc {
  * @export: see struct ahash_alg
  * @import: see struct ahash_alg
  * @setkey: see struct ahash_alg
+ * @digest_many: Digest @n independent buffers of @len bytes each, the
+ *		 digest of @data[i] going to @out[i].  Optional, meant for
+ *		 implementations that hash several buffers in parallel; see
+ *		 crypto_shash_digest_many()
  * @digestsize: see struct ahash_alg
  * @statesize: see struct ahash_alg
  * @descsize: Size of the operational state for the message digest. This state
@@ -182,6 +186,8 @@ struct shash_alg {
 	int (*import)(struct shash_desc *desc, const void *in);
 	int (*setkey)(struct crypto_shash *tfm, const u8 *key,
 		      unsigned int keylen);
+	int (*digest_many)(struct shash_desc *desc, const u8 * const *data,
+			   unsigned int len, u8 * const *out, unsigned int n);
 
 	unsigned int descsize;
 
@@ -822,6 +828,25 @@ int crypto_shash_setkey(struct crypto_shash *tfm, const u8 *key,
 int crypto_shash_digest(struct shash_desc *desc, const u8 *data,
 			unsigned int len, u8 *out);
 
+/**
+ * crypto_shash_digest_many() - calculate message digests for several buffers
+ * @desc: see crypto_shash_final()
+ * @data: array of @n buffers
+ * @len: length of each buffer
+ * @out: array of @n digest buffers
+ * @n: number of buffers
+ *
+ * Same as calling crypto_shash_digest() on each buffer, but lets a
+ * multi-buffer implementation hash them in parallel.  Meant for users
+ * that hash many blocks of the same size, like block device integrity
+ * checking.
+ *
+ * Return: 0 if all the message digests were created successfully; < 0 if an
+ *	   error occurred
+ */
+int crypto_shash_digest_many(struct shash_desc *desc, const u8 * const *data,
+			     unsigned int len, u8 * const *out, unsigned int n);
+
 /**
  * crypto_shash_export() - extract operational state for message digest
  * @desc: reference to the operational state handle whose state is exported
@@ -37,6 +37,7 @@ enum alarmtimer_restart {
  * @type:	Alarm type (BOOTTIME/REALTIME).
  * @state:	Flag that represents if the alarm is set to fire or not.
  * @data:	Internal data value.
+ * @window:	How late the alarm may fire, to share a wakeup with others.
  */
 struct alarm {
 	struct timerqueue_node	node;
@@ -45,8 +46,19 @@ struct alarm {
 	enum alarmtimer_type	type;
 	int			state;
 	void			*data;
+	ktime_t			window;
 };
 
+/**
+ * alarm_set_window - Let an alarm fire up to @window after its expiry
+ * @alarm: ptr to alarm
+ * @window: tolerance, applies from the next alarm_start()
+ */
+static inline void alarm_set_window(struct alarm *alarm, ktime_t window)
+{
+	alarm->window = window;
+}
+
 void alarm_init(struct alarm *alarm, enum alarmtimer_type type,
 		enum alarmtimer_restart (*function)(struct alarm *, ktime_t));
 void alarm_start(struct alarm *alarm, ktime_t start);
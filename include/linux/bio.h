@@ -107,6 +107,15 @@ static inline bool bio_mergeable(struct bio *bio)
 	return true;
 }
 
+static inline bool bio_is_inline_encrypted(struct bio *bio)
+{
+#ifdef CONFIG_FS_ENCRYPTION_INLINE_CRYPT
+	return bio->bi_crypt_ksm;
+#else
+	return false;
+#endif
+}
+
 static inline unsigned int bio_cur_bytes(struct bio *bio)
 {
 	if (bio_has_data(bio))
@@ -16,6 +16,7 @@ struct page;
 struct block_device;
 struct io_context;
 struct cgroup_subsys_state;
+struct keyslot_manager;
 typedef void (bio_end_io_t) (struct bio *);
 
 /*
@@ -96,6 +97,15 @@ struct bio {
 		struct bio_integrity_payload *bi_integrity; /* data integrity */
 #endif
 	};
+#ifdef CONFIG_FS_ENCRYPTION_INLINE_CRYPT
+	/*
+	 * Inline encryption: the key slot of bi_crypt_ksm to use, and the
+	 * data unit number of bi_iter.bi_sector.  No encryption if NULL.
+	 */
+	struct keyslot_manager	*bi_crypt_ksm;
+	unsigned int		bi_crypt_slot;
+	u64			bi_crypt_dun;
+#endif
 
 	unsigned short		bi_vcnt;	/* how many bio_vec's */
 
@@ -230,6 +240,7 @@ enum req_flag_bits {
 	__REQ_NOUNMAP,		/* do not free blocks when zeroing */
 
 	__REQ_NOWAIT,           /* Don't wait if request will block */
+	__REQ_HIPRI,		/* submitter polls for the completion */
 	__REQ_NR_BITS,		/* stops here */
 };
 
@@ -249,6 +260,7 @@ enum req_flag_bits {
 
 #define REQ_NOUNMAP		(1ULL << __REQ_NOUNMAP)
 #define REQ_NOWAIT		(1ULL << __REQ_NOWAIT)
+#define REQ_HIPRI		(1ULL << __REQ_HIPRI)
 
 #define REQ_FAILFAST_MASK \
 	(REQ_FAILFAST_DEV | REQ_FAILFAST_TRANSPORT | REQ_FAILFAST_DRIVER)
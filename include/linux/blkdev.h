@@ -547,6 +547,11 @@ struct request_queue {
 
 	struct queue_limits	limits;
 
+#ifdef CONFIG_FS_ENCRYPTION_INLINE_CRYPT
+	/* Inline encryption engine of the device, set up by the driver */
+	struct keyslot_manager	*ksm;
+#endif
+
 	/*
 	 * sg stuff
 	 */
@@ -65,6 +65,10 @@ SUBSYS(pids)
 SUBSYS(rdma)
 #endif
 
+#if IS_ENABLED(CONFIG_CGROUP_TIMER_SLACK)
+SUBSYS(timer_slack)
+#endif
+
 /*
  * The following subsystems are not supported on the default hierarchy.
  */
@@ -144,6 +144,18 @@ struct dma_buf_ops {
 			      struct sg_table *,
 			      enum dma_data_direction);
 
+	/**
+	 * @cache_sgt_mapping:
+	 *
+	 * If true the core keeps the &sg_table returned by @map_dma_buf cached
+	 * in the attachment, and hands it out again on the next
+	 * dma_buf_map_attachment() for the same direction instead of calling
+	 * @map_dma_buf. The cached mapping is released on dma_buf_detach(), or
+	 * when the exporter calls dma_buf_invalidate_mappings() because the
+	 * backing storage moved.
+	 */
+	bool cache_sgt_mapping;
+
 	/* TODO: Add try_map_dma_buf version, to return immed with -EBUSY
 	 * if the call would block.
 	 */
@@ -310,6 +322,13 @@ struct dma_buf {
  * @dmabuf: buffer for this attachment.
  * @dev: device attached to the buffer.
  * @node: list of dma_buf_attachment.
+ * @sgt: cached mapping, if the exporter sets &dma_buf_ops.cache_sgt_mapping.
+ * @dir: direction of the cached mapping.
+ * @map_count: number of outstanding users of @sgt.
+ * @sgt_stale: @sgt was invalidated while in use and is released on the last
+ *	       unmap.
+ * @invalidate: optional importer callback, invoked with &dma_buf.lock held
+ *		when the exporter invalidates the mappings of this buffer.
  * @priv: exporter specific attachment data.
  *
  * This structure holds the attachment information between the dma_buf buffer
@@ -325,6 +344,11 @@ struct dma_buf_attachment {
 	struct dma_buf *dmabuf;
 	struct device *dev;
 	struct list_head node;
+	struct sg_table *sgt;
+	enum dma_data_direction dir;
+	unsigned int map_count;
+	bool sgt_stale;
+	void (*invalidate)(struct dma_buf_attachment *attach);
 	void *priv;
 };
 
@@ -391,6 +415,7 @@ struct sg_table *dma_buf_map_attachment(struct dma_buf_attachment *,
 					enum dma_data_direction);
 void dma_buf_unmap_attachment(struct dma_buf_attachment *, struct sg_table *,
 				enum dma_data_direction);
+void dma_buf_invalidate_mappings(struct dma_buf *dmabuf);
 int dma_buf_begin_cpu_access(struct dma_buf *dma_buf,
 			     enum dma_data_direction dir);
 int dma_buf_end_cpu_access(struct dma_buf *dma_buf,
@@ -47,6 +47,10 @@ struct dma_fence_cb;
  * can be compared to decide which fence would be signaled later.
  * @flags: A mask of DMA_FENCE_FLAG_* defined below
  * @timestamp: Timestamp when the fence was signaled.
+ * @init_time: Timestamp when the fence was initialized, 0 unless fence
+ * statistics were enabled at the time.
+ * @frame_id: Frame of the task that initialized the fence, see
+ * <linux/frame_trace.h>.
  * @error: Optional, only valid if < 0, must be set before calling
  * dma_fence_signal, indicates that the fence has completed with an error.
  *
@@ -80,6 +84,10 @@ struct dma_fence {
 	unsigned seqno;
 	unsigned long flags;
 	ktime_t timestamp;
+#ifdef CONFIG_DMA_FENCE_STATS
+	ktime_t init_time;
+#endif
+	u64 frame_id;
 	int error;
 };
 
@@ -189,6 +197,11 @@ void dma_fence_init(struct dma_fence *fence, const struct dma_fence_ops *ops,
 void dma_fence_release(struct kref *kref);
 void dma_fence_free(struct dma_fence *fence);
 
+#ifdef CONFIG_DMA_FENCE_STATS
+struct seq_file;
+void dma_fence_stats_show(struct seq_file *s);
+#endif
+
 /**
  * dma_fence_put - decreases refcount of the fence
  * @fence:	[in]	fence to reduce refcount of
@@ -16,6 +16,7 @@
 #include <linux/workqueue.h>
 #include <linux/sched.h>
 #include <linux/capability.h>
+#include <linux/jump_label.h>
 #include <linux/cryptohash.h>
 #include <linux/set_memory.h>
 
@@ -482,7 +483,15 @@ struct sk_filter {
 	struct bpf_prog	*prog;
 };
 
-#define BPF_PROG_RUN(filter, ctx)  (*filter->bpf_func)(ctx, filter->insnsi)
+DECLARE_STATIC_KEY_FALSE(bpf_stats_enabled_key);
+
+u32 bpf_prog_run_stats(const struct bpf_prog *prog, const void *ctx);
+
+/* Run time accounting costs a patched out branch unless it is enabled */
+#define BPF_PROG_RUN(filter, ctx)					\
+	(static_branch_unlikely(&bpf_stats_enabled_key) ?		\
+	 bpf_prog_run_stats(filter, ctx) :				\
+	 (*(filter)->bpf_func)(ctx, (filter)->insnsi))
 
 #define BPF_SKB_CB_LEN QDISC_CB_PRIV_LEN
 
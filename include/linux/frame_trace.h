@@ -0,0 +1,53 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Frame latency tracing
+ *
+ * A frame id is an opaque, non-zero token chosen by userspace, e.g. the
+ * vsync id of the frame.  A thread tags the frame it works on with
+ * BINDER_SET_FRAME_ID, and the id then follows the work of the frame:
+ * binder transactions hand it to the thread that receives them, fences
+ * and atomic commits take it from the thread that creates them.  Each
+ * stage emits the frame:frame_stage trace event, so a tracer in its own
+ * tracefs instance gets the timeline of every frame, from the binder call
+ * of the app to the vblank of the flip.
+ */
+#ifndef _LINUX_FRAME_TRACE_H
+#define _LINUX_FRAME_TRACE_H
+
+#include <linux/preempt.h>
+#include <linux/sched.h>
+
+enum frame_stage {
+	FRAME_STAGE_BINDER_SEND,	/* binder transaction sent */
+	FRAME_STAGE_BINDER_RECV,	/* binder transaction received */
+	FRAME_STAGE_FENCE_EXPORT,	/* fence exported as a sync_file */
+	FRAME_STAGE_GPU_SUBMIT,		/* GPU request submitted to the hardware */
+	FRAME_STAGE_FENCE_SIGNAL,	/* fence signaled */
+	FRAME_STAGE_COMMIT,		/* atomic commit queued */
+	FRAME_STAGE_FLIP,		/* planes of the commit programmed */
+	FRAME_STAGE_VBLANK,		/* the flip of the commit is done */
+};
+
+#ifdef CONFIG_TRACING
+/* The frame of the current task, 0 outside of task context */
+static inline u64 frame_trace_id(void)
+{
+	return in_task() ? current->frame_id : 0;
+}
+
+static inline void frame_trace_set_id(u64 frame_id)
+{
+	current->frame_id = frame_id;
+}
+#else
+static inline u64 frame_trace_id(void)
+{
+	return 0;
+}
+
+static inline void frame_trace_set_id(u64 frame_id)
+{
+}
+#endif
+
+#endif /* _LINUX_FRAME_TRACE_H */
@@ -69,6 +69,8 @@ struct fscrypt_name {
  * fscrypt superblock flags
  */
 #define FS_CFLG_OWN_PAGES (1U << 1)
+/* The filesystem tags its bios with fscrypt_set_bio_crypt_ctx() */
+#define FS_CFLG_INLINE_CRYPT (1U << 2)
 
 /*
  * crypto opertions for filesystems
@@ -164,6 +164,12 @@ static inline void fscrypt_decrypt_bio_pages(struct fscrypt_ctx *ctx,
 	return;
 }
 
+static inline int fscrypt_encrypt_bio_pages(const struct inode *inode,
+					    struct bio *bio, gfp_t gfp_flags)
+{
+	return -EOPNOTSUPP;
+}
+
 static inline void fscrypt_pullback_bio_page(struct page **page, bool restore)
 {
 	return;
@@ -175,4 +181,23 @@ static inline int fscrypt_zeroout_range(const struct inode *inode, pgoff_t lblk,
 	return -EOPNOTSUPP;
 }
 
+/* inline_crypt.c */
+static inline bool fscrypt_inode_uses_inline_crypto(const struct inode *inode)
+{
+	return false;
+}
+
+static inline void fscrypt_set_bio_crypt_ctx(struct bio *bio,
+					     const struct inode *inode,
+					     pgoff_t first_lblk)
+{
+}
+
+static inline bool fscrypt_mergeable_bio(struct bio *bio,
+					 const struct inode *inode,
+					 pgoff_t next_lblk)
+{
+	return true;
+}
+
 #endif	/* _LINUX_FSCRYPT_NOTSUPP_H */
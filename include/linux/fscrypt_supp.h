@@ -139,8 +139,37 @@ static inline bool fscrypt_match_name(const struct fscrypt_name *fname,
 
 /* bio.c */
 extern void fscrypt_decrypt_bio_pages(struct fscrypt_ctx *, struct bio *);
+extern int fscrypt_encrypt_bio_pages(const struct inode *, struct bio *,
+				     gfp_t);
 extern void fscrypt_pullback_bio_page(struct page **, bool);
 extern int fscrypt_zeroout_range(const struct inode *, pgoff_t, sector_t,
 				 unsigned int);
 
+/* inline_crypt.c */
+#ifdef CONFIG_FS_ENCRYPTION_INLINE_CRYPT
+extern bool fscrypt_inode_uses_inline_crypto(const struct inode *);
+extern void fscrypt_set_bio_crypt_ctx(struct bio *, const struct inode *,
+				      pgoff_t);
+extern bool fscrypt_mergeable_bio(struct bio *, const struct inode *,
+				  pgoff_t);
+#else
+static inline bool fscrypt_inode_uses_inline_crypto(const struct inode *inode)
+{
+	return false;
+}
+
+static inline void fscrypt_set_bio_crypt_ctx(struct bio *bio,
+					     const struct inode *inode,
+					     pgoff_t first_lblk)
+{
+}
+
+static inline bool fscrypt_mergeable_bio(struct bio *bio,
+					 const struct inode *inode,
+					 pgoff_t next_lblk)
+{
+	return true;
+}
+#endif
+
 #endif	/* _LINUX_FSCRYPT_SUPP_H */
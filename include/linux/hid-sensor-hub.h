@@ -242,6 +242,11 @@ struct hid_sensor_common {
 	struct hid_sensor_hub_attribute_info sensitivity;
 	struct hid_sensor_hub_attribute_info report_latency;
 	struct work_struct work;
+	/* scans held back until the buffer watermark, see hid_sensor_push() */
+	spinlock_t batch_lock;
+	u8 *batch;
+	unsigned int batch_count;
+	unsigned int batch_watermark;
 };
 
 /* Convert from hid unit expo to regular exponent */
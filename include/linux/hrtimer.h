@@ -461,6 +461,14 @@ extern long hrtimer_nanosleep(const struct timespec64 *rqtp,
 extern void hrtimer_init_sleeper(struct hrtimer_sleeper *sl,
 				 struct task_struct *tsk);
 
+#ifdef CONFIG_CGROUP_TIMER_SLACK
+extern void timer_slack_account_expiry(struct task_struct *tsk,
+				       struct hrtimer *timer);
+#else
+static inline void timer_slack_account_expiry(struct task_struct *tsk,
+					      struct hrtimer *timer) { }
+#endif
+
 extern int schedule_hrtimeout_range(ktime_t *expires, u64 delta,
 						const enum hrtimer_mode mode);
 extern int schedule_hrtimeout_range_clock(ktime_t *expires,
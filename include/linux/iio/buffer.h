@@ -18,6 +18,8 @@ void iio_buffer_set_attrs(struct iio_buffer *buffer,
 			 const struct attribute **attrs);
 
 int iio_push_to_buffers(struct iio_dev *indio_dev, const void *data);
+int iio_push_to_buffers_n(struct iio_dev *indio_dev, const void *data,
+			  unsigned int n);
 
 /**
  * iio_push_to_buffers_with_timestamp() - push data and timestamp to buffers
@@ -95,6 +95,8 @@ struct input_value {
  * @grab: input handle that currently has the device grabbed (via
  *	EVIOCGRAB ioctl). When a handle grabs a device it becomes sole
  *	recipient for all input events coming from the device
+ * @only_handle: the open handle of the device when there is exactly one,
+ *	events are then passed to it without walking @h_list
  * @event_lock: this spinlock is taken when input core receives
  *	and processes a new event for the device (in input_event()).
  *	Code that accesses and/or modifies parameters of a device
@@ -117,6 +119,11 @@ struct input_value {
  * @vals: array of values queued in the current frame
  * @devres_managed: indicates that devices is managed with devres framework
  *	and needs not be explicitly unregistered or freed.
+ * @timestamp: CLOCK_MONOTONIC time the current frame was captured at, as
+ *	set by the driver with input_set_timestamp(), or 0
+ * @num_events: number of events passed to handlers, under @event_lock
+ * @num_frames: number of batches of events passed to handlers, under
+ *	@event_lock
  */
 struct input_dev {
 	const char *name;
@@ -170,6 +177,7 @@ struct input_dev {
 	int (*event)(struct input_dev *dev, unsigned int type, unsigned int code, int value);
 
 	struct input_handle __rcu *grab;
+	struct input_handle __rcu *only_handle;
 
 	spinlock_t event_lock;
 	struct mutex mutex;
@@ -187,6 +195,11 @@ struct input_dev {
 	struct input_value *vals;
 
 	bool devres_managed;
+
+	ktime_t timestamp;
+
+	u64 num_events;
+	u64 num_frames;
 };
 #define to_input_dev(d) container_of(d, struct input_dev, dev)
 
@@ -423,6 +436,34 @@ static inline void input_mt_sync(struct input_dev *dev)
 	input_event(dev, EV_SYN, SYN_MT_REPORT, 0);
 }
 
+/**
+ * input_set_timestamp - set the capture time of the current frame
+ * @dev: input device
+ * @timestamp: CLOCK_MONOTONIC time, typically taken in the hard
+ *	interrupt handler of the device
+ *
+ * Handlers report the events of the frame with this time instead of the
+ * time they got them at.  It is reset once the frame is reported with
+ * input_sync().
+ */
+static inline void input_set_timestamp(struct input_dev *dev,
+				       ktime_t timestamp)
+{
+	dev->timestamp = timestamp;
+}
+
+/**
+ * input_get_timestamp - get the capture time of the current frame
+ * @dev: input device
+ *
+ * Returns the time set with input_set_timestamp(), or the current
+ * CLOCK_MONOTONIC time if none was set for the frame.
+ */
+static inline ktime_t input_get_timestamp(struct input_dev *dev)
+{
+	return dev->timestamp ? dev->timestamp : ktime_get();
+}
+
 void input_set_capability(struct input_dev *dev, unsigned int type, unsigned int code);
 
 /**
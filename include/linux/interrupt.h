@@ -413,6 +413,16 @@ static inline int disable_irq_wake(unsigned int irq)
 	return irq_set_irq_wake(irq, 0);
 }
 
+/* Adaptive moderation of high-rate threaded interrupts: */
+#ifdef CONFIG_IRQ_MODERATION
+extern int irq_set_moderation(unsigned int irq, unsigned int threshold);
+#else
+static inline int irq_set_moderation(unsigned int irq, unsigned int threshold)
+{
+	return -EOPNOTSUPP;
+}
+#endif
+
 /*
  * irq_get_irqchip_state/irq_set_irqchip_state specific flags
  */
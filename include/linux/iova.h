@@ -27,12 +27,15 @@ struct iova {
 struct iova_magazine;
 struct iova_cpu_rcache;
 
-#define IOVA_RANGE_CACHE_MAX_SIZE 6	/* log of max cached IOVA range size (in pages) */
+#define IOVA_RANGE_CACHE_LARGE_SIZE 6	/* log of min large IOVA range size (in pages) */
+#define IOVA_RANGE_CACHE_MAX_SIZE 13	/* log of max cached IOVA range size (in pages) */
 #define MAX_GLOBAL_MAGS 32	/* magazines per bin */
 
 struct iova_rcache {
 	spinlock_t lock;
 	unsigned long depot_size;
+	unsigned long depot_max;	/* magazines kept in the depot */
+	unsigned long mag_size;		/* pfns per magazine */
 	struct iova_magazine *depot[MAX_GLOBAL_MAGS];
 	struct iova_cpu_rcache __percpu *cpu_rcaches;
 };
@@ -51,6 +54,9 @@ typedef void (* iova_entry_dtor)(unsigned long data);
 /* Timeout (in ms) after which entries are flushed from the Flush-Queue */
 #define IOVA_FQ_TIMEOUT	10
 
+/* Default number of entries a Flush Queue takes before it is flushed */
+#define IOVA_FQ_BATCH	(IOVA_FQ_SIZE - 1)
+
 /* Flush Queue entry for defered flushing */
 struct iova_fq_entry {
 	unsigned long iova_pfn;
@@ -70,10 +76,12 @@ struct iova_fq {
 struct iova_domain {
 	spinlock_t	iova_rbtree_lock; /* Lock to protect update of rbtree */
 	struct rb_root	rbroot;		/* iova domain rbtree root */
-	struct rb_node	*cached32_node; /* Save last alloced node */
+	struct rb_node	*cached_node;	/* Save last alloced node */
+	struct rb_node	*cached32_node; /* Save last 32-bit alloced node */
 	unsigned long	granule;	/* pfn granularity for this domain */
 	unsigned long	start_pfn;	/* Lower limit for this domain */
 	unsigned long	dma_32bit_pfn;
+	unsigned long	max32_alloc_size; /* Size of last failed allocation */
 	struct iova_rcache rcaches[IOVA_RANGE_CACHE_MAX_SIZE];	/* IOVA range caches */
 
 	iova_flush_cb	flush_cb;	/* Call-Back function to flush IOMMU
@@ -84,6 +92,11 @@ struct iova_domain {
 
 	struct iova_fq __percpu *fq;	/* Flush Queue */
 
+	unsigned int	fq_batch;	/* Entries per Flush Queue that force
+					   a flush, 1..IOVA_FQ_BATCH */
+	unsigned int	fq_timeout;	/* Timeout (in ms) of the Flush Queues
+					   that are not full */
+
 	atomic64_t	fq_flush_start_cnt;	/* Number of TLB flushes that
 						   have been started */
 
@@ -11,6 +11,7 @@
  */
 
 struct irq_affinity_notify;
+struct irq_moderation;
 struct proc_dir_entry;
 struct module;
 struct irq_desc;
@@ -50,6 +51,7 @@ struct pt_regs;
  * @request_mutex:	mutex to protect request/free before locking desc->lock
  * @dir:		/proc/irq/ procfs entry
  * @debugfs_file:	dentry for the debugfs file
+ * @moderation:		adaptive moderation state, see irq_set_moderation()
  * @name:		flow handler name for /proc/interrupts output
  */
 struct irq_desc {
@@ -95,6 +97,9 @@ struct irq_desc {
 #ifdef CONFIG_GENERIC_IRQ_DEBUGFS
 	struct dentry		*debugfs_file;
 #endif
+#ifdef CONFIG_IRQ_MODERATION
+	struct irq_moderation	*moderation;
+#endif
 #ifdef CONFIG_SPARSE_IRQ
 	struct rcu_head		rcu;
 	struct kobject		kobj;
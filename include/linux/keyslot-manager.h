@@ -0,0 +1,68 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * keyslot-manager.h
+ *
+ * Interface between storage drivers with an inline encryption engine and
+ * the users of its key slots.
+ */
+
+#ifndef _LINUX_KEYSLOT_MANAGER_H
+#define _LINUX_KEYSLOT_MANAGER_H
+
+#include <linux/types.h>
+
+enum blk_crypto_mode {
+	BLK_ENCRYPTION_MODE_AES_256_XTS,
+	BLK_ENCRYPTION_MODE_MAX,
+};
+
+#define BLK_CRYPTO_MAX_KEY_SIZE		64
+
+struct keyslot_manager;
+
+/**
+ * struct keyslot_mgmt_ll_ops - Hooks for programming the hardware key slots
+ * @keyslot_program: Write @key into @slot.  May sleep.
+ * @keyslot_evict:   Clear @slot.  May sleep.
+ */
+struct keyslot_mgmt_ll_ops {
+	int (*keyslot_program)(struct keyslot_manager *ksm, const u8 *key,
+			       unsigned int key_size, enum blk_crypto_mode mode,
+			       unsigned int slot);
+	int (*keyslot_evict)(struct keyslot_manager *ksm, unsigned int slot);
+};
+
+#ifdef CONFIG_FS_ENCRYPTION_INLINE_CRYPT
+
+extern struct keyslot_manager *keyslot_manager_create(unsigned int num_slots,
+			const struct keyslot_mgmt_ll_ops *ksm_ops,
+			unsigned int crypto_modes, unsigned int data_unit_size,
+			void *ll_priv_data);
+extern void keyslot_manager_destroy(struct keyslot_manager *ksm);
+extern void *keyslot_manager_private(struct keyslot_manager *ksm);
+extern bool keyslot_manager_crypto_mode_supported(struct keyslot_manager *ksm,
+			enum blk_crypto_mode mode, unsigned int data_unit_size);
+extern int keyslot_manager_get_slot_for_key(struct keyslot_manager *ksm,
+			const u8 *key, unsigned int key_size,
+			enum blk_crypto_mode mode);
+extern void keyslot_manager_put_slot(struct keyslot_manager *ksm,
+				     unsigned int slot);
+
+#else
+
+static inline struct keyslot_manager *keyslot_manager_create(
+			unsigned int num_slots,
+			const struct keyslot_mgmt_ll_ops *ksm_ops,
+			unsigned int crypto_modes, unsigned int data_unit_size,
+			void *ll_priv_data)
+{
+	return NULL;
+}
+
+static inline void keyslot_manager_destroy(struct keyslot_manager *ksm)
+{
+}
+
+#endif	/* CONFIG_FS_ENCRYPTION_INLINE_CRYPT */
+
+#endif	/* _LINUX_KEYSLOT_MANAGER_H */
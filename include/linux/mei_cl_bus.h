@@ -10,6 +10,8 @@ struct mei_cl_device;
 struct mei_device;
 
 typedef void (*mei_cldev_cb_t)(struct mei_cl_device *cldev);
+typedef void (*mei_cldev_req_cb_t)(struct mei_cl_device *cldev, void *context,
+				   const u8 *buf, ssize_t length);
 
 /**
  * struct mei_cl_device - MEI device handle
@@ -30,6 +32,9 @@ typedef void (*mei_cldev_cb_t)(struct mei_cl_device *cldev);
  * @notif_work: async work to execute FW notif event callback
  * @notif_cb: Drivers register this callback to get asynchronous ME
  *	FW notification pending notifications.
+ * @req_work: async work to complete submitted requests
+ * @req_pending: requests submitted with mei_cldev_submit(), oldest first
+ * @req_inflight: number of requests on @req_pending
  *
  * @do_match: wheather device can be matched with a driver
  * @is_added: device is already scanned
@@ -48,6 +53,9 @@ struct mei_cl_device {
 	mei_cldev_cb_t rx_cb;
 	struct work_struct notif_work;
 	mei_cldev_cb_t notif_cb;
+	struct work_struct req_work;
+	struct list_head req_pending;
+	unsigned int req_inflight;
 
 	unsigned int do_match:1;
 	unsigned int is_added:1;
@@ -90,6 +98,8 @@ ssize_t mei_cldev_send(struct mei_cl_device *cldev, u8 *buf, size_t length);
 ssize_t mei_cldev_recv(struct mei_cl_device *cldev, u8 *buf, size_t length);
 ssize_t mei_cldev_recv_nonblock(struct mei_cl_device *cldev, u8 *buf,
 				size_t length);
+int mei_cldev_submit(struct mei_cl_device *cldev, const u8 *buf, size_t length,
+		     mei_cldev_req_cb_t complete, void *context);
 
 int mei_cldev_register_rx_cb(struct mei_cl_device *cldev, mei_cldev_cb_t rx_cb);
 int mei_cldev_register_notif_cb(struct mei_cl_device *cldev,
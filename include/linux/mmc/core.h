@@ -170,6 +170,11 @@ struct mmc_request {
 
 	int			tag;
 	ktime_t			io_start;
+
+	/* Inline encryption: key slot and first data unit number */
+	bool			crypto_enabled;
+	unsigned int		crypto_key_slot;
+	u64			crypto_dun;
 #ifdef CONFIG_BLOCK
 	int			lat_hist_enabled;
 #endif
@@ -178,6 +183,7 @@ struct mmc_request {
 struct mmc_card;
 
 void mmc_wait_for_req(struct mmc_host *host, struct mmc_request *mrq);
+void mmc_cqe_request_done(struct mmc_host *host, struct mmc_request *mrq);
 int mmc_wait_for_cmd(struct mmc_host *host, struct mmc_command *cmd,
 		int retries);
 
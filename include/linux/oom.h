@@ -102,6 +102,14 @@ extern void oom_killer_enable(void);
 
 extern struct task_struct *find_lock_task_mm(struct task_struct *p);
 
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER_TASK_INDEX
+extern void lowmem_oom_score_adj_update(struct task_struct *task);
+#else
+static inline void lowmem_oom_score_adj_update(struct task_struct *task)
+{
+}
+#endif
+
 /* sysctls */
 extern int sysctl_oom_dump_tasks;
 extern int sysctl_oom_kill_allocating_task;
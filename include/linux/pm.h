@@ -569,6 +569,11 @@ struct dev_pm_info {
 	bool			wakeup_path:1;
 	bool			syscore:1;
 	bool			no_pm_callbacks:1;	/* Owned by the PM core */
+	bool			resumed_async:1;	/* Owned by the PM core */
+	/* Time spent in the resume phases of the last system resume */
+	u32			resume_noirq_us;	/* Owned by the PM core */
+	u32			resume_early_us;	/* Ditto */
+	u32			resume_us;		/* Ditto */
 #else
 	unsigned int		should_wakeup:1;
 #endif
@@ -44,10 +44,14 @@ struct wake_irq;
  * @last_time: Monotonic clock when the wakeup source's was touched last time.
  * @prevent_sleep_time: Total time this source has been preventing autosleep.
  * @event_count: Number of signaled wakeup events.
+ * @nolock_event_count: Events counted without taking @lock, see
+ *	wakeup_source_event_count().
  * @active_count: Number of times the wakeup source was activated.
  * @relax_count: Number of times the wakeup source was deactivated.
  * @expire_count: Number of times the wakeup source's timeout has expired.
  * @wakeup_count: Number of times the wakeup source might abort suspend.
+ * @cpu_time_start: Busy time of all the CPUs when the source was activated.
+ * @cpu_time: CPU time used while the wakeup source was active, in ns.
  * @active: Status of the wakeup source.
  * @has_timeout: The wakeup source has been activated with a timeout.
  */
@@ -68,10 +72,18 @@ struct wakeup_source {
 	unsigned long		relax_count;
 	unsigned long		expire_count;
 	unsigned long		wakeup_count;
-	bool			active:1;
+	atomic_long_t		nolock_event_count;
+	u64			cpu_time_start;
+	u64			cpu_time;
+	bool			active;
 	bool			autosleep_enabled:1;
 };
 
+static inline unsigned long wakeup_source_event_count(struct wakeup_source *ws)
+{
+	return ws->event_count + atomic_long_read(&ws->nolock_event_count);
+}
+
 #ifdef CONFIG_PM_SLEEP
 
 /*
@@ -194,6 +194,9 @@ struct pstore_info {
 #define PSTORE_FLAGS_FTRACE	(1 << 2)
 #define PSTORE_FLAGS_PMSG	(1 << 3)
 
+/* @write_user can be called concurrently for PMSG */
+#define PSTORE_FLAGS_PMSG_NO_LOCK	(1 << 4)
+
 extern int pstore_register(struct pstore_info *);
 extern void pstore_unregister(struct pstore_info *);
 extern bool pstore_cannot_block_path(enum kmsg_dump_reason reason);
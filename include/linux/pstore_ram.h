@@ -26,10 +26,16 @@
 
 /*
  * Choose whether access to the RAM zone requires locking or not.  If a zone
- * can be written to from different CPUs like with ftrace for example, then
- * PRZ_FLAG_NO_LOCK is used. For all other cases, locking is required.
+ * is only written to from one CPU, like the per-CPU ftrace and pmsg zones,
+ * then PRZ_FLAG_NO_LOCK is used and space is reserved with atomics. For all
+ * other cases, locking is required.
  */
 #define PRZ_FLAG_NO_LOCK	BIT(0)
+/*
+ * Only compute the ECC of a block once it is full instead of on every
+ * write.  The block being written is covered after persistent_ram_flush_ecc().
+ */
+#define PRZ_FLAG_DEFER_ECC	BIT(1)
 
 struct persistent_ram_buffer;
 struct rs_control;
@@ -72,6 +78,7 @@ int persistent_ram_write(struct persistent_ram_zone *prz, const void *s,
 			 unsigned int count);
 int persistent_ram_write_user(struct persistent_ram_zone *prz,
 			      const void __user *s, unsigned int count);
+void persistent_ram_flush_ecc(struct persistent_ram_zone *prz);
 
 void persistent_ram_save_old(struct persistent_ram_zone *prz);
 size_t persistent_ram_old_size(struct persistent_ram_zone *prz);
@@ -89,6 +96,7 @@ void ramoops_console_write_buf(const char *buf, size_t size);
  */
 
 #define RAMOOPS_FLAG_FTRACE_PER_CPU	BIT(0)
+#define RAMOOPS_FLAG_PMSG_PER_CPU	BIT(1)
 
 struct ramoops_platform_data {
 	unsigned long	mem_size;
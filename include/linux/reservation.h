@@ -261,6 +261,11 @@ long reservation_object_wait_timeout_rcu(struct reservation_object *obj,
 					 bool wait_all, bool intr,
 					 unsigned long timeout);
 
+long reservation_object_wait_timeout_multi_rcu(struct reservation_object **objs,
+					       unsigned int num_objs,
+					       bool wait_all, bool intr,
+					       unsigned long timeout);
+
 bool reservation_object_test_signaled_rcu(struct reservation_object *obj,
 					  bool test_all);
 
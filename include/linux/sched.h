@@ -414,6 +414,7 @@ struct sched_statistics {
 
 #ifdef CONFIG_SCHED_WALT
 #define RAVG_HIST_SIZE_MAX  5
+#define NUM_BUSY_BUCKETS  10
 
 /* ravg represents frequency scaled cpu-demand of tasks */
 struct ravg {
@@ -438,12 +439,20 @@ struct ravg {
 	 *
 	 * 'prev_window' represents task's contribution to cpu busy time
 	 * statistics (rq->prev_runnable_sum) in previous window
+	 *
+	 * 'pred_demand' represents task's predicted cpu busy time in the
+	 * current window, from the busy time seen in its past windows
+	 *
+	 * 'busy_buckets' groups the past busy times of the task into
+	 * NUM_BUSY_BUCKETS buckets, weighing how often each was recently seen
 	 */
 	u64 mark_start;
 	u32 sum, demand;
 	u32 sum_history[RAVG_HIST_SIZE_MAX];
 	u32 curr_window, prev_window;
 	u16 active_windows;
+	u32 pred_demand;
+	u8 busy_buckets[NUM_BUSY_BUCKETS];
 };
 #endif
 
@@ -642,6 +651,11 @@ struct task_struct {
 	 * of this task
 	 */
 	u32 init_load_pct;
+	/*
+	 * 'grp' is the group of related tasks this task works with, whose
+	 * demand it is placed and clocked for as a whole
+	 */
+	struct related_thread_group *grp;
 #endif
 
 #ifdef CONFIG_CGROUP_SCHED
@@ -968,6 +982,14 @@ struct task_struct {
 	siginfo_t			*last_siginfo;
 
 	struct task_io_accounting	ioac;
+#ifdef CONFIG_UID_SYS_STATS
+	/*
+	 * I/O already added to the per-UID stats, only valid when
+	 * uid_ioac_task points back to this task (it is copied on fork):
+	 */
+	struct task_io_accounting	uid_ioac;
+	struct task_struct		*uid_ioac_task;
+#endif
 #ifdef CONFIG_TASK_XACCT
 	/* Accumulated RSS usage: */
 	u64				acct_rss_mem1;
@@ -1126,6 +1148,9 @@ struct task_struct {
 
 	/* Bitmask and counter of trace recursion: */
 	unsigned long			trace_recursion;
+
+	/* Frame the task works on, see <linux/frame_trace.h>: */
+	u64				frame_id;
 #endif /* CONFIG_TRACING */
 
 #ifdef CONFIG_KCOV
@@ -1197,6 +1222,15 @@ struct task_struct {
 	 */
 };
 
+#ifdef CONFIG_CGROUP_TIMER_SLACK
+extern u64 task_get_effective_timer_slack(struct task_struct *tsk);
+#else
+static inline u64 task_get_effective_timer_slack(struct task_struct *tsk)
+{
+	return tsk->timer_slack_ns;
+}
+#endif
+
 static inline struct pid *task_pid(struct task_struct *task)
 {
 	return task->pids[PIDTYPE_PID].pid;
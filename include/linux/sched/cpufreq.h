@@ -11,6 +11,7 @@
 #define SCHED_CPUFREQ_RT	(1U << 0)
 #define SCHED_CPUFREQ_DL	(1U << 1)
 #define SCHED_CPUFREQ_IOWAIT	(1U << 2)
+#define SCHED_CPUFREQ_BOOST	(1U << 3)
 
 #define SCHED_CPUFREQ_RT_DL	(SCHED_CPUFREQ_RT | SCHED_CPUFREQ_DL)
 
@@ -23,6 +24,18 @@ void cpufreq_add_update_util_hook(int cpu, struct update_util_data *data,
                        void (*func)(struct update_util_data *data, u64 time,
 				    unsigned int flags));
 void cpufreq_remove_update_util_hook(int cpu);
+
+unsigned long cpufreq_get_sched_util(int cpu, unsigned long *max);
+bool cpufreq_sched_util_invariant(void);
 #endif /* CONFIG_CPU_FREQ */
 
+#ifdef CONFIG_CGROUP_SCHEDTUNE
+int schedtune_cpufreq_boost(int cpu);
+#else
+static inline int schedtune_cpufreq_boost(int cpu)
+{
+	return 0;
+}
+#endif
+
 #endif /* _LINUX_SCHED_CPUFREQ_H */
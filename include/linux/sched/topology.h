@@ -84,11 +84,20 @@ struct idle_state {
 	unsigned long power;	 /* power consumption in this idle state */
 };
 
+/* Granularity of sched_group_energy::cap_idx_lut */
+#define SGE_CAP_LUT_SHIFT	4
+#define SGE_CAP_LUT_SIZE	((SCHED_CAPACITY_SCALE >> SGE_CAP_LUT_SHIFT) + 1)
+
 struct sched_group_energy {
 	unsigned int nr_idle_states;	/* number of idle states */
 	struct idle_state *idle_states;	/* ptr to idle state array */
 	unsigned int nr_cap_states;	/* number of capacity states */
 	struct capacity_state *cap_states; /* ptr to capacity state array */
+	/*
+	 * First capacity state that may fit a utilization, indexed by
+	 * util >> SGE_CAP_LUT_SHIFT; optional.
+	 */
+	const u8 *cap_idx_lut;
 };
 
 unsigned long capacity_curr_of(int cpu);
@@ -180,6 +180,7 @@ struct thermal_attr {
  *			drivers should use thermal_zone_get_temp() to get the
  *			current temperature
  * @last_temperature:	previous temperature read
+ * @poll_delay:		the delay of the poll that read @temperature, in ms
  * @emul_temperature:	emulated temperature when using CONFIG_THERMAL_EMULATION
  * @passive:		1 if you've crossed a passive trip point, 0 otherwise.
  * @prev_low_trip:	the low current temperature if you've crossed a passive
@@ -217,6 +218,7 @@ struct thermal_zone_device {
 	int polling_delay;
 	int temperature;
 	int last_temperature;
+	int poll_delay;
 	int emul_temperature;
 	int passive;
 	int prev_low_trip;
@@ -341,6 +343,13 @@ struct thermal_zone_params {
 	 * 		Used by thermal zone drivers (default 0).
 	 */
 	int offset;
+
+	/*
+	 * @adaptive_polling:	scale the polling and passive delays with the
+	 *			rate the temperature rises towards the next
+	 *			trip point (default false).
+	 */
+	bool adaptive_polling;
 };
 
 struct thermal_genl_event {
@@ -0,0 +1,23 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _LINUX_UID_SYS_STATS_H
+#define _LINUX_UID_SYS_STATS_H
+
+#include <linux/types.h>
+
+struct task_struct;
+
+#ifdef CONFIG_UID_SYS_STATS
+/*
+ * Called by the scheduler for the cpu time accounted to @p, with
+ * interrupts disabled.
+ */
+extern void uid_sys_stats_account(struct task_struct *p, u64 cputime,
+				  bool user);
+#else
+static inline void uid_sys_stats_account(struct task_struct *p, u64 cputime,
+					 bool user)
+{
+}
+#endif
+
+#endif /* _LINUX_UID_SYS_STATS_H */
@@ -58,6 +58,25 @@ int virtqueue_add_sgs(struct virtqueue *vq,
 		      void *data,
 		      gfp_t gfp);
 
+/**
+ * virtqueue_buf - a buffer for virtqueue_add_bufs()
+ * @sgs: array of terminated scatterlists.
+ * @out_sgs: the number of scatterlists readable by other side
+ * @in_sgs: the number of scatterlists which are writable (after readable ones)
+ * @data: the token identifying the buffer.
+ */
+struct virtqueue_buf {
+	struct scatterlist **sgs;
+	unsigned int out_sgs;
+	unsigned int in_sgs;
+	void *data;
+};
+
+int virtqueue_add_bufs(struct virtqueue *vq,
+		       const struct virtqueue_buf *bufs,
+		       unsigned int num,
+		       gfp_t gfp);
+
 bool virtqueue_kick(struct virtqueue *vq);
 
 bool virtqueue_kick_prepare(struct virtqueue *vq);
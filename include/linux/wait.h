@@ -490,7 +490,7 @@ do {										\
 	hrtimer_init_sleeper(&__t, current);					\
 	if ((timeout) != KTIME_MAX)						\
 		hrtimer_start_range_ns(&__t.timer, timeout,			\
-				       current->timer_slack_ns,			\
+				       task_get_effective_timer_slack(current),	\
 				       HRTIMER_MODE_REL);			\
 										\
 	__ret = ___wait_event(wq_head, condition, state, 0, 0,			\
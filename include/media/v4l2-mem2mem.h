@@ -88,6 +88,7 @@ struct v4l2_m2m_queue_ctx {
  * @queue: List of memory to memory contexts
  * @job_flags: Job queue flags, used internally by v4l2-mem2mem.c:
  *		%TRANS_QUEUED, %TRANS_RUNNING and %TRANS_ABORT.
+ * @slot: Hardware instance the job of the context runs on
  * @finished: Wait queue used to signalize when a job queue finished.
  * @priv: Instance private data
  *
@@ -109,6 +110,7 @@ struct v4l2_m2m_ctx {
 	struct list_head		queue;
 	unsigned long			job_flags;
 	wait_queue_head_t		finished;
+	unsigned int			slot;
 
 	void				*priv;
 };
@@ -124,14 +126,50 @@ struct v4l2_m2m_buffer {
 	struct list_head	list;
 };
 
+/**
+ * struct v4l2_m2m_slot_stats - utilization of a hardware instance
+ *
+ * @jobs: number of jobs that finished on the instance
+ * @busy_ns: time spent running jobs, in nanoseconds
+ */
+struct v4l2_m2m_slot_stats {
+	u64			jobs;
+	u64			busy_ns;
+};
+
 /**
  * v4l2_m2m_get_curr_priv() - return driver private data for the currently
  * running instance or NULL if no instance is running
  *
  * @m2m_dev: opaque pointer to the internal data to handle M2M context
+ *
+ * For devices with several slots, this is the instance running on slot 0.
  */
 void *v4l2_m2m_get_curr_priv(struct v4l2_m2m_dev *m2m_dev);
 
+/**
+ * v4l2_m2m_get_slot() - return the slot the job of an instance runs on
+ *
+ * @m2m_ctx: m2m context assigned to the instance given by struct &v4l2_m2m_ctx
+ *
+ * Valid from &v4l2_m2m_ops->device_run until v4l2_m2m_job_finish(), so
+ * that devices with several hardware instances know which one to program.
+ */
+static inline unsigned int v4l2_m2m_get_slot(struct v4l2_m2m_ctx *m2m_ctx)
+{
+	return m2m_ctx->slot;
+}
+
+/**
+ * v4l2_m2m_get_slot_stats() - return the utilization of a slot
+ *
+ * @m2m_dev: opaque pointer to the internal data to handle M2M context
+ * @slot: slot number, below the number given to v4l2_m2m_init_slots()
+ * @stats: filled with the statistics of @slot, including the running job
+ */
+int v4l2_m2m_get_slot_stats(struct v4l2_m2m_dev *m2m_dev, unsigned int slot,
+			    struct v4l2_m2m_slot_stats *stats);
+
 /**
  * v4l2_m2m_get_vq() - return vb2_queue for the given type
  *
@@ -328,6 +366,22 @@ int v4l2_m2m_mmap(struct file *file, struct v4l2_m2m_ctx *m2m_ctx,
  */
 struct v4l2_m2m_dev *v4l2_m2m_init(const struct v4l2_m2m_ops *m2m_ops);
 
+/**
+ * v4l2_m2m_init_slots() - initialize per-driver m2m data for a device that
+ * runs several jobs at once
+ *
+ * @m2m_ops: pointer to struct v4l2_m2m_ops
+ * @num_slots: number of hardware instances of the device
+ *
+ * Like v4l2_m2m_init(), but &v4l2_m2m_ops->device_run may be called for up
+ * to @num_slots instances before any job finishes.  The driver finds the
+ * hardware instance to use with v4l2_m2m_get_slot().
+ *
+ * Return: returns an opaque pointer to the internal data to handle M2M context
+ */
+struct v4l2_m2m_dev *v4l2_m2m_init_slots(const struct v4l2_m2m_ops *m2m_ops,
+					 unsigned int num_slots);
+
 /**
  * v4l2_m2m_release() - cleans up and frees a m2m_dev structure
  *
@@ -500,6 +500,9 @@ struct vb2_buf_ops {
  *		when a buffer with the V4L2_BUF_FLAG_LAST is dequeued.
  * @fileio:	file io emulator internal data, used only if emulator is active
  * @threadio:	thread io internal data, used only if thread is active
+ * @dmabuf_cache: DMABUF attachments no plane uses any more, most recently
+ *		released first, kept for when their dma_buf is queued again
+ * @dmabuf_cache_count: number of entries in @dmabuf_cache
  */
 struct vb2_queue {
 	unsigned int			type;
@@ -554,6 +557,9 @@ struct vb2_queue {
 	struct vb2_fileio_data		*fileio;
 	struct vb2_threadio_data	*threadio;
 
+	struct list_head		dmabuf_cache;
+	unsigned int			dmabuf_cache_count;
+
 #ifdef CONFIG_VIDEO_ADV_DEBUG
 	/*
 	 * Counters for how often these queue-related ops are
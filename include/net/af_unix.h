@@ -8,10 +8,13 @@
 #include <linux/refcount.h>
 #include <net/sock.h>
 
+struct seq_file;
+
 void unix_inflight(struct user_struct *user, struct file *fp);
 void unix_notinflight(struct user_struct *user, struct file *fp);
 void unix_gc(void);
 void wait_for_unix_gc(void);
+int unix_gc_stats_show(struct seq_file *seq, void *v);
 struct sock *unix_get_socket(struct file *filp);
 struct sock *unix_peer_get(struct sock *);
 
@@ -64,6 +67,8 @@ struct unix_sock {
 #define UNIX_GC_MAYBE_CYCLE	1
 	struct socket_wq	peer_wq;
 	wait_queue_entry_t		peer_wake;
+	/* Datagrams taken off sk_receive_queue but not yet read */
+	struct sk_buff_head	rx_batch;
 };
 
 static inline struct unix_sock *unix_sk(const struct sock *sk)
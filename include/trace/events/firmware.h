@@ -0,0 +1,54 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM firmware
+
+#if !defined(_TRACE_FIRMWARE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_FIRMWARE_H
+
+#include <linux/device.h>
+#include <linux/tracepoint.h>
+
+/**
+ * firmware_request - called when a firmware request completes
+ *
+ * @dev: device the firmware is for, may be NULL
+ * @name: name of the firmware image
+ * @size: size of the image, 0 on failure
+ * @ret: result of the request
+ * @cached: the image was built in or already in memory
+ * @duration_us: time the request took, in microseconds
+ */
+TRACE_EVENT(firmware_request,
+
+	TP_PROTO(struct device *dev, const char *name, size_t size, int ret,
+		 bool cached, s64 duration_us),
+
+	TP_ARGS(dev, name, size, ret, cached, duration_us),
+
+	TP_STRUCT__entry(
+		__string(dev, dev ? dev_name(dev) : "")
+		__string(name, name)
+		__field(size_t, size)
+		__field(int, ret)
+		__field(bool, cached)
+		__field(s64, duration_us)
+	),
+
+	TP_fast_assign(
+		__assign_str(dev, dev ? dev_name(dev) : "");
+		__assign_str(name, name);
+		__entry->size = size;
+		__entry->ret = ret;
+		__entry->cached = cached;
+		__entry->duration_us = duration_us;
+	),
+
+	TP_printk("dev=%s name=%s size=%zu ret=%d cached=%d duration_us=%lld",
+		  __get_str(dev), __get_str(name), __entry->size, __entry->ret,
+		  __entry->cached, __entry->duration_us)
+);
+
+#endif /* _TRACE_FIRMWARE_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
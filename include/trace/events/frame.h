@@ -0,0 +1,55 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM frame
+
+#if !defined(_TRACE_FRAME_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_FRAME_H
+
+#include <linux/frame_trace.h>
+#include <linux/tracepoint.h>
+
+#define show_frame_stage(stage)						\
+	__print_symbolic(stage,						\
+		{ FRAME_STAGE_BINDER_SEND,	"binder_send" },	\
+		{ FRAME_STAGE_BINDER_RECV,	"binder_recv" },	\
+		{ FRAME_STAGE_FENCE_EXPORT,	"fence_export" },	\
+		{ FRAME_STAGE_GPU_SUBMIT,	"gpu_submit" },		\
+		{ FRAME_STAGE_FENCE_SIGNAL,	"fence_signal" },	\
+		{ FRAME_STAGE_COMMIT,		"commit" },		\
+		{ FRAME_STAGE_FLIP,		"flip" },		\
+		{ FRAME_STAGE_VBLANK,		"vblank" })
+
+/**
+ * frame_stage - called when the work of a frame reaches a stage
+ *
+ * @frame_id: the frame, events for untagged work (0) are not recorded
+ * @stage: the stage reached, see enum frame_stage
+ *
+ * The event timestamps give the stage timings of the frame.
+ */
+TRACE_EVENT_CONDITION(frame_stage,
+
+	TP_PROTO(u64 frame_id, enum frame_stage stage),
+
+	TP_ARGS(frame_id, stage),
+
+	TP_CONDITION(frame_id),
+
+	TP_STRUCT__entry(
+		__field(u64, frame_id)
+		__field(int, stage)
+	),
+
+	TP_fast_assign(
+		__entry->frame_id = frame_id;
+		__entry->stage = stage;
+	),
+
+	TP_printk("frame=%llu stage=%s", __entry->frame_id,
+		  show_frame_stage(__entry->stage))
+);
+
+#endif /* _TRACE_FRAME_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -0,0 +1,52 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM lock_sample
+
+#if !defined(_TRACE_LOCK_SAMPLE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_LOCK_SAMPLE_H
+
+#include <linux/tracepoint.h>
+
+#define LOCK_SAMPLE_MUTEX	0
+#define LOCK_SAMPLE_RWSEM_READ	1
+#define LOCK_SAMPLE_RWSEM_WRITE	2
+#define LOCK_SAMPLE_SPIN	3
+
+/*
+ * One in lock_sample.interval contended acquisitions of a sleeping lock
+ * or a queued spinlock, with the time spent waiting for it.  Add the
+ * "stacktrace" trigger to the event for the full call site.
+ */
+TRACE_EVENT(lock_contention_sample,
+
+	TP_PROTO(void *lock, unsigned long ip, u64 wait_ns, int type),
+
+	TP_ARGS(lock, ip, wait_ns, type),
+
+	TP_STRUCT__entry(
+		__field(void *,		lock)
+		__field(unsigned long,	ip)
+		__field(u64,		wait_ns)
+		__field(int,		type)
+	),
+
+	TP_fast_assign(
+		__entry->lock = lock;
+		__entry->ip = ip;
+		__entry->wait_ns = wait_ns;
+		__entry->type = type;
+	),
+
+	TP_printk("%s lock=%p caller=%pS wait_ns=%llu",
+		  __print_symbolic(__entry->type,
+				   { LOCK_SAMPLE_MUTEX,		"mutex" },
+				   { LOCK_SAMPLE_RWSEM_READ,	"rwsem_read" },
+				   { LOCK_SAMPLE_RWSEM_WRITE,	"rwsem_write" },
+				   { LOCK_SAMPLE_SPIN,		"spinlock" }),
+		  __entry->lock, (void *)__entry->ip, __entry->wait_ns)
+);
+
+#endif /* _TRACE_LOCK_SAMPLE_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
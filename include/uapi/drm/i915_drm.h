@@ -262,6 +262,8 @@ typedef struct _drm_i915_sarea {
 #define DRM_I915_PERF_OPEN		0x36
 #define DRM_I915_PERF_ADD_CONFIG	0x37
 #define DRM_I915_PERF_REMOVE_CONFIG	0x38
+#define DRM_I915_GEM_BO_LIST_CREATE	0x39
+#define DRM_I915_GEM_BO_LIST_DESTROY	0x3a
 
 #define DRM_IOCTL_I915_INIT		DRM_IOW( DRM_COMMAND_BASE + DRM_I915_INIT, drm_i915_init_t)
 #define DRM_IOCTL_I915_FLUSH		DRM_IO ( DRM_COMMAND_BASE + DRM_I915_FLUSH)
@@ -319,6 +321,8 @@ typedef struct _drm_i915_sarea {
 #define DRM_IOCTL_I915_PERF_OPEN	DRM_IOW(DRM_COMMAND_BASE + DRM_I915_PERF_OPEN, struct drm_i915_perf_open_param)
 #define DRM_IOCTL_I915_PERF_ADD_CONFIG	DRM_IOW(DRM_COMMAND_BASE + DRM_I915_PERF_ADD_CONFIG, struct drm_i915_perf_oa_config)
 #define DRM_IOCTL_I915_PERF_REMOVE_CONFIG	DRM_IOW(DRM_COMMAND_BASE + DRM_I915_PERF_REMOVE_CONFIG, __u64)
+#define DRM_IOCTL_I915_GEM_BO_LIST_CREATE	DRM_IOWR(DRM_COMMAND_BASE + DRM_I915_GEM_BO_LIST_CREATE, struct drm_i915_gem_bo_list_create)
+#define DRM_IOCTL_I915_GEM_BO_LIST_DESTROY	DRM_IOW(DRM_COMMAND_BASE + DRM_I915_GEM_BO_LIST_DESTROY, struct drm_i915_gem_bo_list_destroy)
 
 /* Allow drivers to submit batchbuffers directly to hardware, relying
  * on the security mechanisms provided by hardware.
@@ -440,6 +444,12 @@ typedef struct drm_i915_irq_wait {
  */
 #define I915_PARAM_HAS_EXEC_FENCE_ARRAY  49
 
+/* Query whether DRM_I915_GEM_EXECBUFFER2 supports submitting a BO list
+ * previously registered with DRM_I915_GEM_BO_LIST_CREATE.  See
+ * I915_EXEC_BO_LIST.
+ */
+#define I915_PARAM_HAS_EXEC_BO_LIST	 50
+
 typedef struct drm_i915_getparam {
 	__s32 param;
 	/*
@@ -959,7 +969,15 @@ struct drm_i915_gem_execbuffer2 {
  */
 #define I915_EXEC_FENCE_ARRAY   (1<<19)
 
-#define __I915_EXEC_UNKNOWN_FLAGS (-(I915_EXEC_FENCE_ARRAY<<1))
+/* Setting I915_EXEC_BO_LIST tells execbuf to use the execobject[] stored in
+ * the BO list identified by DR1 (created on the same context with
+ * DRM_I915_GEM_BO_LIST_CREATE) instead of reading it from buffers_ptr, which
+ * must be zero. buffer_count must match the number of objects in the list.
+ * Updated object offsets are written back to the list, and not to userspace.
+ */
+#define I915_EXEC_BO_LIST		(1<<20)
+
+#define __I915_EXEC_UNKNOWN_FLAGS (-(I915_EXEC_BO_LIST<<1))
 
 #define I915_EXEC_CONTEXT_ID_MASK	(0xffffffff)
 #define i915_execbuffer2_set_context_id(eb2, context) \
@@ -1301,6 +1319,33 @@ struct drm_i915_gem_context_destroy {
 	__u32 pad;
 };
 
+/*
+ * A BO list is a copy of an execobject[] array registered once on a context
+ * and then referenced by id from execbuf with I915_EXEC_BO_LIST. The kernel
+ * keeps the handles resolved to their vma for as long as none of the objects
+ * on the context are closed, so repeated submissions of the same set of
+ * buffers skip the per-call handle lookup.
+ */
+struct drm_i915_gem_bo_list_create {
+	/** Context on which the list is to be used */
+	__u32 ctx_id;
+
+	/** Number of drm_i915_gem_exec_object2 in buffers_ptr */
+	__u32 buffer_count;
+
+	/** Pointer to struct drm_i915_gem_exec_object2[buffer_count] */
+	__u64 buffers_ptr;
+
+	/** Output: id to pass in drm_i915_gem_execbuffer2.DR1 */
+	__u32 list_id;
+	__u32 pad;
+};
+
+struct drm_i915_gem_bo_list_destroy {
+	__u32 ctx_id;
+	__u32 list_id;
+};
+
 struct drm_i915_reg_read {
 	/*
 	 * Register offset.
@@ -1413,6 +1458,18 @@ enum drm_i915_perf_property_id {
 	 */
 	DRM_I915_PERF_PROP_OA_EXPONENT,
 
+	/**
+	 * A value of 1 requests that the OA buffer be exported to userspace
+	 * via mmap() of the stream fd instead of copying reports via read().
+	 *
+	 * Only supported for system-wide streams. The mapping must be
+	 * read-only, start at offset 0 and cover one page holding a
+	 * &struct drm_i915_perf_oa_buffer_status followed by the OA buffer
+	 * itself (&drm_i915_perf_oa_buffer_status.size bytes). Raw reports are
+	 * exposed as written by the OA unit; read() is not supported.
+	 */
+	DRM_I915_PERF_PROP_OA_BUFFER_MMAP,
+
 	DRM_I915_PERF_PROP_MAX /* non-ABI */
 };
 
@@ -1499,6 +1556,32 @@ enum drm_i915_perf_record_type {
 	DRM_I915_PERF_RECORD_MAX /* non-ABI */
 };
 
+/**
+ * Status page at the start of a DRM_I915_PERF_PROP_OA_BUFFER_MMAP mapping.
+ *
+ * The kernel periodically publishes the offset up to which the OA buffer
+ * holds complete reports (@tail) and the total number of bytes published
+ * since the stream was opened (@total). Reports are kept in a ring of @size
+ * bytes: the bytes published since the reader last sampled @total end at
+ * @tail. If more than @size bytes have been published the reader has been
+ * lapped and the oldest data is lost. @resets counts reinitializations of
+ * the OA buffer (e.g. I915_PERF_IOCTL_ENABLE), after which @tail restarts
+ * at 0 and any data read before it must be discarded.
+ *
+ * Fields are updated while @seqno is odd; readers should sample @seqno
+ * before and after reading the other fields and retry if it changed or
+ * was odd.
+ */
+struct drm_i915_perf_oa_buffer_status {
+	__u32 seqno;
+	__u32 size;
+	__u32 report_size;
+	__u32 tail;
+	__u64 total;
+	__u32 resets;
+	__u32 pad;
+};
+
 /**
  * Structure to upload perf dynamic configuration into the kernel.
  */
@@ -36,6 +36,7 @@ enum {
 	BINDER_TYPE_FD		= B_PACK_CHARS('f', 'd', '*', B_TYPE_LARGE),
 	BINDER_TYPE_FDA		= B_PACK_CHARS('f', 'd', 'a', B_TYPE_LARGE),
 	BINDER_TYPE_PTR		= B_PACK_CHARS('p', 't', '*', B_TYPE_LARGE),
+	BINDER_TYPE_PAGES	= B_PACK_CHARS('p', 'g', '*', B_TYPE_LARGE),
 };
 
 /**
@@ -178,6 +179,18 @@ enum {
 	BINDER_BUFFER_FLAG_HAS_PARENT = 0x01,
 };
 
+/*
+ * A struct binder_buffer_object with hdr.type set to BINDER_TYPE_PAGES
+ * describes page-aligned sender memory (@buffer and @length must both be
+ * multiples of the page size) that is mapped read-only into the
+ * receiver's buffer instead of being copied. The pages are shared with
+ * the sender until the receiver frees the transaction buffer, so the
+ * sender must not modify them until then. Such a buffer can have a
+ * parent, but cannot itself be the parent of another object. Each one
+ * takes up @length bytes of the extra buffers area plus up to a page of
+ * alignment padding.
+ */
+
 /* struct binder_fd_array_object - object describing an array of fds in a buffer
  * @hdr:		common header structure
  * @pad:		padding to ensure correct alignment
@@ -247,6 +260,11 @@ struct binder_node_debug_info {
 	__u32            has_weak_ref;
 };
 
+/*
+ * BINDER_SET_IDLE_TIMEOUT takes a timeout in nanoseconds. Looper threads
+ * started in response to BR_SPAWN_LOOPER that wait for work longer than
+ * this get -ETIMEDOUT from BINDER_WRITE_READ and are expected to exit.
+ */
 #define BINDER_WRITE_READ		_IOWR('b', 1, struct binder_write_read)
 #define BINDER_SET_IDLE_TIMEOUT		_IOW('b', 3, __s64)
 #define BINDER_SET_MAX_THREADS		_IOW('b', 5, __u32)
@@ -255,6 +273,7 @@ struct binder_node_debug_info {
 #define BINDER_THREAD_EXIT		_IOW('b', 8, __s32)
 #define BINDER_VERSION			_IOWR('b', 9, struct binder_version)
 #define BINDER_GET_NODE_DEBUG_INFO	_IOWR('b', 11, struct binder_node_debug_info)
+#define BINDER_SET_FRAME_ID		_IOW('b', 14, __u64)
 
 /*
  * NOTE: Two special error codes you should check for when calling
@@ -318,6 +337,21 @@ struct binder_transaction_data_sg {
 	binder_size_t buffers_size;
 };
 
+/* struct binder_transaction_batch - header for BC_TRANSACTION_BATCH
+ * @count:		number of entries in @transactions
+ * @transactions:	user pointer to an array of binder_transaction_data
+ *
+ * All entries must be one-way transactions to the same target handle.
+ * They are delivered in array order; each one completes with its own
+ * BR_TRANSACTION_COMPLETE, and processing stops at the first failure.
+ */
+struct binder_transaction_batch {
+	binder_size_t		count;
+	binder_uintptr_t	transactions;
+};
+
+#define BINDER_TRANSACTION_BATCH_MAX	256
+
 struct binder_ptr_cookie {
 	binder_uintptr_t ptr;
 	binder_uintptr_t cookie;
@@ -508,6 +542,12 @@ enum binder_driver_command_protocol {
 	/*
 	 * binder_transaction_data_sg: the sent command.
 	 */
+
+	BC_TRANSACTION_BATCH = _IOW('c', 19, struct binder_transaction_batch),
+	/*
+	 * binder_transaction_batch: array of one-way transactions to a
+	 * single target.
+	 */
 };
 
 #endif /* _UAPI_LINUX_BINDER_H */
@@ -93,6 +93,8 @@ enum bpf_cmd {
 	BPF_PROG_GET_FD_BY_ID,
 	BPF_MAP_GET_FD_BY_ID,
 	BPF_OBJ_GET_INFO_BY_FD,
+	BPF_MAP_LOOKUP_BATCH,
+	BPF_MAP_LOOKUP_AND_DELETE_BATCH,
 };
 
 enum bpf_map_type {
@@ -201,6 +203,22 @@ union bpf_attr {
 		__u64		flags;
 	};
 
+	struct { /* struct used by BPF_MAP_*_BATCH commands */
+		__aligned_u64	in_batch;	/* start batch, NULL to start
+						 * from the beginning
+						 */
+		__aligned_u64	out_batch;	/* output: next start batch */
+		__aligned_u64	keys;
+		__aligned_u64	values;
+		__u32		count;		/* input: # of keys and values
+						 * room in the buffers
+						 * output: # of elements copied
+						 */
+		__u32		map_fd;
+		__u64		elem_flags;
+		__u64		flags;
+	} batch;
+
 	struct { /* anonymous struct used by BPF_PROG_LOAD command */
 		__u32		prog_type;	/* one of enum bpf_prog_type */
 		__u32		insn_cnt;
@@ -542,7 +560,9 @@ union bpf_attr {
  *     field is missing inside sk_buff
  *
  * u32 bpf_get_socket_uid(skb)
- *     Get the owner uid of the socket stored inside sk_buff.
+ *     Get the owner uid of the socket stored inside sk_buff.  Together
+ *     with a BPF_MAP_TYPE_PERCPU_HASH map, this lets a
+ *     BPF_PROG_TYPE_CGROUP_SKB program account traffic per uid.
  *     @skb: pointer to skb
  *     Return: uid of the socket owner on success or overflowuid if failed.
  *
@@ -801,6 +821,8 @@ struct bpf_prog_info {
 	__u32 xlated_prog_len;
 	__aligned_u64 jited_prog_insns;
 	__aligned_u64 xlated_prog_insns;
+	__u64 run_time_ns;	/* only counted with kernel.bpf_stats_enabled */
+	__u64 run_cnt;
 } __attribute__((aligned(8)));
 
 struct bpf_map_info {
@@ -216,10 +216,13 @@ struct fuse_file_lock {
  * FOPEN_DIRECT_IO: bypass page cache for this open file
  * FOPEN_KEEP_CACHE: don't invalidate the data cache on open
  * FOPEN_NONSEEKABLE: the file is not seekable
+ * FOPEN_PASSTHROUGH: read, write and mmap go to the backing file
+ *		      registered as passthrough_fh
  */
 #define FOPEN_DIRECT_IO		(1 << 0)
 #define FOPEN_KEEP_CACHE	(1 << 1)
 #define FOPEN_NONSEEKABLE	(1 << 2)
+#define FOPEN_PASSTHROUGH	(1 << 3)
 
 /**
  * INIT request/reply flags
@@ -245,6 +248,7 @@ struct fuse_file_lock {
  * FUSE_PARALLEL_DIROPS: allow parallel lookups and readdir
  * FUSE_HANDLE_KILLPRIV: fs handles killing suid/sgid/cap on write/chown/trunc
  * FUSE_POSIX_ACL: filesystem supports posix acls
+ * FUSE_PASSTHROUGH: kernel supports FOPEN_PASSTHROUGH backing files
  */
 #define FUSE_ASYNC_READ		(1 << 0)
 #define FUSE_POSIX_LOCKS	(1 << 1)
@@ -267,6 +271,7 @@ struct fuse_file_lock {
 #define FUSE_PARALLEL_DIROPS    (1 << 18)
 #define FUSE_HANDLE_KILLPRIV	(1 << 19)
 #define FUSE_POSIX_ACL		(1 << 20)
+#define FUSE_PASSTHROUGH	(1 << 21)
 
 /**
  * CUSE INIT request/reply flags
@@ -499,7 +504,7 @@ struct fuse_create_in {
 struct fuse_open_out {
 	uint64_t	fh;
 	uint32_t	open_flags;
-	uint32_t	padding;
+	uint32_t	passthrough_fh;
 };
 
 struct fuse_release_in {
@@ -776,6 +781,64 @@ struct fuse_notify_retrieve_in {
 
 /* Device ioctls: */
 #define FUSE_DEV_IOC_CLONE	_IOR(229, 0, uint32_t)
+#define FUSE_DEV_IOC_RING_SETUP	_IOWR(229, 1, struct fuse_ring_params)
+#define FUSE_DEV_IOC_RING_ENTER	_IOW(229, 2, uint32_t)
+#define FUSE_DEV_IOC_PASSTHROUGH_OPEN	_IOW(229, 3, uint32_t)
+
+/*
+ * Passthrough
+ *
+ * FUSE_DEV_IOC_PASSTHROUGH_OPEN takes a file descriptor open on a
+ * backing file and returns an identifier for it.  Replying to OPEN or
+ * CREATE with FOPEN_PASSTHROUGH and that identifier in passthrough_fh
+ * makes the kernel serve read, write and mmap on the new fuse file
+ * from the backing file, with the credentials of the caller of the
+ * ioctl.  Each identifier can be used by one open reply.
+ */
+
+/*
+ * Shared request ring
+ *
+ * FUSE_DEV_IOC_RING_SETUP allocates a ring of 'entries' slots of
+ * 'entry_size' bytes each for a device fd, to be mmap'd at offset zero
+ * with length 'ring_size'.  The mapping starts with struct
+ * fuse_ring_header, followed by the submission and completion index
+ * arrays of 'entries' slot numbers each; the slots start at
+ * 'slot_offset'.
+ *
+ * The kernel fills slots with requests, laid out exactly as read() on
+ * the device would return them, and publishes their numbers on the
+ * submission queue.  The daemon writes each reply into the slot of its
+ * request, laid out as it would be passed to write(), and publishes the
+ * slot number on the completion queue.  Every slot handed out must be
+ * completed; a reply header with len == 0 returns a slot without
+ * replying, e.g. for FUSE_FORGET.
+ *
+ * FUSE_DEV_IOC_RING_ENTER consumes the completion queue and refills
+ * the submission queue in one call; with FUSE_RING_ENTER_GETEVENTS it
+ * waits for at least one request.  Requests that don't fit in a slot
+ * are left for read(), which is signalled by FUSE_RING_NEED_READ.
+ */
+#define FUSE_RING_ENTER_GETEVENTS	(1 << 0)
+
+#define FUSE_RING_NEED_READ	(1 << 0)
+
+struct fuse_ring_params {
+	uint32_t	entries;
+	uint32_t	entry_size;
+	uint32_t	flags;
+	uint32_t	slot_offset;
+	uint64_t	ring_size;
+};
+
+struct fuse_ring_header {
+	uint32_t	sq_head;	/* written by the daemon */
+	uint32_t	sq_tail;	/* written by the kernel */
+	uint32_t	cq_head;	/* written by the kernel */
+	uint32_t	cq_tail;	/* written by the daemon */
+	uint32_t	flags;		/* FUSE_RING_* set by the kernel */
+	uint32_t	padding;
+};
 
 struct fuse_lseek_in {
 	uint64_t	fh;
@@ -30,6 +30,31 @@ struct input_event {
 	__s32 value;
 };
 
+/**
+ * struct input_event_ring - event ring shared by an event device with its reader
+ * @head: index past the last complete packet, only written by the kernel
+ * @tail: index of the next event to read, only written by the reader
+ * @size: number of events in @events, a power of 2
+ * @reserved: must be ignored
+ * @events: the ring, the event at index i is events[i & (size - 1)]
+ *
+ * Set up by mmap() of a shared, writable mapping at offset 0 of the event
+ * device, sized for the header and at least as many events as the
+ * read() buffer of the device.  The indices run freely and wrap at 2^32.
+ * The reader consumes the events between @tail and @head, then stores
+ * the new @tail with release semantics.  From then on events are only
+ * queued to the ring, read() fails with -EBUSY, and poll() still reports
+ * pending events.  When the ring is full, the kernel drops the packet it
+ * is queuing and queues SYN_DROPPED as soon as there is room again.
+ */
+struct input_event_ring {
+	__u32 head;
+	__u32 tail;
+	__u32 size;
+	__u32 reserved;
+	struct input_event events[];
+};
+
 /*
  * Protocol version.
  */
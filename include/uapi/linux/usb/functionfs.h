@@ -288,6 +288,23 @@ struct usb_functionfs_event {
 #define	FUNCTIONFS_ENDPOINT_DESC	_IOR('g', 130, \
 					     struct usb_endpoint_descriptor)
 
+/*
+ * Allocates count buffers of size bytes for an endpoint, replacing the
+ * buffers allocated before, if any (a count of 0 just drops them).  They
+ * are then mmap()ed, shared, from the endpoint file, buffer n starting at
+ * offset n * size rounded up to the page size.  An AIO read or write with
+ * a single iovec lying within one buffer of such a mapping is done in
+ * place, without copying the data.  A read may then fill the buffer up to
+ * the max packet size rounded length of the iovec.
+ */
+struct usb_functionfs_buffers {
+	__u32 count;
+	__u32 size;
+};
+
+#define	FUNCTIONFS_BUFFERS_ALLOC	_IOW('g', 131, \
+					     struct usb_functionfs_buffers)
+
 
 
 #endif /* _UAPI__LINUX_FUNCTIONFS_H__ */
@@ -503,6 +503,55 @@ struct vfio_pci_hot_reset {
 
 #define VFIO_DEVICE_PCI_HOT_RESET	_IO(VFIO_TYPE, VFIO_BASE + 13)
 
+/**
+ * VFIO_DEVICE_QUERY_GFX_PLANE - _IORW(VFIO_TYPE, VFIO_BASE + 14,
+ *				       struct vfio_device_gfx_plane_info)
+ *
+ * Describe the surface currently displayed by a plane of a mediated
+ * graphics device, selected by drm_plane_type (DRM_PLANE_TYPE_*).
+ * With VFIO_GFX_PLANE_TYPE_PROBE set, only report whether the device
+ * supports the flags also passed in. With VFIO_GFX_PLANE_FLIP_FENCE set,
+ * flip_fence_fd returns a sync_file fd, signaled when the guest next
+ * flips this plane.
+ *
+ * Return: 0 on success, -errno on failure:
+ *	-enodev = the plane is disabled.
+ */
+struct vfio_device_gfx_plane_info {
+	__u32	argsz;
+	__u32	flags;
+#define VFIO_GFX_PLANE_TYPE_PROBE	(1 << 0)
+#define VFIO_GFX_PLANE_TYPE_DMABUF	(1 << 1)
+#define VFIO_GFX_PLANE_FLIP_FENCE	(1 << 2)
+	/* in */
+	__u32	drm_plane_type;	/* DRM_PLANE_TYPE_* */
+	/* out */
+	__u32	drm_format;	/* DRM_FORMAT_* fourcc */
+	__u64	drm_format_mod;	/* tiling, DRM_FORMAT_MOD_* */
+	__u32	width;
+	__u32	height;
+	__u32	stride;		/* in bytes */
+	__u32	size;		/* in bytes, page aligned */
+	__u32	x_pos;		/* position on the pipe */
+	__u32	y_pos;
+	__s32	flip_fence_fd;
+	__u32	pad;
+};
+
+#define VFIO_DEVICE_QUERY_GFX_PLANE	_IO(VFIO_TYPE, VFIO_BASE + 14)
+
+/**
+ * VFIO_DEVICE_GET_GFX_DMABUF - _IOW(VFIO_TYPE, VFIO_BASE + 15, __u32)
+ *
+ * Export the surface currently displayed by the plane of the given
+ * DRM_PLANE_TYPE_* as a dma-buf, without copying it. The surface may
+ * change right after the query, so callers use the flip fence to know
+ * when to query and export again.
+ *
+ * Return: a new dma-buf fd on success, -errno on failure.
+ */
+#define VFIO_DEVICE_GET_GFX_DMABUF	_IO(VFIO_TYPE, VFIO_BASE + 15)
+
 /* -------- API for Type1 VFIO IOMMU -------- */
 
 /**
@@ -28,6 +28,13 @@ struct vhost_vring_file {
 
 };
 
+struct vhost_vring_busyloop_stats {
+	unsigned int index;
+	__u32 budget;
+	__u64 hits;
+	__u64 misses;
+};
+
 struct vhost_vring_addr {
 	unsigned int index;
 	/* Option flags. */
@@ -159,6 +166,26 @@ struct vhost_memory {
 /* Get busy loop timeout (in us) */
 #define VHOST_GET_VRING_BUSYLOOP_TIMEOUT _IOW(VHOST_VIRTIO, 0x24,	\
 					 struct vhost_vring_state)
+/* Scale the busy loop timeout of a ring to how long the ring usually stays
+ * empty, up to the timeout set above, and to nothing when the ring is
+ * mostly idle. num is 1 to enable, 0 (the default) to disable. Not all
+ * devices busy poll. */
+#define VHOST_SET_VRING_BUSYLOOP_ADAPTIVE _IOW(VHOST_VIRTIO, 0x26,	\
+					  struct vhost_vring_state)
+#define VHOST_GET_VRING_BUSYLOOP_ADAPTIVE _IOW(VHOST_VIRTIO, 0x27,	\
+					  struct vhost_vring_state)
+/* Get the current busy loop timeout (in us) of a ring, and how many of
+ * its busy loops ended with and without finding work */
+#define VHOST_GET_VRING_BUSYLOOP_STATS _IOWR(VHOST_VIRTIO, 0x28,	\
+				     struct vhost_vring_busyloop_stats)
+/* Run the handlers of a ring on a thread of its own, so that rings are
+ * served in parallel. num is the CPU to run the thread on, or one of the
+ * values below. Only valid while the ring has neither a kick eventfd nor a
+ * backend (-EBUSY otherwise). Only supported by vhost-net. */
+#define VHOST_VRING_WORKER_DEVICE	(~0U)	/* Back to the device thread */
+#define VHOST_VRING_WORKER_ANY_CPU	(~0U - 1)
+#define VHOST_SET_VRING_WORKER _IOW(VHOST_VIRTIO, 0x25,	\
+				    struct vhost_vring_state)
 
 /* VHOST_NET specific defines */
 
@@ -164,6 +164,10 @@ int __cgroup_bpf_update(struct cgroup *cgrp, struct cgroup *parent,
  * The program type passed in via @type must be suitable for network
  * filtering. No further check is performed to assert that.
  *
+ * The program runs with preemption disabled, even from the egress path in
+ * process context, so that it can count traffic in per-CPU maps (e.g. per
+ * socket owner, see bpf_get_socket_uid()) without any lock.
+ *
  * This function will return %-EPERM if any if an attached program was found
  * and if it returned != 1 during execution. In all other cases, 0 is returned.
  */
@@ -193,7 +197,9 @@ int __cgroup_bpf_run_filter_skb(struct sock *sk,
 
 		skb->sk = sk;
 		__skb_push(skb, offset);
+		preempt_disable();
 		ret = bpf_prog_run_save_cb(prog, skb) == 1 ? 0 : -EPERM;
+		preempt_enable();
 		__skb_pull(skb, offset);
 		skb->sk = save_sk;
 	}
@@ -228,8 +234,11 @@ int __cgroup_bpf_run_filter_sk(struct sock *sk,
 	rcu_read_lock();
 
 	prog = rcu_dereference(cgrp->bpf.effective[type]);
-	if (prog)
+	if (prog) {
+		preempt_disable();
 		ret = BPF_PROG_RUN(prog, sk) == 1 ? 0 : -EPERM;
+		preempt_enable();
+	}
 
 	rcu_read_unlock();
 
@@ -265,8 +274,11 @@ int __cgroup_bpf_run_filter_sock_ops(struct sock *sk,
 	rcu_read_lock();
 
 	prog = rcu_dereference(cgrp->bpf.effective[type]);
-	if (prog)
+	if (prog) {
+		preempt_disable();
 		ret = BPF_PROG_RUN(prog, sock_ops) == 1 ? 0 : -EPERM;
+		preempt_enable();
+	}
 
 	rcu_read_unlock();
 
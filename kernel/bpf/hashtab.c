@@ -14,6 +14,7 @@
 #include <linux/jhash.h>
 #include <linux/filter.h>
 #include <linux/rculist_nulls.h>
+#include <linux/uaccess.h>
 #include "percpu_freelist.h"
 #include "bpf_lru_list.h"
 #include "map_in_map.h"
@@ -49,6 +50,7 @@ struct htab_elem {
 			union {
 				struct bpf_htab *htab;
 				struct pcpu_freelist_node fnode;
+				struct htab_elem *batch_flink;
 			};
 		};
 	};
@@ -1139,10 +1141,187 @@ static void htab_map_free(struct bpf_map *map)
 	kfree(htab);
 }
 
+/* Elements of a bucket are copied out at once, so that the batch can be
+ * resumed from the next bucket.  The buffers are grown to hold the
+ * largest bucket seen.
+ */
+#define HTAB_BATCH_BUCKET_SIZE	5
+
+/* Called from syscall */
+static int
+__htab_map_lookup_and_delete_batch(struct bpf_map *map,
+				   const union bpf_attr *attr,
+				   union bpf_attr __user *uattr,
+				   bool do_delete)
+{
+	struct bpf_htab *htab = container_of(map, struct bpf_htab, map);
+	void __user *uin_batch = u64_to_user_ptr(attr->batch.in_batch);
+	void __user *uout_batch = u64_to_user_ptr(attr->batch.out_batch);
+	void __user *ukeys = u64_to_user_ptr(attr->batch.keys);
+	void __user *uvalues = u64_to_user_ptr(attr->batch.values);
+	u32 bucket_size = HTAB_BATCH_BUCKET_SIZE;
+	u32 batch = 0, total = 0, max_count;
+	u32 key_size = map->key_size;
+	u32 value_size = map->value_size;
+	bool percpu = htab_is_percpu(htab);
+	bool lru = htab_is_lru(htab);
+	struct htab_elem *l, *to_free;
+	struct hlist_nulls_node *n;
+	void *keys, *values;
+	unsigned long flags;
+	u32 bucket_cnt;
+	struct bucket *b;
+	int ret = 0;
+
+	if (attr->batch.elem_flags || attr->batch.flags)
+		return -EINVAL;
+
+	max_count = attr->batch.count;
+	if (!max_count)
+		return 0;
+
+	if (uin_batch && copy_from_user(&batch, uin_batch, sizeof(batch)))
+		return -EFAULT;
+	if (batch >= htab->n_buckets)
+		return -ENOENT;
+
+	if (percpu)
+		value_size = round_up(value_size, 8) * num_possible_cpus();
+
+alloc:
+	keys = kmalloc_array(bucket_size, key_size, GFP_USER | __GFP_NOWARN);
+	values = kmalloc_array(bucket_size, value_size, GFP_USER | __GFP_NOWARN);
+	if (!keys || !values) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	while (total < max_count) {
+		void *dst_key = keys, *dst_val = values;
+
+		to_free = NULL;
+		bucket_cnt = 0;
+		b = &htab->buckets[batch];
+
+		/* the bucket lock is also taken by programs updating the map */
+		preempt_disable();
+		__this_cpu_inc(bpf_prog_active);
+		raw_spin_lock_irqsave(&b->lock, flags);
+
+		hlist_nulls_for_each_entry_rcu(l, n, &b->head, hash_node)
+			bucket_cnt++;
+
+		if (bucket_cnt > bucket_size ||
+		    bucket_cnt > max_count - total) {
+			raw_spin_unlock_irqrestore(&b->lock, flags);
+			__this_cpu_dec(bpf_prog_active);
+			preempt_enable();
+
+			if (bucket_cnt > max_count - total) {
+				/* the caller resumes from this bucket */
+				if (!total)
+					ret = -ENOSPC;
+				break;
+			}
+
+			bucket_size = bucket_cnt;
+			kfree(keys);
+			kfree(values);
+			goto alloc;
+		}
+
+		hlist_nulls_for_each_entry_rcu(l, n, &b->head, hash_node) {
+			memcpy(dst_key, l->key, key_size);
+
+			if (percpu) {
+				void __percpu *pptr;
+				u32 size = round_up(map->value_size, 8);
+				int cpu, off = 0;
+
+				pptr = htab_elem_get_ptr(l, key_size);
+				for_each_possible_cpu(cpu) {
+					bpf_long_memcpy(dst_val + off,
+							per_cpu_ptr(pptr, cpu),
+							size);
+					off += size;
+				}
+			} else {
+				memcpy(dst_val, l->key + round_up(key_size, 8),
+				       value_size);
+			}
+
+			if (do_delete) {
+				hlist_nulls_del_rcu(&l->hash_node);
+				/* LRU elements are freed out of the bucket lock */
+				if (lru) {
+					l->batch_flink = to_free;
+					to_free = l;
+				} else {
+					free_htab_elem(htab, l);
+				}
+			}
+
+			dst_key += key_size;
+			dst_val += value_size;
+		}
+
+		raw_spin_unlock_irqrestore(&b->lock, flags);
+
+		while (to_free) {
+			l = to_free;
+			to_free = to_free->batch_flink;
+			bpf_lru_push_free(&htab->lru, &l->lru_node);
+		}
+
+		__this_cpu_dec(bpf_prog_active);
+		preempt_enable();
+
+		if (bucket_cnt &&
+		    (copy_to_user(ukeys + (size_t)total * key_size, keys,
+				  key_size * bucket_cnt) ||
+		     copy_to_user(uvalues + (size_t)total * value_size, values,
+				  value_size * bucket_cnt))) {
+			ret = -EFAULT;
+			goto out;
+		}
+
+		total += bucket_cnt;
+		if (++batch >= htab->n_buckets) {
+			ret = -ENOENT;
+			break;
+		}
+	}
+
+	if (copy_to_user(uout_batch, &batch, sizeof(batch)) ||
+	    put_user(total, &uattr->batch.count))
+		ret = -EFAULT;
+
+out:
+	kfree(keys);
+	kfree(values);
+	return ret;
+}
+
+static int htab_map_lookup_batch(struct bpf_map *map,
+				 const union bpf_attr *attr,
+				 union bpf_attr __user *uattr)
+{
+	return __htab_map_lookup_and_delete_batch(map, attr, uattr, false);
+}
+
+static int htab_map_lookup_and_delete_batch(struct bpf_map *map,
+					    const union bpf_attr *attr,
+					    union bpf_attr __user *uattr)
+{
+	return __htab_map_lookup_and_delete_batch(map, attr, uattr, true);
+}
+
 const struct bpf_map_ops htab_map_ops = {
 	.map_alloc = htab_map_alloc,
 	.map_free = htab_map_free,
 	.map_get_next_key = htab_map_get_next_key,
+	.map_lookup_batch = htab_map_lookup_batch,
+	.map_lookup_and_delete_batch = htab_map_lookup_and_delete_batch,
 	.map_lookup_elem = htab_map_lookup_elem,
 	.map_update_elem = htab_map_update_elem,
 	.map_delete_elem = htab_map_delete_elem,
@@ -1153,6 +1332,8 @@ const struct bpf_map_ops htab_lru_map_ops = {
 	.map_alloc = htab_map_alloc,
 	.map_free = htab_map_free,
 	.map_get_next_key = htab_map_get_next_key,
+	.map_lookup_batch = htab_map_lookup_batch,
+	.map_lookup_and_delete_batch = htab_map_lookup_and_delete_batch,
 	.map_lookup_elem = htab_lru_map_lookup_elem,
 	.map_update_elem = htab_lru_map_update_elem,
 	.map_delete_elem = htab_lru_map_delete_elem,
@@ -1236,6 +1417,8 @@ const struct bpf_map_ops htab_percpu_map_ops = {
 	.map_alloc = htab_map_alloc,
 	.map_free = htab_map_free,
 	.map_get_next_key = htab_map_get_next_key,
+	.map_lookup_batch = htab_map_lookup_batch,
+	.map_lookup_and_delete_batch = htab_map_lookup_and_delete_batch,
 	.map_lookup_elem = htab_percpu_map_lookup_elem,
 	.map_update_elem = htab_percpu_map_update_elem,
 	.map_delete_elem = htab_map_delete_elem,
@@ -1245,6 +1428,8 @@ const struct bpf_map_ops htab_lru_percpu_map_ops = {
 	.map_alloc = htab_map_alloc,
 	.map_free = htab_map_free,
 	.map_get_next_key = htab_map_get_next_key,
+	.map_lookup_batch = htab_map_lookup_batch,
+	.map_lookup_and_delete_batch = htab_map_lookup_and_delete_batch,
 	.map_lookup_elem = htab_lru_percpu_map_lookup_elem,
 	.map_update_elem = htab_lru_percpu_map_update_elem,
 	.map_delete_elem = htab_lru_map_delete_elem,
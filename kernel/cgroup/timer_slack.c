@@ -0,0 +1,129 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Timer slack controller
+ *
+ * Sets a minimum timer slack for the tasks of a cgroup, so that the
+ * timeouts of background tasks can be expired together with other
+ * timers instead of waking an idle CPU each.  The slack of a task is
+ * the larger of its own (prctl(PR_SET_TIMERSLACK), timerslack_ns) and
+ * the one of its cgroup, and still does not apply to realtime tasks.
+ *
+ * timer_slack.coalesced counts the timeouts of the cgroup that expired
+ * early, within their slack, on a wakeup the CPU made anyway.
+ */
+#include <linux/atomic.h>
+#include <linux/cgroup.h>
+#include <linux/hrtimer.h>
+#include <linux/kernel.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+
+struct tslack_cgroup {
+	struct cgroup_subsys_state	css;
+	u64				min_slack_ns;
+
+	atomic64_t			expired;
+	atomic64_t			coalesced;
+};
+
+static struct tslack_cgroup *css_tslack(struct cgroup_subsys_state *css)
+{
+	return css ? container_of(css, struct tslack_cgroup, css) : NULL;
+}
+
+static struct tslack_cgroup *task_tslack(struct task_struct *tsk)
+{
+	return css_tslack(task_css(tsk, timer_slack_cgrp_id));
+}
+
+static struct cgroup_subsys_state *
+tslack_css_alloc(struct cgroup_subsys_state *parent_css)
+{
+	struct tslack_cgroup *parent = css_tslack(parent_css);
+	struct tslack_cgroup *tslack;
+
+	tslack = kzalloc(sizeof(*tslack), GFP_KERNEL);
+	if (!tslack)
+		return ERR_PTR(-ENOMEM);
+
+	/* A new cgroup starts with the slack of its parent */
+	if (parent)
+		tslack->min_slack_ns = parent->min_slack_ns;
+	return &tslack->css;
+}
+
+static void tslack_css_free(struct cgroup_subsys_state *css)
+{
+	kfree(css_tslack(css));
+}
+
+u64 task_get_effective_timer_slack(struct task_struct *tsk)
+{
+	u64 slack;
+
+	rcu_read_lock();
+	slack = max(tsk->timer_slack_ns, READ_ONCE(task_tslack(tsk)->min_slack_ns));
+	rcu_read_unlock();
+
+	return slack;
+}
+
+/*
+ * Called when the sleep timer of @tsk expires.  A timer that expires
+ * before its hard expiry time was run along with an earlier timer.
+ */
+void timer_slack_account_expiry(struct task_struct *tsk, struct hrtimer *timer)
+{
+	struct tslack_cgroup *tslack;
+
+	rcu_read_lock();
+	tslack = task_tslack(tsk);
+	atomic64_inc(&tslack->expired);
+	if (hrtimer_cb_get_time(timer) < hrtimer_get_expires(timer))
+		atomic64_inc(&tslack->coalesced);
+	rcu_read_unlock();
+}
+
+static u64 tslack_min_slack_read(struct cgroup_subsys_state *css,
+				 struct cftype *cft)
+{
+	return css_tslack(css)->min_slack_ns;
+}
+
+static int tslack_min_slack_write(struct cgroup_subsys_state *css,
+				  struct cftype *cft, u64 val)
+{
+	/* Tasks pick the new value up the next time they arm a timeout */
+	WRITE_ONCE(css_tslack(css)->min_slack_ns, val);
+	return 0;
+}
+
+static int tslack_stat_show(struct seq_file *sf, void *v)
+{
+	struct tslack_cgroup *tslack = css_tslack(seq_css(sf));
+
+	seq_printf(sf, "expired %lld\n" "coalesced %lld\n",
+		   (s64)atomic64_read(&tslack->expired),
+		   (s64)atomic64_read(&tslack->coalesced));
+	return 0;
+}
+
+static struct cftype tslack_files[] = {
+	{
+		.name = "min_slack_ns",
+		.read_u64 = tslack_min_slack_read,
+		.write_u64 = tslack_min_slack_write,
+		.flags = CFTYPE_NOT_ON_ROOT,
+	},
+	{
+		.name = "stat",
+		.seq_show = tslack_stat_show,
+	},
+	{ }	/* terminate */
+};
+
+struct cgroup_subsys timer_slack_cgrp_subsys = {
+	.css_alloc	= tslack_css_alloc,
+	.css_free	= tslack_css_free,
+	.legacy_cftypes	= tslack_files,
+};
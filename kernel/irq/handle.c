@@ -199,6 +199,7 @@ irqreturn_t handle_irq_event(struct irq_desc *desc)
 
 	desc->istate &= ~IRQS_PENDING;
 	irqd_set(&desc->irq_data, IRQD_IRQ_INPROGRESS);
+	irq_moderation_account(desc);
 	raw_spin_unlock(&desc->lock);
 
 	ret = handle_irq_event_percpu(desc);
@@ -374,6 +374,58 @@ static inline void irq_setup_timings(struct irq_desc *desc,
 static inline void record_irq_time(struct irq_desc *desc) {}
 #endif /* CONFIG_IRQ_TIMINGS */
 
+#ifdef CONFIG_IRQ_MODERATION
+
+/**
+ * struct irq_moderation - interrupt moderation state of an irq
+ * @threshold:    interrupts per second above which the thread polls
+ * @window_start: jiffies at the start of the rate measurement window
+ * @window_count: interrupts taken in the current window
+ * @polling:      the thread polls until the device has no more work
+ * @irqs:         interrupts taken while moderated
+ * @polls:        thread function calls made by polling
+ * @poll_exits:   times the device ran out of work while polled
+ */
+struct irq_moderation {
+	unsigned int	threshold;
+	unsigned long	window_start;
+	unsigned int	window_count;
+	bool		polling;
+	unsigned long	irqs;
+	unsigned long	polls;
+	unsigned long	poll_exits;
+};
+
+extern void __irq_moderation_account(struct irq_desc *desc);
+extern irqreturn_t irq_moderation_poll(struct irq_desc *desc,
+				       struct irqaction *action);
+extern void irq_moderation_free(struct irq_desc *desc);
+
+/* Called with desc->lock held, from handle_irq_event() */
+static inline void irq_moderation_account(struct irq_desc *desc)
+{
+	if (desc->moderation)
+		__irq_moderation_account(desc);
+}
+
+static inline bool irq_moderation_polling(struct irq_desc *desc)
+{
+	return desc->moderation && READ_ONCE(desc->moderation->polling);
+}
+#else
+static inline void irq_moderation_account(struct irq_desc *desc) {}
+static inline bool irq_moderation_polling(struct irq_desc *desc)
+{
+	return false;
+}
+static inline irqreturn_t irq_moderation_poll(struct irq_desc *desc,
+					      struct irqaction *action)
+{
+	return IRQ_NONE;
+}
+static inline void irq_moderation_free(struct irq_desc *desc) {}
+#endif /* CONFIG_IRQ_MODERATION */
+
 
 #ifdef CONFIG_GENERIC_IRQ_CHIP
 void irq_init_generic_chip(struct irq_chip_generic *gc, const char *name,
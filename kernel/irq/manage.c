@@ -897,7 +897,10 @@ static irqreturn_t irq_thread_fn(struct irq_desc *desc,
 {
 	irqreturn_t ret;
 
-	ret = action->thread_fn(action->irq, action->dev_id);
+	if (irq_moderation_polling(desc))
+		ret = irq_moderation_poll(desc, action);
+	else
+		ret = action->thread_fn(action->irq, action->dev_id);
 	irq_finalize_oneshot(desc, action);
 	return ret;
 }
@@ -1603,6 +1606,7 @@ static struct irqaction *__free_irq(unsigned int irq, void *dev_id)
 		irq_release_resources(desc);
 		chip_bus_sync_unlock(desc);
 		irq_remove_timings(desc);
+		irq_moderation_free(desc);
 	}
 
 	mutex_unlock(&desc->request_mutex);
@@ -0,0 +1,139 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Adaptive interrupt moderation
+ *
+ * A device that raises an interrupt for every event can keep a CPU busy
+ * with interrupt entry and exit alone.  For an irq that opted in, the
+ * core measures the interrupt rate, and above a threshold keeps calling
+ * the thread function of the irq, with the line still masked, for as
+ * long as it finds work, much like a NAPI poll loop.  The irq is
+ * unmasked again once the device runs out of work.
+ */
+#include <linux/interrupt.h>
+#include <linux/irq.h>
+#include <linux/jiffies.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+
+#include "internals.h"
+
+/* Length of the interrupt rate measurement window */
+#define IRQ_MODERATION_WINDOW	(HZ / 50)
+
+/* Thread function calls per thread wakeup, bounds free_irq() latency */
+#define IRQ_MODERATION_BUDGET	64
+
+void __irq_moderation_account(struct irq_desc *desc)
+{
+	struct irq_moderation *mod = desc->moderation;
+	unsigned long elapsed = jiffies - mod->window_start;
+
+	mod->irqs++;
+	mod->window_count++;
+	if (elapsed < IRQ_MODERATION_WINDOW)
+		return;
+
+	/* Interrupts per second over the window that just ended */
+	if ((unsigned long)mod->window_count * HZ / elapsed >= mod->threshold)
+		WRITE_ONCE(mod->polling, true);
+
+	mod->window_start += elapsed;
+	mod->window_count = 0;
+}
+
+/*
+ * Called from the irq thread instead of the thread function while the
+ * irq is polled.  The thread function returning IRQ_HANDLED means that
+ * it found work, so it is called again.
+ */
+irqreturn_t irq_moderation_poll(struct irq_desc *desc, struct irqaction *action)
+{
+	struct irq_moderation *mod = READ_ONCE(desc->moderation);
+	irqreturn_t ret = IRQ_NONE;
+	int budget;
+
+	if (!mod)
+		return action->thread_fn(action->irq, action->dev_id);
+
+	for (budget = IRQ_MODERATION_BUDGET; budget; budget--) {
+		mod->polls++;
+		if (action->thread_fn(action->irq, action->dev_id) !=
+		    IRQ_HANDLED) {
+			mod->poll_exits++;
+			WRITE_ONCE(mod->polling, false);
+			break;
+		}
+		ret = IRQ_HANDLED;
+		cond_resched();
+	}
+
+	return ret;
+}
+
+void irq_moderation_free(struct irq_desc *desc)
+{
+	struct irq_moderation *mod;
+
+	raw_spin_lock_irq(&desc->lock);
+	mod = desc->moderation;
+	desc->moderation = NULL;
+	raw_spin_unlock_irq(&desc->lock);
+
+	kfree(mod);
+}
+
+/**
+ *	irq_set_moderation - enable adaptive moderation of an interrupt
+ *	@irq:		Interrupt line
+ *	@threshold:	Interrupts per second above which the line is
+ *			polled, or 0 to disable moderation
+ *
+ *	The interrupt must have been requested with a thread function and
+ *	IRQF_ONESHOT, and must not be shared.  The thread function then
+ *	has to be safe to call when no interrupt is pending, and to return
+ *	IRQ_NONE when the device has no more work.
+ *
+ *	Statistics are shown in /proc/irq/<irq>/moderation.
+ */
+int irq_set_moderation(unsigned int irq, unsigned int threshold)
+{
+	struct irq_desc *desc = irq_to_desc(irq);
+	struct irq_moderation *mod = NULL;
+	struct irqaction *action;
+	int ret = 0;
+
+	if (!desc)
+		return -EINVAL;
+
+	if (threshold) {
+		mod = kzalloc(sizeof(*mod), GFP_KERNEL);
+		if (!mod)
+			return -ENOMEM;
+		mod->threshold = threshold;
+		mod->window_start = jiffies;
+	}
+
+	mutex_lock(&desc->request_mutex);
+	raw_spin_lock_irq(&desc->lock);
+
+	action = desc->action;
+	if (mod && (!action || action->next || !action->thread_fn ||
+		    !(action->flags & IRQF_ONESHOT) ||
+		    test_bit(IRQTF_FORCED_THREAD, &action->thread_flags) ||
+		    irq_settings_is_nested_thread(desc))) {
+		ret = -EINVAL;
+	} else {
+		swap(desc->moderation, mod);
+	}
+
+	raw_spin_unlock_irq(&desc->lock);
+
+	/* Let a thread polling with the old state finish */
+	if (!ret && mod)
+		synchronize_irq(irq);
+	mutex_unlock(&desc->request_mutex);
+
+	kfree(mod);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(irq_set_moderation);
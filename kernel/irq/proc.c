@@ -350,6 +350,37 @@ static const struct file_operations irq_spurious_proc_fops = {
 	.release	= single_release,
 };
 
+#ifdef CONFIG_IRQ_MODERATION
+static int irq_moderation_proc_show(struct seq_file *m, void *v)
+{
+	struct irq_desc *desc = irq_to_desc((long) m->private);
+	struct irq_moderation mod = { };
+
+	raw_spin_lock_irq(&desc->lock);
+	if (desc->moderation)
+		mod = *desc->moderation;
+	raw_spin_unlock_irq(&desc->lock);
+
+	seq_printf(m, "threshold %u\n" "polling %d\n" "irqs %lu\n"
+		   "polls %lu\n" "poll_exits %lu\n",
+		   mod.threshold, mod.polling, mod.irqs, mod.polls,
+		   mod.poll_exits);
+	return 0;
+}
+
+static int irq_moderation_proc_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, irq_moderation_proc_show, PDE_DATA(inode));
+}
+
+static const struct file_operations irq_moderation_proc_fops = {
+	.open		= irq_moderation_proc_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#endif
+
 #define MAX_NAMELEN 128
 
 static int name_unique(unsigned int irq, struct irqaction *new_action)
@@ -440,6 +471,10 @@ void register_irq_proc(unsigned int irq, struct irq_desc *desc)
 #endif
 	proc_create_data("spurious", 0444, desc->dir,
 			 &irq_spurious_proc_fops, (void *)(long)irq);
+#ifdef CONFIG_IRQ_MODERATION
+	proc_create_data("moderation", 0444, desc->dir,
+			 &irq_moderation_proc_fops, (void *)(long)irq);
+#endif
 
 out_unlock:
 	mutex_unlock(&register_lock);
@@ -462,6 +497,9 @@ void unregister_irq_proc(unsigned int irq, struct irq_desc *desc)
 # endif
 #endif
 	remove_proc_entry("spurious", desc->dir);
+#ifdef CONFIG_IRQ_MODERATION
+	remove_proc_entry("moderation", desc->dir);
+#endif
 
 	sprintf(name, "%u", irq);
 	remove_proc_entry(name, root_irq_dir);
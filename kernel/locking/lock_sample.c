@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Low-overhead lock contention sampling
+ *
+ * CONFIG_LOCK_STAT records every acquisition through lockdep, which is
+ * too expensive to leave on.  Instead the slow paths of mutexes, rwsems
+ * and queued spinlocks time one in lock_sample.interval of their waits
+ * on each CPU, and report them in the per-CPU trace buffers.
+ */
+#include <linux/moduleparam.h>
+#include <linux/percpu.h>
+#include <linux/sched/clock.h>
+
+#define CREATE_TRACE_POINTS
+#include "lock_sample.h"
+
+#ifdef MODULE_PARAM_PREFIX
+#undef MODULE_PARAM_PREFIX
+#endif
+#define MODULE_PARAM_PREFIX "lock_sample."
+
+static unsigned int lock_sample_interval = 64;
+module_param_named(interval, lock_sample_interval, uint, 0644);
+MODULE_PARM_DESC(interval, "Sample one in this many contended lock acquisitions");
+
+static DEFINE_PER_CPU(unsigned int, lock_sample_count);
+
+u64 __lock_sample_begin(void)
+{
+	unsigned int interval = READ_ONCE(lock_sample_interval);
+
+	if (interval > 1 && this_cpu_inc_return(lock_sample_count) % interval)
+		return 0;
+	return local_clock() ? : 1;
+}
@@ -0,0 +1,44 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Sampling of lock contention, for the slow paths of the locks.
+ *
+ * While the lock_sample:lock_contention_sample event is disabled this
+ * costs a static branch in the slow path and nothing in the fast path.
+ */
+#ifndef __LOCKING_LOCK_SAMPLE_H
+#define __LOCKING_LOCK_SAMPLE_H
+
+#include <linux/sched/clock.h>
+#include <trace/events/lock_sample.h>
+
+#ifdef CONFIG_TRACEPOINTS
+extern u64 __lock_sample_begin(void);
+
+/* Returns the start time of a sampled wait, 0 if it isn't sampled */
+static __always_inline u64 lock_sample_begin(void)
+{
+	if (!trace_lock_contention_sample_enabled())
+		return 0;
+	return __lock_sample_begin();
+}
+
+static __always_inline void lock_sample_end(u64 start, void *lock,
+					    unsigned long ip, int type)
+{
+	if (start)
+		trace_lock_contention_sample(lock, ip,
+					     local_clock() - start, type);
+}
+#else
+static inline u64 lock_sample_begin(void)
+{
+	return 0;
+}
+
+static inline void lock_sample_end(u64 start, void *lock,
+				   unsigned long ip, int type)
+{
+}
+#endif
+
+#endif /* __LOCKING_LOCK_SAMPLE_H */
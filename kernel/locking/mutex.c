@@ -35,6 +35,8 @@
 # include "mutex.h"
 #endif
 
+#include "lock_sample.h"
+
 void
 __mutex_init(struct mutex *lock, const char *name, struct lock_class_key *key)
 {
@@ -742,6 +744,7 @@ __mutex_lock_common(struct mutex *lock, long state, unsigned int subclass,
 	struct mutex_waiter waiter;
 	bool first = false;
 	struct ww_mutex *ww;
+	u64 sample = 0;
 	int ret;
 
 	might_sleep();
@@ -780,6 +783,7 @@ __mutex_lock_common(struct mutex *lock, long state, unsigned int subclass,
 	debug_mutex_add_waiter(lock, &waiter, current);
 
 	lock_contended(&lock->dep_map, ip);
+	sample = lock_sample_begin();
 
 	if (!use_ww_ctx) {
 		/* add waiting tasks to the end of the waitqueue (FIFO): */
@@ -872,6 +876,7 @@ __mutex_lock_common(struct mutex *lock, long state, unsigned int subclass,
 		ww_mutex_set_context_slowpath(ww, ww_ctx);
 
 	spin_unlock(&lock->wait_lock);
+	lock_sample_end(sample, lock, ip, LOCK_SAMPLE_MUTEX);
 	preempt_enable();
 	return 0;
 
@@ -69,6 +69,7 @@
  */
 
 #include "mcs_spinlock.h"
+#include "lock_sample.h"
 
 #ifdef CONFIG_PARAVIRT_SPINLOCKS
 #define MAX_NODES	8
@@ -295,6 +296,7 @@ void queued_spin_lock_slowpath(struct qspinlock *lock, u32 val)
 {
 	struct mcs_spinlock *prev, *next, *node;
 	u32 new, old, tail;
+	u64 sample;
 	int idx;
 
 	BUILD_BUG_ON(CONFIG_NR_CPUS >= (1U << _Q_TAIL_CPU_BITS));
@@ -374,6 +376,7 @@ void queued_spin_lock_slowpath(struct qspinlock *lock, u32 val)
 	 * queuing.
 	 */
 queue:
+	sample = lock_sample_begin();
 	node = this_cpu_ptr(&mcs_nodes[0]);
 	idx = node->count++;
 	tail = encode_tail(smp_processor_id(), idx);
@@ -504,6 +507,7 @@ void queued_spin_lock_slowpath(struct qspinlock *lock, u32 val)
 	 * release the node
 	 */
 	__this_cpu_dec(mcs_nodes[0].count);
+	lock_sample_end(sample, lock, _RET_IP_, LOCK_SAMPLE_SPIN);
 }
 EXPORT_SYMBOL(queued_spin_lock_slowpath);
 
@@ -18,8 +18,11 @@
 #include <linux/sched/wake_q.h>
 #include <linux/sched/debug.h>
 #include <linux/osq_lock.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include "rwsem.h"
+#include "lock_sample.h"
 
 /*
  * Guide to the rw_semaphore's count field for common values.
@@ -219,6 +222,9 @@ static void __rwsem_mark_wake(struct rw_semaphore *sem,
 		atomic_long_add(adjustment, &sem->count);
 }
 
+static bool rwsem_reader_can_spin(struct rw_semaphore *sem);
+static bool rwsem_optimistic_spin(struct rw_semaphore *sem, bool reader);
+
 /*
  * Wait for the read lock to be granted
  */
@@ -227,13 +233,34 @@ __rwsem_down_read_failed_common(struct rw_semaphore *sem, int state)
 {
 	long count, adjustment = -RWSEM_ACTIVE_READ_BIAS;
 	struct rwsem_waiter waiter;
+	u64 sample = lock_sample_begin();
+	bool first;
 	DEFINE_WAKE_Q(wake_q);
 
+	/*
+	 * Spin while a running writer holds the lock, as page faults do
+	 * against a short mmap() holding mmap_sem.  The read bias is backed
+	 * out first, so that it doesn't hide the release of the lock.  If
+	 * that leaves only waiters, the queueing below wakes them.
+	 */
+	if (rwsem_reader_can_spin(sem)) {
+		count = atomic_long_add_return(-RWSEM_ACTIVE_READ_BIAS,
+					       &sem->count);
+		adjustment = 0;
+		if (count != RWSEM_WAITING_BIAS &&
+		    rwsem_optimistic_spin(sem, true)) {
+			lock_sample_end(sample, sem, _RET_IP_,
+					LOCK_SAMPLE_RWSEM_READ);
+			return sem;
+		}
+	}
+
 	waiter.task = current;
 	waiter.type = RWSEM_WAITING_FOR_READ;
 
 	raw_spin_lock_irq(&sem->wait_lock);
-	if (list_empty(&sem->wait_list))
+	first = list_empty(&sem->wait_list);
+	if (first)
 		adjustment += RWSEM_WAITING_BIAS;
 	list_add_tail(&waiter.list, &sem->wait_list);
 
@@ -247,8 +274,7 @@ __rwsem_down_read_failed_common(struct rw_semaphore *sem, int state)
 	 * wake our own waiter to join the existing active readers !
 	 */
 	if (count == RWSEM_WAITING_BIAS ||
-	    (count > RWSEM_WAITING_BIAS &&
-	     adjustment != -RWSEM_ACTIVE_READ_BIAS))
+	    (count > RWSEM_WAITING_BIAS && first))
 		__rwsem_mark_wake(sem, RWSEM_WAKE_ANY, &wake_q);
 
 	raw_spin_unlock_irq(&sem->wait_lock);
@@ -270,6 +296,7 @@ __rwsem_down_read_failed_common(struct rw_semaphore *sem, int state)
 	}
 
 	__set_current_state(TASK_RUNNING);
+	lock_sample_end(sample, sem, _RET_IP_, LOCK_SAMPLE_RWSEM_READ);
 	return sem;
 out_nolock:
 	list_del(&waiter.list);
@@ -325,6 +352,97 @@ static inline bool rwsem_try_write_lock(long count, struct rw_semaphore *sem)
 }
 
 #ifdef CONFIG_RWSEM_SPIN_ON_OWNER
+/*
+ * Statistics of the optimistic spinning, in <debugfs>/rwsem_stat
+ */
+enum rwsem_stat_item {
+	RWSEM_STAT_READ_SPIN,		/* readers that got the lock spinning */
+	RWSEM_STAT_WRITE_SPIN,		/* writers that got the lock spinning */
+	RWSEM_STAT_SPIN_FAIL,		/* spinners that had to queue */
+	RWSEM_STAT_HANDOFF,		/* waiting writers that set handoff */
+	NR_RWSEM_STAT_ITEMS
+};
+
+static DEFINE_PER_CPU(unsigned long, rwsem_stats[NR_RWSEM_STAT_ITEMS]);
+
+static const char * const rwsem_stat_names[NR_RWSEM_STAT_ITEMS] = {
+	[RWSEM_STAT_READ_SPIN]	= "read_spin_taken",
+	[RWSEM_STAT_WRITE_SPIN]	= "write_spin_taken",
+	[RWSEM_STAT_SPIN_FAIL]	= "spin_failed",
+	[RWSEM_STAT_HANDOFF]	= "handoff",
+};
+
+static inline void rwsem_stat_inc(enum rwsem_stat_item item)
+{
+	this_cpu_inc(rwsem_stats[item]);
+}
+
+static int rwsem_stat_show(struct seq_file *m, void *v)
+{
+	int cpu, i;
+
+	for (i = 0; i < NR_RWSEM_STAT_ITEMS; i++) {
+		unsigned long sum = 0;
+
+		for_each_possible_cpu(cpu)
+			sum += per_cpu(rwsem_stats[i], cpu);
+		seq_printf(m, "%s %lu\n", rwsem_stat_names[i], sum);
+	}
+	return 0;
+}
+
+static int rwsem_stat_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, rwsem_stat_show, NULL);
+}
+
+static const struct file_operations rwsem_stat_fops = {
+	.open		= rwsem_stat_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init rwsem_stat_init(void)
+{
+	debugfs_create_file("rwsem_stat", 0444, NULL, NULL, &rwsem_stat_fops);
+	return 0;
+}
+fs_initcall(rwsem_stat_init);
+
+/*
+ * Set the handoff bit on behalf of the writer at the head of the queue,
+ * return true if it wasn't set yet.
+ */
+static bool rwsem_set_handoff(struct rw_semaphore *sem)
+{
+	struct task_struct *owner = READ_ONCE(sem->owner), *old;
+
+	do {
+		if (rwsem_owner_has_handoff(owner))
+			return false;
+		old = owner;
+		owner = cmpxchg(&sem->owner, old, (struct task_struct *)
+				((unsigned long)old | RWSEM_WRITER_HANDOFF));
+	} while (owner != old);
+
+	rwsem_stat_inc(RWSEM_STAT_HANDOFF);
+	return true;
+}
+
+static void rwsem_clear_handoff(struct rw_semaphore *sem)
+{
+	struct task_struct *owner = READ_ONCE(sem->owner), *old;
+
+	do {
+		if (!rwsem_owner_has_handoff(owner))
+			return;
+		old = owner;
+		owner = cmpxchg(&sem->owner, old, (struct task_struct *)
+				((unsigned long)old & ~RWSEM_WRITER_HANDOFF));
+	} while (owner != old);
+}
+
 /*
  * Try to acquire write lock before the writer has been put on wait queue.
  */
@@ -336,6 +454,11 @@ static inline bool rwsem_try_write_lock_unqueued(struct rw_semaphore *sem)
 		if (!(count == 0 || count == RWSEM_WAITING_BIAS))
 			return false;
 
+		/* Don't take it from a writer that has waited for too long */
+		if (count == RWSEM_WAITING_BIAS &&
+		    rwsem_owner_has_handoff(READ_ONCE(sem->owner)))
+			return false;
+
 		old = atomic_long_cmpxchg_acquire(&sem->count, count,
 				      count + RWSEM_ACTIVE_WRITE_BIAS);
 		if (old == count) {
@@ -347,9 +470,31 @@ static inline bool rwsem_try_write_lock_unqueued(struct rw_semaphore *sem)
 	}
 }
 
+/*
+ * Try to acquire read lock before the reader has been put on wait queue.
+ * Only while neither a writer nor a waiter is there, so that spinning
+ * readers never get ahead of a queued writer.
+ */
+static inline bool rwsem_try_read_lock_unqueued(struct rw_semaphore *sem)
+{
+	long old, count = atomic_long_read(&sem->count);
+
+	while (count >= 0) {
+		old = atomic_long_cmpxchg_acquire(&sem->count, count,
+				      count + RWSEM_ACTIVE_READ_BIAS);
+		if (old == count) {
+			rwsem_set_reader_owned(sem);
+			return true;
+		}
+
+		count = old;
+	}
+	return false;
+}
+
 static inline bool rwsem_can_spin_on_owner(struct rw_semaphore *sem)
 {
-	struct task_struct *owner;
+	struct task_struct *owner, *writer;
 	bool ret = true;
 
 	if (need_resched())
@@ -357,7 +502,13 @@ static inline bool rwsem_can_spin_on_owner(struct rw_semaphore *sem)
 
 	rcu_read_lock();
 	owner = READ_ONCE(sem->owner);
-	if (!rwsem_owner_is_writer(owner)) {
+	if (rwsem_owner_has_handoff(owner)) {
+		ret = false;
+		goto done;
+	}
+
+	writer = rwsem_owner_writer(owner);
+	if (!writer) {
 		/*
 		 * Don't spin if the rwsem is readers owned.
 		 */
@@ -369,20 +520,31 @@ static inline bool rwsem_can_spin_on_owner(struct rw_semaphore *sem)
 	 * As lock holder preemption issue, we both skip spinning if task is not
 	 * on cpu or its cpu is preempted
 	 */
-	ret = owner->on_cpu && !vcpu_is_preempted(task_cpu(owner));
+	ret = writer->on_cpu && !vcpu_is_preempted(task_cpu(writer));
 done:
 	rcu_read_unlock();
 	return ret;
 }
 
+/*
+ * Readers only spin on a writer, there is no telling whether the readers
+ * holding the lock are running.
+ */
+static bool rwsem_reader_can_spin(struct rw_semaphore *sem)
+{
+	return rwsem_owner_is_writer(READ_ONCE(sem->owner)) &&
+	       rwsem_can_spin_on_owner(sem);
+}
+
 /*
  * Return true only if we can still spin on the owner field of the rwsem.
  */
 static noinline bool rwsem_spin_on_owner(struct rw_semaphore *sem)
 {
 	struct task_struct *owner = READ_ONCE(sem->owner);
+	struct task_struct *writer = rwsem_owner_writer(owner);
 
-	if (!rwsem_owner_is_writer(owner))
+	if (!writer)
 		goto out;
 
 	rcu_read_lock();
@@ -399,8 +561,8 @@ static noinline bool rwsem_spin_on_owner(struct rw_semaphore *sem)
 		 * abort spinning when need_resched or owner is not running or
 		 * owner's cpu is preempted.
 		 */
-		if (!owner->on_cpu || need_resched() ||
-				vcpu_is_preempted(task_cpu(owner))) {
+		if (!writer->on_cpu || need_resched() ||
+				vcpu_is_preempted(task_cpu(writer))) {
 			rcu_read_unlock();
 			return false;
 		}
@@ -411,12 +573,13 @@ static noinline bool rwsem_spin_on_owner(struct rw_semaphore *sem)
 out:
 	/*
 	 * If there is a new owner or the owner is not set, we continue
-	 * spinning.
+	 * spinning, unless a waiting writer asked for a handoff.
 	 */
-	return !rwsem_owner_is_reader(READ_ONCE(sem->owner));
+	owner = READ_ONCE(sem->owner);
+	return !rwsem_owner_is_reader(owner) && !rwsem_owner_has_handoff(owner);
 }
 
-static bool rwsem_optimistic_spin(struct rw_semaphore *sem)
+static bool rwsem_optimistic_spin(struct rw_semaphore *sem, bool reader)
 {
 	bool taken = false;
 
@@ -429,12 +592,28 @@ static bool rwsem_optimistic_spin(struct rw_semaphore *sem)
 	if (!osq_lock(&sem->osq))
 		goto done;
 
+	/*
+	 * A reader takes the lock as soon as the writer it spins on
+	 * releases it, and gives up once no writer owns it.
+	 */
+	if (reader) {
+		while (!rwsem_try_read_lock_unqueued(sem)) {
+			if (!rwsem_owner_is_writer(READ_ONCE(sem->owner)) ||
+			    !rwsem_spin_on_owner(sem))
+				goto unlock;
+			cpu_relax();
+		}
+		taken = true;
+		goto unlock;
+	}
+
 	/*
 	 * Optimistically spin on the owner field and attempt to acquire the
 	 * lock whenever the owner changes. Spinning will be stopped when:
 	 *  1) the owning writer isn't running; or
 	 *  2) readers own the lock as we can't determine if they are
-	 *     actively running or not.
+	 *     actively running or not; or
+	 *  3) the writer at the head of the queue asked for a handoff.
 	 */
 	while (rwsem_spin_on_owner(sem)) {
 		/*
@@ -451,7 +630,9 @@ static bool rwsem_optimistic_spin(struct rw_semaphore *sem)
 		 * we're an RT task that will live-lock because we won't let
 		 * the owner complete.
 		 */
-		if (!sem->owner && (need_resched() || rt_task(current)))
+		if (!((unsigned long)READ_ONCE(sem->owner) &
+		      ~RWSEM_WRITER_HANDOFF) &&
+		    (need_resched() || rt_task(current)))
 			break;
 
 		/*
@@ -462,7 +643,13 @@ static bool rwsem_optimistic_spin(struct rw_semaphore *sem)
 		 */
 		cpu_relax();
 	}
+unlock:
 	osq_unlock(&sem->osq);
+	if (taken)
+		rwsem_stat_inc(reader ? RWSEM_STAT_READ_SPIN :
+					RWSEM_STAT_WRITE_SPIN);
+	else
+		rwsem_stat_inc(RWSEM_STAT_SPIN_FAIL);
 done:
 	preempt_enable();
 	return taken;
@@ -477,7 +664,12 @@ static inline bool rwsem_has_spinner(struct rw_semaphore *sem)
 }
 
 #else
-static bool rwsem_optimistic_spin(struct rw_semaphore *sem)
+static bool rwsem_reader_can_spin(struct rw_semaphore *sem)
+{
+	return false;
+}
+
+static bool rwsem_optimistic_spin(struct rw_semaphore *sem, bool reader)
 {
 	return false;
 }
@@ -486,8 +678,23 @@ static inline bool rwsem_has_spinner(struct rw_semaphore *sem)
 {
 	return false;
 }
+
+static inline bool rwsem_set_handoff(struct rw_semaphore *sem)
+{
+	return false;
+}
+
+static inline void rwsem_clear_handoff(struct rw_semaphore *sem)
+{
+}
 #endif
 
+/*
+ * How long the writer at the head of the queue lets spinners steal the
+ * lock from it before asking for a handoff
+ */
+#define RWSEM_HANDOFF_TIMEOUT	DIV_ROUND_UP(HZ, 250)
+
 /*
  * Wait until we successfully acquire the write lock
  */
@@ -496,21 +703,26 @@ __rwsem_down_write_failed_common(struct rw_semaphore *sem, int state)
 {
 	long count;
 	bool waiting = true; /* any queued threads before us */
+	bool handoff = false;
+	unsigned long timeout;
 	struct rwsem_waiter waiter;
 	struct rw_semaphore *ret = sem;
+	u64 sample;
 	DEFINE_WAKE_Q(wake_q);
 
 	/* undo write bias from down_write operation, stop active locking */
 	count = atomic_long_sub_return(RWSEM_ACTIVE_WRITE_BIAS, &sem->count);
 
 	/* do optimistic spinning and steal lock if possible */
-	if (rwsem_optimistic_spin(sem))
+	if (rwsem_optimistic_spin(sem, false))
 		return sem;
 
 	/*
 	 * Optimistic spinning failed, proceed to the slowpath
 	 * and block until we can acquire the sem.
 	 */
+	sample = lock_sample_begin();
+	timeout = jiffies + RWSEM_HANDOFF_TIMEOUT;
 	waiter.task = current;
 	waiter.type = RWSEM_WAITING_FOR_WRITE;
 
@@ -556,6 +768,12 @@ __rwsem_down_write_failed_common(struct rw_semaphore *sem, int state)
 	while (true) {
 		if (rwsem_try_write_lock(count, sem))
 			break;
+
+		/* Keep the spinners from starving the first waiting writer */
+		if (!handoff && time_after(jiffies, timeout) &&
+		    list_first_entry(&sem->wait_list, struct rwsem_waiter,
+				     list) == &waiter)
+			handoff = rwsem_set_handoff(sem);
 		raw_spin_unlock_irq(&sem->wait_lock);
 
 		/* Block until there are no active lockers. */
@@ -572,12 +790,15 @@ __rwsem_down_write_failed_common(struct rw_semaphore *sem, int state)
 	__set_current_state(TASK_RUNNING);
 	list_del(&waiter.list);
 	raw_spin_unlock_irq(&sem->wait_lock);
+	lock_sample_end(sample, sem, _RET_IP_, LOCK_SAMPLE_RWSEM_WRITE);
 
 	return ret;
 
 out_nolock:
 	__set_current_state(TASK_RUNNING);
 	raw_spin_lock_irq(&sem->wait_lock);
+	if (handoff)
+		rwsem_clear_handoff(sem);
 	list_del(&waiter.list);
 	if (list_empty(&sem->wait_list))
 		atomic_long_add(-RWSEM_WAITING_BIAS, &sem->count);
@@ -13,8 +13,14 @@
  *       or not set by owner yet)
  *  3) Other non-zero value
  *     - a writer owns the lock
+ *
+ * On top of that, the RWSEM_WRITER_HANDOFF bit is set by the writer at
+ * the head of the wait queue when it has waited for too long, to keep
+ * optimistic spinners from stealing the lock from it.  It is cleared
+ * when a writer acquires the lock.
  */
 #define RWSEM_READER_OWNED	((struct task_struct *)1UL)
+#define RWSEM_WRITER_HANDOFF	2UL
 
 #ifdef CONFIG_RWSEM_SPIN_ON_OWNER
 /*
@@ -31,28 +37,51 @@ static inline void rwsem_set_owner(struct rw_semaphore *sem)
 
 static inline void rwsem_clear_owner(struct rw_semaphore *sem)
 {
-	WRITE_ONCE(sem->owner, NULL);
+	unsigned long owner = (unsigned long)READ_ONCE(sem->owner);
+
+	/* Keep the handoff of a waiting writer */
+	WRITE_ONCE(sem->owner,
+		   (struct task_struct *)(owner & RWSEM_WRITER_HANDOFF));
 }
 
 static inline void rwsem_set_reader_owned(struct rw_semaphore *sem)
 {
+	unsigned long owner = (unsigned long)READ_ONCE(sem->owner);
+
 	/*
 	 * We check the owner value first to make sure that we will only
 	 * do a write to the rwsem cacheline when it is really necessary
 	 * to minimize cacheline contention.
 	 */
-	if (sem->owner != RWSEM_READER_OWNED)
-		WRITE_ONCE(sem->owner, RWSEM_READER_OWNED);
+	if (!(owner & (unsigned long)RWSEM_READER_OWNED))
+		WRITE_ONCE(sem->owner, (struct task_struct *)
+			   ((owner & RWSEM_WRITER_HANDOFF) |
+			    (unsigned long)RWSEM_READER_OWNED));
+}
+
+/* The writer owning the lock, if any, with the flags masked off */
+static inline struct task_struct *rwsem_owner_writer(struct task_struct *owner)
+{
+	unsigned long v = (unsigned long)owner;
+
+	if (v & (unsigned long)RWSEM_READER_OWNED)
+		return NULL;
+	return (struct task_struct *)(v & ~RWSEM_WRITER_HANDOFF);
 }
 
 static inline bool rwsem_owner_is_writer(struct task_struct *owner)
 {
-	return owner && owner != RWSEM_READER_OWNED;
+	return rwsem_owner_writer(owner) != NULL;
 }
 
 static inline bool rwsem_owner_is_reader(struct task_struct *owner)
 {
-	return owner == RWSEM_READER_OWNED;
+	return (unsigned long)owner & (unsigned long)RWSEM_READER_OWNED;
+}
+
+static inline bool rwsem_owner_has_handoff(struct task_struct *owner)
+{
+	return (unsigned long)owner & RWSEM_WRITER_HANDOFF;
 }
 #else
 static inline void rwsem_set_owner(struct rw_semaphore *sem)
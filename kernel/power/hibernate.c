@@ -38,6 +38,7 @@
 
 
 static int nocompress;
+static unsigned int compress_mode;	/* SF_LZ4_MODE, SF_ZSTD_MODE or 0 for LZO */
 static int noresume;
 static int nohibernate;
 static int resume_wait;
@@ -726,7 +727,7 @@ int hibernate(void)
 		if (nocompress)
 			flags |= SF_NOCOMPRESS_MODE;
 		else
-		        flags |= SF_CRC32_MODE;
+		        flags |= SF_CRC32_MODE | compress_mode;
 
 		pm_pr_dbg("Writing image.\n");
 		error = swsusp_write(flags);
@@ -1154,6 +1155,10 @@ static int __init hibernate_setup(char *str)
 		noresume = 1;
 	} else if (!strncmp(str, "nocompress", 10)) {
 		nocompress = 1;
+	} else if (!strncmp(str, "lz4", 3)) {
+		compress_mode = SF_LZ4_MODE;
+	} else if (!strncmp(str, "zstd", 4)) {
+		compress_mode = SF_ZSTD_MODE;
 	} else if (!strncmp(str, "no", 2)) {
 		noresume = 1;
 		nohibernate = 1;
@@ -27,6 +27,8 @@
 #include <linux/pm.h>
 #include <linux/slab.h>
 #include <linux/lzo.h>
+#include <linux/lz4.h>
+#include <linux/zstd.h>
 #include <linux/vmalloc.h>
 #include <linux/cpumask.h>
 #include <linux/atomic.h>
@@ -224,10 +226,16 @@ int swsusp_swap_in_use(void)
 static unsigned short root_swap = 0xffff;
 static struct block_device *hib_resume_bdev;
 
+/*
+ * Pages for consecutive swap offsets submitted to a batch are gathered
+ * in one bio, that is only submitted once it is full, when the pages of
+ * a non-consecutive offset come, or by hib_flush_batch().
+ */
 struct hib_bio_batch {
 	atomic_t		count;
 	wait_queue_head_t	wait;
 	blk_status_t		error;
+	struct bio		*bio;
 };
 
 static void hib_init_batch(struct hib_bio_batch *hb)
@@ -235,12 +243,23 @@ static void hib_init_batch(struct hib_bio_batch *hb)
 	atomic_set(&hb->count, 0);
 	init_waitqueue_head(&hb->wait);
 	hb->error = BLK_STS_OK;
+	hb->bio = NULL;
+}
+
+static void hib_flush_batch(struct hib_bio_batch *hb)
+{
+	if (hb->bio) {
+		atomic_inc(&hb->count);
+		submit_bio(hb->bio);
+		hb->bio = NULL;
+	}
 }
 
 static void hib_end_io(struct bio *bio)
 {
 	struct hib_bio_batch *hb = bio->bi_private;
-	struct page *page = bio->bi_io_vec[0].bv_page;
+	struct bio_vec *bvec;
+	int i;
 
 	if (bio->bi_status) {
 		pr_alert("Read-error on swap-device (%u:%u:%Lu)\n",
@@ -248,11 +267,16 @@ static void hib_end_io(struct bio *bio)
 			 (unsigned long long)bio->bi_iter.bi_sector);
 	}
 
-	if (bio_data_dir(bio) == WRITE)
-		put_page(page);
-	else if (clean_pages_on_read)
-		flush_icache_range((unsigned long)page_address(page),
-				   (unsigned long)page_address(page) + PAGE_SIZE);
+	bio_for_each_segment_all(bvec, bio, i) {
+		struct page *page = bvec->bv_page;
+
+		if (bio_data_dir(bio) == WRITE)
+			put_page(page);
+		else if (clean_pages_on_read)
+			flush_icache_range((unsigned long)page_address(page),
+					   (unsigned long)page_address(page) +
+					   PAGE_SIZE);
+	}
 
 	if (bio->bi_status && !hb->error)
 		hb->error = bio->bi_status;
@@ -269,7 +293,16 @@ static int hib_submit_io(int op, int op_flags, pgoff_t page_off, void *addr,
 	struct bio *bio;
 	int error = 0;
 
-	bio = bio_alloc(__GFP_RECLAIM | __GFP_HIGH, 1);
+	if (hb && hb->bio) {
+		bio = hb->bio;
+		if (bio_op(bio) == op &&
+		    bio_end_sector(bio) == page_off * (PAGE_SIZE >> 9) &&
+		    bio_add_page(bio, page, PAGE_SIZE, 0) == PAGE_SIZE)
+			return 0;
+		hib_flush_batch(hb);
+	}
+
+	bio = bio_alloc(__GFP_RECLAIM | __GFP_HIGH, hb ? BIO_MAX_PAGES : 1);
 	bio->bi_iter.bi_sector = page_off * (PAGE_SIZE >> 9);
 	bio_set_dev(bio, hib_resume_bdev);
 	bio_set_op_attrs(bio, op, op_flags);
@@ -284,8 +317,7 @@ static int hib_submit_io(int op, int op_flags, pgoff_t page_off, void *addr,
 	if (hb) {
 		bio->bi_end_io = hib_end_io;
 		bio->bi_private = hb;
-		atomic_inc(&hb->count);
-		submit_bio(bio);
+		hb->bio = bio;
 	} else {
 		error = submit_bio_wait(bio);
 		bio_put(bio);
@@ -296,6 +328,7 @@ static int hib_submit_io(int op, int op_flags, pgoff_t page_off, void *addr,
 
 static blk_status_t hib_wait_io(struct hib_bio_batch *hb)
 {
+	hib_flush_batch(hb);
 	wait_event(hb->wait, atomic_read(&hb->count) == 0);
 	return blk_status_to_errno(hb->error);
 }
@@ -517,6 +550,13 @@ static int swap_writer_finish(struct swap_map_handle *handle,
 			             LZO_HEADER, PAGE_SIZE)
 #define LZO_CMP_SIZE	(LZO_CMP_PAGES * PAGE_SIZE)
 
+/* Workspace for the LZO and LZ4 compressors, zstd has its own. */
+#define LZO_WRK_SIZE	(LZO1X_1_MEM_COMPRESS > LZ4_MEM_COMPRESS ? \
+			 LZO1X_1_MEM_COMPRESS : LZ4_MEM_COMPRESS)
+
+/* zstd level, favours speed as the image is written only once. */
+#define HIB_ZSTD_LEVEL	1
+
 /* Maximum number of threads for compression/decompression. */
 #define LZO_THREADS	3
 
@@ -615,7 +655,7 @@ static int crc32_threadfn(void *data)
 	return 0;
 }
 /**
- * Structure used for LZO data compression.
+ * Structure used for LZO, LZ4 or zstd data compression.
  */
 struct cmp_data {
 	struct task_struct *thr;                  /* thread */
@@ -626,11 +666,37 @@ struct cmp_data {
 	wait_queue_head_t done;                   /* compression done */
 	size_t unc_len;                           /* uncompressed length */
 	size_t cmp_len;                           /* compressed length */
+	unsigned int flags;                       /* SF_LZ4/ZSTD_MODE */
+	ZSTD_CCtx *cctx;                          /* zstd context */
+	void *zstd_wrk;                           /* zstd workspace */
 	unsigned char unc[LZO_UNC_SIZE];          /* uncompressed buffer */
 	unsigned char cmp[LZO_CMP_SIZE];          /* compressed buffer */
-	unsigned char wrk[LZO1X_1_MEM_COMPRESS];  /* compression workspace */
+	unsigned char wrk[LZO_WRK_SIZE];          /* compression workspace */
 };
 
+static int hib_compress(struct cmp_data *d)
+{
+	size_t max_len = LZO_CMP_SIZE - LZO_HEADER;
+	int ret;
+
+	if (d->flags & SF_LZ4_MODE) {
+		ret = LZ4_compress_default(d->unc, d->cmp + LZO_HEADER,
+					   d->unc_len, max_len, d->wrk);
+		d->cmp_len = max(ret, 0);
+		return ret > 0 ? 0 : -1;
+	}
+
+	if (d->flags & SF_ZSTD_MODE) {
+		d->cmp_len = ZSTD_compressCCtx(d->cctx, d->cmp + LZO_HEADER,
+				max_len, d->unc, d->unc_len,
+				ZSTD_getParams(HIB_ZSTD_LEVEL, LZO_UNC_SIZE, 0));
+		return ZSTD_isError(d->cmp_len) ? -1 : 0;
+	}
+
+	return lzo1x_1_compress(d->unc, d->unc_len, d->cmp + LZO_HEADER,
+				&d->cmp_len, d->wrk);
+}
+
 /**
  * Compression function that runs in its own thread.
  */
@@ -650,9 +716,7 @@ static int lzo_compress_threadfn(void *data)
 		}
 		atomic_set(&d->ready, 0);
 
-		d->ret = lzo1x_1_compress(d->unc, d->unc_len,
-		                          d->cmp + LZO_HEADER, &d->cmp_len,
-		                          d->wrk);
+		d->ret = hib_compress(d);
 		atomic_set(&d->stop, 1);
 		wake_up(&d->done);
 	}
@@ -664,10 +728,11 @@ static int lzo_compress_threadfn(void *data)
  * @handle: Swap map handle to use for saving the image.
  * @snapshot: Image to read data from.
  * @nr_to_write: Number of pages to save.
+ * @flags: Image flags, SF_LZ4_MODE or SF_ZSTD_MODE select another compressor.
  */
 static int save_image_lzo(struct swap_map_handle *handle,
                           struct snapshot_handle *snapshot,
-                          unsigned int nr_to_write)
+                          unsigned int nr_to_write, unsigned int flags)
 {
 	unsigned int m;
 	int ret = 0;
@@ -704,8 +769,28 @@ static int save_image_lzo(struct swap_map_handle *handle,
 		ret = -ENOMEM;
 		goto out_clean;
 	}
-	for (thr = 0; thr < nr_threads; thr++)
+	for (thr = 0; thr < nr_threads; thr++) {
 		memset(&data[thr], 0, offsetof(struct cmp_data, go));
+		data[thr].flags = flags;
+		data[thr].zstd_wrk = NULL;
+	}
+
+	if (flags & SF_ZSTD_MODE) {
+		ZSTD_parameters params = ZSTD_getParams(HIB_ZSTD_LEVEL,
+							LZO_UNC_SIZE, 0);
+		size_t wrk_size = ZSTD_CCtxWorkspaceBound(params.cParams);
+
+		for (thr = 0; thr < nr_threads; thr++) {
+			data[thr].zstd_wrk = vmalloc(wrk_size);
+			if (!data[thr].zstd_wrk) {
+				pr_err("Failed to allocate zstd workspace\n");
+				ret = -ENOMEM;
+				goto out_clean;
+			}
+			data[thr].cctx = ZSTD_initCCtx(data[thr].zstd_wrk,
+						       wrk_size);
+		}
+	}
 
 	crc = kmalloc(sizeof(*crc), GFP_KERNEL);
 	if (!crc) {
@@ -862,9 +947,11 @@ static int save_image_lzo(struct swap_map_handle *handle,
 		kfree(crc);
 	}
 	if (data) {
-		for (thr = 0; thr < nr_threads; thr++)
+		for (thr = 0; thr < nr_threads; thr++) {
 			if (data[thr].thr)
 				kthread_stop(data[thr].thr);
+			vfree(data[thr].zstd_wrk);
+		}
 		vfree(data);
 	}
 	if (page) free_page((unsigned long)page);
@@ -934,7 +1021,7 @@ int swsusp_write(unsigned int flags)
 	if (!error) {
 		error = (flags & SF_NOCOMPRESS_MODE) ?
 			save_image(&handle, &snapshot, pages - 1) :
-			save_image_lzo(&handle, &snapshot, pages - 1);
+			save_image_lzo(&handle, &snapshot, pages - 1, flags);
 	}
 out_finish:
 	error = swap_writer_finish(&handle, flags, error);
@@ -1101,7 +1188,7 @@ static int load_image(struct swap_map_handle *handle,
 }
 
 /**
- * Structure used for LZO data decompression.
+ * Structure used for LZO, LZ4 or zstd data decompression.
  */
 struct dec_data {
 	struct task_struct *thr;                  /* thread */
@@ -1112,10 +1199,40 @@ struct dec_data {
 	wait_queue_head_t done;                   /* decompression done */
 	size_t unc_len;                           /* uncompressed length */
 	size_t cmp_len;                           /* compressed length */
+	unsigned int flags;                       /* SF_LZ4/ZSTD_MODE */
+	ZSTD_DCtx *dctx;                          /* zstd context */
+	void *zstd_wrk;                           /* zstd workspace */
 	unsigned char unc[LZO_UNC_SIZE];          /* uncompressed buffer */
 	unsigned char cmp[LZO_CMP_SIZE];          /* compressed buffer */
 };
 
+static int hib_decompress(struct dec_data *d)
+{
+	int ret;
+
+	if (d->flags & SF_LZ4_MODE) {
+		ret = LZ4_decompress_safe(d->cmp + LZO_HEADER, d->unc,
+					  d->cmp_len, LZO_UNC_SIZE);
+		d->unc_len = max(ret, 0);
+		return ret < 0 ? -1 : 0;
+	}
+
+	if (d->flags & SF_ZSTD_MODE) {
+		d->unc_len = ZSTD_decompressDCtx(d->dctx, d->unc, LZO_UNC_SIZE,
+						 d->cmp + LZO_HEADER,
+						 d->cmp_len);
+		if (ZSTD_isError(d->unc_len)) {
+			d->unc_len = 0;
+			return -1;
+		}
+		return 0;
+	}
+
+	d->unc_len = LZO_UNC_SIZE;
+	return lzo1x_decompress_safe(d->cmp + LZO_HEADER, d->cmp_len,
+				     d->unc, &d->unc_len);
+}
+
 /**
  * Deompression function that runs in its own thread.
  */
@@ -1135,9 +1252,7 @@ static int lzo_decompress_threadfn(void *data)
 		}
 		atomic_set(&d->ready, 0);
 
-		d->unc_len = LZO_UNC_SIZE;
-		d->ret = lzo1x_decompress_safe(d->cmp + LZO_HEADER, d->cmp_len,
-		                               d->unc, &d->unc_len);
+		d->ret = hib_decompress(d);
 		if (clean_pages_on_decompress)
 			flush_icache_range((unsigned long)d->unc,
 					   (unsigned long)d->unc + d->unc_len);
@@ -1153,10 +1268,11 @@ static int lzo_decompress_threadfn(void *data)
  * @handle: Swap map handle to use for loading data.
  * @snapshot: Image to copy uncompressed data into.
  * @nr_to_read: Number of pages to load.
+ * @flags: Image flags, SF_LZ4_MODE or SF_ZSTD_MODE select another compressor.
  */
 static int load_image_lzo(struct swap_map_handle *handle,
                           struct snapshot_handle *snapshot,
-                          unsigned int nr_to_read)
+                          unsigned int nr_to_read, unsigned int flags)
 {
 	unsigned int m;
 	int ret = 0;
@@ -1196,8 +1312,26 @@ static int load_image_lzo(struct swap_map_handle *handle,
 		ret = -ENOMEM;
 		goto out_clean;
 	}
-	for (thr = 0; thr < nr_threads; thr++)
+	for (thr = 0; thr < nr_threads; thr++) {
 		memset(&data[thr], 0, offsetof(struct dec_data, go));
+		data[thr].flags = flags;
+		data[thr].zstd_wrk = NULL;
+	}
+
+	if (flags & SF_ZSTD_MODE) {
+		size_t wrk_size = ZSTD_DCtxWorkspaceBound();
+
+		for (thr = 0; thr < nr_threads; thr++) {
+			data[thr].zstd_wrk = vmalloc(wrk_size);
+			if (!data[thr].zstd_wrk) {
+				pr_err("Failed to allocate zstd workspace\n");
+				ret = -ENOMEM;
+				goto out_clean;
+			}
+			data[thr].dctx = ZSTD_initDCtx(data[thr].zstd_wrk,
+						       wrk_size);
+		}
+	}
 
 	crc = kmalloc(sizeof(*crc), GFP_KERNEL);
 	if (!crc) {
@@ -1313,6 +1447,9 @@ static int load_image_lzo(struct swap_map_handle *handle,
 		asked += i;
 		want -= i;
 
+		/* Keep the disk busy while the threads decompress */
+		hib_flush_batch(&hb);
+
 		/*
 		 * We are out of data, wait for some more.
 		 */
@@ -1458,9 +1595,11 @@ static int load_image_lzo(struct swap_map_handle *handle,
 		kfree(crc);
 	}
 	if (data) {
-		for (thr = 0; thr < nr_threads; thr++)
+		for (thr = 0; thr < nr_threads; thr++) {
 			if (data[thr].thr)
 				kthread_stop(data[thr].thr);
+			vfree(data[thr].zstd_wrk);
+		}
 		vfree(data);
 	}
 	vfree(page);
@@ -1494,7 +1633,8 @@ int swsusp_read(unsigned int *flags_p)
 	if (!error) {
 		error = (*flags_p & SF_NOCOMPRESS_MODE) ?
 			load_image(&handle, &snapshot, header->pages - 1) :
-			load_image_lzo(&handle, &snapshot, header->pages - 1);
+			load_image_lzo(&handle, &snapshot, header->pages - 1,
+				       *flags_p);
 	}
 	swap_reader_finish(&handle);
 end:
@@ -1740,6 +1740,13 @@ static void increment_cpu_stall_ticks(void)
  * Offloading of callback processing could also in theory be used as
  * an energy-efficiency measure because CPUs with no RCU callbacks
  * queued are more aggressive about entering dyntick-idle mode.
+ *
+ * While the set of no-CBs CPUs is fixed at boot, the CPUs the rcuo
+ * kthreads run on can be changed at any time through the
+ * rcutree.nocb_kthread_cpus parameter.  This lets userspace keep
+ * callback invocation off the CPUs running latency-critical tasks,
+ * for example those of the top-app cpuset on Android, by offloading
+ * all CPUs at boot and writing the remaining housekeeping CPUs there.
  */
 
 
@@ -2331,6 +2338,63 @@ static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp)
 		    (unsigned long)rdp);
 }
 
+/*
+ * CPUs the rcuo kthreads are confined to, if set through
+ * rcutree.nocb_kthread_cpus.  The mutex also keeps the rebinding of the
+ * existing kthreads from racing with the spawning of new ones.
+ */
+static struct cpumask rcu_nocb_kthread_cpus;
+static bool rcu_nocb_kthread_cpus_set;
+static DEFINE_MUTEX(rcu_nocb_kthread_cpus_mutex);
+
+/* Static, as the parameter can be set before the slab allocator is up */
+static int param_set_nocb_kthread_cpus(const char *val,
+				       const struct kernel_param *kp)
+{
+	static struct cpumask new;
+	struct rcu_state *rsp;
+	struct task_struct *t;
+	int cpu, ret;
+
+	mutex_lock(&rcu_nocb_kthread_cpus_mutex);
+	ret = cpulist_parse(val, &new);
+	if (!ret && !cpumask_intersects(&new, cpu_online_mask))
+		ret = -EINVAL;
+	if (ret)
+		goto out;
+
+	cpumask_copy(&rcu_nocb_kthread_cpus, &new);
+	rcu_nocb_kthread_cpus_set = true;
+	if (have_rcu_nocb_mask) {
+		for_each_rcu_flavor(rsp) {
+			for_each_cpu(cpu, rcu_nocb_mask) {
+				t = per_cpu_ptr(rsp->rda, cpu)->nocb_kthread;
+				if (t)
+					set_cpus_allowed_ptr(t, &new);
+			}
+		}
+	}
+out:
+	mutex_unlock(&rcu_nocb_kthread_cpus_mutex);
+	return ret;
+}
+
+static int param_get_nocb_kthread_cpus(char *buffer,
+				       const struct kernel_param *kp)
+{
+	const struct cpumask *mask = cpu_possible_mask;
+
+	if (rcu_nocb_kthread_cpus_set)
+		mask = &rcu_nocb_kthread_cpus;
+	return scnprintf(buffer, PAGE_SIZE, "%*pbl\n", cpumask_pr_args(mask));
+}
+
+static const struct kernel_param_ops nocb_kthread_cpus_ops = {
+	.set = param_set_nocb_kthread_cpus,
+	.get = param_get_nocb_kthread_cpus,
+};
+module_param_cb(nocb_kthread_cpus, &nocb_kthread_cpus_ops, NULL, 0644);
+
 /*
  * If the specified CPU is a no-CBs CPU that does not already have its
  * rcuo kthread for the specified RCU flavor, spawn it.  If the CPUs are
@@ -2373,10 +2437,15 @@ static void rcu_spawn_one_nocb_kthread(struct rcu_state *rsp, int cpu)
 	}
 
 	/* Spawn the kthread for this CPU and RCU flavor. */
-	t = kthread_run(rcu_nocb_kthread, rdp_spawn,
-			"rcuo%c/%d", rsp->abbr, cpu);
+	t = kthread_create(rcu_nocb_kthread, rdp_spawn,
+			   "rcuo%c/%d", rsp->abbr, cpu);
 	BUG_ON(IS_ERR(t));
+	mutex_lock(&rcu_nocb_kthread_cpus_mutex);
+	if (rcu_nocb_kthread_cpus_set)
+		set_cpus_allowed_ptr(t, &rcu_nocb_kthread_cpus);
 	WRITE_ONCE(rdp_spawn->nocb_kthread, t);
+	mutex_unlock(&rcu_nocb_kthread_cpus_mutex);
+	wake_up_process(t);
 }
 
 /*
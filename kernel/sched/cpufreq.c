@@ -11,6 +11,8 @@
 
 #include "sched.h"
 
+unsigned long boosted_cpu_util(int cpu);
+
 DEFINE_PER_CPU(struct update_util_data *, cpufreq_update_util_data);
 
 /**
@@ -61,3 +63,37 @@ void cpufreq_remove_update_util_hook(int cpu)
 	rcu_assign_pointer(per_cpu(cpufreq_update_util_data, cpu), NULL);
 }
 EXPORT_SYMBOL_GPL(cpufreq_remove_update_util_hook);
+
+/**
+ * cpufreq_get_sched_util - Get the utilization of a CPU.
+ * @cpu: The CPU to get the utilization of.
+ * @max: Where to store the capacity of @cpu.
+ *
+ * Return the WALT or PELT utilization of @cpu, including its SchedTune boost
+ * margin, as schedutil selects frequencies from.  For governors driven by
+ * the update_util hooks rather than by sampling idle time.
+ */
+unsigned long cpufreq_get_sched_util(int cpu, unsigned long *max)
+{
+	*max = arch_scale_cpu_capacity(NULL, cpu);
+
+	return min(boosted_cpu_util(cpu), *max);
+}
+EXPORT_SYMBOL_GPL(cpufreq_get_sched_util);
+
+/**
+ * cpufreq_sched_util_invariant - Whether the utilization is frequency invariant.
+ *
+ * If so, cpufreq_get_sched_util() is relative to the highest frequency of the
+ * CPU, otherwise to its current one.
+ */
+bool cpufreq_sched_util_invariant(void)
+{
+#ifdef CONFIG_SCHED_WALT
+	/* WALT scales the busy time with the frequency it was spent at */
+	if (!walt_disabled && sysctl_sched_use_walt_cpu_util)
+		return true;
+#endif
+	return arch_scale_freq_invariant();
+}
+EXPORT_SYMBOL_GPL(cpufreq_sched_util_invariant);
@@ -20,11 +20,6 @@
 
 unsigned long boosted_cpu_util(int cpu);
 
-/* Stub out fast switch routines present on mainline to reduce the backport
- * overhead. */
-#define cpufreq_driver_fast_switch(x, y) 0
-#define cpufreq_enable_fast_switch(x)
-#define cpufreq_disable_fast_switch(x)
 #define LATENCY_MULTIPLIER			(1000)
 
 struct sugov_tunables {
@@ -46,6 +41,13 @@ struct sugov_policy {
 	s64 down_rate_delay_ns;
 	unsigned int next_freq;
 	unsigned int cached_raw_freq;
+	u64 last_eval_time;  /* For shared policies */
+
+	/* Frequency requests made, and skipped by reason */
+	unsigned long nr_freq_updates;
+	unsigned long nr_skipped_redundant;
+	unsigned long nr_skipped_rate_limit;
+	unsigned long nr_skipped_coalesced;
 
 	/* The next fields are only needed if fast switch cannot be used. */
 	struct irq_work irq_work;
@@ -120,23 +122,31 @@ static void sugov_update_commit(struct sugov_policy *sg_policy, u64 time,
 {
 	struct cpufreq_policy *policy = sg_policy->policy;
 
-	if (sugov_up_down_rate_limit(sg_policy, time, next_freq))
+	/* Don't bother the driver with the frequency it already runs at */
+	if (sg_policy->next_freq == next_freq) {
+		sg_policy->nr_skipped_redundant++;
+		if (policy->fast_switch_enabled)
+			trace_cpu_frequency(policy->cur, smp_processor_id());
+		return;
+	}
+
+	if (sugov_up_down_rate_limit(sg_policy, time, next_freq)) {
+		sg_policy->nr_skipped_rate_limit++;
 		return;
+	}
+
+	sg_policy->nr_freq_updates++;
 
 	if (policy->fast_switch_enabled) {
-		if (sg_policy->next_freq == next_freq) {
-			trace_cpu_frequency(policy->cur, smp_processor_id());
-			return;
-		}
 		sg_policy->next_freq = next_freq;
 		sg_policy->last_freq_update_time = time;
 		next_freq = cpufreq_driver_fast_switch(policy, next_freq);
-		if (next_freq == CPUFREQ_ENTRY_INVALID)
+		if (!next_freq)
 			return;
 
 		policy->cur = next_freq;
 		trace_cpu_frequency(next_freq, smp_processor_id());
-	} else if (sg_policy->next_freq != next_freq) {
+	} else {
 		sg_policy->next_freq = next_freq;
 		sg_policy->last_freq_update_time = time;
 		sg_policy->work_in_progress = true;
@@ -321,6 +331,24 @@ static unsigned int sugov_next_freq_shared(struct sugov_cpu *sg_cpu,
 	return get_next_freq(sg_cpu, util, max);
 }
 
+/*
+ * All the cpus of a shared policy update it in turn: look at them all at
+ * most once per rate limit window, unless limits changed or a deadline
+ * task needs the maximum frequency.
+ */
+static bool sugov_coalesce_shared(struct sugov_policy *sg_policy, u64 time,
+				  unsigned int flags)
+{
+	if (flags & SCHED_CPUFREQ_DL || sg_policy->next_freq == UINT_MAX)
+		return false;
+
+	if (time - sg_policy->last_eval_time >= sg_policy->min_rate_limit_ns)
+		return false;
+
+	sg_policy->nr_skipped_coalesced++;
+	return true;
+}
+
 static void sugov_update_shared(struct update_util_data *hook, u64 time,
 				unsigned int flags)
 {
@@ -340,7 +368,9 @@ static void sugov_update_shared(struct update_util_data *hook, u64 time,
 	sugov_set_iowait_boost(sg_cpu, time, flags);
 	sg_cpu->last_update = time;
 
-	if (sugov_should_update_freq(sg_policy, time)) {
+	if (sugov_should_update_freq(sg_policy, time) &&
+	    !sugov_coalesce_shared(sg_policy, time, flags)) {
+		sg_policy->last_eval_time = time;
 		next_f = sugov_next_freq_shared(sg_cpu, util, max, flags);
 		sugov_update_commit(sg_policy, time, next_f);
 	}
@@ -442,12 +472,35 @@ static ssize_t down_rate_limit_us_store(struct gov_attr_set *attr_set,
 	return count;
 }
 
+/* Statistics, summed over the policies sharing the tunables */
+#define sugov_show_stat(file_name, field)				\
+static ssize_t file_name##_show(struct gov_attr_set *attr_set, char *buf) \
+{									\
+	struct sugov_policy *sg_policy;					\
+	unsigned long sum = 0;						\
+									\
+	list_for_each_entry(sg_policy, &attr_set->policy_list, tunables_hook) \
+		sum += READ_ONCE(sg_policy->field);			\
+									\
+	return sprintf(buf, "%lu\n", sum);				\
+}									\
+static struct governor_attr file_name = __ATTR_RO(file_name)
+
+sugov_show_stat(freq_updates, nr_freq_updates);
+sugov_show_stat(skipped_redundant, nr_skipped_redundant);
+sugov_show_stat(skipped_rate_limit, nr_skipped_rate_limit);
+sugov_show_stat(skipped_coalesced, nr_skipped_coalesced);
+
 static struct governor_attr up_rate_limit_us = __ATTR_RW(up_rate_limit_us);
 static struct governor_attr down_rate_limit_us = __ATTR_RW(down_rate_limit_us);
 
 static struct attribute *sugov_attributes[] = {
 	&up_rate_limit_us.attr,
 	&down_rate_limit_us.attr,
+	&freq_updates.attr,
+	&skipped_redundant.attr,
+	&skipped_rate_limit.attr,
+	&skipped_coalesced.attr,
 	NULL
 };
 
@@ -541,7 +594,11 @@ static int sugov_init(struct cpufreq_policy *policy)
 	tunables->up_rate_limit_us = LATENCY_MULTIPLIER;
 	tunables->down_rate_limit_us = LATENCY_MULTIPLIER;
 	lat = policy->cpuinfo.transition_latency / NSEC_PER_USEC;
-	if (lat) {
+	if (policy->transition_delay_us) {
+		/* Drivers that switch fast know best, e.g. intel_cpufreq */
+		tunables->up_rate_limit_us = policy->transition_delay_us;
+		tunables->down_rate_limit_us = policy->transition_delay_us;
+	} else if (lat) {
 		tunables->up_rate_limit_us *= lat;
 		tunables->down_rate_limit_us *= lat;
 	}
@@ -608,6 +665,7 @@ static int sugov_start(struct cpufreq_policy *policy)
 	sg_policy->work_in_progress = false;
 	sg_policy->need_freq_update = false;
 	sg_policy->cached_raw_freq = 0;
+	sg_policy->last_eval_time = 0;
 
 	for_each_cpu(cpu, policy->cpus) {
 		struct sugov_cpu *sg_cpu = &per_cpu(sugov_cpu, cpu);
@@ -5,6 +5,7 @@
 #include <linux/static_key.h>
 #include <linux/context_tracking.h>
 #include <linux/sched/cputime.h>
+#include <linux/uid_sys_stats.h>
 #include "sched.h"
 #include "walt.h"
 
@@ -145,6 +146,8 @@ void account_user_time(struct task_struct *p, u64 cputime)
 	/* Add user time to cpustat. */
 	task_group_account_field(p, index, cputime);
 
+	uid_sys_stats_account(p, cputime, true);
+
 	/* Account for user time used */
 	acct_account_cputime(p);
 }
@@ -162,6 +165,7 @@ void account_guest_time(struct task_struct *p, u64 cputime)
 	p->utime += cputime;
 	account_group_user_time(p, cputime);
 	p->gtime += cputime;
+	uid_sys_stats_account(p, cputime, true);
 
 	/* Add guest time to cpustat. */
 	if (task_nice(p) > 0) {
@@ -189,6 +193,8 @@ void account_system_index_time(struct task_struct *p,
 	/* Add system time to cpustat. */
 	task_group_account_field(p, index, cputime);
 
+	uid_sys_stats_account(p, cputime, false);
+
 	/* Account for system time used */
 	acct_account_cputime(p);
 }
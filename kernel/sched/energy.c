@@ -20,6 +20,7 @@
 
 #define DEBUG
 
+#include <linux/cache.h>
 #include <linux/gfp.h>
 #include <linux/of.h>
 #include <linux/printk.h>
@@ -27,34 +28,125 @@
 #include <linux/sched/topology.h>
 #include <linux/sched_energy.h>
 #include <linux/stddef.h>
+#include <linux/string.h>
 
 struct sched_group_energy *sge_array[NR_CPUS][NR_SD_LEVELS];
 
+/* The cpus of a cluster share the tables, see sge_find_shared() */
+static bool sge_is_shared(int cpu, int sd_level)
+{
+	int i;
+
+	for_each_possible_cpu(i) {
+		if (i == cpu)
+			return false;
+		if (sge_array[i][sd_level] == sge_array[cpu][sd_level])
+			return true;
+	}
+	return false;
+}
+
 static void free_resources(void)
 {
 	int cpu, sd_level;
-	struct sched_group_energy *sge;
 
 	for_each_possible_cpu(cpu) {
 		for_each_possible_sd_level(sd_level) {
-			sge = sge_array[cpu][sd_level];
-			if (sge) {
-				kfree(sge->cap_states);
-				kfree(sge->idle_states);
-				kfree(sge);
-			}
+			if (!sge_is_shared(cpu, sd_level))
+				kfree(sge_array[cpu][sd_level]);
 		}
 	}
+
+	for_each_possible_cpu(cpu) {
+		for_each_possible_sd_level(sd_level)
+			sge_array[cpu][sd_level] = NULL;
+	}
+}
+
+/*
+ * The tables of a group are laid out in a single block, each part
+ * starting on a cache line, so that evaluating the energy of a group
+ * touches as few lines as possible:
+ *
+ *   sched_group_energy | cap_states[] | idle_states[] | cap_idx_lut[]
+ */
+static struct sched_group_energy *sge_alloc(int nr_cap_states,
+					    int nr_idle_states)
+{
+	size_t sge_size = L1_CACHE_ALIGN(sizeof(struct sched_group_energy));
+	size_t cap_size = L1_CACHE_ALIGN(nr_cap_states *
+					 sizeof(struct capacity_state));
+	size_t idle_size = L1_CACHE_ALIGN(nr_idle_states *
+					  sizeof(struct idle_state));
+	struct sched_group_energy *sge;
+	void *p;
+
+	sge = kzalloc(sge_size + cap_size + idle_size +
+		      L1_CACHE_ALIGN(SGE_CAP_LUT_SIZE), GFP_NOWAIT);
+	if (!sge)
+		return NULL;
+
+	p = (void *)sge + sge_size;
+	sge->nr_cap_states = nr_cap_states;
+	sge->cap_states = p;
+	p += cap_size;
+	sge->nr_idle_states = nr_idle_states;
+	sge->idle_states = p;
+	p += idle_size;
+	sge->cap_idx_lut = p;
+
+	return sge;
+}
+
+/*
+ * For each utilization bucket, the first capacity state able to hold
+ * the bottom of the bucket; capacity states are sorted by capacity.
+ */
+static void sge_init_cap_idx_lut(struct sched_group_energy *sge)
+{
+	u8 *lut = (u8 *)sge->cap_idx_lut;
+	unsigned int idx = 0;
+	int i;
+
+	for (i = 0; i < SGE_CAP_LUT_SIZE; i++) {
+		unsigned long util = (unsigned long)i << SGE_CAP_LUT_SHIFT;
+
+		while (idx < sge->nr_cap_states &&
+		       sge->cap_states[idx].cap < util)
+			idx++;
+		lut[i] = idx;
+	}
+}
+
+/* An identical table already parsed for another cpu at this level */
+static struct sched_group_energy *sge_find_shared(int cpu, int sd_level,
+					const struct sched_group_energy *sge)
+{
+	struct sched_group_energy *e;
+	int i;
+
+	for_each_possible_cpu(i) {
+		if (i == cpu)
+			break;
+
+		e = sge_array[i][sd_level];
+		if (e && e->nr_cap_states == sge->nr_cap_states &&
+		    e->nr_idle_states == sge->nr_idle_states &&
+		    !memcmp(e->cap_states, sge->cap_states,
+			    sge->nr_cap_states * sizeof(struct capacity_state)) &&
+		    !memcmp(e->idle_states, sge->idle_states,
+			    sge->nr_idle_states * sizeof(struct idle_state)))
+			return e;
+	}
+	return NULL;
 }
 
 void init_sched_energy_costs(void)
 {
 	struct device_node *cn, *cp;
-	struct capacity_state *cap_states;
-	struct idle_state *idle_states;
-	struct sched_group_energy *sge;
-	const struct property *prop;
-	int sd_level, i, nstates, cpu;
+	struct sched_group_energy *sge, *shared;
+	const struct property *busy, *idle;
+	int sd_level, i, nr_cap_states, nr_idle_states, cpu;
 	const __be32 *val;
 
 	for_each_possible_cpu(cpu) {
@@ -74,44 +166,39 @@ void init_sched_energy_costs(void)
 			if (!cp)
 				break;
 
-			prop = of_find_property(cp, "busy-cost-data", NULL);
-			if (!prop || !prop->value) {
+			busy = of_find_property(cp, "busy-cost-data", NULL);
+			if (!busy || !busy->value) {
 				pr_warn("No busy-cost data, skipping sched_energy init\n");
 				goto out;
 			}
 
-			sge = kcalloc(1, sizeof(struct sched_group_energy),
-				      GFP_NOWAIT);
-
-			nstates = (prop->length / sizeof(u32)) / 2;
-			cap_states = kcalloc(nstates,
-					     sizeof(struct capacity_state),
-					     GFP_NOWAIT);
-
-			for (i = 0, val = prop->value; i < nstates; i++) {
-				cap_states[i].cap = be32_to_cpup(val++);
-				cap_states[i].power = be32_to_cpup(val++);
-			}
-
-			sge->nr_cap_states = nstates;
-			sge->cap_states = cap_states;
-
-			prop = of_find_property(cp, "idle-cost-data", NULL);
-			if (!prop || !prop->value) {
+			idle = of_find_property(cp, "idle-cost-data", NULL);
+			if (!idle || !idle->value) {
 				pr_warn("No idle-cost data, skipping sched_energy init\n");
 				goto out;
 			}
 
-			nstates = (prop->length / sizeof(u32));
-			idle_states = kcalloc(nstates,
-					      sizeof(struct idle_state),
-					      GFP_NOWAIT);
+			nr_cap_states = (busy->length / sizeof(u32)) / 2;
+			nr_idle_states = (idle->length / sizeof(u32));
+			sge = sge_alloc(nr_cap_states, nr_idle_states);
+			if (!sge)
+				goto out;
+
+			for (i = 0, val = busy->value; i < nr_cap_states; i++) {
+				sge->cap_states[i].cap = be32_to_cpup(val++);
+				sge->cap_states[i].power = be32_to_cpup(val++);
+			}
 
-			for (i = 0, val = prop->value; i < nstates; i++)
-				idle_states[i].power = be32_to_cpup(val++);
+			for (i = 0, val = idle->value; i < nr_idle_states; i++)
+				sge->idle_states[i].power = be32_to_cpup(val++);
 
-			sge->nr_idle_states = nstates;
-			sge->idle_states = idle_states;
+			shared = sge_find_shared(cpu, sd_level, sge);
+			if (shared) {
+				kfree(sge);
+				sge = shared;
+			} else {
+				sge_init_cap_idx_lut(sge);
+			}
 
 			sge_array[cpu][sd_level] = sge;
 		}
@@ -5471,7 +5471,6 @@ static inline bool energy_aware(void)
 struct energy_env {
 	struct sched_group	*sg_top;
 	struct sched_group	*sg_cap;
-	int			cap_idx;
 	int			util_delta;
 	int			src_cpu;
 	int			dst_cpu;
@@ -5524,18 +5523,29 @@ static int calc_util_delta(struct energy_env *eenv, int cpu)
 	return 0;
 }
 
-static
-unsigned long group_max_util(struct energy_env *eenv)
+/*
+ * The group energy before and after a change of utilization is computed
+ * in a single walk of the hierarchy: only dst_cpu and src_cpu see their
+ * utilization change, so the other cpus are looked at once for both.
+ */
+
+/*
+ * group_max_util() returns the highest utilization of the cpus sharing the
+ * capacity of eenv->sg_cap, before and after the change.
+ */
+static void group_max_util(struct energy_env *eenv,
+			   unsigned long *before, unsigned long *after)
 {
 	int i, delta;
-	unsigned long max_util = 0;
+	unsigned long util;
 
+	*before = *after = 0;
 	for_each_cpu(i, sched_group_span(eenv->sg_cap)) {
+		util = __cpu_util(i, 0);
+		*before = max(*before, util);
 		delta = calc_util_delta(eenv, i);
-		max_util = max(max_util, __cpu_util(i, delta));
+		*after = max(*after, delta ? __cpu_util(i, delta) : util);
 	}
-
-	return max_util;
 }
 
 /*
@@ -5547,58 +5557,50 @@ unsigned long group_max_util(struct energy_env *eenv)
  * latter is used as the estimate as it leads to a more pessimistic energy
  * estimate (more busy).
  */
-static unsigned
-long group_norm_util(struct energy_env *eenv, struct sched_group *sg)
+static void group_norm_util(struct energy_env *eenv, struct sched_group *sg,
+			    int cap_idx_before, int cap_idx_after,
+			    unsigned long *before, unsigned long *after)
 {
 	int i, delta;
-	unsigned long util_sum = 0;
-	unsigned long capacity = sg->sge->cap_states[eenv->cap_idx].cap;
+	unsigned long util;
+	unsigned long cap_before = sg->sge->cap_states[cap_idx_before].cap;
+	unsigned long cap_after = sg->sge->cap_states[cap_idx_after].cap;
 
+	*before = *after = 0;
 	for_each_cpu(i, sched_group_span(sg)) {
+		util = __cpu_norm_util(i, cap_before, 0);
+		*before += util;
 		delta = calc_util_delta(eenv, i);
-		util_sum += __cpu_norm_util(i, capacity, delta);
+		if (delta || cap_after != cap_before)
+			util = __cpu_norm_util(i, cap_after, delta);
+		*after += util;
 	}
 
-	if (util_sum > SCHED_CAPACITY_SCALE)
-		return SCHED_CAPACITY_SCALE;
-	return util_sum;
+	*before = min_t(unsigned long, *before, SCHED_CAPACITY_SCALE);
+	*after = min_t(unsigned long, *after, SCHED_CAPACITY_SCALE);
 }
 
-static int find_new_capacity(struct energy_env *eenv,
-	const struct sched_group_energy * const sge)
+static int find_new_capacity(const struct sched_group_energy * const sge,
+			     unsigned long util)
 {
-	int idx;
-	unsigned long util = group_max_util(eenv);
+	int idx = 0;
+
+	if (sge->cap_idx_lut)
+		idx = sge->cap_idx_lut[min_t(unsigned long, util,
+				SCHED_CAPACITY_SCALE) >> SGE_CAP_LUT_SHIFT];
 
-	for (idx = 0; idx < sge->nr_cap_states; idx++) {
+	for (; idx < sge->nr_cap_states; idx++) {
 		if (sge->cap_states[idx].cap >= util)
 			break;
 	}
 
-	eenv->cap_idx = idx;
-
 	return idx;
 }
 
-static int group_idle_state(struct energy_env *eenv, struct sched_group *sg)
+static int __group_idle_state(struct energy_env *eenv, struct sched_group *sg,
+			      int state, long grp_util, int util_delta)
 {
-	int i, state = INT_MAX;
 	int src_in_grp, dst_in_grp;
-	long grp_util = 0;
-
-	/* Find the shallowest idle state in the sched group. */
-	for_each_cpu(i, sched_group_span(sg))
-		state = min(state, idle_get_state_idx(cpu_rq(i)));
-
-	/* Take non-cpuidle idling into account (active idle/arch_cpu_idle()) */
-	state++;
-
-	/*
-	 * Try to estimate if a deeper idle state is
-	 * achievable when we move the task.
-	 */
-	for_each_cpu(i, sched_group_span(sg))
-		grp_util += cpu_util(i);
 
 	src_in_grp = cpumask_test_cpu(eenv->src_cpu, sched_group_span(sg));
 	dst_in_grp = cpumask_test_cpu(eenv->dst_cpu, sched_group_span(sg));
@@ -5611,7 +5613,7 @@ static int group_idle_state(struct energy_env *eenv, struct sched_group *sg)
 	/* add or remove util as appropriate to indicate what group util
 	 * will be (worst case - no concurrent execution) after moving the task
 	 */
-	grp_util += src_in_grp ? -eenv->util_delta : eenv->util_delta;
+	grp_util += src_in_grp ? -util_delta : util_delta;
 
 	if (grp_util <=
 		((long)sg->sgc->max_capacity * (int)sg->group_weight)) {
@@ -5644,20 +5646,60 @@ static int group_idle_state(struct energy_env *eenv, struct sched_group *sg)
 	return state;
 }
 
+static void group_idle_state(struct energy_env *eenv, struct sched_group *sg,
+			     int *before, int *after)
+{
+	int i, state = INT_MAX;
+	long grp_util = 0;
+
+	/* Find the shallowest idle state in the sched group. */
+	for_each_cpu(i, sched_group_span(sg))
+		state = min(state, idle_get_state_idx(cpu_rq(i)));
+
+	/* Take non-cpuidle idling into account (active idle/arch_cpu_idle()) */
+	state++;
+
+	/*
+	 * Try to estimate if a deeper idle state is
+	 * achievable when we move the task.
+	 */
+	for_each_cpu(i, sched_group_span(sg))
+		grp_util += cpu_util(i);
+
+	*before = __group_idle_state(eenv, sg, state, grp_util, 0);
+	*after = __group_idle_state(eenv, sg, state, grp_util,
+				    eenv->util_delta);
+}
+
+static int group_energy(const struct sched_group_energy * const sge,
+			unsigned long group_util, int cap_idx, int idle_idx)
+{
+	int sg_busy_energy, sg_idle_energy;
+
+	sg_busy_energy = (group_util * sge->cap_states[cap_idx].power)
+						>> SCHED_CAPACITY_SHIFT;
+	sg_idle_energy = ((SCHED_CAPACITY_SCALE-group_util)
+						* sge->idle_states[idle_idx].power)
+						>> SCHED_CAPACITY_SHIFT;
+
+	return sg_busy_energy + sg_idle_energy;
+}
+
 /*
  * sched_group_energy(): Computes the absolute energy consumption of cpus
- * belonging to the sched_group including shared resources shared only by
- * members of the group. Iterates over all cpus in the hierarchy below the
- * sched_group starting from the bottom working it's way up before going to
- * the next cpu until all cpus are covered at all levels. The current
- * implementation is likely to gather the same util statistics multiple times.
- * This can probably be done in a faster but more complex way.
+ * belonging to eenv->sg_top including shared resources shared only by
+ * members of the group, before (eenv->nrg.before) and after (eenv->energy)
+ * the change of utilization described by eenv. Iterates over all cpus in
+ * the hierarchy below the sched_group starting from the bottom working it's
+ * way up before going to the next cpu until all cpus are covered at all
+ * levels. The current implementation is likely to gather the same util
+ * statistics multiple times.
  * Note: sched_group_energy() may fail when racing with sched_domain updates.
  */
 static int sched_group_energy(struct energy_env *eenv)
 {
 	struct sched_domain *sd;
-	int cpu, total_energy = 0;
+	int cpu, energy_before = 0, energy_after = 0;
 	struct cpumask visit_cpus;
 	struct sched_group *sg;
 
@@ -5687,42 +5729,40 @@ static int sched_group_energy(struct energy_env *eenv)
 				break;
 
 			do {
-				unsigned long group_util;
-				int sg_busy_energy, sg_idle_energy;
-				int cap_idx, idle_idx;
+				const struct sched_group_energy *sge = sg->sge;
+				unsigned long max_before, max_after;
+				unsigned long util_before, util_after;
+				int cap_before, cap_after;
+				int idle_before, idle_after;
 
 				if (sg_shared_cap && sg_shared_cap->group_weight >= sg->group_weight)
 					eenv->sg_cap = sg_shared_cap;
 				else
 					eenv->sg_cap = sg;
 
-				cap_idx = find_new_capacity(eenv, sg->sge);
+				group_max_util(eenv, &max_before, &max_after);
+				cap_before = find_new_capacity(sge, max_before);
+				cap_after = max_after == max_before ? cap_before :
+					    find_new_capacity(sge, max_after);
 
 				if (sg->group_weight == 1) {
-					/* Remove capacity of src CPU (before task move) */
-					if (eenv->util_delta == 0 &&
-					    cpumask_test_cpu(eenv->src_cpu, sched_group_span(sg))) {
-						eenv->cap.before = sg->sge->cap_states[cap_idx].cap;
-						eenv->cap.delta -= eenv->cap.before;
-					}
-					/* Add capacity of dst CPU  (after task move) */
+					/* Capacity of src CPU (before task move) */
+					if (cpumask_test_cpu(eenv->src_cpu, sched_group_span(sg)))
+						eenv->cap.before = sge->cap_states[cap_before].cap;
+					/* Capacity of dst CPU  (after task move) */
 					if (eenv->util_delta != 0 &&
-					    cpumask_test_cpu(eenv->dst_cpu, sched_group_span(sg))) {
-						eenv->cap.after = sg->sge->cap_states[cap_idx].cap;
-						eenv->cap.delta += eenv->cap.after;
-					}
+					    cpumask_test_cpu(eenv->dst_cpu, sched_group_span(sg)))
+						eenv->cap.after = sge->cap_states[cap_after].cap;
 				}
 
-				idle_idx = group_idle_state(eenv, sg);
-				group_util = group_norm_util(eenv, sg);
+				group_idle_state(eenv, sg, &idle_before, &idle_after);
+				group_norm_util(eenv, sg, cap_before, cap_after,
+						&util_before, &util_after);
 
-				sg_busy_energy = (group_util * sg->sge->cap_states[cap_idx].power)
-								>> SCHED_CAPACITY_SHIFT;
-				sg_idle_energy = ((SCHED_CAPACITY_SCALE-group_util)
-								* sg->sge->idle_states[idle_idx].power)
-								>> SCHED_CAPACITY_SHIFT;
-
-				total_energy += sg_busy_energy + sg_idle_energy;
+				energy_before += group_energy(sge, util_before,
+							      cap_before, idle_before);
+				energy_after += group_energy(sge, util_after,
+							     cap_after, idle_after);
 
 				if (!sd->child)
 					cpumask_xor(&visit_cpus, &visit_cpus, sched_group_span(sg));
@@ -5745,7 +5785,8 @@ static int sched_group_energy(struct energy_env *eenv)
 		continue;
 	}
 
-	eenv->energy = total_energy;
+	eenv->nrg.before = energy_before;
+	eenv->energy = energy_after;
 	return 0;
 }
 
@@ -5768,17 +5809,12 @@ static inline int __energy_diff(struct energy_env *eenv)
 	int sd_cpu = -1, energy_before = 0, energy_after = 0;
 	int diff, margin;
 
-	struct energy_env eenv_before = {
-		.util_delta	= 0,
-		.src_cpu	= eenv->src_cpu,
-		.dst_cpu	= eenv->dst_cpu,
-		.nrg		= { 0, 0, 0, 0},
-		.cap		= { 0, 0, 0 },
-	};
-
 	if (eenv->src_cpu == eenv->dst_cpu)
 		return 0;
 
+	/* The env may be reused for another dst_cpu */
+	eenv->cap.before = eenv->cap.after = 0;
+
 	sd_cpu = (eenv->src_cpu != -1) ? eenv->src_cpu : eenv->dst_cpu;
 	sd = rcu_dereference(per_cpu(sd_ea, sd_cpu));
 
@@ -5789,22 +5825,16 @@ static inline int __energy_diff(struct energy_env *eenv)
 
 	do {
 		if (cpu_in_sg(sg, eenv->src_cpu) || cpu_in_sg(sg, eenv->dst_cpu)) {
-			eenv_before.sg_top = eenv->sg_top = sg;
-
-			if (sched_group_energy(&eenv_before))
-				return 0; /* Invalid result abort */
-			energy_before += eenv_before.energy;
-
-			/* Keep track of SRC cpu (before) capacity */
-			eenv->cap.before = eenv_before.cap.before;
-			eenv->cap.delta = eenv_before.cap.delta;
+			eenv->sg_top = sg;
 
 			if (sched_group_energy(eenv))
 				return 0; /* Invalid result abort */
+			energy_before += eenv->nrg.before;
 			energy_after += eenv->energy;
 		}
 	} while (sg = sg->next, sg != sd->groups);
 
+	eenv->cap.delta = eenv->cap.after - eenv->cap.before;
 	eenv->nrg.before = energy_before;
 	eenv->nrg.after = energy_after;
 	eenv->nrg.diff = eenv->nrg.after - eenv->nrg.before;
@@ -6148,7 +6178,7 @@ schedtune_task_margin(struct task_struct *task)
 unsigned long
 boosted_cpu_util(int cpu)
 {
-	unsigned long util = cpu_util(cpu);
+	unsigned long util = cpu_util_freq(cpu);
 	long margin = schedtune_cpu_margin(util, cpu);
 
 	trace_sched_boost_cpu(cpu, util, margin);
@@ -6679,6 +6709,42 @@ static int start_cpu(bool boosted)
 	return boosted ? rd->max_cap_orig_cpu : rd->min_cap_orig_cpu;
 }
 
+/*
+ * Fast path for latency sensitive tasks: look up the idle cpus from the
+ * masks maintained by the idle loop instead of scanning every cpu, taking
+ * the shallowest idle cpu the task fits on, groups in find_best_target()
+ * order first.
+ */
+static int find_idle_target(struct task_struct *p, struct sched_group *sg,
+			    unsigned long min_util)
+{
+	struct sched_group *start = sg;
+	int depth, i;
+
+	do {
+		for (depth = 0; depth < SCHED_IDLE_DEPTHS; depth++) {
+			for_each_cpu_and(i, &sched_idle_cpus[depth],
+					 sched_group_span(sg)) {
+				unsigned long new_util;
+
+				if (!cpumask_test_cpu(i, &p->cpus_allowed) ||
+				    !cpu_online(i) || walt_cpu_high_irqload(i))
+					continue;
+
+				new_util = cpu_util_wake(i, p) + task_util(p);
+				if (max(min_util, new_util) > capacity_orig_of(i))
+					continue;
+
+				/* The masks are updated locklessly, recheck */
+				if (idle_cpu(i))
+					return i;
+			}
+		}
+	} while (sg = sg->next, sg != start);
+
+	return -1;
+}
+
 static inline int find_best_target(struct task_struct *p, int *backup_cpu,
 				   bool boosted, bool prefer_idle)
 {
@@ -6699,6 +6765,9 @@ static inline int find_best_target(struct task_struct *p, int *backup_cpu,
 
 	*backup_cpu = -1;
 
+	/* Keep related tasks together, on cpus that fit their whole group */
+	min_util = max(min_util, related_group_util(p));
+
 	schedstat_inc(p->se.statistics.nr_wakeups_fbt_attempts);
 	schedstat_inc(this_rq()->eas_stats.fbt_attempts);
 
@@ -6718,6 +6787,20 @@ static inline int find_best_target(struct task_struct *p, int *backup_cpu,
 		return -1;
 	}
 
+	/* Case A.1 below, without the scan */
+	if (prefer_idle && sched_feat(FBT_IDLE_MASK)) {
+		i = find_idle_target(p, sd->groups, min_util);
+		if (i >= 0) {
+			schedstat_inc(p->se.statistics.nr_wakeups_fbt_pref_idle);
+			schedstat_inc(this_rq()->eas_stats.fbt_pref_idle);
+
+			trace_sched_find_best_target(p, prefer_idle, min_util,
+						     cpu, -1, -1, i);
+
+			return i;
+		}
+	}
+
 	/* Scan CPUs in all SDs */
 	sg = sd->groups;
 	do {
@@ -94,3 +94,9 @@ SCHED_FEAT(ENERGY_AWARE, true)
 #else
 SCHED_FEAT(ENERGY_AWARE, false)
 #endif
+
+/*
+ * Place prefer_idle tasks on the shallowest idle cpu found from the per
+ * idle-depth cpu masks, before scanning all the cpus in find_best_target().
+ */
+SCHED_FEAT(FBT_IDLE_MASK, true)
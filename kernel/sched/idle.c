@@ -21,6 +21,30 @@
 /* Linker adds these: start and end of __cpuidle functions */
 extern char __cpuidle_text_start[], __cpuidle_text_end[];
 
+#ifdef CONFIG_SMP
+struct cpumask sched_idle_cpus[SCHED_IDLE_DEPTHS];
+static DEFINE_PER_CPU(int, sched_idle_depth) = -1;
+
+/* Move the current cpu to the sched_idle_cpus mask of @depth, -1 for none */
+static void sched_idle_set_depth(int depth)
+{
+	int cpu = smp_processor_id();
+	int old = per_cpu(sched_idle_depth, cpu);
+
+	if (old == depth)
+		return;
+
+	/* Set before clear, so an idle cpu is always in some mask */
+	if (depth >= 0)
+		cpumask_set_cpu(cpu, &sched_idle_cpus[depth]);
+	if (old >= 0)
+		cpumask_clear_cpu(cpu, &sched_idle_cpus[old]);
+	per_cpu(sched_idle_depth, cpu) = depth;
+}
+#else
+static inline void sched_idle_set_depth(int depth) { }
+#endif
+
 /**
  * sched_idle_set_state - Record idle state for the current CPU.
  * @idle_state: State to record.
@@ -29,6 +53,8 @@ void sched_idle_set_state(struct cpuidle_state *idle_state, int index)
 {
 	idle_set_state(this_rq(), idle_state);
 	idle_set_state_idx(this_rq(), index);
+	sched_idle_set_depth(index < 0 ? 0 :
+			     min(index + 1, SCHED_IDLE_DEPTHS - 1));
 }
 
 static int __read_mostly cpu_idle_force_poll;
@@ -222,12 +248,14 @@ static void do_idle(void)
 	__current_set_polling();
 	quiet_vmstat();
 	tick_nohz_idle_enter();
+	sched_idle_set_depth(0);
 
 	while (!need_resched()) {
 		check_pgt_cache();
 		rmb();
 
 		if (cpu_is_offline(smp_processor_id())) {
+			sched_idle_set_depth(-1);
 			cpuhp_report_idle_dead();
 			arch_cpu_idle_dead();
 		}
@@ -256,6 +284,7 @@ static void do_idle(void)
 	 * an IPI to fold the state for us.
 	 */
 	preempt_set_need_resched();
+	sched_idle_set_depth(-1);
 	tick_nohz_idle_exit();
 	__current_clr_polling();
 
@@ -785,6 +785,8 @@ struct rq {
 	struct cpumask freq_domain_cpumask;
 
 	u64 cumulative_runnable_avg;
+	u64 pred_demands_sum;
+	struct related_thread_group *curr_grp;
 	int efficiency; /* Differentiate cpus with different IPC capability */
 	int load_scale_factor;
 	int capacity;
@@ -1600,6 +1602,17 @@ static inline int idle_get_state_idx(struct rq *rq)
 }
 #endif
 
+/*
+ * Idle cpus by depth of their idle state: depth 0 is the idle loop out of
+ * any cpuidle state, depth d the cpuidle state d - 1, the deepest states
+ * sharing the last mask.  Maintained by the idle loop for the placement
+ * of latency sensitive tasks, see find_idle_target().
+ */
+#define SCHED_IDLE_DEPTHS	4
+#ifdef CONFIG_SMP
+extern struct cpumask sched_idle_cpus[SCHED_IDLE_DEPTHS];
+#endif
+
 extern void schedule_idle(void);
 
 extern void sysrq_sched_debug_show(void);
@@ -1805,6 +1818,17 @@ static inline unsigned long capacity_orig_of(int cpu)
 extern unsigned int sysctl_sched_use_walt_cpu_util;
 extern unsigned int walt_ravg_window;
 extern unsigned int walt_disabled;
+extern unsigned int walt_pred_demand;
+
+/*
+ * Tasks working together on the same piece of work, e.g. the threads
+ * producing a frame, run mostly one after the other: they are placed on a
+ * cpu that fits, and clocked for, the demand of the group as a whole.
+ */
+struct related_thread_group {
+	/* Sum of the demand of the tasks in the group */
+	atomic64_t demand;
+};
 
 /*
  * cpu_util returns the amount of capacity of a CPU that is used by CFS
@@ -1855,6 +1879,57 @@ static inline unsigned long cpu_util(int cpu)
 	return __cpu_util(cpu, 0);
 }
 
+/*
+ * cpu_util_freq: the utilization to select the cpu frequency from
+ *
+ * With WALT, the busy time of the last window is a window late for a task
+ * starting a burst it ran before: take the predicted demand of the tasks
+ * runnable on the cpu instead, when it is higher.
+ */
+static inline unsigned long cpu_util_freq(int cpu)
+{
+	unsigned long util = cpu_util(cpu);
+#ifdef CONFIG_SCHED_WALT
+	unsigned long capacity = capacity_orig_of(cpu);
+	struct related_thread_group *grp;
+	u64 demand = 0;
+
+	if (walt_disabled || !sysctl_sched_use_walt_cpu_util)
+		return util;
+
+	if (walt_pred_demand)
+		demand = cpu_rq(cpu)->pred_demands_sum;
+
+	/* A task of a group runs for the whole group */
+	grp = READ_ONCE(cpu_rq(cpu)->curr_grp);
+	if (grp)
+		demand = max_t(u64, demand, atomic64_read(&grp->demand));
+
+	demand = div_u64(demand << SCHED_CAPACITY_SHIFT, walt_ravg_window);
+	util = max_t(unsigned long, util, min_t(u64, demand, capacity));
+#endif
+	return util;
+}
+
+/*
+ * related_group_util: the utilization of the group of related tasks @p
+ * belongs to, 0 if none
+ */
+static inline unsigned long related_group_util(struct task_struct *p)
+{
+#ifdef CONFIG_SCHED_WALT
+	struct related_thread_group *grp = READ_ONCE(p->grp);
+	u64 demand;
+
+	if (grp && !walt_disabled && sysctl_sched_use_walt_task_util) {
+		demand = atomic64_read(&grp->demand) << SCHED_CAPACITY_SHIFT;
+		demand = div_u64(demand, walt_ravg_window);
+		return min_t(u64, demand, SCHED_CAPACITY_SCALE);
+	}
+#endif
+	return 0;
+}
+
 #endif
 
 #ifdef CONFIG_CPU_FREQ_GOV_SCHED
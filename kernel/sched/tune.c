@@ -10,6 +10,7 @@
 
 #include "sched.h"
 #include "tune.h"
+#include "walt.h"
 
 #ifdef CONFIG_CGROUP_SCHEDTUNE
 bool schedtune_initialized = false;
@@ -130,6 +131,10 @@ struct schedtune {
 	/* Hint to bias scheduling of tasks on that SchedTune CGroup
 	 * towards idle CPUs */
 	int prefer_idle;
+
+	/* Hint to place and clock the tasks on that SchedTune CGroup
+	 * for the demand of the group as a whole */
+	int colocate;
 };
 
 static inline struct schedtune *css_st(struct cgroup_subsys_state *css)
@@ -318,6 +323,7 @@ schedtune_tasks_update(struct task_struct *p, int cpu, int idx, int task_count)
 {
 	struct boost_groups *bg = &per_cpu(cpu_boost_groups, cpu);
 	int tasks = bg->group[idx].tasks + task_count;
+	int old_boost_max = bg->boost_max;
 
 	/* Update boosted tasks count while avoiding to make it negative */
 	bg->group[idx].tasks = max(0, tasks);
@@ -328,6 +334,10 @@ schedtune_tasks_update(struct task_struct *p, int cpu, int idx, int task_count)
 	/* Boost group activation or deactivation on that RQ */
 	if (tasks == 1 || tasks == 0)
 		schedtune_cpu_update(cpu);
+
+	/* Let a driver that programs the CPU itself ramp up right away */
+	if (bg->boost_max != old_boost_max && cpu == smp_processor_id())
+		cpufreq_update_util(cpu_rq(cpu), SCHED_CPUFREQ_BOOST);
 }
 
 /*
@@ -522,6 +532,23 @@ int schedtune_cpu_boost(int cpu)
 	return bg->boost_max;
 }
 
+/*
+ * Boost hint for the cpufreq drivers that set the performance hints of the
+ * CPU themselves, like intel_pstate with HWP: the highest boost of the
+ * tasks runnable on @cpu or, when none is boosted, the boost of the running
+ * task if it is negative, so that background work runs efficiently.
+ * Called on @cpu with interrupts disabled.
+ */
+int schedtune_cpufreq_boost(int cpu)
+{
+	int boost = schedtune_cpu_boost(cpu);
+
+	if (boost > 0)
+		return boost;
+
+	return min(schedtune_task_boost(cpu_curr(cpu)), 0);
+}
+
 int schedtune_task_boost(struct task_struct *p)
 {
 	struct schedtune *st;
@@ -574,6 +601,63 @@ prefer_idle_write(struct cgroup_subsys_state *css, struct cftype *cft,
 	return 0;
 }
 
+/* The WALT related thread group of the tasks on a SchedTune CGroup */
+static inline unsigned int
+schedtune_colocate_grp(struct schedtune *st)
+{
+	return st->colocate ? st->idx : 0;
+}
+
+static u64
+colocate_read(struct cgroup_subsys_state *css, struct cftype *cft)
+{
+	struct schedtune *st = css_st(css);
+
+	return st->colocate;
+}
+
+static int
+colocate_write(struct cgroup_subsys_state *css, struct cftype *cft,
+	    u64 colocate)
+{
+	struct schedtune *st = css_st(css);
+	struct task_struct *task;
+	struct css_task_iter it;
+
+	/* The root group does not group related tasks */
+	if (st == &root_schedtune)
+		return -EINVAL;
+
+	st->colocate = !!colocate;
+
+	css_task_iter_start(css, 0, &it);
+	while ((task = css_task_iter_next(&it)))
+		walt_set_task_group(task, schedtune_colocate_grp(st));
+	css_task_iter_end(&it);
+
+	return 0;
+}
+
+static void schedtune_attach(struct cgroup_taskset *tset)
+{
+	struct cgroup_subsys_state *css;
+	struct task_struct *task;
+
+	cgroup_taskset_for_each(task, css, tset)
+		walt_set_task_group(task, schedtune_colocate_grp(css_st(css)));
+}
+
+static void schedtune_fork(struct task_struct *task)
+{
+	unsigned int grp_id;
+
+	rcu_read_lock();
+	grp_id = schedtune_colocate_grp(task_schedtune(task));
+	rcu_read_unlock();
+
+	walt_set_task_group(task, grp_id);
+}
+
 static s64
 boost_read(struct cgroup_subsys_state *css, struct cftype *cft)
 {
@@ -630,6 +714,11 @@ static struct cftype files[] = {
 		.read_u64 = prefer_idle_read,
 		.write_u64 = prefer_idle_write,
 	},
+	{
+		.name = "colocate",
+		.read_u64 = colocate_read,
+		.write_u64 = colocate_write,
+	},
 	{ }	/* terminate */
 };
 
@@ -668,6 +757,9 @@ schedtune_css_alloc(struct cgroup_subsys_state *parent_css)
 		return ERR_PTR(-ENOMEM);
 	}
 
+	/* Each boosting group can be a WALT related thread group */
+	BUILD_BUG_ON(BOOSTGROUPS_COUNT > WALT_NR_GROUPS);
+
 	/* Allow only a limited number of boosting groups */
 	for (idx = 1; idx < BOOSTGROUPS_COUNT; ++idx)
 		if (!allocated_group[idx])
@@ -719,6 +811,8 @@ struct cgroup_subsys schedtune_cgrp_subsys = {
 	.css_free	= schedtune_css_free,
 	.can_attach     = schedtune_can_attach,
 	.cancel_attach  = schedtune_cancel_attach,
+	.attach		= schedtune_attach,
+	.fork		= schedtune_fork,
 	.legacy_cftypes	= files,
 	.early_init	= 1,
 };
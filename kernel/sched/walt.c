@@ -33,6 +33,15 @@
 
 #define EXITING_TASK_MARKER	0xdeaddead
 
+/* Windows a task is active for before its busy time history is trusted */
+#define NEW_TASK_WINDOWS	5
+
+/* Busy bucket weights: raised on a hit, faster if hit consistently */
+#define BUCKET_INC_STEP		8
+#define BUCKET_INC_STEP_BIG	16
+#define BUCKET_DEC_STEP		2
+#define BUCKET_CONSISTENT_THRES	16
+
 static __read_mostly unsigned int walt_ravg_hist_size = 5;
 static __read_mostly unsigned int walt_window_stats_policy =
 	WINDOW_STATS_MAX_RECENT_AVG;
@@ -40,6 +49,9 @@ static __read_mostly unsigned int walt_account_wait_time = 1;
 static __read_mostly unsigned int walt_freq_account_wait_time = 0;
 static __read_mostly unsigned int walt_io_is_busy = 0;
 
+/* 1 -> select frequency from predicted demand as well, 0 -> history only */
+__read_mostly unsigned int walt_pred_demand = 1;
+
 unsigned int sysctl_sched_walt_init_task_load_pct = 15;
 
 /* 1 -> use PELT based load stats, 0 -> use window-based load stats */
@@ -89,6 +101,8 @@ static unsigned int sync_cpu;
 static ktime_t ktime_last;
 static __read_mostly bool walt_ktime_suspended;
 
+static struct related_thread_group related_thread_groups[WALT_NR_GROUPS];
+
 static unsigned int task_load(struct task_struct *p)
 {
 	return p->ravg.demand;
@@ -99,6 +113,7 @@ walt_inc_cumulative_runnable_avg(struct rq *rq,
 				 struct task_struct *p)
 {
 	rq->cumulative_runnable_avg += p->ravg.demand;
+	rq->pred_demands_sum += p->ravg.pred_demand;
 }
 
 void
@@ -107,6 +122,8 @@ walt_dec_cumulative_runnable_avg(struct rq *rq,
 {
 	rq->cumulative_runnable_avg -= p->ravg.demand;
 	BUG_ON((s64)rq->cumulative_runnable_avg < 0);
+	rq->pred_demands_sum -= p->ravg.pred_demand;
+	BUG_ON((s64)rq->pred_demands_sum < 0);
 }
 
 static void
@@ -162,17 +179,61 @@ void walt_dec_cfs_cumulative_runnable_avg(struct cfs_rq *cfs_rq,
 	cfs_rq->cumulative_runnable_avg -= p->ravg.demand;
 }
 
+/* Called with the rq lock of @p held */
+static void __walt_set_task_group(struct rq *rq, struct task_struct *p,
+				  struct related_thread_group *grp)
+{
+	if (p->grp)
+		atomic64_sub(p->ravg.demand, &p->grp->demand);
+	if (grp)
+		atomic64_add(p->ravg.demand, &grp->demand);
+
+	WRITE_ONCE(p->grp, grp);
+	if (task_current(rq, p))
+		WRITE_ONCE(rq->curr_grp, grp);
+}
+
 static int exiting_task(struct task_struct *p)
 {
 	if (p->flags & PF_EXITING) {
 		if (p->ravg.sum_history[0] != EXITING_TASK_MARKER) {
 			p->ravg.sum_history[0] = EXITING_TASK_MARKER;
+			/* Its demand is no longer accounted, drop it */
+			if (p->grp)
+				__walt_set_task_group(task_rq(p), p, NULL);
 		}
 		return 1;
 	}
 	return 0;
 }
 
+/**
+ * walt_set_task_group - Move a task to a group of related tasks
+ * @p:      The task
+ * @grp_id: The group, below WALT_NR_GROUPS, or 0 to leave its group
+ *
+ * The demand of @p is added to the group from then on.  Exiting tasks
+ * leave their group for good.
+ */
+int walt_set_task_group(struct task_struct *p, unsigned int grp_id)
+{
+	struct related_thread_group *grp = NULL;
+	struct rq_flags rf;
+	struct rq *rq;
+
+	if (grp_id >= WALT_NR_GROUPS)
+		return -EINVAL;
+	if (grp_id)
+		grp = &related_thread_groups[grp_id];
+
+	rq = task_rq_lock(p, &rf);
+	if (!exiting_task(p) && p->grp != grp)
+		__walt_set_task_group(rq, p, grp);
+	task_rq_unlock(rq, p, &rf);
+
+	return 0;
+}
+
 static int __init set_walt_ravg_window(char *str)
 {
 	get_option(&str, &walt_ravg_window);
@@ -527,6 +588,128 @@ static void update_cpu_busy_time(struct task_struct *p, struct rq *rq,
 	BUG();
 }
 
+static inline int busy_to_bucket(u32 runtime)
+{
+	int bidx = mult_frac(runtime, NUM_BUSY_BUCKETS, walt_ravg_window);
+
+	/*
+	 * Merge the two lowest buckets: predicting the lowest one would not
+	 * select a different frequency than predicting nothing.
+	 */
+	return clamp(bidx, 1, NUM_BUSY_BUCKETS - 1);
+}
+
+/*
+ * Predict the busy time of a task in a window it has run for @runtime so
+ * far: the most recent busy time in history falling in the first bucket
+ * at or above @start the task was seen in lately, at least @runtime.
+ */
+static u32 get_pred_busy(struct task_struct *p, int start, u32 runtime)
+{
+	u8 *buckets = p->ravg.busy_buckets;
+	u32 *hist = p->ravg.sum_history;
+	u32 dmin, dmax, pred = 0;
+	int i, bidx = NUM_BUSY_BUCKETS;
+
+	/* Not enough history for new tasks */
+	if (p->ravg.active_windows < NEW_TASK_WINDOWS)
+		return runtime;
+
+	for (i = start; i < NUM_BUSY_BUCKETS; i++) {
+		if (buckets[i]) {
+			bidx = i;
+			break;
+		}
+	}
+	if (bidx == NUM_BUSY_BUCKETS)
+		return runtime;
+
+	dmin = bidx > 1 ? mult_frac(bidx, walt_ravg_window, NUM_BUSY_BUCKETS) : 0;
+	dmax = mult_frac(bidx + 1, walt_ravg_window, NUM_BUSY_BUCKETS);
+
+	for (i = 0; i < walt_ravg_hist_size; i++) {
+		if (hist[i] >= dmin && hist[i] < dmax) {
+			pred = hist[i];
+			break;
+		}
+	}
+
+	/* History rolled over the bucket already, take its middle */
+	if (!pred)
+		pred = (dmin + dmax) / 2;
+
+	return max(pred, runtime);
+}
+
+static void bucket_increase(u8 *buckets, int bidx)
+{
+	int i, step;
+
+	for (i = 0; i < NUM_BUSY_BUCKETS; i++) {
+		if (i != bidx) {
+			buckets[i] = buckets[i] > BUCKET_DEC_STEP ?
+				     buckets[i] - BUCKET_DEC_STEP : 0;
+			continue;
+		}
+
+		step = buckets[i] >= BUCKET_CONSISTENT_THRES ?
+		       BUCKET_INC_STEP_BIG : BUCKET_INC_STEP;
+		buckets[i] = min_t(int, buckets[i] + step, U8_MAX);
+	}
+}
+
+/* Predict the next window from history, then record @runtime in it */
+static u32 predict_and_update_buckets(struct task_struct *p, u32 runtime)
+{
+	int bidx = busy_to_bucket(runtime);
+	u32 pred_demand = get_pred_busy(p, bidx, runtime);
+
+	bucket_increase(p->ravg.busy_buckets, bidx);
+
+	return pred_demand;
+}
+
+static inline bool walt_task_queued(struct task_struct *p)
+{
+	/*
+	 * A throttled deadline sched class task gets dequeued without
+	 * changing p->on_rq. Since the dequeue decrements hmp stats
+	 * avoid decrementing it here again.
+	 */
+	return task_on_rq_queued(p) && (!task_has_dl_policy(p) ||
+					!p->dl.dl_throttled);
+}
+
+/*
+ * The prediction is made at window rollover.  Raise it as soon as the
+ * task runs past it in the current window, so that a burst longer than
+ * predicted is seen before the window ends.
+ */
+static void update_task_pred_demand(struct rq *rq, struct task_struct *p,
+				    int event)
+{
+	u32 curr_window = p->ravg.curr_window;
+	u32 new;
+
+	if (is_idle_task(p) || exiting_task(p))
+		return;
+
+	if (event != PUT_PREV_TASK && event != TASK_UPDATE &&
+	    (!walt_freq_account_wait_time ||
+	     (event != TASK_MIGRATE && event != PICK_NEXT_TASK)))
+		return;
+
+	if (p->ravg.pred_demand >= curr_window)
+		return;
+
+	new = get_pred_busy(p, busy_to_bucket(curr_window), curr_window);
+
+	if (walt_task_queued(p))
+		rq->pred_demands_sum += new - p->ravg.pred_demand;
+
+	p->ravg.pred_demand = new;
+}
+
 static int account_busy_for_task_demand(struct task_struct *p, int event)
 {
 	/* No need to bother updating task demand for exiting tasks
@@ -556,13 +739,16 @@ static void update_history(struct rq *rq, struct task_struct *p,
 {
 	u32 *hist = &p->ravg.sum_history[0];
 	int ridx, widx;
-	u32 max = 0, avg, demand;
+	u32 max = 0, avg, demand, pred_demand;
 	u64 sum = 0;
 
 	/* Ignore windows where task had no activity */
 	if (!runtime || is_idle_task(p) || exiting_task(p) || !samples)
 			goto done;
 
+	/* Predict from the history before this window is pushed onto it */
+	pred_demand = predict_and_update_buckets(p, runtime);
+
 	/* Push new 'runtime' value onto stack */
 	widx = walt_ravg_hist_size - 1;
 	ridx = widx - samples;
@@ -594,16 +780,16 @@ static void update_history(struct rq *rq, struct task_struct *p,
 			demand = max(avg, runtime);
 	}
 
-	/*
-	 * A throttled deadline sched class task gets dequeued without
-	 * changing p->on_rq. Since the dequeue decrements hmp stats
-	 * avoid decrementing it here again.
-	 */
-	if (task_on_rq_queued(p) && (!task_has_dl_policy(p) ||
-						!p->dl.dl_throttled))
+	if (walt_task_queued(p)) {
 		fixup_cumulative_runnable_avg(rq, p, demand);
+		rq->pred_demands_sum += (s64)pred_demand - p->ravg.pred_demand;
+	}
+
+	if (p->grp)
+		atomic64_add((s64)demand - p->ravg.demand, &p->grp->demand);
 
 	p->ravg.demand = demand;
+	p->ravg.pred_demand = pred_demand;
 
 done:
 	trace_walt_update_history(rq, p, runtime, samples, event);
@@ -730,6 +916,9 @@ void walt_update_task_ravg(struct task_struct *p, struct rq *rq,
 
 	lockdep_assert_held(&rq->lock);
 
+	if (event == PICK_NEXT_TASK)
+		WRITE_ONCE(rq->curr_grp, p->grp);
+
 	update_window_start(rq, wallclock);
 
 	if (!p->ravg.mark_start)
@@ -737,6 +926,7 @@ void walt_update_task_ravg(struct task_struct *p, struct rq *rq,
 
 	update_task_demand(p, rq, event, wallclock);
 	update_cpu_busy_time(p, rq, event, wallclock, irqtime);
+	update_task_pred_demand(rq, p, event);
 
 done:
 	trace_walt_update_task_ravg(p, rq, event, wallclock, irqtime);
@@ -778,6 +968,8 @@ static void reset_task_stats(struct task_struct *p)
 	if (exiting_task(p))
 		sum = EXITING_TASK_MARKER;
 
+	if (p->grp)
+		atomic64_sub(p->ravg.demand, &p->grp->demand);
 	memset(&p->ravg, 0, sizeof(struct ravg));
 	/* Retain EXITING_TASK marker */
 	p->ravg.sum_history[0] = sum;
@@ -1120,6 +1312,8 @@ void walt_init_new_task_load(struct task_struct *p)
 	u32 init_load_pct = current->init_load_pct;
 
 	p->init_load_pct = 0;
+	if (p->grp)
+		atomic64_sub(p->ravg.demand, &p->grp->demand);
 	memset(&p->ravg, 0, sizeof(struct ravg));
 
 	if (init_load_pct) {
@@ -1128,6 +1322,9 @@ void walt_init_new_task_load(struct task_struct *p)
 	}
 
 	p->ravg.demand = init_load_windows;
+	p->ravg.pred_demand = init_load_windows;
+	if (p->grp)
+		atomic64_add(p->ravg.demand, &p->grp->demand);
 	for (i = 0; i < RAVG_HIST_SIZE_MAX; ++i)
 		p->ravg.sum_history[i] = init_load_windows;
 }
@@ -14,6 +14,9 @@
 #ifndef __WALT_H
 #define __WALT_H
 
+/* Related thread groups, id 0 for none */
+#define WALT_NR_GROUPS		8
+
 #ifdef CONFIG_SCHED_WALT
 
 void walt_update_task_ravg(struct task_struct *p, struct rq *rq, int event,
@@ -36,6 +39,7 @@ void walt_account_irqtime(int cpu, struct task_struct *curr, u64 delta,
 
 u64 walt_irqload(int cpu);
 int walt_cpu_high_irqload(int cpu);
+int walt_set_task_group(struct task_struct *p, unsigned int grp_id);
 
 #else /* CONFIG_SCHED_WALT */
 
@@ -54,6 +58,8 @@ static inline void walt_set_window_start(struct rq *rq) { }
 static inline void walt_migrate_sync_cpu(int cpu) { }
 static inline void walt_init_cpu_efficiency(void) { }
 static inline u64 walt_ktime_clock(void) { return 0; }
+static inline int walt_set_task_group(struct task_struct *p,
+		unsigned int grp_id) { return 0; }
 
 #define walt_cpu_high_irqload(cpu) false
 
@@ -29,6 +29,9 @@
 #include <linux/freezer.h>
 #include <linux/compat.h>
 #include <linux/module.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/sched/rt.h>
 
 #include "posix-timers.h"
 
@@ -65,6 +68,10 @@ static struct rtc_timer		rtctimer;
 static struct rtc_device	*rtcdev;
 static DEFINE_SPINLOCK(rtcdev_lock);
 
+/* Suspends that armed the rtc, and alarms that shared their wakeup */
+static unsigned long alarmtimer_rtc_wakeups;
+static unsigned long alarmtimer_coalesced;
+
 /**
  * alarmtimer_get_rtcdev - Return selected rtcdevice
  *
@@ -214,7 +221,8 @@ static enum hrtimer_restart alarmtimer_fired(struct hrtimer *timer)
 
 	spin_lock_irqsave(&base->lock, flags);
 	if (restart != ALARMTIMER_NORESTART) {
-		hrtimer_set_expires(&alarm->timer, alarm->node.expires);
+		hrtimer_set_expires_range(&alarm->timer, alarm->node.expires,
+					  alarm->window);
 		alarmtimer_enqueue(base, alarm);
 		ret = HRTIMER_RESTART;
 	}
@@ -233,15 +241,73 @@ ktime_t alarm_expires_remaining(const struct alarm *alarm)
 EXPORT_SYMBOL_GPL(alarm_expires_remaining);
 
 #ifdef CONFIG_RTC_CLASS
+/*
+ * Count the alarms that the rtc wakeup @min from now serves on top of
+ * the first one, each of which would have woken the device on its own.
+ */
+static void __maybe_unused alarmtimer_account_wakeup(ktime_t min)
+{
+	unsigned long served = 0;
+	unsigned long flags;
+	int i;
+
+	for (i = 0; i < ALARM_NUMTYPE; i++) {
+		struct alarm_base *base = &alarm_bases[i];
+		struct timerqueue_node *next;
+		ktime_t base_now = base->gettime();
+
+		spin_lock_irqsave(&base->lock, flags);
+		for (next = timerqueue_getnext(&base->timerqueue); next;
+		     next = timerqueue_iterate_next(next)) {
+			if (ktime_sub(next->expires, base_now) > min)
+				break;
+			served++;
+		}
+		spin_unlock_irqrestore(&base->lock, flags);
+	}
+
+	alarmtimer_rtc_wakeups++;
+	if (served > 1)
+		alarmtimer_coalesced += served - 1;
+}
+
+static int alarmtimer_stats_show(struct seq_file *m, void *v)
+{
+	seq_printf(m, "rtc_wakeups %lu\n" "coalesced %lu\n",
+		   alarmtimer_rtc_wakeups, alarmtimer_coalesced);
+	return 0;
+}
+
+static int alarmtimer_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, alarmtimer_stats_show, NULL);
+}
+
+static const struct file_operations alarmtimer_stats_fops = {
+	.open		= alarmtimer_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init alarmtimer_debugfs_init(void)
+{
+	debugfs_create_file("alarmtimer_stats", 0444, NULL, NULL,
+			    &alarmtimer_stats_fops);
+	return 0;
+}
+late_initcall(alarmtimer_debugfs_init);
+
 /**
  * alarmtimer_suspend - Suspend time callback
  * @dev: unused
  * @state: unused
  *
  * When we are going into suspend, we look through the bases
- * to see which is the soonest timer to expire. We then
- * set an rtc timer to fire that far into the future, which
- * will wake us from suspend.
+ * to see which is the soonest alarm deadline, its expiry plus
+ * its window. We then set an rtc timer to fire that far into
+ * the future, which will wake us from suspend for every alarm
+ * that expires by then.
  */
 static int alarmtimer_suspend(struct device *dev)
 {
@@ -266,23 +332,31 @@ static int alarmtimer_suspend(struct device *dev)
 	if (!rtc)
 		return 0;
 
-	/* Find the soonest timer to expire*/
+	/* Find the soonest deadline */
 	for (i = 0; i < ALARM_NUMTYPE; i++) {
 		struct alarm_base *base = &alarm_bases[i];
 		struct timerqueue_node *next;
-		ktime_t delta;
+		ktime_t base_now = base->gettime();
 
 		spin_lock_irqsave(&base->lock, flags);
-		next = timerqueue_getnext(&base->timerqueue);
-		spin_unlock_irqrestore(&base->lock, flags);
-		if (!next)
-			continue;
-		delta = ktime_sub(next->expires, base->gettime());
-		if (!min || (delta < min)) {
-			expires = next->expires;
-			min = delta;
-			type = i;
+		for (next = timerqueue_getnext(&base->timerqueue); next;
+		     next = timerqueue_iterate_next(next)) {
+			struct alarm *alarm = container_of(next, struct alarm,
+							   node);
+			ktime_t delta = ktime_sub(next->expires, base_now);
+
+			/* Later alarms can't have an earlier deadline */
+			if (min && delta > min)
+				break;
+			delta = ktime_add_safe(delta, alarm->window);
+			if (!min || (delta < min)) {
+				expires = ktime_add_safe(next->expires,
+							 alarm->window);
+				min = delta;
+				type = i;
+			}
 		}
+		spin_unlock_irqrestore(&base->lock, flags);
 	}
 	if (min == 0)
 		return 0;
@@ -293,6 +367,7 @@ static int alarmtimer_suspend(struct device *dev)
 	}
 
 	trace_alarmtimer_suspend(expires, type);
+	alarmtimer_account_wakeup(min);
 
 	/* Setup an rtc timer to fire that far in the future */
 	rtc_timer_cancel(rtc, &rtctimer);
@@ -346,6 +421,7 @@ void alarm_init(struct alarm *alarm, enum alarmtimer_type type,
 	alarm->function = function;
 	alarm->type = type;
 	alarm->state = ALARMTIMER_STATE_INACTIVE;
+	alarm->window = 0;
 }
 EXPORT_SYMBOL_GPL(alarm_init);
 
@@ -362,7 +438,8 @@ void alarm_start(struct alarm *alarm, ktime_t start)
 	spin_lock_irqsave(&base->lock, flags);
 	alarm->node.expires = start;
 	alarmtimer_enqueue(base, alarm);
-	hrtimer_start(&alarm->timer, alarm->node.expires, HRTIMER_MODE_ABS);
+	hrtimer_start_range_ns(&alarm->timer, alarm->node.expires,
+			       ktime_to_ns(alarm->window), HRTIMER_MODE_ABS);
 	spin_unlock_irqrestore(&base->lock, flags);
 
 	trace_alarmtimer_start(alarm, base->gettime());
@@ -389,7 +466,8 @@ void alarm_restart(struct alarm *alarm)
 	unsigned long flags;
 
 	spin_lock_irqsave(&base->lock, flags);
-	hrtimer_set_expires(&alarm->timer, alarm->node.expires);
+	hrtimer_set_expires_range(&alarm->timer, alarm->node.expires,
+				  alarm->window);
 	hrtimer_restart(&alarm->timer);
 	alarmtimer_enqueue(base, alarm);
 	spin_unlock_irqrestore(&base->lock, flags);
@@ -680,6 +758,9 @@ static int alarm_timer_create(struct k_itimer *new_timer)
 
 	type = clock2alarm(new_timer->it_clock);
 	alarm_init(&new_timer->it.alarm.alarmtimer, type, alarm_handle_timer);
+	if (!rt_task(current))
+		alarm_set_window(&new_timer->it.alarm.alarmtimer,
+			ns_to_ktime(task_get_effective_timer_slack(current)));
 	return 0;
 }
 
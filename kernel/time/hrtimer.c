@@ -1427,8 +1427,10 @@ static enum hrtimer_restart hrtimer_wakeup(struct hrtimer *timer)
 	struct task_struct *task = t->task;
 
 	t->task = NULL;
-	if (task)
+	if (task) {
+		timer_slack_account_expiry(task, timer);
 		wake_up_process(task);
+	}
 
 	return HRTIMER_NORESTART;
 }
@@ -1518,7 +1520,7 @@ long hrtimer_nanosleep(const struct timespec64 *rqtp,
 	int ret = 0;
 	u64 slack;
 
-	slack = current->timer_slack_ns;
+	slack = task_get_effective_timer_slack(current);
 	if (dl_task(current) || rt_task(current))
 		slack = 0;
 
@@ -223,6 +223,10 @@
 #define PKTGEN_MAGIC 0xbe9be955
 #define PG_PROC_DIR "pktgen"
 #define PGCTRL	    "pgctrl"
+#define PGRX	    "pgrx"
+
+/* Receive latency histogram: bucket n counts [2^(n-1), 2^n) usecs */
+#define PG_RX_HIST_BUCKETS 24
 
 #define MAX_CFLOWS  65536
 
@@ -413,6 +417,17 @@ struct pktgen_hdr {
 };
 
 
+/* Per-CPU receive side counters, for packets with a pktgen_hdr */
+struct pktgen_rx_stats {
+	u64	pkts;
+	u64	bytes;
+	u64	no_timestamp;	/* sent with F_NO_TIMESTAMP */
+	u64	clock_skew;	/* stamped later than received */
+	u64	lat_sum;	/* usecs */
+	u64	lat_max;
+	u64	hist[PG_RX_HIST_BUCKETS];
+};
+
 static unsigned int pg_net_id __read_mostly;
 
 struct pktgen_net {
@@ -420,6 +435,9 @@ struct pktgen_net {
 	struct proc_dir_entry	*proc_dir;
 	struct list_head	pktgen_threads;
 	bool			pktgen_exiting;
+	bool			rx_enabled;
+	struct packet_type	rx_pt[2];	/* IPv4 and IPv6 */
+	struct pktgen_rx_stats __percpu *rx_stats;
 };
 
 struct pktgen_thread {
@@ -458,6 +476,9 @@ static void pktgen_stop_all_threads_ifs(struct pktgen_net *pn);
 
 static void pktgen_stop(struct pktgen_thread *t);
 static void pktgen_clear_counters(struct pktgen_dev *pkt_dev);
+static void pktgen_rx_start(struct pktgen_net *pn);
+static void pktgen_rx_stop(struct pktgen_net *pn);
+static void pktgen_rx_reset(struct pktgen_net *pn);
 
 /* Module parameters, defaults. */
 static int pg_count_d __read_mostly = 1000;
@@ -511,6 +532,15 @@ static ssize_t pgctrl_write(struct file *file, const char __user *buf,
 	else if (!strcmp(data, "reset"))
 		pktgen_reset_all_threads(pn);
 
+	else if (!strcmp(data, "rx_start"))
+		pktgen_rx_start(pn);
+
+	else if (!strcmp(data, "rx_stop"))
+		pktgen_rx_stop(pn);
+
+	else if (!strcmp(data, "rx_reset"))
+		pktgen_rx_reset(pn);
+
 	else
 		return -EINVAL;
 
@@ -531,6 +561,164 @@ static const struct file_operations pktgen_fops = {
 	.release = single_release,
 };
 
+/*
+ * Receive side: while enabled with "rx_start", the UDP packets of this
+ * namespace that start with a pktgen_hdr are counted, and the delay from
+ * their send time stamp is added to a latency histogram.  The sender can
+ * be another host, as long as its clock is synchronized.
+ */
+static int pktgen_rx_rcv(struct sk_buff *skb, struct net_device *dev,
+			 struct packet_type *pt, struct net_device *orig_dev)
+{
+	struct pktgen_net *pn = pt->af_packet_priv;
+	struct pktgen_hdr _pgh, *pgh;
+	struct pktgen_rx_stats *st;
+	struct timespec64 now;
+	unsigned int off;
+	s64 lat;
+	u32 sec;
+
+	if (!net_eq(dev_net(dev), pn->net) || skb->pkt_type == PACKET_OTHERHOST)
+		goto out;
+
+	if (skb->protocol == htons(ETH_P_IP)) {
+		struct iphdr _iph, *iph;
+
+		iph = skb_header_pointer(skb, 0, sizeof(_iph), &_iph);
+		if (!iph || iph->protocol != IPPROTO_UDP ||
+		    iph->frag_off & htons(IP_MF | IP_OFFSET))
+			goto out;
+		off = iph->ihl * 4;
+	} else {
+		struct ipv6hdr _ip6h, *ip6h;
+
+		ip6h = skb_header_pointer(skb, 0, sizeof(_ip6h), &_ip6h);
+		if (!ip6h || ip6h->nexthdr != IPPROTO_UDP)
+			goto out;
+		off = sizeof(*ip6h);
+	}
+
+	pgh = skb_header_pointer(skb, off + sizeof(struct udphdr),
+				 sizeof(_pgh), &_pgh);
+	if (!pgh || pgh->pgh_magic != htonl(PKTGEN_MAGIC))
+		goto out;
+
+	st = this_cpu_ptr(pn->rx_stats);
+	st->pkts++;
+	st->bytes += skb->len;
+
+	if (!pgh->tv_sec && !pgh->tv_usec) {
+		st->no_timestamp++;
+		goto out;
+	}
+
+	/* The sender only has the low 32 bits of the seconds */
+	ktime_get_real_ts64(&now);
+	sec = (u32)now.tv_sec - ntohl(pgh->tv_sec);
+	lat = (s64)(s32)sec * USEC_PER_SEC +
+	      now.tv_nsec / NSEC_PER_USEC - ntohl(pgh->tv_usec);
+	if (lat < 0) {
+		st->clock_skew++;
+		goto out;
+	}
+
+	st->lat_sum += lat;
+	if (lat > st->lat_max)
+		st->lat_max = lat;
+	st->hist[min_t(int, fls64(lat), PG_RX_HIST_BUCKETS - 1)]++;
+out:
+	consume_skb(skb);
+	return NET_RX_SUCCESS;
+}
+
+static void pktgen_rx_start(struct pktgen_net *pn)
+{
+	mutex_lock(&pktgen_thread_lock);
+	if (!pn->rx_enabled) {
+		pn->rx_pt[0].type = htons(ETH_P_IP);
+		pn->rx_pt[1].type = htons(ETH_P_IPV6);
+		pn->rx_pt[0].func = pn->rx_pt[1].func = pktgen_rx_rcv;
+		pn->rx_pt[0].af_packet_priv = pn->rx_pt[1].af_packet_priv = pn;
+		dev_add_pack(&pn->rx_pt[0]);
+		dev_add_pack(&pn->rx_pt[1]);
+		pn->rx_enabled = true;
+	}
+	mutex_unlock(&pktgen_thread_lock);
+}
+
+static void pktgen_rx_stop(struct pktgen_net *pn)
+{
+	mutex_lock(&pktgen_thread_lock);
+	if (pn->rx_enabled) {
+		__dev_remove_pack(&pn->rx_pt[0]);
+		__dev_remove_pack(&pn->rx_pt[1]);
+		synchronize_net();
+		pn->rx_enabled = false;
+	}
+	mutex_unlock(&pktgen_thread_lock);
+}
+
+static void pktgen_rx_reset(struct pktgen_net *pn)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(pn->rx_stats, cpu), 0,
+		       sizeof(struct pktgen_rx_stats));
+}
+
+static int pgrx_show(struct seq_file *seq, void *v)
+{
+	struct pktgen_net *pn = seq->private;
+	struct pktgen_rx_stats sum = {};
+	u64 lat_avg = 0, timed;
+	int cpu, i;
+
+	for_each_possible_cpu(cpu) {
+		const struct pktgen_rx_stats *st = per_cpu_ptr(pn->rx_stats, cpu);
+
+		sum.pkts += st->pkts;
+		sum.bytes += st->bytes;
+		sum.no_timestamp += st->no_timestamp;
+		sum.clock_skew += st->clock_skew;
+		sum.lat_sum += st->lat_sum;
+		sum.lat_max = max(sum.lat_max, st->lat_max);
+		for (i = 0; i < PG_RX_HIST_BUCKETS; i++)
+			sum.hist[i] += st->hist[i];
+	}
+
+	timed = sum.pkts - sum.no_timestamp - sum.clock_skew;
+	if (timed)
+		lat_avg = div64_u64(sum.lat_sum, timed);
+
+	seq_printf(seq, "Receiving: %s\n", pn->rx_enabled ? "on" : "off");
+	seq_printf(seq, "pkts: %llu  bytes: %llu  no_timestamp: %llu  clock_skew: %llu\n",
+		   sum.pkts, sum.bytes, sum.no_timestamp, sum.clock_skew);
+	seq_printf(seq, "latency (usec): avg: %llu  max: %llu\n",
+		   lat_avg, sum.lat_max);
+	seq_printf(seq, "%10llu - %-10llu: %llu\n", 0ULL, 1ULL, sum.hist[0]);
+	for (i = 1; i < PG_RX_HIST_BUCKETS - 1; i++)
+		seq_printf(seq, "%10llu - %-10llu: %llu\n",
+			   1ULL << (i - 1), 1ULL << i, sum.hist[i]);
+	seq_printf(seq, "%10llu -           : %llu\n",
+		   1ULL << (i - 1), sum.hist[i]);
+
+	return 0;
+}
+
+static int pgrx_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, pgrx_show, PDE_DATA(inode));
+}
+
+static const struct file_operations pktgen_rx_fops = {
+	.owner   = THIS_MODULE,
+	.open    = pgrx_open,
+	.read    = seq_read,
+	.llseek  = seq_lseek,
+	.release = single_release,
+};
+
 static int pktgen_if_show(struct seq_file *seq, void *v)
 {
 	const struct pktgen_dev *pkt_dev = seq->private;
@@ -3879,6 +4067,18 @@ static int __net_init pg_net_init(struct net *net)
 		goto remove;
 	}
 
+	pn->rx_stats = alloc_percpu(struct pktgen_rx_stats);
+	if (!pn->rx_stats) {
+		ret = -ENOMEM;
+		goto remove_entry;
+	}
+	pe = proc_create_data(PGRX, 0600, pn->proc_dir, &pktgen_rx_fops, pn);
+	if (pe == NULL) {
+		pr_err("cannot create %s procfs entry\n", PGRX);
+		ret = -EINVAL;
+		goto free_rx_stats;
+	}
+
 	for_each_online_cpu(cpu) {
 		int err;
 
@@ -3891,11 +4091,15 @@ static int __net_init pg_net_init(struct net *net)
 	if (list_empty(&pn->pktgen_threads)) {
 		pr_err("Initialization failed for all threads\n");
 		ret = -ENODEV;
-		goto remove_entry;
+		goto remove_rx_entry;
 	}
 
 	return 0;
 
+remove_rx_entry:
+	remove_proc_entry(PGRX, pn->proc_dir);
+free_rx_stats:
+	free_percpu(pn->rx_stats);
 remove_entry:
 	remove_proc_entry(PGCTRL, pn->proc_dir);
 remove:
@@ -3912,6 +4116,7 @@ static void __net_exit pg_net_exit(struct net *net)
 
 	/* Stop all interfaces & threads */
 	pn->pktgen_exiting = true;
+	pktgen_rx_stop(pn);
 
 	mutex_lock(&pktgen_thread_lock);
 	list_splice_init(&pn->pktgen_threads, &list);
@@ -3925,6 +4130,8 @@ static void __net_exit pg_net_exit(struct net *net)
 		kfree(t);
 	}
 
+	remove_proc_entry(PGRX, pn->proc_dir);
+	free_percpu(pn->rx_stats);
 	remove_proc_entry(PGCTRL, pn->proc_dir);
 	remove_proc_entry(PG_PROC_DIR, pn->net->proc_net);
 }
@@ -466,7 +466,9 @@ static void unix_write_space(struct sock *sk)
  * may receive messages only from that peer. */
 static void unix_dgram_disconnected(struct sock *sk, struct sock *other)
 {
-	if (!skb_queue_empty(&sk->sk_receive_queue)) {
+	if (!skb_queue_empty(&sk->sk_receive_queue) ||
+	    !skb_queue_empty(&unix_sk(sk)->rx_batch)) {
+		skb_queue_purge(&unix_sk(sk)->rx_batch);
 		skb_queue_purge(&sk->sk_receive_queue);
 		wake_up_interruptible_all(&unix_sk(sk)->peer_wait);
 
@@ -485,6 +487,7 @@ static void unix_sock_destructor(struct sock *sk)
 {
 	struct unix_sock *u = unix_sk(sk);
 
+	skb_queue_purge(&u->rx_batch);
 	skb_queue_purge(&sk->sk_receive_queue);
 
 	WARN_ON(refcount_read(&sk->sk_wmem_alloc));
@@ -552,6 +555,7 @@ static void unix_release_sock(struct sock *sk, int embrion)
 
 	/* Try to flush out this socket. Throw out buffers at least */
 
+	skb_queue_purge(&u->rx_batch);
 	while ((skb = skb_dequeue(&sk->sk_receive_queue)) != NULL) {
 		if (state == TCP_LISTEN)
 			unix_release_sock(skb->sk, 1);
@@ -784,6 +788,7 @@ static struct sock *unix_create1(struct net *net, struct socket *sock, int kern)
 	mutex_init(&u->bindlock); /* single task binding lock */
 	init_waitqueue_head(&u->peer_wait);
 	init_waitqueue_func_entry(&u->peer_wake, unix_dgram_peer_wake_relay);
+	skb_queue_head_init(&u->rx_batch);
 	unix_insert_socket(unix_sockets_unbound(sk), sk);
 out:
 	if (sk == NULL)
@@ -1828,6 +1833,31 @@ static int unix_dgram_sendmsg(struct socket *sock, struct msghdr *msg,
  */
 #define UNIX_SKB_FRAGS_SZ (PAGE_SIZE << get_order(32768))
 
+/* Below this, pinning the sender pages costs more than copying them */
+#define UNIX_ZEROCOPY_MIN_SZ	(4 * PAGE_SIZE)
+
+/*
+ * With MSG_ZEROCOPY, the pages of the sender are pinned and attached to
+ * the skb as frags instead of being copied, so the receiver copies the
+ * data once, straight from them.  The completion is reported on the
+ * error queue of the sender once the receiver has consumed the skbs.
+ */
+static int unix_stream_zerocopy_fill(struct sk_buff *skb, struct msghdr *msg,
+				     int size, struct ubuf_info *uarg)
+{
+	int err;
+
+	err = __zerocopy_sg_from_iter(NULL, skb, &msg->msg_iter, size);
+	/* Out of frags: send what was pinned, the rest in the next skb */
+	if (err == -EMSGSIZE && skb->len)
+		err = 0;
+	if (err)
+		return err;
+
+	skb_zcopy_set(skb, uarg);
+	return skb->len;
+}
+
 static int unix_stream_sendmsg(struct socket *sock, struct msghdr *msg,
 			       size_t len)
 {
@@ -1838,6 +1868,7 @@ static int unix_stream_sendmsg(struct socket *sock, struct msghdr *msg,
 	int sent = 0;
 	struct scm_cookie scm;
 	bool fds_sent = false;
+	struct ubuf_info *uarg = NULL;
 	int data_len;
 
 	wait_for_unix_gc();
@@ -1862,12 +1893,40 @@ static int unix_stream_sendmsg(struct socket *sock, struct msghdr *msg,
 	if (sk->sk_shutdown & SEND_SHUTDOWN)
 		goto pipe_err;
 
+	if ((msg->msg_flags & MSG_ZEROCOPY) && len >= UNIX_ZEROCOPY_MIN_SZ) {
+		uarg = sock_zerocopy_alloc(sk, len);
+		if (!uarg && sock_flag(sk, SOCK_ZEROCOPY)) {
+			err = -ENOBUFS;
+			goto out_err;
+		}
+	}
+
 	while (sent < len) {
 		size = len - sent;
 
 		/* Keep two messages in the pipe so it schedules better */
 		size = min_t(int, size, (sk->sk_sndbuf >> 1) - 64);
 
+		if (uarg) {
+			skb = sock_alloc_send_pskb(sk, 0, 0,
+						   msg->msg_flags & MSG_DONTWAIT,
+						   &err, 0);
+			if (!skb)
+				goto out_err;
+
+			err = unix_scm_to_skb(&scm, skb, !fds_sent);
+			if (err >= 0)
+				err = unix_stream_zerocopy_fill(skb, msg, size,
+								uarg);
+			if (err < 0) {
+				kfree_skb(skb);
+				goto out_err;
+			}
+			fds_sent = true;
+			size = err;
+			goto queue;
+		}
+
 		/* allow fallback to order-0 allocations */
 		size = min_t(int, size, SKB_MAX_HEAD(0) + UNIX_SKB_FRAGS_SZ);
 
@@ -1898,6 +1957,7 @@ static int unix_stream_sendmsg(struct socket *sock, struct msghdr *msg,
 			goto out_err;
 		}
 
+queue:
 		unix_state_lock(other);
 
 		if (sock_flag(other, SOCK_DEAD) ||
@@ -1911,6 +1971,7 @@ static int unix_stream_sendmsg(struct socket *sock, struct msghdr *msg,
 		sent += size;
 	}
 
+	sock_zerocopy_put(uarg);
 	scm_destroy(&scm);
 
 	return sent;
@@ -1923,6 +1984,10 @@ static int unix_stream_sendmsg(struct socket *sock, struct msghdr *msg,
 		send_sig(SIGPIPE, current, 0);
 	err = -EPIPE;
 out_err:
+	if (sent)
+		sock_zerocopy_put(uarg);
+	else
+		sock_zerocopy_put_abort(uarg);
 	scm_destroy(&scm);
 	return sent ? : err;
 }
@@ -2083,6 +2148,67 @@ static void unix_copy_addr(struct msghdr *msg, struct sock *sk)
 	}
 }
 
+/* Datagrams moved off the receive queue at once */
+#define UNIX_DGRAM_RX_BATCH	16
+
+/*
+ * The receive queue lock of a datagram socket is shared with all its
+ * senders.  A busy receiver moves the datagrams queued so far to its own
+ * list in one go, and reads the following ones from there without
+ * touching that lock.  Datagrams carrying fds are left on the queue, for
+ * the garbage collector to see them.
+ *
+ * Peeking, and reporting a pending error, go through the receive queue:
+ * the batch is put back at its head first, to keep the datagrams in
+ * order.  Called with the iolock held.
+ */
+static struct sk_buff *unix_dgram_recv_batched(struct sock *sk, int flags)
+{
+	struct sk_buff_head *queue = &sk->sk_receive_queue;
+	struct unix_sock *u = unix_sk(sk);
+	struct sk_buff_head batch;
+	struct sk_buff *skb;
+
+	if (sk->sk_type != SOCK_DGRAM)
+		return NULL;
+
+	if ((flags & MSG_PEEK) || sk->sk_err) {
+		if (!skb_queue_empty(&u->rx_batch)) {
+			spin_lock(&queue->lock);
+			spin_lock(&u->rx_batch.lock);
+			skb_queue_splice_init(&u->rx_batch, queue);
+			spin_unlock(&u->rx_batch.lock);
+			spin_unlock(&queue->lock);
+		}
+		return NULL;
+	}
+
+	skb = skb_dequeue(&u->rx_batch);
+	if (skb)
+		return skb;
+
+	__skb_queue_head_init(&batch);
+
+	spin_lock(&queue->lock);
+	while (skb_queue_len(&batch) < UNIX_DGRAM_RX_BATCH) {
+		skb = skb_peek(queue);
+		if (!skb || UNIXCB(skb).fp)
+			break;
+		__skb_unlink(skb, queue);
+		__skb_queue_tail(&batch, skb);
+	}
+	spin_unlock(&queue->lock);
+
+	skb = __skb_dequeue(&batch);
+	if (!skb_queue_empty(&batch)) {
+		spin_lock(&u->rx_batch.lock);
+		skb_queue_splice_tail(&batch, &u->rx_batch);
+		spin_unlock(&u->rx_batch.lock);
+	}
+
+	return skb;
+}
+
 static int unix_dgram_recvmsg(struct socket *sock, struct msghdr *msg,
 			      size_t size, int flags)
 {
@@ -2104,6 +2230,10 @@ static int unix_dgram_recvmsg(struct socket *sock, struct msghdr *msg,
 		mutex_lock(&u->iolock);
 
 		skip = sk_peek_offset(sk, flags);
+		skb = unix_dgram_recv_batched(sk, flags);
+		if (skb)
+			break;
+
 		skb = __skb_try_recv_datagram(sk, flags, NULL, &peeked, &skip,
 					      &err, &last);
 		if (skb)
@@ -2464,6 +2594,11 @@ static int unix_stream_recvmsg(struct socket *sock, struct msghdr *msg,
 		.flags = flags
 	};
 
+	/* MSG_ZEROCOPY completions */
+	if (flags & MSG_ERRQUEUE)
+		return sock_recv_errqueue(sock->sk, msg, size, SOL_SOCKET,
+					  SO_ZEROCOPY);
+
 	return unix_stream_read_generic(&state, true);
 }
 
@@ -2558,9 +2693,12 @@ long unix_inq_len(struct sock *sk)
 		skb_queue_walk(&sk->sk_receive_queue, skb)
 			amount += unix_skb_len(skb);
 	} else {
-		skb = skb_peek(&sk->sk_receive_queue);
+		spin_lock(&unix_sk(sk)->rx_batch.lock);
+		skb = skb_peek(&unix_sk(sk)->rx_batch) ? :
+		      skb_peek(&sk->sk_receive_queue);
 		if (skb)
 			amount = skb->len;
+		spin_unlock(&unix_sk(sk)->rx_batch.lock);
 	}
 	spin_unlock(&sk->sk_receive_queue.lock);
 
@@ -2656,7 +2794,8 @@ static unsigned int unix_poll(struct file *file, struct socket *sock, poll_table
 		mask |= POLLRDHUP | POLLIN | POLLRDNORM;
 
 	/* readable? */
-	if (!skb_queue_empty(&sk->sk_receive_queue))
+	if (!skb_queue_empty(&sk->sk_receive_queue) ||
+	    !skb_queue_empty(&unix_sk(sk)->rx_batch))
 		mask |= POLLIN | POLLRDNORM;
 
 	/* Connection-based need to check for termination and startup */
@@ -2875,6 +3014,19 @@ static const struct file_operations unix_seq_fops = {
 	.release	= seq_release_net,
 };
 
+static int unix_gc_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, unix_gc_stats_show, NULL);
+}
+
+static const struct file_operations unix_gc_stats_fops = {
+	.owner		= THIS_MODULE,
+	.open		= unix_gc_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 #endif
 
 static const struct net_proto_family unix_family_ops = {
@@ -2897,6 +3049,13 @@ static int __net_init unix_net_init(struct net *net)
 		unix_sysctl_unregister(net);
 		goto out;
 	}
+	/* The collector is shared by all the namespaces */
+	if (net_eq(net, &init_net) &&
+	    !proc_create("unix_gc", 0444, net->proc_net, &unix_gc_stats_fops)) {
+		remove_proc_entry("unix", net->proc_net);
+		unix_sysctl_unregister(net);
+		goto out;
+	}
 #endif
 	error = 0;
 out:
@@ -2907,6 +3066,8 @@ static void __net_exit unix_net_exit(struct net *net)
 {
 	unix_sysctl_unregister(net);
 	remove_proc_entry("unix", net->proc_net);
+	if (net_eq(net, &init_net))
+		remove_proc_entry("unix_gc", net->proc_net);
 }
 
 static struct pernet_operations unix_net_ops = {
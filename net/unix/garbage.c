@@ -79,7 +79,11 @@
 #include <linux/file.h>
 #include <linux/proc_fs.h>
 #include <linux/mutex.h>
+#include <linux/seq_file.h>
 #include <linux/wait.h>
+#include <linux/sched/clock.h>
+#include <linux/sched/user.h>
+#include <linux/workqueue.h>
 
 #include <net/sock.h>
 #include <net/af_unix.h>
@@ -91,10 +95,18 @@
 static LIST_HEAD(gc_inflight_list);
 static LIST_HEAD(gc_candidates);
 static DEFINE_SPINLOCK(unix_gc_lock);
-static DECLARE_WAIT_QUEUE_HEAD(unix_gc_wait);
 
 unsigned int unix_tot_inflight;
 
+/* Protected by unix_gc_lock */
+static struct {
+	unsigned long	runs;
+	unsigned long	collected;	/* sockets freed as part of a cycle */
+	u64		last_ns;
+	u64		max_ns;
+	u64		total_ns;
+} unix_gc_stats;
+
 struct sock *unix_get_socket(struct file *filp)
 {
 	struct sock *u_sock = NULL;
@@ -256,33 +268,51 @@ static void inc_inflight_move_tail(struct unix_sock *u)
 
 static bool gc_in_progress;
 #define UNIX_INFLIGHT_TRIGGER_GC 16000
+#define UNIX_INFLIGHT_SANE_USER (SCM_MAX_FD * 8)
+
+static void __unix_gc(struct work_struct *work);
+static DECLARE_WORK(unix_gc_work, __unix_gc);
 
 void wait_for_unix_gc(void)
 {
 	/* If number of inflight sockets is insane,
 	 * force a garbage collect right now.
 	 */
-	if (unix_tot_inflight > UNIX_INFLIGHT_TRIGGER_GC && !gc_in_progress)
+	if (READ_ONCE(unix_tot_inflight) > UNIX_INFLIGHT_TRIGGER_GC &&
+	    !READ_ONCE(gc_in_progress))
 		unix_gc();
-	wait_event(unix_gc_wait, gc_in_progress == false);
+
+	/* Only throttle the users that keep many fds in flight, the
+	 * collection runs in the background for everybody else.
+	 */
+	if (READ_ONCE(current_user()->unix_inflight) < UNIX_INFLIGHT_SANE_USER)
+		return;
+
+	if (READ_ONCE(gc_in_progress))
+		flush_work(&unix_gc_work);
 }
 
 /* The external entry point: unix_gc() */
 void unix_gc(void)
+{
+	WRITE_ONCE(gc_in_progress, true);
+	queue_work(system_unbound_wq, &unix_gc_work);
+}
+
+static void __unix_gc(struct work_struct *work)
 {
 	struct unix_sock *u;
 	struct unix_sock *next;
 	struct sk_buff_head hitlist;
 	struct list_head cursor;
 	LIST_HEAD(not_cycle_list);
+	unsigned long collected = 0;
+	u64 start, delta;
 
-	spin_lock(&unix_gc_lock);
+	start = local_clock();
 
-	/* Avoid a recursive GC. */
-	if (gc_in_progress)
-		goto out;
+	spin_lock(&unix_gc_lock);
 
-	gc_in_progress = true;
 	/* First, select candidates for garbage collection.  Only
 	 * in-flight sockets are considered, and from those only ones
 	 * which don't have any external reference.
@@ -347,8 +377,10 @@ void unix_gc(void)
 	 * which are creating the cycle(s).
 	 */
 	skb_queue_head_init(&hitlist);
-	list_for_each_entry(u, &gc_candidates, link)
+	list_for_each_entry(u, &gc_candidates, link) {
 		scan_children(&u->sk, inc_inflight, &hitlist);
+		collected++;
+	}
 
 	/* not_cycle_list contains those sockets which do not make up a
 	 * cycle.  Restore these to the inflight list.
@@ -368,9 +400,33 @@ void unix_gc(void)
 
 	/* All candidates should have been detached by now. */
 	BUG_ON(!list_empty(&gc_candidates));
-	gc_in_progress = false;
-	wake_up(&unix_gc_wait);
 
- out:
+	delta = local_clock() - start;
+	unix_gc_stats.runs++;
+	unix_gc_stats.collected += collected;
+	unix_gc_stats.last_ns = delta;
+	unix_gc_stats.max_ns = max(unix_gc_stats.max_ns, delta);
+	unix_gc_stats.total_ns += delta;
+
+	/* Another collection may have been requested meanwhile */
+	if (!work_pending(&unix_gc_work))
+		WRITE_ONCE(gc_in_progress, false);
+
+	spin_unlock(&unix_gc_lock);
+}
+
+#ifdef CONFIG_PROC_FS
+int unix_gc_stats_show(struct seq_file *seq, void *v)
+{
+	spin_lock(&unix_gc_lock);
+	seq_printf(seq, "inflight %u\n", unix_tot_inflight);
+	seq_printf(seq, "runs %lu\n", unix_gc_stats.runs);
+	seq_printf(seq, "collected %lu\n", unix_gc_stats.collected);
+	seq_printf(seq, "last_ns %llu\n", unix_gc_stats.last_ns);
+	seq_printf(seq, "max_ns %llu\n", unix_gc_stats.max_ns);
+	seq_printf(seq, "total_ns %llu\n", unix_gc_stats.total_ns);
 	spin_unlock(&unix_gc_lock);
+
+	return 0;
 }
+#endif
@@ -37,6 +37,7 @@
 #define AVC_CACHE_SLOTS			512
 #define AVC_DEF_CACHE_THRESHOLD		512
 #define AVC_CACHE_RECLAIM		16
+#define AVC_PCPU_SLOTS			64
 
 #ifdef CONFIG_SECURITY_SELINUX_AVC_STATS
 #define avc_cache_stats_incr(field)	this_cpu_inc(avc_cache_stats.field)
@@ -76,6 +77,26 @@ struct avc_cache {
 	u32			latest_notif;	/* latest revocation notification */
 };
 
+/*
+ * Per-CPU direct-mapped cache of recent decisions in front of avc_cache.
+ * Any change of the entries of avc_cache bumps avc_pcpu_gen, which
+ * invalidates all the per-CPU entries at once, as well as the decisions
+ * cached in inodes, see avc_decision_gen().
+ */
+struct avc_pcpu_entry {
+	u32			ssid;
+	u32			tsid;
+	u16			tclass;
+	unsigned int		gen;
+	struct av_decision	avd;
+};
+
+struct avc_pcpu_cache {
+	struct avc_pcpu_entry	slots[AVC_PCPU_SLOTS];
+	unsigned int		lookups;
+	unsigned int		hits;
+};
+
 struct avc_callback_node {
 	int (*callback) (u32 event);
 	u32 events;
@@ -90,6 +111,9 @@ DEFINE_PER_CPU(struct avc_cache_stats, avc_cache_stats) = { 0 };
 #endif
 
 static struct avc_cache avc_cache;
+static DEFINE_PER_CPU(struct avc_pcpu_cache, avc_pcpu_cache);
+/* Starts at 1 so that the zeroed per-CPU entries are invalid */
+static atomic_t avc_pcpu_gen = ATOMIC_INIT(1);
 static struct avc_callback_node *avc_callbacks;
 static struct kmem_cache *avc_node_cachep;
 static struct kmem_cache *avc_xperms_data_cachep;
@@ -202,6 +226,7 @@ void __init avc_init(void)
 int avc_get_hash_stats(char *page)
 {
 	int i, chain_len, max_chain_len, slots_used;
+	unsigned int pcpu_lookups = 0, pcpu_hits = 0;
 	struct avc_node *node;
 	struct hlist_head *head;
 
@@ -223,10 +248,70 @@ int avc_get_hash_stats(char *page)
 
 	rcu_read_unlock();
 
+	for_each_possible_cpu(i) {
+		pcpu_lookups += per_cpu(avc_pcpu_cache, i).lookups;
+		pcpu_hits += per_cpu(avc_pcpu_cache, i).hits;
+	}
+
 	return scnprintf(page, PAGE_SIZE, "entries: %d\nbuckets used: %d/%d\n"
-			 "longest chain: %d\n",
+			 "longest chain: %d\npercpu hits: %u/%u\n",
 			 atomic_read(&avc_cache.active_nodes),
-			 slots_used, AVC_CACHE_SLOTS, max_chain_len);
+			 slots_used, AVC_CACHE_SLOTS, max_chain_len,
+			 pcpu_hits, pcpu_lookups);
+}
+
+/* Invalidate the per-CPU caches, after a change to avc_cache */
+static inline void avc_pcpu_invalidate(void)
+{
+	smp_mb__before_atomic();
+	atomic_inc(&avc_pcpu_gen);
+}
+
+/*
+ * Look @ssid, @tsid, @tclass up in the cache of this CPU.  On a miss, @gen
+ * is the generation to give to avc_pcpu_fill() with the decision found in
+ * avc_cache.  Interrupts are disabled as softirqs check permissions too.
+ */
+static bool avc_pcpu_lookup(u32 ssid, u32 tsid, u16 tclass,
+			    struct av_decision *avd, unsigned int *gen)
+{
+	struct avc_pcpu_cache *cache;
+	struct avc_pcpu_entry *e;
+	unsigned long flags;
+	bool hit;
+
+	*gen = avc_decision_gen();
+
+	local_irq_save(flags);
+	cache = this_cpu_ptr(&avc_pcpu_cache);
+	e = &cache->slots[avc_hash(ssid, tsid, tclass) & (AVC_PCPU_SLOTS - 1)];
+	cache->lookups++;
+	hit = e->gen == *gen && e->ssid == ssid && e->tsid == tsid &&
+	      e->tclass == tclass;
+	if (hit) {
+		cache->hits++;
+		memcpy(avd, &e->avd, sizeof(*avd));
+	}
+	local_irq_restore(flags);
+
+	return hit;
+}
+
+static void avc_pcpu_fill(u32 ssid, u32 tsid, u16 tclass,
+			  struct av_decision *avd, unsigned int gen)
+{
+	struct avc_pcpu_entry *e;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	e = this_cpu_ptr(&avc_pcpu_cache.slots[avc_hash(ssid, tsid, tclass) &
+					       (AVC_PCPU_SLOTS - 1)]);
+	e->ssid = ssid;
+	e->tsid = tsid;
+	e->tclass = tclass;
+	e->gen = gen;
+	memcpy(&e->avd, avd, sizeof(e->avd));
+	local_irq_restore(flags);
 }
 
 /*
@@ -687,6 +772,7 @@ static struct avc_node *avc_insert(u32 ssid, u32 tsid, u16 tclass,
 			    pos->ae.tsid == tsid &&
 			    pos->ae.tclass == tclass) {
 				avc_node_replace(node, pos);
+				avc_pcpu_invalidate();
 				goto found;
 			}
 		}
@@ -895,6 +981,7 @@ static int avc_update_node(u32 event, u32 perms, u8 driver, u8 xperm, u32 ssid,
 		break;
 	}
 	avc_node_replace(node, orig);
+	avc_pcpu_invalidate();
 out_unlock:
 	spin_unlock_irqrestore(lock, flag);
 out:
@@ -927,6 +1014,7 @@ static void avc_flush(void)
 		rcu_read_unlock();
 		spin_unlock_irqrestore(lock, flag);
 	}
+	avc_pcpu_invalidate();
 }
 
 /**
@@ -1098,6 +1186,7 @@ inline int avc_has_perm_noaudit(u32 ssid, u32 tsid,
 {
 	struct avc_node *node;
 	struct avc_xperms_node xp_node;
+	unsigned int gen;
 	int rc = 0;
 	u32 denied;
 
@@ -1105,11 +1194,15 @@ inline int avc_has_perm_noaudit(u32 ssid, u32 tsid,
 
 	rcu_read_lock();
 
-	node = avc_lookup(ssid, tsid, tclass);
-	if (unlikely(!node))
-		node = avc_compute_av(ssid, tsid, tclass, avd, &xp_node);
-	else
-		memcpy(avd, &node->ae.avd, sizeof(*avd));
+	if (!avc_pcpu_lookup(ssid, tsid, tclass, avd, &gen)) {
+		node = avc_lookup(ssid, tsid, tclass);
+		if (unlikely(!node))
+			node = avc_compute_av(ssid, tsid, tclass, avd,
+					      &xp_node);
+		else
+			memcpy(avd, &node->ae.avd, sizeof(*avd));
+		avc_pcpu_fill(ssid, tsid, tclass, avd, gen);
+	}
 
 	denied = requested & ~(avd->allowed);
 	if (unlikely(denied))
@@ -1170,6 +1263,18 @@ u32 avc_policy_seqno(void)
 	return avc_cache.latest_notif;
 }
 
+/*
+ * Generation of the AVC decisions: a decision obtained after reading it
+ * is still valid as long as it doesn't change.
+ */
+unsigned int avc_decision_gen(void)
+{
+	unsigned int gen = atomic_read(&avc_pcpu_gen);
+
+	smp_rmb();
+	return gen;
+}
+
 void avc_disable(void)
 {
 	/*
@@ -235,6 +235,7 @@ static int inode_alloc_security(struct inode *inode)
 		return -ENOMEM;
 
 	spin_lock_init(&isec->lock);
+	seqcount_init(&isec->avd_seq);
 	INIT_LIST_HEAD(&isec->list);
 	isec->inode = inode;
 	isec->sid = SECINITSID_UNLABELED;
@@ -3047,6 +3048,46 @@ static noinline int audit_inode_permission(struct inode *inode,
 	return 0;
 }
 
+/*
+ * Whether @perms were granted to @sid on @isec, without auditing, by the
+ * last decision cached in @isec and the AVC didn't change since.
+ */
+static bool inode_avd_cached(struct inode_security_struct *isec, u32 sid,
+			     u32 perms)
+{
+	unsigned int seq;
+	bool hit;
+
+	do {
+		seq = read_seqcount_begin(&isec->avd_seq);
+		hit = isec->avd_gen == avc_decision_gen() &&
+		      isec->avd_ssid == sid && isec->avd_tsid == isec->sid &&
+		      isec->avd_tclass == isec->sclass &&
+		      !(perms & ~isec->avd_perms);
+	} while (read_seqcount_retry(&isec->avd_seq, seq));
+
+	return hit;
+}
+
+static void inode_avd_cache(struct inode_security_struct *isec, u32 sid,
+			    u32 tsid, u16 tclass, struct av_decision *avd,
+			    unsigned int gen)
+{
+	/* Another task is caching its decision, leave it the place */
+	if (!spin_trylock(&isec->lock))
+		return;
+
+	write_seqcount_begin(&isec->avd_seq);
+	isec->avd_ssid = sid;
+	isec->avd_tsid = tsid;
+	isec->avd_tclass = tclass;
+	isec->avd_perms = avd->allowed & ~avd->auditallow;
+	isec->avd_gen = gen;
+	write_seqcount_end(&isec->avd_seq);
+
+	spin_unlock(&isec->lock);
+}
+
 static int selinux_inode_permission(struct inode *inode, int mask)
 {
 	const struct cred *cred = current_cred();
@@ -3054,8 +3095,10 @@ static int selinux_inode_permission(struct inode *inode, int mask)
 	bool from_access;
 	unsigned flags = mask & MAY_NOT_BLOCK;
 	struct inode_security_struct *isec;
-	u32 sid;
+	u32 sid, tsid;
+	u16 tclass;
 	struct av_decision avd;
+	unsigned int gen;
 	int rc, rc2;
 	u32 audited, denied;
 
@@ -3078,12 +3121,22 @@ static int selinux_inode_permission(struct inode *inode, int mask)
 	if (IS_ERR(isec))
 		return PTR_ERR(isec);
 
-	rc = avc_has_perm_noaudit(sid, isec->sid, isec->sclass, perms, 0, &avd);
+	/* Repeated opens of the same file by the same domain */
+	if (inode_avd_cached(isec, sid, perms))
+		return 0;
+
+	gen = avc_decision_gen();
+	tsid = READ_ONCE(isec->sid);
+	tclass = READ_ONCE(isec->sclass);
+	rc = avc_has_perm_noaudit(sid, tsid, tclass, perms, 0, &avd);
 	audited = avc_audit_required(perms, &avd, rc,
 				     from_access ? FILE__AUDIT_ACCESS : 0,
 				     &denied);
-	if (likely(!audited))
+	if (likely(!audited)) {
+		if (!rc)
+			inode_avd_cache(isec, sid, tsid, tclass, &avd, gen);
 		return rc;
+	}
 
 	rc2 = audit_inode_permission(inode, perms, audited, denied, rc, flags);
 	if (rc2)
@@ -25,6 +25,7 @@
 #include <linux/binfmts.h>
 #include <linux/in.h>
 #include <linux/spinlock.h>
+#include <linux/seqlock.h>
 #include <net/net_namespace.h>
 #include "flask.h"
 #include "avc.h"
@@ -65,6 +66,13 @@ struct inode_security_struct {
 	u16 sclass;		/* security class of this object */
 	unsigned char initialized;	/* initialization flag */
 	spinlock_t lock;
+	/* Last decision of selinux_inode_permission(), see avc_decision_gen() */
+	seqcount_t avd_seq;
+	u32 avd_ssid;		/* SID of the task it was made for */
+	u32 avd_tsid;		/* SID of this object it was made for */
+	u16 avd_tclass;		/* security class it was made for */
+	u32 avd_perms;		/* permissions granted without auditing */
+	unsigned int avd_gen;	/* AVC generation it was made in */
 };
 
 struct file_security_struct {
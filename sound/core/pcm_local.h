@@ -36,6 +36,10 @@ int snd_pcm_update_hw_ptr(struct snd_pcm_substream *substream);
 void snd_pcm_playback_silence(struct snd_pcm_substream *substream,
 			      snd_pcm_uframes_t new_hw_ptr);
 
+void snd_pcm_ptr_timer_start(struct snd_pcm_substream *substream);
+void snd_pcm_ptr_timer_stop(struct snd_pcm_substream *substream);
+void snd_pcm_ptr_timer_free(struct snd_pcm_substream *substream);
+
 #ifdef CONFIG_SND_PCM_TIMER
 void snd_pcm_timer_resolution_change(struct snd_pcm_substream *substream);
 void snd_pcm_timer_init(struct snd_pcm_substream *substream);
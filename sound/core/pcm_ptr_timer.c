@@ -0,0 +1,149 @@
+/*
+ * Timer-driven hw pointer updates for PCM streams without period wakeups
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ * A stream opened with SNDRV_PCM_HW_PARAMS_NO_PERIOD_WAKEUP only gets its
+ * hw pointer updated when user-space asks for it, typically with the
+ * SYNC_PTR ioctl.  When ptr_timer_us is set, such a stream gets a hrtimer
+ * instead, that refreshes the hw pointer in the mmapped status page every
+ * ptr_timer_us while the stream runs, so that an mmap client can read
+ * it directly.
+ */
+
+#include <linux/hrtimer.h>
+#include <linux/list.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <sound/core.h>
+#include <sound/pcm.h>
+
+#include "pcm_local.h"
+
+static unsigned int ptr_timer_us;
+module_param(ptr_timer_us, uint, 0644);
+MODULE_PARM_DESC(ptr_timer_us,
+		 "Period of the hw pointer updates of streams without period wakeups in us (0 = off)");
+
+struct snd_pcm_ptr_timer {
+	struct snd_pcm_substream *substream;
+	struct hrtimer hrt;
+	ktime_t interval;
+	bool running;
+	struct list_head list;
+};
+
+/* The substream runtime has no room for the timer, keep them aside */
+static LIST_HEAD(ptr_timers);
+static DEFINE_SPINLOCK(ptr_timers_lock);
+
+static struct snd_pcm_ptr_timer *
+find_ptr_timer(struct snd_pcm_substream *substream)
+{
+	struct snd_pcm_ptr_timer *pt;
+
+	list_for_each_entry(pt, &ptr_timers, list) {
+		if (pt->substream == substream)
+			return pt;
+	}
+	return NULL;
+}
+
+static enum hrtimer_restart snd_pcm_ptr_timer_callback(struct hrtimer *hrt)
+{
+	struct snd_pcm_ptr_timer *pt =
+		container_of(hrt, struct snd_pcm_ptr_timer, hrt);
+	struct snd_pcm_substream *substream = pt->substream;
+	enum hrtimer_restart ret = HRTIMER_NORESTART;
+	unsigned long flags;
+
+	snd_pcm_stream_lock_irqsave(substream, flags);
+	/* Restarted meanwhile, after a stop we were waiting for */
+	if (hrtimer_is_queued(hrt))
+		goto unlock;
+	if (pt->running && snd_pcm_running(substream)) {
+		snd_pcm_update_hw_ptr(substream);
+		hrtimer_forward_now(hrt, pt->interval);
+		ret = HRTIMER_RESTART;
+	}
+unlock:
+	snd_pcm_stream_unlock_irqrestore(substream, flags);
+	return ret;
+}
+
+/* Called with the stream lock held, when the stream starts or resumes */
+void snd_pcm_ptr_timer_start(struct snd_pcm_substream *substream)
+{
+	unsigned int us = READ_ONCE(ptr_timer_us);
+	struct snd_pcm_ptr_timer *pt;
+	unsigned long flags;
+
+	/* The callback takes the stream lock from hard irq context */
+	if (!us || !substream->runtime->no_period_wakeup ||
+	    substream->pcm->nonatomic)
+		return;
+
+	spin_lock_irqsave(&ptr_timers_lock, flags);
+	pt = find_ptr_timer(substream);
+	if (!pt) {
+		pt = kzalloc(sizeof(*pt), GFP_ATOMIC);
+		if (pt) {
+			pt->substream = substream;
+			hrtimer_init(&pt->hrt, CLOCK_MONOTONIC,
+				     HRTIMER_MODE_REL);
+			pt->hrt.function = snd_pcm_ptr_timer_callback;
+			list_add(&pt->list, &ptr_timers);
+		}
+	}
+	spin_unlock_irqrestore(&ptr_timers_lock, flags);
+	if (!pt)
+		return;
+
+	pt->interval = ns_to_ktime((u64)us * NSEC_PER_USEC);
+	pt->running = true;
+	hrtimer_start(&pt->hrt, pt->interval, HRTIMER_MODE_REL);
+}
+
+/* Called with the stream lock held, when the stream stops or pauses */
+void snd_pcm_ptr_timer_stop(struct snd_pcm_substream *substream)
+{
+	struct snd_pcm_ptr_timer *pt;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ptr_timers_lock, flags);
+	pt = find_ptr_timer(substream);
+	spin_unlock_irqrestore(&ptr_timers_lock, flags);
+	if (!pt)
+		return;
+
+	/* A running callback sees !running once it gets the stream lock */
+	pt->running = false;
+	hrtimer_try_to_cancel(&pt->hrt);
+}
+
+/* Called without the stream lock, once the stream is set up no more */
+void snd_pcm_ptr_timer_free(struct snd_pcm_substream *substream)
+{
+	struct snd_pcm_ptr_timer *pt;
+
+	spin_lock_irq(&ptr_timers_lock);
+	pt = find_ptr_timer(substream);
+	if (pt)
+		list_del(&pt->list);
+	spin_unlock_irq(&ptr_timers_lock);
+	if (!pt)
+		return;
+
+	hrtimer_cancel(&pt->hrt);
+	kfree(pt);
+}
@@ -108,6 +108,9 @@ struct sst_dbg_rbuffer {
 	unsigned long   total_avail;
 	/* To set the state of the stream incase of XRUN */
 	struct snd_compr_stream *stream;
+	/* window mapped by the reader, which then moves the read pointer */
+	bool		mapped;
+	u32		mapped_wp;
 };
 
 /*
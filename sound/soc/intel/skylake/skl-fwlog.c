@@ -18,6 +18,7 @@
 #include <linux/slab.h>
 #include <linux/device.h>
 #include <linux/delay.h>
+#include <linux/mm.h>
 #include <sound/compress_driver.h>
 #include "../common/sst-dsp.h"
 #include "../common/sst-dsp-priv.h"
@@ -151,6 +152,78 @@ void skl_dsp_write_log(struct sst_dsp *sst, void __iomem *src, int core,
 	wake_up(&buff->stream->runtime->sleep);
 }
 
+/*
+ * Size of the tracing window of each dsp.  The window starts with the
+ * read and write pointers, followed by the log ring.
+ */
+static u32 skl_dsp_log_window_size(struct sst_dsp *sst)
+{
+#if defined(CONFIG_SND_SOC_INTEL_CNL_FPGA)
+	return sst->trace_wind.size;
+#else
+	return sst->trace_wind.size / sst->trace_wind.nr_dsp;
+#endif
+}
+
+/*
+ * Map the tracing window of a dsp to the reader.  From then on the log
+ * is not copied any more: the reader takes the data from the window and
+ * moves the read pointer itself, and the notifications only account for
+ * the write pointer moving.  The pointers are shared with the firmware,
+ * so the window of each dsp has to fill whole pages.
+ */
+int skl_dsp_mmap_log(struct sst_dsp *sst, int core, phys_addr_t lpe_phys,
+			struct vm_area_struct *vma)
+{
+	struct sst_dbg_rbuffer *buff = sst->trace_wind.dbg_buffers[core];
+	unsigned long size = vma->vm_end - vma->vm_start;
+	u32 wsize = skl_dsp_log_window_size(sst);
+	unsigned long offset;
+	int ret;
+
+	if (!buff)
+		return -EBADFD;
+
+	offset = sst->trace_wind.addr - sst->addr.lpe + core * wsize;
+	if (!PAGE_ALIGNED(offset) || !PAGE_ALIGNED(wsize) ||
+	    vma->vm_pgoff || size > wsize)
+		return -EINVAL;
+
+	vma->vm_page_prot = pgprot_noncached(vma->vm_page_prot);
+	ret = io_remap_pfn_range(vma, vma->vm_start,
+				 (lpe_phys + offset) >> PAGE_SHIFT, size,
+				 vma->vm_page_prot);
+	if (ret)
+		return ret;
+
+	buff->mapped_wp = readl(sst->trace_wind.addr + core * wsize + 4);
+	buff->mapped = true;
+	return 0;
+}
+EXPORT_SYMBOL_GPL(skl_dsp_mmap_log);
+
+bool skl_dsp_log_mapped(struct sst_dsp *sst, int core)
+{
+	return sst->trace_wind.dbg_buffers[core]->mapped;
+}
+
+/*
+ * The firmware moved the write pointer of a mapped window to @write.
+ * Account for the new data and wake the reader up.
+ */
+void skl_dsp_notify_log(struct sst_dsp *sst, int core, u32 write)
+{
+	struct sst_dbg_rbuffer *buff = sst->trace_wind.dbg_buffers[core];
+	u32 ring = skl_dsp_log_window_size(sst) - 8;
+
+	if (write >= buff->mapped_wp)
+		buff->total_avail += write - buff->mapped_wp;
+	else
+		buff->total_avail += ring - buff->mapped_wp + write;
+	buff->mapped_wp = write;
+	wake_up(&buff->stream->runtime->sleep);
+}
+
 int skl_dsp_copy_log_user(struct sst_dsp *sst, int core,
 				void __user *dest, int count)
 {
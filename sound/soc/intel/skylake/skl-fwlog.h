@@ -12,6 +12,10 @@ int skl_dsp_init_log_buffer(struct sst_dsp *sst, int size,
 unsigned long skl_dsp_log_avail(struct sst_dsp *sst, int core);
 void skl_dsp_write_log(struct sst_dsp *sst, void __iomem *src, int core,
 			int count);
+int skl_dsp_mmap_log(struct sst_dsp *sst, int core, phys_addr_t lpe_phys,
+			struct vm_area_struct *vma);
+bool skl_dsp_log_mapped(struct sst_dsp *sst, int core);
+void skl_dsp_notify_log(struct sst_dsp *sst, int core, u32 write);
 int skl_dsp_copy_log_user(struct sst_dsp *sst, int core, void __user *dest,
 				int count);
 void skl_dsp_get_log_buff(struct sst_dsp *sst, int core);
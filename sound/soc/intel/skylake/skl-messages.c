@@ -2606,21 +2606,20 @@ int skl_delete_pipe(struct skl_sst *ctx, struct skl_pipe *pipe)
 }
 
 /*
- * A pipeline is also a scheduling entity in DSP which can be run, stopped
- * For processing data the pipe need to be run by sending IPC set pipe state
- * to DSP
+ * A created or reset pipe has to be paused before it can be started. Doing
+ * it ahead of time, when the stream is prepared, leaves a single set pipe
+ * state IPC for skl_run_pipe() on the stream start path.
  */
-int skl_run_pipe(struct skl_sst *ctx, struct skl_pipe *pipe)
+int skl_pause_pipe(struct skl_sst *ctx, struct skl_pipe *pipe)
 {
 	int ret;
 
 	dev_dbg(ctx->dev, "%s: pipe = %d\n", __func__, pipe->ppl_id);
 
-	/* If pipe was not created in FW, do not try to pause or delete */
-	if (pipe->state < SKL_PIPE_CREATED)
+	/* If pipe was not created in FW, do not try to pause it */
+	if (pipe->state < SKL_PIPE_CREATED || pipe->state == SKL_PIPE_PAUSED)
 		return 0;
 
-	/* Pipe has to be paused before it is started */
 	ret = skl_set_pipe_state(ctx, pipe, PPL_PAUSED);
 	if (ret < 0) {
 		dev_err(ctx->dev, "Failed to pause pipe\n");
@@ -2629,6 +2628,29 @@ int skl_run_pipe(struct skl_sst *ctx, struct skl_pipe *pipe)
 
 	pipe->state = SKL_PIPE_PAUSED;
 
+	return 0;
+}
+
+/*
+ * A pipeline is also a scheduling entity in DSP which can be run, stopped
+ * For processing data the pipe need to be run by sending IPC set pipe state
+ * to DSP
+ */
+int skl_run_pipe(struct skl_sst *ctx, struct skl_pipe *pipe)
+{
+	int ret;
+
+	dev_dbg(ctx->dev, "%s: pipe = %d\n", __func__, pipe->ppl_id);
+
+	/* If pipe was not created in FW, do not try to pause or delete */
+	if (pipe->state < SKL_PIPE_CREATED || pipe->state == SKL_PIPE_STARTED)
+		return 0;
+
+	/* Pipe has to be paused before it is started */
+	ret = skl_pause_pipe(ctx, pipe);
+	if (ret < 0)
+		return ret;
+
 	ret = skl_set_pipe_state(ctx, pipe, PPL_RUNNING);
 	if (ret < 0) {
 		dev_err(ctx->dev, "Failed to start pipe\n");
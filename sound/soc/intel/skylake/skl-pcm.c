@@ -327,6 +327,7 @@ static int skl_pcm_prepare(struct snd_pcm_substream *substream,
 					SNDRV_PCM_STATE_XRUN)) {
 		skl_reset_pipe(skl->skl_sst, mconfig->pipe);
 		skl_pcm_host_dma_prepare(dai->dev, mconfig->pipe->p_params);
+		skl_pause_pipe(skl->skl_sst, mconfig->pipe);
 	}
 
 	return 0;
@@ -875,6 +876,21 @@ static int skl_trace_compr_copy(struct snd_compr_stream *stream,
 		return skl_probe_compr_copy(stream, dest, count, cpu_dai);
 }
 
+static int skl_trace_compr_mmap(struct snd_compr_stream *stream,
+				struct vm_area_struct *vma)
+{
+	struct snd_soc_pcm_runtime *rtd = stream->private_data;
+	struct hdac_ext_bus *ebus = dev_get_drvdata(rtd->cpu_dai->dev);
+	struct skl *skl = ebus_to_skl(ebus);
+	int core = skl_get_compr_core(stream);
+
+	if (skl_is_logging_core(core))
+		return skl_dsp_mmap_log(skl->skl_sst->dsp, core,
+					pci_resource_start(skl->pci, 4), vma);
+	else
+		return skl_probe_compr_mmap(stream, vma);
+}
+
 static int skl_trace_compr_free(struct snd_compr_stream *stream,
 						struct snd_soc_dai *cpu_dai)
 {
@@ -897,6 +913,7 @@ static int skl_trace_compr_free(struct snd_compr_stream *stream,
 
 static struct snd_compr_ops skl_platform_compr_ops = {
 	.copy = skl_trace_compr_copy,
+	.mmap = skl_trace_compr_mmap,
 };
 
 static struct snd_soc_cdai_ops skl_probe_compr_ops = {
@@ -393,6 +393,36 @@ int skl_probe_compr_copy(struct snd_compr_stream *stream, char __user *buf,
 
 }
 
+/*
+ * Map the probe DMA buffer, so that extracted data is read (or injected
+ * data written) by userspace in place instead of through copy.
+ */
+int skl_probe_compr_mmap(struct snd_compr_stream *stream,
+				struct vm_area_struct *vma)
+{
+	struct snd_compr_runtime *runtime = stream->runtime;
+	struct snd_dma_buffer *dmab = runtime->dma_buffer_p;
+	unsigned long size = vma->vm_end - vma->vm_start;
+	unsigned long offset;
+	int ret;
+
+	if (!dmab)
+		return -EBADFD;
+	if (vma->vm_pgoff || size > PAGE_ALIGN(runtime->dma_bytes))
+		return -EINVAL;
+
+	/* The pages were made uncached by skl_substream_alloc_compr_pages() */
+	vma->vm_page_prot = pgprot_noncached(vma->vm_page_prot);
+	for (offset = 0; offset < size; offset += PAGE_SIZE) {
+		ret = vm_insert_page(vma, vma->vm_start + offset,
+				     snd_sgbuf_get_page(dmab, offset));
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
 int skl_probe_compr_trigger(struct snd_compr_stream *substream, int cmd,
 							struct snd_soc_dai *dai)
 {
@@ -439,7 +439,10 @@ skl_process_log_buffer(struct sst_dsp *sst, struct skl_ipc_header header)
 	ptr = (u32 *) base;
 	read = ptr[0];
 	write = ptr[1];
-	if (write > read) {
+	if (skl_dsp_log_mapped(sst, core)) {
+		/* the reader takes the log from the window and moves ptr[0] */
+		skl_dsp_notify_log(sst, core, write);
+	} else if (write > read) {
 		skl_dsp_write_log(sst, (void __iomem *)(base + 8 + read),
 					core, (write - read));
 		/* read pointer */
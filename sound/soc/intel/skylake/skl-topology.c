@@ -1319,6 +1319,13 @@ static int skl_tplg_mixer_dapm_pre_pmu_event(struct snd_soc_dapm_widget *w,
 		}
 	}
 
+	/*
+	 * FE pipes are started from the PCM trigger, pause them now so
+	 * that starting them takes a single IPC.
+	 */
+	if (s_pipe->conn_type == SKL_PIPE_CONN_TYPE_FE)
+		return skl_pause_pipe(ctx, s_pipe);
+
 	return 0;
 }
 
@@ -43,4 +43,15 @@ int sw_sync_fence_create(int fd, const char *name, unsigned int value);
 int sw_sync_fence_is_valid(int fd);
 void sw_sync_fence_destroy(int fd);
 
+#define SW_SYNC_BATCH_BENCHMARK	(1 << 0)
+
+struct sw_sync_batch_result {
+	unsigned long long signal_ns;
+	unsigned int signaled;
+};
+
+int sw_sync_timeline_batch(int fd, int *fences, unsigned int count,
+			   unsigned int step, unsigned int inc,
+			   unsigned int flags, struct sw_sync_batch_result *res);
+
 #endif
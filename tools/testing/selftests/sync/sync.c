@@ -49,10 +49,23 @@ struct sw_sync_create_fence_data {
 	__s32	fence;
 };
 
+struct sw_sync_batch_data {
+	__u32	count;
+	__u32	step;
+	__u32	inc;
+	__u32	flags;
+	__u64	fences;
+	__u64	signal_ns;
+	__u32	signaled;
+	__u32	pad;
+};
+
 #define SW_SYNC_IOC_MAGIC		'W'
 #define SW_SYNC_IOC_CREATE_FENCE	_IOWR(SW_SYNC_IOC_MAGIC, 0,\
 					      struct sw_sync_create_fence_data)
 #define SW_SYNC_IOC_INC			_IOW(SW_SYNC_IOC_MAGIC, 1, __u32)
+#define SW_SYNC_IOC_BATCH		_IOWR(SW_SYNC_IOC_MAGIC, 2,\
+					      struct sw_sync_batch_data)
 
 
 int sync_wait(int fd, int timeout)
@@ -175,6 +188,31 @@ int sw_sync_timeline_inc(int fd, unsigned int count)
 	return ioctl(fd, SW_SYNC_IOC_INC, &arg);
 }
 
+int sw_sync_timeline_batch(int fd, int *fences, unsigned int count,
+			   unsigned int step, unsigned int inc,
+			   unsigned int flags, struct sw_sync_batch_result *res)
+{
+	struct sw_sync_batch_data data = {};
+	int err;
+
+	data.count = count;
+	data.step = step;
+	data.inc = inc;
+	data.flags = flags;
+	data.fences = (uintptr_t)fences;
+
+	err = ioctl(fd, SW_SYNC_IOC_BATCH, &data);
+	if (err < 0)
+		return err;
+
+	if (res) {
+		res->signal_ns = data.signal_ns;
+		res->signaled = data.signaled;
+	}
+
+	return 0;
+}
+
 int sw_sync_timeline_is_valid(int fd)
 {
 	int status;
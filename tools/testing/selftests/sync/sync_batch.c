@@ -0,0 +1,96 @@
+/*
+ *  sync batched point tests
+ *  Copyright 2018 Google, Inc
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ *  OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ *  ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ *  OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "sync.h"
+#include "sw_sync.h"
+#include "synctest.h"
+
+#define BATCH_FENCES		64
+#define BATCH_BENCH_POINTS	16384
+
+int test_batch_create_signal(void)
+{
+	struct sw_sync_batch_result res;
+	int fences[BATCH_FENCES];
+	int timeline, valid, ret, i;
+
+	timeline = sw_sync_timeline_create();
+	valid = sw_sync_timeline_is_valid(timeline);
+	ASSERT(valid, "Failure allocating timeline\n");
+
+	/* Points at 1..64, advance the timeline to 32 */
+	ret = sw_sync_timeline_batch(timeline, fences, BATCH_FENCES, 1,
+				     BATCH_FENCES / 2, 0, &res);
+	ASSERT(ret == 0, "Failure creating batch\n");
+	ASSERT(res.signaled == BATCH_FENCES / 2,
+	       "Failure signaling half of the batch\n");
+
+	for (i = 0; i < BATCH_FENCES; i++) {
+		valid = sw_sync_fence_is_valid(fences[i]);
+		ASSERT(valid, "Failure allocating batch fence\n");
+
+		ret = sync_wait(fences[i], 0);
+		ASSERT(ret == (i < BATCH_FENCES / 2),
+		       "Batch fence in unexpected state\n");
+	}
+
+	ret = sw_sync_timeline_inc(timeline, BATCH_FENCES / 2);
+	ASSERT(ret == 0, "Failure advancing timeline\n");
+
+	for (i = 0; i < BATCH_FENCES; i++) {
+		ret = sync_wait(fences[i], 0);
+		ASSERT(ret > 0, "Failure signaling batch fence\n");
+		sw_sync_fence_destroy(fences[i]);
+	}
+
+	sw_sync_timeline_destroy(timeline);
+
+	return 0;
+}
+
+int test_batch_signal_benchmark(void)
+{
+	struct sw_sync_batch_result res;
+	int timeline, valid, ret;
+
+	timeline = sw_sync_timeline_create();
+	valid = sw_sync_timeline_is_valid(timeline);
+	ASSERT(valid, "Failure allocating timeline\n");
+
+	ret = sw_sync_timeline_batch(timeline, NULL, BATCH_BENCH_POINTS, 1,
+				     BATCH_BENCH_POINTS,
+				     SW_SYNC_BATCH_BENCHMARK, &res);
+	ASSERT(ret == 0, "Failure running batch benchmark\n");
+	ASSERT(res.signaled == BATCH_BENCH_POINTS,
+	       "Failure signaling every benchmark point\n");
+
+	ksft_print_msg("signaled %u points in %llu ns\n",
+		       res.signaled, res.signal_ns);
+
+	sw_sync_timeline_destroy(timeline);
+
+	return 0;
+}
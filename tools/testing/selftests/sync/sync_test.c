@@ -102,6 +102,8 @@ int main(void)
 	RUN_TEST(test_stress_two_threads_shared_timeline);
 	RUN_TEST(test_consumer_stress_multi_producer_single_consumer);
 	RUN_TEST(test_merge_stress_random_merge);
+	RUN_TEST(test_batch_create_signal);
+	RUN_TEST(test_batch_signal_benchmark);
 
 	err = ksft_get_fail_cnt();
 	if (err)
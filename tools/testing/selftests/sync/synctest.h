@@ -64,4 +64,8 @@ int test_consumer_stress_multi_producer_single_consumer(void);
 /* Stress test - merging */
 int test_merge_stress_random_merge(void);
 
+/* Batched creation and signaling */
+int test_batch_create_signal(void);
+int test_batch_signal_benchmark(void);
+
 #endif